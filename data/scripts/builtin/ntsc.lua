@@ -0,0 +1,167 @@
+--
+-- a composite NTSC look as a fragment shader
+--
+-- This is the GPU side alternative to the NTSC filter in the game
+-- frameserver. With the filter running in the frameserver, each frame grows
+-- to 7/8 * 2 times the width and twice the height before it is sent, here
+-- the frame stays at the native resolution and the effect is applied when
+-- the object is drawn.
+--
+-- Example use is as follows:
+--     local ntsc = system_load("builtin/ntsc.lua")()
+--     local ctx = ntsc(vid, {
+--         artifacts = 0.5, -- luma crawl from chroma, 0..1
+--         fringing = 0.5, -- colour fringes on luma edges, 0..1
+--         bleed = 0.3, -- horizontal smear of chroma, 0..1
+--         saturation = 1.0,
+--         hue = 0.0 -- in degrees
+--     })
+--
+-- For a frameserver the built-in filter is switched off so the unfiltered
+-- frames are the ones that arrive:
+--     target_graphmode(vid, 1, 1)
+--
+-- To change a parameter (same keys as above):
+--     ctx:set("artifacts", 0.2)
+--
+-- To restore the previous shader:
+--     ctx:destroy()
+--
+-- The model is an approximation: each source pixel is encoded into a YIQ
+-- composite signal with a subcarrier period of three pixels, shifted by a
+-- third each row, and then decoded again with separate luma and chroma
+-- filters. The parameters mix between the decoded and the clean values.
+--
+
+local frag = [[
+	uniform sampler2D map_diffuse;
+	uniform vec2 obj_storage_sz;
+	uniform float obj_opacity;
+
+	uniform float artifacts;
+	uniform float fringing;
+	uniform float bleed;
+	uniform float saturation;
+	uniform float hue;
+
+	varying vec2 texco;
+
+	const float pi = 3.1415926535;
+	const mat3 to_yiq = mat3(
+		0.299, 0.596, 0.211,
+		0.587, -0.274, -0.523,
+		0.114, -0.322, 0.312
+	);
+	const mat3 to_rgb = mat3(
+		1.0, 1.0, 1.0,
+		0.956, -0.272, -1.106,
+		0.621, -0.647, 1.703
+	);
+
+	void main()
+	{
+		vec2 px = texco * obj_storage_sz;
+		float row = floor(px.y);
+		float cx = floor(px.x);
+		vec3 clean = to_yiq * texture2D(map_diffuse, texco).rgb;
+
+		float luma = 0.0;
+		float lw = 0.0;
+		vec2 chroma = vec2(0.0);
+		float cw = 0.0;
+		float spread = 1.0 + 3.0 * bleed;
+
+/* modulate the neighbourhood and demodulate with the carrier at each tap,
+ * luma gets the narrow kernel, chroma a wider one to smear colour */
+		for (int i = -4; i <= 4; i++){
+			float fi = float(i);
+			float sx = cx + fi;
+			vec2 tc = vec2((sx + 0.5) / obj_storage_sz.x, texco.y);
+			vec3 yiq = to_yiq * texture2D(map_diffuse, tc).rgb;
+
+			float phase = 2.0 * pi * (sx + row) / 3.0;
+			float cs = cos(phase);
+			float sn = sin(phase);
+			float sig = yiq.x + yiq.y * cs + yiq.z * sn;
+
+			float wl = exp(-fi * fi / 2.0);
+			float wc = exp(-fi * fi / (2.0 * spread * spread));
+			luma += sig * wl;
+			lw += wl;
+			chroma += vec2(sig * cs, sig * sn) * 2.0 * wc;
+			cw += wc;
+		}
+
+		luma /= lw;
+		chroma /= cw;
+
+		vec3 res;
+		res.x = mix(clean.x, luma, artifacts);
+		res.yz = mix(clean.yz, chroma, fringing);
+
+		float h = radians(hue);
+		res.yz = saturation * mat2(cos(h), sin(h), -sin(h), cos(h)) * res.yz;
+
+		gl_FragColor = vec4(clamp(to_rgb * res, 0.0, 1.0), obj_opacity);
+	}
+]];
+
+local shid
+local defaults = {
+	artifacts = 0.5,
+	fringing = 0.5,
+	bleed = 0.3,
+	saturation = 1.0,
+	hue = 0.0
+};
+
+local function ntsc_set(ctx, key, val)
+	if not defaults[key] or type(val) ~= "number" then
+		return;
+	end
+
+	ctx.opts[key] = val;
+	shader_uniform(ctx.shader, key, "f", val);
+end
+
+local function ntsc_destroy(ctx)
+	if valid_vid(ctx.vid) then
+		image_shader(ctx.vid, ctx.old_shader);
+	end
+	ctx.vid = nil;
+end
+
+return function(vid, opts)
+	if not valid_vid(vid) then
+		return;
+	end
+
+	if not shid then
+		shid = build_shader(nil, frag, "ntsc_composite");
+		if not shid then
+			return;
+		end
+	end
+
+-- each context gets its own set of uniforms so the parameters can differ
+	local grp = shader_ugroup(shid);
+	if not grp then
+		return;
+	end
+
+	local ctx = {
+		vid = vid,
+		shader = grp,
+		opts = {},
+		set = ntsc_set,
+		destroy = ntsc_destroy
+	};
+
+	opts = opts and opts or {};
+	for k,v in pairs(defaults) do
+		ntsc_set(ctx, k, opts[k] ~= nil and opts[k] or v);
+	end
+
+	ctx.old_shader = image_shader(vid, grp);
+	return ctx;
+end
@@ -2,16 +2,21 @@
 -- @short: Load/build a mesh and attach to a model.
 -- @inargs: vid:dstmodel, str/tbl:source
 -- @inargs: vid:dstmodel, str/tbl:source, int:nmaps
+-- @inargs: vid:dstmodel, vid:source, int:nmaps, int:lod
 -- @outargs: int:meshindex
 -- @longdescr: This function can be used to setup and attach a mesh to an open
--- model. If *source* is a string, it is treated as a resource that will be
--- passed through an internal model loader. Right now, this method of model
--- loading is disabled and will always fail soft. The reason for that is that
--- the parsing stage needs to move out of the main engine into the decode
--- frameserver for safety and security. This is a temporary measure. The
--- intermediate workaround for the time being is to use the table structure
--- along with a mesh to .lua or mesh to .json along with the builtin/json.lua
--- parser.
+-- model. If *source* is a string, it is treated as a resource with a packed
+-- mesh (.amsh) as written by the 3d mode of the decode frameserver when it is
+-- given a bchunk- out descriptor. Parsing of text model formats happens in the
+-- frameserver for safety and security and never in the main engine.
+--
+-- If *source* is a frameserver vid running the 3d mode of decode, with
+-- TARGET_ALLOWVECTOR set through ref:target_flags, the last packed mesh it has
+-- sent (announced through the "mesh" event with the fields vertices, indices,
+-- lods and id) is attached. The frameserver sends the coarsest level of detail
+-- first and then refinements, adding the same frameserver again replaces the
+-- previous mesh rather than adding a new one, also on a finalized model. The
+-- optional 4th argument *lod* picks a level (0..lods-1), default is the finest.
 --
 -- If *source* is a table, the following fields are expected:
 -- .vertices (indexed table) {x1, y1, z1, x2, y2, z2, ...}
@@ -347,6 +347,9 @@ hi def link luaLabel		Label
 
 
 syn keyword luaFunc benchmark_data
+syn keyword luaFunc benchmark_profile
+syn keyword luaFunc benchmark_gputime
+syn keyword luaFunc benchmark_inputlatency
 syn keyword luaFunc define_nulltarget
 syn keyword luaFunc net_listen
 syn keyword luaFunc text_dimensions
@@ -374,9 +377,11 @@ syn keyword luaFunc copy_surface_properties
 syn keyword luaFunc copy_image_transform
 syn keyword luaFunc video_synchronization
 syn keyword luaFunc system_identstr
+syn keyword luaFunc system_gcbudget
 syn keyword luaFunc net_open
 syn keyword luaFunc delete_audio
 syn keyword luaFunc set_led_rgb
+syn keyword luaFunc set_led_frame
 syn keyword luaFunc delete_image
 syn keyword luaFunc set_context_attachment
 syn keyword luaFunc build_shader
@@ -412,6 +417,7 @@ syn keyword luaFunc video_3dorder
 syn keyword luaFunc target_portconfig
 syn keyword luaFunc nudge_image
 syn keyword luaFunc match_keys
+syn keyword luaFunc list_keys
 syn keyword luaFunc close_rawresource
 syn keyword luaFunc set_image_as_frame
 syn keyword luaFunc fill_surface
@@ -423,6 +429,7 @@ syn keyword luaFunc pacify_target
 syn keyword luaFunc snapshot_target
 syn keyword luaFunc get_keys
 syn keyword luaFunc resize_image
+syn keyword luaFunc resize_image_batch
 syn keyword luaFunc scale_3dvertices
 syn keyword luaFunc image_active_frame
 syn keyword luaFunc define_rendertarget
@@ -463,6 +470,7 @@ syn keyword luaFunc render_text
 syn keyword luaFunc store_key
 syn keyword luaFunc define_recordtarget
 syn keyword luaFunc blend_image
+syn keyword luaFunc blend_image_batch
 syn keyword luaFunc define_feedtarget
 syn keyword luaFunc force_image_blend
 syn keyword luaFunc target_configurations
@@ -476,6 +484,8 @@ syn keyword luaFunc raw_surface
 syn keyword luaFunc system_snapshot
 syn keyword luaFunc kbd_repeat
 syn keyword luaFunc inputanalog_toggle
+syn keyword luaFunc inputanalog_coalesce
+syn keyword luaFunc inputanalog_history
 syn keyword luaFunc build_sphere
 syn keyword luaFunc write_rawresource
 syn keyword luaFunc image_matchstorage
@@ -541,6 +551,7 @@ syn keyword luaFunc delete_shader
 syn keyword luaFunc image_screen_coordinates
 syn keyword luaFunc video_displaymodes
 syn keyword luaFunc resample_image
+syn keyword luaFunc resample_batch
 syn keyword luaFunc move_cursor
 syn keyword luaFunc target_devicehint
 syn keyword luaFunc pick_items
@@ -572,11 +583,13 @@ syn keyword luaFunc rendertarget_vids
 syn keyword luaFunc define_arcantarget
 syn keyword luaFunc image_get_txcos
 syn keyword luaFunc frameserver_debugstall
+syn keyword luaFunc frameserver_placement
 syn keyword luaFunc order_image
 syn keyword luaFunc recordtarget_gain
 syn keyword luaFunc input_filter_analog
 syn keyword luaFunc toggle_mouse_grab
 syn keyword luaFunc move_image
+syn keyword luaFunc move_image_batch
 syn keyword luaFunc reset_image_transform
 syn keyword luaConstant APPL_TEMP_RESOURCE
 syn keyword luaConstant VRESH
@@ -586,6 +599,9 @@ syn keyword luaConstant EXIT_SUCCESS
 syn keyword luaConstant API_VERSION_MAJOR
 syn keyword luaConstant FONT_PT_SZ
 syn keyword luaConstant FORMAT_RAW32
+syn keyword luaConstant FORMAT_PNG_FAST
+syn keyword luaConstant FORMAT_QOI
+syn keyword luaConstant FORMAT_RAW
 syn keyword luaConstant RENDERTARGET_NOSCALE
 syn keyword luaConstant ALLOC_QUALITY_NORMAL
 syn keyword luaConstant ALLOC_QUALITY_HIGH
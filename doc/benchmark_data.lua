@@ -1,7 +1,13 @@
 -- benchmark_data
 -- @short: Retrieve gathered benchmarking values.
--- @outargs: nticks, tickcosttbl, framecount, frametimetbl, costcount, framecosttbl
+-- @outargs: nticks, tickcosttbl, framecount, frametimetbl, costcount, framecosttbl, gccount, gccosttbl, gpucount, gpucosttbl
+-- @longdescr: The gc values cover the incremental garbage collection steps
+-- the conductor runs while waiting for the next frame deadline, with
+-- gccosttbl holding the time spent (in microseconds) per frame.
+-- The gpu values hold the summed GPU time (in microseconds) of the
+-- rendertarget passes collected per frame, these are only gathered with
+-- the video_gpu_timers option, see ref:benchmark_gputime.
 -- @group: system
 -- @cfunction: getbenchvals
--- @related: benchmark_enable, benchmark_timestamp
+-- @related: benchmark_enable, benchmark_timestamp, benchmark_gputime
 
@@ -24,17 +24,21 @@
 -- The entries in *tracetbl* is n indexed of tables with the following
 -- fields:
 -- number:timestamp
--- string:system (graphics, 3d, video, audio, event, frameserver, lua)
+-- string:system (graphics, 3d, video, audio, event, frameserver, lua, startup)
 -- string:subsystem
 -- int:trigger (0 one-shot, 1:enter, 2:exit)
 -- string:path
 -- int:quantity
 -- string:message
 -- int:identifier
+-- @note: The first collection starts with enter/exit pairs with the system
+-- 'startup' for each engine startup phase (database, event, video, audio,
+-- platform, scripting, appl), the exit quantity is the duration in
+-- microseconds.
 -- @note: All calls to this function will reset all timestamp buffers.
 -- @note: Since this can be called from within error handling, make sure
 -- that the dumping code is robust and fast. The ANR watchdog will also
 -- be disabled while inside the callback.
 -- @cfunction: togglebench
--- @related: benchmark_data, benchmark_timestamp, benchmark_tracedata
+-- @related: benchmark_data, benchmark_timestamp, benchmark_tracedata, benchmark_profile
 
@@ -0,0 +1,32 @@
+-- benchmark_gputime
+-- @short: Retrieve the GPU time spent on the last measured rendertarget pass
+-- @inargs: vid:rtgt
+-- @outargs: nil or float:microseconds
+-- @longdescr: When the engine is started with the video_gpu_timers option
+-- and the GPU supports timer queries, each rendertarget pass is measured on
+-- the GPU side. The results are collected without waiting on the GPU, so the
+-- returned value lags a few frames behind and covers both the 2D and the 3D
+-- (camtagged) parts of the pass. *rtgt* is either a rendertarget or WORLDID.
+-- Returns nil if timers are disabled, unsupported or no result has arrived
+-- yet. Results are also added to the tracebuffer (system 'video', subsystem
+-- 'rendertarget-gpu', quantity in microseconds) and the per-frame sum to the
+-- values returned by ref:benchmark_data.
+-- @note: To get the cost of a specific shader or set of objects, route them
+-- into a rendertarget of their own.
+-- @group: system
+-- @cfunction: getgputime
+-- @related: benchmark_data, benchmark_enable
+function main()
+#ifdef MAIN
+	local rt = alloc_surface(320, 200)
+	define_rendertarget(rt, {fill_surface(32, 32, 255, 0, 0)})
+	timer_add_periodic("gpu", 25, false, function()
+		print("world", benchmark_gputime(WORLDID))
+		print("rt", benchmark_gputime(rt))
+	end, true)
+#endif
+
+#ifdef ERROR1
+	benchmark_gputime()
+#endif
+end
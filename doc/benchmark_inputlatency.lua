@@ -0,0 +1,24 @@
+-- benchmark_inputlatency
+-- @short: Retrieve input-to-present latency percentiles per device class
+-- @outargs: tbl
+-- @longdescr: Input samples are timestamped when read by the input platform
+-- (currently evdev). When an input event has been dispatched, the next frame
+-- that is rendered could reflect it, and the time from reading the sample
+-- to that frame being presented (page flip completion where the video
+-- platform reports it, otherwise the end of the frame) is recorded.
+-- The last 128 measurements are kept per device class, regardless of
+-- ref:benchmark_enable.
+-- The returned table has the keys 'keyboard', 'mouse', 'touch' and 'game',
+-- each with a table of 'count', 'p50' and 'p99' where the percentiles are
+-- in microseconds and count is the number of samples they were taken over.
+-- @note: The same values can be queried through the monitor interface with
+-- the 'latency' command.
+-- @group: system
+-- @cfunction: getinputlatency
+-- @related: benchmark_data, benchmark_gputime
+function main()
+#ifdef MAIN
+	local lat = benchmark_inputlatency()
+	print(lat.mouse.count, lat.mouse.p50, lat.mouse.p99)
+#endif
+end
@@ -0,0 +1,38 @@
+-- benchmark_profile
+-- @short: Sample the Lua call stack into the ongoing tracebuffer
+-- @inargs: int:interval_us
+-- @inargs: int:interval_us, int:depth=16
+-- @outargs: bool:ok
+-- @longdescr: This function starts (or with an *interval_us* of 0, stops)
+-- a sampling profiler for the scripting layer. Roughly every *interval_us*
+-- microseconds the call stack of the running script is recorded, up to
+-- *depth* frames deep, into the tracebuffer set by ref:benchmark_enable.
+-- Samples are entries with system set to 'lua' and subsystem to 'sample',
+-- the message holds the stack folded outermost first as
+-- 'name@source:line;name@source:line', the identifier holds the number of
+-- frames and the quantity the sampling interval. Nothing is recorded while
+-- the engine is not running script code or when no tracebuffer is active.
+-- Returns false if the sampler could not be started.
+-- @note: The minimum interval is 100 microseconds.
+-- @note: tests/interactive/tracetest shows how to turn the samples into
+-- nested events in the chrome trace format.
+-- @group: system
+-- @cfunction: benchprofile
+-- @related: benchmark_enable, benchmark_tracedata
+function main()
+#ifdef MAIN
+	benchmark_enable(1024,
+	function(res)
+		for k,v in ipairs(res) do
+			if v.subsystem == "sample" then
+				print(v.timestamp, v.message)
+			end
+		end
+	end)
+	benchmark_profile(1000, 8)
+#endif
+
+#ifdef ERROR1
+	benchmark_profile(10)
+#endif
+end
@@ -0,0 +1,34 @@
+-- blend_image_batch
+-- @short: Change the opacity of many images in one call.
+-- @inargs: numtbl:buf
+-- @inargs: numtbl:buf, int:time
+-- @inargs: numtbl:buf, int:time, int:interp
+-- @outargs: int:count
+-- @longdescr: This is a batch version of ref:blend_image for layout passes that
+-- would otherwise call it once per vid. *buf* is an indexed table that
+-- interleaves a vid with opacity, repeated for each vid to update, where
+-- opacity is the new opacity, as with ref:blend_image.
+-- All updates share the same *time* and *interp* arguments.
+-- Invalid vids are skipped and the number of vids that were updated is returned.
+-- @note: The length of *buf* has to be a multiple of the number of values per
+-- vid and every entry has to be a number, other buffers are terminal state
+-- transitions.
+-- @group: image
+-- @cfunction: blendimagebatch
+-- @related: blend_image
+function main()
+	local buf = {};
+	for i=1,32 do
+		local vid = fill_surface(32, 32, i * 8, 0, 0);
+		move_image(vid, (i - 1) % 8 * 40, math.floor((i - 1) / 8) * 40);
+		table.insert(buf, vid);
+		table.insert(buf, i / 32);
+	end
+#ifdef MAIN
+	blend_image_batch(buf, 50);
+#endif
+
+#ifdef ERROR
+	blend_image_batch({buf[1], "half"});
+#endif
+end
@@ -1,12 +1,51 @@
 -- build_pointcloud
 -- @short: Create a 3D object that is comprised of a cloud of points.
--- @inargs: pointcount, *nmaps*
+-- @inargs: pointcount, *nmaps*, *width*
 -- @outargs: vid
 -- @longdescr: Evenly distribute *pointcount* points in a bounding
 -- volume from -1,-1,-1 to 1,1,1. This is primarily intended to be
 -- manipulated with a vertex shader and a possible lookup texture.
+-- If *width* is provided, the texture coordinates of the points are placed
+-- at the texel centers of a *width* by ceil(pointcount / width) map, point n
+-- at column n % width, row n / width. This lets a map, like the buffer of a
+-- frameserver negotiated with fp16 (RGBA16F) contents, carry a position per
+-- point that the vertex shader looks up, so that the point data can be
+-- streamed and consumed without passing through Lua.
+-- Each point also has an RGBA color (initially white) that is exposed to
+-- shaders through the color attribute. Positions and colors can be changed
+-- with ref:pointcloud_update, only the changed range is synched.
 -- @group: 3d
 -- @cfunction: pointcloud
--- @related:
+-- @related: pointcloud_update
 -- @flags:
+function main()
+#ifdef MAIN
+	local vshader = [[
+	uniform mat4 modelview;
+	uniform mat4 projection;
+	uniform sampler2D map_tu0;
 
+	attribute vec4 vertex;
+	attribute vec4 color;
+	attribute vec2 texcoord;
+	varying vec4 point_color;
+
+	void main(){
+		vec4 pos = texture2D(map_tu0, texcoord);
+		gl_PointSize = 2.0;
+		point_color = color;
+		gl_Position = projection * modelview * vec4(pos.xyz, 1.0);
+	}
+	]];
+
+	local fshader = [[
+	varying vec4 point_color;
+	void main(){
+		gl_FragColor = point_color;
+	}
+	]];
+
+	local cloud = build_pointcloud(512 * 512, 1, 512);
+	image_shader(cloud, build_shader(vshader, fshader, "points"));
+#endif
+end
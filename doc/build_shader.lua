@@ -33,7 +33,8 @@
 -- trans_rotate (float, 0.0 .. 1.0), obj_input_sz (vec2, orig w/h)
 -- obj_output_sz (vec2, current w/h), obj_storage_sz (vec2, texture
 -- storage w/h), obj_opacity(float, 0.0 .. 1.0), obj_col (vec3, 0.0 .. 1.0),
--- rtgt_id (uint), fract_timestamp (float), timestamp (int)
+-- rtgt_id (uint), fract_timestamp (float), timestamp (int),
+-- vr_reproject (mat4, the head rotation since the VR eyes were latched)
 -- @group: vidsys
 -- @related: shader_uniform, image_shader, shader_ugroup, delete_shader
 -- @cfunction: buildshader
@@ -2,6 +2,7 @@
 -- @short: Define a camera for the 3D processing of a rendertarget
 -- @inargs: vid:dst
 -- @inargs: vid:dst, numbtl:projection
+-- @inargs: vid:dst, vid:eye, string:"stereo"
 -- @inargs: vid:dst, float:near
 -- @inargs: vid:dst, float:near, float:far
 -- @inargs: vid:dst, float:near, float:far, float:fov
@@ -24,6 +25,13 @@
 -- drawing mode for the camera and disable normal processing.
 -- the argument form providing *projection* will replace the current projection matrix of the
 -- camera with that of the table.
+-- The argument form with the string "stereo" pairs the camera with a second
+-- one, *eye*, and the rendertarget is then drawn in a single pass with the
+-- left half of the viewport seen from *dst* and the right half from *eye*.
+-- The *eye* keeps its own position, orientation and projection, and is made
+-- into a camera with the parameters of *dst* if it is not already one. Use
+-- BADID as *eye* to revert to a single view. Occlusion queries
+-- (video_3d_occlusion) are not used for stereo passes.
 -- @group: 3d
 -- @cfunction: camtag
 -- @related: video_3dorder
@@ -0,0 +1,34 @@
+-- frameserver_placement
+-- @short: set the resource class for subsequently launched frameservers
+-- @inargs: string:class
+-- @inargs:
+-- @outargs: bool:ok
+-- @longdescr: Frameservers are placed in a resource class when launched,
+-- which controls scheduling policy, nice level, cpu affinity and, if a
+-- delegated cgroup v2 directory has been set through the frameserver_cgroup
+-- config key, cpu.weight, cpuset.cpus and memory.high. By default the class
+-- follows the archetype, encode and decode go in batch-decode and the rest
+-- in interactive. This function changes the class used by all launch_
+-- functions that follow, until it is called again. Calling it without an
+-- argument or with an empty string returns to the archetype default.
+-- The available classes are "interactive", "realtime-audio", "batch-decode"
+-- and "background". The batch-decode and background classes are kept off
+-- the cpus set by the frameserver_reserve config key, which defaults to the
+-- first cpu when there are four or more.
+-- @note: realtime-audio asks for SCHED_FIFO, which needs RLIMIT_RTPRIO or
+-- CAP_SYS_NICE. Without either it falls back to the normal policy.
+-- @note: The per-class defaults can be overridden with the
+-- frameserver_class_name config key (- in name replaced by _), e.g.
+-- frameserver_class_batch_decode=weight=50:cpus=2-7:mem=1G:sched=batch:nice=10
+-- @note: Returns false and leaves the current class as is if *class* is
+-- not known.
+-- @group: system
+-- @cfunction: fsrvplacement
+-- @related: launch_avfeed, launch_decode, launch_target
+function main()
+#ifdef MAIN
+	frameserver_placement("batch-decode");
+	launch_decode("test.mkv", function() end);
+	frameserver_placement();
+#endif
+end
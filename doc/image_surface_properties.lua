@@ -6,6 +6,9 @@
 -- @note: The fields used in proptbl are: (x, y, z, width, height, angle, roll, pitch, yaw,
 -- opacity and order).
 -- @note: The values retrieved are expressed in local (object) coordinate space.
+-- @note: On LuaJIT builds with the video_lua_ffi option set, proptbl is a
+-- struct with the same fields. The fields can be read and assigned, but it
+-- can't be iterated with pairs or extended with new keys.
 -- @group: image
 -- @cfunction: getimageprop
 -- @related: image_surface_initial_properties, image_surface_resolve_properties,
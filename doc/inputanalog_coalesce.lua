@@ -0,0 +1,31 @@
+-- inputanalog_coalesce
+-- @short: Merge high-rate analog and touch samples before they are queued.
+-- @inargs: devid, *mode*
+-- @longdescr:
+-- Devices with high sampling rates (high polling rate mice, pen tablets,
+-- touch screens) can produce far more samples than there are frames to
+-- present them in. This function sets *devid* to coalesce analog and touch
+-- samples before they reach the event queue. Pending samples are merged per
+-- device, sub-id and kind and forwarded at most once per event processing
+-- pass, relative motion is accumulated and the last absolute value kept.
+-- Touch press and release transitions are never merged, and any other input
+-- event from any device forwards pending samples first so that ordering is
+-- preserved.
+-- *mode* can be one out of "off", "merge" (default) or "history". With
+-- "history" the raw samples are also kept and can be retrieved through
+-- ref:inputanalog_history.
+-- A negative *devid* sets the mode for all devices that have not been set
+-- explicitly. The initial default is "off" unless the event_coalesce config
+-- key is set, in which case it is "merge".
+-- @group: iodev
+-- @cfunction: inputanalogcoalesce
+-- @related: inputanalog_history, inputanalog_filter
+function main()
+#ifdef MAIN
+	inputanalog_coalesce(-1, "merge")
+#endif
+
+#ifdef ERROR1
+	inputanalog_coalesce(-1, "weird")
+#endif
+end
@@ -0,0 +1,22 @@
+-- inputanalog_history
+-- @short: Retrieve the raw samples behind coalesced analog input.
+-- @inargs: devid
+-- @outargs: samples
+-- @longdescr:
+-- For a device that has been set to the "history" mode through
+-- ref:inputanalog_coalesce, the most recent raw samples (up to 64) are kept
+-- before merging. This function returns them as an indexed table, oldest
+-- first, with each entry using the same fields as the input event handler
+-- table. Reading consumes the history.
+-- @note: Devices with any other coalescing mode return an empty table.
+-- @group: iodev
+-- @cfunction: inputanaloghistory
+-- @related: inputanalog_coalesce
+function main()
+#ifdef MAIN
+	inputanalog_coalesce(0, "history")
+	for i,v in ipairs(inputanalog_history(0)) do
+		print(v.devid, v.subid, v.samples[1])
+	end
+#endif
+end
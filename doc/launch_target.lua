@@ -61,7 +61,7 @@
 -- "coreopt", "message", "failure", "framestatus", "streaminfo",
 -- "streamstatus", "segment_request", "state_size",
 -- "viewport", "alert", "content_state", "registered", "clock", "cursor",
--- "bchunkstate", "proto_update", "input_mask", "ramp_update"
+-- "bchunkstate", "proto_update", "input_mask", "ramp_update", "mesh"
 --
 -- @tblent: "preroll" {string:segkind, aid:source_audio} is an initial state
 -- where the resources for the target have been reserved, and it is possible
@@ -223,6 +223,12 @@
 -- the color ramp subprotocol, this event will be triggered for each mapped ramp
 -- index. For more information on this system, see ref:video_displaygamma
 --
+-- @tblent: "mesh", {vertices, indices, lods, id} - for clients that have been
+-- allowed vector transfers (TARGET_ALLOWVECTOR), a packed mesh has been received
+-- and can be attached to a model through ref:add_3dmesh with the frameserver as
+-- source. A client may send several in a row (e.g. increasing levels of detail),
+-- only the latest one is kept.
+--
 -- @tblent: "privdrop", {external, networked, sandboxed} - this is used to indicate
 -- that the privilege context a client operates within has changed. trusted launch
 -- can become external in origin, proxied connections can flip between being
@@ -0,0 +1,34 @@
+-- list_keys
+-- @short: Iterate keys and values that start with a prefix
+-- @inargs: prefix, *pagesize*, *targetname*, *configname*
+-- @outargs: iterfun
+-- @longdescr: This function returns an iterator that yields key, value pairs
+-- in key order for all keys that start with *prefix*. They come from the
+-- appl- specific key-value store, or if *targetname* (and *configname*) are
+-- set, the ones associated with that target (and config).
+-- The keys are looked up as a range over the key index rather than through a
+-- pattern like with match_keys, and are retrieved *pagesize* (default, 256)
+-- pairs at a time. This makes it suited for large key sets with hierarchical
+-- prefixes, e.g. per-window state.
+-- @note: keys stored after the iteration has started are included if they
+-- sort after the last key that was returned.
+-- @note: '%' and '_' have no special meaning in *prefix*.
+-- @group: database
+-- @cfunction: listkeys
+-- @related: match_keys, get_key, store_key
+function main()
+#ifdef MAIN
+	store_key({win_1_x = "10", win_1_y = "20", win_2_x = "30", other = "1"});
+	for key, val in list_keys("win_") do
+		print(key, val);
+	end
+
+	for key, val in list_keys("win_1_", 1) do
+		print(key, val);
+	end
+#endif
+
+#ifdef ERROR1
+	list_keys();
+#endif
+end
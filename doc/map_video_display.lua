@@ -43,6 +43,13 @@
 -- that flag will simply resolve to 0 so it is API-wise safe for use. The
 -- caveats should be conveyed to a user.
 --
+-- The HINT_TEARING flag asks the platform to present new contents as soon
+-- as they are ready instead of waiting for vblank, trading tearing for lower
+-- latency. Platforms or drivers without asynchronous flips ignore the flag.
+-- Clients mapped directly to the display can ask for the same behaviour on
+-- their own, and the "tearing" synchronization strategy applies it to all
+-- displays.
+--
 -- @note: A *src* referencing an object with a feed- function, such as
 -- one coming from ref:define_recordtarget, ref:define_calctarget and so
 -- on, is a terminal state transition.
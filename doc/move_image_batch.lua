@@ -0,0 +1,35 @@
+-- move_image_batch
+-- @short: Move many images in one call.
+-- @inargs: numtbl:buf
+-- @inargs: numtbl:buf, int:time
+-- @inargs: numtbl:buf, int:time, int:interp
+-- @outargs: int:count
+-- @longdescr: This is a batch version of ref:move_image for layout passes that
+-- would otherwise call it once per vid. *buf* is an indexed table that
+-- interleaves a vid with x, y, repeated for each vid to update, where
+-- x, y is the new x and y position, as with ref:move_image.
+-- All updates share the same *time* and *interp* arguments.
+-- Invalid vids are skipped and the number of vids that were updated is returned.
+-- @note: The length of *buf* has to be a multiple of the number of values per
+-- vid and every entry has to be a number, other buffers are terminal state
+-- transitions.
+-- @group: image
+-- @cfunction: moveimagebatch
+-- @related: move_image
+function main()
+	local buf = {};
+	for i=1,32 do
+		local vid = fill_surface(32, 32, i * 8, 0, 0);
+		show_image(vid);
+		table.insert(buf, vid);
+		table.insert(buf, (i - 1) % 8 * 40);
+		table.insert(buf, math.floor((i - 1) / 8) * 40);
+	end
+#ifdef MAIN
+	move_image_batch(buf, 20, INTERP_SMOOTHSTEP);
+#endif
+
+#ifdef ERROR
+	move_image_batch({buf[1], 10});
+#endif
+end
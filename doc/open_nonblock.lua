@@ -56,12 +56,23 @@
 -- optimization to avoid additional string manipulation when linefeeds aren't
 -- desired in the resulting string.
 --
+-- The await([int:n or string:delim="\n"]):str,bool function is a read for use
+-- inside a coroutine. It returns n bytes or everything up to and including
+-- *delim* (see lf_strip) along with the alive state, and if that is not
+-- available yet the coroutine is suspended and resumed with the results when
+-- it is. Data for fixed size reads goes into a buffer allocated up front, so
+-- await(65536) in a loop is a cheap way of bulk-reading a stream. At eof,
+-- whatever remains is returned with alive set to false. The await can't be
+-- combined with a data_handler on the same object.
+--
 -- The write(buf, [callback(ok, gpublock)]):int,bool function takes a buffer string
 -- or table of buffer strings as argument and queues for writing.
 -- If a callback is provided, it will be triggered if writing encounters a
 -- terminal state or all queued writes have been completed.
 -- Multiple subsequent write calls will add buffers to the queue, and the last
 -- provided callback will be the only one to fire.
+-- Queued buffers are flushed with as few system calls as possible, so passing
+-- a table of strings is preferred over concatenating them first.
 -- The callback form can also fail (returns 0, false) if the number of polled data
 -- sources exceed some system bound or if the source is not opened for writing.
 --
@@ -114,6 +125,23 @@ function main_clock_pulse()
 end
 #endif
 
+#ifdef MAIN3
+function main()
+	a = open_nonblock("test.txt")
+	reader = coroutine.create(
+	function()
+		repeat
+			local line, alive = a:await("\n")
+			if line then
+				print(line)
+			end
+		until not alive
+		a:close()
+	end)
+	coroutine.resume(reader)
+end
+#endif
+
 #ifdef MAIN2
 function main()
 	a = open_nonblock("=test", false)
@@ -0,0 +1,30 @@
+-- pointcloud_update
+-- @short: Replace the positions and/or colors of points in a pointcloud.
+-- @inargs: vid:cloud, int:start, nil|tbl:positions, *tbl:colors*
+-- @outargs: bool
+-- @longdescr: Overwrite points in a *cloud* created with ref:build_pointcloud
+-- starting at point *start* (first point is 1). *positions* is a flat table of
+-- x, y, z triplets and *colors* a flat table of r, g, b, a quadruplets, either
+-- of which can be nil. Points past the end of the cloud are ignored. The
+-- changes are copied into a GPU side buffer the next time the cloud is drawn,
+-- when supported through a persistently mapped buffer where only the modified
+-- range is transferred. Returns false if *cloud* is not a pointcloud.
+-- @note: For larger, per-frame updates, have a frameserver produce the
+-- positions into a buffer used as a map and sample it in a vertex shader, see
+-- ref:build_pointcloud.
+-- @note: positions or colors not divisible by 3 and 4 values respectively
+-- is a terminal state transition.
+-- @group: 3d
+-- @cfunction: pointcloudupdate
+-- @related: build_pointcloud
+-- @flags:
+function main()
+#ifdef MAIN
+	local cloud = build_pointcloud(1000);
+	show_image(cloud);
+	pointcloud_update(cloud, 1, {0, 0, 0, 0.5, 0.5, 0.5}, {1, 0, 0, 1, 0, 1, 0, 1});
+#endif
+#ifdef ERROR
+	pointcloud_update(BADID, 1, {1, 2});
+#endif
+end
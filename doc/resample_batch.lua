@@ -0,0 +1,61 @@
+-- resample_batch
+-- @short: resample many images in one pass
+-- @inargs: tbl:jobs, shid:shader
+-- @inargs: tbl:jobs, shid:shader, bool:separate
+-- @inargs: tbl:jobs, shid:shader, bool:separate, func:callback
+-- @outargs: vidtbl or nil
+-- @longdescr: This function takes an indexed table of jobs, where each job
+-- is an indexed table of {vid:src, int:width, int:height}, and resamples
+-- every *src* to *width* and *height* output using the shader specified in
+-- *shader*. Contrary to ref:resample_image, the sources are left untouched
+-- and a new vid is returned for each job, in the same order as *jobs*.
+-- All jobs are drawn in a single offscreen pass into a shared atlas. By default
+-- the returned vids share the atlas storage and reference their region through
+-- texture coordinates, which is the cheaper option. If *separate* is set
+-- (default to false), the atlas is read back once and split into individual
+-- storages that can be resized, shared or used as rendertargets like any other
+-- image. If *callback* is provided, it will be invoked once the batch has been
+-- completed with the first returned vid as source and a table with
+-- kind = "resampled" along with the *width* and *height* of the atlas.
+-- @note: The batch is processed in full or not at all, on failure nil is returned.
+-- @note: Batches that do not fit into a single atlas (RESAMPLE_ATLAS_SIZE,
+-- default 8192x8192) are split into as many passes as needed.
+-- @note: Exceeding MAX_SURFACEW, MAX_SURFACEH for any job is a terminal state
+-- transition.
+-- @group: image
+-- @cfunction: resamplebatch
+-- @related: resample_image
+
+function main()
+	local imgs = {};
+	for i=1,16 do
+		imgs[i] = load_image("test.png");
+	end
+	local shid = build_shader(nil, [[
+uniform sampler2D map_diffuse;
+varying vec2 texco;
+
+void main()
+{
+	gl_FragColor = texture2D(map_diffuse, texco);
+}
+]], "thumbnail");
+#ifdef MAIN
+	local jobs = {};
+	for i,v in ipairs(imgs) do
+		jobs[i] = {v, 64, 64};
+	end
+	local thumbs = resample_batch(jobs, shid, false,
+	function(source, status)
+		print("batch done", status.width, status.height);
+	end);
+	for i,v in ipairs(thumbs) do
+		move_image(v, ((i-1) % 4) * 64, math.floor((i-1) / 4) * 64);
+		show_image(v);
+	end
+#endif
+
+#ifdef ERROR
+	resample_batch({{imgs[1], -64, -64}}, shid);
+#endif
+end
@@ -0,0 +1,36 @@
+-- resize_image_batch
+-- @short: Resize many images in one call.
+-- @inargs: numtbl:buf
+-- @inargs: numtbl:buf, int:time
+-- @inargs: numtbl:buf, int:time, int:interp
+-- @outargs: int:count
+-- @longdescr: This is a batch version of ref:resize_image for layout passes that
+-- would otherwise call it once per vid. *buf* is an indexed table that
+-- interleaves a vid with w, h, repeated for each vid to update, where
+-- w, h is the new absolute width and height, as with ref:resize_image (0 in one of them retains the aspect ratio).
+-- All updates share the same *time* and *interp* arguments.
+-- Invalid vids are skipped and the number of vids that were updated is returned.
+-- @note: The length of *buf* has to be a multiple of the number of values per
+-- vid and every entry has to be a number, other buffers are terminal state
+-- transitions.
+-- @group: image
+-- @cfunction: resizeimagebatch
+-- @related: resize_image
+function main()
+	local buf = {};
+	for i=1,32 do
+		local vid = fill_surface(32, 32, i * 8, 0, 0);
+		move_image(vid, (i - 1) % 8 * 66, math.floor((i - 1) / 8) * 66);
+		show_image(vid);
+		table.insert(buf, vid);
+		table.insert(buf, 64);
+		table.insert(buf, 0);
+	end
+#ifdef MAIN
+	resize_image_batch(buf, 20);
+#endif
+
+#ifdef ERROR
+	resize_image_batch({buf[1], 10});
+#endif
+end
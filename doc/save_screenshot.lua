@@ -11,6 +11,13 @@
 -- The format setting is by default FORMAT_PNG but can also be
 -- FORMAT_PNG_FLIP, FORMAT_RAW8, FORMAT_RAW24 or FORMAT_RAW32 though
 -- the RAW formats are primarily for advanced use and debugging purposes.
+-- FORMAT_PNG_FAST produces a larger PNG at a fraction of the encoding
+-- time, FORMAT_QOI encodes using the 'Quite OK Image' format which is
+-- faster still, and FORMAT_RAW writes the readback buffer as is, in the
+-- native pixel format of the engine and in the row order of the readback.
+-- The readback itself happens immediately, the encoding and writing is
+-- done on a separate thread so the file may not be complete when the
+-- function returns.
 -- @note: For specific contexts, primarly calctargets, the contents of
 -- the non-local storage is not accessible on all graphic subsystems
 -- for all *srcids* as the calctarget may occupy or bind the same slot.
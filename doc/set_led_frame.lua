@@ -0,0 +1,30 @@
+-- set_led_frame
+-- @short: Set the R,G,B values for a range of LEDs on a controller in one call.
+-- @inargs: ctrlid, data, *offset*
+-- @outargs: int
+-- @group: iodev
+-- @cfunction: led_frame
+-- @related: set_led_rgb, controller_leds
+-- @longdescr: Update consecutive LEDs on an rgb capable controller, starting
+-- at LED index *offset* (default 0). *data* is either a table of numbers
+-- in the form {r1, g1, b1, r2, g2, b2, ...} or a string of packed r,g,b bytes.
+-- Returns the number of LEDs that were set, which is clamped to the number
+-- of LEDs the controller has, or -1 if *ctrlid* does not exist or lacks
+-- the r,g,b capability.
+-- @note: Like with ref:set_led_rgb, the values are queued and sent to the
+-- device as part of the next frame. Only the LEDs that actually changed
+-- are included in the update.
+-- @note: the LED set of functions can be disabled at buildtime,
+-- if this symbol is set to nil, then the engine has been compiled
+-- without support for LEDs.
+function main()
+#ifdef MAIN
+	local frame = {};
+	for i=1,16 do
+		table.insert(frame, i * 16 - 1);
+		table.insert(frame, 0);
+		table.insert(frame, 255 - i * 16);
+	end
+	set_led_frame(0, frame);
+#endif
+end
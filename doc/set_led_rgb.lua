@@ -4,12 +4,15 @@
 -- @outargs: bool
 -- @group: iodev
 -- @cfunction: led_rgb
+-- @related: set_led_frame, led_intensity, controller_leds
 -- @longdescr: Set the color value of an individual LED on a known LED controller and
 -- returns -1 if the *controlid* does not exist, if *ledid* is not a valid index,
 -- if the *controlid* backed device lacks the r,g,b capability. A negative *ledid*
 -- will result in the value being set for all LEDs associated with the device.
--- A return of 0 means that the update failed as it would block the device. This
--- can happen if many LED update queries are being pushed to a slow device.
--- If the optional boolean *buffer* is set, the request may be queued and the queue
--- will not dispatch until a non-buffered update is called.
+-- Updates are queued and sent to the device as one bulk write per frame, or
+-- at the rate set through the 'led_rate' config key (Hz). The return value is
+-- 1 when the update has been queued. If a device is too slow to keep up, the
+-- changes accumulate and are retried on the next frame.
+-- If the optional boolean *buffer* is set, the queue will not dispatch until a
+-- non-buffered update is called.
 
@@ -0,0 +1,24 @@
+-- system_gcbudget
+-- @short: Set the time budget for garbage collection between frames.
+-- @inargs: int:budget_us
+-- @inargs: int:budget_us, int:step_kb
+-- @longdescr: When the engine is idle waiting for the next frame deadline,
+-- it runs incremental garbage collection steps of *step_kb* (default, 4)
+-- for at most *budget_us* (default, 1000) microseconds per frame, or until
+-- a collection cycle has been completed. This spreads out collection work
+-- that would otherwise happen in the middle of event handlers or rendering.
+-- Setting *budget_us* to 0 disables idle collection. The automatic collector
+-- is not affected and still runs as normal.
+-- @note: The time spent is tracked in the gccosttbl from ref:benchmark_data.
+-- @group: system
+-- @cfunction: gcbudget
+-- @related: benchmark_data
+function main()
+#ifdef MAIN
+	system_gcbudget(2000, 8);
+#endif
+
+#ifdef ERROR1
+	system_gcbudget(-1);
+#endif
+end
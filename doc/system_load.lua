@@ -25,6 +25,10 @@
 -- barrier alltogether, it should be used sparringly and only with verified
 -- and trusted code.
 --
+-- @note: With the lua_bytecode_cache config option set, the compiled form of
+-- .lua files is kept in .luacache in the appl-temp namespace and used instead
+-- of parsing the source as long as the source file is unchanged.
+--
 -- @note: The namespace mapping can be changed compile- time by setting
 -- CAREFUL_USERMASK and MODULE_USERMASK for the arcan_lua.c source file.
 -- @group: system
@@ -45,6 +45,9 @@
 -- @note: The connection point is consumed (closed, unlinked) when the
 -- first verified connection goes through. To re-use the connection point,
 -- invoke target_alloc again with the same key from within the callback handler.
+-- With connpoint=n in the frameserver_pool config key, the n most recently
+-- used keys keep a segment prepared ahead of time so that such a re-use does
+-- not have to allocate and map a new one.
 -- @note: for honoring explicit requests from a frameserver regarding new
 -- subsegments, use the accept_target function.
 -- @note: When a 'connected' event has been received, many applications
@@ -14,7 +14,9 @@
 -- as part of ref:map_video_display calls. The valid values now are
 -- DEVICE_INDIRECT for composed rendering, and DEVICE_LOST to indicate
 -- that the currently used GPU should be dropped and, if possible, revert
--- to software- defined graphics.
+-- to software- defined graphics. Along with a card handle, the client is also
+-- sent the format and modifier pairs the display planes can scan out, so that
+-- buffers it allocates itself can be mapped directly on a display.
 -- The other uses are with a string target. This is used to indicate a
 -- connection point to another arcan-shmif capable server. The default is
 -- to mark this as a hint, 'in the event of the main connection being lost,
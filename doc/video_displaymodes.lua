@@ -28,8 +28,11 @@
 -- This can be further hinted by providing a *modeopts* table.
 --
 -- The valid keys for this table are:
--- *modeopts:number:vrr* for setting the refresh rate target (Hz) or a <= 0 value
--- for letting the platform dynamically decide.
+-- *modeopts:number:vrr* for setting the refresh rate target (Hz) or a < 0 value
+-- for letting the platform dynamically decide within the panel range. Any
+-- non-zero value enables adaptive synch on displays that support it, 0 (or
+-- leaving the key out) disables it. With adaptive synch active, the display is
+-- refreshed as the frameserver with synchronization focus delivers new frames.
 -- *modeopts:int:quality* for setting the mode scanout quality. This overrides
 -- the behaviour for WORLDID and directly composited output only. If another
 -- rendertarget has been set as the direct output through ref:map_video_display
@@ -0,0 +1,35 @@
+-- video_residency
+-- @short: Query or set the vstore budget and return per-context store accounting.
+-- @inargs:
+-- @inargs: number:budget_mb
+-- @outargs: tbl
+-- @longdescr: Every backing store that has been uploaded to the GPU is
+-- accounted for, along with the frame it was last drawn. When *budget_mb*
+-- is set to a value larger than 0, image backed stores
+-- (load_image, load_image_asynch) that are not shared, not part of a
+-- frameset and have not been drawn during the last few frames can get their
+-- GPU copy dropped, least recently drawn first, until the resident stores of
+-- the active context fit within the budget. Such stores are uploaded again
+-- from the local copy, or reloaded from the source, the next time they are
+-- drawn. A budget of 0 disables eviction. The initial budget can be set
+-- through the vstore_budget=mb platform argument.
+-- The returned *tbl* has the fields budget (bytes), evictions and restores
+-- (counters since start), and an array part with one entry per context in
+-- the context stack, starting with the current one. Each entry has the
+-- fields objects, gpu, cpu, resident and evicted, where gpu and cpu are
+-- bytes of store allocations and resident and evicted are the parts of gpu
+-- that are, or are not, currently held by the GPU.
+-- @note: Downscaling is not performed, a store is either resident or not.
+-- @group: vidsys
+-- @cfunction: videoresidency
+-- @related: current_context_usage
+-- @flags:
+function main()
+#ifdef MAIN
+	local a = load_image("test.png");
+	local res = video_residency(64);
+	for i,v in ipairs(res) do
+		print(i, v.objects, v.resident, v.evicted);
+	end
+#endif
+end
@@ -13,9 +13,11 @@
 
 #include <inttypes.h>
 #include <string.h>
+#include <stddef.h>
 #include <math.h>
 #include <assert.h>
 #include <ctype.h>
+#include <time.h>
 
 #include "a12.h"
 #include "a12_int.h"
@@ -33,6 +35,8 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "external/zstd/zstd.h"
 
@@ -47,6 +51,7 @@ static int header_sizes[] = {
 	1 + 4 + 2, /* AUDIO partial: ch, stream, len */
 	1 + 4 + 2, /* BINARY partial: ch, stream, len */
 	MAC_BLOCK_SZ + 8 + 1, /* First packet server side */
+	1 + 2, /* compact EVENT partial: ch, len */
 	0
 };
 
@@ -59,7 +64,10 @@ size_t a12int_header_size(int kind)
 }
 
 static void unlink_node(struct a12_state*, struct blob_out*);
+static void bframe_drop(struct a12_state*, uint8_t, struct binary_frame*);
 static void dirstate_item(struct a12_state* S, struct appl_meta* C);
+static struct a12_pool* pool_create(void);
+static void pool_destroy(struct a12_pool* P);
 
 static uint8_t* grow_array(uint8_t* dst, size_t* cur_sz, size_t new_sz, int ind)
 {
@@ -205,6 +213,47 @@ void a12int_set_directory(struct a12_state* S, struct appl_meta* M)
 	S->directory = M;
 }
 
+/* merge a partial directory into the current one, entries are replaced or
+ * appended by identifier and only those are forwarded as dirstate items */
+void a12int_update_directory(struct a12_state* S, struct appl_meta* M)
+{
+	bool notify = S->directory != NULL;
+	bool updated = false;
+
+	while (M){
+		struct appl_meta* next = M->next;
+		struct appl_meta* C = find_entry(S, M);
+
+		if (notify){
+			dirstate_item(S, M);
+			updated = true;
+		}
+
+		if (C){
+			free(C->buf);
+			M->next = C->next;
+			*C = *M;
+			DYNAMIC_FREE(M);
+		}
+		else {
+			struct appl_meta** tail = &S->directory;
+			while (*tail)
+				tail = &(*tail)->next;
+			M->next = NULL;
+			*tail = M;
+		}
+
+		M = next;
+	}
+
+	if (updated){
+		uint8_t outb[CONTROL_PACKET_SIZE] = {0};
+		build_control_header(S, outb, COMMAND_DIRSTATE);
+		a12int_append_out(S,
+			STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+	}
+}
+
 static void fail_state(struct a12_state* S)
 {
 #ifndef _DEBUG
@@ -214,8 +263,8 @@ static void fail_state(struct a12_state* S)
 	S->state = STATE_BROKEN;
 }
 
-static void send_hello_packet(struct a12_state* S,
-	int mode, uint8_t pubk[static 32], uint8_t entropy[static 8])
+static void send_hello_packet(struct a12_state* S, int mode,
+	uint8_t pubk[static 32], uint8_t entropy[static 8], const uint8_t* ticket)
 {
 /* construct the reply with the proper public key */
 	uint8_t outb[CONTROL_PACKET_SIZE] = {0};
@@ -251,23 +300,52 @@ static void send_hello_packet(struct a12_state* S,
  * a new ciphersuite will need to be added */
 	outb[20] = mode;
 
+/* optional decoders we have, the other end only uses what is set here */
+	outb[71] = A12_FEATURE_TILES | A12_FEATURE_TILE_HASH | A12_FEATURE_BSTREAM |
+		A12_FEATURE_ZBANDS | (S->opts->datagram ? A12_FEATURE_DGRAM : 0);
+#ifdef WANT_OPUS
+	outb[71] |= A12_FEATURE_OPUS;
+#endif
+
+/* clients can always hold on to a ticket, servers need a key to make them */
+	uint8_t empty[32] = {0};
+	if (!S->server || memcmp(S->opts->ticket_key, empty, 32) != 0)
+		outb[71] |= A12_FEATURE_RESUME;
+
+	if (ticket)
+		memcpy(&outb[72], ticket, A12_TICKET_SIZE);
+
 /* send it back to client */
 	a12int_append_out(S,
 		STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
 }
 
+/*
+ * Encrypt [sz] bytes from [src] into [dst] and add the ciphertext to the MAC,
+ * in batches small enough that the hash pass reads what the cipher just wrote
+ * from cache rather than taking a second trip through memory.
+ */
+#define CRYPTO_BATCH_SZ 16384
+static void crypt_copy_mac(struct chacha_ctx* ctx,
+	blake3_hasher* mac, uint8_t* dst, const uint8_t* src, size_t sz)
+{
+	for (size_t ofs = 0; ofs < sz; ofs += CRYPTO_BATCH_SZ){
+		size_t nb = sz - ofs > CRYPTO_BATCH_SZ ? CRYPTO_BATCH_SZ : sz - ofs;
+		chacha_apply_copy(ctx, &dst[ofs], &src[ofs], nb);
+		blake3_hasher_update(mac, &dst[ofs], nb);
+	}
+}
+
 /*
  * Used when a full byte buffer for a packet has been prepared, important
  * since it will also encrypt, generate MAC and add to buffer prestate.
  *
- * This is where more advanced and fair queueing should be made in order
- * to not have the bandwidth hungry channels (i.e. video) consume everything.
- * The rough idea is to have bins for a/v/b streams, with a priority on a/v
- * unless it is getting too 'old'. There are some complications:
- *
- * 1. stream cancellation, can only be done on non-delta/non-compressed
- *    so mostly usable for binary then
- * 2. control packets that are tied to an a/v/b frame
+ * The bandwidth hungry channels are kept from consuming everything by the
+ * outq: while an audio or video frame is being encoded its packets (control
+ * header included) go unencrypted into a queue per class and are moved out on
+ * flush, after input and control and a bounded amount at a time. Encryption
+ * has to follow wire order so it happens on the move. Binary streams already
+ * go last as they are only pulled in on flush with an empty buffer.
  *
  * Another issue is that the raw vframes are big and ugly, and here is the
  * place where we perform an unavoidable copy unless we want interleaving (and
@@ -277,17 +355,9 @@ static void send_hello_packet(struct a12_state* S,
  * counter as part of the message, replay attacks won't work BUT any
  * reordering would then still need to account for rekeying.
  */
-void a12int_append_out(struct a12_state* S, uint8_t type,
-	const uint8_t* const out, size_t out_sz, uint8_t* prepend, size_t prepend_sz)
+static void append_crypt(struct a12_state* S, uint8_t type,
+	const uint8_t* const out, size_t out_sz, const uint8_t* prepend, size_t prepend_sz)
 {
-	if (S->state == STATE_BROKEN)
-		return;
-
-/*
- * QUEUE-slot here,
- * should also have the ability to probe the size of the queue slots
- * so that encoders can react on backpressure
- */
 	a12int_trace(A12_TRACE_CRYPTO,
 		"type=%d:size=%zu:prepend_size=%zu:ofs=%zu", type, out_sz, prepend_sz, S->buf_ofs);
 
@@ -316,29 +386,6 @@ void a12int_append_out(struct a12_state* S, uint8_t type,
 	S->buf_ofs += MAC_BLOCK_SZ;
 	size_t data_pos = S->buf_ofs;
 
-/* MISSING OPTIMIZATION, extract n bytes of the cipherstream and apply copy
- * operation rather than in-place modification, align with MAC block size and
- * continuously update as we fetch as well */
-
-/* 8 byte sequence number */
-	pack_u64(S->current_seqnr++, &dst[S->buf_ofs]);
-	S->buf_ofs += 8;
-
-/* 1 byte command data */
-	dst[S->buf_ofs++] = type;
-
-/* any possible prepend-to-data block */
-	if (prepend_sz){
-		memcpy(&dst[S->buf_ofs], prepend, prepend_sz);
-		S->buf_ofs += prepend_sz;
-	}
-
-/* and our data block */
-	memcpy(&dst[S->buf_ofs], out, out_sz);
-	S->buf_ofs += out_sz;
-
-	size_t used = S->buf_ofs - data_pos;
-
 /*
  * If we are the client and haven't sent the first authentication request
  * yet, setup the nonce part of the cipher to random and shorten the MAC.
@@ -362,11 +409,27 @@ void a12int_append_out(struct a12_state* S, uint8_t type,
 		blake3_hasher_update(&S->out_mac, &dst[mac_sz], mac_sz);
 	}
 
-/* apply stream-cipher to buffer contents - ETM */
-	chacha_apply(S->enc_state, &dst[data_pos], used);
+/* 8 byte sequence number */
+	pack_u64(S->current_seqnr++, &dst[S->buf_ofs]);
+	S->buf_ofs += 8;
+
+/* 1 byte command data */
+	dst[S->buf_ofs++] = type;
+
+/* any possible prepend-to-data block */
+	if (prepend_sz){
+		memcpy(&dst[S->buf_ofs], prepend, prepend_sz);
+		S->buf_ofs += prepend_sz;
+	}
+
+/* apply stream-cipher to buffer contents - ETM, header and prepend in place */
+	chacha_apply(S->enc_state, &dst[data_pos], S->buf_ofs - data_pos);
+	blake3_hasher_update(&S->out_mac, &dst[data_pos], S->buf_ofs - data_pos);
 
-/* update MAC with encrypted contents */
-	blake3_hasher_update(&S->out_mac, &dst[data_pos], used);
+/* and our data block is encrypted while being copied, with the MAC updated
+ * per batch while the ciphertext is still in cache */
+	crypt_copy_mac(S->enc_state, &S->out_mac, &dst[S->buf_ofs], out, out_sz);
+	S->buf_ofs += out_sz;
 
 /* sample MAC and write to buffer pos, remember it for debugging - no need to
  * chain separately as 'finalize' is not really finalized */
@@ -387,6 +450,491 @@ void a12int_append_out(struct a12_state* S, uint8_t type,
 	}
 }
 
+#define OUTQ_UNIT_END 0xff
+#define OUTQ_REC_HDR 5
+
+/*
+ * Datagram transport (see a12_datagram_ in a12.h and HACKING.md), once
+ * enabled outq_commit cuts a/v units into datagrams instead of putting them
+ * in the output buffer. A unit is the records (type, length, data) between
+ * two unit ends and the receiving end replays them through the same
+ * process_ functions as the stream. Each datagram:
+ *
+ *  [0..15]  MAC, keyed blake3 over [16..]
+ *  [16..23] sequence number, also the nonce for the cipher
+ *  [24]     class (probe, audio, video)
+ *  [25]     refresh generation
+ *  [26..29] unit number (per class)
+ *  [30..33] unit size
+ *  [34..37] offset into the unit
+ *  [38..]   unit data
+ *
+ * [24..] is encrypted, with the key and MAC key being different per
+ * direction.
+ *
+ * The first video unit after a refresh is the one that everything after it
+ * builds on, so it goes over the stream followed by a DGRAM_OP_SYNCED with
+ * the unit number the datagrams continue from.
+ */
+#define DGRAM_HDR (MAC_BLOCK_SZ + 8)
+#define DGRAM_INNER 14
+#define DGRAM_MTU_MIN 256
+#define DGRAM_MTU_MAX 65507
+#define DGRAM_OUT_CAP (4 * 1024 * 1024)
+#define DGRAM_UNIT_CAP (64 * 1024 * 1024)
+#define DGRAM_SLOTS 16
+#define DGRAM_LOSS_MS 250
+
+enum {
+	DGRAM_PROBE = 0,
+	DGRAM_AUDIO = 1,
+	DGRAM_VIDEO = 2
+};
+
+/* COMMAND_DATAGRAM [18] */
+enum {
+	DGRAM_OP_PORT = 1,    /* [19..20] port the sender receives datagrams on */
+	DGRAM_OP_SWITCH = 2,  /* no more a/v on the stream after this           */
+	DGRAM_OP_REFRESH = 3, /* [19] generation, reset and send a sync unit    */
+	DGRAM_OP_SYNCED = 4   /* [19] generation, [20..23] next video unit      */
+};
+
+struct dgram_slot {
+	bool used;
+	uint8_t cls;
+	uint8_t gen;
+	uint32_t unit;
+	uint32_t size;
+	uint32_t got;
+	uint64_t ts;
+	uint8_t* buf;
+};
+
+struct a12_dgram {
+	uint8_t mac_out[BLAKE3_KEY_LEN], mac_in[BLAKE3_KEY_LEN];
+	uint8_t key_out[BLAKE3_KEY_LEN], key_in[BLAKE3_KEY_LEN];
+	struct chacha_ctx cipher;
+	uint16_t port;
+	bool replay;
+
+/* sending side, hold is set from enabling until the first refresh request as
+ * a/v already on the stream has to arrive before the other end can start */
+	bool enabled;
+	bool hold;
+	bool sync;
+	uint8_t gen;
+	size_t mtu;
+	uint64_t seq;
+	uint32_t unit[DGRAM_VIDEO + 1];
+
+/* datagrams waiting to be flushed as [u16 size][datagram] */
+	uint8_t* out;
+	size_t out_sz, out_used, out_ofs;
+	size_t queued;
+
+/* receiving side, replay window for the sequence numbers, next unit by class
+ * and the generation of the last refresh, video waits for its sync unit */
+	uint64_t rx_top;
+	uint64_t rx_mask;
+	uint32_t rx_next[DGRAM_VIDEO + 1];
+	bool rx_started[DGRAM_VIDEO + 1];
+	bool rx_switched;
+	bool rx_wait;
+	uint8_t rx_gen;
+	struct dgram_slot slots[DGRAM_SLOTS];
+	uint8_t pkt[DGRAM_MTU_MAX];
+};
+
+static void dgram_setup(struct a12_state* S, uint8_t nonce[static NONCE_SIZE]);
+static void dgram_commit(struct a12_state* S);
+static void dgram_free(struct a12_state* S);
+static void command_datagram(struct a12_state* S, void* tag, void (*on_event)
+	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*));
+
+/*
+ * venc: with an encode worker (a12_set_venc_worker) a12_channel_vframe only
+ * copies the buffer into a job and queues it. The worker runs the same
+ * encoders as the synchronous path but with venc_job set, so that what they
+ * append and step goes into the job. Whoever services the state then moves
+ * finished jobs into the video outq (venc_collect). Anything the encoders
+ * would read from the state is sampled into the job on submission.
+ */
+#define VENC_STEP 0xfe
+
+struct venc_job {
+	struct shmifsrv_vbuffer vb;
+	size_t vb_sz;
+	struct a12_vframe_opts opts;
+	struct arcan_shmif_region regions[ARCAN_SHMIF_DIRTY_LIM];
+	size_t n_regions;
+	size_t chunk_sz;
+	uint8_t chid;
+	uint32_t sid;
+	uint64_t seqnr;
+	uint64_t pts;
+	int pressure;
+	bool reset_delta;
+	bool defer_commit;
+	bool failed;
+	size_t ms, n_px;
+	struct a12_outq out;
+	struct venc_job* next;
+};
+
+struct a12_venc {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct venc_job* queue;
+	struct venc_job* done;
+	struct venc_job* spare;
+	size_t in_flight;
+	bool active;
+	bool shutdown;
+	void (*ready)(struct a12_state*, void*);
+	void* tag;
+};
+
+static _Thread_local struct venc_job* venc_job;
+
+static void venc_collect(struct a12_state* S);
+static void venc_sync(struct a12_state* S);
+static void venc_stop(struct a12_state* S);
+static void track_vstream(struct a12_state* S, uint32_t id);
+
+static bool outq_push(struct a12_outq* Q, int ind, uint8_t type,
+	const uint8_t* out, size_t out_sz, const uint8_t* prepend, size_t prepend_sz)
+{
+	size_t len = out_sz + prepend_sz;
+
+/* slide consumed records out before growing */
+	if (Q->ofs && Q->used + OUTQ_REC_HDR + len >= Q->sz){
+		memmove(Q->buf, &Q->buf[Q->ofs], Q->used - Q->ofs);
+		Q->used -= Q->ofs;
+		Q->unit_start -= Q->ofs;
+		Q->ofs = 0;
+	}
+
+	size_t required = Q->used + OUTQ_REC_HDR + len;
+	Q->buf = grow_array(Q->buf, &Q->sz, required, ind);
+	if (!Q->buf){
+		*Q = (struct a12_outq){};
+		return false;
+	}
+
+	uint8_t* dst = &Q->buf[Q->used];
+	dst[0] = type;
+	pack_u32(len, &dst[1]);
+	if (prepend_sz)
+		memcpy(&dst[OUTQ_REC_HDR], prepend, prepend_sz);
+	if (out_sz)
+		memcpy(&dst[OUTQ_REC_HDR + prepend_sz], out, out_sz);
+	Q->used = required;
+	return true;
+}
+
+/* reset a queue that has been emptied, and release what a burst grew it to
+ * as long as no unit is being built in it */
+static void outq_drained(struct a12_state* S, size_t i)
+{
+	struct a12_outq* Q = &S->outq[i];
+	if (Q->ofs != Q->used)
+		return;
+
+	Q->ofs = Q->used = Q->unit_start = 0;
+
+	if (Q->sz > A12_OUTBUF_TRIM && S->outq_class != i){
+		a12int_trace(A12_TRACE_ALLOC, "trim=queue:%zu:from=%zu", i, Q->sz);
+		DYNAMIC_FREE(Q->buf);
+		Q->buf = NULL;
+		Q->sz = 0;
+	}
+}
+
+static void outq_open(struct a12_state* S, int cls)
+{
+	if (S->opts->sink)
+		return;
+
+	S->outq_class = cls;
+	S->outq[cls].unit_start = S->outq[cls].used;
+}
+
+static void outq_close(struct a12_state* S)
+{
+	if (S->outq_class == OUTQ_NONE)
+		return;
+
+	struct a12_outq* Q = &S->outq[S->outq_class];
+	S->outq_class = OUTQ_NONE;
+
+	if (Q->used != Q->unit_start && S->state != STATE_BROKEN){
+		if (!outq_push(Q, 2 + (Q - S->outq), OUTQ_UNIT_END, NULL, 0, NULL, 0)){
+			fail_state(S);
+			return;
+		}
+		Q->units++;
+	}
+}
+
+/*
+ * Encrypt complete units into the output buffer until it holds [cap] bytes,
+ * audio before video. At least one unit is moved so that the queue always
+ * drains, the rest stays for the next flush - letting any input or control
+ * that arrives in the meanwhile go ahead of it.
+ */
+static void outq_commit(struct a12_state* S, size_t cap)
+{
+	bool first = true;
+
+	if (S->dgram && S->dgram->enabled){
+		dgram_commit(S);
+		return;
+	}
+
+	for (size_t i = OUTQ_AUDIO; i < OUTQ_COUNT; i++){
+		struct a12_outq* Q = &S->outq[i];
+
+		while (Q->units && (first || S->buf_ofs < cap)){
+			first = false;
+			for(;;){
+				uint8_t type = Q->buf[Q->ofs];
+				uint32_t len;
+				unpack_u32(&len, &Q->buf[Q->ofs + 1]);
+				size_t data = Q->ofs + OUTQ_REC_HDR;
+				Q->ofs = data + len;
+
+				if (type == OUTQ_UNIT_END){
+					Q->units--;
+					break;
+				}
+
+				append_crypt(S, type, &Q->buf[data], len, NULL, 0);
+				if (S->state == STATE_BROKEN)
+					return;
+			}
+		}
+
+		outq_drained(S, i);
+	}
+}
+
+static size_t outq_bytes(struct a12_state* S)
+{
+	size_t sum = 0;
+	for (size_t i = OUTQ_AUDIO; i < OUTQ_COUNT; i++)
+		sum += S->outq[i].used - S->outq[i].ofs;
+	if (S->dgram)
+		sum += S->dgram->queued;
+	return sum;
+}
+
+/*
+ * The link model works on the vframe acks the sink sends (COMMAND_PING with
+ * the stream id) once a frame has been received in full. Each outgoing frame
+ * records where in the byte stream it starts and ends and when it was handed
+ * to the transport. An ack means the bytes up to there have arrived: the
+ * difference to the previous ack over the time in between is a delivery rate
+ * sample and the time since the frame went out is a round trip sample.
+ */
+static void link_track(struct a12_state* S, uint32_t id)
+{
+	uint64_t pos = S->link.flushed + S->buf_ofs + outq_bytes(S);
+
+	if (S->link.last_id &&
+		S->link.track[S->link.last_id % LINK_TRACK].id == S->link.last_id)
+		S->link.track[S->link.last_id % LINK_TRACK].end = pos;
+
+	S->link.track[id % LINK_TRACK] = (typeof(S->link.track[0])){
+		.id = id,
+		.pos = pos
+	};
+	S->link.last_id = id;
+}
+
+static void link_sent(struct a12_state* S, size_t n)
+{
+	S->link.flushed += n;
+	uint64_t now = arcan_timemillis();
+
+	for (size_t i = 0; i < LINK_TRACK; i++){
+		if (S->link.track[i].id && !S->link.track[i].ts &&
+			S->link.track[i].pos < S->link.flushed)
+			S->link.track[i].ts = now;
+	}
+}
+
+static void link_ack(struct a12_state* S, uint32_t id)
+{
+	if (!id || S->link.track[id % LINK_TRACK].id != id)
+		return;
+
+	uint64_t sent = S->link.track[id % LINK_TRACK].ts;
+	uint64_t pos = S->link.track[id % LINK_TRACK].end;
+	S->link.track[id % LINK_TRACK].id = 0;
+	if (!sent)
+		return;
+
+/* the end isn't known until the next frame, nothing else is in flight then */
+	if (!pos)
+		pos = S->link.flushed;
+	if (pos > S->link.delivered)
+		S->link.delivered = pos;
+
+	uint64_t now = arcan_timemillis();
+	size_t rtt = now > sent ? now - sent : 1;
+
+	if (!S->link.rtt_min || rtt <= S->link.rtt_min ||
+		now - S->link.rtt_min_ts > LINK_RTT_WINDOW_MS){
+		S->link.rtt_min = rtt;
+		S->link.rtt_min_ts = now;
+	}
+	S->link.rtt = S->link.rtt ? (S->link.rtt * 7 + rtt) / 8 : rtt;
+	S->stats.roundtrip_latency = S->link.rtt;
+
+	if (!S->link.ack_ts || pos < S->link.ack_pos){
+		S->link.ack_ts = now;
+		S->link.ack_pos = pos;
+		return;
+	}
+
+/* acks come in bursts, so sample over at least half a round trip */
+	if (now - S->link.ack_ts < LINK_SAMPLE_MS ||
+		now - S->link.ack_ts < S->link.rtt_min / 2)
+		return;
+
+/* if the frame went out after the last ack the link idled in between, such a
+ * sample is limited by what we had to send and can only raise the estimate */
+	bool app_limited = sent > S->link.ack_ts;
+	size_t rate = (pos - S->link.ack_pos) * 1000 / (now - S->link.ack_ts);
+	S->link.ack_ts = now;
+	S->link.ack_pos = pos;
+
+	if (app_limited && rate <= S->link.bw)
+		return;
+
+	size_t step = (now - S->link.bw_ts) / LINK_BW_SLOT_MS;
+	for (size_t j = 0; j < step && j < LINK_BW_SLOTS; j++){
+		S->link.bw_ind = (S->link.bw_ind + 1) % LINK_BW_SLOTS;
+		S->link.bw_slot[S->link.bw_ind] = 0;
+	}
+	if (step)
+		S->link.bw_ts = now;
+
+	if (rate > S->link.bw_slot[S->link.bw_ind])
+		S->link.bw_slot[S->link.bw_ind] = rate;
+
+	S->link.bw = 0;
+	for (size_t j = 0; j < LINK_BW_SLOTS; j++)
+		if (S->link.bw_slot[j] > S->link.bw)
+			S->link.bw = S->link.bw_slot[j];
+
+	a12int_trace(A12_TRACE_VDETAIL,
+		"kind=link:rtt=%zu:rtt_min=%zu:rate=%zu:bw=%zu",
+		S->link.rtt, S->link.rtt_min, rate, S->link.bw);
+}
+
+static size_t link_inflight(struct a12_state* S)
+{
+	return S->link.flushed > S->link.delivered ?
+		S->link.flushed - S->link.delivered : 0;
+}
+
+static size_t link_cwnd(struct a12_state* S)
+{
+	if (!S->link.bw)
+		return 0;
+
+	size_t cwnd = LINK_CWND_GAIN * S->link.bw * S->link.rtt_min / 1000;
+	return cwnd > LINK_CWND_MIN ? cwnd : LINK_CWND_MIN;
+}
+
+static int link_pressure(struct a12_state* S)
+{
+	size_t cwnd = link_cwnd(S);
+	if (!cwnd)
+		return OUTQ_PRESSURE_NONE;
+
+	size_t inflight = link_inflight(S);
+	bool stalled = arcan_timemillis() - S->link.ack_ts > LINK_STALL_MS;
+
+	if (inflight >= cwnd && !stalled)
+		return OUTQ_PRESSURE_HARD;
+
+	if (inflight >= cwnd / LINK_CWND_GAIN || stalled ||
+		S->link.rtt > 2 * S->link.rtt_min + LINK_DELAY_SLACK_MS)
+		return OUTQ_PRESSURE_SOFT;
+
+	return OUTQ_PRESSURE_NONE;
+}
+
+/* the drain rate only says how fast the transport takes data, buffering
+ * further down can make that much more than the link delivers */
+static size_t out_rate(struct a12_state* S)
+{
+	if (S->link.bw && (!S->drain.rate || S->link.bw < S->drain.rate))
+		return S->link.bw;
+	return S->drain.rate;
+}
+
+void a12int_append_out(struct a12_state* S, uint8_t type,
+	const uint8_t* const out, size_t out_sz, uint8_t* prepend, size_t prepend_sz)
+{
+/* on the encode worker, the state belongs to someone else */
+	if (venc_job){
+		if (!venc_job->failed &&
+			!outq_push(&venc_job->out, 2 + OUTQ_COUNT,
+				type, out, out_sz, prepend, prepend_sz))
+			venc_job->failed = true;
+		return;
+	}
+
+	if (S->state == STATE_BROKEN)
+		return;
+
+/* with a sink everything goes out immediately so there is nothing to queue */
+	if (!S->opts->sink){
+		if (S->outq_class != OUTQ_NONE){
+			struct a12_outq* Q = &S->outq[S->outq_class];
+			if (!outq_push(Q, 2 + S->outq_class,
+				type, out, out_sz, prepend, prepend_sz))
+				fail_state(S);
+			return;
+		}
+
+/* input and keepalives may pass queued a/v, other control can refer to it
+ * (stream cancel, channel and key changes) so commit the queues first */
+		bool pass = type == STATE_EVENT_PACKET || type == STATE_EVENTC_PACKET ||
+			(type == STATE_CONTROL_PACKET &&
+			out_sz > 17 && out[17] == COMMAND_PING);
+
+		if (!pass)
+			outq_commit(S, SIZE_MAX);
+	}
+
+	append_crypt(S, type, out, out_sz, prepend, prepend_sz);
+}
+
+int a12int_out_pressure(struct a12_state* S)
+{
+	if (venc_job)
+		return venc_job->pressure;
+
+	size_t queued = outq_bytes(S) + S->buf_ofs;
+	size_t rate = out_rate(S);
+	size_t drain_ms = rate ? queued * 1000 / rate : 0;
+
+	if (queued >= OUTQ_CAP || drain_ms >= OUTQ_DRAIN_HARD_MS)
+		return OUTQ_PRESSURE_HARD;
+
+	int link = link_pressure(S);
+
+	if (queued >= OUTQ_CAP / 2 || drain_ms >= OUTQ_DRAIN_SOFT_MS)
+		return link > OUTQ_PRESSURE_SOFT ? link : OUTQ_PRESSURE_SOFT;
+
+	return link;
+}
+
 static void reset_state(struct a12_state* S)
 {
 	S->left = header_sizes[STATE_NOPACKET];
@@ -447,11 +995,13 @@ static void update_keymaterial(
 		}
 	}
 
-	S->enc_state = DYNAMIC_MALLOC(sizeof(struct chacha_ctx));
 	if (!S->enc_state){
-		DYNAMIC_FREE(S->dec_state);
-		fail_state(S);
-		return;
+		S->enc_state = DYNAMIC_MALLOC(sizeof(struct chacha_ctx));
+		if (!S->enc_state){
+			DYNAMIC_FREE(S->dec_state);
+			fail_state(S);
+			return;
+		}
 	}
 
 /* depending on who initates the connection, the cipher key will be different,
@@ -503,6 +1053,8 @@ static struct a12_state* a12_setup(struct a12_context_options* opt, bool srv)
 	res->shutdown_id = -1;
 	for (size_t i = 0; i <= 255; i++){
 		res->channels[i].unpack_state.bframe.tmp_fd = -1;
+		for (size_t j = 0; j < BSTREAM_PARALLEL - 1; j++)
+			res->channels[i].unpack_state.bstreams[j].tmp_fd = -1;
 	}
 
 	size_t len = 0;
@@ -517,7 +1069,9 @@ static struct a12_state* a12_setup(struct a12_context_options* opt, bool srv)
 		sprintf(res->opts->secret, "SETECASTRONOMY");
 	}
 
-	len = strlen(res->opts->secret);
+	len = strnlen(res->opts->secret, 32);
+	if (!srv)
+		memcpy(res->keys.psk, res->opts->secret, len);
 	update_keymaterial(res, res->opts->secret, len, NULL);
 
 /* easy-dump for quick debugging (i.e. cmp side vs side to find offset,
@@ -540,8 +1094,16 @@ static struct a12_state* a12_setup(struct a12_context_options* opt, bool srv)
 
 	res->cookie = 0xfeedface;
 	res->out_stream = 1;
+
+/* band threads only pay off with cores to run them on */
+	long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+	res->venc_threads = n_cpu > 1 ?
+		(n_cpu < ZSTD_VIDEO_WORKERS ? n_cpu : ZSTD_VIDEO_WORKERS) : 0;
 	res->notify_dynamic = true;
 
+/* without a pool buffers simply go back to malloc */
+	res->pool = pool_create();
+
 	return res;
 }
 
@@ -626,45 +1188,130 @@ struct a12_state* a12_client(struct a12_context_options* opt)
 	uint8_t nonce[8];
 	arcan_random(nonce, 8);
 	trace_crypto_key(S->server, "hello-pub", outpk, 32);
-	send_hello_packet(S, mode, outpk, nonce);
+	send_hello_packet(S, mode, outpk, nonce, NULL);
 
 	return S;
 }
 
-void
-a12_channel_shutdown(struct a12_state* S, const char* last_words)
+bool a12_get_ticket(struct a12_state* S, struct a12_ticket* out)
 {
-	if (!S || S->cookie != 0xfeedface){
-		return;
-	}
-
-	uint8_t outb[CONTROL_PACKET_SIZE] = {0};
-	step_sequence(S, outb);
-	outb[16] = S->out_channel;
-	outb[17] = COMMAND_SHUTDOWN;
-	snprintf((char*)(&outb[18]), CONTROL_PACKET_SIZE - 19, "%s", last_words);
+	if (!S || S->cookie != 0xfeedface || S->server || !S->ticket.expires)
+		return false;
 
-	a12int_trace(A12_TRACE_SYSTEM, "channel open, add control packet");
-	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+	*out = S->ticket;
+	return true;
 }
 
-void
-a12_channel_close(struct a12_state* S)
+bool a12_resume(struct a12_state* S, struct a12_ticket* T)
 {
-	if (!S || S->cookie != 0xfeedface){
-		return;
+	if (!S || S->cookie != 0xfeedface || S->server || !T || !T->expires ||
+		(uint64_t) time(NULL) >= T->expires)
+		return false;
+
+	venc_sync(S);
+
+/* anything queued, half-sent or half-read belongs to the old connection */
+	S->buf_ofs = 0;
+	for (size_t i = 0; i < OUTQ_COUNT; i++){
+		struct a12_outq* Q = &S->outq[i];
+		Q->ofs = Q->used = Q->unit_start = Q->units = 0;
 	}
 
-	struct a12_channel* ch = &S->channels[S->out_channel];
+	while (S->pending)
+		unlink_node(S, S->pending);
 
+	if (S->prepend_unpack){
+		DYNAMIC_FREE(S->prepend_unpack);
+		S->prepend_unpack = NULL;
+		S->prepend_unpack_sz = 0;
+	}
+	dgram_free(S);
+
+/* the channels stay, but the other end has no reference frames, tile caches
+ * or streams in progress - same as after a datagram refresh */
+	for (size_t i = 0; i < 256; i++){
+		struct a12_channel* ch = &S->channels[i];
+		a12int_encode_reset_delta(S, i);
+		a12int_encode_drop(S, i, false);
+		a12int_decode_drop(S, i, false);
+		ch->vframe_dropped = true;
+
+		bframe_drop(S, i, &ch->unpack_state.bframe);
+		for (size_t j = 0; j < BSTREAM_PARALLEL - 1; j++)
+			bframe_drop(S, i, &ch->unpack_state.bstreams[j]);
+	}
+
+	memset(&S->congestion_stats, '\0', sizeof(S->congestion_stats));
+	memset(&S->link, '\0', sizeof(S->link));
+
+/* and back to where a12_client starts, keyed from the preshared secret with
+ * the first packet providing the nonce */
+	S->current_seqnr = 0;
+	S->last_seen_seqnr = 0;
+	S->keys.rekey_pos = 0;
+	S->cl_firstout = false;
+	S->auth_latched = false;
+	S->state = STATE_NOPACKET;
+	reset_state(S);
+	update_keymaterial(S, S->keys.psk, strnlen(S->keys.psk, 32), NULL);
+
+	S->ticket = *T;
+	S->resuming = true;
+	S->authentic = AUTH_REAL_HELLO_SENT;
+
+	uint8_t nonce[8];
+	uint8_t empty[32] = {0};
+	arcan_random(nonce, 8);
+	a12int_trace(A12_TRACE_SECURITY, "kind=ticket:status=resume");
+	send_hello_packet(S, HELLO_MODE_TICKET, empty, nonce, T->blob);
+
+	return true;
+}
+
+void
+a12_channel_shutdown(struct a12_state* S, const char* last_words)
+{
+	if (!S || S->cookie != 0xfeedface){
+		return;
+	}
+
+	uint8_t outb[CONTROL_PACKET_SIZE] = {0};
+	step_sequence(S, outb);
+	outb[16] = S->out_channel;
+	outb[17] = COMMAND_SHUTDOWN;
+	snprintf((char*)(&outb[18]), CONTROL_PACKET_SIZE - 19, "%s", last_words);
+
+	a12int_trace(A12_TRACE_SYSTEM, "channel open, add control packet");
+	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+}
+
+void
+a12_channel_close(struct a12_state* S)
+{
+	if (!S || S->cookie != 0xfeedface){
+		return;
+	}
+
+	struct a12_channel* ch = &S->channels[S->out_channel];
+
+	venc_sync(S);
 	a12int_encode_drop(S, S->out_channel, false);
 	a12int_decode_drop(S, S->out_channel, false);
+	a12int_encode_audio_drop(S, S->out_channel);
+	a12int_decode_audio_drop(S, S->out_channel);
 
 	if (ch->unpack_state.bframe.zstd){
 		ZSTD_freeDCtx(ch->unpack_state.bframe.zstd);
 		ch->unpack_state.bframe.zstd = NULL;
 	}
 
+	for (size_t i = 0; i < BSTREAM_PARALLEL - 1; i++){
+		if (ch->unpack_state.bstreams[i].zstd){
+			ZSTD_freeDCtx(ch->unpack_state.bstreams[i].zstd);
+			ch->unpack_state.bstreams[i].zstd = NULL;
+		}
+	}
+
 	if (ch->active){
 		ch->cont = NULL;
 		ch->active = false;
@@ -692,8 +1339,15 @@ a12_free(struct a12_state* S)
 		}
 	}
 
+	venc_stop(S);
+	a12int_vdec_stop(S);
 	a12int_set_directory(S, NULL);
 
+	for (size_t i = 0; i < 256; i++){
+		a12int_encode_audio_drop(S, i);
+		a12int_decode_audio_drop(S, i);
+	}
+
 	if (S->prepend_unpack){
 		DYNAMIC_FREE(S->prepend_unpack);
 		S->prepend_unpack = NULL;
@@ -703,6 +1357,10 @@ a12_free(struct a12_state* S)
 	a12int_trace(A12_TRACE_ALLOC, "a12-state machine freed");
 	DYNAMIC_FREE(S->bufs[0]);
 	DYNAMIC_FREE(S->bufs[1]);
+	for (size_t i = 0; i < OUTQ_COUNT; i++)
+		DYNAMIC_FREE(S->outq[i].buf);
+	dgram_free(S);
+	pool_destroy(S->pool);
 	DYNAMIC_FREE(S->opts);
 
 	*S = (struct a12_state){};
@@ -716,9 +1374,17 @@ static void update_mac_and_decrypt(const char* source,
 	blake3_hasher* hash, struct chacha_ctx* ctx, uint8_t* buf, size_t sz)
 {
 	a12int_trace(A12_TRACE_CRYPTO, "src=%s:mac_update=%zu", source, sz);
-	blake3_hasher_update(hash, buf, sz);
-	if (ctx)
-		chacha_apply(ctx, buf, sz);
+	if (!ctx){
+		blake3_hasher_update(hash, buf, sz);
+		return;
+	}
+
+/* same batching as crypt_copy_mac, but MAC before decrypt */
+	for (size_t ofs = 0; ofs < sz; ofs += CRYPTO_BATCH_SZ){
+		size_t nb = sz - ofs > CRYPTO_BATCH_SZ ? CRYPTO_BATCH_SZ : sz - ofs;
+		blake3_hasher_update(hash, &buf[ofs], nb);
+		chacha_apply(ctx, &buf[ofs], nb);
+	}
 }
 
 /*
@@ -917,13 +1583,176 @@ static void command_cancelstream(
 	}
 }
 
+/* The first stream on a channel always goes into bframe (tunnels and older
+ * peers only know of that one), further ones into the first free bstreams
+ * slot. With no slot free the (active) bframe is returned. */
+static struct binary_frame* bframe_slot(struct a12_state* S, uint8_t channel)
+{
+	struct binary_frame* bframe = &S->channels[channel].unpack_state.bframe;
+	if (!bframe->active)
+		return bframe;
+
+	for (size_t i = 0; i < BSTREAM_PARALLEL - 1; i++){
+		if (!S->channels[channel].unpack_state.bstreams[i].active)
+			return &S->channels[channel].unpack_state.bstreams[i];
+	}
+
+	return bframe;
+}
+
+/* Map a stream-id to the frame it unpacks into, anything unknown maps to the
+ * bframe so the regular checks for dead or cancelled streams apply. */
+static struct binary_frame* bframe_find(
+	struct a12_state* S, uint8_t channel, int64_t streamid)
+{
+	struct binary_frame* bframe = &S->channels[channel].unpack_state.bframe;
+	if (bframe->streamid == streamid)
+		return bframe;
+
+	for (size_t i = 0; i < BSTREAM_PARALLEL - 1; i++){
+		struct binary_frame* cur = &S->channels[channel].unpack_state.bstreams[i];
+		if (cur->active && cur->streamid == streamid)
+			return cur;
+	}
+
+	return bframe;
+}
+
+/* blake3 of the first [len] bytes of [fd] without touching the file offset */
+static bool hash_prefix(int fd, uint64_t len, uint8_t out[static 16])
+{
+	uint8_t* buf = DYNAMIC_MALLOC(BSTREAM_CHUNK);
+	if (!buf)
+		return false;
+
+	blake3_hasher hash;
+	blake3_hasher_init(&hash);
+	uint64_t pos = 0;
+
+	while (pos < len){
+		size_t ntr = len - pos > BSTREAM_CHUNK ? BSTREAM_CHUNK : len - pos;
+		ssize_t nr = pread(fd, buf, ntr, pos);
+		if (-1 == nr && errno == EINTR)
+			continue;
+
+		if (nr <= 0){
+			DYNAMIC_FREE(buf);
+			return false;
+		}
+
+		blake3_hasher_update(&hash, buf, nr);
+		pos += nr;
+	}
+
+	blake3_hasher_finalize(&hash, out, 16);
+	DYNAMIC_FREE(buf);
+	return true;
+}
+
+static void send_bstreamseek(struct a12_state* S,
+	uint8_t channel, uint32_t streamid, uint64_t ofs, uint8_t* hash, bool confirm)
+{
+	uint8_t outb[CONTROL_PACKET_SIZE];
+	build_control_header(S, outb, COMMAND_BSTREAMSEEK);
+	outb[16] = channel;
+	pack_u32(streamid, &outb[18]);
+	pack_u64(ofs, &outb[22]);
+	if (hash)
+		memcpy(&outb[30], hash, 16);
+	outb[46] = confirm;
+	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+}
+
+/* The receiver of a resumable stream tells where its verified prefix ends,
+ * the part past the last full chunk is always sent again. The sender only
+ * skips if its own data hashes the same and then confirms the offset. */
+static void request_bstreamseek(
+	struct a12_state* S, uint8_t channel, struct binary_frame* bframe)
+{
+	uint8_t hash[16] = {0};
+	uint64_t ofs = 0;
+	struct stat fs;
+
+	if (bframe->resume && bframe->size &&
+		-1 != bframe->tmp_fd && 0 == fstat(bframe->tmp_fd, &fs)){
+		ofs = (uint64_t) fs.st_size < bframe->size ? fs.st_size : bframe->size - 1;
+		ofs -= ofs % BSTREAM_CHUNK;
+		if (ofs && !hash_prefix(bframe->tmp_fd, ofs, hash))
+			ofs = 0;
+	}
+
+	a12int_trace(A12_TRACE_BTRANSFER,
+		"kind=seek_request:stream=%"PRId64":ch=%d:ofs=%"PRIu64,
+		bframe->streamid, (int) channel, ofs);
+	send_bstreamseek(S, channel, bframe->streamid, ofs, hash, false);
+}
+
+static void bframe_cancel(
+	struct a12_state* S, uint8_t channel, struct binary_frame* bframe);
+
+static void command_bstreamseek(struct a12_state* S)
+{
+	uint8_t channel = S->decode[16];
+	uint32_t streamid;
+	uint64_t ofs;
+	unpack_u32(&streamid, &S->decode[18]);
+	unpack_u64(&ofs, &S->decode[22]);
+
+/* receiving end, the sender has decided where the data will start */
+	if (S->decode[46] == 1){
+		struct binary_frame* bframe = bframe_find(S, channel, streamid);
+		if (!bframe->active || bframe->streamid != streamid || bframe->tunnel)
+			return;
+
+		if (ofs >= bframe->size){
+			bframe_cancel(S, channel, bframe);
+			return;
+		}
+
+/* a rejected prefix is thrown away along with the rest */
+		if ((ofs || bframe->resume) && -1 != bframe->tmp_fd &&
+			(-1 == lseek(bframe->tmp_fd, ofs, SEEK_SET) ||
+			-1 == ftruncate(bframe->tmp_fd, ofs))){
+			bframe_cancel(S, channel, bframe);
+			return;
+		}
+
+		bframe->size -= ofs;
+		a12int_trace(A12_TRACE_BTRANSFER,
+			"kind=resumed:stream=%"PRIu32":ch=%d:ofs=%"PRIu64":left=%"PRIu64,
+			streamid, (int) channel, ofs, bframe->size);
+		return;
+	}
+
+/* sending end, find the node that is held back waiting for this */
+	struct blob_out* node = S->pending;
+	while (node && !(node->active && node->streamid == streamid))
+		node = node->next;
+
+	if (!node || !node->wait_seek)
+		return;
+
+	uint8_t hash[16];
+	if (ofs && (ofs >= node->size || ofs % BSTREAM_CHUNK ||
+		!hash_prefix(node->fd, ofs, hash) || memcmp(hash, &S->decode[30], 16) != 0)){
+		a12int_trace(A12_TRACE_BTRANSFER,
+			"kind=seek_reject:stream=%"PRIu32":ofs=%"PRIu64, streamid, ofs);
+		ofs = 0;
+	}
+
+	node->ofs = ofs;
+	node->left = node->size - ofs;
+	node->wait_seek = false;
+	send_bstreamseek(S, node->chid, streamid, ofs, NULL, true);
+}
+
 static void command_binarystream(struct a12_state* S)
 {
 /*
  * unpack / validate header
  */
 	uint8_t channel = S->decode[16];
-	struct binary_frame* bframe = &S->channels[channel].unpack_state.bframe;
+	struct binary_frame* bframe = bframe_slot(S, channel);
 
 /*
  * sign of a very broken client (or state tracking), starting a new binary
@@ -958,6 +1787,7 @@ static void command_binarystream(struct a12_state* S)
 	memcpy(bframe->checksum, &S->decode[35], 16);
 	bframe->tmp_fd = -1;
 	memcpy(bframe->extid, &S->decode[53], 16);
+	bframe->resume = false;
 
 	bframe->active = true;
 	a12int_trace(A12_TRACE_BTRANSFER,
@@ -990,14 +1820,18 @@ static void command_binarystream(struct a12_state* S)
 	if (S->binary_handler){
 		struct a12_bhandler_res res = S->binary_handler(S, bm, S->binary_handler_tag);
 		bframe->tmp_fd = res.fd;
+		bframe->resume = res.resume;
 		sc = res.flag;
 	}
 
 	if (sc == A12_BHANDLER_DONTWANT || sc == A12_BHANDLER_CACHED){
-		a12_stream_cancel(S, channel);
 		a12int_trace(A12_TRACE_BTRANSFER,
 			"kind=reject:stream=%"PRId64":ch=%d", bframe->streamid, channel);
+		bframe_cancel(S, channel, bframe);
 	}
+/* the sender holds the data back until it knows where to start */
+	else if (S->decode[69] == 1)
+		request_bstreamseek(S, channel, bframe);
 }
 
 void a12_vstream_cancel(struct a12_state* S, uint8_t channel, int reason)
@@ -1020,10 +1854,15 @@ void a12_vstream_cancel(struct a12_state* S, uint8_t channel, int reason)
 }
 
 void a12_stream_cancel(struct a12_state* S, uint8_t channel)
+{
+	bframe_cancel(S, channel, &S->channels[channel].unpack_state.bframe);
+}
+
+static void bframe_cancel(
+	struct a12_state* S, uint8_t channel, struct binary_frame* bframe)
 {
 	uint8_t outb[CONTROL_PACKET_SIZE] = {0};
 	step_sequence(S, outb);
-	struct binary_frame* bframe = &S->channels[channel].unpack_state.bframe;
 
 /* API misuse, trying to cancel a stream that is not active */
 	if (!bframe->active)
@@ -1033,9 +1872,19 @@ void a12_stream_cancel(struct a12_state* S, uint8_t channel)
 	outb[17] = COMMAND_CANCELSTREAM;
 	pack_u32(bframe->streamid, &outb[18]); /* [18 .. 21] stream-id */
 	outb[23] = STREAM_TYPE_BINARY;
+	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+	bframe_drop(S, channel, bframe);
+}
+
+/* local half of a cancel, also used when the other end is already gone */
+static void bframe_drop(
+	struct a12_state* S, uint8_t channel, struct binary_frame* bframe)
+{
+	if (!bframe->active)
+		return;
+
 	bframe->active = false;
 	bframe->streamid = -1;
-	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
 
 	if (bframe->zstd){
 		ZSTD_freeDCtx(bframe->zstd);
@@ -1048,6 +1897,8 @@ void a12_stream_cancel(struct a12_state* S, uint8_t channel)
 		struct a12_bhandler_meta bm = {
 			.fd = bframe->tmp_fd,
 			.state = A12_BHANDLER_CANCELLED,
+			.type = bframe->type,
+			.identifier = bframe->identifier,
 			.streamid = bframe->streamid,
 			.channel = channel
 		};
@@ -1070,8 +1921,15 @@ static void command_audioframe(struct a12_state* S)
 	aframe->channels = S->decode[22];
 	unpack_u16(&aframe->nsamples, &S->decode[24]);
 	unpack_u32(&aframe->rate, &S->decode[26]);
+	unpack_u64(&aframe->pts, &S->decode[30]);
+	aframe->commit = 0;
 	S->in_channel = -1;
 
+	free(aframe->inbuf);
+	aframe->inbuf = NULL;
+	aframe->inbuf_pos = 0;
+	aframe->inbuf_sz = 0;
+
 /* developer error (or malicious client), set to skip decode/playback */
 	if (!S->channels[channel].active){
 		a12int_trace(A12_TRACE_SYSTEM,
@@ -1080,6 +1938,20 @@ static void command_audioframe(struct a12_state* S)
 		return;
 	}
 
+/* encoded frames say how much follows so that they can be decoded whole */
+	if (aframe->encoding == AUDIO_ENCODING_OPUS){
+		uint32_t sz;
+		unpack_u32(&sz, &S->decode[38]);
+		if (sz && sz <= AUDIO_UNIT_MAX)
+			aframe->inbuf = malloc(sz);
+		if (!aframe->inbuf){
+			a12int_trace(A12_TRACE_AUDIO, "kind=error:opus_unit:size=%"PRIu32, sz);
+			aframe->commit = 255;
+			return;
+		}
+		aframe->inbuf_sz = sz;
+	}
+
 /* this requires an extended resize (theoretically, practically not),
  * and in those cases we want to copy-out the vbuffer state if set and
 	if (cont->samplerate != aframe->rate){
@@ -1223,12 +2095,15 @@ static void command_videoframe(struct a12_state* S)
 	struct a12_channel* channel = &S->channels[ch];
 	struct video_frame* vframe = &S->channels[ch].unpack_state.vframe;
 
+/* the previous frame might still be decoding into the destination */
+	a12int_vdec_sync(S, ch);
+
 /*
  * allocation and tracking for this one is subtle! nderef- etc. has been here
  * in the past. The reason is that codec can be swapped at the encoder side
  * and that some codecs need to retain state between frames.
  */
-	if (!a12int_vframe_setup(channel, vframe, method)){
+	if (!a12int_vframe_setup(S, channel, vframe, method)){
 		vframe->commit = 255;
 		a12int_stream_fail(S, ch, 1, STREAM_FAIL_UNKNOWN);
 		return;
@@ -1259,6 +2134,9 @@ static void command_videoframe(struct a12_state* S)
 /* [41]     : commit: uint8 */
 	unpack_u32(&vframe->expanded_sz, &S->decode[40]);
 	vframe->commit = S->decode[44];
+
+/* [45..52] : capture time, 0 from older sources */
+	unpack_u64(&vframe->pts, &S->decode[45]);
 	S->in_channel = -1;
 
 /* If channel set, apply resize immediately - synch cost should be offset with
@@ -1296,6 +2174,16 @@ static void command_videoframe(struct a12_state* S)
 		hints_changed = true;
 	}
 
+/* partial updates need to stay partial locally as well, the region is then
+ * marked when the frame completes (see a12_decode.c) */
+	if (channel->active != CHANNEL_RAW &&
+		(vframe->x || vframe->y ||
+		vframe->w != vframe->sw || vframe->h != vframe->sh) &&
+		!(cont->hints & SHMIF_RHINT_SUBREGION)){
+		cont->hints |= SHMIF_RHINT_SUBREGION;
+		hints_changed = true;
+	}
+
 /* always request a new video buffer between frames for raw mode so the
  * caller has the option of mapping each to different destinations */
 	if (channel->active == CHANNEL_RAW)
@@ -1341,7 +2229,7 @@ static void command_videoframe(struct a12_state* S)
 	if (vframe->postprocess == POSTPROCESS_VIDEO_RGBA ||
 		vframe->postprocess == POSTPROCESS_VIDEO_RGB565 ||
 		vframe->postprocess == POSTPROCESS_VIDEO_RGB){
-		vframe->row_left = vframe->w - vframe->x;
+		vframe->row_left = vframe->w;
 		vframe->out_pos = vframe->y * cont->pitch + vframe->x;
 		a12int_trace(A12_TRACE_TRANSFER,
 			"row-length: %zu at buffer pos %"PRIu32, vframe->row_left, vframe->inbuf_pos);
@@ -1373,7 +2261,7 @@ static void command_videoframe(struct a12_state* S)
 /* out_pos gets validated in the decode stage, so no OOB ->y ->x */
 		vframe->out_pos = vframe->y * cont->pitch + vframe->x;
 		vframe->inbuf_pos = 0;
-		vframe->inbuf = DYNAMIC_MALLOC(vframe->inbuf_sz);
+		vframe->inbuf = a12int_pool_alloc(S, vframe->inbuf_sz);
 		if (!vframe->inbuf){
 			a12int_trace(A12_TRACE_ALLOC,
 				"couldn't allocate intermediate buffer store");
@@ -1577,6 +2465,8 @@ void a12_enqueue_bstream(struct a12_state* S,
 	blake3_hasher_finalize(&hash, next->checksum, 16);
 	munmap(map, fend);
 	next->left = fend;
+	next->size = fend;
+	next->streaming = false;
 	a12int_trace(A12_TRACE_BTRANSFER,
 		"kind=added:type=%d:stream=no:size=%zu", type, next->left);
 	S->active_blobs++;
@@ -1594,6 +2484,10 @@ static bool authdec_buffer(const char* src, struct a12_state* S, size_t block_sz
 {
 	size_t mac_size = MAC_BLOCK_SZ;
 
+/* datagram units are authenticated and decrypted as they arrive */
+	if (S->dgram && S->dgram->replay)
+		return true;
+
 	if (S->authentic == AUTH_SERVER_HBLOCK){
 		mac_size = 8;
 		trace_crypto_key(S->server, "auth_mac_in", S->last_mac_in, mac_size);
@@ -1616,6 +2510,131 @@ static bool authdec_buffer(const char* src, struct a12_state* S, size_t block_sz
 	return res;
 }
 
+/*
+ * Session tickets keep no state on the server end:
+ *
+ *  [0..7]   nonce
+ *  [8..11]  expiry (unix time, seconds)
+ *  [12..43] client public key, encrypted
+ *  [44..55] keyed blake3 tag over [0..43]
+ *
+ * The cipher, tag and secret keys all come from opts->ticket_key and the
+ * secret the resumed session is keyed from is derived over the plaintext,
+ * so the ticket alone is enough to both authenticate and rekey.
+ */
+static void ticket_crypt(struct a12_state* S,
+	uint8_t ticket[static A12_TICKET_SIZE], bool seal, uint8_t secret[static 32])
+{
+	uint8_t keys[3 * BLAKE3_KEY_LEN];
+	blake3_hasher temp;
+	blake3_hasher_init_derive_key(&temp, "arcan-a12 session ticket");
+	blake3_hasher_update(&temp, S->opts->ticket_key, 32);
+	blake3_hasher_finalize(&temp, keys, sizeof(keys));
+
+/* the secret is over the plaintext, open decrypts first and seal last */
+	struct chacha_ctx ctx;
+	chacha_setup(&ctx, keys, BLAKE3_KEY_LEN, 0, CIPHER_ROUNDS);
+	chacha_set_nonce(&ctx, ticket);
+
+	if (!seal)
+		chacha_apply(&ctx, &ticket[12], 32);
+
+	blake3_hasher_init_keyed(&temp, &keys[2 * BLAKE3_KEY_LEN]);
+	blake3_hasher_update(&temp, ticket, 44);
+	blake3_hasher_finalize(&temp, secret, 32);
+
+	if (seal)
+		chacha_apply(&ctx, &ticket[12], 32);
+
+	memset(keys, '\0', sizeof(keys));
+	memset(&ctx, '\0', sizeof(ctx));
+	memset(&temp, '\0', sizeof(temp));
+}
+
+static void ticket_tag(struct a12_state* S,
+	const uint8_t ticket[static A12_TICKET_SIZE], uint8_t tag[static 12])
+{
+	uint8_t keys[3 * BLAKE3_KEY_LEN];
+	blake3_hasher temp;
+	blake3_hasher_init_derive_key(&temp, "arcan-a12 session ticket");
+	blake3_hasher_update(&temp, S->opts->ticket_key, 32);
+	blake3_hasher_finalize(&temp, keys, sizeof(keys));
+
+	blake3_hasher_init_keyed(&temp, &keys[BLAKE3_KEY_LEN]);
+	blake3_hasher_update(&temp, ticket, 44);
+	blake3_hasher_finalize(&temp, tag, 12);
+	memset(keys, '\0', sizeof(keys));
+}
+
+/* server, after authentication if the client can take one */
+static void send_ticket(struct a12_state* S)
+{
+	uint8_t empty[32] = {0};
+	if (!(S->remote_features & A12_FEATURE_RESUME) ||
+		memcmp(S->opts->ticket_key, empty, 32) == 0)
+		return;
+
+	uint8_t outb[CONTROL_PACKET_SIZE] = {0};
+	build_control_header(S, outb, COMMAND_TICKET);
+
+	uint8_t* ticket = &outb[18];
+	arcan_random(ticket, 8);
+	pack_u32((uint32_t) time(NULL) + TICKET_LIFETIME, &ticket[8]);
+	memcpy(&ticket[12], S->keys.remote_pub, 32);
+	ticket_crypt(S, ticket, true, &outb[18 + A12_TICKET_SIZE]);
+	ticket_tag(S, ticket, &ticket[44]);
+
+	a12int_trace(A12_TRACE_SECURITY, "kind=ticket:lifetime=%d", TICKET_LIFETIME);
+	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+	memset(outb, '\0', sizeof(outb));
+}
+
+/* client, keep it around for a12_resume */
+static void command_ticket(struct a12_state* S)
+{
+	if (S->server)
+		return;
+
+	uint32_t expires;
+	memcpy(S->ticket.blob, &S->decode[18], A12_TICKET_SIZE);
+	memcpy(S->ticket.secret, &S->decode[18 + A12_TICKET_SIZE], 32);
+	unpack_u32(&expires, &S->ticket.blob[8]);
+	S->ticket.expires = expires;
+	a12int_trace(A12_TRACE_SECURITY, "kind=ticket:expires=%"PRIu32, expires);
+}
+
+/* server, check that the ticket is ours and current, recover the public key
+ * of the client it was issued to and the secret to continue with */
+static bool open_ticket(struct a12_state* S,
+	const uint8_t in[static A12_TICKET_SIZE], uint8_t pubk[static 32], uint8_t secret[static 32])
+{
+	uint8_t empty[32] = {0};
+	if (memcmp(S->opts->ticket_key, empty, 32) == 0)
+		return false;
+
+	uint8_t ticket[A12_TICKET_SIZE];
+	memcpy(ticket, in, A12_TICKET_SIZE);
+
+	uint8_t tag[12];
+	ticket_tag(S, ticket, tag);
+	if (memcmp(tag, &ticket[44], 12) != 0){
+		a12int_trace(A12_TRACE_SECURITY, "kind=ticket:status=bad_tag");
+		return false;
+	}
+
+	uint32_t expires;
+	unpack_u32(&expires, &ticket[8]);
+	if ((uint32_t) time(NULL) >= expires){
+		a12int_trace(A12_TRACE_SECURITY, "kind=ticket:status=expired");
+		return false;
+	}
+
+	ticket_crypt(S, ticket, false, secret);
+	memcpy(pubk, &ticket[12], 32);
+	memset(ticket, '\0', sizeof(ticket));
+	return true;
+}
+
 static void hello_auth_server_hello(struct a12_state* S)
 {
 	uint8_t pubk[32];
@@ -1628,12 +2647,42 @@ static void hello_auth_server_hello(struct a12_state* S)
 	a12int_trace(A12_TRACE_CRYPTO, "state=complete:method=%d", cfl);
 
 	/* here is a spot for having more authentication modes if needed (version bump) */
-	if (cfl != HELLO_MODE_EPHEMPK && cfl != HELLO_MODE_REALPK){
+	if (cfl != HELLO_MODE_EPHEMPK && cfl != HELLO_MODE_REALPK &&
+		(cfl != HELLO_MODE_TICKET || S->authentic != AUTH_SERVER_HBLOCK)){
 		a12int_trace(A12_TRACE_SECURITY, "unknown_hello");
 		fail_state(S);
 		return;
 	}
 
+/* resume, the ticket replaces both the key exchange and the lookup, the
+ * reply carries the nonce that together with the ticket secret keys the
+ * rest of the session */
+	if (cfl == HELLO_MODE_TICKET){
+		uint8_t secret[32];
+		if (!open_ticket(S, &S->decode[72], S->keys.remote_pub, secret)){
+			fail_state(S);
+			return;
+		}
+
+		uint8_t empty[32] = {0};
+		arcan_random(nonce, 8);
+		send_hello_packet(S, HELLO_MODE_TICKET, empty, nonce, NULL);
+
+		memcpy((uint8_t*)S->opts->secret, secret, 32);
+		memset(secret, '\0', sizeof(secret));
+		update_keymaterial(S, S->opts->secret, 32, nonce);
+		dgram_setup(S, nonce);
+		trace_crypto_key(S->server, "state=resumed", S->keys.remote_pub, 32);
+
+		S->authentic = AUTH_FULL_PK;
+		S->auth_latched = true;
+		send_ticket(S);
+
+		if (S->on_auth)
+			S->on_auth(S, S->auth_tag);
+		return;
+	}
+
 /* public key is ephemeral, generate new pair, send a hello out with the new
  * one THEN derive new keys for authentication and so on. After this the
  * connection flows just like if the ephem mode wasn't used - the client
@@ -1644,7 +2693,7 @@ static void hello_auth_server_hello(struct a12_state* S)
 		x25519_private_key(ek);
 		x25519_public_key(ek, pubk);
 		arcan_random(nonce, 8);
-		send_hello_packet(S, HELLO_MODE_EPHEMPK, pubk, nonce);
+		send_hello_packet(S, HELLO_MODE_EPHEMPK, pubk, nonce, NULL);
 
 		x25519_shared_secret((uint8_t*)S->opts->secret, ek, remote_pubk);
 		trace_crypto_key(S->server, "ephem_pub", pubk, 32);
@@ -1677,7 +2726,7 @@ static void hello_auth_server_hello(struct a12_state* S)
 /* hello packet here will still use the keystate from the process_srvfirst
  * which will use the client provided nonce, KDF on preshare-pw */
 	arcan_random(nonce, 8);
-	send_hello_packet(S, HELLO_MODE_REALPK, pubk, nonce);
+	send_hello_packet(S, HELLO_MODE_REALPK, pubk, nonce, NULL);
 	memcpy(S->keys.remote_pub, &S->decode[21], 32);
 	trace_crypto_key(S->server, "state=client_pk_ok:respond_pk", pubk, 32);
 
@@ -1685,10 +2734,12 @@ static void hello_auth_server_hello(struct a12_state* S)
  * states regardless of the nonce the client provided in the first message */
 	trace_crypto_key(S->server, "state=server_ssecret", (uint8_t*)S->opts->secret, 32);
 	update_keymaterial(S, S->opts->secret, 32, nonce);
+	dgram_setup(S, nonce);
 
 /* and done, mark latched so a12_unpack saves buffer and returns */
 	S->authentic = AUTH_FULL_PK;
 	S->auth_latched = true;
+	send_ticket(S);
 
 	if (S->on_auth)
 		S->on_auth(S, S->auth_tag);
@@ -1696,6 +2747,30 @@ static void hello_auth_server_hello(struct a12_state* S)
 
 static void hello_auth_client_hello(struct a12_state* S)
 {
+/* the server accepted the ticket, it is only good for one resume */
+	if (S->resuming){
+		if (S->decode[20] != HELLO_MODE_TICKET){
+			a12int_trace(A12_TRACE_SECURITY, "kind=ticket:status=rejected");
+			fail_state(S);
+			return;
+		}
+
+		memcpy((uint8_t*)S->opts->secret, S->ticket.secret, 32);
+		S->ticket = (struct a12_ticket){0};
+		S->resuming = false;
+		update_keymaterial(S, S->opts->secret, 32, &S->decode[8]);
+		dgram_setup(S, &S->decode[8]);
+
+		S->authentic = AUTH_FULL_PK;
+		S->auth_latched = true;
+		S->remote_mode = S->decode[54];
+		a12int_trace(A12_TRACE_SYSTEM, "resumed:remote_mode=%d", S->remote_mode);
+
+		if (S->on_auth)
+			S->on_auth(S, S->auth_tag);
+		return;
+	}
+
 	if (!S->opts->pk_lookup){
 		a12int_trace(A12_TRACE_CRYPTO, "state=eimpl:kind=x25519-no-lookup");
 		fail_state(S);
@@ -1716,6 +2791,7 @@ static void hello_auth_client_hello(struct a12_state* S)
 	x25519_shared_secret((uint8_t*)S->opts->secret, S->keys.real_priv, &S->decode[21]);
 	trace_crypto_key(S->server, "state=client_ssecret", (uint8_t*)S->opts->secret, 32);
 	update_keymaterial(S, S->opts->secret, 32, &S->decode[8]);
+	dgram_setup(S, &S->decode[8]);
 
 	S->authentic = AUTH_FULL_PK;
 	S->auth_latched = true;
@@ -1735,7 +2811,11 @@ static void process_hello_auth(struct a12_state* S)
 - [20]      Flags         : uint8
 - [21+ 32]  x25519 Pk     : blob,
 - [54]      Source/Sink
+- [71]      Features
 	 */
+	S->remote_major = S->decode[18];
+	S->remote_minor = S->decode[19];
+	S->remote_features = S->decode[71];
 
 	if (S->decode[54]){
 		S->remote_mode = ROLE_PROBE;
@@ -1817,7 +2897,7 @@ static void process_hello_auth(struct a12_state* S)
 
 		S->authentic = AUTH_REAL_HELLO_SENT;
 		arcan_random(nonce, 8);
-		send_hello_packet(S, 1, realpk, nonce);
+		send_hello_packet(S, 1, realpk, nonce, NULL);
 	}
 /* the server and client are both using a shared secret from the ephemeral key
  * now, and this message contains the real public key of the client, treat it
@@ -1849,6 +2929,8 @@ static void command_pingpacket(struct a12_state* S, uint32_t sid)
 		return;
 	}
 
+	link_ack(S, sid);
+
 	size_t i;
 	size_t wnd_sz = VIDEO_FRAME_DRIFT_WINDOW;
 	for (i = 0; i < wnd_sz; i++){
@@ -2164,6 +3246,15 @@ static void process_control(struct a12_state* S, void (*on_event)
 	case COMMAND_DIRSTATE:
 		add_dirent(S);
 	break;
+	case COMMAND_DATAGRAM:
+		command_datagram(S, tag, on_event);
+	break;
+	case COMMAND_BSTREAMSEEK:
+		command_bstreamseek(S);
+	break;
+	case COMMAND_TICKET:
+		command_ticket(S);
+	break;
 	default:
 		a12int_trace(A12_TRACE_SYSTEM, "Unknown message type: %d", (int)command);
 	break;
@@ -2201,40 +3292,84 @@ static void process_event(struct a12_state* S, void* tag,
 	reset_state(S);
 }
 
-static void process_blob(struct a12_state* S)
+/*
+ * Same as process_event but the payload is in the compact eventpack format
+ * and variable length, so first comes (ch, len) then the packed event.
+ */
+static void process_event_compact(struct a12_state* S, void* tag,
+	void (*on_event)(
+		struct arcan_shmif_cont* wnd, int chid, struct arcan_event*, void*))
 {
-/* do we have the header bytes or not? the actual callback is triggered
- * inside of the binarystream rather than of the individual blobs */
 	if (S->in_channel == -1){
 		update_mac_and_decrypt(__func__, &S->in_mac,
 			S->dec_state, S->decode, header_sizes[S->state]);
 
 		S->in_channel = S->decode[0];
-		unpack_u32(&S->in_stream, &S->decode[1]);
-		unpack_u16(&S->left, &S->decode[5]);
+		unpack_u16(&S->left, &S->decode[1]);
 		S->decode_pos = 0;
-		a12int_trace(A12_TRACE_BTRANSFER,
-			"kind=header:channel=%d:size=%"PRIu16, S->in_channel, S->left);
+
+		if (!S->left || S->left > A12_EVENTC_MAX){
+			a12int_trace(A12_TRACE_SYSTEM,
+				"kind=error:status=EINVAL:message=bad compact event size");
+			fail_state(S);
+		}
 		return;
 	}
 
-/* did we receive a message on a dead channel? */
-	struct binary_frame* cbf = &S->channels[S->in_channel].unpack_state.bframe;
 	if (!authdec_buffer(__func__, S, S->decode_pos)){
+		a12int_trace(A12_TRACE_CRYPTO, "MAC mismatch on event packet");
 		fail_state(S);
 		return;
 	}
 
-	struct arcan_shmif_cont* cont = S->channels[S->in_channel].cont;
-	if (!cont && !S->binary_handler && !cbf->tunnel){
-		a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=EINVAL:"
-			"ch=%d:message=no segment or bhandler mapped", S->in_channel);
-		reset_state(S);
-		return;
+	struct arcan_event aev;
+	uint8_t channel = S->in_channel;
+
+	if (-1 == arcan_shmif_eventunpack_compact(S->decode, S->decode_pos, &aev)){
+		a12int_trace(A12_TRACE_SYSTEM, "broken event packet received");
+	}
+	else if (on_event){
+		a12int_trace(A12_TRACE_EVENT, "unpack event to %d", channel);
+		on_event(S->channels[channel].cont, channel, &aev, tag);
 	}
 
-/* we can't stop the other side from sending data to a dead stream, so just
- * discard the data and hope that a previously sent cancelstream will take */
+	reset_state(S);
+}
+
+static void process_blob(struct a12_state* S)
+{
+/* do we have the header bytes or not? the actual callback is triggered
+ * inside of the binarystream rather than of the individual blobs */
+	if (S->in_channel == -1){
+		update_mac_and_decrypt(__func__, &S->in_mac,
+			S->dec_state, S->decode, header_sizes[S->state]);
+
+		S->in_channel = S->decode[0];
+		unpack_u32(&S->in_stream, &S->decode[1]);
+		unpack_u16(&S->left, &S->decode[5]);
+		S->decode_pos = 0;
+		a12int_trace(A12_TRACE_BTRANSFER,
+			"kind=header:channel=%d:size=%"PRIu16, S->in_channel, S->left);
+		return;
+	}
+
+/* did we receive a message on a dead channel? */
+	struct binary_frame* cbf = bframe_find(S, S->in_channel, S->in_stream);
+	if (!authdec_buffer(__func__, S, S->decode_pos)){
+		fail_state(S);
+		return;
+	}
+
+	struct arcan_shmif_cont* cont = S->channels[S->in_channel].cont;
+	if (!cont && !S->binary_handler && !cbf->tunnel){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=EINVAL:"
+			"ch=%d:message=no segment or bhandler mapped", S->in_channel);
+		reset_state(S);
+		return;
+	}
+
+/* we can't stop the other side from sending data to a dead stream, so just
+ * discard the data and hope that a previously sent cancelstream will take */
 	if (cbf->streamid != S->in_stream || -1 == cbf->streamid){
 		a12int_trace(A12_TRACE_BTRANSFER, "kind=notice:ch=%d:src_stream=%"PRIu32
 			":dst_stream=%"PRId64":message=data on cancelled stream",
@@ -2266,7 +3401,7 @@ static void process_blob(struct a12_state* S)
 		if (ZSTD_CONTENTSIZE_UNKNOWN == content_sz ||
 		    ZSTD_CONTENTSIZE_ERROR == content_sz){
 			a12int_trace(A12_TRACE_SYSTEM, "kind=zstd_bad:unknown_size");
-			a12_stream_cancel(S, S->in_channel);
+			bframe_cancel(S, S->in_channel, cbf);
 			reset_state(S);
 			return;
 		}
@@ -2277,7 +3412,7 @@ static void process_blob(struct a12_state* S)
 		if (!buf){
 			a12int_trace(A12_TRACE_ALLOC,
 				"kind=zstd_buffer_fail:size=%zu", (size_t) content_sz);
-			a12_stream_cancel(S, S->in_channel);
+			bframe_cancel(S, S->in_channel, cbf);
 			reset_state(S);
 			return;
 		}
@@ -2288,7 +3423,7 @@ static void process_blob(struct a12_state* S)
 
 		if (ZSTD_isError(decode)){
 			a12int_trace(A12_TRACE_SYSTEM, "kind=zstd_fail:code=%zu", (size_t) decode);
-			a12_stream_cancel(S, S->in_channel);
+			bframe_cancel(S, S->in_channel, cbf);
 			reset_state(S);
 			return;
 		}
@@ -2316,7 +3451,7 @@ static void process_blob(struct a12_state* S)
 /* so there was a problem writing (dead pipe, out of space etc). send a cancel
  * on the stream,this will also forward the status change to the event handler
  * itself who is responsible for closing the tmp_fd */
-				a12_stream_cancel(S, S->in_channel);
+				bframe_cancel(S, S->in_channel, cbf);
 				reset_state(S);
 				if (free_buf)
 					DYNAMIC_FREE(buf);
@@ -2374,6 +3509,7 @@ static void process_blob(struct a12_state* S)
 /* send that we ack:ed the transfer so the other side gets a chance to react
  * even if they have nothing else queued */
 			a12int_stream_ack(S, S->in_channel, cbf->identifier);
+			reset_state(S);
 			return;
 		}
 	}
@@ -2492,26 +3628,123 @@ static void drain_audio(struct a12_channel* ch)
 {
 	struct arcan_shmif_cont* cont = ch->cont;
 	if (ch->active == CHANNEL_RAW){
+		size_t nb = cont->abufpos ?
+			cont->abufpos * sizeof(AUDIO_SAMPLE_TYPE) : cont->abufused;
 		if (ch->raw.signal_audio)
-			ch->raw.signal_audio(cont->abufused, ch->raw.tag);
+			ch->raw.signal_audio(nb, ch->raw.tag);
 		cont->abufused = 0;
+		cont->abufpos = 0;
 		return;
 	}
 
 	arcan_shmif_signal(cont, SHMIF_SIGAUD);
 }
 
+/* the segment need to have negotiated an audio buffer (raw: been given one)
+ * before samples can go anywhere */
+static bool audio_acquire(struct a12_state* S,
+	struct a12_channel* channel, struct audio_frame* caf)
+{
+	struct arcan_shmif_cont* cont = channel->cont;
+
+	if (channel->active == CHANNEL_RAW){
+		if (!update_proxy_acont(channel, caf))
+			return false;
+	}
+
+	if (cont->audp)
+		return true;
+
+/* the shared video buffer can move, the decode worker needs to be done first */
+	a12int_vdec_sync(S, channel - S->channels);
+
+	a12int_trace(A12_TRACE_AUDIO,
+		"frame-resize, rate: %"PRIu32", channels: %"PRIu8,
+		caf->rate, caf->channels
+	);
+
+/* a note with the extended resize here is that we always request a single
+ * video buffer, which means the video part will be locked until we get an
+ * ack from the consumer - this might need to be tunable to increase if we
+ * detect that we stall on signalling video */
+	if (!arcan_shmif_resize_ext(cont,
+		cont->w, cont->h, (struct shmif_resize_ext){
+			.abuf_sz = 1024, .samplerate = caf->rate,
+			.abuf_cnt = 16, .vbuf_cnt = 1
+		})){
+		a12int_trace(A12_TRACE_ALLOC, "frame-resize failed");
+		caf->commit = 255;
+		return false;
+	}
+
+	return true;
+}
+
+void a12int_audio_out(struct a12_state* S, struct a12_channel* ch,
+	const int16_t* buf, size_t n, uint8_t channels, uint32_t rate)
+{
+	struct arcan_shmif_cont* cont = ch->cont;
+	struct audio_frame af = {.channels = channels, .rate = rate};
+	if (!cont || !audio_acquire(S, ch, &af))
+		return;
+
+/* the segment is stereo, mono gets duplicated */
+	for (size_t i = 0; i < n; i++){
+		cont->audp[cont->abufpos++] = SHMIF_AINT16(buf[i]);
+		if (channels == 1)
+			cont->audp[cont->abufpos++] = SHMIF_AINT16(buf[i]);
+
+		if (cont->abufcount - cont->abufpos <= 1)
+			drain_audio(ch);
+	}
+
+	if (cont->abufpos)
+		drain_audio(ch);
+}
+
+/* encoded audio is collected until the unit is complete, then it goes to the
+ * jitter buffer and playout is left to a12_audio_step */
+static void audio_unit(struct a12_state* S,
+	struct a12_channel* channel, struct audio_frame* caf)
+{
+	if (caf->commit == 255 || !caf->inbuf){
+		reset_state(S);
+		return;
+	}
+
+	if (S->decode_pos > caf->inbuf_sz - caf->inbuf_pos){
+		a12int_trace(A12_TRACE_AUDIO,
+			"kind=error:audio_overflow:size=%zu", caf->inbuf_sz);
+		caf->commit = 255;
+		reset_state(S);
+		return;
+	}
+
+	memcpy(&caf->inbuf[caf->inbuf_pos], S->decode, S->decode_pos);
+	caf->inbuf_pos += S->decode_pos;
+
+	if (caf->inbuf_pos == caf->inbuf_sz){
+		a12int_audio_unit(S, channel, caf);
+		free(caf->inbuf);
+		caf->inbuf = NULL;
+		caf->inbuf_pos = caf->inbuf_sz = 0;
+		a12int_audio_playout(S, channel, a12int_media_clock());
+	}
+
+	reset_state(S);
+}
+
 static void process_audio(struct a12_state* S)
 {
 /* in_channel is used to track if we are waiting for the header or not */
 	if (S->in_channel == -1){
 		uint32_t stream;
+		update_mac_and_decrypt(__func__,
+			&S->in_mac, S->dec_state, S->decode, header_sizes[S->state]);
 		S->in_channel = S->decode[0];
 		unpack_u32(&stream, &S->decode[1]);
 		unpack_u16(&S->left, &S->decode[5]);
 		S->decode_pos = 0;
-		update_mac_and_decrypt(__func__,
-			&S->in_mac, S->dec_state, S->decode, header_sizes[S->state]);
 		a12int_trace(A12_TRACE_AUDIO,
 			"audio[%d:%"PRIx32"], left: %"PRIu16, S->in_channel, stream, S->left);
 		return;
@@ -2539,33 +3772,15 @@ static void process_audio(struct a12_state* S)
 		return;
 	}
 
-	if (channel->active == CHANNEL_RAW){
-		if (!update_proxy_acont(channel, caf))
-			return;
+	if (caf->encoding == AUDIO_ENCODING_OPUS){
+		audio_unit(S, channel, caf);
+		return;
 	}
 
 /* passed the header stage, now it's the data block,
  * make sure the segment has registered that it can provide audio */
-	if (!cont->audp){
-		a12int_trace(A12_TRACE_AUDIO,
-			"frame-resize, rate: %"PRIu32", channels: %"PRIu8,
-			caf->rate, caf->channels
-		);
-
-/* a note with the extended resize here is that we always request a single
- * video buffer, which means the video part will be locked until we get an
- * ack from the consumer - this might need to be tunable to increase if we
- * detect that we stall on signalling video */
-			if (!arcan_shmif_resize_ext(cont,
-			cont->w, cont->h, (struct shmif_resize_ext){
-				.abuf_sz = 1024, .samplerate = caf->rate,
-				.abuf_cnt = 16, .vbuf_cnt = 1
-			})){
-			a12int_trace(A12_TRACE_ALLOC, "frame-resize failed");
-			caf->commit = 255;
-			return;
-		}
-	}
+	if (!audio_acquire(S, channel, caf))
+		return;
 
 /* Flush out into abuffer, assuming that the context has been set to match the
  * defined source format in a previous stage. Resampling might be needed here,
@@ -2596,7 +3811,7 @@ static void process_audio(struct a12_state* S)
 	caf->nsamples -= S->decode_pos >> 1;
 
 /* drain if there is data left in the buffer, but no samples left */
-	if (!caf->nsamples && cont->abufused){
+	if (!caf->nsamples && cont->abufpos){
 		drain_audio(channel);
 	}
 
@@ -2605,553 +3820,2406 @@ static void process_audio(struct a12_state* S)
 	reset_state(S);
 }
 
-/* helper that just forwards to set-destination */
-void a12_set_destination(
-	struct a12_state* S, struct arcan_shmif_cont* wnd, uint8_t chid)
+/*
+ * Keys for the datagram transport come from the session secret and the nonce
+ * of the final HELLO, so they are new for every session even though the
+ * secret is the same between two keypairs. There is one MAC and one cipher
+ * key in each direction.
+ */
+static void dgram_setup(struct a12_state* S, uint8_t nonce[static NONCE_SIZE])
 {
-	if (!S){
-		a12int_trace(A12_TRACE_DEBUG, "invalid set_destination call");
+	if (!S->opts->datagram || !(S->remote_features & A12_FEATURE_DGRAM) || S->dgram)
 		return;
-	}
 
-	if (S->channels[chid].active == CHANNEL_RAW){
-		DYNAMIC_FREE(S->channels[chid].cont);
-		S->channels[chid].cont = NULL;
+	struct a12_dgram* D = DYNAMIC_MALLOC(sizeof(struct a12_dgram));
+	if (!D){
+		a12int_trace(A12_TRACE_ALLOC, "kind=error:dgram_state");
+		return;
 	}
+	memset(D, '\0', sizeof(struct a12_dgram));
 
-	S->channels[chid].cont = wnd;
-	S->channels[chid].active = wnd ? CHANNEL_SHMIF : CHANNEL_INACTIVE;
+	uint8_t keys[4 * BLAKE3_KEY_LEN];
+	blake3_hasher temp;
+	blake3_hasher_init_derive_key(&temp, "arcan-a12 datagram");
+	blake3_hasher_update(&temp, S->opts->secret, 32);
+	blake3_hasher_update(&temp, nonce, NONCE_SIZE);
+	blake3_hasher_finalize(&temp, keys, sizeof(keys));
+
+/* [server mac, server key, client mac, client key] */
+	uint8_t* srv = keys;
+	uint8_t* cl = &keys[2 * BLAKE3_KEY_LEN];
+	memcpy(D->mac_out, S->server ? srv : cl, BLAKE3_KEY_LEN);
+	memcpy(D->key_out, &(S->server ? srv : cl)[BLAKE3_KEY_LEN], BLAKE3_KEY_LEN);
+	memcpy(D->mac_in, S->server ? cl : srv, BLAKE3_KEY_LEN);
+	memcpy(D->key_in, &(S->server ? cl : srv)[BLAKE3_KEY_LEN], BLAKE3_KEY_LEN);
+	memset(keys, '\0', sizeof(keys));
+	memset(&temp, '\0', sizeof(temp));
+
+	S->dgram = D;
+	a12int_trace(A12_TRACE_CRYPTO, "kind=dgram_keys");
 }
 
-void a12_set_destination_raw(struct a12_state* S,
-	uint8_t chid, struct a12_unpack_cfg cfg, size_t cfg_sz)
+static void dgram_free(struct a12_state* S)
 {
-/* the reason for this rather odd design is that non-shmif based receiver was
- * an afterthought, and it was a much larger task refactoring it out versus
- * adding a proxy and tagging */
-	size_t ct_sz = sizeof(struct arcan_shmif_cont);
-	struct arcan_shmif_cont* fake = DYNAMIC_MALLOC(ct_sz);
-	if (!fake)
+	struct a12_dgram* D = S->dgram;
+	if (!D)
 		return;
 
-	*fake = (struct arcan_shmif_cont){};
-	S->channels[chid].cont = fake;
-	S->channels[chid].raw = cfg;
-	S->channels[chid].active = CHANNEL_RAW;
+	for (size_t i = 0; i < DGRAM_SLOTS; i++)
+		DYNAMIC_FREE(D->slots[i].buf);
+	DYNAMIC_FREE(D->out);
 
-/* these are tracked per context and not per channel */
-	S->on_discover = cfg.on_discover;
-	S->discover_tag = cfg.on_discover_tag;
+	memset(D, '\0', sizeof(struct a12_dgram));
+	DYNAMIC_FREE(D);
+	S->dgram = NULL;
 }
 
-void
-a12_unpack(struct a12_state* S, const uint8_t* buf,
-	size_t buf_sz, void* tag, void (*on_event)
-	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*))
+/* a new keystream for every datagram, the sequence number is the nonce */
+static void dgram_cipher(
+	struct a12_dgram* D, const uint8_t* key, uint8_t nonce[static 8])
 {
-	if (S->state == STATE_BROKEN){
-		a12int_trace(A12_TRACE_SYSTEM,
-			"kind=error:status=EINVAL:message=state machine broken");
-		fail_state(S);
-		return;
+	chacha_setup(&D->cipher, key, BLAKE3_KEY_LEN, 0, CIPHER_ROUNDS);
+	chacha_set_nonce(&D->cipher, nonce);
+}
+
+static void dgram_mac(const uint8_t* key, uint8_t* buf, size_t sz, uint8_t* out)
+{
+	blake3_hasher H;
+	blake3_hasher_init_keyed(&H, key);
+	blake3_hasher_update(&H, buf, sz);
+	blake3_hasher_finalize(&H, out, MAC_BLOCK_SZ);
+}
+
+static bool dgram_emit(struct a12_state* S, uint8_t flags,
+	uint32_t unit, uint32_t size, uint32_t ofs, const uint8_t* data, size_t n)
+{
+	struct a12_dgram* D = S->dgram;
+	size_t total = DGRAM_HDR + DGRAM_INNER + n;
+
+	if (D->out_ofs && D->out_used + 2 + total > D->out_sz){
+		memmove(D->out, &D->out[D->out_ofs], D->out_used - D->out_ofs);
+		D->out_used -= D->out_ofs;
+		D->out_ofs = 0;
 	}
 
-/* flush any prequeued buffer, see comment at the end of the function */
-	if (S->prepend_unpack){
-		uint8_t* tmp_buf = S->prepend_unpack;
-		size_t tmp_sz = S->prepend_unpack_sz;
-		a12int_trace(A12_TRACE_SYSTEM, "kind=prebuf:size=%zu", tmp_sz);
-		S->prepend_unpack_sz = 0;
-		S->prepend_unpack = NULL;
-		a12_unpack(S, tmp_buf, tmp_sz, tag, on_event);
-		DYNAMIC_FREE(tmp_buf);
+	D->out = grow_array(D->out, &D->out_sz, D->out_used + 2 + total, 2 + OUTQ_COUNT);
+	if (!D->out){
+		D->out_used = D->out_ofs = D->queued = 0;
+		return false;
 	}
 
-/* Unknown state? then we're back waiting for a command packet */
-	if (S->left == 0)
-		reset_state(S);
+	pack_u16(total, &D->out[D->out_used]);
+	uint8_t* dst = &D->out[D->out_used + 2];
+	pack_u64(++D->seq, &dst[MAC_BLOCK_SZ]);
 
-/* iteratively flush, we tail- recurse should the need arise, optimization
- * here would be to forward buf immediately if it fits - saves a copy */
-	size_t ntr = buf_sz > S->left ? S->left : buf_sz;
+	uint8_t* inner = &dst[DGRAM_HDR];
+	inner[0] = flags;
+	inner[1] = D->gen;
+	pack_u32(unit, &inner[2]);
+	pack_u32(size, &inner[6]);
+	pack_u32(ofs, &inner[10]);
+	if (n)
+		memcpy(&inner[DGRAM_INNER], data, n);
 
-	memcpy(&S->decode[S->decode_pos], buf, ntr);
+	dgram_cipher(D, D->key_out, &dst[MAC_BLOCK_SZ]);
+	chacha_apply(&D->cipher, inner, DGRAM_INNER + n);
+	dgram_mac(D->mac_out, &dst[MAC_BLOCK_SZ], total - MAC_BLOCK_SZ, dst);
 
-	S->left -= ntr;
-	S->decode_pos += ntr;
-	buf_sz -= ntr;
-	S->stats.b_in += ntr;
+	D->out_used += 2 + total;
+	D->queued += total;
+	S->stats.b_out += total;
+	return true;
+}
 
-/* do we need to buffer more? */
-	if (S->left)
-		return;
+static void dgram_sync(
+	struct a12_state* S, struct a12_outq* Q, size_t start, size_t end)
+{
+	struct a12_dgram* D = S->dgram;
 
-/* otherwise dispatch based on state */
-	switch(S->state){
-	case STATE_1STSRV_PACKET:
-		process_srvfirst(S);
-	break;
-	case STATE_NOPACKET:
-		process_nopacket(S);
-	break;
-	case STATE_CONTROL_PACKET:
-		process_control(S, on_event, tag);
-	break;
-	case STATE_EVENT_PACKET:
-		process_event(S, tag, on_event);
-	break;
-/* worth noting is that these (a,v,b) have different buffer sizes for their
- * respective packets, so the authentication and decryption steps are somewhat
- * different */
-	case STATE_VIDEO_PACKET:
-		process_video(S);
-	break;
-	case STATE_AUDIO_PACKET:
-		process_audio(S);
-	break;
-	case STATE_BLOB_PACKET:
-		process_blob(S);
-	break;
-	default:
-		a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=EINVAL:message=bad command");
-		fail_state(S);
-		return;
-	break;
+	for (size_t ofs = start; ofs < end && S->state != STATE_BROKEN;){
+		uint32_t len;
+		unpack_u32(&len, &Q->buf[ofs + 1]);
+		append_crypt(S, Q->buf[ofs], &Q->buf[ofs + OUTQ_REC_HDR], len, NULL, 0);
+		ofs += OUTQ_REC_HDR + len;
 	}
 
-/* This is an ugly thing - so a buffer can contain a completed authentication
- * sequence and subsequent data. An API consumer may well need to do additional
- * work in between completed authentication and proper use or data might get
- * lost. The easiest way to solve this after the fact was to add a latched
- * buffer stage.
- *
- *  on_authentication_completed:
- *   - set latched state
- *   - if data remaining: save a copy and return
- *
- *  next unpack:
- *   - check if buffered data exist
- *   - process first, then move on to submitted buffer
+	uint8_t outb[CONTROL_PACKET_SIZE];
+	build_control_header(S, outb, COMMAND_DATAGRAM);
+	outb[18] = DGRAM_OP_SYNCED;
+	outb[19] = D->gen;
+	pack_u32(D->unit[DGRAM_VIDEO], &outb[20]);
+	append_crypt(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+
+	D->sync = false;
+}
+
+/*
+ * Move complete a/v units into datagrams, leaving the rest queued once there
+ * is enough waiting to be flushed. Units that are too large to reassemble are
+ * skipped, but still consume a unit number so that the other end sees it as
+ * a loss and asks for a refresh.
  */
-	if (buf_sz){
-		if (!S->auth_latched){
-			a12_unpack(S, &buf[ntr], buf_sz, tag, on_event);
-			return;
-		}
+static void dgram_commit(struct a12_state* S)
+{
+	struct a12_dgram* D = S->dgram;
+	if (D->hold)
+		return;
 
-		S->auth_latched = false;
-		S->prepend_unpack = DYNAMIC_MALLOC(buf_sz);
+	size_t chunk = D->mtu - DGRAM_HDR - DGRAM_INNER;
+
+	for (size_t i = OUTQ_AUDIO; i < OUTQ_COUNT; i++){
+		struct a12_outq* Q = &S->outq[i];
+		uint8_t cls = i == OUTQ_AUDIO ? DGRAM_AUDIO : DGRAM_VIDEO;
+
+		while (Q->units && D->queued < DGRAM_OUT_CAP){
+			size_t start = Q->ofs;
+			size_t end = start;
+			for(;;){
+				uint32_t len;
+				unpack_u32(&len, &Q->buf[end + 1]);
+				if (Q->buf[end] == OUTQ_UNIT_END)
+					break;
+				end += OUTQ_REC_HDR + len;
+			}
+			Q->ofs = end + OUTQ_REC_HDR;
+			Q->units--;
 
-		if (!S->prepend_unpack){
-			a12int_trace(A12_TRACE_ALLOC, "kind=error:latch_buffer_sz=%zu", buf_sz);
-			fail_state(S);
-			return;
+			size_t size = end - start;
+			if (cls == DGRAM_VIDEO && D->sync){
+				dgram_sync(S, Q, start, end);
+				continue;
+			}
+
+			uint32_t unit = D->unit[cls]++;
+			if (size > DGRAM_UNIT_CAP){
+				a12int_trace(A12_TRACE_SYSTEM,
+					"kind=error:dgram_unit_size=%zu:class=%d", size, (int) cls);
+				continue;
+			}
+
+			for (size_t ofs = 0; ofs < size; ofs += chunk){
+				size_t n = size - ofs > chunk ? chunk : size - ofs;
+				if (!dgram_emit(S, cls, unit, size, ofs, &Q->buf[start + ofs], n)){
+					fail_state(S);
+					return;
+				}
+			}
 		}
 
-		a12int_trace(A12_TRACE_SYSTEM, "kind=auth_latch:size=%zu", buf_sz);
-		memcpy(S->prepend_unpack, &buf[ntr], buf_sz);
-		S->prepend_unpack_sz = buf_sz;
-		return;
+		outq_drained(S, i);
 	}
-	if (S->auth_latched)
-		S->auth_latched = false;
 }
 
-/*
- * Several small issues that should be looked at here, one is that we don't
- * multiplex well with the source, risking a non-block 100% spin. Second is
- * that we don't have an intermediate buffer as part of the queue-node, meaning
- * that we risk sending very small blocks of data as part of the stream,
- * wasting bandwidth.
+static void dgram_request(struct a12_state* S)
+{
+	uint8_t outb[CONTROL_PACKET_SIZE];
+	build_control_header(S, outb, COMMAND_DATAGRAM);
+	outb[18] = DGRAM_OP_REFRESH;
+	outb[19] = S->dgram->rx_gen;
+
+	S->stats.dgram_refresh++;
+	a12int_trace(A12_TRACE_VIDEO,
+		"kind=dgram_refresh:gen=%"PRIu8, S->dgram->rx_gen);
+	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+}
+
+/*
+ * A video unit went missing, whatever comes after it depends on state the
+ * decoders no longer have in common with the encoders. Drop the tile caches
+ * and anything incomplete, then wait for the sync unit of the refresh.
  */
-static void* read_data(int fd, size_t cap, uint16_t* nts, bool* die)
+static void dgram_loss(struct a12_state* S)
 {
-	void* buf = DYNAMIC_MALLOC(65536);
-	*nts = 0;
+	struct a12_dgram* D = S->dgram;
+	S->stats.dgram_lost++;
+
+/* the units after the sync unit are only collected, the gap is found again
+ * when delivering resumes */
+	if (D->rx_wait)
+		return;
+
+	for (size_t i = 0; i < DGRAM_SLOTS; i++){
+		if (D->slots[i].used && D->slots[i].cls == DGRAM_VIDEO){
+			DYNAMIC_FREE(D->slots[i].buf);
+			D->slots[i] = (struct dgram_slot){};
+		}
+	}
+
+	for (size_t i = 0; i < 256; i++)
+		if (S->channels[i].active)
+			a12int_decode_drop(S, i, false);
+
+	D->rx_wait = true;
+	D->rx_gen++;
+	dgram_request(S);
+}
+
+/* source side of the refresh, forget everything that was encoded against
+ * the old state and make sure the next frame goes in full */
+static void dgram_refresh(struct a12_state* S, uint8_t gen)
+{
+	struct a12_dgram* D = S->dgram;
+
+	venc_sync(S);
+	struct a12_outq* Q = &S->outq[OUTQ_VIDEO];
+	Q->ofs = Q->used = Q->unit_start = Q->units = 0;
+
+	for (size_t i = 0; i < 256; i++){
+		a12int_encode_reset_delta(S, i);
+		a12int_encode_drop(S, i, false);
+		S->channels[i].vframe_dropped = true;
+	}
+
+	memset(S->congestion_stats.frame_window, '\0',
+		sizeof(S->congestion_stats.frame_window));
+	S->congestion_stats.pending = 0;
+
+/* what got lost will never be acked, don't count it as in flight */
+	S->link.delivered = S->link.flushed;
+
+	D->gen = gen;
+	D->sync = true;
+	D->hold = false;
+	a12int_trace(A12_TRACE_VIDEO, "kind=dgram_sync:gen=%"PRIu8, gen);
+}
+
+/*
+ * Run the records of a unit through the regular packet handlers. The stream
+ * can be in the middle of a packet so that decode state is kept aside, and
+ * with the MAC / cipher state out of the way (and replay set so that
+ * authdec_buffer passes) the handlers work on the plaintext as is.
+ */
+static void dgram_replay(struct a12_state* S, uint8_t* buf, size_t sz,
+	void* tag, void (*on_event)
+	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*))
+{
+	uint8_t state = S->state;
+	uint16_t left = S->left;
+	uint16_t pos = S->decode_pos;
+	int in_channel = S->in_channel;
+	uint8_t* saved = NULL;
+
+	if (pos){
+		saved = DYNAMIC_MALLOC(pos);
+		if (!saved)
+			return;
+		memcpy(saved, S->decode, pos);
+	}
+
+	struct chacha_ctx* dec = S->dec_state;
+	blake3_hasher mac = S->in_mac;
+	S->dec_state = NULL;
+	S->dgram->replay = true;
+
+	for (size_t ofs = 0; ofs + OUTQ_REC_HDR <= sz && S->state != STATE_BROKEN;){
+		uint8_t type = buf[ofs];
+		uint32_t len;
+		unpack_u32(&len, &buf[ofs + 1]);
+		ofs += OUTQ_REC_HDR;
+		if (len > sz - ofs)
+			break;
+
+		uint8_t* data = &buf[ofs];
+		ofs += len;
+		S->in_channel = -1;
+
+		if (type == STATE_CONTROL_PACKET && len == CONTROL_PACKET_SIZE){
+			S->state = type;
+			memcpy(S->decode, data, len);
+			S->decode_pos = len;
+			process_control(S, on_event, tag);
+			continue;
+		}
+
+		bool av = type == STATE_VIDEO_PACKET || type == STATE_AUDIO_PACKET;
+		size_t hsz = av ? header_sizes[type] : 0;
+		if (!av || len < hsz || len - hsz > sizeof(S->decode)){
+			a12int_trace(A12_TRACE_SYSTEM,
+				"kind=error:dgram_record=%d:size=%"PRIu32, (int) type, len);
+			continue;
+		}
+
+/* header, then the data - same as the two stages on the stream */
+		S->state = type;
+		memcpy(S->decode, data, hsz);
+		S->decode_pos = hsz;
+		if (type == STATE_VIDEO_PACKET)
+			process_video(S);
+		else
+			process_audio(S);
+
+		memcpy(S->decode, &data[hsz], len - hsz);
+		S->decode_pos = len - hsz;
+		S->left = 0;
+		if (type == STATE_VIDEO_PACKET)
+			process_video(S);
+		else
+			process_audio(S);
+	}
+
+	S->dgram->replay = false;
+	S->dec_state = dec;
+	S->in_mac = mac;
+
+	if (S->state != STATE_BROKEN){
+		S->state = state;
+		S->left = left;
+		S->decode_pos = pos;
+		S->in_channel = in_channel;
+		if (pos)
+			memcpy(S->decode, saved, pos);
+	}
+	DYNAMIC_FREE(saved);
+}
+
+/* sliding window over the last 64 sequence numbers */
+static bool dgram_window(struct a12_dgram* D, uint64_t seq, bool mark)
+{
+	if (seq > D->rx_top){
+		if (mark){
+			uint64_t step = seq - D->rx_top;
+			D->rx_mask = (step >= 64 ? 0 : D->rx_mask << step) | 1;
+			D->rx_top = seq;
+		}
+		return true;
+	}
+
+	uint64_t back = D->rx_top - seq;
+	if (back >= 64 || (D->rx_mask & ((uint64_t) 1 << back)))
+		return false;
+
+	if (mark)
+		D->rx_mask |= (uint64_t) 1 << back;
+	return true;
+}
+
+static void dgram_deliver(struct a12_state* S, struct dgram_slot* slot,
+	void* tag, void (*on_event)
+	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*))
+{
+	struct a12_dgram* D = S->dgram;
+	D->rx_next[slot->cls] = slot->unit + 1;
+	D->rx_started[slot->cls] = true;
+
+	struct dgram_slot cur = *slot;
+	*slot = (struct dgram_slot){};
+	dgram_replay(S, cur.buf, cur.size, tag, on_event);
+	DYNAMIC_FREE(cur.buf);
+}
+
+/*
+ * The fragments of a unit go out back to back, if one has been left without
+ * any for a while then the rest are not coming. Anything not delivered is
+ * either incomplete or waiting for one that is.
+ */
+static void dgram_stale(struct a12_state* S)
+{
+	struct a12_dgram* D = S->dgram;
+	if (!D->rx_switched || D->rx_wait)
+		return;
+
+	uint64_t now = arcan_timemillis();
+	for (size_t i = 0; i < DGRAM_SLOTS; i++){
+		struct dgram_slot* slot = &D->slots[i];
+		if (slot->used && slot->cls == DGRAM_VIDEO && now - slot->ts > DGRAM_LOSS_MS){
+			dgram_loss(S);
+			return;
+		}
+	}
+}
+
+/* deliver units of [cls] for as long as the next one is complete */
+static void dgram_resume(struct a12_state* S, uint8_t cls,
+	void* tag, void (*on_event)
+	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*))
+{
+	struct a12_dgram* D = S->dgram;
+
+	for (bool more = true; more && S->state != STATE_BROKEN;){
+		more = false;
+		for (size_t i = 0; i < DGRAM_SLOTS; i++){
+			struct dgram_slot* slot = &D->slots[i];
+			if (slot->used && slot->cls == cls &&
+				slot->unit == D->rx_next[cls] && slot->got == slot->size){
+				dgram_deliver(S, slot, tag, on_event);
+				more = true;
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Audio goes out as soon as a unit is complete, anything older still in
+ * reassembly is dropped. Video is delivered strictly in order, one unit
+ * completing ahead of the next expected can wait for that one, more than that
+ * and the missing one is considered lost. While waiting for a sync unit the
+ * units that follow it are only collected.
+ */
+static void dgram_complete(struct a12_state* S, struct dgram_slot* slot,
+	void* tag, void (*on_event)
+	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*))
+{
+	struct a12_dgram* D = S->dgram;
+	uint8_t cls = slot->cls;
+
+	if (cls == DGRAM_AUDIO){
+		for (size_t i = 0; i < DGRAM_SLOTS; i++){
+			if (D->slots[i].used && D->slots[i].cls == cls &&
+				D->slots[i].unit < slot->unit){
+				DYNAMIC_FREE(D->slots[i].buf);
+				D->slots[i] = (struct dgram_slot){};
+			}
+		}
+		dgram_deliver(S, slot, tag, on_event);
+		return;
+	}
 
+	if (D->rx_wait)
+		return;
+
+	if (slot->unit == D->rx_next[cls])
+		dgram_resume(S, cls, tag, on_event);
+	else if (slot->unit - D->rx_next[cls] > 1)
+		dgram_loss(S);
+}
+
+static struct dgram_slot* dgram_slot(struct a12_state* S,
+	uint8_t cls, uint8_t gen, uint32_t unit, uint32_t size)
+{
+	struct a12_dgram* D = S->dgram;
+	struct dgram_slot* free_slot = NULL;
+	struct dgram_slot* oldest = NULL;
+
+	for (size_t i = 0; i < DGRAM_SLOTS; i++){
+		struct dgram_slot* slot = &D->slots[i];
+		if (!slot->used){
+			if (!free_slot)
+				free_slot = slot;
+			continue;
+		}
+
+		if (slot->cls == cls && slot->unit == unit)
+			return slot->size == size ? slot : NULL;
+
+		if (!oldest || (slot->cls == cls &&
+			(oldest->cls != cls || slot->unit < oldest->unit)))
+			oldest = slot;
+	}
+
+/* evicting an incomplete video unit is the same as it being lost */
+	if (!free_slot){
+		bool lost = oldest->cls == DGRAM_VIDEO;
+		DYNAMIC_FREE(oldest->buf);
+		*oldest = (struct dgram_slot){};
+		free_slot = oldest;
+		if (lost)
+			dgram_loss(S);
+	}
+
+	uint8_t* buf = DYNAMIC_MALLOC(size);
 	if (!buf){
-		a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=ENOMEM");
-		*die = true;
+		a12int_trace(A12_TRACE_ALLOC, "kind=error:dgram_unit=%"PRIu32, size);
 		return NULL;
 	}
 
-	ssize_t nr = read(fd, buf, cap);
+	*free_slot = (struct dgram_slot){
+		.used = true,
+		.cls = cls,
+		.gen = gen,
+		.unit = unit,
+		.size = size,
+		.buf = buf
+	};
+	return free_slot;
+}
+
+bool a12_datagram_unpack(struct a12_state* S,
+	const uint8_t* buf, size_t buf_sz, void* tag, void (*on_event)
+	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*))
+{
+	struct a12_dgram* D = S->dgram;
+	if (!D || S->state == STATE_BROKEN ||
+		buf_sz < DGRAM_HDR + DGRAM_INNER || buf_sz > DGRAM_MTU_MAX)
+		return false;
+
+	uint64_t seq;
+	memcpy(D->pkt, buf, buf_sz);
+	unpack_u64(&seq, &D->pkt[MAC_BLOCK_SZ]);
+	if (!dgram_window(D, seq, false))
+		return false;
+
+	uint8_t mac[MAC_BLOCK_SZ];
+	dgram_mac(D->mac_in, &D->pkt[MAC_BLOCK_SZ], buf_sz - MAC_BLOCK_SZ, mac);
+	if (memcmp(mac, D->pkt, MAC_BLOCK_SZ) != 0){
+		a12int_trace(A12_TRACE_CRYPTO, "kind=dgram_bad_mac:seq=%"PRIu64, seq);
+		return false;
+	}
+	dgram_window(D, seq, true);
+	dgram_stale(S);
+
+	uint8_t* inner = &D->pkt[DGRAM_HDR];
+	size_t n = buf_sz - DGRAM_HDR - DGRAM_INNER;
+	dgram_cipher(D, D->key_in, &D->pkt[MAC_BLOCK_SZ]);
+	chacha_apply(&D->cipher, inner, DGRAM_INNER + n);
+	S->stats.b_in += buf_sz;
+
+	uint8_t cls = inner[0];
+	uint8_t gen = inner[1];
+	uint32_t unit, size, ofs;
+	unpack_u32(&unit, &inner[2]);
+	unpack_u32(&size, &inner[6]);
+	unpack_u32(&ofs, &inner[10]);
+
+	if (cls == DGRAM_PROBE)
+		return true;
+
+	if (cls > DGRAM_VIDEO || !size ||
+		size > DGRAM_UNIT_CAP || ofs > size || n > size - ofs){
+		a12int_trace(A12_TRACE_SYSTEM,
+			"kind=error:dgram_class=%d:size=%"PRIu32, (int) cls, size);
+		return true;
+	}
+
+/* nothing until whatever came over the stream is done, video from before the
+ * last refresh builds on state that is gone and while waiting for the sync
+ * unit there is no telling where the next one starts */
+	if (!D->rx_switched || (cls == DGRAM_VIDEO && gen != D->rx_gen))
+		return true;
+
+	if (D->rx_started[cls] &&
+		!(cls == DGRAM_VIDEO && D->rx_wait) && unit < D->rx_next[cls])
+		return true;
+
+	struct dgram_slot* slot = dgram_slot(S, cls, gen, unit, size);
+	if (!slot)
+		return true;
+
+/* the loss from evicting may have started a new refresh */
+	if (cls == DGRAM_VIDEO && gen != D->rx_gen){
+		DYNAMIC_FREE(slot->buf);
+		*slot = (struct dgram_slot){};
+		return true;
+	}
+
+	memcpy(&slot->buf[ofs], &inner[DGRAM_INNER], n);
+	slot->got += n;
+	slot->ts = arcan_timemillis();
+
+	if (slot->got >= slot->size)
+		dgram_complete(S, slot, tag, on_event);
+
+	return true;
+}
+
+static void command_datagram(struct a12_state* S, void* tag, void (*on_event)
+	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*))
+{
+	struct a12_dgram* D = S->dgram;
+	if (!D){
+		a12int_trace(A12_TRACE_SECURITY, "datagram:not_negotiated");
+		return;
+	}
+
+	switch (S->decode[18]){
+	case DGRAM_OP_PORT:
+		unpack_u16(&D->port, &S->decode[19]);
+		a12int_trace(A12_TRACE_SYSTEM, "kind=dgram_port:port=%"PRIu16, D->port);
+	break;
+
+/* the stream is in order, so any a/v sent over it has been processed */
+	case DGRAM_OP_SWITCH:
+		D->rx_switched = true;
+		D->rx_wait = true;
+		D->rx_gen++;
+		dgram_request(S);
+	break;
+	case DGRAM_OP_REFRESH:
+		if (D->enabled)
+			dgram_refresh(S, S->decode[19]);
+	break;
+
+/* the sync unit has been through the stream, continue with what has been
+ * collected of the units after it */
+	case DGRAM_OP_SYNCED:{
+		uint32_t next;
+		unpack_u32(&next, &S->decode[20]);
+		if (!D->rx_wait || S->decode[19] != D->rx_gen)
+			break;
+
+		for (size_t i = 0; i < DGRAM_SLOTS; i++){
+			struct dgram_slot* slot = &D->slots[i];
+			if (slot->used && slot->cls == DGRAM_VIDEO &&
+				(slot->gen != D->rx_gen || slot->unit < next)){
+				DYNAMIC_FREE(slot->buf);
+				*slot = (struct dgram_slot){};
+			}
+		}
+
+		D->rx_wait = false;
+		D->rx_next[DGRAM_VIDEO] = next;
+		D->rx_started[DGRAM_VIDEO] = true;
+		dgram_resume(S, DGRAM_VIDEO, tag, on_event);
+	}
+	break;
+	default:
+		a12int_trace(A12_TRACE_SYSTEM, "datagram:unknown_op=%d", (int) S->decode[18]);
+	break;
+	}
+}
+
+bool a12_datagram_ready(struct a12_state* S)
+{
+	return S && S->cookie == 0xfeedface && S->dgram;
+}
+
+void a12_datagram_announce(struct a12_state* S, uint16_t port)
+{
+	if (!a12_datagram_ready(S))
+		return;
+
+	uint8_t outb[CONTROL_PACKET_SIZE];
+	build_control_header(S, outb, COMMAND_DATAGRAM);
+	outb[18] = DGRAM_OP_PORT;
+	pack_u16(port, &outb[19]);
+	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+}
+
+uint16_t a12_datagram_port(struct a12_state* S)
+{
+	return a12_datagram_ready(S) ? S->dgram->port : 0;
+}
+
+/*
+ * Whatever a/v is queued goes on the stream ahead of the switch, then the
+ * queues are held until the other end has seen it and asks for a refresh.
+ */
+bool a12_datagram_enable(struct a12_state* S, size_t mtu)
+{
+	if (!a12_datagram_ready(S) || S->opts->sink || S->state == STATE_BROKEN)
+		return false;
+
+	struct a12_dgram* D = S->dgram;
+	if (mtu < DGRAM_MTU_MIN)
+		mtu = DGRAM_MTU_MIN;
+	else if (mtu > DGRAM_MTU_MAX)
+		mtu = DGRAM_MTU_MAX;
+	D->mtu = mtu;
+
+	if (D->enabled)
+		return true;
+
+	venc_sync(S);
+	outq_commit(S, SIZE_MAX);
+
+	D->enabled = true;
+	D->hold = true;
+
+	uint8_t outb[CONTROL_PACKET_SIZE];
+	build_control_header(S, outb, COMMAND_DATAGRAM);
+	outb[18] = DGRAM_OP_SWITCH;
+	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+
+	a12int_trace(A12_TRACE_SYSTEM, "kind=dgram_enable:mtu=%zu", mtu);
+	return true;
+}
+
+size_t a12_datagram_flush(struct a12_state* S, uint8_t** buf)
+{
+	if (!a12_datagram_ready(S) || S->state == STATE_BROKEN)
+		return 0;
+
+	struct a12_dgram* D = S->dgram;
+	dgram_stale(S);
+
+	if (D->out_ofs == D->out_used && D->enabled){
+		D->out_ofs = D->out_used = 0;
+		venc_collect(S);
+		dgram_commit(S);
+	}
+
+	if (D->out_ofs == D->out_used)
+		return 0;
+
+	uint16_t len;
+	unpack_u16(&len, &D->out[D->out_ofs]);
+	*buf = &D->out[D->out_ofs + 2];
+	D->out_ofs += 2 + len;
+	D->queued -= len;
+	link_sent(S, len);
+
+	return len;
+}
+
+void a12_datagram_probe(struct a12_state* S)
+{
+	if (!a12_datagram_ready(S) || S->state == STATE_BROKEN)
+		return;
+
+	if (!dgram_emit(S, DGRAM_PROBE, 0, 0, 0, NULL, 0))
+		fail_state(S);
+}
+
+/* helper that just forwards to set-destination */
+void a12_set_destination(
+	struct a12_state* S, struct arcan_shmif_cont* wnd, uint8_t chid)
+{
+	if (!S){
+		a12int_trace(A12_TRACE_DEBUG, "invalid set_destination call");
+		return;
+	}
+
+	a12int_vdec_sync(S, chid);
+	if (S->channels[chid].active == CHANNEL_RAW){
+		DYNAMIC_FREE(S->channels[chid].cont);
+		S->channels[chid].cont = NULL;
+	}
+
+	S->channels[chid].cont = wnd;
+	S->channels[chid].active = wnd ? CHANNEL_SHMIF : CHANNEL_INACTIVE;
+}
+
+void a12_set_destination_raw(struct a12_state* S,
+	uint8_t chid, struct a12_unpack_cfg cfg, size_t cfg_sz)
+{
+/* the reason for this rather odd design is that non-shmif based receiver was
+ * an afterthought, and it was a much larger task refactoring it out versus
+ * adding a proxy and tagging */
+	size_t ct_sz = sizeof(struct arcan_shmif_cont);
+	struct arcan_shmif_cont* fake = DYNAMIC_MALLOC(ct_sz);
+	if (!fake)
+		return;
+
+	*fake = (struct arcan_shmif_cont){};
+	a12int_vdec_sync(S, chid);
+	S->channels[chid].cont = fake;
+	S->channels[chid].raw = cfg;
+	S->channels[chid].active = CHANNEL_RAW;
+
+/* these are tracked per context and not per channel */
+	S->on_discover = cfg.on_discover;
+	S->discover_tag = cfg.on_discover_tag;
+}
+
+void
+a12_unpack(struct a12_state* S, const uint8_t* buf,
+	size_t buf_sz, void* tag, void (*on_event)
+	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*))
+{
+	if (S->state == STATE_BROKEN){
+		a12int_trace(A12_TRACE_SYSTEM,
+			"kind=error:status=EINVAL:message=state machine broken");
+		fail_state(S);
+		return;
+	}
+
+/* signal what the decode worker has finished since last time */
+	a12int_vdec_collect(S);
+
+/* flush any prequeued buffer, see comment at the end of the function */
+	if (S->prepend_unpack){
+		uint8_t* tmp_buf = S->prepend_unpack;
+		size_t tmp_sz = S->prepend_unpack_sz;
+		a12int_trace(A12_TRACE_SYSTEM, "kind=prebuf:size=%zu", tmp_sz);
+		S->prepend_unpack_sz = 0;
+		S->prepend_unpack = NULL;
+		a12_unpack(S, tmp_buf, tmp_sz, tag, on_event);
+		DYNAMIC_FREE(tmp_buf);
+	}
+
+/* Unknown state? then we're back waiting for a command packet */
+	if (S->left == 0)
+		reset_state(S);
+
+/* iteratively flush, we tail- recurse should the need arise, optimization
+ * here would be to forward buf immediately if it fits - saves a copy */
+	size_t ntr = buf_sz > S->left ? S->left : buf_sz;
+
+	memcpy(&S->decode[S->decode_pos], buf, ntr);
+
+	S->left -= ntr;
+	S->decode_pos += ntr;
+	buf_sz -= ntr;
+	S->stats.b_in += ntr;
+
+/* do we need to buffer more? */
+	if (S->left)
+		return;
+
+/* otherwise dispatch based on state */
+	switch(S->state){
+	case STATE_1STSRV_PACKET:
+		process_srvfirst(S);
+	break;
+	case STATE_NOPACKET:
+		process_nopacket(S);
+	break;
+	case STATE_CONTROL_PACKET:
+		process_control(S, on_event, tag);
+	break;
+	case STATE_EVENT_PACKET:
+		process_event(S, tag, on_event);
+	break;
+	case STATE_EVENTC_PACKET:
+		process_event_compact(S, tag, on_event);
+	break;
+/* worth noting is that these (a,v,b) have different buffer sizes for their
+ * respective packets, so the authentication and decryption steps are somewhat
+ * different */
+	case STATE_VIDEO_PACKET:
+		process_video(S);
+	break;
+	case STATE_AUDIO_PACKET:
+		process_audio(S);
+	break;
+	case STATE_BLOB_PACKET:
+		process_blob(S);
+	break;
+	default:
+		a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=EINVAL:message=bad command");
+		fail_state(S);
+		return;
+	break;
+	}
+
+/* This is an ugly thing - so a buffer can contain a completed authentication
+ * sequence and subsequent data. An API consumer may well need to do additional
+ * work in between completed authentication and proper use or data might get
+ * lost. The easiest way to solve this after the fact was to add a latched
+ * buffer stage.
+ *
+ *  on_authentication_completed:
+ *   - set latched state
+ *   - if data remaining: save a copy and return
+ *
+ *  next unpack:
+ *   - check if buffered data exist
+ *   - process first, then move on to submitted buffer
+ */
+	if (buf_sz){
+		if (!S->auth_latched){
+			a12_unpack(S, &buf[ntr], buf_sz, tag, on_event);
+			return;
+		}
+
+		S->auth_latched = false;
+		S->prepend_unpack = DYNAMIC_MALLOC(buf_sz);
+
+		if (!S->prepend_unpack){
+			a12int_trace(A12_TRACE_ALLOC, "kind=error:latch_buffer_sz=%zu", buf_sz);
+			fail_state(S);
+			return;
+		}
+
+		a12int_trace(A12_TRACE_SYSTEM, "kind=auth_latch:size=%zu", buf_sz);
+		memcpy(S->prepend_unpack, &buf[ntr], buf_sz);
+		S->prepend_unpack_sz = buf_sz;
+		return;
+	}
+	if (S->auth_latched)
+		S->auth_latched = false;
+}
+
+/*
+ * Several small issues that should be looked at here, one is that we don't
+ * multiplex well with the source, risking a non-block 100% spin. Second is
+ * that we don't have an intermediate buffer as part of the queue-node, meaning
+ * that we risk sending very small blocks of data as part of the stream,
+ * wasting bandwidth.
+ */
+/* [ofs] is set for file-backed sources, read from there and advance */
+static void* read_data(int fd, uint64_t* ofs, size_t cap, uint16_t* nts, bool* die)
+{
+	void* buf = DYNAMIC_MALLOC(65536);
+	*nts = 0;
+
+	if (!buf){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=ENOMEM");
+		*die = true;
+		return NULL;
+	}
+
+	ssize_t nr = ofs ? pread(fd, buf, cap, *ofs) : read(fd, buf, cap);
+
+/* possibly non-fatal or no data present yet, keep stream alive - a bad stream
+ * source with no timeout will block / preempt other binary transfers though so
+ * might need to consider reordering in that case. */
+	if (-1 == nr){
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			*die = false;
+		else
+			*die = true;
+
+		DYNAMIC_FREE(buf);
+		return NULL;
+	}
+
+	*die = false;
+	if (nr == 0){
+		DYNAMIC_FREE(buf);
+		return NULL;
+	}
+
+	*nts = nr;
+	if (ofs)
+		*ofs += nr;
+	return buf;
+}
+
+static void unlink_node(struct a12_state* S, struct blob_out* node)
+{
+	/* find the owner of the node, redirect next */
+	/* close the socket and other resources */
+	struct blob_out* next = node->next;
+	struct blob_out** dst = &S->pending;
+
+	while (*dst != node && *dst){
+		dst = &((*dst)->next);
+	}
+
+	if (*dst != node){
+		a12int_trace(A12_TRACE_SYSTEM, "couldn't not unlink node");
+		return;
+	}
+
+	a12int_trace(A12_TRACE_ALLOC, "unlinked:stream=%"PRIu64, node->streamid);
+
+	S->active_blobs--;
+	*dst = next;
+	close(node->fd);
+	if (node->zstd){
+		ZSTD_freeCCtx(node->zstd);
+		node->zstd = NULL;
+	}
+
+	DYNAMIC_FREE(node);
+}
+
+/*
+ * tail-recurse back into queue_node until the
+ */
+static size_t queue_node(struct a12_state* S, struct blob_out* node);
+static bool flush_compressed(
+	struct a12_state* S, struct blob_out* node, char* buf, size_t nts)
+{
+	uint8_t outb[1 + 4 + 2];
+	outb[0] = node->chid;
+	pack_u32(node->streamid, &outb[1]);
+
+	if (!node->left && !nts){
+		a12int_trace(A12_TRACE_BTRANSFER,
+			"kind=compressed_stream_over:stream=%zu:ch=%d",
+			(size_t)node->streamid, (int) node->chid
+		);
+		return false;
+	}
+
+/* Nts and buffer size comes from the read function and its static upper buffer
+ * bound, this is mainly to balance between interleaving (higher prio data) and
+ * throughput. An external oracle should be allowed to influence this using
+ * transport information on bandwidth and MTUs. There are better (?) ways of
+ * using ZSTD here, but all are quite complicated. The problem is the normal of
+ * chunking+metadata and the discrepancy between bytes in vs bytes out. A
+ * trivially compressible input set might just yield a byte or two for a full
+ * input buffer, yet we will 'terminate' compression and send of a chunk with
+ * header regardless - reducing efficiency.
+ *
+ * The flow here might be unintuitive but -
+ *  - a12_flush checks if there is space to interleave binary data
+ *  - if so, append_blob will check if there is a binary transfer queued
+ *    it picks this in first come first server order, but could be reordered
+ *  - it enters queue_node which reads up to a cap of bytes into a buffer
+ *  - this buffer is forwarded to flush_compressed or uncompressed depending
+ *    on the zstd- context availability which should be setup when the stream
+ *    is initialised.
+ *  - we arrive here, compress and flush whatever is provided, and return if
+ *    there is more data to be processed (the nts for the blob stream)
+ *    and if there isn't, queue_node will unlink and free us.
+ *  - otherwise a12int_append_out will increase the outgoing buffer that
+ *    a12_flush checks, and the cycle repeats itself.
+ * */
+
+	size_t max = ZSTD_compressBound(nts);
+	if (max >= 65536){
+		a12int_trace(A12_TRACE_SYSTEM,
+			"kind=compressed_stream_overflow:cap=64k:size=%zu", max);
+		return false;
+	}
+
+	void* compressed = DYNAMIC_MALLOC(max);
+	size_t out = ZSTD_compressCCtx(node->zstd, compressed, max, buf, nts, 3);
+	pack_u16(out, &outb[5]);
+
+	a12int_append_out(S,
+		STATE_BLOB_PACKET, (uint8_t*) compressed, out, outb, sizeof(outb));
+
+	DYNAMIC_FREE(compressed);
+
+	if (node->left){
+		a12int_trace(A12_TRACE_BTRANSFER, "kind=compressed_block:"
+			"stream=%"PRIu64":ch=%d:size=%zu:base=%zu:left=%zu",
+			(uint64_t)node->streamid, (int) node->chid, out, nts, node->left
+		);
+		node->left -= nts;
+		return node->left != 0;
+	}
+
+	a12int_trace(A12_TRACE_BTRANSFER,
+		"kind=compressed_stream=%zu:ch=%d:size=%zu:base=%zu",
+		(size_t)node->streamid, (int) node->chid, out, nts
+	);
+
+	return true;
+}
+
+static bool flush_uncompressed(
+	struct a12_state* S, struct blob_out* node, char* buf, size_t nts)
+{
+	uint8_t outb[1 + 4 + 2];
+	outb[0] = node->chid;
+	pack_u32(node->streamid, &outb[1]);
+	pack_u16(nts, &outb[5]);
+	a12int_append_out(S, STATE_BLOB_PACKET, (uint8_t*) buf, nts, outb, sizeof(outb));
+
+/* if we have a fixed known size .. */
+	if (node->left){
+		node->left -= nts;
+		a12int_trace(A12_TRACE_BTRANSFER,
+			"kind=block:stream=%"PRIu64":ch=%d:size=%zu:left=%zu",
+			node->streamid, (int)node->chid, nts, node->left
+			);
+		return node->left != 0;
+	}
+
+	a12int_trace(A12_TRACE_BTRANSFER,
+		"kind=block:stream=%zu:ch=%d:streaming:size=%zu",
+		(size_t) node->streamid, (int)node->chid, nts
+	);
+
+/* otherwise we are streaming from an unknown source and the EOB determines */
+	return nts != 0;
+}
+
+static size_t begin_bstream(struct a12_state* S, struct blob_out* node)
+{
+	uint8_t outb[CONTROL_PACKET_SIZE];
+
+	build_control_header(S, outb, COMMAND_BINARYSTREAM);
+	outb[16] = node->chid;
+
+	S->out_stream++;
+	pack_u32(S->out_stream, &outb[18]);      /* [18 .. 21] stream-id */
+	pack_u64(node->left, &outb[22]);         /* [22 .. 29] total-size */
+	outb[30] = node->type;
+	pack_u32(node->identifier, &outb[31]);   /* 31..34 : id-token */
+	memcpy(&outb[35], node->checksum, 16);
+
+/* enable compression if possible - zstd has a decent entropy estimator so even
+ * for precompressed source material the overhead isn't that substantial, still
+ * could be added as an option for the bstream creation function but just let
+ * it be the default for now */
+	node->zstd = ZSTD_createCCtx();
+	if (node->zstd){
+		ZSTD_CCtx_setParameter(node->zstd, ZSTD_c_nbWorkers, 4);
+		outb[52] = 1;
+	}
+
+/* only used for two subtypes but will be set to 0 otherwise */
+	memcpy(&outb[53], node->extid, 16);
+
+/* larger files can be resumed, the receiver then answers with where to start */
+	if ((S->remote_features & A12_FEATURE_BSTREAM) &&
+		!node->streaming && !node->buf && node->size > BSTREAM_CHUNK){
+		outb[69] = 1;
+		node->wait_seek = true;
+	}
+
+	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+
+	node->active = true;
+	node->streamid = S->out_stream;
+	a12int_trace(
+		A12_TRACE_BTRANSFER, "kind=created:size=%zu:stream:%"PRIu64":ch=%d",
+		node->left, node->streamid, node->chid
+	);
+
+/* set a small cap for the first packet, and defer the next queue node until
+ * the ack:ed serial has advanced a bit to let the other end cancel before we
+ * push too much so that we don't just burst - better rampup is needed here */
+	return 16384;
+}
+
+static size_t queue_node(struct a12_state* S, struct blob_out* node)
+{
+	uint16_t nts;
+	size_t cap = node->left;
+	if (cap == 0 || cap > 64096)
+		cap = 64096;
+
+	bool die;
+	bool free_buf;
+	char* buf;
+
+/* not activated, so build a header first */
+	if (!node->active){
+		size_t rampup = begin_bstream(S, node);
+		if (node->wait_seek)
+			return CONTROL_PACKET_SIZE;
+
+		if (rampup < cap)
+			cap = rampup;
+	}
+
+/* if we have a non-streaming pre-allocated source, just slice off and keep */
+	if (node->buf){
+		buf = &node->buf[node->buf_sz - node->left];
+		nts = cap;
+		die = false;
+		free_buf = false;
+	}
+	else {
+		buf = read_data(node->fd, node->streaming ? NULL : &node->ofs, cap, &nts, &die);
+		free_buf = true;
+	}
+
+/* streaming or file source that broke before we finished sending it all */
+	if (!buf && (die || !node->zstd)){
+		a12_stream_cancel(S, S->in_channel);
+		if (die){
+			unlink_node(S, node);
+		}
+		return 0;
+	}
+
+/* might not have data to send yet */
+	if (!nts)
+		return nts;
+
+/* keep it around and referenced for being able to revert / disable compression
+ * should some edge case need arise */
+	if (node->zstd)
+		die = !flush_compressed(S, node, buf, nts);
+	else
+		die = !flush_uncompressed(S, node, buf, nts);
+
+	if (free_buf)
+		DYNAMIC_FREE(buf);
+
+	if (die)
+		unlink_node(S, node);
+
+	return nts;
+}
+
+static size_t append_blob(struct a12_state* S, int mode)
+{
+/* find suitable blob */
+	if (mode == A12_FLUSH_NOBLOB || !S->pending)
+		return 0;
+
+/* The last seen seqnr shows how big the window drift is between us and the
+ * other side. Control packets contain sequence numbers, and the last one
+ * seen. When a binary transfer that is likely to be rejected due to being
+ * cached - transfer is delayed until the other end has had enough time to
+ * cancel the stream. */
+	if (
+		S->pending->rampup_seqnr &&
+		S->last_seen_seqnr < S->pending->rampup_seqnr)
+	{
+		return 0;
+	}
+
+/* rotate between the first streams unless they are held back */
+	else if (S->remote_features & A12_FEATURE_BSTREAM){
+		struct blob_out* set[BSTREAM_PARALLEL];
+		struct blob_out* cur = S->pending;
+		size_t n = 0;
+
+		for (size_t i = 0; cur && i < BSTREAM_PARALLEL; i++, cur = cur->next){
+			if (cur->wait_seek ||
+				(mode == A12_FLUSH_CHONLY && cur->chid != S->out_channel) ||
+				(cur->rampup_seqnr && S->last_seen_seqnr < cur->rampup_seqnr))
+				continue;
+			set[n++] = cur;
+		}
+
+		if (!n)
+			return 0;
+
+		return queue_node(S, set[S->blob_rr++ % n]);
+	}
+
+/* only current channel? */
+	else if (mode == A12_FLUSH_CHONLY){
+		struct blob_out* parent = S->pending;
+		while (parent){
+			if (parent->chid == S->out_channel)
+				return queue_node(S, parent);
+			parent = parent->next;
+		}
+		return 0;
+	}
+
+	return queue_node(S, S->pending);
+}
+
+/*
+ * The contract for a12_flush is that the previous buffer has been written out
+ * by the time it is called again, so while there is a backlog the time between
+ * calls estimates how fast the link drains. Without one the link is idle and
+ * the gap says nothing.
+ */
+static void drain_sample(struct a12_state* S)
+{
+	bool backlog = S->buf_ofs ||
+		S->outq[OUTQ_AUDIO].units || S->outq[OUTQ_VIDEO].units;
+
+	if (!S->drain.last_sz || !backlog){
+		S->drain.acc_b = 0;
+		S->drain.acc_ms = 0;
+		S->drain.last_sz = 0;
+		return;
+	}
+
+	uint64_t now = arcan_timemillis();
+	S->drain.acc_b += S->drain.last_sz;
+	S->drain.acc_ms += now > S->drain.last_ts ? now - S->drain.last_ts : 0;
+	S->drain.last_sz = 0;
+
+/* accumulate a few samples to not be thrown off by timer resolution */
+	if (S->drain.acc_ms < 20)
+		return;
+
+	size_t rate = (uint64_t) S->drain.acc_b * 1000 / S->drain.acc_ms;
+	S->drain.rate = S->drain.rate ? (S->drain.rate * 7 + rate) / 8 : rate;
+	S->drain.acc_b = 0;
+	S->drain.acc_ms = 0;
+}
+
+size_t
+a12_flush(struct a12_state* S, uint8_t** buf, int allow_blob)
+{
+	if (S->state == STATE_BROKEN || S->cookie != 0xfeedface)
+		return 0;
+
+	drain_sample(S);
+
+/* input and control is already in the buffer, add what fits of queued a/v */
+	venc_collect(S);
+	outq_commit(S, OUTQ_FLUSH_CAP);
+
+/* Nothing in the outgoing buffer? then we can pull in whatever data transfer
+ * is pending, if there are any queued. Repeat the append- until we have an
+ * outgoing buffer of a certain size. */
+	if (S->buf_ofs == 0){
+		while (allow_blob > A12_FLUSH_NOBLOB &&
+			append_blob(S, allow_blob) && S->buf_ofs < BLOB_QUEUE_CAP){}
+
+		if (!S->buf_ofs)
+			return 0;
+	}
+
+	size_t rv = S->buf_ofs;
+	int old_ind = S->buf_ind;
+
+/* switch out "output buffer" and return how much there is to send, it is
+ * expected that by the next non-0 returning channel_flush, its contents have
+ * been pushed to the other side */
+	*buf = S->bufs[S->buf_ind];
+	S->buf_ofs = 0;
+	S->buf_ind = (S->buf_ind + 1) % 2;
+	a12int_trace(A12_TRACE_ALLOC, "locked %d, new buffer: %d", old_ind, S->buf_ind);
+
+/* the new buffer went out with the previous flush, if a burst grew it and
+ * output is back to normal sizes it gets released and grows again on need */
+	if (S->buf_sz[S->buf_ind] > A12_OUTBUF_TRIM && rv < A12_OUTBUF_TRIM / 4){
+		a12int_trace(A12_TRACE_ALLOC,
+			"trim=buffer:%d:from=%zu", S->buf_ind, S->buf_sz[S->buf_ind]);
+		DYNAMIC_FREE(S->bufs[S->buf_ind]);
+		S->bufs[S->buf_ind] = NULL;
+		S->buf_sz[S->buf_ind] = 0;
+	}
+
+	S->drain.last_sz = rv;
+	S->drain.last_ts = arcan_timemillis();
+	link_sent(S, rv);
+	return rv;
+}
+
+int
+a12_poll(struct a12_state* S)
+{
+	if (!S || S->state == STATE_BROKEN || S->cookie != 0xfeedface)
+		return -1;
+
+	venc_collect(S);
+	a12int_vdec_collect(S);
+	return S->buf_ofs || S->pending ||
+		S->outq[OUTQ_AUDIO].units || S->outq[OUTQ_VIDEO].units ||
+		(S->dgram && S->dgram->queued) ? 1 : 0;
+}
+
+int
+a12_auth_state(struct a12_state* S)
+{
+	return S->authentic;
+}
+
+void
+a12_channel_new(struct a12_state* S,
+	uint8_t chid, uint8_t segkind, uint32_t cookie)
+{
+	uint8_t outb[CONTROL_PACKET_SIZE];
+	build_control_header(S, outb, COMMAND_NEWCH);
+
+	outb[18] = chid;
+	outb[19] = segkind;
+	outb[20] = 0;
+	pack_u32(cookie, &outb[21]);
+
+	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+}
+
+void
+a12_set_channel(struct a12_state* S, uint8_t chid)
+{
+	if (chid != S->out_channel)
+		a12int_trace(A12_TRACE_SYSTEM, "channel_out=%"PRIu8, chid);
+	S->out_channel = chid;
+}
+
+void
+a12_channel_aframe(struct a12_state* S,
+		shmif_asample* buf,
+		size_t n_samples,
+		struct a12_aframe_cfg cfg,
+		struct a12_aframe_opts opts)
+{
+	if (!S || S->cookie != 0xfeedface || S->state == STATE_BROKEN)
+		return;
+
+/* use a fix size now as the outb- writer lacks queueing and interleaving */
+	size_t chunk_sz = 16428;
+
+	a12int_trace(A12_TRACE_AUDIO,
+		"encode %zu samples @ %"PRIu32" Hz /%"PRIu8" ch",
+		n_samples, cfg.samplerate, cfg.channels
+	);
+	outq_open(S, OUTQ_AUDIO);
+	if (opts.method != AFRAME_METHOD_OPUS ||
+		!(S->remote_features & A12_FEATURE_OPUS) ||
+		!a12int_encode_aopus(S, S->out_channel, buf, n_samples/2, cfg, opts, chunk_sz))
+		a12int_encode_araw(S, S->out_channel, buf, n_samples/2, cfg, opts, chunk_sz);
+	outq_close(S);
+}
+
+int a12_audio_step(struct a12_state* S)
+{
+	if (!S || S->cookie != 0xfeedface || S->state == STATE_BROKEN)
+		return -1;
+
+	int next = -1;
+	uint64_t now = a12int_media_clock();
+
+	for (size_t i = 0; i < 256; i++){
+		if (!S->channels[i].jitter)
+			continue;
+
+		int ms = a12int_audio_playout(S, &S->channels[i], now);
+		if (ms >= 0 && (next == -1 || ms < next))
+			next = ms;
+	}
+
+	return next;
+}
+
+/*
+ * Forward one region of [vb] to the encoder that match the set opts.
+ */
+static bool vframe_encode(struct a12_state* S,
+	struct shmifsrv_vbuffer* vb, struct a12_vframe_opts opts, int chid,
+	uint32_t sid, size_t x, size_t y, size_t w, size_t h, size_t chunk_sz)
+{
+	a12int_trace(A12_TRACE_VIDEO,
+		"out vframe: %zu*%zu @%zu,%zu+%zu,%zu", vb->w, vb->h, w, h, x, y);
+#define argstr S, vb, opts, sid, x, y, w, h, chunk_sz, chid
+
+/* we have a pre-compressed passthrough - send it with the FOURCC stored
+ * in place of expanded length and just send the buffer as is */
+	if (vb->flags.compressed)
+		a12int_encode_passthrough(argstr);
+	else
+	switch(opts.method){
+	case VFRAME_METHOD_RAW_RGB565:
+		a12int_encode_rgb565(argstr);
+	break;
+	case VFRAME_METHOD_NORMAL:
+		if (vb->flags.ignore_alpha)
+			a12int_encode_rgb(argstr);
+		else
+			a12int_encode_rgba(argstr);
+	break;
+	case VFRAME_METHOD_RAW_NOALPHA:
+		a12int_encode_rgb(argstr);
+	break;
+/* these are the same, the encoder will pick which based on ref. frame */
+	case VFRAME_METHOD_ZSTD:
+	case VFRAME_METHOD_DZSTD:
+		a12int_encode_dzstd(argstr);
+	break;
+	case VFRAME_METHOD_H264:
+		a12int_encode_h264(argstr);
+	break;
+	case VFRAME_METHOD_TPACK_ZSTD:
+		a12int_encode_ztz(argstr);
+	break;
+	case VFRAME_METHOD_TILES:
+		a12int_encode_tiles(argstr);
+	break;
+	default:
+		a12int_trace(A12_TRACE_SYSTEM, "unknown format: %d\n", opts.method);
+		return false;
+	break;
+	}
+
+	return true;
+}
+
+static bool raw_or_delta(int method)
+{
+	return method == VFRAME_METHOD_RAW_RGB565 ||
+		method == VFRAME_METHOD_NORMAL ||
+		method == VFRAME_METHOD_RAW_NOALPHA ||
+		method == VFRAME_METHOD_ZSTD ||
+		method == VFRAME_METHOD_DZSTD;
+}
+
+static void venc_run(struct a12_state* S, struct venc_job* job)
+{
+	size_t now = arcan_timemillis();
+	venc_job = job;
+
+	if (job->reset_delta)
+		a12int_encode_reset_delta(S, job->chid);
+
+	for (size_t i = 0; i < job->n_regions && !job->failed; i++){
+		struct arcan_shmif_region* r = &job->regions[i];
+		job->defer_commit = i < job->n_regions - 1;
+
+		if (!vframe_encode(S, &job->vb, job->opts, job->chid, job->sid + i,
+			r->x1, r->y1, r->x2 - r->x1, r->y2 - r->y1, job->chunk_sz))
+			job->failed = true;
+	}
+
+	venc_job = NULL;
+	size_t then = arcan_timemillis();
+	job->ms = then > now ? then - now : 0;
+}
+
+static void* venc_thread(void* tag)
+{
+	struct a12_state* S = tag;
+	struct a12_venc* V = S->venc;
+
+	pthread_mutex_lock(&V->lock);
+	for(;;){
+		while (!V->queue && !V->shutdown)
+			pthread_cond_wait(&V->cond, &V->lock);
+
+		if (V->shutdown)
+			break;
+
+		struct venc_job* job = V->queue;
+		V->queue = job->next;
+		job->next = NULL;
+		V->active = true;
+		pthread_mutex_unlock(&V->lock);
+
+		venc_run(S, job);
+
+/* only signal when there was nothing waiting to be collected already */
+		pthread_mutex_lock(&V->lock);
+		bool signal = !V->done;
+		struct venc_job** tail = &V->done;
+		while (*tail)
+			tail = &(*tail)->next;
+		*tail = job;
+		V->active = false;
+		pthread_cond_broadcast(&V->cond);
+
+		if (V->ready && signal){
+			pthread_mutex_unlock(&V->lock);
+			V->ready(S, V->tag);
+			pthread_mutex_lock(&V->lock);
+		}
+	}
+	pthread_mutex_unlock(&V->lock);
+
+	return NULL;
+}
+
+static void venc_release(struct a12_venc* V, struct venc_job* job)
+{
+	V->in_flight--;
+
+/* keep one around as the frame-sized buffers are expensive to get */
+	if (!V->spare){
+		job->out.used = job->out.ofs = job->out.unit_start = 0;
+		job->next = NULL;
+		V->spare = job;
+		return;
+	}
+
+	free(job->vb.buffer);
+	DYNAMIC_FREE(job->out.buf);
+	free(job);
+}
+
+/*
+ * Fold the size of an encoded frame into the estimates that adaptive method
+ * selection works from. Only frames using the method it picked count, that
+ * covers frames that were queued before a switch.
+ */
+static void adapt_feedback(
+	struct a12_state* S, uint8_t chid, int method, size_t bytes, size_t n_px)
+{
+	struct a12_channel* ch = &S->channels[chid];
+	if (!ch->adapt.method || ch->adapt.method != method || !n_px)
+		return;
+
+	size_t ratio = bytes * 256 / (n_px * 3);
+	if (ratio > 512)
+		ratio = 512;
+
+	ch->adapt.bytes = (ch->adapt.bytes * 3 + bytes) / 4;
+	ch->adapt.ratio = (ch->adapt.ratio * 3 + ratio) / 4;
+}
+
+/*
+ * Move finished jobs into the video outq in the order they were submitted,
+ * replaying the stream steps the encoders made.
+ */
+static void venc_collect(struct a12_state* S)
+{
+	struct a12_venc* V = S->venc;
+	if (!V)
+		return;
+
+	pthread_mutex_lock(&V->lock);
+	struct venc_job* job = V->done;
+	V->done = NULL;
+	pthread_mutex_unlock(&V->lock);
+
+	while (job){
+		struct venc_job* next = job->next;
+		struct a12_outq* Q = &job->out;
+
+		if (job->failed)
+			a12int_trace(A12_TRACE_VIDEO, "kind=error:message=venc job failed");
+
+		outq_open(S, OUTQ_VIDEO);
+		for (size_t ofs = 0; ofs < Q->used && S->state != STATE_BROKEN;){
+			uint8_t type = Q->buf[ofs];
+			uint32_t len;
+			unpack_u32(&len, &Q->buf[ofs + 1]);
+			uint8_t* data = &Q->buf[ofs + OUTQ_REC_HDR];
+			ofs += OUTQ_REC_HDR + len;
+
+			if (type == VENC_STEP){
+				uint32_t id;
+				unpack_u32(&id, data);
+				track_vstream(S, id);
+			}
+			else
+				a12int_append_out(S, type, data, len, NULL, 0);
+		}
+		outq_close(S);
+
+		adapt_feedback(S, job->chid, job->opts.method, job->out.used, job->n_px);
+		S->stats.ms_vframe = job->ms;
+		if (job->n_px)
+			S->stats.ms_vframe_px = (float)job->ms / (float)job->n_px;
+
+		venc_release(V, job);
+		job = next;
+	}
+}
+
+/* wait for the worker to finish everything queued and collect the results,
+ * needed before anything else touches the encoder state of a channel */
+static void venc_sync(struct a12_state* S)
+{
+	struct a12_venc* V = S->venc;
+	if (!V)
+		return;
+
+	pthread_mutex_lock(&V->lock);
+	while (V->queue || V->active)
+		pthread_cond_wait(&V->cond, &V->lock);
+	pthread_mutex_unlock(&V->lock);
+
+	venc_collect(S);
+}
+
+static void venc_stop(struct a12_state* S)
+{
+	struct a12_venc* V = S->venc;
+	if (!V)
+		return;
+
+	venc_sync(S);
+	pthread_mutex_lock(&V->lock);
+	V->shutdown = true;
+	pthread_cond_broadcast(&V->cond);
+	pthread_mutex_unlock(&V->lock);
+	pthread_join(V->thread, NULL);
+
+	pthread_mutex_destroy(&V->lock);
+	pthread_cond_destroy(&V->cond);
+
+	if (V->spare){
+		free(V->spare->vb.buffer);
+		DYNAMIC_FREE(V->spare->out.buf);
+		free(V->spare);
+	}
+
+	DYNAMIC_FREE(V);
+	S->venc = NULL;
+}
 
-/* possibly non-fatal or no data present yet, keep stream alive - a bad stream
- * source with no timeout will block / preempt other binary transfers though so
- * might need to consider reordering in that case. */
-	if (-1 == nr){
-		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
-			*die = false;
-		else
-			*die = true;
+/*
+ * Copy what the encoders need from [vb] and queue it for the worker. The rows
+ * outside of the damaged area are left as is for the methods that only look
+ * at the regions.
+ */
+static void venc_submit(struct a12_state* S, struct shmifsrv_vbuffer* vb,
+	struct a12_vframe_opts opts, struct arcan_shmif_region* regions,
+	size_t n_regions, size_t chunk_sz, bool reset_delta)
+{
+	struct a12_venc* V = S->venc;
 
-		DYNAMIC_FREE(buf);
-		return NULL;
+/* passthrough is never dropped, so wait for room */
+	if (V->in_flight >= VENC_QUEUE_LIM)
+		venc_sync(S);
+
+	struct venc_job* job = V->spare;
+	if (job)
+		V->spare = NULL;
+	else if (!(job = malloc(sizeof(struct venc_job)))){
+		a12int_trace(A12_TRACE_ALLOC, "kind=error:message=venc job alloc");
+		return;
+	}
+	else
+		*job = (struct venc_job){};
+
+	size_t nb = vb->flags.compressed ? vb->buffer_sz : vb->stride * vb->h;
+	if (job->vb_sz < nb){
+		free(job->vb.buffer);
+		job->vb.buffer = malloc(nb);
+		job->vb_sz = job->vb.buffer ? nb : 0;
+
+		if (!job->vb.buffer){
+			a12int_trace(A12_TRACE_ALLOC, "kind=error:message=venc buffer alloc");
+			DYNAMIC_FREE(job->out.buf);
+			free(job);
+			return;
+		}
 	}
 
-	*die = false;
-	if (nr == 0){
-		DYNAMIC_FREE(buf);
-		return NULL;
+	uint8_t* dst = job->vb.buffer_bytes;
+	struct arcan_shmif_region bb = regions[0];
+	for (size_t i = 1; i < n_regions; i++){
+		bb.y1 = regions[i].y1 < bb.y1 ? regions[i].y1 : bb.y1;
+		bb.y2 = regions[i].y2 > bb.y2 ? regions[i].y2 : bb.y2;
 	}
 
-	*nts = nr;
-	return buf;
+	if (!vb->flags.compressed && raw_or_delta(opts.method))
+		memcpy(&dst[bb.y1 * vb->stride],
+			&vb->buffer_bytes[bb.y1 * vb->stride], (bb.y2 - bb.y1) * vb->stride);
+	else
+		memcpy(dst, vb->buffer_bytes, nb);
+
+	job->vb = *vb;
+	job->vb.buffer_bytes = dst;
+	job->opts = opts;
+	memcpy(job->regions, regions, n_regions * sizeof(struct arcan_shmif_region));
+	job->n_regions = n_regions;
+	job->chunk_sz = chunk_sz;
+	job->chid = S->out_channel;
+	job->sid = S->out_stream;
+	job->seqnr = S->last_seen_seqnr;
+	job->pts = S->vframe_pts;
+	job->pressure = a12int_out_pressure(S);
+	job->reset_delta = reset_delta;
+	job->failed = false;
+	job->n_px = 0;
+	for (size_t i = 0; i < n_regions; i++)
+		job->n_px += (regions[i].x2 - regions[i].x1) * (regions[i].y2 - regions[i].y1);
+
+/* one stream id per region, same as the encoders step them when in-line */
+	S->out_stream += n_regions;
+	V->in_flight++;
+
+	pthread_mutex_lock(&V->lock);
+	struct venc_job** tail = &V->queue;
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = job;
+	pthread_cond_broadcast(&V->cond);
+	pthread_mutex_unlock(&V->lock);
 }
 
-static void unlink_node(struct a12_state* S, struct blob_out* node)
+bool
+a12_set_venc_worker(struct a12_state* S, size_t threads,
+	void (*ready)(struct a12_state*, void* tag), void* tag)
 {
-	/* find the owner of the node, redirect next */
-	/* close the socket and other resources */
-	struct blob_out* next = node->next;
-	struct blob_out** dst = &S->pending;
+	if (!S || S->cookie != 0xfeedface)
+		return false;
 
-	while (*dst != node && *dst){
-		dst = &((*dst)->next);
+	if (!threads && !ready){
+		venc_stop(S);
+		return true;
 	}
 
-	if (*dst != node){
-		a12int_trace(A12_TRACE_SYSTEM, "couldn't not unlink node");
-		return;
+/* with a sink the output is expected to be available on return */
+	if (S->opts->sink || S->venc)
+		return false;
+
+	struct a12_venc* V = DYNAMIC_MALLOC(sizeof(struct a12_venc));
+	if (!V)
+		return false;
+
+	*V = (struct a12_venc){
+		.ready = ready,
+		.tag = tag
+	};
+	pthread_mutex_init(&V->lock, NULL);
+	pthread_cond_init(&V->cond, NULL);
+	S->venc = V;
+
+	if (0 != pthread_create(&V->thread, NULL, venc_thread, S)){
+		pthread_mutex_destroy(&V->lock);
+		pthread_cond_destroy(&V->cond);
+		DYNAMIC_FREE(V);
+		S->venc = NULL;
+		return false;
 	}
 
-	a12int_trace(A12_TRACE_ALLOC, "unlinked:stream=%"PRIu64, node->streamid);
+	if (threads)
+		S->venc_threads = threads;
 
-	S->active_blobs--;
-	*dst = next;
-	close(node->fd);
-	if (node->zstd){
-		ZSTD_freeCCtx(node->zstd);
-		node->zstd = NULL;
+	return true;
+}
+
+bool
+a12_set_vdec_worker(struct a12_state* S, size_t threads,
+	void (*ready)(struct a12_state*, void* tag), void* tag)
+{
+	if (!S || S->cookie != 0xfeedface)
+		return false;
+
+	if (!threads && !ready){
+		a12int_vdec_stop(S);
+		return true;
 	}
 
-	DYNAMIC_FREE(node);
+	return a12int_vdec_start(S, threads, ready, tag);
 }
 
 /*
- * tail-recurse back into queue_node until the
+ * relay: the encoder is a state of its own that never gets connected, frames
+ * are run through it with a job set like on the venc worker so that what it
+ * produces ends up as records (stream ids relative to 0, channel 0 for deltas
+ * and 1 for keyframes) that can be replayed into each viewer.
  */
-static size_t queue_node(struct a12_state* S, struct blob_out* node);
-static bool flush_compressed(
-	struct a12_state* S, struct blob_out* node, char* buf, size_t nts)
+struct relay_viewer {
+	struct a12_state* S;
+	bool synced;
+};
+
+struct a12_relay {
+	struct a12_state* enc;
+	struct relay_viewer viewers[A12_RELAY_VIEWERS];
+	size_t n_viewers;
+
+/* copy of the contents after the last frame, keyframes are built from it */
+	struct shmifsrv_vbuffer last;
+	size_t last_sz;
+	bool have_last;
+
+/* the delta encoder reference is only good if every frame went through it */
+	bool stale;
+
+	struct venc_job frame;
+	struct venc_job key;
+	bool key_valid;
+};
+
+static void relay_features(struct a12_relay* R)
 {
-	uint8_t outb[1 + 4 + 2];
-	outb[0] = node->chid;
-	pack_u32(node->streamid, &outb[1]);
+	uint8_t features = R->n_viewers ? 0xff : 0;
+	for (size_t i = 0; i < R->n_viewers; i++)
+		features &= R->viewers[i].S->remote_features;
+	R->enc->remote_features = features;
+}
 
-	if (!node->left && !nts){
-		a12int_trace(A12_TRACE_BTRANSFER,
-			"kind=compressed_stream_over:stream=%zu:ch=%d",
-			(size_t)node->streamid, (int) node->chid
-		);
-		return false;
+static int relay_method(struct shmifsrv_vbuffer* vb, int method)
+{
+	if (vb->flags.tpack)
+		return VFRAME_METHOD_TPACK_ZSTD;
+
+	return raw_or_delta(method) ? method : VFRAME_METHOD_DZSTD;
+}
+
+static void relay_job(struct venc_job* job, int chid, struct a12_vframe_opts opts)
+{
+	job->out.used = job->out.ofs = job->out.unit_start = 0;
+	job->opts = opts;
+	job->chid = chid;
+	job->sid = 0;
+	job->seqnr = 0;
+	job->pts = a12int_media_clock();
+	job->pressure = OUTQ_PRESSURE_NONE;
+	job->defer_commit = false;
+	job->failed = false;
+}
+
+/*
+ * Patch what differs between viewers into the records of [job] and add them
+ * to the video outq of [S], records are rewritten in place as viewers are
+ * served one at a time.
+ */
+static void relay_replay(struct a12_state* S, struct venc_job* job)
+{
+	uint8_t chid = S->out_channel;
+	uint32_t base = S->out_stream;
+	uint32_t n_sid = 0;
+	struct a12_outq* Q = &job->out;
+
+	outq_open(S, OUTQ_VIDEO);
+	for (size_t ofs = 0; ofs < Q->used && S->state != STATE_BROKEN;){
+		uint8_t type = Q->buf[ofs];
+		uint32_t len, id;
+		unpack_u32(&len, &Q->buf[ofs + 1]);
+		uint8_t* data = &Q->buf[ofs + OUTQ_REC_HDR];
+		ofs += OUTQ_REC_HDR + len;
+
+		switch (type){
+		case VENC_STEP:
+			unpack_u32(&id, data);
+			track_vstream(S, base + id);
+			n_sid = id + 1 > n_sid ? id + 1 : n_sid;
+		break;
+		case STATE_CONTROL_PACKET:
+			pack_u64(S->last_seen_seqnr, data);
+			data[16] = chid;
+			unpack_u32(&id, &data[18]);
+			pack_u32(base + id, &data[18]);
+			a12int_append_out(S, type, data, len, NULL, 0);
+			pack_u32(id, &data[18]);
+		break;
+		case STATE_VIDEO_PACKET:
+			data[0] = chid;
+			a12int_append_out(S, type, data, len, NULL, 0);
+		break;
+		}
 	}
+	outq_close(S);
 
-/* Nts and buffer size comes from the read function and its static upper buffer
- * bound, this is mainly to balance between interleaving (higher prio data) and
- * throughput. An external oracle should be allowed to influence this using
- * transport information on bandwidth and MTUs. There are better (?) ways of
- * using ZSTD here, but all are quite complicated. The problem is the normal of
- * chunking+metadata and the discrepancy between bytes in vs bytes out. A
- * trivially compressible input set might just yield a byte or two for a full
- * input buffer, yet we will 'terminate' compression and send of a chunk with
- * header regardless - reducing efficiency.
- *
- * The flow here might be unintuitive but -
- *  - a12_flush checks if there is space to interleave binary data
- *  - if so, append_blob will check if there is a binary transfer queued
- *    it picks this in first come first server order, but could be reordered
- *  - it enters queue_node which reads up to a cap of bytes into a buffer
- *  - this buffer is forwarded to flush_compressed or uncompressed depending
- *    on the zstd- context availability which should be setup when the stream
- *    is initialised.
- *  - we arrive here, compress and flush whatever is provided, and return if
- *    there is more data to be processed (the nts for the blob stream)
- *    and if there isn't, queue_node will unlink and free us.
- *  - otherwise a12int_append_out will increase the outgoing buffer that
- *    a12_flush checks, and the cycle repeats itself.
- * */
+	S->out_stream = base + n_sid;
+}
 
-	size_t max = ZSTD_compressBound(nts);
-	if (max >= 65536){
-		a12int_trace(A12_TRACE_SYSTEM,
-			"kind=compressed_stream_overflow:cap=64k:size=%zu", max);
+/* full frame of the last contents, shared by all that need one until the
+ * next frame arrives */
+static bool relay_keyframe(struct a12_relay* R)
+{
+	if (R->key_valid)
+		return true;
+
+	if (!R->have_last)
 		return false;
-	}
 
-	void* compressed = DYNAMIC_MALLOC(max);
-	size_t out = ZSTD_compressCCtx(node->zstd, compressed, max, buf, nts, 3);
-	pack_u16(out, &outb[5]);
+	struct a12_vframe_opts opts = {
+		.method = R->last.flags.tpack ?
+			VFRAME_METHOD_TPACK_ZSTD : VFRAME_METHOD_ZSTD
+	};
 
-	a12int_append_out(S,
-		STATE_BLOB_PACKET, (uint8_t*) compressed, out, outb, sizeof(outb));
+	relay_job(&R->key, 1, opts);
+	a12int_encode_reset_delta(R->enc, 1);
 
-	DYNAMIC_FREE(compressed);
+	venc_job = &R->key;
+	bool ok = vframe_encode(R->enc, &R->last,
+		opts, 1, 0, 0, 0, R->last.w, R->last.h, 32768);
+	venc_job = NULL;
 
-	if (node->left){
-		a12int_trace(A12_TRACE_BTRANSFER, "kind=compressed_block:"
-			"stream=%"PRIu64":ch=%d:size=%zu:base=%zu:left=%zu",
-			(uint64_t)node->streamid, (int) node->chid, out, nts, node->left
-		);
-		node->left -= nts;
-		return node->left != 0;
+/* only the delta encoder needs to keep its reference */
+	a12int_encode_reset_delta(R->enc, 1);
+
+	R->key_valid = ok && !R->key.failed;
+	return R->key_valid;
+}
+
+static void relay_update_last(struct a12_relay* R,
+	struct shmifsrv_vbuffer* vb, struct arcan_shmif_region* bb, bool full)
+{
+	size_t nb = vb->stride * vb->h;
+	if (R->last_sz < nb){
+		DYNAMIC_FREE(R->last.buffer);
+		R->last.buffer = DYNAMIC_MALLOC(nb);
+		R->last_sz = R->last.buffer ? nb : 0;
+		full = true;
 	}
 
-	a12int_trace(A12_TRACE_BTRANSFER,
-		"kind=compressed_stream=%zu:ch=%d:size=%zu:base=%zu",
-		(size_t)node->streamid, (int) node->chid, out, nts
-	);
+	if (!R->last.buffer){
+		R->have_last = false;
+		return;
+	}
 
-	return true;
+	if (!R->have_last || R->last.w != vb->w ||
+		R->last.h != vb->h || R->last.stride != vb->stride || vb->flags.tpack)
+		full = true;
+
+	uint8_t* dst = R->last.buffer_bytes;
+	if (full)
+		memcpy(dst, vb->buffer_bytes, nb);
+	else
+		memcpy(&dst[bb->y1 * vb->stride],
+			&vb->buffer_bytes[bb->y1 * vb->stride], (bb->y2 - bb->y1) * vb->stride);
+
+	R->last.w = vb->w;
+	R->last.h = vb->h;
+	R->last.stride = vb->stride;
+	R->last.pitch = vb->pitch;
+	R->last.flags = vb->flags;
+	R->last.flags.subregion = false;
+	R->last.n_regions = 0;
+	R->have_last = true;
 }
 
-static bool flush_uncompressed(
-	struct a12_state* S, struct blob_out* node, char* buf, size_t nts)
+struct a12_relay* a12_relay_create()
 {
-	uint8_t outb[1 + 4 + 2];
-	outb[0] = node->chid;
-	pack_u32(node->streamid, &outb[1]);
-	pack_u16(nts, &outb[5]);
-	a12int_append_out(S, STATE_BLOB_PACKET, (uint8_t*) buf, nts, outb, sizeof(outb));
+	a12_init();
 
-/* if we have a fixed known size .. */
-	if (node->left){
-		node->left -= nts;
-		a12int_trace(A12_TRACE_BTRANSFER,
-			"kind=block:stream=%"PRIu64":ch=%d:size=%zu:left=%zu",
-			node->streamid, (int)node->chid, nts, node->left
-			);
-		return node->left != 0;
-	}
+	struct a12_relay* R = DYNAMIC_MALLOC(sizeof(struct a12_relay));
+	if (!R)
+		return NULL;
 
-	a12int_trace(A12_TRACE_BTRANSFER,
-		"kind=block:stream=%zu:ch=%d:streaming:size=%zu",
-		(size_t) node->streamid, (int)node->chid, nts
-	);
+	*R = (struct a12_relay){};
+	R->enc = a12_setup(&(struct a12_context_options){}, true);
+	if (!R->enc){
+		DYNAMIC_FREE(R);
+		return NULL;
+	}
 
-/* otherwise we are streaming from an unknown source and the EOB determines */
-	return nts != 0;
+	R->stale = true;
+	return R;
 }
 
-static size_t begin_bstream(struct a12_state* S, struct blob_out* node)
+bool a12_relay_attach(struct a12_relay* R, struct a12_state* S)
 {
-	uint8_t outb[CONTROL_PACKET_SIZE];
+	if (!R || !S || S->cookie != 0xfeedface || R->n_viewers == A12_RELAY_VIEWERS)
+		return false;
 
-	build_control_header(S, outb, COMMAND_BINARYSTREAM);
-	outb[16] = node->chid;
+	for (size_t i = 0; i < R->n_viewers; i++)
+		if (R->viewers[i].S == S)
+			return true;
 
-	S->out_stream++;
-	pack_u32(S->out_stream, &outb[18]);      /* [18 .. 21] stream-id */
-	pack_u64(node->left, &outb[22]);         /* [22 .. 29] total-size */
-	outb[30] = node->type;
-	pack_u32(node->identifier, &outb[31]);   /* 31..34 : id-token */
-	memcpy(&outb[35], node->checksum, 16);
+	struct relay_viewer* V = &R->viewers[R->n_viewers++];
+	*V = (struct relay_viewer){.S = S};
+	relay_features(R);
 
-/* enable compression if possible - zstd has a decent entropy estimator so even
- * for precompressed source material the overhead isn't that substantial, still
- * could be added as an option for the bstream creation function but just let
- * it be the default for now */
-	node->zstd = ZSTD_createCCtx();
-	if (node->zstd){
-		ZSTD_CCtx_setParameter(node->zstd, ZSTD_c_nbWorkers, 4);
-		outb[52] = 1;
+	if (relay_keyframe(R)){
+		relay_replay(S, &R->key);
+		V->synced = true;
 	}
 
-/* only used for two subtypes but will be set to 0 otherwise */
-	memcpy(&outb[53], node->extid, 16);
-	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+	return true;
+}
 
-	node->active = true;
-	node->streamid = S->out_stream;
-	a12int_trace(
-		A12_TRACE_BTRANSFER, "kind=created:size=%zu:stream:%"PRIu64":ch=%d",
-		node->left, node->streamid, node->chid
-	);
+void a12_relay_detach(struct a12_relay* R, struct a12_state* S)
+{
+	if (!R)
+		return;
 
-/* set a small cap for the first packet, and defer the next queue node until
- * the ack:ed serial has advanced a bit to let the other end cancel before we
- * push too much so that we don't just burst - better rampup is needed here */
-	return 16384;
+	for (size_t i = 0; i < R->n_viewers; i++){
+		if (R->viewers[i].S != S)
+			continue;
+
+		memmove(&R->viewers[i], &R->viewers[i + 1],
+			(R->n_viewers - i - 1) * sizeof(struct relay_viewer));
+		R->n_viewers--;
+		relay_features(R);
+		return;
+	}
 }
 
-static size_t queue_node(struct a12_state* S, struct blob_out* node)
+void a12_relay_vframe(struct a12_relay* R,
+	struct shmifsrv_vbuffer* vb, struct a12_vframe_opts opts)
 {
-	uint16_t nts;
-	size_t cap = node->left;
-	if (cap == 0 || cap > 64096)
-		cap = 64096;
-
-	bool die;
-	bool free_buf;
-	char* buf;
+	if (!R)
+		return;
 
-/* not activated, so build a header first */
-	if (!node->active){
-		size_t rampup = begin_bstream(S, node);
-		if (rampup < cap)
-			cap = rampup;
+/* the bitstream refers to decoder state that a late viewer doesn't have */
+	if (vb->flags.compressed){
+		a12int_trace(A12_TRACE_VIDEO, "kind=drop:relay_passthrough");
+		return;
 	}
 
-/* if we have a non-streaming pre-allocated source, just slice off and keep */
-	if (node->buf){
-		buf = &node->buf[node->buf_sz - node->left];
-		nts = cap;
-		die = false;
-		free_buf = false;
+	size_t x = 0, y = 0, w = vb->w, h = vb->h;
+	bool valid_region = vb->flags.subregion;
+	if (vb->flags.subregion){
+		x = vb->region.x1;
+		y = vb->region.y1;
+		w = vb->region.x2 - x;
+		h = vb->region.y2 - y;
 	}
-	else {
-		buf = read_data(node->fd, cap, &nts, &die);
+
+	if (!w || !h || !vb->w || !vb->h){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=einval:status=bad dimensions");
+		return;
 	}
 
-/* streaming or file source that broke before we finished sending it all */
-	if (!buf && (die || !node->zstd)){
-		a12_stream_cancel(S, S->in_channel);
-		if (die){
-			unlink_node(S, node);
+	if (x + w > vb->w || y + h > vb->h){
+		x = 0;
+		y = 0;
+		w = vb->w;
+		h = vb->h;
+		valid_region = false;
+	}
+
+	struct arcan_shmif_region bb = {.x1 = x, .y1 = y, .x2 = x + w, .y2 = y + h};
+	relay_update_last(R, vb, &bb, !valid_region);
+	R->key_valid = false;
+
+/* a viewer that would drop this frame gets resynched with a keyframe later */
+	size_t n_synced = 0;
+	int pressure = OUTQ_PRESSURE_NONE;
+	for (size_t i = 0; i < R->n_viewers; i++){
+		struct relay_viewer* V = &R->viewers[i];
+		if (!V->synced || V->S->state == STATE_BROKEN)
+			continue;
+
+		int vp = a12int_out_pressure(V->S);
+		if (vp == OUTQ_PRESSURE_HARD){
+			a12int_trace(A12_TRACE_VDETAIL, "kind=drop:relay_viewer=%zu", i);
+			V->synced = false;
+			V->S->stats.vframe_dropped++;
+			continue;
 		}
-		return 0;
-	}
 
-/* might not have data to send yet */
-	if (!nts)
-		return nts;
+		pressure = vp > pressure ? vp : pressure;
+		n_synced++;
+	}
+
+	opts.method = relay_method(vb, opts.method);
+	struct a12_channel* ch = &R->enc->channels[0];
+	if (n_synced){
+		if (R->stale || (opts.method != ch->last_vmethod &&
+			(opts.method == VFRAME_METHOD_ZSTD || opts.method == VFRAME_METHOD_DZSTD) &&
+			ch->last_vmethod != VFRAME_METHOD_ZSTD && ch->last_vmethod != VFRAME_METHOD_DZSTD))
+			a12int_encode_reset_delta(R->enc, 0);
+		ch->last_vmethod = opts.method;
+		R->stale = false;
+
+		struct arcan_shmif_region* regions = &bb;
+		size_t n_regions = 1;
+		if (valid_region && vb->n_regions > 1 && !vb->flags.tpack){
+			regions = vb->regions;
+			n_regions = vb->n_regions;
+		}
 
-/* keep it around and referenced for being able to revert / disable compression
- * should some edge case need arise */
-	if (node->zstd)
-		die = !flush_compressed(S, node, buf, nts);
+		relay_job(&R->frame, 0, opts);
+		R->frame.pressure = pressure;
+		venc_job = &R->frame;
+		for (size_t i = 0; i < n_regions && !R->frame.failed; i++){
+			struct arcan_shmif_region* r = &regions[i];
+			R->frame.defer_commit = i < n_regions - 1;
+			if (!vframe_encode(R->enc, vb, opts, 0, i,
+				r->x1, r->y1, r->x2 - r->x1, r->y2 - r->y1, 32768))
+				R->frame.failed = true;
+		}
+		venc_job = NULL;
+
+/* with the reference in an unknown state, everyone starts over */
+		if (R->frame.failed){
+			a12int_trace(A12_TRACE_VIDEO, "kind=error:message=relay encode failed");
+			R->stale = true;
+			for (size_t i = 0; i < R->n_viewers; i++)
+				R->viewers[i].synced = false;
+		}
+	}
 	else
-		die = !flush_uncompressed(S, node, buf, nts);
+		R->stale = true;
 
-	if (free_buf)
-		DYNAMIC_FREE(buf);
+	for (size_t i = 0; i < R->n_viewers; i++){
+		struct relay_viewer* V = &R->viewers[i];
+		if (V->S->state == STATE_BROKEN)
+			continue;
 
-	if (die)
-		unlink_node(S, node);
+		if (V->synced){
+			relay_replay(V->S, &R->frame);
+			continue;
+		}
 
-	return nts;
+		if (a12int_out_pressure(V->S) != OUTQ_PRESSURE_HARD && relay_keyframe(R)){
+			relay_replay(V->S, &R->key);
+			V->synced = true;
+		}
+	}
 }
 
-static size_t append_blob(struct a12_state* S, int mode)
+void a12_relay_free(struct a12_relay* R)
 {
-/* find suitable blob */
-	if (mode == A12_FLUSH_NOBLOB || !S->pending)
-		return 0;
+	if (!R)
+		return;
 
-/* The last seen seqnr shows how big the window drift is between us and the
- * other side. Control packets contain sequence numbers, and the last one
- * seen. When a binary transfer that is likely to be rejected due to being
- * cached - transfer is delayed until the other end has had enough time to
- * cancel the stream. */
-	if (
-		S->pending->rampup_seqnr &&
-		S->last_seen_seqnr < S->pending->rampup_seqnr)
-	{
-		return 0;
-	}
+	a12_free(R->enc);
+	DYNAMIC_FREE(R->frame.out.buf);
+	DYNAMIC_FREE(R->key.out.buf);
+	DYNAMIC_FREE(R->last.buffer);
+	DYNAMIC_FREE(R);
+}
 
-/* only current channel? */
-	else if (mode == A12_FLUSH_CHONLY){
-		struct blob_out* parent = S->pending;
-		while (parent){
-			if (parent->chid == S->out_channel)
-				return queue_node(S, parent);
-			parent = parent->next;
-		}
-		return 0;
-	}
+struct band_run {
+	size_t n;
+	_Atomic size_t next;
+	void (*fn)(size_t, void*);
+	void* tag;
+};
 
-	return queue_node(S, S->pending);
+static void* band_thread(void* tag)
+{
+	struct band_run* B = tag;
+	size_t i;
+	while ((i = atomic_fetch_add(&B->next, 1)) < B->n)
+		B->fn(i, B->tag);
+	return NULL;
 }
 
-size_t
-a12_flush(struct a12_state* S, uint8_t** buf, int allow_blob)
+void a12int_band_run(size_t n, size_t threads,
+	void (*fn)(size_t i, void* tag), void* tag)
 {
-	if (S->state == STATE_BROKEN || S->cookie != 0xfeedface)
-		return 0;
-
-/* Nothing in the outgoing buffer? then we can pull in whatever data transfer
- * is pending, if there are any queued. Repeat the append- until we have an
- * outgoing buffer of a certain size. */
-	if (S->buf_ofs == 0){
-		while (allow_blob > A12_FLUSH_NOBLOB &&
-			append_blob(S, allow_blob) && S->buf_ofs < BLOB_QUEUE_CAP){}
+	struct band_run B = {
+		.n = n,
+		.fn = fn,
+		.tag = tag
+	};
 
-		if (!S->buf_ofs)
-			return 0;
+/* the caller takes a share so no threads is the same as one */
+	pthread_t pt[VDEC_THREADS_MAX];
+	size_t n_pt = 0;
+	for (size_t i = 1; i < threads && i < n && n_pt < VDEC_THREADS_MAX; i++){
+		if (0 == pthread_create(&pt[n_pt], NULL, band_thread, &B))
+			n_pt++;
 	}
 
-	size_t rv = S->buf_ofs;
-	int old_ind = S->buf_ind;
+	band_thread(&B);
+	for (size_t i = 0; i < n_pt; i++)
+		pthread_join(pt[i], NULL);
+}
 
-/* switch out "output buffer" and return how much there is to send, it is
- * expected that by the next non-0 returning channel_flush, its contents have
- * been pushed to the other side */
-	*buf = S->bufs[S->buf_ind];
-	S->buf_ofs = 0;
-	S->buf_ind = (S->buf_ind + 1) % 2;
-	a12int_trace(A12_TRACE_ALLOC, "locked %d, new buffer: %d", old_ind, S->buf_ind);
+/*
+ * Released buffers are parked oldest first and an alloc takes the smallest
+ * one that fits without wasting more than half of it. Sizes above the granule
+ * are rounded up so that compressed frames of a channel, which vary a bit in
+ * size, still hit the same buffer. Parking more than POOL_SLOTS buffers or
+ * A12_POOL_CAP bytes releases the oldest, so a resize doesn't keep the
+ * buffers of the old dimensions around for long.
+ */
+#define POOL_SLOTS 8
+#define POOL_GRANULE (64 * 1024)
 
-	return rv;
+union pool_hdr {
+	size_t sz;
+	max_align_t align;
+};
+
+struct a12_pool {
+	pthread_mutex_t lock;
+	union pool_hdr* slots[POOL_SLOTS];
+	size_t n_slots;
+	size_t held;
+};
+
+static void pool_unlink(struct a12_pool* P, size_t i)
+{
+	P->held -= P->slots[i]->sz;
+	memmove(&P->slots[i], &P->slots[i+1],
+		(P->n_slots - i - 1) * sizeof(union pool_hdr*));
+	P->n_slots--;
 }
 
-int
-a12_poll(struct a12_state* S)
+static struct a12_pool* pool_create(void)
 {
-	if (!S || S->state == STATE_BROKEN || S->cookie != 0xfeedface)
-		return -1;
+	struct a12_pool* P = DYNAMIC_MALLOC(sizeof(struct a12_pool));
+	if (!P)
+		return NULL;
 
-	return S->buf_ofs || S->pending ? 1 : 0;
+	*P = (struct a12_pool){};
+	if (0 != pthread_mutex_init(&P->lock, NULL)){
+		DYNAMIC_FREE(P);
+		return NULL;
+	}
+
+	return P;
 }
 
-int
-a12_auth_state(struct a12_state* S)
+static void pool_destroy(struct a12_pool* P)
 {
-	return S->authentic;
+	if (!P)
+		return;
+
+	for (size_t i = 0; i < P->n_slots; i++)
+		DYNAMIC_FREE(P->slots[i]);
+
+	pthread_mutex_destroy(&P->lock);
+	DYNAMIC_FREE(P);
 }
 
-void
-a12_channel_new(struct a12_state* S,
-	uint8_t chid, uint8_t segkind, uint32_t cookie)
+void* a12int_pool_alloc(struct a12_state* S, size_t sz)
 {
-	uint8_t outb[CONTROL_PACKET_SIZE];
-	build_control_header(S, outb, COMMAND_NEWCH);
+	struct a12_pool* P = S->pool;
+
+	if (P){
+		pthread_mutex_lock(&P->lock);
+		size_t best = P->n_slots;
+		for (size_t i = 0; i < P->n_slots; i++){
+			size_t cur = P->slots[i]->sz;
+			if (cur >= sz && cur / 2 <= sz &&
+				(best == P->n_slots || cur < P->slots[best]->sz))
+				best = i;
+		}
 
-	outb[18] = chid;
-	outb[19] = segkind;
-	outb[20] = 0;
-	pack_u32(cookie, &outb[21]);
+		if (best != P->n_slots){
+			union pool_hdr* res = P->slots[best];
+			pool_unlink(P, best);
+			pthread_mutex_unlock(&P->lock);
+			return &res[1];
+		}
+		pthread_mutex_unlock(&P->lock);
+	}
 
-	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+	size_t bsz = sz;
+	if (bsz > POOL_GRANULE)
+		bsz = (bsz + POOL_GRANULE - 1) / POOL_GRANULE * POOL_GRANULE;
+
+	if (bsz < sz || bsz > SIZE_MAX - sizeof(union pool_hdr))
+		return NULL;
+
+	union pool_hdr* res = DYNAMIC_MALLOC(sizeof(union pool_hdr) + bsz);
+	if (!res){
+		a12int_trace(A12_TRACE_ALLOC, "kind=alloc_error:pool:size=%zu", bsz);
+		return NULL;
+	}
+
+	a12int_trace(A12_TRACE_ALLOC, "kind=pool:miss=%zu", bsz);
+	res->sz = bsz;
+	return &res[1];
 }
 
-void
-a12_set_channel(struct a12_state* S, uint8_t chid)
+void a12int_pool_free(struct a12_state* S, void* buf)
 {
-	if (chid != S->out_channel)
-		a12int_trace(A12_TRACE_SYSTEM, "channel_out=%"PRIu8, chid);
-	S->out_channel = chid;
+	if (!buf)
+		return;
+
+	union pool_hdr* hdr = &((union pool_hdr*) buf)[-1];
+	struct a12_pool* P = S->pool;
+
+	if (!P || hdr->sz > A12_POOL_CAP){
+		DYNAMIC_FREE(hdr);
+		return;
+	}
+
+	pthread_mutex_lock(&P->lock);
+	while (P->n_slots &&
+		(P->n_slots == POOL_SLOTS || P->held + hdr->sz > A12_POOL_CAP)){
+		union pool_hdr* old = P->slots[0];
+		pool_unlink(P, 0);
+		DYNAMIC_FREE(old);
+	}
+
+	P->slots[P->n_slots++] = hdr;
+	P->held += hdr->sz;
+	pthread_mutex_unlock(&P->lock);
 }
 
-void
-a12_channel_aframe(struct a12_state* S,
-		shmif_asample* buf,
-		size_t n_samples,
-		struct a12_aframe_cfg cfg,
-		struct a12_aframe_opts opts)
+/*
+ * VFRAME_METHOD_ADAPTIVE - pick the method for the next frame of a channel.
+ * tpack has its own packing. Otherwise the sequence of damage says if it is
+ * text/UI-like (small, scattered updates) or video (most of the surface each
+ * frame). The tile format already picks solid / cached / compressed per tile
+ * so the damaged regions of the former get the right treatment there. The
+ * latter goes to h264 when the tiles stop working: compressing worse than
+ * 2:1, not fitting the link estimate for the frame interval or taking longer
+ * to encode than the interval. Both directions need ADAPT_STREAK frames in a
+ * row so that a single scroll or full redraw doesn't flip-flop the encoder.
+ */
+#define ADAPT_STREAK 8
+#define ADAPT_MOTION_HI 192
+#define ADAPT_MOTION_LO 64
+
+static int adapt_method(struct a12_state* S,
+	struct a12_channel* ch, struct shmifsrv_vbuffer* vb, size_t w, size_t h)
 {
-	if (!S || S->cookie != 0xfeedface || S->state == STATE_BROKEN)
-		return;
+	int base = (S->remote_features & A12_FEATURE_TILES) ?
+		VFRAME_METHOD_TILES : VFRAME_METHOD_DZSTD;
 
-/* use a fix size now as the outb- writer lacks queueing and interleaving */
-	size_t chunk_sz = 16428;
+	if (vb->flags.tpack)
+		return VFRAME_METHOD_TPACK_ZSTD;
 
-	a12int_trace(A12_TRACE_AUDIO,
-		"encode %zu samples @ %"PRIu32" Hz /%"PRIu8" ch",
-		n_samples, cfg.samplerate, cfg.channels
-	);
-	a12int_encode_araw(S, S->out_channel, buf, n_samples/2, cfg, opts, chunk_sz);
+/* a damage chain covers less than its bounding box */
+	size_t area = w * h;
+	if (vb->flags.subregion && vb->n_regions > 1){
+		size_t sum = 0;
+		for (size_t i = 0; i < vb->n_regions; i++)
+			sum += (size_t)(vb->regions[i].x2 - vb->regions[i].x1) *
+				(vb->regions[i].y2 - vb->regions[i].y1);
+		area = sum < area ? sum : area;
+	}
+
+	size_t share = area * 256 / (vb->w * vb->h);
+	ch->adapt.motion = (ch->adapt.motion * 3 + share) / 4;
+
+	uint64_t now = arcan_timemillis();
+	if (ch->adapt.last_ts && now > ch->adapt.last_ts)
+		ch->adapt.interval = (ch->adapt.interval * 3 + (now - ch->adapt.last_ts)) / 4;
+	ch->adapt.last_ts = now;
+
+	int method = ch->adapt.method == VFRAME_METHOD_H264 ?
+		VFRAME_METHOD_H264 : base;
+
+#ifdef WANT_H264_ENC
+	size_t budget = out_rate(S) * ch->adapt.interval / 1000;
+	bool costly = ch->adapt.ratio > 128 ||
+		(budget && ch->adapt.bytes > budget) ||
+		(ch->adapt.interval && S->stats.ms_vframe > ch->adapt.interval);
+
+	bool flip = method == VFRAME_METHOD_H264 ?
+		ch->adapt.motion < ADAPT_MOTION_LO :
+		ch->adapt.motion > ADAPT_MOTION_HI && costly && !S->advenc_broken;
+
+	ch->adapt.streak = flip ? ch->adapt.streak + 1 : 0;
+	if (ch->adapt.streak >= ADAPT_STREAK){
+		method = method == VFRAME_METHOD_H264 ? base : VFRAME_METHOD_H264;
+		ch->adapt.streak = 0;
+	}
+
+	if (S->advenc_broken)
+		method = base;
+#endif
+
+	if (method != ch->adapt.method){
+		a12int_trace(A12_TRACE_VIDEO,
+			"kind=status:adaptive=%d:motion=%zu:ratio=%zu:bytes=%zu:interval=%zu",
+			method, ch->adapt.motion, ch->adapt.ratio,
+			ch->adapt.bytes, ch->adapt.interval
+		);
+		ch->adapt.method = method;
+		ch->adapt.bytes = 0;
+		ch->adapt.ratio = 0;
+	}
+
+	return method;
 }
 
 /*
@@ -3170,6 +6238,7 @@ a12_channel_vframe(struct a12_state* S,
 
 /* avoid dumb updates */
 	size_t x = 0, y = 0, w = vb->w, h = vb->h;
+	bool valid_region = vb->flags.subregion;
 	if (vb->flags.subregion){
 		x = vb->region.x1;
 		y = vb->region.y1;
@@ -3192,8 +6261,99 @@ a12_channel_vframe(struct a12_state* S,
 		y = 0;
 		w = vb->w;
 		h = vb->h;
+		valid_region = false;
+	}
+
+/* The queue is bounded by dropping frames while it drains. The damage of a
+ * dropped frame is lost so the next one goes out in full. Precompressed
+ * passthrough can't be dropped without breaking the decoder on the other end.
+ * A worker that is still busy with earlier frames counts as drained. */
+	struct a12_channel* ch = &S->channels[S->out_channel];
+	venc_collect(S);
+	int pressure = S->opts->sink ? OUTQ_PRESSURE_NONE : a12int_out_pressure(S);
+	bool venc_full = S->venc && S->venc->in_flight >= VENC_QUEUE_LIM;
+
+	if ((pressure == OUTQ_PRESSURE_HARD || venc_full) && !vb->flags.compressed){
+		a12int_trace(A12_TRACE_VDETAIL,
+			"kind=drop:queued=%zu:rate=%zu", outq_bytes(S), S->drain.rate);
+		ch->vframe_dropped = true;
+		S->stats.vframe_dropped++;
+		return;
+	}
+
+	if (ch->vframe_dropped){
+		ch->vframe_dropped = false;
+		x = 0;
+		y = 0;
+		w = vb->w;
+		h = vb->h;
+		valid_region = false;
+	}
+
+	S->vframe_pts = a12int_media_clock();
+
+	if (opts.method == VFRAME_METHOD_ADAPTIVE)
+		opts.method = adapt_method(S, ch, vb, w, h);
+
+/* the other end rejected h264, stick to what it can decode */
+	if (opts.method == VFRAME_METHOD_H264 && S->advenc_broken)
+		opts.method = VFRAME_METHOD_DZSTD;
+
+/* without a set cap, h264 gets its share of the estimated link rate */
+	if (opts.method == VFRAME_METHOD_H264 && !opts.bitrate && S->link.bw){
+		opts.bitrate = S->link.bw * 8 / 1000 * LINK_VIDEO_SHARE / 100;
+		if (!opts.bitrate)
+			opts.bitrate = 1;
+		else if (opts.bitrate > 1000000)
+			opts.bitrate = 1000000;
+	}
+
+/* and only send tiles to one that announced it can take them */
+	bool tiles = S->remote_features & A12_FEATURE_TILES;
+	if (opts.method == VFRAME_METHOD_TILES && !tiles)
+		opts.method = VFRAME_METHOD_DZSTD;
+
+/* raw is cheap to produce but the most expensive to send, switch to the delta
+ * compressor */
+	if (pressure != OUTQ_PRESSURE_NONE && !vb->flags.compressed &&
+		(opts.method == VFRAME_METHOD_RAW_RGB565 ||
+		 opts.method == VFRAME_METHOD_NORMAL ||
+		 opts.method == VFRAME_METHOD_RAW_NOALPHA)){
+		opts.method = tiles ? VFRAME_METHOD_TILES : VFRAME_METHOD_DZSTD;
+	}
+
+/* the delta compressors track what the other end has, if some other method
+ * was used for the last frame that reference is stale and need to restart -
+ * for h264 that means starting over on a keyframe */
+	bool reset_delta = false;
+	if (opts.method == VFRAME_METHOD_TILES || opts.method == VFRAME_METHOD_H264)
+		reset_delta = ch->last_vmethod != opts.method;
+	else if (opts.method == VFRAME_METHOD_DZSTD || opts.method == VFRAME_METHOD_ZSTD)
+		reset_delta = ch->last_vmethod != VFRAME_METHOD_DZSTD &&
+			ch->last_vmethod != VFRAME_METHOD_ZSTD;
+	ch->last_vmethod = opts.method;
+
+/* with a damage chain, the methods that work on arbitrary sub-regions get one
+ * frame per region and only the last commits - the compressors that need the
+ * full surface (h264, tpack, passthrough) just use the bounding box */
+	struct arcan_shmif_region bb = {.x1 = x, .y1 = y, .x2 = x + w, .y2 = y + h};
+	struct arcan_shmif_region* regions = &bb;
+	size_t n_regions = 1;
+
+	if (valid_region && vb->n_regions > 1 &&
+		!vb->flags.compressed && raw_or_delta(opts.method)){
+		regions = vb->regions;
+		n_regions = vb->n_regions;
+	}
+
+	if (S->venc){
+		venc_submit(S, vb, opts, regions, n_regions, chunk_sz, reset_delta);
+		return;
 	}
 
+	if (reset_delta)
+		a12int_encode_reset_delta(S, S->out_channel);
+
 /* option: quadtree delta- buffer and only distribute the updated
  * cells? should cut down on memory bandwidth on decode side and
  * on rle/compressing */
@@ -3208,56 +6368,36 @@ a12_channel_vframe(struct a12_state* S,
  * then we have the problem of the meta- area that should take
  * other package types when we get there
  */
-	uint32_t sid = S->out_stream;
-
-	a12int_trace(A12_TRACE_VIDEO,
-		"out vframe: %zu*%zu @%zu,%zu+%zu,%zu", vb->w, vb->h, w, h, x, y);
-#define argstr S, vb, opts, sid, x, y, w, h, chunk_sz, S->out_channel
-
 	size_t now = arcan_timemillis();
-
-/* we have a pre-compressed passthrough - send it with the FOURCC stored
- * in place of expanded length and just send the buffer as is */
-	if (vb->flags.compressed)
-		a12int_encode_passthrough(argstr);
-	else
-	switch(opts.method){
-	case VFRAME_METHOD_RAW_RGB565:
-		a12int_encode_rgb565(argstr);
-	break;
-	case VFRAME_METHOD_NORMAL:
-		if (vb->flags.ignore_alpha)
-			a12int_encode_rgb(argstr);
-		else
-			a12int_encode_rgba(argstr);
-	break;
-	case VFRAME_METHOD_RAW_NOALPHA:
-		a12int_encode_rgb(argstr);
-	break;
-/* these are the same, the encoder will pick which based on ref. frame */
-	case VFRAME_METHOD_ZSTD:
-	case VFRAME_METHOD_DZSTD:
-		a12int_encode_dzstd(argstr);
-	break;
-	case VFRAME_METHOD_H264:
-		if (S->advenc_broken)
-			a12int_encode_dzstd(argstr);
-		else
-			a12int_encode_h264(argstr);
-	break;
-	case VFRAME_METHOD_TPACK_ZSTD:
-		a12int_encode_ztz(argstr);
-	break;
-	default:
-		a12int_trace(A12_TRACE_SYSTEM, "unknown format: %d\n", opts.method);
-		return;
-	break;
+	size_t n_px = 0;
+	size_t pre = S->stats.b_out + S->outq[OUTQ_VIDEO].used;
+
+	outq_open(S, OUTQ_VIDEO);
+	for (size_t i = 0; i < n_regions; i++){
+		x = regions[i].x1;
+		y = regions[i].y1;
+		w = regions[i].x2 - x;
+		h = regions[i].y2 - y;
+		n_px += w * h;
+
+		S->vframe_defer_commit = i < n_regions - 1;
+		bool ok = vframe_encode(S, vb, opts,
+			S->out_channel, S->out_stream, x, y, w, h, chunk_sz);
+		S->vframe_defer_commit = false;
+
+		if (!ok){
+			outq_close(S);
+			return;
+		}
 	}
+	outq_close(S);
+	adapt_feedback(S, S->out_channel, opts.method,
+		S->stats.b_out + S->outq[OUTQ_VIDEO].used - pre, n_px);
 
 	size_t then = arcan_timemillis();
 	if (then > now){
 		S->stats.ms_vframe = then - now;
-		S->stats.ms_vframe_px = (float)(then - now) / (float)(w * h);
+		S->stats.ms_vframe_px = (float)(then - now) / (float)n_px;
 	}
 }
 
@@ -3317,6 +6457,21 @@ a12_channel_enqueue(struct a12_state* S, struct arcan_event* ev)
 /*
  * MAC and cipher state is managed in the append-outb stage
  */
+	if (S->remote_major == ASHMIF_VERSION_MAJOR &&
+		S->remote_minor >= A12_EVENTC_MINOR){
+		uint8_t buf[A12_EVENTC_MAX];
+		ssize_t nb = arcan_shmif_eventpack_compact(ev, buf, sizeof(buf));
+		if (-1 != nb){
+			uint8_t hdr[1 + 2];
+			hdr[0] = S->out_channel;
+			pack_u16(nb, &hdr[1]);
+			a12int_append_out(S, STATE_EVENTC_PACKET, buf, nb, hdr, sizeof(hdr));
+			a12int_trace(A12_TRACE_EVENT,
+				"kind=enqueue:size=%zd:eventstr=%s", nb, arcan_shmif_eventstr(ev, NULL, 0));
+			return true;
+		}
+	}
+
 	uint8_t outb[header_sizes[STATE_EVENT_PACKET]];
 	size_t hdr = SEQUENCE_NUMBER_SIZE + 1;
 	outb[SEQUENCE_NUMBER_SIZE] = S->out_channel;
@@ -3387,7 +6542,18 @@ a12_set_bhandler(struct a12_state* S,
 
 struct a12_iostat a12_state_iostat(struct a12_state* S)
 {
-/* just an accessor, values are updated continously */
+/* mostly an accessor, values are updated continously - except the queue
+ * which is cheaper to sum up on demand */
+	S->stats.out_queued = outq_bytes(S);
+	S->stats.venc_busy = S->venc && S->venc->in_flight >= VENC_QUEUE_LIM;
+	S->stats.out_rate = S->drain.rate;
+	size_t rate = out_rate(S);
+	S->stats.out_drain_ms = rate ?
+		(uint64_t)(S->stats.out_queued + S->buf_ofs) * 1000 / rate : 0;
+	S->stats.link_rtt_min = S->link.rtt_min;
+	S->stats.link_rate = S->link.bw;
+	S->stats.link_inflight = link_inflight(S);
+	S->stats.link_cwnd = link_cwnd(S);
 	return S->stats;
 }
 
@@ -3397,7 +6563,7 @@ void* a12_sensitive_alloc(size_t nb)
 		ARCAN_MEM_EXTSTRUCT, ARCAN_MEM_SENSITIVE | ARCAN_MEM_BZERO, ARCAN_MEMALIGN_PAGE);
 }
 
-void a12int_step_vstream(struct a12_state* S, uint32_t id)
+static void track_vstream(struct a12_state* S, uint32_t id)
 {
 	size_t slot = S->congestion_stats.pending;
 
@@ -3406,7 +6572,45 @@ void a12int_step_vstream(struct a12_state* S, uint32_t id)
 	if (S->congestion_stats.pending < VIDEO_FRAME_DRIFT_WINDOW - 1)
 		S->congestion_stats.pending++;
 
-	S->congestion_stats.frame_window[slot] = S->out_stream++;
+	S->congestion_stats.frame_window[slot] = id;
+	link_track(S, id);
+}
+
+void a12int_step_vstream(struct a12_state* S, uint32_t id)
+{
+/* the worker runs with stream ids reserved on submission, venc_collect does
+ * the tracking when the job is moved to the outq */
+	if (venc_job){
+		uint8_t buf[4];
+		pack_u32(id, buf);
+		a12int_append_out(S, VENC_STEP, buf, 4, NULL, 0);
+		return;
+	}
+
+	track_vstream(S, id);
+	S->out_stream++;
+}
+
+uint64_t a12int_venc_seqnr(struct a12_state* S)
+{
+	return venc_job ? venc_job->seqnr : S->last_seen_seqnr;
+}
+
+uint64_t a12int_venc_pts(struct a12_state* S)
+{
+	return venc_job ? venc_job->pts : S->vframe_pts;
+}
+
+uint64_t a12int_media_clock()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool a12int_venc_commit(struct a12_state* S)
+{
+	return !(venc_job ? venc_job->defer_commit : S->vframe_defer_commit);
 }
 
 bool a12_ok(struct a12_state* S)
@@ -92,6 +92,14 @@ struct appl_meta {
 	uint64_t update_ts;
 };
 
+/* hardware backends for h264 encode/decode, see a12_context_options */
+enum a12_hwvideo {
+	A12_HWVIDEO_NONE = 0,
+	A12_HWVIDEO_VAAPI = 1,
+	A12_HWVIDEO_NVENC = 2,
+	A12_HWVIDEO_V4L2M2M = 3
+};
+
 struct a12_context_options {
 /* Provide to enable asymetric key authentication, set valid in the return to
  * allow the key, otherwise the session may be continued for a random number of
@@ -130,6 +138,37 @@ struct a12_context_options {
  * marks the state machine as broken. */
 	bool (*sink)(uint8_t* buf, size_t buf_sz, void* tag);
 	void* sink_tag;
+
+/* Prefer a hardware backend (enum a12_hwvideo) over the software h264 codec.
+ * [hw_video_device] is optional and for vaapi the render node to use. With
+ * vaapi and v4l2m2m, decoded frames are passed to the shmif destination as
+ * dma-buf planes if it accepts handles. Anything that fails to set up falls
+ * back to software. Ignored if built without ffmpeg. */
+	int hw_video;
+	const char* hw_video_device;
+
+/* Announce that audio and video can go over a separate datagram transport,
+ * see a12_datagram_announce. Only used if both ends set it. */
+	bool datagram;
+
+/* Cap (ms) on the playout delay of the opus audio jitter buffer, the delay
+ * follows the arrival jitter and the latency of video on the same channel
+ * up to this value, 0 = default (200ms). See a12_audio_step. */
+	size_t audio_delay_max;
+
+/* Server only, set to hand out session tickets that a client can resume with
+ * (see a12_resume) without a new key exchange. Tickets carry their own state
+ * so any server with the same key accepts them, all [0] disables. */
+	uint8_t ticket_key[32];
+};
+
+/* Opaque ticket as provided by the server, the secret the resumed session is
+ * keyed from and when (unix time, seconds) the server will stop accepting it */
+#define A12_TICKET_SIZE 56
+struct a12_ticket {
+	uint8_t blob[A12_TICKET_SIZE];
+	uint8_t secret[32];
+	uint64_t expires;
 };
 
 /*
@@ -173,6 +212,28 @@ a12_free(struct a12_state*);
 void a12_set_session(
 	struct pk_response* dst, uint8_t pubk[static 32], uint8_t privk[static 32]);
 
+/*
+ * Client only, get the last session ticket the server provided. Each one is
+ * good for a single resume and replaced by the next one after that.
+ */
+bool a12_get_ticket(struct a12_state*, struct a12_ticket*);
+
+/*
+ * Client only, reuse an authenticated state [S] for a new connection to the
+ * same server after the old one was lost. Anything in flight is discarded
+ * and a resume request is queued, flush and unpack as with a12_client until
+ * a12_auth_state reaches AUTH_FULL_PK.
+ *
+ * Channels, their codecs and destinations are kept, but the other end starts
+ * over: the next video frame of each channel goes out in full, binary streams
+ * that were in flight are dropped and channels other than the primary need
+ * to be announced again.
+ *
+ * Returns false if the ticket has expired or the state can't be resumed, if
+ * the server rejects the ticket the state fails as with a failed handshake.
+ */
+bool a12_resume(struct a12_state* S, struct a12_ticket*);
+
 /*
  * Take an incoming byte buffer and append to the current state of
  * the channel. Any received events will be pushed via the callback.
@@ -276,6 +337,11 @@ void a12_set_channel(struct a12_state* S, uint8_t chid);
  * These should be set when there are no audio/video frames from the source that
  * should be prioritised, and when the segment on the channel is in the preroll
  * state.
+ *
+ * Input and control always go first, audio and video frames are held in a
+ * bounded queue and added after them. When that queue is backed up, see the
+ * out_ fields in a12_iostat, video is switched to delta compression and then
+ * frames are dropped until it drains.
  */
 enum a12_blob_mode {
 	A12_FLUSH_NOBLOB = 0,
@@ -451,7 +517,9 @@ enum a12_vframe_method {
 	VFRAME_METHOD_H264 = 5,
 	VFRAME_METHOD_TPACK_ZSTD = 7,
 	VFRAME_METHOD_ZSTD = 8,
-	VFRAME_METHOD_DZSTD = 9
+	VFRAME_METHOD_DZSTD = 9,
+	VFRAME_METHOD_TILES = 10, /* falls back to DZSTD unless the sink has it */
+	VFRAME_METHOD_ADAPTIVE = 11 /* switch between the above based on content */
 };
 
 enum a12_stream_types {
@@ -490,10 +558,17 @@ struct a12_vframe_opts {
 
 enum a12_aframe_method {
 	AFRAME_METHOD_RAW = 0,
+
+/* falls back to RAW if built without libopus or other end can't decode it,
+ * needs 48kHz (or 8/12/16/24kHz) mono or stereo */
+	AFRAME_METHOD_OPUS = 1
 };
 
 struct a12_aframe_opts {
 	enum a12_aframe_method method;
+
+	size_t frame_us; /* opus: 2500, 5000, 10000 or 20000 (default) */
+	size_t bitrate;  /* opus: kbit/s, 0 = codec default */
 };
 
 struct a12_aframe_cfg {
@@ -547,6 +622,12 @@ struct a12_bhandler_meta {
 struct a12_bhandler_res {
 	enum a12_bhandler_flag flag;
 	int fd;
+
+/* [fd] already holds the start of this stream (a previous transfer with the
+ * same checksum that got interrupted). If the other end supports it, the
+ * transfer continues after the part of the prefix it could verify and [fd]
+ * is positioned and truncated to that point, otherwise it restarts at 0. */
+	bool resume;
 };
 void
 a12_set_bhandler(struct a12_state*,
@@ -593,6 +674,84 @@ a12_channel_vframe(
 	struct a12_vframe_opts opts
 );
 
+/*
+ * Move video encoding off the thread that services [S]. a12_channel_vframe
+ * then only copies the buffer and returns, the encoded frame is added to the
+ * output on a later a12_poll or a12_flush. [ready] is called from the worker
+ * thread whenever a frame has finished encoding and should only be used to
+ * wake up whatever services [S], not to call into it.
+ *
+ * [threads] sets how many threads the zstd based methods get to compress
+ * large frames as bands in parallel, 0 keeps the default.
+ *
+ * While the worker is busy the iostat venc_busy field is set, frames that
+ * are provided anyhow are dropped (or wait for passthrough) and the next one
+ * is sent in full.
+ *
+ * Calling with [threads] 0 and no [ready] stops the worker again.
+ *
+ * Returns false if there already is a worker, if the state has a sink set or
+ * if the thread could not be created.
+ */
+bool
+a12_set_venc_worker(struct a12_state* S, size_t threads,
+	void (*ready)(struct a12_state*, void* tag), void* tag);
+
+/*
+ * Relay: encode one source once and send it to many authenticated states.
+ * Each frame is compressed a single time and copied into the video outq of
+ * every attached state, only the framing (sequence numbers, stream ids and
+ * the encryption in a12_flush) is done per viewer.
+ *
+ * The relayed stream is restricted to the raw and zstd methods, the others
+ * (tiles, h264, adaptive) hold per-sink reference state and are mapped to
+ * DZSTD. Precompressed passthrough frames are dropped.
+ *
+ * A viewer that is attached late, or that is backed up enough that a frame
+ * would be dropped for it, is skipped until it can take a keyframe of the
+ * current contents. That keyframe is built on demand from a copy of the last
+ * frame and cached until the next one, so other viewers are not affected.
+ *
+ * Video goes out on the channel of each state that was set with a12_set_channel
+ * at the time of the call. The relay does not take ownership of attached
+ * states and the caller is expected to serialize calls into it and the states.
+ */
+struct a12_relay;
+struct a12_relay* a12_relay_create(void);
+
+/*
+ * Add [S] as a viewer, if the relay has seen a frame the keyframe is queued
+ * for it immediately. Returns false if there is no room left.
+ */
+bool a12_relay_attach(struct a12_relay* R, struct a12_state* S);
+void a12_relay_detach(struct a12_relay* R, struct a12_state* S);
+
+void a12_relay_vframe(struct a12_relay* R,
+	struct shmifsrv_vbuffer* vb, struct a12_vframe_opts opts);
+
+void a12_relay_free(struct a12_relay* R);
+
+/*
+ * Move decoding of buffered video frames (tiles and the zstd based methods)
+ * off the thread that calls a12_unpack. Frames on different channels then
+ * decode in parallel on up to [threads] threads (0 = one per core), and a
+ * frame that came as zstd bands has those split across them as well. The
+ * destination of a channel is written to by the worker until the frame is
+ * signalled, which happens in order on a later a12_unpack or a12_poll.
+ * [ready] is called from the worker when there is something to signal and
+ * should only be used to wake up whatever services [S].
+ *
+ * h264 stays on the calling thread.
+ *
+ * Calling with [threads] 0 and no [ready] stops the worker again.
+ *
+ * Returns false if there already is a worker or if no thread could be
+ * created.
+ */
+bool
+a12_set_vdec_worker(struct a12_state* S, size_t threads,
+	void (*ready)(struct a12_state*, void* tag), void* tag);
+
 /*
  * Forward / start a new channel intended for the 'real' client. If this
  * comes as a NEWSEGMENT event from the 'real' arcan instance, make sure
@@ -662,6 +821,28 @@ struct a12_iostat {
 	size_t ms_vframe;           /* for last encoded video frame */
 	float ms_vframe_px;
 	size_t packets_pending;     /* delta between seqnr and last-seen seqnr */
+	size_t out_queued;          /* a/v bytes waiting for the output buffer */
+	size_t out_rate;            /* estimated drain rate, b/s (0 = unknown) */
+	size_t out_drain_ms;        /* estimated time to drain queued + buffered */
+	size_t vframe_dropped;      /* frames skipped due to output pressure */
+	bool venc_busy;             /* encode worker can't take more frames */
+
+/* link model from video frame acks, 0 until the first ones got back,
+ * roundtrip_latency above is the smoothed round trip */
+	size_t link_rtt_min;        /* ms, minimum over the last 10s */
+	size_t link_rate;           /* bottleneck estimate, b/s */
+	size_t link_inflight;       /* bytes flushed but not known to be delivered */
+	size_t link_cwnd;           /* in-flight limit video backs off at */
+
+/* datagram transport, units that never completed and refreshes requested */
+	size_t dgram_lost;
+	size_t dgram_refresh;
+
+/* opus audio jitter buffer, current playout delay, frames synthesised due to
+ * loss or underrun and frames skipped to catch up or arriving too late */
+	size_t audio_delay_ms;
+	size_t audio_concealed;
+	size_t audio_skipped;
 };
 
 /* get / set a string representation for logging and similar operations
@@ -674,6 +855,58 @@ void a12_set_endpoint(struct a12_state* S, const char*);
  */
 struct a12_iostat a12_state_iostat(struct a12_state* S);
 
+/*
+ * Datagram transport, for when both ends set the datagram context option.
+ * Control, input and binary transfers stay on the regular stream while audio
+ * and video units are cut into datagrams that are individually encrypted and
+ * authenticated with keys derived from the session. There is no resend, a
+ * lost audio unit is skipped and a lost video unit makes the sink discard
+ * video and ask the source (over the stream) for a refresh: codecs and tile
+ * caches are reset on both ends and the next frame is sent in full over the
+ * stream, with the datagrams continuing from there.
+ *
+ * The carrier is left to the API user:
+ *
+ * a12_datagram_ready - authenticated with the feature on both ends.
+ *
+ * a12_datagram_announce - send the [port] the local end receives on, the
+ *                         other end gets it from a12_datagram_port.
+ *
+ * a12_datagram_enable - start cutting a/v into datagrams of at most [mtu]
+ *                       bytes (when the sending end knows the other end can
+ *                       be reached), returns false if not ready.
+ *
+ * a12_datagram_flush - get the next datagram to send, returns its size or 0,
+ *                      the buffer is valid until the next call into [S].
+ *                      Also call it periodically (~100ms) on the receiving
+ *                      end as that is where units that stopped short are
+ *                      found.
+ *
+ * a12_datagram_unpack - feed a received datagram, returns true if it was
+ *                       authentic, for a receiver that needs to learn where
+ *                       the other end is (first authentic datagram).
+ *
+ * a12_datagram_probe - queue an empty datagram, to let the other end learn
+ *                      the address or to keep a mapping open.
+ */
+bool a12_datagram_ready(struct a12_state* S);
+void a12_datagram_announce(struct a12_state* S, uint16_t port);
+uint16_t a12_datagram_port(struct a12_state* S);
+bool a12_datagram_enable(struct a12_state* S, size_t mtu);
+size_t a12_datagram_flush(struct a12_state* S, uint8_t** buf);
+bool a12_datagram_unpack(struct a12_state* S,
+	const uint8_t* buf, size_t buf_sz, void* tag, void (*on_event)
+	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*));
+void a12_datagram_probe(struct a12_state* S);
+
+/*
+ * Audio that was sent as opus is decoded into a jitter buffer rather than
+ * forwarded as it arrives. Playout runs from this function: call it when it
+ * asks for it and after a12_unpack. Returns the number of milliseconds until
+ * the next call is needed or -1 if there is no audio being played out.
+ */
+int a12_audio_step(struct a12_state* S);
+
 /*
  * Try to negotiate a connection for a directory resource based on an announced
  * public key. An ephemeral keypair will be generated and part of the reply.
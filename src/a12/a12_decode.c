@@ -10,11 +10,18 @@
 #include <inttypes.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "a12.h"
 #include "a12_int.h"
+#include "a12_decode.h"
 #include "zstd.h"
 
+#ifdef WANT_OPUS
+#include <opus.h>
+#endif
+
 #ifdef LOG_FRAME_OUTPUT
 #define STB_IMAGE_WRITE_STATIC
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -22,8 +29,19 @@
 #include "../../engine/external/stb_image_write.h"
 #endif
 
+/* for segments in subregion mode, each completed frame adds to the damage
+ * and the committing one synchs them together */
+static void mark_region(struct arcan_shmif_cont* cont, struct video_frame* cvf)
+{
+	if (cont && (cont->hints & SHMIF_RHINT_SUBREGION))
+		arcan_shmif_dirty(cont, cvf->x, cvf->y, cvf->x + cvf->w, cvf->y + cvf->h, 0);
+}
+
+static void video_transit(struct a12_channel* ch, struct video_frame* cvf);
+
 static void drain_video(struct a12_channel* ch, struct video_frame* cvf)
 {
+	video_transit(ch, cvf);
 	cvf->commit = 0;
 	if (ch->active == CHANNEL_RAW){
 		a12int_trace(A12_TRACE_VIDEO,
@@ -38,6 +56,7 @@ static void drain_video(struct a12_channel* ch, struct video_frame* cvf)
 
 	a12int_trace(A12_TRACE_VIDEO,
 		"kind=drain:dest=%"PRIxPTR":ts=%llu", (uintptr_t) ch->cont, arcan_timemillis());
+	mark_region(ch->cont, cvf);
 	arcan_shmif_signal(ch->cont, SHMIF_SIGVID);
 }
 
@@ -47,14 +66,13 @@ bool a12int_buffer_format(int method)
 		method == POSTPROCESS_VIDEO_H264 ||
 		method == POSTPROCESS_VIDEO_TZSTD ||
 		method == POSTPROCESS_VIDEO_ZSTD ||
-		method == POSTPROCESS_VIDEO_DZSTD;
+		method == POSTPROCESS_VIDEO_DZSTD ||
+		method == POSTPROCESS_VIDEO_TILES;
 }
 
-static int video_miniz(const void* buf, int len, void* user)
+static int video_miniz(struct arcan_shmif_cont* cont,
+	struct video_frame* cvf, const void* buf, int len)
 {
-	struct a12_state* S = user;
-	struct video_frame* cvf = &S->channels[S->in_channel].unpack_state.vframe;
-	struct arcan_shmif_cont* cont = S->channels[S->in_channel].cont;
 	const uint8_t* inbuf = buf;
 
 	if (!cont || len > cvf->expanded_sz){
@@ -150,6 +168,96 @@ static int video_miniz(const void* buf, int len, void* user)
 
 #ifdef WANT_H264_DEC
 
+#define A12_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) |\
+	((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+/*
+ * Hand a decoded hardware surface to the sink as dma-buf planes rather than
+ * reading it back. vaapi surfaces are mapped to DRM PRIME first, v4l2m2m is
+ * already there. The frame is held so that the decoder won't recycle the
+ * surface while the sink may still be sampling from it.
+ */
+static bool pass_planes(struct a12_channel* ch,
+	AVFrame* frame, struct arcan_shmif_cont* cont)
+{
+	if (ch->active != CHANNEL_SHMIF || !arcan_shmif_handle_permitted(cont))
+		return false;
+
+	AVFrame* drm = av_frame_alloc();
+	if (!drm)
+		return false;
+
+	if (frame->format == AV_PIX_FMT_DRM_PRIME){
+		if (av_frame_ref(drm, frame) < 0)
+			goto fail;
+	}
+	else {
+		drm->format = AV_PIX_FMT_DRM_PRIME;
+		if (av_hwframe_map(drm, frame, AV_HWFRAME_MAP_READ) < 0)
+			goto fail;
+	}
+
+	const AVDRMFrameDescriptor* desc = (const AVDRMFrameDescriptor*) drm->data[0];
+	size_t n_planes = 0;
+	for (int l = 0; l < desc->nb_layers; l++)
+		n_planes += desc->layers[l].nb_planes;
+
+	if (!n_planes || n_planes > 4)
+		goto fail;
+
+/* vaapi exports NV12 as separate R8 + GR88 layers, the sink wants the one
+ * format for all the planes */
+	uint32_t fourcc = desc->layers[0].format;
+	if (desc->nb_layers == 2 &&
+		fourcc == A12_FOURCC('R', '8', ' ', ' ') &&
+		desc->layers[1].format == A12_FOURCC('G', 'R', '8', '8'))
+		fourcc = A12_FOURCC('N', 'V', '1', '2');
+
+	struct arcan_event ev = {
+		.category = EVENT_EXTERNAL,
+		.ext.kind = ARCAN_EVENT(BUFFERSTREAM)
+	};
+
+	size_t left = n_planes;
+	for (int l = 0; l < desc->nb_layers; l++){
+		const AVDRMLayerDescriptor* layer = &desc->layers[l];
+
+		for (int p = 0; p < layer->nb_planes; p++){
+			const AVDRMPlaneDescriptor* plane = &layer->planes[p];
+			const AVDRMObjectDescriptor* obj = &desc->objects[plane->object_index];
+
+/* a failure past the first plane leaves the sink with a partial set, it will
+ * reject that and the BUFFER_FAIL puts us on the readback path */
+			if (!arcan_pushhandle(obj->fd, cont->epipe)){
+				if (left == n_planes)
+					goto fail;
+				av_frame_free(&drm);
+				return true;
+			}
+
+			ev.ext.bstream.stride = plane->pitch;
+			ev.ext.bstream.offset = plane->offset;
+			ev.ext.bstream.format = fourcc;
+			ev.ext.bstream.mod_hi = obj->format_modifier >> 32;
+			ev.ext.bstream.mod_lo = obj->format_modifier & 0xffffffff;
+			ev.ext.bstream.width = frame->width;
+			ev.ext.bstream.height = frame->height;
+			ev.ext.bstream.left = --left;
+			arcan_shmif_enqueue(cont, &ev);
+		}
+	}
+
+	size_t ind = ch->videnc.held_ind;
+	av_frame_free(&ch->videnc.held[ind]);
+	ch->videnc.held[ind] = drm;
+	ch->videnc.held_ind = (ind + 1) % A12_HWVIDEO_HOLD;
+	return true;
+
+fail:
+	av_frame_free(&drm);
+	return false;
+}
+
 void ffmpeg_decode_pkt(
 	struct a12_state* S, struct video_frame* cvf, struct arcan_shmif_cont* cont)
 {
@@ -174,36 +282,100 @@ void ffmpeg_decode_pkt(
 			return;
 		}
 
+		struct a12_channel* ch = &S->channels[S->in_channel];
+		AVFrame* src = cvf->ffmpeg.frame;
+
+/* hardware surfaces go to the sink as is if it takes handles, otherwise
+ * they are read back and converted like the rest */
+		if (src->format == AV_PIX_FMT_VAAPI || src->format == AV_PIX_FMT_DRM_PRIME){
+			if (pass_planes(ch, src, cont)){
+				a12int_trace(A12_TRACE_VIDEO, "ffmpeg:kind=handle:commit=%d", cvf->commit);
+				if (cvf->commit && cvf->commit != 255)
+					drain_video(ch, cvf);
+				continue;
+			}
+
+			if (!ch->videnc.hwframe && !(ch->videnc.hwframe = av_frame_alloc()))
+				return;
+
+			av_frame_unref(ch->videnc.hwframe);
+			if (av_hwframe_transfer_data(ch->videnc.hwframe, src, 0) < 0){
+				a12int_trace(A12_TRACE_SYSTEM, "ffmpeg:kind=readback_fail");
+				a12_vstream_cancel(S, S->in_channel, STREAM_CANCEL_DECODE_ERROR);
+				return;
+			}
+			src = ch->videnc.hwframe;
+		}
+
 		a12int_trace(A12_TRACE_VIDEO,
-			"ffmpeg:kind=convert:commit=%d:format=yub420p", cvf->commit);
-/* Quite possible that we should actually cache this context as well, but it
- * has different behavior to the rest due to resize. Since this all turns
- * ffmpeg into a dependency, maybe it belongs in the vframe setup on resize. */
-		struct SwsContext* scaler =
-			sws_getContext(cvf->w, cvf->h, AV_PIX_FMT_YUV420P,
-				cvf->w, cvf->h, AV_PIX_FMT_BGRA, SWS_BILINEAR, NULL, NULL, NULL);
+			"ffmpeg:kind=convert:commit=%d:format=%d", cvf->commit, src->format);
+
+/* cached on the channel, only rebuilt if the size or format changes */
+		ch->videnc.scaler = sws_getCachedContext(ch->videnc.scaler,
+			cvf->w, cvf->h, src->format,
+			cvf->w, cvf->h, AV_PIX_FMT_BGRA, SWS_BILINEAR, NULL, NULL, NULL);
+		if (!ch->videnc.scaler){
+			a12_vstream_cancel(S, S->in_channel, STREAM_CANCEL_DECODE_ERROR);
+			return;
+		}
 
 		uint8_t* const dst[] = {cont->vidb};
 		int dst_stride[] = {cont->stride};
 
-		sws_scale(scaler, (const uint8_t* const*) cvf->ffmpeg.frame->data,
-			cvf->ffmpeg.frame->linesize, 0, cvf->h, dst, dst_stride);
+		sws_scale(ch->videnc.scaler, (const uint8_t* const*) src->data,
+			src->linesize, 0, cvf->h, dst, dst_stride);
 
 /* Mark that we should send a ping so the other side can update the drift wnd */
 		if (cvf->commit && cvf->commit != 255){
-			drain_video(&S->channels[S->in_channel], cvf);
+			drain_video(ch, cvf);
 		}
+	}
+}
+
+static enum AVPixelFormat hw_get_format(
+	AVCodecContext* ctx, const enum AVPixelFormat* fmt)
+{
+	enum AVPixelFormat want = (enum AVPixelFormat)(intptr_t) ctx->opaque;
+	for (size_t i = 0; fmt[i] != AV_PIX_FMT_NONE; i++)
+		if (fmt[i] == want)
+			return want;
+
+	return avcodec_default_get_format(ctx, fmt);
+}
+
+/* vaapi decodes through the regular h264 decoder with a device attached,
+ * v4l2m2m is a decoder of its own that can output DRM PRIME frames */
+static void hw_decoder_setup(struct a12_state* S, struct a12_channel* ch)
+{
+	AVCodecContext* ctx = ch->videnc.encdec;
 
-		sws_freeContext(scaler);
+	if (S->opts->hw_video == A12_HWVIDEO_VAAPI){
+		if (av_hwdevice_ctx_create(&ch->videnc.hwdev,
+			AV_HWDEVICE_TYPE_VAAPI, S->opts->hw_video_device, NULL, 0) < 0){
+			a12int_trace(A12_TRACE_SYSTEM, "kind=error:message=vaapi device failed");
+			ch->videnc.hw_failed = true;
+			return;
+		}
+		ctx->hw_device_ctx = av_buffer_ref(ch->videnc.hwdev);
+		ctx->opaque = (void*)(intptr_t) AV_PIX_FMT_VAAPI;
+		ctx->get_format = hw_get_format;
+	}
+	else if (S->opts->hw_video == A12_HWVIDEO_V4L2M2M &&
+		strcmp(ch->videnc.codec->name, "h264_v4l2m2m") == 0){
+		ctx->opaque = (void*)(intptr_t) AV_PIX_FMT_DRM_PRIME;
+		ctx->get_format = hw_get_format;
 	}
 }
 
-static bool ffmpeg_alloc(struct a12_channel* ch, int method)
+static bool ffmpeg_alloc(struct a12_state* S, struct a12_channel* ch, int method)
 {
 	bool new_codec = false;
 
 	if (!ch->videnc.codec){
-		ch->videnc.codec = avcodec_find_decoder(method);
+		if (!ch->videnc.hw_failed && S->opts->hw_video == A12_HWVIDEO_V4L2M2M)
+			ch->videnc.codec = avcodec_find_decoder_by_name("h264_v4l2m2m");
+		if (!ch->videnc.codec)
+			ch->videnc.codec = avcodec_find_decoder(method);
 		if (!ch->videnc.codec){
 			a12int_trace(A12_TRACE_SYSTEM, "couldn't find h264 decoder");
 			return false;
@@ -217,12 +389,25 @@ static bool ffmpeg_alloc(struct a12_channel* ch, int method)
 			a12int_trace(A12_TRACE_SYSTEM, "couldn't setup h264 codec context");
 			return false;
 		}
+		if (!ch->videnc.hw_failed)
+			hw_decoder_setup(S, ch);
 	}
 
-/* got the context, but it needs to be 'opened' as well */
+/* got the context, but it needs to be 'opened' as well, if that fails with
+ * a hardware backend, go again with the software decoder */
 	if (new_codec){
-		if (avcodec_open2(ch->videnc.encdec, ch->videnc.codec, NULL ) < 0)
-			return false;
+		if (avcodec_open2(ch->videnc.encdec, ch->videnc.codec, NULL ) < 0){
+			if (ch->videnc.encdec->get_format != hw_get_format)
+				return false;
+
+			a12int_trace(A12_TRACE_SYSTEM,
+				"kind=error:message=%s failed, using software", ch->videnc.codec->name);
+			avcodec_free_context(&ch->videnc.encdec);
+			av_buffer_unref(&ch->videnc.hwdev);
+			ch->videnc.codec = NULL;
+			ch->videnc.hw_failed = true;
+			return ffmpeg_alloc(S, ch, method);
+		}
 	}
 
 	if (!ch->videnc.parser){
@@ -259,25 +444,36 @@ static bool ffmpeg_alloc(struct a12_channel* ch, int method)
 
 void a12int_decode_drop(struct a12_state* S, int chid, bool failed)
 {
+	a12int_vdec_sync(S, chid);
+
 	if (S->channels[chid].unpack_state.vframe.zstd){
 		ZSTD_freeDCtx(S->channels[chid].unpack_state.vframe.zstd);
-		S->channels[chid].zstd = NULL;
+		S->channels[chid].unpack_state.vframe.zstd = NULL;
 	}
 
+	free(S->channels[chid].tile_cache);
+	S->channels[chid].tile_cache = NULL;
+	a12int_tile_lru_free(S->channels[chid].tile_lru);
+	S->channels[chid].tile_lru = NULL;
+
 #if defined(WANT_H264_ENC) || defined(WANT_H264_DEC)
+	for (size_t i = 0; i < A12_HWVIDEO_HOLD; i++)
+		av_frame_free(&S->channels[chid].videnc.held[i]);
+
 	if (!S->channels[chid].videnc.encdec)
 		return;
 
 #endif
 }
 
-bool a12int_vframe_setup(struct a12_channel* ch, struct video_frame* dst, int method)
+bool a12int_vframe_setup(struct a12_state* S,
+	struct a12_channel* ch, struct video_frame* dst, int method)
 {
 	*dst = (struct video_frame){};
 
 	if (method == POSTPROCESS_VIDEO_H264){
 #ifdef WANT_H264_DEC
-		if (!ffmpeg_alloc(ch, AV_CODEC_ID_H264))
+		if (!ffmpeg_alloc(S, ch, AV_CODEC_ID_H264))
 			return false;
 
 /* parser, context, packet, frame, scaler */
@@ -294,52 +490,438 @@ bool a12int_vframe_setup(struct a12_channel* ch, struct video_frame* dst, int me
 	return true;
 }
 
-void a12int_decode_vbuffer(struct a12_state* S,
-	struct a12_channel* ch, struct video_frame* cvf, struct arcan_shmif_cont* cont)
+struct a12_tile_lru* a12int_tile_lru_alloc(bool pixels)
 {
-	a12int_trace(A12_TRACE_VIDEO, "decode vbuffer, method: %d", cvf->postprocess);
-	if ( cvf->postprocess == POSTPROCESS_VIDEO_DZSTD
-		|| cvf->postprocess == POSTPROCESS_VIDEO_ZSTD
-		|| cvf->postprocess == POSTPROCESS_VIDEO_TZSTD)
-	{
-		uint64_t content_sz = ZSTD_getFrameContentSize(cvf->inbuf, cvf->inbuf_pos);
+	struct a12_tile_lru* L = malloc(sizeof(struct a12_tile_lru));
+	if (!L)
+		return NULL;
 
-/* repeat and compare, don't le/gt */
-		if (content_sz == cvf->expanded_sz){
-			if (!ch->unpack_state.vframe.zstd &&
-				!(ch->unpack_state.vframe.zstd = ZSTD_createDCtx())){
-				a12int_trace(A12_TRACE_SYSTEM,
-					"kind=alloc_error:zstd_context_alloc");
+	L->head = L->tail = A12_TILE_NOSLOT;
+	L->used = 0;
+	for (size_t i = 0; i < A12_TILE_LRU; i++)
+		L->bucket[i] = A12_TILE_NOSLOT;
+
+	L->pixels = NULL;
+	if (pixels &&
+		!(L->pixels = malloc(A12_TILE_LRU * A12_TILE_SZ * A12_TILE_SZ * 3))){
+		free(L);
+		return NULL;
+	}
+
+	return L;
+}
+
+void a12int_tile_lru_free(struct a12_tile_lru* L)
+{
+	if (!L)
+		return;
+
+	free(L->pixels);
+	free(L);
+}
+
+void a12int_tile_digest(
+	const uint8_t* px, size_t w, size_t h, uint8_t out[A12_TILE_DIGEST])
+{
+	uint8_t dim[4];
+	pack_u16(w, &dim[0]);
+	pack_u16(h, &dim[2]);
+
+	blake3_hasher hash;
+	blake3_hasher_init(&hash);
+	blake3_hasher_update(&hash, dim, 4);
+	blake3_hasher_update(&hash, px, w * h * 3);
+	blake3_hasher_finalize(&hash, out, A12_TILE_DIGEST);
+}
+
+static size_t lru_bucket(const uint8_t digest[A12_TILE_DIGEST])
+{
+	return (digest[0] | (digest[1] << 8)) % A12_TILE_LRU;
+}
+
+static void lru_unlink(struct a12_tile_lru* L, uint16_t i)
+{
+	if (L->ent[i].prev != A12_TILE_NOSLOT)
+		L->ent[L->ent[i].prev].next = L->ent[i].next;
+	else
+		L->head = L->ent[i].next;
+
+	if (L->ent[i].next != A12_TILE_NOSLOT)
+		L->ent[L->ent[i].next].prev = L->ent[i].prev;
+	else
+		L->tail = L->ent[i].prev;
+}
+
+static void lru_front(struct a12_tile_lru* L, uint16_t i)
+{
+	L->ent[i].prev = A12_TILE_NOSLOT;
+	L->ent[i].next = L->head;
+	if (L->head != A12_TILE_NOSLOT)
+		L->ent[L->head].prev = i;
+	L->head = i;
+	if (L->tail == A12_TILE_NOSLOT)
+		L->tail = i;
+}
+
+uint16_t a12int_tile_lru_find(
+	struct a12_tile_lru* L, const uint8_t digest[A12_TILE_DIGEST])
+{
+	uint16_t i = L->bucket[lru_bucket(digest)];
+	while (i != A12_TILE_NOSLOT &&
+		memcmp(L->ent[i].digest, digest, A12_TILE_DIGEST) != 0)
+		i = L->ent[i].chain;
+
+	if (i != A12_TILE_NOSLOT && i != L->head){
+		lru_unlink(L, i);
+		lru_front(L, i);
+	}
+
+	return i;
+}
+
+uint16_t a12int_tile_lru_insert(struct a12_tile_lru* L,
+	const uint8_t digest[A12_TILE_DIGEST], size_t w, size_t h)
+{
+	uint16_t i = a12int_tile_lru_find(L, digest);
+	if (i != A12_TILE_NOSLOT)
+		return i;
+
+	if (L->used < A12_TILE_LRU)
+		i = L->used++;
+
+/* evict the tail, which also means taking it out of its hash chain */
+	else {
+		i = L->tail;
+		lru_unlink(L, i);
+
+		uint16_t* pos = &L->bucket[lru_bucket(L->ent[i].digest)];
+		while (*pos != i)
+			pos = &L->ent[*pos].chain;
+		*pos = L->ent[i].chain;
+	}
+
+	memcpy(L->ent[i].digest, digest, A12_TILE_DIGEST);
+	L->ent[i].w = w;
+	L->ent[i].h = h;
+
+	size_t b = lru_bucket(digest);
+	L->ent[i].chain = L->bucket[b];
+	L->bucket[b] = i;
+	lru_front(L, i);
+
+	return i;
+}
+
+/*
+ * Tile records are written straight into the destination at their position,
+ * see the format description in a12_int.h.
+ */
+static void decode_tiles(struct a12_channel* ch,
+	struct video_frame* cvf, struct arcan_shmif_cont* cont)
+{
+	const size_t slot_sz = A12_TILE_SZ * A12_TILE_SZ * 3;
+
+	if (!ch->unpack_state.vframe.zstd &&
+		!(ch->unpack_state.vframe.zstd = ZSTD_createDCtx())){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=alloc_error:zstd_context_alloc");
+		return;
+	}
+
+	uint8_t tmp[A12_TILE_SZ * A12_TILE_SZ * 3];
+	uint8_t* buf = cvf->inbuf;
+	size_t left = cvf->inbuf_pos;
+
+	while (left >= 5){
+		uint16_t col, row, slot = A12_TILE_NOSLOT;
+		unpack_u16(&col, &buf[0]);
+		unpack_u16(&row, &buf[2]);
+		uint8_t type = buf[4];
+
+		size_t tx = (size_t) col * A12_TILE_SZ, ty = (size_t) row * A12_TILE_SZ;
+		if (tx >= cont->w || ty >= cont->h)
+			goto bad;
+
+		size_t tw = cont->w - tx < A12_TILE_SZ ? cont->w - tx : A12_TILE_SZ;
+		size_t th = cont->h - ty < A12_TILE_SZ ? cont->h - ty : A12_TILE_SZ;
+		size_t raw_sz = tw * th * 3;
+		uint8_t* px = NULL;
+		size_t used;
+
+		if (type == TILE_SOLID){
+			if (left < 8)
+				goto bad;
+			shmif_pixel col = SHMIF_RGBA(buf[5], buf[6], buf[7], 0xff);
+			for (size_t y = ty; y < ty + th; y++){
+				shmif_pixel* dst = &cont->vidp[y * cont->pitch + tx];
+				for (size_t x = 0; x < tw; x++)
+					dst[x] = col;
 			}
-/* actually decompress */
-			else {
-				void* buffer = malloc(content_sz);
-				if (buffer){
-					uint64_t decode =
-						ZSTD_decompressDCtx(ch->unpack_state.vframe.zstd,
-							buffer, content_sz, cvf->inbuf, cvf->inbuf_pos);
-					a12int_trace(A12_TRACE_VIDEO, "kind=zstd_state:%"PRIu64, decode);
-					video_miniz(buffer, content_sz, S);
-					free(buffer);
+			used = 8;
+		}
+		else if (type == TILE_HASH){
+			if (left < 5 + A12_TILE_DIGEST || !ch->tile_lru)
+				goto bad;
+
+			uint16_t i = a12int_tile_lru_find(ch->tile_lru, &buf[5]);
+			if (i == A12_TILE_NOSLOT ||
+				ch->tile_lru->ent[i].w != tw || ch->tile_lru->ent[i].h != th)
+				goto bad;
+
+			px = &ch->tile_lru->pixels[i * slot_sz];
+			used = 5 + A12_TILE_DIGEST;
+		}
+		else {
+			if (left < 7)
+				goto bad;
+			unpack_u16(&slot, &buf[5]);
+			if (slot != A12_TILE_NOSLOT && slot >= A12_TILE_CACHE)
+				goto bad;
+
+			if (slot != A12_TILE_NOSLOT && !ch->tile_cache &&
+				!(ch->tile_cache = malloc(A12_TILE_CACHE * slot_sz))){
+				a12int_trace(A12_TRACE_SYSTEM, "kind=alloc_error:tile_cache");
+				return;
+			}
+
+			uint8_t* store = slot == A12_TILE_NOSLOT ?
+				tmp : &ch->tile_cache[slot * slot_sz];
+
+			if (type == TILE_CACHE){
+				if (slot == A12_TILE_NOSLOT)
+					goto bad;
+				px = store;
+				used = 7;
+			}
+			else if (type == TILE_RAW){
+				if (left < 7 + raw_sz)
+					goto bad;
+				memcpy(store, &buf[7], raw_sz);
+				px = store;
+				used = 7 + raw_sz;
+			}
+			else if (type == TILE_ZSTD){
+				uint32_t len;
+				if (left < 11)
+					goto bad;
+				unpack_u32(&len, &buf[7]);
+				if (left - 11 < len)
+					goto bad;
+
+				size_t nb = ZSTD_decompressDCtx(
+					ch->unpack_state.vframe.zstd, store, slot_sz, &buf[11], len);
+				if (ZSTD_isError(nb) || nb != raw_sz)
+					goto bad;
+				px = store;
+				used = 11 + len;
+			}
+			else
+				goto bad;
+
+/* without a slot the tile goes into the content addressed cache, the
+ * encoder does the same insert so the next HASH record can refer to it */
+			if (slot == A12_TILE_NOSLOT && type != TILE_CACHE){
+				if (!ch->tile_lru && !(ch->tile_lru = a12int_tile_lru_alloc(true))){
+					a12int_trace(A12_TRACE_SYSTEM, "kind=alloc_error:tile_lru");
+					return;
 				}
+
+				uint8_t digest[A12_TILE_DIGEST];
+				a12int_tile_digest(px, tw, th, digest);
+				uint16_t i = a12int_tile_lru_insert(ch->tile_lru, digest, tw, th);
+				px = &ch->tile_lru->pixels[i * slot_sz];
+				memcpy(px, store, raw_sz);
 			}
 		}
-		else {
-			a12int_trace(A12_TRACE_SYSTEM,
-				"kind=decode_error:in_sz=%zu:exp_sz=%zu:message=size mismatch",
-				(size_t) content_sz, (size_t) cvf->expanded_sz
-			);
+
+		if (px){
+			for (size_t y = ty; y < ty + th; y++){
+				shmif_pixel* dst = &cont->vidp[y * cont->pitch + tx];
+				for (size_t x = 0; x < tw; x++, px += 3)
+					dst[x] = SHMIF_RGBA(px[0], px[1], px[2], 0xff);
+			}
 		}
 
-		free(cvf->inbuf);
-		cvf->inbuf = NULL;
-		cvf->carry = 0;
+		buf += used;
+		left -= used;
+	}
+
+	return;
+
+bad:
+	a12int_trace(A12_TRACE_SYSTEM,
+		"kind=decode_error:message=bad tile record at %zu",
+		(size_t)(buf - cvf->inbuf));
+}
+
+/*
+ * A large ZSTD/DZSTD frame can come as a series of zstd frames, one per band
+ * of whole rows (A12_FEATURE_ZBANDS). Those decompress and unpack into their
+ * part of the destination independently of each other.
+ */
+struct zstd_band {
+	const uint8_t* in;
+	size_t in_sz;
+	size_t out_ofs;
+	size_t out_sz;
+	bool failed;
+};
+
+struct band_decode {
+	struct zstd_band band[ZSTD_VIDEO_BANDS_MAX];
+	struct arcan_shmif_cont* cont;
+	struct video_frame* cvf;
+	uint8_t* out;
+	size_t row_sz;
+};
+
+/* returns the number of frames in the buffer or 0 if they don't add up */
+static size_t zstd_bands(struct video_frame* cvf, struct zstd_band* band)
+{
+	size_t n = 0, ofs = 0, total = 0;
+
+	while (ofs < cvf->inbuf_pos){
+		if (n == ZSTD_VIDEO_BANDS_MAX)
+			return 0;
+
+		size_t left = cvf->inbuf_pos - ofs;
+		size_t in_sz = ZSTD_findFrameCompressedSize(&cvf->inbuf[ofs], left);
+		uint64_t out_sz = ZSTD_getFrameContentSize(&cvf->inbuf[ofs], left);
+		if (ZSTD_isError(in_sz) ||
+			out_sz == ZSTD_CONTENTSIZE_UNKNOWN || out_sz == ZSTD_CONTENTSIZE_ERROR ||
+			out_sz > cvf->expanded_sz - total)
+			return 0;
+
+		band[n++] = (struct zstd_band){
+			.in = &cvf->inbuf[ofs],
+			.in_sz = in_sz,
+			.out_ofs = total,
+			.out_sz = out_sz
+		};
+		ofs += in_sz;
+		total += out_sz;
+	}
+
+/* repeat and compare, don't le/gt */
+	return total == cvf->expanded_sz ? n : 0;
+}
+
+static void decode_band(size_t i, void* tag)
+{
+	struct band_decode* D = tag;
+	struct zstd_band* B = &D->band[i];
+
+	size_t nb = ZSTD_decompress(&D->out[B->out_ofs], B->out_sz, B->in, B->in_sz);
+	if (ZSTD_isError(nb) || nb != B->out_sz){
+		B->failed = true;
+		return;
+	}
+
+/* the band starts on a row of its own, unpack as if it was a frame of that */
+	struct video_frame bf = *D->cvf;
+	bf.out_pos = D->cvf->out_pos + (B->out_ofs / D->row_sz) * D->cont->pitch;
+	bf.row_left = D->cvf->w;
+	bf.expanded_sz = B->out_sz;
+	bf.carry = 0;
+	video_miniz(D->cont, &bf, &D->out[B->out_ofs], B->out_sz);
+}
+
+static void decode_zstd(struct a12_state* S,
+	struct a12_channel* ch, struct video_frame* cvf, struct arcan_shmif_cont* cont)
+{
+	struct band_decode D = {
+		.cont = cont,
+		.cvf = cvf,
+		.row_sz = (size_t) cvf->w * 3
+	};
+
+	size_t n_bands = zstd_bands(cvf, D.band);
+	if (!n_bands){
+		a12int_trace(A12_TRACE_SYSTEM,
+			"kind=decode_error:in_sz=%zu:exp_sz=%zu:message=size mismatch",
+			(size_t) cvf->inbuf_pos, (size_t) cvf->expanded_sz
+		);
+		return;
+	}
+
+/* tpack is a byte stream and bands off the row grid can't be split */
+	bool split = n_bands > 1 && cont &&
+		cvf->postprocess != POSTPROCESS_VIDEO_TZSTD && D.row_sz;
+	for (size_t i = 0; split && i < n_bands - 1; i++)
+		split = D.band[i].out_sz % D.row_sz == 0;
+
+	if (!(D.out = a12int_pool_alloc(S, cvf->expanded_sz))){
+		a12int_trace(A12_TRACE_ALLOC, "kind=alloc_error:zstd_buffer");
+		return;
+	}
+
+	if (split){
+		a12int_band_run(n_bands, S->vdec_threads, decode_band, &D);
+		for (size_t i = 0; i < n_bands; i++)
+			if (D.band[i].failed){
+				a12int_trace(A12_TRACE_SYSTEM, "kind=decode_error:band=%zu", i);
+				break;
+			}
+		a12int_trace(A12_TRACE_VIDEO, "kind=zstd_state:bands=%zu", n_bands);
+	}
+/* concatenated frames decompress in one go as well */
+	else if (!ch->unpack_state.vframe.zstd &&
+		!(ch->unpack_state.vframe.zstd = ZSTD_createDCtx())){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=alloc_error:zstd_context_alloc");
+	}
+	else {
+		uint64_t decode = ZSTD_decompressDCtx(ch->unpack_state.vframe.zstd,
+			D.out, cvf->expanded_sz, cvf->inbuf, cvf->inbuf_pos);
+		a12int_trace(A12_TRACE_VIDEO, "kind=zstd_state:%"PRIu64, decode);
+		if (!ZSTD_isError(decode) && decode == cvf->expanded_sz)
+			video_miniz(cont, cvf, D.out, decode);
+	}
+
+	a12int_pool_free(S, D.out);
+}
+
+/* unpack into the destination, everything but signalling the result */
+static void decode_buffer(struct a12_state* S,
+	struct a12_channel* ch, struct video_frame* cvf, struct arcan_shmif_cont* cont)
+{
+	if (cvf->postprocess == POSTPROCESS_VIDEO_TILES){
+		if (cont && cvf->commit != 255)
+			decode_tiles(ch, cvf, cont);
+	}
+	else
+		decode_zstd(S, ch, cvf, cont);
+
+	a12int_pool_free(S, cvf->inbuf);
+	cvf->inbuf = NULL;
+	cvf->carry = 0;
+}
 
 /* this is a junction where other local transfer strategies should be considered,
  * i.e. no-block and defer process on the next stepframe or spin on the vready */
-		if (cvf->commit && cvf->commit != 255){
-			drain_video(ch, cvf);
-		}
+static void finish_buffer(struct a12_channel* ch, struct video_frame* cvf)
+{
+	if (cvf->commit && cvf->commit != 255)
+		drain_video(ch, cvf);
+	else if (!cvf->commit && ch->active != CHANNEL_RAW)
+		mark_region(ch->cont, cvf);
+}
+
+static bool vdec_submit(struct a12_state* S,
+	struct a12_channel* ch, struct arcan_shmif_cont* cont);
+
+void a12int_decode_vbuffer(struct a12_state* S,
+	struct a12_channel* ch, struct video_frame* cvf, struct arcan_shmif_cont* cont)
+{
+	a12int_trace(A12_TRACE_VIDEO, "decode vbuffer, method: %d", cvf->postprocess);
+	if ( cvf->postprocess == POSTPROCESS_VIDEO_TILES
+		|| cvf->postprocess == POSTPROCESS_VIDEO_DZSTD
+		|| cvf->postprocess == POSTPROCESS_VIDEO_ZSTD
+		|| cvf->postprocess == POSTPROCESS_VIDEO_TZSTD)
+	{
+		if (vdec_submit(S, ch, cont))
+			return;
+
+		decode_buffer(S, ch, cvf, cont);
+		finish_buffer(ch, cvf);
 		return;
 	}
 #ifdef WANT_H264_DEC
@@ -387,7 +969,7 @@ void a12int_decode_vbuffer(struct a12_state* S,
 		}
 
 out_h264:
-		free(cvf->inbuf);
+		a12int_pool_free(S, cvf->inbuf);
 		cvf->inbuf = NULL;
 		cvf->carry = 0;
 		return;
@@ -400,6 +982,218 @@ out_h264:
  * that could offset the need to 'negotiate' */
 }
 
+/*
+ * vdec: with a decode worker (a12_set_vdec_worker) a completed buffered frame
+ * is handed to a pool of threads rather than decoded by whoever unpacks. The
+ * channel (its decode state and destination) then belongs to the worker until
+ * the job is collected, and that is where the frame is signalled so that the
+ * completion order of a channel stays the same. As the next frame header on a
+ * channel syncs on it there is at most one job per channel.
+ */
+enum {
+	VDEC_IDLE = 0,
+	VDEC_QUEUED,
+	VDEC_DONE
+};
+
+struct vdec_job {
+	struct a12_channel* ch;
+	struct arcan_shmif_cont* cont;
+	struct vdec_job* next;
+};
+
+struct a12_vdec {
+	struct a12_state* S;
+	pthread_t threads[VDEC_THREADS_MAX];
+	size_t n_threads;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct vdec_job jobs[256];
+	uint8_t status[256];
+	size_t queued;
+	struct vdec_job* queue;
+	struct vdec_job* done;
+	bool shutdown;
+	void (*ready)(struct a12_state*, void*);
+	void* tag;
+};
+
+static void* vdec_thread(void* tag)
+{
+	struct a12_vdec* V = tag;
+
+	pthread_mutex_lock(&V->lock);
+	for(;;){
+		while (!V->queue && !V->shutdown)
+			pthread_cond_wait(&V->cond, &V->lock);
+
+		if (V->shutdown)
+			break;
+
+		struct vdec_job* job = V->queue;
+		V->queue = job->next;
+		job->next = NULL;
+		pthread_mutex_unlock(&V->lock);
+
+		decode_buffer(V->S, job->ch, &job->ch->unpack_state.vframe, job->cont);
+
+/* only signal when there was nothing waiting to be collected already */
+		pthread_mutex_lock(&V->lock);
+		bool signal = !V->done;
+		struct vdec_job** tail = &V->done;
+		while (*tail)
+			tail = &(*tail)->next;
+		*tail = job;
+		V->status[job - V->jobs] = VDEC_DONE;
+		V->queued--;
+		pthread_cond_broadcast(&V->cond);
+
+		if (V->ready && signal){
+			pthread_mutex_unlock(&V->lock);
+			V->ready(V->S, V->tag);
+			pthread_mutex_lock(&V->lock);
+		}
+	}
+	pthread_mutex_unlock(&V->lock);
+
+	return NULL;
+}
+
+static bool vdec_submit(struct a12_state* S,
+	struct a12_channel* ch, struct arcan_shmif_cont* cont)
+{
+	struct a12_vdec* V = S->vdec;
+	if (!V)
+		return false;
+
+	size_t chid = ch - S->channels;
+	a12int_vdec_sync(S, chid);
+
+	pthread_mutex_lock(&V->lock);
+	struct vdec_job* job = &V->jobs[chid];
+	*job = (struct vdec_job){
+		.ch = ch,
+		.cont = cont
+	};
+	V->status[chid] = VDEC_QUEUED;
+	V->queued++;
+
+	struct vdec_job** tail = &V->queue;
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = job;
+	pthread_cond_broadcast(&V->cond);
+	pthread_mutex_unlock(&V->lock);
+
+	a12int_trace(A12_TRACE_VIDEO, "kind=vdec:queued=%zu", chid);
+	return true;
+}
+
+void a12int_vdec_collect(struct a12_state* S)
+{
+	struct a12_vdec* V = S->vdec;
+	if (!V)
+		return;
+
+	pthread_mutex_lock(&V->lock);
+	struct vdec_job* job = V->done;
+	V->done = NULL;
+	for (struct vdec_job* cur = job; cur; cur = cur->next)
+		V->status[cur - V->jobs] = VDEC_IDLE;
+	pthread_mutex_unlock(&V->lock);
+
+	while (job){
+		struct vdec_job* next = job->next;
+		finish_buffer(job->ch, &job->ch->unpack_state.vframe);
+		job = next;
+	}
+}
+
+void a12int_vdec_sync(struct a12_state* S, int chid)
+{
+	struct a12_vdec* V = S->vdec;
+	if (!V)
+		return;
+
+	pthread_mutex_lock(&V->lock);
+	if (chid == -1){
+		while (V->queued)
+			pthread_cond_wait(&V->cond, &V->lock);
+	}
+	else {
+		while (V->status[chid] == VDEC_QUEUED)
+			pthread_cond_wait(&V->cond, &V->lock);
+	}
+	pthread_mutex_unlock(&V->lock);
+
+	a12int_vdec_collect(S);
+}
+
+void a12int_vdec_stop(struct a12_state* S)
+{
+	struct a12_vdec* V = S->vdec;
+	if (!V)
+		return;
+
+	a12int_vdec_sync(S, -1);
+	pthread_mutex_lock(&V->lock);
+	V->shutdown = true;
+	pthread_cond_broadcast(&V->cond);
+	pthread_mutex_unlock(&V->lock);
+
+	for (size_t i = 0; i < V->n_threads; i++)
+		pthread_join(V->threads[i], NULL);
+
+	pthread_mutex_destroy(&V->lock);
+	pthread_cond_destroy(&V->cond);
+	DYNAMIC_FREE(V);
+	S->vdec = NULL;
+}
+
+bool a12int_vdec_start(struct a12_state* S, size_t threads,
+	void (*ready)(struct a12_state*, void* tag), void* tag)
+{
+	if (S->vdec)
+		return false;
+
+	if (!threads){
+		long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = n_cpu > 1 ? n_cpu : 1;
+	}
+	if (threads > VDEC_THREADS_MAX)
+		threads = VDEC_THREADS_MAX;
+
+	struct a12_vdec* V = DYNAMIC_MALLOC(sizeof(struct a12_vdec));
+	if (!V)
+		return false;
+
+	*V = (struct a12_vdec){
+		.S = S,
+		.ready = ready,
+		.tag = tag
+	};
+	pthread_mutex_init(&V->lock, NULL);
+	pthread_cond_init(&V->cond, NULL);
+
+	for (size_t i = 0; i < threads; i++){
+		if (0 != pthread_create(&V->threads[V->n_threads], NULL, vdec_thread, V))
+			break;
+		V->n_threads++;
+	}
+
+	if (!V->n_threads){
+		pthread_mutex_destroy(&V->lock);
+		pthread_cond_destroy(&V->cond);
+		DYNAMIC_FREE(V);
+		return false;
+	}
+
+	S->vdec = V;
+	S->vdec_threads = V->n_threads;
+	a12int_trace(A12_TRACE_VIDEO, "kind=vdec:threads=%zu", V->n_threads);
+	return true;
+}
+
 void a12int_unpack_vbuffer(struct a12_state* S,
 	struct video_frame* cvf, struct arcan_shmif_cont* cont)
 {
@@ -469,11 +1263,288 @@ void a12int_unpack_vbuffer(struct a12_state* S,
 		a12int_trace(A12_TRACE_VIDEO,
 			"video frame completed, commit:%"PRIu8, cvf->commit);
 		a12int_stream_ack(S, S->in_channel, cvf->id);
-		if (cvf->commit){
-			arcan_shmif_signal(cont, SHMIF_SIGVID);
-		}
+		finish_buffer(&S->channels[S->in_channel], cvf);
 	}
 	else {
 		a12int_trace(A12_TRACE_VDETAIL, "video buffer left: %"PRIu32, cvf->inbuf_sz);
 	}
 }
+
+/*
+ * Opus audio goes through a jitter buffer. Packets are placed on the local
+ * clock by their capture time plus the smallest transit (arrival - capture)
+ * seen, the clocks of the two ends are never compared, only the offset. The
+ * playout delay on top of that follows the arrival jitter and is stretched to
+ * the transit of video on the same channel so that the two line up, up to the
+ * configured cap. Gaps are concealed by the decoder and if the buffer stays
+ * dry past that playout stops and starts over with the next packet.
+ */
+#define JITTER_SLOTS 64
+#define JITTER_PKT_MAX 1276
+#define JITTER_PLC_MAX 3
+#define JITTER_DELAY_MAX 200
+#define JITTER_PCM_MAX 5760
+
+struct jitter_pkt {
+	uint64_t pts;
+	uint16_t len;
+	uint8_t data[JITTER_PKT_MAX];
+};
+
+struct a12_jitter {
+#ifdef WANT_OPUS
+	OpusDecoder* dec;
+#endif
+	uint32_t rate;
+	uint8_t channels;
+
+/* transit statistics and playout delay, us */
+	bool have_base;
+	int64_t base;
+	int64_t last_transit;
+	int64_t jitter;
+	int64_t delay;
+	int64_t video;
+	bool have_video;
+
+	bool playing;
+	uint64_t next_pts;
+	int64_t frame_us;
+	size_t concealed;
+	uint64_t over_ts;
+
+	size_t n_pkt;
+	struct jitter_pkt pkt[JITTER_SLOTS]; /* ordered by pts */
+	int16_t pcm[JITTER_PCM_MAX * 2];
+};
+
+void a12int_decode_audio_drop(struct a12_state* S, int chid)
+{
+	struct a12_channel* ch = &S->channels[chid];
+	free(ch->unpack_state.aframe.inbuf);
+	ch->unpack_state.aframe.inbuf = NULL;
+
+	if (!ch->jitter)
+		return;
+
+#ifdef WANT_OPUS
+	opus_decoder_destroy(ch->jitter->dec);
+#endif
+	free(ch->jitter);
+	ch->jitter = NULL;
+}
+
+static void video_transit(struct a12_channel* ch, struct video_frame* cvf)
+{
+	if (!ch->jitter || !cvf->pts)
+		return;
+
+	struct a12_jitter* J = ch->jitter;
+	int64_t transit = (int64_t)(a12int_media_clock() - cvf->pts);
+	if (!J->have_video){
+		J->video = transit;
+		J->have_video = true;
+	}
+	else
+		J->video += (transit - J->video) / 8;
+}
+
+#ifdef WANT_OPUS
+static void jitter_insert(struct a12_state* S, struct a12_jitter* J,
+	uint64_t pts, int64_t dur, const uint8_t* buf, size_t len)
+{
+	int64_t transit = (int64_t)(a12int_media_clock() - pts);
+	if (!J->playing)
+		J->frame_us = dur;
+
+/* the base creeps up slowly so that clock drift doesn't keep an old minimum */
+	if (!J->have_base){
+		J->base = J->last_transit = transit;
+		J->have_base = true;
+	}
+	else {
+		int64_t d = transit - J->last_transit;
+		J->jitter += ((d < 0 ? -d : d) - J->jitter) / 16;
+		J->last_transit = transit;
+
+		if (transit < J->base)
+			J->base = transit;
+		else
+			J->base += (transit - J->base) / 4096;
+	}
+
+	if (J->playing && pts + J->frame_us / 2 < J->next_pts){
+		S->stats.audio_skipped++;
+		return;
+	}
+
+	if (J->n_pkt == JITTER_SLOTS){
+		memmove(&J->pkt[0], &J->pkt[1], sizeof(struct jitter_pkt) * --J->n_pkt);
+		S->stats.audio_skipped++;
+	}
+
+	size_t i = J->n_pkt;
+	while (i && J->pkt[i-1].pts > pts)
+		i--;
+
+	if (i && J->pkt[i-1].pts == pts)
+		return;
+
+	memmove(&J->pkt[i+1], &J->pkt[i], sizeof(struct jitter_pkt) * (J->n_pkt - i));
+	J->pkt[i].pts = pts;
+	J->pkt[i].len = len;
+	memcpy(J->pkt[i].data, buf, len);
+	J->n_pkt++;
+}
+#endif
+
+void a12int_audio_unit(
+	struct a12_state* S, struct a12_channel* ch, struct audio_frame* caf)
+{
+#ifndef WANT_OPUS
+	a12int_trace(A12_TRACE_MISSING, "kind=error:opus_unit:no_decoder");
+#else
+	struct a12_jitter* J = ch->jitter;
+
+	if (caf->channels < 1 || caf->channels > 2)
+		return;
+
+	if (J && (J->rate != caf->rate || J->channels != caf->channels)){
+		a12int_decode_audio_drop(S, ch - S->channels);
+		J = NULL;
+	}
+
+	if (!J){
+		int err;
+		J = malloc(sizeof(struct a12_jitter));
+		if (!J)
+			return;
+		memset(J, '\0', sizeof(struct a12_jitter));
+
+		J->dec = opus_decoder_create(caf->rate, caf->channels, &err);
+		if (!J->dec){
+			a12int_trace(A12_TRACE_AUDIO, "kind=error:opus_decoder:code=%d", err);
+			free(J);
+			return;
+		}
+
+		J->rate = caf->rate;
+		J->channels = caf->channels;
+		J->frame_us = 20000;
+		ch->jitter = J;
+	}
+
+	uint64_t pts = caf->pts;
+	for (size_t pos = 0; pos + 2 <= caf->inbuf_pos;){
+		uint16_t len;
+		unpack_u16(&len, &caf->inbuf[pos]);
+		pos += 2;
+
+		if (!len || len >= JITTER_PKT_MAX || len > caf->inbuf_pos - pos){
+			a12int_trace(A12_TRACE_AUDIO, "kind=error:opus_unit:bad_packet");
+			return;
+		}
+
+		int n = opus_packet_get_nb_samples(&caf->inbuf[pos], len, J->rate);
+		if (n <= 0)
+			return;
+
+		int64_t dur = (int64_t) n * 1000000 / J->rate;
+		jitter_insert(S, J, pts, dur, &caf->inbuf[pos], len);
+		pts += dur;
+		pos += len;
+	}
+#endif
+}
+
+int a12int_audio_playout(
+	struct a12_state* S, struct a12_channel* ch, uint64_t now)
+{
+#ifndef WANT_OPUS
+	return -1;
+#else
+	struct a12_jitter* J = ch->jitter;
+	if (!J)
+		return -1;
+
+/* grow the delay as soon as it is needed, shrink by skipping a frame at a
+ * time (at most one a second) while it is larger than needed */
+	int64_t cap = (S->opts->audio_delay_max ?
+		S->opts->audio_delay_max : JITTER_DELAY_MAX) * 1000;
+	int64_t want = J->frame_us + 3 * J->jitter;
+	if (J->have_video && J->video - J->base > want)
+		want = J->video - J->base;
+	if (want > cap)
+		want = cap;
+
+	if (want > J->delay)
+		J->delay = want;
+
+	S->stats.audio_delay_ms = J->delay / 1000;
+
+	if (!J->playing){
+		if (!J->n_pkt)
+			return -1;
+		J->playing = true;
+		J->next_pts = J->pkt[0].pts;
+		J->concealed = 0;
+	}
+
+	for (size_t step = 0; step < JITTER_SLOTS; step++){
+		int64_t due = (int64_t) J->next_pts + J->base + J->delay;
+		if (due > (int64_t) now)
+			return (due - (int64_t) now + 999) / 1000;
+
+		while (J->n_pkt && J->pkt[0].pts + J->frame_us / 2 < J->next_pts){
+			memmove(&J->pkt[0], &J->pkt[1], sizeof(struct jitter_pkt) * --J->n_pkt);
+			S->stats.audio_skipped++;
+		}
+
+		int n;
+		bool over = J->delay > want + J->frame_us;
+		if (!over)
+			J->over_ts = 0;
+		else if (!J->over_ts)
+			J->over_ts = now;
+
+		if (J->n_pkt && J->pkt[0].pts <= J->next_pts + J->frame_us / 2){
+			if (over && now - J->over_ts > 1000000 && J->n_pkt > 1){
+				J->over_ts = now;
+				J->delay -= J->frame_us;
+				J->next_pts = J->pkt[1].pts;
+				memmove(&J->pkt[0], &J->pkt[1], sizeof(struct jitter_pkt) * --J->n_pkt);
+				S->stats.audio_skipped++;
+				continue;
+			}
+
+			n = opus_decode(J->dec,
+				J->pkt[0].data, J->pkt[0].len, J->pcm, JITTER_PCM_MAX, 0);
+			J->next_pts = J->pkt[0].pts;
+			memmove(&J->pkt[0], &J->pkt[1], sizeof(struct jitter_pkt) * --J->n_pkt);
+			J->concealed = 0;
+		}
+		else if (J->concealed < JITTER_PLC_MAX){
+			n = opus_decode(J->dec, NULL, 0,
+				J->pcm, J->frame_us * J->rate / 1000000, 0);
+			J->concealed++;
+			S->stats.audio_concealed++;
+		}
+		else {
+			J->playing = false;
+			return J->n_pkt ? 0 : -1;
+		}
+
+		if (n <= 0){
+			a12int_trace(A12_TRACE_AUDIO, "kind=error:opus_decode:code=%d", n);
+			J->playing = false;
+			return J->n_pkt ? 0 : -1;
+		}
+
+		J->frame_us = (int64_t) n * 1000000 / J->rate;
+		J->next_pts += J->frame_us;
+		a12int_audio_out(S, ch, J->pcm, n * J->channels, J->channels, J->rate);
+	}
+
+	return 0;
+#endif
+}
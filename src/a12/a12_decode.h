@@ -7,7 +7,8 @@
  */
 bool a12int_buffer_format(int method);
 
-bool a12int_vframe_setup(struct a12_channel* ch, struct video_frame* dst, int method);
+bool a12int_vframe_setup(struct a12_state* S,
+	struct a12_channel* ch, struct video_frame* dst, int method);
 
 /* Release any encoder contexts and intermediate buffers tied to the state/channel */
 void a12int_decode_drop(struct a12_state* S, int chid, bool failed);
@@ -16,6 +17,29 @@ void a12int_decode_vbuffer(
 	struct a12_state* S,
 	struct a12_channel* ch, struct video_frame*, struct arcan_shmif_cont*);
 
+/*
+ * Video decode worker, see a12_set_vdec_worker. The decode state and the
+ * destination of a channel with a frame in the worker belong to it until
+ * collected, sync on the channel (or -1 for all) before touching either.
+ * Collecting signals the frames that have been decoded.
+ */
+bool a12int_vdec_start(struct a12_state* S, size_t threads,
+	void (*ready)(struct a12_state*, void* tag), void* tag);
+void a12int_vdec_stop(struct a12_state* S);
+void a12int_vdec_sync(struct a12_state* S, int chid);
+void a12int_vdec_collect(struct a12_state* S);
+
+/* Decode a complete encoded audio frame into the jitter buffer of [ch] */
+void a12int_audio_unit(
+	struct a12_state* S, struct a12_channel* ch, struct audio_frame* caf);
+
+/* Play out whatever is due at [now] (media clock), returns the number of ms
+ * until something is next due or -1 if nothing is being played */
+int a12int_audio_playout(
+	struct a12_state* S, struct a12_channel* ch, uint64_t now);
+
+void a12int_decode_audio_drop(struct a12_state* S, int chid);
+
 void a12int_unpack_vbuffer(
 	struct a12_state* S, struct video_frame* cvf, struct arcan_shmif_cont* cont);
 #endif
@@ -18,13 +18,18 @@
 
 #define ZSTD_H_ZSTD_STATIC_LINKING_ONLY
 #include "zstd.h"
+#include "common/xxhash.h"
+
+#ifdef WANT_OPUS
+#include <opus.h>
+#endif
 
 /*
  * create the control packet
  */
 static void a12int_vframehdr_build(
 	uint8_t buf[CONTROL_PACKET_SIZE],
-	uint64_t last_seen, uint8_t chid,
+	struct a12_state* S, uint8_t chid,
 	int type, uint32_t sid,
 	uint16_t sw, uint16_t sh, uint16_t w, uint16_t h, uint16_t x, uint16_t y,
 	uint32_t len, uint32_t exp_len, bool commit, uint8_t flags)
@@ -37,7 +42,7 @@ static void a12int_vframehdr_build(
 	);
 
 	memset(buf, '\0', CONTROL_PACKET_SIZE);
-	pack_u64(last_seen, &buf[0]);
+	pack_u64(a12int_venc_seqnr(S), &buf[0]);
 	arcan_random(&buf[8], 8); /* 0..8 entropy */
 
 	buf[16] = chid; /* [16] : channel-id */
@@ -55,9 +60,12 @@ static void a12int_vframehdr_build(
 
 	buf[35] = flags; /* [35] : dataflags: uint8 */
 
-/* [40] Commit on completion, this is always set right now but will change
- * when 'chain of deltas' mode for shmif is added */
+/* [40] Commit on completion, cleared for all but the last region when the
+ * source provided a damage chain */
 	buf[44] = commit;
+
+/* [45..52] capture time for the sink to line audio up with */
+	pack_u64(a12int_venc_pts(S), &buf[45]);
 }
 
 /*
@@ -85,6 +93,29 @@ static void chunk_pack(struct a12_state* S, int type,
 		a12int_append_out(S, type, &buf[n_chunks * chunk_sz], left, outb, sizeof(outb));
 }
 
+/*
+ * [16] channel, [17] command, [18..21] stream, [22] channels, [23] encoding
+ * [24..25] samples (interleaved), [26..29] rate, [30..37] capture time (us)
+ * [38..41] encoded size that follows in audio packets (opus)
+ */
+static void aframe_header(uint8_t outb[CONTROL_PACKET_SIZE],
+	struct a12_state* S, uint8_t chid, struct a12_aframe_cfg cfg,
+	uint8_t encoding, uint16_t n_samples, uint64_t pts, uint32_t size)
+{
+	memset(outb, '\0', CONTROL_PACKET_SIZE);
+	pack_u64(S->last_seen_seqnr, outb);
+	arcan_random(&outb[8], 8);
+	outb[16] = chid;
+	outb[17] = COMMAND_AUDIOFRAME;
+	pack_u32(0, &outb[18]);
+	outb[22] = cfg.channels;
+	outb[23] = encoding;
+	pack_u16(n_samples, &outb[24]);
+	pack_u32(cfg.samplerate, &outb[26]);
+	pack_u64(pts, &outb[30]);
+	pack_u32(size, &outb[38]);
+}
+
 void a12int_encode_araw(struct a12_state* S,
 	uint8_t chid,
 	shmif_asample* buf,
@@ -93,9 +124,8 @@ void a12int_encode_araw(struct a12_state* S,
 	struct a12_aframe_opts opts, size_t chunk_sz)
 {
 /* repack the audio into a temporary buffer for format reasons */
-	size_t hdr_sz = a12int_header_size(STATE_AUDIO_PACKET);
-	size_t buf_sz = hdr_sz + n_samples * sizeof(uint16_t) * cfg.channels;
-	uint8_t* outb = malloc(hdr_sz + buf_sz);;
+	size_t buf_sz = n_samples * sizeof(uint16_t);
+	uint8_t* outb = malloc(buf_sz);
 	if (!outb){
 		a12int_trace(A12_TRACE_ALLOC,
 			"failed to alloc %zu for s16aud", buf_sz);
@@ -103,26 +133,203 @@ void a12int_encode_araw(struct a12_state* S,
 	}
 
 /* audio control message header */
-	outb[16] = chid;
-	outb[17] = COMMAND_AUDIOFRAME;
-	pack_u32(0, &outb[18]); /* stream-id */
-	outb[22] = cfg.channels; /* channels */
-	outb[23] = 0; /* encoding, u16 */
-	pack_u16(n_samples, &outb[24]);
+	uint8_t hdr[CONTROL_PACKET_SIZE];
+	uint64_t pts = a12int_media_clock() -
+		(uint64_t) n_samples / (cfg.channels ? cfg.channels : 1) *
+		1000000 / (cfg.samplerate ? cfg.samplerate : ARCAN_SHMIF_SAMPLERATE);
+	aframe_header(hdr, S, chid, cfg, AUDIO_ENCODING_S16, n_samples, pts, 0);
 
 /* repack into the right format (note, need _Generic on asample) */
-	size_t pos = hdr_sz;
+	size_t pos = 0;
 	for (size_t i = 0; i < n_samples; i++, pos += 2){
 		pack_s16(buf[i], &outb[pos]);
 	}
 
 /* then split it up (though likely we get fed much smaller chunks) */
 	a12int_append_out(S,
-		STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
-	chunk_pack(S, STATE_AUDIO_PACKET, chid, &outb[hdr_sz], pos - hdr_sz, chunk_sz);
+		STATE_CONTROL_PACKET, hdr, CONTROL_PACKET_SIZE, NULL, 0);
+	chunk_pack(S, STATE_AUDIO_PACKET, chid, outb, pos, chunk_sz);
 	free(outb);
 }
 
+/*
+ * Opus packets that complete during one call go out as one audio frame, each
+ * prefixed by its u16 length. Samples that don't fill a frame are held until
+ * the next call, the frame carries the capture time of its first sample.
+ */
+#define AENC_FRAME_MAX 960
+#define AENC_PACKET_MAX 1275
+
+struct a12_aenc {
+#ifdef WANT_OPUS
+	OpusEncoder* enc;
+#endif
+	uint32_t rate;
+	uint8_t channels;
+	size_t frame; /* samples per channel */
+	size_t bitrate;
+	uint64_t pts;
+	size_t held; /* interleaved samples */
+	int16_t buf[AENC_FRAME_MAX * 2];
+};
+
+void a12int_encode_audio_drop(struct a12_state* S, int chid)
+{
+	struct a12_aenc* E = S->channels[chid].aenc;
+	if (!E)
+		return;
+
+#ifdef WANT_OPUS
+	opus_encoder_destroy(E->enc);
+#endif
+	free(E);
+	S->channels[chid].aenc = NULL;
+}
+
+#ifdef WANT_OPUS
+static void aopus_unit(struct a12_state* S, struct a12_aenc* E,
+	uint8_t chid, struct a12_aframe_cfg cfg,
+	uint8_t* buf, size_t buf_sz, size_t n_frames, size_t chunk_sz)
+{
+	uint8_t hdr[CONTROL_PACKET_SIZE];
+	aframe_header(hdr, S, chid, cfg,
+		AUDIO_ENCODING_OPUS, n_frames * E->frame * cfg.channels, E->pts, buf_sz);
+	a12int_append_out(S, STATE_CONTROL_PACKET, hdr, CONTROL_PACKET_SIZE, NULL, 0);
+	chunk_pack(S, STATE_AUDIO_PACKET, chid, buf, buf_sz, chunk_sz);
+
+	E->pts += (uint64_t) n_frames * E->frame * 1000000 / cfg.samplerate;
+	a12int_trace(A12_TRACE_AUDIO,
+		"kind=opus:frames=%zu:bytes=%zu:held=%zu", n_frames, buf_sz, E->held);
+}
+#endif
+
+bool a12int_encode_aopus(struct a12_state* S,
+	uint8_t chid,
+	shmif_asample* buf,
+	size_t n_samples,
+	struct a12_aframe_cfg cfg,
+	struct a12_aframe_opts opts, size_t chunk_sz)
+{
+#ifndef WANT_OPUS
+	return false;
+#else
+	if (cfg.channels < 1 || cfg.channels > 2)
+		return false;
+
+	switch (cfg.samplerate){
+	case 8000: case 12000: case 16000: case 24000: case 48000:
+	break;
+	default:
+		return false;
+	}
+
+	size_t frame_us = opts.frame_us;
+	if (frame_us != 2500 && frame_us != 5000 && frame_us != 10000)
+		frame_us = 20000;
+	size_t frame = (size_t) cfg.samplerate * frame_us / 1000000;
+
+	struct a12_aenc* E = S->channels[chid].aenc;
+	if (E && (E->rate != cfg.samplerate || E->channels != cfg.channels)){
+		a12int_encode_audio_drop(S, chid);
+		E = NULL;
+	}
+
+	if (!E){
+		int err;
+		E = malloc(sizeof(struct a12_aenc));
+		if (!E)
+			return false;
+
+		*E = (struct a12_aenc){
+			.rate = cfg.samplerate,
+			.channels = cfg.channels,
+			.bitrate = SIZE_MAX
+		};
+
+		E->enc = opus_encoder_create(cfg.samplerate,
+			cfg.channels, OPUS_APPLICATION_RESTRICTED_LOWDELAY, &err);
+		if (!E->enc){
+			a12int_trace(A12_TRACE_AUDIO, "kind=error:opus_encoder:code=%d", err);
+			free(E);
+			return false;
+		}
+		S->channels[chid].aenc = E;
+	}
+
+	if (E->bitrate != opts.bitrate){
+		opus_encoder_ctl(E->enc,
+			OPUS_SET_BITRATE(opts.bitrate ? (opus_int32) opts.bitrate * 1000 : OPUS_AUTO));
+		E->bitrate = opts.bitrate;
+	}
+
+	if (E->frame != frame){
+		E->frame = frame;
+		E->held = 0;
+	}
+
+/* what is held should end where this buffer starts, if not the source has
+ * stalled or skipped and the held samples no longer line up */
+	uint64_t start = a12int_media_clock() -
+		(uint64_t)(n_samples / cfg.channels) * 1000000 / cfg.samplerate;
+	uint64_t held_end = E->pts +
+		(uint64_t)(E->held / cfg.channels) * 1000000 / cfg.samplerate;
+	if (start > held_end + 40000 || held_end > start + 40000){
+		E->held = 0;
+		E->pts = start;
+	}
+
+	size_t frame_sz = frame * cfg.channels;
+	size_t unit_lim = 65535 / frame_sz;
+	uint8_t* outb = NULL;
+	size_t pos = 0, done = 0, in = 0;
+
+	while (in < n_samples){
+		size_t step = frame_sz - E->held;
+		if (step > n_samples - in)
+			step = n_samples - in;
+		memcpy(&E->buf[E->held], &buf[in], step * sizeof(int16_t));
+		E->held += step;
+		in += step;
+
+		if (E->held < frame_sz)
+			break;
+		E->held = 0;
+
+		if (!outb){
+			outb = malloc(unit_lim * (AENC_PACKET_MAX + 2));
+			if (!outb)
+				return true;
+		}
+
+		opus_int32 nb = opus_encode(E->enc,
+			E->buf, frame, &outb[pos + 2], AENC_PACKET_MAX);
+/* the frames in a unit are back to back, so a failed one ends it */
+		if (nb < 0){
+			a12int_trace(A12_TRACE_AUDIO, "kind=error:opus_encode:code=%d", (int) nb);
+			if (done)
+				aopus_unit(S, E, chid, cfg, outb, pos, done, chunk_sz);
+			pos = done = 0;
+			E->pts += (uint64_t) frame * 1000000 / cfg.samplerate;
+			continue;
+		}
+
+		pack_u16(nb, &outb[pos]);
+		pos += nb + 2;
+		done++;
+
+		if (done == unit_lim || in == n_samples){
+			aopus_unit(S, E, chid, cfg, outb, pos, done, chunk_sz);
+			pos = done = 0;
+		}
+	}
+
+	if (done)
+		aopus_unit(S, E, chid, cfg, outb, pos, done, chunk_sz);
+	free(outb);
+	return true;
+#endif
+}
+
 /*
  * the rgb565, rgb and rgba function all follow the same pattern
  */
@@ -140,7 +347,7 @@ void a12int_encode_rgb565(PACK_ARGS)
 	size_t pos = y * vb->pitch + x;
 
 /* get the packing buffer, cancel if oom */
-	uint8_t* outb = malloc(hdr_sz + bpb);
+	uint8_t* outb = a12int_pool_alloc(S, hdr_sz + bpb);
 	if (!outb){
 		a12int_trace(A12_TRACE_ALLOC,
 			"failed to alloc %zu for rgb565", hdr_sz + bpb);
@@ -149,9 +356,9 @@ void a12int_encode_rgb565(PACK_ARGS)
 
 /* store the control frame that defines our video buffer */
 	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
-	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
+	a12int_vframehdr_build(hdr_buf, S, chid,
 		POSTPROCESS_VIDEO_RGB565, sid, vb->w, vb->h, w, h, x, y,
-		w * h * px_sz, w * h * px_sz, 1, vb->flags.origo_ll);
+		w * h * px_sz, w * h * px_sz, a12int_venc_commit(S), vb->flags.origo_ll);
 	a12int_step_vstream(S, sid);
 	a12int_append_out(S,
 		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
@@ -206,7 +413,7 @@ void a12int_encode_rgb565(PACK_ARGS)
 		a12int_append_out(S, STATE_VIDEO_PACKET, outb, left+hdr_sz, NULL, 0);
 	}
 
-	free(outb);
+	a12int_pool_free(S, outb);
 }
 
 void a12int_encode_passthrough(PACK_ARGS)
@@ -214,7 +421,7 @@ void a12int_encode_passthrough(PACK_ARGS)
 /* right now only step H264 fourcc, vb->compressed */
 	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
 
-	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
+	a12int_vframehdr_build(hdr_buf, S, chid,
 		POSTPROCESS_VIDEO_H264, sid, vb->w, vb->h, w, h, x, y,
 		vb->buffer_sz, vb->w * vb->h * sizeof(shmif_pixel), 1, vb->flags.origo_ll);
 	a12int_step_vstream(S, sid);
@@ -238,15 +445,15 @@ void a12int_encode_rgba(PACK_ARGS)
 	size_t pos = y * vb->pitch + x;
 
 /* get the packing buffer, cancel if oom */
-	uint8_t* outb = malloc(hdr_sz + bpb);
+	uint8_t* outb = a12int_pool_alloc(S, hdr_sz + bpb);
 	if (!outb)
 		return;
 
 /* store the control frame that defines our video buffer */
 	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
-	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
+	a12int_vframehdr_build(hdr_buf, S, chid,
 		POSTPROCESS_VIDEO_RGBA, sid, vb->w, vb->h, w, h, x, y,
-		w * h * px_sz, w * h * px_sz, 1, vb->flags.origo_ll
+		w * h * px_sz, w * h * px_sz, a12int_venc_commit(S), vb->flags.origo_ll
 	);
 	a12int_step_vstream(S, sid);
 	a12int_append_out(S,
@@ -291,7 +498,7 @@ void a12int_encode_rgba(PACK_ARGS)
 		a12int_append_out(S, STATE_VIDEO_PACKET, outb, hdr_sz + left, NULL, 0);
 	}
 
-	free(outb);
+	a12int_pool_free(S, outb);
 }
 
 void a12int_encode_rgb(PACK_ARGS)
@@ -309,15 +516,15 @@ void a12int_encode_rgb(PACK_ARGS)
 	size_t pos = y * vb->pitch + x;
 
 /* get the packing buffer, cancel if oom */
-	uint8_t* outb = malloc(hdr_sz + bpb);
+	uint8_t* outb = a12int_pool_alloc(S, hdr_sz + bpb);
 	if (!outb)
 		return;
 
 /* store the control frame that defines our video buffer */
 	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
-	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
+	a12int_vframehdr_build(hdr_buf, S, chid,
 		POSTPROCESS_VIDEO_RGB, sid, vb->w, vb->h, w, h, x, y,
-		w * h * px_sz, w * h * px_sz, 1, vb->flags.origo_ll
+		w * h * px_sz, w * h * px_sz, a12int_venc_commit(S), vb->flags.origo_ll
 	);
 	a12int_step_vstream(S, sid);
 	a12int_append_out(S,
@@ -368,7 +575,7 @@ void a12int_encode_rgb(PACK_ARGS)
 		a12int_append_out(S, STATE_VIDEO_PACKET, outb, hdr_sz + bytes_left, NULL, 0);
 	}
 
-	free(outb);
+	a12int_pool_free(S, outb);
 }
 
 static bool setup_zstd(struct a12_state* S, uint8_t ch)
@@ -378,12 +585,91 @@ static bool setup_zstd(struct a12_state* S, uint8_t ch)
 		if (!S->channels[ch].zstd){
 			return false;
 		}
-		ZSTD_CCtx_setParameter(S->channels[ch].zstd, ZSTD_c_nbWorkers, 4);
+/* the worker threads split the input into bands and work on one each, the
+ * output is still a single frame so the decoder side doesn't care */
+		ZSTD_CCtx_setParameter(S->channels[ch].zstd,
+			ZSTD_c_nbWorkers, S->venc_threads);
+		ZSTD_CCtx_setParameter(S->channels[ch].zstd,
+			ZSTD_c_jobSize, ZSTD_VIDEO_BAND_SZ);
 	}
 
 	return true;
 }
 
+/* ZSTD_compressCCtx ignores the advanced parameters (workers) while compress2
+ * uses the ones set on the context */
+static size_t zstd_compress(struct a12_state* S, uint8_t ch,
+	uint8_t* dst, size_t dst_sz, const uint8_t* src, size_t src_sz, int level)
+{
+	ZSTD_CCtx_setParameter(S->channels[ch].zstd, ZSTD_c_compressionLevel, level);
+	return ZSTD_compress2(S->channels[ch].zstd, dst, dst_sz, src, src_sz);
+}
+
+/*
+ * With A12_FEATURE_ZBANDS a large frame is compressed as a series of zstd
+ * frames over whole rows that the other end can decompress independently.
+ * Each band goes into its own slot sized by the bound and the slots are
+ * packed together after.
+ */
+struct band_encode {
+	const uint8_t* src;
+	size_t src_sz;
+	size_t band_sz;
+	uint8_t* dst;
+	size_t slot_sz;
+	size_t out_sz[ZSTD_VIDEO_BANDS_MAX];
+	int level;
+};
+
+static void encode_band(size_t i, void* tag)
+{
+	struct band_encode* E = tag;
+	size_t ofs = i * E->band_sz;
+	size_t nb = E->src_sz - ofs < E->band_sz ? E->src_sz - ofs : E->band_sz;
+	E->out_sz[i] = ZSTD_compress(
+		&E->dst[i * E->slot_sz], E->slot_sz, &E->src[ofs], nb, E->level);
+}
+
+static bool zstd_compress_bands(struct a12_state* S, uint8_t** out,
+	size_t* out_sz, const uint8_t* src, size_t src_sz, size_t row_sz, int level)
+{
+	size_t rows = ZSTD_VIDEO_BAND_SZ / row_sz;
+	struct band_encode E = {
+		.src = src,
+		.src_sz = src_sz,
+		.band_sz = (rows ? rows : 1) * row_sz,
+		.level = level
+	};
+
+	size_t n = (src_sz + E.band_sz - 1) / E.band_sz;
+	if (n > ZSTD_VIDEO_BANDS_MAX){
+		E.band_sz = (src_sz / ZSTD_VIDEO_BANDS_MAX + row_sz) / row_sz * row_sz;
+		n = (src_sz + E.band_sz - 1) / E.band_sz;
+	}
+
+	E.slot_sz = ZSTD_compressBound(E.band_sz);
+	if (!(E.dst = a12int_pool_alloc(S, n * E.slot_sz)))
+		return false;
+
+	a12int_band_run(n, S->venc_threads, encode_band, &E);
+
+	size_t ofs = 0;
+	for (size_t i = 0; i < n; i++){
+		if (ZSTD_isError(E.out_sz[i])){
+			a12int_trace(A12_TRACE_ALLOC,
+				"kind=zstd_fail:band=%zu:message=%s", i, ZSTD_getErrorName(E.out_sz[i]));
+			a12int_pool_free(S, E.dst);
+			return false;
+		}
+		memmove(&E.dst[ofs], &E.dst[i * E.slot_sz], E.out_sz[i]);
+		ofs += E.out_sz[i];
+	}
+
+	*out = E.dst;
+	*out_sz = ofs;
+	return true;
+}
+
 struct compress_res {
 	bool ok;
 	uint8_t type;
@@ -438,15 +724,19 @@ static void compress_tzstd(struct a12_state* S, uint8_t ch,
 	size_t out_sz;
 	uint8_t* buf;
 	out_sz = ZSTD_compressBound(compress_in_sz);
-	buf = malloc(out_sz);
+	buf = a12int_pool_alloc(S, out_sz);
+	if (!buf){
+		a12int_trace(A12_TRACE_ALLOC, "failed to build compressed TPACK output");
+		return;
+	}
 
-	out_sz = ZSTD_compressCCtx(S->channels[ch].zstd,
+	out_sz = zstd_compress(S, ch,
 		buf, out_sz, vb->buffer_bytes, compress_in_sz, ZSTD_VIDEO_LEVEL);
 
 	if (ZSTD_isError(out_sz)){
 		a12int_trace(A12_TRACE_ALLOC,
 			"kind=zstd_fail:message=%s", ZSTD_getErrorName(out_sz));
-		free(buf);
+		a12int_pool_free(S, buf);
 		return;
 	}
 
@@ -456,13 +746,8 @@ static void compress_tzstd(struct a12_state* S, uint8_t ch,
 		(size_t) out_sz, (float)(compress_in_sz+1.0) / (float)(out_sz+1.0)
 	);
 
-	if (!buf){
-		a12int_trace(A12_TRACE_ALLOC, "failed to build compressed TPACK output");
-		return;
-	}
-
 	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
-	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, ch,
+	a12int_vframehdr_build(hdr_buf, S, ch,
 		type, sid, vb->w, vb->h, w, h, 0, 0,
 		out_sz, compress_in_sz, 1, vb->flags.origo_ll
 	);
@@ -477,7 +762,7 @@ static void compress_tzstd(struct a12_state* S, uint8_t ch,
 		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
 
 	chunk_pack(S, STATE_VIDEO_PACKET, ch, buf, out_sz, chunk_sz);
-	free(buf);
+	a12int_pool_free(S, buf);
 }
 
 void a12int_encode_ztz(PACK_ARGS)
@@ -499,8 +784,8 @@ static struct compress_res compress_deltaz(struct a12_state* S, uint8_t ch,
 			"kind=resize:ch=%"PRIu8"prev_w=%zu:rev_h=%zu:new_w%zu:new_h=%zu",
 			ch, (size_t) ab->w, (size_t) ab->h, (size_t) vb->w, (size_t) vb->h
 		);
-		free(ab->buffer);
-		free(S->channels[ch].compression);
+		a12int_pool_free(S, ab->buffer);
+		a12int_pool_free(S, S->channels[ch].compression);
 		ab->buffer = NULL;
 		S->channels[ch].compression = NULL;
 	}
@@ -514,7 +799,7 @@ static struct compress_res compress_deltaz(struct a12_state* S, uint8_t ch,
 		type = POSTPROCESS_VIDEO_ZSTD;
 		*ab = *vb;
 		size_t nb = vb->w * vb->h * 3;
-		ab->buffer = malloc(nb);
+		ab->buffer = a12int_pool_alloc(S, nb);
 		*w = vb->w;
 		*h = vb->h;
 		*x = 0;
@@ -529,11 +814,11 @@ static struct compress_res compress_deltaz(struct a12_state* S, uint8_t ch,
  * contents of the previous input frame, this should provide a better basis for
  * deflates RLE etc. stages, but also act as an option for us to provide our
  * cheaper RLE or send out a raw- frame when the RLE didn't work out */
-		S->channels[ch].compression = malloc(nb);
+		S->channels[ch].compression = a12int_pool_alloc(S, nb);
 		compress_in_sz = nb;
 
 		if (!S->channels[ch].compression){
-			free(ab->buffer);
+			a12int_pool_free(S, ab->buffer);
 			ab->buffer = NULL;
 			return (struct compress_res){};
 		}
@@ -580,20 +865,31 @@ static struct compress_res compress_deltaz(struct a12_state* S, uint8_t ch,
 	}
 
 	size_t out_sz;
-	uint8_t* buf;
+	uint8_t* buf = NULL;
 
-	out_sz = ZSTD_compressBound(compress_in_sz);
-	buf = malloc(out_sz);
-	if (!buf)
-		return (struct compress_res){};
+/* when the output is backed up, trade encode time for fewer bytes */
+	int level = a12int_out_pressure(S) == OUTQ_PRESSURE_NONE ?
+		1 : ZSTD_VIDEO_PRESSURE_LEVEL;
 
-	out_sz = ZSTD_compressCCtx(
-		S->channels[ch].zstd, buf, out_sz, compress_in, compress_in_sz, 1);
+	if ((S->remote_features & A12_FEATURE_ZBANDS) &&
+		S->venc_threads > 1 && compress_in_sz >= 2 * ZSTD_VIDEO_BAND_SZ){
+		if (!zstd_compress_bands(S, &buf,
+			&out_sz, compress_in, compress_in_sz, *w * 3, level))
+			return (struct compress_res){};
+	}
+	else {
+		out_sz = ZSTD_compressBound(compress_in_sz);
+		buf = a12int_pool_alloc(S, out_sz);
+		if (!buf)
+			return (struct compress_res){};
+
+		out_sz = zstd_compress(S, ch, buf, out_sz, compress_in, compress_in_sz, level);
+	}
 
 	if (ZSTD_isError(out_sz)){
 		a12int_trace(A12_TRACE_ALLOC,
 			"kind=zstd_fail:message=%s", ZSTD_getErrorName(out_sz));
-		free(buf);
+		a12int_pool_free(S, buf);
 		return (struct compress_res){};
 	}
 
@@ -611,6 +907,22 @@ static struct compress_res compress_deltaz(struct a12_state* S, uint8_t ch,
 	};
 }
 
+void a12int_encode_reset_delta(struct a12_state* S, int chid)
+{
+	if (S->channels[chid].tiles)
+		S->channels[chid].tiles->reset = true;
+
+	a12int_pool_free(S, S->channels[chid].acc.buffer);
+	a12int_pool_free(S, S->channels[chid].compression);
+	S->channels[chid].acc.buffer = NULL;
+	S->channels[chid].compression = NULL;
+
+/* the h264 reference is stale as well if other methods updated in between */
+#ifdef WANT_H264_ENC
+	S->channels[chid].videnc.keyframe = true;
+#endif
+}
+
 void a12int_encode_dzstd(PACK_ARGS)
 {
 	struct compress_res cres = compress_deltaz(S, chid, vb, &x, &y, &w, &h, true);
@@ -618,9 +930,9 @@ void a12int_encode_dzstd(PACK_ARGS)
 		return;
 
 	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
-	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
+	a12int_vframehdr_build(hdr_buf, S, chid,
 		cres.type, sid, vb->w, vb->h, w, h, x, y,
-		cres.out_sz, cres.in_sz, 1, vb->flags.origo_ll
+		cres.out_sz, cres.in_sz, a12int_venc_commit(S), vb->flags.origo_ll
 	);
 
 	a12int_trace(A12_TRACE_VDETAIL,
@@ -632,7 +944,7 @@ void a12int_encode_dzstd(PACK_ARGS)
 		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
 	chunk_pack(S, STATE_VIDEO_PACKET, chid, cres.out_buf, cres.out_sz, chunk_sz);
 
-	free(cres.out_buf);
+	a12int_pool_free(S, cres.out_buf);
 }
 
 
@@ -643,9 +955,9 @@ void a12int_encode_dpng(PACK_ARGS)
 		return;
 
 	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
-	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
+	a12int_vframehdr_build(hdr_buf, S, chid,
 		cres.type, sid, vb->w, vb->h, w, h, x, y,
-		cres.out_sz, cres.in_sz, 1, vb->flags.origo_ll
+		cres.out_sz, cres.in_sz, a12int_venc_commit(S), vb->flags.origo_ll
 	);
 
 	a12int_trace(A12_TRACE_VDETAIL,
@@ -657,23 +969,358 @@ void a12int_encode_dpng(PACK_ARGS)
 		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
 	chunk_pack(S, STATE_VIDEO_PACKET, chid, cres.out_buf, cres.out_sz, chunk_sz);
 
-	free(cres.out_buf);
+	a12int_pool_free(S, cres.out_buf);
 }
 
-void a12int_encode_drop(struct a12_state* S, int chid, bool failed)
+/*
+ * Tile state follows the surface, a new size or a reset means that all tiles
+ * are sent again. The cache slots survive as the other end keeps them.
+ */
+static struct a12_tiles* tiles_setup(
+	struct a12_state* S, struct a12_channel* ch, size_t w, size_t h)
 {
-	if (S->channels[chid].zstd){
-		ZSTD_freeCCtx(S->channels[chid].zstd);
-		S->channels[chid].zstd = NULL;
+	struct a12_tiles* T = ch->tiles;
+
+	if (!T){
+		T = malloc(sizeof(struct a12_tiles));
+		if (!T)
+			return NULL;
+		*T = (struct a12_tiles){};
+		ch->tiles = T;
+
+/* if this fails it is just the slot cache that gets used */
+		if (S->remote_features & A12_FEATURE_TILE_HASH)
+			T->lru = a12int_tile_lru_alloc(false);
+	}
+
+	if (T->w != w || T->h != h || !T->hash){
+		size_t cols = (w + A12_TILE_SZ - 1) / A12_TILE_SZ;
+		size_t rows = (h + A12_TILE_SZ - 1) / A12_TILE_SZ;
+		free(T->hash);
+		T->hash = malloc(cols * rows * sizeof(uint64_t));
+		if (!T->hash){
+			T->w = T->h = 0;
+			return NULL;
+		}
+		T->w = w;
+		T->h = h;
+		T->cols = cols;
+		T->rows = rows;
+		T->reset = true;
+	}
+
+	return T;
+}
+
+/* seeded with the dimensions so that edge tiles of different sizes never
+ * match each other in the cache */
+static uint64_t tile_hash(
+	struct shmifsrv_vbuffer* vb, size_t tx, size_t ty, size_t tw, size_t th)
+{
+	uint64_t hv = (tw << 16) | th;
+	for (size_t y = ty; y < ty + th; y++)
+		hv = XXH64(&vb->buffer[y * vb->pitch + tx], tw * sizeof(shmif_pixel), hv);
+	return hv;
+}
+
+struct tile_out {
+	uint8_t* buf;
+	size_t sz;
+	size_t pos;
+};
+
+static bool tile_reserve(struct tile_out* out, size_t nb)
+{
+	if (out->pos + nb <= out->sz)
+		return true;
+
+	size_t sz = out->sz ? out->sz : 65536;
+	while (sz < out->pos + nb)
+		sz *= 2;
+
+	uint8_t* buf = realloc(out->buf, sz);
+	if (!buf)
+		return false;
+
+	out->buf = buf;
+	out->sz = sz;
+	return true;
+}
+
+/*
+ * Pick the cheapest coding for one tile: a single colour, a slot the other
+ * end already has or the packed pixels, zstd compressed if that gains enough.
+ */
+static bool tile_encode(struct a12_state* S, uint8_t ch,
+	struct a12_tiles* T, struct shmifsrv_vbuffer* vb, struct tile_out* out,
+	size_t col, size_t row, uint64_t hv)
+{
+	size_t tx = col * A12_TILE_SZ, ty = row * A12_TILE_SZ;
+	size_t tw = vb->w - tx < A12_TILE_SZ ? vb->w - tx : A12_TILE_SZ;
+	size_t th = vb->h - ty < A12_TILE_SZ ? vb->h - ty : A12_TILE_SZ;
+	size_t raw_sz = tw * th * 3;
+
+	static _Thread_local uint8_t pack[A12_TILE_SZ * A12_TILE_SZ * 3];
+	static _Thread_local uint8_t zbuf[A12_TILE_SZ * A12_TILE_SZ * 3 + 512];
+
+	if (!tile_reserve(out, 11 + raw_sz))
+		return false;
+
+	uint8_t* dst = &out->buf[out->pos];
+	pack_u16(col, &dst[0]);
+	pack_u16(row, &dst[2]);
+
+	shmif_pixel first = vb->buffer[ty * vb->pitch + tx];
+	bool solid = true;
+	for (size_t y = ty; y < ty + th && solid; y++){
+		shmif_pixel* px = &vb->buffer[y * vb->pitch + tx];
+		for (size_t x = 0; x < tw; x++){
+			if (px[x] != first){
+				solid = false;
+				break;
+			}
+		}
+	}
+
+	if (solid){
+		uint8_t a;
+		dst[4] = TILE_SOLID;
+		SHMIF_RGBA_DECOMP(first, &dst[5], &dst[6], &dst[7], &a);
+		out->pos += 8;
+		return true;
+	}
+
+	uint16_t slot = hv % A12_TILE_CACHE;
+	if (!T->lru && T->cache[slot] == hv){
+		dst[4] = TILE_CACHE;
+		pack_u16(slot, &dst[5]);
+		out->pos += 7;
+		return true;
+	}
+
+	size_t ofs = 0;
+	for (size_t y = ty; y < ty + th; y++){
+		shmif_pixel* px = &vb->buffer[y * vb->pitch + tx];
+		for (size_t x = 0; x < tw; x++){
+			uint8_t a;
+			SHMIF_RGBA_DECOMP(px[x], &pack[ofs], &pack[ofs+1], &pack[ofs+2], &a);
+			ofs += 3;
+		}
+	}
+
+/* content addressed, anything the other end still holds from any position or
+ * earlier frame only costs the digest - otherwise it gets added on both ends */
+	if (T->lru){
+		uint8_t digest[A12_TILE_DIGEST];
+		a12int_tile_digest(pack, tw, th, digest);
+
+		if (a12int_tile_lru_find(T->lru, digest) != A12_TILE_NOSLOT){
+			dst[4] = TILE_HASH;
+			memcpy(&dst[5], digest, A12_TILE_DIGEST);
+			out->pos += 5 + A12_TILE_DIGEST;
+			return true;
+		}
+
+		a12int_tile_lru_insert(T->lru, digest, tw, th);
+		slot = A12_TILE_NOSLOT;
+	}
+	else
+		T->cache[slot] = hv;
+
+	pack_u16(slot, &dst[5]);
+
+/* these are small enough that the worker threads of the context don't help */
+	size_t zsz = ZSTD_compressCCtx(
+		S->channels[ch].zstd, zbuf, sizeof(zbuf), pack, raw_sz, 1);
+
+	if (!ZSTD_isError(zsz) && zsz < raw_sz - raw_sz / 8){
+		dst[4] = TILE_ZSTD;
+		pack_u32(zsz, &dst[7]);
+		memcpy(&dst[11], zbuf, zsz);
+		out->pos += 11 + zsz;
+		return true;
 	}
 
+	dst[4] = TILE_RAW;
+	memcpy(&dst[7], pack, raw_sz);
+	out->pos += 7 + raw_sz;
+	return true;
+}
+
+void a12int_encode_tiles(PACK_ARGS)
+{
+	struct a12_channel* ch = &S->channels[chid];
+	struct a12_tiles* T;
+
+	if (!setup_zstd(S, chid) || !(T = tiles_setup(S, ch, vb->w, vb->h))){
+		a12int_trace(A12_TRACE_ALLOC, "kind=error:message=tile setup failed");
+		return;
+	}
+
+/* only the tiles that the damage touch are considered, of those only the
+ * ones where the contents actually changed are sent */
+	size_t c1 = x / A12_TILE_SZ, r1 = y / A12_TILE_SZ;
+	size_t c2 = (x + w + A12_TILE_SZ - 1) / A12_TILE_SZ;
+	size_t r2 = (y + h + A12_TILE_SZ - 1) / A12_TILE_SZ;
+	if (T->reset || c2 > T->cols || r2 > T->rows || c1 >= c2 || r1 >= r2){
+		c1 = r1 = 0;
+		c2 = T->cols;
+		r2 = T->rows;
+	}
+
+	struct tile_out out = {.buf = T->out, .sz = T->out_sz};
+	size_t bc1 = c2, br1 = r2, bc2 = 0, br2 = 0;
+	size_t n_tiles = 0;
+
+	for (size_t row = r1; row < r2; row++){
+		for (size_t col = c1; col < c2; col++){
+			size_t tx = col * A12_TILE_SZ, ty = row * A12_TILE_SZ;
+			size_t tw = vb->w - tx < A12_TILE_SZ ? vb->w - tx : A12_TILE_SZ;
+			size_t th = vb->h - ty < A12_TILE_SZ ? vb->h - ty : A12_TILE_SZ;
+			uint64_t hv = tile_hash(vb, tx, ty, tw, th);
+			size_t ti = row * T->cols + col;
+
+/* every frame needs a payload, so the last inspected tile goes out if
+ * nothing else changed */
+			bool last = row == r2 - 1 && col == c2 - 1;
+			if (!T->reset && T->hash[ti] == hv && (n_tiles || !last))
+				continue;
+
+			T->hash[ti] = hv;
+/* the caches have already been updated for tiles the other end will never
+ * see, so stop referencing them altogether */
+			if (!tile_encode(S, chid, T, vb, &out, col, row, hv)){
+				a12int_trace(A12_TRACE_ALLOC, "kind=error:message=tile buffer");
+				a12int_tile_lru_free(T->lru);
+				T->lru = NULL;
+				memset(T->cache, '\0', sizeof(T->cache));
+				T->out = out.buf;
+				T->out_sz = out.sz;
+				T->reset = true;
+				return;
+			}
+
+			n_tiles++;
+			bc1 = col < bc1 ? col : bc1;
+			br1 = row < br1 ? row : br1;
+			bc2 = col + 1 > bc2 ? col + 1 : bc2;
+			br2 = row + 1 > br2 ? row + 1 : br2;
+		}
+	}
+	T->reset = false;
+
+/* the region is the bounding box of what was sent so that the other end
+ * only marks that as damaged */
+	x = bc1 * A12_TILE_SZ;
+	y = br1 * A12_TILE_SZ;
+	w = (bc2 * A12_TILE_SZ > vb->w ? vb->w : bc2 * A12_TILE_SZ) - x;
+	h = (br2 * A12_TILE_SZ > vb->h ? vb->h : br2 * A12_TILE_SZ) - y;
+
+	a12int_trace(A12_TRACE_VDETAIL,
+		"kind=status:codec=tiles:tiles=%zu:b_in=%zu:b_out=%zu",
+		n_tiles, w * h * 3, out.pos
+	);
+
+	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
+	a12int_vframehdr_build(hdr_buf, S, chid,
+		POSTPROCESS_VIDEO_TILES, sid, vb->w, vb->h, w, h, x, y,
+		out.pos, w * h * sizeof(shmif_pixel),
+		a12int_venc_commit(S), vb->flags.origo_ll
+	);
+
+	a12int_step_vstream(S, sid);
+	a12int_append_out(S,
+		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
+	chunk_pack(S, STATE_VIDEO_PACKET, chid, out.buf, out.pos, chunk_sz);
+
+/* keep the buffer around, the next frame is likely to need as much */
+	T->out = out.buf;
+	T->out_sz = out.sz;
+}
+
+#if defined(WANT_H264_ENC) || defined(WANT_H264_DEC)
+static const char* hw_encoder_name(int api)
+{
+	switch (api){
+	case A12_HWVIDEO_VAAPI:
+		return "h264_vaapi";
+	case A12_HWVIDEO_NVENC:
+		return "h264_nvenc";
+	case A12_HWVIDEO_V4L2M2M:
+		return "h264_v4l2m2m";
+	default:
+		return NULL;
+	}
+}
+
+static bool codec_has_fmt(const AVCodec* codec, enum AVPixelFormat fmt)
+{
+	if (!codec->pix_fmts)
+		return false;
+
+	for (size_t i = 0; codec->pix_fmts[i] != AV_PIX_FMT_NONE; i++)
+		if (codec->pix_fmts[i] == fmt)
+			return true;
+
+	return false;
+}
+
+/*
+ * vaapi encoders only take their own surfaces, so there is a device and a
+ * pool of NV12 surfaces that each converted frame gets uploaded into.
+ */
+static bool hw_encoder_setup(struct a12_state* S,
+	int chid, AVCodecContext* encoder, struct shmifsrv_vbuffer* vb)
+{
+	struct a12_channel* ch = &S->channels[chid];
+
+	if (av_hwdevice_ctx_create(&ch->videnc.hwdev,
+		AV_HWDEVICE_TYPE_VAAPI, S->opts->hw_video_device, NULL, 0) < 0){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=error:message=vaapi device failed");
+		return false;
+	}
+
+	ch->videnc.hwframes = av_hwframe_ctx_alloc(ch->videnc.hwdev);
+	if (!ch->videnc.hwframes)
+		return false;
+
+	AVHWFramesContext* fctx = (AVHWFramesContext*) ch->videnc.hwframes->data;
+	fctx->format = AV_PIX_FMT_VAAPI;
+	fctx->sw_format = AV_PIX_FMT_NV12;
+	fctx->width = vb->w;
+	fctx->height = vb->h;
+	fctx->initial_pool_size = 8;
+
+	if (av_hwframe_ctx_init(ch->videnc.hwframes) < 0)
+		return false;
+
+	encoder->hw_frames_ctx = av_buffer_ref(ch->videnc.hwframes);
+	if (!encoder->hw_frames_ctx)
+		return false;
+
+	ch->videnc.hwframe = av_frame_alloc();
+	return ch->videnc.hwframe != NULL;
+}
+
+static void hw_encoder_drop(struct a12_channel* ch)
+{
+	av_frame_free(&ch->videnc.hwframe);
+	av_buffer_unref(&ch->videnc.hwframes);
+	av_buffer_unref(&ch->videnc.hwdev);
+}
+#endif
+
+/* just the h264 encoder, for rebuilding it while the channel lives on */
+static void drop_videnc(struct a12_state* S, int chid, bool failed)
+{
 #if defined(WANT_H264_ENC) || defined(WANT_H264_DEC)
 	if (!S->channels[chid].videnc.encdec)
 		return;
 
 /* dealloc context */
-	S->channels[chid].videnc.encdec = NULL;
+	avcodec_free_context(&S->channels[chid].videnc.encdec);
 	S->channels[chid].videnc.failed = failed;
+	hw_encoder_drop(&S->channels[chid]);
 
 	if (S->channels[chid].videnc.scaler){
 		sws_freeContext(S->channels[chid].videnc.scaler);
@@ -691,6 +1338,25 @@ void a12int_encode_drop(struct a12_state* S, int chid, bool failed)
 	a12int_trace(A12_TRACE_VIDEO, "dropping h264 context");
 }
 
+void a12int_encode_drop(struct a12_state* S, int chid, bool failed)
+{
+	if (S->channels[chid].zstd){
+		ZSTD_freeCCtx(S->channels[chid].zstd);
+		S->channels[chid].zstd = NULL;
+	}
+
+/* the other end drops its cache with the channel so the slots go as well */
+	if (S->channels[chid].tiles && !failed){
+		a12int_tile_lru_free(S->channels[chid].tiles->lru);
+		free(S->channels[chid].tiles->out);
+		free(S->channels[chid].tiles->hash);
+		free(S->channels[chid].tiles);
+		S->channels[chid].tiles = NULL;
+	}
+
+	drop_videnc(S, chid, failed);
+}
+
 #if defined(WANT_H264_ENC) || defined(WANT_H264_DEC)
 
 static bool open_videnc(struct a12_state* S,
@@ -704,12 +1370,21 @@ static bool open_videnc(struct a12_state* S,
 	AVPacket* packet = NULL;
 	struct SwsContext* scaler = NULL;
 
+/* the hardware encoder is tried first unless it already failed once */
+	const char* hw_name = NULL;
+	if (!S->channels[chid].videnc.hw_failed && codecid == AV_CODEC_ID_H264)
+		hw_name = hw_encoder_name(S->opts->hw_video);
+
 	if (!codec){
-		codec = avcodec_find_encoder(codecid);
+		if (hw_name)
+			codec = avcodec_find_encoder_by_name(hw_name);
+		if (!codec)
+			codec = avcodec_find_encoder(codecid);
 		if (!codec)
 			return false;
 		S->channels[chid].videnc.codec = codec;
 	}
+	bool hw = hw_name && strcmp(codec->name, hw_name) == 0;
 
 /*
  * prior to this, we have a safeguard if the input resolution isn't % 2 so
@@ -724,7 +1399,7 @@ static bool open_videnc(struct a12_state* S,
 /* Check opts and switch preset, bitrate, tuning etc. based on resolution
  * and link estimates. Later we should switch this dynamically, possibly
  * reconfigure based on AV_CODEC_CAP_PARAM_CHANGE */
-	if (codecid == AV_CODEC_ID_H264){
+	if (codecid == AV_CODEC_ID_H264 && !hw){
 		switch(venc_opts.bias){
 		case VFRAME_BIAS_LATENCY:
 			av_opt_set(encoder->priv_data, "preset", "veryfast", 0);
@@ -757,13 +1432,27 @@ static bool open_videnc(struct a12_state* S,
 	snprintf(buf, 8, "%d", venc_opts.ratefactor);
 	av_opt_set(encoder->priv_data, "crf", buf, 0);
 
-/* this caps the ratefactor based on an eval buffer window */
-	if (!venc_opts.bitrate)
+/* this caps the ratefactor based on an eval buffer window, an explicit cap
+ * (or one from the link estimate) also goes into the VBV so that it holds */
+	if (venc_opts.bitrate){
+		encoder->rc_max_rate = (int64_t) venc_opts.bitrate * 1000;
+		encoder->rc_buffer_size = encoder->rc_max_rate / 2;
+	}
+	else
 		venc_opts.bitrate = 1000;
 
 	snprintf(buf, 8, "%zu", (size_t) venc_opts.bitrate * 1000);
 	av_opt_set(encoder->priv_data, "maxrate", buf, 0);
 
+/* the hardware encoders don't have crf, go by bitrate instead */
+	if (hw){
+		encoder->bit_rate = (int64_t) venc_opts.bitrate * 1000;
+		encoder->rc_max_rate = encoder->bit_rate;
+		encoder->rc_buffer_size = encoder->bit_rate / 2;
+		if (venc_opts.bias == VFRAME_BIAS_LATENCY)
+			av_opt_set(encoder->priv_data, "zerolatency", "1", 0);
+	}
+
 	a12int_trace(A12_TRACE_VIDEO,
 		"kind=encval:crf=%d:rate=%zu", venc_opts.ratefactor, venc_opts.bitrate);
 
@@ -778,8 +1467,30 @@ static bool open_videnc(struct a12_state* S,
 	encoder->gop_size = 1;
 	encoder->max_b_frames = 1;
 	encoder->pix_fmt = AV_PIX_FMT_YUV420P;
-	if (avcodec_open2(encoder, codec, NULL) < 0)
+
+/* pick the input format closest to the shm layout that the encoder takes,
+ * BGR0 is the layout as is and needs no conversion at all */
+	enum AVPixelFormat sw_fmt = AV_PIX_FMT_YUV420P;
+	if (hw && S->opts->hw_video == A12_HWVIDEO_VAAPI){
+		if (!hw_encoder_setup(S, chid, encoder, vb))
+			goto fail_hw;
+		encoder->pix_fmt = AV_PIX_FMT_VAAPI;
+		encoder->max_b_frames = 0;
+		sw_fmt = AV_PIX_FMT_NV12;
+	}
+	else if (hw){
+		if (codec_has_fmt(codec, AV_PIX_FMT_BGR0))
+			sw_fmt = AV_PIX_FMT_BGR0;
+		else if (codec_has_fmt(codec, AV_PIX_FMT_NV12))
+			sw_fmt = AV_PIX_FMT_NV12;
+		encoder->pix_fmt = sw_fmt;
+	}
+
+	if (avcodec_open2(encoder, codec, NULL) < 0){
+		if (hw)
+			goto fail_hw;
 		goto fail;
+	}
 
 	frame = av_frame_alloc();
 	if (!frame)
@@ -789,7 +1500,7 @@ static bool open_videnc(struct a12_state* S,
 	if (!packet)
 		goto fail;
 
-	frame->format = AV_PIX_FMT_YUV420P;
+	frame->format = sw_fmt;
 	frame->width = vb->w;
 	frame->height = vb->h;
 	frame->pts = 0;
@@ -800,22 +1511,36 @@ static bool open_videnc(struct a12_state* S,
 
 	S->channels[chid].videnc.encdec = encoder;
 
-	scaler = sws_getContext(
-		vb->w, vb->h, AV_PIX_FMT_BGRA,
-		vb->w, vb->h, AV_PIX_FMT_YUV420P,
-		SWS_BILINEAR, NULL, NULL, NULL
-	);
+	if (sw_fmt != AV_PIX_FMT_BGR0){
+		scaler = sws_getContext(
+			vb->w, vb->h, AV_PIX_FMT_BGRA,
+			vb->w, vb->h, sw_fmt,
+			SWS_BILINEAR, NULL, NULL, NULL
+		);
 
-	if (!scaler)
-		goto fail;
+		if (!scaler)
+			goto fail;
+	}
 
 	S->channels[chid].videnc.scaler = scaler;
 	S->channels[chid].videnc.frame = frame;
 	S->channels[chid].videnc.packet = packet;
 
-	a12int_trace(A12_TRACE_VIDEO, "kind=codec_ok:ch=%d:codec=%d", chid, codecid);
+	a12int_trace(A12_TRACE_VIDEO,
+		"kind=codec_ok:ch=%d:codec=%d:name=%s", chid, codecid, codec->name);
 	return true;
 
+/* retry once with the software codec */
+fail_hw:
+	a12int_trace(A12_TRACE_SYSTEM,
+		"kind=error:message=%s failed, using software", codec->name);
+	avcodec_free_context(&encoder);
+	S->channels[chid].videnc.encdec = NULL;
+	hw_encoder_drop(&S->channels[chid]);
+	S->channels[chid].videnc.hw_failed = true;
+	S->channels[chid].videnc.codec = NULL;
+	return open_videnc(S, venc_opts, vb, chid, codecid);
+
 fail:
 	if (frame)
 		av_frame_free(&frame);
@@ -843,7 +1568,13 @@ void a12int_encode_h264(PACK_ARGS)
 	else if (
 		vb->w != S->channels[chid].videnc.w ||
 		vb->h != S->channels[chid].videnc.h)
-		a12int_encode_drop(S, chid, false);
+		drop_videnc(S, chid, false);
+
+/* a cap from the link estimate can appear after the encoder was set up, the
+ * VBV can't be switched on afterwards so that takes a new encoder */
+	else if (opts.bitrate && S->channels[chid].videnc.encdec &&
+		!S->channels[chid].videnc.encdec->rc_max_rate)
+		drop_videnc(S, chid, false);
 
 /* If we don't have an encoder (first time or reset due to resize),
  * try to configure, and if the configuration fails (i.e. still no
@@ -862,6 +1593,21 @@ void a12int_encode_h264(PACK_ARGS)
 	if (S->channels[chid].videnc.failed)
 		goto fallback;
 
+/* follow the cap as the link estimate moves, libx264 reconfigures its VBV on
+ * the next frame when these change, large steps only to not thrash it */
+	AVCodecContext* enc = S->channels[chid].videnc.encdec;
+	int64_t cap = (int64_t) opts.bitrate * 1000;
+	if (cap && (cap > enc->rc_max_rate + enc->rc_max_rate / 8 ||
+		cap < enc->rc_max_rate - enc->rc_max_rate / 8)){
+		a12int_trace(A12_TRACE_VIDEO,
+			"kind=encval:rate=%zu:prev=%zu", (size_t) opts.bitrate,
+			(size_t)(enc->rc_max_rate / 1000));
+		enc->rc_max_rate = cap;
+		enc->rc_buffer_size = cap / 2;
+		if (enc->bit_rate)
+			enc->bit_rate = cap;
+	}
+
 /* just for shorthand */
 	AVFrame* frame = S->channels[chid].videnc.frame;
 	AVCodecContext* encoder = S->channels[chid].videnc.encdec;
@@ -883,22 +1629,47 @@ void a12int_encode_h264(PACK_ARGS)
  * other useful tuning is marking sbs for vr
  */
 
-/* and color-convert from src into frame */
+/* and color-convert from src into frame, unless the encoder takes it as is */
 	int ret;
-	const uint8_t* const src[] = {(uint8_t*)vb->buffer};
-	int src_stride[] = {vb->stride};
-	int rv = sws_scale(scaler,
-		src, src_stride, 0, vb->h, frame->data, frame->linesize);
-	if (rv < 0){
-		a12int_trace(A12_TRACE_VIDEO, "rescaling failed: %d", rv);
-		a12int_encode_drop(S, chid, true);
-		goto fallback;
+	int rv = 0;
+	if (scaler){
+		const uint8_t* const src[] = {(uint8_t*)vb->buffer};
+		int src_stride[] = {vb->stride};
+		rv = sws_scale(scaler,
+			src, src_stride, 0, vb->h, frame->data, frame->linesize);
+		if (rv < 0){
+			a12int_trace(A12_TRACE_VIDEO, "rescaling failed: %d", rv);
+			a12int_encode_drop(S, chid, true);
+			goto fallback;
+		}
+	}
+	else
+		av_image_copy_plane(frame->data[0], frame->linesize[0],
+			vb->buffer_bytes, vb->stride, vb->w * sizeof(shmif_pixel), vb->h);
+
+/* with a surface pool, the converted frame is uploaded into a free one */
+	AVFrame* in = frame;
+	if (S->channels[chid].videnc.hwframes){
+		in = S->channels[chid].videnc.hwframe;
+		av_frame_unref(in);
+		if (av_hwframe_get_buffer(S->channels[chid].videnc.hwframes, in, 0) < 0 ||
+			av_hwframe_transfer_data(in, frame, 0) < 0){
+			a12int_trace(A12_TRACE_VIDEO, "kind=error:message=surface upload failed");
+			a12int_encode_drop(S, chid, true);
+			goto fallback;
+		}
 	}
 
 /* send to encoder, may return EAGAIN requesting a flush */
 again:
 	frame->pts++;
-	ret = avcodec_send_frame(encoder, frame);
+	in->pts = frame->pts;
+	in->pict_type = AV_PICTURE_TYPE_NONE;
+	if (S->channels[chid].videnc.keyframe){
+		in->pict_type = AV_PICTURE_TYPE_I;
+		S->channels[chid].videnc.keyframe = false;
+	}
+	ret = avcodec_send_frame(encoder, in);
 	if (ret < 0 && ret != AVERROR(EAGAIN)){
 		a12int_trace(A12_TRACE_VIDEO, "encoder failed: %d", ret);
 		a12int_encode_drop(S, chid, true);
@@ -924,7 +1695,7 @@ again:
 /* don't see a nice way to combine ffmpegs view of 'packets' and ours,
  * maybe we could avoid it and the extra copy but uncertain */
 		uint8_t hdr_buf[CONTROL_PACKET_SIZE];
-		a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
+		a12int_vframehdr_build(hdr_buf, S, chid,
 			POSTPROCESS_VIDEO_H264, sid, vb->w, vb->h, vb->w, vb->h,
 			0, 0, packet->size, vb->w * vb->h * 4, 1, vb->flags.origo_ll
 		);
@@ -20,8 +20,12 @@ void a12int_encode_tz(PACK_ARGS);
 void a12int_encode_dzstd(PACK_ARGS);
 void a12int_encode_ztz(PACK_ARGS);
 void a12int_encode_passthrough(PACK_ARGS);
+void a12int_encode_tiles(PACK_ARGS);
 void a12int_encode_drop(struct a12_state* S, int chid, bool failed);
 
+/* drop the reference frame of the delta encoder, next frame is sent in full */
+void a12int_encode_reset_delta(struct a12_state* S, int chid);
+
 void a12int_encode_araw(struct a12_state* S,
 	uint8_t chid,
 	shmif_asample* buf,
@@ -30,4 +34,15 @@ void a12int_encode_araw(struct a12_state* S,
 	struct a12_aframe_opts opts, size_t chunk_sz
 );
 
+/* returns false if opus can't be used for [cfg] and raw should be sent */
+bool a12int_encode_aopus(struct a12_state* S,
+	uint8_t chid,
+	shmif_asample* buf,
+	size_t n_samples,
+	struct a12_aframe_cfg cfg,
+	struct a12_aframe_opts opts, size_t chunk_sz
+);
+
+void a12int_encode_audio_drop(struct a12_state* S, int chid);
+
 #endif
@@ -12,6 +12,8 @@
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include <libswresample/swresample.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/hwcontext_drm.h>
 #endif
 
 #ifndef ZSTD_DEFAULT_LEVEL
@@ -22,6 +24,12 @@
 #define ZSTD_VIDEO_LEVEL 2
 #endif
 
+/* decoded hardware surfaces passed as handles are kept from being reused by
+ * the decoder until this many newer ones have been passed */
+#ifndef A12_HWVIDEO_HOLD
+#define A12_HWVIDEO_HOLD 3
+#endif
+
 #ifndef VIDEO_FRAME_DRIFT_WINDOW
 #define VIDEO_FRAME_DRIFT_WINDOW 8
 #endif
@@ -35,6 +43,125 @@
 #define BLOB_QUEUE_CAP (128 * 1024)
 #endif
 
+/* audio/video packets are queued unencrypted and moved to the output buffer
+ * on flush, after any input and control. FLUSH_CAP bounds how much of that a
+ * single flush takes, CAP and the DRAIN_ thresholds (estimated time to write
+ * out what is queued) is where the encoders start to back off */
+#ifndef OUTQ_CAP
+#define OUTQ_CAP (8 * 1024 * 1024)
+#endif
+
+#ifndef OUTQ_FLUSH_CAP
+#define OUTQ_FLUSH_CAP (256 * 1024)
+#endif
+
+#ifndef OUTQ_DRAIN_SOFT_MS
+#define OUTQ_DRAIN_SOFT_MS 50
+#endif
+
+#ifndef OUTQ_DRAIN_HARD_MS
+#define OUTQ_DRAIN_HARD_MS 250
+#endif
+
+/* link model from the acks of the last TRACK vframes. The bottleneck rate is
+ * the max delivery rate over BW_SLOTS slots of BW_SLOT_MS, the propagation
+ * estimate the minimum round trip over RTT_WINDOW_MS. Video backs off (soft)
+ * at the bandwidth-delay product in flight or when the smoothed round trip
+ * grows DELAY_SLACK_MS past twice the minimum, and drops frames at CWND_GAIN
+ * times that (never below CWND_MIN). Without any ack for STALL_MS it stays at
+ * backing off so that a lost ack can't stop video. h264 without a set rate
+ * gets VIDEO_SHARE percent of the estimate */
+#ifndef LINK_TRACK
+#define LINK_TRACK 64
+#endif
+
+#ifndef LINK_BW_SLOTS
+#define LINK_BW_SLOTS 8
+#endif
+
+#ifndef LINK_BW_SLOT_MS
+#define LINK_BW_SLOT_MS 250
+#endif
+
+#ifndef LINK_RTT_WINDOW_MS
+#define LINK_RTT_WINDOW_MS 10000
+#endif
+
+#ifndef LINK_SAMPLE_MS
+#define LINK_SAMPLE_MS 10
+#endif
+
+#ifndef LINK_CWND_GAIN
+#define LINK_CWND_GAIN 2
+#endif
+
+#ifndef LINK_CWND_MIN
+#define LINK_CWND_MIN (64 * 1024)
+#endif
+
+#ifndef LINK_DELAY_SLACK_MS
+#define LINK_DELAY_SLACK_MS 20
+#endif
+
+#ifndef LINK_STALL_MS
+#define LINK_STALL_MS 5000
+#endif
+
+#ifndef LINK_VIDEO_SHARE
+#define LINK_VIDEO_SHARE 75
+#endif
+
+/* zstd level for the delta encoder when the link rather than the CPU is the
+ * bottleneck */
+#ifndef ZSTD_VIDEO_PRESSURE_LEVEL
+#define ZSTD_VIDEO_PRESSURE_LEVEL 4
+#endif
+
+/* large zstd video frames are split into bands of BAND_SZ bytes compressed
+ * by up to WORKERS threads (one per core), smaller inputs stay on the calling
+ * thread */
+#ifndef ZSTD_VIDEO_WORKERS
+#define ZSTD_VIDEO_WORKERS 4
+#endif
+
+#ifndef ZSTD_VIDEO_BAND_SZ
+#define ZSTD_VIDEO_BAND_SZ (512 * 1024)
+#endif
+
+/* with A12_FEATURE_ZBANDS the bands are independent zstd frames of whole
+ * rows that the other end can decompress in parallel, at most this many */
+#ifndef ZSTD_VIDEO_BANDS_MAX
+#define ZSTD_VIDEO_BANDS_MAX 64
+#endif
+
+/* upper bound on threads in the video decode worker (a12_set_vdec_worker) */
+#ifndef VDEC_THREADS_MAX
+#define VDEC_THREADS_MAX 16
+#endif
+
+/* bytes of released frame buffers a state keeps around for reuse, see
+ * a12int_pool_alloc */
+#ifndef A12_POOL_CAP
+#define A12_POOL_CAP (16 * 1024 * 1024)
+#endif
+
+/* output buffers and queues that a burst grew past this are released once
+ * drained, and grow back on demand */
+#ifndef A12_OUTBUF_TRIM
+#define A12_OUTBUF_TRIM (1 * 1024 * 1024)
+#endif
+
+/* number of copied video frames that can wait for or be in the encode
+ * worker (see a12_set_venc_worker) */
+#ifndef VENC_QUEUE_LIM
+#define VENC_QUEUE_LIM 2
+#endif
+
+/* states that can be attached to one a12_relay */
+#ifndef A12_RELAY_VIEWERS
+#define A12_RELAY_VIEWERS 64
+#endif
+
 /* safe UDP beacon, increase in controlled LANs */
 #ifndef BEACON_KEY_CAP
 #define BEACON_KEY_CAP 15
@@ -65,6 +192,7 @@ enum {
 	STATE_VIDEO_PACKET   = 4, /* video    -> nopacket, broken                */
 	STATE_BLOB_PACKET    = 5, /* blob     -> nopacket, broken                */
 	STATE_1STSRV_PACKET  = 6, /* mac+nonce -> control                        */
+	STATE_EVENTC_PACKET  = 7, /* compact event -> nopacket, broken           */
 	STATE_BROKEN
 };
 
@@ -84,12 +212,16 @@ enum control_commands {
 	COMMAND_DIROPEN      = 12,/* mediate access to a dyn src/dir */
 	COMMAND_DIROPENED    = 13,/* replies to DIROPEN (src/sink)   */
 	COMMAND_TUNDROP      = 14,/* state change on DIROPENED con   */
+	COMMAND_DATAGRAM     = 15,/* datagram port / refresh request */
+	COMMAND_BSTREAMSEEK  = 16,/* resume offset for a bstream     */
+	COMMAND_TICKET       = 17,/* session ticket for resuming     */
 };
 
 enum hello_mode {
 	HELLO_MODE_NOASYM  = 0,
 	HELLO_MODE_REALPK  = 1,
-	HELLO_MODE_EPHEMPK = 2
+	HELLO_MODE_EPHEMPK = 2,
+	HELLO_MODE_TICKET  = 3
 };
 
 enum channel_cfg {
@@ -100,6 +232,11 @@ enum channel_cfg {
 
 #define SEQUENCE_NUMBER_SIZE 8
 
+/* compact (variable length) event packets are used when the other end
+ * announced at least this shmif minor in HELLO, MAX caps the payload */
+#define A12_EVENTC_MINOR 22
+#define A12_EVENTC_MAX 256
+
 #ifdef _DEBUG
 #define DEBUG 1
 #else
@@ -113,7 +250,97 @@ enum {
 	POSTPROCESS_VIDEO_H264   = 5, /* ffmpeg or native decompressor        */
 	POSTPROCESS_VIDEO_TZSTD  = 7, /* ZSTD+tpack                           */
 	POSTPROCESS_VIDEO_DZSTD  = 8, /* ZSTD - P frame                       */
-	POSTPROCESS_VIDEO_ZSTD   = 9  /* ZSTD - I frame                       */
+	POSTPROCESS_VIDEO_ZSTD   = 9, /* ZSTD - I frame                       */
+	POSTPROCESS_VIDEO_TILES  = 10 /* changed tiles, per-tile coding        */
+};
+
+/* HELLO [71] bitmask of optional formats the sender can decode */
+enum {
+	A12_FEATURE_TILES = 1,
+	A12_FEATURE_TILE_HASH = 2,
+	A12_FEATURE_DGRAM = 4,
+	A12_FEATURE_OPUS = 8,
+	A12_FEATURE_BSTREAM = 16,
+	A12_FEATURE_RESUME = 32,
+	A12_FEATURE_ZBANDS = 64
+};
+
+/* With A12_FEATURE_RESUME, how long (seconds) a session ticket is good for */
+#define TICKET_LIFETIME 600
+
+/* With A12_FEATURE_BSTREAM, this many binary streams can be in flight per
+ * channel at once and resumed transfers restart at a multiple of the chunk
+ * size after the receiver's prefix has been verified by the sender */
+#define BSTREAM_PARALLEL 4
+#define BSTREAM_CHUNK 65536
+
+/* The tile format splits the surface into A12_TILE_SZ squares (smaller at the
+ * right and bottom edges). Each record in the payload is:
+ *  [0..1] column  [2..3] row  [4] type, followed by
+ *  RAW:   [5..6] slot, tile w * h * 3 (r, g, b)
+ *  ZSTD:  [5..6] slot, [7..10] length, zstd frame that expands to RAW
+ *  SOLID: [5..7] r, g, b
+ *  CACHE: [5..6] slot
+ *  HASH:  [5..20] digest
+ * RAW and ZSTD tiles are stored in [slot] of a per-channel cache of
+ * A12_TILE_CACHE tiles on the decoder side, CACHE copies a stored tile back
+ * in. With slot set to 0xffff they go into the content addressed LRU instead,
+ * keyed on the digest of the tile, and HASH copies from there. */
+#define A12_TILE_SZ 64
+#define A12_TILE_CACHE 256
+#define A12_TILE_NOSLOT 0xffff
+#define A12_TILE_LRU 512
+#define A12_TILE_DIGEST 16
+
+enum {
+	TILE_RAW   = 0,
+	TILE_ZSTD  = 1,
+	TILE_SOLID = 2,
+	TILE_CACHE = 3,
+	TILE_HASH  = 4
+};
+
+/* Both ends apply the same lookups and inserts in the same order, so the copy
+ * the encoder keeps (without pixels) always matches what the decoder holds.
+ * A hit moves the entry to the front, an insert into a full cache reuses the
+ * least recently used entry. */
+struct a12_tile_lru {
+	uint16_t head, tail, used;
+	uint16_t bucket[A12_TILE_LRU];
+	struct {
+		uint8_t digest[A12_TILE_DIGEST];
+		uint16_t prev, next, chain;
+		uint16_t w, h;
+	} ent[A12_TILE_LRU];
+	uint8_t* pixels;
+};
+
+struct a12_tile_lru* a12int_tile_lru_alloc(bool pixels);
+void a12int_tile_lru_free(struct a12_tile_lru*);
+
+/* digest over the dimensions and the packed r, g, b values */
+void a12int_tile_digest(
+	const uint8_t* px, size_t w, size_t h, uint8_t out[A12_TILE_DIGEST]);
+
+/* returns the entry index or A12_TILE_NOSLOT */
+uint16_t a12int_tile_lru_find(
+	struct a12_tile_lru*, const uint8_t digest[A12_TILE_DIGEST]);
+
+/* returns the entry index the tile should be stored at */
+uint16_t a12int_tile_lru_insert(struct a12_tile_lru*,
+	const uint8_t digest[A12_TILE_DIGEST], size_t w, size_t h);
+
+/* encoder side mirror of what the other end has: per tile content hashes of
+ * the last frame, the hashes of the tiles held in each cache slot and, when
+ * both ends support it, the digests in the content addressed cache */
+struct a12_tiles {
+	size_t w, h, cols, rows;
+	bool reset;
+	uint64_t* hash;
+	uint64_t cache[A12_TILE_CACHE];
+	struct a12_tile_lru* lru;
+	uint8_t* out;
+	size_t out_sz;
 };
 
 size_t a12int_header_size(int type);
@@ -121,6 +348,14 @@ size_t a12int_header_size(int type);
 struct ZSTD_CCtx_s;
 struct ZSTD_DCtx_s;
 
+enum audio_encoding {
+	AUDIO_ENCODING_S16 = 0,
+	AUDIO_ENCODING_OPUS = 1 /* u16 length prefixed packets */
+};
+
+/* encoded audio frames are collected whole before decoding */
+#define AUDIO_UNIT_MAX (512 * 1024)
+
 struct audio_frame {
 	uint32_t id;
 
@@ -130,6 +365,7 @@ struct audio_frame {
 	uint8_t format;
 	uint16_t nsamples;
 	uint8_t commit;
+	uint64_t pts; /* source media clock, us */
 
 /* only used for some postprocessing mode (i.e. decompression) */
 	uint8_t* inbuf;
@@ -148,6 +384,7 @@ struct binary_frame {
 	uint8_t checksum[16];
 	int64_t streamid; /* actual type is uint32 but -1 for cancel */
 	char extid[16];
+	bool resume; /* the bhandler supplied a prefix of the stream in tmp_fd */
 	struct ZSTD_DCtx_s* zstd;
 };
 
@@ -159,6 +396,7 @@ struct video_frame {
 	uint32_t flags;
 	uint8_t postprocess;
 	uint8_t commit; /* finish after this transfer? */
+	uint64_t pts; /* source media clock, us */
 
 	uint8_t* inbuf; /* decode buffer, not used for all modes */
 	uint32_t inbuf_pos;
@@ -205,6 +443,12 @@ struct blob_out {
 	uint64_t streamid;
 	uint64_t rampup_seqnr;
 
+/* file-backed sources are read with pread from [ofs] as the descriptor can be
+ * shared, resumable ones hold data until the receiver has replied with a seek */
+	uint64_t size;
+	uint64_t ofs;
+	bool wait_seek;
+
 	struct ZSTD_CCtx_s* zstd;
 	struct blob_out* next;
 };
@@ -219,11 +463,42 @@ struct a12_channel {
 		struct video_frame vframe;
 		struct audio_frame aframe;
 		struct binary_frame bframe;
+
+/* further concurrent binary streams (A12_FEATURE_BSTREAM), bframe is the first */
+		struct binary_frame bstreams[BSTREAM_PARALLEL - 1];
 	} unpack_state;
 
 /* used for both encoding and decoding, state is aliased into unpack_state */
 	struct shmifsrv_vbuffer acc;
 
+/* encoder side, method used for the last frame and if one was dropped due to
+ * output pressure (next goes out in full as its damage is lost) */
+	int last_vmethod;
+	bool vframe_dropped;
+
+/* VFRAME_METHOD_ADAPTIVE, method currently picked and moving averages of the
+ * damaged share of the surface (0..256), frame interval, output bytes and
+ * compression ratio (out / in, 0..256) that it was picked from */
+	struct {
+		int method;
+		size_t streak;
+		size_t motion;
+		size_t interval;
+		size_t bytes;
+		size_t ratio;
+		uint64_t last_ts;
+	} adapt;
+
+/* tile format state, encoder and decoder (cache pixels) sides */
+	struct a12_tiles* tiles;
+	uint8_t* tile_cache;
+	struct a12_tile_lru* tile_lru;
+
+/* opus audio, encoder (holding samples until there is a full frame) and the
+ * decoder with its jitter buffer */
+	struct a12_aenc* aenc;
+	struct a12_jitter* jitter;
+
 	struct {
 		uint8_t* compression;
 		struct ZSTD_CCtx_s* zstd;
@@ -237,12 +512,52 @@ struct a12_channel {
 			struct SwsContext* scaler;
 			size_t w, h;
 			bool failed;
+
+/* hardware backend: device, encoder surface pool and upload frame, and on the
+ * decode side the mapped frames that the sink may still be sampling from */
+			AVBufferRef* hwdev;
+			AVBufferRef* hwframes;
+			AVFrame* hwframe;
+			AVFrame* held[A12_HWVIDEO_HOLD];
+			size_t held_ind;
+			bool hw_failed;
+
+/* next frame should be an IDR, set when h264 is resumed after other methods */
+			bool keyframe;
 		} videnc;
 #endif
 	};
 };
 
+enum outq_class {
+	OUTQ_NONE  = 0,
+	OUTQ_AUDIO = 1,
+	OUTQ_VIDEO = 2,
+	OUTQ_COUNT = 3
+};
+
+enum outq_pressure {
+	OUTQ_PRESSURE_NONE = 0,
+	OUTQ_PRESSURE_SOFT = 1,
+	OUTQ_PRESSURE_HARD = 2
+};
+
+/* records of u8 type, u32 size, payload - grouped into units (one frame)
+ * by an OUTQ_UNIT_END record, only complete units are moved out */
+struct a12_outq {
+	uint8_t* buf;
+	size_t sz;
+	size_t used;
+	size_t ofs;
+	size_t unit_start;
+	size_t units;
+};
+
 struct a12_state;
+struct a12_venc;
+struct a12_vdec;
+struct a12_pool;
+struct a12_dgram;
 struct a12_state {
 	struct a12_context_options* opts;
 	struct appl_meta* directory;
@@ -258,6 +573,28 @@ struct a12_state {
 	int64_t shutdown_id;
 	bool advenc_broken;
 
+/* set while emitting all but the last region of a chained (multi-rect damage)
+ * video frame so that the other side only commits once */
+	bool vframe_defer_commit;
+
+/* capture time (media clock) of the video frame being encoded */
+	uint64_t vframe_pts;
+
+/* optional video encode worker and the number of zstd band threads */
+	struct a12_venc* venc;
+	size_t venc_threads;
+
+/* optional video decode worker and the number of threads it (and the zstd
+ * bands in a frame) gets */
+	struct a12_vdec* vdec;
+	size_t vdec_threads;
+
+/* datagram transport for a/v, keys and reassembly, see a12_datagram_ */
+	struct a12_dgram* dgram;
+
+/* recycled frame buffers, see a12int_pool_alloc */
+	struct a12_pool* pool;
+
 /* The biggest concern of congestion is video frames as that tends to be most
  * primary data. The decision to act upon this is still up to the tool feeding
  * the state machine, there might be other priorities and factors to weigh in
@@ -267,6 +604,30 @@ struct a12_state {
 		uint32_t frame_window[VIDEO_FRAME_DRIFT_WINDOW]; /* seqnrs tied to vframes */
 		size_t pending; /* updated whenever we send something out */
 	} congestion_stats;
+
+/* link model (see LINK_ defines), bytes handed out on flush, the outgoing
+ * vframes by stream id with their offset into that and the time they were
+ * flushed, the offset the acks say has arrived and the filter states */
+	struct {
+		struct {
+			uint32_t id;
+			uint64_t pos;
+			uint64_t end;
+			uint64_t ts;
+		} track[LINK_TRACK];
+		uint32_t last_id;
+		uint64_t flushed;
+		uint64_t delivered;
+		uint64_t ack_ts;
+		uint64_t ack_pos;
+		size_t bw_slot[LINK_BW_SLOTS];
+		size_t bw_ind;
+		uint64_t bw_ts;
+		size_t bw;
+		size_t rtt;
+		size_t rtt_min;
+		uint64_t rtt_min_ts;
+	} link;
 	struct a12_iostat stats;
 
 /* tracks a pending dynamic directory resource */
@@ -285,10 +646,24 @@ struct a12_state {
 	uint8_t buf_ind;
 	size_t buf_ofs;
 
+/* bulk data waiting for the output buffer, in priority order, the class that
+ * a12int_append_out currently pushes to and the drain rate estimate that
+ * is sampled on flush */
+	struct a12_outq outq[OUTQ_COUNT];
+	int outq_class;
+	struct {
+		uint64_t last_ts;
+		size_t last_sz;
+		size_t acc_b;
+		size_t acc_ms;
+		size_t rate;
+	} drain;
+
 /* linked list of pending binary transfers, can be re-ordered and affect
  * blocking / transfer state of events on the other side */
 	struct blob_out* pending;
 	size_t active_blobs;
+	size_t blob_rr;
 
 /* current event handler for binary transfer cache oracle */
 	struct a12_bhandler_res
@@ -331,14 +706,26 @@ struct a12_state {
 		uint8_t real_priv[32];
 		uint64_t rekey_pos;
 		uint8_t remote_pub[32];
+
+/* client, the preshared secret that a resumed session starts from */
+		char psk[32];
 	} keys;
 
+/* client, the last ticket the server handed out and if the state is waiting
+ * for the server to accept one, see a12_resume */
+	struct a12_ticket ticket;
+	bool resuming;
+
 /* client side needs to send the first packet with MAC+nonce, server side
  * needs to interpret first packet with MAC+nonce */
 	bool server;
 	bool cl_firstout;
 	int authentic;
 	int remote_mode;
+
+/* shmif version the other end announced in HELLO, gates wire features */
+	uint8_t remote_major, remote_minor;
+	uint8_t remote_features;
 	char* endpoint;
 
 /* saved between calls to unpack, see end of a12_unpack for explanation */
@@ -367,9 +754,45 @@ void a12int_append_out(
 
 void a12int_step_vstream(struct a12_state* S, uint32_t id);
 
+/* Returns how backed up the output is (enum outq_pressure), based on queued
+ * bytes and the estimated time to drain them. */
+int a12int_out_pressure(struct a12_state* S);
+
+/* The encoders run either on the thread servicing the state or on the encode
+ * worker, these return the seqnr to ack and if the frame should be committed
+ * from the state or from the job that the worker is processing. */
+uint64_t a12int_venc_seqnr(struct a12_state* S);
+bool a12int_venc_commit(struct a12_state* S);
+
+/* Media clock (us) that audio and video are stamped with, on the source side
+ * that is the capture time of the frame being encoded. */
+uint64_t a12int_media_clock(void);
+uint64_t a12int_venc_pts(struct a12_state* S);
+
+/* Frame sized scratch buffers (compressed video in either direction, zstd
+ * decode targets, delta accumulation) come from and go back to a per-state
+ * pool rather than malloc for every frame. The pool is locked as the encode
+ * and decode workers use it too. A buffer from _alloc must be released with
+ * _free and nothing else. */
+void* a12int_pool_alloc(struct a12_state* S, size_t sz);
+void a12int_pool_free(struct a12_state* S, void* buf);
+
+/* Run [fn] once for each of [n] bands on up to [threads] threads, the
+ * calling one included, and return when all are done. */
+void a12int_band_run(size_t n, size_t threads,
+	void (*fn)(size_t i, void* tag), void* tag);
+
+/* Forward [n] interleaved samples to the audio destination of [ch] */
+void a12int_audio_out(struct a12_state* S, struct a12_channel* ch,
+	const int16_t* buf, size_t n, uint8_t channels, uint32_t rate);
+
 /* takes ownership of appl_meta */
 void a12int_set_directory(struct a12_state*, struct appl_meta*);
 
+/* takes ownership of appl_meta, replaces or appends entries by identifier
+ * rather than swapping out the whole directory */
+void a12int_update_directory(struct a12_state*, struct appl_meta*);
+
 /*
  * For a state in directory server mode,
  * and with the other end having requested notifications as part of a
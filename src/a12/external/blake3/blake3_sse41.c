@@ -0,0 +1,227 @@
+/*
+ * SSE4.1 backend for the bundled BLAKE3, plugs into blake3_dispatch.c and
+ * follows the structure of blake3_portable.c. Single block compression works
+ * on the state as four rows, hash_many runs four inputs in parallel with one
+ * vector per state word. Same license as the rest of the BLAKE3 sources.
+ */
+#include "blake3_impl.h"
+
+#if defined(IS_X86) && !defined(BLAKE3_NO_SSE41)
+#include <immintrin.h>
+
+#define DEGREE 4
+
+INLINE __m128i loadu(const uint8_t src[16])
+{
+	return _mm_loadu_si128((const __m128i*) src);
+}
+
+INLINE void storeu(__m128i src, uint8_t dest[16])
+{
+	_mm_storeu_si128((__m128i*) dest, src);
+}
+
+INLINE __m128i addv(__m128i a, __m128i b){ return _mm_add_epi32(a, b); }
+INLINE __m128i xorv(__m128i a, __m128i b){ return _mm_xor_si128(a, b); }
+INLINE __m128i set1(uint32_t x){ return _mm_set1_epi32((int32_t) x); }
+
+INLINE __m128i rot16(__m128i x)
+{
+	return _mm_shuffle_epi8(x,
+		_mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+}
+
+INLINE __m128i rot12(__m128i x)
+{
+	return _mm_or_si128(_mm_srli_epi32(x, 12), _mm_slli_epi32(x, 32 - 12));
+}
+
+INLINE __m128i rot8(__m128i x)
+{
+	return _mm_shuffle_epi8(x,
+		_mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+}
+
+INLINE __m128i rot7(__m128i x)
+{
+	return _mm_or_si128(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 32 - 7));
+}
+
+INLINE void g(__m128i* a, __m128i* b, __m128i* c, __m128i* d, __m128i x, __m128i y)
+{
+	*a = addv(addv(*a, *b), x);
+	*d = rot16(xorv(*d, *a));
+	*c = addv(*c, *d);
+	*b = rot12(xorv(*b, *c));
+	*a = addv(addv(*a, *b), y);
+	*d = rot8(xorv(*d, *a));
+	*c = addv(*c, *d);
+	*b = rot7(xorv(*b, *c));
+}
+
+/*
+ * Row-wise single block: the column step runs G on all four columns at once,
+ * the diagonal step rotates rows 1..3 so that the diagonals line up as columns
+ * and back again afterwards.
+ */
+INLINE void compress_pre(__m128i rows[4], const uint32_t cv[8],
+	const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+	uint64_t counter, uint8_t flags)
+{
+	uint32_t m[16];
+	for (size_t i = 0; i < 16; i++)
+		m[i] = load32(&block[i * 4]);
+
+	rows[0] = _mm_loadu_si128((const __m128i*) &cv[0]);
+	rows[1] = _mm_loadu_si128((const __m128i*) &cv[4]);
+	rows[2] = _mm_set_epi32(
+		(int32_t) IV[3], (int32_t) IV[2], (int32_t) IV[1], (int32_t) IV[0]);
+	rows[3] = _mm_set_epi32((int32_t) flags, (int32_t) block_len,
+		(int32_t) counter_high(counter), (int32_t) counter_low(counter));
+
+	for (size_t r = 0; r < 7; r++){
+		const uint8_t* s = MSG_SCHEDULE[r];
+		g(&rows[0], &rows[1], &rows[2], &rows[3],
+			_mm_set_epi32(m[s[6]], m[s[4]], m[s[2]], m[s[0]]),
+			_mm_set_epi32(m[s[7]], m[s[5]], m[s[3]], m[s[1]]));
+
+		rows[1] = _mm_shuffle_epi32(rows[1], _MM_SHUFFLE(0, 3, 2, 1));
+		rows[2] = _mm_shuffle_epi32(rows[2], _MM_SHUFFLE(1, 0, 3, 2));
+		rows[3] = _mm_shuffle_epi32(rows[3], _MM_SHUFFLE(2, 1, 0, 3));
+
+		g(&rows[0], &rows[1], &rows[2], &rows[3],
+			_mm_set_epi32(m[s[14]], m[s[12]], m[s[10]], m[s[8]]),
+			_mm_set_epi32(m[s[15]], m[s[13]], m[s[11]], m[s[9]]));
+
+		rows[1] = _mm_shuffle_epi32(rows[1], _MM_SHUFFLE(2, 1, 0, 3));
+		rows[2] = _mm_shuffle_epi32(rows[2], _MM_SHUFFLE(1, 0, 3, 2));
+		rows[3] = _mm_shuffle_epi32(rows[3], _MM_SHUFFLE(0, 3, 2, 1));
+	}
+}
+
+void blake3_compress_in_place_sse41(uint32_t cv[8],
+	const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+	uint64_t counter, uint8_t flags)
+{
+	__m128i rows[4];
+	compress_pre(rows, cv, block, block_len, counter, flags);
+	_mm_storeu_si128((__m128i*) &cv[0], xorv(rows[0], rows[2]));
+	_mm_storeu_si128((__m128i*) &cv[4], xorv(rows[1], rows[3]));
+}
+
+void blake3_compress_xof_sse41(const uint32_t cv[8],
+	const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len,
+	uint64_t counter, uint8_t flags, uint8_t out[64])
+{
+	__m128i rows[4];
+	compress_pre(rows, cv, block, block_len, counter, flags);
+	storeu(xorv(rows[0], rows[2]), &out[0]);
+	storeu(xorv(rows[1], rows[3]), &out[16]);
+	storeu(xorv(rows[2], _mm_loadu_si128((const __m128i*) &cv[0])), &out[32]);
+	storeu(xorv(rows[3], _mm_loadu_si128((const __m128i*) &cv[4])), &out[48]);
+}
+
+INLINE void transpose4(__m128i v[4])
+{
+	__m128i ab_01 = _mm_unpacklo_epi32(v[0], v[1]);
+	__m128i ab_23 = _mm_unpackhi_epi32(v[0], v[1]);
+	__m128i cd_01 = _mm_unpacklo_epi32(v[2], v[3]);
+	__m128i cd_23 = _mm_unpackhi_epi32(v[2], v[3]);
+	v[0] = _mm_unpacklo_epi64(ab_01, cd_01);
+	v[1] = _mm_unpackhi_epi64(ab_01, cd_01);
+	v[2] = _mm_unpacklo_epi64(ab_23, cd_23);
+	v[3] = _mm_unpackhi_epi64(ab_23, cd_23);
+}
+
+/* message words for one block of four inputs, m[word] holds one per input */
+INLINE void transpose_msg(const uint8_t* const* inputs, size_t ofs, __m128i m[16])
+{
+	for (size_t w = 0; w < 4; w++){
+		for (size_t i = 0; i < DEGREE; i++)
+			m[w * 4 + i] = loadu(&inputs[i][ofs + w * 16]);
+		transpose4(&m[w * 4]);
+	}
+}
+
+INLINE void round_fn4(__m128i v[16], const __m128i m[16], size_t r)
+{
+	const uint8_t* s = MSG_SCHEDULE[r];
+	g(&v[0], &v[4], &v[8], &v[12], m[s[0]], m[s[1]]);
+	g(&v[1], &v[5], &v[9], &v[13], m[s[2]], m[s[3]]);
+	g(&v[2], &v[6], &v[10], &v[14], m[s[4]], m[s[5]]);
+	g(&v[3], &v[7], &v[11], &v[15], m[s[6]], m[s[7]]);
+	g(&v[0], &v[5], &v[10], &v[15], m[s[8]], m[s[9]]);
+	g(&v[1], &v[6], &v[11], &v[12], m[s[10]], m[s[11]]);
+	g(&v[2], &v[7], &v[8], &v[13], m[s[12]], m[s[13]]);
+	g(&v[3], &v[4], &v[9], &v[14], m[s[14]], m[s[15]]);
+}
+
+static void hash4(const uint8_t* const* inputs, size_t blocks,
+	const uint32_t key[8], uint64_t counter, bool increment_counter,
+	uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t* out)
+{
+	__m128i h[8];
+	for (size_t i = 0; i < 8; i++)
+		h[i] = set1(key[i]);
+
+	uint32_t lo[DEGREE], hi[DEGREE];
+	for (size_t i = 0; i < DEGREE; i++){
+		uint64_t ctr = counter + (increment_counter ? i : 0);
+		lo[i] = counter_low(ctr);
+		hi[i] = counter_high(ctr);
+	}
+	__m128i ctr_lo = _mm_loadu_si128((const __m128i*) lo);
+	__m128i ctr_hi = _mm_loadu_si128((const __m128i*) hi);
+
+	uint8_t block_flags = flags | flags_start;
+	for (size_t b = 0; b < blocks; b++){
+		if (b + 1 == blocks)
+			block_flags |= flags_end;
+
+		__m128i m[16];
+		transpose_msg(inputs, b * BLAKE3_BLOCK_LEN, m);
+
+		__m128i v[16] = {
+			h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+			set1(IV[0]), set1(IV[1]), set1(IV[2]), set1(IV[3]),
+			ctr_lo, ctr_hi, set1(BLAKE3_BLOCK_LEN), set1(block_flags)
+		};
+
+		for (size_t r = 0; r < 7; r++)
+			round_fn4(v, m, r);
+
+		for (size_t i = 0; i < 8; i++)
+			h[i] = xorv(v[i], v[i + 8]);
+
+		block_flags = flags;
+	}
+
+/* h[word] holds one lane per input, flip back to one row per output */
+	transpose4(&h[0]);
+	transpose4(&h[4]);
+	for (size_t i = 0; i < DEGREE; i++){
+		storeu(h[i], &out[i * BLAKE3_OUT_LEN]);
+		storeu(h[i + 4], &out[i * BLAKE3_OUT_LEN + 16]);
+	}
+}
+
+void blake3_hash_many_sse41(const uint8_t* const* inputs, size_t num_inputs,
+	size_t blocks, const uint32_t key[8], uint64_t counter,
+	bool increment_counter, uint8_t flags, uint8_t flags_start,
+	uint8_t flags_end, uint8_t* out)
+{
+	while (num_inputs >= DEGREE){
+		hash4(inputs, blocks, key, counter,
+			increment_counter, flags, flags_start, flags_end, out);
+		if (increment_counter)
+			counter += DEGREE;
+		inputs += DEGREE;
+		num_inputs -= DEGREE;
+		out += DEGREE * BLAKE3_OUT_LEN;
+	}
+
+	if (num_inputs)
+		blake3_hash_many_portable(inputs, num_inputs, blocks, key,
+			counter, increment_counter, flags, flags_start, flags_end, out);
+}
+#endif
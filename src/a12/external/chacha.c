@@ -14,8 +14,8 @@ WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
 ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
 OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
-This implementation is intended to be simple, many optimizations can be
-performed.
+The block function is kept simple, bulk use goes through the multi-block
+SSE2/AVX2/NEON paths further below.
 */
 
 #include <stdbool.h>
@@ -129,21 +129,260 @@ static void chacha_counter_set(
 	chacha_block(ctx, ctx->keystream.u32);
 }
 
-static void chacha_apply(
-	struct chacha_ctx *ctx, uint8_t* buf, size_t length)
+/*
+ * Multi-block keystream generation, the state is kept 'vertical' with one
+ * vector per schedule word and one lane per block, so 4 (SSE2/NEON) or 8
+ * (AVX2) consecutive counter values are processed at once, then transposed
+ * back into blocks and XORed straight from source to destination.
+ *
+ * The lanes only increment the low counter word, batches that would carry
+ * into the next word take the scalar path instead.
+ */
+#if !defined(CHACHA_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define CHACHA_SIMD_SSE2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CHACHA_SIMD_AVX2
+#endif
+#elif !defined(CHACHA_NO_SIMD) && defined(__ARM_NEON) && \
+	defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#define CHACHA_SIMD_NEON
+#endif
+
+static bool chacha_lanes_ok(struct chacha_ctx* ctx, uint32_t lanes)
 {
-	if (!length)
-		return;
+	return ctx->schedule[counter_pos] <= UINT32_MAX - (lanes - 1);
+}
+
+static void chacha_step_counter(struct chacha_ctx* ctx, uint32_t lanes)
+{
+	uint32_t *const nonce = &ctx->schedule[counter_pos];
+	nonce[0] += lanes;
+	if (!nonce[0] && !++nonce[1] && !++nonce[2]){
+		++nonce[3];
+	}
+}
+
+#define VQUARTERROUND(ADD, XOR, ROT, a, b, c, d) \
+	a = ADD(a, b); d = ROT(XOR(d, a), 16); \
+	c = ADD(c, d); b = ROT(XOR(b, c), 12); \
+	a = ADD(a, b); d = ROT(XOR(d, a), 8); \
+	c = ADD(c, d); b = ROT(XOR(b, c), 7);
+
+#define VDOUBLEROUND(ADD, XOR, ROT, x) \
+	VQUARTERROUND(ADD, XOR, ROT, x[0], x[4], x[8], x[12]) \
+	VQUARTERROUND(ADD, XOR, ROT, x[1], x[5], x[9], x[13]) \
+	VQUARTERROUND(ADD, XOR, ROT, x[2], x[6], x[10], x[14]) \
+	VQUARTERROUND(ADD, XOR, ROT, x[3], x[7], x[11], x[15]) \
+	VQUARTERROUND(ADD, XOR, ROT, x[0], x[5], x[10], x[15]) \
+	VQUARTERROUND(ADD, XOR, ROT, x[1], x[6], x[11], x[12]) \
+	VQUARTERROUND(ADD, XOR, ROT, x[2], x[7], x[8], x[13]) \
+	VQUARTERROUND(ADD, XOR, ROT, x[3], x[4], x[9], x[14])
+
+#ifdef CHACHA_SIMD_SSE2
+#define SSE_ROTL(v, n) _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+
+static void chacha_blocks4(
+	struct chacha_ctx* ctx, uint8_t* dst, const uint8_t* src)
+{
+	__m128i x[16], s[16];
+	for (size_t i = 0; i < 16; i++)
+		s[i] = _mm_set1_epi32(ctx->schedule[i]);
+	s[12] = _mm_add_epi32(s[12], _mm_set_epi32(3, 2, 1, 0));
+	memcpy(x, s, sizeof(x));
+
+	for (int i = ctx->iterations; i; i--){
+		VDOUBLEROUND(_mm_add_epi32, _mm_xor_si128, SSE_ROTL, x)
+	}
+
+	for (size_t i = 0; i < 16; i++)
+		x[i] = _mm_add_epi32(x[i], s[i]);
+
+/* each group of four words transposes into 16 bytes of four blocks */
+	for (size_t g = 0; g < 4; g++){
+		__m128i* v = &x[g * 4];
+		__m128i t0 = _mm_unpacklo_epi32(v[0], v[1]);
+		__m128i t1 = _mm_unpacklo_epi32(v[2], v[3]);
+		__m128i t2 = _mm_unpackhi_epi32(v[0], v[1]);
+		__m128i t3 = _mm_unpackhi_epi32(v[2], v[3]);
+		__m128i b[4] = {
+			_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+			_mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)
+		};
+		for (size_t j = 0; j < 4; j++){
+			size_t ofs = j * 64 + g * 16;
+			__m128i in = _mm_loadu_si128((const __m128i*) &src[ofs]);
+			_mm_storeu_si128((__m128i*) &dst[ofs], _mm_xor_si128(in, b[j]));
+		}
+	}
+}
+#endif
+
+#ifdef CHACHA_SIMD_AVX2
+#define AVX_ROTL(v, n) \
+	_mm256_or_si256(_mm256_slli_epi32(v, n), _mm256_srli_epi32(v, 32 - (n)))
+
+static bool chacha_have_avx2()
+{
+	static int have = -1;
+	if (have == -1){
+		__builtin_cpu_init();
+		have = __builtin_cpu_supports("avx2");
+	}
+	return have;
+}
+
+__attribute__((target("avx2")))
+static void chacha_blocks8(
+	struct chacha_ctx* ctx, uint8_t* dst, const uint8_t* src)
+{
+	__m256i x[16], s[16];
+	for (size_t i = 0; i < 16; i++)
+		s[i] = _mm256_set1_epi32(ctx->schedule[i]);
+	s[12] = _mm256_add_epi32(s[12], _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+	memcpy(x, s, sizeof(x));
+
+	for (int i = ctx->iterations; i; i--){
+		VDOUBLEROUND(_mm256_add_epi32, _mm256_xor_si256, AVX_ROTL, x)
+	}
+
+	for (size_t i = 0; i < 16; i++)
+		x[i] = _mm256_add_epi32(x[i], s[i]);
 
+/* unpack works within the 128-bit halves, so after the 4x4 transpose the
+ * low half of b[g][j] is part of block j and the high half of block j+4 */
+	__m256i b[4][4];
+	for (size_t g = 0; g < 4; g++){
+		__m256i* v = &x[g * 4];
+		__m256i t0 = _mm256_unpacklo_epi32(v[0], v[1]);
+		__m256i t1 = _mm256_unpacklo_epi32(v[2], v[3]);
+		__m256i t2 = _mm256_unpackhi_epi32(v[0], v[1]);
+		__m256i t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+		b[g][0] = _mm256_unpacklo_epi64(t0, t1);
+		b[g][1] = _mm256_unpackhi_epi64(t0, t1);
+		b[g][2] = _mm256_unpacklo_epi64(t2, t3);
+		b[g][3] = _mm256_unpackhi_epi64(t2, t3);
+	}
+
+	for (size_t j = 0; j < 4; j++){
+		__m256i out[4] = {
+			_mm256_permute2x128_si256(b[0][j], b[1][j], 0x20),
+			_mm256_permute2x128_si256(b[2][j], b[3][j], 0x20),
+			_mm256_permute2x128_si256(b[0][j], b[1][j], 0x31),
+			_mm256_permute2x128_si256(b[2][j], b[3][j], 0x31)
+		};
+		size_t ofs[4] = {j * 64, j * 64 + 32, (j + 4) * 64, (j + 4) * 64 + 32};
+		for (size_t k = 0; k < 4; k++){
+			__m256i in = _mm256_loadu_si256((const __m256i*) &src[ofs[k]]);
+			_mm256_storeu_si256((__m256i*) &dst[ofs[k]], _mm256_xor_si256(in, out[k]));
+		}
+	}
+}
+#endif
+
+#ifdef CHACHA_SIMD_NEON
+#define NEON_ROTL(v, n) vsriq_n_u32(vshlq_n_u32(v, n), v, 32 - (n))
+
+static void chacha_blocks4(
+	struct chacha_ctx* ctx, uint8_t* dst, const uint8_t* src)
+{
+	static const uint32_t lane_ofs[4] = {0, 1, 2, 3};
+	uint32x4_t x[16], s[16];
+	for (size_t i = 0; i < 16; i++)
+		s[i] = vdupq_n_u32(ctx->schedule[i]);
+	s[12] = vaddq_u32(s[12], vld1q_u32(lane_ofs));
+	memcpy(x, s, sizeof(x));
+
+	for (int i = ctx->iterations; i; i--){
+		VDOUBLEROUND(vaddq_u32, veorq_u32, NEON_ROTL, x)
+	}
+
+/* interleaving store of four words is the transpose, one block per 16 */
+	for (size_t g = 0; g < 4; g++){
+		uint32_t ks[16];
+		uint32x4x4_t v = {{
+			vaddq_u32(x[g * 4 + 0], s[g * 4 + 0]),
+			vaddq_u32(x[g * 4 + 1], s[g * 4 + 1]),
+			vaddq_u32(x[g * 4 + 2], s[g * 4 + 2]),
+			vaddq_u32(x[g * 4 + 3], s[g * 4 + 3])
+		}};
+		vst4q_u32(ks, v);
+		for (size_t j = 0; j < 4; j++){
+			size_t ofs = j * 64 + g * 16;
+			uint8x16_t in = vld1q_u8(&src[ofs]);
+			vst1q_u8(&dst[ofs],
+				veorq_u8(in, vreinterpretq_u8_u32(vld1q_u32(&ks[j * 4]))));
+		}
+	}
+}
+#endif
+
+/* keystream for [n] whole blocks XORed from [src] into [dst], may alias */
+static void chacha_xor_blocks(struct chacha_ctx* ctx,
+	uint8_t* dst, const uint8_t* src, size_t n)
+{
+	while (n){
+#ifdef CHACHA_SIMD_AVX2
+		if (n >= 8 && chacha_lanes_ok(ctx, 8) && chacha_have_avx2()){
+			chacha_blocks8(ctx, dst, src);
+			chacha_step_counter(ctx, 8);
+			dst += 8 * 64, src += 8 * 64, n -= 8;
+			continue;
+		}
+#endif
+#if defined(CHACHA_SIMD_SSE2) || defined(CHACHA_SIMD_NEON)
+		if (n >= 4 && chacha_lanes_ok(ctx, 4)){
+			chacha_blocks4(ctx, dst, src);
+			chacha_step_counter(ctx, 4);
+			dst += 4 * 64, src += 4 * 64, n -= 4;
+			continue;
+		}
+#endif
+		union {
+			uint32_t u32[16];
+			uint8_t u8[64];
+		} ks;
+		chacha_block(ctx, ks.u32);
+		for (size_t i = 0; i < 64; i++)
+			dst[i] = src[i] ^ ks.u8[i];
+		dst += 64, src += 64, n--;
+	}
+}
+
+/*
+ * Apply the cipher while copying from [src] to [dst] (which may be the same),
+ * the keystream left from the previous call is used first, then whole blocks
+ * go directly from the block function and the tail starts a new keystream.
+ */
+static void chacha_apply_copy(struct chacha_ctx *ctx,
+	uint8_t* dst, const uint8_t* src, size_t length)
+{
 	size_t ofs = 0;
-	while(ofs < length){
-		if (ctx->pos == 64)
-			chacha_block(ctx, ctx->keystream.u32);
-
-		size_t nib = 64 - ctx->pos;
-		while (nib && ofs < length){
-			buf[ofs] ^= ctx->keystream.u8[ctx->pos++];
-			nib--, ofs++;
+	while (ctx->pos < 64 && ofs < length){
+		dst[ofs] = src[ofs] ^ ctx->keystream.u8[ctx->pos++];
+		ofs++;
+	}
+
+	size_t nblocks = (length - ofs) >> 6;
+	if (nblocks){
+		chacha_xor_blocks(ctx, &dst[ofs], &src[ofs], nblocks);
+		ofs += nblocks << 6;
+		ctx->pos = 64;
+	}
+
+	if (ofs < length){
+		chacha_block(ctx, ctx->keystream.u32);
+		while (ofs < length){
+			dst[ofs] = src[ofs] ^ ctx->keystream.u8[ctx->pos++];
+			ofs++;
 		}
 	}
 }
+
+static void chacha_apply(
+	struct chacha_ctx *ctx, uint8_t* buf, size_t length)
+{
+	chacha_apply_copy(ctx, buf, buf, length);
+}
@@ -43,6 +43,15 @@ struct a12helper_opts {
 
 /* opendir to populate with b64[checksum] for fonts and other cacheables */
 	int bcache_dir;
+
+/* a12cl_shmifsrv- specific: encode video on a worker thread rather than on
+ * the segment thread while holding the state, see a12_set_venc_worker.
+ * The value is the number of zstd band threads (0 = disabled) */
+	size_t venc_threads;
+
+/* a12cl_shmifsrv- specific: client audio is only forwarded with the method
+ * set to AFRAME_METHOD_OPUS, raw pcm costs too much to be on by default */
+	struct a12_aframe_opts aframe;
 };
 
 /*
@@ -161,6 +170,73 @@ int a12helper_a12srv_shmifcl(
 	struct arcan_shmif_cont* prealloc,
 	struct a12_state* S, const char* cp, int fd_in, int fd_out);
 
+/*
+ * a12srv_shmifcl- specific: when the connection is lost after the server has
+ * provided a session ticket, [reconnect] is called (with the state held) for
+ * a new one to continue on. It is expected to a12_resume the state with the
+ * ticket and authenticate before returning the descriptor, or return -1 to
+ * terminate as if it wasn't set.
+ */
+void a12helper_a12srv_shmifcl_reconnect(
+	int (*reconnect)(struct a12_state*, struct a12_ticket*, void* tag), void* tag);
+
+/*
+ * a12srv_shmifcl- specific: decode video on a worker with [threads] threads
+ * (see a12_set_vdec_worker), 0 (default) keeps it on the thread servicing
+ * the connection.
+ */
+void a12helper_a12srv_shmifcl_vdec(size_t threads);
+
+/*
+ * UDP carrier for the datagram transport (a12_datagram_ in a12.h) that the
+ * a12cl_shmifsrv and a12srv_shmifcl loops use when it has been negotiated.
+ * There is no locking here, call with the state held like for a12_unpack.
+ *
+ * init    - [stream_fd] is the socket the session runs over.
+ * step    - set up once ready, probe and send what is queued, call after
+ *           each round and at least every _timeout ms.
+ * read    - forward what has arrived on fd (when it polls readable).
+ * events  - the poll events to use for fd.
+ */
+struct a12helper_dgram {
+	int fd;
+	int stream_fd;
+	bool failed;
+	bool connected;
+	uint64_t probe_ts;
+	size_t pending_sz;
+	uint8_t pending[65536];
+	uint8_t inbuf[65536];
+};
+
+void a12helper_dgram_init(struct a12helper_dgram*, int stream_fd);
+void a12helper_dgram_step(struct a12_state*, struct a12helper_dgram*);
+void a12helper_dgram_read(struct a12_state*,
+	struct a12helper_dgram*, void* tag, void (*on_event)
+	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*));
+int a12helper_dgram_timeout(struct a12helper_dgram*);
+short a12helper_dgram_events(struct a12helper_dgram*);
+void a12helper_dgram_close(struct a12helper_dgram*);
+
+/*
+ * Share the shmif client [C] between any number of prenegotiated connections
+ * (see a12_relay in a12.h). A thread services the client and every attached
+ * connection until the client dies, video is encoded once for all, client
+ * events are broadcast and only input from the first attached connection is
+ * forwarded to the client. The relay takes ownership of [C].
+ *
+ * attach - hand over [S] and its socket [fd], returns false (with [S] and [fd]
+ *          still belonging to the caller) if the relay has shut down.
+ * alive  - false when the client has died and the relay should be freed.
+ * free   - wait for the relay thread to finish and release it.
+ */
+struct a12helper_relay;
+struct a12helper_relay* a12helper_relay_start(
+	struct shmifsrv_client* C, struct a12helper_opts opts);
+bool a12helper_relay_attach(struct a12helper_relay*, struct a12_state* S, int fd);
+bool a12helper_relay_alive(struct a12helper_relay*);
+void a12helper_relay_free(struct a12helper_relay*);
+
 uint8_t* a12helper_tob64(const uint8_t* data, size_t inl, size_t* outl);
 bool a12helper_fromb64(const uint8_t* instr, size_t lim, uint8_t outb[static 32]);
 
@@ -322,6 +322,52 @@ static void auth_handler(struct a12_state* S, void* tag)
 	spawn_thread(S, C->user, C, 0);
 }
 
+static struct {
+	int (*fptr)(struct a12_state*, struct a12_ticket*, void*);
+	void* tag;
+} reconnect;
+
+void a12helper_a12srv_shmifcl_reconnect(
+	int (*fptr)(struct a12_state*, struct a12_ticket*, void* tag), void* tag)
+{
+	reconnect.fptr = fptr;
+	reconnect.tag = tag;
+}
+
+static size_t vdec_threads;
+
+void a12helper_a12srv_shmifcl_vdec(size_t threads)
+{
+	vdec_threads = threads;
+}
+
+static void vdec_ready(struct a12_state* S, void* tag)
+{
+	int fd = (intptr_t) tag;
+	uint8_t ch = 0;
+	write(fd, &ch, 1);
+}
+
+/* with the state held, swap in a new connection if there is a ticket to
+ * resume with, otherwise -1 and the loop terminates like before */
+static int resume_connection(struct cl_state* cl, struct a12_state* S)
+{
+	struct a12_ticket ticket;
+	if (!reconnect.fptr || !a12_get_ticket(S, &ticket))
+		return -1;
+
+	int fd = -1;
+	BEGIN_CRITICAL(cl, "resume");
+		a12int_trace(A12_TRACE_SYSTEM, "kind=resume:status=reconnecting");
+		fd = reconnect.fptr(S, &ticket, reconnect.tag);
+		a12int_trace(A12_TRACE_SYSTEM, "kind=resume:fd=%d", fd);
+		if (-1 != fd)
+			a12_unpack(S, NULL, 0, NULL, on_cl_event);
+	END_CRITICAL(cl);
+
+	return fd;
+}
+
 int a12helper_a12srv_shmifcl(
 	struct arcan_shmif_cont* prealloc,
 	struct a12_state* S, const char* cp, int fd_in, int fd_out)
@@ -375,26 +421,51 @@ int a12helper_a12srv_shmifcl(
 		S->auth_tag = &cont;
 	}
 
+/* the decode worker gets a wakeup pipe of its own as the end of the other
+ * one closing is what tells that the primary segment is gone */
+	int vdec_pipe[2] = {-1, -1};
+	if (vdec_threads && -1 != pipe(vdec_pipe)){
+		fcntl(vdec_pipe[0], F_SETFL, O_NONBLOCK);
+		fcntl(vdec_pipe[1], F_SETFL, O_NONBLOCK);
+		if (!a12_set_vdec_worker(S,
+			vdec_threads, vdec_ready, (void*)(intptr_t) vdec_pipe[1])){
+			close(vdec_pipe[0]);
+			close(vdec_pipe[1]);
+			vdec_pipe[0] = vdec_pipe[1] = -1;
+		}
+	}
+
 /*
- * Socket in/out liveness, buffer flush / dispatch
+ * Socket in/out liveness, buffer flush / dispatch, out is only polled while
+ * there is something to write, then the datagram socket (if any) and the
+ * decode worker wakeup last
  */
-	size_t n_fd = 2;
 	static const short errmask = POLLERR | POLLNVAL | POLLHUP;
-	struct pollfd fds[3] = {
+	struct pollfd fds[5] = {
 		{.fd = fd_in,        .events = POLLIN  | errmask},
 		{.fd = pipe_pair[0], .events = POLLIN  | errmask},
-		{.fd = fd_out,       .events = POLLOUT | errmask}
+		{.fd = -1,           .events = POLLOUT | errmask},
+		{.fd = -1,           .events = POLLIN},
+		{.fd = vdec_pipe[0], .events = POLLIN}
 	};
 
+	static struct a12helper_dgram dgram;
+	a12helper_dgram_init(&dgram, fd_in);
+	int timeout = -1;
+
 /* flush any left overs from authentication */
 	a12_unpack(S, NULL, 0, NULL, on_cl_event);
 
-	while(a12_ok(S) && -1 != poll(fds, n_fd, -1)){
-		if (
-			(fds[0].revents & errmask) ||
-			(fds[1].revents & errmask) ||
-			(n_fd == 3 && fds[1].revents & errmask)){
+	while(a12_ok(S) &&
+		-1 != poll(fds, COUNT_OF(fds), timeout)){
+		if (fds[1].revents & errmask)
 			break;
+
+/* the carrier is gone, but the session might live on over a new one */
+		if ((fds[0].revents & errmask) || (fds[2].revents & errmask)){
+			if (-1 == (fd_in = fd_out = resume_connection(&cl, S)))
+				break;
+			goto resumed;
 		}
 
 	/* flush wakeup data from threads */
@@ -409,8 +480,16 @@ int a12helper_a12srv_shmifcl(
 			read(fds[1].fd, inbuf, 9000);
 		}
 
+/* decoded frames are signalled as part of unpacking */
+		if (fds[4].revents & POLLIN){
+			read(fds[4].fd, inbuf, 9000);
+			BEGIN_CRITICAL(&cl, "vdec-collect");
+				a12_unpack(S, NULL, 0, NULL, on_cl_event);
+			END_CRITICAL(&cl);
+		}
+
 /* pending out, flush or grab next out buffer */
-		if (n_fd == 3 && (fds[2].revents & POLLOUT) && outbuf_sz){
+		if ((fds[2].revents & POLLOUT) && outbuf_sz){
 			ssize_t nw = write(fd_out, outbuf, outbuf_sz);
 
 			if (a12_trace_targets & A12_TRACE_TRANSFER){
@@ -434,7 +513,9 @@ int a12helper_a12srv_shmifcl(
 				BEGIN_CRITICAL(&cl, "read-buffer");
 					a12int_trace(A12_TRACE_SYSTEM, "failed to read from input: %d", errno);
 				END_CRITICAL(&cl);
-				break;
+				if (-1 == (fd_in = fd_out = resume_connection(&cl, S)))
+					break;
+				goto resumed;
 			}
 /* we are not really interested in the 'half-open' scenario as the session is
  * interactive by defintion, so it is reasonably safe to just break here and
@@ -443,7 +524,9 @@ int a12helper_a12srv_shmifcl(
 				BEGIN_CRITICAL(&cl, "read-buffer");
 					a12int_trace(A12_TRACE_SYSTEM, "other side closed the connection");
 				END_CRITICAL(&cl);
-				break;
+				if (-1 == (fd_in = fd_out = resume_connection(&cl, S)))
+					break;
+				goto resumed;
 			}
 
 			BEGIN_CRITICAL(&cl, "unpack-buffer");
@@ -452,6 +535,24 @@ int a12helper_a12srv_shmifcl(
 			END_CRITICAL(&cl);
 		}
 
+/* datagrams in and out, anything this queues on the stream (refresh
+ * requests) goes with the flush below */
+		BEGIN_CRITICAL(&cl, "datagram");
+			if (fds[3].revents & POLLIN)
+				a12helper_dgram_read(S, &dgram, NULL, on_cl_event);
+			a12helper_dgram_step(S, &dgram);
+		END_CRITICAL(&cl);
+		fds[3].fd = dgram.fd;
+		fds[3].events = a12helper_dgram_events(&dgram);
+
+/* received opus audio plays out of a jitter buffer, wake up when it is due */
+		BEGIN_CRITICAL(&cl, "audio");
+			int audio_ms = a12_audio_step(S);
+		END_CRITICAL(&cl);
+		timeout = a12helper_dgram_timeout(&dgram);
+		if (audio_ms >= 0 && (timeout == -1 || audio_ms < timeout))
+			timeout = audio_ms;
+
 /* refill outgoing buffer if there is something left, better heuristics can be
  * applied here and set A12_FLUSH_CHONLY or NOBLOB depending on channel state */
 		if (!outbuf_sz){
@@ -461,7 +562,32 @@ int a12helper_a12srv_shmifcl(
 		}
 
 /* poll accordingly */
-		n_fd = outbuf_sz > 0 ? 3 : 2;
+		fds[2].fd = outbuf_sz > 0 ? fd_out : -1;
+		continue;
+
+/* what was left to write was keyed for the old connection */
+resumed:
+		a12helper_dgram_close(&dgram);
+		a12helper_dgram_init(&dgram, fd_in);
+		fds[0].fd = fd_in;
+		fds[3].fd = -1;
+		timeout = -1;
+
+		BEGIN_CRITICAL(&cl, "resume-buffer");
+			outbuf_sz = a12_flush(S, &outbuf, A12_FLUSH_ALL);
+		END_CRITICAL(&cl);
+		fds[2].fd = outbuf_sz > 0 ? fd_out : -1;
+	}
+
+	a12helper_dgram_close(&dgram);
+
+/* the worker might still be writing into a segment */
+	if (-1 != vdec_pipe[0]){
+		BEGIN_CRITICAL(&cl, "vdec-stop");
+			a12_set_vdec_worker(S, 0, NULL, NULL);
+		END_CRITICAL(&cl);
+		close(vdec_pipe[0]);
+		close(vdec_pipe[1]);
 	}
 
 /* things died before authenticating, drop the context */
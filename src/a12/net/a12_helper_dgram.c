@@ -0,0 +1,219 @@
+/*
+ * Copyright: Bjorn Stahl
+ * License: 3-Clause BSD
+ * Description: Datagram carrier for the a12_datagram_ set of functions, shared
+ * between the a12cl_shmifsrv and a12srv_shmifcl loops. The a12 server end of a
+ * session binds an UDP socket on the address of its stream socket and
+ * announces the port, the client end connects to that port on the address of
+ * the stream peer and keeps probing so that the server (and anything in
+ * between) learns where to send.
+ */
+#include <arcan_shmif.h>
+#include <arcan_shmif_server.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <poll.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "a12.h"
+#include "a12_int.h"
+#include "a12_helper.h"
+
+/* fits in the minimum IPv6 MTU with the IP and UDP headers */
+#define DGRAM_MTU 1200
+#define DGRAM_PROBE_MS 1000
+#define DGRAM_POLL_MS 100
+
+void a12helper_dgram_init(struct a12helper_dgram* D, int stream_fd)
+{
+	*D = (struct a12helper_dgram){
+		.fd = -1,
+		.stream_fd = stream_fd
+	};
+}
+
+static int dgram_socket(struct sockaddr_storage* addr, socklen_t len, bool bind_to)
+{
+	if (addr->ss_family != AF_INET && addr->ss_family != AF_INET6)
+		return -1;
+
+	int fd = socket(addr->ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (-1 == fd)
+		return -1;
+
+	int rv = bind_to ?
+		bind(fd, (struct sockaddr*) addr, len) :
+		connect(fd, (struct sockaddr*) addr, len);
+
+	if (-1 == rv){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=error:dgram_socket:%s", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void set_port(struct sockaddr_storage* addr, uint16_t port)
+{
+	if (addr->ss_family == AF_INET)
+		((struct sockaddr_in*) addr)->sin_port = htons(port);
+	else
+		((struct sockaddr_in6*) addr)->sin6_port = htons(port);
+}
+
+static uint16_t get_port(struct sockaddr_storage* addr)
+{
+	if (addr->ss_family == AF_INET)
+		return ntohs(((struct sockaddr_in*) addr)->sin_port);
+	return ntohs(((struct sockaddr_in6*) addr)->sin6_port);
+}
+
+/*
+ * server: bind next to the stream socket and announce
+ * client: wait for the announcement and connect to the peer
+ */
+static void dgram_setup(struct a12_state* S, struct a12helper_dgram* D)
+{
+	struct sockaddr_storage addr;
+	socklen_t len = sizeof(addr);
+
+	if (S->server){
+		if (-1 == getsockname(D->stream_fd, (struct sockaddr*) &addr, &len)){
+			D->failed = true;
+			return;
+		}
+
+		set_port(&addr, 0);
+		D->fd = dgram_socket(&addr, len, true);
+		len = sizeof(addr);
+		if (-1 == D->fd || -1 == getsockname(D->fd, (struct sockaddr*) &addr, &len)){
+			D->failed = true;
+			return;
+		}
+
+		a12_datagram_announce(S, get_port(&addr));
+		a12int_trace(A12_TRACE_SYSTEM, "kind=dgram:bound=%"PRIu16, get_port(&addr));
+		return;
+	}
+
+	uint16_t port = a12_datagram_port(S);
+	if (!port)
+		return;
+
+	if (-1 == getpeername(D->stream_fd, (struct sockaddr*) &addr, &len)){
+		D->failed = true;
+		return;
+	}
+
+	set_port(&addr, port);
+	D->fd = dgram_socket(&addr, len, false);
+	if (-1 == D->fd){
+		D->failed = true;
+		return;
+	}
+
+	D->connected = true;
+	a12_datagram_enable(S, DGRAM_MTU);
+	a12int_trace(A12_TRACE_SYSTEM, "kind=dgram:connected=%"PRIu16, port);
+}
+
+void a12helper_dgram_step(struct a12_state* S, struct a12helper_dgram* D)
+{
+	if (D->failed || !a12_datagram_ready(S))
+		return;
+
+	if (-1 == D->fd){
+		dgram_setup(S, D);
+		if (-1 == D->fd)
+			return;
+	}
+
+	if (!S->server){
+		uint64_t now = arcan_timemillis();
+		if (now - D->probe_ts >= DGRAM_PROBE_MS){
+			a12_datagram_probe(S);
+			D->probe_ts = now;
+		}
+	}
+
+/* what couldn't be sent last time goes first, the rest can be dropped on
+ * errors as there is no difference between that and being lost on the way */
+	if (D->pending_sz){
+		if (-1 == send(D->fd, D->pending, D->pending_sz, 0) &&
+			(errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		D->pending_sz = 0;
+	}
+
+	if (!D->connected)
+		return;
+
+	uint8_t* buf;
+	size_t n;
+	while ((n = a12_datagram_flush(S, &buf))){
+		if (-1 != send(D->fd, buf, n, 0))
+			continue;
+
+		if (errno == EAGAIN || errno == EWOULDBLOCK){
+			memcpy(D->pending, buf, n);
+			D->pending_sz = n;
+			return;
+		}
+	}
+}
+
+void a12helper_dgram_read(struct a12_state* S,
+	struct a12helper_dgram* D, void* tag, void (*on_event)
+	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*))
+{
+	if (-1 == D->fd)
+		return;
+
+	for(;;){
+		struct sockaddr_storage addr;
+		socklen_t len = sizeof(addr);
+		ssize_t nr = recvfrom(D->fd,
+			D->inbuf, sizeof(D->inbuf), 0, (struct sockaddr*) &addr, &len);
+
+		if (nr < 0){
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+
+		if (!a12_datagram_unpack(S, D->inbuf, nr, tag, on_event) || D->connected)
+			continue;
+
+/* the first authentic datagram tells where the other end is */
+		if (-1 == connect(D->fd, (struct sockaddr*) &addr, len)){
+			a12int_trace(A12_TRACE_SYSTEM, "kind=error:dgram_connect:%s", strerror(errno));
+			continue;
+		}
+
+		D->connected = true;
+		a12_datagram_enable(S, DGRAM_MTU);
+		a12int_trace(A12_TRACE_SYSTEM, "kind=dgram:peer=%"PRIu16, get_port(&addr));
+	}
+}
+
+int a12helper_dgram_timeout(struct a12helper_dgram* D)
+{
+	return -1 == D->fd ? -1 : DGRAM_POLL_MS;
+}
+
+short a12helper_dgram_events(struct a12helper_dgram* D)
+{
+	return POLLIN | (D->pending_sz ? POLLOUT : 0);
+}
+
+void a12helper_dgram_close(struct a12helper_dgram* D)
+{
+	if (-1 != D->fd)
+		close(D->fd);
+	D->fd = -1;
+}
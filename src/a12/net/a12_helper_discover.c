@@ -27,7 +27,26 @@
 #include "anet_helper.h"
 #include "hashmap.h"
 
+/*
+ * Sources send their beacon pair every few seconds, a pair that has been
+ * verified and reported is remembered for a while so that repeats with the
+ * same keyset size are dropped before hashing / keystore scanning and the
+ * consumer isn't told about the same source over and over. Half pairs that
+ * never complete are expired so that noise on the segment doesn't accumulate.
+ */
+#define BEACON_PAIR_TIMEOUT 5000
+#define BEACON_REPORT_TTL 60000
+#define BEACON_TRACK_LIMIT 256
+#define BEACON_SWEEP_MS 1000
+
 static struct hashmap_s known_beacons;
+static struct hashmap_s reported_beacons;
+
+struct reported {
+	char src[INET6_ADDRSTRLEN];
+	size_t len;
+	uint64_t ts;
+};
 
 /* missing - for DDoS protection we'd also want a bloom filter of challenges
  * and discard ones we have already seen */
@@ -45,6 +64,7 @@ struct beacon {
 		uint64_t ts;
 	} slot[2];
 	char* tag;
+	char src[INET6_ADDRSTRLEN]; /* hashmap key, needs to outlive the entry */
 };
 
 static ssize_t
@@ -176,6 +196,51 @@ struct keystore_mask*
 	return cur;
 }
 
+static int expire_beacon(void* const tag, struct hashmap_element_s* const e)
+{
+	uint64_t now = *(uint64_t*) tag;
+	struct beacon* bcn = e->data;
+
+	if (now - bcn->slot[0].ts < BEACON_PAIR_TIMEOUT)
+		return 0;
+
+	free(bcn->tag);
+	free(bcn);
+	return -1;
+}
+
+static int expire_reported(void* const tag, struct hashmap_element_s* const e)
+{
+	uint64_t now = *(uint64_t*) tag;
+	struct reported* rep = e->data;
+
+	if (now - rep->ts < BEACON_REPORT_TTL)
+		return 0;
+
+	free(rep);
+	return -1;
+}
+
+static void mark_reported(const char* name, size_t nlen, size_t len)
+{
+	struct reported* rep = hashmap_get(&reported_beacons, name, nlen);
+	if (!rep){
+		if (hashmap_num_entries(&reported_beacons) >= BEACON_TRACK_LIMIT)
+			return;
+
+		rep = malloc(sizeof(struct reported));
+		if (!rep)
+			return;
+
+		*rep = (struct reported){0};
+		snprintf(rep->src, sizeof(rep->src), "%s", name);
+		hashmap_put(&reported_beacons, rep->src, nlen, rep);
+	}
+
+	rep->len = len;
+	rep->ts = arcan_timemillis();
+}
+
 void
 	a12helper_listen_beacon(
 		struct arcan_shmif_cont* C, int sock,
@@ -186,7 +251,9 @@ void
 			const char*, char* addr),
 		bool (*on_shmif)(struct arcan_shmif_cont* C))
 {
-	hashmap_create(256, &known_beacons);
+	hashmap_create(BEACON_TRACK_LIMIT, &known_beacons);
+	hashmap_create(BEACON_TRACK_LIMIT, &reported_beacons);
+	uint64_t last_sweep = arcan_timemillis();
 
 	for(;;){
 		uint8_t mtu[9000];
@@ -201,12 +268,19 @@ void
 			},
 		};
 
-		if (-1 == poll(ps, 2, -1)){
-			if (errno != EINTR)
+		if (-1 == poll(ps, 2, BEACON_SWEEP_MS)){
+			if (errno == EINTR || errno == EAGAIN)
 				continue;
 			break;
 		}
 
+		uint64_t now = arcan_timemillis();
+		if (now - last_sweep >= BEACON_SWEEP_MS){
+			hashmap_iterate_pairs(&known_beacons, expire_beacon, &now);
+			hashmap_iterate_pairs(&reported_beacons, expire_reported, &now);
+			last_sweep = now;
+		}
+
 		if (ps[0].revents){
 			struct sockaddr_in caddr;
 			socklen_t len = sizeof(caddr);
@@ -228,12 +302,26 @@ void
 				size_t nlen = strlen(name);
 				struct beacon* bcn = hashmap_get(&known_beacons, name, nlen);
 
-/* no previous known beacon, store and remember */
+/* no previous known beacon, store and remember - unless the same source has
+ * been reported recently with the same keyset and there is nothing new */
 				if (!bcn){
+					struct reported* rep = hashmap_get(&reported_beacons, name, nlen);
+					if (rep && rep->len == nr - 16 && now - rep->ts < BEACON_REPORT_TTL)
+						continue;
+
+					if (hashmap_num_entries(&known_beacons) >= BEACON_TRACK_LIMIT){
+						a12int_trace(A12_TRACE_DIRECTORY, "beacon_drop:source=%s", name);
+						continue;
+					}
+
 					const char* err;
 					struct beacon* new_bcn = malloc(sizeof(struct beacon));
+					if (!new_bcn)
+						continue;
+
 					*new_bcn = (struct beacon){0};
-					hashmap_put(&known_beacons, name, nlen, new_bcn);
+					snprintf(new_bcn->src, sizeof(new_bcn->src), "%s", name);
+					hashmap_put(&known_beacons, new_bcn->src, nlen, new_bcn);
 					unpack_beacon(new_bcn, 0, mtu, nr, &err);
 				}
 
@@ -279,11 +367,12 @@ void
 								&bcn->slot[0].unpack.keys[i], bcn->slot[0].unpack.chg,
 								on_beacon, C, name);
 						}
+						mark_reported(name, nlen, bcn->slot[0].len);
 					}
 
+					hashmap_remove(&known_beacons, name, nlen);
 					free(bcn->tag);
 					free(bcn);
-					hashmap_remove(&known_beacons, name, nlen);
 				}
 			}
 		}
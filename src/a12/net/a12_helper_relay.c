@@ -0,0 +1,350 @@
+/*
+ * Copyright: Bjorn Stahl
+ * License: 3-Clause BSD
+ * Description: Relay loop for sharing one local shmif client with several
+ * incoming a12 connections (arcan-net --relay). Video is encoded once through
+ * an a12_relay and copied into each connection, events from the client go to
+ * all of them while only the first connection gets to provide input. Audio,
+ * subsegments and binary transfers are not relayed.
+ */
+#include <arcan_shmif.h>
+#include <arcan_shmif_server.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <pthread.h>
+
+#include "a12.h"
+#include "a12_int.h"
+#include "a12_helper.h"
+
+#define RELAY_POLL_MS 4
+
+struct relay_viewer {
+	struct a12_state* S;
+	struct arcan_shmif_cont fake;
+	struct a12helper_relay* R;
+	uint8_t* outbuf;
+	size_t outbuf_sz;
+	int fd;
+	bool dead;
+};
+
+struct a12helper_relay {
+	struct shmifsrv_client* C;
+	struct a12helper_opts opts;
+	struct a12_relay* relay;
+	pthread_t thread;
+
+/* accepted connections wait here until the relay thread picks them up */
+	pthread_mutex_t lock;
+	int wake[2];
+	bool dead;
+	struct relay_viewer* pending[A12_RELAY_VIEWERS];
+	size_t n_pending;
+
+	struct relay_viewer* viewers[A12_RELAY_VIEWERS];
+	size_t n_viewers;
+};
+
+static void drop_viewer(struct relay_viewer* V)
+{
+	if (V->R)
+		a12_relay_detach(V->R->relay, V->S);
+
+	a12_set_channel(V->S, 0);
+	a12_channel_close(V->S);
+	if (!a12_free(V->S))
+		a12int_trace(A12_TRACE_ALLOC, "kind=error:relay_viewer_free");
+
+	shutdown(V->fd, SHUT_RDWR);
+	close(V->fd);
+	free(V);
+}
+
+static void on_viewer_event(
+	struct arcan_shmif_cont* cont, int chid, struct arcan_event* ev, void* tag)
+{
+	struct relay_viewer* V = tag;
+	struct a12helper_relay* R = V->R;
+
+/* any more than one viewer steering the client would just fight */
+	if (R->viewers[0] != V || chid != 0 || arcan_shmif_descrevent(ev) ||
+		(ev->category == EVENT_TARGET && ev->tgt.kind == TARGET_COMMAND_NEWSEGMENT)){
+		a12int_trace(A12_TRACE_EVENT,
+			"kind=relay_ignore:eventstr=%s", arcan_shmif_eventstr(ev, NULL, 0));
+		return;
+	}
+
+	shmifsrv_enqueue_event(R->C, ev, -1);
+}
+
+static void drop_audio(shmif_asample* buf,
+	size_t n_samples, unsigned channels, unsigned rate, void* tag)
+{
+}
+
+static void adopt_pending(struct a12helper_relay* R)
+{
+	pthread_mutex_lock(&R->lock);
+	for (size_t i = 0; i < R->n_pending; i++){
+		struct relay_viewer* V = R->pending[i];
+
+		a12_set_channel(V->S, 0);
+		if (R->n_viewers == A12_RELAY_VIEWERS || !a12_relay_attach(R->relay, V->S)){
+			a12int_trace(A12_TRACE_SYSTEM, "kind=error:relay_full");
+			V->R = NULL;
+			drop_viewer(V);
+			continue;
+		}
+
+		R->viewers[R->n_viewers++] = V;
+
+/* flush authentication leftovers */
+		a12_unpack(V->S, NULL, 0, V, on_viewer_event);
+		a12int_trace(A12_TRACE_SYSTEM, "kind=relay_attach:viewers=%zu", R->n_viewers);
+	}
+	R->n_pending = 0;
+	pthread_mutex_unlock(&R->lock);
+}
+
+static void service_viewer(struct relay_viewer* V, short revents)
+{
+	static const short errmask = POLLERR | POLLNVAL | POLLHUP;
+	if (revents & errmask){
+		V->dead = true;
+		return;
+	}
+
+	if (revents & POLLIN){
+		uint8_t inbuf[9000];
+		ssize_t nr = recv(V->fd, inbuf, sizeof(inbuf), MSG_DONTWAIT);
+		if (nr == 0 ||
+			(-1 == nr && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)){
+			V->dead = true;
+			return;
+		}
+
+		if (nr > 0)
+			a12_unpack(V->S, inbuf, nr, V, on_viewer_event);
+	}
+
+/* write as much as the socket takes, what is left stays queued in the state
+ * and counts towards the backpressure the relay drops frames on */
+	for(;;){
+		if (!V->outbuf_sz && !(V->outbuf_sz = a12_flush(V->S, &V->outbuf, 0)))
+			break;
+
+		ssize_t nw = send(V->fd, V->outbuf, V->outbuf_sz, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (-1 == nw){
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				V->dead = true;
+			break;
+		}
+
+		V->outbuf += nw;
+		V->outbuf_sz -= nw;
+	}
+
+	if (!a12_ok(V->S))
+		V->dead = true;
+}
+
+static void* relay_thread(void* tag)
+{
+	struct a12helper_relay* R = tag;
+	static const short errmask = POLLERR | POLLNVAL | POLLHUP;
+	struct pollfd pfd[2 + A12_RELAY_VIEWERS];
+
+	for(;;){
+		pfd[0] = (struct pollfd){
+			.fd = shmifsrv_client_handle(R->C), .events = POLLIN | errmask};
+		pfd[1] = (struct pollfd){.fd = R->wake[0], .events = POLLIN};
+
+		for (size_t i = 0; i < R->n_viewers; i++){
+			pfd[2 + i] = (struct pollfd){
+				.fd = R->viewers[i]->fd,
+				.events = POLLIN | errmask | (R->viewers[i]->outbuf_sz ? POLLOUT : 0)
+			};
+		}
+
+/* no signal for when the client has a new frame, so stick to a short step */
+		if (-1 == poll(pfd, 2 + R->n_viewers, RELAY_POLL_MS) &&
+			errno != EAGAIN && errno != EINTR){
+			a12int_trace(A12_TRACE_SYSTEM,
+				"kind=error:status=EPOLL:message=%s", strerror(errno));
+			break;
+		}
+
+		if (pfd[0].revents & errmask)
+			break;
+
+		if (pfd[1].revents & POLLIN){
+			uint8_t buf[64];
+			read(R->wake[0], buf, sizeof(buf));
+		}
+
+		size_t n_polled = R->n_viewers;
+		adopt_pending(R);
+
+		struct arcan_event ev;
+		while (shmifsrv_dequeue_events(R->C, &ev, 1)){
+			if (arcan_shmif_descrevent(&ev) || shmifsrv_process_event(R->C, &ev))
+				continue;
+
+			for (size_t i = 0; i < R->n_viewers; i++){
+				a12_set_channel(R->viewers[i]->S, 0);
+				a12_channel_enqueue(R->viewers[i]->S, &ev);
+			}
+		}
+
+		int pv;
+		while ((pv = shmifsrv_poll(R->C)) != CLIENT_NOT_READY && pv != CLIENT_IDLE){
+			if (pv == CLIENT_DEAD){
+				a12int_trace(A12_TRACE_EVENT, "client=dead");
+				goto out;
+			}
+
+			if (pv & CLIENT_VBUFFER_READY){
+				struct shmifsrv_vbuffer vb = shmifsrv_video(R->C);
+				if (R->n_viewers){
+					struct a12_vframe_opts opts = {.method = VFRAME_METHOD_DZSTD};
+					if (R->opts.eval_vcodec)
+						opts = R->opts.eval_vcodec(R->viewers[0]->S,
+							shmifsrv_client_type(R->C), &vb, R->opts.tag);
+					a12_relay_vframe(R->relay, &vb, opts);
+				}
+				shmifsrv_video_step(R->C);
+			}
+
+			if (pv & CLIENT_ABUFFER_READY)
+				shmifsrv_audio(R->C, drop_audio, NULL);
+		}
+
+/* viewers adopted this round weren't polled, but still get their output */
+		for (size_t i = 0; i < R->n_viewers; i++)
+			service_viewer(R->viewers[i], i < n_polled ? pfd[2 + i].revents : 0);
+
+		for (size_t i = 0; i < R->n_viewers;){
+			if (!R->viewers[i]->dead){
+				i++;
+				continue;
+			}
+
+			drop_viewer(R->viewers[i]);
+			memmove(&R->viewers[i], &R->viewers[i + 1],
+				(R->n_viewers - i - 1) * sizeof(struct relay_viewer*));
+			R->n_viewers--;
+			a12int_trace(A12_TRACE_SYSTEM, "kind=relay_detach:viewers=%zu", R->n_viewers);
+		}
+	}
+
+out:
+	pthread_mutex_lock(&R->lock);
+	R->dead = true;
+	pthread_mutex_unlock(&R->lock);
+	adopt_pending(R);
+
+	for (size_t i = 0; i < R->n_viewers; i++)
+		drop_viewer(R->viewers[i]);
+	R->n_viewers = 0;
+
+	a12_relay_free(R->relay);
+	R->relay = NULL;
+	shmifsrv_free(R->C, SHMIFSRV_FREE_NO_DMS);
+	R->C = NULL;
+
+	return NULL;
+}
+
+struct a12helper_relay* a12helper_relay_start(
+	struct shmifsrv_client* C, struct a12helper_opts opts)
+{
+	struct a12helper_relay* R = malloc(sizeof(struct a12helper_relay));
+	if (!R)
+		return NULL;
+
+	*R = (struct a12helper_relay){
+		.C = C,
+		.opts = opts
+	};
+
+	if (-1 == pipe(R->wake)){
+		free(R);
+		return NULL;
+	}
+
+	if (!(R->relay = a12_relay_create())){
+		close(R->wake[0]);
+		close(R->wake[1]);
+		free(R);
+		return NULL;
+	}
+
+	pthread_mutex_init(&R->lock, NULL);
+	if (0 != pthread_create(&R->thread, NULL, relay_thread, R)){
+		pthread_mutex_destroy(&R->lock);
+		a12_relay_free(R->relay);
+		close(R->wake[0]);
+		close(R->wake[1]);
+		free(R);
+		return NULL;
+	}
+
+	return R;
+}
+
+bool a12helper_relay_attach(struct a12helper_relay* R, struct a12_state* S, int fd)
+{
+	struct relay_viewer* V = malloc(sizeof(struct relay_viewer));
+	if (!V)
+		return false;
+
+	*V = (struct relay_viewer){
+		.S = S,
+		.R = R,
+		.fd = fd
+	};
+	a12_set_destination(S, &V->fake, 0);
+	V->fake.user = V;
+
+	pthread_mutex_lock(&R->lock);
+	if (R->dead || R->n_pending == A12_RELAY_VIEWERS){
+		pthread_mutex_unlock(&R->lock);
+		a12_set_channel(S, 0);
+		a12_channel_close(S);
+		free(V);
+		return false;
+	}
+
+	R->pending[R->n_pending++] = V;
+	pthread_mutex_unlock(&R->lock);
+
+	uint8_t ch = 0;
+	write(R->wake[1], &ch, 1);
+	return true;
+}
+
+bool a12helper_relay_alive(struct a12helper_relay* R)
+{
+	pthread_mutex_lock(&R->lock);
+	bool alive = !R->dead;
+	pthread_mutex_unlock(&R->lock);
+	return alive;
+}
+
+void a12helper_relay_free(struct a12helper_relay* R)
+{
+	if (!R)
+		return;
+
+	pthread_join(R->thread, NULL);
+	pthread_mutex_destroy(&R->lock);
+	close(R->wake[0]);
+	close(R->wake[1]);
+	free(R);
+}
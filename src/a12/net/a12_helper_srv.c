@@ -30,8 +30,10 @@ struct shmifsrv_thread_data {
 	struct a12helper_opts opts;
 
 	float font_sz;
-	int kill_fd;
 	uint8_t chid;
+
+/* pending or attached segment list, see segment_thread */
+	struct shmifsrv_thread_data* next;
 };
 
 /* [THREADING]
@@ -42,13 +44,29 @@ struct shmifsrv_thread_data {
  * The buffer-out is simply a way for the main feed thread to forward the current
  * pending buffer output
  *
+ * All the segments of the connection are served by one thread through a
+ * shmifsrv_reactor. New segments are created by the main thread (while
+ * unpacking) and queued on [pending], the segment thread attaches them to the
+ * reactor on its next pass. [wake_fd] is the write end of the pipe the main
+ * thread polls, closing it shuts the connection down.
 */
-static bool spawn_thread(struct shmifsrv_thread_data* inarg);
+static void queue_segment(struct shmifsrv_thread_data* inarg);
 static pthread_mutex_t giant_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static const char* last_lock;
 static _Atomic volatile size_t buffer_out = 0;
-static _Atomic volatile uint8_t n_segments;
+
+static struct {
+	struct shmifsrv_reactor* reactor;
+	struct shmifsrv_thread_data* pending;
+	struct shmifsrv_thread_data* active;
+	pthread_t thread;
+	_Atomic bool shutdown;
+	bool dirty;
+	int wake_fd;
+} segments = {
+	.wake_fd = -1
+};
 
 #define BEGIN_CRITICAL(X, Y) do{pthread_mutex_lock(X); last_lock = Y;} while(0);
 #define END_CRITICAL(X) do{pthread_mutex_unlock(X);} while(0);
@@ -76,7 +94,7 @@ static struct a12_vframe_opts vopts_from_segment(
 	}
 
 	return (struct a12_vframe_opts){
-		.method = VFRAME_METHOD_DZSTD,
+		.method = VFRAME_METHOD_ADAPTIVE,
 			.bias = VFRAME_BIAS_BALANCED
 	};
 }
@@ -418,15 +436,7 @@ static void on_srv_event(
  * the encoding dance */
 	new_data->fake.user = new_data;
 	a12_set_destination(data->S, &new_data->fake, new_data->chid);
-
-	if (!spawn_thread(new_data)){
-		a12int_trace(A12_TRACE_SYSTEM,
-			"kind=error:type=ENOTHRDMEM:src_ch=%d:dst_ch=%d", chid, ev->tgt.ioevs[0].iv);
-		free(new_data);
-		a12_set_channel(data->S, chid);
-		a12_channel_close(data->S);
-		return;
-	}
+	queue_segment(new_data);
 
 	a12int_trace(A12_TRACE_ALLOC,
 		"kind=new_channel:src_ch=%d:dst_ch=%d", chid, (int)new_data->chid);
@@ -435,219 +445,247 @@ static void on_srv_event(
 static void on_audio_cb(shmif_asample* buf,
 	size_t n_samples,  unsigned channels, unsigned rate, void* tag)
 {
-	return;
-	struct a12_state* S = tag;
-	a12_channel_aframe(S, buf, n_samples,
+	struct shmifsrv_thread_data* data = tag;
+	if (data->opts.aframe.method != AFRAME_METHOD_OPUS)
+		return;
+
+	a12_channel_aframe(data->S, buf, n_samples,
 		(struct a12_aframe_cfg){
 			.channels = channels,
 			.samplerate = rate
 		},
-		(struct a12_aframe_opts){
-			.method = AFRAME_METHOD_RAW
-		}
+		data->opts.aframe
 	);
 }
 
-static void* client_thread(void* inarg)
+/*
+ * [THREADING]
+ * The reactor callbacks all run from segment_thread with the lock held
+ */
+static void on_segment_event(
+	struct shmifsrv_client* C, struct arcan_event* evs, size_t n, void* tag)
 {
-	struct shmifsrv_thread_data* data = inarg;
-	static const short errmask = POLLERR | POLLNVAL | POLLHUP;
-	struct pollfd pfd[2] = {
-		{ .fd = shmifsrv_client_handle(data->C), .events = POLLIN | errmask },
-		{ .fd = data->kill_fd, errmask }
-	};
-
-/* enable encoded video passthrough */
-	shmifsrv_client_protomask(data->C, SHMIF_META_VENC);
-
-/* We don't have a monitorable trigger for inbound video/audio frames, so some
- * timeout is in order for the time being. It might be useful to add that kind
- * of signalling to shmif though */
-	size_t poll_step = 4;
-
-/* the ext-io thread might be sleeping waiting for input, when we finished
- * one pass/burst and know there is queued data to be sent, wake it up */
-	bool dirty = false;
-	redirect_exit(data->C, 4, data->opts.redirect_exit);
-
-	for(;;){
-		if (dirty){
-			write(data->kill_fd, &data->chid, 1);
-			dirty = false;
-		}
-
-		if (-1 == poll(pfd, 2, poll_step)){
-			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
-				a12int_trace(A12_TRACE_SYSTEM,
-					"kind=error:status=EPOLL:message=%s", strerror(errno));
-				break;
-			}
-		}
+	struct shmifsrv_thread_data* data = tag;
 
-/* kill socket or poll socket died */
-		if ((pfd[0].revents & errmask) || (pfd[1].revents & errmask)){
+	for (size_t i = 0; i < n; i++){
+		if (arcan_shmif_descrevent(&evs[i])){
 			a12int_trace(A12_TRACE_SYSTEM,
-				"kind=error:status=EBADFD:client=%d:killsig=%d", pfd[0].revents, pfd[1].revents);
-			break;
+				"kind=error:status=EINVAL:message=client->server descriptor event");
+			continue;
 		}
 
-		struct arcan_event ev;
-
-		while (shmifsrv_dequeue_events(data->C, &ev, 1)){
-			if (arcan_shmif_descrevent(&ev)){
-				a12int_trace(A12_TRACE_SYSTEM,
-					"kind=error:status=EINVAL:message=client->server descriptor event");
-				continue;
-			}
-
-/* server-consumed or should be forwarded? */
-			BEGIN_CRITICAL(&giant_lock, "client_event");
-				if (shmifsrv_process_event(data->C, &ev)){
-					a12int_trace(A12_TRACE_EVENT,
-						"kind=consumed:channel=%d:eventstr=%s",
-						data->chid, arcan_shmif_eventstr(&ev, NULL, 0)
-					);
-				}
-				else {
-					a12_set_channel(data->S, data->chid);
-					a12int_trace(A12_TRACE_EVENT, "kind=forward:channel=%d:eventstr=%s",
-						data->chid, arcan_shmif_eventstr(&ev, NULL, 0));
-					a12_channel_enqueue(data->S, &ev);
-					dirty = true;
-				}
-			END_CRITICAL(&giant_lock);
-		}
+		a12_set_channel(data->S, data->chid);
+		a12int_trace(A12_TRACE_EVENT, "kind=forward:channel=%d:eventstr=%s",
+			data->chid, arcan_shmif_eventstr(&evs[i], NULL, 0));
+		a12_channel_enqueue(data->S, &evs[i]);
+		segments.dirty = true;
+	}
+}
 
-		int pv;
-		while (
-			(pv = shmifsrv_poll(data->C)) !=
-				CLIENT_NOT_READY && pv != CLIENT_IDLE){
-/* Dead client, send the close message and that should cascade down the rest
- * and kill relevant sockets. */
-			if (pv == CLIENT_DEAD){
-				a12int_trace(A12_TRACE_EVENT, "client=dead");
-				goto out;
-			}
+/*
+ * Not stepping the buffer leaves it pending and the reactor reports it again
+ * on the next pass, that is how frames are deferred on congestion.
+ */
+static void on_segment_video(struct shmifsrv_client* C, void* tag)
+{
+	struct shmifsrv_thread_data* data = tag;
 
 /* the shared buffer_out marks if we should wait a bit before releasing the
  * client as to not keep oversaturating with incoming video frames, we could
  * threshold this to something more reasonable, or just have two congestion
  * levels, one for focused channel and one lower for the rest */
-			if (pv & CLIENT_VBUFFER_READY){
-				if (atomic_load(&buffer_out) > 0){
-					break;
-				}
+	if (atomic_load(&buffer_out) > 0)
+		return;
 
 /* check the congestion window - there are many more options for congestion
  * control here, and the tuning is not figured out. One venue would be to
  * track which channel has a segment with focus, and prioritise those higher. */
-				struct a12_iostat stat = a12_state_iostat(data->S);
-				struct shmifsrv_vbuffer vb = shmifsrv_video(data->C);
+	struct a12_iostat stat = a12_state_iostat(data->S);
+	struct shmifsrv_vbuffer vb = shmifsrv_video(data->C);
 
-				if (data->opts.vframe_block &&
-					stat.vframe_backpressure >= data->opts.vframe_soft_block){
+/* the encode worker is still busy, keep the frame for the next round */
+	if (stat.venc_busy){
+		a12int_trace(A12_TRACE_VDETAIL, "vbuffer=defer:venc_busy");
+		return;
+	}
+
+	if (data->opts.vframe_block &&
+		stat.vframe_backpressure >= data->opts.vframe_soft_block){
 
 /* the soft block caps at ~20% of buffer difs for large buffers, the other
  * option is to have aggregation and dirty rectangles here, then invalidate if
  * they accumulate to cover all */
-					size_t px_c = vb.w * vb.h;
-					size_t reg_c =
-						(vb.region.x2 - vb.region.x1) * (vb.region.y2 - vb.region.y1);
-					bool allow_soft = vb.flags.subregion &&
-						(reg_c < px_c) && ((float)reg_c / (float)px_c) <= 0.2;
-
-					if (stat.vframe_backpressure >= data->opts.vframe_block && !allow_soft){
-						a12int_trace(A12_TRACE_VDETAIL,
-							"vbuffer=defer:congestion=%zu:soft=%zu:limit=%zu",
-							stat.vframe_backpressure, data->opts.vframe_soft_block,
-							data->opts.vframe_block
-						);
-						break;
-					}
-				}
+		size_t px_c = vb.w * vb.h;
+		size_t reg_c =
+			(vb.region.x2 - vb.region.x1) * (vb.region.y2 - vb.region.y1);
+
+/* with a damage chain only the regions themselves will be sent */
+		if (vb.n_regions > 1){
+			reg_c = 0;
+			for (size_t i = 0; i < vb.n_regions; i++)
+				reg_c += (vb.regions[i].x2 - vb.regions[i].x1) *
+					(vb.regions[i].y2 - vb.regions[i].y1);
+		}
+		bool allow_soft = vb.flags.subregion &&
+			(reg_c < px_c) && ((float)reg_c / (float)px_c) <= 0.2;
+
+		if (stat.vframe_backpressure >= data->opts.vframe_block && !allow_soft){
+			a12int_trace(A12_TRACE_VDETAIL,
+				"vbuffer=defer:congestion=%zu:soft=%zu:limit=%zu",
+				stat.vframe_backpressure, data->opts.vframe_soft_block,
+				data->opts.vframe_block
+			);
+			return;
+		}
+	}
 
 /* two option, one is to map the dma-buf ourselves and do the readback, or with
  * streams map the stream and convert to h264 on gpu, but easiest now is to
  * just reject and let the caller do the readback. this is currently done by
  * default in shmifsrv.*/
-				BEGIN_CRITICAL(&giant_lock, "video-buffer");
-					a12_set_channel(data->S, data->chid);
+	a12_set_channel(data->S, data->chid);
 
 /* vopts_from_segment here lets the caller pick compression parameters (coarse),
  * including the special 'defer this frame until later' */
-					a12_channel_vframe(data->S, &vb, vopts_from_segment(data, vb));
-					dirty = true;
-				END_CRITICAL(&giant_lock);
-				stat = a12_state_iostat(data->S);
-				a12int_trace(A12_TRACE_VDETAIL,
-					"vbuffer=release:time_ms=%zu:time_ms_px=%.4f:congestion=%zu",
-					stat.ms_vframe, stat.ms_vframe_px,
-					stat.vframe_backpressure
-				);
+	a12_channel_vframe(data->S, &vb, vopts_from_segment(data, vb));
+	segments.dirty = true;
+
+	stat = a12_state_iostat(data->S);
+	a12int_trace(A12_TRACE_VDETAIL,
+		"vbuffer=release:time_ms=%zu:time_ms_px=%.4f:congestion=%zu",
+		stat.ms_vframe, stat.ms_vframe_px,
+		stat.vframe_backpressure
+	);
 
 /* the other part is to, after a certain while of VBUFFER_READY but not any
  * buffer- out space, track if any of our segments have focus, if so, inject it
  * anyhow (should help responsiveness), increase video compression time-
  * tradeoff and defer the step stage so the client gets that we are limited */
-				shmifsrv_video_step(data->C);
-			}
+	shmifsrv_video_step(data->C);
+}
 
 /* send audio anyway, as not all clients are providing audio and there is less
  * tricks that can be applied from the backpressured client, dynamic resampling
  * and heavier compression is an option here as well though */
-			if (pv & CLIENT_ABUFFER_READY){
-				a12int_trace(A12_TRACE_AUDIO, "audio-buffer");
-				BEGIN_CRITICAL(&giant_lock, "audio_buffer");
-					a12_set_channel(data->S, data->chid);
-					shmifsrv_audio(data->C, on_audio_cb, data->S);
-					dirty = true;
-				END_CRITICAL(&giant_lock);
-			}
-		}
+static void on_segment_audio(struct shmifsrv_client* C, void* tag)
+{
+	struct shmifsrv_thread_data* data = tag;
+	a12int_trace(A12_TRACE_AUDIO, "audio-buffer");
+	a12_set_channel(data->S, data->chid);
+	shmifsrv_audio(data->C, on_audio_cb, data);
+	segments.dirty = true;
+}
 
+static void segment_close(struct shmifsrv_thread_data* data)
+{
+	for (struct shmifsrv_thread_data** cur = &segments.active; *cur;
+		cur = &(*cur)->next){
+		if (*cur == data){
+			*cur = data->next;
+			break;
+		}
 	}
 
-out:
-	BEGIN_CRITICAL(&giant_lock, "client_death");
-		a12_set_channel(data->S, data->chid);
-		a12_channel_close(data->S);
-		write(data->kill_fd, &data->chid, 1);
-		a12int_trace(A12_TRACE_SYSTEM, "client died");
-	END_CRITICAL(&giant_lock);
-
-/* only shut-down everything on the primary- segment failure */
-	if (data->chid == 0 && data->kill_fd != -1)
-		close(data->kill_fd);
+	a12_set_channel(data->S, data->chid);
+	a12_channel_close(data->S);
+	segments.dirty = true;
+	a12int_trace(A12_TRACE_SYSTEM, "client died");
 
-/* don't kill the shmifsrv client session for the primary one */
+/* don't kill the shmifsrv client session for the primary one, only shut-down
+ * everything on the primary- segment failure. The primary data is owned by
+ * the main thread as it is the unpack tag. */
 	if (data->chid != 0){
-		shmifsrv_free(data->C, SHMIFSRV_FREE_NO_DMS);
+		shmifsrv_reactor_free(segments.reactor, data->C, SHMIFSRV_FREE_NO_DMS);
+		free(data);
 	}
+	else {
+		shmifsrv_reactor_remove(segments.reactor, data->C);
+		if (-1 != segments.wake_fd){
+			close(segments.wake_fd);
+			segments.wake_fd = -1;
+		}
+	}
+}
 
-	atomic_fetch_sub(&n_segments, 1);
+/* Dead client, send the close message and that should cascade down the rest
+ * and kill relevant sockets. */
+static void on_segment_dead(struct shmifsrv_client* C, void* tag)
+{
+	a12int_trace(A12_TRACE_EVENT, "client=dead");
+	segment_close(tag);
+}
 
-	free(inarg);
-	return NULL;
+static void attach_pending()
+{
+	while (segments.pending){
+		struct shmifsrv_thread_data* data = segments.pending;
+		segments.pending = data->next;
+
+/* enable encoded video passthrough */
+		shmifsrv_client_protomask(data->C, SHMIF_META_VENC);
+		redirect_exit(data->C, 4, data->opts.redirect_exit);
+
+		data->next = segments.active;
+		segments.active = data;
+
+		if (!shmifsrv_reactor_add(segments.reactor, data->C, data)){
+			a12int_trace(A12_TRACE_ALLOC,
+				"kind=error:type=ENOMEM:message=couldn't track segment:ch=%d",
+				(int) data->chid);
+			segment_close(data);
+		}
+	}
 }
 
-static bool spawn_thread(struct shmifsrv_thread_data* inarg)
+static void* segment_thread(void* inarg)
 {
-	pthread_t pth;
-	pthread_attr_t pthattr;
-	pthread_attr_init(&pthattr);
-	pthread_attr_setdetachstate(&pthattr, PTHREAD_CREATE_DETACHED);
-	atomic_fetch_add(&n_segments, 1);
-
-	if (-1 == pthread_create(&pth, &pthattr, client_thread, inarg)){
-		BEGIN_CRITICAL(&giant_lock, "cleanup-spawn");
-			atomic_fetch_sub(&n_segments, 1);
-			a12int_trace(A12_TRACE_ALLOC, "could not spawn thread");
-			free(inarg);
+/* We don't have a monitorable trigger for inbound video/audio frames, so some
+ * timeout is in order for the time being. The reactor itself is only run
+ * while holding the lock as the main thread enqueues into the same clients,
+ * so the wait happens outside of it. It might be useful to add that kind of
+ * signalling to shmif though */
+	static const int poll_step = 4;
+
+	BEGIN_CRITICAL(&giant_lock, "segment-reactor");
+	while (!atomic_load(&segments.shutdown)){
+		attach_pending();
+		shmifsrv_reactor_run(segments.reactor, 0);
+
+/* the ext-io thread might be sleeping waiting for input, when we finished
+ * one pass/burst and know there is queued data to be sent, wake it up */
+		if (segments.dirty && -1 != segments.wake_fd)
+			write(segments.wake_fd, &(uint8_t){0}, 1);
+		segments.dirty = false;
+
 		END_CRITICAL(&giant_lock);
-		return false;
+		poll(NULL, 0, poll_step);
+		BEGIN_CRITICAL(&giant_lock, "segment-reactor");
 	}
 
-	return true;
+/* connection is going down, close whatever channels are left */
+	attach_pending();
+	while (segments.active)
+		segment_close(segments.active);
+	END_CRITICAL(&giant_lock);
+
+	return NULL;
+}
+
+/*
+ * [THREADING]
+ * Called with the lock held (or before the segment thread exists)
+ */
+static void queue_segment(struct shmifsrv_thread_data* inarg)
+{
+	inarg->next = segments.pending;
+	segments.pending = inarg;
+}
+
+static void venc_ready(struct a12_state* S, void* tag)
+{
+	int fd = (intptr_t) tag;
+	uint8_t ch = 0;
+	write(fd, &ch, 1);
 }
 
 void a12helper_a12cl_shmifsrv(struct a12_state* S,
@@ -672,49 +710,86 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
  */
 	struct shmifsrv_thread_data* arg;
 	arg = malloc(sizeof(struct shmifsrv_thread_data));
-	if (!arg){
+	segments.reactor = shmifsrv_reactor_create((struct shmifsrv_reactor_cb){
+		.event = on_segment_event,
+		.video = on_segment_video,
+		.audio = on_segment_audio,
+		.dead = on_segment_dead
+	});
+
+	if (!arg || !segments.reactor){
+		shmifsrv_reactor_destroy(segments.reactor);
+		segments.reactor = NULL;
+		free(arg);
 		close(pipe_pair[0]);
 		close(pipe_pair[1]);
 		return;
 	}
 
-/*
- * the kill_fd will be shared among the other segments, so it is only
- * here where there is reason to clean it up like this
- */
 	*arg = (struct shmifsrv_thread_data){
 		.C = C,
 		.S = S,
-		.kill_fd = pipe_pair[1],
 		.opts = opts,
 		.chid = 0
 	};
-	if (!spawn_thread(arg)){
+
+/* the wake_fd is shared among the segments and closed with the primary one */
+	segments.wake_fd = pipe_pair[1];
+	segments.shutdown = false;
+	segments.dirty = false;
+	queue_segment(arg);
+
+	if (0 != pthread_create(&segments.thread, NULL, segment_thread, NULL)){
+		a12int_trace(A12_TRACE_ALLOC, "could not spawn thread");
+		shmifsrv_reactor_destroy(segments.reactor);
+		segments.reactor = NULL;
+		segments.pending = NULL;
+		segments.wake_fd = -1;
+		free(arg);
 		close(pipe_pair[0]);
 		close(pipe_pair[1]);
 		return;
 	}
 	fake.user = arg;
 
-/* Socket in/out liveness, buffer flush / dispatch */
-	size_t n_fd = 2;
+/* the encode worker gets its own end of the wakeup pipe as the one in arg
+ * goes away with the primary segment */
+	int venc_fd = -1;
+	if (opts.venc_threads && -1 != (venc_fd = dup(pipe_pair[1]))){
+		BEGIN_CRITICAL(&giant_lock, "venc-setup");
+		if (!a12_set_venc_worker(S,
+			opts.venc_threads, venc_ready, (void*)(intptr_t) venc_fd)){
+			close(venc_fd);
+			venc_fd = -1;
+		}
+		END_CRITICAL(&giant_lock);
+	}
+
+/* Socket in/out liveness, buffer flush / dispatch, out is only polled while
+ * there is something to write and the datagram socket (if any) last */
 	static const short errmask = POLLERR | POLLNVAL | POLLHUP;
-	struct pollfd fds[3] = {
+	struct pollfd fds[4] = {
 		{	.fd = fd_in, .events = POLLIN | errmask},
 		{ .fd = pipe_pair[0], .events = POLLIN | errmask},
-		{ .fd = fd_out, .events = POLLOUT | errmask}
+		{ .fd = -1, .events = POLLOUT | errmask},
+		{ .fd = -1, .events = POLLIN}
 	};
 
+	static struct a12helper_dgram dgram;
+	a12helper_dgram_init(&dgram, fd_in);
+	int timeout = -1;
+
 /* flush authentication leftovers */
 	a12_unpack(S, NULL, 0, arg, on_srv_event);
 
 	uint8_t inbuf[9000];
-	while(a12_ok(S) && -1 != poll(fds, n_fd, -1)){
+	while(a12_ok(S) &&
+		-1 != poll(fds, COUNT_OF(fds), timeout)){
 
 /* death by poll? */
 		if ((fds[0].revents & errmask) ||
 				(fds[1].revents & errmask) ||
-				(n_fd == 3 && (fds[2].revents & errmask))){
+				(fds[2].revents & errmask)){
 			break;
 		}
 
@@ -731,7 +806,7 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 		}
 
 /* pending out, flush or grab next out buffer */
-		if (n_fd == 3 && (fds[2].revents & POLLOUT) && outbuf_sz){
+		if ((fds[2].revents & POLLOUT) && outbuf_sz){
 			ssize_t nw = write(fd_out, outbuf, outbuf_sz);
 
 			if (a12_trace_targets & A12_TRACE_TRANSFER){
@@ -773,23 +848,59 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 			END_CRITICAL(&giant_lock);
 		}
 
+/* datagrams in and out, anything this queues on the stream (refresh
+ * requests) goes with the flush below */
+		BEGIN_CRITICAL(&giant_lock, "datagram");
+			if (fds[3].revents & POLLIN)
+				a12helper_dgram_read(S, &dgram, arg, on_srv_event);
+			a12helper_dgram_step(S, &dgram);
+		END_CRITICAL(&giant_lock);
+		fds[3].fd = dgram.fd;
+		fds[3].events = a12helper_dgram_events(&dgram);
+
+/* received opus audio plays out of a jitter buffer, wake up when it is due */
+		BEGIN_CRITICAL(&giant_lock, "audio");
+			int audio_ms = a12_audio_step(S);
+		END_CRITICAL(&giant_lock);
+		timeout = a12helper_dgram_timeout(&dgram);
+		if (audio_ms >= 0 && (timeout == -1 || audio_ms < timeout))
+			timeout = audio_ms;
+
 		if (!outbuf_sz){
 			BEGIN_CRITICAL(&giant_lock, "get-buffer");
 				outbuf_sz = a12_flush(S, &outbuf, 0);
 			END_CRITICAL(&giant_lock);
 		}
-		n_fd = outbuf_sz > 0 ? 3 : 2;
+		fds[2].fd = outbuf_sz > 0 ? fd_out : -1;
 	}
 
+	a12helper_dgram_close(&dgram);
+
 	if (opts.bcache_dir > 0)
 		close(opts.bcache_dir);
 
 	a12int_trace(A12_TRACE_SYSTEM, "(srv) shutting down connection");
+	if (venc_fd != -1){
+		BEGIN_CRITICAL(&giant_lock, "venc-shutdown");
+		a12_set_venc_worker(S, 0, NULL, NULL);
+		END_CRITICAL(&giant_lock);
+		close(venc_fd);
+	}
+	atomic_store(&segments.shutdown, true);
+	pthread_join(segments.thread, NULL);
+	shmifsrv_reactor_destroy(segments.reactor);
+	segments.reactor = NULL;
+
 	close(pipe_pair[0]);
-	while(atomic_load(&n_segments) > 0){}
+	if (-1 != segments.wake_fd){
+		close(segments.wake_fd);
+		segments.wake_fd = -1;
+	}
+
 	if (!a12_free(S)){
 		a12int_trace(A12_TRACE_ALLOC, "error cleaning up a12 context");
 	}
+	free(arg);
 
 /* only the primary segment left, we will try and migrate that one,
  * sending the DEVICE_NODE migrate event and performing a non-dms drop */
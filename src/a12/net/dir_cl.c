@@ -773,6 +773,10 @@ static void mark_xfer_complete(struct ioloop_shared* I, struct a12_bhandler_meta
 	}
 	else if (M.type == A12_BTYPE_BLOB){
 		cbt->appl_out_complete = true;
+		if (cbt->appl_partial[0]){
+			unlinkat(cbt->clopt->basedir, cbt->appl_partial, 0);
+			cbt->appl_partial[0] = '\0';
+		}
 	}
 
 /* still need to wait for the state block to finish */
@@ -903,13 +907,36 @@ struct a12_bhandler_res anet_directory_cl_bhandler(
 			cbt->clopt->basedir = open(cbt->clopt->basedir_path, O_DIRECTORY);
 		}
 
-		char filename[] = "appltemp-XXXXXX";
-		int appl_fd = mkstemp(filename);
+/* With a known checksum the download is named after it and kept if the
+ * transfer breaks, so that the next attempt can resume from it. */
+		static const uint8_t nullsum[16];
+		int appl_fd;
+
+		if (memcmp(M.checksum, nullsum, 16) != 0){
+			char* dst = cbt->appl_partial;
+			dst += sprintf(dst, ".appl-");
+			for (size_t i = 0; i < 16; i++)
+				dst += sprintf(dst, "%02"PRIx8, M.checksum[i]);
+			sprintf(dst, ".part");
+
+			appl_fd = openat(cbt->clopt->basedir,
+				cbt->appl_partial, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+			struct stat fs;
+			res.resume = -1 != appl_fd && 0 == fstat(appl_fd, &fs) && fs.st_size > 0;
+		}
+		else {
+			char filename[] = "appltemp-XXXXXX";
+			appl_fd = mkstemp(filename);
+			if (-1 != appl_fd)
+				unlink(filename);
+			cbt->appl_partial[0] = '\0';
+		}
+
 		if (-1 == appl_fd){
 			fprintf(stderr, "Couldn't create temporary appl- unpack store\n");
 			return res;
 		}
-		unlink(filename);
 
 		cbt->appl_out = fdopen(appl_fd, "rw");
 		res.flag = A12_BHANDLER_NEWFD;
@@ -929,6 +956,7 @@ struct a12_bhandler_res anet_directory_cl_bhandler(
 		else if (M.type == A12_BTYPE_BLOB){
 			fprintf(stderr, "appl download cancelled\n");
 			if (cbt->appl_out){
+				fclose(cbt->appl_out);
 				cbt->appl_out = NULL;
 				cbt->appl_out_complete = false;
 			}
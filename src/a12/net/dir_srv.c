@@ -35,6 +35,11 @@
 #include <stdatomic.h>
 #include <pthread.h>
 
+#ifdef __linux__
+#include <sched.h>
+#include <sys/inotify.h>
+#endif
+
 extern bool g_shutdown;
 
 struct dircl;
@@ -65,6 +70,44 @@ struct dircl {
 
 /* [UAF-risk] 1:1 for now - always check this when removing a dircl */
 	struct dircl* tunnel;
+
+/* queue link until the owning shard picks the client up */
+	struct dircl* shard_next;
+	bool activated;
+
+/* index clock of the last index or delta sent to the worker */
+	uint64_t dir_clock;
+};
+
+/* Clients are spread over a fixed set of shard threads (one per core unless
+ * set in anet_dirsrv_opts) where each steps all of its clients from a single
+ * poll loop, rather than each client getting a thread of its own. The worker
+ * processes that terminate the a12 connections are still one per client as
+ * that is what sandboxes them from each other. */
+#define SHARD_LIMIT 64
+#define SHARD_POLL_MS 25
+
+struct dirsrv_shard {
+	pthread_t pth;
+	pthread_mutex_t sync;
+	struct dircl* pending;
+	_Atomic size_t count;
+};
+
+static struct {
+	struct dirsrv_shard* set;
+	size_t count;
+} shards;
+
+/* Appl packages are written out once per version and that descriptor is then
+ * shared by every download of it. a12 reads file-backed streams with an offset
+ * of its own so parallel transfers from the same descriptor don't interfere. */
+struct appl_pkgfd {
+	uint16_t identifier;
+	const char* buf;
+	uint64_t buf_sz;
+	int fd;
+	struct appl_pkgfd* next;
 };
 
 static struct {
@@ -73,6 +116,14 @@ static struct {
 	volatile struct anet_dirsrv_opts* opts;
 	char* dirlist;
 	size_t dirlist_sz;
+	struct appl_pkgfd* packages;
+
+/* Every change to an appl stamps it with the next index clock value as its
+ * update_ts, a worker that has seen up to clock n only needs the entries
+ * newer than that. Removals and rescans can't be expressed as a delta and
+ * move full_clock, everyone behind it gets the whole index again. */
+	uint64_t clock;
+	uint64_t full_clock;
 } active_clients = {
 	.sync = PTHREAD_MUTEX_INITIALIZER
 };
@@ -150,22 +201,131 @@ static int buf_memfd(const char* buf, size_t buf_sz)
 	return out;
 }
 
+/* needs to be called with active_clients.sync held, for when the buffer of an
+ * appl is freed and the pointer could be reused by the next version */
+static void appl_pkgfd_drop(uint16_t identifier)
+{
+	struct appl_pkgfd** cur = &active_clients.packages;
+	while (*cur && (*cur)->identifier != identifier)
+		cur = &(*cur)->next;
+
+	if (!*cur)
+		return;
+
+	struct appl_pkgfd* dead = *cur;
+	*cur = dead->next;
+	close(dead->fd);
+	free(dead);
+}
+
+/* needs to be called with active_clients.sync held, returns a new descriptor
+ * for the caller to close */
+static int appl_pkgfd(volatile struct appl_meta* meta)
+{
+	struct appl_pkgfd** cur = &active_clients.packages;
+	while (*cur && (*cur)->identifier != meta->identifier)
+		cur = &(*cur)->next;
+
+	if (*cur && (*cur)->buf == meta->buf && (*cur)->buf_sz == meta->buf_sz)
+		return dup((*cur)->fd);
+
+	int fd = buf_memfd(meta->buf, meta->buf_sz);
+	if (-1 == fd)
+		return -1;
+
+	if (*cur){
+		close((*cur)->fd);
+	}
+	else {
+		*cur = malloc(sizeof(struct appl_pkgfd));
+		if (!*cur)
+			return fd;
+		**cur = (struct appl_pkgfd){
+			.identifier = meta->identifier
+		};
+	}
+
+	(*cur)->buf = meta->buf;
+	(*cur)->buf_sz = meta->buf_sz;
+	(*cur)->fd = fd;
+	return dup(fd);
+}
+
+/* needs to be called with active_clients.sync held, the timestamp part
+ * follows wall-clock time but never repeats or goes backwards */
+static uint64_t index_stamp()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	uint64_t now = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+	active_clients.clock = now > active_clients.clock ?
+		now : active_clients.clock + 1;
+
+	return active_clients.clock;
+}
+
+static void index_entry(FILE* dst, volatile struct appl_meta* cur)
+{
+	fprintf(dst,
+		"kind=appl:name=%s:id=%"PRIu16":size=%"PRIu64
+		":categories=%"PRIu16":hash=%"PRIx8
+		"%"PRIx8"%"PRIx8"%"PRIx8":timestamp=%"PRIu64":description=%s\n",
+		cur->appl.name, cur->identifier, cur->buf_sz, cur->categories,
+		cur->hash[0], cur->hash[1], cur->hash[2], cur->hash[3],
+		cur->update_ts,
+		cur->appl.short_descr
+	);
+}
+
+/* needs to be called with active_clients.sync held, sends only the entries
+ * that changed since the last time unless the worker is behind a removal */
 static void dirlist_to_worker(struct dircl* C)
 {
 	if (!active_clients.dirlist)
 		return;
 
-	int fd = buf_memfd(active_clients.dirlist, active_clients.dirlist_sz);
+	bool full = !C->dir_clock || C->dir_clock < active_clients.full_clock;
+	char* buf = active_clients.dirlist;
+	size_t buf_sz = active_clients.dirlist_sz;
+
+	if (!full){
+		FILE* delta = open_memstream(&buf, &buf_sz);
+		if (!delta)
+			return;
+
+		volatile struct appl_meta* cur = &active_clients.opts->dir;
+		while (cur){
+			if (cur->appl.name[0] && cur->update_ts > C->dir_clock)
+				index_entry(delta, cur);
+			cur = cur->next;
+		}
+		fclose(delta);
+	}
+
+	C->dir_clock = active_clients.clock;
+	if (!buf_sz){
+		if (!full)
+			free(buf);
+		return;
+	}
+
+	int fd = buf_memfd(buf, buf_sz);
+	if (!full)
+		free(buf);
+
 	if (-1 == fd)
 		return;
 
-	shmifsrv_enqueue_event(C->C,
-		&(struct arcan_event){
-			.category = EVENT_TARGET,
-			.tgt.kind = TARGET_COMMAND_BCHUNK_IN,
-			.tgt.ioevs[1].iv = active_clients.dirlist_sz,
-			.tgt.message = ".index"
-		}, fd);
+	struct arcan_event ev = {
+		.category = EVENT_TARGET,
+		.tgt.kind = TARGET_COMMAND_BCHUNK_IN,
+		.tgt.ioevs[1].iv = buf_sz
+	};
+	snprintf(ev.tgt.message,
+		COUNT_OF(ev.tgt.message), "%s", full ? ".index" : ".delta");
+
+	shmifsrv_enqueue_event(C->C, &ev, fd);
 
 	close(fd);
 }
@@ -361,7 +521,7 @@ volatile struct appl_meta* identifier_to_appl(
 	volatile struct appl_meta* cur = &active_clients.opts->dir;
 
 	while (cur){
-		if (cur->identifier == *mid){
+		if (cur->identifier == *mid && cur->appl.name[0]){
 			pthread_mutex_unlock(&active_clients.sync);
 			A12INT_DIRTRACE("dirsv:resolve_id:id=%s:applname=%s", id, cur->appl.name);
 			return cur;
@@ -524,6 +684,7 @@ static void handle_bchunk_completion(struct dircl* C, bool ok)
 			blake3_hasher_init(&hash);
 			blake3_hasher_update(&hash, dst, dst_sz);
 			blake3_hasher_finalize(&hash, (uint8_t*)cur->hash, 4);
+			cur->update_ts = index_stamp();
 
 /* need to unlock as shmifsrv set will lock again, it will take care of
  * rebuilding the index and notifying listeners though - identity action
@@ -584,7 +745,7 @@ static void handle_bchunk_req(struct dircl* C, char* ext, bool input)
 		switch (mtype){
 		case IDTYPE_APPL:
 			pthread_mutex_lock(&active_clients.sync);
-				resfd = buf_memfd(meta->buf, meta->buf_sz);
+				resfd = appl_pkgfd(meta);
 				ressz = meta->buf_sz;
 			pthread_mutex_unlock(&active_clients.sync);
 		break;
@@ -909,101 +1070,82 @@ make_random:
 	C->message_ofs = strlen(C->message_multipart);
 }
 
-static void* dircl_process(void* P)
+/* Returns false when the client is dead, revents comes from the poll on the
+ * client handle and ticks from the monotonic clock of the shard. */
+static bool dircl_step(struct dircl* C, short revents, int ticks)
 {
-	struct dircl* C = P;
-
-/* a 'fun' little side notice here is that there is a race in shmifsrv-
- * spawn child where the descriptor gets sent while the client is in a
- * forked state but not completed exec. */
-
-	shmifsrv_monotonic_rebase();
-	int pv = 25;
-	bool dead = false, activated = false;
-
-	while (!dead){
-		struct pollfd pfd = {
-			.fd = shmifsrv_client_handle(C->C),
-			.events = POLLIN | POLLERR | POLLHUP
-		};
-
-		if (poll(&pfd, 1, pv) > 0){
-			if (pfd.revents){
-				if (pfd.revents != POLLIN){
-					A12INT_DIRTRACE("dirsv:kind=worker:epipe");
-					break;
-				}
-				pv = 25;
-			}
-		}
+	if (revents && revents != POLLIN){
+		A12INT_DIRTRACE("dirsv:kind=worker:epipe");
+		return false;
+	}
 
-		int sv;
-		if ((sv = shmifsrv_poll(C->C)) == CLIENT_DEAD){
-			A12INT_DIRTRACE("dirsv:kind=worker:dead");
-			dead = true;
-			continue;
-		}
+	if (shmifsrv_poll(C->C) == CLIENT_DEAD){
+		A12INT_DIRTRACE("dirsv:kind=worker:dead");
+		return false;
+	}
 
 /* send the directory index as a bchunkstate, this lets us avoid abusing the
  *MESSAGE event as well as re-using the same codepaths for dynamically
  * updating the index later. */
-		if (!activated && shmifsrv_poll(C->C) == CLIENT_IDLE){
-			arcan_event ev = {
-				.category = EVENT_TARGET,
-				.tgt.kind = TARGET_COMMAND_MESSAGE
-			};
+	if (!C->activated && shmifsrv_poll(C->C) == CLIENT_IDLE){
+		arcan_event ev = {
+			.category = EVENT_TARGET,
+			.tgt.kind = TARGET_COMMAND_MESSAGE
+		};
 
-			if (active_clients.opts->a12_cfg->secret[0]){
-				snprintf(
-					(char*)ev.tgt.message, COUNT_OF(ev.tgt.message),
-					"secret=%s", active_clients.opts->a12_cfg->secret
-				);
+		if (active_clients.opts->a12_cfg->secret[0]){
+			snprintf(
+				(char*)ev.tgt.message, COUNT_OF(ev.tgt.message),
+				"secret=%s", active_clients.opts->a12_cfg->secret
+			);
 
 /* apply the \t is illegal, escapes : rule */
-				for (size_t i = 0; i < 32 && ev.tgt.message[i]; i++){
-					if (ev.tgt.message[i] == ':')
-						ev.tgt.message[i] = '\t';
-				}
-
-				shmifsrv_enqueue_event(C->C, &ev, -1);
+			for (size_t i = 0; i < 32 && ev.tgt.message[i]; i++){
+				if (ev.tgt.message[i] == ':')
+					ev.tgt.message[i] = '\t';
 			}
 
+			shmifsrv_enqueue_event(C->C, &ev, -1);
+		}
+
 /* the applindex need to be set when the worker constructs the state machine,
  * while as the list of dynamic sources happens after it is up and running */
+		pthread_mutex_lock(&active_clients.sync);
 			dirlist_to_worker(C);
-			ev.tgt.kind = TARGET_COMMAND_ACTIVATE;
-			shmifsrv_enqueue_event(C->C, &ev, -1);
-			activated = true;
-		}
+			C->activated = true;
+		pthread_mutex_unlock(&active_clients.sync);
+		ev.tgt.kind = TARGET_COMMAND_ACTIVATE;
+		shmifsrv_enqueue_event(C->C, &ev, -1);
+	}
 
-		struct arcan_event ev;
-		while (1 == shmifsrv_dequeue_events(C->C, &ev, 1)){
+	struct arcan_event ev;
+	while (1 == shmifsrv_dequeue_events(C->C, &ev, 1)){
 /* petName for a source/dir or for joining an appl */
-			if (ev.ext.kind == EVENT_EXTERNAL_IDENT){
-				A12INT_DIRTRACE("dirsv:kind=worker:cl_join=%s", (char*)ev.ext.message.data);
-				handle_ident(C, ev);
-			}
-			else if (ev.ext.kind == EVENT_EXTERNAL_NETSTATE){
-				handle_netstate(C, ev);
-			}
+		if (ev.ext.kind == EVENT_EXTERNAL_IDENT){
+			A12INT_DIRTRACE("dirsv:kind=worker:cl_join=%s", (char*)ev.ext.message.data);
+			handle_ident(C, ev);
+		}
+		else if (ev.ext.kind == EVENT_EXTERNAL_NETSTATE){
+			handle_netstate(C, ev);
+		}
 /* right now we permit the worker to fetch / update their state store of any
  * appl as the format is id[.resource]. The other option is to use IDENT to
  * explicitly enter an appl signalling that participation in networked activity
  * is desired. */
-			else if (ev.ext.kind == EVENT_EXTERNAL_BCHUNKSTATE){
-				handle_bchunk_req(C, (char*) ev.ext.bchunk.extensions, ev.ext.bchunk.input);
-			}
+		else if (ev.ext.kind == EVENT_EXTERNAL_BCHUNKSTATE){
+			handle_bchunk_req(C, (char*) ev.ext.bchunk.extensions, ev.ext.bchunk.input);
+		}
 
 /* bounce-back ack streamsatus */
-			else if (ev.ext.kind == EVENT_EXTERNAL_STREAMSTATUS){
-				shmifsrv_enqueue_event(C->C, &ev, -1);
-				if (C->pending_stream){
-					C->pending_stream = false;
-					handle_bchunk_completion(C, ev.ext.streamstat.completion >= 1.0);
-				}
-				else
-					A12INT_DIRTRACE("dirsv:kind=worker_error:status_no_pending");
+		else if (ev.ext.kind == EVENT_EXTERNAL_STREAMSTATUS){
+			shmifsrv_enqueue_event(C->C, &ev, -1);
+			if (C->pending_stream){
+				C->pending_stream = false;
+				handle_bchunk_completion(C, ev.ext.streamstat.completion >= 1.0);
 			}
+			else
+				A12INT_DIRTRACE("dirsv:kind=worker_error:status_no_pending");
+		}
 
 /* this is cheating a bit, SHMIF splits TARGET and EXTERNAL for (srv->cl), (cl->srv)
  * but by replaying like this we use EXTERNAL as (cl->srv->cl) */
@@ -1012,17 +1154,20 @@ static void* dircl_process(void* P)
  * keys on the initial connection. If the authentication goes through and IDENT
  * is used to 'join' an appl the MESSAGE facility should (TOFIX) become a broadcast
  * domain or wrapped through a Lua VM instance as the server end of the appl. */
-			else if (ev.ext.kind == EVENT_EXTERNAL_MESSAGE){
-				dircl_message(C, ev);
-			}
+		else if (ev.ext.kind == EVENT_EXTERNAL_MESSAGE){
+			dircl_message(C, ev);
 		}
+	}
 
-		int ticks = shmifsrv_monotonic_tick(NULL);
-		while (!dead && ticks--){
-			shmifsrv_tick(C->C);
-		}
+	while (ticks--){
+		shmifsrv_tick(C->C);
 	}
 
+	return true;
+}
+
+static void dircl_drop(struct dircl* C)
+{
 	pthread_mutex_lock(&active_clients.sync);
 
 		if (C->tunnel){
@@ -1061,10 +1206,102 @@ static void* dircl_process(void* P)
 	shmifsrv_free(C->C, true);
 	memset(C, 0xff, sizeof(struct dircl));
 	free(C);
+}
+
+
+/* a 'fun' little side notice here is that there is a race in shmifsrv-
+ * spawn child where the descriptor gets sent while the client is in a
+ * forked state but not completed exec. */
+static void* shard_process(void* P)
+{
+	struct dirsrv_shard* D = P;
+	struct dircl** set = NULL;
+	struct pollfd* pset = NULL;
+	size_t set_sz = 0, set_cap = 0;
+
+/* the tick counter is thread-local so each shard has its own timebase */
+	shmifsrv_monotonic_rebase();
+
+	for(;;){
+		pthread_mutex_lock(&D->sync);
+		while (D->pending){
+			if (set_sz == set_cap){
+				size_t new_cap = set_cap ? set_cap * 2 : 16;
+				struct dircl** new_set = realloc(set, new_cap * sizeof(struct dircl*));
+				if (!new_set)
+					break;
+				set = new_set;
+
+				struct pollfd* new_pset = realloc(pset, new_cap * sizeof(struct pollfd));
+				if (!new_pset)
+					break;
+				pset = new_pset;
+				set_cap = new_cap;
+			}
+			set[set_sz++] = D->pending;
+			D->pending = D->pending->shard_next;
+		}
+		pthread_mutex_unlock(&D->sync);
+
+		for (size_t i = 0; i < set_sz; i++){
+			pset[i] = (struct pollfd){
+				.fd = shmifsrv_client_handle(set[i]->C),
+				.events = POLLIN | POLLERR | POLLHUP
+			};
+		}
+
+		poll(pset, set_sz, SHARD_POLL_MS);
+		int ticks = shmifsrv_monotonic_tick(NULL);
+
+		for (size_t i = 0; i < set_sz;){
+			if (dircl_step(set[i], pset[i].revents, ticks)){
+				i++;
+				continue;
+			}
+
+			dircl_drop(set[i]);
+			set_sz--;
+			set[i] = set[set_sz];
+			pset[i] = pset[set_sz];
+			atomic_fetch_sub(&D->count, 1);
+		}
+	}
 
 	return NULL;
 }
 
+static bool shards_start()
+{
+	size_t count = active_clients.opts->shards;
+	if (!count){
+		long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+		count = n_cpu > 0 ? n_cpu : 1;
+	}
+	if (count > SHARD_LIMIT)
+		count = SHARD_LIMIT;
+
+	shards.set = malloc(sizeof(struct dirsrv_shard) * count);
+	if (!shards.set)
+		return false;
+
+	pthread_attr_t pthattr;
+	pthread_attr_init(&pthattr);
+	pthread_attr_setdetachstate(&pthattr, PTHREAD_CREATE_DETACHED);
+
+	for (size_t i = 0; i < count; i++){
+		shards.set[i] = (struct dirsrv_shard){
+			.sync = PTHREAD_MUTEX_INITIALIZER
+		};
+		if (0 != pthread_create(&shards.set[i].pth, &pthattr, shard_process, &shards.set[i]))
+			break;
+		shards.count++;
+	}
+
+	pthread_attr_destroy(&pthattr);
+	a12int_trace(A12_TRACE_DIRECTORY, "dirsv:kind=shards:count=%zu", shards.count);
+	return shards.count > 0;
+}
+
 /*
  * the index only contain active appls, dynamic sources are sent separately
  * as netstate discover / lost events and just forwarded.
@@ -1078,17 +1315,8 @@ static void rebuild_index()
 		&active_clients.dirlist, &active_clients.dirlist_sz);
 	volatile struct appl_meta* cur = &active_clients.opts->dir;
 	while (cur){
-		if (cur->appl.name[0]){
-			fprintf(dirlist,
-				"kind=appl:name=%s:id=%"PRIu16":size=%"PRIu64
-				":categories=%"PRIu16":hash=%"PRIx8
-				"%"PRIx8"%"PRIx8"%"PRIx8":timestamp=%"PRIu64":description=%s\n",
-				cur->appl.name, cur->identifier, cur->buf_sz, cur->categories,
-				cur->hash[0], cur->hash[1], cur->hash[2], cur->hash[3],
-				cur->update_ts,
-				cur->appl.short_descr
-			);
-		}
+		if (cur->appl.name[0])
+			index_entry(dirlist, cur);
 		cur = cur->next;
 	}
 
@@ -1104,16 +1332,16 @@ void anet_directory_shmifsrv_set(struct anet_dirsrv_opts* opts)
 	if (opts->dir.handle || opts->dir.buf){
 		rebuild_index();
 
-/* Note that DIRTRACE macro isn't used here as it locks the mutex. Setting the
- * directory again after the initial time (vs. individual entry updates with
- * broadcast) should be rare to never). An optimization here is to only send
- * a new dirlist to clients that have explicitly asked for notification. That
- * information is hidden in the a12_state in the dirsrv_worker. */
+/* Note that DIRTRACE macro isn't used here as it locks the mutex. Workers
+ * get a delta of what changed since their last index, clients that haven't
+ * been activated yet will get the full one on activation. */
 		if (!first){
-			a12int_trace(A12_TRACE_DIRECTORY, "list_updated");
-			struct dircl* cur = &active_clients.root;
+			a12int_trace(A12_TRACE_DIRECTORY,
+				"list_updated:clock=%"PRIu64, active_clients.clock);
+			struct dircl* cur = active_clients.root.next;
 			while (cur){
-				dirlist_to_worker(cur);
+				if (cur->activated)
+					dirlist_to_worker(cur);
 				cur = cur->next;
 			}
 		}
@@ -1124,16 +1352,17 @@ void anet_directory_shmifsrv_set(struct anet_dirsrv_opts* opts)
 	pthread_mutex_unlock(&active_clients.sync);
 }
 
-/* This is in the parent process, it acts as a 1:1 thread/process which
- * pools and routes. The other end of this shmif connection is in the
- * normal */
+/* This is in the parent process, the connection is handed to one of the
+ * shard threads which pools and routes. The other end of this shmif
+ * connection is in the normal */
 void anet_directory_shmifsrv_thread(
 	struct shmifsrv_client* cl, struct a12_state* S)
 {
-	pthread_t pth;
-	pthread_attr_t pthattr;
-	pthread_attr_init(&pthattr);
-	pthread_attr_setdetachstate(&pthattr, PTHREAD_CREATE_DETACHED);
+	if (!shards.count && !shards_start()){
+		a12int_trace(A12_TRACE_DIRECTORY, "dirsv:kind=error:no_shards");
+		shmifsrv_free(cl, SHMIFSRV_FREE_NO_DMS);
+		return;
+	}
 
 	struct dircl* newent = malloc(sizeof(struct dircl));
 	*newent = (struct dircl){
@@ -1166,7 +1395,19 @@ void anet_directory_shmifsrv_thread(
 		cur->next = newent;
 		newent->prev = cur;
 	pthread_mutex_unlock(&active_clients.sync);
-	pthread_create(&pth, &pthattr, dircl_process, newent);
+
+/* least loaded, the counts only shrink behind our back so this is safe */
+	struct dirsrv_shard* D = &shards.set[0];
+	for (size_t i = 1; i < shards.count; i++){
+		if (shards.set[i].count < D->count)
+			D = &shards.set[i];
+	}
+
+	atomic_fetch_add(&D->count, 1);
+	pthread_mutex_lock(&D->sync);
+		newent->shard_next = D->pending;
+		D->pending = newent;
+	pthread_mutex_unlock(&D->sync);
 }
 
 /* This part is much more PoC - we'd need a nicer cache / store (sqlite?) so
@@ -1192,6 +1433,7 @@ static size_t scan_appdir(int fd, struct appl_meta* dst)
  * more settled appl format to work from */
 		if (build_appl_pkg(ent->d_name, dst, fd)){
 			dst->identifier = count++;
+			dst->update_ts = index_stamp();
 			dst = dst->next;
 		}
 	}
@@ -1215,5 +1457,251 @@ void anet_directory_srv_rescan(struct anet_dirsrv_opts* opts)
 {
 	pthread_mutex_lock(&active_clients.sync);
 		opts->dir_count = scan_appdir(dup(opts->basedir), &opts->dir);
+		active_clients.full_clock = active_clients.clock;
 	pthread_mutex_unlock(&active_clients.sync);
 }
+
+/* Rebuild a single appl package, the build itself happens without the lock
+ * held. Existing entries keep their identifier, new ones get the next free
+ * and one that can't be built any more is marked as removed. */
+static void index_update(struct anet_dirsrv_opts* opts, const char* name)
+{
+	struct appl_meta new = {0};
+	bool ok = build_appl_pkg(name, &new, opts->basedir);
+	free(new.next);
+
+	pthread_mutex_lock(&active_clients.sync);
+	struct appl_meta* cur = &opts->dir;
+	while (cur->next && strcmp(cur->appl.name, name) != 0)
+		cur = cur->next;
+
+	bool found = strcmp(cur->appl.name, name) == 0;
+
+	if (!ok || (found && memcmp(cur->hash, new.hash, 4) == 0)){
+		free(new.buf);
+		if (!ok && found){
+			if (!cur->handle)
+				free(cur->buf);
+			appl_pkgfd_drop(cur->identifier);
+			cur->buf = NULL;
+			cur->buf_sz = 0;
+			cur->appl.name[0] = '\0';
+			active_clients.full_clock = index_stamp();
+			a12int_trace(A12_TRACE_DIRECTORY, "index:removed=%s", name);
+		}
+		pthread_mutex_unlock(&active_clients.sync);
+		return;
+	}
+
+/* the tail entry is always an empty placeholder, take that and add a new */
+	if (!found){
+		cur->identifier = opts->dir_count++;
+		cur->next = malloc(sizeof(struct appl_meta));
+		*(cur->next) = (struct appl_meta){0};
+		snprintf(cur->appl.name, COUNT_OF(cur->appl.name), "%s", name);
+	}
+	else {
+		if (!cur->handle)
+			free(cur->buf);
+		cur->handle = NULL;
+		appl_pkgfd_drop(cur->identifier);
+	}
+
+	cur->buf = new.buf;
+	cur->buf_sz = new.buf_sz;
+	memcpy(cur->hash, new.hash, 4);
+	cur->update_ts = index_stamp();
+
+	a12int_trace(A12_TRACE_DIRECTORY,
+		"index:updated=%s:id=%"PRIu16":clock=%"PRIu64,
+		name, cur->identifier, cur->update_ts);
+	pthread_mutex_unlock(&active_clients.sync);
+}
+
+#ifdef __linux__
+/* Instead of waiting for SIGUSR1 the basedir and every directory inside of it
+ * is watched. Events are collected until things have been quiet for a bit so
+ * that a checkout or copy doesn't rebuild an appl for every file, then only
+ * the touched appls are rebuilt and the index change pushed as a delta. */
+#define WATCH_LIMIT 1024
+#define WATCH_DIRTY_LIMIT 32
+#define WATCH_DEBOUNCE_MS 250
+
+static struct {
+	int fd;
+	const char* appl;
+	size_t count;
+	struct {
+		int wd;
+		char appl[18];
+	} set[WATCH_LIMIT];
+} watch;
+
+static int watch_add(const char* path, const struct stat* st, int type, struct FTW* ftw)
+{
+	if (type != FTW_D)
+		return 0;
+
+	if (ftw->level > 0 && path[ftw->base] == '.')
+		return FTW_SKIP_SUBTREE;
+
+	int wd = inotify_add_watch(watch.fd, path,
+		IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+		IN_ATTRIB | IN_ONLYDIR);
+	if (-1 == wd)
+		return 0;
+
+	for (size_t i = 0; i < watch.count; i++)
+		if (watch.set[i].wd == wd)
+			return 0;
+
+	if (watch.count == WATCH_LIMIT){
+		a12int_trace(A12_TRACE_DIRECTORY, "index:kind=error:watch_limit");
+		inotify_rm_watch(watch.fd, wd);
+		return FTW_STOP;
+	}
+
+	watch.set[watch.count].wd = wd;
+	snprintf(watch.set[watch.count].appl, 18, "%s", watch.appl);
+	watch.count++;
+	return 0;
+}
+
+static void watch_appl(const char* name)
+{
+	watch.appl = name;
+	nftw(name, watch_add, 16, FTW_PHYS | FTW_ACTIONRETVAL);
+}
+
+static void* index_watcher(void* tag)
+{
+	struct anet_dirsrv_opts* opts = tag;
+	char dirty[WATCH_DIRTY_LIMIT][18];
+	size_t n_dirty = 0;
+	bool rescan = false;
+
+/* the thread gets a working directory of its own as both building packages
+ * and the relative watch paths would otherwise chdir() the whole process */
+	if (-1 == unshare(CLONE_FS) || -1 == fchdir(opts->basedir)){
+		a12int_trace(A12_TRACE_DIRECTORY, "index:kind=error:watch_cwd");
+		return NULL;
+	}
+
+	watch.appl = "";
+	watch_add(".", NULL, FTW_D, &(struct FTW){0});
+
+	DIR* dir = fdopendir(dup(opts->basedir));
+	if (dir){
+		struct dirent* ent;
+		rewinddir(dir);
+		while ((ent = readdir(dir))){
+			if (ent->d_type == DT_DIR &&
+				ent->d_name[0] != '.' && strlen(ent->d_name) < 18)
+				watch_appl(ent->d_name);
+		}
+		closedir(dir);
+	}
+	a12int_trace(A12_TRACE_DIRECTORY, "index:watching=%zu", watch.count);
+
+	char evbuf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct pollfd pfd = {.fd = watch.fd, .events = POLLIN};
+
+	for(;;){
+		int rv = poll(&pfd, 1, n_dirty || rescan ? WATCH_DEBOUNCE_MS : -1);
+		if (-1 == rv){
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+/* quiet period over, rebuild what was touched and push the changes */
+		if (0 == rv){
+			if (rescan)
+				anet_directory_srv_rescan(opts);
+			else
+				for (size_t i = 0; i < n_dirty; i++)
+					index_update(opts, dirty[i]);
+
+			anet_directory_shmifsrv_set(opts);
+			n_dirty = 0;
+			rescan = false;
+			continue;
+		}
+
+		ssize_t nr = read(watch.fd, evbuf, sizeof(evbuf));
+		if (nr <= 0)
+			continue;
+
+		for (char* ptr = evbuf; ptr < evbuf + nr;){
+			struct inotify_event* ev = (struct inotify_event*) ptr;
+			ptr += sizeof(struct inotify_event) + ev->len;
+
+			if (ev->mask & IN_Q_OVERFLOW){
+				rescan = true;
+				continue;
+			}
+
+			size_t i = 0;
+			for (; i < watch.count && watch.set[i].wd != ev->wd; i++){}
+			if (i == watch.count)
+				continue;
+
+			if (ev->mask & IN_IGNORED){
+				watch.set[i] = watch.set[--watch.count];
+				continue;
+			}
+
+/* events on the basedir itself name the appl, otherwise it is the owner */
+			char name[18];
+			if (!watch.set[i].appl[0]){
+				if (!ev->len || !(ev->mask & IN_ISDIR) ||
+					ev->name[0] == '.' || strlen(ev->name) >= 18)
+					continue;
+				snprintf(name, 18, "%s", ev->name);
+			}
+			else
+				snprintf(name, 18, "%s", watch.set[i].appl);
+
+			if ((ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO)))
+				watch_appl(name);
+
+			size_t j = 0;
+			for (; j < n_dirty && strcmp(dirty[j], name) != 0; j++){}
+			if (j < n_dirty)
+				continue;
+
+			if (n_dirty == WATCH_DIRTY_LIMIT)
+				rescan = true;
+			else
+				snprintf(dirty[n_dirty++], 18, "%s", name);
+		}
+	}
+
+	return NULL;
+}
+#endif
+
+bool anet_directory_srv_watch(struct anet_dirsrv_opts* opts)
+{
+#ifdef __linux__
+	watch.fd = inotify_init1(IN_CLOEXEC);
+	if (-1 == watch.fd)
+		return false;
+
+	pthread_t pth;
+	pthread_attr_t pthattr;
+	pthread_attr_init(&pthattr);
+	pthread_attr_setdetachstate(&pthattr, PTHREAD_CREATE_DETACHED);
+	int rv = pthread_create(&pth, &pthattr, index_watcher, opts);
+	pthread_attr_destroy(&pthattr);
+
+	if (0 == rv)
+		return true;
+
+	close(watch.fd);
+	watch.fd = -1;
+	return false;
+#else
+	return false;
+#endif
+}
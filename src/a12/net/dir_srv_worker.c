@@ -207,10 +207,12 @@ static void on_a12srv_event(
 	}
 }
 
-static void unpack_index(
-	struct a12_state *S, struct arcan_shmif_cont *C, struct arcan_event* ev)
+/* a delta only carries the entries that changed since the last index, removals
+ * always come as a full index */
+static void unpack_index(struct a12_state *S,
+	struct arcan_shmif_cont *C, struct arcan_event* ev, bool delta)
 {
-	a12int_trace(A12_TRACE_DIRECTORY, "new_index");
+	a12int_trace(A12_TRACE_DIRECTORY, "new_index:delta=%d", (int) delta);
 	FILE* fpek = fdopen(ev->tgt.ioevs[0].iv, "r");
 	if (!fpek){
 		a12int_trace(A12_TRACE_DIRECTORY, "error=einval_fd");
@@ -285,8 +287,16 @@ static void unpack_index(
 	}
 
 	fclose(fpek);
-	if (!S)
+	if (!S && delta){
+		cur = &pending_index;
+		while (*cur)
+			cur = &(*cur)->next;
+		*cur = first;
+	}
+	else if (!S)
 		pending_index = first;
+	else if (delta)
+		a12int_update_directory(S, first);
 	else
 		a12int_set_directory(S, first);
 }
@@ -297,7 +307,10 @@ static void bchunk_event(struct a12_state *S,
 {
 /* the index is packed as shmif argstrs line-separated */
 	if (strcmp(ev->tgt.message, ".index") == 0){
-		unpack_index(S, C, ev);
+		unpack_index(S, C, ev, false);
+	}
+	else if (strcmp(ev->tgt.message, ".delta") == 0){
+		unpack_index(S, C, ev, true);
 	}
 /* Only single channel handled for now, 1:1 source-sink connections. Multiple
  * ones are not difficult as such but evaluate the need experimentally first. */
@@ -380,8 +380,8 @@ bool build_appl_pkg(const char* name, struct appl_meta* dst, int cdir)
 	int olddir = open(".", O_DIRECTORY);
 
 	char* path[] = {".", NULL};
-	fchdir(cdir);
-	chdir(name);
+	if (-1 == fchdir(cdir) || -1 == chdir(name))
+		goto err;
 
 	size_t buf_sz;
 	if (!(fpek = open_memstream(&dst->buf, &buf_sz)))
@@ -16,6 +16,9 @@ struct anet_dirsrv_opts {
 	const char* allow_appl;
 	const char* allow_ctrl;
 	const char* allow_ares;
+
+/* number of threads servicing worker connections, 0 = one per core */
+	size_t shards;
 };
 
 /*
@@ -71,6 +74,7 @@ struct directory_meta {
 
 	FILE* appl_out;
 	bool appl_out_complete;
+	char appl_partial[48];
 	int state_in;
 	bool state_in_complete;
 
@@ -82,6 +86,10 @@ struct directory_meta {
  */
 void anet_directory_srv_rescan(struct anet_dirsrv_opts* opts);
 
+/* keep the index up to date with changes to the appls in basedir from a
+ * thread of its own, returns false if that isn't supported on the platform */
+bool anet_directory_srv_watch(struct anet_dirsrv_opts* opts);
+
 void anet_directory_srv(
 	struct a12_context_options*, struct anet_dirsrv_opts, int fdin, int fdout);
 
@@ -21,6 +21,8 @@
 #include "anet_helper.h"
 #include "directory.h"
 
+extern void arcan_random(uint8_t* dst, size_t);
+
 enum anet_mode {
 	ANET_SHMIF_CL = 1,
 	ANET_SHMIF_CL_REVERSE = 2,
@@ -33,7 +35,8 @@ enum anet_mode {
 
 enum mt_mode {
 	MT_SINGLE = 0,
-	MT_FORK = 1
+	MT_FORK = 1,
+	MT_RELAY = 2
 };
 
 struct arcan_net_meta {
@@ -48,9 +51,12 @@ static struct {
 	bool no_default;
 	bool probe_only;
 	bool keep_alive;
+	bool keystore_indexed;
 	size_t accept_n_pk_unknown;
 	size_t backpressure;
 	size_t backpressure_soft;
+	size_t venc_threads;
+	struct a12_aframe_opts aframe;
 	int directory;
 	struct anet_dirsrv_opts dirsrv;
 	struct anet_dircl_opts dircl;
@@ -93,6 +99,9 @@ static struct a12_vframe_opts vcodec_tuning(
 
 static bool open_keystore(struct anet_options* opts, const char** err)
 {
+	if (global.keystore_indexed)
+		opts->keystore.type = A12HELPER_PROVIDER_INDEXED;
+
 	if (0 > opts->keystore.directory.dirfd){
 		opts->keystore.directory.dirfd = a12helper_keystore_dirfd(err);
 		if (-1 == opts->keystore.directory.dirfd)
@@ -137,13 +146,9 @@ void arcan_fatal(const char* msg, ...)
 	exit(EXIT_FAILURE);
 }
 
-static bool handover_setup(struct a12_state* S,
-	int fd, struct arcan_net_meta* meta, struct shmifsrv_client** C)
-{
-	if (meta->opts->mode != ANET_SHMIF_EXEC && global.directory <= 0)
-		return true;
-
 /* wait for authentication before going for the shmifsrv processing mode */
+static bool handover_auth(struct a12_state* S, int fd)
+{
 	char* msg;
 	if (!anet_authenticate(S, fd, fd, &msg)){
 		a12int_trace(A12_TRACE_SYSTEM, "authentication failed: %s", msg);
@@ -160,6 +165,18 @@ static bool handover_setup(struct a12_state* S,
 		return false;
 	}
 
+	return true;
+}
+
+static bool handover_setup(struct a12_state* S,
+	int fd, struct arcan_net_meta* meta, struct shmifsrv_client** C)
+{
+	if (meta->opts->mode != ANET_SHMIF_EXEC && global.directory <= 0)
+		return true;
+
+	if (!handover_auth(S, fd))
+		return false;
+
 	a12int_trace(A12_TRACE_SYSTEM, "client connected, spawning: %s", meta->bin);
 
 /* connection is ok, tie it to a new shmifsrv_client via the exec arg. The GUID
@@ -307,6 +324,8 @@ static void fork_a12srv(struct a12_state* S, int fd, void* tag)
 			.redirect_exit = meta->opts->redirect_exit,
 			.devicehint_cp = meta->opts->devicehint_cp,
 			.vframe_block = global.backpressure,
+			.venc_threads = global.venc_threads,
+			.aframe = global.aframe,
 			.vframe_soft_block = global.backpressure_soft,
 			.eval_vcodec = vcodec_tuning,
 			.bcache_dir = get_bcache_dir()
@@ -331,7 +350,7 @@ static struct a12_vframe_opts vcodec_tuning(
 	struct a12_state* S, int segid, struct shmifsrv_vbuffer* vb, void* tag)
 {
 	struct a12_vframe_opts opts = {
-		.method = VFRAME_METHOD_DZSTD,
+		.method = VFRAME_METHOD_ADAPTIVE,
 		.bias = VFRAME_BIAS_BALANCED
 	};
 
@@ -415,6 +434,8 @@ static void single_a12srv(struct a12_state* S, int fd, void* tag)
 			.redirect_exit = meta->opts->redirect_exit,
 			.devicehint_cp = meta->opts->devicehint_cp,
 			.vframe_block = global.backpressure,
+			.venc_threads = global.venc_threads,
+			.aframe = global.aframe,
 			.vframe_soft_block = global.backpressure_soft,
 			.eval_vcodec = vcodec_tuning,
 			.bcache_dir = get_bcache_dir()
@@ -428,6 +449,47 @@ static void single_a12srv(struct a12_state* S, int fd, void* tag)
 	}
 }
 
+/*
+ * The first connection spawns the client and the relay that then services it,
+ * the rest are authenticated here and handed over. The client is re-spawned
+ * for the next connection after it has died.
+ */
+static void relay_a12srv(struct a12_state* S, int fd, void* tag)
+{
+	static struct a12helper_relay* relay;
+	struct arcan_net_meta* meta = tag;
+
+	if (relay && !a12helper_relay_alive(relay)){
+		a12helper_relay_free(relay);
+		relay = NULL;
+	}
+
+	if (relay){
+		if (!handover_auth(S, fd))
+			return;
+	}
+	else {
+		struct shmifsrv_client* C = NULL;
+		if (!handover_setup(S, fd, meta, &C))
+			return;
+
+		relay = a12helper_relay_start(C, (struct a12helper_opts){
+			.eval_vcodec = vcodec_tuning
+		});
+
+		if (!relay){
+			a12int_trace(A12_TRACE_SYSTEM, "kind=error:message=couldn't start relay");
+			shmifsrv_free(C, SHMIFSRV_FREE_NO_DMS);
+		}
+	}
+
+	if (!relay || !a12helper_relay_attach(relay, S, fd)){
+		a12_free(S);
+		shutdown(fd, SHUT_RDWR);
+		close(fd);
+	}
+}
+
 static void dir_to_shmifsrv(struct a12_state* S, struct a12_dynreq a, void* tag);
 struct dirstate {
 	int fd;
@@ -470,6 +532,8 @@ static void a12cl_dispatch(
 /* note that the a12helper will do the cleanup / free */
 		a12helper_a12cl_shmifsrv(S, cl, fd, fd, (struct a12helper_opts){
 			.vframe_block = global.backpressure,
+			.venc_threads = global.venc_threads,
+			.aframe = global.aframe,
 			.redirect_exit = args->redirect_exit,
 			.devicehint_cp = args->devicehint_cp,
 			.bcache_dir = get_bcache_dir()
@@ -523,6 +587,8 @@ static void dir_a12srv(struct a12_state* S, int fd, void* tag)
 		.redirect_exit = ds->aopts->redirect_exit,
 		.devicehint_cp = ds->aopts->devicehint_cp,
 		.vframe_block = global.backpressure,
+		.venc_threads = global.venc_threads,
+		.aframe = global.aframe,
 		.vframe_soft_block = global.backpressure_soft,
 		.eval_vcodec = vcodec_tuning,
 		.bcache_dir = get_bcache_dir()
@@ -948,9 +1014,11 @@ static bool show_usage(const char* msg, char** argv, size_t i)
 	""
 	"Options:\n"
 	"\t-t             \t Single- client (no fork/mt - easier troubleshooting)\n"
+	"\t --relay       \t (-l with exec) Share one application with all clients\n"
 	"\t --probe-only  \t (outbound) Authenticate and print server primary state\n"
 	"\t-d bitmap      \t Set trace bitmap (bitmask or key1,key2,...)\n"
 	"\t--keystore fd  \t Use inherited [fd] for keystore root store\n"
+	"\t--keystore-index\t Keep accepted keys in one indexed log (large stores)\n"
 	"\t-v, --version  \t Print build/version information to stdout\n\n"
 	"Directory client options: \n"
 	"\t --keep-appl   \t Don't wipe appl after execution\n"
@@ -976,6 +1044,16 @@ static bool show_usage(const char* msg, char** argv, size_t i)
 #endif
 	"\tA12_VBP        \t backpressure maximium cap (0..8)\n"
 	"\tA12_VBP_SOFT   \t backpressure soft (full-frames) cap (< VBP)\n"
+	"\tA12_VENC_THREADS\t encode video on a worker, with n compression threads\n"
+	"\tA12_VDEC_THREADS\t decode video on a worker, with n threads\n"
+#ifdef WANT_H264_ENC
+	"\tA12_VIDEO_HW   \t h264 backend, vaapi[:device], nvenc or v4l2m2m\n"
+#endif
+	"\tA12_DGRAM      \t send audio/video as UDP datagrams (set on both ends)\n"
+	"\tA12_AUDIO_FRAME\t forward client audio as opus, frame ms (2.5, 5, 10, 20)\n"
+	"\tA12_AUDIO_RATE \t opus bitrate in kilobits/s\n"
+	"\tA12_AUDIO_DELAY\t cap (ms) on the playout delay of received opus audio\n"
+	"\tA12_DIRECTORY_THREADS\t directory server threads for clients (default=cores)\n"
 	"\tA12_CACHE_DIR  \t Used for caching binary stores (fonts, ...)\n\n"
 	"\tLocal Discovery mode (ignores connection arguments):\n"
 	"\tarcan-net discover passive\n"
@@ -1215,6 +1293,9 @@ static int apply_commandline(int argc, char** argv, struct arcan_net_meta* meta)
 
 			opts->keystore.directory.dirfd = strtoul(argv[i], NULL, 10);
 		}
+		else if (strcmp(argv[i], "--keystore-index") == 0){
+			global.keystore_indexed = true;
+		}
 		else if (strcmp(argv[i], "--probe-only") == 0){
 			opts->opts->local_role = ROLE_PROBE;
 			global.probe_only = true;
@@ -1278,6 +1359,9 @@ static int apply_commandline(int argc, char** argv, struct arcan_net_meta* meta)
 		else if (strcmp(argv[i], "-t") == 0){
 			opts->mt_mode = MT_SINGLE;
 		}
+		else if (strcmp(argv[i], "--relay") == 0){
+			opts->mt_mode = MT_RELAY;
+		}
 		else if (strcmp(argv[i], "-T") == 0 || strcmp(argv[i], "--trust") == 0){
 			i++;
 			if (i == argc)
@@ -1376,6 +1460,12 @@ static int apply_commandline(int argc, char** argv, struct arcan_net_meta* meta)
 		}
 	}
 
+	return i;
+}
+
+/* applies regardless of which mode the command line ended up in */
+static bool apply_environment(struct anet_options* opts)
+{
 	char* tmp;
 	if ((tmp = getenv("A12_VBP"))){
 		size_t bp = strtoul(tmp, NULL, 10);
@@ -1389,7 +1479,58 @@ static int apply_commandline(int argc, char** argv, struct arcan_net_meta* meta)
 			global.backpressure_soft = bp;
 	}
 
-	return i;
+	if ((tmp = getenv("A12_VENC_THREADS"))){
+		size_t nt = strtoul(tmp, NULL, 10);
+		if (nt <= 16)
+			global.venc_threads = nt;
+	}
+
+	if ((tmp = getenv("A12_VDEC_THREADS"))){
+		size_t nt = strtoul(tmp, NULL, 10);
+		if (nt <= 16)
+			a12helper_a12srv_shmifcl_vdec(nt);
+	}
+
+/* api[:device], e.g. vaapi:/dev/dri/renderD128 */
+	if ((tmp = getenv("A12_VIDEO_HW"))){
+		static const char* apis[] = {
+			[A12_HWVIDEO_VAAPI] = "vaapi",
+			[A12_HWVIDEO_NVENC] = "nvenc",
+			[A12_HWVIDEO_V4L2M2M] = "v4l2m2m"
+		};
+		size_t len = strcspn(tmp, ":");
+		for (size_t i = 1; i < COUNT_OF(apis); i++){
+			if (strlen(apis[i]) == len && strncmp(apis[i], tmp, len) == 0)
+				opts->opts->hw_video = i;
+		}
+		if (!opts->opts->hw_video)
+			return show_usage("A12_VIDEO_HW: expected vaapi, nvenc or v4l2m2m", NULL, 0);
+		if (tmp[len] == ':' && tmp[len+1])
+			opts->opts->hw_video_device = &tmp[len+1];
+	}
+
+	if (getenv("A12_DGRAM"))
+		opts->opts->datagram = true;
+
+/* frame duration in ms, 2.5 to 20 */
+	if ((tmp = getenv("A12_AUDIO_FRAME"))){
+		float ms = strtof(tmp, NULL);
+		if (ms != 2.5 && ms != 5 && ms != 10 && ms != 20)
+			return show_usage("A12_AUDIO_FRAME: expected 2.5, 5, 10 or 20", NULL, 0);
+		global.aframe.method = AFRAME_METHOD_OPUS;
+		global.aframe.frame_us = ms * 1000;
+	}
+
+	if ((tmp = getenv("A12_AUDIO_RATE")))
+		global.aframe.bitrate = strtoul(tmp, NULL, 10);
+
+	if ((tmp = getenv("A12_DIRECTORY_THREADS")))
+		global.dirsrv.shards = strtoul(tmp, NULL, 10);
+
+	if ((tmp = getenv("A12_AUDIO_DELAY")))
+		opts->opts->audio_delay_max = strtoul(tmp, NULL, 10);
+
+	return true;
 }
 
 static bool discover_beacon(
@@ -1633,6 +1774,28 @@ static void sigusr_rescan(int sign)
 	global.flag_rescan = true;
 }
 
+struct resume_tag {
+	struct anet_options* anet;
+	struct anet_cl_connection* cl;
+};
+
+/* the connection to the server was lost, try to get back to it without
+ * losing the clients we have */
+static int reconnect_session(struct a12_state* S, struct a12_ticket* T, void* tag)
+{
+	struct resume_tag* rt = tag;
+	char* err = NULL;
+
+	if (!anet_cl_resume(rt->cl, T, rt->anet->retry_count, &err)){
+		a12int_trace(A12_TRACE_SYSTEM,
+			"kind=resume:status=failed:message=%s", err ? err : "");
+		free(err);
+		return -1;
+	}
+
+	return rt->cl->fd;
+}
+
 int main(int argc, char** argv)
 {
 	struct anet_options anet = {
@@ -1672,6 +1835,9 @@ int main(int argc, char** argv)
 	if (!argi && anet.mode != ANET_SHMIF_DIRSRV_INHERIT && !meta.opts->host)
 		return EXIT_FAILURE;
 
+	if (!apply_environment(meta.opts))
+		return EXIT_FAILURE;
+
 /* no mode? if there's arguments left, assume it is is the 'reverse' mode
  * where the connection is outbound but we get the a12 'client' view back
  * to pair with an arcan-net --exec .. */
@@ -1737,6 +1903,8 @@ int main(int argc, char** argv)
 				anet_directory_cl(cl.state, global.dircl, cl.fd, cl.fd);
 			}
 			else {
+				struct resume_tag rt = {.anet = &anet, .cl = &cl};
+				a12helper_a12srv_shmifcl_reconnect(reconnect_session, &rt);
 				rc = a12helper_a12srv_shmifcl(NULL, cl.state, NULL, cl.fd, cl.fd);
 			}
 			shutdown(cl.fd, SHUT_RDWR);
@@ -1774,6 +1942,12 @@ int main(int argc, char** argv)
 			a12helper_keystore_register("default", "127.0.0.1", 6680, outp);
 			a12int_trace(A12_TRACE_SECURITY, "key_added=default");
 		}
+
+/* Session tickets are sealed with a key that only lives in this process and
+ * the forked children, a restart invalidates those in circulation. The
+ * directory has its own reconnection semantics. */
+		if (global.directory == -1)
+			arcan_random(anet.opts->ticket_key, 32);
 	}
 
 /* The directory option is not applied through the mode/role but rather as part
@@ -1810,6 +1984,9 @@ int main(int argc, char** argv)
 			}, NULL);
 			anet_directory_srv_rescan(&global.dirsrv);
 			anet_directory_shmifsrv_set(&global.dirsrv);
+
+			if (!anet_directory_srv_watch(&global.dirsrv))
+				a12int_trace(A12_TRACE_DIRECTORY, "index:kind=warning:no_watch");
 		}
 
 		if (!global.trust_domain)
@@ -1825,6 +2002,15 @@ int main(int argc, char** argv)
 			fprintf(stderr, "%s", errmsg ? errmsg : "");
 			free(errmsg);
 		break;
+		case MT_RELAY:
+			if (anet.mode != ANET_SHMIF_EXEC || global.directory != -1){
+				show_usage("--relay requires -l port -- /usr/bin/app", NULL, 0);
+				return EXIT_FAILURE;
+			}
+			anet_listen(&anet, &errmsg, relay_a12srv, &meta);
+			fprintf(stderr, "%s", errmsg ? errmsg : "");
+			free(errmsg);
+		break;
 		default:
 		break;
 		}
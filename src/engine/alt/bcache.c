@@ -0,0 +1,326 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Bytecode cache for appl scripts, see bcache.h
+ *
+ * Each cache entry is a header, the source path and the lua_dump output of
+ * the chunk. Entries are written to a temporary file and renamed into place
+ * so a reader never sees a partial one. The chunk name is part of the dump,
+ * error messages and tracebacks look the same as with the source.
+ *
+ * The entries are no more (or less) trusted than the scripts themselves, the
+ * loaders accept binary chunks from any .lua in the appl namespaces already.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <lua.h>
+#include <lauxlib.h>
+
+#if defined(ARCAN_LUAJIT) && defined(__has_include)
+#if __has_include(<luajit.h>)
+#include <luajit.h>
+#endif
+#endif
+
+#include "platform.h"
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "alt/bcache.h"
+
+#ifndef LUAJIT_VERSION
+#define LUAJIT_VERSION ""
+#endif
+
+#ifndef ARCAN_BUILDVERSION
+#define ARCAN_BUILDVERSION ""
+#endif
+
+#ifdef __APPLE__
+#define st_mtim st_mtimespec
+#endif
+
+/* bump on any change to the entry layout */
+#define BCACHE_MAGIC "ALUABC1"
+
+struct bc_header {
+	char magic[8];
+	uint64_t vm;
+	uint64_t dev, ino, size;
+	int64_t mtime_s, mtime_ns;
+	uint64_t path_len;
+	uint64_t code_len;
+};
+
+struct dump_buf {
+	char* buf;
+	size_t sz, used;
+	bool fail;
+};
+
+static struct {
+	bool checked;
+	bool enabled;
+	uint64_t vm;
+} bcache;
+
+static uint64_t fnv1a(uint64_t hash, const void* buf, size_t sz)
+{
+	const uint8_t* in = buf;
+	for (size_t i = 0; i < sz; i++){
+		hash ^= in[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static void check_enabled()
+{
+	if (bcache.checked)
+		return;
+	bcache.checked = true;
+
+	uintptr_t tag;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+	bcache.enabled = get_config("lua_bytecode_cache", 0, NULL, tag);
+
+/* bytecode is specific to the VM, its version and the data model */
+	char ident[256];
+	snprintf(ident, sizeof(ident), "%s:%s:%s:%zu:%zu",
+		LUA_RELEASE, LUAJIT_VERSION, ARCAN_BUILDVERSION,
+		sizeof(void*), sizeof(lua_Number));
+	bcache.vm = fnv1a(0xcbf29ce484222325ULL, ident, strlen(ident));
+}
+
+/* .luacache/<hash of path>.luac in APPL_TEMP, [mkdir] when about to write */
+static char* entry_path(const char* path, bool mkdir_dir)
+{
+	char* dir = arcan_expand_resource(".luacache", RESOURCE_APPL_TEMP);
+	if (!dir)
+		return NULL;
+
+	if (mkdir_dir && -1 == mkdir(dir, S_IRWXU) && errno != EEXIST){
+		arcan_mem_free(dir);
+		return NULL;
+	}
+
+	size_t len = strlen(dir) + sizeof("/0123456789abcdef.luac");
+	char* res = malloc(len);
+	if (res){
+		uint64_t hash = fnv1a(0xcbf29ce484222325ULL, path, strlen(path));
+		snprintf(res, len, "%s/%016"PRIx64".luac", dir, hash);
+	}
+
+	arcan_mem_free(dir);
+	return res;
+}
+
+static struct bc_header make_header(const char* path, struct stat* st)
+{
+	struct bc_header hdr = {
+		.magic = BCACHE_MAGIC,
+		.vm = bcache.vm,
+		.dev = st->st_dev,
+		.ino = st->st_ino,
+		.size = st->st_size,
+		.mtime_s = st->st_mtim.tv_sec,
+		.mtime_ns = st->st_mtim.tv_nsec,
+		.path_len = strlen(path)
+	};
+	return hdr;
+}
+
+/* returns -1 if there is no valid entry, otherwise the load status */
+static int load_entry(lua_State* L,
+	const char* path, struct stat* st, const char* chunkname)
+{
+	char* fn = entry_path(path, false);
+	if (!fn)
+		return -1;
+
+	int fd = open(fn, O_RDONLY | O_CLOEXEC);
+	free(fn);
+	if (-1 == fd)
+		return -1;
+
+	struct stat est;
+	struct bc_header ref = make_header(path, st);
+	int rv = -1;
+
+	if (-1 == fstat(fd, &est) ||
+		(size_t) est.st_size < sizeof(struct bc_header) + ref.path_len){
+		close(fd);
+		return -1;
+	}
+
+	uint8_t* map = mmap(NULL, est.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	struct bc_header hdr;
+	memcpy(&hdr, map, sizeof(hdr));
+	ref.code_len = hdr.code_len;
+
+	if (memcmp(&hdr, &ref, sizeof(hdr)) == 0 &&
+		est.st_size - sizeof(hdr) - hdr.path_len == hdr.code_len &&
+		memcmp(&map[sizeof(hdr)], path, hdr.path_len) == 0){
+		madvise(map, est.st_size, MADV_SEQUENTIAL);
+		rv = luaL_loadbuffer(L,
+			(char*) &map[sizeof(hdr) + hdr.path_len], hdr.code_len, chunkname);
+	}
+
+	munmap(map, est.st_size);
+	return rv;
+}
+
+static int dump_writer(lua_State* L, const void* p, size_t sz, void* ud)
+{
+	struct dump_buf* out = ud;
+	if (out->used + sz > out->sz){
+		size_t nsz = out->sz ? out->sz * 2 : 65536;
+		while (nsz < out->used + sz)
+			nsz *= 2;
+
+		char* nbuf = realloc(out->buf, nsz);
+		if (!nbuf){
+			out->fail = true;
+			return 1;
+		}
+		out->buf = nbuf;
+		out->sz = nsz;
+	}
+
+	memcpy(&out->buf[out->used], p, sz);
+	out->used += sz;
+	return 0;
+}
+
+static bool write_all(int fd, const void* buf, size_t sz)
+{
+	const char* cur = buf;
+	while (sz){
+		ssize_t nw = write(fd, cur, sz);
+		if (nw > 0){
+			cur += nw;
+			sz -= nw;
+		}
+		else if (-1 == nw && errno == EINTR)
+			;
+		else
+			return false;
+	}
+	return true;
+}
+
+/* dump the function on the top of the stack */
+static void store_entry(lua_State* L, const char* path, struct stat* st)
+{
+	struct dump_buf out = {0};
+	if (0 != lua_dump(L, dump_writer, &out) || out.fail){
+		free(out.buf);
+		return;
+	}
+
+	char* fn = entry_path(path, true);
+	if (!fn){
+		free(out.buf);
+		return;
+	}
+
+	size_t tlen = strlen(fn) + sizeof(".tmp.4294967295");
+	char tmp[tlen];
+	snprintf(tmp, tlen, "%s.tmp.%u", fn, (unsigned) getpid());
+
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (-1 != fd){
+		struct bc_header hdr = make_header(path, st);
+		hdr.code_len = out.used;
+
+		bool ok =
+			write_all(fd, &hdr, sizeof(hdr)) &&
+			write_all(fd, path, hdr.path_len) &&
+			write_all(fd, out.buf, out.used);
+
+		close(fd);
+		if (!ok || -1 == rename(tmp, fn))
+			unlink(tmp);
+	}
+
+	free(fn);
+	free(out.buf);
+}
+
+/* same rules as luaL_loadfile, a leading # line is skipped but its newline
+ * is kept so that line numbers still match */
+static int load_source(lua_State* L, int fd, size_t sz, const char* chunkname)
+{
+	if (!sz)
+		return luaL_loadbuffer(L, "", 0, chunkname);
+
+	data_source src = {.fd = fd, .len = sz};
+	map_region map = arcan_map_resource(&src, false);
+	if (!map.ptr){
+		lua_pushfstring(L, "couldn't map %s", chunkname);
+		return LUA_ERRFILE;
+	}
+
+	const char* buf = map.ptr;
+	size_t len = map.sz;
+	if (buf[0] == '#'){
+		const char* nl = memchr(buf, '\n', len);
+		len = nl ? len - (nl - buf) : 0;
+		buf = nl ? nl : buf;
+	}
+
+	int rv = luaL_loadbuffer(L, buf, len, chunkname);
+	arcan_release_map(map);
+	return rv;
+}
+
+int alt_bcache_load(lua_State* L, const char* path, const char* chunkname)
+{
+	check_enabled();
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	struct stat st;
+
+	if (-1 == fd){
+		lua_pushfstring(L, "cannot open %s", path);
+		return LUA_ERRFILE;
+	}
+
+	if (-1 == fstat(fd, &st)){
+		close(fd);
+		lua_pushfstring(L, "cannot stat %s", path);
+		return LUA_ERRFILE;
+	}
+
+	int rv = -1;
+	if (bcache.enabled && 0 == (rv = load_entry(L, path, &st, chunkname))){
+		close(fd);
+		return 0;
+	}
+
+/* a failed load of a matching entry leaves its message on the stack */
+	if (bcache.enabled && -1 != rv)
+		lua_pop(L, 1);
+
+	rv = load_source(L, fd, st.st_size, chunkname);
+	close(fd);
+
+	if (0 == rv && bcache.enabled)
+		store_entry(L, path, &st);
+
+	return rv;
+}
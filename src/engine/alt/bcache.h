@@ -0,0 +1,22 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Bytecode cache for appl scripts.
+ */
+#ifndef HAVE_ALT_BCACHE
+#define HAVE_ALT_BCACHE
+
+/*
+ * Load the script at the resolved [path] as a chunk named [chunkname] and
+ * push it (or the error message) onto [L], returning the luaL_load* status.
+ *
+ * With lua_bytecode_cache set, the compiled chunk is dumped into .luacache/
+ * in the APPL_TEMP namespace, keyed on path, inode, size, mtime and the VM
+ * build. Later loads with a matching entry map and load that instead of
+ * parsing the source. A missing, stale or unwritable cache just means the
+ * source is parsed as normal.
+ */
+int alt_bcache_load(lua_State* L, const char* path, const char* chunkname);
+
+#endif
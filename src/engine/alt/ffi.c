@@ -0,0 +1,293 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: LuaJIT FFI bindings for the hot image functions, see ffi.h
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <math.h>
+#include <lua.h>
+#include <lauxlib.h>
+
+#include "platform.h"
+#include "alt/opaque.h"
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_video.h"
+#include "arcan_videoint.h"
+
+#include "alt/types.h"
+#include "alt/ffi.h"
+
+#if defined(ARCAN_LUAJIT) && \
+	!defined(LUA_TRACE_STDERR) && !defined(LUA_TRACE_COVERAGE)
+
+/* mirrored in the cdef below, keep in sync */
+struct alt_ffi_props {
+	double x, y, z;
+	double width, height, depth;
+	double angle, roll, pitch, yaw;
+	double opacity, order;
+};
+
+struct alt_ffi_api {
+	int (*move)(double, double, double, int, int);
+	int (*opacity)(double, double, int, int);
+	int (*resize)(double, double, double, int, int, double*);
+	int (*scale)(double, double, double, int, int, double*);
+	int (*props)(double, double, struct alt_ffi_props*);
+};
+
+/*
+ * All of these return 0 on success and -1 if the caller should retry with
+ * the regular C function (which will then produce the same errors and
+ * warnings as it always has), resize returns 1 for no values.
+ */
+static bool use_interp(int time, int interp)
+{
+	return time > 0 && interp >= 0 && interp < ARCAN_VINTER_ENDMARKER;
+}
+
+static int ffi_move(double vid, double x, double y, int time, int interp)
+{
+	arcan_vobj_id id = luavid_tovid(vid);
+	if (time < 0)
+		time = 0;
+
+	if (ARCAN_OK != arcan_video_objectmove(id, x, y, 1.0, time))
+		return -1;
+
+	if (use_interp(time, interp))
+		arcan_video_moveinterp(id, interp);
+
+	return 0;
+}
+
+static int ffi_opacity(double vid, double val, int time, int interp)
+{
+	arcan_vobj_id id = luavid_tovid(vid);
+	if (time < 0)
+		time = 0;
+
+	if (ARCAN_OK != arcan_video_objectopacity(id, val, time))
+		return -1;
+
+	if (use_interp(time, interp))
+		arcan_video_blendinterp(id, interp);
+
+	return 0;
+}
+
+static int ffi_resize(
+	double vid, double w, double h, int time, int interp, double* out)
+{
+	arcan_vobj_id id = luavid_tovid(vid);
+	float neww = w, newh = h;
+	bool interp_ok = use_interp(time, interp);
+	if (time < 0)
+		time = 0;
+
+	if (!arcan_video_getobject(id))
+		return -1;
+
+	if (neww < EPSILON && newh < EPSILON)
+		return 1;
+
+	surface_properties prop = arcan_video_initial_properties(id);
+	if (prop.scale.x < EPSILON && prop.scale.y < EPSILON){
+		out[0] = out[1] = 0;
+		return 0;
+	}
+
+/* retain aspect ratio in scale */
+	if (neww < EPSILON && newh > EPSILON)
+		neww = newh * (prop.scale.x / prop.scale.y);
+	else if (neww > EPSILON && newh < EPSILON)
+		newh = neww * (prop.scale.y / prop.scale.x);
+
+	neww = ceilf(neww);
+	newh = ceilf(newh);
+	arcan_video_objectscale(id, neww / prop.scale.x, newh / prop.scale.y, 1.0, time);
+
+	if (interp_ok)
+		arcan_video_scaleinterp(id, interp);
+
+	out[0] = neww;
+	out[1] = newh;
+	return 0;
+}
+
+static int ffi_scale(
+	double vid, double w, double h, int time, int interp, double* out)
+{
+	arcan_vobj_id id = luavid_tovid(vid);
+	float desw = w, desh = h;
+	if (time < 0)
+		time = 0;
+
+	if (!arcan_video_getobject(id))
+		return -1;
+
+	surface_properties prop = arcan_video_initial_properties(id);
+
+/* retain aspect ratio in scale */
+	if (desw < EPSILON && desh > EPSILON)
+		desw = desh * (prop.scale.x / prop.scale.y);
+	else if (desw > EPSILON && desh < EPSILON)
+		desh = desw * (prop.scale.y / prop.scale.x);
+
+	arcan_video_objectscale(id, desw, desh, 1.0, time);
+	if (use_interp(time, interp))
+		arcan_video_scaleinterp(id, interp);
+
+	out[0] = desw;
+	out[1] = desh;
+	return 0;
+}
+
+static int ffi_props(double vid, double dt, struct alt_ffi_props* out)
+{
+	arcan_vobj_id id = luavid_tovid(vid);
+	long long ldt = dt;
+	if (ldt < 0)
+		ldt = LONG_MAX;
+
+	surface_properties prop = ldt > 0 ?
+		arcan_video_properties_at(id, ldt) : arcan_video_current_properties(id);
+
+	*out = (struct alt_ffi_props){
+		.x = prop.position.x,
+		.y = prop.position.y,
+		.z = prop.position.z,
+		.width = prop.scale.x,
+		.height = prop.scale.y,
+		.depth = prop.scale.z,
+		.angle = prop.rotation.roll,
+		.roll = prop.rotation.roll,
+		.pitch = prop.rotation.pitch,
+		.yaw = prop.rotation.yaw,
+		.opacity = prop.opa,
+		.order = arcan_video_getzv(id)
+	};
+
+	return 0;
+}
+
+static struct alt_ffi_api api = {
+	.move = ffi_move,
+	.opacity = ffi_opacity,
+	.resize = ffi_resize,
+	.scale = ffi_scale,
+	.props = ffi_props
+};
+
+/*
+ * The wrappers only take the single numeric vid form, anything else (tables
+ * of vids, bad arguments) goes to the original function. The out- buffers
+ * are allocated once and reused so the calls themselves don't allocate.
+ */
+static const char ffi_src[] =
+"local api = ...\n"
+"local ffi = require('ffi')\n"
+"ffi.cdef[[\n"
+"struct alt_ffi_props {\n"
+"	double x, y, z;\n"
+"	double width, height, depth;\n"
+"	double angle, roll, pitch, yaw;\n"
+"	double opacity, order;\n"
+"};\n"
+"struct alt_ffi_api {\n"
+"	int (*move)(double, double, double, int, int);\n"
+"	int (*opacity)(double, double, int, int);\n"
+"	int (*resize)(double, double, double, int, int, double*);\n"
+"	int (*scale)(double, double, double, int, int, double*);\n"
+"	int (*props)(double, double, struct alt_ffi_props*);\n"
+"};\n"
+"]]\n"
+"api = ffi.cast('struct alt_ffi_api*', api)\n"
+"local props_t = ffi.typeof('struct alt_ffi_props')\n"
+"local dims = ffi.new('double[2]')\n"
+"local type = type\n"
+"local c_move, c_blend = move_image, blend_image\n"
+"local c_resize, c_scale = resize_image, scale_image\n"
+"local c_props = image_surface_properties\n"
+"\n"
+"move_image = function(vid, x, y, t, i, ...)\n"
+"	if type(vid) ~= 'number' or\n"
+"		api.move(vid, x or 0, y or 0, t or 0, i or -1) ~= 0 then\n"
+"		return c_move(vid, x, y, t, i, ...)\n"
+"	end\n"
+"end\n"
+"\n"
+"blend_image = function(vid, v, t, i, ...)\n"
+"	if type(vid) ~= 'number' or type(v) ~= 'number' or\n"
+"		api.opacity(vid, v, t or 0, i or -1) ~= 0 then\n"
+"		return c_blend(vid, v, t, i, ...)\n"
+"	end\n"
+"end\n"
+"\n"
+"resize_image = function(vid, w, h, t, i, ...)\n"
+"	if type(vid) ~= 'number' or type(w) ~= 'number' or type(h) ~= 'number' then\n"
+"		return c_resize(vid, w, h, t, i, ...)\n"
+"	end\n"
+"	local rv = api.resize(vid, w, h, t or 0, i or -1, dims)\n"
+"	if rv == 0 then\n"
+"		return dims[0], dims[1]\n"
+"	elseif rv < 0 then\n"
+"		return c_resize(vid, w, h, t, i, ...)\n"
+"	end\n"
+"end\n"
+"\n"
+"scale_image = function(vid, w, h, t, i, ...)\n"
+"	if type(vid) ~= 'number' or type(w) ~= 'number' or type(h) ~= 'number' or\n"
+"		api.scale(vid, w, h, t or 0, i or -1, dims) ~= 0 then\n"
+"		return c_scale(vid, w, h, t, i, ...)\n"
+"	end\n"
+"	return dims[0], dims[1]\n"
+"end\n"
+"\n"
+"image_surface_properties = function(vid, dt, ...)\n"
+"	if type(vid) ~= 'number' then\n"
+"		return c_props(vid, dt, ...)\n"
+"	end\n"
+"	local res = props_t()\n"
+"	api.props(vid, dt or 0, res)\n"
+"	return res\n"
+"end\n";
+
+bool alt_ffi_setup(lua_State* L)
+{
+	uintptr_t tag;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+	if (!get_config("video_lua_ffi", 0, NULL, tag))
+		return false;
+
+	int top = lua_gettop(L);
+	if (0 != luaL_loadbuffer(L, ffi_src, sizeof(ffi_src) - 1, "=alt_ffi")){
+		arcan_warning("lua_ffi: couldn't load bindings: %s\n", lua_tostring(L, -1));
+		lua_settop(L, top);
+		return false;
+	}
+
+	lua_pushlightuserdata(L, &api);
+	if (0 != lua_pcall(L, 1, 0, 0)){
+		arcan_warning("lua_ffi: couldn't setup bindings: %s\n", lua_tostring(L, -1));
+		lua_settop(L, top);
+		return false;
+	}
+
+	lua_settop(L, top);
+	return true;
+}
+
+#else
+bool alt_ffi_setup(lua_State* L)
+{
+	return false;
+}
+#endif
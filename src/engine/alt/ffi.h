@@ -0,0 +1,26 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Optional LuaJIT FFI fast path for a small set of hot image
+ * functions (move_image, blend_image, resize_image, scale_image and
+ * image_surface_properties).
+ */
+#ifndef HAVE_ALT_FFI
+#define HAVE_ALT_FFI
+
+/*
+ * Replace the hot subset of the already registered globals in [L] with
+ * wrappers that call into the engine through the LuaJIT FFI, so the calls
+ * can be compiled into traces rather than forcing exits through the C API.
+ * The classic functions are kept as fallbacks for every argument form but
+ * the plain single-vid numeric one.
+ *
+ * This is opt-in (video_lua_ffi) as image_surface_properties will return a
+ * struct with the same fields rather than a table. Does nothing on builds
+ * without LuaJIT or with LUA_TRACE_ enabled. Returns true if the wrappers
+ * were installed.
+ */
+bool alt_ffi_setup(lua_State* L);
+
+#endif
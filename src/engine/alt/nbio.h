@@ -34,6 +34,18 @@ struct nonblock_io {
 
 /* in line-buffered mode, this is used for input */
 	char buf[4096];
+
+/* coroutine suspended in :await and the data accumulated for it, the buffer
+ * is sized up front for fixed size reads and grows for delimiter scans */
+	bool awaiting;
+	intptr_t await_thread;
+	size_t await_n;
+	char await_delim[8];
+	size_t await_dlen;
+	size_t await_scan;
+	char* abuf;
+	size_t abuf_sz;
+	size_t abuf_used;
 };
 
 /*
@@ -13,6 +13,9 @@
 #include <lualib.h>
 #include <lauxlib.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
 
 typedef struct arcan_vobject arcan_vobject;
 
@@ -30,6 +33,18 @@ static intptr_t trace_cb;
 
 static char* crash_source;
 
+/* the sampler thread only ever touches the hook, the stack walk and the
+ * trace buffer writes happen in the hook on the thread running the VM */
+static struct {
+	lua_State* L;
+	pthread_t thread;
+	bool running;
+	_Atomic bool alive;
+	_Atomic uint64_t armed;
+	size_t interval;
+	size_t depth;
+} profiler;
+
 extern void arcan_conductor_toggle_watchdog();
 
 char* alt_trace_crash_source()
@@ -96,6 +111,7 @@ bool alt_trace_start(lua_State* L, intptr_t cb, size_t sz)
 
 void alt_trace_finish(lua_State* L)
 {
+	arcan_trace_flush();
 	if (!got_trace_buffer)
 		return;
 
@@ -246,3 +262,91 @@ int alt_trace_log(lua_State* ctx)
 	arcan_mem_free(log_buffer);
 	return 0;
 }
+
+static void profile_hook(lua_State* L, lua_Debug* ar)
+{
+	lua_sethook(L, NULL, 0, 0);
+	uint64_t armed = atomic_exchange(&profiler.armed, 0);
+	if (!armed || !arcan_trace_enabled)
+		return;
+
+/* the hook fires on the next instruction executed, if the VM was idle when
+ * armed the stack is not representative for the interval so drop it */
+	if (arcan_timemicros() - armed > profiler.interval)
+		return;
+
+/* first find the depth, then fold the frames outermost first */
+	lua_Debug cur;
+	int level = 0;
+	while ((size_t)level < profiler.depth && lua_getstack(L, level, &cur))
+		level++;
+
+	if (!level)
+		return;
+
+	char folded[1024];
+	size_t ofs = 0;
+	for (int i = level - 1; i >= 0; i--){
+		lua_getstack(L, i, &cur);
+		lua_getinfo(L, "nSl", &cur);
+		int nw = snprintf(&folded[ofs], sizeof(folded) - ofs, "%s%s@%s:%d",
+			ofs ? ";" : "", cur.name ? cur.name : "?", cur.short_src, cur.currentline);
+		if (nw < 0 || (size_t)nw >= sizeof(folded) - ofs){
+			folded[ofs] = '\0';
+			break;
+		}
+		ofs += nw;
+	}
+
+	arcan_trace_mark("lua", "sample", 0, TRACE_SYS_DEFAULT,
+		level, profiler.interval, folded, __FILE__, __func__, __LINE__);
+}
+
+static void* profile_thread(void* unused)
+{
+	struct timespec ts = {
+		.tv_sec = profiler.interval / 1000000,
+		.tv_nsec = (profiler.interval % 1000000) * 1000
+	};
+
+	while (atomic_load(&profiler.alive)){
+		nanosleep(&ts, NULL);
+
+/* don't stomp on the watchdog (or any other) hook, it takes precedence */
+		if (!arcan_trace_enabled || lua_gethook(profiler.L))
+			continue;
+
+		atomic_store(&profiler.armed, arcan_timemicros());
+		lua_sethook(profiler.L, profile_hook, LUA_MASKCOUNT, 1);
+	}
+
+	return NULL;
+}
+
+bool alt_trace_profile(lua_State* L, size_t interval_us, size_t depth)
+{
+	if (profiler.running){
+		atomic_store(&profiler.alive, false);
+		pthread_join(profiler.thread, NULL);
+		profiler.running = false;
+		if (lua_gethook(L) == profile_hook)
+			lua_sethook(L, NULL, 0, 0);
+	}
+
+	if (!interval_us)
+		return true;
+
+	profiler.L = L;
+	profiler.interval = interval_us;
+	profiler.depth = depth;
+	atomic_store(&profiler.armed, 0);
+	atomic_store(&profiler.alive, true);
+
+	if (0 != pthread_create(&profiler.thread, NULL, profile_thread, NULL)){
+		atomic_store(&profiler.alive, false);
+		return false;
+	}
+
+	profiler.running = true;
+	return true;
+}
@@ -30,3 +30,11 @@ char* alt_trace_crash_source(void);
  * append the lua VM call backtrace to [out]
  */
 void alt_trace_callstack(lua_State* ctx, FILE* out);
+
+/*
+ * start (or with [interval_us] = 0, stop) sampling the lua call stack into
+ * the active trace buffer. A timer thread arms a one-shot debug hook every
+ * [interval_us] and the hook records up to [depth] frames as a 'sample'
+ * mark, so script hotspots end up on the same timeline as engine marks.
+ */
+bool alt_trace_profile(lua_State* ctx, size_t interval_us, size_t depth);
@@ -14,6 +14,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <inttypes.h>
+#include <float.h>
 
 #include <assert.h>
 
@@ -37,6 +38,9 @@ struct camtag_data {
 	float line_width;
 	enum agp_mesh_flags flags;
 	struct arcan_vr_ctx* vrref;
+
+/* second camera drawn in the same pass (side by side stereo) */
+	arcan_vobj_id stereo;
 };
 
 struct geometry {
@@ -48,10 +52,40 @@ struct geometry {
 	bool complete;
 	bool threaded;
 
+/* source of a packed mesh, refinements from it replace the store */
+	uintptr_t tag;
+
 	pthread_t worker;
 	struct geometry* next;
 };
 
+/* models keep lag-one occlusion query state per camera that sees them,
+ * a VR setup needs at least one per eye */
+#define OCCLUSION_SLOTS 4
+
+struct occlusion_slot {
+	arcan_vobj_id camera;
+	unsigned query;
+	bool pending;
+	bool visible;
+};
+
+/* built by a camera pass when video_3d_culling is set */
+struct cull_ctx {
+	_Alignas(16) float frustum[6][4];
+	arcan_vobj_id camera;
+	bool occlusion;
+};
+
+/* a camera pass draws each model once per eye, side by side when stereo */
+#define MAX_EYES 2
+
+struct eye {
+	_Alignas(16) float view[16];
+	float* projection;
+	struct cull_ctx* cull;
+};
+
 typedef struct {
 	pthread_mutex_t lock;
 	int work_count;
@@ -63,6 +97,18 @@ typedef struct {
 	vector bbmax;
 	float radius;
 
+/* tight model-space bounds of the current geometry, [bbmin, bbmax] are only
+ * guaranteed to cover it. Resolved on first use after the vertices change,
+ * usable is false for skinned geometry where the shader moves vertices */
+	struct {
+		vector min;
+		vector max;
+		bool valid;
+		bool usable;
+	} cull;
+
+	struct occlusion_slot occlusion[OCCLUSION_SLOTS];
+
 /* position, opacity etc. are inherited from parent */
 	struct {
 /* debug geometry (position, normals, bounding box, ...) */
@@ -156,6 +202,9 @@ static void freemodel(arcan_3dmodel* src)
 		src->vrref = NULL;
 	}
 
+	for (size_t i = 0; i < OCCLUSION_SLOTS; i++)
+		agp_occlusion_free(src->occlusion[i].query);
+
 	struct geometry* geom = src->geometry;
 
 /* always make sure the model is loaded before freeing */
@@ -252,12 +301,203 @@ matr[2], matr[6], matr[10], matr[14],
 matr[3], matr[7], matr[11], matr[15]);
 }
 
+/*
+ * Culling, only active when a camera pass provides a cull_ctx
+ */
+static void minmax_verts(vector* minp, vector* maxp,
+	const float* verts, unsigned nverts, size_t step);
+
+/* floats between two vertex positions, packed meshes are interleaved */
+static size_t vertex_step(struct agp_mesh_store* store)
+{
+	return store->stride ? store->stride / sizeof(float) : 3;
+}
+
+static void update_bounds(arcan_3dmodel* src)
+{
+	src->cull.valid = true;
+	src->cull.usable = false;
+
+	vector bbmin = {.x =  FLT_MAX, .y =  FLT_MAX, .z =  FLT_MAX};
+	vector bbmax = {.x = -FLT_MAX, .y = -FLT_MAX, .z = -FLT_MAX};
+	size_t count = 0;
+
+/* skinned geometry is placed by the shader, we don't know where it ends up */
+	for (struct geometry* geom = src->geometry; geom; geom = geom->next){
+		if (geom->store.joints || geom->store.weights ||
+			geom->store.vertex_size != 3 || !geom->store.verts)
+			return;
+
+		minmax_verts(&bbmin, &bbmax, geom->store.verts,
+			geom->store.n_vertices, vertex_step(&geom->store));
+		count += geom->store.n_vertices;
+	}
+
+	if (!count)
+		return;
+
+	src->cull.min = bbmin;
+	src->cull.max = bbmax;
+	src->cull.usable = true;
+}
+
+static struct occlusion_slot* occlusion_slot(
+	arcan_3dmodel* src, arcan_vobj_id camera, bool alloc)
+{
+	struct occlusion_slot* slot = NULL;
+
+	for (size_t i = 0; i < OCCLUSION_SLOTS; i++){
+		if (src->occlusion[i].query && src->occlusion[i].camera == camera)
+			return &src->occlusion[i];
+		if (!src->occlusion[i].query && !slot)
+			slot = &src->occlusion[i];
+	}
+
+	if (!alloc)
+		return NULL;
+
+/* more cameras than slots, recycle the query rather than grow */
+	unsigned query;
+	if (!slot){
+		slot = &src->occlusion[(size_t) camera % OCCLUSION_SLOTS];
+		query = slot->query;
+	}
+	else if (!(query = agp_occlusion_alloc()))
+		return NULL;
+
+	*slot = (struct occlusion_slot){
+		.camera = camera,
+		.query = query,
+		.visible = true
+	};
+
+	return slot;
+}
+
+/* unit cube used as a stand-in when testing if an occluded model is back */
+static float proxy_verts[] = {
+	0.0, 0.0, 0.0,  1.0, 0.0, 0.0,  1.0, 1.0, 0.0,  0.0, 1.0, 0.0,
+	0.0, 0.0, 1.0,  1.0, 0.0, 1.0,  1.0, 1.0, 1.0,  0.0, 1.0, 1.0
+};
+
+static unsigned proxy_indices[] = {
+	0, 1, 2,  0, 2, 3,  4, 6, 5,  4, 7, 6,
+	0, 3, 7,  0, 7, 4,  1, 5, 6,  1, 6, 2,
+	0, 4, 5,  0, 5, 1,  3, 2, 6,  3, 6, 7
+};
+
+static struct agp_mesh_store proxy_box = {
+	.verts = proxy_verts,
+	.indices = proxy_indices,
+	.vertex_size = 3,
+	.n_vertices = 8,
+	.n_indices = 36,
+	.type = AGP_MESH_TRISOUP
+};
+
+static void draw_proxy(float* view, float c[3], float e[3], unsigned query)
+{
+	float _Alignas(16) box[16] = {
+		2.0 * e[0], 0.0, 0.0, 0.0,
+		0.0, 2.0 * e[1], 0.0, 0.0,
+		0.0, 0.0, 2.0 * e[2], 0.0,
+		c[0] - e[0], c[1] - e[1], c[2] - e[2], 1.0
+	};
+	float _Alignas(16) out[16];
+	multiply_matrix(out, view, box);
+
+	agp_shader_activate(agp_default_shader(BASIC_3D));
+	agp_shader_envv(MODELVIEW_MATR, out, sizeof(float) * 16);
+
+	agp_occlusion_begin(query, true);
+	agp_submit_mesh(&proxy_box, MESH_FACING_BOTH);
+	agp_occlusion_end();
+}
+
+/*
+ * Test the world-space bounds of a model against the camera frustum and, if
+ * enabled, against the last occlusion query result for the camera. Returns
+ * false if the model can be skipped. When [qslot] is set, a query is active
+ * and the caller should agp_occlusion_end() after submitting the model.
+ *
+ * The queries are collected the frame after they are issued, so a model that
+ * becomes visible again is drawn one frame late and only models earlier in
+ * the pipeline count as occluders.
+ */
+static bool cull_model(arcan_3dmodel* src, float* model, float* view,
+	struct cull_ctx* cull, struct occlusion_slot** qslot)
+{
+	if (!src->cull.valid)
+		update_bounds(src);
+
+	if (!src->cull.usable)
+		return true;
+
+/* transform center and extents rather than all eight corners, the result
+ * covers the rotated box */
+	vector lc = mul_vectorf(add_vector(src->cull.min, src->cull.max), 0.5);
+	vector le = mul_vectorf(sub_vector(src->cull.max, src->cull.min), 0.5);
+	float c[3], e[3];
+
+	for (size_t i = 0; i < 3; i++){
+		c[i] = model[12+i] +
+			model[i] * lc.x + model[4+i] * lc.y + model[8+i] * lc.z;
+		e[i] = fabsf(model[i]) * le.x +
+			fabsf(model[4+i]) * le.y + fabsf(model[8+i]) * le.z;
+	}
+
+	if (frustum_aabb((const float (*)[4]) cull->frustum,
+		c[0] - e[0], c[1] - e[1], c[2] - e[2],
+		c[0] + e[0], c[1] + e[1], c[2] + e[2]) == outside){
+
+/* whatever is pending is stale by the time the model is back in view */
+		struct occlusion_slot* slot = occlusion_slot(src, cull->camera, false);
+		if (slot){
+			slot->pending = false;
+			slot->visible = true;
+		}
+		return false;
+	}
+
+	if (!cull->occlusion)
+		return true;
+
+/* reaching the near plane would clip the proxy, and the camera might well be
+ * inside the box, so don't trust a query there */
+	const float* np = cull->frustum[4];
+	if (np[0] * c[0] + np[1] * c[1] + np[2] * c[2] + np[3] -
+		(fabsf(np[0]) * e[0] + fabsf(np[1]) * e[1] + fabsf(np[2]) * e[2]) <= 0.0)
+		return true;
+
+	struct occlusion_slot* slot = occlusion_slot(src, cull->camera, true);
+	if (!slot)
+		return true;
+
+	if (slot->pending){
+		int res = agp_occlusion_result(slot->query);
+		if (-1 == res)
+			return slot->visible;
+
+		slot->visible = res == 1;
+	}
+
+	slot->pending = true;
+	if (slot->visible){
+		agp_occlusion_begin(slot->query, false);
+		*qslot = slot;
+		return true;
+	}
+
+	draw_proxy(view, c, e, slot->query);
+	return false;
+}
+
 /*
  * Render-loops, Pass control, Initialization
  */
 static void rendermodel(arcan_vobject* vobj, arcan_3dmodel* src,
-	agp_shader_id baseprog, surface_properties props, float* view,
-	enum agp_mesh_flags flags)
+	agp_shader_id baseprog, surface_properties props,
+	struct eye* eyes, size_t n_eyes, enum agp_mesh_flags flags)
 {
 	assert(vobj);
 
@@ -292,10 +532,25 @@ static void rendermodel(arcan_vobject* vobj, arcan_3dmodel* src,
 		props.position.z - oz
 	);
 
-	float _Alignas(16) out[16];
-	multiply_matrix(out, view, model);
+/* only mono passes use occlusion queries, so there is at most one */
+	struct occlusion_slot* query = NULL;
+	float _Alignas(16) out[MAX_EYES][16];
+	bool draw[MAX_EYES];
+	size_t visible = 0;
+
+	for (size_t i = 0; i < n_eyes; i++){
+		draw[i] = !eyes[i].cull ||
+			cull_model(src, model, eyes[i].view, eyes[i].cull, &query);
+
+		if (draw[i]){
+			multiply_matrix(out[i], eyes[i].view, model);
+			visible++;
+		}
+	}
+
+	if (!visible)
+		return;
 
-	agp_shader_envv(MODELVIEW_MATR, out, sizeof(float) * 16);
 	agp_shader_envv(OBJ_OPACITY, &props.opa, sizeof(float));
 
 	struct geometry* base = src->geometry;
@@ -325,10 +580,24 @@ static void rendermodel(arcan_vobject* vobj, arcan_3dmodel* src,
 				;
 		}
 
-		agp_shader_envv(MODELVIEW_MATR, out, sizeof(float) * 16);
-		agp_submit_mesh(&base->store, flags);
+/* the program and stores stay bound, only the view changes between eyes */
+		for (size_t i = 0; i < n_eyes; i++){
+			if (!draw[i])
+				continue;
+
+			if (n_eyes > 1){
+				agp_rendertarget_subview(i, n_eyes);
+				agp_shader_envv(PROJECTION_MATR, eyes[i].projection, sizeof(float) * 16);
+			}
+
+			agp_shader_envv(MODELVIEW_MATR, out[i], sizeof(float) * 16);
+			agp_submit_mesh(&base->store, flags);
+		}
 		base = base->next;
 	}
+
+	if (query)
+		agp_occlusion_end();
 }
 
 enum arcan_ffunc_rv arcan_ffunc_3dobj FFUNC_HEAD
@@ -366,7 +635,7 @@ enum arcan_ffunc_rv arcan_ffunc_3dobj FFUNC_HEAD
 /* normal scene process, except stops after no objects with infinite
  * flag (skybox, skygeometry etc.) */
 static arcan_vobject_litem* process_scene_infinite(
-	arcan_vobject_litem* cell, float lerp, float* view,
+	arcan_vobject_litem* cell, float lerp, struct eye* eyes, size_t n_eyes,
 	enum agp_mesh_flags flags)
 {
 	arcan_vobject_litem* current = cell;
@@ -396,8 +665,8 @@ static arcan_vobject_litem* process_scene_infinite(
 		surface_properties dprops;
 
 		arcan_resolve_vidprop(cvo, lerp, &dprops);
-		rendermodel(cvo,
-			obj3d, cvo->program, dprops, view, flags | MESH_FACING_NODEPTH);
+		rendermodel(cvo, obj3d, cvo->program,
+			dprops, eyes, n_eyes, flags | MESH_FACING_NODEPTH);
 
 		current = current->next;
 	}
@@ -406,7 +675,7 @@ static arcan_vobject_litem* process_scene_infinite(
 }
 
 static void process_scene_normal(arcan_vobject_litem* cell,
-	float lerp, float* modelview, enum agp_mesh_flags flags)
+	float lerp, struct eye* eyes, size_t n_eyes, enum agp_mesh_flags flags)
 {
 	arcan_vobject_litem* current = cell;
 	struct rendertarget* rtgt = arcan_vint_current_rt();
@@ -439,7 +708,7 @@ static void process_scene_normal(arcan_vobject_litem* cell,
 			dprops = cvo->current;
 		else
 			arcan_resolve_vidprop(cvo, lerp, &dprops);
-		rendermodel(cvo, model, cvo->program, dprops, modelview, flags);
+		rendermodel(cvo, model, cvo->program, dprops, eyes, n_eyes, flags);
 
 		current = current->next;
 	}
@@ -509,6 +778,31 @@ bool arcan_3d_obj_bb_intersect(arcan_vobj_id cam,
 		&model->current.position, rad, &d1, &d2);
 }
 
+/* view matrix for a camera, without the translation so that infinite
+ * geometry can be drawn first */
+static void camera_view(arcan_vobject* camobj,
+	struct camtag_data* camera, float fract, float* view, vector* pos)
+{
+	float _Alignas(16) matr[16];
+	float _Alignas(16) omatr[16];
+
+	surface_properties dprop;
+	arcan_resolve_vidprop(camobj, fract, &dprop);
+	if (camera->vrref){
+		dprop.rotation = camobj->current.rotation;
+	}
+
+/* scale */
+	identity_matrix(matr);
+	scale_matrix(matr, dprop.scale.x, dprop.scale.y, dprop.scale.z);
+
+/* rotate */
+	matr_quatf(norm_quat(dprop.rotation.quaternion), omatr);
+	multiply_matrix(view, matr, omatr);
+
+	*pos = dprop.position;
+}
+
 /* Chained to the video-pass in arcan_video, stop at the
  * first non-negative order value */
 arcan_vobject_litem* arcan_3d_refresh(arcan_vobj_id camtag,
@@ -520,52 +814,77 @@ arcan_vobject_litem* arcan_3d_refresh(arcan_vobj_id camtag,
 		return cell;
 
 	struct camtag_data* camera = camobj->feed.state.ptr;
-	float _Alignas(16) matr[16];
-	float _Alignas(16) dmatr[16];
-	float _Alignas(16) omatr[16];
+	if (camera->vrref)
+		arcan_vr_latch(camera->vrref);
+
+	struct camtag_data* cameras[MAX_EYES] = {camera};
+	arcan_vobj_id camids[MAX_EYES] = {camtag};
+	struct eye eyes[MAX_EYES];
+	vector pos[MAX_EYES];
+	size_t n_eyes = 1;
 
 	agp_pipeline_hint(PIPELINE_3D);
 	agp_render_options((struct agp_render_options){
 		.line_width = camera->line_width
 	});
 
-	surface_properties dprop;
-	arcan_resolve_vidprop(camobj, fract, &dprop);
-	if (camera->vrref){
-		dprop.rotation = camobj->current.rotation;
-	}
-
 	agp_shader_activate(agp_default_shader(BASIC_3D));
 	agp_shader_envv(PROJECTION_MATR, camera->projection, sizeof(float) * 16);
 
-/* scale */
-	identity_matrix(matr);
-	scale_matrix(matr, dprop.scale.x, dprop.scale.y, dprop.scale.z);
+	camera_view(camobj, camera, fract, eyes[0].view, &pos[0]);
+
+/* the paired eye may have been deleted, or the id reused for something else */
+	arcan_vobject* eyeobj = camera->stereo != ARCAN_EID ?
+		arcan_video_getobject(camera->stereo) : NULL;
+
+	if (eyeobj &&
+		eyeobj->feed.state.tag == ARCAN_TAG_3DCAMERA && eyeobj->feed.state.ptr){
+		cameras[1] = eyeobj->feed.state.ptr;
+		camids[1] = camera->stereo;
+		camera_view(eyeobj, cameras[1], fract, eyes[1].view, &pos[1]);
+		n_eyes = 2;
+	}
+
+	for (size_t i = 0; i < n_eyes; i++){
+		eyes[i].projection = cameras[i]->projection;
+		eyes[i].cull = NULL;
+	}
 
-/* rotate */
-	matr_quatf(norm_quat(dprop.rotation.quaternion), omatr);
-	multiply_matrix(dmatr, matr, omatr);
 	arcan_3dmodel* obj3d = cell->elem->feed.state.ptr;
 
 /* "infinite geometry" (skybox) */
 	if (obj3d->flags.infinite)
-		cell = process_scene_infinite(cell, fract, dmatr, camera->flags);
+		cell = process_scene_infinite(cell, fract, eyes, n_eyes, camera->flags);
 
 /* object translate */
-	struct camtag_data* cdata = camobj->feed.state.ptr;
-	cdata->wpos = dprop.position;
-	translate_matrix(dmatr, dprop.position.x, dprop.position.y, dprop.position.z);
-	memcpy(cdata->mvm, dmatr, sizeof(float) * 16);
+	struct cull_ctx cull[MAX_EYES];
+	for (size_t i = 0; i < n_eyes; i++){
+		translate_matrix(eyes[i].view, pos[i].x, pos[i].y, pos[i].z);
+		cameras[i]->wpos = pos[i];
+		memcpy(cameras[i]->mvm, eyes[i].view, sizeof(float) * 16);
+
+/* queries are kept per camera but wrap all geometry of a model, which the
+ * interleaved stereo submission doesn't allow for */
+		if (arcan_video_display.cull_3d){
+			update_frustum(eyes[i].projection, eyes[i].view, cull[i].frustum);
+			cull[i].camera = camids[i];
+			cull[i].occlusion = arcan_video_display.occlusion_3d && n_eyes == 1;
+			eyes[i].cull = &cull[i];
+		}
+	}
+
+	process_scene_normal(cell, fract, eyes, n_eyes, camera->flags);
 
-	process_scene_normal(cell, fract, dmatr, camera->flags);
+	if (n_eyes > 1)
+		agp_rendertarget_subview(0, 0);
 
 	return cell;
 }
 
 static void minmax_verts(vector* minp, vector* maxp,
-	const float* verts, unsigned nverts)
+	const float* verts, unsigned nverts, size_t step)
 {
-	for (size_t i = 0; i < nverts * 3; i += 3){
+	for (size_t i = 0; i < nverts * step; i += step){
 		vector a = {.x = verts[i], .y = verts[i+1], .z = verts[i+2]};
 		if (a.x < minp->x) minp->x = a.x;
 		if (a.y < minp->y) minp->y = a.y;
@@ -600,7 +919,15 @@ arcan_errc arcan_3d_swizzlemodel(arcan_vobj_id dst)
 
 	struct geometry* curr = model->geometry;
 	while (curr) {
-		if (curr->store.indices){
+		if (curr->store.indices && curr->store.index_size == 2){
+			uint16_t* indices = (uint16_t*) curr->store.indices;
+			for (size_t i = 0; i < curr->store.n_indices; i+= 3){
+				uint16_t iv = indices[i];
+				indices[i] = indices[i+2];
+				indices[i+2] = iv;
+			}
+		}
+		else if (curr->store.indices){
 			unsigned* indices = curr->store.indices;
 			for (size_t i = 0; i <curr->store.n_indices; i+= 3){
 				unsigned iv = indices[i];
@@ -625,7 +952,7 @@ arcan_errc arcan_3d_swizzlemodel(arcan_vobj_id dst)
 	return rv;
 }
 
-arcan_vobj_id arcan_3d_pointcloud(size_t count, size_t nmaps)
+arcan_vobj_id arcan_3d_pointcloud(size_t count, size_t nmaps, size_t width)
 {
 	if (count == 0)
 		return ARCAN_EID;
@@ -645,23 +972,36 @@ arcan_vobj_id arcan_3d_pointcloud(size_t count, size_t nmaps)
 
 	newmodel->geometry = arcan_alloc_mem(sizeof(struct geometry), ARCAN_MEM_VTAG,
 		ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
-	newmodel->geometry->store.n_vertices = count;
-	newmodel->geometry->store.vertex_size = 3;
-	newmodel->geometry->nmaps = nmaps;
-	newmodel->geometry->store.verts = arcan_alloc_mem(sizeof(float) * count * 3,
-		ARCAN_MEM_MODELDATA, 0, ARCAN_MEMALIGN_PAGE);
-	newmodel->geometry->store.txcos = arcan_alloc_mem(sizeof(float) * count * 2,
+
+/* one buffer [verts | colors | txcos] so that the store can be streamed */
+	struct agp_mesh_store* store = &newmodel->geometry->store;
+	size_t buf_sz = sizeof(float) * count * (3 + 4 + 2);
+	float* dbuf = arcan_alloc_mem(buf_sz,
 		ARCAN_MEM_MODELDATA, 0, ARCAN_MEMALIGN_PAGE);
 
+	store->shared_buffer = (uint8_t*) dbuf;
+	store->shared_buffer_sz = buf_sz;
+	store->verts = dbuf;
+	store->colors = &dbuf[count * 3];
+	store->txcos = &dbuf[count * 7];
+	store->fmt.n_colors = 4;
+	store->n_vertices = count;
+	store->vertex_size = 3;
+	store->stream = true;
+	newmodel->geometry->nmaps = nmaps;
+
 	float step = 2.0f / sqrtf(count);
+	size_t rows = width ? (count + width - 1) / width : 0;
 
 	float cz = -1;
 	float cx = -1;
-	float* dbuf = newmodel->geometry->store.verts;
-	float* tbuf = newmodel->geometry->store.txcos;
+	float* cbuf = store->colors;
+	float* tbuf = store->txcos;
 
-/* evenly distribute texture coordinates, randomly distribute vertices */
-	while(count--){
+/* evenly distribute texture coordinates, randomly distribute vertices. With
+ * a [width], the coordinates hit the texel centers of a width * rows map so
+ * that a vertex shader can look up per-point data */
+	for (size_t i = 0; i < count; i++){
 		cx = cx + step;
 		if (cx > 1){
 			cx = -1;
@@ -675,8 +1015,19 @@ arcan_vobj_id arcan_3d_pointcloud(size_t count, size_t nmaps)
 		*dbuf++ = x;
 		*dbuf++ = y;
 		*dbuf++ = z;
-		*tbuf++ = (cx + 1.0) / 2.0;
-		*tbuf++ = (cz + 1.0) / 2.0;
+		*cbuf++ = 1.0;
+		*cbuf++ = 1.0;
+		*cbuf++ = 1.0;
+		*cbuf++ = 1.0;
+
+		if (width){
+			*tbuf++ = ((float)(i % width) + 0.5) / (float) width;
+			*tbuf++ = ((float)(i / width) + 0.5) / (float) rows;
+		}
+		else {
+			*tbuf++ = (cx + 1.0) / 2.0;
+			*tbuf++ = (cz + 1.0) / 2.0;
+		}
 	}
 
 	newmodel->radius = 1.0;
@@ -687,12 +1038,50 @@ arcan_vobj_id arcan_3d_pointcloud(size_t count, size_t nmaps)
 	newmodel->bbmax = bbmax;
 	newmodel->flags.complete = true;
 	newmodel->flags.debug = true;
-	newmodel->geometry->nmaps = nmaps;
 	newmodel->geometry->store.type = AGP_MESH_POINTCLOUD;
 
 	return rv;
 }
 
+arcan_errc arcan_3d_pointcloud_update(arcan_vobj_id id,
+	size_t ofs, size_t count, const float* pos, const float* col)
+{
+	arcan_vobject* vobj = arcan_video_getobject(id);
+	if (!vobj)
+		return ARCAN_ERRC_NO_SUCH_OBJECT;
+
+	if (vobj->feed.state.tag != ARCAN_TAG_3DOBJ)
+		return ARCAN_ERRC_UNACCEPTED_STATE;
+
+	arcan_3dmodel* model = vobj->feed.state.ptr;
+	struct agp_mesh_store* store = &model->geometry->store;
+	if (store->type != AGP_MESH_POINTCLOUD || !store->colors ||
+		ofs >= store->n_vertices)
+		return ARCAN_ERRC_BAD_ARGUMENT;
+
+	if (count > store->n_vertices - ofs)
+		count = store->n_vertices - ofs;
+
+	if (pos){
+		memcpy(&store->verts[ofs * 3], pos, sizeof(float) * count * 3);
+		agp_invalidate_mesh_range(store,
+			(uint8_t*) &store->verts[ofs * 3] - store->shared_buffer,
+			sizeof(float) * count * 3
+		);
+		model->cull.valid = false;
+	}
+
+	if (col){
+		memcpy(&store->colors[ofs * 4], col, sizeof(float) * count * 4);
+		agp_invalidate_mesh_range(store,
+			(uint8_t*) &store->colors[ofs * 4] - store->shared_buffer,
+			sizeof(float) * count * 4
+		);
+	}
+
+	return ARCAN_OK;
+}
+
 arcan_vobj_id arcan_3d_buildcylinder(float r,
 	float hh, size_t steps, size_t nmaps, int fill_mode)
 {
@@ -1166,7 +1555,7 @@ arcan_vobj_id arcan_3d_buildplane(
  * or iterate, plan is to possibly add transform / lookup functions
  * during creation step, so this is a precaution */
 	minmax_verts(&newmodel->bbmin, &newmodel->bbmax,
-			dst->store.verts, dst->store.n_vertices);
+			dst->store.verts, dst->store.n_vertices, 3);
 	dst->complete = true;
 	newmodel->flags.complete = true;
 
@@ -1269,56 +1658,168 @@ arcan_errc arcan_3d_addraw(arcan_vobj_id dst,
 	return ARCAN_OK;
 }
 
-arcan_errc arcan_3d_addmesh(arcan_vobj_id dst,
-	data_source resource, unsigned nmaps)
+static uint8_t packed_fmt(uint8_t fmt)
 {
-	arcan_vobject* vobj = arcan_video_getobject(dst);
+	switch (fmt){
+	case SHMIF_MESH_S16N: return AGP_VFMT_S16N;
+	case SHMIF_MESH_U16N: return AGP_VFMT_U16N;
+	case SHMIF_MESH_S8N: return AGP_VFMT_S8N;
+	case SHMIF_MESH_U8N: return AGP_VFMT_U8N;
+	default:
+		return AGP_VFMT_F32;
+	}
+}
 
-	if (!vobj)
-		return ARCAN_ERRC_NO_SUCH_OBJECT;
+/* point the store into the packed mesh at the level of detail [lod], the
+ * layout is drawn from as is, so nothing gets converted or copied here */
+static bool packed_store(struct agp_mesh_store* store, uint8_t* buf, int lod)
+{
+	const struct shmif_mesh_header* hdr = (struct shmif_mesh_header*) buf;
+	const struct shmif_mesh_attrib* attr = hdr->attr;
+
+/* the culling and scaling needs positions as plain float triplets */
+	if (attr[SHMIF_MESH_POSITION].fmt != SHMIF_MESH_F32 ||
+		attr[SHMIF_MESH_POSITION].components != 3 ||
+		(attr[SHMIF_MESH_NORMAL].fmt && attr[SHMIF_MESH_NORMAL].components < 3) ||
+		(attr[SHMIF_MESH_TXCOS].fmt && attr[SHMIF_MESH_TXCOS].components < 2) ||
+		(attr[SHMIF_MESH_COLOR].fmt && attr[SHMIF_MESH_COLOR].components < 3))
+		return false;
 
-	arcan_3dmodel* model = vobj->feed.state.ptr;
+	const struct shmif_mesh_lod* lods =
+		(struct shmif_mesh_lod*)(buf + hdr->ofs_lods);
+
+	if (lod < 0 || lod >= hdr->n_lods)
+		lod = hdr->n_lods - 1;
+
+	const struct shmif_mesh_lod* level = &lods[lod];
+	uint8_t* vbase = buf + hdr->ofs_vertices;
+
+	*store = (struct agp_mesh_store){
+		.shared_buffer = buf,
+		.shared_buffer_sz = hdr->data_sz,
+		.type = AGP_MESH_TRISOUP,
+		.verts = (float*)(vbase + attr[SHMIF_MESH_POSITION].offset),
+		.indices = (unsigned*)(buf +
+			hdr->ofs_indices + (size_t) level->index_ofs * hdr->index_size),
+		.vertex_size = 3,
+		.n_vertices = level->n_vertices,
+		.n_indices = level->n_indices,
+		.stride = hdr->stride,
+		.index_size = hdr->index_size,
+		.validated = true
+	};
 
-	if (1 ||
-		vobj->feed.state.tag != ARCAN_TAG_3DOBJ ||
-		model->flags.complete == true)
-		return ARCAN_ERRC_UNACCEPTED_STATE;
+	if (attr[SHMIF_MESH_NORMAL].fmt){
+		store->normals = (float*)(vbase + attr[SHMIF_MESH_NORMAL].offset);
+		store->fmt.normals = packed_fmt(attr[SHMIF_MESH_NORMAL].fmt);
+	}
 
-/*
- * commented out for now until we can add the model parsing to fsrv_decode
- *
-	struct threadarg* arg = arcan_alloc_mem(sizeof(struct threadarg),
-		ARCAN_MEM_THREADCTX, 0, ARCAN_MEMALIGN_NATURAL);
-
-	arg->model = model;
-	arg->resource = resource;
-	arg->readofs = 0;
-	arg->datamap = arcan_map_resource(&arg->resource, false);
-	if (arg->datamap.ptr == NULL){
-		arcan_mem_free(arg);
-		return ARCAN_ERRC_BAD_RESOURCE;
+	if (attr[SHMIF_MESH_TXCOS].fmt){
+		store->txcos = (float*)(vbase + attr[SHMIF_MESH_TXCOS].offset);
+		store->fmt.txcos = packed_fmt(attr[SHMIF_MESH_TXCOS].fmt);
 	}
 
-	struct geometry** nextslot = &(model->geometry);
-	while (*nextslot)
-		nextslot = &((*nextslot)->next);
+	if (attr[SHMIF_MESH_COLOR].fmt){
+		store->colors = (float*)(vbase + attr[SHMIF_MESH_COLOR].offset);
+		store->fmt.colors = packed_fmt(attr[SHMIF_MESH_COLOR].fmt);
+		store->fmt.n_colors = attr[SHMIF_MESH_COLOR].components;
+	}
 
-	*nextslot = arcan_alloc_mem(sizeof(struct geometry), ARCAN_MEM_VTAG,
-		ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	return true;
+}
 
-	(*nextslot)->nmaps = nmaps;
-	(*nextslot)->store.type = AGP_MESH_TRISOUP;
+arcan_errc arcan_3d_addpacked(arcan_vobj_id dst,
+	uint8_t* buf, size_t buf_sz, unsigned nmaps, int lod, uintptr_t tag)
+{
+	arcan_vobject* vobj = arcan_video_getobject(dst);
+	arcan_errc rv = ARCAN_OK;
+
+	if (!vobj){
+		rv = ARCAN_ERRC_NO_SUCH_OBJECT;
+		goto out;
+	}
 
-	arg->geom = *nextslot;
+	if (vobj->feed.state.tag != ARCAN_TAG_3DOBJ){
+		rv = ARCAN_ERRC_UNACCEPTED_STATE;
+		goto out;
+	}
+
+	struct agp_mesh_store store;
+	if (!shmif_mesh_validate(buf, buf_sz) || !packed_store(&store, buf, lod)){
+		rv = ARCAN_ERRC_BAD_RESOURCE;
+		goto out;
+	}
 
+	arcan_3dmodel* model = vobj->feed.state.ptr;
 	pthread_mutex_lock(&model->lock);
-	model->work_count++;
-	pthread_mutex_unlock(&model->lock);
 
-	arg->geom->threaded = true;
-*/
+/* a refinement of a mesh from the same source replaces the store in place,
+ * this is also permitted after the model has been finalized */
+	struct geometry** nextslot = &(model->geometry);
+	while (*nextslot){
+		if (tag && (*nextslot)->tag == tag)
+			break;
+		nextslot = &((*nextslot)->next);
+	}
 
+	if (*nextslot){
+		agp_drop_mesh(&(*nextslot)->store);
+	}
+	else if (model->flags.complete){
+		pthread_mutex_unlock(&model->lock);
+		rv = ARCAN_ERRC_UNACCEPTED_STATE;
+		goto out;
+	}
+	else {
+		*nextslot = arcan_alloc_mem(sizeof(struct geometry),
+			ARCAN_MEM_VTAG, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+			ARCAN_MEMALIGN_NATURAL);
+
+		if (!*nextslot){
+			pthread_mutex_unlock(&model->lock);
+			rv = ARCAN_ERRC_OUT_OF_SPACE;
+			goto out;
+		}
+		(*nextslot)->nmaps = nmaps;
+		(*nextslot)->tag = tag;
+	}
+
+	(*nextslot)->store = store;
+	(*nextslot)->complete = true;
+	model->cull.valid = false;
+	pthread_mutex_unlock(&model->lock);
 	return ARCAN_OK;
+
+out:
+	arcan_mem_free(buf);
+	return rv;
+}
+
+arcan_errc arcan_3d_addmesh(arcan_vobj_id dst,
+	data_source resource, unsigned nmaps)
+{
+	map_region map = arcan_map_resource(&resource, false);
+	if (!map.ptr)
+		return ARCAN_ERRC_BAD_RESOURCE;
+
+/* the resource map is read-only and swizzle/scale work in place, and the
+ * header size check keeps the copy from being made for non-mesh files */
+	uint8_t* buf = NULL;
+	if (map.sz >= sizeof(struct shmif_mesh_header) &&
+		((struct shmif_mesh_header*) map.u8)->magic == SHMIF_MESH_MAGIC){
+		buf = arcan_alloc_mem(map.sz,
+			ARCAN_MEM_MODELDATA, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_SIMD);
+		if (buf)
+			memcpy(buf, map.u8, map.sz);
+	}
+
+	size_t buf_sz = map.sz;
+	arcan_release_map(map);
+
+	if (!buf)
+		return ARCAN_ERRC_BAD_RESOURCE;
+
+	return arcan_3d_addpacked(dst, buf, buf_sz, nmaps, -1, 0);
 }
 
 arcan_errc arcan_3d_scalevertices(arcan_vobj_id vid)
@@ -1344,7 +1845,7 @@ arcan_errc arcan_3d_scalevertices(arcan_vobj_id vid)
 
 	while (geom){
 		minmax_verts(&dst->bbmin, &dst->bbmax,
-				geom->store.verts, geom->store.n_vertices);
+				geom->store.verts, geom->store.n_vertices, vertex_step(&geom->store));
 		geom = geom->next;
 	}
 
@@ -1374,7 +1875,8 @@ arcan_errc arcan_3d_scalevertices(arcan_vobj_id vid)
 	dst->bbmax.z += tz; dst->bbmin.z += tz;
 
 	while(geom){
-		for (unsigned i = 0; i < geom->store.n_vertices * 3; i += 3){
+		size_t step = vertex_step(&geom->store);
+		for (unsigned i = 0; i < geom->store.n_vertices * step; i += step){
 			geom->store.verts[i]   = tx + geom->store.verts[i]   * sf;
 			geom->store.verts[i+1] = ty + geom->store.verts[i+1] * sf;
 			geom->store.verts[i+2] = tz + geom->store.verts[i+2] * sf;
@@ -1383,6 +1885,7 @@ arcan_errc arcan_3d_scalevertices(arcan_vobj_id vid)
 		geom = geom->next;
 	}
 
+	dst->cull.valid = false;
 	pthread_mutex_unlock(&dst->lock);
 	return ARCAN_OK;
 }
@@ -1488,6 +1991,7 @@ arcan_errc arcan_3d_baseorient(arcan_vobj_id dst,
 		geom = geom->next;
 	}
 
+	model->cull.valid = false;
 	pthread_mutex_unlock(&model->lock);
 	return ARCAN_OK;
 }
@@ -1506,6 +2010,50 @@ arcan_errc arcan_3d_camproj(arcan_vobj_id vid, float proj[static 16])
 	return ARCAN_OK;
 }
 
+arcan_errc arcan_3d_camstereo(arcan_vobj_id vid, arcan_vobj_id eye)
+{
+	arcan_vobject* vobj = arcan_video_getobject(vid);
+	if (!vobj)
+		return ARCAN_ERRC_NO_SUCH_OBJECT;
+
+	if (vobj->feed.state.tag != ARCAN_TAG_3DCAMERA)
+		return ARCAN_ERRC_UNACCEPTED_STATE;
+
+	struct camtag_data* camera = vobj->feed.state.ptr;
+	if (eye == ARCAN_EID){
+		camera->stereo = ARCAN_EID;
+		return ARCAN_OK;
+	}
+
+	if (eye == vid)
+		return ARCAN_ERRC_BAD_ARGUMENT;
+
+	arcan_vobject* eobj = arcan_video_getobject(eye);
+	if (!eobj)
+		return ARCAN_ERRC_NO_SUCH_OBJECT;
+
+/* untagged eye inherits the parameters of the primary camera */
+	if (eobj->feed.state.tag != ARCAN_TAG_3DCAMERA){
+		if (eobj->feed.state.ptr)
+			return ARCAN_ERRC_UNACCEPTED_STATE;
+
+		struct camtag_data* ecam = arcan_alloc_mem(
+			sizeof(struct camtag_data),
+			ARCAN_MEM_VTAG, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_SIMD
+		);
+		*ecam = *camera;
+		ecam->vrref = NULL;
+		ecam->stereo = ARCAN_EID;
+
+		vfunc_state state = {.tag = ARCAN_TAG_3DCAMERA, .ptr = ecam};
+		arcan_video_alterfeed(eye, FFUNC_3DOBJ, state);
+		FL_SET(eobj, FL_FULL3D);
+	}
+
+	camera->stereo = eye;
+	return ARCAN_OK;
+}
+
 arcan_errc arcan_3d_camtag(arcan_vobj_id tgtid,
 	arcan_vobj_id vid, float near, float far, float ar, float fov, int flags, ...)
 {
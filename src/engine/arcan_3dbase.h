@@ -42,6 +42,15 @@ arcan_errc arcan_3d_camtag(arcan_vobj_id tgt,
  */
 arcan_errc arcan_3d_camproj(arcan_vobj_id vid, float proj[static 16]);
 
+/*
+ * Pair a tagged camera with a second one (e.g. the right eye) so that a
+ * single pass over the pipeline draws both, side by side, into the left and
+ * right halves of the rendertarget of [vid]. The eye keeps its own position,
+ * orientation and projection. If [eye] is not a camera already, it becomes
+ * one with the parameters of [vid]. ARCAN_EID as [eye] reverts to one view.
+ */
+arcan_errc arcan_3d_camstereo(arcan_vobj_id vid, arcan_vobj_id eye);
+
 /*
  * Generate a finalized model where the vertices range between [mins,mint]
  * with s mapped to x axis and t mapped to y or z depending on if [vert] is
@@ -95,8 +104,24 @@ arcan_vobj_id arcan_3d_buildbox(float width, float height,
  * The principal way for distributing the vertices is to attach an image to a
  * frameset slot (one will be allocated) and use that in a vertex shader that
  * determines the actual position of each vertice.
+ *
+ * If [width] is set, the texture coordinates are instead placed at the texel
+ * centers of a [width] * ceil(count / width) map, one point per texel, so
+ * that a map (e.g. an fp16 frameserver buffer) can carry per-point data.
+ *
+ * Positions and RGBA colors are kept in a store that is synched to the GPU
+ * on change, see arcan_3d_pointcloud_update.
+ */
+arcan_vobj_id arcan_3d_pointcloud(size_t count, size_t nmaps, size_t width);
+
+/*
+ * Replace the positions (3 floats per point) and/or colors (4 floats per
+ * point) of [count] points starting at point [ofs] in a pointcloud. Either
+ * of [pos] and [col] can be NULL. The count is clamped to the points in the
+ * cloud, only the changed range gets sent to the GPU.
  */
-arcan_vobj_id arcan_3d_pointcloud(size_t count, size_t nmaps);
+arcan_errc arcan_3d_pointcloud_update(arcan_vobj_id id,
+	size_t ofs, size_t count, const float* pos, const float* col);
 
 /*
  * Use the transform defined by the camtagged object in [cam] and return
@@ -143,13 +168,25 @@ arcan_errc arcan_3d_meshshader(arcan_vobj_id dst,
 	agp_shader_id shid, unsigned slot);
 
 /*
- * [Asynchronous Operation]
- * Add a mesh to an unfinalized model and set it to consume [nmaps]
- * maps from the frameset associated with [dst].
+ * Add a mesh from a packed mesh file (.amsh, see shmif_mesh_header in
+ * arcan_shmif_sub.h) to an unfinalized model and set it to consume
+ * [nmaps] maps from the frameset associated with [dst].
  */
 arcan_errc arcan_3d_addmesh(arcan_vobj_id dst,
 	data_source resource, unsigned nmaps);
 
+/*
+ * Add a packed mesh in [buf] (arcan_alloc_mem) at the level of detail [lod]
+ * (-1 for the finest one present) and take ownership of [buf], even if the
+ * call fails. The layout is drawn from directly without conversion.
+ *
+ * If [tag] is non-zero and matches that of an earlier packed mesh in the
+ * model, that one gets replaced instead, even if the model is finalized.
+ * This is used to swap in streamed refinements from a frameserver.
+ */
+arcan_errc arcan_3d_addpacked(arcan_vobj_id dst,
+	uint8_t* buf, size_t buf_sz, unsigned nmaps, int lod, uintptr_t tag);
+
 /*
  * Add a trisoup as a mesh to an unfinalized model and set it to
  * consume [nmaps] from the frameset associated with [dst].
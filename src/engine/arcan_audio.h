@@ -81,7 +81,9 @@ arcan_errc arcan_audio_alterfeed(arcan_aobj_id id, arcan_afunc_cb feed);
 /*
  * Allocate a streaming audio source, tag is a regular context pointer
  * that will be passed to the corresponding callback / feed function.
- * These will likely be invoked as part of audio_refresh.
+ * These will likely be invoked as part of audio_refresh, though platforms
+ * with a mixer thread may invoke them from there unless a monitor is hooked
+ * (see arcan_audio_hookfeed), so the feed should only touch shared memory.
  */
 arcan_aobj_id arcan_audio_feed(arcan_afunc_cb feed,
 	void* tag, arcan_errc* errc);
@@ -11,6 +11,10 @@
 
 #include "arcan_hmeta.h"
 
+#ifdef __LINUX
+#include <sys/epoll.h>
+#endif
+
 /* defined in platform.h, used in psep open, shared memory */
 _Atomic uint64_t* volatile arcan_watchdog_ping = NULL;
 static size_t gpu_lock_bitmap;
@@ -74,6 +78,14 @@ void arcan_conductor_toggle_watchdog()
  *      this would again be better for something like vulkan where we tie the
  *      rendertarget to a unique pipeline (they are much alike)
  */
+/*
+ * Running estimate of a cost in microseconds, mean and mean deviation
+ * updated as for TCP RTT estimation so that the bound reacts to jitter.
+ */
+struct cost_est {
+	double mean, dev;
+};
+
 static struct {
 	uint64_t tick_count;
 	int64_t set_deadline;
@@ -81,14 +93,163 @@ static struct {
 	double transfer_cost;
 	uint8_t timestep;
 	bool in_frame;
+
+/* measured costs and the absolute deadline used by SYNCH_BUDGET */
+	struct {
+		struct cost_est tick, poll, render, scanout, frame;
+		uint64_t last_frame_us;
+		uint64_t frames;
+		double slack;
+		uint64_t deadline_us;
+		uint64_t target_us;
+		uint64_t scanout_us;
+		size_t misses;
+	} budget;
+
+/* scripting VM collection steps run in the slack before a deadline */
+	struct {
+		size_t budget_us;
+		size_t step_kb;
+		size_t spent_us;
+		uint64_t total_us;
+		bool cycle_done;
+	} gc;
 } conductor = {
 	.render_cost = 4,
 	.transfer_cost = 1,
-	.timestep = 2
+	.timestep = 2,
+	.gc = {
+		.budget_us = 1000,
+		.step_kb = 4
+	}
 };
 
 static ssize_t find_frameserver(struct arcan_frameserver* fsrv);
 
+/*
+ * Per-frame phase timing. There is a single writer (the main loop) and the
+ * readers are the monitor and the watchdog signal handler, which can interrupt
+ * the writer at any point. The head is only advanced after a record is done
+ * and readers skip the slot that the writer would fill next.
+ */
+#define PHASE_RING 64
+
+struct phase_rec {
+	uint64_t start_us;
+	uint64_t end_us;
+	uint32_t us[CONDUCTOR_PHASE_COUNT];
+};
+
+static struct {
+	_Atomic int cur;
+	_Atomic uint64_t since;
+	uint32_t acc[CONDUCTOR_PHASE_COUNT];
+	uint64_t frame_start;
+	_Atomic uint64_t head;
+	struct phase_rec ring[PHASE_RING];
+} phases;
+
+static const char* phase_names[CONDUCTOR_PHASE_COUNT] = {
+	"idle", "event", "script", "transfer", "render", "swap", "scanout"
+};
+
+int arcan_conductor_phase(int phase)
+{
+	if (phase < 0 || phase >= CONDUCTOR_PHASE_COUNT)
+		phase = CONDUCTOR_PHASE_EVENT;
+
+	uint64_t now = arcan_timemicros();
+	int prev = atomic_load_explicit(&phases.cur, memory_order_relaxed);
+	uint64_t since = atomic_load_explicit(&phases.since, memory_order_relaxed);
+
+	if (since && now > since)
+		phases.acc[prev] += now - since;
+
+	atomic_store_explicit(&phases.since, now, memory_order_relaxed);
+	atomic_store_explicit(&phases.cur, phase, memory_order_release);
+	return prev;
+}
+
+static void phase_frame()
+{
+	arcan_conductor_phase(atomic_load(&phases.cur));
+	uint64_t now = atomic_load(&phases.since);
+	uint64_t head = atomic_load_explicit(&phases.head, memory_order_relaxed);
+
+	struct phase_rec* rec = &phases.ring[head % PHASE_RING];
+	rec->start_us = phases.frame_start ? phases.frame_start : now;
+	rec->end_us = now;
+	memcpy(rec->us, phases.acc, sizeof(phases.acc));
+	memset(phases.acc, '\0', sizeof(phases.acc));
+	phases.frame_start = now;
+
+	atomic_store_explicit(&phases.head, head + 1, memory_order_release);
+}
+
+void arcan_conductor_phase_dump(int fd)
+{
+	char buf[256];
+	uint64_t now = arcan_timemicros();
+	int cur = atomic_load_explicit(&phases.cur, memory_order_acquire);
+	uint64_t since = atomic_load_explicit(&phases.since, memory_order_relaxed);
+	uint64_t head = atomic_load_explicit(&phases.head, memory_order_acquire);
+
+	int n = snprintf(buf, sizeof(buf),
+		"#BEGINPHASES\ncurrent=%s elapsed_us=%"PRIu64"\n#frame_us",
+		phase_names[cur], since && now > since ? now - since : 0);
+
+	for (size_t i = 0; i < CONDUCTOR_PHASE_COUNT && n < sizeof(buf); i++)
+		n += snprintf(&buf[n], sizeof(buf) - n, " %s", phase_names[i]);
+
+	if (n < sizeof(buf))
+		n += snprintf(&buf[n], sizeof(buf) - n, "\n");
+
+	if (-1 == write(fd, buf, n < sizeof(buf) ? n : sizeof(buf) - 1))
+		return;
+
+	uint64_t count = head < PHASE_RING - 1 ? head : PHASE_RING - 1;
+	for (uint64_t i = head - count; i < head; i++){
+		struct phase_rec* rec = &phases.ring[i % PHASE_RING];
+		n = snprintf(buf, sizeof(buf), "%"PRIu64, rec->end_us - rec->start_us);
+
+		for (size_t j = 0; j < CONDUCTOR_PHASE_COUNT && n < sizeof(buf); j++)
+			n += snprintf(&buf[n], sizeof(buf) - n, " %"PRIu32, rec->us[j]);
+
+		if (n < sizeof(buf))
+			n += snprintf(&buf[n], sizeof(buf) - n, "\n");
+
+		if (-1 == write(fd, buf, n < sizeof(buf) ? n : sizeof(buf) - 1))
+			return;
+	}
+
+	const char end[] = "#ENDPHASES\n";
+	if (-1 == write(fd, end, sizeof(end) - 1)){}
+}
+
+/*
+ * Displays registered by the platform, each with its own composition clock
+ * that is set on scanout (arcan_conductor_display_synch) and stepped by the
+ * refresh rate while the display is idle.
+ */
+#ifndef CONDUCTOR_DISPLAYS
+#define CONDUCTOR_DISPLAYS 16
+#endif
+
+static struct conductor_disp {
+	bool used;
+	size_t gpu_id, disp_id;
+	float rate;
+	arcan_vobj_id obj;
+	uint64_t next_us;
+
+/* adaptive synch: [rate] is the upper bound of the panel range and [min_rate]
+ * the lower, [pending] is set when the focus target has delivered a frame
+ * since the display last synched at [last_us] */
+	bool dynamic, pending;
+	float min_rate;
+	uint64_t last_us;
+} displays[CONDUCTOR_DISPLAYS];
+
 /*
  * To add new options here,
  *
@@ -104,6 +265,8 @@ static char* synchopts[] = {
 	"powersave", "synch to clock tick (~25Hz)",
 	"adaptive", "defer composition",
 	"tight", "defer composition, delay client-wake",
+	"budget", "start composition from measured costs to finish before vsynch",
+	"tearing", "as immediate, displays present without waiting for vblank",
 	NULL
 };
 
@@ -126,33 +289,129 @@ enum synchopts {
 /* defer composition, wake clients after vsynch */
 	SYNCH_ADAPTIVE,
 /* defer composition, wake clients after half-time */
-	SYNCH_TIGHT
+	SYNCH_TIGHT,
+/* defer composition by measured cost, wake clients after vsynch */
+	SYNCH_BUDGET,
+/* wait for display, wake client after buffer ack, asynchronous flips */
+	SYNCH_TEARING
 };
 
 static int synchopt = SYNCH_IMMEDIATE;
 
+/*
+ * Per class polling divider (poll every n:th herd step) and cap on buffer
+ * releases per unlock pass (0, unlimited). Releases that are over the cap
+ * stay pending until the next pass, which is also what keeps a large set of
+ * background clients from delaying the focus target.
+ */
+static const struct {
+	unsigned poll_div;
+	size_t release_cap;
+} prio_class[CONDUCTOR_PRIO_COUNT] = {
+	[CONDUCTOR_PRIO_FOCUS] = {.poll_div = 1},
+	[CONDUCTOR_PRIO_VISIBLE] = {.poll_div = 1},
+	[CONDUCTOR_PRIO_OCCLUDED] = {.poll_div = 4, .release_cap = 8},
+	[CONDUCTOR_PRIO_BACKGROUND] = {.poll_div = 16, .release_cap = 2}
+};
+
+/* herd steps an occluded client waits before being demoted to background */
+#define PRIO_BACKGROUND_STEPS 600
+
+static uint64_t herd_step;
+
+/* toggle the invisible hint flag on top of what the scripts last sent, a
+ * 0x0 displayhint only changes the hint flags */
+static void prio_throttle(struct arcan_frameserver* fsrv, bool throttle)
+{
+	if (fsrv->prio.throttled == throttle)
+		return;
+
+	fsrv->prio.throttled = throttle;
+
+	struct arcan_event ev = {
+		.category = EVENT_TARGET,
+		.tgt.kind = TARGET_COMMAND_DISPLAYHINT,
+		.tgt.ioevs[4].fv = -1,
+		.tgt.ioevs[5].iv = fsrv->desc.text.cellw,
+		.tgt.ioevs[6].iv = fsrv->desc.text.cellh
+	};
+
+	if (fsrv->desc.hint.last.tgt.kind == TARGET_COMMAND_DISPLAYHINT)
+		ev = fsrv->desc.hint.last;
+
+	ev.tgt.ioevs[0].iv = ev.tgt.ioevs[1].iv = 0;
+	if (throttle)
+		ev.tgt.ioevs[2].iv |= 2;
+	ev.tgt.timestamp = arcan_timemillis();
+
+	TRACE_MARK_ONESHOT("conductor", "synchronization",
+		TRACE_SYS_DEFAULT, fsrv->vid, throttle, "prio-throttle");
+	platform_fsrv_pushevent(fsrv, &ev);
+}
+
+static void classify_herd()
+{
+	herd_step++;
+
+	for (size_t i = 0, j = frameservers.used; i < frameservers.count && j; i++){
+		struct arcan_frameserver* fsrv = frameservers.ref[i];
+		if (!fsrv)
+			continue;
+		j--;
+
+		struct arcan_vobject* vobj = arcan_video_getobject(fsrv->vid);
+		int cls = CONDUCTOR_PRIO_VISIBLE;
+		if (fsrv == frameservers.focus)
+			cls = CONDUCTOR_PRIO_FOCUS;
+		else if (!vobj || vobj->current.opa <= EPSILON){
+			if (fsrv->prio.cls < CONDUCTOR_PRIO_OCCLUDED)
+				fsrv->prio.since = herd_step;
+
+			cls = herd_step - fsrv->prio.since > PRIO_BACKGROUND_STEPS ?
+				CONDUCTOR_PRIO_BACKGROUND : CONDUCTOR_PRIO_OCCLUDED;
+		}
+
+		fsrv->prio.cls = cls;
+		fsrv->prio.skip_poll = (herd_step + i) % prio_class[cls].poll_div != 0;
+		prio_throttle(fsrv, cls >= CONDUCTOR_PRIO_OCCLUDED);
+	}
+}
+
 /*
  * difference between step/unlock is that step performs a polling step
  * where transfers might occur, unlock simply awakes clients that did
- * contribute a frame last pass but has been locked since
+ * contribute a frame last pass but has been locked since. The release
+ * order follows the scheduling classes, focus first.
  */
 static void unlock_herd()
 {
-	for (size_t i = 0; i < frameservers.count; i++)
-		if (frameservers.ref[i]){
+	for (size_t cls = 0; cls < CONDUCTOR_PRIO_COUNT; cls++){
+		size_t cap = prio_class[cls].release_cap;
+
+		for (size_t i = 0; i < frameservers.count; i++){
+			struct arcan_frameserver* fsrv = frameservers.ref[i];
+			if (!fsrv || fsrv->prio.cls != cls || !fsrv->flags.release_pending)
+				continue;
+
 			TRACE_MARK_ONESHOT("conductor", "synchronization",
-				TRACE_SYS_DEFAULT, frameservers.ref[i]->vid, 0, "unlock-herd");
-			arcan_frameserver_releaselock(frameservers.ref[i]);
+				TRACE_SYS_DEFAULT, fsrv->vid, cls, "unlock-herd");
+			arcan_frameserver_releaselock(fsrv);
+
+			if (cap && !--cap)
+				break;
 		}
+	}
 }
 
 static void step_herd(int mode)
 {
 	uint64_t start = arcan_timemillis();
+	int phase = arcan_conductor_phase(CONDUCTOR_PHASE_TRANSFER);
 
 	TRACE_MARK_ENTER("conductor", "synchronization",
 		TRACE_SYS_DEFAULT, mode, 0, "step-herd");
 
+	classify_herd();
 	arcan_frameserver_lock_buffers(0);
 	arcan_video_pollfeed();
 	arcan_frameserver_lock_buffers(mode);
@@ -164,6 +423,7 @@ static void step_herd(int mode)
 
 	TRACE_MARK_ENTER("conductor", "synchronization",
 		TRACE_SYS_DEFAULT, mode, conductor.transfer_cost, "step-herd");
+	arcan_conductor_phase(phase);
 }
 
 static void forward_vblank()
@@ -173,20 +433,291 @@ static void forward_vblank()
 		if (fsrv && fsrv->clock.vblank){
 			struct arcan_vobject* vobj = arcan_video_getobject(fsrv->vid);
 
-			platform_fsrv_pushevent(fsrv, &(struct arcan_event){
-					.category = EVENT_TARGET,
-					.tgt.kind = TARGET_COMMAND_STEPFRAME,
-					.tgt.ioevs[0].iv = 0,
-					.tgt.ioevs[1].iv = 2,
-					.tgt.ioevs[2].uiv = vobj->owner->msc,
-				});
+			struct arcan_event ev = {
+				.category = EVENT_TARGET,
+				.tgt.kind = TARGET_COMMAND_STEPFRAME,
+				.tgt.ioevs[0].iv = 0,
+				.tgt.ioevs[1].iv = 2,
+				.tgt.ioevs[2].uiv = vobj->owner->msc,
+			};
+			arcan_frameserver_stamp_present(&ev);
+			platform_fsrv_pushevent(fsrv, &ev);
 		}
 	}
 }
 
+extern struct arcan_luactx* main_lua_context;
+
+/*
+ * Step the scripting VM collector until [until_us] or until the budget for
+ * the current frame is spent. A finished cycle also ends it for the frame so
+ * that the slack doesn't go to restarting a collection with nothing to do.
+ * Returns the number of microseconds spent.
+ */
+static uint64_t idle_gc(uint64_t until_us)
+{
+	if (!main_lua_context || conductor.gc.cycle_done ||
+		conductor.gc.spent_us >= conductor.gc.budget_us)
+		return 0;
+
+	uint64_t start = arcan_timemicros();
+	uint64_t end = start + (conductor.gc.budget_us - conductor.gc.spent_us);
+	if (until_us < end)
+		end = until_us;
+
+	uint64_t now = start;
+	TRACE_MARK_ENTER("conductor", "gc", TRACE_SYS_DEFAULT, 0, end - start, "");
+	while (now < end){
+		if (arcan_lua_gcstep(main_lua_context, conductor.gc.step_kb)){
+			conductor.gc.cycle_done = true;
+			now = arcan_timemicros();
+			break;
+		}
+		now = arcan_timemicros();
+	}
+	TRACE_MARK_EXIT("conductor", "gc", TRACE_SYS_DEFAULT, 0, now - start, "");
+
+	conductor.gc.spent_us += now - start;
+	return now - start;
+}
+
+/*
+ * Descriptor wakeups: event sources, frameserver sockets and input device
+ * nodes are registered once and each wait dispatches directly to the owner of
+ * a ready descriptor, instead of every subsystem rebuilding and polling its
+ * own set on every pass through the loop. On Linux the set is kept in an
+ * epoll instance, elsewhere it falls back to a poll() over the watch list.
+ */
+struct fd_watch {
+	int fd;
+	int events;
+	bool dead;
+	void (*dispatch)(int fd, int revents, void* tag);
+	void* tag;
+	struct fd_watch* next;
+};
+
+static struct {
+	struct fd_watch* first;
+	bool init, dispatching, dirty;
+	int epoll;
+
+/* fallback set, rebuilt when the watch list changes */
+	struct pollfd* set;
+	struct fd_watch** owner;
+	size_t set_sz, set_used;
+} reactor;
+
+static void reactor_setup()
+{
+	if (reactor.init)
+		return;
+
+	reactor.init = true;
+	reactor.epoll = -1;
+#ifdef __LINUX
+	reactor.epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (-1 == reactor.epoll)
+		arcan_warning("conductor: epoll unavailable (%s), "
+			"falling back to poll\n", strerror(errno));
+#endif
+}
+
+#ifdef __LINUX
+/* the epoll registration is per descriptor, so the mask is the union of all
+ * watches on it and the watches are resolved on dispatch */
+static void epoll_sync(int fd)
+{
+	uint32_t mask = 0;
+	bool used = false;
+
+	for (struct fd_watch* cur = reactor.first; cur; cur = cur->next){
+		if (cur->dead || cur->fd != fd)
+			continue;
+		used = true;
+		mask |= (cur->events & POLLIN ? EPOLLIN : 0) |
+			(cur->events & POLLOUT ? EPOLLOUT : 0);
+	}
+
+	struct epoll_event ev = {
+		.events = mask,
+		.data.fd = fd
+	};
+
+	if (!used){
+		epoll_ctl(reactor.epoll, EPOLL_CTL_DEL, fd, NULL);
+		return;
+	}
+
+	if (-1 == epoll_ctl(reactor.epoll, EPOLL_CTL_MOD, fd, &ev) && errno == ENOENT)
+		epoll_ctl(reactor.epoll, EPOLL_CTL_ADD, fd, &ev);
+}
+#endif
+
+static void reactor_sweep()
+{
+	struct fd_watch** cur = &reactor.first;
+	while (*cur){
+		if ((*cur)->dead){
+			struct fd_watch* dead = *cur;
+			*cur = dead->next;
+			arcan_mem_free(dead);
+		}
+		else
+			cur = &(*cur)->next;
+	}
+}
+
+bool arcan_conductor_watch_fd(int fd, int events,
+	void (*dispatch)(int fd, int revents, void* tag), void* tag)
+{
+	if (fd < 0 || !dispatch)
+		return false;
+
+	reactor_setup();
+
+	struct fd_watch* watch = arcan_alloc_mem(sizeof(struct fd_watch),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+
+	*watch = (struct fd_watch){
+		.fd = fd,
+		.events = events & (POLLIN | POLLOUT),
+		.dispatch = dispatch,
+		.tag = tag,
+		.next = reactor.first
+	};
+	reactor.first = watch;
+	reactor.dirty = true;
+
+#ifdef __LINUX
+	if (-1 != reactor.epoll)
+		epoll_sync(fd);
+#endif
+
+	return true;
+}
+
+void arcan_conductor_unwatch_fd(int fd, void* tag)
+{
+	bool found = false;
+
+	for (struct fd_watch* cur = reactor.first; cur; cur = cur->next){
+		if (cur->dead || cur->tag != tag || (fd != -1 && cur->fd != fd))
+			continue;
+
+		cur->dead = true;
+		found = true;
+#ifdef __LINUX
+		if (-1 != reactor.epoll)
+			epoll_sync(cur->fd);
+#endif
+	}
+
+	if (!found)
+		return;
+
+/* a dispatch handler may remove other watches from the set being processed,
+ * so only mark them and let the wait release them */
+	reactor.dirty = true;
+	if (!reactor.dispatching)
+		reactor_sweep();
+}
+
+static void reactor_dispatch(int fd, int revents)
+{
+	for (struct fd_watch* cur = reactor.first; cur; cur = cur->next){
+		if (cur->dead || cur->fd != fd)
+			continue;
+
+		int mask = revents & (cur->events | POLLERR | POLLHUP | POLLNVAL);
+		if (mask)
+			cur->dispatch(fd, mask, cur->tag);
+	}
+}
+
+static void poll_fallback(int timeout)
+{
+	if (reactor.dirty){
+		size_t count = 0;
+		for (struct fd_watch* cur = reactor.first; cur; cur = cur->next)
+			count++;
+
+		if (count > reactor.set_sz){
+			arcan_mem_free(reactor.set);
+			arcan_mem_free(reactor.owner);
+			reactor.set_sz = count + 16;
+			reactor.set = arcan_alloc_mem(sizeof(struct pollfd) * reactor.set_sz,
+				ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+			reactor.owner = arcan_alloc_mem(sizeof(void*) * reactor.set_sz,
+				ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		}
+
+		reactor.set_used = 0;
+		for (struct fd_watch* cur = reactor.first; cur; cur = cur->next){
+			reactor.owner[reactor.set_used] = cur;
+			reactor.set[reactor.set_used++] = (struct pollfd){
+				.fd = cur->fd,
+				.events = cur->events
+			};
+		}
+		reactor.dirty = false;
+	}
+
+	int nr = poll(reactor.set, reactor.set_used, timeout);
+	if (nr <= 0)
+		return;
+
+	for (size_t i = 0; i < reactor.set_used && nr; i++){
+		struct fd_watch* cur = reactor.owner[i];
+		if (!reactor.set[i].revents)
+			continue;
+
+		nr--;
+		if (!cur->dead)
+			cur->dispatch(cur->fd, reactor.set[i].revents, cur->tag);
+	}
+}
+
+/* wait up to timeout (ms) for any registered descriptor and dispatch */
+static void wait_sources(int timeout)
+{
+	int phase = arcan_conductor_phase(CONDUCTOR_PHASE_IDLE);
+	reactor_setup();
+	reactor.dispatching = true;
+
+#ifdef __LINUX
+	if (-1 != reactor.epoll){
+		struct epoll_event evs[32];
+		int nr = epoll_wait(reactor.epoll, evs, COUNT_OF(evs), timeout);
+
+		for (int i = 0; i < nr; i++){
+			uint32_t ev = evs[i].events;
+			reactor_dispatch(evs[i].data.fd,
+				(ev & EPOLLIN ? POLLIN : 0) | (ev & EPOLLOUT ? POLLOUT : 0) |
+				(ev & EPOLLERR ? POLLERR : 0) | (ev & EPOLLHUP ? POLLHUP : 0));
+		}
+	}
+	else
+#endif
+		poll_fallback(timeout);
+
+	reactor.dispatching = false;
+	if (reactor.dirty){
+		reactor_sweep();
+
+/* only the poll fallback needs to rebuild its set */
+		if (-1 != reactor.epoll)
+			reactor.dirty = false;
+	}
+
+	arcan_conductor_phase(phase);
+}
+
 static void internal_yield()
 {
-	arcan_event_poll_sources(arcan_event_defaultctx(), conductor.timestep);
+	uint64_t gc = idle_gc(arcan_timemicros() + conductor.timestep * 1000);
+	int left = conductor.timestep - (int)(gc / 1000);
+	wait_sources(left > 0 ? left : 0);
 	TRACE_MARK_ONESHOT("conductor", "yield",
 		TRACE_SYS_DEFAULT, 0, conductor.timestep, "step");
 }
@@ -227,9 +758,89 @@ size_t arcan_conductor_gpus_locked()
 	return gpu_lock_bitmap;
 }
 
+static struct conductor_disp* find_display(size_t gpu_id, size_t disp_id)
+{
+	for (size_t i = 0; i < CONDUCTOR_DISPLAYS; i++)
+		if (displays[i].used &&
+			displays[i].gpu_id == gpu_id && displays[i].disp_id == disp_id)
+			return &displays[i];
+
+	return NULL;
+}
+
+static bool vrr_paced(struct conductor_disp* d)
+{
+	return d->dynamic && d->last_us && frameservers.focus;
+}
+
+/* with adaptive synch the panel holds until the next frame arrives within its
+ * range, so the clock follows frame delivery from the focus target: present as
+ * soon as the upper rate permits, and no later than the lower rate allows */
+static uint64_t dynamic_clock(struct conductor_disp* d)
+{
+	if (d->pending)
+		return d->last_us + 1000000.0 / d->rate;
+
+	if (d->min_rate > 0.0)
+		return d->last_us + 1000000.0 / d->min_rate;
+
+	return d->next_us;
+}
+
+/* step idle clocks forward to the next vblank after [now], return the
+ * earliest clock of any display or 0 if none is known */
+static uint64_t step_display_clocks(uint64_t now)
+{
+	uint64_t next = 0;
+
+	for (size_t i = 0; i < CONDUCTOR_DISPLAYS; i++){
+		struct conductor_disp* d = &displays[i];
+		if (!d->used || !d->next_us || d->rate <= 0.0)
+			continue;
+
+		if (d->next_us <= now){
+			uint64_t period = 1000000.0 / d->rate;
+			d->next_us += ((now - d->next_us) / period + 1) * period;
+		}
+
+		uint64_t clock = vrr_paced(d) ? dynamic_clock(d) : d->next_us;
+		if (!next || clock < next)
+			next = clock;
+	}
+
+	return next;
+}
+
+static void wake_at(uint64_t us)
+{
+	int64_t ms = us / 1000;
+	if (conductor.set_deadline == -1 || ms < conductor.set_deadline){
+		conductor.set_deadline = ms;
+		conductor.budget.deadline_us = us;
+	}
+}
+
 void arcan_conductor_register_display(size_t gpu_id,
 		size_t disp_id, enum synch_method method, float rate, arcan_vobj_id obj)
 {
+	struct conductor_disp* d = find_display(gpu_id, disp_id);
+	for (size_t i = 0; !d && i < CONDUCTOR_DISPLAYS; i++)
+		if (!displays[i].used){
+			d = &displays[i];
+			*d = (struct conductor_disp){
+				.used = true,
+				.gpu_id = gpu_id,
+				.disp_id = disp_id
+			};
+		}
+
+	if (d){
+		d->rate = method == SYNCH_NONE ? 0.0 : rate;
+		d->dynamic = method == SYNCH_DYNAMIC;
+		d->pending = false;
+		d->obj = obj;
+	}
+
 /* need to know which display and which vobj is needed to be updated in order
  * to fulfill the requirement of the display synch so that we can schedule it
  * accordingly, later the full DAG- would also be calculated here to resolve
@@ -243,11 +854,58 @@ void arcan_conductor_register_display(size_t gpu_id,
 void arcan_conductor_release_display(size_t gpu_id, size_t disp_id)
 {
 /* remove from set of known displays so its rate doesn't come into account */
+	struct conductor_disp* d = find_display(gpu_id, disp_id);
+	if (d)
+		*d = (struct conductor_disp){0};
+
 	char buf[24];
 	snprintf(buf, 24, "release:%zu:%zu", gpu_id, disp_id);
 	TRACE_MARK_ONESHOT("conductor", "display", TRACE_SYS_DEFAULT, gpu_id, 0, buf);
 }
 
+/* Readiness on the frameserver socket is latched into the flags and the watch
+ * disarmed, the descriptor is level-triggered and the state is only consumed
+ * when the frameserver is next polled (socketpoll / validchild) */
+static void fsrv_wakeup(int fd, int revents, void* tag)
+{
+	struct arcan_frameserver* fsrv = tag;
+
+	if (revents & (POLLERR | POLLHUP | POLLNVAL))
+		fsrv->flags.sock_hup = true;
+	else if (revents & POLLIN)
+		fsrv->flags.sock_ready = true;
+
+	TRACE_MARK_ONESHOT("conductor", "frameserver", TRACE_SYS_DEFAULT,
+		fsrv->vid, revents, fsrv->flags.sock_hup ? "socket-hup" : "socket-ready");
+
+	arcan_conductor_unwatch_fd(fd, fsrv);
+}
+
+void arcan_conductor_watch_frameserver(struct arcan_frameserver* fsrv)
+{
+	if (!fsrv || fsrv->dpipe <= 0 || fsrv->flags.sock_hup)
+		return;
+
+/* pending listening sockets need POLLIN for accept, connected ones are only
+ * tracked for hangup as descriptor transfers are consumed by the event path */
+	int events = fsrv->sockaddr ? POLLIN : 0;
+
+	for (struct fd_watch* cur = reactor.first; cur; cur = cur->next){
+		if (cur->dead || cur->tag != fsrv)
+			continue;
+
+		if (cur->fd == fsrv->dpipe && cur->events == events)
+			return;
+
+		arcan_conductor_unwatch_fd(cur->fd, fsrv);
+		break;
+	}
+
+	if (!fsrv->flags.sock_ready)
+		fsrv->flags.sock_watch =
+			arcan_conductor_watch_fd(fsrv->dpipe, events, fsrv_wakeup, fsrv);
+}
+
 void arcan_conductor_register_frameserver(struct arcan_frameserver* fsrv)
 {
 	size_t dst_i = 0;
@@ -288,6 +946,7 @@ void arcan_conductor_register_frameserver(struct arcan_frameserver* fsrv)
 	frameservers.ref[dst_i] = fsrv;
 	TRACE_MARK_ONESHOT("conductor", "frameserver",
 		TRACE_SYS_DEFAULT, fsrv->vid, 0, "register");
+	arcan_conductor_watch_frameserver(fsrv);
 
 /*
  * other approach is to run a monitor thread here that futexes on the flags
@@ -313,11 +972,15 @@ int arcan_conductor_yield(struct conductor_display* disps, size_t pset_count)
 
 	for (size_t i=0, j=frameservers.used; i < frameservers.count && j > 0; i++){
 		if (frameservers.ref[i]){
-			arcan_vint_pollfeed(frameservers.ref[i]->vid, false);
+			if (!frameservers.ref[i]->prio.skip_poll)
+				arcan_vint_pollfeed(frameservers.ref[i]->vid, false);
 			j--;
 		}
 	}
 
+/* the platform is about to wait for the display, use that for collection */
+	idle_gc(arcan_timemicros() + conductor.timestep * 1000);
+
 /* same as other timesleep calls, should be replaced with poll and pollset */
 	return conductor.timestep;
 }
@@ -331,6 +994,11 @@ static ssize_t find_frameserver(struct arcan_frameserver* fsrv)
 	return -1;
 }
 
+bool arcan_conductor_tearing()
+{
+	return synchopt == SYNCH_TEARING;
+}
+
 const char** arcan_conductor_synchopts()
 {
 	return (const char**) synchopts;
@@ -362,12 +1030,14 @@ void arcan_conductor_setsynch(const char* arg)
 	case SYNCH_VSYNCH:
 	case SYNCH_ADAPTIVE:
 	case SYNCH_POWERSAVE:
+	case SYNCH_BUDGET:
 		arcan_frameserver_lock_buffers(2);
 	break;
 	case SYNCH_TIGHT:
 		arcan_frameserver_lock_buffers(2);
 	break;
 	case SYNCH_IMMEDIATE:
+	case SYNCH_TEARING:
 	case SYNCH_PROCESSING:
 		arcan_frameserver_lock_buffers(0);
 		unlock_herd();
@@ -413,6 +1083,8 @@ void arcan_conductor_deregister_frameserver(struct arcan_frameserver* fsrv)
 	}
 	frameservers.ref[dst_i] = NULL;
 	frameservers.used--;
+	arcan_conductor_unwatch_fd(-1, fsrv);
+	fsrv->flags.sock_watch = false;
 
 	if (fsrv == frameservers.focus){
 		TRACE_MARK_ONESHOT("conductor", "frameserver",
@@ -427,7 +1099,6 @@ void arcan_conductor_deregister_frameserver(struct arcan_frameserver* fsrv)
 /* the real work here comes when we do multithreaded processing */
 }
 
-extern struct arcan_luactx* main_lua_context;
 static size_t event_count;
 static bool process_event(arcan_event* ev, int drain)
 {
@@ -512,7 +1183,58 @@ static int estimate_frame_cost()
 	return conductor.render_cost + conductor.transfer_cost + conductor.timestep;
 }
 
-static bool preframe_synch(int next, int elapsed)
+static void cost_sample(struct cost_est* est, double us)
+{
+	double err = us - est->mean;
+	est->mean += 0.125 * err;
+	est->dev += 0.25 * (fabs(err) - est->dev);
+}
+
+static double cost_bound(struct cost_est* est)
+{
+	return est->mean + 2.0 * est->dev;
+}
+
+/*
+ * Start composition late enough that input arriving until then is included,
+ * but early enough that polling, rendering and scanout submission has time to
+ * finish before the deadline. If a logical tick is due inside that window its
+ * cost is added as well. Misses grow the slack in postframe_synch.
+ */
+static bool budget_synch(float frag)
+{
+	uint64_t now = arcan_timemicros();
+
+	if (!conductor.budget.deadline_us || now >= conductor.budget.deadline_us)
+		return true;
+
+	double cost =
+		cost_bound(&conductor.budget.poll) +
+		cost_bound(&conductor.budget.render) +
+		cost_bound(&conductor.budget.scanout) + conductor.budget.slack;
+
+	uint64_t left = conductor.budget.deadline_us - now;
+	double next_tick = (1.0 - frag) * ARCAN_TIMER_TICK * 1000.0;
+	if (next_tick < left)
+		cost += cost_bound(&conductor.budget.tick);
+
+	if (cost + 1000.0 >= left){
+		TRACE_MARK_ONESHOT("conductor", "synchronization",
+			TRACE_SYS_DEFAULT, 0, (int64_t)(left - cost), "budget-deadline");
+		return true;
+	}
+
+/* spend some of the slack on collection, then wait for whatever is left,
+ * when woken up by input we come back here and re-evaluate */
+	uint64_t wait_until = now + (uint64_t)(left - cost);
+	idle_gc(wait_until);
+	now = arcan_timemicros();
+	if (now < wait_until)
+		wait_sources((wait_until - now) / 1000.0);
+	return false;
+}
+
+static bool preframe_synch(int next, int elapsed, float frag)
 {
 	switch(synchopt){
 	case SYNCH_ADAPTIVE:{
@@ -552,9 +1274,12 @@ static bool preframe_synch(int next, int elapsed)
 			TRACE_SYS_DEFAULT, 0, elapsed - margin, "tight-deadline");
 		return true;
 	}
+	case SYNCH_BUDGET:
+		return budget_synch(frag);
 	case SYNCH_VSYNCH:
 	case SYNCH_PROCESSING:
 	case SYNCH_IMMEDIATE:
+	case SYNCH_TEARING:
 	case SYNCH_POWERSAVE:
 	break;
 	}
@@ -567,13 +1292,33 @@ static uint64_t postframe_synch(uint64_t next)
 	case SYNCH_VSYNCH:
 	case SYNCH_ADAPTIVE:
 	case SYNCH_POWERSAVE:
+	case SYNCH_BUDGET:
 		unlock_herd();
 	break;
 	case SYNCH_PROCESSING:
 	case SYNCH_IMMEDIATE:
+	case SYNCH_TEARING:
 	break;
 	}
 
+/* finishing after the deadline we aimed for means the estimate was too
+ * optimistic, back off quickly and recover slowly */
+	if (conductor.budget.target_us){
+		if (arcan_timemicros() > conductor.budget.target_us){
+			conductor.budget.misses++;
+			conductor.budget.slack = conductor.budget.slack * 2.0 + 250.0;
+			if (conductor.budget.slack > 4000.0)
+				conductor.budget.slack = 4000.0;
+
+			TRACE_MARK_ONESHOT("conductor", "synchronization", TRACE_SYS_WARN,
+				0, conductor.budget.misses, "budget-miss");
+		}
+		else
+			conductor.budget.slack *= 0.95;
+
+		conductor.budget.target_us = 0;
+	}
+
 /* this is not the 'correct' time to do this for multiscreen settings, we would
  * need to let the platform expose that event per screen and bias to the one (if
  * any) the frameserver is actually mapped to the vblank on. */
@@ -588,6 +1333,16 @@ static uint64_t postframe_synch(uint64_t next)
  * persist and re-introduce min the main event handler during warmup and make
  * sure we don't get stuck in an endless recover->main->flush->recover loop */
 static bool valid_cycle;
+
+/* when benchmarking is enabled, costofs has moved past the latest sample */
+static size_t last_cost(arcan_benchdata* stats)
+{
+	size_t n = sizeof(stats->framecost) / sizeof(stats->framecost[0]);
+	if (!stats->bench_enabled)
+		return (uint8_t)stats->costofs;
+	return ((uint8_t)stats->costofs + n - 1) % n;
+}
+
 bool arcan_conductor_valid_cycle()
 {
 	return valid_cycle;
@@ -602,19 +1357,39 @@ int arcan_conductor_reset_count(bool step)
 
 static int trigger_video_synch(float frag)
 {
+	uint64_t start = arcan_timemicros();
+	conductor.budget.scanout_us = conductor.budget.deadline_us > start ?
+		conductor.budget.deadline_us : start +
+		cost_bound(&conductor.budget.render) + cost_bound(&conductor.budget.scanout);
+
 	conductor.set_deadline = -1;
+	conductor.budget.target_us =
+		synchopt == SYNCH_BUDGET ? conductor.budget.deadline_us : 0;
+	conductor.budget.deadline_us = 0;
 
 	TRACE_MARK_ENTER("conductor", "platform-frame", TRACE_SYS_DEFAULT, conductor.tick_count, frag, "");
+	int phase = arcan_conductor_phase(CONDUCTOR_PHASE_SCRIPT);
 		arcan_lua_callvoidfun(main_lua_context, "preframe_pulse", false, NULL);
+		arcan_conductor_phase(CONDUCTOR_PHASE_RENDER);
 			platform_video_synch(conductor.tick_count, frag, NULL, NULL);
 
 			#ifdef WITH_TRACY
 			TracyCFrameMark
 			#endif
+		arcan_conductor_phase(CONDUCTOR_PHASE_SCRIPT);
 		arcan_lua_callvoidfun(main_lua_context, "postframe_pulse", false, NULL);
+	arcan_conductor_phase(phase);
+	phase_frame();
+
+/* whatever the scripts did to the LEDs this frame goes out as one update */
+	arcan_led_flush();
 	TRACE_MARK_EXIT("conductor", "platform-frame", TRACE_SYS_DEFAULT, conductor.tick_count, frag, "");
 
 	arcan_bench_register_frame();
+	arcan_bench_register_gc(conductor.gc.spent_us);
+	conductor.gc.total_us += conductor.gc.spent_us;
+	conductor.gc.spent_us = 0;
+	conductor.gc.cycle_done = false;
 	arcan_benchdata* stats = arcan_bench_data();
 
 /* exponential moving average */
@@ -622,6 +1397,21 @@ static int trigger_video_synch(float frag)
 		0.8 * (double)stats->framecost[(uint8_t)stats->costofs] +
 		0.2 * conductor.render_cost;
 
+/* the refresh cost is only known in milliseconds, the rest of the synch
+ * (pulses, submission, flip handling) is treated as scanout */
+	double synch = arcan_timemicros() - start;
+	double render = stats->framecost[last_cost(stats)] * 1000.0;
+	if (render > synch)
+		render = synch;
+	cost_sample(&conductor.budget.render, render);
+	cost_sample(&conductor.budget.scanout, synch - render);
+
+	uint64_t now = arcan_timemicros();
+	if (conductor.budget.last_frame_us)
+		cost_sample(&conductor.budget.frame, now - conductor.budget.last_frame_us);
+	conductor.budget.last_frame_us = now;
+	conductor.budget.frames++;
+
 	TRACE_MARK_ONESHOT("conductor", "frame-over", TRACE_SYS_DEFAULT, 0, conductor.set_deadline, "");
 
 	valid_cycle = true;
@@ -629,6 +1419,15 @@ static int trigger_video_synch(float frag)
 	return conductor.set_deadline > 0 ? conductor.set_deadline : 0;
 }
 
+uint64_t arcan_conductor_scanout_estimate()
+{
+	uint64_t now = arcan_timemicros();
+	if (conductor.budget.scanout_us > now)
+		return conductor.budget.scanout_us;
+
+	return now + cost_bound(&conductor.budget.scanout);
+}
+
 static arcan_tick_cb outcb;
 static void conductor_cycle(int);
 int arcan_conductor_run(arcan_tick_cb tick)
@@ -665,35 +1464,42 @@ int arcan_conductor_run(arcan_tick_cb tick)
  * and then actually dispatch / process these twice so that their old buffers
  * might get to be updated before we synch to display.
  */
+		uint64_t poll_start = arcan_timemicros();
+		arcan_conductor_phase(CONDUCTOR_PHASE_TRANSFER);
 		arcan_video_pollfeed();
 		arcan_audio_refresh();
+		cost_sample(&conductor.budget.poll, arcan_timemicros() - poll_start);
 
 /* let the event-layer polling set interleave up to the next deadline. */
 #ifdef ARCAN_LWA
 		if (conductor.set_deadline > 0){
 			int step = conductor.set_deadline - arcan_timemillis();
 			if (step > 0)
-				arcan_event_poll_sources(evctx, step);
+				wait_sources(step);
 		}
 		else
 #endif
-			arcan_event_poll_sources(evctx, 0);
+			wait_sources(0);
 
 		last_tickcount = conductor.tick_count;
 
 		TRACE_MARK_ENTER("conductor", "event",
 			TRACE_SYS_DEFAULT, 0, last_tickcount, "process");
 
+		arcan_conductor_phase(CONDUCTOR_PHASE_EVENT);
 		float frag = arcan_event_process(evctx, conductor_cycle);
 		uint64_t elapsed = arcan_timemillis() - last_synch;
 
 		TRACE_MARK_EXIT("conductor", "event",
 			TRACE_SYS_DEFAULT, 0, last_tickcount, "process");
 
-/* This fails when the event recipient has queued a SHUTDOWN event */
+/* This fails when the event recipient has queued a SHUTDOWN event, the
+ * input and event handlers in the scripts run from here */
+		arcan_conductor_phase(CONDUCTOR_PHASE_SCRIPT);
 		if (!arcan_event_feed(evctx, process_event, &exit_code))
 			break;
 		process_event(NULL, 0);
+		arcan_conductor_phase(CONDUCTOR_PHASE_EVENT);
 
 /* Chunk the time left until the next batch and yield in small steps. This
  * puts us about 25fps, could probably go a little lower than that, say 12 */
@@ -704,7 +1510,7 @@ int arcan_conductor_run(arcan_tick_cb tick)
 
 /* Other processing modes deal with their poll/sleep synch inside video-synch
  * or based on another evaluation function */
-		else if (next_synch <= 0 || preframe_synch(next_synch - last_synch, elapsed)){
+		else if (next_synch <= 0 || preframe_synch(next_synch - last_synch, elapsed, frag)){
 /* A stall or other action caused us to miss the tight deadline and the herd
  * didn't get unlocked this pass, so perform one now to not block the clients
  * indefinitely */
@@ -738,8 +1544,13 @@ void arcan_conductor_fakesynch(uint8_t left)
 	struct platform_timing timing = platform_hardware_clockcfg();
 	size_t sleep_cost = !timing.tickless * (timing.cost_us / 1000);
 
+	if (left > sleep_cost){
+		uint64_t gc = idle_gc(arcan_timemicros() + (left - sleep_cost) * 1000);
+		left = gc / 1000 >= left ? 0 : left - gc / 1000;
+	}
+
 	while ((step = arcan_conductor_yield(NULL, 0)) != -1 && left > step + sleep_cost){
-		arcan_event_poll_sources(arcan_event_defaultctx(), step);
+		wait_sources(step);
 		left -= step;
 	}
 
@@ -747,10 +1558,121 @@ void arcan_conductor_fakesynch(uint8_t left)
 		TRACE_SYS_SLOW, 0, left, "fake synch");
 }
 
+void arcan_conductor_display_synch(
+	size_t gpu_id, size_t disp_id, float period_ms)
+{
+	uint64_t now = arcan_timemicros();
+	struct conductor_disp* d = find_display(gpu_id, disp_id);
+
+	if (!d){
+		arcan_conductor_deadline(period_ms);
+		return;
+	}
+
+	d->next_us = now + period_ms * 1000.0;
+	d->last_us = now;
+	d->pending = false;
+	wake_at(step_display_clocks(now));
+
+	TRACE_MARK_ONESHOT("conductor", "display",
+		TRACE_SYS_DEFAULT, disp_id, period_ms, "display-synch");
+}
+
+bool arcan_conductor_display_due(size_t gpu_id, size_t disp_id)
+{
+	struct conductor_disp* d = find_display(gpu_id, disp_id);
+	if (!d || !d->next_us || d->rate <= 0.0)
+		return true;
+
+	uint64_t now = arcan_timemicros();
+	uint64_t next = step_display_clocks(now);
+
+/* anything with a vblank inside the time it takes to compose is due now,
+ * the others are left for the cycle closest to their own vblank */
+	double margin =
+		cost_bound(&conductor.budget.render) + cost_bound(&conductor.budget.scanout);
+	if (margin < 1000.0)
+		margin = 1000.0;
+
+	uint64_t clock = vrr_paced(d) ? dynamic_clock(d) : d->next_us;
+	if (clock <= next + margin)
+		return true;
+
+	wake_at(clock - margin);
+	return false;
+}
+
+void arcan_conductor_display_range(
+	size_t gpu_id, size_t disp_id, float min_hz, float max_hz)
+{
+	struct conductor_disp* d = find_display(gpu_id, disp_id);
+	if (!d)
+		return;
+
+	d->min_rate = min_hz > 0.0 ? min_hz : 0.0;
+	if (max_hz > 0.0)
+		d->rate = max_hz;
+
+	char buf[32];
+	snprintf(buf, 32, "range:%.1f:%.1f", d->min_rate, d->rate);
+	TRACE_MARK_ONESHOT("conductor", "display", TRACE_SYS_DEFAULT, disp_id, 0, buf);
+}
+
+void arcan_conductor_frame_delivered(struct arcan_frameserver* fsrv)
+{
+	if (!fsrv || fsrv != frameservers.focus)
+		return;
+
+	for (size_t i = 0; i < CONDUCTOR_DISPLAYS; i++){
+		struct conductor_disp* d = &displays[i];
+		if (!d->used || !d->dynamic || !d->last_us || d->pending)
+			continue;
+
+		d->pending = true;
+		wake_at(dynamic_clock(d));
+
+		TRACE_MARK_ONESHOT("conductor", "display",
+			TRACE_SYS_DEFAULT, d->disp_id, fsrv->vid, "vrr-frame");
+	}
+}
+
+void arcan_conductor_stats(struct conductor_stats* dst)
+{
+	*dst = (struct conductor_stats){
+		.ticks = conductor.tick_count,
+		.frames = conductor.budget.frames,
+		.frame_us = conductor.budget.frame.mean,
+		.frame_dev_us = conductor.budget.frame.dev,
+		.tick_us = conductor.budget.tick.mean,
+		.poll_us = conductor.budget.poll.mean,
+		.render_us = conductor.budget.render.mean,
+		.scanout_us = conductor.budget.scanout.mean,
+		.budget_misses = conductor.budget.misses,
+		.gc_us = conductor.gc.total_us + conductor.gc.spent_us,
+		.frameservers = frameservers.used
+	};
+}
+
+size_t arcan_conductor_frameservers(struct arcan_frameserver** dst, size_t lim)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < frameservers.count && n < lim; i++)
+		if (frameservers.ref[i])
+			dst[n++] = frameservers.ref[i];
+	return n;
+}
+
+void arcan_conductor_gcbudget(size_t budget_us, size_t step_kb)
+{
+	conductor.gc.budget_us = budget_us;
+	conductor.gc.step_kb = step_kb ? step_kb : 1;
+}
+
 void arcan_conductor_deadline(uint8_t deadline)
 {
 	if (conductor.set_deadline == -1 || deadline < conductor.set_deadline){
 		conductor.set_deadline = arcan_timemillis() + deadline;
+		conductor.budget.deadline_us = arcan_timemicros() + deadline * 1000;
 		TRACE_MARK_ONESHOT("conductor", "synchronization",
 			TRACE_SYS_DEFAULT, 0, deadline, "deadline");
 	}
@@ -758,6 +1680,7 @@ void arcan_conductor_deadline(uint8_t deadline)
 
 static void conductor_cycle(int nticks)
 {
+	uint64_t start = arcan_timemicros();
 	conductor.tick_count += nticks;
 /* priority is always in maintaining logical clock and event processing */
 	unsigned njobs;
@@ -775,9 +1698,20 @@ static void conductor_cycle(int nticks)
 	if (arcan_watchdog_ping)
 		atomic_store(arcan_watchdog_ping, arcan_timemillis());
 
+	int phase = arcan_conductor_phase(CONDUCTOR_PHASE_SCRIPT);
 	arcan_lua_tick(main_lua_context, nticks, conductor.tick_count);
 	outcb(nticks);
+	arcan_conductor_phase(phase);
 
+	int count = nticks;
 	while(nticks--)
 		arcan_mem_tick();
+
+	platform_launch_pool_step();
+
+	if (count)
+		cost_sample(&conductor.budget.tick,
+			(double)(arcan_timemicros() - start) / count);
+/* per-frame temporaries (ARCAN_MEM_FRAME) end here */
+	arcan_mem_frame_reset();
 }
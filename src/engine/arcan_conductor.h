@@ -25,6 +25,42 @@ int arcan_conductor_run(arcan_tick_cb cb);
 void arcan_conductor_enable_watchdog();
 void arcan_conductor_toggle_watchdog();
 
+/* Phases of a main loop pass, the time spent in each is accumulated per frame
+ * and kept in a fixed ring of the most recent frames. */
+enum conductor_phase {
+	CONDUCTOR_PHASE_IDLE = 0,
+	CONDUCTOR_PHASE_EVENT,
+	CONDUCTOR_PHASE_SCRIPT,
+	CONDUCTOR_PHASE_TRANSFER,
+	CONDUCTOR_PHASE_RENDER,
+	CONDUCTOR_PHASE_SWAP,
+	CONDUCTOR_PHASE_SCANOUT,
+	CONDUCTOR_PHASE_COUNT
+};
+
+/* Switch the currently active phase, the time since the last switch is
+ * charged to the previous phase which is returned so that nested sections
+ * can restore it. The platform marks SWAP and SCANOUT within video_synch. */
+int arcan_conductor_phase(int phase);
+
+/* Write the current phase, the time spent in it and the ring of per-frame
+ * phase timings to [fd]. This only formats into a stack buffer and writes
+ * so it can be used from the watchdog signal handler. */
+void arcan_conductor_phase_dump(int fd);
+
+/* Register a descriptor with the conductor wait set. Whenever the main loop
+ * idles or interleaves with display synch it waits on all registered
+ * descriptors at once and [dispatch] is invoked with the ready (POLLIN,
+ * POLLOUT, POLLERR, POLLHUP) mask for each watch the descriptor has.
+ * [events] can be 0 to only track errors and hangup. The same descriptor can
+ * be watched multiple times with different tags. */
+bool arcan_conductor_watch_fd(int fd, int events,
+	void (*dispatch)(int fd, int revents, void* tag), void* tag);
+
+/* Remove watches previously added with [tag], if [fd] is -1 all watches
+ * matching the tag will be removed. Safe to call from within a dispatch. */
+void arcan_conductor_unwatch_fd(int fd, void* tag);
+
 /* will return true after one complete event-flush -> scanout cycle
  * has been completed, this is a test heuristic to determine if the
  * platform has gotten stuck in some recoverable state. */
@@ -100,12 +136,64 @@ int arcan_conductor_yield(struct conductor_display* disps, size_t pset_count);
  */
 void arcan_conductor_deadline(uint8_t next_deadline_ms);
 
+/*
+ * Set the amount of time (microseconds) per frame that can be spent on
+ * incremental steps of [step_kb] in the scripting VM garbage collector,
+ * these are only run in the idle time left before the next deadline.
+ * A budget of 0 disables this and leaves collection to the VM allocator.
+ */
+void arcan_conductor_gcbudget(size_t budget_us, size_t step_kb);
+
+/*
+ * [called from platform]
+ * Scanout on a registered display completed and the next one is expected in
+ * [period_ms]. This sets the composition clock of that display and the next
+ * deadline becomes the earliest one of any display, rather than whichever
+ * display synched last.
+ */
+void arcan_conductor_display_synch(
+	size_t gpu_id, size_t disp_id, float period_ms);
+
+/*
+ * [called from platform]
+ * Check if a registered display should be composed and scanned out in the
+ * current synch. Displays whose clock is further away than the estimated
+ * composition time are left for a later synch, and the conductor will wake
+ * up in time for them. Unknown displays and ones without a clock are due.
+ */
+bool arcan_conductor_display_due(size_t gpu_id, size_t disp_id);
+
+/*
+ * [called from platform]
+ * Set the refresh range [min_hz, max_hz] of a display registered with
+ * SYNCH_DYNAMIC (adaptive synch). While a frameserver has focus, such a
+ * display is composed when the focus delivers a new frame, no sooner than
+ * max_hz allows and no later than min_hz requires.
+ */
+void arcan_conductor_display_range(
+	size_t gpu_id, size_t disp_id, float min_hz, float max_hz);
+
 /*
  * Switch the synchronization strategy to a string reference available in
  * synchopts, if no such string is found, the current strategy will remain.
  */
 void arcan_conductor_setsynch(const char* arg);
 
+/*
+ * [called from platform]
+ *
+ * Returns true if the active strategy prefers displays to present new
+ * buffers immediately (asynchronous flips) over waiting for vblank.
+ */
+bool arcan_conductor_tearing();
+
+/*
+ * Return the time (arcan_timemicros) at which the frame that is being, or is
+ * about to be, composed is expected to reach the display. This is the next
+ * display clock when known, otherwise the estimated composition cost.
+ */
+uint64_t arcan_conductor_scanout_estimate();
+
 /*
  * [called from platform]
  *
@@ -125,6 +213,19 @@ int arcan_conductor_reset_count(bool step);
  * strategy so permits */
 void arcan_conductor_focus(struct arcan_frameserver* fsrv);
 
+/* Scheduling classes for registered frameservers, derived on each herd step
+ * from the focus target and the visibility of the frameserver vid. Clients
+ * that stay occluded are demoted to background after a while. Lower classes
+ * are polled less often, get a smaller share of buffer releases per pass and
+ * are hinted as invisible so that they can throttle themselves. */
+enum conductor_prio {
+	CONDUCTOR_PRIO_FOCUS = 0,
+	CONDUCTOR_PRIO_VISIBLE,
+	CONDUCTOR_PRIO_OCCLUDED,
+	CONDUCTOR_PRIO_BACKGROUND,
+	CONDUCTOR_PRIO_COUNT
+};
+
 /* add a frameserver to the set of external data sources that should be
  * monitored for transfer requests and resize/renegotiation, invoked when a
  * frameserver structure is built and activated */
@@ -134,5 +235,32 @@ void arcan_conductor_register_frameserver(struct arcan_frameserver* fsrv);
  * all processing on the frameserver should be suspended or as part of the
  * deallocation sequence */
 void arcan_conductor_deregister_frameserver(struct arcan_frameserver* fsrv);
+
+/* (re-)arm readiness tracking on the frameserver socket, this is done on
+ * register and needs to be repeated when the socket has changed (e.g. after
+ * an accept on a listening connection point) or a latched readiness state
+ * has been consumed. */
+void arcan_conductor_watch_frameserver(struct arcan_frameserver* fsrv);
+
+/* a frameserver has delivered a new video frame, if it is the focus target
+ * this marks displays with adaptive synch as having new contents to present */
+void arcan_conductor_frame_delivered(struct arcan_frameserver* fsrv);
+
+/* Counters and running cost estimates (mean microseconds) for metrics export,
+ * [frame_us] is the time between frames, [gc_us] the total time spent on
+ * scripting VM collection steps and [frameservers] the number registered. */
+struct conductor_stats {
+	uint64_t ticks, frames;
+	double frame_us, frame_dev_us;
+	double tick_us, poll_us, render_us, scanout_us;
+	size_t budget_misses;
+	uint64_t gc_us;
+	size_t frameservers;
+};
+void arcan_conductor_stats(struct conductor_stats* dst);
+
+/* Fill [dst] with up to [lim] of the registered frameservers, returns the
+ * number filled. These are only valid until the next conductor pass. */
+size_t arcan_conductor_frameservers(struct arcan_frameserver** dst, size_t lim);
 #endif
 #endif
@@ -15,10 +15,15 @@
 
 #include <sys/types.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <errno.h>
 
 #include "arcan_math.h"
 #include "arcan_general.h"
 #include "arcan_db.h"
+#include "external/uthash.h"
 
 #ifdef ARCAN_DB_STANDALONE
 static const char* ARCAN_TBL = "arcan";
@@ -133,8 +138,75 @@ static const char* ddls[] = {
 #define DI_INSKV_TARGET_LIBV "INSERT OR REPLACE INTO "\
 	"target_libs(libname, libnote, target) VALUES(?, ?, ?);"
 
+/*
+ * Key/value cache for the appl, target and config namespaces. Reads are served
+ * from memory, with absent keys cached as NULL values, and writes update the
+ * cache and are queued for the writer thread. That thread has a connection of
+ * its own and commits the queue as one transaction every flush interval
+ * (db_flush_interval, ms) and on close. With the database in WAL mode neither
+ * that nor external readers (the arcan_db tool) block the engine connection.
+ *
+ * Queries that match over a namespace (applkeys, getkeys, matchkey) wait for
+ * the queue to be committed first so that they see the same state as the
+ * cache does. Changes from other connections are noticed by the writer through
+ * the data_version pragma and the cache is dropped on the next access.
+ */
+#define DB_CACHE_LIMIT 4096
+#define DB_FLUSH_INTERVAL 1000
+
+struct kv_cache {
+	char* key;
+	char* val;
+	UT_hash_handle hh;
+};
+
+struct kv_write {
+	enum DB_KVTARGET type;
+	char* appl;
+	int64_t id;
+	char* key;
+	char* val;
+	struct kv_write* next;
+};
+
+struct kv_writer {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	sqlite3* dbh;
+	unsigned interval;
+
+	struct kv_write* pending;
+	struct kv_write** tail;
+	uint64_t queued, flushed;
+	bool sync, shutdown;
+
+	int data_version;
+	_Atomic bool stale;
+};
+
+/*
+ * Prepared statements for the main connection, keyed on the query text. The
+ * statements are reset and have their bindings cleared when a query is done
+ * with them (db_stmt_done), a statement that is left stepped would otherwise
+ * keep a read transaction open.
+ */
+struct db_stmt {
+	char* sql;
+	sqlite3_stmt* stmt;
+	UT_hash_handle hh;
+};
+
 struct arcan_dbh {
 	sqlite3* dbh;
+	struct db_stmt* stmts;
+
+/* see kv_cache above, [cache_on] is false for the standalone tool */
+	bool cache_on;
+	struct kv_cache* cache;
+	size_t cache_count;
+	struct kv_writer* writer;
+	bool cached_tr;
 
 /* cached appl name used for the DBHandle, although
  * some special functions may use a different one, none outside _db.c should */
@@ -168,6 +240,464 @@ void arcan_db_set_shared(struct arcan_dbh* new)
 	shared_handle = new;
 }
 
+static char* cache_key(enum DB_KVTARGET type,
+	const char* appl, int64_t id, const char* key)
+{
+	char* res = NULL;
+	if (type == DVT_APPL)
+		asprintf(&res, "a\x1f%s\x1f%s", appl, key);
+	else
+		asprintf(&res, "%c\x1f%"PRId64"\x1f%s", type == DVT_TARGET ? 't' : 'c', id, key);
+	return res;
+}
+
+static void cache_drop(struct arcan_dbh* dbh)
+{
+	struct kv_cache* ent, (* tmp);
+	HASH_ITER(hh, dbh->cache, ent, tmp){
+		HASH_DEL(dbh->cache, ent);
+		free(ent->key);
+		free(ent->val);
+		free(ent);
+	}
+	dbh->cache_count = 0;
+}
+
+/* takes ownership of [hkey] */
+static void cache_set(struct arcan_dbh* dbh, char* hkey, const char* val)
+{
+	if (!hkey)
+		return;
+
+	struct kv_cache* ent;
+	HASH_FIND_STR(dbh->cache, hkey, ent);
+	if (ent){
+		free(hkey);
+		free(ent->val);
+		ent->val = val ? strdup(val) : NULL;
+		return;
+	}
+
+	ent = malloc(sizeof(struct kv_cache));
+	if (!ent){
+		free(hkey);
+		return;
+	}
+
+	*ent = (struct kv_cache){
+		.key = hkey,
+		.val = val ? strdup(val) : NULL
+	};
+	HASH_ADD_KEYPTR(hh, dbh->cache, ent->key, strlen(ent->key), ent);
+	dbh->cache_count++;
+}
+
+/* the statements the writer and the synchronous path share, NULL [val] is
+ * a delete */
+static bool kv_apply(sqlite3* dbh, enum DB_KVTARGET type,
+	const char* appl, int64_t id, const char* key, const char* val)
+{
+	sqlite3_stmt* stmt = NULL;
+	char* qry = NULL;
+
+	if (type == DVT_APPL){
+		if (val)
+			asprintf(&qry, "INSERT OR REPLACE INTO appl_%s(key, val) VALUES(?, ?);", appl);
+		else
+			asprintf(&qry, "DELETE FROM appl_%s WHERE key = ?;", appl);
+	}
+	else if (type == DVT_TARGET)
+		qry = strdup(val ? DI_INSKV_TARGET :
+			"DELETE FROM target_kv WHERE key = ? AND target = ?;");
+	else
+		qry = strdup(val ? DI_INSKV_CONFIG :
+			"DELETE FROM config_kv WHERE key = ? AND config = ?;");
+
+	if (!qry)
+		return false;
+
+	int rc = sqlite3_prepare_v2(dbh, qry, -1, &stmt, NULL);
+	free(qry);
+	if (rc != SQLITE_OK)
+		return false;
+
+	int ind = 1;
+	sqlite3_bind_text(stmt, ind++, key, -1, SQLITE_TRANSIENT);
+	if (val)
+		sqlite3_bind_text(stmt, ind++, val, -1, SQLITE_TRANSIENT);
+	if (type != DVT_APPL)
+		sqlite3_bind_int64(stmt, ind++, id);
+
+	rc = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+
+	if (rc != SQLITE_DONE)
+		arcan_warning("arcan_db(), kv write (%s) failed: %s\n", key, sqlite3_errmsg(dbh));
+
+	return rc == SQLITE_DONE;
+}
+
+static void free_write(struct kv_write* w)
+{
+	free(w->appl);
+	free(w->key);
+	free(w->val);
+	free(w);
+}
+
+static void writer_commit(struct kv_writer* wr, struct kv_write* batch)
+{
+	if (!batch)
+		return;
+
+	sqlite3_exec(wr->dbh, "BEGIN;", NULL, NULL, NULL);
+	while (batch){
+		struct kv_write* next = batch->next;
+		kv_apply(wr->dbh, batch->type, batch->appl, batch->id, batch->key, batch->val);
+		free_write(batch);
+		batch = next;
+	}
+
+	if (SQLITE_OK != sqlite3_exec(wr->dbh, "COMMIT;", NULL, NULL, NULL)){
+		arcan_warning("arcan_db(), write-behind commit failed: %s\n",
+			sqlite3_errmsg(wr->dbh));
+		sqlite3_exec(wr->dbh, "ROLLBACK;", NULL, NULL, NULL);
+	}
+}
+
+/* changes from another connection, the engine one included */
+static void writer_check_version(struct kv_writer* wr)
+{
+	sqlite3_stmt* stmt;
+	if (SQLITE_OK != sqlite3_prepare_v2(wr->dbh, "PRAGMA data_version;", -1, &stmt, NULL))
+		return;
+
+	if (SQLITE_ROW == sqlite3_step(stmt)){
+		int ver = sqlite3_column_int(stmt, 0);
+		if (wr->data_version && ver != wr->data_version)
+			atomic_store(&wr->stale, true);
+		wr->data_version = ver;
+	}
+
+	sqlite3_finalize(stmt);
+}
+
+static void* writer_thread(void* arg)
+{
+	struct kv_writer* wr = arg;
+	pthread_mutex_lock(&wr->lock);
+
+	for(;;){
+		if (!wr->sync && !wr->shutdown){
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += wr->interval / 1000;
+			ts.tv_nsec += (wr->interval % 1000) * 1000000;
+			if (ts.tv_nsec >= 1000000000){
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&wr->cond, &wr->lock, &ts);
+		}
+
+		struct kv_write* batch = wr->pending;
+		uint64_t queued = wr->queued;
+		bool shutdown = wr->shutdown;
+		wr->pending = NULL;
+		wr->tail = &wr->pending;
+		wr->sync = false;
+		pthread_mutex_unlock(&wr->lock);
+
+		writer_check_version(wr);
+		writer_commit(wr, batch);
+
+		pthread_mutex_lock(&wr->lock);
+		wr->flushed = queued;
+		pthread_cond_broadcast(&wr->cond);
+
+		if (shutdown && !wr->pending)
+			break;
+	}
+
+	pthread_mutex_unlock(&wr->lock);
+	return NULL;
+}
+
+/* wait until everything queued so far has been committed */
+static void db_cache_sync(struct arcan_dbh* dbh)
+{
+	struct kv_writer* wr = dbh->writer;
+	if (!wr)
+		return;
+
+	pthread_mutex_lock(&wr->lock);
+	uint64_t target = wr->queued;
+	while (wr->flushed < target){
+		wr->sync = true;
+		pthread_cond_broadcast(&wr->cond);
+		pthread_cond_wait(&wr->cond, &wr->lock);
+	}
+	pthread_mutex_unlock(&wr->lock);
+}
+
+/* the cache may hold values that only exist in the queue, commit before
+ * anything is dropped */
+static void cache_check(struct arcan_dbh* dbh)
+{
+	bool stale = dbh->writer && atomic_exchange(&dbh->writer->stale, false);
+	if (!stale && dbh->cache_count < DB_CACHE_LIMIT)
+		return;
+
+	db_cache_sync(dbh);
+	cache_drop(dbh);
+}
+
+static bool cache_lookup(struct arcan_dbh* dbh,
+	enum DB_KVTARGET type, const char* appl, int64_t id, const char* key, char** out)
+{
+	if (!dbh->cache_on)
+		return false;
+
+	cache_check(dbh);
+	char* hkey = cache_key(type, appl, id, key);
+	if (!hkey)
+		return false;
+
+	struct kv_cache* ent;
+	HASH_FIND_STR(dbh->cache, hkey, ent);
+	free(hkey);
+
+/* the whole appl namespace might be in the cache, see cache_fill_appl */
+	if (!ent && type == DVT_APPL){
+		hkey = cache_key(DVT_APPL, appl, 0, "");
+		if (hkey)
+			HASH_FIND_STR(dbh->cache, hkey, ent);
+		free(hkey);
+
+		if (ent && ent->val){
+			*out = NULL;
+			return true;
+		}
+		return false;
+	}
+
+	if (!ent)
+		return false;
+
+	*out = ent->val ? strdup(ent->val) : NULL;
+	return true;
+}
+
+/* update the cache and write through or queue, false if there is no cache
+ * and the caller should write */
+static bool cache_write(struct arcan_dbh* dbh, enum DB_KVTARGET type,
+	const char* appl, int64_t id, const char* key, const char* val)
+{
+	if (!dbh->cache_on)
+		return false;
+
+	cache_check(dbh);
+	cache_set(dbh, cache_key(type, appl, id, key), val);
+
+	if (!dbh->writer)
+		return false;
+
+	struct kv_write* w = malloc(sizeof(struct kv_write));
+	if (!w)
+		return false;
+
+	*w = (struct kv_write){
+		.type = type,
+		.appl = appl ? strdup(appl) : NULL,
+		.id = id,
+		.key = strdup(key),
+		.val = val ? strdup(val) : NULL
+	};
+
+	pthread_mutex_lock(&dbh->writer->lock);
+	*dbh->writer->tail = w;
+	dbh->writer->tail = &w->next;
+	dbh->writer->queued++;
+	pthread_mutex_unlock(&dbh->writer->lock);
+	return true;
+}
+
+static void writer_start(struct arcan_dbh* dbh, const char* fname, unsigned interval)
+{
+	struct kv_writer* wr = malloc(sizeof(struct kv_writer));
+	if (!wr)
+		return;
+
+	*wr = (struct kv_writer){
+		.interval = interval
+	};
+	wr->tail = &wr->pending;
+
+	if (SQLITE_OK != sqlite3_open_v2(fname, &wr->dbh, SQLITE_OPEN_READWRITE, NULL)){
+		arcan_warning("arcan_db(), no writer connection, writes are synchronous\n");
+		sqlite3_close(wr->dbh);
+		free(wr);
+		return;
+	}
+
+	sqlite3_busy_timeout(wr->dbh, 1000);
+	sqlite3_exec(wr->dbh, "PRAGMA foreign_keys=ON;", NULL, NULL, NULL);
+	sqlite3_exec(wr->dbh, "PRAGMA synchronous=OFF;", NULL, NULL, NULL);
+
+	pthread_mutex_init(&wr->lock, NULL);
+	pthread_cond_init(&wr->cond, NULL);
+
+	if (0 != pthread_create(&wr->thread, NULL, writer_thread, wr)){
+		pthread_mutex_destroy(&wr->lock);
+		pthread_cond_destroy(&wr->cond);
+		sqlite3_close(wr->dbh);
+		free(wr);
+		return;
+	}
+
+	dbh->writer = wr;
+}
+
+static void writer_stop(struct arcan_dbh* dbh)
+{
+	struct kv_writer* wr = dbh->writer;
+	if (!wr)
+		return;
+
+	pthread_mutex_lock(&wr->lock);
+	wr->shutdown = true;
+	pthread_cond_broadcast(&wr->cond);
+	pthread_mutex_unlock(&wr->lock);
+	pthread_join(wr->thread, NULL);
+
+	pthread_mutex_destroy(&wr->lock);
+	pthread_cond_destroy(&wr->cond);
+	sqlite3_close(wr->dbh);
+	free(wr);
+	dbh->writer = NULL;
+}
+
+/* arcan_fatal and other exit paths that never reach arcan_db_close */
+static void db_atexit()
+{
+	if (shared_handle)
+		db_cache_sync(shared_handle);
+}
+
+static sqlite3_stmt* db_stmt(struct arcan_dbh* dbh, const char* sql)
+{
+	struct db_stmt* ent;
+	HASH_FIND_STR(dbh->stmts, sql, ent);
+	if (ent)
+		return ent->stmt;
+
+	sqlite3_stmt* stmt = NULL;
+	if (SQLITE_OK != sqlite3_prepare_v2(dbh->dbh, sql, -1, &stmt, NULL)){
+		sqlite3_finalize(stmt);
+		return NULL;
+	}
+
+	ent = malloc(sizeof(struct db_stmt));
+	if (!ent || !(ent->sql = strdup(sql))){
+		free(ent);
+		sqlite3_finalize(stmt);
+		return NULL;
+	}
+
+	ent->stmt = stmt;
+	HASH_ADD_KEYPTR(hh, dbh->stmts, ent->sql, strlen(ent->sql), ent);
+	return stmt;
+}
+
+static void db_stmt_done(sqlite3_stmt* stmt)
+{
+	if (!stmt)
+		return;
+
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+}
+
+/* needs to happen before the connection can be closed */
+static void db_stmt_drop(struct arcan_dbh* dbh)
+{
+	struct db_stmt* ent, (* tmp);
+	HASH_ITER(hh, dbh->stmts, ent, tmp){
+		HASH_DEL(dbh->stmts, ent);
+		sqlite3_finalize(ent->stmt);
+		free(ent->sql);
+		free(ent);
+	}
+}
+
+/*
+ * any query that returns a list of strings, [cols] per row, as one packed
+ * array - rows with a NULL column are skipped as the array is NULL terminated
+ */
+static struct arcan_strarr db_packed_query(
+	struct arcan_dbh* dbh, sqlite3_stmt* stmt, size_t cols)
+{
+	struct arcan_strarr res = {.data = NULL};
+	char* buf = NULL;
+	size_t* ofs = NULL;
+	size_t buf_sz = 0, buf_used = 0, ofs_sz = 0, count = 0;
+
+	while (stmt && sqlite3_step(stmt) == SQLITE_ROW){
+		size_t len = 0;
+		bool skip = false;
+		for (size_t i = 0; i < cols && !skip; i++){
+			skip = sqlite3_column_type(stmt, i) == SQLITE_NULL;
+			len += sqlite3_column_bytes(stmt, i) + 1;
+		}
+		if (skip)
+			continue;
+
+		if (buf_used + len > buf_sz){
+			size_t nsz = buf_sz ? buf_sz * 2 : 4096;
+			while (nsz < buf_used + len)
+				nsz *= 2;
+			char* nbuf = realloc(buf, nsz);
+			if (!nbuf)
+				break;
+			buf = nbuf;
+			buf_sz = nsz;
+		}
+
+		if (count + cols > ofs_sz){
+			size_t nsz = ofs_sz ? ofs_sz * 2 : 64;
+			size_t* nofs = realloc(ofs, nsz * sizeof(size_t));
+			if (!nofs)
+				break;
+			ofs = nofs;
+			ofs_sz = nsz;
+		}
+
+/* offsets rather than pointers as the block can move while growing */
+		for (size_t i = 0; i < cols; i++){
+			const char* str = (const char*) sqlite3_column_text(stmt, i);
+			size_t nb = sqlite3_column_bytes(stmt, i);
+			memcpy(&buf[buf_used], str ? str : "", nb);
+			buf[buf_used + nb] = '\0';
+			ofs[count++] = buf_used;
+			buf_used += nb + 1;
+		}
+	}
+
+	db_stmt_done(stmt);
+
+	res.data = arcan_alloc_mem(sizeof(char*) * (count + 1),
+		ARCAN_MEM_STRINGBUF, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	for (size_t i = 0; i < count; i++)
+		res.data[i] = &buf[ofs[i]];
+
+	res.pack = buf;
+	res.count = count;
+	res.limit = count + 1;
+	free(ofs);
+
+	return res;
+}
+
 /*
  * any query that just returns a list of strings,
  * pack into a dbres (or append to an existing one)
@@ -188,7 +718,7 @@ static struct arcan_strarr db_string_query(struct arcan_dbh* dbh,
 
 /* we stop one step short of full capacity before
  * resizing to have both a valid count and a NULL terminated array */
-	while (sqlite3_step(stmt) == SQLITE_ROW){
+	while (stmt && sqlite3_step(stmt) == SQLITE_ROW){
 		if (res.count+1 >= res.limit)
 			arcan_mem_growarr(&res);
 
@@ -196,7 +726,7 @@ static struct arcan_strarr db_string_query(struct arcan_dbh* dbh,
 		res.data[res.count++] = (arg ? strdup(arg) : NULL);
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return res;
 }
 
@@ -205,21 +735,18 @@ static struct arcan_strarr db_string_query(struct arcan_dbh* dbh,
  */
 static int db_num_query(struct arcan_dbh* dbh, const char* qry, bool* status)
 {
-	sqlite3_stmt* stmt = NULL;
 	if (status) *status = false;
 	int count = -1;
 
-	int code = sqlite3_prepare_v2(dbh->dbh, qry, strlen(qry), &stmt, NULL);
-	if (SQLITE_OK == code){
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
+	if (stmt){
 		while (sqlite3_step(stmt) == SQLITE_ROW){
 			count = sqlite3_column_int(stmt, 0);
 			if (status) *status = true;
 		}
 
-		sqlite3_finalize(stmt);
+		db_stmt_done(stmt);
 	}
-	else
-		count = -1;
 
 	return count;
 }
@@ -260,7 +787,9 @@ void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl)
 	char dropbuf[sizeof(dropqry) + len + 1];
 	snprintf(dropbuf, sizeof(dropbuf), "%s%s;", dropqry, appl);
 
+	db_cache_sync(dbh);
 	db_void_query(dbh, dropbuf, true);
+	cache_drop(dbh);
 
 /* special case, reset version fields etc. */
 	if (strcmp(appl, ARCAN_TBL) == 0){
@@ -327,11 +856,12 @@ bool arcan_db_droptarget(struct arcan_dbh* dbh, arcan_targetid id)
 /* should suffice from ON DELETE CASCADE relationship */
 	static const char qry[]  = "DELETE FROM target WHERE tgtid = ?;";
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(qry)-1, &stmt, NULL);
+	db_cache_sync(dbh);
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
 	sqlite3_bind_int(stmt, 1, id);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
+	cache_drop(dbh);
 
 	return true;
 }
@@ -340,11 +870,12 @@ bool arcan_db_dropconfig(struct arcan_dbh* dbh, arcan_configid id)
 {
 	static const char qry[] = "DELETE FROM config WHERE cfgid = ?;";
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(qry)-1, &stmt, NULL);
+	db_cache_sync(dbh);
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
 	sqlite3_bind_int(stmt, 1, id);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
+	cache_drop(dbh);
 
 	return true;
 }
@@ -357,8 +888,7 @@ arcan_targetid arcan_db_addtarget(struct arcan_dbh* dbh,
 		"	target(tgtid, name, tag, executable, bfmt) VALUES "
 		"((select tgtid FROM target where name = ?), ?, ?, ?, ?)";
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, ddl, sizeof(ddl)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, ddl);
 
 	sqlite3_bind_text(stmt, 1, identifier, -1, SQLITE_STATIC);
 	sqlite3_bind_text(stmt, 2, identifier, -1, SQLITE_STATIC);
@@ -367,28 +897,28 @@ arcan_targetid arcan_db_addtarget(struct arcan_dbh* dbh,
 	sqlite3_bind_int(stmt, 5, bfmt);
 
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	arcan_targetid newid = sqlite3_last_insert_rowid(dbh->dbh);
 
 /* delete previous arguments */
 	static const char drop_argv[] = "DELETE FROM target_argv WHERE target = ?;";
-	sqlite3_prepare_v2(dbh->dbh, drop_argv, sizeof(drop_argv) - 1, &stmt, NULL);
+	stmt = db_stmt(dbh, drop_argv);
 	sqlite3_bind_int(stmt, 1, newid);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 /* add new ones */
 	if (0 == sz)
 		return newid;
 
 	static const char add_argv[] = DI_INSARG_TARGET;
+	stmt = db_stmt(dbh, add_argv);
 	for (size_t i = 0; i < sz; i++){
-		sqlite3_prepare_v2(dbh->dbh, add_argv, sizeof(add_argv) - 1, &stmt, NULL);
 		sqlite3_bind_int(stmt, 1, newid);
 		sqlite3_bind_text(stmt, 2, argv[i], -1, SQLITE_STATIC);
 		sqlite3_step(stmt);
-		sqlite3_finalize(stmt);
+		db_stmt_done(stmt);
 	}
 
 	return newid;
@@ -404,8 +934,7 @@ arcan_configid arcan_db_addconfig(struct arcan_dbh* dbh,
 		"passed_counter, failed_counter, target) VALUES "
 		"(NULL, ?, ?, ?, ?)";
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, ddl, sizeof(ddl)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, ddl);
 
 	sqlite3_bind_text(stmt, 1, identifier, -1, SQLITE_STATIC);
 	sqlite3_bind_int(stmt, 2, 0);
@@ -413,28 +942,28 @@ arcan_configid arcan_db_addconfig(struct arcan_dbh* dbh,
 	sqlite3_bind_int(stmt, 4, id);
 
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	arcan_configid newid = sqlite3_last_insert_rowid(dbh->dbh);
 
 /* delete previous arguments */
 	static const char drop_argv[] = "DELETE FROM config_argv WHERE config = ?;";
-	sqlite3_prepare_v2(dbh->dbh, drop_argv, sizeof(drop_argv) - 1, &stmt, NULL);
+	stmt = db_stmt(dbh, drop_argv);
 	sqlite3_bind_int(stmt, 1, newid);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 /* add new ones */
 	if (0 == sz)
 		return newid;
 
 	static const char add_argv[] = DI_INSARG_CONFIG;
+	stmt = db_stmt(dbh, add_argv);
 	for (size_t i = 0; i < sz; i++){
-		sqlite3_prepare_v2(dbh->dbh, add_argv, sizeof(add_argv) - 1, &stmt, NULL);
 		sqlite3_bind_int(stmt, 1, newid);
 		sqlite3_bind_text(stmt, 2, argv[i], -1, SQLITE_STATIC);
 		sqlite3_step(stmt);
-		sqlite3_finalize(stmt);
+		db_stmt_done(stmt);
 	}
 
 	return newid;
@@ -446,15 +975,15 @@ bool arcan_db_verifytarget(struct arcan_dbh* dbh, arcan_targetid id)
 {
 	static const char ddl[] = "SELECT COUNT(*) FROM target WHERE tgtid = ?;";
 
-	sqlite3_stmt* stmt = NULL;
-	if (SQLITE_OK == sqlite3_prepare_v2(
-		dbh->dbh, ddl, sizeof(ddl)-1, &stmt, NULL)){
-		sqlite3_bind_int(stmt, 1, id);
-		sqlite3_step(stmt);
-		return 1 == sqlite3_column_int(stmt, 0);
-	}
+	sqlite3_stmt* stmt = db_stmt(dbh, ddl);
+	if (!stmt)
+		return false;
+
+	sqlite3_bind_int(stmt, 1, id);
+	bool found = SQLITE_ROW == sqlite3_step(stmt) && 1 == sqlite3_column_int(stmt, 0);
+	db_stmt_done(stmt);
 
-	return false;
+	return found;
 }
 
 arcan_targetid arcan_db_targetid(struct arcan_dbh* dbh,
@@ -464,13 +993,13 @@ arcan_targetid arcan_db_targetid(struct arcan_dbh* dbh,
 	static const char dql[] = "SELECT tgtid FROM target WHERE name = ?;";
 	sqlite3_stmt* stmt;
 
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_text(stmt, 1, identifier, -1, SQLITE_STATIC);
 
 	if (SQLITE_ROW == sqlite3_step(stmt))
 		rid = sqlite3_column_int64(stmt, 0);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return rid;
 }
 
@@ -478,46 +1007,42 @@ struct arcan_strarr arcan_db_list_appl(struct arcan_dbh* dbh)
 {
 	static const char dql[] = "SELECT name FROM sqlite_master WHERE "
 		"type='table' and NAME like \"appl_%\"";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 
-	return db_string_query(dbh, stmt, NULL, 0);
+	return db_packed_query(dbh, stmt, 1);
 }
 
 struct arcan_strarr arcan_db_config_argv(struct arcan_dbh* dbh,arcan_configid id)
 {
 	static const char dql[] = "SELECT arg FROM config_argv WHERE "
 		"config = ? ORDER BY argnum ASC;";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, id);
 
-	return db_string_query(dbh, stmt, NULL, 0);
+	return db_packed_query(dbh, stmt, 1);
 }
 
 struct arcan_strarr arcan_db_target_argv(struct arcan_dbh* dbh,arcan_targetid id)
 {
 	static const char dql[] = "SELECT arg FROM target_argv WHERE "
 		"target = ? ORDER BY argnum ASC;";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, id);
 
-	return db_string_query(dbh, stmt, NULL, 0);
+	return db_packed_query(dbh, stmt, 1);
 }
 
 arcan_targetid arcan_db_cfgtarget(struct arcan_dbh* dbh, arcan_configid cfg)
 {
 	static const char dql[] = "SELECT target FROM config WHERE cfgid = ?;";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, cfg);
 	arcan_targetid tid = BAD_TARGET;
 
 	if (SQLITE_ROW == sqlite3_step(stmt))
 		tid = sqlite3_column_int64(stmt, 0);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return tid;
 }
 
@@ -529,14 +1054,14 @@ arcan_configid arcan_db_configid(struct arcan_dbh* dbh,
 	sqlite3_stmt* stmt;
 	arcan_configid cid = BAD_CONFIG;
 
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_text(stmt, 1, config, strlen(config), SQLITE_STATIC);
 	sqlite3_bind_int(stmt, 2, target);
 
 	if (SQLITE_ROW == sqlite3_step(stmt))
 		cid = sqlite3_column_int64(stmt, 0);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return cid;
 }
 
@@ -544,8 +1069,8 @@ struct arcan_strarr arcan_db_target_tags(struct arcan_dbh* dbh)
 {
 	sqlite3_stmt* stmt;
 	static const char dql[] = "SELECT DISTINCT tag FROM target;";
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
-	return db_string_query(dbh, stmt, NULL, 0);
+	stmt = db_stmt(dbh, dql);
+	return db_packed_query(dbh, stmt, 1);
 }
 
 struct arcan_strarr arcan_db_targets(struct arcan_dbh* dbh, const char* tag)
@@ -553,22 +1078,21 @@ struct arcan_strarr arcan_db_targets(struct arcan_dbh* dbh, const char* tag)
 	sqlite3_stmt* stmt;
 	if (!tag){
 		static const char dql[] = "SELECT name FROM target;";
-		sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+		stmt = db_stmt(dbh, dql);
 	}
 	else {
 		static const char dql[] = "SELECT name FROM target WHERE tag=?;";
-		sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+		stmt = db_stmt(dbh, dql);
 		sqlite3_bind_text(stmt, 1, tag, strlen(tag), SQLITE_STATIC);
 	}
-	return db_string_query(dbh, stmt, NULL, 0);
+	return db_packed_query(dbh, stmt, 1);
 }
 
 char* arcan_db_targettag(struct arcan_dbh* dbh, arcan_targetid tid)
 {
 	static const char dql[] = "SELECT tag FROM target WHERE tgtid = ?;";
 	char* resstr = NULL;
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 
 	sqlite3_bind_int(stmt, 1, tid);
 	if (sqlite3_step(stmt) == SQLITE_ROW){
@@ -578,7 +1102,7 @@ char* arcan_db_targettag(struct arcan_dbh* dbh, arcan_targetid tid)
 	if (resstr)
 		resstr = strdup(resstr);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return resstr;
 }
 
@@ -595,7 +1119,7 @@ char* arcan_db_targetexec(struct arcan_dbh* dbh,
 	static const char dql[] = "SELECT executable, bfmt "
 		"FROM target WHERE tgtid = ?;";
 
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql) - 1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, tid);
 
 	char* execstr = NULL;
@@ -607,12 +1131,11 @@ char* arcan_db_targetexec(struct arcan_dbh* dbh,
 	if (execstr)
 		execstr = strdup(execstr);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	static const char dql_tgt_argv[] = "SELECT arg FROM target_argv WHERE "
 		"target = ? ORDER BY argnum ASC;";
-	sqlite3_prepare_v2(dbh->dbh, dql_tgt_argv,
-		sizeof(dql_tgt_argv)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_tgt_argv);
 	sqlite3_bind_int(stmt, 1, tid);
 
 	*argv = db_string_query(dbh, stmt, NULL, 1);
@@ -620,29 +1143,25 @@ char* arcan_db_targetexec(struct arcan_dbh* dbh,
 
 	static const char dql_cfg_argv[] = "SELECT arg FROM config_argv WHERE "
 		"config = ? ORDER BY argnum ASC;";
-	sqlite3_prepare_v2(dbh->dbh, dql_cfg_argv,
-		sizeof(dql_cfg_argv)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_cfg_argv);
 	sqlite3_bind_int(stmt, 1, configid);
 	*argv = db_string_query(dbh, stmt, argv, 0);
 
 	static const char dql_tgt_env[] = "SELECT key || '=' || val "
 		"FROM target_env WHERE target = ?";
-	sqlite3_prepare_v2(dbh->dbh, dql_tgt_env,
-		sizeof(dql_tgt_env)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_tgt_env);
 	sqlite3_bind_int(stmt, 1, tid);
 	*env = db_string_query(dbh, stmt, NULL, 0);
 
 	static const char dql_cfg_env[] = "SELECT key || '=' || val "
 		"FROM config_env WHERE config = ?";
-	sqlite3_prepare_v2(dbh->dbh, dql_cfg_env,
-		sizeof(dql_cfg_env)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_cfg_env);
 	sqlite3_bind_int(stmt, 1, tid);
 	db_string_query(dbh, stmt, env, 0);
 
 	static const char dql_tgt_lib[] = "SELECT libname FROM target_libs WHERE "
 		"target = ?;";
-	sqlite3_prepare_v2(dbh->dbh, dql_tgt_lib,
-		sizeof(dql_tgt_lib)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_tgt_lib);
 	sqlite3_bind_int(stmt, 1, tid);
 	*libs = db_string_query(dbh, stmt, NULL, 0);
 
@@ -657,29 +1176,25 @@ void arcan_db_launch_status(struct arcan_dbh* dbh, arcan_configid cid, bool s)
 	static const char dql_fail[] = "UPDATE failed_counter SET "
 		"failed_counter = failed_counter + 1 WHERE config = ?;";
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh,
-		(s ? dql_ok : dql_fail), sizeof(dql_ok)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, (s ? dql_ok : dql_fail));
 	sqlite3_bind_int(stmt, 1, cid);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 }
 
 struct arcan_strarr arcan_db_configs(struct arcan_dbh* dbh, arcan_targetid tid)
 {
 	static const char dql[] = "SELECT name FROM config WHERE target = ?;";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, tid);
 
-	return db_string_query(dbh, stmt, NULL, 0);
+	return db_packed_query(dbh, stmt, 1);
 }
 
 char* arcan_db_execname(struct arcan_dbh* dbh, arcan_targetid tid)
 {
 	static const char dql[] = "SELECT executable FROM target WHERE tgtid = ?;";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, tid);
 
 	char* res = NULL;
@@ -688,58 +1203,55 @@ char* arcan_db_execname(struct arcan_dbh* dbh, arcan_targetid tid)
 		res = arg ? strdup((char*)arg) : NULL;
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return res;
 }
 
 void arcan_db_begin_transaction(struct arcan_dbh* dbh,
 	enum DB_KVTARGET kvt, union arcan_dbtrans_id id)
 {
-	if (dbh->transaction)
+	if (dbh->transaction || dbh->cached_tr)
 		arcan_fatal("arcan_db_begin_transaction()"
 			"	called during a pending transaction\n");
 
+/* the pairs go to the cache and the writer queue */
+	if (dbh->writer &&
+		(kvt == DVT_APPL || kvt == DVT_TARGET || kvt == DVT_CONFIG)){
+		dbh->cached_tr = true;
+		dbh->trid = id;
+		dbh->ttype = kvt;
+		return;
+	}
+
 	sqlite3_exec(dbh->dbh, "BEGIN;", NULL, NULL, NULL);
-	int code = SQLITE_OK;
+	const char* qry = NULL;
 
 	switch (kvt){
 	case DVT_APPL:
-		code = sqlite3_prepare_v2(dbh->dbh, dbh->akv_update,
-			dbh->akv_upd_sz, &dbh->transaction, NULL);
+		qry = dbh->akv_update;
 	break;
-
 	case DVT_TARGET:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET,
-			strlen(DI_INSKV_TARGET)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET;
 	break;
-
 	case DVT_CONFIG:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_CONFIG,
-			strlen(DI_INSKV_CONFIG)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_CONFIG;
 	break;
-
 	case DVT_CONFIG_ENV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_CONFIG_ENV,
-			strlen(DI_INSKV_TARGET_ENV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_CONFIG_ENV;
 	break;
-
 	case DVT_TARGET_ENV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET_ENV,
-			strlen(DI_INSKV_TARGET_ENV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET_ENV;
 	break;
-
 	case DVT_TARGET_LIBV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET_LIBV,
-			strlen(DI_INSKV_TARGET_LIBV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET_LIBV;
 	break;
 	case DVT_ENDM:
 	break;
 	}
 
-	if (code != SQLITE_OK){
-		arcan_warning("arcan_db_begin_transaction(), failed: %s\n",
-			sqlite3_errmsg(dbh->dbh));
-	}
+/* the statement stays in the cache, end_transaction only resets it */
+	if (qry)
+		dbh->transaction = db_stmt(dbh, qry);
 
 	dbh->trid = id;
 	dbh->ttype = kvt;
@@ -760,12 +1272,12 @@ struct arcan_strarr arcan_db_getkeys(struct arcan_dbh* dbh,
 	else
 		qry = queries[1];
 
-	sqlite3_stmt * stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(GET_KV_TGT)-1, &stmt, NULL);
+	db_cache_sync(dbh);
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
 	sqlite3_bind_int(stmt, 1, tgt>=DVT_TARGET && tgt<DVT_CONFIG ? id.tid:id.cid);
 
 #undef GET_KV_TGT
-	return db_string_query(dbh, stmt, NULL, 0);
+	return db_packed_query(dbh, stmt, 1);
 }
 
 struct arcan_strarr arcan_db_applkeys(struct arcan_dbh* dbh,
@@ -775,25 +1287,22 @@ struct arcan_strarr arcan_db_applkeys(struct arcan_dbh* dbh,
 
 	size_t mk_sz = sizeof(MATCH_APPL) + strlen(applname);
 	char mk_buf[ mk_sz ];
-	ssize_t nw = snprintf(mk_buf, mk_sz, MATCH_APPL, applname);
+	snprintf(mk_buf, mk_sz, MATCH_APPL, applname);
+	db_cache_sync(dbh);
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, mk_buf, mk_sz-1, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, mk_buf);
 	sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
 
-	return db_string_query(dbh, stmt, NULL, 0);
+	return db_packed_query(dbh, stmt, 1);
 #undef MATCH_KEY_APPL
 }
 
 struct arcan_strarr arcan_db_matchkey(struct arcan_dbh* dbh,
 	enum DB_KVTARGET tgt, const char* pattern)
 {
-#define MATCH_KEY_TGT "SELECT tgtid ||':'|| value"\
-	" FROM target_kv WHERE key LIKE ?;"
-
 	static const char* const queries[] = {
-		MATCH_KEY_TGT,
-		"SELECT cfgid || ':' || value FROM config_kv WHERE key LIKE ?;"
+		"SELECT target || ':' || val FROM target_kv WHERE key LIKE ?;",
+		"SELECT config || ':' || val FROM config_kv WHERE key LIKE ?;"
 	};
 
 	const char* qry = NULL;
@@ -802,11 +1311,81 @@ struct arcan_strarr arcan_db_matchkey(struct arcan_dbh* dbh,
 	else
 		qry = queries[1];
 
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(MATCH_KEY_TGT)-1, &stmt, NULL);
+	db_cache_sync(dbh);
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
 	sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
 
-	return db_string_query(dbh, stmt, NULL, 0);
+	return db_packed_query(dbh, stmt, 1);
+}
+
+/*
+ * The upper bound for keys that start with [prefix], NULL if there is none
+ * (empty prefix or nothing but 0xff), the kv indices can then serve the query
+ * as a range rather than as a LIKE scan
+ */
+static char* prefix_bound(const char* prefix)
+{
+	char* dst = strdup(prefix);
+	if (!dst)
+		return NULL;
+
+	size_t len = strlen(dst);
+	while (len && (unsigned char) dst[len-1] == 0xff)
+		dst[--len] = '\0';
+
+	if (!len){
+		free(dst);
+		return NULL;
+	}
+
+	dst[len-1]++;
+	return dst;
+}
+
+struct arcan_strarr arcan_db_prefixkeys(struct arcan_dbh* dbh,
+	enum DB_KVTARGET tgt, int64_t id,
+	const char* prefix, const char* after, size_t limit)
+{
+	const char* tbl = "target_kv WHERE target = ?3 AND";
+	if (tgt == DVT_APPL)
+		tbl = NULL;
+	else if (tgt == DVT_CONFIG || tgt == DVT_CONFIG_ENV)
+		tbl = "config_kv WHERE config = ?3 AND";
+
+	if (!prefix)
+		prefix = "";
+
+/* continuing a page, the last key returned is the new lower bound */
+	bool cont = after && strcmp(after, prefix) >= 0;
+	char* upper = prefix_bound(prefix);
+	bool bound = upper != NULL;
+
+/* out of memory rather than no bound */
+	if (!bound && prefix[0] && (unsigned char) prefix[0] != 0xff)
+		return (struct arcan_strarr){.data = NULL};
+
+	char* qry = NULL;
+	asprintf(&qry, "SELECT key, val FROM %s%s%s key %s ?1%s ORDER BY key LIMIT ?4;",
+		tbl ? tbl : "appl_", tbl ? "" : dbh->applname, tbl ? "" : " WHERE",
+		cont ? ">" : ">=", bound ? " AND key < ?2" : "");
+	if (!qry){
+		free(upper);
+		return (struct arcan_strarr){.data = NULL};
+	}
+
+	db_cache_sync(dbh);
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
+	free(qry);
+
+	sqlite3_bind_text(stmt, 1, cont ? after : prefix, -1, SQLITE_TRANSIENT);
+	if (bound)
+		sqlite3_bind_text(stmt, 2, upper, -1, SQLITE_TRANSIENT);
+	free(upper);
+	if (tbl)
+		sqlite3_bind_int64(stmt, 3, id);
+	sqlite3_bind_int64(stmt, 4, limit ? (int64_t) limit : -1);
+
+	return db_packed_query(dbh, stmt, 2);
 }
 
 char* arcan_db_getvalue(struct arcan_dbh* dbh,
@@ -816,32 +1395,22 @@ char* arcan_db_getvalue(struct arcan_dbh* dbh,
 /* must match enum */
 	assert(DVT_ENDM == 5);
 
+	if (tgt == DVT_APPL)
+		return arcan_db_appl_val(dbh, dbh->applname, key);
+
 	static const char* queries[] = {
-		"SELECT val FROM target_kv WHERE key = ? AND tgtid = ? LIMIT 1;",
-		"SELECT val FROM config_kv WHERE key = ? AND cfgid = ? LIMIT 1;"
+		"SELECT val FROM target_kv WHERE key = ? AND target = ? LIMIT 1;",
+		"SELECT val FROM config_kv WHERE key = ? AND config = ? LIMIT 1;"
 	};
 
-	const char* qry = NULL;
-	if (tgt >= DVT_TARGET && tgt < DVT_CONFIG)
-		qry = queries[0];
-	else
-		qry = queries[1];
-
-/* assume they all are the same length */
-	static size_t qry_sz;
-	if (qry_sz == 0)
-		qry_sz = strlen(queries[1]);
-
-	sqlite3_stmt* stmt = NULL;
+	bool is_tgt = tgt >= DVT_TARGET && tgt < DVT_CONFIG;
+	enum DB_KVTARGET ns = is_tgt ? DVT_TARGET : DVT_CONFIG;
+	if (cache_lookup(dbh, ns, NULL, id, key, &res))
+		return res;
 
-	if (tgt == DVT_APPL){
-		sqlite3_prepare_v2(dbh->dbh, dbh->akv_get, dbh->akv_get_sz, &stmt, NULL);
-	}
-	else {
-		sqlite3_prepare_v2(dbh->dbh, qry, qry_sz, &stmt, NULL);
-		sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
-		sqlite3_bind_int(stmt, 2, id);
-	}
+	sqlite3_stmt* stmt = db_stmt(dbh, queries[is_tgt ? 0 : 1]);
+	sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 2, id);
 
 	if (SQLITE_ROW == sqlite3_step(stmt)){
 		const char* row = (const char*) sqlite3_column_text(stmt, 0);
@@ -849,14 +1418,18 @@ char* arcan_db_getvalue(struct arcan_dbh* dbh,
 			res = strdup(row);
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
+
+	if (dbh->cache_on)
+		cache_set(dbh, cache_key(ns, NULL, id, key), res);
+
 	return res;
 }
 
 void arcan_db_add_kvpair(
 	struct arcan_dbh* dbh, const char* key, const char* val)
 {
-	if (!dbh->transaction)
+	if (!dbh->transaction && !dbh->cached_tr)
 		arcan_fatal("arcan_db_add_kvpair() "
 			"called without any open transaction.");
 
@@ -865,6 +1438,20 @@ void arcan_db_add_kvpair(
 		return;
 	}
 
+/* an empty value is the same as removing the key, if the write couldn't be
+ * queued it goes straight to the main connection instead */
+	int64_t id = dbh->ttype == DVT_TARGET ? dbh->trid.tid : dbh->trid.cid;
+	if (dbh->cached_tr){
+		const char* v = val[0] ? val : NULL;
+		if (!cache_write(dbh, dbh->ttype, dbh->applname, id, key, v))
+			kv_apply(dbh->dbh, dbh->ttype, dbh->applname, id, key, v);
+		return;
+	}
+
+	if (dbh->cache_on &&
+		(dbh->ttype == DVT_APPL || dbh->ttype == DVT_TARGET || dbh->ttype == DVT_CONFIG))
+		cache_set(dbh, cache_key(dbh->ttype, dbh->applname, id, key), val[0] ? val : NULL);
+
 	if (val[0] == 0)
 		dbh->trclean = true;
 
@@ -900,11 +1487,17 @@ void arcan_db_add_kvpair(
 
 void arcan_db_end_transaction(struct arcan_dbh* dbh)
 {
+	if (dbh->cached_tr){
+		dbh->cached_tr = false;
+		dbh->trclean = false;
+		return;
+	}
+
 	if (!dbh->transaction)
 		arcan_fatal("arcan_db_end_transaction() "
 			"called without any open transaction.");
 
-	sqlite3_finalize(dbh->transaction);
+	db_stmt_done(dbh->transaction);
 
 	if (dbh->trclean){
 		switch (dbh->ttype){
@@ -942,6 +1535,9 @@ bool arcan_db_appl_kv(struct arcan_dbh* dbh,
 	if (!applname || !dbh || !key)
 		return rv;
 
+	if (cache_write(dbh, DVT_APPL, applname, 0, key, value))
+		return true;
+
 	const char ddl_insert[] = "INSERT OR REPLACE "
 		"INTO appl_%s(key, val) VALUES(?, ?);";
 	const char k_drop[] = "DELETE FROM appl_%s WHERE key=?;";
@@ -957,25 +1553,89 @@ bool arcan_db_appl_kv(struct arcan_dbh* dbh,
 		upd_sz = sizeof(ddl_insert) + strlen(applname);
 
 	char upd_buf[ upd_sz ];
-	ssize_t nw = snprintf(upd_buf, upd_sz, dqry, applname);
+	snprintf(upd_buf, upd_sz, dqry, applname);
 
-	sqlite3_stmt* stmt = NULL;
-	sqlite3_prepare_v2(dbh->dbh, upd_buf, nw, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, upd_buf);
 	sqlite3_bind_text(stmt, 1, key,   -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text(stmt, 2, value, -1, SQLITE_TRANSIENT);
 
 	rv = sqlite3_step(stmt) == SQLITE_DONE;
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	return rv;
 }
 
+static struct arcan_strarr appl_keyset(struct arcan_dbh* dbh, const char* applname)
+{
+	const char qry[] = "SELECT key, val FROM appl_%s;";
+	size_t qry_sz = sizeof(qry) + strlen(applname);
+	char qry_buf[ qry_sz ];
+	snprintf(qry_buf, qry_sz, qry, applname);
+
+	return db_packed_query(dbh, db_stmt(dbh, qry_buf), 2);
+}
+
+struct arcan_strarr arcan_db_appl_keyset(
+	struct arcan_dbh* dbh, const char* applname)
+{
+	db_cache_sync(dbh);
+	return appl_keyset(dbh, applname);
+}
+
+/*
+ * On the first miss in an appl namespace, read all of it in one query rather
+ * than a query per key. Keys that already are in the cache can be newer than
+ * what has been committed so those are left alone. The empty key marks the
+ * namespace as read, with a NULL value if it was too large to cache.
+ */
+static void cache_fill_appl(struct arcan_dbh* dbh, const char* applname)
+{
+	char* mark = cache_key(DVT_APPL, applname, 0, "");
+	if (!mark)
+		return;
+
+	struct kv_cache* ent;
+	HASH_FIND_STR(dbh->cache, mark, ent);
+	if (ent){
+		free(mark);
+		return;
+	}
+
+	struct arcan_strarr set = appl_keyset(dbh, applname);
+	bool fits = dbh->cache_count + set.count / 2 < DB_CACHE_LIMIT / 2;
+
+	for (size_t i = 0; fits && i + 1 < set.count; i += 2){
+		char* hkey = cache_key(DVT_APPL, applname, 0, set.data[i]);
+		if (!hkey)
+			continue;
+
+		HASH_FIND_STR(dbh->cache, hkey, ent);
+		if (ent)
+			free(hkey);
+		else
+			cache_set(dbh, hkey, set.data[i+1]);
+	}
+
+	cache_set(dbh, mark, fits ? "" : NULL);
+	arcan_mem_freearr(&set);
+}
+
 char* arcan_db_appl_val(struct arcan_dbh* dbh,
 	const char* const applname, const char* const key)
 {
 	if (!dbh || !key)
 		return NULL;
 
+	char* rv = NULL;
+	if (cache_lookup(dbh, DVT_APPL, applname, 0, key, &rv))
+		return rv;
+
+	if (dbh->cache_on){
+		cache_fill_appl(dbh, applname);
+		if (cache_lookup(dbh, DVT_APPL, applname, 0, key, &rv))
+			return rv;
+	}
+
 	const char qry[] = "SELECT val FROM appl_%s WHERE key = ?;";
 
 	size_t wbuf_sz = strlen(applname) + sizeof(qry);
@@ -983,11 +1643,9 @@ char* arcan_db_appl_val(struct arcan_dbh* dbh,
 	memset(wbuf, '\0', wbuf_sz);
 	snprintf(wbuf, wbuf_sz, qry, applname);
 
-	sqlite3_stmt* stmt = NULL;
-	sqlite3_prepare_v2(dbh->dbh, wbuf, wbuf_sz, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, wbuf);
 	sqlite3_bind_text(stmt, 1, (char*) key, -1, SQLITE_TRANSIENT);
 
-	char* rv = NULL;
 	int rc = sqlite3_step(stmt);
 
 	if (rc == SQLITE_ROW){
@@ -997,7 +1655,10 @@ char* arcan_db_appl_val(struct arcan_dbh* dbh,
 			rv = strdup((const char*) rowt);
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
+
+	if (dbh->cache_on)
+		cache_set(dbh, cache_key(DVT_APPL, applname, 0, key), rv);
 
 	return rv;
 }
@@ -1050,6 +1711,9 @@ void arcan_db_close(struct arcan_dbh** ctx)
 	if (!ctx)
 		return;
 
+	writer_stop(*ctx);
+	cache_drop(*ctx);
+	db_stmt_drop(*ctx);
 	sqlite3_close((*ctx)->dbh);
 	arcan_mem_free((*ctx)->applname);
 	arcan_mem_free((*ctx)->akv_update);
@@ -1073,6 +1737,7 @@ struct arcan_dbh* arcan_db_open(const char* fname, const char* applname)
 			return NULL;
 
 		atexit(sqliteexit);
+		atexit(db_atexit);
 	}
 
 	if (!applname)
@@ -1089,6 +1754,7 @@ struct arcan_dbh* arcan_db_open(const char* fname, const char* applname)
 		assert(dbh);
 
 		if ( !dbh_integrity_check(res) ){
+			db_stmt_drop(res);
 			sqlite3_close(dbh);
 			arcan_mem_free(res);
 			return NULL;
@@ -1100,6 +1766,33 @@ struct arcan_dbh* arcan_db_open(const char* fname, const char* applname)
 		db_void_query(res, "PRAGMA foreign_keys=ON;", false);
 		db_void_query(res, "PRAGMA synchronous=OFF;", false);
 
+/* the UNIQUE (key, id) indices don't help with per id prefix queries,
+ * added here rather than in the DDL so that older databases get them too */
+		db_void_query(res, "CREATE INDEX IF NOT EXISTS "
+			"target_kv_range ON target_kv(target, key);", false);
+		db_void_query(res, "CREATE INDEX IF NOT EXISTS "
+			"config_kv_range ON config_kv(config, key);", false);
+
+#ifndef ARCAN_DB_STANDALONE
+/* the writer needs a second connection to the same database, which an
+ * in-memory one can't have, the cache still serves reads there */
+		res->cache_on = true;
+		if (strcmp(fname, ":memory:") != 0 && strlen(fname) > 0){
+			db_void_query(res, "PRAGMA journal_mode=WAL;", true);
+
+			const char* env = getenv("ARCAN_DB_FLUSH_INTERVAL");
+			char* cfg = env ? NULL : arcan_db_appl_val(res, ARCAN_TBL, "db_flush_interval");
+			unsigned interval = DB_FLUSH_INTERVAL;
+			if (env || cfg)
+				interval = strtoul(env ? env : cfg, NULL, 10);
+			arcan_mem_free(cfg);
+
+/* a cached value from the lookup above is fine, the writer isn't running */
+			if (interval)
+				writer_start(res, fname, interval);
+		}
+#endif
+
 		return res;
 	}
 	else
@@ -43,6 +43,10 @@ static const int BAD_CONFIG = -1;
 /* Opens database and performs a sanity check,
  * Creates an entry for applname unless one already exists,
  * returns null IF fname can't be opened/read OR sanity check fails.
+ *
+ * Key/values are cached and writes to a file database are committed in
+ * batches from a separate thread every ARCAN_DB_FLUSH_INTERVAL (or the
+ * arcan appl key db_flush_interval) ms, 0 writes through immediately.
  */
 struct arcan_dbh* arcan_db_open(const char* fname, const char* applname);
 
@@ -231,6 +235,25 @@ void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl);
 bool arcan_db_appl_kv(struct arcan_dbh* dbh, const char* appl,
 	const char* key, const char* value);
 
+/*
+ * Retrieve keys and values (alternating entries, packed) in key order where
+ * the key starts with [prefix], from the appl- specific namespace (DVT_APPL)
+ * or the target/config one identified by [id]. This is served as a range over
+ * the key index. [after] (can be NULL) is the last key of a previous page to
+ * continue from and [limit] the number of pairs in a page, 0 for all of them.
+ */
+struct arcan_strarr arcan_db_prefixkeys(struct arcan_dbh*,
+	enum DB_KVTARGET, int64_t id,
+	const char* prefix, const char* after, size_t limit);
+
+/*
+ * Retrieve all keys and values in an appl- specific namespace with one query,
+ * as alternating key, value entries. The array is packed (see arcan_strarr)
+ * and is freed with arcan_mem_freearr as usual.
+ */
+struct arcan_strarr arcan_db_appl_keyset(
+	struct arcan_dbh* dbh, const char* appl);
+
 /*
  * Retrieve the current value stored with key
  * caller is expected to mem_free string, can return NULL.
@@ -22,6 +22,7 @@
 #include <errno.h>
 #include <math.h>
 #include <assert.h>
+#include <stdatomic.h>
 #include <signal.h>
 
 /*
@@ -43,12 +44,13 @@
 #include "arcan_led.h"
 
 #include "arcan_frameserver.h"
+#include "arcan_conductor.h"
 
 typedef struct queue_cell queue_cell;
 
 static arcan_event eventbuf[ARCAN_EVENT_QUEUE_LIM];
 
-static uint8_t eventfront = 0, eventback = 0;
+static uint16_t eventfront = 0, eventback = 0;
 static int64_t epoch;
 
 /* basic context is just mapped on the static buffer, the reason for this
@@ -73,15 +75,26 @@ static struct arcan_evctx default_evctx = {
 static int panic_keysym = -1, panic_keymod = -1;
 
 /* fixed size 64 entries bitmap for dynamic event source tracking */
+/* sources are registered with the conductor wait set, the list is only
+ * kept to map del_source back to the watch and its tag, and to refill the
+ * per-tick event budget */
 struct evsrc_meta {
+	int fd;
 	intptr_t tag;
-	mode_t mode;
+	int mode;
 	bool mask;
+	bool throttled;
+	unsigned spent;
+	struct arcan_evctx* ctx;
+	struct evsrc_meta* next;
 };
 
-static struct pollfd evsrc_pollset[64];
-static struct evsrc_meta evsrc_meta[64];
-static uint64_t evsrc_bitmap;
+static struct evsrc_meta* evsrc_first;
+
+/* number of events a single source may inject per tick, 0 = unlimited */
+static unsigned evsrc_budget = 32;
+static bool evsrc_budget_init;
+static void evsrc_refill();
 
 arcan_evctx* arcan_event_defaultctx(){
 	return &default_evctx;
@@ -106,11 +119,120 @@ static bool queue_full(arcan_evctx* ctx)
 	 return (((*ctx->back + 1) % ctx->eventbuf_sz) == *ctx->front);
 }
 
+unsigned arcan_event_queuedepth(arcan_evctx* ctx)
+{
+	if (!ctx || !ctx->front || !ctx->back || !ctx->eventbuf_sz)
+		return 0;
+
+/* the offsets might be in shared memory, only trust them as counters */
+	unsigned front = *ctx->front % ctx->eventbuf_sz;
+	unsigned back = *ctx->back % ctx->eventbuf_sz;
+	return (back + ctx->eventbuf_sz - front) % ctx->eventbuf_sz;
+}
+
 static bool queue_empty(arcan_evctx* ctx)
 {
 	return (*ctx->front == *ctx->back);
 }
 
+/*
+ * Pop up to [lim] events from [ctx] into [dst] with a single barrier and a
+ * single update of the front index, used by queuetransfer to move batches
+ * out of (untrusted) frameserver queues.
+ */
+static size_t queue_batch(arcan_evctx* ctx, struct arcan_event* dst, size_t lim)
+{
+	if (ctx->local){
+		size_t count = 0;
+		while (count < lim && arcan_event_poll(ctx, &dst[count]))
+			count++;
+		return count;
+	}
+
+	FORCE_SYNCH();
+	unsigned front = *(ctx->front);
+	unsigned back = *(ctx->back);
+
+	if (front >= ctx->eventbuf_sz || back >= ctx->eventbuf_sz){
+		pull_killswitch(ctx);
+		return 0;
+	}
+
+	size_t count = 0;
+	while (front != back && count < lim){
+		dst[count++] = ctx->eventbuf[front];
+		memset(&ctx->eventbuf[front], 0xff, sizeof(struct arcan_event));
+		front = (front + 1) % ctx->eventbuf_sz;
+	}
+
+	FORCE_SYNCH();
+	*(ctx->front) = front;
+	return count;
+}
+
+/*
+ * Bounded MPSC queue for producers outside of the main thread. Slots carry a
+ * lap counter, even when free for the lap and odd when filled, so producers
+ * only contend on the head index and never wait on each other.
+ */
+#define ASYNC_QUEUE_SZ 256
+static struct {
+	struct {
+		_Atomic size_t lap;
+		struct arcan_event ev;
+	} slot[ASYNC_QUEUE_SZ];
+	_Atomic size_t head;
+	size_t tail;
+} async_queue;
+
+bool arcan_event_enqueue_async(const struct arcan_event* const src)
+{
+	size_t pos = atomic_load_explicit(&async_queue.head, memory_order_relaxed);
+
+	for(;;){
+		size_t lap = (pos / ASYNC_QUEUE_SZ) * 2;
+		size_t cur = atomic_load_explicit(
+			&async_queue.slot[pos % ASYNC_QUEUE_SZ].lap, memory_order_acquire);
+
+		if (cur == lap){
+			if (atomic_compare_exchange_weak_explicit(&async_queue.head,
+				&pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+				break;
+		}
+/* slot still holds the previous lap, consumer is behind */
+		else if (cur < lap)
+			return false;
+		else
+			pos = atomic_load_explicit(&async_queue.head, memory_order_relaxed);
+	}
+
+	async_queue.slot[pos % ASYNC_QUEUE_SZ].ev = *src;
+	atomic_store_explicit(&async_queue.slot[pos % ASYNC_QUEUE_SZ].lap,
+		(pos / ASYNC_QUEUE_SZ) * 2 + 1, memory_order_release);
+
+	return true;
+}
+
+/* move everything the producers have published into the default queue */
+static void async_drain(arcan_evctx* ctx)
+{
+	for(;;){
+		size_t pos = async_queue.tail;
+		size_t lap = (pos / ASYNC_QUEUE_SZ) * 2;
+
+		if (atomic_load_explicit(&async_queue.slot[pos % ASYNC_QUEUE_SZ].lap,
+			memory_order_acquire) != lap + 1)
+			return;
+
+		struct arcan_event ev = async_queue.slot[pos % ASYNC_QUEUE_SZ].ev;
+		atomic_store_explicit(&async_queue.slot[pos % ASYNC_QUEUE_SZ].lap,
+			lap + 2, memory_order_release);
+		async_queue.tail = pos + 1;
+
+		arcan_event_enqueue(ctx, &ev);
+	}
+}
+
 int arcan_event_poll(arcan_evctx* ctx, struct arcan_event* dst)
 {
 	assert(dst);
@@ -121,14 +243,14 @@ int arcan_event_poll(arcan_evctx* ctx, struct arcan_event* dst)
  * wake the guard thread that will try to safely shut down */
 	if (ctx->local == false){
 		FORCE_SYNCH();
-		if ( *(ctx->front) > PP_QUEUE_SZ ){
+		if ( *(ctx->front) >= ctx->eventbuf_sz ){
 			pull_killswitch(ctx);
 			return 0;
 		}
 		else {
 			*dst = ctx->eventbuf[ *(ctx->front) ];
 			memset(&ctx->eventbuf[ *(ctx->front) ], 0xff, sizeof(struct arcan_event));
-			*(ctx->front) = (*(ctx->front) + 1) % PP_QUEUE_SZ;
+			*(ctx->front) = (*(ctx->front) + 1) % ctx->eventbuf_sz;
 		}
 	}
 	else {
@@ -184,6 +306,209 @@ int arcan_event_denqueue(arcan_evctx* ctx, const struct arcan_event* const src)
 	return arcan_event_enqueue(ctx, src);
 }
 
+/*
+ * Coalescing for high-rate analog and touch sources (8kHz mice, pens, touch
+ * screens): samples are held back per devid/subid/kind until the next
+ * arcan_event_process, accumulating relative motion and keeping the latest
+ * absolute value. Any other input event flushes the held samples first so
+ * the order relative to buttons and keys is preserved.
+ */
+#define COALESCE_SLOTS 32
+#define COALESCE_DEVICES 16
+#define COALESCE_HISTORY 64
+
+static struct {
+	struct arcan_event pending[COALESCE_SLOTS];
+	size_t n_pending;
+	bool flushing;
+
+	int default_mode;
+	bool init;
+
+	struct {
+		int devid;
+		int mode;
+		struct arcan_ioevent* history;
+		size_t hist_pos, hist_count;
+	} dev[COALESCE_DEVICES];
+} coalesce = {
+	.dev[0 ... COALESCE_DEVICES-1].devid = -1
+};
+
+static int coalesce_mode(int devid, size_t* slot)
+{
+	for (size_t i = 0; i < COALESCE_DEVICES; i++)
+		if (coalesce.dev[i].devid == devid){
+			*slot = i;
+			return coalesce.dev[i].mode;
+		}
+
+	*slot = COALESCE_DEVICES;
+	return coalesce.default_mode;
+}
+
+void arcan_event_coalesce(int devid, enum arcan_event_coalesce mode)
+{
+	if (devid < 0){
+		coalesce.default_mode = mode;
+		coalesce.init = true;
+		return;
+	}
+
+	size_t slot;
+	coalesce_mode(devid, &slot);
+	if (slot == COALESCE_DEVICES){
+		for (slot = 0; slot < COALESCE_DEVICES; slot++)
+			if (coalesce.dev[slot].devid == -1)
+				break;
+		if (slot == COALESCE_DEVICES){
+			arcan_warning("event_coalesce(), device limit (%d) reached\n",
+				COALESCE_DEVICES);
+			return;
+		}
+		coalesce.dev[slot].devid = devid;
+	}
+
+	coalesce.dev[slot].mode = mode;
+
+	if (mode == EVENT_COALESCE_HISTORY && !coalesce.dev[slot].history){
+		coalesce.dev[slot].history = arcan_alloc_mem(
+			sizeof(struct arcan_ioevent) * COALESCE_HISTORY,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	}
+	else if (mode != EVENT_COALESCE_HISTORY){
+		arcan_mem_free(coalesce.dev[slot].history);
+		coalesce.dev[slot].history = NULL;
+	}
+
+	coalesce.dev[slot].hist_pos = coalesce.dev[slot].hist_count = 0;
+}
+
+size_t arcan_event_history(int devid, struct arcan_ioevent* dst, size_t lim)
+{
+	size_t slot;
+	coalesce_mode(devid, &slot);
+	if (slot == COALESCE_DEVICES || !coalesce.dev[slot].history)
+		return 0;
+
+/* oldest first, reading consumes the history */
+	size_t count = coalesce.dev[slot].hist_count;
+	size_t start =
+		(coalesce.dev[slot].hist_pos + COALESCE_HISTORY - count) % COALESCE_HISTORY;
+
+	if (count > lim)
+		count = lim;
+
+	for (size_t i = 0; i < count; i++)
+		dst[i] = coalesce.dev[slot].history[(start + i) % COALESCE_HISTORY];
+
+	coalesce.dev[slot].hist_count = 0;
+	return count;
+}
+
+static void coalesce_flush(arcan_evctx* ctx)
+{
+	if (!coalesce.n_pending)
+		return;
+
+	coalesce.flushing = true;
+	for (size_t i = 0; i < coalesce.n_pending; i++)
+		arcan_event_enqueue(ctx, &coalesce.pending[i]);
+	coalesce.n_pending = 0;
+	coalesce.flushing = false;
+}
+
+static int16_t clamp_i16(int v)
+{
+	return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v);
+}
+
+/* merge [src] into [dst], returns false if the two can't be merged */
+static bool coalesce_merge(struct arcan_ioevent* dst, const struct arcan_ioevent* src)
+{
+	if (src->kind == EVENT_IO_TOUCH){
+/* press / release transitions are never merged away */
+		if (dst->input.touch.active != src->input.touch.active)
+			return false;
+		dst->input.touch = src->input.touch;
+	}
+	else {
+		if (dst->input.analog.gotrel != src->input.analog.gotrel ||
+			dst->input.analog.nvalues != src->input.analog.nvalues)
+			return false;
+
+/* relative samples come on even indices if gotrel is set, odd otherwise */
+		size_t nv = src->input.analog.nvalues;
+		for (size_t i = 0; i < nv && i < 4; i++){
+			bool rel = (nv != 3 || i != 2) &&
+				(src->input.analog.gotrel ? !(i % 2) : (i % 2));
+
+			if (rel)
+				dst->input.analog.axisval[i] = clamp_i16(
+					dst->input.analog.axisval[i] + src->input.analog.axisval[i]);
+			else
+				dst->input.analog.axisval[i] = src->input.analog.axisval[i];
+		}
+	}
+
+/* keep the earliest (read time for local input) for latency tracking */
+	if (!dst->pts || (src->pts && src->pts < dst->pts))
+		dst->pts = src->pts;
+	return true;
+}
+
+/* returns true if the event was absorbed into the pending set */
+static bool coalesce_event(arcan_evctx* ctx, const struct arcan_event* src)
+{
+	if (!coalesce.init){
+		uintptr_t tag;
+		cfg_lookup_fun get_config = platform_config_lookup(&tag);
+		if (get_config("event_coalesce", 0, NULL, tag))
+			coalesce.default_mode = EVENT_COALESCE_MERGE;
+		coalesce.init = true;
+	}
+
+	if (src->io.kind != EVENT_IO_AXIS_MOVE && src->io.kind != EVENT_IO_TOUCH){
+		coalesce_flush(ctx);
+		return false;
+	}
+
+	size_t slot;
+	int mode = coalesce_mode(src->io.devid, &slot);
+	if (mode == EVENT_COALESCE_OFF){
+		coalesce_flush(ctx);
+		return false;
+	}
+
+	if (mode == EVENT_COALESCE_HISTORY && slot != COALESCE_DEVICES){
+		coalesce.dev[slot].history[coalesce.dev[slot].hist_pos] = src->io;
+		coalesce.dev[slot].hist_pos =
+			(coalesce.dev[slot].hist_pos + 1) % COALESCE_HISTORY;
+		if (coalesce.dev[slot].hist_count < COALESCE_HISTORY)
+			coalesce.dev[slot].hist_count++;
+	}
+
+	for (size_t i = 0; i < coalesce.n_pending; i++){
+		struct arcan_ioevent* cur = &coalesce.pending[i].io;
+		if (cur->devid != src->io.devid ||
+			cur->subid != src->io.subid || cur->kind != src->io.kind)
+			continue;
+
+		if (coalesce_merge(cur, &src->io))
+			return true;
+
+/* unmergeable (e.g. touch release), preserve order by flushing */
+		coalesce_flush(ctx);
+		break;
+	}
+
+	if (coalesce.n_pending == COALESCE_SLOTS)
+		coalesce_flush(ctx);
+
+	coalesce.pending[coalesce.n_pending++] = *src;
+	return true;
+}
+
 /*
  * enqueue to current context considering input-masking, unless label is set,
  * assign one based on what kind of event it is This function has a similar
@@ -199,6 +524,10 @@ int arcan_event_enqueue(arcan_evctx* ctx, const struct arcan_event* const src)
 		|| (ctx->state_fl & EVSTATE_DEAD) > 0)
 		return ARCAN_OK;
 
+	if (src->category == EVENT_IO && ctx->local &&
+		!coalesce.flushing && coalesce_event(ctx, src))
+		return ARCAN_OK;
+
 /* One big caveat with this approach is the possibility of feedback loop with
  * magnification - forcing us to break ordering by directly feeding drain.
  * Given that we have special treatment for _EXPIRE and similar calls,
@@ -277,13 +606,44 @@ static bool append_bufferstream(struct arcan_frameserver* tgt, arcan_extevent* e
 		goto fail;
 	}
 
+/* shared memory is always a single plane that replaces any pending one and
+ * is mapped and validated at upload */
+	if (ev->bstream.shm){
+		if (tgt->vstream.pool.fd > 0)
+			close(tgt->vstream.pool.fd);
+
+		tgt->vstream.pool.fd = fd;
+		tgt->vstream.pool.offset = ev->bstream.offset;
+		tgt->vstream.pool.stride = ev->bstream.stride;
+		tgt->vstream.pool.format = ev->bstream.format;
+		tgt->vstream.pool.w = ev->bstream.width;
+		tgt->vstream.pool.h = ev->bstream.height;
+		return true;
+	}
+
+/* the acquire fence follows the plane descriptor */
+	int fence = 0;
+	if (ev->bstream.fence){
+		fence = arcan_fetchhandle(tgt->dpipe, false);
+		if (-1 == fence){
+			arcan_warning("fetchhandle-bstream fence mismatch\n");
+			close(fd);
+			goto fail;
+		}
+		tgt->vstream.fenced = true;
+	}
+
 /* if the client lies about the plane count - we arrive here: */
 	if (tgt->vstream.incoming_used == 4){
+		close(fd);
+		if (fence > 0)
+			close(fence);
 		goto fail;
 	}
 
 	size_t i = tgt->vstream.incoming_used;
 	tgt->vstream.incoming[i].fd = fd;
+	tgt->vstream.incoming[i].fence = fence;
 	tgt->vstream.incoming[i].gbm.stride = ev->bstream.stride;
 	tgt->vstream.incoming[i].gbm.offset = ev->bstream.offset;
 	tgt->vstream.incoming[i].gbm.mod_hi = ev->bstream.mod_hi;
@@ -291,6 +651,14 @@ static bool append_bufferstream(struct arcan_frameserver* tgt, arcan_extevent* e
 	tgt->vstream.incoming[i].gbm.format = ev->bstream.format;
 	tgt->vstream.incoming[i].w = ev->bstream.width;
 	tgt->vstream.incoming[i].h = ev->bstream.height;
+
+/* unknown values fall back to the driver default rather than failing */
+	tgt->vstream.incoming[i].gbm.color_space =
+		ev->bstream.color_space <= SHMIFEXT_CS_BT2020 ? ev->bstream.color_space : 0;
+	tgt->vstream.incoming[i].gbm.color_range =
+		ev->bstream.color_range <= SHMIFEXT_RANGE_NARROW ? ev->bstream.color_range : 0;
+	tgt->vstream.incoming[i].gbm.chroma_siting = ev->bstream.chroma_siting &
+		(SHMIFEXT_SITING_H_HALF | SHMIFEXT_SITING_V_HALF);
 	tgt->vstream.incoming_used++;
 
 /* flush incoming to pending, but if there is already something pending, take
@@ -318,6 +686,52 @@ fail:
 }
 
 
+/* external events that need no other treatment than the source rewrite */
+static bool simple_transfer(
+	const arcan_event* ev, int allowed, struct arcan_frameserver* tgt)
+{
+	if (!tgt || ev->category != EVENT_EXTERNAL || !(ev->category & allowed))
+		return false;
+
+	switch (ev->ext.kind){
+	case EVENT_EXTERNAL_SEGREQ:
+	case EVENT_EXTERNAL_BUFFERSTREAM:
+	case EVENT_EXTERNAL_PRIVDROP:
+	case EVENT_EXTERNAL_INPUTMASK:
+	case EVENT_EXTERNAL_CLOCKREQ:
+	case EVENT_EXTERNAL_REGISTER:
+	case EVENT_EXTERNAL_FLUSHAUD:
+		return false;
+	default:
+		return true;
+	}
+}
+
+/* append a run of already filtered events with at most two copies and one
+ * update of the back index, falls back to normal enqueue (drain / overflow
+ * handling) if the run doesn't fit */
+static void queue_append(arcan_evctx* ctx, const arcan_event* src, size_t n)
+{
+	if (!n || (ctx->state_fl & EVSTATE_DEAD))
+		return;
+
+	if ((src[0].category & ctx->mask_cat_inp) ||
+		ctx->eventbuf_sz - 1 - queue_used(ctx) < n){
+		for (size_t i = 0; i < n; i++)
+			arcan_event_enqueue(ctx, &src[i]);
+		return;
+	}
+
+	unsigned back = *ctx->back;
+	size_t span = ctx->eventbuf_sz - back;
+	if (span > n)
+		span = n;
+
+	memcpy(&ctx->eventbuf[back], src, span * sizeof(arcan_event));
+	memcpy(ctx->eventbuf, &src[span], (n - span) * sizeof(arcan_event));
+	*ctx->back = (back + n) % ctx->eventbuf_sz;
+}
+
 int arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
 	enum ARCAN_EVENT_CATEGORY allowed, float sat, struct arcan_frameserver* tgt)
 {
@@ -341,10 +755,38 @@ int arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
 
 	size_t cap = floor((float)dstqueue->eventbuf_sz * sat);
 
-	while (!queue_empty(srcqueue) && queue_used(dstqueue) < cap){
-		arcan_event inev;
-		if (arcan_event_poll(srcqueue, &inev) == 0)
-			break;
+	arcan_event batch[64];
+	size_t n_batch = 0, ofs = 0, n_run = 0;
+
+	while (ofs < n_batch ||
+		(!queue_empty(srcqueue) && queue_used(dstqueue) < cap)){
+		if (ofs == n_batch){
+			queue_append(dstqueue, batch, n_run);
+			n_run = 0;
+
+			size_t lim = cap - queue_used(dstqueue);
+			n_batch = queue_batch(srcqueue,
+				batch, lim < COUNT_OF(batch) ? lim : COUNT_OF(batch));
+			ofs = 0;
+			if (!n_batch)
+				break;
+		}
+
+		arcan_event inev = batch[ofs++];
+
+/* The common case is an external event that only needs the source rewritten,
+ * these are compacted in place at the front of the batch and appended to the
+ * destination as one run when the batch is done or a slow-path event shows
+ * up (so the order is preserved) */
+		if (!drain && simple_transfer(&inev, allowed, tgt)){
+			batch[n_run] = inev;
+			batch[n_run++].ext.source = tgt->vid;
+			wake = true;
+			continue;
+		}
+
+		queue_append(dstqueue, batch, n_run);
+		n_run = 0;
 
 /* Ioevents have special behavior as the routed path (via frameserver callback
  * or global event handler) can be decided here: if raw transfers have been
@@ -421,6 +863,9 @@ int arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
 					else if (inev.ext.clock.dynamic == 2){
 						tgt->clock.vblank = !tgt->clock.vblank;
 					}
+					else if (inev.ext.clock.dynamic == 3){
+						tgt->clock.tearing = !tgt->clock.tearing;
+					}
 					else if (tgt->flags.autoclock){
 						tgt->clock.once = inev.ext.clock.once;
 						tgt->clock.frame = inev.ext.clock.dynamic;
@@ -467,9 +912,9 @@ int arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
 		}
 		wake = true;
 
-/* it might be slightly faster to drain multiple events here, but since the
- * source might be mapped to an untrusted in-memory queue it would still take a
- * full filter+copy path - so likely not worth pursuing.
+/* events are copied out of the source queue in batches (one barrier and
+ * front update per batch), but since the source might be mapped to an
+ * untrusted in-memory queue each one still takes the full filter path.
  *
  * There is a complex and subtle danger here:
  *  0.Recall we are being called from the TRAMP_GUARD
@@ -511,6 +956,8 @@ int arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
 		arcan_event_enqueue(dstqueue, &inev);
 	}
 
+	queue_append(dstqueue, batch, n_run);
+
 	if (wake)
 		arcan_sem_post(srcqueue->synch.handle);
 
@@ -555,6 +1002,10 @@ float arcan_event_process(arcan_evctx* ctx, arcan_tick_cb cb)
 	int64_t delta = arcan_frametime() - base;
 
 	platform_event_process(ctx);
+	async_drain(ctx);
+	if (ctx == &default_evctx)
+		arcan_evrec_replay(ctx);
+	coalesce_flush(ctx);
 
 	if (delta > ARCAN_TIMER_TICK){
 		int nticks = delta / ARCAN_TIMER_TICK;
@@ -564,6 +1015,7 @@ float arcan_event_process(arcan_evctx* ctx, arcan_tick_cb cb)
 		}
 
 		ctx->c_ticks += nticks;
+		evsrc_refill();
 		cb(nticks);
 		arcan_bench_register_tick(nticks);
 		return arcan_event_process(ctx, cb);
@@ -622,9 +1074,165 @@ void arcan_bench_register_cost(unsigned cost)
 		(sizeof(benchdata.framecost) / sizeof(benchdata.framecost[0]));
 }
 
+void arcan_bench_register_gc(unsigned cost)
+{
+	if (benchdata.bench_enabled == false)
+		return;
+
+	benchdata.gccost[(unsigned)benchdata.gcofs] = cost;
+	benchdata.gccount++;
+	benchdata.gcofs = (benchdata.gcofs + 1) %
+		(sizeof(benchdata.gccost) / sizeof(benchdata.gccost[0]));
+}
+
+void arcan_bench_register_gpu(unsigned cost)
+{
+	if (benchdata.bench_enabled == false)
+		return;
+
+	benchdata.gpucost[(unsigned)benchdata.gpuofs] = cost;
+	benchdata.gpucount++;
+	benchdata.gpuofs = (benchdata.gpuofs + 1) %
+		(sizeof(benchdata.gpucost) / sizeof(benchdata.gpucost[0]));
+}
+
+/*
+ * Input-to-present latency: evdev stamps io.pts at read time, the earliest
+ * stamp per device class that has been dispatched is captured with the next
+ * rendered frame and completed when the platform reports that frame as
+ * presented (or at the end of the frame for platforms that don't).
+ */
+static struct {
+	uint64_t pending[BENCH_INPUT_CLASSES];
+	uint64_t inflight[BENCH_INPUT_CLASSES];
+	bool presents;
+} inputlat;
+
+static int input_class(const struct arcan_ioevent* io)
+{
+	switch (io->devkind){
+	case EVENT_IDEVKIND_KEYBOARD:
+		return 0;
+	case EVENT_IDEVKIND_MOUSE:
+		return 1;
+	case EVENT_IDEVKIND_TOUCHDISP:
+		return 2;
+	case EVENT_IDEVKIND_GAMEDEV:
+		return 3;
+	default:
+		return -1;
+	}
+}
+
+static void input_dispatched(const struct arcan_ioevent* io)
+{
+	int cl = input_class(io);
+	if (-1 == cl || !io->pts)
+		return;
+
+	if (!inputlat.pending[cl] || io->pts < inputlat.pending[cl])
+		inputlat.pending[cl] = io->pts;
+}
+
+static void input_presented(uint64_t present_us)
+{
+	for (size_t i = 0; i < BENCH_INPUT_CLASSES; i++){
+		if (!inputlat.inflight[i])
+			continue;
+
+		if (present_us > inputlat.inflight[i]){
+			benchdata.inputlat[i][(unsigned)benchdata.inputlatofs[i]] =
+				present_us - inputlat.inflight[i];
+			benchdata.inputlatofs[i] =
+				(benchdata.inputlatofs[i] + 1) % COUNT_OF(benchdata.inputlat[i]);
+			benchdata.inputlatcount[i]++;
+		}
+		inputlat.inflight[i] = 0;
+	}
+}
+
+/*
+ * Last scanout as reported by the platform, forwarded to clients with the
+ * frame feedback (STEPFRAME) so that they can pace against the display rather
+ * than the time the event happened to be delivered.
+ */
+static struct {
+	uint64_t last_us;
+	uint32_t period_us;
+} scanout;
+
+void arcan_bench_register_present(uint64_t present_us)
+{
+	inputlat.presents = true;
+	input_presented(present_us ? present_us : arcan_timemicros());
+
+	if (!present_us)
+		return;
+
+/* ignore gaps from idle displays, they say nothing about the refresh */
+	if (scanout.last_us && present_us > scanout.last_us){
+		uint64_t delta = present_us - scanout.last_us;
+		if (delta > 1000 && delta < 100000)
+			scanout.period_us = scanout.period_us ?
+				(scanout.period_us * 3 + delta) / 4 : delta;
+	}
+	scanout.last_us = present_us;
+}
+
+uint64_t arcan_bench_last_present(uint32_t* period_us)
+{
+	if (period_us)
+		*period_us = scanout.period_us;
+	return scanout.last_us;
+}
+
+static int cmp_unsigned(const void* a, const void* b)
+{
+	unsigned va = *(const unsigned*) a;
+	unsigned vb = *(const unsigned*) b;
+	return va < vb ? -1 : va > vb;
+}
+
+size_t arcan_bench_input_latency(size_t devclass, unsigned* p50, unsigned* p99)
+{
+	if (devclass >= BENCH_INPUT_CLASSES)
+		return 0;
+
+	size_t count = benchdata.inputlatcount[devclass];
+	if (count > COUNT_OF(benchdata.inputlat[0]))
+		count = COUNT_OF(benchdata.inputlat[0]);
+
+	*p50 = *p99 = 0;
+	if (!count)
+		return 0;
+
+/* the ring is filled from 0, so the first [count] entries are valid */
+	unsigned tmp[COUNT_OF(benchdata.inputlat[0])];
+	memcpy(tmp, benchdata.inputlat[devclass], count * sizeof(unsigned));
+	qsort(tmp, count, sizeof(unsigned), cmp_unsigned);
+
+	*p50 = tmp[(count - 1) / 2];
+	*p99 = tmp[(count - 1) * 99 / 100];
+	return count;
+}
+
 void arcan_bench_register_frame()
 {
 	static long long int lastframe = -1;
+
+/* inputs dispatched until now can be reflected in this frame */
+	for (size_t i = 0; i < BENCH_INPUT_CLASSES; i++){
+		if (!inputlat.pending[i])
+			continue;
+		if (!inputlat.inflight[i] || inputlat.pending[i] < inputlat.inflight[i])
+			inputlat.inflight[i] = inputlat.pending[i];
+		inputlat.pending[i] = 0;
+	}
+
+	if (!inputlat.presents)
+		input_presented(arcan_timemicros());
+	arcan_evrec_frame();
+
 	if (benchdata.bench_enabled == false)
 		return;
 
@@ -650,6 +1258,8 @@ void arcan_event_deinit(arcan_evctx* ctx, bool flush)
 		return;
 
 	eventfront = eventback = 0;
+	coalesce.n_pending = 0;
+	arcan_evrec_finish();
 }
 
 #ifdef _DEBUG
@@ -659,8 +1269,8 @@ void arcan_event_dump(struct arcan_evctx* ctx)
 	size_t count = 0;
 
 	while (front != *ctx->back){
-		arcan_warning("slot: %d, category: %d, kind: %d\n",
-			count, ctx->eventbuf[front].io.kind, ctx->eventbuf[front].category);
+		arcan_warning("slot: %zu, %s\n",
+			count++, arcan_shmif_eventstr(&ctx->eventbuf[front], NULL, 0));
 		front = (front + 1) % ctx->eventbuf_sz;
 	}
 }
@@ -693,6 +1303,8 @@ bool arcan_event_feed(struct arcan_evctx* ctx,
 /* slide, we forego _poll to cut down on one copy */
 		arcan_event* ev = &ctx->eventbuf[ *(ctx->front) ];
 		*(ctx->front) = (*(ctx->front) + 1) % ctx->eventbuf_sz;
+		if (ctx == &default_evctx)
+			arcan_evrec_record(ev);
 
 		switch (ev->category){
 			case EVENT_VIDEO:
@@ -709,6 +1321,12 @@ bool arcan_event_feed(struct arcan_evctx* ctx,
 					if (exit_code) *exit_code = ev->sys.errcode;
 					break;
 				}
+			case EVENT_IO:
+				if (ctx == &default_evctx)
+					input_dispatched(&ev->io);
+				hnd(ev, 0);
+			break;
+
 			default:
 				hnd(ev, 0);
 			break;
@@ -732,68 +1350,102 @@ static int mode_to_poll(mode_t mode)
 	return mode | POLLERR | POLLHUP;
 }
 
-bool arcan_event_add_source(
-	struct arcan_evctx* ctx, int fd, mode_t mode, intptr_t otag, bool masked)
+static void evsrc_dispatch(int fd, int revents, void* tag)
 {
-	int mask = 0;
-	mode = mode_to_poll(mode);
-
-/* allocate new */
-	uint64_t i = __builtin_ffsll(~evsrc_bitmap);
-	if (!i)
-		return false;
-
-	i--;
-	evsrc_pollset[i].fd = fd;
-	evsrc_pollset[i].events = mode;
-	evsrc_meta[i].mode = mode;
-	evsrc_meta[i].tag = otag;
-	evsrc_meta[i].mask = masked;
-	evsrc_bitmap |= (uint64_t)1 << i;
+	struct evsrc_meta* src = tag;
 
-	return true;
-}
+/* masked sources only serve to wake the wait up */
+	if (src->mask)
+		return;
 
-void arcan_event_poll_sources(struct arcan_evctx* ctx, int timeout)
-{
-	ssize_t nelem = poll(evsrc_pollset, 64, timeout);
-	if (nelem <= 0){
-		if (timeout > 0)
-			arcan_timesleep(timeout);
+/* a source that keeps being ready would otherwise get to inject an event on
+ * every wait. Once the budget is spent, disarm it until the next tick so the
+ * level-triggered descriptor doesn't keep waking us up either. */
+	if (evsrc_budget && src->spent >= evsrc_budget){
+		arcan_conductor_unwatch_fd(fd, src);
+		src->throttled = true;
+		TRACE_MARK_ONESHOT("event", "source", TRACE_SYS_WARN,
+			fd, src->spent, "throttled");
 		return;
 	}
+	src->spent++;
 
-	for (size_t i = 0; i < 64; i++){
-		struct pollfd* ent = &evsrc_pollset[i];
-		if (ent->fd <= 0 || !ent->revents || evsrc_meta[i].mask)
-			continue;
-
-		struct arcan_event ev = (struct arcan_event){
-			.category = EVENT_SYSTEM,
-			.sys.data.fd = evsrc_pollset[i].fd,
-			.sys.data.otag = evsrc_meta[i].tag
-		};
+	struct arcan_event ev = (struct arcan_event){
+		.category = EVENT_SYSTEM,
+		.sys.data.fd = fd,
+		.sys.data.otag = src->tag
+	};
 
 /* Note that we send IN/OUT even in the case of failure. This is to force the
  * recipient to use normal error handling for read/write to react to a
  * monitored source failing. */
-		if (ent->revents & POLLIN ||
-			((ent->revents & (POLLERR | POLLHUP)) && (ent->events & POLLIN))){
-				ev.sys.kind = EVENT_SYSTEM_DATA_IN;
-				arcan_event_denqueue(ctx, &ev);
-			}
+	if (revents & POLLIN ||
+		((revents & (POLLERR | POLLHUP)) && (src->mode & POLLIN))){
+			ev.sys.kind = EVENT_SYSTEM_DATA_IN;
+			arcan_event_denqueue(src->ctx, &ev);
+		}
 
 /* This is subtle - the events here go direct to drain. That means that
  * infinitely many calls to add_source and del_source can happen between these
  * two, possibly changing the otag being used to map to VM objects. Removing
- * the source is save though, as the pollset is cleared when the source is
- * removed, and this condition won't fire an extraneous event. */
-		if (ent->revents & POLLOUT ||
-			((ent->revents & (POLLERR | POLLHUP)) && (ent->events & POLLOUT))){
-			ev.sys.kind = EVENT_SYSTEM_DATA_OUT;
-			arcan_event_denqueue(ctx, &ev);
+ * the source is safe though, as the watch is only marked as dead when the
+ * source is removed, and this condition won't fire an extraneous event. */
+	if (revents & POLLOUT ||
+		((revents & (POLLERR | POLLHUP)) && (src->mode & POLLOUT))){
+		ev.sys.kind = EVENT_SYSTEM_DATA_OUT;
+		arcan_event_denqueue(src->ctx, &ev);
+	}
+}
+
+static void evsrc_refill()
+{
+	for (struct evsrc_meta* cur = evsrc_first; cur; cur = cur->next){
+		cur->spent = 0;
+		if (cur->throttled){
+			cur->throttled = false;
+			arcan_conductor_watch_fd(cur->fd, cur->mode, evsrc_dispatch, cur);
+		}
+	}
+}
+
+bool arcan_event_add_source(
+	struct arcan_evctx* ctx, int fd, mode_t mode, intptr_t otag, bool masked)
+{
+	int pmode = mode_to_poll(mode);
+
+	if (!evsrc_budget_init){
+		uintptr_t tag;
+		char* val;
+		cfg_lookup_fun get_config = platform_config_lookup(&tag);
+		if (get_config("event_source_budget", 0, &val, tag) && val){
+			evsrc_budget = strtoul(val, NULL, 10);
+			free(val);
 		}
+		evsrc_budget_init = true;
 	}
+
+	struct evsrc_meta* src = arcan_alloc_mem(sizeof(struct evsrc_meta),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL);
+	if (!src)
+		return false;
+
+	*src = (struct evsrc_meta){
+		.fd = fd,
+		.tag = otag,
+		.mode = pmode,
+		.mask = masked,
+		.ctx = ctx,
+		.next = evsrc_first
+	};
+
+	if (!arcan_conductor_watch_fd(fd, pmode, evsrc_dispatch, src)){
+		arcan_mem_free(src);
+		return false;
+	}
+
+	evsrc_first = src;
+	return true;
 }
 
 /* Remove a source previously added through add_source. Will return true if
@@ -801,17 +1453,20 @@ void arcan_event_poll_sources(struct arcan_evctx* ctx, int timeout)
 bool arcan_event_del_source(
 	struct arcan_evctx* ctx, int fd, mode_t mode, intptr_t* out)
 {
-	mode = mode_to_poll(mode);
-	for (uint64_t i = 0; i < 64; i++){
-		if (evsrc_pollset[i].fd == fd && evsrc_pollset[i].events == mode){
-			evsrc_pollset[i].fd = -1;
-			evsrc_bitmap &= ~((uint64_t)1 << i);
-			if (out)
-				*out = evsrc_meta[i].tag;
-			evsrc_meta[i] = (struct evsrc_meta){0};
-			evsrc_pollset[i] = (struct pollfd){0};
-			return true;
-		}
+	int pmode = mode_to_poll(mode);
+
+	for (struct evsrc_meta** cur = &evsrc_first; *cur; cur = &(*cur)->next){
+		struct evsrc_meta* src = *cur;
+		if (src->fd != fd || src->mode != pmode)
+			continue;
+
+		if (!src->throttled)
+			arcan_conductor_unwatch_fd(fd, src);
+		*cur = src->next;
+		if (out)
+			*out = src->tag;
+		arcan_mem_free(src);
+		return true;
 	}
 
 	return false;
@@ -860,6 +1515,9 @@ void arcan_event_init(arcan_evctx* ctx)
 
 	epoch = arcan_timemillis() - ctx->c_ticks * ARCAN_TIMER_TICK;
 	platform_event_init(ctx);
+
+	if (ctx == &default_evctx)
+		arcan_evrec_init();
 }
 
 void arcan_led_removed(int devid)
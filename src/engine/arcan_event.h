@@ -67,11 +67,37 @@ bool arcan_event_add_source(
 bool arcan_event_del_source(
 	struct arcan_evctx*, int fd, mode_t mode, intptr_t* out);
 
-/* Work through the list of registered sources and queue events for the ones
- * that are readable/writable as EVENT_SYSTEM_DATA_IN/OUT. This is intended to
- * be run as part of the conductor scheduler. The internal queueing is
- * direct-to-drain. */
-void arcan_event_poll_sources(struct arcan_evctx* ctx, int timeout);
+/* arcan_event_enqueue is only safe to call from the main thread, other
+ * producers (worker, nanny or I/O threads) post to the default context
+ * through this bounded lock-free queue instead. Events are moved into the
+ * default queue as part of arcan_event_process. Returns false if the queue
+ * is full. */
+bool arcan_event_enqueue_async(const struct arcan_event* const);
+
+enum arcan_event_coalesce {
+	EVENT_COALESCE_OFF = 0,
+	EVENT_COALESCE_MERGE = 1,
+/* merge but retain the raw samples for arcan_event_history */
+	EVENT_COALESCE_HISTORY = 2
+};
+
+/* Set how analog and touch samples from [devid] should be coalesced before
+ * being queued, a negative devid sets the default for all devices without a
+ * specific mode (config event_coalesce sets the initial default to merge).
+ * Merged samples are flushed at most once per arcan_event_process, relative
+ * motion is accumulated and the last absolute sample is kept. */
+void arcan_event_coalesce(int devid, enum arcan_event_coalesce mode);
+
+/* Retrieve (and consume) up to [lim] raw samples for a device set to
+ * EVENT_COALESCE_HISTORY, oldest first. */
+size_t arcan_event_history(int devid, struct arcan_ioevent* dst, size_t lim);
+
+/* Registered sources are part of the conductor wait set (see
+ * arcan_conductor_watch_fd), readable/writable ones are queued as
+ * EVENT_SYSTEM_DATA_IN/OUT whenever the conductor waits. The internal
+ * queueing is direct-to-drain. Each source may inject at most
+ * event_source_budget (config, default 32, 0 = unlimited) events per tick,
+ * after that it is disarmed until the next tick. */
 
 /*
  * Process the entire event queue and forward relevant events through [hnd].
@@ -80,6 +106,19 @@ void arcan_event_poll_sources(struct arcan_evctx* ctx, int timeout);
  */
 bool arcan_event_feed(struct arcan_evctx*, arcan_event_handler hnd, int* ec);
 
+/*
+ * Event recording / replay (see arcan_evrec.c), controlled through the
+ * event_record, event_replay, event_replay_fast and event_replay_exit config
+ * keys. _record is called for every event fed from the default context,
+ * _replay injects due events as part of arcan_event_process, _frame from
+ * arcan_bench_register_frame and _finish flushes and reports on shutdown.
+ */
+void arcan_evrec_init();
+void arcan_evrec_record(const struct arcan_event*);
+void arcan_evrec_replay(struct arcan_evctx*);
+void arcan_evrec_frame();
+void arcan_evrec_finish();
+
 /*
  * Convert as many external events in [srcqueue] to [dstqueue] as possible
  * without breaking [saturation] (% of dstqueue slots, 0..1 range).
@@ -120,6 +159,11 @@ int arcan_event_enqueue(struct arcan_evctx*, const struct arcan_event* const);
  */
 int arcan_event_denqueue(struct arcan_evctx*, const struct arcan_event* const);
 
+/*
+ * number of events queued in [ctx] that have not been dequeued yet
+ */
+unsigned arcan_event_queuedepth(struct arcan_evctx*);
+
 /* global clock, milisecond resolution relative to epoch set during start */
 int64_t arcan_frametime();
 
@@ -0,0 +1,321 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Event recording and replay for performance regression runs.
+ *
+ * The recorder appends every event dispatched from the default queue to a
+ * file, packed with the compact eventpack format and stamped with the time
+ * since the previous record. The replayer reads such a file back and injects
+ * the input events into the default queue, either at the recorded pace or as
+ * fast as the queue accepts them, and collects frame time statistics for the
+ * duration of the replay.
+ *
+ * Only the EVENT_IO category is reinjected, the rest reference frameservers
+ * and objects from the recorded session that won't exist in the replay. They
+ * are still kept in the recording so the workload can be inspected.
+ *
+ * Configuration (get_config, ARCAN_EVENT_... in env):
+ *  event_record=path        - write a recording
+ *  event_replay=path        - replay a recording
+ *  event_replay_fast        - ignore the recorded timing
+ *  event_replay_exit        - shut down when the replay has been consumed
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_shmif.h"
+#include "arcan_event.h"
+
+/* file header: magic, format, shmif major, shmif minor; then records of
+ * varint(delta_us) varint(len) eventpack_compact[len] */
+static const uint8_t evrec_magic[4] = {'A', 'E', 'V', 'R'};
+#define EVREC_VERSION 1
+#define EVREC_MAXPACK 256
+
+/* events injected per arcan_event_process in fast mode */
+#define EVREC_FAST_BATCH 32
+
+/* frame time histogram, 100us buckets up to 1s, the rest go into the last */
+#define EVREC_BUCKET_US 100
+#define EVREC_BUCKETS 10000
+
+static struct {
+	bool init;
+
+	FILE* rec;
+	uint64_t rec_last;
+	size_t rec_count;
+
+	FILE* play;
+	bool fast;
+	bool exit;
+	uint64_t play_start;
+	uint64_t play_due;
+	size_t play_count;
+	bool pending;
+	struct arcan_event next;
+
+	uint64_t last_frame;
+	size_t frames;
+	uint64_t frame_sum, frame_max;
+	unsigned* hist;
+} evrec;
+
+static void write_varint(FILE* fout, uint64_t v)
+{
+	do {
+		uint8_t b = v & 0x7f;
+		v >>= 7;
+		fputc(b | (v ? 0x80 : 0), fout);
+	} while (v);
+}
+
+static bool read_varint(FILE* fin, uint64_t* out)
+{
+	*out = 0;
+	for (size_t shift = 0; shift < 64; shift += 7){
+		int ch = fgetc(fin);
+		if (EOF == ch)
+			return false;
+		*out |= (uint64_t)(ch & 0x7f) << shift;
+		if (!(ch & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static FILE* open_recording(const char* path)
+{
+	FILE* fout = fopen(path, "w");
+	if (!fout){
+		arcan_warning("event_record: couldn't open (%s) for writing\n", path);
+		return NULL;
+	}
+
+	fwrite(evrec_magic, sizeof(evrec_magic), 1, fout);
+	fputc(EVREC_VERSION, fout);
+	fputc(ASHMIF_VERSION_MAJOR, fout);
+	fputc(ASHMIF_VERSION_MINOR, fout);
+	return fout;
+}
+
+static FILE* open_replay(const char* path)
+{
+	FILE* fin = fopen(path, "r");
+	if (!fin){
+		arcan_warning("event_replay: couldn't open (%s)\n", path);
+		return NULL;
+	}
+
+	uint8_t hdr[7];
+	if (1 != fread(hdr, sizeof(hdr), 1, fin) ||
+		memcmp(hdr, evrec_magic, sizeof(evrec_magic)) != 0 ||
+		hdr[4] != EVREC_VERSION){
+		arcan_warning("event_replay: (%s) is not a recording\n", path);
+		fclose(fin);
+		return NULL;
+	}
+
+/* the compact format is layout independent, but enum values may still drift */
+	if (hdr[5] != ASHMIF_VERSION_MAJOR)
+		arcan_warning("event_replay: recorded with shmif %d.%d, running %d.%d\n",
+			(int) hdr[5], (int) hdr[6], ASHMIF_VERSION_MAJOR, ASHMIF_VERSION_MINOR);
+
+	return fin;
+}
+
+/* read the next reinjectable event, returns false on end of file */
+static bool replay_next()
+{
+	uint64_t delta, len;
+	uint8_t buf[EVREC_MAXPACK];
+
+	while (read_varint(evrec.play, &delta) && read_varint(evrec.play, &len)){
+		if (len > sizeof(buf) || 1 != fread(buf, len, 1, evrec.play))
+			break;
+
+		evrec.play_due += delta;
+		if (-1 == arcan_shmif_eventunpack_compact(buf, len, &evrec.next))
+			continue;
+
+		if (evrec.next.category == EVENT_IO)
+			return true;
+	}
+
+	return false;
+}
+
+static size_t hist_percentile(size_t limit)
+{
+	size_t acc = 0;
+	for (size_t i = 0; i < EVREC_BUCKETS; i++){
+		acc += evrec.hist[i];
+		if (acc > limit)
+			return i;
+	}
+	return EVREC_BUCKETS - 1;
+}
+
+static void replay_report()
+{
+	if (!evrec.hist)
+		return;
+
+	double dur = (double)(arcan_timemicros() - evrec.play_start) / 1000000.0;
+
+	if (!evrec.frames){
+		arcan_warning("event_replay: events=%zu duration=%.3fs frames=0\n",
+			evrec.play_count, dur);
+		goto out;
+	}
+
+#define BUCKET_MS(X) ((double)((X) * EVREC_BUCKET_US + EVREC_BUCKET_US) / 1000.0)
+	arcan_warning("event_replay: events=%zu duration=%.3fs frames=%zu "
+		"mean=%.2fms p50=%.2fms p95=%.2fms p99=%.2fms max=%.2fms\n",
+		evrec.play_count, dur, evrec.frames,
+		(double) evrec.frame_sum / (double) evrec.frames / 1000.0,
+		BUCKET_MS(hist_percentile((evrec.frames - 1) / 2)),
+		BUCKET_MS(hist_percentile((evrec.frames - 1) * 95 / 100)),
+		BUCKET_MS(hist_percentile((evrec.frames - 1) * 99 / 100)),
+		(double) evrec.frame_max / 1000.0
+	);
+#undef BUCKET_MS
+
+out:
+	arcan_mem_free(evrec.hist);
+	evrec.hist = NULL;
+}
+
+static void replay_done(struct arcan_evctx* ctx)
+{
+	fclose(evrec.play);
+	evrec.play = NULL;
+	replay_report();
+
+	if (evrec.exit)
+		arcan_event_enqueue(ctx, &(struct arcan_event){
+			.category = EVENT_SYSTEM,
+			.sys.kind = EVENT_SYSTEM_EXIT,
+			.sys.errcode = EXIT_SUCCESS
+		});
+}
+
+void arcan_evrec_init()
+{
+	if (evrec.init)
+		return;
+	evrec.init = true;
+
+	uintptr_t tag;
+	char* val;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+
+	if (get_config("event_replay", 0, &val, tag) && val){
+		evrec.play = open_replay(val);
+		free(val);
+		evrec.fast = get_config("event_replay_fast", 0, NULL, tag);
+		evrec.exit = get_config("event_replay_exit", 0, NULL, tag);
+		if (evrec.play){
+			evrec.hist = arcan_alloc_mem(sizeof(unsigned) * EVREC_BUCKETS,
+				ARCAN_MEM_BINDING, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+			evrec.pending = replay_next();
+		}
+	}
+
+	if (get_config("event_record", 0, &val, tag) && val){
+		if (evrec.play)
+			arcan_warning("event_record: ignored while replaying\n");
+		else
+			evrec.rec = open_recording(val);
+		free(val);
+	}
+}
+
+void arcan_evrec_record(const struct arcan_event* ev)
+{
+	if (!evrec.rec)
+		return;
+
+	uint8_t buf[EVREC_MAXPACK];
+	ssize_t nb = arcan_shmif_eventpack_compact(ev, buf, sizeof(buf));
+	if (-1 == nb)
+		return;
+
+	uint64_t now = arcan_timemicros();
+	write_varint(evrec.rec, evrec.rec_last ? now - evrec.rec_last : 0);
+	write_varint(evrec.rec, nb);
+	fwrite(buf, nb, 1, evrec.rec);
+	evrec.rec_last = now;
+	evrec.rec_count++;
+}
+
+void arcan_evrec_replay(struct arcan_evctx* ctx)
+{
+	if (!evrec.play)
+		return;
+
+	uint64_t now = arcan_timemicros();
+	if (!evrec.play_start){
+		evrec.play_start = now;
+		evrec.last_frame = 0;
+	}
+
+	size_t budget = EVREC_FAST_BATCH;
+	while (evrec.pending){
+		if (evrec.fast){
+			if (!budget--)
+				return;
+		}
+		else if (now - evrec.play_start < evrec.play_due)
+			return;
+
+		if (ARCAN_OK != arcan_event_enqueue(ctx, &evrec.next))
+			return;
+
+		evrec.play_count++;
+		evrec.pending = replay_next();
+	}
+
+	replay_done(ctx);
+}
+
+void arcan_evrec_frame()
+{
+	if (!evrec.hist || !evrec.play_start)
+		return;
+
+	uint64_t now = arcan_timemicros();
+	if (evrec.last_frame && now > evrec.last_frame){
+		uint64_t delta = now - evrec.last_frame;
+		size_t bucket = delta / EVREC_BUCKET_US;
+		evrec.hist[bucket < EVREC_BUCKETS ? bucket : EVREC_BUCKETS - 1]++;
+		evrec.frame_sum += delta;
+		if (delta > evrec.frame_max)
+			evrec.frame_max = delta;
+		evrec.frames++;
+	}
+	evrec.last_frame = now;
+}
+
+void arcan_evrec_finish()
+{
+	if (evrec.rec){
+		arcan_warning("event_record: %zu events written\n", evrec.rec_count);
+		fclose(evrec.rec);
+		evrec.rec = NULL;
+	}
+
+/* shut down mid-replay, still report what we have */
+	if (evrec.play){
+		fclose(evrec.play);
+		evrec.play = NULL;
+		replay_report();
+	}
+}
@@ -56,6 +56,7 @@ enum arcan_ffunc_cmd {
 	FFUNC_DESTROY = 3, /* custom cleanup */
 	FFUNC_READBACK= 4, /* recordtargets, when a readback is ready */
 	FFUNC_ADOPT   = 5, /* outside context */
+	FFUNC_READBACK_HANDLE = 6, /* recordtargets, exported store instead of readback */
 };
 
 enum arcan_ffunc_rv {
@@ -41,6 +41,22 @@
 /* temporary workaround while migrating */
 typedef struct TTF_Font TTF_Font;
 #include "../shmif/tui/raster/raster.h"
+#include "../frameserver/util/resampler/speex_resampler.h"
+
+/* vector versions of the mixer stages, selected at runtime in amix_select */
+#ifndef AMIX_NO_SIMD
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AMIX_SIMD_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AMIX_SIMD_NEON
+#if defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+#endif
 
 /*
  * implementation defined for out-of-order execution
@@ -59,6 +75,7 @@ static inline void emit_deliveredframe(arcan_frameserver* src,
 	unsigned long long pts, unsigned long long framecount);
 static inline void emit_droppedframe(arcan_frameserver* src,
 	unsigned long long pts, unsigned long long framecount);
+static void drop_amixer(arcan_frameserver* dst);
 
 static void autoclock_frame(arcan_frameserver* tgt)
 {
@@ -112,6 +129,7 @@ arcan_errc arcan_frameserver_free(arcan_frameserver* src)
 
 	arcan_conductor_deregister_frameserver(src);
 	arcan_frameserver_close_bufferqueues(src, true, true);
+	platform_fsrv_mappool(src, true);
 
 	arcan_aobj_id aid = src->aid;
 	uintptr_t tag = src->tag;
@@ -130,8 +148,16 @@ arcan_errc arcan_frameserver_free(arcan_frameserver* src)
  * being drawable or responding to font size changes (as font state is lost glyph
  * caches can't be rebuilt or used) - something to reconsider when we can do
  * shared atlases */
+	if (src->desc.text.gpu){
+		arcan_vobject* vobj = arcan_video_getobject(vid);
+		arcan_renderfun_tpack_release(&src->desc.text.gpu, vobj ? vobj->vstore : NULL);
+	}
 	arcan_renderfun_release_fontgroup(src->desc.text.group);
 	src->desc.text.group = NULL;
+	drop_amixer(src);
+
+	arcan_mem_free(src->desc.mesh.buf);
+	src->desc.mesh.buf = NULL;
 
 	char msg[32];
 
@@ -140,13 +166,15 @@ arcan_errc arcan_frameserver_free(arcan_frameserver* src)
 	else if (!platform_fsrv_lastwords(src, msg, COUNT_OF(msg)))
 		snprintf(msg, COUNT_OF(msg), "Couldn't access metadata (SIGBUS?)");
 
+/* the audio feed can be serviced from the audio thread with [src] as tag so
+ * it has to be gone before src is */
+	arcan_audio_stop(aid);
+
 /* will free, so no UAF here - only time the function returns false is when we
  * are somehow running it twice one the same src */
 	if (!platform_fsrv_destroy(src))
 		return ARCAN_ERRC_UNACCEPTED_STATE;
 
-	arcan_audio_stop(aid);
-
 /* make sure there is no other weird dangling state around and forward the
  * client 'last words' as a troubleshooting exit 'status' */
 	vfunc_state emptys = {0};
@@ -238,6 +266,10 @@ void arcan_frameserver_close_bufferqueues(
 				close(src->vstream.incoming[i].fd);
 				src->vstream.incoming[i].fd = -1;
 			}
+			if (src->vstream.incoming[i].fence > 0){
+				close(src->vstream.incoming[i].fence);
+				src->vstream.incoming[i].fence = 0;
+			}
 		}
 		src->vstream.incoming_used = 0;
 	}
@@ -248,11 +280,186 @@ void arcan_frameserver_close_bufferqueues(
 				close(src->vstream.pending[i].fd);
 				src->vstream.pending[i].fd = -1;
 			}
+			if (src->vstream.pending[i].fence > 0){
+				close(src->vstream.pending[i].fence);
+				src->vstream.pending[i].fence = 0;
+			}
 		}
 		src->vstream.pending_used = 0;
+
+		if (src->vstream.pool.fd > 0){
+			close(src->vstream.pool.fd);
+			src->vstream.pool.fd = 0;
+		}
 	}
 }
 
+/*
+ * A new client buffer has replaced the previous one in [store], tell the
+ * client when it is safe to write into the older ones again.
+ */
+static void release_buffers(arcan_frameserver* src, struct agp_vstore* store)
+{
+	size_t held = 1;
+	int fence = platform_video_release_fence(store, &held);
+	if (-1 == fence)
+		return;
+
+	arcan_event ev = {
+		.category = EVENT_TARGET,
+		.tgt.kind = TARGET_COMMAND_BUFFER_RELEASE,
+		.tgt.ioevs[0].iv = fence,
+		.tgt.ioevs[1].iv = held
+	};
+
+	platform_fsrv_pushfd(src, &ev, fence);
+	close(fence);
+	TRACE_MARK_ONESHOT("frameserver", "buffer-release", TRACE_SYS_DEFAULT, src->vid, held, "");
+}
+
+/*
+ * Upload from the shared memory the client passed instead of the segment, the
+ * memory is read-only and sealed (see platform_fsrv_mappool) so the bounds
+ * check here is all that is needed. The upload is synchronous so the client
+ * can be told to reuse the memory right away.
+ */
+static void push_pool(arcan_frameserver* src, struct agp_vstore* store,
+	struct stream_meta stream, struct arcan_shmif_region* chain, size_t n_chain)
+{
+	uint8_t* map = platform_fsrv_mappool(src, false);
+	size_t ofs = src->vstream.pool.offset;
+	size_t stride = src->vstream.pool.stride;
+	size_t w = src->vstream.pool.w;
+	size_t h = src->vstream.pool.h;
+
+/* 'XR24' and 'AR24', byte order matches av_pixel */
+	uint32_t fmt = src->vstream.pool.format;
+	bool ok = map &&
+		(fmt == 0x34325258 || fmt == 0x34325241) &&
+		w == store->w && h == store->h && w && h &&
+		stride >= w * sizeof(av_pixel) && stride % sizeof(av_pixel) == 0 &&
+		ofs % sizeof(av_pixel) == 0 &&
+		ofs < src->vstream.pool.map_sz &&
+		(src->vstream.pool.map_sz - ofs) / stride >= h - 1 &&
+		src->vstream.pool.map_sz - ofs - (h - 1) * stride >= w * sizeof(av_pixel);
+
+	close(src->vstream.pool.fd);
+	src->vstream.pool.fd = 0;
+
+	if (ok){
+		stream.buf = (av_pixel*)(map + ofs);
+		stream.stride = stride / sizeof(av_pixel);
+
+		size_t n_px = 0;
+		if (n_chain){
+			for (size_t i = 0; i < n_chain; i++){
+				struct stream_meta sub = stream;
+				sub.x1 = chain[i].x1; sub.w = chain[i].x2 - chain[i].x1;
+				sub.y1 = chain[i].y1; sub.h = chain[i].y2 - chain[i].y1;
+				n_px += sub.w * sub.h;
+				sub = agp_stream_prepare(store, sub, STREAM_RAW_DIRECT_SYNCHRONOUS);
+				agp_stream_commit(store, sub);
+			}
+		}
+		else {
+			n_px = stream.dirty ? stream.w * stream.h : w * h;
+			stream = agp_stream_prepare(store, stream, STREAM_RAW_DIRECT_SYNCHRONOUS);
+			agp_stream_commit(store, stream);
+		}
+		TRACE_MARK_ONESHOT("frameserver", "buffer-pool", TRACE_SYS_DEFAULT, src->vid, n_px, "");
+	}
+	else {
+		platform_fsrv_mappool(src, true);
+		arcan_event_enqueue(&src->outqueue, &(struct arcan_event){
+			.category = EVENT_TARGET,
+			.tgt.kind = TARGET_COMMAND_BUFFER_FAIL
+		});
+		TRACE_MARK_ONESHOT("frameserver", "buffer-pool", TRACE_SYS_WARN, src->vid, 0, "rejected");
+	}
+
+/* no fence, the memory is free as soon as the upload returns */
+	arcan_event_enqueue(&src->outqueue, &(struct arcan_event){
+		.category = EVENT_TARGET,
+		.tgt.kind = TARGET_COMMAND_BUFFER_RELEASE,
+		.tgt.ioevs[0].iv = BADFD
+	});
+}
+
+/*
+ * Retrieve the damage chain (if any) that goes with the bounding [dirty]
+ * region. Anything that fails validation falls back to the bounding box, as
+ * does a chain that covers most of it anyhow since the separate uploads will
+ * cost more than the pixels saved.
+ */
+static size_t load_dirty_chain(struct arcan_shmif_page* shmpage,
+	struct agp_vstore* store, struct arcan_shmif_region* dirty,
+	struct arcan_shmif_region out[static ARCAN_SHMIF_DIRTY_LIM])
+{
+	size_t n = atomic_load(&shmpage->dirty_chain_n);
+	if (n <= 1 || n > ARCAN_SHMIF_DIRTY_LIM)
+		return 0;
+
+	size_t area = 0;
+	for (size_t i = 0; i < n; i++){
+		out[i] = shmpage->dirty_chain[i];
+		if (out[i].x2 <= out[i].x1 || out[i].y2 <= out[i].y1 ||
+			out[i].x2 > store->w || out[i].y2 > store->h ||
+			out[i].x1 < dirty->x1 || out[i].x2 > dirty->x2 ||
+			out[i].y1 < dirty->y1 || out[i].y2 > dirty->y2)
+			return 0;
+
+		area += (size_t)(out[i].x2 - out[i].x1) * (out[i].y2 - out[i].y1);
+	}
+
+	size_t bb = (size_t)(dirty->x2 - dirty->x1) * (dirty->y2 - dirty->y1);
+	if (area > bb / 2)
+		return 0;
+
+	return n;
+}
+
+/* The video buffer holds a packed mesh rather than pixels. It gets copied out
+ * once and validated on the copy, after that it is drawn from as is. */
+static void push_mesh(arcan_frameserver* src, shmif_pixel* buf)
+{
+	struct arcan_shmif_vector vec = *src->desc.aext.vector;
+	size_t lim = src->desc.width * src->desc.height * sizeof(shmif_pixel);
+
+	if (!vec.data_sz || vec.data_sz > lim){
+		arcan_warning("client-mesh() - bad size (%zu/%zu)\n",
+			(size_t) vec.data_sz, lim);
+		return;
+	}
+
+	uint8_t* dst = arcan_alloc_mem(vec.data_sz,
+		ARCAN_MEM_MODELDATA, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_SIMD);
+	if (!dst)
+		return;
+
+	memcpy(dst, buf, vec.data_sz);
+	const struct shmif_mesh_header* hdr = shmif_mesh_validate(dst, vec.data_sz);
+	if (!hdr){
+		arcan_warning("client-mesh() - couldn't validate mesh\n");
+		arcan_mem_free(dst);
+		return;
+	}
+
+	arcan_mem_free(src->desc.mesh.buf);
+	src->desc.mesh.buf = dst;
+	src->desc.mesh.buf_sz = vec.data_sz;
+
+	arcan_event_enqueue(arcan_event_defaultctx(), &(arcan_event){
+		.category = EVENT_FSRV,
+		.fsrv.kind = EVENT_FSRV_MESH,
+		.fsrv.video = src->vid,
+		.fsrv.otag = src->tag,
+		.fsrv.width = hdr->n_vertices,
+		.fsrv.height = hdr->n_indices,
+		.fsrv.counter = hdr->n_lods,
+		.fsrv.pts = vec.mesh_id
+	});
+}
+
 static bool push_buffer(arcan_frameserver* src,
 	struct agp_vstore* store, struct arcan_shmif_region* dirty)
 {
@@ -267,6 +474,13 @@ static bool push_buffer(arcan_frameserver* src,
 	TRACE_MARK_ONESHOT("frameserver", "buffer-eval", TRACE_SYS_DEFAULT, src->vid, vready, "");
 
 	vready = (vready <= 0 || vready > src->vbuf_cnt) ? 0 : vready - 1;
+
+/* with explicit slots, the swapchain model and presentation time decide */
+	if (src->vswap){
+		vready = platform_fsrv_vslot_acquire(src, arcan_timemillis());
+		if (-1 == vready)
+			return false;
+	}
 	shmif_pixel* buf = src->vbufs[vready];
 
 /* If the HDR subprotocol is enabled, verify and translate into store metadata
@@ -331,8 +545,30 @@ static bool push_buffer(arcan_frameserver* src,
 		else
 			arcan_event_enqueue(arcan_event_defaultctx(), &rezev);
 
-		store->vinf.text.d_fmt = (src->desc.hints & SHMIF_RHINT_IGNORE_ALPHA) ||
-			src->flags.no_alpha_copy ? GL_NOALPHA_PIXEL_FORMAT : GL_STORE_PIXEL_FORMAT;
+/* With HDR the buffers can also be in a deeper format that the store should
+ * match so they can be uploaded as-is rather than converted. */
+		int depth = VSTORE_HINT_NORMAL;
+		if (src->desc.aproto & SHMIF_META_HDR){
+			switch (SHMIF_META_VFMT(src->desc.aproto)){
+			case SHMIF_VFMT_RGB10A2:
+				depth = VSTORE_HINT_HIDEF;
+			break;
+			case SHMIF_VFMT_RGBA16F:
+				depth = VSTORE_HINT_F16;
+			break;
+			default:
+			break;
+			}
+		}
+
+		if (agp_vstore_setformat(store, depth) != depth){
+			arcan_warning("frameserver(%"PRIxPTR") buffer format "
+				"not supported by platform\n", (uintptr_t) src->vid);
+		}
+
+		if (store->hdr.depth < VSTORE_HINT_HIDEF)
+			store->vinf.text.d_fmt = (src->desc.hints & SHMIF_RHINT_IGNORE_ALPHA) ||
+				src->flags.no_alpha_copy ? GL_NOALPHA_PIXEL_FORMAT : GL_STORE_PIXEL_FORMAT;
 
 /* this might not take if the store is locked - i.e. GPU resources will not
  * match local copies, the main context where that matters is if the vobj is
@@ -343,6 +579,12 @@ static bool push_buffer(arcan_frameserver* src,
 		explicit = true;
 	}
 
+	if (src->desc.aext.vector){
+		TRACE_MARK_ONESHOT("frameserver", "buffer-mesh", TRACE_SYS_DEFAULT, src->vid, 0, "");
+		push_mesh(src, buf);
+		goto commit_mask;
+	}
+
 /* special case, the contents is in a compressed format that can either be
  * rasterized or deferred to on-GPU rasterization / atlas lookup, so the other
  * setup isn't strictly needed. */
@@ -357,18 +599,31 @@ static bool push_buffer(arcan_frameserver* src,
 				0, 0, &src->desc.text.cellw, &src->desc.text.cellh);
 		}
 
+		size_t tpack_sz = src->desc.width * src->desc.height * sizeof(shmif_pixel);
+
+/* the GPU path draws straight into the store so the local copy the dst_copy
+ * is made from won't be kept up to date, stay on the raster for that */
+		if (arcan_video_display.tpack_gpu && !store->dst_copy){
+			int rv = arcan_renderfun_tpack(src->desc.text.group,
+				&src->desc.text.gpu, store, (uint8_t*) buf, tpack_sz);
+
+			if (-1 == rv){
+				arcan_warning("client-tpack() - couldn't unpack buffer\n");
+				goto commit_mask;
+			}
+			else if (rv)
+				goto tpack_feedback;
+		}
+		else if (src->desc.text.gpu)
+			arcan_renderfun_tpack_release(&src->desc.text.gpu, store);
+
 /* raster is 'built' every update from whatever caching mechanism is in
  * renderfun, it is only valid for the tui_raster_renderagp call as the
  * contents can be invalidated with any resize/font-size/font change. */
 		struct tui_raster_context* raster =
 			arcan_renderfun_fontraster(src->desc.text.group);
 
-/* This is the next step to change, of course we should merge the buffers into
- * a tpack_vstore and then use normal txcos etc. to pick our visible set, and a
- * MSDF text atlas to get drawing lists, removing the last 'big buffer'
- * requirement, as well as drawing the cursor separately. */
-		tui_raster_renderagp(raster, store, (uint8_t*) buf,
-			src->desc.width * src->desc.height * sizeof(shmif_pixel), &stream);
+		tui_raster_renderagp(raster, store, (uint8_t*) buf, tpack_sz, &stream);
 
 /* Raster failed for some reason - tactics would be to send reset and after
  * n- fails kill it for not complying with format - something to finish when
@@ -395,6 +650,8 @@ static bool push_buffer(arcan_frameserver* src,
 		stream = agp_stream_prepare(store, stream, STREAM_RAW_DIRECT);
 		agp_stream_commit(store, stream);
 
+tpack_feedback:
+		;
 /* Return feedback on kerning in px. Set the entire buffer regardless of delta
  * since when we get an actual kerning table in the vstore - it will be cheaper
  * with an aligned (rows * cols) memcpy than to jump around and patch in bytes
@@ -427,6 +684,13 @@ static bool push_buffer(arcan_frameserver* src,
 				sizeof(struct agp_buffer_plane) * src->vstream.pending_used);
 			stream.used = src->vstream.pending_used;
 			stream = agp_stream_prepare(store, stream, STREAM_HANDLE);
+
+/* the platform has queued any waits it needs on the acquire fences */
+			for (size_t i = 0; i < src->vstream.pending_used; i++)
+				if (src->vstream.pending[i].fence > 0){
+					close(src->vstream.pending[i].fence);
+					src->vstream.pending[i].fence = 0;
+				}
 			src->vstream.pending_used = 0;
 
 /* the vstream can die because of a format mismatch, platform validation failure
@@ -451,8 +715,11 @@ static bool push_buffer(arcan_frameserver* src,
 
 			TRACE_MARK_ONESHOT("frameserver", "buffer-handle", TRACE_SYS_WARN, src->vid, 0, "platform reject");
 		}
-		else
+		else {
 			agp_stream_commit(store, stream);
+			if (src->vstream.fenced)
+				release_buffers(src, store);
+		}
 
 		goto commit_mask;
 	}
@@ -472,15 +739,42 @@ static bool push_buffer(arcan_frameserver* src,
 	else
 		src->desc.region_valid = false;
 
+/* with a damage chain, each region is streamed on its own while desc.region
+ * keeps the bounding box for anything that forwards / reads back */
+	struct arcan_shmif_region chain[ARCAN_SHMIF_DIRTY_LIM];
+	size_t n_chain = stream.dirty ?
+		load_dirty_chain(src->shm.ptr, store, dirty, chain) : 0;
+
+	if (src->vstream.pool.fd > 0){
+		push_pool(src, store, stream, chain, n_chain);
+		goto commit_mask;
+	}
+
+/* deeper formats go straight from the segment, the PBO and local copy paths
+ * assume av_pixel */
+	enum stream_type stype = explicit || store->hdr.depth >= VSTORE_HINT_HIDEF ?
+		STREAM_RAW_DIRECT_SYNCHRONOUS : (
+			src->flags.local_copy ? STREAM_RAW_DIRECT_COPY : STREAM_RAW_DIRECT);
+
 /* perhaps also convert hints to message string */
 	size_t n_px = stream.w * stream.h;
 	TRACE_MARK_ENTER("frameserver", "buffer-upload", TRACE_SYS_DEFAULT, src->vid, n_px, "");
 
-	stream = agp_stream_prepare(store, stream, explicit ?
-		STREAM_RAW_DIRECT_SYNCHRONOUS : (
-			src->flags.local_copy ? STREAM_RAW_DIRECT_COPY : STREAM_RAW_DIRECT));
-
-	agp_stream_commit(store, stream);
+	if (n_chain){
+		n_px = 0;
+		for (size_t i = 0; i < n_chain; i++){
+			struct stream_meta sub = stream;
+			sub.x1 = chain[i].x1; sub.w = chain[i].x2 - chain[i].x1;
+			sub.y1 = chain[i].y1; sub.h = chain[i].y2 - chain[i].y1;
+			n_px += sub.w * sub.h;
+			sub = agp_stream_prepare(store, sub, stype);
+			agp_stream_commit(store, sub);
+		}
+	}
+	else {
+		stream = agp_stream_prepare(store, stream, stype);
+		agp_stream_commit(store, stream);
+	}
 	TRACE_MARK_EXIT("frameserver", "buffer-upload", TRACE_SYS_DEFAULT, src->vid, n_px, "upload");
 
 commit_mask:
@@ -540,9 +834,16 @@ enum arcan_ffunc_rv arcan_frameserver_pollffunc FFUNC_HEAD
 			if (errno == EBADF){
 				arcan_frameserver_free(tgt);
 			}
+/* spurious wakeup or failed accept, re-arm the listening socket */
+			else if (tgt->flags.sock_watch)
+				arcan_conductor_watch_frameserver(tgt);
 			return FRV_NOFRAME;
 		}
 
+/* the connection point has been swapped for the accepted socket */
+		if (tgt->flags.sock_watch)
+			arcan_conductor_watch_frameserver(tgt);
+
 		arcan_video_alterfeed(tgt->vid, FFUNC_SOCKVER, state);
 
 /* this is slightly special, we want to allow the option to re-use the
@@ -658,6 +959,9 @@ enum arcan_ffunc_rv arcan_frameserver_emptyframe FFUNC_HEAD
 
 	switch (cmd){
 		case FFUNC_POLL:
+			if (tgt->prio.skip_poll)
+				break;
+
 			if (tgt->shm.ptr->resized){
 				if (arcan_frameserver_tick_control(tgt, false, FFUNC_VFRAME) &&
 					tgt->shm.ptr && tgt->shm.ptr->vready){
@@ -693,6 +997,15 @@ enum arcan_ffunc_rv arcan_frameserver_emptyframe FFUNC_HEAD
 	return FRV_NOFRAME;
 }
 
+void arcan_frameserver_stamp_present(struct arcan_event* ev)
+{
+	uint32_t period;
+	uint64_t present = arcan_bench_last_present(&period);
+	ev->tgt.ioevs[3].uiv = present & 0xffffffff;
+	ev->tgt.ioevs[4].uiv = present >> 32;
+	ev->tgt.ioevs[5].uiv = period;
+}
+
 void arcan_frameserver_lock_buffers(int state)
 {
 	g_buffers_locked = state;
@@ -707,19 +1020,24 @@ int arcan_frameserver_releaselock(struct arcan_frameserver* tgt)
 	tgt->flags.release_pending = false;
 	TRAMP_GUARD(0, tgt);
 
-	atomic_store_explicit(&tgt->shm.ptr->vready, 0, memory_order_release);
+	if (tgt->vswap)
+		platform_fsrv_vslot_release(tgt);
+	else
+		atomic_store_explicit(&tgt->shm.ptr->vready, 0, memory_order_release);
 	arcan_sem_post( tgt->vsync );
 		if (tgt->desc.hints & SHMIF_RHINT_VSIGNAL_EV){
 			arcan_vobject* vobj = arcan_video_getobject(tgt->vid);
 
 			TRACE_MARK_ONESHOT("frameserver", "signal", TRACE_SYS_DEFAULT, tgt->vid, 0, "");
-			platform_fsrv_pushevent(tgt, &(struct arcan_event){
+			struct arcan_event ev = {
 				.category = EVENT_TARGET,
 				.tgt.kind = TARGET_COMMAND_STEPFRAME,
 				.tgt.ioevs[0].iv = 1,
 				.tgt.ioevs[1].iv = 0,
 				.tgt.ioevs[2].uiv = vobj ? vobj->owner->msc : 0
-			});
+			};
+			arcan_frameserver_stamp_present(&ev);
+			platform_fsrv_pushevent(tgt, &ev);
 		}
 
 	platform_fsrv_leave();
@@ -753,9 +1071,14 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
 /* silent compiler, this should not happen for a target with a
  * frameserver feeding it */
 	case FFUNC_READBACK:
+	case FFUNC_READBACK_HANDLE:
 	break;
 
 	case FFUNC_POLL:
+/* deferred by the conductor scheduling class, unless there is audio to mix */
+		if (tgt->prio.skip_poll && !atomic_load(&shmpage->aready))
+			goto no_out;
+
 		if (shmpage->resized){
 			arcan_frameserver_tick_control(tgt, false, FFUNC_VFRAME);
 			goto no_out;
@@ -778,8 +1101,12 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
 
 /* caller uses this hint to determine if a transfer should be
  * initiated or not */
-		rv = (tgt->shm.ptr->vready &&
-			!tgt->flags.release_pending) ? FRV_GOTFRAME : FRV_NOFRAME;
+		if (tgt->vswap)
+			rv = (platform_fsrv_vslot_pick(tgt, arcan_timemillis()) != -1 &&
+				!tgt->flags.release_pending) ? FRV_GOTFRAME : FRV_NOFRAME;
+		else
+			rv = (tgt->shm.ptr->vready &&
+				!tgt->flags.release_pending) ? FRV_GOTFRAME : FRV_NOFRAME;
 	break;
 
 	case FFUNC_TICK:
@@ -835,7 +1162,8 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
  *     for tighter latency management, here is where the estimated next synch
  *     deadline for any output it is used on could/should be set, though it
  *     feeds back into the need of the conductor- refactor */
-		dst_store->vinf.text.vpts = shmpage->vpts;
+		dst_store->vinf.text.vpts = tgt->vslot_held ?
+			atomic_load(&shmpage->vslot_pts[tgt->vslot_held - 1]) : shmpage->vpts;
 
 /*     if there's a clock for being triggered in order to be able to submit
  *     contents at a specific MSC on best effort, forward that now. */
@@ -865,23 +1193,30 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
 		if (tgt->desc.callback_framestate)
 			emit_deliveredframe(tgt, shmpage->vpts, tgt->desc.framecount);
 		tgt->desc.framecount++;
+		tgt->desc.frame_us = arcan_timemicros();
 		TRACE_MARK_ONESHOT("frameserver", "frame", TRACE_SYS_DEFAULT, tgt->vid, tgt->desc.framecount, "");
+		arcan_conductor_frame_delivered(tgt);
 
 /* interactive frameserver blocks on vsemaphore only,
  * so set monitor flags and wake up */
 		if (g_buffers_locked != 2){
-			atomic_store_explicit(&shmpage->vready, 0, memory_order_release);
+			if (tgt->vswap)
+				platform_fsrv_vslot_release(tgt);
+			else
+				atomic_store_explicit(&shmpage->vready, 0, memory_order_release);
 
 			arcan_sem_post( tgt->vsync );
 			if (tgt->desc.hints & SHMIF_RHINT_VSIGNAL_EV){
 				TRACE_MARK_ONESHOT("frameserver", "signal", TRACE_SYS_DEFAULT, tgt->vid, 0, "");
-				platform_fsrv_pushevent(tgt, &(struct arcan_event){
+				struct arcan_event ev = {
 					.category = EVENT_TARGET,
 					.tgt.kind = TARGET_COMMAND_STEPFRAME,
 					.tgt.ioevs[0].iv = 1,
 					.tgt.ioevs[1].iv = 0,
 					.tgt.ioevs[2].uiv = vobj ? vobj->owner->msc : 0
-				});
+				};
+				arcan_frameserver_stamp_present(&ev);
+				platform_fsrv_pushevent(tgt, &ev);
 			}
 		}
 		else
@@ -978,6 +1313,33 @@ leave:
 	return FRV_NOFRAME;
 }
 
+/* move any mixed audio along with a delivered recordtarget frame */
+static void feed_audio(arcan_frameserver* src)
+{
+	if (!src->ofs_audb)
+		return;
+
+	memcpy(src->abufs[0], src->audb, src->ofs_audb);
+	src->shm.ptr->abufused[0] = src->ofs_audb;
+	src->ofs_audb = 0;
+}
+
+/* timestamp, set the dirty region and hand the video buffer to the client */
+static void mark_frame(arcan_frameserver* src)
+{
+	struct arcan_shmif_region reg;
+	if (src->desc.region_valid)
+		reg = src->desc.region;
+	else
+		reg = (struct arcan_shmif_region){
+			.x2 = src->desc.width, .y2 = src->desc.height
+		};
+
+	atomic_store(&src->shm.ptr->vpts, arcan_timemillis());
+	atomic_store(&src->shm.ptr->dirty, reg);
+	atomic_store(&src->shm.ptr->vready, 1);
+}
+
 enum arcan_ffunc_rv arcan_frameserver_avfeedframe FFUNC_HEAD
 {
 	assert(state.ptr);
@@ -1017,11 +1379,7 @@ enum arcan_ffunc_rv arcan_frameserver_avfeedframe FFUNC_HEAD
 	else if (cmd == FFUNC_READBACK){
 		if (src->shm.ptr && !src->shm.ptr->vready){
 			memcpy(src->vbufs[0], buf, buf_sz);
-			if (src->ofs_audb){
-				memcpy(src->abufs[0], src->audb, src->ofs_audb);
-				src->shm.ptr->abufused[0] = src->ofs_audb;
-				src->ofs_audb = 0;
-			}
+			feed_audio(src);
 
 /*
  * it is possible that we deliver more videoframes than we can legitimately
@@ -1033,17 +1391,7 @@ enum arcan_ffunc_rv arcan_frameserver_avfeedframe FFUNC_HEAD
 				.category = EVENT_TARGET,
 				.tgt.ioevs[0] = src->vfcount++
 			};
-			struct arcan_shmif_region reg;
-			if (src->desc.region_valid)
-				reg = src->desc.region;
-			else
-				reg = (struct arcan_shmif_region){
-					.x2 = src->desc.width, .y2 = src->desc.height
-				};
-
-			atomic_store(&src->shm.ptr->vpts, arcan_timemillis());
-			atomic_store(&src->shm.ptr->dirty, reg);
-			atomic_store(&src->shm.ptr->vready, 1);
+			mark_frame(src);
 			platform_fsrv_pushevent(src, &ev);
 
 			if (src->desc.callback_framestate)
@@ -1054,6 +1402,52 @@ enum arcan_ffunc_rv arcan_frameserver_avfeedframe FFUNC_HEAD
 				emit_droppedframe(src, 0, src->desc.dropcount++);
 		}
 	}
+/*
+ * Zero-copy version of the above for clients that have opted in through the
+ * page hints. With buf == NULL this only checks if a frame can be taken now,
+ * otherwise buf carries [buf_sz] exported planes that replace the readback.
+ * The descriptors are ours to close either way.
+ */
+	else if (cmd == FFUNC_READBACK_HANDLE){
+		struct agp_buffer_plane* planes = (struct agp_buffer_plane*) buf;
+		bool accept = src->shm.ptr && !src->shm.ptr->vready &&
+			(atomic_load(&src->shm.ptr->hints) & SHMIF_RHINT_IMPORT_BUFFER);
+
+		if (!accept || !planes){
+			for (size_t i = 0; planes && i < buf_sz; i++)
+				close(planes[i].fd);
+
+			platform_fsrv_leave();
+			return accept ? FRV_GOTFRAME : FRV_NOFRAME;
+		}
+
+		feed_audio(src);
+		mark_frame(src);
+		unsigned frame = src->vfcount++;
+
+		for (size_t i = 0; i < buf_sz; i++){
+			arcan_event ev = {
+				.category = EVENT_TARGET,
+				.tgt.kind = TARGET_COMMAND_BUFFERSTREAM,
+				.tgt.ioevs[0].iv = planes[i].fd,
+				.tgt.ioevs[1].iv = buf_sz - i - 1,
+				.tgt.ioevs[2].uiv = planes[i].gbm.stride,
+				.tgt.ioevs[3].uiv = planes[i].gbm.offset,
+				.tgt.ioevs[4].uiv = planes[i].gbm.format,
+				.tgt.ioevs[5].uiv = planes[i].gbm.mod_hi,
+				.tgt.ioevs[6].uiv = planes[i].gbm.mod_lo,
+				.tgt.ioevs[7].uiv = frame
+			};
+			platform_fsrv_pushfd(src, &ev, planes[i].fd);
+			close(planes[i].fd);
+		}
+
+		if (src->desc.callback_framestate)
+			emit_deliveredframe(src, 0, src->desc.framecount++);
+
+		platform_fsrv_leave();
+		return FRV_GOTFRAME;
+	}
 	else
 			;
 
@@ -1062,11 +1456,336 @@ no_out:
 	return FRV_NOFRAME;
 }
 
+/*
+ * Mixer stages, all on interleaved L/R:
+ *  gain - int16 to float with the per channel gain applied
+ *  mix  - acc = acc + in - acc * in, one source at a time
+ *  pack - float back to int16 with clipping
+ */
+static void amix_gain(float* out,
+	const int16_t* in, size_t n, float l_gain, float r_gain)
+{
+	const float gain[2] = {l_gain / 32767.0f, r_gain / 32767.0f};
+	for (size_t i = 0; i < n; i++)
+		out[i] = (float) in[i] * gain[i % 2];
+}
+
+static void amix_mix(float* acc, const float* in, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		acc[i] += in[i] - acc[i] * in[i];
+}
+
+static float amix_clip(float v)
+{
+	v *= 32767.0f;
+	return v > 32767.0f ? 32767.0f : (v < -32768.0f ? -32768.0f : v);
+}
+
+static void amix_pack(int16_t* out, const float* in, size_t n)
+{
+	for (size_t i = 0; i < n; i++){
+		int16_t sample = lrintf(amix_clip(in[i]));
+		memcpy(&out[i], &sample, sizeof(int16_t));
+	}
+}
+
+#ifdef AMIX_SIMD_X86
+#define SSE2_FN __attribute__((target("sse2")))
+#define AVX2_FN __attribute__((target("avx2")))
+
+static SSE2_FN void amix_gain_sse2(float* out,
+	const int16_t* in, size_t n, float l_gain, float r_gain)
+{
+	const __m128 gain = _mm_setr_ps(
+		l_gain / 32767.0f, r_gain / 32767.0f, l_gain / 32767.0f, r_gain / 32767.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		__m128i v = _mm_loadu_si128((__m128i*) &in[i]);
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_ps(&out[i], _mm_mul_ps(_mm_cvtepi32_ps(lo), gain));
+		_mm_storeu_ps(&out[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), gain));
+	}
+
+	amix_gain(&out[i], &in[i], n - i, l_gain, r_gain);
+}
+
+static SSE2_FN void amix_mix_sse2(float* acc, const float* in, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		__m128 a = _mm_loadu_ps(&acc[i]);
+		__m128 b = _mm_loadu_ps(&in[i]);
+		_mm_storeu_ps(&acc[i], _mm_add_ps(a, _mm_sub_ps(b, _mm_mul_ps(a, b))));
+	}
+
+	amix_mix(&acc[i], &in[i], n - i);
+}
+
+static SSE2_FN void amix_pack_sse2(int16_t* out, const float* in, size_t n)
+{
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	const __m128 lim_hi = _mm_set1_ps(32767.0f);
+	const __m128 lim_lo = _mm_set1_ps(-32768.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(&in[i]), scale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(&in[i + 4]), scale);
+		a = _mm_max_ps(_mm_min_ps(a, lim_hi), lim_lo);
+		b = _mm_max_ps(_mm_min_ps(b, lim_hi), lim_lo);
+		_mm_storeu_si128((__m128i*) &out[i],
+			_mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+	}
+
+	amix_pack(&out[i], &in[i], n - i);
+}
+
+static AVX2_FN void amix_gain_avx2(float* out,
+	const int16_t* in, size_t n, float l_gain, float r_gain)
+{
+	const float lg = l_gain / 32767.0f;
+	const float rg = r_gain / 32767.0f;
+	const __m256 gain = _mm256_setr_ps(lg, rg, lg, rg, lg, rg, lg, rg);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16){
+		__m256i v = _mm256_loadu_si256((__m256i*) &in[i]);
+		__m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+		__m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1));
+		_mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_cvtepi32_ps(lo), gain));
+		_mm256_storeu_ps(&out[i + 8], _mm256_mul_ps(_mm256_cvtepi32_ps(hi), gain));
+	}
+
+	amix_gain_sse2(&out[i], &in[i], n - i, l_gain, r_gain);
+}
+
+static AVX2_FN void amix_mix_avx2(float* acc, const float* in, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		__m256 a = _mm256_loadu_ps(&acc[i]);
+		__m256 b = _mm256_loadu_ps(&in[i]);
+		_mm256_storeu_ps(&acc[i],
+			_mm256_add_ps(a, _mm256_sub_ps(b, _mm256_mul_ps(a, b))));
+	}
+
+	amix_mix(&acc[i], &in[i], n - i);
+}
+
+static AVX2_FN void amix_pack_avx2(int16_t* out, const float* in, size_t n)
+{
+	const __m256 scale = _mm256_set1_ps(32767.0f);
+	const __m256 lim_hi = _mm256_set1_ps(32767.0f);
+	const __m256 lim_lo = _mm256_set1_ps(-32768.0f);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16){
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(&in[i]), scale);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(&in[i + 8]), scale);
+		a = _mm256_max_ps(_mm256_min_ps(a, lim_hi), lim_lo);
+		b = _mm256_max_ps(_mm256_min_ps(b, lim_hi), lim_lo);
+
+/* packs works per 128-bit lane, swap the middle quads back into order */
+		__m256i res = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+		_mm256_storeu_si256((__m256i*) &out[i], _mm256_permute4x64_epi64(res, 0xd8));
+	}
+
+	amix_pack(&out[i], &in[i], n - i);
+}
+#endif
+
+#ifdef AMIX_SIMD_NEON
+static void amix_gain_neon(float* out,
+	const int16_t* in, size_t n, float l_gain, float r_gain)
+{
+	const float gv[4] = {
+		l_gain / 32767.0f, r_gain / 32767.0f, l_gain / 32767.0f, r_gain / 32767.0f};
+	const float32x4_t gain = vld1q_f32(gv);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		int16x8_t v = vld1q_s16(&in[i]);
+		vst1q_f32(&out[i], vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), gain));
+		vst1q_f32(&out[i + 4],
+			vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), gain));
+	}
+
+	amix_gain(&out[i], &in[i], n - i, l_gain, r_gain);
+}
+
+static void amix_mix_neon(float* acc, const float* in, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		float32x4_t a = vld1q_f32(&acc[i]);
+		float32x4_t b = vld1q_f32(&in[i]);
+		vst1q_f32(&acc[i], vaddq_f32(a, vsubq_f32(b, vmulq_f32(a, b))));
+	}
+
+	amix_mix(&acc[i], &in[i], n - i);
+}
+
+static inline int32x4_t neon_round(float32x4_t v)
+{
+#ifdef __aarch64__
+	return vcvtnq_s32_f32(v);
+#else
+	uint32x4_t neg = vcltq_f32(v, vdupq_n_f32(0.0f));
+	float32x4_t half = vbslq_f32(neg, vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+	return vcvtq_s32_f32(vaddq_f32(v, half));
+#endif
+}
+
+static void amix_pack_neon(int16_t* out, const float* in, size_t n)
+{
+	const float32x4_t scale = vdupq_n_f32(32767.0f);
+	const float32x4_t lim_hi = vdupq_n_f32(32767.0f);
+	const float32x4_t lim_lo = vdupq_n_f32(-32768.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		float32x4_t a = vmulq_f32(vld1q_f32(&in[i]), scale);
+		float32x4_t b = vmulq_f32(vld1q_f32(&in[i + 4]), scale);
+		a = vmaxq_f32(vminq_f32(a, lim_hi), lim_lo);
+		b = vmaxq_f32(vminq_f32(b, lim_hi), lim_lo);
+		vst1q_s16(&out[i],
+			vcombine_s16(vqmovn_s32(neon_round(a)), vqmovn_s32(neon_round(b))));
+	}
+
+	amix_pack(&out[i], &in[i], n - i);
+}
+#endif
+
+static struct {
+	bool init;
+	void (*gain)(float*, const int16_t*, size_t, float, float);
+	void (*mix)(float*, const float*, size_t);
+	void (*pack)(int16_t*, const float*, size_t);
+	int resample_quality;
+} amix = {
+	.gain = amix_gain,
+	.mix = amix_mix,
+	.pack = amix_pack,
+	.resample_quality = SPEEX_RESAMPLER_QUALITY_DEFAULT
+};
+
+/* ARCAN_AMIX_RESAMPLE picks the resampler profile for sources that negotiated
+ * their own samplerate: low (short filters, less latency and cpu for low
+ * power devices), default, high or an explicit 0-10 speex quality */
+static void resample_select()
+{
+	const char* val = getenv("ARCAN_AMIX_RESAMPLE");
+	if (!val)
+		return;
+
+	if (strcmp(val, "low") == 0)
+		amix.resample_quality = 1;
+	else if (strcmp(val, "high") == 0)
+		amix.resample_quality = 8;
+	else if (strcmp(val, "default") == 0)
+		amix.resample_quality = SPEEX_RESAMPLER_QUALITY_DEFAULT;
+	else if (val[0] >= '0' && val[0] <= '9'){
+		long q = strtol(val, NULL, 10);
+		amix.resample_quality = q > 10 ? 10 : q;
+	}
+}
+
+/* ARCAN_AMIX_NOSIMD in the env keeps the scalar versions for comparison */
+static void amix_select()
+{
+	if (amix.init)
+		return;
+	amix.init = true;
+	resample_select();
+
+	if (getenv("ARCAN_AMIX_NOSIMD"))
+		return;
+
+#ifdef AMIX_SIMD_X86
+	if (__builtin_cpu_supports("avx2")){
+		amix.gain = amix_gain_avx2;
+		amix.mix = amix_mix_avx2;
+		amix.pack = amix_pack_avx2;
+	}
+	else if (__builtin_cpu_supports("sse2")){
+		amix.gain = amix_gain_sse2;
+		amix.mix = amix_mix_sse2;
+		amix.pack = amix_pack_sse2;
+	}
+#endif
+
+#ifdef AMIX_SIMD_NEON
+#if defined(__arm__) && defined(__linux__)
+	if (!(getauxval(AT_HWCAP) & HWCAP_NEON))
+		return;
+#endif
+	amix.gain = amix_gain_neon;
+	amix.mix = amix_mix_neon;
+	amix.pack = amix_pack_neon;
+#endif
+}
+
+/* Convert, apply gain and append to the source buffer. Sources that have
+ * negotiated a different samplerate are resampled here so that every buffer
+ * is at the native rate when the mix stage runs. */
+static void buffer_amixer(struct frameserver_audsrc* cur,
+	const int16_t* buf, size_t nsamples, unsigned frequency)
+{
+	size_t ulim = COUNT_OF(cur->inbuf);
+	nsamples &= ~(size_t)1;
+
+	if (frequency && frequency != ARCAN_SHMIF_SAMPLERATE){
+		int err;
+		if (!cur->resampler)
+			cur->resampler = speex_resampler_init(2, frequency,
+				ARCAN_SHMIF_SAMPLERATE, amix.resample_quality, &err);
+		else if (cur->rate != frequency)
+			speex_resampler_set_rate(
+				cur->resampler, frequency, ARCAN_SHMIF_SAMPLERATE);
+		cur->rate = frequency;
+	}
+	else
+		cur->rate = ARCAN_SHMIF_SAMPLERATE;
+
+	if (cur->rate == ARCAN_SHMIF_SAMPLERATE || !cur->resampler){
+		size_t n = ulim - cur->inofs;
+		n = nsamples < n ? nsamples : n;
+		amix.gain(&cur->inbuf[cur->inofs], buf, n, cur->l_gain, cur->r_gain);
+		cur->inofs += n;
+		return;
+	}
+
+	float work[1024];
+	while (nsamples && cur->inofs < ulim){
+		size_t n = nsamples < COUNT_OF(work) ? nsamples : COUNT_OF(work);
+		amix.gain(work, buf, n, cur->l_gain, cur->r_gain);
+
+		spx_uint32_t in_len = n >> 1;
+		spx_uint32_t out_len = (ulim - cur->inofs) >> 1;
+		speex_resampler_process_interleaved_float(
+			cur->resampler, work, &in_len, &cur->inbuf[cur->inofs], &out_len);
+
+		cur->inofs += out_len << 1;
+		buf += in_len << 1;
+		nsamples -= in_len << 1;
+
+/* out of buffer space, the rest is truncated as with the native rate */
+		if (!in_len)
+			break;
+	}
+}
+
 /* assumptions:
  * buf_sz doesn't contain partial samples (% (bytes per sample * channels))
  * dst->amixer inaud is allocated and allocation count matches n_aids */
 static void feed_amixer(arcan_frameserver* dst, arcan_aobj_id srcid,
-	int16_t* buf, int nsamples)
+	int16_t* buf, int nsamples, unsigned frequency)
 {
 /* formats; nsamples (samples in, 2 samples / frame)
  * cur->inbuf; samples converted to float with gain, 2 samples / frame)
@@ -1078,15 +1797,9 @@ static void feed_amixer(arcan_frameserver* dst, arcan_aobj_id srcid,
 	for (int i = 0; i < dst->amixer.n_aids; i++){
 		struct frameserver_audsrc* cur = dst->amixer.inaud + i;
 
-		if (cur->src_aid == srcid){
-			int ulim = sizeof(cur->inbuf) / sizeof(float);
-			int count = 0;
-
-			while (nsamples-- && cur->inofs < ulim){
-				float val = *buf++;
-				cur->inbuf[cur->inofs++] =
-					(count++ % 2 ? cur->l_gain : cur->r_gain) * (val / 32767.0f);
-			}
+		if (cur->src_aid == srcid && nsamples > 0){
+			buffer_amixer(cur, buf, nsamples, frequency);
+			nsamples = 0;
 		}
 
 		if (cur->inofs < minv)
@@ -1099,24 +1812,21 @@ static void feed_amixer(arcan_frameserver* dst, arcan_aobj_id srcid,
  * A = float(sampleA) * gainA.
  * B = float(sampleB) * gainB. Z = A + B - A * B
  */
-		if (minv != INT_MAX && minv > 512 && dst->sz_audb - dst->ofs_audb > 0){
-/* clamp */
-			if (dst->ofs_audb + minv * sizeof(uint16_t) > dst->sz_audb)
-				minv = (dst->sz_audb - dst->ofs_audb) / sizeof(uint16_t);
+	if (minv != INT_MAX && minv > 512 && dst->sz_audb - dst->ofs_audb > 0){
+/* clamp, and keep whole frames so the sources stay L/R aligned */
+		if (dst->ofs_audb + minv * sizeof(uint16_t) > dst->sz_audb)
+			minv = ((dst->sz_audb - dst->ofs_audb) / sizeof(uint16_t)) & ~(size_t)1;
 
-			for (int sc = 0; sc < minv; sc++){
-				float work_sample = 0;
+/* the accumulator runs over the sources one at a time so the stages can work
+ * on whole buffers instead of sample by sample */
+		float* acc = dst->amixer.acc;
+		memset(acc, '\0', minv * sizeof(float));
+		for (int i = 0; i < dst->amixer.n_aids; i++)
+			amix.mix(acc, dst->amixer.inaud[i].inbuf, minv);
+
+		amix.pack((int16_t*) &dst->audb[dst->ofs_audb], acc, minv);
+		dst->ofs_audb += minv * sizeof(int16_t);
 
-			for (int i = 0; i < dst->amixer.n_aids; i++){
-				work_sample += dst->amixer.inaud[i].inbuf[sc] - (work_sample *
-					dst->amixer.inaud[i].inbuf[sc]);
-			}
-/* clip output */
-			int16_t sample_conv = work_sample >= 1.0 ? 32767.0 :
-				(work_sample < -1.0 ? -32768 : work_sample * 32767);
-			memcpy(&dst->audb[dst->ofs_audb], &sample_conv, sizeof(int16_t));
-			dst->ofs_audb += sizeof(int16_t);
-		}
 /* 2b. Reset intermediate buffers, slide if needed. */
 		for (int j = 0; j < dst->amixer.n_aids; j++){
 			struct frameserver_audsrc* cur = dst->amixer.inaud + j;
@@ -1129,7 +1839,19 @@ static void feed_amixer(arcan_frameserver* dst, arcan_aobj_id srcid,
 				cur->inofs = 0;
 		}
 	}
+}
 
+static void drop_amixer(arcan_frameserver* dst)
+{
+	for (int i = 0; i < dst->amixer.n_aids; i++)
+		if (dst->amixer.inaud[i].resampler)
+			speex_resampler_destroy(dst->amixer.inaud[i].resampler);
+
+	arcan_mem_free(dst->amixer.inaud);
+	arcan_mem_free(dst->amixer.acc);
+	dst->amixer.inaud = NULL;
+	dst->amixer.acc = NULL;
+	dst->amixer.n_aids = 0;
 }
 
 void arcan_frameserver_update_mixweight(arcan_frameserver* dst,
@@ -1148,12 +1870,15 @@ void arcan_frameserver_avfeed_mixer(arcan_frameserver* dst, int n_sources,
 {
 	assert(sources != NULL && dst != NULL && n_sources > 0);
 
-	if (dst->amixer.n_aids)
-		arcan_mem_free(dst->amixer.inaud);
+	drop_amixer(dst);
+	amix_select();
 
 	dst->amixer.inaud = arcan_alloc_mem(
 		n_sources * sizeof(struct frameserver_audsrc),
 		ARCAN_MEM_ATAG, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	dst->amixer.acc = arcan_alloc_mem(
+		sizeof(dst->amixer.inaud->inbuf),
+		ARCAN_MEM_ATAG, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_SIMD);
 
 	for (int i = 0; i < n_sources; i++){
 		dst->amixer.inaud[i].l_gain  = 1.0;
@@ -1172,19 +1897,12 @@ void arcan_frameserver_avfeedmon(arcan_aobj_id src, uint8_t* buf,
 	assert((intptr_t)(buf) % 4 == 0);
 
 /*
- * FIXME: This is a victim of a recent shmif refactor where we started to
- * allow negotating different samplerates. This should be complemented with
- * the speex- resampler that's in the codebase already
+ * The mixer stage is also where the resampling happens, so a single feed with
+ * a non-native samplerate gets routed through a mixer of its own. With unit
+ * gain and only one source the mix formula passes the samples through.
  */
-	if (frequency != ARCAN_SHMIF_SAMPLERATE){
-		static bool warn;
-		if (!warn){
-			arcan_warning("arcan_frameserver_avfeedmon(), monitoring an audio feed\n"
-				"with a non-native samplerate, this is >currently< supported for\n"
-				"playback but not for recording (TOFIX).\n");
-			warn = true;
-		}
-	}
+	if (frequency && frequency != ARCAN_SHMIF_SAMPLERATE && !dst->amixer.n_aids)
+		arcan_frameserver_avfeed_mixer(dst, 1, &src);
 
 /*
  * with no mixing setup (lowest latency path), we just feed the sync buffer
@@ -1193,7 +1911,7 @@ void arcan_frameserver_avfeedmon(arcan_aobj_id src, uint8_t* buf,
  * sources
  */
 	if (dst->amixer.n_aids > 0){
-		feed_amixer(dst, src, (int16_t*) buf, buf_sz >> 1);
+		feed_amixer(dst, src, (int16_t*) buf, buf_sz >> 1, frequency);
 	}
 	else if (dst->ofs_audb + buf_sz < dst->sz_audb){
 			memcpy(dst->audb + dst->ofs_audb, buf, buf_sz);
@@ -1245,6 +1963,38 @@ static inline void emit_droppedframe(arcan_frameserver* src,
 	arcan_event_enqueue(arcan_event_defaultctx(), &deliv);
 }
 
+bool arcan_frameserver_perf(arcan_frameserver* src, struct arcan_shmif_perf* out)
+{
+	if (!src || !out || !src->shm.ptr)
+		return false;
+
+	TRAMP_GUARD(false, src);
+
+/* the counters mutate independently, this is a sample and not a snapshot */
+	struct arcan_shmif_perf* perf = &src->shm.ptr->perf;
+	*out = (struct arcan_shmif_perf){};
+#define PERF(X) atomic_store_explicit(&out->X, \
+	atomic_load_explicit(&perf->X, memory_order_relaxed), memory_order_relaxed)
+	PERF(frames);
+	PERF(dropped);
+	PERF(audio);
+	PERF(render_us);
+	PERF(wait_us);
+	PERF(last_render_us);
+	PERF(last_wait_us);
+	PERF(outq_hwm);
+	PERF(inq_hwm);
+	PERF(outq_full);
+	PERF(resizes);
+	PERF(resize_us);
+	PERF(evwaits);
+	PERF(evwait_us);
+#undef PERF
+
+	platform_fsrv_leave();
+	return true;
+}
+
 bool arcan_frameserver_getramps(arcan_frameserver* src,
 	size_t index, float* table, size_t table_sz, size_t* ch_sz)
 {
@@ -1358,6 +2108,9 @@ bool arcan_frameserver_setramps(
  * This is a legacy- feed interface and doesn't reflect how the shmif audio
  * buffering works. Hence we ignore queing to the selected buffer, and instead
  * use a populate function to retrieve at most n' buffers that we then fill.
+ *
+ * The audio platform may call this from its mixer thread, with the shm read
+ * lock held, so only the audio parts of the shared page are touched here.
  */
 arcan_errc arcan_frameserver_audioframe_direct(void* aobj,
 	arcan_aobj_id id, unsigned buffer, bool cont, void* tag)
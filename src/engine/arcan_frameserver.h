@@ -51,6 +51,9 @@ struct arcan_frameserver_meta {
 		int hint;
 		float szmm;
 		size_t cellw, cellh;
+
+/* cell grid and atlas reference for drawing TPACK on the GPU */
+		struct tpack_gpu* gpu;
 	} text;
 
 /* tracking state for displayhint events - somewhat redundant in that width/
@@ -88,12 +91,22 @@ struct arcan_frameserver_meta {
 		uint8_t gamma_map;
 	} aext;
 
+/* latest validated packed mesh (VOBJ) copied out of the video buffer, owned
+ * here until add_3dmesh claims it */
+	struct {
+		uint8_t* buf;
+		size_t buf_sz;
+	} mesh;
+
 /* statistics for tracking performance / timing */
 	bool callback_framestate;
 	unsigned long long framecount;
 	unsigned long long dropcount;
 	unsigned long long lastpts;
 
+/* arcan_timemicros of the last delivered video frame, 0 if none */
+	uint64_t frame_us;
+
 /* This one was added to have a way to mark objects that were created in the
  * main entrypoint of the lua scripts (that run before _adopt) but in recovery
  * would still be exposed to adopt. If the developer would reject it there
@@ -111,6 +124,10 @@ struct frameserver_audsrc {
 	arcan_aobj_id src_aid;
 	float l_gain;
 	float r_gain;
+
+/* created when the source has a non-native samplerate */
+	void* resampler;
+	unsigned rate;
 };
 
 struct arcan_frameserver {
@@ -187,10 +204,26 @@ struct arcan_frameserver {
 		bool sandboxed : 1;
 		bool wrapped : 1;
 
+/* socket readiness latched by the conductor wait set, only valid when
+ * sock_watch is set, otherwise the socket has to be polled directly */
+		bool sock_watch : 1;
+		bool sock_ready : 1;
+		bool sock_hup : 1;
+
 /* tristate: 0 (default) empty, 1 (preroll-ok), 2 (preroll-lock) */
 		int activated;
 	} flags;
 
+/* scheduling class assigned by the conductor on each herd step, [skip_poll]
+ * defers buffer polling to a later step, [throttled] tracks if the client has
+ * been hinted as invisible and [since] is the step the client was occluded */
+	struct {
+		uint8_t cls;
+		bool skip_poll;
+		bool throttled;
+		uint64_t since;
+	} prio;
+
 /* if autoclock is set, track and use as metric for firing events */
 	struct {
 		uint32_t left;
@@ -203,6 +236,7 @@ struct arcan_frameserver {
 		bool frame;
 		bool once;
 		bool vblank;
+		bool tearing;
 	} clock;
 
 /* for monitoring hooks, 0 entry terminates. */
@@ -219,6 +253,7 @@ struct arcan_frameserver {
 		unsigned n_aids;
 		size_t max_bufsz;
 		struct frameserver_audsrc* inaud;
+		float* acc;
 	} amixer;
 
 /* playstate control and statistics */
@@ -247,6 +282,21 @@ struct arcan_frameserver {
 		size_t incoming_used;
 
 		size_t skip;
+
+/* client attaches acquire fences, send release fences back */
+		bool fenced;
+
+/* shared memory passed instead of vidp (arcan_shmif_signal_shm), the
+ * descriptor is consumed by the next push_buffer while the mapping is
+ * cached by the platform for as long as the source file stays the same */
+		struct {
+			int fd;
+			uint32_t offset, stride, format, w, h;
+
+			uint8_t* map;
+			size_t map_sz;
+			uint64_t dev, ino;
+		} pool;
 	} vstream;
 
 /* temporary buffer for aligning queue/dequeue events in audio, can/should
@@ -278,6 +328,11 @@ struct arcan_frameserver {
 	size_t abuf_sz;
 	size_t vbuf_cnt;
 
+/* negotiated swapchain model (0 for default) and the slot currently held
+ * for reading, offset by one so that 0 means none */
+	int vswap;
+	int vslot_held;
+
 /* for use with rz_ack */
 	int rz_known;
 	shmif_pixel* vbufs[FSRV_MAX_VBUFC];
@@ -416,6 +471,15 @@ bool arcan_frameserver_setramps(arcan_frameserver*,
 	uint8_t* edid, size_t edid_sz
 );
 
+/*
+ * Sample the performance counters the client keeps in the shared page
+ * (struct arcan_shmif_perf). The values are reported by the client and
+ * should be treated as untrusted hints.
+ *
+ * Returns false if there is no page or it couldn't be read.
+ */
+bool arcan_frameserver_perf(arcan_frameserver*, struct arcan_shmif_perf* out);
+
 /*
  * Various transfer- and buffering schemes. These should not be mapped
  * into video- feedfunctions by themeselves, but managed through
@@ -527,6 +591,12 @@ void arcan_frameserver_lock_buffers(int state);
  */
 int arcan_frameserver_releaselock(struct arcan_frameserver* tgt);
 
+/*
+ * Attach the last scanout timestamp and refresh estimate to a STEPFRAME
+ * (ioevs[3..5], see TARGET_COMMAND_STEPFRAME) before it is pushed.
+ */
+void arcan_frameserver_stamp_present(struct arcan_event* ev);
+
 /*
  * helper functions that tie together the platform/.../frameserver.c
  * with allocation, member matching, presets etc.
@@ -541,6 +611,20 @@ arcan_frameserver* platform_launch_internal(const char* fname,
 	struct arcan_strarr* argv, struct arcan_strarr* envv,
 	struct arcan_strarr* libs, uintptr_t tag);
 
+/*
+ * Maintain the pool of prewarmed frameservers (frameserver_pool config),
+ * called by the conductor once per tick to replace the ones that have
+ * been handed out or died while waiting.
+ */
+void platform_launch_pool_step();
+
+/*
+ * Set the resource class (interactive, realtime-audio, batch-decode,
+ * background) that subsequent launches are placed in, NULL or empty
+ * returns to the per-archetype default. Returns false on unknown class.
+ */
+bool platform_launch_class(const char* name);
+
 /*
  * Working against the mapped shared memory page is a critical section,
  * there are corner cases and DoS opportunities that could be exploited
@@ -100,6 +100,8 @@ typedef struct {
 /*
  * found / implemented in arcan_event.c
  */
+#define BENCH_INPUT_CLASSES 4
+
 typedef struct {
 	bool bench_enabled;
 
@@ -111,6 +113,21 @@ typedef struct {
 
 	unsigned framecost[64], costcount;
 	char costofs;
+
+/* microseconds of Lua GC work scheduled in idle time, per frame */
+	unsigned gccost[64], gccount;
+	char gcofs;
+
+/* microseconds of GPU time spent on rendertarget passes, per frame
+ * (only with video_gpu_timers), lags a few frames behind */
+	unsigned gpucost[64], gpucount;
+	char gpuofs;
+
+/* microseconds from reading an input sample to the presentation of the first
+ * frame that could reflect it, per device class (keyboard, mouse, touch,
+ * game), kept regardless of bench_enabled */
+	unsigned inputlat[BENCH_INPUT_CLASSES][128], inputlatcount[BENCH_INPUT_CLASSES];
+	char inputlatofs[BENCH_INPUT_CLASSES];
 } arcan_benchdata;
 
 /*
@@ -145,8 +162,23 @@ void arcan_state_dump(const char* prefix, const char* key, const char* src);
 void arcan_bench_register_tick(unsigned);
 void arcan_bench_register_cost(unsigned);
 void arcan_bench_register_frame();
+void arcan_bench_register_gc(unsigned);
+void arcan_bench_register_gpu(unsigned);
 arcan_benchdata* arcan_bench_data();
 
+/* [called from platform] a frame has been presented (page flip completed),
+ * [present_us] is on the arcan_timemicros clock or 0 for 'now' */
+void arcan_bench_register_present(uint64_t present_us);
+
+/* timestamp (arcan_timemicros clock) of the last presented frame the platform
+ * has reported along with an estimate of the refresh period, both 0 if the
+ * platform doesn't report presentation */
+uint64_t arcan_bench_last_present(uint32_t* period_us);
+
+/* p50 / p99 over the input latency window of a device class (see
+ * arcan_benchdata), returns the number of samples used */
+size_t arcan_bench_input_latency(size_t devclass, unsigned* p50, unsigned* p99);
+
 /*
  * used throughout the engine (if set), using macro form in order for high-
  * optimized builds that disable tracing entirely
@@ -156,7 +188,8 @@ extern bool arcan_trace_enabled;
 /*
  * enable collection buffer, collection will continue until the next call
  * to setbuffer or when the buffer is full. When that occurs finish_flag
- * is set to true and control over buf will be relinquished.
+ * is set to true and control over buf will be relinquished. Any thread
+ * can mark, see arcan_trace_flush.
  *
  * the buffer will be packaged as follow:
  * [status flag] (1b) 0xff for complete, otherwise invalid and processing
@@ -172,9 +205,25 @@ void arcan_trace_setbuffer(uint8_t* buf, size_t buf_sz, bool* finish_flag);
 
 /*
  * appends a plain log message to the trace buffer
+ * (as a oneshot mark with the system 'trace' and subsystem 'log')
  */
 void arcan_trace_log(const char* message, size_t len);
 
+/*
+ * marks from any thread go into a per-thread ring, this merges them into
+ * the collection buffer in timestamp order. The thread that set the buffer
+ * also does this whenever its own ring is half full, other threads rely on
+ * this being called periodically (each script tick).
+ */
+void arcan_trace_flush();
+
+/*
+ * record the time spent in the startup phase [subsys] (static string) as a
+ * pair of 'startup' enter/exit marks, with the duration (us) as quantifier
+ * on the exit. These are held back and added first in the next collection.
+ */
+void arcan_trace_startup(const char* subsys, uint64_t start_us, uint64_t end_us);
+
 /*
  * cleans up trace buffer and tracy zones
  */
@@ -215,9 +264,42 @@ enum trace_level {
 	TRACE_SYS_ERROR = 4
 };
 
+/*
+ * compile-time trace categories, build with ARCAN_TRACE_CATEGORIES set to a
+ * mask of the TRACE_CAT_ values to keep and the marks for the other systems
+ * fold away (0 removes all of them). Without it every category is kept and
+ * only arcan_trace_enabled is checked.
+ */
+#define TRACE_CAT_CONDUCTOR 1
+#define TRACE_CAT_VIDEO 2
+#define TRACE_CAT_AGP 4
+#define TRACE_CAT_FONT 8
+#define TRACE_CAT_EVENT 16
+#define TRACE_CAT_FRAMESERVER 32
+#define TRACE_CAT_SCRIPTING 64
+#define TRACE_CAT_OTHER 128
+
+#ifdef ARCAN_TRACE_CATEGORIES
+static inline unsigned arcan_trace_category(const char* sys)
+{
+	return
+		__builtin_strcmp(sys, "conductor") == 0 ? TRACE_CAT_CONDUCTOR :
+		__builtin_strcmp(sys, "video") == 0 ? TRACE_CAT_VIDEO :
+		__builtin_strcmp(sys, "agp") == 0 ? TRACE_CAT_AGP :
+		__builtin_strcmp(sys, "font") == 0 ? TRACE_CAT_FONT :
+		__builtin_strcmp(sys, "event") == 0 ? TRACE_CAT_EVENT :
+		__builtin_strcmp(sys, "frameserver") == 0 ? TRACE_CAT_FRAMESERVER :
+		__builtin_strcmp(sys, "scripting") == 0 ? TRACE_CAT_SCRIPTING :
+		TRACE_CAT_OTHER;
+}
+#define TRACE_CATEGORY(A) ((ARCAN_TRACE_CATEGORIES & arcan_trace_category(A)) != 0)
+#else
+#define TRACE_CATEGORY(A) 1
+#endif
+
 #ifndef TRACE_MARK_ENTER
 #define TRACE_MARK_ENTER(A, B, C, D, E, F) do { \
-	if (arcan_trace_enabled){ \
+	if (TRACE_CATEGORY(A) && arcan_trace_enabled){ \
 		arcan_trace_mark((A), (B), 1, (C), (D), (E), (F), __FILE__, __FUNCTION__, __LINE__);\
 	}\
 } while (0);
@@ -225,7 +307,7 @@ enum trace_level {
 
 #ifndef TRACE_MARK_ONESHOT
 #define TRACE_MARK_ONESHOT(A, B, C, D, E, F) do { \
-	if (arcan_trace_enabled){ \
+	if (TRACE_CATEGORY(A) && arcan_trace_enabled){ \
 		arcan_trace_mark((A), (B), 0, (C), (D), (E), (F), __FILE__, __FUNCTION__, __LINE__);\
 	}\
 } while (0);
@@ -233,7 +315,7 @@ enum trace_level {
 
 #ifndef TRACE_MARK_EXIT
 #define TRACE_MARK_EXIT(A, B, C, D, E, F) do { \
-	if (arcan_trace_enabled){ \
+	if (TRACE_CATEGORY(A) && arcan_trace_enabled){ \
 		arcan_trace_mark((A), (B), 2, (C), (D), (E), (F), __FILE__, __FUNCTION__, __LINE__);\
 	}\
 } while (0);
@@ -12,6 +12,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "arcan_math.h"
 #include "arcan_general.h"
@@ -42,8 +43,12 @@ struct png_readstr
 	size_t inbuf_sz;
 };
 
-arcan_errc arcan_img_outpng(FILE* dst,
-	av_pixel* inbuf, size_t inw, size_t inh, bool vflip)
+/* the stb_image_write tuning knobs are globals, and the encoders run on
+ * detached screenshot threads - take the lock for the duration of an encode */
+static pthread_mutex_t stbiw_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static arcan_errc outpng(FILE* dst,
+	av_pixel* inbuf, size_t inw, size_t inh, bool vflip, bool fast)
 {
 	int outln = 0;
 	bool dynout = false;
@@ -92,16 +97,166 @@ arcan_errc arcan_img_outpng(FILE* dst,
 			memcpy(&outbuf[step * stride], &inbuf[row*inw], stride);
 	}
 
+/* fast mode: skip the per-row filter search (all five filters tried and
+ * scored) in favour of 'up', which suits mostly flat UI contents, and use
+ * the shortest hash chains stb allows */
+	pthread_mutex_lock(&stbiw_lock);
+	stbi_write_png_compression_level = fast ? 1 : 8;
+	stbi_write_force_png_filter = fast ? 2 : -1;
 	unsigned char* png = stbi_write_png_to_mem(
 		(unsigned char*) outbuf, 0, inw, inh, 4, &outln);
+	pthread_mutex_unlock(&stbiw_lock);
 
-	fwrite(png, 1, outln, dst);
-	arcan_mem_free(png);
+	arcan_errc rv = ARCAN_ERRC_OUT_OF_SPACE;
+	if (png){
+		rv = fwrite(png, 1, outln, dst) == (size_t) outln ? ARCAN_OK : ARCAN_ERRC_BAD_RESOURCE;
+		arcan_mem_free(png);
+	}
 
 	if (vflip || dynout)
 		arcan_mem_free(outbuf);
 
-	return ARCAN_OK;
+	return rv;
+}
+
+arcan_errc arcan_img_outpng(FILE* dst,
+	av_pixel* inbuf, size_t inw, size_t inh, bool vflip)
+{
+	return outpng(dst, inbuf, inw, inh, vflip, false);
+}
+
+arcan_errc arcan_img_outpng_fast(FILE* dst,
+	av_pixel* inbuf, size_t inw, size_t inh, bool vflip)
+{
+	return outpng(dst, inbuf, inw, inh, vflip, true);
+}
+
+/*
+ * QOI (qoiformat.org), single pass over the pixels with a 64 entry colour
+ * cache and small deltas against the previous pixel - an order of magnitude
+ * faster than deflate at a size that is usually within 2x of the PNG one
+ */
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xc0
+#define QOI_OP_RGB   0xfe
+#define QOI_OP_RGBA  0xff
+#define QOI_HASH(r, g, b, a) (((r) * 3 + (g) * 5 + (b) * 7 + (a) * 11) % 64)
+#define QOI_BUFSZ 65536
+
+static void qoi_be32(uint8_t* dst, uint32_t v)
+{
+	dst[0] = v >> 24;
+	dst[1] = v >> 16;
+	dst[2] = v >> 8;
+	dst[3] = v;
+}
+
+arcan_errc arcan_img_outqoi(FILE* dst,
+	av_pixel* inbuf, size_t inw, size_t inh, bool vflip)
+{
+	if (!inw || !inh || inw > UINT32_MAX || inh > UINT32_MAX)
+		return ARCAN_ERRC_BAD_ARGUMENT;
+
+/* worst case is 5b / px, flush when there is less than that left */
+	uint8_t* out = arcan_alloc_mem(QOI_BUFSZ, ARCAN_MEM_VBUFFER,
+		ARCAN_MEM_TEMPORARY | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+	if (!out)
+		return ARCAN_ERRC_OUT_OF_SPACE;
+
+	memcpy(out, "qoif", 4);
+	qoi_be32(&out[4], inw);
+	qoi_be32(&out[8], inh);
+	out[12] = 4;
+	out[13] = 0;
+	size_t ofs = 14;
+	bool ok = true;
+
+	uint8_t index[64][4] = {0};
+	uint8_t prev[4] = {0, 0, 0, 255};
+	size_t run = 0;
+
+	for (size_t row = 0; row < inh && ok; row++){
+		av_pixel* src = &inbuf[(vflip ? inh - row - 1 : row) * inw];
+		bool last_row = row == inh - 1;
+
+		for (size_t x = 0; x < inw; x++){
+			uint8_t px[4];
+			RGBA_DECOMP(src[x], &px[0], &px[1], &px[2], &px[3]);
+
+			if (QOI_BUFSZ - ofs < 8){
+				ok = fwrite(out, 1, ofs, dst) == ofs;
+				ofs = 0;
+			}
+
+			if (memcmp(px, prev, 4) == 0){
+				run++;
+				if (run == 62 || (last_row && x == inw - 1)){
+					out[ofs++] = QOI_OP_RUN | (run - 1);
+					run = 0;
+				}
+				continue;
+			}
+
+			if (run){
+				out[ofs++] = QOI_OP_RUN | (run - 1);
+				run = 0;
+			}
+
+			int ind = QOI_HASH(px[0], px[1], px[2], px[3]);
+			if (memcmp(index[ind], px, 4) == 0){
+				out[ofs++] = QOI_OP_INDEX | ind;
+			}
+			else {
+				memcpy(index[ind], px, 4);
+
+				if (px[3] == prev[3]){
+					int8_t vr = px[0] - prev[0];
+					int8_t vg = px[1] - prev[1];
+					int8_t vb = px[2] - prev[2];
+					int8_t vg_r = vr - vg;
+					int8_t vg_b = vb - vg;
+
+					if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2){
+						out[ofs++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+					}
+					else if (vg_r > -9 && vg_r < 8 &&
+						vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8){
+						out[ofs++] = QOI_OP_LUMA | (vg + 32);
+						out[ofs++] = (vg_r + 8) << 4 | (vg_b + 8);
+					}
+					else {
+						out[ofs++] = QOI_OP_RGB;
+						memcpy(&out[ofs], px, 3);
+						ofs += 3;
+					}
+				}
+				else {
+					out[ofs++] = QOI_OP_RGBA;
+					memcpy(&out[ofs], px, 4);
+					ofs += 4;
+				}
+			}
+
+			memcpy(prev, px, 4);
+		}
+	}
+
+	static const uint8_t padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+	if (ok && QOI_BUFSZ - ofs < 8){
+		ok = fwrite(out, 1, ofs, dst) == ofs;
+		ofs = 0;
+	}
+
+	if (ok){
+		memcpy(&out[ofs], padding, 8);
+		ofs += 8;
+		ok = fwrite(out, 1, ofs, dst) == ofs;
+	}
+
+	arcan_mem_free(out);
+	return ok ? ARCAN_OK : ARCAN_ERRC_BAD_RESOURCE;
 }
 
 av_pixel* arcan_img_repack(uint32_t* inbuf, size_t inw, size_t inh)
@@ -135,71 +290,396 @@ done:
 arcan_errc arcan_pkm_raw(const uint8_t* inbuf, size_t inbuf_sz,
 		uint32_t** outbuf, size_t* outw, size_t* outh, struct arcan_img_meta* meta)
 {
-#ifdef ETC1_SUPPORT
-/* extract header fields */
+	if (inbuf_sz < 16 || memcmp(inbuf, "PKM ", 4) != 0)
+		return ARCAN_ERRC_BAD_RESOURCE;
+
+/* extract header fields, format 0 is ETC1 RGB without mipmaps */
+	int format  = (inbuf[ 6] << 8) | inbuf[ 7];
 	int pwidth  = (inbuf[ 8] << 8) | inbuf[ 9];
 	int pheight = (inbuf[10] << 8) | inbuf[11];
 	int width   = (inbuf[12] << 8) | inbuf[13];
 	int height  = (inbuf[14] << 8) | inbuf[15];
 
+	size_t c_size = agp_compressed_size(AGP_COMPRESSED_ETC1, pwidth, pheight);
+	if (format != 0 || !width || !height || inbuf_sz - 16 < c_size)
+		return ARCAN_ERRC_UNSUPPORTED_FORMAT;
+
 /* strip header */
-	*outbuf = arcan_mem_alloc(inbuf_sz - 16,
-		ARCAN_MEM_VBUFFER, ARCAN_MEMALIGN_PAGE);
+	*outbuf = arcan_alloc_mem(c_size,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	if (!*outbuf)
+		return ARCAN_ERRC_OUT_OF_SPACE;
 
-	memcpy(*outbuf, inbuf + 16, inbuf_sz - 16);
+	memcpy(*outbuf, inbuf + 16, c_size);
 	meta->compressed = true;
+	meta->cformat = AGP_COMPRESSED_ETC1;
+	meta->levels = 1;
 	meta->pwidth = pwidth;
 	meta->pheight = pheight;
-	meta->c_size = (pwidth * pheight) >> 1;
+	meta->c_size = c_size;
 	*outw = width;
 	*outh = height;
 
 	return ARCAN_OK;
-#else
-	return ARCAN_ERRC_UNSUPPORTED_FORMAT;
-#endif
 }
 
-/*
-struct dds_data_fmt
+#ifndef MAX_DDS_DIMENSION
+#define MAX_DDS_DIMENSION 16384
+#endif
+
+static uint32_t le32(const uint8_t* p)
 {
-	GLsizei  width;
-	GLsizei  height;
-	GLint    components;
-	GLenum   format;
-	int      numMipMaps;
-	GLubyte *pixels;
-};
-*/
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
 
 arcan_errc arcan_dds_raw(const uint8_t* inbuf, size_t inbuf_sz,
 	uint32_t** outbuf, size_t* outw, size_t* outh, struct arcan_img_meta* meta)
 {
-#ifdef DDS_SUPPORT
-	struct dds_dsta_fmt* dds_img_data;
-	DDSurfacedesc2 ddsd;
-
-	strncmp(inbuf, "DDS ", 4) == 0;
-
-/* read DDSD */
-/* alloc outbuf as DDSIMAGEDATA */
-/* check FourCC from DDSD for supported formats;
- * FOURCC_DXT1,3,5 (factor 2, 4, 4 as CR)
- * something weird with dwLinearSize?
- * check mipmapcount (linearsize * factor from fourCC)
- * now we have raw-data
- * FOURCC DXT1 only gives RGB, no alpha channel
- * DXT1 has a block size of 8, otherwise 16
- * foreach mipmap level;
- *  (1, 1 dimension if 0 0,
- *  glCompressedTexImage(level, formatv, cw, ch, 0,
- *  (cw+3)/4 * (ch+3)/4 * blocksize)
- *  slide buffer offset with size
- *  shift down width / height
-*/
-#else
-	return ARCAN_ERRC_UNSUPPORTED_FORMAT;
-#endif
+/* magic + DDS_HEADER (124b), pixel format at 76, data follows at 128 */
+	if (inbuf_sz < 128 || memcmp(inbuf, "DDS ", 4) != 0 || le32(inbuf + 4) != 124)
+		return ARCAN_ERRC_BAD_RESOURCE;
+
+	uint32_t flags = le32(inbuf + 8);
+	size_t h = le32(inbuf + 12);
+	size_t w = le32(inbuf + 16);
+	size_t levels = (flags & 0x20000) ? le32(inbuf + 28) : 1;
+
+/* only plain DXT1/3/5 (DDPF_FOURCC), no DX10 header, cubemaps or volumes */
+	enum agp_compressed_format fmt;
+	if (!(le32(inbuf + 80) & 0x4))
+		return ARCAN_ERRC_UNSUPPORTED_FORMAT;
+	else if (memcmp(inbuf + 84, "DXT1", 4) == 0)
+		fmt = AGP_COMPRESSED_DXT1;
+	else if (memcmp(inbuf + 84, "DXT3", 4) == 0)
+		fmt = AGP_COMPRESSED_DXT3;
+	else if (memcmp(inbuf + 84, "DXT5", 4) == 0)
+		fmt = AGP_COMPRESSED_DXT5;
+	else
+		return ARCAN_ERRC_UNSUPPORTED_FORMAT;
+
+	if (!w || !h || w > MAX_DDS_DIMENSION || h > MAX_DDS_DIMENSION)
+		return ARCAN_ERRC_BAD_RESOURCE;
+
+/* a partial chain would leave the texture incomplete, so either all the
+ * levels down to 1x1 are present or only the first one is used */
+	size_t chain = 1;
+	for (size_t d = w > h ? w : h; d > 1; d >>= 1)
+		chain++;
+	if (levels != chain)
+		levels = 1;
+
+	size_t total = 0;
+	size_t lw = w, lh = h;
+	for (size_t i = 0; i < levels; i++){
+		total += agp_compressed_size(fmt, lw, lh);
+		lw = lw > 1 ? lw >> 1 : 1;
+		lh = lh > 1 ? lh >> 1 : 1;
+	}
+
+	if (total > inbuf_sz - 128){
+		levels = 1;
+		total = agp_compressed_size(fmt, w, h);
+		if (total > inbuf_sz - 128)
+			return ARCAN_ERRC_BAD_RESOURCE;
+	}
+
+	*outbuf = arcan_alloc_mem(total,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	if (!*outbuf)
+		return ARCAN_ERRC_OUT_OF_SPACE;
+
+	memcpy(*outbuf, inbuf + 128, total);
+	meta->compressed = true;
+	meta->mipmapped = levels > 1;
+	meta->cformat = fmt;
+	meta->levels = levels;
+	meta->pwidth = w;
+	meta->pheight = h;
+	meta->c_size = total;
+	*outw = w;
+	*outh = h;
+
+	return ARCAN_OK;
+}
+
+/* DXT color endpoints are RGB565, output packing matches stbi (RGBA bytes) */
+static void unpack565(uint16_t c, uint8_t* rgb)
+{
+	uint8_t r = (c >> 11) & 0x1f;
+	uint8_t g = (c >>  5) & 0x3f;
+	uint8_t b = (c >>  0) & 0x1f;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void dxt_colors(const uint8_t* blk, bool punch, uint32_t pal[4])
+{
+	uint16_t c0 = blk[0] | (blk[1] << 8);
+	uint16_t c1 = blk[2] | (blk[3] << 8);
+	uint8_t a[3], b[3], c[3], d[3];
+	unpack565(c0, a);
+	unpack565(c1, b);
+
+	bool four = !punch || c0 > c1;
+	for (size_t i = 0; i < 3; i++){
+		c[i] = four ? (2 * a[i] + b[i]) / 3 : (a[i] + b[i]) / 2;
+		d[i] = four ? (a[i] + 2 * b[i]) / 3 : 0;
+	}
+
+	pal[0] = a[0] | (a[1] << 8) | (a[2] << 16) | 0xff000000;
+	pal[1] = b[0] | (b[1] << 8) | (b[2] << 16) | 0xff000000;
+	pal[2] = c[0] | (c[1] << 8) | (c[2] << 16) | 0xff000000;
+	pal[3] = d[0] | (d[1] << 8) | (d[2] << 16) | (four ? 0xff000000 : 0);
+}
+
+static void dxt5_alpha(const uint8_t* blk, uint8_t out[16])
+{
+	uint8_t pal[8] = {blk[0], blk[1]};
+	if (pal[0] > pal[1]){
+		for (size_t i = 1; i < 7; i++)
+			pal[i+1] = ((7 - i) * pal[0] + i * pal[1]) / 7;
+	}
+	else {
+		for (size_t i = 1; i < 5; i++)
+			pal[i+1] = ((5 - i) * pal[0] + i * pal[1]) / 5;
+		pal[6] = 0;
+		pal[7] = 255;
+	}
+
+	uint64_t bits = 0;
+	for (size_t i = 0; i < 6; i++)
+		bits |= (uint64_t) blk[2 + i] << (8 * i);
+
+	for (size_t i = 0; i < 16; i++)
+		out[i] = pal[(bits >> (3 * i)) & 0x7];
+}
+
+uint32_t* arcan_img_expand(const uint8_t* inbuf,
+	const struct arcan_img_meta* meta, size_t w, size_t h, bool vflip)
+{
+	if (!meta->compressed ||
+		(meta->cformat != AGP_COMPRESSED_DXT1 &&
+		meta->cformat != AGP_COMPRESSED_DXT3 &&
+		meta->cformat != AGP_COMPRESSED_DXT5))
+		return NULL;
+
+	uint32_t* out = arcan_alloc_mem(w * h * 4,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	if (!out)
+		return NULL;
+
+	size_t bsz = meta->cformat == AGP_COMPRESSED_DXT1 ? 8 : 16;
+	size_t bw = (meta->pwidth + 3) / 4;
+	size_t bh = (meta->pheight + 3) / 4;
+
+	for (size_t by = 0; by < bh; by++)
+		for (size_t bx = 0; bx < bw; bx++){
+			const uint8_t* blk = inbuf + (by * bw + bx) * bsz;
+			uint8_t alpha[16];
+			bool has_alpha = true;
+
+			if (meta->cformat == AGP_COMPRESSED_DXT3){
+				for (size_t i = 0; i < 16; i++){
+					uint8_t v = (blk[i >> 1] >> (4 * (i & 1))) & 0x0f;
+					alpha[i] = v | (v << 4);
+				}
+				blk += 8;
+			}
+			else if (meta->cformat == AGP_COMPRESSED_DXT5){
+				dxt5_alpha(blk, alpha);
+				blk += 8;
+			}
+			else
+				has_alpha = false;
+
+			uint32_t pal[4];
+			dxt_colors(blk, !has_alpha, pal);
+			uint32_t idx = le32(blk + 4);
+
+			for (size_t i = 0; i < 16; i++){
+				size_t x = bx * 4 + (i & 3);
+				size_t y = by * 4 + (i >> 2);
+				if (x >= w || y >= h)
+					continue;
+
+				uint32_t px = pal[(idx >> (2 * i)) & 0x3];
+				if (has_alpha)
+					px = (px & 0x00ffffff) | ((uint32_t) alpha[i] << 24);
+
+				out[(vflip ? h - 1 - y : y) * w + x] = px;
+			}
+		}
+
+	return out;
+}
+
+/*
+ * Decoded images, most recently used first. A lookup hands out a copy so
+ * that the entries never alias a vstore (which may be freed, resized, or
+ * repacked in place).
+ */
+struct cache_ent {
+	char* path;
+	int64_t mtime;
+	uint64_t size;
+	bool vflip;
+
+	uint32_t* buf;
+	size_t buf_sz;
+	size_t w, h;
+	struct arcan_img_meta meta;
+
+	struct cache_ent* prev;
+	struct cache_ent* next;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct cache_ent* first;
+	struct cache_ent* last;
+	size_t used;
+	size_t limit;
+} cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static void cache_unlink(struct cache_ent* ent)
+{
+	if (ent->prev)
+		ent->prev->next = ent->next;
+	else
+		cache.first = ent->next;
+
+	if (ent->next)
+		ent->next->prev = ent->prev;
+	else
+		cache.last = ent->prev;
+
+	ent->prev = ent->next = NULL;
+}
+
+static void cache_drop(struct cache_ent* ent)
+{
+	cache_unlink(ent);
+	cache.used -= ent->buf_sz;
+	arcan_mem_free(ent->buf);
+	free(ent->path);
+	arcan_mem_free(ent);
+}
+
+static void cache_trim(size_t limit)
+{
+	while (cache.last && cache.used > limit)
+		cache_drop(cache.last);
+}
+
+static struct cache_ent* cache_find(const struct arcan_img_key* key)
+{
+	for (struct cache_ent* ent = cache.first; ent; ent = ent->next){
+		if (ent->vflip != key->vflip || strcmp(ent->path, key->path) != 0)
+			continue;
+
+/* the file has changed since, this entry will never match again */
+		if (ent->mtime != key->mtime || ent->size != key->size){
+			cache_drop(ent);
+			return NULL;
+		}
+
+		return ent;
+	}
+
+	return NULL;
+}
+
+void arcan_img_cache_limit(size_t limit)
+{
+	pthread_mutex_lock(&cache.lock);
+	cache.limit = limit;
+	cache_trim(limit);
+	pthread_mutex_unlock(&cache.lock);
+}
+
+uint32_t* arcan_img_cache_get(const struct arcan_img_key* key,
+	size_t* outw, size_t* outh, struct arcan_img_meta* meta)
+{
+	uint32_t* res = NULL;
+	pthread_mutex_lock(&cache.lock);
+
+	struct cache_ent* ent = cache.limit ? cache_find(key) : NULL;
+	if (!ent)
+		goto out;
+
+	res = arcan_alloc_mem(ent->buf_sz,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	if (!res)
+		goto out;
+
+	memcpy(res, ent->buf, ent->buf_sz);
+	*outw = ent->w;
+	*outh = ent->h;
+	*meta = ent->meta;
+
+	if (ent != cache.first){
+		cache_unlink(ent);
+		ent->next = cache.first;
+		cache.first->prev = ent;
+		cache.first = ent;
+	}
+
+out:
+	pthread_mutex_unlock(&cache.lock);
+	return res;
+}
+
+void arcan_img_cache_put(const struct arcan_img_key* key,
+	const uint32_t* buf, size_t w, size_t h, const struct arcan_img_meta* meta)
+{
+	size_t buf_sz = meta->compressed ? meta->c_size : w * h * sizeof(uint32_t);
+
+	pthread_mutex_lock(&cache.lock);
+	if (!buf_sz || buf_sz > cache.limit)
+		goto out;
+
+	struct cache_ent* ent = cache_find(key);
+	if (ent)
+		cache_drop(ent);
+
+	ent = arcan_alloc_mem(sizeof(struct cache_ent),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+	if (!ent)
+		goto out;
+
+	ent->buf = arcan_alloc_mem(buf_sz,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	ent->path = strdup(key->path);
+	if (!ent->buf || !ent->path){
+		arcan_mem_free(ent->buf);
+		free(ent->path);
+		arcan_mem_free(ent);
+		goto out;
+	}
+
+	memcpy(ent->buf, buf, buf_sz);
+	ent->buf_sz = buf_sz;
+	ent->mtime = key->mtime;
+	ent->size = key->size;
+	ent->vflip = key->vflip;
+	ent->w = w;
+	ent->h = h;
+	ent->meta = *meta;
+
+	cache_trim(cache.limit - buf_sz);
+	ent->next = cache.first;
+	if (cache.first)
+		cache.first->prev = ent;
+	else
+		cache.last = ent;
+	cache.first = ent;
+	cache.used += buf_sz;
+
+out:
+	pthread_mutex_unlock(&cache.lock);
 }
 
 void arcan_img_init()
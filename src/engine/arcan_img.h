@@ -12,6 +12,22 @@ struct arcan_img_meta {
 	bool mipmapped;
 	int pwidth, pheight;
 	size_t c_size;
+
+/* for compressed sources, enum agp_compressed_format and the number of
+ * mipmap levels stored back to back in the buffer (level 0 first) */
+	int cformat;
+	size_t levels;
+};
+
+/*
+ * identity of the source used for the decode cache, the file is
+ * considered changed if mtime or size (stat) differ
+ */
+struct arcan_img_key {
+	const char* path;
+	int64_t mtime;
+	uint64_t size;
+	bool vflip;
 };
 
 void arcan_img_init();
@@ -35,10 +51,44 @@ arcan_errc arcan_img_decode(const char* hint, char* inbuf, size_t inbuf_sz,
 arcan_errc arcan_img_outpng(FILE* dst,
 	av_pixel* inbuf, size_t inw, size_t inh, bool vflip);
 
+/*
+ * same as arcan_img_outpng, but trade size for encoding speed: a fixed row
+ * filter and the shortest match search. Safe to call from other threads.
+ */
+arcan_errc arcan_img_outpng_fast(FILE* dst,
+	av_pixel* inbuf, size_t inw, size_t inh, bool vflip);
+
+/*
+ * same as arcan_img_outpng, but encode as QOI (RGBA, sRGB).
+ */
+arcan_errc arcan_img_outqoi(FILE* dst,
+	av_pixel* inbuf, size_t inw, size_t inh, bool vflip);
+
 /*
  * make sure that inbuf is propery aligned
  * and matches the native engine color format.
  * returns NULL on failure but [inbuf] will always be freed (or re-used)
  */
 av_pixel* arcan_img_repack(uint32_t* inbuf, size_t inw, size_t inh);
+
+/*
+ * decode the first level of a block compressed [inbuf] (described by
+ * [meta]) into a new [w]x[h] RGBA buffer, for when the GPU lacks
+ * support for the format. Only DXT1/3/5, returns NULL otherwise.
+ */
+uint32_t* arcan_img_expand(const uint8_t* inbuf,
+	const struct arcan_img_meta* meta, size_t w, size_t h, bool vflip);
+
+/*
+ * Decoded image cache (thread-safe), disabled until a limit (bytes)
+ * is set. Lookups return a copy (arcan_alloc_mem, caller frees) of
+ * the buffer as it was returned from arcan_img_decode, or NULL.
+ */
+void arcan_img_cache_limit(size_t limit);
+
+uint32_t* arcan_img_cache_get(const struct arcan_img_key* key,
+	size_t* outw, size_t* outh, struct arcan_img_meta* meta);
+
+void arcan_img_cache_put(const struct arcan_img_key* key,
+	const uint32_t* buf, size_t w, size_t h, const struct arcan_img_meta* meta);
 #endif
@@ -12,6 +12,11 @@
  * to an existing named pipe will have the engine map that as an
  * external led controller that speaks the protocol mentioned in the
  * header.
+ *
+ * Updates are not sent as they arrive, they go into a per-controller
+ * shadow table and arcan_led_flush sends the changed LEDs as one write.
+ * The 'led_rate' config value (Hz) caps how often that happens, the
+ * default is whenever flush is called (once per frame from the engine).
  */
 #include <stdlib.h>
 #include <stdint.h>
@@ -64,9 +69,16 @@ struct led_controller {
 		int fd;
 	};
 
-/* some need a big table, others do fine with a simple bitmask */
+/* some need a big table (0x00RRGGBB shadow, [dirty] marks what has changed
+ * since the last flush), others do fine with a simple bitmask */
 	uint32_t table[256];
-	uint16_t ledmask;
+	uint64_t dirty[4];
+	uint32_t ledmask;
+
+/* [pending] if there is anything to flush, [hold] if the last update asked
+ * for it to be buffered until a non-buffered one arrives */
+	bool pending;
+	bool hold;
 
 /* for FIFOs, we may need to try open the path during writes */
 	char* path;
@@ -120,6 +132,50 @@ static struct led_controller controllers[MAX_LED_CONTROLLERS] = {0};
 static uint64_t ctrl_mask;
 static int n_controllers = 0;
 
+#ifndef LED_STANDALONE
+static uint64_t flush_interval;
+static uint64_t last_flush;
+#endif
+
+/* see arcan_led_probe, handles opened ahead of the next arcan_led_init */
+#ifdef USB_SUPPORT
+static hid_device* probed[sizeof(usb_tbl) / sizeof(usb_tbl[0])];
+#endif
+static bool probe_done;
+
+static void reset_shadow(struct led_controller* ctrl)
+{
+	memset(ctrl->table, '\0', sizeof(ctrl->table));
+	memset(ctrl->dirty, '\0', sizeof(ctrl->dirty));
+	ctrl->ledmask = 0;
+	ctrl->pending = false;
+	ctrl->hold = false;
+}
+
+static size_t shadow_count(struct led_controller* ctrl)
+{
+	if (ctrl->caps.nleds <= 0)
+		return 0;
+
+	return (size_t)ctrl->caps.nleds > COUNT_OF(ctrl->table) ?
+		COUNT_OF(ctrl->table) : (size_t)ctrl->caps.nleds;
+}
+
+static void shadow_set(struct led_controller* ctrl, size_t i, uint32_t val)
+{
+	if (ctrl->table[i] == val)
+		return;
+
+	ctrl->table[i] = val;
+	ctrl->dirty[i >> 6] |= (uint64_t)1 << (i & 63);
+	ctrl->pending = true;
+}
+
+static bool shadow_dirty(struct led_controller* ctrl, size_t i)
+{
+	return (ctrl->dirty[i >> 6] & ((uint64_t)1 << (i & 63))) != 0;
+}
+
 static int find_free_ind()
 {
 	for (size_t i = 0; i < MAX_LED_CONTROLLERS; i++)
@@ -149,11 +205,16 @@ static struct led_controller* find_devid(uint64_t devid)
 	return NULL;
 }
 
-static void forcecontroller(const struct usb_ent* ent)
+static void forcecontroller(const struct usb_ent* ent, void* handle)
 {
 	int ind = find_free_ind();
-	if (-1 == ind)
+	if (-1 == ind){
+#ifdef USB_SUPPORT
+		if (handle)
+			hid_close(handle);
+#endif
 		return;
+	}
 
 /* the USB standard doesn't mandate a serial number (facepalm)
  * and hidraw doesn't really have something akin to an instance id */
@@ -162,13 +223,19 @@ static void forcecontroller(const struct usb_ent* ent)
 		(uint64_t)(ent->vid & 0xffff) << 16) | ((uint64_t)ent->pid & 0xffff);
 /* other option would be to close and reopen the device as an attempt
  * to reset to a possibly safer state */
-	if (find_devid(devid))
+	if (find_devid(devid)){
+#ifdef USB_SUPPORT
+		if (handle)
+			hid_close(handle);
+#endif
 		return;
+	}
 
 #ifdef USB_SUPPORT
-	controllers[ind].handle = hid_open(ent->vid, ent->pid, NULL);
+	controllers[ind].handle = handle;
 	controllers[ind].type = ent->type;
 	controllers[ind].caps = ent->caps;
+	reset_shadow(&controllers[ind]);
 	if (controllers[ind].handle == NULL)
 		return;
 
@@ -197,8 +264,8 @@ int8_t arcan_led_register(int cmd_ch, int devref,
 	controllers[id].devid = id;
 	controllers[id].fd = cmd_ch;
 	controllers[id].type = ARCAN_LEDCTRL;
-	controllers[id].ledmask = 0;
 	controllers[id].caps = caps;
+	reset_shadow(&controllers[id]);
 	controllers[id].errc = 0;
 	controllers[id].no_close = false;
 
@@ -257,6 +324,7 @@ bool arcan_led_remove(uint8_t device)
 	ctrl_mask &= ~(1 << device);
 	n_controllers--;
 	leddev->handle = NULL;
+	reset_shadow(leddev);
 	arcan_led_removed(device);
 
 	return true;
@@ -321,10 +389,43 @@ void arcan_led_init()
 	}
 	else
 		free(kv);
+
+	uintptr_t tag;
+	char* val;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+	if (get_config("led_rate", 0, &val, tag) && val){
+		unsigned long rate = strtoul(val, NULL, 10);
+		flush_interval = rate ? 1000000 / rate : 0;
+		free(val);
+	}
+#endif
+
+/* use the results of a probe that ran ahead, later calls (hotplug) scan */
+	for (size_t i = 0; i < sizeof(usb_tbl) / sizeof(usb_tbl[0]); i++){
+		void* handle = NULL;
+#ifdef USB_SUPPORT
+		if (probe_done){
+			handle = probed[i];
+			probed[i] = NULL;
+		}
+		else
+			handle = hid_open(usb_tbl[i].vid, usb_tbl[i].pid, NULL);
+
+		if (!handle)
+			continue;
 #endif
+		forcecontroller(&usb_tbl[i], handle);
+	}
+	probe_done = false;
+}
 
+void arcan_led_probe()
+{
+#ifdef USB_SUPPORT
 	for (size_t i = 0; i < sizeof(usb_tbl) / sizeof(usb_tbl[0]); i++)
-		forcecontroller(&usb_tbl[i]);
+		probed[i] = hid_open(usb_tbl[i].vid, usb_tbl[i].pid, NULL);
+#endif
+	probe_done = true;
 }
 
 uint64_t arcan_led_controllers()
@@ -349,38 +450,44 @@ static void ultimarc_update(uint8_t device, struct led_controller* ctrl)
 
 int arcan_led_intensity(uint8_t device, int16_t led, uint8_t intensity)
 {
-	bool rv = false;
 	struct led_controller* leddev = get_device(device);
-	uint8_t di = led < 0 ? 255 : led;
 	if (!leddev)
 		return false;
 
-	if (di > leddev->caps.nleds-1 && di != 255)
+	size_t count = shadow_count(leddev);
+	if (led >= (int)count)
 		return false;
 
 	if (!leddev->caps.variable_brightness)
 		intensity = intensity > 0 ? 255 : 0;
 
 /* PROTOCOL INSERTION POINT */
-	switch (controllers[device].type) {
-	case ARCAN_LEDCTRL:
+	switch (leddev->type) {
+	case ARCAN_LEDCTRL:{
+		uint32_t val = ((uint32_t)intensity << 16) |
+			((uint32_t)intensity << 8) | intensity;
 		if (led < 0)
-			return write_leddev(leddev, device, (uint8_t[]){
-				'A', '\0', 'i', intensity, 'c', '\0'}, 6);
+			for (size_t i = 0; i < count; i++)
+				shadow_set(leddev, i, val);
 		else
-			return write_leddev(leddev, device, (uint8_t[]){
-				'a', (uint8_t)led, 'i', intensity, 'c', '\0'}, 6);
+			shadow_set(leddev, led, val);
+		leddev->hold = false;
+	}
 	break;
-	case PACDRIVE:
-		if (intensity)
-			leddev->ledmask |= 1 << led;
-		else
-			leddev->ledmask &= ~(1 << led);
-		ultimarc_update(device, leddev);
+	case PACDRIVE:{
+		uint32_t mask = led < 0 ?
+			(count >= 32 ? UINT32_MAX : ((uint32_t)1 << count) - 1) :
+			(uint32_t)1 << led;
+		uint32_t new = intensity ? leddev->ledmask | mask : leddev->ledmask & ~mask;
+		if (new != leddev->ledmask){
+			leddev->ledmask = new;
+			leddev->pending = true;
+		}
+	}
 	break;
 	default:
 		arcan_warning("Warning: arcan_led_intensity(), unknown LED / "
-			"unsupported mode for device type: %i\n", controllers[device].type);
+			"unsupported mode for device type: %i\n", leddev->type);
 		return false;
 	}
 
@@ -391,22 +498,19 @@ int arcan_led_rgb(uint8_t device,
 	int16_t led, uint8_t r, uint8_t g, uint8_t b, bool buffer)
 {
 	struct led_controller* leddev = get_device(device);
-	if (!leddev || !leddev->caps.rgb || led > (int)leddev->caps.nleds)
+	if (!leddev || !leddev->caps.rgb || led >= (int)shadow_count(leddev))
 		return -1;
 
 	switch (leddev->type){
 	case ARCAN_LEDCTRL:{
-		int v;
+		uint32_t val = ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
 		if (led < 0)
-			v = write_leddev(leddev, device, (uint8_t[]){'A', '\0'}, 2);
-		else
-			v = write_leddev(leddev, device, (uint8_t[]){'a', (uint8_t)led}, 2);
-
-		if (1 == v)
-			return write_leddev(leddev, device, (uint8_t[]){
-				'r', r, 'g', g, 'b', b, 'c', buffer ? 255 : 0}, 8);
+			for (size_t i = 0, count = shadow_count(leddev); i < count; i++)
+				shadow_set(leddev, i, val);
 		else
-			return v;
+			shadow_set(leddev, led, val);
+		leddev->hold = buffer;
+		return 1;
 	}
 	break;
 	default:
@@ -416,6 +520,114 @@ int arcan_led_rgb(uint8_t device,
 	}
 }
 
+ssize_t arcan_led_rgb_frame(uint8_t device,
+	size_t ofs, const uint8_t* rgb, size_t n)
+{
+	struct led_controller* leddev = get_device(device);
+	if (!leddev || !leddev->caps.rgb || leddev->type != ARCAN_LEDCTRL)
+		return -1;
+
+	size_t count = shadow_count(leddev);
+	if (ofs >= count)
+		return 0;
+
+	if (n > count - ofs)
+		n = count - ofs;
+
+	for (size_t i = 0; i < n; i++, rgb += 3)
+		shadow_set(leddev, ofs + i,
+			((uint32_t)rgb[0] << 16) | ((uint32_t)rgb[1] << 8) | rgb[2]);
+
+	leddev->hold = false;
+	return n;
+}
+
+/*
+ * One 'a' ind 'r' 'g' 'b' 'c' block per changed LED, all queued but the last
+ * which commits. When every LED changed to the same value it collapses into
+ * a single 'A' block. The worst case (256 LEDs) stays below PIPE_BUF so the
+ * non-blocking write either goes through in full or not at all, and in the
+ * latter case the dirty set is simply retried on the next flush.
+ */
+static void flush_ledctrl(uint8_t device, struct led_controller* ctrl)
+{
+	uint8_t buf[10 * COUNT_OF(ctrl->table)];
+	size_t count = shadow_count(ctrl);
+	size_t ofs = 0, ndirty = 0;
+	bool uniform = true;
+
+	for (size_t i = 0; i < count; i++){
+		if (!shadow_dirty(ctrl, i))
+			continue;
+
+		uint32_t val = ctrl->table[i];
+		uniform = uniform && val == ctrl->table[0];
+		ndirty++;
+
+		memcpy(&buf[ofs], (uint8_t[]){
+			'a', (uint8_t)i, 'r', (val >> 16) & 0xff, 'g', (val >> 8) & 0xff,
+			'b', val & 0xff, 'c', 255}, 10);
+		ofs += 10;
+	}
+
+	if (!ndirty){
+		ctrl->pending = false;
+		return;
+	}
+
+	if (uniform && ndirty == count){
+		uint32_t val = ctrl->table[0];
+		memcpy(buf, (uint8_t[]){
+			'A', '\0', 'r', (val >> 16) & 0xff, 'g', (val >> 8) & 0xff,
+			'b', val & 0xff, 'c', 255}, 10);
+		ofs = 10;
+	}
+
+	buf[ofs-1] = 0;
+	if (1 == write_leddev(ctrl, device, buf, ofs)){
+		memset(ctrl->dirty, '\0', sizeof(ctrl->dirty));
+		ctrl->pending = false;
+	}
+}
+
+static void flush_device(uint8_t device, struct led_controller* ctrl)
+{
+/* PROTOCOL INSERTION POINT */
+	switch (ctrl->type){
+	case ARCAN_LEDCTRL:
+		flush_ledctrl(device, ctrl);
+	break;
+	case PACDRIVE:
+		ctrl->pending = false;
+		ultimarc_update(device, ctrl);
+	break;
+	}
+}
+
+void arcan_led_flush()
+{
+	if (!ctrl_mask)
+		return;
+
+#ifndef LED_STANDALONE
+	if (flush_interval){
+		uint64_t now = arcan_timemicros();
+		if (now - last_flush < flush_interval)
+			return;
+		last_flush = now;
+	}
+#endif
+
+	for (size_t i = 0; i < MAX_LED_CONTROLLERS; i++){
+		if (!(ctrl_mask & ((uint64_t)1 << i)))
+			continue;
+
+		struct led_controller* ctrl = &controllers[i];
+		if (ctrl->pending && !ctrl->hold)
+			flush_device(i, ctrl);
+	}
+}
+
 struct led_capabilities arcan_led_capabilities(uint8_t device)
 {
 	struct led_capabilities rv = {0};
@@ -427,6 +639,11 @@ struct led_capabilities arcan_led_capabilities(uint8_t device)
 
 void arcan_led_shutdown()
 {
+/* the last state should still reach the devices, buffered or not */
+	for (size_t i = 0; i < MAX_LED_CONTROLLERS; i++)
+		if ((ctrl_mask & ((uint64_t)1 << i)) && controllers[i].pending)
+			flush_device(i, &controllers[i]);
+
 	for (int i = 0; i < MAX_LED_CONTROLLERS && n_controllers > 0; i++)
 		if ((ctrl_mask & (1 << i)) > 0){
 			n_controllers--;
@@ -32,6 +32,13 @@ struct led_capabilities {
  * LED types there should be handled dynamically */
 void arcan_led_init();
 
+/*
+ * Open the USB controllers the next arcan_led_init would scan for ahead of
+ * time. This does not touch the controller table and can run on a helper
+ * thread during startup, though not at the same time as arcan_led_init.
+ */
+void arcan_led_probe();
+
 /*
  * Query if there's support for a specific usb device
  */
@@ -53,10 +60,21 @@ int arcan_led_intensity(uint8_t device, int16_t led, uint8_t intensity);
 
 /* Set a specific led to a specific rgb, if buffer is set the actual changes
  * should be deferred until a non-buffered update is set. For large numbers of
- * LEDs, this saves bandwidth with devices that require header/footer */
+ * LEDs, this saves bandwidth with devices that require header/footer.
+ * The change is only queued, it reaches the device on the next flush. */
 int arcan_led_rgb(uint8_t device,
 	int16_t led, uint8_t, uint8_t g, uint8_t b, bool buffer);
 
+/* Set [n] consecutive leds starting at [ofs] from packed r,g,b triplets in
+ * [rgb]. Returns the number of leds set (clamped to the controller) or -1 if
+ * the device does not exist or lacks the rgb capability. */
+ssize_t arcan_led_rgb_frame(uint8_t device,
+	size_t ofs, const uint8_t* rgb, size_t n);
+
+/* Send the changes queued since the last flush, one bulk write per device.
+ * Expected to be called once per frame, subject to the 'led_rate' limit. */
+void arcan_led_flush();
+
 /* Used internally by the platform- layers for handling additional devices,
  * uses a simple pipe- protocol for updating. Initial state is always clear.
  * Returns device ID or -1 on failure.
@@ -55,6 +55,8 @@
 #include "alt/support.h"
 #include "alt/nbio.h"
 #include "alt/trace.h"
+#include "alt/ffi.h"
+#include "alt/bcache.h"
 
 /*
  * tradeoff (extra branch + loss in precision vs. assymetry and UB)
@@ -422,15 +424,17 @@ void arcan_lua_cbdrop()
 {
 	for (size_t i = 0; i <= vcontext_ind; i++){
 		struct arcan_video_context* ctx = &vcontext_stack[i];
-		for (size_t j = 0; j < ctx->vitem_limit; j++)
-			if (FL_TEST(&ctx->vitems_pool[j], FL_INUSE) &&
-				ctx->vitems_pool[j].feed.state.tag == ARCAN_TAG_FRAMESERV){
-				arcan_frameserver* fsrv = ctx->vitems_pool[j].feed.state.ptr;
+		for (size_t j = 1; j < ctx->vitem_top; j++){
+			arcan_vobject* vobj = arcan_vint_vitem(ctx, j);
+			if (FL_TEST(vobj, FL_INUSE) &&
+				vobj->feed.state.tag == ARCAN_TAG_FRAMESERV){
+				arcan_frameserver* fsrv = vobj->feed.state.ptr;
 				if (!fsrv)
 					continue;
 
 				fsrv->tag = LUA_NOREF;
 			}
+		}
 	}
 }
 
@@ -556,23 +560,10 @@ static char* findresource(
 
 static int alua_doresolve(lua_State* ctx, const char* inp)
 {
-	data_source source = arcan_open_resource(inp);
-	if (source.fd == BADFD)
-		return -1;
-
-	map_region map = arcan_map_resource(&source, false);
-	if (!map.ptr){
-		arcan_release_resource(&source);
-		return -1;
-	}
-
-	int rv = luaL_loadbuffer(ctx, map.ptr, map.sz, inp);
+	int rv = alt_bcache_load(ctx, inp, inp);
 	if (0 == rv)
 		rv = lua_pcall(ctx, 0, LUA_MULTRET, 0);
 
-	arcan_release_map(map);
-	arcan_release_resource(&source);
-
 	return rv;
 }
 
@@ -612,6 +603,27 @@ void arcan_lua_tick(lua_State* ctx, size_t nticks, size_t global)
 	alt_trace_finish(ctx);
 }
 
+struct gcstep {
+	int kb;
+	bool done;
+};
+
+static int gcstep_protected(lua_State* ctx)
+{
+	struct gcstep* step = lua_touserdata(ctx, 1);
+	step->done = lua_gc(ctx, LUA_GCSTEP, step->kb) == 1;
+	return 0;
+}
+
+/* the step may run finalizers, so it is protected like any other call */
+bool arcan_lua_gcstep(lua_State* ctx, size_t kb)
+{
+	struct gcstep step = {.kb = kb};
+	if (0 != lua_cpcall(ctx, gcstep_protected, &step))
+		lua_pop(ctx, 1);
+	return step.done;
+}
+
 char* arcan_lua_main(lua_State* ctx, const char* inp, bool file)
 {
 	bool fail = false;
@@ -1058,6 +1070,14 @@ static int debugstall(lua_State* ctx)
 	LUA_ETRACE("frameserver_debugstall", NULL, 0);
 }
 
+static int fsrvplacement(lua_State* ctx)
+{
+	LUA_TRACE("frameserver_placement");
+	const char* name = luaL_optstring(ctx, 1, NULL);
+	lua_pushboolean(ctx, platform_launch_class(name));
+	LUA_ETRACE("frameserver_placement", NULL, 1);
+}
+
 static int loadimage(lua_State* ctx)
 {
 	LUA_TRACE("load_image");
@@ -1343,6 +1363,68 @@ static int resampleimage(lua_State* ctx)
 	LUA_ETRACE("resample_image", NULL, 0);
 }
 
+static int resamplebatch(lua_State* ctx)
+{
+	LUA_TRACE("resample_batch");
+	luaL_checktype(ctx, 1, LUA_TTABLE);
+	agp_shader_id shid = lua_type(ctx, 2) == LUA_TSTRING ?
+	agp_shader_lookup(luaL_checkstring(ctx, 2)) : luaL_checknumber(ctx, 2);
+	bool separate = luaL_optbnumber(ctx, 3, false);
+
+	size_t nelems = lua_rawlen(ctx, 1);
+	if (!nelems)
+		arcan_fatal("resample_batch(), empty job table\n");
+
+	struct arcan_resample_job* jobs = arcan_alloc_mem(
+		sizeof(struct arcan_resample_job) * nelems,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+
+/* each job is an indexed {vid, width, height} table */
+	for (size_t i = 0; i < nelems; i++){
+		lua_rawgeti(ctx, 1, i+1);
+		if (lua_type(ctx, -1) != LUA_TTABLE)
+			arcan_fatal("resample_batch(), job %zu: expected {vid, w, h}\n", i+1);
+
+		lua_rawgeti(ctx, -1, 1);
+		jobs[i].src = luaL_checkvid(ctx, -1, NULL);
+		lua_rawgeti(ctx, -2, 2);
+		jobs[i].w = abs((int)luaL_checknumber(ctx, -1));
+		lua_rawgeti(ctx, -3, 3);
+		jobs[i].h = abs((int)luaL_checknumber(ctx, -1));
+		lua_pop(ctx, 4);
+
+		if (jobs[i].w == 0 || jobs[i].w > MAX_SURFACEW ||
+			jobs[i].h == 0 || jobs[i].h > MAX_SURFACEH)
+			arcan_fatal("resample_batch(), job %zu: illegal dimensions"
+				" requested (%zu:%d x %zu:%d)\n",
+				i+1, jobs[i].w, MAX_SURFACEW, jobs[i].h, MAX_SURFACEH);
+	}
+
+	intptr_t ref = 0;
+	if (lua_isfunction(ctx, 4) && !lua_iscfunction(ctx, 4)){
+		lua_pushvalue(ctx, 4);
+		ref = luaL_ref(ctx, LUA_REGISTRYINDEX);
+	}
+
+	if (ARCAN_OK != arcan_video_resamplebatch(jobs, nelems, shid, separate, ref)){
+		if (ref)
+			luaL_unref(ctx, LUA_REGISTRYINDEX, ref);
+		arcan_mem_free(jobs);
+		lua_pushnil(ctx);
+		LUA_ETRACE("resample_batch", "couldn't process batch", 1);
+	}
+
+	lua_createtable(ctx, nelems, 0);
+	for (size_t i = 0; i < nelems; i++){
+		lua_pushvid(ctx, jobs[i].out);
+		lua_rawseti(ctx, -2, i+1);
+		trace_allocation(ctx, "resample_batch", jobs[i].out);
+	}
+
+	arcan_mem_free(jobs);
+	LUA_ETRACE("resample_batch", NULL, 1);
+}
+
 static int imageresizestorage(lua_State* ctx)
 {
 	LUA_TRACE("image_resize_storage");
@@ -1651,6 +1733,76 @@ static int imageopacity(lua_State* ctx)
 	LUA_ETRACE("blend_image", NULL, 0);
 }
 
+/*
+ * shared by the _image_batch functions, argument 1 is an interleaved array
+ * of vid followed by one (blend) or two (move, resize) values per vid
+ */
+static size_t transformbatch(lua_State* ctx,
+	enum arcan_batch_transform kind, const char* caller)
+{
+	luaL_checktype(ctx, 1, LUA_TTABLE);
+	int time = luaL_optint(ctx, 2, 0);
+	int interp = luaL_optint(ctx, 3, -1);
+	if (time < 0) time = 0;
+
+	size_t nv = kind == ARCAN_BATCH_BLEND ? 1 : 2;
+	size_t nelems = lua_rawlen(ctx, 1);
+	if (nelems % (nv + 1) != 0)
+		arcan_fatal("%s(), buffer length (%zu) is not a multiple of %zu\n",
+			caller, nelems, nv + 1);
+
+	size_t n = nelems / (nv + 1);
+	if (!n)
+		return 0;
+
+	arcan_vobj_id* ids = arcan_alloc_mem(
+		n * (sizeof(arcan_vobj_id) + nv * sizeof(float)),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_FRAME, ARCAN_MEMALIGN_NATURAL);
+	float* vals = (float*) &ids[n];
+
+	for (size_t i = 0, ind = 1; i < n; i++){
+		for (size_t j = 0; j <= nv; j++, ind++){
+			lua_rawgeti(ctx, 1, ind);
+			if (lua_type(ctx, -1) != LUA_TNUMBER)
+				arcan_fatal("%s(), invalid buffer entry (%zu), number expected\n",
+					caller, ind);
+
+			if (j == 0)
+				ids[i] = luavid_tovid(lua_tonumber(ctx, -1));
+			else
+				vals[i * nv + j - 1] = lua_tonumber(ctx, -1);
+			lua_pop(ctx, 1);
+		}
+	}
+
+	size_t count = arcan_video_transform_batch(kind, ids, vals, n, time, interp);
+	arcan_mem_free(ids);
+	return count;
+}
+
+static int moveimagebatch(lua_State* ctx)
+{
+	LUA_TRACE("move_image_batch");
+	lua_pushnumber(ctx, transformbatch(ctx, ARCAN_BATCH_MOVE, "move_image_batch"));
+	LUA_ETRACE("move_image_batch", NULL, 1);
+}
+
+static int resizeimagebatch(lua_State* ctx)
+{
+	LUA_TRACE("resize_image_batch");
+	lua_pushnumber(ctx,
+		transformbatch(ctx, ARCAN_BATCH_RESIZE, "resize_image_batch"));
+	LUA_ETRACE("resize_image_batch", NULL, 1);
+}
+
+static int blendimagebatch(lua_State* ctx)
+{
+	LUA_TRACE("blend_image_batch");
+	lua_pushnumber(ctx,
+		transformbatch(ctx, ARCAN_BATCH_BLEND, "blend_image_batch"));
+	LUA_ETRACE("blend_image_batch", NULL, 1);
+}
+
 static int showimage(lua_State* ctx)
 {
 	LUA_TRACE("show_image");
@@ -2753,7 +2905,11 @@ static int systemload(lua_State* ctx)
 	int res = 0;
 
 	if (fname){
-		int rv = luaL_loadfile(ctx, fname);
+		size_t len = strlen(fname) + 2;
+		char chunkname[len];
+		snprintf(chunkname, len, "@%s", fname);
+
+		int rv = alt_bcache_load(ctx, fname, chunkname);
 		if (rv == 0)
 			res = 1;
 		else if (dieonfail)
@@ -3152,6 +3308,39 @@ static int led_rgb(lua_State* ctx)
 	LUA_ETRACE("set_led_rgb", NULL, 1);
 }
 
+static int led_frame(lua_State* ctx)
+{
+	LUA_TRACE("set_led_frame");
+
+	uint8_t id = luaL_checkint(ctx, 1);
+	size_t ofs = luaL_optint(ctx, 3, 0);
+	ssize_t rv;
+
+/* a string is taken as packed r,g,b bytes, a table as a flat r,g,b,... list */
+	if (lua_type(ctx, 2) == LUA_TSTRING){
+		size_t len;
+		const char* buf = lua_tolstring(ctx, 2, &len);
+		rv = arcan_led_rgb_frame(id, ofs, (const uint8_t*) buf, len / 3);
+	}
+	else {
+		luaL_checktype(ctx, 2, LUA_TTABLE);
+		uint8_t buf[256 * 3];
+		size_t n = lua_rawlen(ctx, 2) / 3;
+		if (n > 256)
+			n = 256;
+
+		for (size_t i = 0; i < n * 3; i++){
+			lua_rawgeti(ctx, 2, i+1);
+			buf[i] = lua_tointeger(ctx, -1);
+			lua_pop(ctx, 1);
+		}
+		rv = arcan_led_rgb_frame(id, ofs, buf, n);
+	}
+
+	lua_pushnumber(ctx, rv);
+	LUA_ETRACE("set_led_frame", NULL, 1);
+}
+
 static int setled(lua_State* ctx)
 {
 	LUA_TRACE("set_led");
@@ -3224,6 +3413,43 @@ static int contextusage(lua_State* ctx)
 	LUA_ETRACE("current_context_usage", NULL, 2);
 }
 
+static int videoresidency(lua_State* ctx)
+{
+	LUA_TRACE("video_residency");
+
+	ssize_t budget = -1;
+	if (lua_type(ctx, 1) == LUA_TNUMBER){
+		lua_Number mb = lua_tonumber(ctx, 1);
+		budget = mb > 0 ? (ssize_t)(mb * 1024.0 * 1024.0) : 0;
+	}
+
+	size_t evictions, restores;
+	arcan_video_vstore_budget(budget, &evictions, &restores);
+	size_t cur = arcan_video_vstore_budget(-1, NULL, NULL);
+
+	lua_newtable(ctx);
+	int top = lua_gettop(ctx);
+	tblnum(ctx, "budget", cur, top);
+	tblnum(ctx, "evictions", evictions, top);
+	tblnum(ctx, "restores", restores, top);
+
+/* one entry per context in the stack, starting with the current one */
+	struct arcan_video_usage use;
+	for (unsigned i = 0; arcan_video_contextusage_at(i, &use); i++){
+		lua_pushnumber(ctx, i + 1);
+		lua_newtable(ctx);
+		int ent = lua_gettop(ctx);
+		tblnum(ctx, "objects", use.vobjects, ent);
+		tblnum(ctx, "gpu", use.store_gpu, ent);
+		tblnum(ctx, "cpu", use.store_cpu, ent);
+		tblnum(ctx, "resident", use.store_resident, ent);
+		tblnum(ctx, "evicted", use.store_evicted, ent);
+		lua_rawset(ctx, top);
+	}
+
+	LUA_ETRACE("video_residency", NULL, 1);
+}
+
 static void get_utf8(const char* instr, uint8_t dst[5])
 {
 	if (!instr){
@@ -4526,6 +4752,7 @@ bool arcan_lua_pushevent(lua_State* ctx, arcan_event* ev)
 			tblnum(ctx, "frameno", ev->ext.streamstat.frameno, top);
 			tblnum(ctx,"streaming",
 				ev->ext.streamstat.streaming!=0,top);
+			tblnum(ctx, "identifier", ev->ext.streamstat.identifier, top);
 		break;
 /* special semantics for segreq */
 		case EVENT_EXTERNAL_SEGREQ:
@@ -4763,6 +4990,13 @@ bool arcan_lua_pushevent(lua_State* ctx, arcan_event* ev)
 			tblnum(ctx, "width", ev->fsrv.width, top);
 			tblnum(ctx, "height", ev->fsrv.height, top);
 		break;
+		case EVENT_FSRV_MESH:
+			tblstr(ctx, "kind", "mesh", top);
+			tblnum(ctx, "vertices", ev->fsrv.width, top);
+			tblnum(ctx, "indices", ev->fsrv.height, top);
+			tblnum(ctx, "lods", ev->fsrv.counter, top);
+			tblnum(ctx, "id", ev->fsrv.pts, top);
+		break;
 		case EVENT_FSRV_IONESTED:
 			tblstr(ctx, "kind", "input", top);
 			tblnum(ctx, "tgtid", ev->fsrv.input.dst, top);
@@ -4834,6 +5068,7 @@ bool arcan_lua_pushevent(lua_State* ctx, arcan_event* ev)
 		lua_newtable(ctx);
 		int top = lua_gettop(ctx);
 		int source = CB_SOURCE_NONE;
+		bool oneshot = false;
 
 		switch (ev->vid.kind){
 		case EVENT_VIDEO_EXPIRE :
@@ -4865,6 +5100,15 @@ bool arcan_lua_pushevent(lua_State* ctx, arcan_event* ev)
 			tblnum(ctx, "height", ev->vid.height, top);
 		break;
 
+		case EVENT_VIDEO_RESAMPLE_COMPLETE:
+			evmsg = "video_event(resample_complete), callback";
+			source = CB_SOURCE_IMAGE;
+			oneshot = true;
+			tblstr(ctx, "kind", "resampled", top);
+			tblnum(ctx, "width", ev->vid.width, top);
+			tblnum(ctx, "height", ev->vid.height, top);
+		break;
+
 		default:
 			arcan_warning("Engine -> Script Warning: arcan_lua_pushevent(),"
 			"	unknown video event (%i)\n", ev->vid.kind);
@@ -4878,6 +5122,9 @@ bool arcan_lua_pushevent(lua_State* ctx, arcan_event* ev)
 		else
 			lua_settop(ctx, 0);
 
+		if (oneshot)
+			luaL_unref(ctx, LUA_REGISTRYINDEX, dst_cb);
+
 		if (adopt_check){
 			if (luactx.pending_socket_label){
 				arcan_mem_free(luactx.pending_socket_label);
@@ -5449,6 +5696,33 @@ fail:
 	LUA_ETRACE("add_3dmesh_rawmesh", NULL, 1);
 }
 
+/* claim the latest packed mesh from a frameserver, the frameserver vid is used
+ * as the tag so that later refinements replace the earlier geometry */
+static int fsrvmesh(lua_State* ctx, arcan_vobj_id did, int nmaps)
+{
+	arcan_vobject* vobj;
+	arcan_vobj_id sid = luaL_checkvid(ctx, 2, &vobj);
+	int lod = luaL_optnumber(ctx, 4, -1);
+
+	if (vobj->feed.state.tag != ARCAN_TAG_FRAMESERV || !vobj->feed.state.ptr)
+		arcan_fatal("add_3dmesh(), source vid (arg 2) not "
+			"associated with a frameserver.");
+
+	arcan_frameserver* fsrv = vobj->feed.state.ptr;
+	if (!fsrv->desc.mesh.buf){
+		lua_pushboolean(ctx, false);
+		LUA_ETRACE("add_3dmesh", "no mesh", 1);
+	}
+
+	uint8_t* buf = fsrv->desc.mesh.buf;
+	size_t buf_sz = fsrv->desc.mesh.buf_sz;
+	fsrv->desc.mesh.buf = NULL;
+
+	lua_pushboolean(ctx, ARCAN_OK ==
+		arcan_3d_addpacked(did, buf, buf_sz, nmaps, lod, (uintptr_t) sid));
+	LUA_ETRACE("add_3dmesh", NULL, 1);
+}
+
 static int loadmesh(lua_State* ctx)
 {
 	LUA_TRACE("add_3dmesh");
@@ -5457,6 +5731,8 @@ static int loadmesh(lua_State* ctx)
 	int nmaps = abs((int)luaL_optnumber(ctx, 3, 1));
 	if (lua_type(ctx, 2) == LUA_TTABLE)
 		return rawmesh(ctx, did, nmaps);
+	if (lua_type(ctx, 2) == LUA_TNUMBER)
+		return fsrvmesh(ctx, did, nmaps);
 	if (lua_type(ctx, 2) != LUA_TSTRING)
 		arcan_fatal("add_3dmesh(), invalid resource type");
 
@@ -5469,10 +5745,10 @@ static int loadmesh(lua_State* ctx)
 			arcan_warning("loadmesh(%s) -- "
 				"Couldn't add mesh to (%d)\n", path, did);
 		arcan_release_resource(&indata);
-		lua_pushboolean(ctx, false);
+		lua_pushboolean(ctx, rv == ARCAN_OK);
 	}
 	else
-		lua_pushboolean(ctx, true);
+		lua_pushboolean(ctx, false);
 	arcan_mem_free(path);
 
 	LUA_ETRACE("add_3dmesh", NULL, 1);
@@ -5569,14 +5845,69 @@ static int pointcloud(lua_State* ctx)
 	LUA_TRACE("build_pointcloud");
 	float count = luaL_checknumber(ctx, 1);
 	int nmaps = abs((int)luaL_optnumber(ctx, 2, 1));
+	size_t width = abs((int)luaL_optnumber(ctx, 3, 0));
 
-	arcan_vobj_id id = arcan_3d_pointcloud(count, nmaps);
+	arcan_vobj_id id = arcan_3d_pointcloud(count, nmaps, width);
 	lua_pushvid(ctx, id);
 	trace_allocation(ctx, "build_pointcloud", id);
 
 	LUA_ETRACE("build_pointcloud", NULL, 1);
 }
 
+/* flat number table at [ind] into [n_per] float tuples, NULL if nil */
+static float* pointtbl(lua_State* ctx, int ind, size_t n_per, size_t* count)
+{
+	if (lua_type(ctx, ind) == LUA_TNIL || lua_type(ctx, ind) == LUA_TNONE)
+		return NULL;
+
+	luaL_checktype(ctx, ind, LUA_TTABLE);
+	size_t nelems = lua_rawlen(ctx, ind);
+	if (nelems % n_per)
+		arcan_fatal("pointcloud_update(), table at %d: "
+			"%zu values is not a multiple of %zu\n", ind, nelems, n_per);
+
+	if (!nelems)
+		return NULL;
+
+	float* buf = arcan_alloc_mem(sizeof(float) * nelems,
+		ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
+
+	for (size_t i = 0; i < nelems; i++){
+		lua_rawgeti(ctx, ind, i+1);
+		buf[i] = lua_tonumber(ctx, -1);
+		lua_pop(ctx, 1);
+	}
+
+	*count = nelems / n_per;
+	return buf;
+}
+
+static int pointcloudupdate(lua_State* ctx)
+{
+	LUA_TRACE("pointcloud_update");
+	arcan_vobj_id id = luaL_checkvid(ctx, 1, NULL);
+	int ofs = luaL_checknumber(ctx, 2);
+	if (ofs < 1)
+		arcan_fatal("pointcloud_update(), invalid start point (%d < 1)\n", ofs);
+
+	size_t n_pos = 0, n_col = 0;
+	float* pos = pointtbl(ctx, 3, 3, &n_pos);
+	float* col = pointtbl(ctx, 4, 4, &n_col);
+
+	arcan_errc rv = ARCAN_OK;
+	if (pos)
+		rv = arcan_3d_pointcloud_update(id, ofs - 1, n_pos, pos, NULL);
+
+	if (col && rv == ARCAN_OK)
+		rv = arcan_3d_pointcloud_update(id, ofs - 1, n_col, NULL, col);
+
+	arcan_mem_free(pos);
+	arcan_mem_free(col);
+
+	lua_pushboolean(ctx, rv == ARCAN_OK);
+	LUA_ETRACE("pointcloud_update", NULL, 1);
+}
+
 static int buildcylinder(lua_State* ctx)
 {
 	LUA_TRACE("build_cylinder");
@@ -5650,6 +5981,14 @@ static int camtag(lua_State* ctx)
 		LUA_ETRACE("camtag_model", NULL, 1);
 	}
 
+/* third form pairs the camera with a second eye drawn in the same pass */
+	if (lua_type(ctx, 3) == LUA_TSTRING &&
+		strcmp(lua_tostring(ctx, 3), "stereo") == 0){
+		arcan_vobj_id eye = luavid_tovid(luaL_optnumber(ctx, 2, ARCAN_EID));
+		lua_pushboolean(ctx, arcan_3d_camstereo(id, eye) == ARCAN_OK);
+		LUA_ETRACE("camtag_model", NULL, 1);
+	}
+
 	struct monitor_mode mode = platform_video_dimensions();
 	float w = mode.width;
 	float h = mode.height;
@@ -5991,6 +6330,87 @@ static int getkeys(lua_State* ctx)
 	LUA_ETRACE("get_keys", NULL, rv);
 }
 
+/*
+ * upvalues: prefix, domain, id, page size, current page (key, val, ...),
+ * position in the page and the last key returned
+ */
+static int keyiter(lua_State* ctx)
+{
+	int pos = lua_tointeger(ctx, lua_upvalueindex(6));
+	lua_rawgeti(ctx, lua_upvalueindex(5), pos + 1);
+
+	if (lua_isnil(ctx, -1)){
+		lua_pop(ctx, 1);
+		struct arcan_strarr res = arcan_db_prefixkeys(DBHANDLE,
+			lua_tointeger(ctx, lua_upvalueindex(2)),
+			lua_tointeger(ctx, lua_upvalueindex(3)),
+			lua_tostring(ctx, lua_upvalueindex(1)),
+			lua_tostring(ctx, lua_upvalueindex(7)),
+			lua_tointeger(ctx, lua_upvalueindex(4))
+		);
+
+		if (!res.count){
+			arcan_mem_freearr(&res);
+			return 0;
+		}
+
+		lua_createtable(ctx, res.count, 0);
+		for (size_t i = 0; i < res.count; i++){
+			lua_pushstring(ctx, res.data[i]);
+			lua_rawseti(ctx, -2, i + 1);
+		}
+		arcan_mem_freearr(&res);
+
+		lua_replace(ctx, lua_upvalueindex(5));
+		pos = 0;
+		lua_rawgeti(ctx, lua_upvalueindex(5), 1);
+	}
+
+	lua_pushvalue(ctx, -1);
+	lua_replace(ctx, lua_upvalueindex(7));
+	lua_rawgeti(ctx, lua_upvalueindex(5), pos + 2);
+
+	lua_pushinteger(ctx, pos + 2);
+	lua_replace(ctx, lua_upvalueindex(6));
+
+	return 2;
+}
+
+static int listkeys(lua_State* ctx)
+{
+	LUA_TRACE("list_keys");
+
+	const char* prefix = luaL_checkstring(ctx, 1);
+	size_t pagesz = luaL_optnumber(ctx, 2, 256);
+	const char* opt_target = luaL_optstring(ctx, 3, NULL);
+	const char* opt_config = luaL_optstring(ctx, 4, NULL);
+
+	int domain = DVT_APPL;
+	int64_t id = 0;
+
+	if (opt_target){
+		arcan_targetid tid = arcan_db_targetid(DBHANDLE, opt_target, NULL);
+		domain = DVT_TARGET;
+		id = tid;
+
+		if (opt_config){
+			domain = DVT_CONFIG;
+			id = arcan_db_configid(DBHANDLE, tid, opt_config);
+		}
+	}
+
+	lua_pushstring(ctx, prefix);
+	lua_pushinteger(ctx, domain);
+	lua_pushinteger(ctx, id);
+	lua_pushinteger(ctx, pagesz ? pagesz : 256);
+	lua_newtable(ctx);
+	lua_pushinteger(ctx, 0);
+	lua_pushnil(ctx);
+	lua_pushcclosure(ctx, keyiter, 7);
+
+	LUA_ETRACE("list_keys", NULL, 1);
+}
+
 static int getkey(lua_State* ctx)
 {
 	LUA_TRACE("get_key");
@@ -6018,7 +6438,12 @@ static int getkey(lua_State* ctx)
 			free(val);
 		}
 		else{
-			arcan_db_getvalue(DBHANDLE, DVT_TARGET, tid, key);
+			char* val = arcan_db_getvalue(DBHANDLE, DVT_TARGET, tid, key);
+			if (val)
+				lua_pushstring(ctx, val);
+			else
+				lua_pushnil(ctx);
+			free(val);
 		}
 	}
 	else {
@@ -6225,7 +6650,7 @@ static int videodispgamma(lua_State* ctx)
 		}
 
 		uint16_t* ramps = arcan_alloc_mem(values * sizeof(uint16_t),
-			ARCAN_MEM_VSTRUCT, ARCAN_MEM_TEMPORARY | ARCAN_MEM_BZERO,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_FRAME | ARCAN_MEM_BZERO,
 			ARCAN_MEMALIGN_NATURAL
 		);
 
@@ -6723,6 +7148,8 @@ static int imagecolor(lua_State* ctx)
 			agp_rendertarget_clearcolor(rtgt->art,
 				(float)cred / 255.0f, (float)cgrn / 255.0f,
 				(float)cblu / 255.0f, (float)alpha / 255.0f);
+/* not visible to the damage tracking, force a full pass */
+			rtgt->damage.sig = 0;
 			lua_pushboolean(ctx, true);
 			LUA_ETRACE("image_color", NULL, 1);
 		}
@@ -7016,6 +7443,7 @@ static int warning(lua_State* ctx)
 void arcan_lua_shutdown(lua_State* ctx)
 {
 	TRACE_MARK_ONESHOT("scripting", "shutdown", TRACE_SYS_DEFAULT, 0, 0, "");
+	alt_trace_profile(ctx, 0, 0);
 	arcan_trace_setbuffer(NULL, 0, NULL);
 	alt_trace_finish(ctx);
 	alt_nbio_release();
@@ -7053,6 +7481,9 @@ static void error_hook(lua_State* ctx, lua_Debug* ar)
 static void sig_watchdog(int sig, siginfo_t* info, void* unused)
 {
 	if (getppid() == info->si_pid){
+/* the phase breakdown tells script stalls apart from GPU / display ones */
+		arcan_conductor_phase_dump(STDERR_FILENO);
+
 /* set a hook that we can use to then invoke our error handler path */
 		lua_sethook(luactx.last_ctx, luactx.error_hook, LUA_MASKCOUNT, 1);
 	}
@@ -7691,6 +8122,32 @@ static void* pthr_waiter(void* src)
 	return NULL;
 }
 
+/* the layouts the planes can scan out, for clients that allocate their own
+ * buffers (waybridge feedback) to pick one that can go on a plane as is */
+static void push_scanout_formats(arcan_frameserver* fsrv)
+{
+	uint32_t formats[32];
+	uint64_t modifiers[32];
+	size_t n = platform_video_scanout_formats(formats, modifiers, COUNT_OF(formats));
+
+	platform_fsrv_pushevent(fsrv, &(struct arcan_event){
+		.category = EVENT_TARGET,
+		.tgt.kind = TARGET_COMMAND_DEVICESTATE,
+		.tgt.ioevs[0].iv = 2
+	});
+
+	for (size_t i = 0; i < n; i++){
+		platform_fsrv_pushevent(fsrv, &(struct arcan_event){
+			.category = EVENT_TARGET,
+			.tgt.kind = TARGET_COMMAND_DEVICESTATE,
+			.tgt.ioevs[0].iv = 3,
+			.tgt.ioevs[1].uiv = modifiers[i] >> 32,
+			.tgt.ioevs[2].uiv = modifiers[i] & 0xffffffff,
+			.tgt.ioevs[4].uiv = formats[i]
+		});
+	}
+}
+
 static int targetdevhint(lua_State* ctx)
 {
 	LUA_TRACE("target_devicehint");
@@ -7745,6 +8202,7 @@ static int targetdevhint(lua_State* ctx)
 			memcpy(ev.tgt.message, buf, buf_sz);
 			arcan_mem_free(buf);
 			platform_fsrv_pushfd(fsrv, &ev, fd);
+			push_scanout_formats(fsrv);
 		}
 	}
 /* string reference, switch render-node */
@@ -8487,10 +8945,9 @@ static int targetstepframe(lua_State* ctx)
 		fsrv->desc.region_valid = true;
 	}
 
-/* cascade / repeat call protection, only request read if we aren't in that
- * state already - this is for the asynch behavior */
-	if (!FL_TEST(rtgt, TGTFL_READING)){
-		agp_request_readback(rtgt->color->vstore);
+/* cascade / repeat call protection, the request is refused if every slot in
+ * the readback ring is already in flight - this is for the asynch behavior */
+	if (agp_request_readback(rtgt->color->vstore)){
 		FL_SET(rtgt, TGTFL_READING);
 		rtgt->transfc++;
 		lua_pushboolean(ctx, true);
@@ -10597,6 +11054,23 @@ static int benchtracedata(lua_State* ctx)
 	LUA_ETRACE("benchmark_tracedata", NULL, 0);
 }
 
+static int benchprofile(lua_State* ctx)
+{
+	LUA_TRACE("benchmark_profile");
+	int interval = luaL_checknumber(ctx, 1);
+	int depth = luaL_optnumber(ctx, 2, 16);
+
+	if (interval < 0 || (interval > 0 && interval < 100))
+		arcan_fatal("benchmark_profile(1), interval (%d) "
+			"should be 0 (off) or >= 100 microseconds\n", interval);
+
+	if (depth <= 0)
+		arcan_fatal("benchmark_profile(2), invalid depth (%d) > 0\n", depth);
+
+	lua_pushboolean(ctx, alt_trace_profile(ctx, interval, depth));
+	LUA_ETRACE("benchmark_profile", NULL, 1);
+}
+
 extern arcan_benchdata benchdata;
 static int togglebench(lua_State* ctx)
 {
@@ -10630,8 +11104,12 @@ static int togglebench(lua_State* ctx)
 	memset(benchdata.ticktime, '\0', sizeof(benchdata.ticktime));
 	memset(benchdata.frametime, '\0', sizeof(benchdata.frametime));
 	memset(benchdata.framecost, '\0', sizeof(benchdata.framecost));
+	memset(benchdata.gccost, '\0', sizeof(benchdata.gccost));
+	memset(benchdata.gpucost, '\0', sizeof(benchdata.gpucost));
 	benchdata.tickofs = benchdata.frameofs = benchdata.costofs = 0;
 	benchdata.framecount = benchdata.tickcount = benchdata.costcount = 0;
+	benchdata.gcofs = benchdata.gpuofs = 0;
+	benchdata.gccount = benchdata.gpucount = 0;
 
 	LUA_ETRACE("benchmark_enable", NULL, 0);
 }
@@ -10698,7 +11176,76 @@ static int getbenchvals(lua_State* ctx)
 		i = (i + 1) % bench_sz;
 	}
 
-	LUA_ETRACE("benchmark_data", NULL, 6);
+	bench_sz = COUNT_OF(benchdata.gccost);
+	i = (benchdata.gcofs + 1) % bench_sz;
+	lua_pushnumber(ctx, benchdata.gccount);
+	lua_newtable(ctx);
+	top = lua_gettop(ctx);
+	count = 0;
+
+	while (i != benchdata.gcofs){
+		lua_pushnumber(ctx, count++);
+		lua_pushnumber(ctx, benchdata.gccost[i]);
+		lua_rawset(ctx, top);
+		i = (i + 1) % bench_sz;
+	}
+
+	bench_sz = COUNT_OF(benchdata.gpucost);
+	i = (benchdata.gpuofs + 1) % bench_sz;
+	lua_pushnumber(ctx, benchdata.gpucount);
+	lua_newtable(ctx);
+	top = lua_gettop(ctx);
+	count = 0;
+
+	while (i != benchdata.gpuofs){
+		lua_pushnumber(ctx, count++);
+		lua_pushnumber(ctx, benchdata.gpucost[i]);
+		lua_rawset(ctx, top);
+		i = (i + 1) % bench_sz;
+	}
+
+	LUA_ETRACE("benchmark_data", NULL, 10);
+}
+
+static int getinputlatency(lua_State* ctx)
+{
+	LUA_TRACE("benchmark_inputlatency");
+	static const char* classes[BENCH_INPUT_CLASSES] = {
+		"keyboard", "mouse", "touch", "game"
+	};
+
+	lua_newtable(ctx);
+	int top = lua_gettop(ctx);
+
+	for (size_t i = 0; i < BENCH_INPUT_CLASSES; i++){
+		unsigned p50, p99;
+		size_t count = arcan_bench_input_latency(i, &p50, &p99);
+
+		lua_pushstring(ctx, classes[i]);
+		lua_newtable(ctx);
+		int ent = lua_gettop(ctx);
+		tblnum(ctx, "count", count, ent);
+		tblnum(ctx, "p50", p50, ent);
+		tblnum(ctx, "p99", p99, ent);
+		lua_rawset(ctx, top);
+	}
+
+	LUA_ETRACE("benchmark_inputlatency", NULL, 1);
+}
+
+static int getgputime(lua_State* ctx)
+{
+	LUA_TRACE("benchmark_gputime");
+	arcan_vobj_id vid = luaL_checkvid(ctx, 1, NULL);
+
+	uint64_t ns;
+	if (ARCAN_OK != arcan_video_rendertarget_gputime(vid, &ns)){
+		lua_pushnil(ctx);
+		LUA_ETRACE("benchmark_gputime", NULL, 1);
+	}
+
+	lua_pushnumber(ctx, (double)ns / 1000.0);
+	LUA_ETRACE("benchmark_gputime", NULL, 1);
 }
 
 static int timestamp(lua_State* ctx)
@@ -11410,14 +11957,78 @@ static int inputanalogtoggle(lua_State* ctx)
 	LUA_ETRACE("inputanalog_toggle", NULL, 0);
 }
 
+static int inputanalogcoalesce(lua_State* ctx)
+{
+	LUA_TRACE("inputanalog_coalesce");
+
+	int devid = luaL_checknumber(ctx, 1);
+	const char* smode = luaL_optstring(ctx, 2, "merge");
+	enum arcan_event_coalesce mode = EVENT_COALESCE_MERGE;
+
+	if (strcmp(smode, "off") == 0)
+		mode = EVENT_COALESCE_OFF;
+	else if (strcmp(smode, "history") == 0)
+		mode = EVENT_COALESCE_HISTORY;
+	else if (strcmp(smode, "merge") != 0)
+		arcan_fatal("inputanalog_coalesce(), unknown mode (%s), "
+			"expected off, merge or history\n", smode);
+
+	arcan_event_coalesce(devid, mode);
+
+	LUA_ETRACE("inputanalog_coalesce", NULL, 0);
+}
+
+static int inputanaloghistory(lua_State* ctx)
+{
+	LUA_TRACE("inputanalog_history");
+
+	int devid = luaL_checknumber(ctx, 1);
+	struct arcan_ioevent samples[64];
+	size_t count = arcan_event_history(devid, samples, COUNT_OF(samples));
+
+	lua_createtable(ctx, count, 0);
+	int top = lua_gettop(ctx);
+
+	for (size_t i = 0; i < count; i++){
+		append_iotable(ctx, &samples[i]);
+		lua_rawseti(ctx, top, i + 1);
+	}
+
+	LUA_ETRACE("inputanalog_history", NULL, 1);
+}
+
 enum outfmt_screenshot {
 	OUTFMT_PNG,
 	OUTFMT_PNG_FLIP,
 	OUTFMT_RAW8,
 	OUTFMT_RAW24,
-	OUTFMT_RAW32
+	OUTFMT_RAW32,
+	OUTFMT_PNG_FAST,
+	OUTFMT_QOI,
+	OUTFMT_RAW_NATIVE
 };
 
+/* the readback as is, native pixel format and row order, no repacking */
+static void dump_native(FILE* dst, av_pixel* buf, int w, int h)
+{
+	fflush(dst);
+	int fd = fileno(dst);
+	uint8_t* cur = (uint8_t*) buf;
+	size_t left = (size_t) w * h * sizeof(av_pixel);
+
+	while (left){
+		ssize_t nw = write(fd, cur, left);
+		if (-1 == nw){
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			arcan_warning("save_screenshot(), raw dump failed: %s\n", strerror(errno));
+			return;
+		}
+		cur += nw;
+		left -= nw;
+	}
+}
+
 static void dump_raw(FILE* dst, av_pixel* buf,
 	int w, int h, enum outfmt_screenshot fmt)
 {
@@ -11485,6 +12096,18 @@ static void* pthr_imgwr(void* arg)
 		arcan_img_outpng(job->dst, job->databuf, job->dw, job->dh, true);
 	break;
 
+	case OUTFMT_PNG_FAST:
+		arcan_img_outpng_fast(job->dst, job->databuf, job->dw, job->dh, false);
+	break;
+
+	case OUTFMT_QOI:
+		arcan_img_outqoi(job->dst, job->databuf, job->dw, job->dh, false);
+	break;
+
+	case OUTFMT_RAW_NATIVE:
+		dump_native(job->dst, job->databuf, job->dw, job->dh);
+	break;
+
 /* flip is assumed in the raw formats */
 	case OUTFMT_RAW8:
 	case OUTFMT_RAW24:
@@ -11517,7 +12140,8 @@ static int screenshot(lua_State* ctx)
 
 	enum outfmt_screenshot fmt = luaL_optnumber(ctx, 2, OUTFMT_PNG);
 	if (fmt != OUTFMT_PNG && fmt != OUTFMT_PNG_FLIP &&
-		fmt != OUTFMT_RAW8 && fmt != OUTFMT_RAW24 && fmt != OUTFMT_RAW32)
+		fmt != OUTFMT_RAW8 && fmt != OUTFMT_RAW24 && fmt != OUTFMT_RAW32 &&
+		fmt != OUTFMT_PNG_FAST && fmt != OUTFMT_QOI && fmt != OUTFMT_RAW_NATIVE)
 		arcan_fatal("save_screenshot(), invalid/uknown format: %d\n", fmt);
 
 	bool local = luaL_optbnumber(ctx, 4, false);
@@ -11575,9 +12199,15 @@ static int screenshot(lua_State* ctx)
 	pthread_t pthr;
 	pthread_attr_init(&jattr);
 	pthread_attr_setdetachstate(&jattr, PTHREAD_CREATE_DETACHED);
-	pthread_create(&pthr, NULL, pthr_imgwr, (void*) job);
 
-	LUA_ETRACE("save_screenshot", "couldn't setup file or thread", 0);
+/* rather stall than lose the shot if no thread could be spawned */
+	if (0 != pthread_create(&pthr, &jattr, pthr_imgwr, (void*) job)){
+		arcan_warning("save_screenshot() -- couldn't spawn encoder, blocking.\n");
+		pthr_imgwr(job);
+	}
+	pthread_attr_destroy(&jattr);
+
+	LUA_ETRACE("save_screenshot", NULL, 0);
 
 /* otherwise thread cleans up at exit */
 cleanup:
@@ -11908,6 +12538,19 @@ static void register_tbl(lua_State* ctx, const luaL_Reg* funtbl)
 	}
 }
 
+static int gcbudget(lua_State* ctx)
+{
+	LUA_TRACE("system_gcbudget");
+	int budget = luaL_checknumber(ctx, 1);
+	int step = luaL_optnumber(ctx, 2, 4);
+	if (budget < 0 || step <= 0)
+		arcan_fatal("system_gcbudget(), invalid budget (%d) or step (%d)\n",
+			budget, step);
+
+	arcan_conductor_gcbudget(budget, step);
+	LUA_ETRACE("system_gcbudget", NULL, 0);
+}
+
 static int getidentstr(lua_State* ctx)
 {
 	LUA_TRACE("system_identstr");
@@ -11990,7 +12633,7 @@ static int chacha_random(lua_State* ctx)
 	uint8_t* buf =
 		arcan_alloc_mem(count,
 			ARCAN_MEM_STRINGBUF,
-			ARCAN_MEM_TEMPORARY | ARCAN_MEM_NONFATAL,
+			ARCAN_MEM_FRAME | ARCAN_MEM_NONFATAL,
 			ARCAN_MEMALIGN_NATURAL
 		);
 	if (buf){
@@ -12160,6 +12803,7 @@ static const luaL_Reg dbfuns[] = {
 {"get_key",      getkey     },
 {"get_keys",     getkeys    },
 {"match_keys",   matchkeys  },
+{"list_keys",    listkeys   },
 {"list_targets", gettargets },
 {"list_target_tags", gettags },
 {"target_configurations", getconfigs },
@@ -12201,12 +12845,16 @@ static const luaL_Reg imgfuns[] = {
 {"show_image",               showimage          },
 {"hide_image",               hideimage          },
 {"move_image",               moveimage          },
+{"move_image_batch",         moveimagebatch     },
 {"nudge_image",              nudgeimage         },
 {"rotate_image",             rotateimage        },
 {"scale_image",              scaleimage         },
 {"resize_image",             scaleimage2        },
+{"resize_image_batch",       resizeimagebatch   },
 {"resample_image",           resampleimage      },
+{"resample_batch",           resamplebatch      },
 {"blend_image",              imageopacity       },
+{"blend_image_batch",        blendimagebatch    },
 {"crop_image",               cropimage          },
 {"persist_image",            imagepersist       },
 {"image_parent",             imageparent        },
@@ -12301,6 +12949,7 @@ static const luaL_Reg threedfuns[] = {
 {"build_sphere",     buildsphere  },
 {"build_cylinder",   buildcylinder},
 {"build_pointcloud", pointcloud   },
+{"pointcloud_update", pointcloudupdate },
 {"scale_3dvertices", scale3dverts },
 {"swizzle_model",    swizzlemodel },
 {"mesh_shader",      setmeshshader},
@@ -12322,12 +12971,17 @@ static const luaL_Reg sysfuns[] = {
 {"decode_modifiers",    decodemod        },
 {"benchmark_enable",    togglebench      },
 {"benchmark_tracedata", benchtracedata   },
+{"benchmark_profile",   benchprofile     },
 {"benchmark_timestamp", timestamp        },
 {"benchmark_data",      getbenchvals     },
+{"benchmark_inputlatency", getinputlatency },
+{"benchmark_gputime",   getgputime       },
 {"appl_arguments",      getapplarguments },
 {"system_identstr",     getidentstr      },
+{"system_gcbudget",     gcbudget         },
 {"system_defaultfont",  setdefaultfont   },
 {"frameserver_debugstall", debugstall    },
+{"frameserver_placement", fsrvplacement },
 #ifdef ARCAN_LWA
 {"VRES_AUTORES", videocanvasrsz },
 #endif
@@ -12346,6 +13000,7 @@ static const luaL_Reg iofuns[] = {
 {"set_led",             setled           },
 {"led_intensity",       led_intensity    },
 {"set_led_rgb",         led_rgb          },
+{"set_led_frame",       led_frame        },
 {"controller_leds",     n_leds           },
 {"vr_setup",            vr_setup         },
 {"vr_map_limb",         vr_maplimb       },
@@ -12353,6 +13008,8 @@ static const luaL_Reg iofuns[] = {
 {"inputanalog_filter",  inputfilteranalog},
 {"inputanalog_query",   inputanalogquery},
 {"inputanalog_toggle",  inputanalogtoggle},
+{"inputanalog_coalesce", inputanalogcoalesce},
+{"inputanalog_history", inputanaloghistory},
 {NULL, NULL},
 };
 #undef EXT_MAPTBL_IODEV
@@ -12384,6 +13041,7 @@ static const luaL_Reg vidsysfuns[] = {
 {"storepop_video_context",           popcontext_ext },
 {"pop_video_context",                popcontext     },
 {"current_context_usage",            contextusage   },
+{"video_residency",                  videoresidency },
 {NULL, NULL},
 };
 #undef EXT_MAPTBL_VIDSYS
@@ -12441,6 +13099,9 @@ static const luaL_Reg netfuns[] = {
 	luaopen_bit(ctx);
 	lua_settop(ctx, top);
 
+/* last so that the fast paths can capture the regular functions */
+	alt_ffi_setup(ctx);
+
 	atexit(arcan_lua_cleanup);
 	return ARCAN_OK;
 }
@@ -12601,6 +13262,7 @@ void arcan_lua_pushglobalconsts(lua_State* ctx){
 {"HINT_ROTATE_180", HINT_ROTATE_180},
 {"HINT_CURSOR", HINT_CURSOR},
 {"HINT_DIRECT", HINT_DIRECT},
+{"HINT_TEARING", HINT_TEARING},
 {"TD_HINT_CONTINUED", 1},
 {"TD_HINT_INVISIBLE", 2},
 {"TD_HINT_UNFOCUSED", 4},
@@ -12621,6 +13283,9 @@ void arcan_lua_pushglobalconsts(lua_State* ctx){
 {"FORMAT_RAW8", OUTFMT_RAW8},
 {"FORMAT_RAW24", OUTFMT_RAW24},
 {"FORMAT_RAW32", OUTFMT_RAW32},
+{"FORMAT_PNG_FAST", OUTFMT_PNG_FAST},
+{"FORMAT_QOI", OUTFMT_QOI},
+{"FORMAT_RAW", OUTFMT_RAW_NATIVE},
 {"ORDER_FIRST", ORDER3D_FIRST},
 {"ORDER_NONE", ORDER3D_NONE},
 {"ORDER_LAST", ORDER3D_LAST},
@@ -12953,6 +13618,32 @@ fprintf(dst,
 	(int) fsrv->outqueue.eventbuf_sz,
 	qused(&fsrv->outqueue));
 
+	struct arcan_shmif_perf perf;
+	if (arcan_frameserver_perf(fsrv, &perf))
+		fprintf(dst,
+"\tperf = {\
+\tframes = %u,\
+\tdropped = %u,\
+\taudio = %u,\
+\trender_us = %llu,\
+\twait_us = %llu,\
+\tlast_render_us = %u,\
+\tlast_wait_us = %u,\
+\tinevq_hwm = %u,\
+\toutevq_hwm = %u,\
+\toutevq_full = %u,\
+\tresizes = %u,\
+\tresize_us = %llu,\
+\tevwaits = %u,\
+\tevwait_us = %llu},",
+		(unsigned) perf.frames, (unsigned) perf.dropped, (unsigned) perf.audio,
+		(unsigned long long) perf.render_us, (unsigned long long) perf.wait_us,
+		(unsigned) perf.last_render_us, (unsigned) perf.last_wait_us,
+		(unsigned) perf.inq_hwm, (unsigned) perf.outq_hwm,
+		(unsigned) perf.outq_full, (unsigned) perf.resizes,
+		(unsigned long long) perf.resize_us, (unsigned) perf.evwaits,
+		(unsigned long long) perf.evwait_us);
+
 	fprintf(dst, "\tsource = ");
 	fput_luasafe_str(dst, fsrv->source ? fsrv->source : "NULL");
 	fprintf(dst, ",\n\tkind = ");
@@ -13199,11 +13890,11 @@ ctx.tickstamp = %lld;\n",
 (long long int) ctx->last_tickstamp
 );
 
-		for (size_t i = 0; i < ctx->vitem_limit; i++){
-			if (!FL_TEST(&(ctx->vitems_pool[i]), FL_INUSE))
+		for (size_t i = 1; i < ctx->vitem_top; i++){
+			if (!FL_TEST(arcan_vint_vitem(ctx, i), FL_INUSE))
 				continue;
 
-			dump_vobject(dst, ctx->vitems_pool + i);
+			dump_vobject(dst, arcan_vint_vitem(ctx, i));
 			fprintf(dst, "\
 vobj.cellid_translated = %ld;\n\
 ctx.vobjs[vobj.cellid] = vobj;\n", (long int)vid_toluavid(i));
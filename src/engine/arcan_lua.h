@@ -41,6 +41,10 @@ void arcan_lua_cbdrop();
 void arcan_lua_shutdown(struct arcan_luactx*);
 void arcan_lua_tick(struct arcan_luactx*, size_t, size_t);
 
+/* perform one incremental garbage collection step of [kb] size,
+ * returns true if that step finished a collection cycle */
+bool arcan_lua_gcstep(struct arcan_luactx*, size_t kb);
+
 /* access the last known crash source, used when a [callvoidfun] has
  * failed and longjumped into the set jump buffer */
 const char* arcan_lua_crash_source(struct arcan_luactx*);
@@ -56,6 +56,24 @@ static void vplatform_usage()
 	printf("(use ARCAN_VIDEO_XXX=val for env, or "
 		"arcan_db add_appl_kv arcan video_xxx for db)\n");
 	printf("\tignore_dirty - always update regardless of 'dirty' state\n");
+	printf("\tsoa_tfcache - resolve transforms in one packed pass per rendertarget\n");
+	printf("\tprepare_threads=n - prepare rendertargets on n worker threads\n");
+	printf("\tdamage_regions - only redraw changed parts of rendertargets\n");
+	printf("\tpick_index - spatial index for picking and offscreen culling\n");
+	printf("\tbatch_draws - merge runs of default-shaded quads into one draw\n");
+	printf("\ttext_atlas - draw text from a shared glyph atlas\n");
+	printf("\ttext_cache=kb - keep kb of rastered text lines for partially changed text\n");
+	printf("\ttpack_gpu - draw tpack clients on the GPU from a shared glyph atlas (experimental)\n");
+	printf("\treadback_ring=n - in-flight readbacks per rendertarget (default 3)\n");
+	printf("\tupload_ring=mb - persistently mapped staging for uploads, 0 off (default 32)\n");
+	printf("\tgpu_timers - measure GPU time per rendertarget pass (benchmark_gputime)\n");
+	printf("\texport_readback - pass recordtarget stores to capable encoders as dma-bufs\n");
+	printf("\t3d_culling - skip 3d models outside of the camera frustum\n");
+	printf("\t3d_occlusion - also skip models occluded last frame (implies 3d_culling)\n");
+	printf("\timage_workers=n - number of threads for asynchronous image loads (0, synchronous)\n");
+	printf("\timage_cache=mb - keep up to mb decoded images around for repeated loads\n");
+	printf("\tvstore_budget=mb - drop GPU copies of undrawn images above mb of resident stores\n");
+	printf("\tlua_ffi - LuaJIT FFI fast path for hot image calls, surface properties as structs\n");
 	while(1){
 		const char* a = *cur++;
 		if (!a) break;
@@ -91,7 +109,7 @@ printf("Usage: arcan [-whfmWMOqspTBtHbdgaSV] applname "
 "-m\t--conservative\ttoggle conservative memory management (default: off)\n"
 "-W\t--sync-strat  \tspecify video synchronization strategy (see below)\n"
 "-M\t--monitor     \tenable monitor session (arg: [ticks/sample], -1 debug only)\n"
-"-O\t--monitor-out \tLOG:fname or LOGFD:num\n"
+"-O\t--monitor-out \tLOG:fname, LOGFD:num, METRICS:fname or METRICSFD:num\n"
 "-C\t--monitor-ctrl\tuse STDIN as control interface (with SIGUSR1)\n"
 "-s\t--windowed    \ttoggle borderless window mode\n"
 #ifdef DISABLE_FRAMESERVERS
@@ -200,6 +218,57 @@ static void fatal_shutdown()
 	arcan_video_shutdown(false);
 }
 
+/*
+ * Audio device setup and the LED controller scan don't depend on video and
+ * both can take a noticeable amount of time (device probing, sound servers),
+ * so they run on a helper thread while the video platform is brought up.
+ */
+struct startup_job {
+	bool nosound;
+	arcan_errc audio;
+	pthread_t thread;
+	bool threaded;
+};
+
+static void* startup_worker(void* arg)
+{
+	struct startup_job* job = arg;
+
+	uint64_t ts = arcan_timemicros();
+	job->audio = arcan_audio_setup(job->nosound);
+	uint64_t now = arcan_timemicros();
+	arcan_trace_startup("audio", ts, now);
+
+	arcan_led_probe();
+	arcan_trace_startup("led_probe", now, arcan_timemicros());
+
+	return NULL;
+}
+
+static void startup_begin(struct startup_job* job)
+{
+	job->threaded =
+		0 == pthread_create(&job->thread, NULL, startup_worker, job);
+
+	if (!job->threaded)
+		startup_worker(job);
+}
+
+static void startup_end(struct startup_job* job)
+{
+	if (job->threaded)
+		pthread_join(job->thread, NULL);
+	job->threaded = false;
+}
+
+/* time since the last phase, [ts] is updated to now */
+static void startup_phase(const char* subsys, uint64_t* ts)
+{
+	uint64_t now = arcan_timemicros();
+	arcan_trace_startup(subsys, *ts, now);
+	*ts = now;
+}
+
 static void add_hookscript(const char* instr)
 {
 /* convert to filesystem path */
@@ -263,6 +332,7 @@ int MAIN_REDIR(int argc, char* argv[])
 /* needed first as device_init might fork and need some shared mem */
 	system_page_size = sysconf(_SC_PAGE_SIZE);
 	arcan_conductor_enable_watchdog();
+	uint64_t startup_ts = arcan_timemicros();
 
 /*
  * these are, in contrast to normal video_init/event_init, only set once
@@ -502,6 +572,20 @@ int MAIN_REDIR(int argc, char* argv[])
 	if (dbfname || (dbfname = platform_dbstore_path()))
 		dbhandle = arcan_db_open(dbfname, arcan_appl_id());
 
+/* keep linked shader binaries next to the database so later launches on the
+ * same GPU / driver can skip compilation. In-memory databases or a name
+ * without a directory part leave the cache disabled rather than littering
+ * whatever the current directory happens to be */
+	if (dbhandle && strcmp(dbfname, ":memory:") != 0){
+		char* dir = strdup(dbfname);
+		char* sep = dir ? strrchr(dir, '/') : NULL;
+		if (sep){
+			*sep = '\0';
+			agp_shader_cache(dir[0] ? dir : "/");
+		}
+		free(dir);
+	}
+
 	if (!dbhandle){
 		arcan_warning(
 			"Couldn't open/create database (%s), fallback to :memory:\n", dbfname);
@@ -553,9 +637,15 @@ int MAIN_REDIR(int argc, char* argv[])
 	if (windowed)
 		fullscreen = false;
 
+	startup_phase("database", &startup_ts);
+
 /* grab video, (necessary) */
 	arcan_evctx* evctx = arcan_event_defaultctx();
 	arcan_event_init(evctx);
+	startup_phase("event", &startup_ts);
+
+	struct startup_job startup_job = {.nosound = nosound};
+	startup_begin(&startup_job);
 
 	if (arcan_video_init(width, height, 32, fullscreen, windowed,
 		conservative, arcan_appl_id()) != ARCAN_OK){
@@ -570,11 +660,15 @@ int MAIN_REDIR(int argc, char* argv[])
  * platforms are extremely volatile if we don't initiate a shutdown (egl-dri
  * for one) */
 	extern void(*arcan_fatal_hook)(void);
+	startup_phase("video", &startup_ts);
+
+/* grab audio, (possible to live without) */
+	startup_end(&startup_job);
 	arcan_fatal_hook = fatal_shutdown;
+	startup_phase("audio_wait", &startup_ts);
 
 	errno = 0;
-/* grab audio, (possible to live without) */
-	if (ARCAN_OK != arcan_audio_setup(nosound))
+	if (ARCAN_OK != startup_job.audio)
 		arcan_warning("Warning: No audio devices could be found.\n");
 
 	arcan_math_init();
@@ -582,6 +676,7 @@ int MAIN_REDIR(int argc, char* argv[])
 
 /* setup device polling, cleanup, ... */
 	arcan_led_init();
+	startup_phase("platform", &startup_ts);
 
 /*
  * fallback implementation resides here and a little further down in the "if
@@ -720,6 +815,9 @@ int MAIN_REDIR(int argc, char* argv[])
 		goto error;
 	}
 
+	if (!jumpcode)
+		startup_phase("scripting", &startup_ts);
+
 	char* msg = arcan_lua_main(main_lua_context, inp, inp_file);
 	if (msg != NULL){
 		arcan_warning("\n\x1b[1mParsing error in (\x1b[33m%s\x1b[39m):\n"
@@ -738,6 +836,9 @@ int MAIN_REDIR(int argc, char* argv[])
 		goto error;
 	}
 
+	if (!jumpcode)
+		startup_phase("appl", &startup_ts);
+
 /* mark that we are in hook so a script can know that is being used as a hook-
  * scripts and not as embedded by the appl itself */
 	arcan_lua_setglobalint(main_lua_context, "IN_HOOK", 1);
@@ -51,6 +51,38 @@ void multiply_matrix(float* restrict dst,
 				b[i+2] * a[j+8] +
 				b[i+3] * a[j+12];
 }
+
+void multiply_matrix_n(float* dst,
+	const float* restrict a, const float* b, size_t n)
+{
+	float tmp[16];
+
+/* b may be dst, so go through a temporary */
+	for (size_t i = 0; i < n; i++){
+		multiply_matrix(tmp, a, &b[i * 16]);
+		memcpy(&dst[i * 16], tmp, sizeof(tmp));
+	}
+}
+
+void mult_matrix_vecf_n(const float* restrict m,
+	const float* v, float* dst, size_t n)
+{
+	float tmp[4];
+
+	for (size_t i = 0; i < n; i++){
+		mult_matrix_vecf(m, &v[i * 4], tmp);
+		memcpy(&dst[i * 4], tmp, sizeof(tmp));
+	}
+}
+
+void frustum_aabb_n(const float frustum[6][4],
+	const float* restrict boxes, size_t n, enum cstate* restrict res)
+{
+	for (size_t i = 0; i < n; i++){
+		const float* b = &boxes[i * 6];
+		res[i] = frustum_aabb(frustum, b[0], b[1], b[2], b[3], b[4], b[5]);
+	}
+}
 #endif
 
 void scale_matrix(float* m, float xs, float ys, float zs)
@@ -574,7 +606,7 @@ static inline quat nlerp_quatfl(quat a, quat b, float fact, bool r360)
 	quat rq;
 
 	if (r360 && dot_quat(a, b) < 0.0f)
-		rq = add_quat(mul_quatf(a, tinv), mul_quatf(a, -fact));
+		rq = add_quat(mul_quatf(a, tinv), mul_quatf(b, -fact));
 	else
 		rq = add_quat(mul_quatf(a, tinv), mul_quatf(b,  fact));
 
@@ -597,6 +629,15 @@ quat nlerp_quat360(quat a, quat b, float fact){
 	return nlerp_quatfl(a, b, fact, true );
 }
 
+#ifndef ARCAN_MATH_SIMD
+void nlerp_quat_n(quat* dst,
+	const quat* a, const quat* b, const float* fact, size_t n, bool r360)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = nlerp_quatfl(a[i], b[i], fact[i], r360);
+}
+#endif
+
 float* matr_rotatef(float ang, float* dmatr)
 {
 	float cv = cosf(ang);
@@ -875,40 +916,21 @@ enum cstate frustum_aabb(const float frustum[6][4],
 	const float x2, const float y2, const float z2)
 {
 	enum cstate res = inside;
-	for (int i = 0; i < 6; i++){
-		if (frustum[i][0] * x1 + frustum[i][1] * y1 +
-			frustum[i][2] * z1 + frustum[i][3] > 0.0f)
-			continue;
-
-		res = intersect;
 
-		if (frustum[i][0] * x2 + frustum[i][1] * y1 +
-			frustum[i][2] * z1 + frustum[i][3] > 0.0f)
-			continue;
-
-		if (frustum[i][0] * x1 + frustum[i][1] * y2 +
-			frustum[i][2] * z1 + frustum[i][3] > 0.0f)
-			continue;
-
-		if (frustum[i][0] * x2 + frustum[i][1] * y2 +
-			frustum[i][2] * z1 + frustum[i][3] > 0.0f)
-			continue;
-
-		if (frustum[i][0] * x1 + frustum[i][1] * y1 +
-			frustum[i][2] * z2 + frustum[i][3] > 0.0f)
-			continue;
-
-		if (frustum[i][0] * x2 + frustum[i][1] * y1 +
-			frustum[i][2] * z2 + frustum[i][3] > 0.0f)
-			continue;
+/* for each plane, only the corners furthest along and furthest against the
+ * normal matter (x1,y1,z1 is expected to be the minimum corner) */
+	for (int i = 0; i < 6; i++){
+		const float* pl = frustum[i];
 
-		if (frustum[i][0] * x1 + frustum[i][1] * y2 +
-			frustum[i][2] * z2 + frustum[i][3] > 0.0f)
-			continue;
+		if (pl[0] * (pl[0] >= 0.0f ? x2 : x1) +
+			pl[1] * (pl[1] >= 0.0f ? y2 : y1) +
+			pl[2] * (pl[2] >= 0.0f ? z2 : z1) + pl[3] < 0.0f)
+			return outside;
 
-		if (frustum[i][0] * x2 + frustum[i][1] * y2 +
-			frustum[i][2] * z2 + frustum[i][3] > 0.0f)
-			continue;
+		if (pl[0] * (pl[0] >= 0.0f ? x1 : x2) +
+			pl[1] * (pl[1] >= 0.0f ? y1 : y2) +
+			pl[2] * (pl[2] >= 0.0f ? z1 : z2) + pl[3] < 0.0f)
+			res = intersect;
 	}
 
 	return res;
@@ -936,9 +958,10 @@ enum cstate frustum_sphere(const float frustum[6][4],
 
 void update_frustum(float* prjm, float* mvm, float frustum[6][4])
 {
-	float mmr[16];
-/* multiply modelview with projection */
-	multiply_matrix(mmr, mvm, prjm);
+	float _Alignas(16) mmr[16];
+/* clip = projection * modelview, planes are then in the space of the
+ * modelview input (world space for a view matrix) */
+	multiply_matrix(mmr, prjm, mvm);
 
 /* extract and normalize planes */
 	frustum[0][0] = mmr[3]  + mmr[0]; // left
@@ -147,6 +147,26 @@ enum cstate frustum_aabb(const float frustum[6][4],
 	const float x1, const float y1, const float z1,
 	const float x2, const float y2, const float z2);
 
+/*
+ * Batch forms of the above for the callers that have many of the same
+ * operation ready at once (transform caches, cull passes). These are what
+ * the SIMD builds vectorize over, the scalar fallbacks just loop.
+ *
+ * multiply_matrix_n: dst[i] = a * b[i] for [n] 4x4 matrices, dst may be b.
+ * mult_matrix_vecf_n: dst[i] = m * v[i] for [n] 4-float vectors, dst may be v.
+ * nlerp_quat_n: dst[i] = nlerp(a[i], b[i], fact[i]) as nlerp_quat180/360.
+ * frustum_aabb_n: [boxes] is n * (x1, y1, z1, x2, y2, z2), res gets the
+ *                 enum cstate for each box.
+ */
+void multiply_matrix_n(float* dst,
+	const float* restrict a, const float* b, size_t n);
+void mult_matrix_vecf_n(const float* restrict m,
+	const float* v, float* dst, size_t n);
+void nlerp_quat_n(quat* dst,
+	const quat* a, const quat* b, const float* fact, size_t n, bool r360);
+void frustum_aabb_n(const float frustum[6][4],
+	const float* restrict boxes, size_t n, enum cstate* restrict res);
+
 /* comp.graphics.algorithms DAQ, Randolph Franklin */
 int pinpoly(int, float*, float*, float, float);
 
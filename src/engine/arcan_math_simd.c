@@ -150,3 +150,133 @@ void multiply_matrix(float* restrict dst,
 #endif
 }
 
+
+/*
+ * The batch forms below keep the constant operand in registers for the whole
+ * run, so the data side is always loaded unaligned - the arrays are packed
+ * and not necessarily 16-byte aligned per element.
+ */
+void multiply_matrix_n(float* dst,
+	const float* restrict ina, const float* inb, size_t n)
+{
+	const __m128 a = _mm_loadu_ps(&ina[0]);
+	const __m128 b = _mm_loadu_ps(&ina[4]);
+	const __m128 c = _mm_loadu_ps(&ina[8]);
+	const __m128 d = _mm_loadu_ps(&ina[12]);
+
+/* each output column only depends on the same column in inb, so storing it
+ * right away is safe even when dst is inb */
+	for (size_t i = 0; i < n; i++, inb += 16, dst += 16){
+		for (size_t j = 0; j < 16; j += 4){
+			__m128 t = _mm_mul_ps(a, _mm_set1_ps(inb[j]));
+			t = _mm_add_ps(_mm_mul_ps(b, _mm_set1_ps(inb[j+1])), t);
+			t = _mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(inb[j+2])), t);
+			t = _mm_add_ps(_mm_mul_ps(d, _mm_set1_ps(inb[j+3])), t);
+			_mm_storeu_ps(&dst[j], t);
+		}
+	}
+}
+
+void mult_matrix_vecf_n(const float* restrict m,
+	const float* v, float* dst, size_t n)
+{
+	const __m128 c0 = _mm_loadu_ps(&m[0]);
+	const __m128 c1 = _mm_loadu_ps(&m[4]);
+	const __m128 c2 = _mm_loadu_ps(&m[8]);
+	const __m128 c3 = _mm_loadu_ps(&m[12]);
+
+	for (size_t i = 0; i < n; i++, v += 4, dst += 4){
+		__m128 t = _mm_mul_ps(c0, _mm_set1_ps(v[0]));
+		t = _mm_add_ps(_mm_mul_ps(c1, _mm_set1_ps(v[1])), t);
+		t = _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(v[2])), t);
+		t = _mm_add_ps(_mm_mul_ps(c3, _mm_set1_ps(v[3])), t);
+		_mm_storeu_ps(dst, t);
+	}
+}
+
+void nlerp_quat_n(quat* dst,
+	const quat* qa, const quat* qb, const float* fact, size_t n, bool r360)
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+
+	for (size_t i = 0; i < n; i++){
+		__m128 a = _mm_loadu_ps(qa[i].xyzw);
+		__m128 b = _mm_loadu_ps(qb[i].xyzw);
+		__m128 f = _mm_set1_ps(fact[i]);
+
+/* shortest path, flip b if the dot product is negative */
+		if (r360){
+			__m128 dp = _mm_mul_ps(a, b);
+			dp = _mm_hadd_ps(dp, dp);
+			dp = _mm_hadd_ps(dp, dp);
+			__m128 neg = _mm_cmplt_ps(dp, _mm_setzero_ps());
+			b = _mm_xor_ps(b, _mm_and_ps(neg, sign));
+		}
+
+/* a + (b - a) * f, then normalize */
+		__m128 r = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f));
+		__m128 len = _mm_mul_ps(r, r);
+		len = _mm_hadd_ps(len, len);
+		len = _mm_hadd_ps(len, len);
+		r = _mm_div_ps(r, _mm_sqrt_ps(len));
+
+		_mm_storeu_ps(dst[i].xyzw, r);
+	}
+}
+
+void frustum_aabb_n(const float frustum[6][4],
+	const float* restrict boxes, size_t n, enum cstate* restrict res)
+{
+	size_t i = 0;
+
+/* four boxes at a time, transposed so that each register holds one of the
+ * six bounds for all four */
+	for (; i + 4 <= n; i += 4){
+		const float* bx = &boxes[i * 6];
+		__m128 r0 = _mm_loadu_ps(&bx[0]);
+		__m128 r1 = _mm_loadu_ps(&bx[6]);
+		__m128 r2 = _mm_loadu_ps(&bx[12]);
+		__m128 r3 = _mm_loadu_ps(&bx[18]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+		const __m128 x1 = r0, y1 = r1, z1 = r2, x2 = r3;
+		const __m128 y2 = _mm_setr_ps(bx[4], bx[10], bx[16], bx[22]);
+		const __m128 z2 = _mm_setr_ps(bx[5], bx[11], bx[17], bx[23]);
+
+		__m128 out = _mm_setzero_ps();
+		__m128 isect = _mm_setzero_ps();
+		const __m128 zero = _mm_setzero_ps();
+
+/* same p/n-vertex selection as frustum_aabb, the plane signs are uniform
+ * across the four boxes so the selection is a plain branch */
+		for (size_t j = 0; j < 6; j++){
+			const float* pl = frustum[j];
+			const __m128 px = _mm_set1_ps(pl[0]);
+			const __m128 py = _mm_set1_ps(pl[1]);
+			const __m128 pz = _mm_set1_ps(pl[2]);
+			const __m128 pw = _mm_set1_ps(pl[3]);
+
+			__m128 far = _mm_add_ps(pw, _mm_mul_ps(px, pl[0] >= 0.0f ? x2 : x1));
+			far = _mm_add_ps(far, _mm_mul_ps(py, pl[1] >= 0.0f ? y2 : y1));
+			far = _mm_add_ps(far, _mm_mul_ps(pz, pl[2] >= 0.0f ? z2 : z1));
+
+			__m128 near = _mm_add_ps(pw, _mm_mul_ps(px, pl[0] >= 0.0f ? x1 : x2));
+			near = _mm_add_ps(near, _mm_mul_ps(py, pl[1] >= 0.0f ? y1 : y2));
+			near = _mm_add_ps(near, _mm_mul_ps(pz, pl[2] >= 0.0f ? z1 : z2));
+
+			out = _mm_or_ps(out, _mm_cmplt_ps(far, zero));
+			isect = _mm_or_ps(isect, _mm_cmplt_ps(near, zero));
+		}
+
+		int om = _mm_movemask_ps(out);
+		int im = _mm_movemask_ps(isect);
+		for (size_t j = 0; j < 4; j++)
+			res[i + j] = (om & (1 << j)) ? outside :
+				((im & (1 << j)) ? intersect : inside);
+	}
+
+	for (; i < n; i++){
+		const float* b = &boxes[i * 6];
+		res[i] = frustum_aabb(frustum, b[0], b[1], b[2], b[3], b[4], b[5]);
+	}
+}
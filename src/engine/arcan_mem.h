@@ -144,6 +144,30 @@ enum arcan_memhint {
  * tier storage (i.e. trustzone) if possible.
  */
 	ARCAN_MEM_LOCKACCESS = 33,
+
+/*
+ * indicate that this is a small object that is allocated and freed at a high
+ * rate (transform chains, render list items, text cells). These come from a
+ * slab pool per size class so that the steady state doesn't touch the system
+ * allocator. Only meaningful with ARCAN_MEMALIGN_NATURAL, larger blocks than
+ * the biggest size class fall back to the normal path.
+ */
+	ARCAN_MEM_SLAB = 64,
+
+/*
+ * indicate that this block is only used until the end of the current conductor
+ * cycle (arcan_mem_frame_reset). These are bump allocated from a frame arena
+ * and arcan_mem_free on them is a no-op. Only the main thread gets arena
+ * blocks, elsewhere (or when the arena is full) the hint is ignored and the
+ * block has to be freed as normal - so always pair it with arcan_mem_free.
+ */
+	ARCAN_MEM_FRAME = 128,
+
+/*
+ * Implies (ARCAN_MEM_FRAME) but the block survives one more reset, for data
+ * that is produced in one frame and consumed in the next.
+ */
+	ARCAN_MEM_FRAMECARRY = 384
 };
 
 enum arcan_memalign {
@@ -179,6 +203,10 @@ struct arcan_strarr {
 		char** data;
 		void** cdata;
 	};
+
+/* if set, the strings in data all point into this one block, such an array
+ * is complete as returned and shouldn't be grown or have entries replaced */
+	char* pack;
 };
 
 void arcan_mem_growarr(struct arcan_strarr*);
@@ -209,6 +237,34 @@ void arcan_mem_unlock(void*);
  */
 void arcan_mem_tick();
 
+/*
+ * implemented in <platform>/mem.c
+ * release all ARCAN_MEM_FRAME blocks and the ARCAN_MEM_FRAMECARRY blocks
+ * from the reset before this one. The first call decides which thread
+ * owns the frame arena.
+ */
+void arcan_mem_frame_reset();
+
+/*
+ * implemented in <platform>/mem.c
+ * per size class statistics for the ARCAN_MEM_SLAB pools, the [tick_]
+ * counters cover the period up to the last arcan_mem_tick. [sys_alloc] is
+ * the number of slab requests that had to go to the system allocator (out
+ * of pool space or too large), in a steady state that should stay at zero.
+ * returns the number of pools, fills up to [lim] entries in [dst].
+ */
+struct arcan_mem_poolstat {
+	size_t obj_sz;
+	size_t in_use;
+	size_t capacity;
+	size_t alloc_cnt;
+	size_t dealloc_cnt;
+	size_t sys_alloc;
+	size_t tick_alloc;
+	size_t tick_sys_alloc;
+};
+size_t arcan_mem_poolstats(struct arcan_mem_poolstat* dst, size_t lim);
+
 /*
  * implemented in <platform>/mem.c
  * aggregates a mem_alloc and a mem_copy from a source buffer.
@@ -11,6 +11,18 @@ static bool m_locked;
 static bool m_transaction;
 static int longjmp_mode;
 
+/* metrics export, see metrics_sample - [buf] holds a snapshot that hasn't
+ * been completely written yet, new ones are dropped until it drains */
+static struct {
+	int fd;
+	char* buf;
+	size_t buf_sz;
+	size_t ofs;
+	size_t dropped;
+} m_metrics = {
+	.fd = -1
+};
+
 /*
  * instead of adding more commands here, the saner option is to establish
  * a shmif based control interface (with the interesting consequence of
@@ -118,6 +130,28 @@ static void cmd_continue(char* arg)
 		cmd_commit(arg);
 }
 
+static void cmd_latency(char* arg)
+{
+	static const char* classes[BENCH_INPUT_CLASSES] = {
+		"keyboard", "mouse", "touch", "game"
+	};
+
+	fprintf(m_out, "#BEGINLATENCY\n");
+	for (size_t i = 0; i < BENCH_INPUT_CLASSES; i++){
+		unsigned p50, p99;
+		size_t count = arcan_bench_input_latency(i, &p50, &p99);
+		fprintf(m_out, "%s count=%zu p50=%u p99=%u\n", classes[i], count, p50, p99);
+	}
+	fprintf(m_out, "#ENDLATENCY\n");
+	fflush(m_out);
+}
+
+static void cmd_phases(char* arg)
+{
+	fflush(m_out);
+	arcan_conductor_phase_dump(fileno(m_out));
+}
+
 static void cmd_dumpstate(char* argv)
 {
 /* previously all the dumping ran here, with the change to bootstrap a shmif
@@ -155,6 +189,8 @@ void arcan_monitor_watchdog(lua_State* L, lua_Debug* D)
 		{"dumpstate", cmd_dumpstate},
 		{"commit", cmd_commit},
 		{"reload", cmd_reload},
+		{"latency", cmd_latency},
+		{"phases", cmd_phases},
 		{"lock", cmd_lock}
 	};
 
@@ -189,6 +225,194 @@ void arcan_monitor_watchdog(lua_State* L, lua_Debug* D)
 	}
 }
 
+static void metrics_flush()
+{
+	while (m_metrics.buf && m_metrics.ofs < m_metrics.buf_sz){
+		ssize_t nw = write(m_metrics.fd,
+			&m_metrics.buf[m_metrics.ofs], m_metrics.buf_sz - m_metrics.ofs);
+
+		if (nw > 0){
+			m_metrics.ofs += nw;
+			continue;
+		}
+
+		if (-1 == nw && (errno == EINTR))
+			continue;
+
+		if (-1 == nw && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+
+/* collector is gone, no point in producing more */
+		arcan_warning("monitor: metrics output failed (%s), disabled\n",
+			nw == 0 ? "eof" : strerror(errno));
+		close(m_metrics.fd);
+		m_metrics.fd = -1;
+		break;
+	}
+
+	free(m_metrics.buf);
+	m_metrics.buf = NULL;
+	m_metrics.buf_sz = m_metrics.ofs = 0;
+}
+
+static void metrics_fsrv(FILE* out, const char* name, const char* type,
+	struct arcan_frameserver** fsrv, size_t n, int field, uint64_t now)
+{
+	fprintf(out, "# TYPE %s %s\n", name, type);
+	for (size_t i = 0; i < n; i++){
+		struct arcan_frameserver* cur = fsrv[i];
+		switch (field){
+		case 0:
+			fprintf(out, "%s_total{vid=\"%"PRIxVOBJ"\",segid=\"%d\"} %llu\n",
+				name, cur->vid, (int) cur->segid, cur->desc.framecount);
+		break;
+		case 1:
+			if (cur->desc.frame_us && now > cur->desc.frame_us)
+				fprintf(out, "%s{vid=\"%"PRIxVOBJ"\",segid=\"%d\"} %.6f\n",
+					name, cur->vid, (int) cur->segid, (double)(now - cur->desc.frame_us) / 1000000.0);
+		break;
+		case 2:
+			fprintf(out, "%s{vid=\"%"PRIxVOBJ"\",segid=\"%d\",dir=\"in\"} %u\n",
+				name, cur->vid, (int) cur->segid, arcan_event_queuedepth(&cur->inqueue));
+			fprintf(out, "%s{vid=\"%"PRIxVOBJ"\",segid=\"%d\",dir=\"out\"} %u\n",
+				name, cur->vid, (int) cur->segid, arcan_event_queuedepth(&cur->outqueue));
+		break;
+		}
+	}
+}
+
+/*
+ * One OpenMetrics text snapshot, terminated by '# EOF'. Everything here is
+ * already tracked elsewhere (conductor cost estimates, counters) except for
+ * the store estimate which is a walk of the current context, so at the
+ * default rates this is cheap. Writing it is never allowed to block.
+ */
+static void metrics_sample()
+{
+	metrics_flush();
+	if (m_metrics.fd == -1)
+		return;
+
+	if (m_metrics.buf){
+		m_metrics.dropped++;
+		return;
+	}
+
+	FILE* out = open_memstream(&m_metrics.buf, &m_metrics.buf_sz);
+	if (!out)
+		return;
+
+	struct conductor_stats cst;
+	arcan_conductor_stats(&cst);
+
+	struct arcan_video_usage vst;
+	arcan_video_usage(&vst);
+
+	fprintf(out,
+		"# TYPE arcan_ticks counter\n"
+		"arcan_ticks_total %"PRIu64"\n"
+		"# TYPE arcan_frames counter\n"
+		"arcan_frames_total %"PRIu64"\n"
+		"# TYPE arcan_frame_interval_seconds gauge\n"
+		"arcan_frame_interval_seconds %.6f\n"
+		"# TYPE arcan_frame_jitter_seconds gauge\n"
+		"arcan_frame_jitter_seconds %.6f\n"
+		"# TYPE arcan_stage_cost_seconds gauge\n"
+		"arcan_stage_cost_seconds{stage=\"tick\"} %.6f\n"
+		"arcan_stage_cost_seconds{stage=\"poll\"} %.6f\n"
+		"arcan_stage_cost_seconds{stage=\"render\"} %.6f\n"
+		"arcan_stage_cost_seconds{stage=\"scanout\"} %.6f\n"
+		"# TYPE arcan_budget_misses counter\n"
+		"arcan_budget_misses_total %zu\n",
+		cst.ticks, cst.frames,
+		cst.frame_us / 1000000.0, cst.frame_dev_us / 1000000.0,
+		cst.tick_us / 1000000.0, cst.poll_us / 1000000.0,
+		cst.render_us / 1000000.0, cst.scanout_us / 1000000.0,
+		cst.budget_misses
+	);
+
+	fprintf(out,
+		"# TYPE arcan_vobjects gauge\n"
+		"arcan_vobjects %u\n"
+		"# TYPE arcan_vobjects_limit gauge\n"
+		"arcan_vobjects_limit %u\n"
+		"# TYPE arcan_rendertargets gauge\n"
+		"arcan_rendertargets %u\n"
+		"# TYPE arcan_vstore_bytes gauge\n"
+		"# UNIT arcan_vstore_bytes bytes\n"
+		"arcan_vstore_bytes{kind=\"gpu\"} %zu\n"
+		"arcan_vstore_bytes{kind=\"cpu\"} %zu\n"
+		"# TYPE arcan_vstore_residency gauge\n"
+		"arcan_vstore_residency{state=\"resident\"} %zu\n"
+		"arcan_vstore_residency{state=\"evicted\"} %zu\n"
+		"# TYPE arcan_event_queue_depth gauge\n"
+		"arcan_event_queue_depth %u\n",
+		vst.vobjects, vst.vobject_limit, vst.rendertargets,
+		vst.store_gpu, vst.store_cpu,
+		vst.store_resident, vst.store_evicted,
+		arcan_event_queuedepth(arcan_event_defaultctx())
+	);
+
+	if (main_lua_context){
+		lua_State* L = (lua_State*) main_lua_context;
+		size_t mem = (size_t) lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+		fprintf(out,
+			"# TYPE arcan_lua_memory_bytes gauge\n"
+			"# UNIT arcan_lua_memory_bytes bytes\n"
+			"arcan_lua_memory_bytes %zu\n",
+			mem
+		);
+	}
+
+	fprintf(out,
+		"# TYPE arcan_lua_gc_seconds counter\n"
+		"arcan_lua_gc_seconds_total %.6f\n"
+		"# TYPE arcan_frameservers gauge\n"
+		"arcan_frameservers %zu\n",
+		(double) cst.gc_us / 1000000.0, cst.frameservers
+	);
+
+	struct arcan_frameserver* fsrv[256];
+	size_t n = arcan_conductor_frameservers(fsrv, COUNT_OF(fsrv));
+	uint64_t now = arcan_timemicros();
+	metrics_fsrv(out, "arcan_frameserver_frames", "counter", fsrv, n, 0, now);
+	metrics_fsrv(out, "arcan_frameserver_frame_age_seconds", "gauge", fsrv, n, 1, now);
+	metrics_fsrv(out, "arcan_frameserver_queue_depth", "gauge", fsrv, n, 2, now);
+
+	fprintf(out,
+		"# TYPE arcan_metrics_dropped counter\n"
+		"arcan_metrics_dropped_total %zu\n"
+		"# EOF\n",
+		m_metrics.dropped
+	);
+
+	fclose(out);
+	metrics_flush();
+}
+
+static bool metrics_open(const char* dst)
+{
+	int fd = -1;
+	if (strncmp(dst, "METRICS:", 8) == 0){
+		fd = open(&dst[8], O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | O_NONBLOCK, 0600);
+		if (-1 == fd){
+			arcan_warning("-O %s could not be opened (%s)\n", dst, strerror(errno));
+			return false;
+		}
+	}
+	else if (strncmp(dst, "METRICSFD:", 10) == 0){
+		fd = strtoul(&dst[10], NULL, 0);
+		if (fd <= 0 || -1 == fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK))
+			arcan_fatal("-O %s points to an invalid descriptor\n", dst);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+	}
+	else
+		return false;
+
+	m_metrics.fd = fd;
+	return true;
+}
+
 bool arcan_monitor_configure(int srate, const char* dst, FILE* ctrl)
 {
 	m_srate = srate;
@@ -200,7 +424,11 @@ bool arcan_monitor_configure(int srate, const char* dst, FILE* ctrl)
 	bool logfdtgt = dst ? strncmp(dst, "LOGFD:", 6) == 0 : false;
 
 	m_ctrl = ctrl;
-	setlinebuf(m_ctrl);
+	if (m_ctrl)
+		setlinebuf(m_ctrl);
+
+	if (dst && metrics_open(dst))
+		return true;
 
 	if (!logtgt && !logfdtgt)
 		return false;
@@ -249,6 +477,10 @@ void arcan_monitor_tick()
 		}
 	}
 
+/* a previous metrics snapshot might not have been written out completely */
+	if (m_metrics.buf)
+		metrics_flush();
+
 	if (m_srate <= 0)
 		return;
 
@@ -257,9 +489,14 @@ void arcan_monitor_tick()
 	if (m_ctr)
 		return;
 
+	m_ctr = m_srate;
+	if (-1 != m_metrics.fd){
+		metrics_sample();
+		return;
+	}
+
 	char buf[8];
 	snprintf(buf, 8, "%zu", count++);
-	m_ctr = m_srate;
 	arcan_lua_statesnap(m_out, buf, true);
 }
 
@@ -24,6 +24,14 @@ void arcan_monitor_watchdog(lua_State*, lua_Debug*);
  * call once, set periodic output monitoring destination:
  *  LOG:fname
  *  LOGFD:fd
+ *  METRICS:fname
+ *  METRICSFD:fd
+ *
+ * the METRICS forms switch the periodic sample from the VM state to an
+ * OpenMetrics text snapshot (frame/stage costs, object and store use, event
+ * queue depth, Lua memory and GC time, per frameserver frame age and queue
+ * depth) ending with '# EOF'. The descriptor is non-blocking, if a snapshot
+ * can't be written out before the next one is due that one is dropped.
  *
  * and possibly activate control interface (ctrl) that will be processed as
  * part of arcan_monitor_watchdog.
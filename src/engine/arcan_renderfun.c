@@ -12,6 +12,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <stddef.h>
 #include <math.h>
 #include <unistd.h>
@@ -36,6 +37,7 @@
 #define NO_ARCAN_SHMIF
 #include "../shmif/tui/raster/pixelfont.h"
 #include "../shmif/tui/raster/raster.h"
+#include "arcan_tuisym.h"
 #undef TTF_Font
 
 #include "arcan_renderfun.h"
@@ -59,6 +61,9 @@ struct font_entry {
 	size_t size;
 	float vdpi, hdpi;
 	uint8_t usecount;
+
+/* changes whenever the chain is (re-)opened, keys the glyph atlas */
+	uint32_t atlas_id;
 };
 
 struct text_format {
@@ -116,6 +121,7 @@ static unsigned int font_cache_size = ARCAN_FONT_CACHE_LIMIT;
 static struct tui_font builtin_bitmap;
 static struct font_entry font_cache[ARCAN_FONT_CACHE_LIMIT] = {
 };
+static uint32_t atlas_font_seq;
 
 static uint16_t nexthigher(uint16_t k)
 {
@@ -157,9 +163,17 @@ struct rcell {
 		} format;
 	} data;
 
+/* set instead of data.surf.buf when built for the glyph atlas */
+	struct atlas_run* glyphs;
+
+/* set if data.surf.buf is borrowed from the run cache */
+	struct text_run* run;
+
 	struct rcell* next;
 };
 
+static void run_evict(size_t budget);
+
 void arcan_video_fontdefaults(file_handle* fd, int* pt_sz, int* hint)
 {
 	if (fd)
@@ -344,6 +358,7 @@ static struct font_entry* grab_font(const char* fname, size_t size)
 	font_cache[i].vdpi = default_vdpi;
 	font_cache[i].hdpi = default_hdpi;
 	font_cache[i].chain = newch;
+	font_cache[i].atlas_id = ++atlas_font_seq;
 	font = &font_cache[i];
 
 done:
@@ -374,6 +389,7 @@ bool arcan_video_defaultfont(const char* ident,
 		font_cache[0].chain.data[0] = font;
 		font_cache[0].chain.fd[0] = fd;
 		font_cache[0].chain.count = 1;
+		font_cache[0].atlas_id = ++atlas_font_seq;
 		set_style(&last_style, &font_cache[0]);
 	}
 	else{
@@ -389,6 +405,7 @@ bool arcan_video_defaultfont(const char* ident,
 		font_cache[0].chain.count = dst_i;
 		font_cache[0].chain.fd[dst_i-1] = fd;
 		font_cache[0].chain.data[dst_i-1] = font;
+		font_cache[0].atlas_id = ++atlas_font_seq;
 	}
 
 	return true;
@@ -409,6 +426,9 @@ void arcan_video_reset_fontcache()
 		for (int i = 0; i < ARCAN_FONT_CACHE_LIMIT; i++)
 			zap_slot(i);
 	}
+
+/* the font ids are not reused, but there is no point in keeping the runs */
+	run_evict(0);
 }
 
 #ifndef TEXT_EMBEDDEDICON_MAXW
@@ -934,6 +954,423 @@ retry:
 #define CONST_MAX_SURFACEH 4096
 #endif
 
+/*
+ * Optional (video_text_atlas) glyph atlas. Each glyph is rastered once for
+ * a font/style/color combination into a shared store and text that only
+ * consists of cached glyphs can be drawn as a list of quads referencing it
+ * (arcan_renderfun_glyphs) instead of being rastered and uploaded on every
+ * change. Glyphs are packed in shelves and never evicted, when the atlas
+ * runs out of space, text falls back to the rasterizing path.
+ */
+#ifndef TEXT_ATLAS_SIZE
+#define TEXT_ATLAS_SIZE 1024
+#endif
+
+#ifndef TEXT_ATLAS_SLOTS
+#define TEXT_ATLAS_SLOTS 4096
+#endif
+
+struct atlas_glyph {
+	uint32_t font;
+	uint32_t cp;
+	uint32_t col;
+	int style;
+	int hint;
+	uint16_t x, y, w, h;
+	int advance;
+};
+
+struct atlas_run {
+	size_t count;
+	struct {
+		size_t ind;
+		int x;
+	} refs[];
+};
+
+static struct {
+	struct agp_vstore* store;
+	struct atlas_glyph glyphs[TEXT_ATLAS_SLOTS];
+	size_t used;
+	size_t shelf_x, shelf_y, shelf_h;
+	bool dirty;
+
+/* set while building a chain for the atlas, failed if any part didn't fit */
+	bool pass, failed;
+} text_atlas;
+
+static bool atlas_setup()
+{
+	if (text_atlas.store)
+		return true;
+
+	struct agp_vstore* vs = arcan_alloc_mem(sizeof(struct agp_vstore),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!vs)
+		return false;
+
+	size_t sz = TEXT_ATLAS_SIZE * TEXT_ATLAS_SIZE * sizeof(av_pixel);
+	vs->vinf.text.raw = arcan_alloc_mem(sz,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	if (!vs->vinf.text.raw){
+		arcan_mem_free(vs);
+		return false;
+	}
+
+/* same as render_alloc, BZERO on VBUFFER would give us FULLALPHA */
+	for (size_t i = 0; i < TEXT_ATLAS_SIZE * TEXT_ATLAS_SIZE; i++)
+		vs->vinf.text.raw[i] = 0;
+
+	vs->vinf.text.s_raw = sz;
+	vs->w = vs->h = TEXT_ATLAS_SIZE;
+	vs->txmapped = TXSTATE_TEX2D;
+	vs->txu = vs->txv = ARCAN_VTEX_CLAMP;
+	vs->scale = ARCAN_VIMAGE_NOPOW2;
+	vs->imageproc = IMAGEPROC_NORMAL;
+	vs->filtermode = ARCAN_VFILTER_NONE;
+	vs->refcount = 1;
+
+	text_atlas.store = vs;
+	text_atlas.shelf_x = text_atlas.shelf_y = text_atlas.shelf_h = 0;
+	text_atlas.dirty = true;
+	return true;
+}
+
+/* find or raster [cp] in the style, returns the slot or -1 if it won't fit */
+static ssize_t atlas_glyph(struct text_format* style, uint32_t cp)
+{
+	uint32_t col = RGBA(style->col[0], style->col[1], style->col[2], style->col[3]);
+	uint32_t font = style->font->atlas_id;
+
+	size_t ind = (((font * 31 + cp) * 31 + col) * 31 +
+		(uint32_t) style->style) % TEXT_ATLAS_SLOTS;
+	for (size_t i = 0; i < TEXT_ATLAS_SLOTS; i++, ind = (ind + 1) % TEXT_ATLAS_SLOTS){
+		struct atlas_glyph* g = &text_atlas.glyphs[ind];
+		if (!g->font)
+			break;
+
+		if (g->font == font && g->cp == cp && g->col == col &&
+			g->style == style->style && g->hint == default_hint)
+			return ind;
+	}
+
+/* keep the probe sequences short */
+	if (text_atlas.used >= TEXT_ATLAS_SLOTS * 3 / 4)
+		return -1;
+
+	int w, h;
+	uint32_t ucs4[2] = {cp, 0};
+	if (TTF_SizeUNICODEchain(style->font->chain.data,
+		style->font->chain.count, ucs4, &w, &h, style->style) || w < 0 || h <= 0)
+		return -1;
+
+/* next shelf? */
+	if (text_atlas.shelf_x + w > TEXT_ATLAS_SIZE){
+		text_atlas.shelf_y += text_atlas.shelf_h;
+		text_atlas.shelf_x = text_atlas.shelf_h = 0;
+	}
+
+	if (w > TEXT_ATLAS_SIZE || text_atlas.shelf_y + h > TEXT_ATLAS_SIZE)
+		return -1;
+
+	struct atlas_glyph* g = &text_atlas.glyphs[ind];
+	*g = (struct atlas_glyph){
+		.font = font,
+		.cp = cp,
+		.col = col,
+		.style = style->style,
+		.hint = default_hint,
+		.x = text_atlas.shelf_x,
+		.y = text_atlas.shelf_y,
+		.w = w,
+		.h = h
+	};
+
+	unsigned xstart = 0, prev = 0;
+	av_pixel* dst = &text_atlas.store->vinf.text.raw[
+		g->y * TEXT_ATLAS_SIZE + g->x];
+
+	TTF_RenderUNICODEglyph(dst, w, h, TEXT_ATLAS_SIZE,
+		style->font->chain.data, style->font->chain.count, cp,
+		&xstart, style->col, style->col, false, false, style->style,
+		&g->advance, &prev
+	);
+
+/* includes any bold overhang, matching how the run would be advanced */
+	g->advance += xstart;
+	text_atlas.dirty = true;
+
+/* leave a gap between glyphs so that filtering doesn't bleed */
+	text_atlas.shelf_x += w + 1;
+	if (h + 1 > text_atlas.shelf_h)
+		text_atlas.shelf_h = h + 1;
+
+	text_atlas.used++;
+	return ind;
+}
+
+/* the atlas equivalent of render_alloc, resolve each glyph of the run */
+static bool atlas_alloc(struct rcell* cnode,
+	const char* const base, struct text_format* style)
+{
+	if (!style->font || !style->font->atlas_id || !atlas_setup())
+		return false;
+
+	int w, h;
+	if (size_font_chain(style, base, &w, &h) || w <= 0 || h <= 0)
+		return false;
+
+	size_t len = strlen(base);
+	uint32_t ucs4[len+1];
+	UTF8_to_UTF32(ucs4, (const uint8_t* const) base, len);
+
+	size_t count = 0;
+	while (ucs4[count])
+		count++;
+
+	struct atlas_run* run = arcan_alloc_mem(sizeof(struct atlas_run) +
+		sizeof(run->refs[0]) * count, ARCAN_MEM_VSTRUCT,
+		ARCAN_MEM_TEMPORARY | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL
+	);
+	if (!run)
+		return false;
+
+	int x = 0;
+	run->count = 0;
+	for (size_t i = 0; i < count; i++){
+		ssize_t ind = atlas_glyph(style, ucs4[i]);
+		if (-1 == ind){
+			arcan_mem_free(run);
+			return false;
+		}
+
+		run->refs[run->count].ind = ind;
+		run->refs[run->count++].x = x;
+		x += text_atlas.glyphs[ind].advance;
+	}
+
+	cnode->glyphs = run;
+	cnode->data.surf.w = w;
+	cnode->data.surf.h = h;
+	cnode->ascent = style->ascent;
+	cnode->height = style->height;
+	cnode->descent = style->descent;
+	cnode->skipv = style->skip;
+
+	return true;
+}
+
+/*
+ * Optional (video_text_cache) cache of rastered runs. A run is the text between
+ * two format points rastered in one font, style and color, typically one line
+ * of a multi-line label. When only some lines of a block change, the others
+ * are neither sized nor rastered again but composed from the cached copies.
+ * The key has the font id (which changes when the font is re-opened, e.g. on
+ * size or density changes), style, color, hinting and the text. Runs that
+ * are not in use by a chain being built are evicted least recently used
+ * first once the cache is over budget.
+ */
+#ifndef TEXT_RUN_BUCKETS
+#define TEXT_RUN_BUCKETS 256
+#endif
+
+struct text_run {
+	uint64_t hash;
+	uint32_t font;
+	uint32_t col;
+	int style;
+	int hint;
+
+/* builtin bitmap font metrics, that font has no id */
+	size_t px_skip;
+	int px_h;
+
+	char* text;
+	size_t w, h;
+	av_pixel* buf;
+	int ascent, height, descent, skipv;
+
+	size_t refs;
+	struct text_run* next;
+	struct text_run* lru_prev;
+	struct text_run* lru_next;
+};
+
+static struct {
+	struct text_run* buckets[TEXT_RUN_BUCKETS];
+	struct text_run* lru_head;
+	struct text_run* lru_tail;
+	size_t budget;
+	size_t bytes;
+} text_runs;
+
+static uint64_t run_hash(struct text_format* style, const char* text)
+{
+	uint64_t hash = 0xcbf29ce484222325;
+	for (const uint8_t* cur = (const uint8_t*) text; *cur; cur++)
+		hash = (hash ^ *cur) * 0x100000001b3;
+
+	hash = (hash ^ (style->font ? style->font->atlas_id : 0)) * 0x100000001b3;
+	hash = (hash ^ (uint32_t) style->style) * 0x100000001b3;
+	return hash;
+}
+
+static bool run_match(struct text_run* run,
+	uint64_t hash, struct text_format* style, const char* text)
+{
+	uint32_t col = RGBA(style->col[0], style->col[1], style->col[2], style->col[3]);
+
+	if (run->hash != hash || run->col != col ||
+		run->style != style->style || run->hint != default_hint)
+		return false;
+
+	if (style->font){
+		if (run->font != style->font->atlas_id)
+			return false;
+	}
+	else if (run->font || run->px_skip != style->px_skip ||
+		run->px_h != style->height)
+		return false;
+
+	return strcmp(run->text, text) == 0;
+}
+
+static void run_unlink(struct text_run* run)
+{
+	if (run->lru_prev)
+		run->lru_prev->lru_next = run->lru_next;
+	else
+		text_runs.lru_head = run->lru_next;
+
+	if (run->lru_next)
+		run->lru_next->lru_prev = run->lru_prev;
+	else
+		text_runs.lru_tail = run->lru_prev;
+
+	run->lru_prev = run->lru_next = NULL;
+}
+
+static void run_touch(struct text_run* run)
+{
+	run_unlink(run);
+	run->lru_next = text_runs.lru_head;
+	if (text_runs.lru_head)
+		text_runs.lru_head->lru_prev = run;
+	text_runs.lru_head = run;
+	if (!text_runs.lru_tail)
+		text_runs.lru_tail = run;
+}
+
+static void run_free(struct text_run* run)
+{
+	struct text_run** prev = &text_runs.buckets[run->hash % TEXT_RUN_BUCKETS];
+	while (*prev && *prev != run)
+		prev = &(*prev)->next;
+	if (*prev)
+		*prev = run->next;
+
+	run_unlink(run);
+	text_runs.bytes -= run->w * run->h * sizeof(av_pixel);
+	arcan_mem_free(run->buf);
+	arcan_mem_free(run->text);
+	arcan_mem_free(run);
+}
+
+static void run_evict(size_t budget)
+{
+	struct text_run* cur = text_runs.lru_tail;
+	while (cur && text_runs.bytes > budget){
+		struct text_run* prev = cur->lru_prev;
+		if (!cur->refs)
+			run_free(cur);
+		cur = prev;
+	}
+}
+
+static struct text_run* run_lookup(struct text_format* style, const char* text)
+{
+	if (!text_runs.budget)
+		return NULL;
+
+	uint64_t hash = run_hash(style, text);
+	struct text_run* run = text_runs.buckets[hash % TEXT_RUN_BUCKETS];
+
+	for (; run; run = run->next)
+		if (run_match(run, hash, style, text)){
+			run_touch(run);
+			return run;
+		}
+
+	return NULL;
+}
+
+/* hand the rastered buffer of [cnode] over to a new cache entry */
+static void run_insert(
+	struct rcell* cnode, struct text_format* style, const char* text)
+{
+	size_t sz = cnode->data.surf.w * cnode->data.surf.h * sizeof(av_pixel);
+	if (!text_runs.budget || sz > text_runs.budget)
+		return;
+
+	struct text_run* run = arcan_alloc_mem(sizeof(struct text_run),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!run)
+		return;
+
+	run->text = strdup(text);
+	if (!run->text){
+		arcan_mem_free(run);
+		return;
+	}
+
+	run->hash = run_hash(style, text);
+	run->font = style->font ? style->font->atlas_id : 0;
+	run->col = RGBA(style->col[0], style->col[1], style->col[2], style->col[3]);
+	run->style = style->style;
+	run->hint = default_hint;
+	run->px_skip = style->font ? 0 : style->px_skip;
+	run->px_h = style->font ? 0 : style->height;
+	run->w = cnode->data.surf.w;
+	run->h = cnode->data.surf.h;
+	run->buf = cnode->data.surf.buf;
+	run->ascent = cnode->ascent;
+	run->height = cnode->height;
+	run->descent = cnode->descent;
+	run->skipv = cnode->skipv;
+	run->refs = 1;
+
+	size_t ind = run->hash % TEXT_RUN_BUCKETS;
+	run->next = text_runs.buckets[ind];
+	text_runs.buckets[ind] = run;
+	run_touch(run);
+	text_runs.bytes += sz;
+	cnode->run = run;
+
+	run_evict(text_runs.budget);
+}
+
+void arcan_renderfun_textcache(size_t bytes)
+{
+	text_runs.budget = bytes;
+	run_evict(bytes);
+}
+
+/* same as size_font_chain, but previously rastered runs are already sized */
+static int size_run(struct text_format* style, const char* base, int* w, int* h)
+{
+	struct text_run* run = run_lookup(style, base);
+	if (!run)
+		return size_font_chain(style, base, w, h);
+
+	*w = run->w;
+	*h = run->h;
+	return 0;
+}
+
 /* in arcan_ttf.c */
 static void draw_builtin(struct rcell* cnode,
 	const char* const base, struct text_format* style, int w, int h)
@@ -958,6 +1395,28 @@ static bool render_alloc(struct rcell* cnode,
 {
 	int w, h;
 
+	if (text_atlas.pass){
+		if (!atlas_alloc(cnode, base, style)){
+			text_atlas.failed = true;
+			return false;
+		}
+		return true;
+	}
+
+	struct text_run* run = run_lookup(style, base);
+	if (run){
+		run->refs++;
+		cnode->run = run;
+		cnode->data.surf.buf = run->buf;
+		cnode->data.surf.w = run->w;
+		cnode->data.surf.h = run->h;
+		cnode->ascent = run->ascent;
+		cnode->height = run->height;
+		cnode->descent = run->descent;
+		cnode->skipv = run->skipv;
+		return true;
+	}
+
 	if (size_font_chain(style, base, &w, &h)){
 		arcan_warning("arcan_video_renderstring(), couldn't size node.\n");
 		return false;
@@ -999,6 +1458,7 @@ static bool render_alloc(struct rcell* cnode,
 	cnode->height = style->height;
 	cnode->descent = style->descent;
 	cnode->skipv = style->skip;
+	run_insert(cnode, style, base);
 
 	return true;
 }
@@ -1009,7 +1469,7 @@ static inline void currstyle_cnode(struct text_format* curr_style,
 	if (sizeonly){
 		if (curr_style->font){
 			int dw, dh;
-			size_font_chain(curr_style, base, &dw, &dh);
+			size_run(curr_style, base, &dw, &dh);
 			cnode->ascent = TTF_FontAscent(curr_style->font->chain.data[0]);
 			cnode->width = dw;
 			cnode->descent = TTF_FontDescent(curr_style->font->chain.data[0]);
@@ -1022,8 +1482,10 @@ static inline void currstyle_cnode(struct text_format* curr_style,
 		return;
 	}
 
-/* image or render font */
+/* image or render font, embedded images are not covered by the atlas */
 	if (curr_style->surf.buf){
+		if (text_atlas.pass)
+			text_atlas.failed = true;
 		cnode->data.surf.buf = curr_style->surf.buf;
 		cnode->data.surf.w = curr_style->surf.w;
 		cnode->data.surf.h = curr_style->surf.h;
@@ -1041,9 +1503,9 @@ reset:
 
 static struct rcell* trystep(struct rcell* cnode, bool force)
 {
-	if (force || cnode->data.surf.buf)
+	if (force || cnode->data.surf.buf || cnode->glyphs)
 	cnode = cnode->next = arcan_alloc_mem(sizeof(struct rcell),
-		ARCAN_MEM_VSTRUCT, ARCAN_MEM_TEMPORARY | ARCAN_MEM_BZERO,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_FRAME | ARCAN_MEM_BZERO | ARCAN_MEM_SLAB,
 		ARCAN_MEMALIGN_NATURAL
 	);
 	return cnode;
@@ -1128,7 +1590,7 @@ static int build_textchain(char* message,
 	if (msglen) {
 		cnode->next = NULL;
 		if (sizeonly){
-			size_font_chain(curr_style, base, (int*) &cnode->width, (int*) &cnode->height);
+			size_run(curr_style, base, (int*) &cnode->width, (int*) &cnode->height);
 		}
 		else
 			render_alloc(cnode, base, curr_style);
@@ -1187,10 +1649,15 @@ static void cleanup_chain(struct rcell* root)
 {
 	while (root){
 		assert(root != (void*) 0xdeadbeef);
-		if (root->data.surf.buf){
+		if (root->run){
+			root->run->refs--;
+			root->data.surf.buf = NULL;
+		}
+		else if (root->data.surf.buf){
 			arcan_mem_free(root->data.surf.buf);
 			root->data.surf.buf = (void*) 0xfeedface;
 		}
+		arcan_mem_free(root->glyphs);
 
 		struct rcell* prev = root;
 		root = root->next;
@@ -1199,10 +1666,81 @@ static void cleanup_chain(struct rcell* root)
 	}
 }
 
+/*
+ * Translate the laid out chain into quads referencing the atlas, positions
+ * are in the pixel space of the text and texture coordinates in the atlas.
+ */
+static struct vobject_glyphs* atlas_list(
+	struct rcell* root, struct renderline_meta* lines)
+{
+	size_t count = 0;
+	for (struct rcell* cnode = root; cnode; cnode = cnode->next)
+		if (cnode->glyphs)
+			for (size_t i = 0; i < cnode->glyphs->count; i++)
+				count += text_atlas.glyphs[cnode->glyphs->refs[i].ind].w > 0;
+
+	struct vobject_glyphs* res = arcan_alloc_mem(
+		sizeof(struct vobject_glyphs) + sizeof(float) * 8 * count,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL
+	);
+	if (!res)
+		return NULL;
+
+	res->atlas = text_atlas.store;
+	res->count = 0;
+	res->verts = (float*)(res + 1);
+	res->txcos = res->verts + 4 * count;
+
+	const float step = 1.0f / (float) TEXT_ATLAS_SIZE;
+	int curw = 0;
+	int line = 0;
+
+	for (struct rcell* cnode = root; cnode; cnode = cnode->next){
+		if (cnode->glyphs){
+			for (size_t i = 0; i < cnode->glyphs->count; i++){
+				struct atlas_glyph* g = &text_atlas.glyphs[cnode->glyphs->refs[i].ind];
+				if (!g->w)
+					continue;
+
+				float* v = &res->verts[res->count * 4];
+				float* t = &res->txcos[res->count * 4];
+				v[0] = curw + cnode->glyphs->refs[i].x;
+				v[1] = lines[line].ystart;
+				v[2] = v[0] + g->w;
+				v[3] = v[1] + g->h;
+				t[0] = (float) g->x * step;
+				t[1] = (float) g->y * step;
+				t[2] = (float)(g->x + g->w) * step;
+				t[3] = (float)(g->y + g->h) * step;
+				res->count++;
+			}
+			curw += cnode->data.surf.w;
+		}
+		else if (!cnode->data.surf.buf){
+			if (cnode->data.format.tab > 0)
+				curw = get_tabofs(curw, cnode->data.format.tab, /* tab_spacing */ 0);
+
+			if (cnode->data.format.cr)
+				curw = 0;
+
+			if (cnode->data.format.newline > 0)
+				line += cnode->data.format.newline;
+		}
+	}
+
+	if (text_atlas.dirty){
+		agp_update_vstore(text_atlas.store, true);
+		text_atlas.dirty = false;
+	}
+
+	return res;
+}
+
 static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 	size_t chainlines, bool norender, bool pot,
 	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
-	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh)
+	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh,
+	struct vobject_glyphs** glyphs)
 {
 	struct rcell* cnode = root;
 	unsigned int linecount = 0;
@@ -1228,7 +1766,7 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 
 	while (cnode) {
 /* data node */
-		if (cnode->data.surf.buf) {
+		if (cnode->data.surf.buf || cnode->glyphs) {
 			if (!fixed_spacing)
 				line_spacing = cnode->skipv;
 
@@ -1285,6 +1823,24 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 	if (norender)
 		return (cleanup_chain(root), NULL);
 
+/* the atlas path only produces the quad list, the caller owns lines */
+	if (glyphs){
+		if (text_atlas.failed || !(*glyphs = atlas_list(root, lines))){
+			arcan_mem_free(lines);
+			return (cleanup_chain(root), NULL);
+		}
+
+		if (n_lines)
+			*n_lines = linecount;
+
+		if (lineheights)
+			*lineheights = lines;
+		else
+			arcan_mem_free(lines);
+
+		return (cleanup_chain(root), NULL);
+	}
+
 /* if we have a vobj set, re-use that backing store, and treat
  * it as a source-stream resize (so scaling factors etc. get reapplied) */
 
@@ -1352,13 +1908,14 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 	return (cleanup_chain(root), raw);
 }
 
-av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
+static av_pixel* fmtstr_extended(const char** msgarray,
 	arcan_vobj_id dstore, bool pot,
 	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
-	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh, bool norender)
+	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh, bool norender,
+	struct vobject_glyphs** glyphs)
 {
 	struct rcell* root = arcan_alloc_mem(sizeof(struct rcell),
-		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_FRAME | ARCAN_MEM_SLAB,
 		ARCAN_MEMALIGN_NATURAL
 	);
 	if (!root || !msgarray || !msgarray[0])
@@ -1379,7 +1936,8 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
 		}
 
 		if (ind % 2 == 0){
-			char* work = strdup(msgarray[ind]);
+			char* work = arcan_alloc_fillmem(msgarray[ind], strlen(msgarray[ind]) + 1,
+				ARCAN_MEM_STRINGBUF, ARCAN_MEM_FRAME, ARCAN_MEMALIGN_NATURAL);
 			int nlines = build_textchain(work, cur, false, true, ind == 0);
 			arcan_mem_free(work);
 			if (-1 == nlines)
@@ -1391,7 +1949,7 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
 /* %2+1, no format-string input, just treat as text */
 		else{
 			cur = cur->next = arcan_alloc_mem(sizeof(struct rcell),
-				ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
+				ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_FRAME | ARCAN_MEM_SLAB,
 				ARCAN_MEMALIGN_NATURAL
 			);
 			currstyle_cnode(&last_style, msgarray[ind], cur, false);
@@ -1402,22 +1960,31 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
 /* append newline */
 	cur = cur->next = arcan_alloc_mem(
 		sizeof(struct rcell), ARCAN_MEM_VSTRUCT,
-		ARCAN_MEM_TEMPORARY | ARCAN_MEM_BZERO,
+		ARCAN_MEM_FRAME | ARCAN_MEM_BZERO | ARCAN_MEM_SLAB,
 		ARCAN_MEMALIGN_NATURAL
 	);
 	cur->data.format.newline = 1;
 
 	return process_chain(root, arcan_video_getobject(dstore),
 		acc+1, norender, pot, n_lines,
-		lineheights, dw, dh, d_sz, maxw, maxh
+		lineheights, dw, dh, d_sz, maxw, maxh, glyphs
 	);
 }
 
-av_pixel* arcan_renderfun_renderfmtstr(const char* message,
+av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
+	arcan_vobj_id dstore, bool pot,
+	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
+	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh, bool norender)
+{
+	return fmtstr_extended(msgarray, dstore, pot, n_lines,
+		lineheights, dw, dh, d_sz, maxw, maxh, norender, NULL);
+}
+
+static av_pixel* fmtstr(const char* message,
 	arcan_vobj_id dstore,
 	bool pot, unsigned int* n_lines, struct renderline_meta** lineheights,
 	size_t* dw, size_t* dh, uint32_t* d_sz,
-	size_t* maxw, size_t* maxh, bool norender)
+	size_t* maxw, size_t* maxh, bool norender, struct vobject_glyphs** glyphs)
 {
 	if (!message)
 		return NULL;
@@ -1426,11 +1993,12 @@ av_pixel* arcan_renderfun_renderfmtstr(const char* message,
 
 /* (A) parse format string and build chains of renderblocks */
 	struct rcell* root = arcan_alloc_mem(sizeof(struct rcell),
-		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_FRAME | ARCAN_MEM_SLAB,
 		ARCAN_MEMALIGN_NATURAL
 	);
 
-	char* work = strdup(message);
+	char* work = arcan_alloc_fillmem(message, strlen(message) + 1,
+		ARCAN_MEM_STRINGBUF, ARCAN_MEM_FRAME, ARCAN_MEMALIGN_NATURAL);
 	last_style.newline = 0;
 	last_style.tab = 0;
 	last_style.cr = false;
@@ -1441,13 +2009,67 @@ av_pixel* arcan_renderfun_renderfmtstr(const char* message,
 	if (chainlines > 0){
 		raw = process_chain(root, arcan_video_getobject(dstore),
 			chainlines, norender, pot, n_lines, lineheights,
-			dw, dh, d_sz, maxw, maxh
+			dw, dh, d_sz, maxw, maxh, glyphs
 		);
 	}
+	else
+		cleanup_chain(root);
 
 	return raw;
 }
 
+av_pixel* arcan_renderfun_renderfmtstr(const char* message,
+	arcan_vobj_id dstore,
+	bool pot, unsigned int* n_lines, struct renderline_meta** lineheights,
+	size_t* dw, size_t* dh, uint32_t* d_sz,
+	size_t* maxw, size_t* maxh, bool norender)
+{
+	return fmtstr(message, dstore, pot, n_lines,
+		lineheights, dw, dh, d_sz, maxw, maxh, norender, NULL);
+}
+
+/* embedded images and vids (\\p, \\P, \\e, \\E) are never atlas eligible, check
+ * before building so that their loading isn't done twice on fallback */
+static bool has_embeds(const char* msg)
+{
+	for (; msg && *msg; msg++)
+		if (msg[0] == '\\' && msg[1] &&
+			(msg[1] == 'p' || msg[1] == 'P' || msg[1] == 'e' || msg[1] == 'E'))
+			return true;
+	return false;
+}
+
+struct vobject_glyphs* arcan_renderfun_glyphs(
+	const char* message, const char** msgarray,
+	unsigned int* n_lines, struct renderline_meta** lineheights,
+	size_t* maxw, size_t* maxh)
+{
+	if (msgarray){
+		for (size_t i = 0; msgarray[i]; i++)
+			if (i % 2 == 0 && has_embeds(msgarray[i]))
+				return NULL;
+	}
+	else if (!message || has_embeds(message))
+		return NULL;
+
+	size_t dw, dh;
+	uint32_t dsz;
+	struct vobject_glyphs* res = NULL;
+
+	text_atlas.pass = true;
+	text_atlas.failed = false;
+
+	if (message)
+		fmtstr(message, ARCAN_EID, false,
+			n_lines, lineheights, &dw, &dh, &dsz, maxw, maxh, false, &res);
+	else
+		fmtstr_extended(msgarray, ARCAN_EID, false,
+			n_lines, lineheights, &dw, &dh, &dsz, maxw, maxh, false, &res);
+
+	text_atlas.pass = false;
+	return res;
+}
+
 int arcan_renderfun_stretchblit(char* src, int inw, int inh,
 	uint32_t* dst, size_t dstw, size_t dsth, int flipv)
 {
@@ -1483,7 +2105,9 @@ struct arcan_renderfun_fontgroup {
 	float ppcm;
 	float size_mm;
 
-/* when adding atlas support, reference the internal font here instead */
+/* identity of the font in each of the slots the raster uses, keys state
+ * that can be shared with other groups (the tpack glyph atlas) */
+	uint64_t ident[4];
 };
 
 static void build_font_group(
@@ -1569,6 +2193,15 @@ static void set_font_slot(
 		return;
 	}
 
+/* taken before the descriptor is consumed, unique if there is no inode */
+	struct stat fs;
+	if (slot < COUNT_OF(grp->ident)){
+		if (-1 != fstat(fd, &fs))
+			grp->ident[slot] = ((uint64_t) fs.st_dev << 32) ^ (uint64_t) fs.st_ino;
+		else
+			grp->ident[slot] = ((uint64_t) 1 << 63) | ++atlas_font_seq;
+	}
+
 /* first check for a supported pixel font format, early-out on found/io error */
 	int pfstat = consume_pixel_font(grp, fd);
 	if (pfstat)
@@ -1729,6 +2362,618 @@ struct tui_raster_context*
 	return group->raster;
 }
 
+/*
+ * GPU path for TPACK (video_tpack_gpu). Instead of rastering into the client
+ * store, the cells are unpacked into a grid that is uploaded as a texture of
+ * three texels per cell:
+ *
+ *  [fg.rgb, attr] [bg.rgba] [slot lo, slot hi, attr_ext, -]
+ *
+ * where slot references a cell sized tile in a glyph atlas shared with every
+ * group that has the same fonts and cell size. The tiles are rastered once,
+ * white on black, and the shader uses them as coverage between fg and bg and
+ * adds lines, borders and cursor on its own. Updates then cost in proportion
+ * to the changed cells rather than the store size, and a font size change
+ * only swaps atlas.
+ *
+ * This is opt-in and the cpu raster stays the default. The fallback covers a
+ * shader that fails to build and a full atlas, but nothing compares what the
+ * shader draws (lines, borders, cursor, blending against bg) with what
+ * tui_raster produces for the same cells. Make it the default once such a
+ * comparison passes on both GL21 and GLES2.
+ */
+#ifndef TPACK_ATLAS_SIZE
+#define TPACK_ATLAS_SIZE 1024
+#endif
+
+struct tpack_atlas_ent {
+	uint32_t cp;
+	uint16_t style;
+	uint16_t slot;
+};
+
+struct tpack_atlas {
+	uint64_t key;
+	size_t refs;
+	struct tpack_atlas* next;
+
+	size_t cell_w, cell_h;
+	size_t per_row, n_slots, used;
+
+/* bumped on reset, users resolve all their cells again on mismatch */
+	uint64_t generation;
+
+	struct agp_vstore* store;
+	size_t dirty_y1, dirty_y2;
+
+	size_t map_sz;
+	struct tpack_atlas_ent* map;
+};
+
+struct tpack_gpu {
+	struct tpack_atlas* atlas;
+	uint64_t generation;
+
+/* grid contents are only usable after a full frame */
+	bool synched;
+
+	size_t cols, rows;
+	struct tui_raster_cell* cells;
+	struct agp_vstore* grid;
+
+	struct agp_rendertarget* rtgt;
+	struct agp_vstore* rtgt_store;
+	unsigned rtgt_glid;
+	size_t rtgt_w, rtgt_h;
+};
+
+static struct tpack_atlas* tpack_atlases;
+static agp_shader_id tpack_shader = BROKEN_SHADER;
+static bool tpack_shader_failed;
+
+static const char* tpack_fprg =
+"#ifdef GL_ES\n"
+"#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+"precision highp float;\n"
+"#else\n"
+"precision mediump float;\n"
+"#endif\n"
+"#endif\n"
+"uniform sampler2D map_tu0;\n"
+"uniform sampler2D map_tu1;\n"
+"uniform vec2 tp_grid;\n"
+"uniform vec2 tp_cell;\n"
+"uniform vec2 tp_out;\n"
+"uniform vec2 tp_atlas;\n"
+"uniform vec4 tp_cursor;\n"
+"uniform vec4 tp_pad;\n"
+"varying vec2 texco;\n"
+"float bit(float v, float b){\n"
+"	return mod(floor(v / b), 2.0);\n"
+"}\n"
+"void main(){\n"
+"	vec2 px = floor(texco * tp_out);\n"
+"	vec2 cell = floor(px / tp_cell);\n"
+"	if (cell.x >= tp_grid.x || cell.y >= tp_grid.y){\n"
+"		gl_FragColor = tp_pad;\n"
+"		return;\n"
+"	}\n"
+"	vec2 lp = px - cell * tp_cell;\n"
+"	float dx = 1.0 / (tp_grid.x * 3.0);\n"
+"	vec2 gp = vec2((cell.x * 3.0 + 0.5) * dx, (cell.y + 0.5) / tp_grid.y);\n"
+"	vec4 t0 = texture2D(map_tu0, gp);\n"
+"	vec4 bg = texture2D(map_tu0, gp + vec2(dx, 0.0));\n"
+"	vec4 t2 = texture2D(map_tu0, gp + vec2(2.0 * dx, 0.0));\n"
+"	vec4 fg = vec4(t0.rgb, 1.0);\n"
+"	vec4 cc = vec4(tp_cursor.rgb, 1.0);\n"
+"	float attr = floor(t0.a * 255.0 + 0.5);\n"
+"	float ext = floor(t2.b * 255.0 + 0.5);\n"
+"	float slot = floor(t2.r * 255.0 + 0.5) + 256.0 * floor(t2.g * 255.0 + 0.5);\n"
+"	bool cursor = bit(attr, 32.0) > 0.5;\n"
+"	if (cursor && tp_cursor.a == 1.0)\n"
+"		bg = cc;\n"
+"	vec2 ap = vec2(mod(slot, tp_atlas.x), floor(slot / tp_atlas.x));\n"
+"	ap = (ap * tp_cell + lp + 0.5) / tp_atlas.y;\n"
+"	vec4 col = mix(bg, fg, texture2D(map_tu1, ap).r);\n"
+"	if (slot > 0.0){\n"
+"		float n = floor(tp_cell.y * 0.05);\n"
+"		n = n - mod(n, 2.0) + 1.0;\n"
+"		float sy = floor(tp_cell.y / 2.0) - floor(n / 2.0);\n"
+"		if (bit(attr, 2.0) > 0.5 && lp.y >= tp_cell.y - n)\n"
+"			col = fg;\n"
+"		if (bit(attr, 16.0) > 0.5 && lp.y >= sy && lp.y < sy + n)\n"
+"			col = fg;\n"
+"	}\n"
+"	vec2 bw = vec2(min(floor((tp_cell.x + 15.0) / 16.0),\n"
+"		floor((tp_cell.y + 15.0) / 16.0)));\n"
+"	bool et = lp.y < bw.y;\n"
+"	bool ed = lp.y >= tp_cell.y - bw.y;\n"
+"	bool el = lp.x < bw.x;\n"
+"	bool er = lp.x >= tp_cell.x - bw.x;\n"
+"	if ((bit(ext, 32.0) > 0.5 && et) || (bit(ext, 8.0) > 0.5 && ed) ||\n"
+"		(bit(ext, 16.0) > 0.5 && el) || (bit(ext, 4.0) > 0.5 && er))\n"
+"		col = fg;\n"
+"	if (cursor && ((tp_cursor.a == 2.0 && ed) ||\n"
+"		(tp_cursor.a == 3.0 && (et || ed || el || er)) ||\n"
+"		(tp_cursor.a == 4.0 && el)))\n"
+"		col = cc;\n"
+"	gl_FragColor = col;\n"
+"}\n";
+
+static bool tpack_shader_ready()
+{
+	if (tpack_shader_failed)
+		return false;
+
+	if (agp_shader_valid(tpack_shader))
+		return true;
+
+	tpack_shader = agp_shader_build("tpack_gpu", NULL, NULL, tpack_fprg);
+	if (!agp_shader_valid(tpack_shader)){
+		arcan_warning("tpack_gpu: couldn't build shader, using cpu raster\n");
+		tpack_shader_failed = true;
+		return false;
+	}
+
+	return true;
+}
+
+/* same setup as the text atlas, the raw buffer is kept for partial updates */
+static struct agp_vstore* tpack_store(size_t w, size_t h)
+{
+	struct agp_vstore* vs = arcan_alloc_mem(sizeof(struct agp_vstore),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!vs)
+		return NULL;
+
+	size_t sz = w * h * sizeof(av_pixel);
+	vs->vinf.text.raw = arcan_alloc_mem(sz,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	if (!vs->vinf.text.raw){
+		arcan_mem_free(vs);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < w * h; i++)
+		vs->vinf.text.raw[i] = 0;
+
+	vs->vinf.text.s_raw = sz;
+	vs->w = w;
+	vs->h = h;
+	vs->txmapped = TXSTATE_TEX2D;
+	vs->txu = vs->txv = ARCAN_VTEX_CLAMP;
+	vs->scale = ARCAN_VIMAGE_NOPOW2;
+	vs->imageproc = IMAGEPROC_NORMAL;
+	vs->filtermode = ARCAN_VFILTER_NONE;
+	vs->refcount = 1;
+
+	return vs;
+}
+
+static void tpack_store_free(struct agp_vstore* vs)
+{
+	if (!vs)
+		return;
+
+	av_pixel* raw = vs->vinf.text.raw;
+	agp_drop_vstore(vs);
+	arcan_mem_free(raw);
+	arcan_mem_free(vs);
+}
+
+/* push rows [y1, y2) of the raw buffer */
+static void tpack_synch(struct agp_vstore* vs, size_t y1, size_t y2)
+{
+	if (y2 <= y1)
+		return;
+
+	if (!vs->vinf.text.glid || y2 - y1 == vs->h){
+		agp_update_vstore(vs, true);
+		return;
+	}
+
+	agp_stream_prepare(vs, (struct stream_meta){
+		.buf = vs->vinf.text.raw,
+		.dirty = true,
+		.x1 = 0, .y1 = y1, .w = vs->w, .h = y2 - y1
+	}, STREAM_RAW_DIRECT_SYNCHRONOUS);
+}
+
+static uint64_t tpack_atlas_key(struct arcan_renderfun_fontgroup* grp)
+{
+	size_t pt, px;
+	font_group_ptpx(grp, &pt, &px);
+
+	uint64_t val[] = {
+		grp->ident[0], grp->ident[1], grp->ident[2], grp->ident[3],
+		grp->font[0].vector, pt, px, grp->w, grp->h,
+		(uint64_t)(grp->ppcm * 1000.0f)
+	};
+
+	uint64_t key = 0xcbf29ce484222325;
+	const uint8_t* buf = (const uint8_t*) val;
+	for (size_t i = 0; i < sizeof(val); i++)
+		key = (key ^ buf[i]) * 0x100000001b3;
+
+	return key;
+}
+
+static void tpack_atlas_reset(struct tpack_atlas* atlas)
+{
+	memset(atlas->map, '\0', atlas->map_sz * sizeof(struct tpack_atlas_ent));
+
+/* slot 0 is the empty cell, which is all background */
+	atlas->used = 1;
+	atlas->generation++;
+}
+
+static struct tpack_atlas* tpack_atlas_acquire(uint64_t key, size_t cw, size_t ch)
+{
+	for (struct tpack_atlas* cur = tpack_atlases; cur; cur = cur->next)
+		if (cur->key == key){
+			cur->refs++;
+			return cur;
+		}
+
+	if (cw > TPACK_ATLAS_SIZE || ch > TPACK_ATLAS_SIZE)
+		return NULL;
+
+	struct tpack_atlas* atlas = arcan_alloc_mem(sizeof(struct tpack_atlas),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!atlas)
+		return NULL;
+
+	atlas->key = key;
+	atlas->refs = 1;
+	atlas->cell_w = cw;
+	atlas->cell_h = ch;
+	atlas->per_row = TPACK_ATLAS_SIZE / cw;
+
+/* the slot has to fit in two bytes of the grid texel */
+	atlas->n_slots = atlas->per_row * (TPACK_ATLAS_SIZE / ch);
+	if (atlas->n_slots > 65536)
+		atlas->n_slots = 65536;
+
+/* keep the probe sequences short */
+	atlas->map_sz = atlas->n_slots * 2;
+	atlas->map = arcan_alloc_mem(
+		atlas->map_sz * sizeof(struct tpack_atlas_ent), ARCAN_MEM_VSTRUCT,
+		ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL
+	);
+	atlas->store = tpack_store(TPACK_ATLAS_SIZE, TPACK_ATLAS_SIZE);
+
+	if (!atlas->map || !atlas->store){
+		arcan_mem_free(atlas->map);
+		tpack_store_free(atlas->store);
+		arcan_mem_free(atlas);
+		return NULL;
+	}
+
+	tpack_atlas_reset(atlas);
+	atlas->dirty_y1 = 0;
+	atlas->dirty_y2 = TPACK_ATLAS_SIZE;
+
+	atlas->next = tpack_atlases;
+	tpack_atlases = atlas;
+	return atlas;
+}
+
+static void tpack_atlas_release(struct tpack_atlas* atlas)
+{
+	if (!atlas || --atlas->refs)
+		return;
+
+	struct tpack_atlas** cur = &tpack_atlases;
+	while (*cur && *cur != atlas)
+		cur = &(*cur)->next;
+	if (*cur)
+		*cur = atlas->next;
+
+	tpack_store_free(atlas->store);
+	arcan_mem_free(atlas->map);
+	arcan_mem_free(atlas);
+}
+
+/* find or raster the tile for the glyph in [cell], -1 if the atlas is full */
+static ssize_t tpack_atlas_slot(struct tpack_atlas* atlas,
+	struct tui_raster_context* raster, struct tui_raster_cell* cell)
+{
+/* the rest of the attributes are drawn by the shader */
+	uint16_t style = (cell->attr & (CATTR_BOLD | CATTR_ITALIC)) |
+		((cell->attr_ext & (CEATTR_GLYPH_IND | CEATTR_AGLYPH_IND)) << 8);
+
+	size_t ind = ((size_t) cell->ucs4 * 31 + style) % atlas->map_sz;
+	for (size_t i = 0; i < atlas->map_sz; i++, ind = (ind + 1) % atlas->map_sz){
+		struct tpack_atlas_ent* ent = &atlas->map[ind];
+		if (!ent->slot)
+			break;
+
+		if (ent->cp == cell->ucs4 && ent->style == style)
+			return ent->slot;
+	}
+
+	if (atlas->used >= atlas->n_slots)
+		return -1;
+
+	size_t slot = atlas->used++;
+	atlas->map[ind] = (struct tpack_atlas_ent){
+		.cp = cell->ucs4,
+		.style = style,
+		.slot = slot
+	};
+
+	size_t x = (slot % atlas->per_row) * atlas->cell_w;
+	size_t y = (slot / atlas->per_row) * atlas->cell_h;
+
+	tui_raster_drawcell(raster, &(struct tui_raster_cell){
+			.fc = SHMIF_RGBA(0xff, 0xff, 0xff, 0xff),
+			.bc = SHMIF_RGBA(0x00, 0x00, 0x00, 0xff),
+			.ucs4 = cell->ucs4,
+			.attr = style & 0xff,
+			.attr_ext = style >> 8
+		},
+		&atlas->store->vinf.text.raw[y * TPACK_ATLAS_SIZE + x], TPACK_ATLAS_SIZE
+	);
+
+	if (y < atlas->dirty_y1)
+		atlas->dirty_y1 = y;
+	if (y + atlas->cell_h > atlas->dirty_y2)
+		atlas->dirty_y2 = y + atlas->cell_h;
+
+	return slot;
+}
+
+/* rebuild the grid texels for rows [y1, y2), false if the atlas ran out */
+static bool tpack_resolve(struct tpack_gpu* gpu,
+	struct tui_raster_context* raster, size_t y1, size_t y2)
+{
+	av_pixel* dst = gpu->grid->vinf.text.raw;
+
+	for (size_t y = y1; y < y2; y++)
+		for (size_t x = 0; x < gpu->cols; x++){
+			struct tui_raster_cell* cell = &gpu->cells[y * gpu->cols + x];
+			ssize_t slot = 0;
+			if (cell->ucs4 &&
+				-1 == (slot = tpack_atlas_slot(gpu->atlas, raster, cell)))
+				return false;
+
+			uint8_t r, g, b, a;
+			SHMIF_RGBA_DECOMP(cell->fc, &r, &g, &b, &a);
+
+			av_pixel* tx = &dst[(y * gpu->cols + x) * 3];
+			tx[0] = SHMIF_RGBA(r, g, b, cell->attr);
+			tx[1] = cell->bc;
+			tx[2] = SHMIF_RGBA(slot & 0xff, slot >> 8, cell->attr_ext, 0);
+		}
+
+	return true;
+}
+
+static bool tpack_grid(struct tpack_gpu* gpu, size_t cols, size_t rows)
+{
+	if (gpu->cols == cols && gpu->rows == rows && gpu->cells)
+		return true;
+
+	arcan_mem_free(gpu->cells);
+	tpack_store_free(gpu->grid);
+	gpu->synched = false;
+	gpu->cols = gpu->rows = 0;
+
+	gpu->cells = arcan_alloc_mem(sizeof(struct tui_raster_cell) * cols * rows,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	gpu->grid = tpack_store(cols * 3, rows);
+
+	if (!gpu->cells || !gpu->grid){
+		arcan_mem_free(gpu->cells);
+		tpack_store_free(gpu->grid);
+		gpu->cells = NULL;
+		gpu->grid = NULL;
+		return false;
+	}
+
+	gpu->cols = cols;
+	gpu->rows = rows;
+	return true;
+}
+
+/* (re-)bind the rendertarget, the store can be resized or swapped */
+static bool tpack_target(struct tpack_gpu* gpu, struct agp_vstore* dst, bool* new)
+{
+	if (gpu->rtgt && gpu->rtgt_store == dst &&
+		gpu->rtgt_glid == dst->vinf.text.glid &&
+		gpu->rtgt_w == dst->w && gpu->rtgt_h == dst->h)
+		return true;
+
+	agp_drop_rendertarget(gpu->rtgt);
+	gpu->rtgt = NULL;
+
+	if (!dst->vinf.text.glid ||
+		!(gpu->rtgt = agp_setup_rendertarget(dst, RENDERTARGET_COLOR)))
+		return false;
+
+	gpu->rtgt_store = dst;
+	gpu->rtgt_glid = dst->vinf.text.glid;
+	gpu->rtgt_w = dst->w;
+	gpu->rtgt_h = dst->h;
+	*new = true;
+	return true;
+}
+
+/* leaving the gpu path, bring the local copy up to date for the cpu raster */
+static int tpack_fallback(struct tpack_gpu* gpu, struct agp_vstore* dst)
+{
+	if (gpu->synched && gpu->rtgt && gpu->rtgt_store == dst)
+		agp_readback_synchronous(dst);
+
+	gpu->synched = false;
+	return 0;
+}
+
+int arcan_renderfun_tpack(struct arcan_renderfun_fontgroup* group,
+	struct tpack_gpu** state, struct agp_vstore* dst, uint8_t* buf, size_t buf_sz)
+{
+	struct tui_raster_context* raster = arcan_renderfun_fontraster(group);
+	if (!raster || !group->w || !group->h || !tpack_shader_ready())
+		return *state ? tpack_fallback(*state, dst) : 0;
+
+	struct tpack_gpu* gpu = *state;
+	if (!gpu){
+		gpu = arcan_alloc_mem(sizeof(struct tpack_gpu), ARCAN_MEM_VSTRUCT,
+			ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+		if (!gpu)
+			return 0;
+		*state = gpu;
+	}
+
+	size_t cols = dst->w / group->w;
+	size_t rows = dst->h / group->h;
+	if (!cols || !rows || !tpack_grid(gpu, cols, rows))
+		return tpack_fallback(gpu, dst);
+
+/* the atlas follows the fonts and the cell size */
+	bool redraw = false;
+	uint64_t key = tpack_atlas_key(group);
+	if (!gpu->atlas || gpu->atlas->key != key){
+		struct tpack_atlas* atlas = tpack_atlas_acquire(key, group->w, group->h);
+		if (!atlas)
+			return tpack_fallback(gpu, dst);
+
+		tpack_atlas_release(gpu->atlas);
+		gpu->atlas = atlas;
+		gpu->generation = atlas->generation - 1;
+		redraw = true;
+	}
+
+	size_t y1, y2;
+	av_pixel bgc;
+	int rv = tui_raster_cells(
+		raster, buf, buf_sz, gpu->cells, cols, rows, &y1, &y2, &bgc);
+	if (-1 == rv)
+		return -1;
+
+/* whatever the delta applies to isn't in the grid */
+	if (!rv && !gpu->synched)
+		return 0;
+
+	size_t ry1 = y1, ry2 = y2;
+	if (rv || gpu->generation != gpu->atlas->generation){
+		ry1 = 0;
+		ry2 = rows;
+	}
+
+/* a full atlas is started over, if it can't hold even this frame it is
+ * too small for the cell size */
+	if (!tpack_resolve(gpu, raster, ry1, ry2)){
+		tpack_atlas_reset(gpu->atlas);
+		ry1 = 0;
+		ry2 = rows;
+		if (!tpack_resolve(gpu, raster, ry1, ry2)){
+			arcan_warning("tpack_gpu: glyph atlas full, using cpu raster\n");
+			return tpack_fallback(gpu, dst);
+		}
+	}
+	gpu->generation = gpu->atlas->generation;
+
+	if (!tpack_target(gpu, dst, &redraw))
+		return tpack_fallback(gpu, dst);
+
+	tpack_synch(gpu->grid, ry1, ry2);
+	tpack_synch(gpu->atlas->store, gpu->atlas->dirty_y1, gpu->atlas->dirty_y2);
+	gpu->atlas->dirty_y1 = TPACK_ATLAS_SIZE;
+	gpu->atlas->dirty_y2 = 0;
+
+/* only the changed band, unless the pixels no longer match */
+	size_t py1 = y1 * group->h;
+	size_t py2 = y2 * group->h;
+	if (rv || redraw){
+		py1 = 0;
+		py2 = dst->h;
+	}
+	gpu->synched = true;
+
+	if (py2 <= py1)
+		return 1;
+
+	float proj[16];
+	build_orthographic_matrix(proj, 0, dst->w, 0, dst->h, 0, 1);
+
+	uint8_t cc[4];
+	av_pixel ccp;
+	int cs = tui_raster_cursor_state(raster, &ccp);
+	SHMIF_RGBA_DECOMP(ccp, &cc[0], &cc[1], &cc[2], &cc[3]);
+
+	uint8_t pad[4];
+	SHMIF_RGBA_DECOMP(bgc, &pad[0], &pad[1], &pad[2], &pad[3]);
+
+/* 0: none, 1: block, 2: under, 3: hollow, 4: bar - same priority as raster */
+	float mode = 0;
+	if (cs == (CURSOR_ACTIVE | CURSOR_BLOCK))
+		mode = 1;
+	else if (cs & CURSOR_UNDER)
+		mode = 2;
+	else if (cs & CURSOR_HOLLOW)
+		mode = 3;
+	else if (cs & CURSOR_BAR)
+		mode = 4;
+
+	float grid[2] = {cols, rows};
+	float cell[2] = {group->w, group->h};
+	float out[2] = {dst->w, dst->h};
+	float atlas[2] = {gpu->atlas->per_row, TPACK_ATLAS_SIZE};
+	float cursor[4] = {
+		(float) cc[0] / 255.0f, (float) cc[1] / 255.0f, (float) cc[2] / 255.0f, mode};
+	float padc[4] = {(float) pad[0] / 255.0f,
+		(float) pad[1] / 255.0f, (float) pad[2] / 255.0f, (float) pad[3] / 255.0f};
+
+	agp_activate_rendertarget(gpu->rtgt);
+	agp_shader_activate(tpack_shader);
+	agp_activate_vstore_multi(
+		(struct agp_vstore*[]){gpu->grid, gpu->atlas->store}, 2);
+	agp_shader_envv(PROJECTION_MATR, proj, sizeof(float) * 16);
+	agp_shader_forceunif("tp_grid", shdrvec2, grid);
+	agp_shader_forceunif("tp_cell", shdrvec2, cell);
+	agp_shader_forceunif("tp_out", shdrvec2, out);
+	agp_shader_forceunif("tp_atlas", shdrvec2, atlas);
+	agp_shader_forceunif("tp_cursor", shdrvec4, cursor);
+	agp_shader_forceunif("tp_pad", shdrvec4, padc);
+	agp_blendstate(BLEND_NONE);
+
+	float t1 = (float) py1 / (float) dst->h;
+	float t2 = (float) py2 / (float) dst->h;
+	agp_draw_vobj(0, py1, dst->w, py2,
+		(float[]){0, t1, 1, t1, 1, t2, 0, t2}, NULL);
+
+	agp_deactivate_vstore();
+	agp_activate_rendertarget(NULL);
+
+	dst->update_ts = arcan_timemillis();
+	return 1;
+}
+
+void arcan_renderfun_tpack_release(
+	struct tpack_gpu** state, struct agp_vstore* dst)
+{
+	struct tpack_gpu* gpu = *state;
+	if (!gpu)
+		return;
+
+	if (dst)
+		tpack_fallback(gpu, dst);
+
+	agp_drop_rendertarget(gpu->rtgt);
+	tpack_store_free(gpu->grid);
+	tpack_atlas_release(gpu->atlas);
+	arcan_mem_free(gpu->cells);
+	arcan_mem_free(gpu);
+	*state = NULL;
+}
+
 static void build_font_group(
 	struct arcan_renderfun_fontgroup* grp, int* fds, size_t n_fonts)
 {
@@ -81,6 +81,29 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** message,
 	size_t* maxw, size_t* maxh, bool norender
 );
 
+/*
+ * Lay out [message] (or the [msgarray] form of _extended) like renderfmtstr
+ * but as a list of quads referencing glyphs in a shared atlas store rather
+ * than a rastered buffer, see video_text_atlas. Returns NULL if the text
+ * can't be represented this way (embedded images, the builtin bitmap font,
+ * atlas out of space), the caller should then use renderfmtstr.
+ *
+ * The list is a single allocation to be freed with arcan_mem_free.
+ */
+struct vobject_glyphs;
+struct vobject_glyphs* arcan_renderfun_glyphs(
+	const char* message, const char** msgarray,
+	unsigned int* n_lines, struct renderline_meta** lineheights,
+	size_t* maxw, size_t* maxh);
+
+/*
+ * Set the number of bytes of rastered text runs (the text between format
+ * points, usually one line) that are kept around so that text which is
+ * rendered again with some lines unchanged only rasters the changed ones.
+ * 0 (default) disables the cache and drops what has been cached.
+ */
+void arcan_renderfun_textcache(size_t bytes);
+
 /*
  * set the video offset used for embedded rendering of vstores, this is
  * primarily used when there's a scripting- or similar context that remaps
@@ -170,3 +193,24 @@ void arcan_renderfun_release_fontgroup(struct arcan_renderfun_fontgroup* group);
  */
 struct tui_raster_context;
 struct tui_raster_context* arcan_renderfun_fontraster(struct arcan_renderfun_fontgroup*);
+
+/*
+ * Draw the TPACK contents of [buf] into [dst] on the GPU from a cell grid
+ * and a glyph atlas shared between groups with the same fonts and cell size.
+ * [state] is allocated on first use and kept by the caller between frames.
+ *
+ * Returns 1 if [dst] was updated, -1 on a malformed buffer and 0 if the
+ * frame should go through the CPU raster instead (no shader or atlas space,
+ * waiting for a full frame, ...). In that case the local copy in [dst] has
+ * been synched so that the raster can take over.
+ */
+struct tpack_gpu;
+int arcan_renderfun_tpack(struct arcan_renderfun_fontgroup* group,
+	struct tpack_gpu** state, struct agp_vstore* dst, uint8_t* buf, size_t buf_sz);
+
+/*
+ * Free [state], reading back into [dst] (if provided) so that its local copy
+ * reflects what the GPU path last drew.
+ */
+void arcan_renderfun_tpack_release(
+	struct tpack_gpu** state, struct agp_vstore* dst);
@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdatomic.h>
+#include <pthread.h>
 
 #include "arcan_math.h"
 #include "arcan_general.h"
@@ -17,30 +18,370 @@ bool arcan_trace_enabled = true;
 bool arcan_trace_enabled = false;
 #endif
 
+/*
+ * Each thread that marks gets its own SPSC byte ring (producer is the thread,
+ * consumer is whoever holds [flush_lock]) so workers (nbio, image loaders,
+ * frameserver nannies) can trace without contending on the collection buffer.
+ * Records are already in the packed buffer format (sans status byte) behind
+ * a length prefix, a 0 length means skip to the start of the ring. The rings
+ * are merged on flush by timestamp, which is CLOCK_MONOTONIC (arcan_timemicros)
+ * for all threads so the order holds across them.
+ *
+ * Rings are never freed, when a thread exits its ring is drained and then
+ * picked up by the next thread that starts to trace.
+ */
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE (256 * 1024)
+#endif
+
+enum ring_state {
+	RING_USED = 0,
+	RING_DEAD = 1,
+	RING_FREE = 2
+};
+
+struct trace_ring {
+	_Atomic size_t head;
+	_Atomic size_t tail;
+	_Atomic int state;
+	struct trace_ring* next;
+	uint8_t buf[TRACE_RING_SIZE];
+};
+
+static _Atomic(struct trace_ring*) rings;
+static _Thread_local struct trace_ring* local_ring;
+static pthread_key_t ring_key;
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* consumer side, only touched with [flush_lock] held */
 static uint8_t* buffer;
 static size_t buffer_sz;
 static size_t buffer_pos;
 static bool* buffer_flag;
+static pthread_t buffer_owner;
+static _Atomic bool collecting;
+
+/* startup phases are timed before any collection can be set up, they are
+ * kept here and replayed at the start of the first one */
+#ifndef TRACE_STARTUP_LIMIT
+#define TRACE_STARTUP_LIMIT 32
+#endif
+
+static struct {
+	const char* subsys;
+	uint64_t start, end;
+} startup[TRACE_STARTUP_LIMIT];
+static size_t startup_count;
+
+static void trace_append(uint64_t ts, uint8_t trigger, uint8_t tracelevel,
+	uint64_t ident, uint32_t quant, const char* sys, const char* subsys,
+	const char* message, size_t msg_len);
+
+static void ring_release(void* ring)
+{
+	atomic_store(&((struct trace_ring*)ring)->state, RING_DEAD);
+}
+
+static void ring_init()
+{
+	pthread_key_create(&ring_key, ring_release);
+}
+
+static struct trace_ring* get_ring()
+{
+	if (local_ring)
+		return local_ring;
+
+	pthread_once(&ring_once, ring_init);
+
+/* reuse the ring of a thread that has exited and been drained */
+	for (struct trace_ring* cur = atomic_load(&rings); cur; cur = cur->next){
+		int state = RING_FREE;
+		if (atomic_compare_exchange_strong(&cur->state, &state, RING_USED)){
+			local_ring = cur;
+			break;
+		}
+	}
+
+	if (!local_ring){
+		struct trace_ring* ring = malloc(sizeof(struct trace_ring));
+		if (!ring)
+			return NULL;
+
+		atomic_init(&ring->head, 0);
+		atomic_init(&ring->tail, 0);
+		atomic_init(&ring->state, RING_USED);
+
+		ring->next = atomic_load(&rings);
+		while (!atomic_compare_exchange_weak(&rings, &ring->next, ring)){}
+		local_ring = ring;
+	}
+
+	pthread_setspecific(ring_key, local_ring);
+	return local_ring;
+}
+
+/* producer side, [len] bytes are written at the returned pointer and then
+ * published with ring_commit, NULL if the ring is full (the record is lost) */
+static uint8_t* ring_reserve(struct trace_ring* ring, size_t len, size_t* step)
+{
+	size_t tot = (sizeof(uint32_t) + len + 7) & ~(size_t)7;
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	size_t ofs = head % TRACE_RING_SIZE;
+
+/* doesn't fit before the end, pad to the start */
+	size_t pad = TRACE_RING_SIZE - ofs < tot ? TRACE_RING_SIZE - ofs : 0;
+	if (tot + pad > TRACE_RING_SIZE - (head - tail))
+		return NULL;
+
+	if (pad){
+		if (pad >= sizeof(uint32_t))
+			memset(&ring->buf[ofs], '\0', sizeof(uint32_t));
+		ofs = 0;
+	}
+
+	uint32_t len32 = len;
+	memcpy(&ring->buf[ofs], &len32, sizeof(uint32_t));
+	*step = tot + pad;
+	return &ring->buf[ofs + sizeof(uint32_t)];
+}
+
+static void ring_commit(struct trace_ring* ring, size_t step)
+{
+	atomic_fetch_add_explicit(&ring->head, step, memory_order_release);
+}
+
+/* consumer side, the next record in the ring (without consuming it) */
+static uint8_t* ring_peek(struct trace_ring* ring, size_t* len)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	while (tail != head){
+		size_t ofs = tail % TRACE_RING_SIZE;
+		uint32_t len32 = 0;
+		if (TRACE_RING_SIZE - ofs >= sizeof(uint32_t))
+			memcpy(&len32, &ring->buf[ofs], sizeof(uint32_t));
+
+		if (len32){
+			*len = len32;
+			return &ring->buf[ofs + sizeof(uint32_t)];
+		}
+
+		tail += TRACE_RING_SIZE - ofs;
+		atomic_store_explicit(&ring->tail, tail, memory_order_release);
+	}
+
+	return NULL;
+}
+
+static void ring_consume(struct trace_ring* ring, size_t len)
+{
+	size_t tot = (sizeof(uint32_t) + len + 7) & ~(size_t)7;
+	atomic_fetch_add_explicit(&ring->tail, tot, memory_order_release);
+}
+
+static void ring_drop(struct trace_ring* ring)
+{
+	size_t len;
+	while (ring_peek(ring, &len))
+		ring_consume(ring, len);
+}
+
+static void buffer_finish()
+{
+	if (buffer_flag)
+		*buffer_flag = true;
+	buffer = NULL;
+	buffer_flag = NULL;
+	buffer_pos = 0;
+	atomic_store(&collecting, false);
+	#ifndef WITH_TRACE
+	arcan_trace_enabled = false;
+	#endif
+}
+
+/* [flush_lock] held, merge the rings into the buffer oldest record first */
+static void flush_locked()
+{
+	for(;;){
+		struct trace_ring* best = NULL;
+		uint8_t* best_rec = NULL;
+		size_t best_len = 0;
+		uint64_t best_ts = UINT64_MAX;
+
+		for (struct trace_ring* cur = atomic_load(&rings); cur; cur = cur->next){
+			size_t len;
+			uint8_t* rec = ring_peek(cur, &len);
+
+			if (!rec){
+				int state = RING_DEAD;
+				atomic_compare_exchange_strong(&cur->state, &state, RING_FREE);
+				continue;
+			}
+
+			uint64_t ts;
+			memcpy(&ts, rec, sizeof(ts));
+			if (ts < best_ts){
+				best = cur;
+				best_rec = rec;
+				best_len = len;
+				best_ts = ts;
+			}
+		}
+
+		if (!best)
+			return;
+
+		if (!buffer){
+			ring_consume(best, best_len);
+			continue;
+		}
+
+/* tight packing format, valid- mark (0xff) then the record, when we reach
+ * the end mark the rest invalid (0xaa), set finish_flag and stop collecting,
+ * there is always room left for that mark */
+		if (buffer_sz - buffer_pos < best_len + 2){
+			buffer[buffer_pos] = 0xaa;
+			buffer_finish();
+			continue;
+		}
+
+		memcpy(&buffer[buffer_pos + 1], best_rec, best_len);
+		buffer[buffer_pos] = 0xff;
+		buffer_pos += best_len + 1;
+		ring_consume(best, best_len);
+	}
+}
+
+void arcan_trace_flush()
+{
+	pthread_mutex_lock(&flush_lock);
+	flush_locked();
+	pthread_mutex_unlock(&flush_lock);
+}
 
 void arcan_trace_setbuffer(uint8_t* buf, size_t buf_sz, bool* finish_flag)
 {
+	pthread_mutex_lock(&flush_lock);
+
+	if (buffer)
+		flush_locked();
+
 	if (buffer){
-		*buffer_flag = true;
-		buffer = NULL;
-		buffer_flag = NULL;
-		buffer_pos = 0;
-		#ifndef WITH_TRACE
-		arcan_trace_enabled = false;
-		#endif
+		buffer[buffer_pos] = 0xaa;
+		buffer_finish();
 	}
 
-	if (!buf || !buf_sz)
+	if (!buf || !buf_sz){
+		pthread_mutex_unlock(&flush_lock);
 		return;
+	}
+
+/* anything queued from before doesn't belong to this collection */
+	for (struct trace_ring* cur = atomic_load(&rings); cur; cur = cur->next)
+		ring_drop(cur);
 
 	buffer = buf;
 	buffer_flag = finish_flag;
 	buffer_sz = buf_sz;
+	buffer_pos = 0;
+	buffer_owner = pthread_self();
+	atomic_store(&collecting, true);
 	arcan_trace_enabled = true;
+
+	size_t n_startup = startup_count;
+	startup_count = 0;
+	pthread_mutex_unlock(&flush_lock);
+
+/* the timestamps are older than anything else so the merge puts them first */
+	for (size_t i = 0; i < n_startup; i++){
+		trace_append(startup[i].start, 1, TRACE_SYS_DEFAULT,
+			0, 0, "startup", startup[i].subsys, NULL, 0);
+		trace_append(startup[i].end, 2, TRACE_SYS_DEFAULT,
+			0, (uint32_t)(startup[i].end - startup[i].start),
+			"startup", startup[i].subsys, NULL, 0);
+	}
+}
+
+void arcan_trace_startup(const char* subsys, uint64_t start, uint64_t end)
+{
+	pthread_mutex_lock(&flush_lock);
+	if (startup_count < TRACE_STARTUP_LIMIT){
+		startup[startup_count].subsys = subsys;
+		startup[startup_count].start = start;
+		startup[startup_count].end = end;
+		startup_count++;
+	}
+	pthread_mutex_unlock(&flush_lock);
+}
+
+static void trace_append(uint64_t ts, uint8_t trigger, uint8_t tracelevel,
+	uint64_t ident, uint32_t quant, const char* sys, const char* subsys,
+	const char* message, size_t msg_len)
+{
+	struct trace_ring* ring = get_ring();
+	if (!ring)
+		return;
+
+	size_t sys_len = strlen(sys) + 1;
+	size_t subsys_len = strlen(subsys) + 1;
+	size_t tot =
+		8 /* timestamp */   +
+		1 /* trigger */     +
+		1 /* trace level */ +
+		8 /* identifier */  +
+		4 /* quantifier */  +
+		sys_len + subsys_len + msg_len + 1;
+
+	size_t step;
+	uint8_t* dst = ring_reserve(ring, tot, &step);
+	if (!dst)
+		return;
+
+	size_t pos = 0;
+
+/* timestamp */
+	if (!ts)
+		ts = arcan_timemicros();
+	memcpy(&dst[pos], &ts, sizeof(ts));
+	pos += sizeof(ts);
+
+/* sys / subsys */
+	memcpy(&dst[pos], sys, sys_len);
+	pos += sys_len;
+	memcpy(&dst[pos], subsys, subsys_len);
+	pos += subsys_len;
+
+/* trigger */
+	dst[pos++] = trigger;
+
+/* tracelevel */
+	dst[pos++] = tracelevel;
+
+/* identifier */
+	memcpy(&dst[pos], &ident, 8);
+	pos += 8;
+
+/* quantifier */
+	memcpy(&dst[pos], &quant, 4);
+	pos += 4;
+
+/* message */
+	if (msg_len)
+		memcpy(&dst[pos], message, msg_len);
+	dst[pos + msg_len] = '\0';
+
+	ring_commit(ring, step);
+
+/* the collecting thread merges once its own ring is getting full, for the
+ * others it happens on the next arcan_trace_flush */
+	if (atomic_load_explicit(&ring->head, memory_order_relaxed) -
+		atomic_load_explicit(&ring->tail, memory_order_relaxed) > TRACE_RING_SIZE / 2 &&
+		pthread_equal(buffer_owner, pthread_self()))
+		arcan_trace_flush();
 }
 
 void arcan_trace_log(const char* message, size_t len)
@@ -51,11 +392,11 @@ void arcan_trace_log(const char* message, size_t len)
 #ifdef WITH_TRACY
 	TracyCMessage(message, len);
 #else
-	for (int i=0; i < len; i++) {
-		if (buffer_pos == buffer_sz)
-			return;
-		buffer[buffer_pos + i] = message[i];
-	}
+	if (!atomic_load(&collecting) || !message)
+		return;
+
+	size_t msg_len = strnlen(message, len);
+	trace_append(0, 0, TRACE_SYS_DEFAULT, 0, 0, "trace", "log", message, msg_len);
 #endif
 }
 
@@ -261,75 +602,11 @@ void arcan_trace_mark(
 	};
 	#endif
 
-	if (!buffer)
+	if (!atomic_load(&collecting))
 		return;
 
-	size_t start_ofs = buffer_pos;
-
-	size_t sys_len = strlen(sys) + 1;
-	size_t subsys_len = strlen(subsys) + 1;
-	size_t msg_len = message ? strlen(message) + 1 : 1;
-	size_t tot =
-		1 /* ok marker */   +
-		8 /* timestamp */   +
-		1 /* trigger */     +
-		1 /* trace level */ +
-		8 /* identifier */  +
-		4 /* quantifier */  +
-		sys_len + subsys_len + msg_len;
-
-/* tight packing format, valid- mark (0xaa) then arguments in each order,
- * when we reach end, write eos mark (0xff), set finish_flag and disable
- * tracing - rough safety check first before doing anything */
-	if (buffer_sz - buffer_pos < tot)
-		goto fail_short;
-
-/* ok marker */
-	buffer_pos++;
-
-/* timestamp */
-	uint64_t ts = arcan_timemicros();
-	memcpy(&buffer[buffer_pos], &ts, sizeof(ts));
-	buffer_pos += sizeof(ts);
-
-/* sys / subsys */
-	memcpy(&buffer[buffer_pos], sys, sys_len);
-	buffer_pos += sys_len;
-	memcpy(&buffer[buffer_pos], subsys, subsys_len);
-	buffer_pos += subsys_len;
-
-/* trigger */
-	memcpy(&buffer[buffer_pos], &trigger, 1);
-	buffer_pos += 1;
-
-/* tracelevel */
-	memcpy(&buffer[buffer_pos], &tracelevel, 1);
-	buffer_pos += 1;
-
-/* identifier */
-	memcpy(&buffer[buffer_pos], &ident, 8);
-	buffer_pos += 8;
-
-/* quantifier */
-	memcpy(&buffer[buffer_pos], &quant, 4);
-	buffer_pos += 4;
-
-/* message */
-	if (message){
-		memcpy(&buffer[buffer_pos], message, msg_len);
-		buffer_pos += msg_len;
-	}
-	else {
-		buffer[buffer_pos++] = '\0';
-	}
-
-/* mark sample as completed */
-	buffer[start_ofs] = 0xff;
-	return;
-
-fail_short:
-	*buffer_flag = true;
-	buffer[start_ofs] = 0xaa;
+	trace_append(0, trigger, tracelevel, ident, quant,
+		sys, subsys, message, message ? strlen(message) : 0);
 }
 
 void arcan_trace_close()
@@ -43,6 +43,21 @@
 
 #include "external/stb_image_resize.h"
 
+/* vector versions of the glyph blits, selected at runtime in TTF_Init */
+#ifndef TTF_NO_SIMD
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define TTF_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TTF_SIMD_NEON
+#if defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+#endif
+
 #include "arcan_math.h"
 #include "arcan_general.h"
 #include "arcan_shmif.h"
@@ -123,6 +138,8 @@ struct _TTF_Font {
 	/* For non-scalable formats, we must remember which font index size */
 	int font_size_family;
 	int ptsize;
+	uint16_t hdpi;
+	uint16_t vdpi;
 
 	/* really just flags passed into FT_Load_Glyph */
 	int hinting;
@@ -409,6 +426,8 @@ static void TTF_SetFTError(const char *msg, FT_Error error)
 #endif /* USE_FREETYPE_ERRORS */
 }
 
+static void blit_select();
+
 int TTF_Init( void )
 {
 	int status = 0;
@@ -424,6 +443,7 @@ int TTF_Init( void )
 			static unsigned char gweights[] = {0x1a, 0x43, 0x56, 0x43, 0x1a};
 			FT_Library_SetLcdFilterWeights(library, gweights);
 		}
+		blit_select();
 	}
 	if ( status == 0 ) {
 		++TTF_initialized;
@@ -442,6 +462,24 @@ static unsigned long ft_read(FT_Stream stream, unsigned long ofs,
 	return fread(buf, 1, count, fpek);
 }
 
+/* used by forked fonts, the descriptor is a dup and shares the file offset
+ * with the original so reads need to be positional */
+static unsigned long ft_pread(FT_Stream stream, unsigned long ofs,
+	unsigned char* buf, unsigned long count)
+{
+	FILE* fpek = stream->descriptor.pointer;
+	unsigned long pos = 0;
+
+	while (pos < count){
+		ssize_t nr = pread(fileno(fpek), &buf[pos], count - pos, ofs + pos);
+		if (nr <= 0)
+			break;
+		pos += nr;
+	}
+
+	return pos;
+}
+
 static int ft_sizeind(FT_Face face, float ys)
 {
 	FT_Pos tgt = ys, em = 0;
@@ -545,6 +583,8 @@ TTF_Font* TTF_OpenFontIndexRW( FILE* src, int freesrc, int ptsize,
 	font->args.flags = FT_OPEN_STREAM;
 	font->args.stream = stream;
 	font->ptsize = ptsize;
+	font->hdpi = hdpi;
+	font->vdpi = vdpi;
 
 	error = FT_Open_Face( library, &font->args, index, &font->face );
 	if( error ) {
@@ -749,6 +789,37 @@ TTF_Font* TTF_OpenFontFD(int fd,
 	return res;
 }
 
+TTF_Font* TTF_ForkFont(TTF_Font* font_ref, int style)
+{
+	if (!font_ref || !font_ref->font || !font_ref->font->src)
+		return NULL;
+
+	struct _TTF_Font* src = font_ref->font;
+	int nfd = arcan_shmif_dupfd(fileno(src->src), -1, true);
+	if (-1 == nfd)
+		return NULL;
+
+	FILE* fstream = fdopen(nfd, "r");
+	if (!fstream){
+		close(nfd);
+		return NULL;
+	}
+
+/* opened outside of the cache so nothing about the face is shared */
+	fseek(fstream, 0, SEEK_SET);
+	TTF_Font* res = TTF_OpenFontIndexRW(fstream, 1,
+		src->ptsize, src->hdpi, src->vdpi, src->face->face_index);
+	if (!res)
+		return NULL;
+
+	res->font->args.stream->read = ft_pread;
+	res->font->hinting = src->hinting;
+	res->font->kerning = src->kerning;
+	TTF_SetFontStyle(res, style);
+
+	return res;
+}
+
 static void Flush_Glyph( c_glyph* glyph )
 {
 	glyph->stored = 0;
@@ -1637,18 +1708,374 @@ static inline av_pixel pack_subpx(uint8_t fg[4],
 		return PACK(fg[0], fg[1], fg[2], 0xff);
 }
 
+/*
+ * Row versions of the blits above. The vector kernels work on the packed
+ * pixel with one lane per channel so they don't care about the channel order
+ * of PACK, only that alpha is in the top byte, and are exact to the scalar
+ * ones. Subpixel coverage is gathered into PACK(r, g, b, (r+g+b)/3) first as
+ * the LCD and LCD_V source layouts differ.
+ */
+static void blit_gray(PIXEL* out, const uint8_t* cov,
+	size_t n, uint8_t fg[4], uint8_t bg[4], bool usebg)
+{
+	for (size_t i = 0; i < n; i++, out++){
+		if (usebg)
+			*out = pack_pixel_bg(fg, bg, cov[i]);
+		else if (cov[i])
+			*out = pack_pixel(fg, cov[i]);
+	}
+}
+
+static void blit_subpx(PIXEL* out, const PIXEL* cov,
+	size_t n, uint8_t fg[4], uint8_t bg[4], bool usebg)
+{
+	for (size_t i = 0; i < n; i++, out++){
+		uint8_t r = cov[i] >> __builtin_ctz(PACK(0xff, 0, 0, 0));
+		uint8_t g = cov[i] >> __builtin_ctz(PACK(0, 0xff, 0, 0));
+		uint8_t b = cov[i] >> __builtin_ctz(PACK(0, 0, 0xff, 0));
+
+		if (usebg)
+			*out = pack_subpx_bg(fg, bg, r, g, b);
+		else if (b|g|r)
+			*out = pack_subpx(fg, r, g, b);
+	}
+}
+
+static void blit_fill(PIXEL* out, PIXEL clr, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = clr;
+}
+
+#ifdef TTF_SIMD_SSE2
+#define SSE2_FN __attribute__((target("sse2")))
+
+/* (0x80 + a * f + (255 - a) * b) / 255 in 16-bit lanes */
+static inline SSE2_FN __m128i sse2_blend(__m128i a, __m128i f, __m128i b)
+{
+	__m128i t = _mm_add_epi16(
+		_mm_add_epi16(_mm_mullo_epi16(a, f),
+			_mm_mullo_epi16(_mm_sub_epi16(_mm_set1_epi16(255), a), b)),
+		_mm_set1_epi16(0x80)
+	);
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+/* the alpha selection of pack_pixel_bg for [a] in 32-bit lanes */
+static inline SSE2_FN __m128i sse2_bgalpha(__m128i a, uint8_t bga)
+{
+	__m128i lt = _mm_cmplt_epi32(a, _mm_set1_epi32(2 * bga));
+	__m128i full = _mm_cmpeq_epi32(a, _mm_set1_epi32(255));
+	__m128i av = _mm_or_si128(
+		_mm_and_si128(lt, _mm_set1_epi32(bga)), _mm_andnot_si128(lt, a));
+	av = _mm_or_si128(full, av);
+	return _mm_slli_epi32(av, 24);
+}
+
+/* (0x80 + c * f) / 255 in 16-bit lanes */
+static inline SSE2_FN __m128i sse2_mul(__m128i c, __m128i f)
+{
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(c, f), _mm_set1_epi16(0x80));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static SSE2_FN void blit_gray_sse2(PIXEL* out, const uint8_t* cov,
+	size_t n, uint8_t fg[4], uint8_t bg[4], bool usebg)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rgb = _mm_set1_epi32(0x00ffffff);
+	const __m128i fgp = _mm_set1_epi32(PACK(fg[0], fg[1], fg[2], 0));
+	const __m128i fg16 = _mm_unpacklo_epi8(fgp, zero);
+	const __m128i bg16 = _mm_unpacklo_epi8(
+		_mm_set1_epi32(PACK(bg[0], bg[1], bg[2], 0)), zero);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		uint32_t c4;
+		memcpy(&c4, &cov[i], 4);
+		__m128i c = _mm_cvtsi32_si128(c4);
+		__m128i a32 = _mm_unpacklo_epi16(_mm_unpacklo_epi8(c, zero), zero);
+		__m128i dst = _mm_loadu_si128((__m128i*) &out[i]);
+		__m128i res;
+
+		if (usebg){
+			__m128i ab = _mm_unpacklo_epi16(
+				_mm_unpacklo_epi8(c, c), _mm_unpacklo_epi8(c, c));
+			res = _mm_packus_epi16(
+				sse2_blend(_mm_unpacklo_epi8(ab, zero), fg16, bg16),
+				sse2_blend(_mm_unpackhi_epi8(ab, zero), fg16, bg16)
+			);
+			res = _mm_or_si128(_mm_and_si128(res, rgb), sse2_bgalpha(a32, bg[3]));
+		}
+		else {
+			__m128i skip = _mm_cmpeq_epi32(a32, zero);
+			res = _mm_or_si128(fgp, _mm_slli_epi32(a32, 24));
+			res = _mm_or_si128(
+				_mm_and_si128(skip, dst), _mm_andnot_si128(skip, res));
+		}
+
+		_mm_storeu_si128((__m128i*) &out[i], res);
+	}
+
+	blit_gray(&out[i], &cov[i], n - i, fg, bg, usebg);
+}
+
+static SSE2_FN void blit_subpx_sse2(PIXEL* out, const PIXEL* cov,
+	size_t n, uint8_t fg[4], uint8_t bg[4], bool usebg)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rgb = _mm_set1_epi32(0x00ffffff);
+	const __m128i fg16 = _mm_unpacklo_epi8(
+		_mm_set1_epi32(PACK(fg[0], fg[1], fg[2], 0)), zero);
+	const __m128i bg16 = _mm_unpacklo_epi8(
+		_mm_set1_epi32(PACK(bg[0], bg[1], bg[2], 0)), zero);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		__m128i c = _mm_loadu_si128((__m128i*) &cov[i]);
+		__m128i a32 = _mm_srli_epi32(c, 24);
+		__m128i lo = sse2_mul(_mm_unpacklo_epi8(c, zero), fg16);
+		__m128i hi = sse2_mul(_mm_unpackhi_epi8(c, zero), fg16);
+		__m128i res;
+
+		if (usebg){
+/* broadcast the alpha lane of each pixel */
+			__m128i alo = _mm_unpacklo_epi8(c, zero);
+			__m128i ahi = _mm_unpackhi_epi8(c, zero);
+			alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(alo, 0xff), 0xff);
+			ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(ahi, 0xff), 0xff);
+
+			res = _mm_packus_epi16(
+				sse2_blend(alo, lo, bg16), sse2_blend(ahi, hi, bg16));
+			res = _mm_or_si128(_mm_and_si128(res, rgb), sse2_bgalpha(a32, bg[3]));
+		}
+		else {
+			__m128i dst = _mm_loadu_si128((__m128i*) &out[i]);
+			__m128i skip = _mm_cmpeq_epi32(_mm_and_si128(c, rgb), zero);
+			res = _mm_or_si128(
+				_mm_and_si128(_mm_packus_epi16(lo, hi), rgb), _mm_slli_epi32(a32, 24));
+			res = _mm_or_si128(
+				_mm_and_si128(skip, dst), _mm_andnot_si128(skip, res));
+		}
+
+		_mm_storeu_si128((__m128i*) &out[i], res);
+	}
+
+	blit_subpx(&out[i], &cov[i], n - i, fg, bg, usebg);
+}
+
+static SSE2_FN void blit_fill_sse2(PIXEL* out, PIXEL clr, size_t n)
+{
+	__m128i v = _mm_set1_epi32(clr);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_si128((__m128i*) &out[i], v);
+
+	blit_fill(&out[i], clr, n - i);
+}
+#endif
+
+#ifdef TTF_SIMD_NEON
+/* (0x80 + a * f + (255 - a) * b) / 255 in 16-bit lanes */
+static inline uint16x8_t neon_blend(uint16x8_t a, uint16x8_t f, uint16x8_t b)
+{
+	uint16x8_t t = vmlaq_u16(vdupq_n_u16(0x80), a, f);
+	t = vmlaq_u16(t, vsubq_u16(vdupq_n_u16(255), a), b);
+	return vshrq_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+}
+
+/* (0x80 + c * f) / 255 in 16-bit lanes */
+static inline uint16x8_t neon_mul(uint16x8_t c, uint16x8_t f)
+{
+	uint16x8_t t = vmlaq_u16(vdupq_n_u16(0x80), c, f);
+	return vshrq_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+}
+
+/* the alpha selection of pack_pixel_bg for [a] in 32-bit lanes */
+static inline uint32x4_t neon_bgalpha(uint32x4_t a, uint8_t bga)
+{
+	uint32x4_t lt = vcltq_u32(a, vdupq_n_u32(2 * bga));
+	uint32x4_t av = vbslq_u32(lt, vdupq_n_u32(bga), a);
+	av = vorrq_u32(av, vceqq_u32(a, vdupq_n_u32(255)));
+	return vshlq_n_u32(av, 24);
+}
+
+static inline uint32x4_t neon_pack(uint16x8_t lo, uint16x8_t hi)
+{
+	return vreinterpretq_u32_u8(vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+}
+
+static void blit_gray_neon(PIXEL* out, const uint8_t* cov,
+	size_t n, uint8_t fg[4], uint8_t bg[4], bool usebg)
+{
+	static const uint8_t bcast[16] = {
+		0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3};
+	const uint8x8_t lo_ind = vld1_u8(bcast);
+	const uint8x8_t hi_ind = vld1_u8(&bcast[8]);
+	const uint32x4_t rgb = vdupq_n_u32(0x00ffffff);
+	const uint32x4_t fgp = vdupq_n_u32(PACK(fg[0], fg[1], fg[2], 0));
+	const uint16x8_t fg16 = vmovl_u8(vreinterpret_u8_u32(vget_low_u32(fgp)));
+	const uint16x8_t bg16 = vmovl_u8(vreinterpret_u8_u32(
+		vdup_n_u32(PACK(bg[0], bg[1], bg[2], 0))));
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		uint32_t c4;
+		memcpy(&c4, &cov[i], 4);
+		uint8x8_t c = vreinterpret_u8_u32(vdup_n_u32(c4));
+		uint32x4_t a32 = vmovl_u16(vget_low_u16(vmovl_u8(c)));
+		uint32x4_t res;
+
+		if (usebg){
+			res = neon_pack(
+				neon_blend(vmovl_u8(vtbl1_u8(c, lo_ind)), fg16, bg16),
+				neon_blend(vmovl_u8(vtbl1_u8(c, hi_ind)), fg16, bg16)
+			);
+			res = vorrq_u32(vandq_u32(res, rgb), neon_bgalpha(a32, bg[3]));
+		}
+		else {
+			uint32x4_t skip = vceqq_u32(a32, vdupq_n_u32(0));
+			res = vorrq_u32(fgp, vshlq_n_u32(a32, 24));
+			res = vbslq_u32(skip, vld1q_u32((uint32_t*) &out[i]), res);
+		}
+
+		vst1q_u32((uint32_t*) &out[i], res);
+	}
+
+	blit_gray(&out[i], &cov[i], n - i, fg, bg, usebg);
+}
+
+static void blit_subpx_neon(PIXEL* out, const PIXEL* cov,
+	size_t n, uint8_t fg[4], uint8_t bg[4], bool usebg)
+{
+	static const uint8_t bcast[8] = {3, 3, 3, 3, 7, 7, 7, 7};
+	const uint8x8_t a_ind = vld1_u8(bcast);
+	const uint32x4_t rgb = vdupq_n_u32(0x00ffffff);
+	const uint16x8_t fg16 = vmovl_u8(vreinterpret_u8_u32(
+		vdup_n_u32(PACK(fg[0], fg[1], fg[2], 0))));
+	const uint16x8_t bg16 = vmovl_u8(vreinterpret_u8_u32(
+		vdup_n_u32(PACK(bg[0], bg[1], bg[2], 0))));
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		uint32x4_t c = vld1q_u32((const uint32_t*) &cov[i]);
+		uint8x16_t c8 = vreinterpretq_u8_u32(c);
+		uint32x4_t a32 = vshrq_n_u32(c, 24);
+		uint16x8_t lo = neon_mul(vmovl_u8(vget_low_u8(c8)), fg16);
+		uint16x8_t hi = neon_mul(vmovl_u8(vget_high_u8(c8)), fg16);
+		uint32x4_t res;
+
+		if (usebg){
+			uint16x8_t alo = vmovl_u8(vtbl1_u8(vget_low_u8(c8), a_ind));
+			uint16x8_t ahi = vmovl_u8(vtbl1_u8(vget_high_u8(c8), a_ind));
+			res = neon_pack(neon_blend(alo, lo, bg16), neon_blend(ahi, hi, bg16));
+			res = vorrq_u32(vandq_u32(res, rgb), neon_bgalpha(a32, bg[3]));
+		}
+		else {
+			uint32x4_t skip = vceqq_u32(vandq_u32(c, rgb), vdupq_n_u32(0));
+			res = vorrq_u32(vandq_u32(neon_pack(lo, hi), rgb), vshlq_n_u32(a32, 24));
+			res = vbslq_u32(skip, vld1q_u32((uint32_t*) &out[i]), res);
+		}
+
+		vst1q_u32((uint32_t*) &out[i], res);
+	}
+
+	blit_subpx(&out[i], &cov[i], n - i, fg, bg, usebg);
+}
+
+static void blit_fill_neon(PIXEL* out, PIXEL clr, size_t n)
+{
+	uint32x4_t v = vdupq_n_u32(clr);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4)
+		vst1q_u32((uint32_t*) &out[i], v);
+
+	blit_fill(&out[i], clr, n - i);
+}
+#endif
+
+static struct {
+	void (*gray)(PIXEL*, const uint8_t*, size_t, uint8_t*, uint8_t*, bool);
+	void (*subpx)(PIXEL*, const PIXEL*, size_t, uint8_t*, uint8_t*, bool);
+	void (*fill)(PIXEL*, PIXEL, size_t);
+} blit = {
+	.gray = blit_gray,
+	.subpx = blit_subpx,
+	.fill = blit_fill
+};
+
+static void blit_select()
+{
+/* the vector kernels place alpha in the top byte, ARCAN_TTF_NOSIMD in the env
+ * keeps the scalar versions for comparison */
+	if (PACK(0, 0, 0, 0xff) != 0xff000000 || getenv("ARCAN_TTF_NOSIMD"))
+		return;
+
+#ifdef TTF_SIMD_SSE2
+	if (__builtin_cpu_supports("sse2")){
+		blit.gray = blit_gray_sse2;
+		blit.subpx = blit_subpx_sse2;
+		blit.fill = blit_fill_sse2;
+	}
+#endif
+
+#ifdef TTF_SIMD_NEON
+#if defined(__arm__) && defined(__linux__)
+	if (!(getauxval(AT_HWCAP) & HWCAP_NEON))
+		return;
+#endif
+	blit.gray = blit_gray_neon;
+	blit.subpx = blit_subpx_neon;
+	blit.fill = blit_fill_neon;
+#endif
+}
+
 static void yfill(PIXEL* dst, PIXEL clr, int yfill, int w, int h, int stride)
 {
 	for (int br = 0, ur = h-1; br < yfill; br++, ur--){
-		PIXEL* dr = &dst[br * stride];
-		for (int col = 0; col < w; col++)
-			*dr++ = clr;
-		dr = &dst[ur * stride];
-		for (int col = 0; col < w; col++)
-			*dr++ = clr;
+		blit.fill(&dst[br * stride], clr, w);
+		blit.fill(&dst[ur * stride], clr, w);
+	}
+}
+
+/* gather subpixel coverage, [step] apart between channels and [adv] between
+ * pixels, into PACK(r, g, b, avg) chunks for the blit */
+static void blit_lcd(PIXEL* out, const uint8_t* src, size_t n,
+	size_t step, size_t adv, uint8_t fg[4], uint8_t bg[4], bool usebg)
+{
+	PIXEL cov[64];
+
+	while (n){
+		size_t nc = n > 64 ? 64 : n;
+
+		for (size_t i = 0; i < nc; i++, src += adv){
+			uint8_t b = src[0];
+			uint8_t g = src[step];
+			uint8_t r = src[step * 2];
+			cov[i] = PACK(r, g, b, (r + g + b) / 3);
+		}
+
+		blit.subpx(out, cov, nc, fg, bg, usebg);
+		out += nc;
+		n -= nc;
 	}
 }
 
+/* number of pixels a row blit may touch, same bounds as the per-pixel loops */
+static inline size_t row_span(PIXEL* out, PIXEL* ubound, int gwidth, size_t width)
+{
+	size_t n = gwidth < 0 ? 0 : gwidth;
+	if (n > width)
+		n = width;
+	if (out >= ubound)
+		return 0;
+	if (n > (size_t)(ubound - out))
+		n = ubound - out;
+	return n;
+}
+
 static bool render_unicode(
 	PIXEL* dst,
 	size_t width, size_t height,
@@ -1770,18 +2197,8 @@ static bool render_unicode(
 			uint8_t* src = (uint8_t*)(glyph->pixmap.buffer+glyph->pixmap.pitch*row);
 			out = out < dst ? dst : out;
 
-			for (int col = 0; col < gwidth && col < width && out < ubound; col++){
-				uint8_t b = *src++;
-				uint8_t g = *src++;
-				uint8_t r = *src++;
-
-				if (usebg)
-					*out++ = pack_subpx_bg(fg, bg, r, g, b);
-				else if (b|g|r)
-					*out++ = pack_subpx(fg, r, g, b);
-				else
-					out++;
-			}
+			blit_lcd(out, src,
+				row_span(out, ubound, gwidth, width), 1, 3, fg, bg, usebg);
 		}
 	}
 	else if (glyph->pixmap.pixel_mode == FT_PIXEL_MODE_LCD_V){
@@ -1793,18 +2210,8 @@ static bool render_unicode(
 			uint8_t* src = (uint8_t*)(glyph->pixmap.buffer+(glyph->pixmap.pitch*3)*row);
 			out = out < dst ? dst : out;
 
-			for (int col = 0; col < gwidth && col < width && out < ubound; col++){
-				uint8_t b = *src;
-				uint8_t g = *(src + glyph->pixmap.pitch);
-				uint8_t r = *(src + glyph->pixmap.pitch + glyph->pixmap.pitch);
-
-				if (usebg)
-					*out++ = pack_subpx_bg(fg, bg, r, g, b);
-				else if (b|g|r)
-					*out++ = pack_subpx(fg, r, g, b);
-				else
-					out++;
-			}
+			blit_lcd(out, src, row_span(out, ubound, gwidth, width),
+				glyph->pixmap.pitch, 1, fg, bg, usebg);
 		}
 	}
 	else
@@ -1818,15 +2225,7 @@ static bool render_unicode(
 		PIXEL* out = &dst[(row+glyph->yoffset)*stride+(*xstart+glyph->minx)];
 		uint8_t* src = (uint8_t*)(glyph->pixmap.buffer+glyph->pixmap.pitch * row);
 		out = out < dst ? dst : out;
-		for (int col = 0; col < gwidth && col < width && out < ubound; col++){
-			uint8_t a = *src++;
-			if (usebg)
-				*out++ = pack_pixel_bg(fg, bg, a);
-			else if (a)
-				*out++ = pack_pixel(fg, a);
-			else
-				out++;
-		}
+		blit.gray(out, src, row_span(out, ubound, gwidth, width), fg, bg, usebg);
 	}
 
 /* Underline / Strikethrough can be handled by the caller for this func
@@ -72,6 +72,12 @@ TTF_Font* TTF_OpenFontFD(int fd, int ptsize, uint16_t hdpi, uint16_t vdpi);
 /* open font using a preexisting font for file, will close *src if needed */
 TTF_Font* TTF_ReplaceFont(TTF_Font*, int pt, uint16_t hdpi, uint16_t vdpi);
 
+/* open a private copy of a font with the same size, hinting and a fixed
+ * style, bypassing the font cache. The copy can be used from another thread
+ * than the one holding the original, but must be opened and closed from the
+ * thread that opened the original */
+TTF_Font* TTF_ForkFont(TTF_Font*, int style);
+
 void* TTF_GetFtFace(TTF_Font*);
 
 int UTF8_to_UTF32(uint32_t* out, const uint8_t* in, size_t len);
@@ -6,6 +6,7 @@
 
 #include "arcan_hmeta.h"
 #include "arcan_ttf.h"
+#include "arcan_workers.h"
 
 #define CLAMP(x, l, h) (((x) > (h)) ? (h) : (((x) < (l)) ? (l) : (x)))
 
@@ -18,12 +19,17 @@
  - (char*)&(*(type*)0)))
 #endif
 
+#ifndef RESAMPLE_ATLAS_SIZE
+#define RESAMPLE_ATLAS_SIZE 8192
+#endif
+
 #ifndef ARCAN_VIDEO_DEFAULT_MIPMAP_STATE
 #define ARCAN_VIDEO_DEFAULT_MIPMAP_STATE false
 #endif
 
 static surface_properties empty_surface();
 static sem_handle asynchsynch;
+static void loader_limit(size_t limit);
 
 /* these match arcan_vinterpolant enum */
 static arcan_interp_3d_function lut_interp_3d[] = {
@@ -65,7 +71,7 @@ struct arcan_video_display arcan_video_display = {
 struct arcan_video_context vcontext_stack[CONTEXT_STACK_LIMIT] = {
 	{
 		.n_rtargets = 0,
-		.vitem_ofs = 1,
+		.vitem_top = 1,
 		.nalive    = 0,
 		.world = {
 			.tracetag = "(world)",
@@ -92,6 +98,42 @@ struct arcan_video_context* dctx);
 static inline void build_modelview(float* dmatr,
 	float* imatr, surface_properties* prop, arcan_vobject* src);
 static inline void process_readback(struct rendertarget* tgt, float fract);
+static void tfcache_free(struct vobject_tfcache* cache);
+static void prep_free(struct rendertarget* tgt);
+static void damage_merge(struct agp_region* dst, const struct agp_region* src);
+static void pickidx_moved(arcan_vobject* vobj);
+static void pickidx_free(struct rendertarget* tgt);
+static void gputime_free(struct rendertarget* tgt);
+
+/* log of objects whose cached properties were invalidated, see pickidx_ */
+#ifndef PICKIDX_GRID
+#define PICKIDX_GRID 16
+#endif
+
+#ifndef PICKIDX_MOVED
+#define PICKIDX_MOVED 64
+#endif
+
+static struct {
+	arcan_vobject* vobj[PICKIDX_MOVED];
+	uint64_t seq;
+} pick_moved;
+
+/* number of drawn frames an image store has to go unused before it can be
+ * evicted, see residency_enforce */
+#ifndef RESIDENCY_GRACE
+#define RESIDENCY_GRACE 2
+#endif
+
+static struct {
+	uint64_t frame;
+	size_t evictions;
+	size_t restores;
+} residency = {
+	.frame = RESIDENCY_GRACE + 1
+};
+
+static void residency_enforce();
 
 static inline void trace(const char* msg, ...)
 {
@@ -117,7 +159,8 @@ void arcan_vint_drop_vstore(struct agp_vstore* s)
 	s->refcount--;
 
 	if (s->refcount == 0){
-		if (s->txmapped != TXSTATE_OFF && s->vinf.text.glid){
+/* evicted stores have no glid but still hold raw and source */
+		if (s->txmapped != TXSTATE_OFF){
 			if (s->vinf.text.raw){
 				arcan_mem_free(s->vinf.text.raw);
 				s->vinf.text.raw = NULL;
@@ -219,6 +262,7 @@ static void invalidate_cache(arcan_vobject* vobj)
 	if (!vobj->valid_cache)
 		return;
 
+	pickidx_moved(vobj);
 	vobj->valid_cache = false;
 
 	for (size_t i = 0; i < vobj->childslots; i++)
@@ -238,6 +282,127 @@ static void dropchild(arcan_vobject* parent, arcan_vobject* child)
 	}
 }
 
+/*
+ * Setup the chunk table for a context without backing any slots, the first
+ * chunk will be allocated on the first request for an id.
+ */
+static void vitem_setup(struct arcan_video_context* ctx)
+{
+	ctx->vitem_limit = arcan_video_display.default_vitemlim;
+	ctx->vitem_top = 1;
+	ctx->vitem_nchunks = 0;
+	ctx->vitem_nfree = 0;
+	ctx->vitem_fhead = 0;
+	ctx->vitem_free = NULL;
+	ctx->vitems_pool = arcan_alloc_mem(sizeof(arcan_vobject*) *
+		((ctx->vitem_limit + VITEM_CHUNK_SIZE - 1) / VITEM_CHUNK_SIZE),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL
+	);
+}
+
+static void vitem_teardown(struct arcan_video_context* ctx)
+{
+	for (size_t i = 0; i < ctx->vitem_nchunks; i++)
+		arcan_mem_free(ctx->vitems_pool[i]);
+
+	arcan_mem_free(ctx->vitems_pool);
+	arcan_mem_free(ctx->vitem_free);
+	ctx->vitems_pool = NULL;
+	ctx->vitem_free = NULL;
+	ctx->vitem_nchunks = 0;
+	ctx->vitem_nfree = 0;
+	ctx->vitem_fhead = 0;
+	ctx->vitem_top = 1;
+}
+
+/*
+ * Back every chunk up to and including the one holding [id]. The free queue
+ * can never hold more ids than there are backed slots so it grows with them,
+ * and is unwrapped to start at 0 in the new buffer.
+ */
+static bool vitem_grow(struct arcan_video_context* ctx, size_t id)
+{
+	if (id >= ctx->vitem_limit)
+		return false;
+
+	size_t nchunks = id / VITEM_CHUNK_SIZE + 1;
+	if (nchunks <= ctx->vitem_nchunks)
+		return true;
+
+	unsigned* free = arcan_alloc_mem(sizeof(unsigned) * nchunks * VITEM_CHUNK_SIZE,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+	if (!free)
+		return false;
+
+/* the chunk count is only committed once every chunk is backed, the free
+ * queue wraps on it and has to stay in step with the buffer size */
+	for (size_t i = ctx->vitem_nchunks; i < nchunks; i++){
+		ctx->vitems_pool[i] = arcan_alloc_mem(
+			sizeof(arcan_vobject) * VITEM_CHUNK_SIZE, ARCAN_MEM_VSTRUCT,
+			ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE
+		);
+
+		if (!ctx->vitems_pool[i]){
+			while (i-- > ctx->vitem_nchunks){
+				arcan_mem_free(ctx->vitems_pool[i]);
+				ctx->vitems_pool[i] = NULL;
+			}
+			arcan_mem_free(free);
+			return false;
+		}
+	}
+
+	size_t cap = ctx->vitem_nchunks * VITEM_CHUNK_SIZE;
+	for (size_t i = 0; i < ctx->vitem_nfree; i++)
+		free[i] = ctx->vitem_free[(ctx->vitem_fhead + i) % cap];
+	arcan_mem_free(ctx->vitem_free);
+	ctx->vitem_free = free;
+	ctx->vitem_fhead = 0;
+	ctx->vitem_nchunks = nchunks;
+
+	return true;
+}
+
+arcan_vobject* arcan_vint_vitem(struct arcan_video_context* ctx, size_t id)
+{
+	if (id / VITEM_CHUNK_SIZE >= ctx->vitem_nchunks)
+		return NULL;
+
+	return &ctx->vitems_pool[id / VITEM_CHUNK_SIZE][id % VITEM_CHUNK_SIZE];
+}
+
+/*
+ * Recalculate the top and the free queue from the INUSE state of the slots,
+ * used when objects have been moved into a context outside of allocation.
+ * Ids are queued in ascending order so that low ids get reused first.
+ */
+static void vitem_rebuild(struct arcan_video_context* ctx)
+{
+	size_t top = 1;
+	for (size_t i = 1; i < ctx->vitem_nchunks * VITEM_CHUNK_SIZE; i++)
+		if (FL_TEST(arcan_vint_vitem(ctx, i), FL_INUSE))
+			top = i + 1;
+
+	ctx->vitem_top = top;
+	ctx->vitem_nfree = 0;
+	ctx->vitem_fhead = 0;
+	for (size_t i = 1; i < top; i++)
+		if (!FL_TEST(arcan_vint_vitem(ctx, i), FL_INUSE))
+			ctx->vitem_free[ctx->vitem_nfree++] = i;
+}
+
+static void vitem_release(struct arcan_video_context* ctx, arcan_vobj_id id)
+{
+	if (id <= 0 || id >= ctx->vitem_top)
+		return;
+
+/* queued at the tail so that a released id is the last to be handed out,
+ * script-held references to a deleted vid then resolve to nothing for as
+ * long as possible rather than to an unrelated new object */
+	size_t cap = ctx->vitem_nchunks * VITEM_CHUNK_SIZE;
+	ctx->vitem_free[(ctx->vitem_fhead + ctx->vitem_nfree++) % cap] = id;
+}
+
 /* scan through each cell in use, and either deallocate / wrap with deleteobject
  * or pause frameserver connections and (conservative) delete resources that can
  * be recreated later on. */
@@ -245,9 +410,9 @@ static void deallocate_gl_context(
 	struct arcan_video_context* context, bool del, struct agp_vstore* safe_store)
 {
 /* index (0) is always worldid */
-	for (size_t i = 1; i < context->vitem_limit; i++){
-		if (FL_TEST(&(context->vitems_pool[i]), FL_INUSE)){
-			arcan_vobject* current = &(context->vitems_pool[i]);
+	for (size_t i = 1; i < context->vitem_top; i++){
+		arcan_vobject* current = arcan_vint_vitem(context, i);
+		if (FL_TEST(current, FL_INUSE)){
 
 /* before doing any modification, wait for any async load calls to finish(!),
  * question is IF this should invalidate or not */
@@ -269,10 +434,13 @@ static void deallocate_gl_context(
 		}
 	}
 
-/* pool is dynamically sized and size is set on layer push */
+/* pool is dynamically sized and the limit is set on layer push */
 	if (del){
-		arcan_mem_free(context->vitems_pool);
-		context->vitems_pool = NULL;
+		vitem_teardown(context);
+		tfcache_free(&context->tfcache);
+		prep_free(&context->stdoutp);
+		pickidx_free(&context->stdoutp);
+		gputime_free(&context->stdoutp);
 	}
 }
 
@@ -301,16 +469,11 @@ static void reallocate_gl_context(struct arcan_video_context* context)
 	arcan_tickv cticks = arcan_video_display.c_ticks;
 
 /* If there's nothing saved, we reallocate */
-	if (!context->vitems_pool){
-		context->vitem_limit = arcan_video_display.default_vitemlim;
-		context->vitem_ofs   = 1;
-		context->vitems_pool = arcan_alloc_mem(
-			sizeof(struct arcan_vobject) * context->vitem_limit,
-				ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
-	}
-	else for (size_t i = 1; i < context->vitem_limit; i++)
-		if (FL_TEST(&(context->vitems_pool[i]), FL_INUSE)){
-			arcan_vobject* current = &context->vitems_pool[i];
+	if (!context->vitems_pool)
+		vitem_setup(context);
+	else for (size_t i = 1; i < context->vitem_top; i++)
+		if (FL_TEST(arcan_vint_vitem(context, i), FL_INUSE)){
+			arcan_vobject* current = arcan_vint_vitem(context, i);
 			surface_transform* ctrans = current->transform;
 
 			if (FL_TEST(current, FL_PRSIST))
@@ -326,6 +489,7 @@ static void reallocate_gl_context(struct arcan_video_context* context)
 /* for conservative memory management mode we need to reallocate
  * static resources. getimage will strdup the source so to avoid leaking,
  * copy and free */
+			FL_CLEAR(current, FL_EVICTED);
 			if (arcan_video_display.conservative &&
 				(char)current->feed.state.tag == ARCAN_TAG_IMAGE){
 					char* fname = strdup( current->vstore->vinf.text.source );
@@ -377,13 +541,17 @@ static void push_transfer_persists(
 	struct arcan_video_context* src,
 	struct arcan_video_context* dst)
 {
-	for (size_t i = 1; i < src->vitem_limit - 1; i++){
-		arcan_vobject* srcobj = &src->vitems_pool[i];
-		arcan_vobject* dstobj = &dst->vitems_pool[i];
+	for (size_t i = 1; i < src->vitem_top; i++){
+		arcan_vobject* srcobj = arcan_vint_vitem(src, i);
 
 		if (!FL_TEST(srcobj, FL_INUSE) || !FL_TEST(srcobj, FL_PRSIST))
 			continue;
 
+/* the persistent object has to keep its id so back the slot in dst */
+		if (!vitem_grow(dst, i))
+			continue;
+		arcan_vobject* dstobj = arcan_vint_vitem(dst, i);
+
 		detach_fromtarget(srcobj->owner, srcobj);
 		memcpy(dstobj, srcobj, sizeof(arcan_vobject));
 		dst->nalive++; /* fake allocate */
@@ -391,6 +559,8 @@ static void push_transfer_persists(
 		attach_object(&dst->stdoutp, dstobj);
 		trace("vcontext_stack_push() : transfer-attach: %s\n", srcobj->tracetag);
 	}
+
+	vitem_rebuild(dst);
 }
 
 /*
@@ -402,13 +572,22 @@ static void pop_transfer_persists(
 	struct arcan_video_context* src,
 	struct arcan_video_context* dst)
 {
-	for (size_t i = 1; i < src->vitem_limit - 1; i++){
-		arcan_vobject* srcobj = &src->vitems_pool[i];
-		arcan_vobject* dstobj = &dst->vitems_pool[i];
+	bool moved = false;
 
-		if (!FL_TEST(srcobj, FL_INUSE) || !FL_TEST(srcobj, FL_PRSIST))
+	for (size_t i = 1; i < src->vitem_top; i++){
+		arcan_vobject* srcobj = arcan_vint_vitem(src, i);
+
+		if (!FL_TEST(srcobj, FL_INUSE) || !FL_TEST(srcobj, FL_PRSIST) ||
+			!vitem_grow(dst, i))
 			continue;
 
+/* objects flagged persistent in src but lacking a shadow in dst */
+		arcan_vobject* dstobj = arcan_vint_vitem(dst, i);
+		if (!FL_TEST(dstobj, FL_INUSE)){
+			dst->nalive++;
+			moved = true;
+		}
+
 		arcan_vobject* parent = dstobj->parent;
 
 		detach_fromtarget(srcobj->owner, srcobj);
@@ -419,6 +598,10 @@ static void pop_transfer_persists(
 		dstobj->parent = parent;
 		memset(srcobj, '\0', sizeof(arcan_vobject));
 	}
+
+/* only a slot that wasn't a shadow in dst would disagree with its free stack */
+	if (moved)
+		vitem_rebuild(dst);
 }
 
 void arcan_vint_drawrt(struct agp_vstore* vs, int x, int y, int w, int h)
@@ -603,7 +786,6 @@ signed arcan_video_pushcontext()
 
 	current_context = &vcontext_stack[ vcontext_ind ];
 	current_context->stdoutp.first = NULL;
-	current_context->vitem_ofs = 1;
 	current_context->nalive = 0;
 
 	current_context->world = empty_vobj;
@@ -612,11 +794,14 @@ signed arcan_video_pushcontext()
 	current_context->stdoutp.vppcm = current_context->stdoutp.hppcm = 28;
 	current_context->stdoutp.color = &current_context->world;
 	current_context->stdoutp.max_order = 65536;
-	current_context->vitem_limit = arcan_video_display.default_vitemlim;
-	current_context->vitems_pool = arcan_alloc_mem(
-		sizeof(struct arcan_vobject) * current_context->vitem_limit,
-		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL
-	);
+	current_context->tfcache = (struct vobject_tfcache){0};
+	for (size_t i = 0; i < RENDERTARGET_LIMIT; i++){
+		current_context->rtargets[i].prep = (struct rendertarget_prep){0};
+		current_context->rtargets[i].pick = (struct rendertarget_pickidx){0};
+	}
+	current_context->stdoutp.prep = (struct rendertarget_prep){0};
+	current_context->stdoutp.pick = (struct rendertarget_pickidx){0};
+	vitem_setup(current_context);
 
 	current_context->rtargets[0].first = NULL;
 
@@ -641,9 +826,10 @@ void arcan_video_recoverexternal(bool pop, int* saved,
 	for (size_t i = 0; i <= vcontext_ind; i++){
 		struct arcan_video_context* ctx = &vcontext_stack[i];
 
-		for (size_t j = 1; j < ctx->vitem_limit; j++){
-			if (FL_TEST(&(ctx->vitems_pool[j]), FL_INUSE)){
-				if (ctx->vitems_pool[j].feed.state.tag == ARCAN_TAG_FRAMESERV)
+		for (size_t j = 1; j < ctx->vitem_top; j++){
+			arcan_vobject* cobj = arcan_vint_vitem(ctx, j);
+			if (FL_TEST(cobj, FL_INUSE)){
+				if (cobj->feed.state.tag == ARCAN_TAG_FRAMESERV)
 					n_ext++;
 			}
 		}
@@ -682,13 +868,12 @@ void arcan_video_recoverexternal(bool pop, int* saved,
 		struct arcan_video_context* ctx = &vcontext_stack[i];
 
 /* only care about frameservers */
-		for (size_t j = 1; j < ctx->vitem_limit; j++){
-			if (!FL_TEST(&ctx->vitems_pool[j], FL_INUSE) ||
-				ctx->vitems_pool[j].feed.state.tag != ARCAN_TAG_FRAMESERV)
+		for (size_t j = 1; j < ctx->vitem_top; j++){
+			arcan_vobject* cobj = arcan_vint_vitem(ctx, j);
+			if (!FL_TEST(cobj, FL_INUSE) ||
+				cobj->feed.state.tag != ARCAN_TAG_FRAMESERV)
 				continue;
 
-			arcan_vobject* cobj = &ctx->vitems_pool[j];
-
 /* some feedfunctions are dangerous to try and save */
 			if (cobj->feed.ffunc == FFUNC_SOCKVER ||
 				cobj->feed.ffunc == FFUNC_SOCKPOLL)
@@ -773,9 +958,9 @@ clense:
 
 arcan_vobj_id arcan_video_findstate(enum arcan_vobj_tags tag, void* ptr)
 {
-	for (size_t i = 1; i < current_context->vitem_limit; i++){
-	if (FL_TEST(&current_context->vitems_pool[i], FL_INUSE)){
-		arcan_vobject* vobj = &current_context->vitems_pool[i];
+	for (size_t i = 1; i < current_context->vitem_top; i++){
+	arcan_vobject* vobj = arcan_vint_vitem(current_context, i);
+	if (FL_TEST(vobj, FL_INUSE)){
 		if (vobj->feed.state.tag == tag && vobj->feed.state.ptr == ptr)
 			return i;
 	}
@@ -877,6 +1062,16 @@ unsigned arcan_video_popcontext()
 	reallocate_gl_context(current_context);
 	FLAG_DIRTY(NULL);
 
+/* the restored rendertarget contents can't be assumed to be intact, and the
+ * moved-object log may reference objects from the dropped context */
+	current_context->stdoutp.damage.sig = 0;
+	current_context->stdoutp.pick.valid = false;
+	for (size_t i = 0; i < current_context->n_rtargets; i++){
+		current_context->rtargets[i].damage.sig = 0;
+		current_context->rtargets[i].pick.valid = false;
+	}
+	pick_moved.seq += PICKIDX_MOVED + 1;
+
 	return (CONTEXT_STACK_LIMIT - 1) - vcontext_ind;
 }
 
@@ -888,31 +1083,48 @@ static inline surface_properties empty_surface()
 	return res;
 }
 
+/*
+ * The top of the handed-out range is extended while it stays within the
+ * chunks that are already backed, then released ids are taken from the head
+ * of the free queue (oldest release first), and only when that is empty is
+ * a new chunk backed. 0 is protected.
+ */
 static arcan_vobj_id video_allocid(
 	bool* status, struct arcan_video_context* ctx, bool write)
 {
-	unsigned i = ctx->vitem_ofs, c = ctx->vitem_limit;
+	unsigned i;
 	*status = false;
 
-	while (c--){
-		if (i == 0) /* 0 is protected */
-			i = 1;
+	size_t cap = ctx->vitem_nchunks * VITEM_CHUNK_SIZE;
+	bool fresh = ctx->vitem_top < ctx->vitem_limit &&
+		(ctx->vitem_top < cap || !ctx->vitem_nfree);
 
-		if (!FL_TEST(&ctx->vitems_pool[i], FL_INUSE)){
-			*status = true;
-			if (!write)
-				return i;
+	if (fresh)
+		i = ctx->vitem_top;
+	else if (ctx->vitem_nfree)
+		i = ctx->vitem_free[ctx->vitem_fhead];
+	else
+		return ARCAN_EID;
 
-			ctx->nalive++;
-			FL_SET(&ctx->vitems_pool[i], FL_INUSE);
-			ctx->vitem_ofs = (ctx->vitem_ofs + 1) >= ctx->vitem_limit ? 1 : i + 1;
-			return i;
-		}
+	*status = true;
+	if (!write)
+		return i;
 
-		i = (i + 1) % (ctx->vitem_limit - 1);
+	if (i == ctx->vitem_top){
+		if (!vitem_grow(ctx, i)){
+			*status = false;
+			return ARCAN_EID;
+		}
+		ctx->vitem_top++;
+	}
+	else {
+		ctx->vitem_fhead = (ctx->vitem_fhead + 1) % cap;
+		ctx->vitem_nfree--;
 	}
 
-	return ARCAN_EID;
+	ctx->nalive++;
+	FL_SET(arcan_vint_vitem(ctx, i), FL_INUSE);
+	return i;
 }
 
 arcan_errc arcan_video_resampleobject(arcan_vobj_id vid,
@@ -1030,6 +1242,202 @@ arcan_errc arcan_video_resampleobject(arcan_vobj_id vid,
 	return ARCAN_OK;
 }
 
+/*
+ * Shelf-pack as many of [jobs] as fits in one atlas, in submission order,
+ * writing the atlas-relative origin for each into [pos]. Returns the number
+ * of jobs that went into the atlas and its dimensions in [w, h].
+ */
+static size_t resample_pack(struct arcan_resample_job* jobs, size_t n,
+	size_t* pos, size_t* w, size_t* h)
+{
+	size_t area = 0, maxw = 0;
+	for (size_t i = 0; i < n; i++){
+		area += jobs[i].w * jobs[i].h;
+		maxw = jobs[i].w > maxw ? jobs[i].w : maxw;
+	}
+
+	size_t aw = sqrt(area) + 1;
+	aw = aw < maxw ? maxw : aw;
+	aw = aw > RESAMPLE_ATLAS_SIZE ? RESAMPLE_ATLAS_SIZE : aw;
+
+	size_t x = 0, y = 0, shelf = 0, count = 0;
+	for (; count < n; count++){
+		if (x + jobs[count].w > aw){
+			y += shelf;
+			x = shelf = 0;
+		}
+
+		if (y + jobs[count].h > RESAMPLE_ATLAS_SIZE)
+			break;
+
+		pos[count * 2 + 0] = x;
+		pos[count * 2 + 1] = y;
+		x += jobs[count].w;
+		shelf = jobs[count].h > shelf ? jobs[count].h : shelf;
+	}
+
+	*w = aw;
+	*h = y + shelf;
+	return count;
+}
+
+/*
+ * One rendertarget pass for the first jobs that fit in an atlas, returns the
+ * number of jobs completed (0 on failure, jobs[].out are then left as EID).
+ */
+static size_t resample_pass(struct arcan_resample_job* jobs, size_t n,
+	agp_shader_id shid, bool separate, size_t* outw, size_t* outh)
+{
+	size_t* pos = arcan_alloc_mem(sizeof(size_t) * 2 * n,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_FRAME | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+	if (!pos)
+		return 0;
+
+	size_t aw, ah;
+	size_t count = resample_pack(jobs, n, pos, &aw, &ah);
+	if (!count){
+		arcan_mem_free(pos);
+		return 0;
+	}
+
+	av_pixel* buf = arcan_alloc_mem(aw * ah * sizeof(av_pixel),
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	img_cons cons = {.w = aw, .h = ah, .bpp = sizeof(av_pixel)};
+	arcan_vobj_id atlas = buf ?
+		arcan_video_rawobject(buf, cons, aw, ah, 1) : ARCAN_EID;
+
+	if (atlas == ARCAN_EID){
+		arcan_mem_free(buf);
+		arcan_mem_free(pos);
+		return 0;
+	}
+
+	if (ARCAN_OK != arcan_video_setuprendertarget(
+		atlas, 0, -1, false, RENDERTARGET_COLOR | RENDERTARGET_RETAIN_ALPHA)){
+		arcan_video_deleteobject(atlas);
+		arcan_mem_free(pos);
+		return 0;
+	}
+
+/* one proxy per job, they are owned by the atlas and cascade with it */
+	for (size_t i = 0; i < count; i++){
+		arcan_vobj_id xfer = arcan_video_nullobject(jobs[i].w, jobs[i].h, 0);
+		if (xfer == ARCAN_EID)
+			continue;
+
+		arcan_video_shareglstore(jobs[i].src, xfer);
+		arcan_video_setprogram(xfer, shid);
+		arcan_video_forceblend(xfer, BLEND_FORCE);
+		arcan_video_objectmove(xfer, pos[i * 2], pos[i * 2 + 1], 1.0, 0);
+		arcan_video_attachtorendertarget(atlas, xfer, true);
+		arcan_video_objectopacity(xfer, 1.0, 0);
+	}
+
+	agp_rendertarget_clearcolor(
+		arcan_vint_findrt(arcan_video_getobject(atlas))->art, 0.0, 0.0, 0.0, 0.0);
+	arcan_video_forceupdate(atlas, true);
+
+	struct agp_vstore* astore = arcan_video_getobject(atlas)->vstore;
+	if (separate)
+		agp_readback_synchronous(astore);
+
+	for (size_t i = 0; i < count; i++){
+		size_t x = pos[i * 2], y = pos[i * 2 + 1];
+		size_t w = jobs[i].w, h = jobs[i].h;
+
+/* split the readback into individual stores */
+		if (separate){
+			av_pixel* dbuf = arcan_alloc_mem(w * h * sizeof(av_pixel),
+				ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+			if (!dbuf)
+				continue;
+
+			for (size_t row = 0; row < h; row++)
+				memcpy(&dbuf[row * w],
+					&astore->vinf.text.raw[(y + row) * aw + x], w * sizeof(av_pixel));
+
+			img_cons dcons = {.w = w, .h = h, .bpp = sizeof(av_pixel)};
+			jobs[i].out = arcan_video_rawobject(dbuf, dcons, w, h, 1);
+			if (jobs[i].out == ARCAN_EID)
+				arcan_mem_free(dbuf);
+			continue;
+		}
+
+/* or reference the atlas region through the texture coordinates */
+		jobs[i].out = arcan_video_nullobject(w, h, 0);
+		if (jobs[i].out == ARCAN_EID)
+			continue;
+
+		float s1 = (float)x / aw, t1 = (float)y / ah;
+		float s2 = (float)(x + w) / aw, t2 = (float)(y + h) / ah;
+		float txcos[8] = {s1, t1, s2, t1, s2, t2, s1, t2};
+		arcan_video_shareglstore(atlas, jobs[i].out);
+		arcan_video_override_mapping(jobs[i].out, txcos);
+	}
+
+	arcan_video_deleteobject(atlas);
+	arcan_mem_free(pos);
+
+	*outw = aw;
+	*outh = ah;
+	return count;
+}
+
+arcan_errc arcan_video_resamplebatch(struct arcan_resample_job* jobs,
+	size_t n, agp_shader_id shid, bool separate, intptr_t tag)
+{
+	if (!n)
+		return ARCAN_ERRC_BAD_ARGUMENT;
+
+	for (size_t i = 0; i < n; i++){
+		arcan_vobject* vobj = arcan_video_getobject(jobs[i].src);
+		jobs[i].out = ARCAN_EID;
+
+		if (!vobj)
+			return ARCAN_ERRC_NO_SUCH_OBJECT;
+
+		if (vobj->vstore->txmapped != TXSTATE_TEX2D)
+			return ARCAN_ERRC_UNACCEPTED_STATE;
+
+		if (!jobs[i].w || !jobs[i].h ||
+			jobs[i].w > RESAMPLE_ATLAS_SIZE || jobs[i].h > RESAMPLE_ATLAS_SIZE)
+			return ARCAN_ERRC_OUT_OF_SPACE;
+	}
+
+/* normally a single pass, more only if the batch does not fit in one atlas */
+	size_t aw = 0, ah = 0;
+	bool failed = false;
+	for (size_t ofs = 0; ofs < n && !failed;){
+		size_t step = resample_pass(&jobs[ofs], n - ofs, shid, separate, &aw, &ah);
+		failed = step == 0;
+		ofs += step;
+	}
+
+	for (size_t i = 0; i < n && !failed; i++)
+		failed = jobs[i].out == ARCAN_EID;
+
+	if (failed){
+		for (size_t i = 0; i < n; i++){
+			if (jobs[i].out != ARCAN_EID)
+				arcan_video_deleteobject(jobs[i].out);
+			jobs[i].out = ARCAN_EID;
+		}
+		return ARCAN_ERRC_OUT_OF_SPACE;
+	}
+
+	arcan_event ev = {
+		.category = EVENT_VIDEO,
+		.vid.kind = EVENT_VIDEO_RESAMPLE_COMPLETE,
+		.vid.source = jobs[0].out,
+		.vid.width = aw,
+		.vid.height = ah,
+		.vid.data = tag
+	};
+	arcan_event_enqueue(arcan_event_defaultctx(), &ev);
+
+	return ARCAN_OK;
+}
+
 arcan_errc arcan_video_mipmapset(arcan_vobj_id vid, bool enable)
 {
 	arcan_vobject* vobj = arcan_video_getobject(vid);
@@ -1136,7 +1544,7 @@ static arcan_vobject* new_vobject(
 	if (!status)
 		return NULL;
 
-	rv = dctx->vitems_pool + fid;
+	rv = arcan_vint_vitem(dctx, fid);
 	rv->order = 0;
 	populate_vstore(&rv->vstore);
 
@@ -1183,9 +1591,9 @@ arcan_vobject* arcan_video_getobject(arcan_vobj_id id)
 {
 	arcan_vobject* rc = NULL;
 
-	if (id > 0 && id < current_context->vitem_limit &&
-		FL_TEST(&current_context->vitems_pool[id], FL_INUSE))
-		rc = current_context->vitems_pool + id;
+	if (id > 0 && id < current_context->vitem_top &&
+		FL_TEST(arcan_vint_vitem(current_context, id), FL_INUSE))
+		rc = arcan_vint_vitem(current_context, id);
 	else
 		if (id == ARCAN_VIDEO_WORLDID){
 			rc = &current_context->world;
@@ -1245,6 +1653,12 @@ static bool detach_fromtarget(struct rendertarget* dst, arcan_vobject* src)
 		torem->previous->next = torem->next;
 	}
 
+	dst->pick.seq++;
+
+/* the area it covered needs to be redrawn on the next partial pass */
+	if (torem->damage.valid && torem->damage.tgt == dst->damage.id)
+		damage_merge(&dst->damage.box, &torem->damage.box);
+
 /* (4.) mark as something easy to find in dumps */
 	torem->elem = (arcan_vobject*) 0xfeedface;
 
@@ -1295,6 +1709,27 @@ void arcan_vint_reraster(arcan_vobject* src, struct rendertarget* rtgt)
  *  that led to its creation. This allows us to just reraster into that */
 	size_t dw, dh, maxw, maxh;
 	uint32_t dsz;
+
+	if (src->glyphs){
+		arcan_mem_free(src->glyphs);
+		src->glyphs = NULL;
+
+		src->glyphs = vs->vinf.text.kind == STORAGE_TEXT ?
+			arcan_renderfun_glyphs(vs->vinf.text.source,
+				NULL, NULL, NULL, &maxw, &maxh) :
+			arcan_renderfun_glyphs(NULL,
+				(const char**) vs->vinf.text.source_arr, NULL, NULL, &maxw, &maxh);
+
+		if (src->glyphs){
+			vs->vinf.text.vppcm = rtgt->vppcm;
+			vs->vinf.text.hppcm = rtgt->hppcm;
+			vs->w = maxw;
+			vs->h = maxh;
+			FLAG_DIRTY(src);
+			return;
+		}
+	}
+
 	if (vs->vinf.text.kind == STORAGE_TEXT)
 		arcan_renderfun_renderfmtstr(
 			vs->vinf.text.source, src->cellid,
@@ -1312,10 +1747,12 @@ static void attach_object(struct rendertarget* dst, arcan_vobject* src)
 {
 	arcan_vobject_litem* new_litem =
 		arcan_alloc_mem(sizeof *new_litem,
-			ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_SLAB,
+			ARCAN_MEMALIGN_NATURAL);
 
 	new_litem->next = new_litem->previous = NULL;
 	new_litem->elem = src;
+	dst->pick.seq++;
 
 /* (pre) if orphaned, assign */
 	if (src->owner == NULL){
@@ -1434,7 +1871,7 @@ static surface_transform* dup_chain(surface_transform* base)
 		return NULL;
 
 	surface_transform* res = arcan_alloc_mem( sizeof(surface_transform),
-		ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_SLAB, ARCAN_MEMALIGN_NATURAL);
 
 	surface_transform* current = res;
 
@@ -1444,7 +1881,7 @@ static surface_transform* dup_chain(surface_transform* base)
 
 		if (base->next)
 			current->next = arcan_alloc_mem( sizeof(surface_transform),
-			ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_SLAB, ARCAN_MEMALIGN_NATURAL);
 		else
 			current->next = NULL;
 
@@ -1532,6 +1969,8 @@ arcan_errc arcan_video_linkobjs(arcan_vobj_id srcid,
 	src->p_anchor = anchorp;
 	src->mask = mask;
 	src->p_scale = scalem;
+	if (src->valid_cache)
+		pickidx_moved(src);
 	src->valid_cache = false;
 
 /* already linked to dst? do nothing */
@@ -1594,6 +2033,107 @@ arcan_errc arcan_video_init(uint16_t width, uint16_t height, uint8_t bpp,
 		if (get_config("video_ignore_dirty", 0, NULL, tag)){
 			arcan_video_display.ignore_dirty = SIZE_MAX >> 1;
 		}
+
+/* large scenes benefit from resolving all transforms in one packed sweep
+ * before drawing, smaller ones pay for the extra pass */
+		if (get_config("video_soa_tfcache", 0, NULL, tag)){
+			arcan_video_display.soa_tfcache = true;
+		}
+
+/* track per-object damage and scissor rendertarget passes to what changed */
+		if (get_config("video_damage_regions", 0, NULL, tag)){
+			arcan_video_display.damage_regions = true;
+		}
+
+/* grid index of world-space bounds for picking and culling */
+		if (get_config("video_pick_index", 0, NULL, tag)){
+			arcan_video_display.pick_index = true;
+		}
+
+/* CPU-transformed vertex batches for runs of plain textured quads */
+		if (get_config("video_batch_draws", 0, NULL, tag)){
+			arcan_video_display.batch_draws = true;
+		}
+
+/* format string text as quads over a shared glyph atlas */
+		if (get_config("video_text_atlas", 0, NULL, tag)){
+			arcan_video_display.text_atlas = true;
+		}
+
+/* kilobytes of rastered text runs kept for re-rendering partially changed text */
+		char* tcarg;
+		if (get_config("video_text_cache", 0, &tcarg, tag) && tcarg){
+			arcan_renderfun_textcache(strtoul(tcarg, NULL, 10) * 1024);
+			free(tcarg);
+		}
+
+/* TPACK clients drawn by shader from a cell grid instead of the cpu raster,
+ * opt-in, see the notes on the GPU path in arcan_renderfun.c */
+		if (get_config("video_tpack_gpu", 0, NULL, tag)){
+			arcan_video_display.tpack_gpu = true;
+		}
+
+/* export recordtarget stores to clients that can import them */
+		if (get_config("video_export_readback", 0, NULL, tag)){
+			arcan_video_display.export_readback = true;
+		}
+
+/* bounding box culling in camera passes, occlusion implies frustum */
+		if (get_config("video_3d_culling", 0, NULL, tag)){
+			arcan_video_display.cull_3d = true;
+		}
+
+		if (get_config("video_3d_occlusion", 0, NULL, tag)){
+			arcan_video_display.cull_3d = true;
+			arcan_video_display.occlusion_3d = true;
+		}
+
+/* GPU time per rendertarget pass, see benchmark_gputime */
+		if (get_config("video_gpu_timers", 0, NULL, tag)){
+			arcan_video_display.gpu_timers = true;
+		}
+
+/* number of readbacks that may be in flight per rendertarget */
+		char* rbdepth;
+		if (get_config("video_readback_ring", 0, &rbdepth, tag) && rbdepth){
+			agp_readback_ring(strtoul(rbdepth, NULL, 10));
+			free(rbdepth);
+		}
+
+/* staging memory (MiB) for streaming uploads, 0 to disable */
+		char* ulsize;
+		if (get_config("video_upload_ring", 0, &ulsize, tag) && ulsize){
+			agp_upload_ring(strtoul(ulsize, NULL, 10));
+			free(ulsize);
+		}
+
+/* rendertarget preparation on a worker pool, only the agp_ submission is
+ * then left on the main thread */
+		char* workers;
+		if (get_config("video_prepare_threads", 0, &workers, tag) && workers){
+			arcan_video_display.prepare_threads = strtoul(workers, NULL, 10);
+			free(workers);
+		}
+
+/* asynchronous image loads, 0 workers means decode on the calling thread,
+ * and the (opt-in) decoded image cache size in megabytes */
+		char* imgarg;
+		if (get_config("video_image_workers", 0, &imgarg, tag) && imgarg){
+			loader_limit(strtoul(imgarg, NULL, 10));
+			free(imgarg);
+		}
+
+		if (get_config("video_image_cache", 0, &imgarg, tag) && imgarg){
+			arcan_img_cache_limit(strtoul(imgarg, NULL, 10) * 1024 * 1024);
+			free(imgarg);
+		}
+
+/* megabytes of resident vstores before unused images get evicted */
+		if (get_config("video_vstore_budget", 0, &imgarg, tag) && imgarg){
+			arcan_video_display.vstore_budget =
+				strtoul(imgarg, NULL, 10) * 1024 * 1024;
+			free(imgarg);
+		}
 	}
 
 	if (!platform_video_init(width, height, bpp, fs, frames, caption)){
@@ -1603,15 +2143,15 @@ arcan_errc arcan_video_init(uint16_t width, uint16_t height, uint8_t bpp,
 
 	agp_init();
 
+/* the pool is joined in video_shutdown, so respawn on every init */
+	arcan_workers_init(arcan_video_display.prepare_threads);
+
 	arcan_video_display.in_video = true;
 	arcan_video_display.conservative = conservative;
 
 	current_context->world.current.scale.x = 1.0;
 	current_context->world.current.scale.y = 1.0;
-	current_context->vitem_limit = arcan_video_display.default_vitemlim;
-	current_context->vitems_pool = arcan_alloc_mem(
-		sizeof(struct arcan_vobject) * current_context->vitem_limit,
-		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	vitem_setup(current_context);
 
 	struct monitor_mode mode = platform_video_dimensions();
 	if (mode.width == 0 || mode.height == 0){
@@ -1706,28 +2246,63 @@ arcan_errc arcan_vint_getimage(const char* fname, arcan_vobject* dst,
 		return ARCAN_ERRC_BAD_RESOURCE;
 	}
 
+	struct arcan_img_meta meta = {0};
+	uint32_t* ch_imgbuf = NULL;
+	bool vflip = dst->vstore->imageproc == IMAGEPROC_FLIPH;
+	arcan_errc rv = ARCAN_OK;
+
+/* the decode cache is keyed on the file identity (size, mtime), sources
+ * that can't be stat:ed are simply never cached */
+	struct stat fst;
+	struct arcan_img_key key = {.path = fname, .vflip = vflip};
+	bool cacheable = fstat(inres.fd, &fst) == 0;
+	if (cacheable){
+		key.mtime = fst.st_mtime;
+		key.size = fst.st_size;
+		ch_imgbuf = arcan_img_cache_get(&key, &inw, &inh, &meta);
+	}
+
+	if (ch_imgbuf)
+		arcan_release_resource(&inres);
+	else {
 /* mmap (preferred) or buffer (mmap not working / useful due to alignment) */
-	map_region inmem = arcan_map_resource(&inres, false);
-	if (inmem.ptr == NULL){
-		arcan_sem_post(asynchsynch);
+		map_region inmem = arcan_map_resource(&inres, false);
+		if (inmem.ptr == NULL){
+			arcan_sem_post(asynchsynch);
+			arcan_release_resource(&inres);
+			return ARCAN_ERRC_BAD_RESOURCE;
+		}
+
+		rv = arcan_img_decode(fname, inmem.ptr, inmem.sz,
+			&ch_imgbuf, &inw, &inh, &meta, vflip);
+
+		arcan_release_map(inmem);
 		arcan_release_resource(&inres);
-		return ARCAN_ERRC_BAD_RESOURCE;
-	}
 
-	struct arcan_img_meta meta = {0};
-	uint32_t* ch_imgbuf = NULL;
+		if (ARCAN_OK != rv)
+			goto done;
 
-	arcan_errc rv = arcan_img_decode(fname, inmem.ptr, inmem.sz,
-		&ch_imgbuf, &inw, &inh, &meta, dst->vstore->imageproc == IMAGEPROC_FLIPH);
+		if (cacheable)
+			arcan_img_cache_put(&key, ch_imgbuf, inw, inh, &meta);
+	}
 
-	arcan_release_map(inmem);
-	arcan_release_resource(&inres);
+/* no GPU support for the compressed format, try to expand it on the CPU
+ * and continue as any other decoded image */
+	if (meta.compressed && !agp_compressed_support(meta.cformat)){
+		uint32_t* expbuf =
+			arcan_img_expand((uint8_t*) ch_imgbuf, &meta, inw, inh, vflip);
+		arcan_mem_free(ch_imgbuf);
+		ch_imgbuf = expbuf;
+		meta = (struct arcan_img_meta){0};
 
-	if (ARCAN_OK != rv)
-		goto done;
+		if (!ch_imgbuf){
+			rv = ARCAN_ERRC_UNSUPPORTED_FORMAT;
+			goto done;
+		}
+	}
 
-	av_pixel* imgbuf = arcan_img_repack(ch_imgbuf, inw, inh);
-	if (!imgbuf){
+	av_pixel* imgbuf = NULL;
+	if (!meta.compressed && !(imgbuf = arcan_img_repack(ch_imgbuf, inw, inh))){
 		rv = ARCAN_ERRC_OUT_OF_SPACE;
 		goto done;
 	}
@@ -1754,8 +2329,17 @@ arcan_errc arcan_vint_getimage(const char* fname, arcan_vobject* dst,
 
 	enum arcan_vimage_mode desm = dst->vstore->scale;
 
-	if (meta.compressed)
+/* the blocks are uploaded as is, padded dimensions for the store, no
+ * stretching, repacking or flipping (vflip is ignored) */
+	if (meta.compressed){
+		dstframe->vinf.text.raw = (av_pixel*) ch_imgbuf;
+		dstframe->vinf.text.s_raw = meta.c_size;
+		dstframe->vinf.text.compressed = meta.cformat;
+		dstframe->vinf.text.mip_levels = meta.levels;
+		dstframe->w = meta.pwidth;
+		dstframe->h = meta.pheight;
 		goto push_comp;
+	}
 
 /* the user requested specific dimensions, or we are in a mode where
  * we should manually enfore a stretch to the nearest power of two */
@@ -1889,8 +2473,15 @@ arcan_errc arcan_video_shareglstore(arcan_vobj_id sid, arcan_vobj_id did)
 	if (!src || !dst || src == dst)
 		return ARCAN_ERRC_NO_SUCH_OBJECT;
 
+/* the shared store has to be resident, the refcount keeps it that way */
+	if (FL_TEST(src, FL_EVICTED))
+		arcan_vint_residency_touch(src);
+
 /* remove the original target store, substitute in our own */
 	arcan_vint_drop_vstore(dst->vstore);
+	FL_CLEAR(dst, FL_EVICTED);
+	arcan_mem_free(dst->glyphs);
+	dst->glyphs = NULL;
 
 	struct rendertarget* rtgt = arcan_vint_findrt(dst);
 
@@ -2245,6 +2836,30 @@ arcan_errc arcan_video_rendertarget_setnoclear(arcan_vobj_id did, bool value)
 	return ARCAN_OK;
 }
 
+arcan_errc arcan_video_rendertarget_gputime(arcan_vobj_id did, uint64_t* ns)
+{
+	struct rendertarget* rtgt;
+
+	if (did == ARCAN_VIDEO_WORLDID)
+		rtgt = &current_context->stdoutp;
+	else {
+		arcan_vobject* vobj = arcan_video_getobject(did);
+		if (!vobj)
+			return ARCAN_ERRC_NO_SUCH_OBJECT;
+
+		rtgt = arcan_vint_findrt(vobj);
+	}
+
+	if (!rtgt)
+		return ARCAN_ERRC_NO_SUCH_OBJECT;
+
+	if (!arcan_video_display.gpu_timers || !rtgt->gputime.last_ns)
+		return ARCAN_ERRC_UNACCEPTED_STATE;
+
+	*ns = rtgt->gputime.last_ns;
+	return ARCAN_OK;
+}
+
 arcan_errc arcan_video_linkrendertarget(arcan_vobj_id did,
 	arcan_vobj_id tgt_id, int refresh, bool scale, enum rendertarget_mode format)
 {
@@ -2374,6 +2989,9 @@ arcan_errc arcan_video_setasframe(arcan_vobj_id dst,
 	if (fid >= dstvobj->frameset->n_frames)
 		return ARCAN_ERRC_BAD_ARGUMENT;
 
+	if (FL_TEST(srcvobj, FL_EVICTED))
+		arcan_vint_residency_touch(srcvobj);
+
 	struct frameset_store* store = &dstvobj->frameset->frames[fid];
 	if (store->frame != srcvobj->vstore){
 		arcan_vint_drop_vstore(store->frame);
@@ -2392,35 +3010,165 @@ arcan_errc arcan_video_setasframe(arcan_vobj_id dst,
 	return ARCAN_OK;
 }
 
+enum loader_state {
+	LOADER_QUEUED = 0,
+	LOADER_RUNNING,
+	LOADER_DONE
+};
+
 struct thread_loader_args {
 	arcan_vobject* dst;
-	pthread_t self;
 	arcan_vobj_id dstid;
 	char* fname;
 	intptr_t tag;
 	img_cons constraints;
 	arcan_errc rc;
+
+	enum loader_state state;
+	struct thread_loader_args* next;
 };
 
-static void* thread_loader(void* in)
+/*
+ * Asynchronous loads are queued (FIFO) and serviced by a set of detached
+ * workers that are spawned on demand up to [limit] and then kept around,
+ * rather than creating (and joining) one thread per request.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+
+	struct thread_loader_args* first;
+	struct thread_loader_args* last;
+
+	size_t n_threads;
+	size_t n_idle;
+	size_t limit;
+} loader = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+	.limit = ASYNCH_CONCURRENT_THREADS
+};
+
+static void loader_run(struct thread_loader_args* largs)
 {
-	struct thread_loader_args* largs = (struct thread_loader_args*) in;
 	arcan_vobject* dst = largs->dst;
 	largs->rc = arcan_vint_getimage(largs->fname, dst, largs->constraints, true);
+
+	pthread_mutex_lock(&loader.lock);
 	dst->feed.state.tag = ARCAN_TAG_ASYNCIMGRD;
-	return 0;
+	largs->state = LOADER_DONE;
+	pthread_cond_broadcast(&loader.done);
+	pthread_mutex_unlock(&loader.lock);
 }
 
-void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force)
+static void* thread_loader(void* in)
 {
-	if (!force && img->feed.state.tag != ARCAN_TAG_ASYNCIMGRD){
-		return;
+	pthread_mutex_lock(&loader.lock);
+	for(;;){
+		while (!loader.first){
+			loader.n_idle++;
+			pthread_cond_wait(&loader.wake, &loader.lock);
+			loader.n_idle--;
+		}
+
+		struct thread_loader_args* largs = loader.first;
+		loader.first = largs->next;
+		if (!loader.first)
+			loader.last = NULL;
+		largs->next = NULL;
+		largs->state = LOADER_RUNNING;
+
+		pthread_mutex_unlock(&loader.lock);
+		loader_run(largs);
+		pthread_mutex_lock(&loader.lock);
+	}
+
+	return NULL;
+}
+
+static void loader_wait(struct thread_loader_args* largs);
+
+static void loader_limit(size_t limit)
+{
+	pthread_mutex_lock(&loader.lock);
+	loader.limit = limit;
+	pthread_mutex_unlock(&loader.lock);
+}
+
+static void loader_enqueue(struct thread_loader_args* largs)
+{
+	pthread_mutex_lock(&loader.lock);
+	largs->state = LOADER_QUEUED;
+	largs->next = NULL;
+	if (loader.last)
+		loader.last->next = largs;
+	else
+		loader.first = largs;
+	loader.last = largs;
+
+/* grow the pool if every worker is busy */
+	if (!loader.n_idle && loader.n_threads < loader.limit){
+		pthread_t pth;
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		if (0 == pthread_create(&pth, &attr, thread_loader, NULL))
+			loader.n_threads++;
+		pthread_attr_destroy(&attr);
+	}
+
+	bool inline_run = loader.n_threads == 0;
+	pthread_cond_signal(&loader.wake);
+	pthread_mutex_unlock(&loader.lock);
+
+/* no workers could be created, degrade to a synchronous load, the
+ * next poll will still pick it up and emit the result event */
+	if (inline_run)
+		loader_wait(largs);
+}
+
+/*
+ * block until [largs] has been serviced, a job that hasn't been picked up
+ * yet is removed from the queue and processed on the calling thread
+ */
+static void loader_wait(struct thread_loader_args* largs)
+{
+	pthread_mutex_lock(&loader.lock);
+	if (largs->state == LOADER_QUEUED){
+		struct thread_loader_args** cur = &loader.first;
+		struct thread_loader_args* prev = NULL;
+		while (*cur != largs){
+			prev = *cur;
+			cur = &(*cur)->next;
+		}
+		*cur = largs->next;
+		if (loader.last == largs)
+			loader.last = prev;
+		largs->next = NULL;
+		largs->state = LOADER_RUNNING;
+
+		pthread_mutex_unlock(&loader.lock);
+		loader_run(largs);
+		return;
+	}
+
+	while (largs->state != LOADER_DONE)
+		pthread_cond_wait(&loader.done, &loader.lock);
+	pthread_mutex_unlock(&loader.lock);
+}
+
+void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force)
+{
+	if (!force && img->feed.state.tag != ARCAN_TAG_ASYNCIMGRD){
+		return;
 	}
 
 	struct thread_loader_args* args =
 		(struct thread_loader_args*) img->feed.state.ptr;
 
-	pthread_join(args->self, NULL);
+	loader_wait(args);
 
 	arcan_event loadev = {
 		.category = EVENT_VIDEO,
@@ -2483,7 +3231,7 @@ static arcan_vobj_id loadimage_asynch(const char* fname,
 	dstobj->feed.state.tag = ARCAN_TAG_ASYNCIMGLD;
 	dstobj->feed.state.ptr = args;
 
-	pthread_create(&args->self, NULL, thread_loader, (void*) args);
+	loader_enqueue(args);
 
 	return rv;
 }
@@ -3267,12 +4015,15 @@ static void drop_rtarget(arcan_vobject* vobj)
 	if (dst->art)
 		agp_drop_rendertarget(dst->art);
 	dst->art = NULL;
+	prep_free(dst);
+	pickidx_free(dst);
+	gputime_free(dst);
 
 /* create a temporary copy of all the elements in the rendertarget,
  * this will be a noop for a linked rendertarget */
 	arcan_vobject_litem* current = dst->first;
 	size_t pool_sz = (dst->color->extrefc.attachments) * sizeof(arcan_vobject*);
-	pool = arcan_alloc_mem(pool_sz, ARCAN_MEM_VSTRUCT, ARCAN_MEM_TEMPORARY,
+	pool = arcan_alloc_mem(pool_sz, ARCAN_MEM_VSTRUCT, ARCAN_MEM_FRAME,
 		ARCAN_MEMALIGN_NATURAL);
 
 /* note the contents of the rendertarget as "detached" from the source vobj */
@@ -3391,11 +4142,10 @@ arcan_errc arcan_video_deleteobject(arcan_vobj_id id)
 
 /* when a persist is defined in a lower layer, we know that the lowest layer
  * is the last on to have the persistflag) */
-	if (FL_TEST(vobj, FL_PRSIST) &&
-		(vcontext_ind > 0 && FL_TEST(
-			&vcontext_stack[vcontext_ind - 1].vitems_pool[
-			vobj->cellid], FL_PRSIST))
-	)
+	arcan_vobject* shadow = vcontext_ind > 0 ?
+		arcan_vint_vitem(&vcontext_stack[vcontext_ind - 1], vobj->cellid) : NULL;
+
+	if (FL_TEST(vobj, FL_PRSIST) && shadow && FL_TEST(shadow, FL_PRSIST))
 		return ARCAN_ERRC_UNACCEPTED_STATE;
 
 /* step one, disassociate from ALL rendertargets,  */
@@ -3470,11 +4220,13 @@ arcan_errc arcan_video_deleteobject(arcan_vobj_id id)
 	}
 
 	arcan_mem_free(vobj->tracetag);
+	arcan_mem_free(vobj->glyphs);
 	arcan_vint_dropshape(vobj);
 
 /* lots of default values are assumed to be 0, so reset the
  * entire object to be sure. will help leak detectors as well */
 	memset(vobj, 0, sizeof(arcan_vobject));
+	vitem_release(current_context, id);
 
 	for (size_t i = 0; i < cascade_c; i++){
 		if (!pool[i])
@@ -3636,10 +4388,12 @@ arcan_errc arcan_video_objectrotate3d(arcan_vobj_id id,
 	if (!base){
 		if (last)
 			base = last->next = arcan_alloc_mem(sizeof(surface_transform),
-							ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+							ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_SLAB,
+							ARCAN_MEMALIGN_NATURAL);
 		else
 			base = last = arcan_alloc_mem(sizeof(surface_transform),
-				ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+				ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_SLAB,
+				ARCAN_MEMALIGN_NATURAL);
 	}
 
 	if (!vobj->transform)
@@ -3730,64 +4484,76 @@ arcan_errc arcan_video_origoshift(arcan_vobj_id id,
 	return ARCAN_OK;
 }
 
-/* alter object opacity, range 0..1 */
-arcan_errc arcan_video_objectopacity(arcan_vobj_id id,
+/*
+ * The chain- appending part of objectopacity, objectmove and objectscale,
+ * these work on an already resolved object and return the link that was
+ * appended (NULL if the change was immediate) so that the batch version
+ * can set interpolation without walking the chain a second time.
+ */
+static surface_transform* vobj_opacity(arcan_vobject* vobj,
 	float opa, unsigned int tv)
 {
-	arcan_errc rv = ARCAN_ERRC_NO_SUCH_OBJECT;
-	arcan_vobject* vobj = arcan_video_getobject(id);
+	surface_transform* base = NULL;
 	opa = CLAMP(opa, 0.0, 1.0);
+	invalidate_cache(vobj);
 
-	if (vobj){
-		rv = ARCAN_OK;
-		invalidate_cache(vobj);
+	/* clear chains for rotate attribute
+	 * if time is set to ovverride and be immediate */
+	if (tv == 0){
+		swipe_chain(vobj->transform, offsetof(surface_transform, blend),
+			sizeof(struct transf_blend));
+		vobj->current.opa = opa;
+	}
+	else { /* find endpoint to attach at */
+		float bv = vobj->current.opa;
 
-		/* clear chains for rotate attribute
-		 * if time is set to ovverride and be immediate */
-		if (tv == 0){
-			swipe_chain(vobj->transform, offsetof(surface_transform, blend),
-				sizeof(struct transf_blend));
-			vobj->current.opa = opa;
+		base = vobj->transform;
+		surface_transform* last = base;
+
+		while (base && base->blend.startt){
+			bv = base->blend.endopa;
+			last = base;
+			base = base->next;
 		}
-		else { /* find endpoint to attach at */
-			float bv = vobj->current.opa;
 
-			surface_transform* base = vobj->transform;
-			surface_transform* last = base;
+		if (!base){
+			if (last)
+				base = last->next =
+					arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
+						ARCAN_MEM_BZERO | ARCAN_MEM_SLAB, ARCAN_MEMALIGN_NATURAL);
+			else
+				base = last =
+					arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
+						ARCAN_MEM_BZERO | ARCAN_MEM_SLAB, ARCAN_MEMALIGN_NATURAL);
+		}
 
-			while (base && base->blend.startt){
-				bv = base->blend.endopa;
-				last = base;
-				base = base->next;
-			}
+		if (!vobj->transform)
+			vobj->transform = base;
 
-			if (!base){
-				if (last)
-					base = last->next =
-						arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-							ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
-				else
-					base = last =
-						arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-							ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
-			}
+		if (vobj->owner)
+			vobj->owner->transfc++;
 
-			if (!vobj->transform)
-				vobj->transform = base;
+		base->blend.startt = last->blend.endt < arcan_video_display.c_ticks ?
+			arcan_video_display.c_ticks : last->blend.endt;
+		base->blend.endt = base->blend.startt + tv;
+		base->blend.startopa = bv;
+		base->blend.endopa = opa + EPSILON;
+		base->blend.interp = ARCAN_VINTER_LINEAR;
+	}
 
-			if (vobj->owner)
-				vobj->owner->transfc++;
+	return base;
+}
 
-			base->blend.startt = last->blend.endt < arcan_video_display.c_ticks ?
-				arcan_video_display.c_ticks : last->blend.endt;
-			base->blend.endt = base->blend.startt + tv;
-			base->blend.startopa = bv;
-			base->blend.endopa = opa + EPSILON;
-			base->blend.interp = ARCAN_VINTER_LINEAR;
-		}
-	}
+/* alter object opacity, range 0..1 */
+arcan_errc arcan_video_objectopacity(arcan_vobj_id id,
+	float opa, unsigned int tv)
+{
+	arcan_vobject* vobj = arcan_video_getobject(id);
+	if (!vobj)
+		return ARCAN_ERRC_NO_SUCH_OBJECT;
 
-	return rv;
+	vobj_opacity(vobj, opa, tv);
+	return ARCAN_OK;
 }
 
 arcan_errc arcan_video_blendinterp(arcan_vobj_id id, enum arcan_vinterp inter)
@@ -3858,14 +4624,9 @@ arcan_errc arcan_video_moveinterp(arcan_vobj_id id, enum arcan_vinterp inter)
  * otherwise time denotes how many ticks it should take to move the object
  * from its start position to it's final.
  * An event will in this case be generated */
-arcan_errc arcan_video_objectmove(arcan_vobj_id id, float newx,
-	float newy, float newz, unsigned int tv)
+static surface_transform* vobj_move(arcan_vobject* vobj,
+	float newx, float newy, float newz, unsigned int tv)
 {
-	arcan_vobject* vobj = arcan_video_getobject(id);
-
-	if (!vobj)
-		return ARCAN_ERRC_NO_SUCH_OBJECT;
-
 	invalidate_cache(vobj);
 
 /* clear chains for rotate attribute
@@ -3876,7 +4637,7 @@ arcan_errc arcan_video_objectmove(arcan_vobj_id id, float newx,
 		vobj->current.position.x = newx;
 		vobj->current.position.y = newy;
 		vobj->current.position.z = newz;
-		return ARCAN_OK;
+		return NULL;
 	}
 
 /* find endpoint to attach at */
@@ -3897,11 +4658,11 @@ arcan_errc arcan_video_objectmove(arcan_vobj_id id, float newx,
 		if (last)
 			base = last->next =
 				arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-					ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+					ARCAN_MEM_BZERO | ARCAN_MEM_SLAB, ARCAN_MEMALIGN_NATURAL);
 		else
 			base = last =
 				arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-					ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+					ARCAN_MEM_BZERO | ARCAN_MEM_SLAB, ARCAN_MEMALIGN_NATURAL);
 	}
 
 	point newp = {newx, newy, newz};
@@ -3918,6 +4679,18 @@ arcan_errc arcan_video_objectmove(arcan_vobj_id id, float newx,
 	if (vobj->owner)
 		vobj->owner->transfc++;
 
+	return base;
+}
+
+arcan_errc arcan_video_objectmove(arcan_vobj_id id, float newx,
+	float newy, float newz, unsigned int tv)
+{
+	arcan_vobject* vobj = arcan_video_getobject(id);
+
+	if (!vobj)
+		return ARCAN_ERRC_NO_SUCH_OBJECT;
+
+	vobj_move(vobj, newx, newy, newz, tv);
 	return ARCAN_OK;
 }
 
@@ -3925,66 +4698,128 @@ arcan_errc arcan_video_objectmove(arcan_vobj_id id, float newx,
  * stepy at 0 it will be instantaneous,
  * otherwise it will move at stepx % of delta-size each tick
  * return value is an errorcode, run through char* arcan_verror(int8_t) */
+static surface_transform* vobj_scale(arcan_vobject* vobj,
+	float wf, float hf, float df, unsigned tv)
+{
+	surface_transform* base = NULL;
+	const int immediately = 0;
+	invalidate_cache(vobj);
+
+	if (tv == immediately){
+		swipe_chain(vobj->transform, offsetof(surface_transform, scale),
+			sizeof(struct transf_scale));
+
+		vobj->current.scale.x = wf;
+		vobj->current.scale.y = hf;
+		vobj->current.scale.z = df;
+	}
+	else {
+		base = vobj->transform;
+		surface_transform* last = base;
+
+/* figure out the coordinates which the transformation is chained to */
+		scalefactor bs = vobj->current.scale;
+
+		while (base && base->scale.startt){
+			bs = base->scale.endd;
+
+			last = base;
+			base = base->next;
+		}
+
+		if (!base){
+			if (last)
+				base = last->next = arcan_alloc_mem(sizeof(surface_transform),
+					ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_SLAB,
+					ARCAN_MEMALIGN_NATURAL);
+			else
+				base = last = arcan_alloc_mem(sizeof(surface_transform),
+					ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_SLAB,
+					ARCAN_MEMALIGN_NATURAL);
+		}
+
+		if (!vobj->transform)
+			vobj->transform = base;
+
+		base->scale.startt = last->scale.endt < arcan_video_display.c_ticks ?
+			arcan_video_display.c_ticks : last->scale.endt;
+		base->scale.endt = base->scale.startt + tv;
+		base->scale.interp = ARCAN_VINTER_LINEAR;
+		base->scale.startd = bs;
+		base->scale.endd.x = wf;
+		base->scale.endd.y = hf;
+		base->scale.endd.z = df;
+
+		if (vobj->owner)
+			vobj->owner->transfc++;
+	}
+
+	return base;
+}
+
 arcan_errc arcan_video_objectscale(arcan_vobj_id id, float wf,
 	float hf, float df, unsigned tv)
 {
-	arcan_errc rv = ARCAN_ERRC_NO_SUCH_OBJECT;
 	arcan_vobject* vobj = arcan_video_getobject(id);
+	if (!vobj)
+		return ARCAN_ERRC_NO_SUCH_OBJECT;
 
-	if (vobj){
-		const int immediately = 0;
-		rv = ARCAN_OK;
-		invalidate_cache(vobj);
-
-		if (tv == immediately){
-			swipe_chain(vobj->transform, offsetof(surface_transform, scale),
-				sizeof(struct transf_scale));
+	vobj_scale(vobj, wf, hf, df, tv);
+	return ARCAN_OK;
+}
 
-			vobj->current.scale.x = wf;
-			vobj->current.scale.y = hf;
-			vobj->current.scale.z = df;
-		}
-		else {
-			surface_transform* base = vobj->transform;
-			surface_transform* last = base;
+size_t arcan_video_transform_batch(enum arcan_batch_transform kind,
+	const arcan_vobj_id* ids, const float* vals, size_t n,
+	unsigned tv, int interp)
+{
+	size_t count = 0;
+	bool use_interp = tv > 0 && interp >= 0 && interp < ARCAN_VINTER_ENDMARKER;
+	size_t stride = kind == ARCAN_BATCH_BLEND ? 1 : 2;
 
-/* figure out the coordinates which the transformation is chained to */
-			scalefactor bs = vobj->current.scale;
+	for (size_t i = 0; i < n; i++, vals += stride){
+		arcan_vobject* vobj = arcan_video_getobject(ids[i]);
+		if (!vobj)
+			continue;
 
-			while (base && base->scale.startt){
-				bs = base->scale.endd;
+		surface_transform* link;
+		count++;
 
-				last = base;
-				base = base->next;
-			}
+		switch (kind){
+		case ARCAN_BATCH_MOVE:
+			link = vobj_move(vobj, vals[0], vals[1], 1.0, tv);
+			if (link && use_interp)
+				link->move.interp = interp;
+		break;
 
-			if (!base){
-				if (last)
-					base = last->next = arcan_alloc_mem(sizeof(surface_transform),
-						ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
-				else
-					base = last = arcan_alloc_mem(sizeof(surface_transform),
-						ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+/* absolute dimensions, 0 in one axis retains the aspect ratio */
+		case ARCAN_BATCH_RESIZE:{
+			float w = vals[0], h = vals[1];
+			if ((w < EPSILON && h < EPSILON) || !vobj->origw || !vobj->origh){
+				count--;
+				continue;
 			}
 
-			if (!vobj->transform)
-				vobj->transform = base;
+			if (w < EPSILON)
+				w = h * ((float)vobj->origw / vobj->origh);
+			else if (h < EPSILON)
+				h = w * ((float)vobj->origh / vobj->origw);
 
-			base->scale.startt = last->scale.endt < arcan_video_display.c_ticks ?
-				arcan_video_display.c_ticks : last->scale.endt;
-			base->scale.endt = base->scale.startt + tv;
-			base->scale.interp = ARCAN_VINTER_LINEAR;
-			base->scale.startd = bs;
-			base->scale.endd.x = wf;
-			base->scale.endd.y = hf;
-			base->scale.endd.z = df;
+			link = vobj_scale(vobj,
+				ceilf(w) / vobj->origw, ceilf(h) / vobj->origh, 1.0, tv);
+			if (link && use_interp)
+				link->scale.interp = interp;
+		}
+		break;
 
-			if (vobj->owner)
-				vobj->owner->transfc++;
+		case ARCAN_BATCH_BLEND:
+			link = vobj_opacity(vobj, vals[0], tv);
+			if (link && use_interp)
+				link->blend.interp = interp;
+		break;
 		}
 	}
 
-	return rv;
+	return count;
 }
 
 /*
@@ -4358,13 +5193,42 @@ static inline bool process_counter(
 	return false;
 }
 
+/* if the feed has opted in to taking buffers, the store is exported and the
+ * handles passed on instead of going through a readback and a copy */
+static bool export_readback(struct rendertarget* tgt)
+{
+	arcan_vobject* vobj = tgt->color;
+	if (!arcan_video_display.export_readback || !vobj->feed.ffunc)
+		return false;
+
+	arcan_vfunc_cb ffunc = arcan_ffunc_lookup(vobj->feed.ffunc);
+	if (FRV_GOTFRAME != ffunc(FFUNC_READBACK_HANDLE,
+		NULL, 0, 0, 0, 0, vobj->feed.state, vobj->cellid))
+		return false;
+
+	struct agp_buffer_plane planes[4];
+	size_t n = platform_video_export_vstore(vobj->vstore, planes, COUNT_OF(planes));
+	if (!n)
+		return false;
+
+	return FRV_GOTFRAME == ffunc(FFUNC_READBACK_HANDLE,
+		(av_pixel*) planes, n, vobj->vstore->w, vobj->vstore->h, 0,
+		vobj->feed.state, vobj->cellid
+	);
+}
+
+/* requests queue in the agp readback ring, so earlier ones being in flight
+ * doesn't block a new one - if the ring is full the frame is dropped */
 static inline void process_readback(struct rendertarget* tgt, float fract)
 {
-	if (!FL_TEST(tgt, TGTFL_READING) &&
-		process_counter(tgt, &tgt->readcnt, tgt->readback, fract)){
-		agp_request_readback(tgt->color->vstore);
+	if (!process_counter(tgt, &tgt->readcnt, tgt->readback, fract))
+		return;
+
+	if (export_readback(tgt))
+		return;
+
+	if (agp_request_readback(tgt->color->vstore))
 		FL_SET(tgt, TGTFL_READING);
-	}
 }
 
 /*
@@ -4454,6 +5318,8 @@ unsigned arcan_video_tick(unsigned steps, unsigned* njobs)
 		steps = steps - 1;
 	} while (steps);
 
+	residency_enforce();
+
 	if (njobs)
 		*njobs = arcan_video_display.dirty;
 
@@ -4579,6 +5445,127 @@ static void apply(arcan_vobject* vobj, surface_properties* dprops,
 	}
 }
 
+static void tfcache_free(struct vobject_tfcache* cache)
+{
+	arcan_mem_free(cache->gen);
+	arcan_mem_free(cache->position);
+	arcan_mem_free(cache->scale);
+	arcan_mem_free(cache->rotation);
+	arcan_mem_free(cache->opacity);
+	arcan_mem_free(cache->world);
+	*cache = (struct vobject_tfcache){0};
+}
+
+static bool tfcache_alloc(struct vobject_tfcache* cache, size_t limit)
+{
+	tfcache_free(cache);
+	int fl = ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL;
+
+	cache->gen = arcan_alloc_mem(sizeof(uint64_t) * limit,
+		ARCAN_MEM_VSTRUCT, fl, ARCAN_MEMALIGN_NATURAL);
+	cache->position = arcan_alloc_mem(sizeof(point) * limit,
+		ARCAN_MEM_VSTRUCT, fl, ARCAN_MEMALIGN_SIMD);
+	cache->scale = arcan_alloc_mem(sizeof(scalefactor) * limit,
+		ARCAN_MEM_VSTRUCT, fl, ARCAN_MEMALIGN_SIMD);
+	cache->rotation = arcan_alloc_mem(sizeof(surface_orientation) * limit,
+		ARCAN_MEM_VSTRUCT, fl, ARCAN_MEMALIGN_SIMD);
+	cache->opacity = arcan_alloc_mem(sizeof(float) * limit,
+		ARCAN_MEM_VSTRUCT, fl, ARCAN_MEMALIGN_SIMD);
+	cache->world = arcan_alloc_mem(sizeof(float) * 16 * limit,
+		ARCAN_MEM_VSTRUCT, fl, ARCAN_MEMALIGN_SIMD);
+
+	if (!cache->gen || !cache->position || !cache->scale ||
+		!cache->rotation || !cache->opacity || !cache->world){
+		tfcache_free(cache);
+		return false;
+	}
+
+	cache->limit = limit;
+	return true;
+}
+
+/* fetch the resolved properties for [vobj] if they have been populated in the
+ * currently active rendertarget pass */
+static inline bool tfcache_lookup(arcan_vobject* vobj, surface_properties* dst)
+{
+	struct vobject_tfcache* cache = &current_context->tfcache;
+	size_t i = vobj->cellid;
+
+	if (!cache->active || i == 0 || i >= cache->limit ||
+		cache->gen[i] != cache->active)
+		return false;
+
+	dst->position = cache->position[i];
+	dst->scale = cache->scale[i];
+	dst->rotation = cache->rotation[i];
+	dst->opa = cache->opacity[i];
+	return true;
+}
+
+static inline float* tfcache_world(arcan_vobject* vobj)
+{
+	struct vobject_tfcache* cache = &current_context->tfcache;
+	size_t i = vobj->cellid;
+
+	if (!cache->active || i == 0 || i >= cache->limit ||
+		cache->gen[i] != cache->active)
+		return NULL;
+
+	return &cache->world[i * 16];
+}
+
+static inline void tfcache_invalidate(arcan_vobject* vobj)
+{
+	struct vobject_tfcache* cache = &current_context->tfcache;
+	if (vobj->cellid < cache->limit)
+		cache->gen[vobj->cellid] = 0;
+}
+
+/*
+ * Linear resolve pass over the pipeline of [tgt], populating the packed cache
+ * with properties and modelview for every object in the 2D range. Parents that
+ * appear before their children in the pipeline will be picked up from the
+ * cache rather than resolved again.
+ */
+static void tfcache_resolve(struct rendertarget* tgt, float fract)
+{
+	struct vobject_tfcache* cache = &current_context->tfcache;
+	cache->active = 0;
+
+	if (!arcan_video_display.soa_tfcache)
+		return;
+
+/* follow the backed range of the pool rather than the context limit */
+	size_t backed = current_context->vitem_nchunks * VITEM_CHUNK_SIZE;
+	if (cache->limit != backed && !tfcache_alloc(cache, backed))
+		return;
+
+	cache->active = ++cache->counter;
+
+	for (arcan_vobject_litem* cur = tgt->first; cur; cur = cur->next){
+		arcan_vobject* elem = cur->elem;
+		if (elem->order < 0 || elem->order < tgt->min_order)
+			continue;
+
+		if (elem->order > tgt->max_order)
+			break;
+
+		size_t i = elem->cellid;
+		surface_properties dprops = empty_surface();
+		arcan_resolve_vidprop(elem, fract, &dprops);
+
+		cache->position[i] = dprops.position;
+		cache->scale[i] = dprops.scale;
+		cache->rotation[i] = dprops.rotation;
+		cache->opacity[i] = dprops.opa;
+
+		if (dprops.opa > EPSILON)
+			build_modelview(&cache->world[i * 16], tgt->base, &dprops, elem);
+
+		cache->gen[i] = cache->active;
+	}
+}
+
 /*
  * Caching works as follows;
  * Any object that has a parent with an ongoing transformation
@@ -4588,8 +5575,8 @@ static void apply(arcan_vobject* vobj, surface_properties* dprops,
  * which is then re-used every rendercall.
  * Queueing a transformation immediately invalidates the cache.
  */
-void arcan_resolve_vidprop(
-	arcan_vobject* vobj, float lerp, surface_properties* props)
+static void resolve_vidprop(arcan_vobject* vobj,
+	float lerp, surface_properties* props, bool store)
 {
 	if (vobj->valid_cache)
 		*props = vobj->prop_cache;
@@ -4599,7 +5586,8 @@ void arcan_resolve_vidprop(
  * that is questionable without more real-world data */
 	else if (vobj->parent && vobj->parent != &current_context->world){
 		surface_properties dprop = empty_surface();
-		arcan_resolve_vidprop(vobj->parent, lerp, &dprop);
+		if (!tfcache_lookup(vobj->parent, &dprop))
+			resolve_vidprop(vobj->parent, lerp, &dprop, store);
 
 /* now apply the parent chain to ourselves */
 		apply(vobj, props, &dprop, lerp, false);
@@ -4675,7 +5663,7 @@ void arcan_resolve_vidprop(
 		current = current->parent;
 	}
 
-	if (can_cache && vobj->owner && !vobj->valid_cache){
+	if (store && can_cache && vobj->owner && !vobj->valid_cache){
 		surface_properties dprop = *props;
 		vobj->prop_cache  = *props;
 		vobj->valid_cache = true;
@@ -4685,6 +5673,12 @@ void arcan_resolve_vidprop(
 		;
 }
 
+void arcan_resolve_vidprop(
+	arcan_vobject* vobj, float lerp, surface_properties* props)
+{
+	resolve_vidprop(vobj, lerp, props, true);
+}
+
 static void calc_cp_area(arcan_vobject* vobj, point* ul, point* lr)
 {
 	surface_properties cur;
@@ -4702,7 +5696,12 @@ static void calc_cp_area(arcan_vobject* vobj, point* ul, point* lr)
 		calc_cp_area(vobj->parent, ul, lr);
 }
 
-static inline void build_modelview(float* dmatr,
+/*
+ * Same as build_modelview but without any side effects on [src], returns the
+ * rotation state rather than storing it so that it can be used from threads
+ * (see rendertarget preparation)
+ */
+static bool build_modelview_pure(float* dmatr,
 	float* imatr, surface_properties* prop, arcan_vobject* src)
 {
 	float _Alignas(16) omatr[16];
@@ -4715,14 +5714,14 @@ static inline void build_modelview(float* dmatr,
 	prop->position.x += prop->scale.x;
 	prop->position.y += prop->scale.y;
 
-	src->rotate_state =
+	bool rotate_state =
 		fabsf(prop->rotation.roll)  > EPSILON ||
 		fabsf(prop->rotation.pitch) > EPSILON ||
 		fabsf(prop->rotation.yaw)   > EPSILON;
 
 	memcpy(tmatr, imatr, sizeof(float) * 16);
 
-	if (src->rotate_state){
+	if (rotate_state){
 		if (FL_TEST(src, FL_FULL3D))
 			matr_quatf(norm_quat (prop->rotation.quaternion), omatr);
 		else
@@ -4743,10 +5742,18 @@ static inline void build_modelview(float* dmatr,
 	else
 		translate_matrix(tmatr, prop->position.x, prop->position.y, 0.0);
 
-	if (src->rotate_state)
+	if (rotate_state)
 		multiply_matrix(dmatr, tmatr, omatr);
 	else
 		memcpy(dmatr, tmatr, sizeof(float) * 16);
+
+	return rotate_state;
+}
+
+static inline void build_modelview(float* dmatr,
+	float* imatr, surface_properties* prop, arcan_vobject* src)
+{
+	src->rotate_state = build_modelview_pure(dmatr, imatr, prop, src);
 }
 
 static inline float time_ratio(arcan_tickv start, arcan_tickv stop)
@@ -4791,41 +5798,202 @@ static void update_shenv(arcan_vobject* src, surface_properties* prop)
 	}
 }
 
-static inline void setup_surf(struct rendertarget* dst,
-	surface_properties* prop, arcan_vobject* src, float** mv)
-{
-/* just temporary storage/scratch */
-	static float _Alignas(16) dmatr[16];
+/*
+ * Set while the serial submission in process_rendertarget draws an object that
+ * has a prepared modelview (see prepare_rendertargets), main thread only.
+ */
+static struct {
+	arcan_vobject* vobj;
+	float* mv;
+} prep_current;
 
-	if (src->feed.state.tag == ARCAN_TAG_ASYNCIMGLD)
-		return;
+static void prep_free(struct rendertarget* tgt)
+{
+	arcan_mem_free(tgt->prep.props);
+	arcan_mem_free(tgt->prep.world);
+	arcan_mem_free(tgt->prep.rotate);
+	tgt->prep.props = NULL;
+	tgt->prep.world = NULL;
+	tgt->prep.rotate = NULL;
+	tgt->prep.limit = tgt->prep.count = 0;
+	tgt->prep.cookie = 0;
+	tgt->prep.first = NULL;
+}
 
-/* currently, we only cache the primary rendertarget, and the better option is
- * to actually remove secondary attachments etc. now that we have order-peeling
- * and sharestorage there should really just be 1:1 between src and dst */
-	if (src->valid_cache && dst == src->owner){
-		prop->scale.x *= src->origw * 0.5f;
-		prop->scale.y *= src->origh * 0.5f;
-		prop->position.x += prop->scale.x;
-		prop->position.y += prop->scale.y;
-		*mv = src->prop_matr;
+/* count the 2D range of the pipeline and make sure the buffers fit */
+static bool prep_setup(struct rendertarget* tgt)
+{
+	size_t count = 0;
+	for (arcan_vobject_litem* cur = tgt->first; cur; cur = cur->next){
+		if (cur->elem->order < 0 || cur->elem->order < tgt->min_order)
+			continue;
+		if (cur->elem->order > tgt->max_order)
+			break;
+		count++;
 	}
-	else {
-		build_modelview(dmatr, dst->base, prop, src);
-		*mv = dmatr;
+
+	if (!count)
+		return false;
+
+	if (count > tgt->prep.limit){
+		size_t limit = count + 64;
+		prep_free(tgt);
+		int fl = ARCAN_MEM_NONFATAL;
+
+		tgt->prep.props = arcan_alloc_mem(sizeof(surface_properties) * limit,
+			ARCAN_MEM_VSTRUCT, fl, ARCAN_MEMALIGN_NATURAL);
+		tgt->prep.world = arcan_alloc_mem(sizeof(float) * 16 * limit,
+			ARCAN_MEM_VSTRUCT, fl, ARCAN_MEMALIGN_SIMD);
+		tgt->prep.rotate = arcan_alloc_mem(sizeof(bool) * limit,
+			ARCAN_MEM_VSTRUCT, fl, ARCAN_MEMALIGN_NATURAL);
+
+		if (!tgt->prep.props || !tgt->prep.world || !tgt->prep.rotate){
+			prep_free(tgt);
+			return false;
+		}
+		tgt->prep.limit = limit;
 	}
-	update_shenv(src, prop);
+
+	tgt->prep.count = 0;
+	return true;
 }
 
-static inline void setup_shape_surf(struct rendertarget* dst,
-	surface_properties* prop, arcan_vobject* src, float** mv)
-{
-	static float _Alignas(16) dmatr[16];
-	surface_properties oldprop = *prop;
-	if (src->feed.state.tag == ARCAN_TAG_ASYNCIMGLD)
-		return;
+struct prep_batch {
+	struct rendertarget** set;
+	float fract;
+};
 
-	build_modelview(dmatr, dst->base, prop, src);
+/*
+ * Worker side of the preparation, this may only read from the vobjects in the
+ * pipeline and write to the prep- buffers of its own rendertarget.
+ */
+static void prep_job(void* tag, size_t ind)
+{
+	struct prep_batch* batch = tag;
+	struct rendertarget* tgt = batch->set[ind];
+	size_t pi = 0;
+
+	for (arcan_vobject_litem* cur = tgt->first;
+		cur && pi < tgt->prep.limit; cur = cur->next){
+		arcan_vobject* elem = cur->elem;
+		if (elem->order < 0 || elem->order < tgt->min_order)
+			continue;
+
+		if (elem->order > tgt->max_order)
+			break;
+
+		surface_properties dprops = empty_surface();
+		resolve_vidprop(elem, batch->fract, &dprops, false);
+		tgt->prep.props[pi] = dprops;
+		tgt->prep.rotate[pi] = elem->rotate_state;
+
+		if (dprops.opa > EPSILON && elem != tgt->color)
+			tgt->prep.rotate[pi] = build_modelview_pure(
+				&tgt->prep.world[pi * 16], tgt->base, &dprops, elem);
+
+		pi++;
+	}
+
+	tgt->prep.count = pi;
+}
+
+/* the same predicate as steptgt + the early-out in process_rendertarget */
+static bool prep_wanted(struct rendertarget* tgt)
+{
+	if (!(tgt->refresh < 0 && tgt->refreshcnt <= 1) || !tgt->first)
+		return false;
+
+	return arcan_video_display.dirty ||
+		arcan_video_display.ignore_dirty || tgt->dirtyc || tgt->transfc;
+}
+
+/*
+ * Run the CPU side of the coming rendertarget passes (property resolution and
+ * modelview building) as one job per rendertarget on the worker pool. The
+ * results are only consumed in the serial submission, so the output is the
+ * same regardless of the number of workers.
+ */
+static void prepare_rendertargets(float fract)
+{
+	if (!arcan_workers_count())
+		return;
+
+	struct rendertarget* set[RENDERTARGET_LIMIT + 1];
+	size_t count = 0;
+
+	for (size_t i = 0; i < current_context->n_rtargets; i++){
+		struct rendertarget* tgt = &current_context->rtargets[i];
+		if (prep_wanted(tgt) && prep_setup(tgt))
+			set[count++] = tgt;
+	}
+
+	if (prep_wanted(&current_context->stdoutp) &&
+		prep_setup(&current_context->stdoutp))
+		set[count++] = &current_context->stdoutp;
+
+	struct prep_batch batch = {
+		.set = set,
+		.fract = fract
+	};
+
+	arcan_workers_dispatch(prep_job, &batch, count);
+
+	for (size_t i = 0; i < count; i++){
+		set[i]->prep.cookie = arcan_video_display.cookie;
+		set[i]->prep.first = set[i]->first;
+	}
+}
+
+static void prep_invalidate()
+{
+	for (size_t i = 0; i < current_context->n_rtargets; i++)
+		current_context->rtargets[i].prep.cookie = 0;
+	current_context->stdoutp.prep.cookie = 0;
+}
+
+static inline bool resolve_surf(struct rendertarget* dst,
+	surface_properties* prop, arcan_vobject* src, float** mv)
+{
+/* just temporary storage/scratch */
+	static float _Alignas(16) dmatr[16];
+
+	if (src->feed.state.tag == ARCAN_TAG_ASYNCIMGLD)
+		return false;
+
+/* currently, we only cache the primary rendertarget, and the better option is
+ * to actually remove secondary attachments etc. now that we have order-peeling
+ * and sharestorage there should really just be 1:1 between src and dst */
+	float* cached = prep_current.vobj == src ? prep_current.mv : tfcache_world(src);
+	if ((src->valid_cache && dst == src->owner) || cached){
+		prop->scale.x *= src->origw * 0.5f;
+		prop->scale.y *= src->origh * 0.5f;
+		prop->position.x += prop->scale.x;
+		prop->position.y += prop->scale.y;
+		*mv = cached ? cached : src->prop_matr;
+	}
+	else {
+		build_modelview(dmatr, dst->base, prop, src);
+		*mv = dmatr;
+	}
+	return true;
+}
+
+static inline void setup_surf(struct rendertarget* dst,
+	surface_properties* prop, arcan_vobject* src, float** mv)
+{
+	if (resolve_surf(dst, prop, src, mv))
+		update_shenv(src, prop);
+}
+
+static inline void setup_shape_surf(struct rendertarget* dst,
+	surface_properties* prop, arcan_vobject* src, float** mv)
+{
+	static float _Alignas(16) dmatr[16];
+	surface_properties oldprop = *prop;
+	if (src->feed.state.tag == ARCAN_TAG_ASYNCIMGLD)
+		return;
+
+	build_modelview(dmatr, dst->base, prop, src);
 	*mv = dmatr;
 	scale_matrix(*mv, prop->scale.x, prop->scale.y, 1.0);
 	update_shenv(src, prop);
@@ -4938,7 +6106,8 @@ static void ffunc_process(arcan_vobject* dst, bool step)
 		);
 		TRACE_MARK_EXIT("video", "feed-render", TRACE_SYS_DEFAULT, dst->cellid, 0, dst->tracetag);
 
-/* for statistics, mark an upload */
+/* for statistics, mark an upload, the sequence covers imported handles */
+		dst->vstore->update_seq++;
 		arcan_video_display.dirty++;
 		dst->owner->uploadc++;
 		dst->owner->transfc++;
@@ -5106,6 +6275,179 @@ static int draw_vobj(struct rendertarget* tgt,
 	return 0;
 }
 
+/*
+ * Optional (video_batch_draws) merging of consecutive objects in a pass that
+ * use the default shader and share vstore, blend state and opacity. The quads
+ * are transformed on the CPU and submitted with a single agp_draw_quads. The
+ * default shader doesn't consume any of the other per-object uniforms so the
+ * output matches the unbatched path. Atlas text (video_text_atlas) is always
+ * drawn through here, as a batch of its own when it can't be merged.
+ */
+#define DRAW_BATCH_LIMIT 1024
+
+static struct {
+	agp_shader_id shid;
+	struct agp_vstore* vstore;
+	enum arcan_blendfunc blend;
+	float opa;
+	size_t count;
+	_Alignas(16) float verts[DRAW_BATCH_LIMIT * 24];
+	float txcos[DRAW_BATCH_LIMIT * 12];
+} draw_batch;
+
+static void batch_flush()
+{
+	if (!draw_batch.count)
+		return;
+
+	agp_shader_activate(draw_batch.shid);
+	agp_activate_vstore(draw_batch.vstore);
+	agp_blendstate(draw_batch.blend);
+	agp_shader_envv(OBJ_OPACITY, &draw_batch.opa, sizeof(float));
+	agp_draw_quads(draw_batch.verts, draw_batch.txcos, draw_batch.count);
+	draw_batch.count = 0;
+}
+
+/* only plain single-store textured quads without stencil clipping */
+static bool batch_eligible(arcan_vobject* elem, agp_shader_id shid)
+{
+	if (!arcan_video_display.batch_draws ||
+		shid != agp_default_shader(BASIC_2D))
+		return false;
+
+	if (elem->shape || elem->frameset ||
+		elem->vstore->txmapped != TXSTATE_TEX2D ||
+		elem->feed.state.tag == ARCAN_TAG_ASYNCIMGLD)
+		return false;
+
+	return elem->clip == ARCAN_CLIP_OFF || !get_clip_source(elem);
+}
+
+/* flush unless the pending batch has the same state, then switch to it */
+static void batch_state(agp_shader_id shid,
+	struct agp_vstore* vstore, enum arcan_blendfunc blend, float opa)
+{
+	if (draw_batch.count && (draw_batch.shid != shid ||
+		draw_batch.vstore != vstore || draw_batch.blend != blend ||
+		draw_batch.opa != opa))
+		batch_flush();
+
+	draw_batch.shid = shid;
+	draw_batch.vstore = vstore;
+	draw_batch.blend = blend;
+	draw_batch.opa = opa;
+}
+
+/* [corners] and [txcos] in the vertex order of agp_draw_vobj */
+static void batch_quad(const float* mv, const float* corners, const float* txcos)
+{
+	static const int tri[6] = {0, 1, 2, 0, 2, 3};
+
+	if (draw_batch.count == DRAW_BATCH_LIMIT)
+		batch_flush();
+
+	float* dv = &draw_batch.verts[draw_batch.count * 24];
+	float* dt = &draw_batch.txcos[draw_batch.count * 12];
+
+	for (size_t i = 0; i < 6; i++){
+		float x = corners[tri[i] * 2 + 0];
+		float y = corners[tri[i] * 2 + 1];
+
+		for (size_t j = 0; j < 4; j++)
+			dv[i * 4 + j] = mv[j] * x + mv[4 + j] * y + mv[12 + j];
+
+		dt[i * 2 + 0] = txcos[tri[i] * 2 + 0];
+		dt[i * 2 + 1] = txcos[tri[i] * 2 + 1];
+	}
+
+	draw_batch.count++;
+}
+
+/* same blend selection as draw_vobj */
+static enum arcan_blendfunc batch_blend(arcan_vobject* elem, float opa)
+{
+	if (elem->blendmode == BLEND_NORMAL && opa > 1.0 - EPSILON)
+		return BLEND_NONE;
+	return elem->blendmode;
+}
+
+static void batch_add(struct rendertarget* tgt,
+	arcan_vobject* elem, surface_properties prop, const float* txcos)
+{
+	float* mv = NULL;
+	enum arcan_blendfunc blend = batch_blend(elem, prop.opa);
+
+	if (!resolve_surf(tgt, &prop, elem, &mv))
+		return;
+
+	batch_state(agp_default_shader(BASIC_2D), elem->vstore, blend, prop.opa);
+
+	float corners[8] = {
+		-prop.scale.x, -prop.scale.y,
+		 prop.scale.x, -prop.scale.y,
+		 prop.scale.x,  prop.scale.y,
+		-prop.scale.x,  prop.scale.y
+	};
+
+	batch_quad(mv, corners, txcos);
+}
+
+/*
+ * Atlas text, the glyph positions are in the pixel space of the text and
+ * get mapped to the object quad. Anything that can't share the batch with
+ * its neighbours (custom shader, clipping) is drawn as a batch of its own.
+ */
+static void batch_glyphs(struct rendertarget* tgt, arcan_vobject* elem,
+	surface_properties prop, agp_shader_id shid, float fract)
+{
+	struct vobject_glyphs* glyphs = elem->glyphs;
+	enum arcan_blendfunc blend = batch_blend(elem, prop.opa);
+	float* mv = NULL;
+
+	if (!glyphs->count || !elem->origw || !elem->origh ||
+		!resolve_surf(tgt, &prop, elem, &mv))
+		return;
+
+	arcan_vobject* clip_src = elem->clip != ARCAN_CLIP_OFF ?
+		get_clip_source(elem) : NULL;
+
+	bool shared = arcan_video_display.batch_draws &&
+		shid == agp_default_shader(BASIC_2D) && !clip_src;
+
+	if (!shared){
+		batch_flush();
+		if (clip_src)
+			populate_stencil(tgt, elem, fract);
+		agp_shader_activate(shid);
+		update_shenv(elem, &prop);
+	}
+
+	batch_state(shid, glyphs->atlas, blend, prop.opa);
+
+	float sx = 2.0f * prop.scale.x / (float) elem->origw;
+	float sy = 2.0f * prop.scale.y / (float) elem->origh;
+
+	for (size_t i = 0; i < glyphs->count; i++){
+		const float* v = &glyphs->verts[i * 4];
+		const float* t = &glyphs->txcos[i * 4];
+		float x1 = -prop.scale.x + v[0] * sx;
+		float y1 = -prop.scale.y + v[1] * sy;
+		float x2 = -prop.scale.x + v[2] * sx;
+		float y2 = -prop.scale.y + v[3] * sy;
+
+		batch_quad(mv,
+			(float[]){x1, y1, x2, y1, x2, y2, x1, y2},
+			(float[]){t[0], t[1], t[2], t[1], t[2], t[3], t[0], t[3]}
+		);
+	}
+
+	if (!shared){
+		batch_flush();
+		if (clip_src)
+			agp_disable_stencil();
+	}
+}
+
 /*
  * Apply clipping without using the stencil buffer, cheaper but with some
  * caveats of its own. Will work particularly bad for partial clipping with
@@ -5187,17 +6529,666 @@ static inline bool setup_shallow_texclip(
 
 /* this is expensive, we should instead temporarily offset */
 	elem->valid_cache = false;
+	tfcache_invalidate(elem);
+	prep_current.vobj = NULL;
 	*txcos = cliptxbuf;
 	return true;
 }
 
+/*
+ * Damage tracking, each attachment keeps a signature of the state that
+ * affects what the element looks like along with the area it covered when
+ * last drawn. Mismatches add the old and the new area to the damage of the
+ * target, and the pass is then scissored to the merged region.
+ */
+enum damage_state {
+	DAMAGE_NONE = 0,
+	DAMAGE_PARTIAL,
+	DAMAGE_FULL
+};
+
+#define DAMAGE_SEED 0xcbf29ce484222325ull
+#define DAMAGE_HASH(H, V) ((H) = damage_hash((H), &(V), sizeof(V)))
+
+/* set while a linked pipeline is being processed as part of another target */
+static size_t link_depth;
+
+static uint64_t damage_hash(uint64_t h, const void* buf, size_t n)
+{
+	const uint8_t* b = buf;
+	for (size_t i = 0; i < n; i++){
+		h ^= b[i];
+		h *= 0x100000001b3ull;
+	}
+	return h;
+}
+
+static void damage_merge(struct agp_region* dst, const struct agp_region* src)
+{
+	if (src->x1 >= src->x2 || src->y1 >= src->y2)
+		return;
+
+	if (dst->x1 >= dst->x2 || dst->y1 >= dst->y2){
+		*dst = *src;
+		return;
+	}
+
+	dst->x1 = src->x1 < dst->x1 ? src->x1 : dst->x1;
+	dst->y1 = src->y1 < dst->y1 ? src->y1 : dst->y1;
+	dst->x2 = src->x2 > dst->x2 ? src->x2 : dst->x2;
+	dst->y2 = src->y2 > dst->y2 ? src->y2 : dst->y2;
+}
+
+static inline bool damage_overlap(
+	const struct agp_region* a, const struct agp_region* b)
+{
+	return a->x1 < b->x2 && a->x2 > b->x1 && a->y1 < b->y2 && a->y2 > b->y1;
+}
+
+/* an attachment that is no longer drawn leaves its last area behind */
+static void damage_drop(struct rendertarget* tgt,
+	arcan_vobject_litem* item, struct agp_region* out)
+{
+	if (item->damage.valid && item->damage.tgt == tgt->damage.id)
+		damage_merge(out, &item->damage.box);
+	item->damage.valid = false;
+}
+
+/*
+ * Project the object quad into framebuffer coordinates of [tgt], returns
+ * false if the object can't be bounded (mesh shapes, degenerate projection).
+ */
+static bool damage_box(struct rendertarget* tgt, arcan_vobject* elem,
+	surface_properties props, size_t w, size_t h, struct agp_region* out)
+{
+	float _Alignas(16) mv[16];
+	float _Alignas(16) pmv[16];
+
+	if (elem->shape)
+		return false;
+
+	build_modelview_pure(mv, tgt->base, &props, elem);
+	multiply_matrix(pmv, tgt->projection, mv);
+
+	float x1 = w, y1 = h, x2 = 0, y2 = 0;
+	float corners[4][4] = {
+		{-props.scale.x, -props.scale.y, 0.0f, 1.0f},
+		{ props.scale.x, -props.scale.y, 0.0f, 1.0f},
+		{ props.scale.x,  props.scale.y, 0.0f, 1.0f},
+		{-props.scale.x,  props.scale.y, 0.0f, 1.0f}
+	};
+	mult_matrix_vecf_n(pmv, corners[0], corners[0], 4);
+
+	for (size_t i = 0; i < 4; i++){
+		float cw = corners[i][3];
+		if (cw <= EPSILON)
+			return false;
+
+		float px = (corners[i][0] / cw + 1.0f) * 0.5f * w;
+		float py = (corners[i][1] / cw + 1.0f) * 0.5f * h;
+		x1 = px < x1 ? px : x1;
+		y1 = py < y1 ? py : y1;
+		x2 = px > x2 ? px : x2;
+		y2 = py > y2 ? py : y2;
+	}
+
+/* one pixel of slack for filtering at the edges */
+	x1 = floorf(x1) - 1.0f;
+	y1 = floorf(y1) - 1.0f;
+	x2 = ceilf(x2) + 1.0f;
+	y2 = ceilf(y2) + 1.0f;
+
+	*out = (struct agp_region){
+		.x1 = x1 > 0 ? x1 : 0, .y1 = y1 > 0 ? y1 : 0,
+		.x2 = x2 < w ? x2 : w, .y2 = y2 < h ? y2 : h
+	};
+
+	return true;
+}
+
+static uint64_t damage_signature(struct rendertarget* tgt, arcan_vobject* elem,
+	surface_properties* props, struct agp_region* box, float fract, bool* always)
+{
+	uint64_t h = DAMAGE_SEED;
+	struct agp_vstore* vs = elem->vstore;
+
+	DAMAGE_HASH(h, *box);
+	DAMAGE_HASH(h, props->opa);
+	DAMAGE_HASH(h, elem->order);
+	DAMAGE_HASH(h, elem->blendmode);
+	DAMAGE_HASH(h, elem->flags);
+	DAMAGE_HASH(h, elem->program);
+	DAMAGE_HASH(h, elem->clip);
+	int tag = elem->feed.state.tag;
+	DAMAGE_HASH(h, tag);
+	DAMAGE_HASH(h, vs);
+	DAMAGE_HASH(h, vs->update_seq);
+	DAMAGE_HASH(h, vs->txmapped);
+	if (elem->glyphs){
+		DAMAGE_HASH(h, elem->glyphs);
+		DAMAGE_HASH(h, elem->glyphs->count);
+		DAMAGE_HASH(h, elem->glyphs->atlas->update_seq);
+	}
+
+	if (vs->txmapped == TXSTATE_OFF)
+		DAMAGE_HASH(h, vs->vinf.col);
+	else
+		DAMAGE_HASH(h, vs->vinf.text.glid);
+
+/* same texture coordinate selection as in the draw pass */
+	float* txcos = elem->txcos;
+	if ( (elem->mask & MASK_MAPPING) > 0)
+		txcos = elem->parent != &current_context->world ?
+			elem->parent->txcos : elem->txcos;
+	if (!txcos)
+		txcos = arcan_video_display.default_txcos;
+	h = damage_hash(h, txcos, sizeof(float) * 8);
+
+	if (elem->frameset){
+		struct frameset_store* ds = &elem->frameset->frames[elem->frameset->index];
+		DAMAGE_HASH(h, elem->frameset->index);
+		DAMAGE_HASH(h, ds->frame);
+		if (ds->frame)
+			DAMAGE_HASH(h, ds->frame->update_seq);
+		if (elem->frameset->mode == ARCAN_FRAMESET_MULTITEXTURE)
+			*always = true;
+	}
+
+/* custom shaders may have time- or uniform- driven output that is not visible
+ * from here, and deep clipping depends on the entire parent chain */
+	if (elem->program &&
+		elem->program != agp_default_shader(BASIC_2D) &&
+		elem->program != agp_default_shader(COLOR_2D))
+		*always = true;
+
+	if (elem->clip == ARCAN_CLIP_ON)
+		*always = true;
+
+	else if (elem->clip == ARCAN_CLIP_SHALLOW){
+		arcan_vobject* clip_src = get_clip_source(elem);
+		if (clip_src){
+			surface_properties cprops = empty_surface();
+			arcan_resolve_vidprop(clip_src, fract, &cprops);
+			DAMAGE_HASH(h, cprops.position);
+			DAMAGE_HASH(h, cprops.scale);
+			DAMAGE_HASH(h, cprops.rotation);
+		}
+	}
+
+	return h;
+}
+
+/*
+ * Objects that the platform has put on a display plane of their own are left
+ * out of the world composition, they still count for picking and other
+ * rendertargets they are attached to.
+ */
+static inline bool scanout_skip(struct rendertarget* tgt, arcan_vobject* elem)
+{
+	return FL_TEST(elem, FL_SCANOUT) && tgt == &current_context->stdoutp;
+}
+
+static bool damage_eligible(struct rendertarget* tgt, bool nest)
+{
+	return arcan_video_display.damage_regions &&
+		!arcan_video_display.ignore_dirty &&
+		!nest && !tgt->link && !link_depth &&
+		!tgt->force_shid && !FL_TEST(tgt, TGTFL_NOCLEAR) &&
+		tgt->color && tgt->color->vstore && tgt->art &&
+		(!tgt->first || tgt->first->elem->order >= 0);
+}
+
+/*
+ * Sweep the 2D range of the pipeline and compare against the records from the
+ * last pass, [out] is set to the merged damage in framebuffer coordinates.
+ */
+static enum damage_state damage_scan(struct rendertarget* tgt,
+	float fract, bool use_prep, struct agp_region* out)
+{
+	static uint64_t damage_id;
+	size_t w = tgt->color->vstore->w;
+	size_t h = tgt->color->vstore->h;
+	bool full = false;
+
+	if (!tgt->damage.id)
+		tgt->damage.id = ++damage_id;
+
+	*out = tgt->damage.box;
+	tgt->damage.box = (struct agp_region){};
+
+/* changes to the target itself invalidate everything */
+	uint64_t sig = DAMAGE_SEED;
+	DAMAGE_HASH(sig, tgt->projection);
+	DAMAGE_HASH(sig, tgt->base);
+	DAMAGE_HASH(sig, tgt->shid);
+	DAMAGE_HASH(sig, tgt->color->vstore);
+	DAMAGE_HASH(sig, tgt->min_order);
+	DAMAGE_HASH(sig, tgt->max_order);
+	DAMAGE_HASH(sig, w);
+	DAMAGE_HASH(sig, h);
+	if (sig != tgt->damage.sig){
+		tgt->damage.sig = sig;
+		full = true;
+	}
+
+	size_t prep_ind = 0;
+	for (arcan_vobject_litem* cur = tgt->first; cur; cur = cur->next){
+		arcan_vobject* elem = cur->elem;
+
+		if (elem->order < tgt->min_order || elem->order > tgt->max_order){
+			damage_drop(tgt, cur, out);
+			continue;
+		}
+
+		surface_properties dprops = empty_surface();
+		if (use_prep && prep_ind < tgt->prep.count)
+			dprops = tgt->prep.props[prep_ind++];
+		else if (!tfcache_lookup(elem, &dprops))
+			arcan_resolve_vidprop(elem, fract, &dprops);
+
+		if (dprops.opa <= EPSILON || elem == tgt->color || scanout_skip(tgt, elem)){
+			damage_drop(tgt, cur, out);
+			continue;
+		}
+
+		struct agp_region box;
+		if (!damage_box(tgt, elem, dprops, w, h, &box)){
+			damage_drop(tgt, cur, out);
+			full = true;
+			continue;
+		}
+
+		bool always = false;
+		uint64_t esig = damage_signature(tgt, elem, &dprops, &box, fract, &always);
+
+		if (always || !cur->damage.valid ||
+			cur->damage.tgt != tgt->damage.id || cur->damage.sig != esig){
+			damage_drop(tgt, cur, out);
+			damage_merge(out, &box);
+		}
+
+		cur->damage.valid = true;
+		cur->damage.tgt = tgt->damage.id;
+		cur->damage.sig = esig;
+		cur->damage.box = box;
+	}
+
+	if (full)
+		return DAMAGE_FULL;
+
+	if (out->x1 >= out->x2 || out->y1 >= out->y2)
+		return DAMAGE_NONE;
+
+/* past this point the extra state changes are not worth it */
+	if ((out->x2 - out->x1) * (out->y2 - out->y1) * 4 > w * h * 3)
+		return DAMAGE_FULL;
+
+	return DAMAGE_PARTIAL;
+}
+
+/*
+ * Pick index, a uniform grid over the world-space bounding boxes of the
+ * pipeline. The boxes are refit from the properties resolved during each
+ * pass (and used to cull objects outside of the target), the grid is then
+ * rebuilt from the entries that are stable (no transforms in the chain).
+ * Objects that change in between passes are logged in pick_moved so that
+ * the picking functions can include them regardless of the index.
+ */
+static void pickidx_moved(arcan_vobject* vobj)
+{
+	if (arcan_video_display.pick_index)
+		pick_moved.vobj[pick_moved.seq++ % PICKIDX_MOVED] = vobj;
+}
+
+static void pickidx_free(struct rendertarget* tgt)
+{
+	arcan_mem_free(tgt->pick.entries);
+	arcan_mem_free(tgt->pick.dynamic);
+	arcan_mem_free(tgt->pick.scratch);
+	arcan_mem_free(tgt->pick.cells);
+	arcan_mem_free(tgt->pick.cell_ofs);
+	uint64_t seq = tgt->pick.seq;
+	tgt->pick = (struct rendertarget_pickidx){.seq = seq};
+}
+
+/* axis aligned world-space box of the (possibly rotated) object quad */
+static void world_box(arcan_vobject* vobj, surface_properties* prop, float* box)
+{
+	float w = (float)vobj->origw * prop->scale.x;
+	float h = (float)vobj->origh * prop->scale.y;
+	box[0] = prop->position.x;
+	box[1] = prop->position.y;
+	box[2] = box[0] + w;
+	box[3] = box[1] + h;
+
+	if (fabsf(prop->rotation.roll) <= EPSILON){
+		if (w < 0){
+			box[0] = box[2];
+			box[2] = prop->position.x;
+		}
+		if (h < 0){
+			box[1] = box[3];
+			box[3] = prop->position.y;
+		}
+		return;
+	}
+
+/* same rotation around the center as arcan_video_screencoords */
+	float ang = DEG2RAD(prop->rotation.roll);
+	float sinv = fabsf(sinf(ang));
+	float cosv = fabsf(cosf(ang));
+	float cpx = box[0] + 0.5f * w;
+	float cpy = box[1] + 0.5f * h;
+	float hw = 0.5f * (fabsf(w) * cosv + fabsf(h) * sinv);
+	float hh = 0.5f * (fabsf(w) * sinv + fabsf(h) * cosv);
+	box[0] = cpx - hw;
+	box[1] = cpy - hh;
+	box[2] = cpx + hw;
+	box[3] = cpy + hh;
+}
+
+/*
+ * Reset the entries to the current pipeline, all dynamic until refit by the
+ * draw pass. Returns false if the index shouldn't be maintained.
+ */
+static bool pickidx_begin(struct rendertarget* tgt)
+{
+	if (!arcan_video_display.pick_index || link_depth)
+		return false;
+
+	size_t count = 0;
+	for (arcan_vobject_litem* cur = tgt->first; cur; cur = cur->next)
+		count++;
+
+	if (count > tgt->pick.limit || !tgt->pick.entries){
+		size_t limit = count + 64;
+		pickidx_free(tgt);
+		tgt->pick.entries = arcan_alloc_mem(
+			sizeof(struct rendertarget_pickent) * limit,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+		tgt->pick.dynamic = arcan_alloc_mem(sizeof(size_t) * limit,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+		size_t scratch = limit + PICKIDX_MOVED;
+		if (scratch < PICKIDX_GRID * PICKIDX_GRID)
+			scratch = PICKIDX_GRID * PICKIDX_GRID;
+		tgt->pick.scratch = arcan_alloc_mem(sizeof(size_t) * scratch,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+		tgt->pick.cell_ofs = arcan_alloc_mem(
+			sizeof(size_t) * (PICKIDX_GRID * PICKIDX_GRID + 1),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+
+		if (!tgt->pick.entries || !tgt->pick.dynamic ||
+			!tgt->pick.scratch || !tgt->pick.cell_ofs){
+			pickidx_free(tgt);
+			return false;
+		}
+		tgt->pick.limit = limit;
+	}
+
+	size_t i = 0;
+	for (arcan_vobject_litem* cur = tgt->first; cur; cur = cur->next, i++){
+		tgt->pick.entries[i] = (struct rendertarget_pickent){.vobj = cur->elem};
+		if (cur->elem->owner == tgt)
+			cur->elem->pick_ind = i;
+	}
+
+	tgt->pick.count = count;
+	tgt->pick.valid = false;
+	return true;
+}
+
+static inline struct rendertarget_pickent* pickidx_entry(
+	struct rendertarget* tgt, arcan_vobject* elem)
+{
+	if (elem->owner != tgt || elem->pick_ind >= tgt->pick.count ||
+		tgt->pick.entries[elem->pick_ind].vobj != elem)
+		return NULL;
+
+	return &tgt->pick.entries[elem->pick_ind];
+}
+
+/*
+ * Derive the world-space area visible through the target projection, only
+ * done for the axis aligned case, returns false if no culling is possible.
+ */
+static bool pickidx_visible(struct rendertarget* tgt, float* vis)
+{
+	float _Alignas(16) m[16];
+	multiply_matrix(m, tgt->projection, tgt->base);
+
+	if (fabsf(m[1]) > EPSILON || fabsf(m[4]) > EPSILON ||
+		fabsf(m[0]) <= EPSILON || fabsf(m[5]) <= EPSILON ||
+		fabsf(m[3]) > EPSILON || fabsf(m[7]) > EPSILON)
+		return false;
+
+	float xa = (-1.0f - m[12]) / m[0];
+	float xb = ( 1.0f - m[12]) / m[0];
+	float ya = (-1.0f - m[13]) / m[5];
+	float yb = ( 1.0f - m[13]) / m[5];
+	vis[0] = xa < xb ? xa : xb;
+	vis[2] = xa < xb ? xb : xa;
+	vis[1] = ya < yb ? ya : yb;
+	vis[3] = ya < yb ? yb : ya;
+	return true;
+}
+
+static void pickidx_finish(struct rendertarget* tgt)
+{
+	struct rendertarget_pickidx* idx = &tgt->pick;
+	float x1 = INFINITY, y1 = INFINITY, x2 = -INFINITY, y2 = -INFINITY;
+
+/* only stable entries go into the grid, the rest are always tested */
+	for (size_t i = 0; i < idx->count; i++){
+		struct rendertarget_pickent* ent = &idx->entries[i];
+		ent->stable = ent->drawn && ent->vobj->valid_cache;
+		if (!ent->stable)
+			continue;
+
+		x1 = ent->x1 < x1 ? ent->x1 : x1;
+		y1 = ent->y1 < y1 ? ent->y1 : y1;
+		x2 = ent->x2 > x2 ? ent->x2 : x2;
+		y2 = ent->y2 > y2 ? ent->y2 : y2;
+	}
+
+	idx->x1 = x1;
+	idx->y1 = y1;
+	idx->cw = x2 > x1 ? (x2 - x1) / PICKIDX_GRID : 1.0f;
+	idx->ch = y2 > y1 ? (y2 - y1) / PICKIDX_GRID : 1.0f;
+	memset(idx->cell_ofs, '\0', sizeof(size_t) * (PICKIDX_GRID*PICKIDX_GRID+1));
+	idx->n_dynamic = 0;
+
+/* first pass counts, objects that would span much of the grid are treated
+ * as dynamic rather than being inserted everywhere */
+	size_t total = 0;
+	for (size_t i = 0; i < idx->count; i++){
+		struct rendertarget_pickent* ent = &idx->entries[i];
+		if (ent->stable){
+			size_t cx1 = (ent->x1 - idx->x1) / idx->cw;
+			size_t cy1 = (ent->y1 - idx->y1) / idx->ch;
+			size_t cx2 = (ent->x2 - idx->x1) / idx->cw;
+			size_t cy2 = (ent->y2 - idx->y1) / idx->ch;
+			cx1 = cx1 >= PICKIDX_GRID ? PICKIDX_GRID - 1 : cx1;
+			cy1 = cy1 >= PICKIDX_GRID ? PICKIDX_GRID - 1 : cy1;
+			cx2 = cx2 >= PICKIDX_GRID ? PICKIDX_GRID - 1 : cx2;
+			cy2 = cy2 >= PICKIDX_GRID ? PICKIDX_GRID - 1 : cy2;
+			size_t span = (cx2 - cx1 + 1) * (cy2 - cy1 + 1);
+
+			if (span * 4 <= PICKIDX_GRID * PICKIDX_GRID){
+				for (size_t y = cy1; y <= cy2; y++)
+					for (size_t x = cx1; x <= cx2; x++)
+						idx->cell_ofs[y * PICKIDX_GRID + x + 1]++;
+				total += span;
+				continue;
+			}
+			ent->stable = false;
+		}
+		idx->dynamic[idx->n_dynamic++] = i;
+	}
+
+	if (total > idx->cells_limit){
+		arcan_mem_free(idx->cells);
+		idx->cells_limit = total + (total >> 1) + 64;
+		idx->cells = arcan_alloc_mem(sizeof(size_t) * idx->cells_limit,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+		if (!idx->cells){
+			idx->cells_limit = 0;
+			return;
+		}
+	}
+
+	for (size_t i = 1; i <= PICKIDX_GRID * PICKIDX_GRID; i++)
+		idx->cell_ofs[i] += idx->cell_ofs[i-1];
+
+/* second pass fills, reuse scratch as the per-cell write cursor */
+	size_t* cursor = idx->scratch;
+	memcpy(cursor, idx->cell_ofs, sizeof(size_t) * PICKIDX_GRID * PICKIDX_GRID);
+
+	for (size_t i = 0; i < idx->count; i++){
+		struct rendertarget_pickent* ent = &idx->entries[i];
+		if (!ent->stable)
+			continue;
+
+		size_t cx1 = (ent->x1 - idx->x1) / idx->cw;
+		size_t cy1 = (ent->y1 - idx->y1) / idx->ch;
+		size_t cx2 = (ent->x2 - idx->x1) / idx->cw;
+		size_t cy2 = (ent->y2 - idx->y1) / idx->ch;
+		cx1 = cx1 >= PICKIDX_GRID ? PICKIDX_GRID - 1 : cx1;
+		cy1 = cy1 >= PICKIDX_GRID ? PICKIDX_GRID - 1 : cy1;
+		cx2 = cx2 >= PICKIDX_GRID ? PICKIDX_GRID - 1 : cx2;
+		cy2 = cy2 >= PICKIDX_GRID ? PICKIDX_GRID - 1 : cy2;
+
+		for (size_t y = cy1; y <= cy2; y++)
+			for (size_t x = cx1; x <= cx2; x++)
+				idx->cells[cursor[y * PICKIDX_GRID + x]++] = i;
+	}
+
+	idx->built = idx->seq;
+	idx->moved = pick_moved.seq;
+	idx->valid = true;
+}
+
+static int pickidx_cmp(const void* a, const void* b)
+{
+	size_t av = *(const size_t*) a;
+	size_t bv = *(const size_t*) b;
+	return av < bv ? -1 : (av > bv ? 1 : 0);
+}
+
+/*
+ * Gather the entries (in pipeline order) that may contain [x, y], returns
+ * false if the index can't be used and a full sweep is needed.
+ */
+static bool pickidx_query(struct rendertarget* tgt,
+	int x, int y, size_t** out, size_t* n_out)
+{
+	struct rendertarget_pickidx* idx = &tgt->pick;
+	if (!arcan_video_display.pick_index || !idx->valid ||
+		idx->built != idx->seq || pick_moved.seq - idx->moved > PICKIDX_MOVED)
+		return false;
+
+	size_t n = 0;
+	size_t* dst = idx->scratch;
+
+	float fx = ((float)x - idx->x1) / idx->cw;
+	float fy = ((float)y - idx->y1) / idx->ch;
+	if (fx >= 0.0f && fy >= 0.0f && fx < PICKIDX_GRID && fy < PICKIDX_GRID){
+		size_t cell = (size_t)fy * PICKIDX_GRID + (size_t)fx;
+		for (size_t i = idx->cell_ofs[cell]; i < idx->cell_ofs[cell+1]; i++)
+			dst[n++] = idx->cells[i];
+	}
+
+	memcpy(&dst[n], idx->dynamic, sizeof(size_t) * idx->n_dynamic);
+	n += idx->n_dynamic;
+
+/* objects changed since the index was built can be anywhere, objects owned
+ * by other targets are already dynamic here */
+	for (uint64_t i = idx->moved; i < pick_moved.seq; i++){
+		arcan_vobject* vobj = pick_moved.vobj[i % PICKIDX_MOVED];
+		if (vobj->owner != tgt)
+			continue;
+
+		struct rendertarget_pickent* ent = pickidx_entry(tgt, vobj);
+		if (!ent)
+			return false;
+
+		dst[n++] = vobj->pick_ind;
+	}
+
+	qsort(dst, n, sizeof(size_t), pickidx_cmp);
+	size_t u = 0;
+	for (size_t i = 0; i < n; i++)
+		if (!u || dst[u-1] != dst[i])
+			dst[u++] = dst[i];
+
+	*out = dst;
+	*n_out = u;
+	return true;
+}
+
 _Thread_local static struct rendertarget* current_rendertarget;
 struct rendertarget* arcan_vint_current_rt()
 {
 	return current_rendertarget;
 }
 
-static size_t process_rendertarget(
+/*
+ * GPU timing (video_gpu_timers) per rendertarget pass. Each target cycles
+ * through a small ring of timer queries so that results can be collected
+ * a few frames later without stalling on the GPU. If all queries are still
+ * in flight, the pass simply goes untimed.
+ */
+static void gputime_poll(struct rendertarget* tgt)
+{
+	while (tgt->gputime.count){
+		size_t tail = (tgt->gputime.head +
+			GPUTIME_RING - tgt->gputime.count) % GPUTIME_RING;
+
+		int64_t ns = agp_timer_result(tgt->gputime.queries[tail]);
+		if (-1 == ns)
+			break;
+
+		tgt->gputime.last_ns = ns;
+		tgt->gputime.count--;
+		arcan_video_display.gpu_frame_ns += ns;
+
+		TRACE_MARK_ONESHOT("video", "rendertarget-gpu", TRACE_SYS_DEFAULT,
+			tgt->color ? tgt->color->cellid : 0, ns / 1000,
+			tgt->color && tgt->color->tracetag ? tgt->color->tracetag : "world");
+	}
+}
+
+static bool gputime_begin(struct rendertarget* tgt)
+{
+	gputime_poll(tgt);
+	if (tgt->gputime.count == GPUTIME_RING)
+		return false;
+
+	unsigned* id = &tgt->gputime.queries[tgt->gputime.head];
+	if (!*id && !(*id = agp_timer_alloc()))
+		return false;
+
+	agp_timer_begin(*id);
+	return true;
+}
+
+static void gputime_end(struct rendertarget* tgt)
+{
+	agp_timer_end();
+	tgt->gputime.head = (tgt->gputime.head + 1) % GPUTIME_RING;
+	tgt->gputime.count++;
+}
+
+static void gputime_free(struct rendertarget* tgt)
+{
+	for (size_t i = 0; i < GPUTIME_RING; i++){
+		if (tgt->gputime.queries[i])
+			agp_timer_free(tgt->gputime.queries[i]);
+		tgt->gputime.queries[i] = 0;
+	}
+	tgt->gputime.head = tgt->gputime.count = 0;
+}
+
+static size_t process_rendertarget_pass(
 	struct rendertarget* tgt, float fract, bool nest)
 {
 	arcan_vobject_litem* current;
@@ -5214,7 +7205,9 @@ static size_t process_rendertarget(
 		tgt->link = NULL;
 		size_t old_msc = tgt->msc;
 
-		pc += process_rendertarget(tgt, fract, false);
+		link_depth++;
+		pc += process_rendertarget_pass(tgt, fract, false);
+		link_depth--;
 		nest = pc > 0;
 
 		tgt->first = tmp_cur;
@@ -5237,6 +7230,27 @@ static size_t process_rendertarget(
 		!tgt->dirtyc && !tgt->transfc)
 		return 0;
 
+/* properties might already have been resolved in the preparation stage,
+ * otherwise populate the packed transform cache (if enabled) for the 2D range */
+	bool use_prep =
+		tgt->prep.cookie == arcan_video_display.cookie && tgt->prep.cookie &&
+		tgt->prep.first == tgt->first;
+	size_t prep_ind = 0;
+
+	if (!use_prep)
+		tfcache_resolve(tgt, fract);
+
+/* compare against the last pass, nothing visible changed means nothing to draw */
+	struct agp_region damage = {};
+	enum damage_state dstate = DAMAGE_FULL;
+	if (damage_eligible(tgt, nest)){
+		dstate = damage_scan(tgt, fract, use_prep, &damage);
+		if (dstate == DAMAGE_NONE){
+			current_context->tfcache.active = 0;
+			return 0;
+		}
+	}
+
 	tgt->uploadc = 0;
 	tgt->msc++;
 
@@ -5251,9 +7265,18 @@ static size_t process_rendertarget(
 	agp_shader_envv(RTGT_ID, &tgt->id, sizeof(int));
 	agp_shader_envv(OBJ_OPACITY, &(float){1.0}, sizeof(float));
 
+/* the target may refuse (multi-buffered, contents not yet established) */
+	if (dstate == DAMAGE_PARTIAL && !agp_rendertarget_scissor(tgt->art, &damage))
+		dstate = DAMAGE_FULL;
+
 	if (!FL_TEST(tgt, TGTFL_NOCLEAR) && !nest)
 		agp_rendertarget_clear();
 
+/* the pick index is refit from the properties resolved below */
+	float vis[4];
+	bool pick_active = pickidx_begin(tgt);
+	bool cull = pick_active && pickidx_visible(tgt, vis);
+
 /* first, handle all 3d work (which may require multiple passes etc.) */
 	if (tgt->order3d == ORDER3D_FIRST && current && current->elem->order < 0){
 		current = arcan_3d_refresh(tgt->camtag, current, fract);
@@ -5286,14 +7309,58 @@ static size_t process_rendertarget(
 
 /* calculate coordinate system translations, world cannot be masked */
 		surface_properties dprops = empty_surface();
-		arcan_resolve_vidprop(elem, fract, &dprops);
+		prep_current.vobj = NULL;
+
+		if (use_prep && prep_ind < tgt->prep.count){
+			dprops = tgt->prep.props[prep_ind];
+			elem->rotate_state = tgt->prep.rotate[prep_ind];
+			prep_current.vobj = elem;
+			prep_current.mv = &tgt->prep.world[prep_ind * 16];
+			prep_ind++;
+		}
+		else if (!tfcache_lookup(elem, &dprops))
+			arcan_resolve_vidprop(elem, fract, &dprops);
+
+		struct rendertarget_pickent* pent =
+			pick_active ? pickidx_entry(tgt, elem) : NULL;
+		if (pent){
+			float box[4];
+			world_box(elem, &dprops, box);
+			pent->x1 = box[0];
+			pent->y1 = box[1];
+			pent->x2 = box[2];
+			pent->y2 = box[3];
+			pent->drawn = true;
+		}
 
 /* don't waste time on objects that aren't supposed to be visible */
-		if ( dprops.opa <= EPSILON || elem == tgt->color){
+		if ( dprops.opa <= EPSILON || elem == tgt->color || scanout_skip(tgt, elem)){
 			current = current->next;
 			continue;
 		}
 
+/* or are entirely outside of the target */
+		if (cull && pent && !elem->shape &&
+			(pent->x2 < vis[0] || pent->x1 > vis[2] ||
+			 pent->y2 < vis[1] || pent->y1 > vis[3])){
+			current = current->next;
+			continue;
+		}
+
+/* still visible, even if not part of the region being redrawn */
+		elem->last_drawn = residency.frame;
+
+/* or are entirely outside of the region being redrawn */
+		if (dstate == DAMAGE_PARTIAL &&
+			current->damage.valid && !damage_overlap(&current->damage.box, &damage)){
+			current = current->next;
+			continue;
+		}
+
+/* store may have been evicted to stay within the vstore budget */
+		if (FL_TEST(elem, FL_EVICTED))
+			arcan_vint_residency_touch(elem);
+
 /* enable clipping using stencil buffer, we need to reset the state of the
  * stencil buffer between draw calls so track if it's enabled or not */
 		bool clipped = false;
@@ -5320,6 +7387,22 @@ static size_t process_rendertarget(
 		agp_shader_id shid = tgt->shid;
 		if (!tgt->force_shid && elem->program)
 			shid = elem->program;
+
+		if (elem->glyphs){
+			batch_glyphs(tgt, elem, dprops, shid, fract);
+			current = current->next;
+			pc++;
+			continue;
+		}
+
+		if (batch_eligible(elem, shid)){
+			batch_add(tgt, elem, dprops, txcos);
+			current = current->next;
+			pc++;
+			continue;
+		}
+
+		batch_flush();
 		agp_shader_activate(shid);
 
 		if (elem->frameset){
@@ -5363,6 +7446,8 @@ static size_t process_rendertarget(
 		agp_disable_stencil();
 	}
 
+	batch_flush();
+
 /* reset and try the 3d part again if requested */
 end3d:
 	current = tgt->first;
@@ -5373,12 +7458,38 @@ end3d:
 			pc++;
 	}
 
+	current_context->tfcache.active = 0;
+	prep_current.vobj = NULL;
+
+	if (pick_active)
+		pickidx_finish(tgt);
+
+	if (dstate == DAMAGE_PARTIAL)
+		agp_rendertarget_scissor(tgt->art, NULL);
+
+/* let consumers of the target store (other rendertargets) see the change */
 	if (pc){
 		tgt->frame_cookie = arcan_video_display.cookie;
+		if (tgt->color && tgt->color->vstore)
+			tgt->color->vstore->update_seq++;
 	}
 	return pc;
 }
 
+static size_t process_rendertarget(
+	struct rendertarget* tgt, float fract, bool nest)
+{
+	if (!arcan_video_display.gpu_timers || link_depth)
+		return process_rendertarget_pass(tgt, fract, nest);
+
+	bool timed = gputime_begin(tgt);
+	size_t pc = process_rendertarget_pass(tgt, fract, nest);
+	if (timed)
+		gputime_end(tgt);
+
+	return pc;
+}
+
 arcan_errc arcan_video_forceread(
 	arcan_vobj_id sid, bool local, av_pixel** dptr, size_t* dsize)
 {
@@ -5489,10 +7600,9 @@ arcan_errc arcan_video_screenshot(av_pixel** dptr, size_t* dsize)
 	return ARCAN_OK;
 }
 
-/* Check outstanding readbacks, map and feed onwards, ideally we should synch
- * this with a fence - but the platform GL etc. versioning restricts things for
- * the time being. Threaded- dispatch from the conductor is the right way
- * forward */
+/* Check outstanding readbacks, map and feed onwards. The agp side polls the
+ * oldest transfer with a fence where the GL has them, so this doesn't block.
+ * Threaded- dispatch from the conductor is the right way forward */
 void arcan_vint_pollreadback(struct rendertarget* tgt)
 {
 	if (!FL_TEST(tgt, TGTFL_READING))
@@ -5517,8 +7627,12 @@ void arcan_vint_pollreadback(struct rendertarget* tgt)
  * and then call poll again, we have to release once retrieved */
 	struct asynch_readback_meta rbb = agp_poll_readback(vobj->vstore);
 
-	if (rbb.ptr == NULL)
+/* nothing left in flight (e.g. the store was reset) means nothing to wait on */
+	if (rbb.ptr == NULL){
+		if (!rbb.pending)
+			FL_CLEAR(tgt, TGTFL_READING);
 		return;
+	}
 
 /* the ffunc might've disappeared, so disable the readback state */
 	if (!vobj->feed.ffunc)
@@ -5531,7 +7645,8 @@ void arcan_vint_pollreadback(struct rendertarget* tgt)
 	}
 
 	rbb.release(rbb.tag);
-	FL_CLEAR(tgt, TGTFL_READING);
+	if (!rbb.pending)
+		FL_CLEAR(tgt, TGTFL_READING);
 }
 
 static size_t steptgt(float fract, struct rendertarget* tgt)
@@ -5551,6 +7666,14 @@ static size_t steptgt(float fract, struct rendertarget* tgt)
 		return 1;
 	}
 
+/* keep any global dirty state around for when the target is processed again */
+	if (tgt->deferred){
+		tgt->deferred = false;
+		if (arcan_video_display.dirty || arcan_video_display.ignore_dirty)
+			tgt->dirtyc++;
+		return tgt->dirtyc > 0;
+	}
+
 	size_t transfc = 0;
 	if (tgt->refresh < 0 && process_counter(
 		tgt, &tgt->refreshcnt, tgt->refresh, fract)){
@@ -5586,6 +7709,9 @@ unsigned arcan_vint_refresh(float fract, size_t* ndirty)
 		arcan_video_display.ignore_dirty--;
 	}
 
+/* CPU- side preparation can run in parallel ahead of the serial passes */
+	prepare_rendertargets(fract);
+
 /* Right now there is an explicit 'first come first update' kind of
  * order except for worldid as everything else might be composed there.
  *
@@ -5607,13 +7733,32 @@ unsigned arcan_vint_refresh(float fract, size_t* ndirty)
 	current_rendertarget = NULL;
 	agp_activate_rendertarget(NULL);
 
+/* the eyes have been drawn, the (world) composition can correct for the head
+ * movement since they were latched, shaders opt in through vr_reproject */
+	float _Alignas(16) reproj[16];
+	if (arcan_vr_reprojection(reproj))
+		transfc += agp_shader_envv(VR_REPROJECT, reproj, sizeof(float) * 16);
+
 	TRACE_MARK_ENTER("video", "process-world-rendertarget", TRACE_SYS_DEFAULT, 0, 0, "world");
 		tgt_dirty = steptgt(fract, &current_context->stdoutp);
 		transfc += tgt_dirty;
 	TRACE_MARK_EXIT("video", "process-world-rendertarget", TRACE_SYS_DEFAULT, 0, tgt_dirty, "world");
+	prep_invalidate();
+
+	if (arcan_video_display.gpu_timers){
+		if (arcan_video_display.gpu_frame_ns)
+			arcan_bench_register_gpu(arcan_video_display.gpu_frame_ns / 1000);
+		arcan_video_display.gpu_frame_ns = 0;
+	}
+
 	*ndirty = transfc + arcan_video_display.dirty;
 	arcan_video_display.dirty = 0;
 
+/* only frames that drew anything age the stores, a static scene shouldn't
+ * end up evicting what is still on screen */
+	if (*ndirty)
+		residency.frame++;
+
 /* This is part of another dirty workaround when n buffers are needed by the
  * video platform for a flip to reach the display and we want the same contents
  * in every buffer stage at the cost of rendering */
@@ -5798,6 +7943,18 @@ size_t arcan_video_rpick(arcan_vobj_id rt,
 	if (lim == 0 || !tgt || !tgt->first)
 		return count;
 
+	size_t* cand;
+	size_t n_cand;
+	if (pickidx_query(tgt, x, y, &cand, &n_cand)){
+		while (n_cand-- && count < lim){
+			arcan_vobject* vobj = tgt->pick.entries[cand[n_cand]].vobj;
+			if ((vobj->mask & MASK_UNPICKABLE) == 0 && obj_visible(vobj) &&
+				arcan_video_hittest(vobj->cellid, x, y))
+					dst[count++] = vobj->cellid;
+		}
+		return count;
+	}
+
 	arcan_vobject_litem* current = tgt->first;
 
 /* skip to last, then start stepping backwards */
@@ -5826,6 +7983,18 @@ size_t arcan_video_pick(arcan_vobj_id rt,
 	if (lim == 0 || !tgt || !tgt->first)
 		return count;
 
+	size_t* cand;
+	size_t n_cand;
+	if (pickidx_query(tgt, x, y, &cand, &n_cand)){
+		for (size_t i = 0; i < n_cand && count < lim; i++){
+			arcan_vobject* vobj = tgt->pick.entries[cand[i]].vobj;
+			if (vobj->cellid && !(vobj->mask & MASK_UNPICKABLE) &&
+				obj_visible(vobj) && arcan_video_hittest(vobj->cellid, x, y))
+					dst[count++] = vobj->cellid;
+		}
+		return count;
+	}
+
 	arcan_vobject_litem* current = tgt->first;
 
 	while (current && count < lim){
@@ -6078,14 +8247,194 @@ unsigned arcan_video_contextusage(unsigned* used)
 {
 	if (used){
 		*used = 0;
-		for (unsigned i = 1; i < current_context->vitem_limit-1; i++)
-			if (FL_TEST(&current_context->vitems_pool[i], FL_INUSE))
+		for (unsigned i = 1; i < current_context->vitem_top; i++)
+			if (FL_TEST(arcan_vint_vitem(current_context, i), FL_INUSE))
 				(*used)++;
 	}
 
 	return current_context->vitem_limit-1;
 }
 
+static size_t vstore_bytes(struct agp_vstore* vs)
+{
+	size_t bpp = vs->bpp ? vs->bpp : sizeof(av_pixel);
+	return vs->w * vs->h * bpp;
+}
+
+static bool vstore_resident(struct agp_vstore* vs)
+{
+	return vs->vinf.text.glid != 0 || vs->vinf.text.glid_proxy;
+}
+
+static void context_usage(
+	struct arcan_video_context* ctx, struct arcan_video_usage* dst)
+{
+	*dst = (struct arcan_video_usage){
+		.vobject_limit = ctx->vitem_limit - 1,
+		.rendertargets = ctx->n_rtargets
+	};
+
+/* stores shared between objects are split by refcount so they count once */
+	for (unsigned i = 1; i < ctx->vitem_top; i++){
+		arcan_vobject* vobj = arcan_vint_vitem(ctx, i);
+		if (!FL_TEST(vobj, FL_INUSE))
+			continue;
+
+		dst->vobjects++;
+		struct agp_vstore* vs = vobj->vstore;
+		if (!vs || vs->txmapped == TXSTATE_OFF)
+			continue;
+
+		size_t refc = vs->refcount ? vs->refcount : 1;
+		size_t bytes = vstore_bytes(vs) / refc;
+		dst->store_gpu += bytes;
+
+		if (vstore_resident(vs))
+			dst->store_resident += bytes;
+		else if (FL_TEST(vobj, FL_EVICTED))
+			dst->store_evicted += bytes;
+
+		if (vs->txmapped == TXSTATE_TPACK)
+			dst->store_cpu += vs->vinf.text.tpack.buf_sz / refc;
+		else if (vs->vinf.text.raw)
+			dst->store_cpu += vs->vinf.text.s_raw / refc;
+	}
+}
+
+void arcan_video_usage(struct arcan_video_usage* dst)
+{
+	context_usage(current_context, dst);
+}
+
+bool arcan_video_contextusage_at(unsigned ofs, struct arcan_video_usage* dst)
+{
+	if (ofs > vcontext_ind)
+		return false;
+
+	context_usage(&vcontext_stack[vcontext_ind - ofs], dst);
+	return true;
+}
+
+size_t arcan_video_vstore_budget(
+	ssize_t budget, size_t* evictions, size_t* restores)
+{
+	size_t old = arcan_video_display.vstore_budget;
+	if (budget >= 0)
+		arcan_video_display.vstore_budget = budget;
+
+	if (evictions)
+		*evictions = residency.evictions;
+
+	if (restores)
+		*restores = residency.restores;
+
+	return old;
+}
+
+/*
+ * Only stores that can be rebuilt without help from the appl are considered,
+ * that is plain images with a local copy or (conservative) a source to load
+ * from, not shared with other objects and not drawn for a few frames.
+ */
+static bool residency_evictable(arcan_vobject* vobj)
+{
+	struct agp_vstore* vs = vobj->vstore;
+
+	return FL_TEST(vobj, FL_INUSE) &&
+		!FL_TEST(vobj, FL_EVICTED | FL_RTGT) &&
+		(char) vobj->feed.state.tag == ARCAN_TAG_IMAGE &&
+		!vobj->frameset && vs && vs->refcount == 1 &&
+		vs->txmapped == TXSTATE_TEX2D &&
+		vs->vinf.text.kind == STORAGE_IMAGE_URI &&
+		vs->vinf.text.glid && !vs->vinf.text.glid_proxy &&
+		(vs->vinf.text.raw || vs->vinf.text.source) &&
+		vobj->last_drawn + RESIDENCY_GRACE < residency.frame;
+}
+
+static int residency_cmp(const void* a, const void* b)
+{
+	const arcan_vobject* va = *(arcan_vobject* const*) a;
+	const arcan_vobject* vb = *(arcan_vobject* const*) b;
+	return va->last_drawn < vb->last_drawn ? -1 : va->last_drawn > vb->last_drawn;
+}
+
+/* drop the least recently drawn stores until we're an eight below budget */
+static void residency_enforce()
+{
+	size_t budget = arcan_video_display.vstore_budget;
+	if (!budget)
+		return;
+
+	struct arcan_video_usage use;
+	context_usage(current_context, &use);
+	if (use.store_resident <= budget)
+		return;
+
+	arcan_vobject** cand = arcan_alloc_mem(
+		sizeof(arcan_vobject*) * current_context->vitem_top, ARCAN_MEM_VSTRUCT,
+		ARCAN_MEM_TEMPORARY | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL
+	);
+	if (!cand)
+		return;
+
+	size_t n = 0;
+	for (unsigned i = 1; i < current_context->vitem_top; i++){
+		arcan_vobject* vobj = arcan_vint_vitem(current_context, i);
+		if (residency_evictable(vobj))
+			cand[n++] = vobj;
+	}
+
+	qsort(cand, n, sizeof(arcan_vobject*), residency_cmp);
+
+	size_t target = budget - (budget >> 3);
+	for (size_t i = 0; i < n && use.store_resident > target; i++){
+		size_t bytes = vstore_bytes(cand[i]->vstore);
+		agp_null_vstore(cand[i]->vstore);
+		FL_SET(cand[i], FL_EVICTED);
+		use.store_resident = bytes > use.store_resident ? 0 : use.store_resident - bytes;
+		residency.evictions++;
+	}
+
+	arcan_mem_free(cand);
+}
+
+void arcan_vint_residency_touch(arcan_vobject* vobj)
+{
+	vobj->last_drawn = residency.frame;
+	if (!FL_TEST(vobj, FL_EVICTED))
+		return;
+
+	FL_CLEAR(vobj, FL_EVICTED);
+	residency.restores++;
+	struct agp_vstore* vs = vobj->vstore;
+
+	if (vs->vinf.text.raw){
+		agp_update_vstore(vs, true);
+		return;
+	}
+
+/* conservative mode dropped the local copy after the upload, load from the
+ * source again, getimage will strdup so copy and free - see reallocate */
+	char* fname = strdup(vs->vinf.text.source);
+	if (!fname)
+		return;
+
+	arcan_mem_free(vs->vinf.text.source);
+	vs->vinf.text.source = NULL;
+
+	if (ARCAN_OK != arcan_vint_getimage(fname,
+		vobj, (img_cons){.w = vobj->origw, .h = vobj->origh}, false)){
+		arcan_warning("vstore_budget: couldn't reload evicted (%s)\n", fname);
+		if (!vs->vinf.text.source)
+			vs->vinf.text.source = fname;
+		else
+			arcan_mem_free(fname);
+		return;
+	}
+
+	arcan_mem_free(fname);
+}
+
 bool arcan_video_contextsize(unsigned newlim)
 {
 	if (newlim <= 1 || newlim >= VITEM_CONTEXT_LIMIT)
@@ -6094,8 +8443,8 @@ bool arcan_video_contextsize(unsigned newlim)
 /* this change isn't allowed when the shrink/expand operation would
  * change persistent objects in the stack */
 	if (newlim < arcan_video_display.default_vitemlim)
-		for (unsigned i = 1; i < current_context->vitem_limit-1; i++)
-			if (FL_TEST(&current_context->vitems_pool[i], FL_INUSE|FL_PRSIST))
+		for (unsigned i = 1; i < current_context->vitem_top; i++)
+			if (FL_TEST(arcan_vint_vitem(current_context, i), FL_INUSE|FL_PRSIST))
 				return false;
 
 	arcan_video_display.default_vitemlim = newlim;
@@ -6125,11 +8474,11 @@ static void flag_ctxfsrv_dms(struct arcan_video_context* ctx)
 	if (!ctx)
 		return;
 
-	for (size_t i = 1; i < ctx->vitem_limit; i++){
-		if (!FL_TEST(&(ctx->vitems_pool[i]), FL_INUSE))
+	for (size_t i = 1; i < ctx->vitem_top; i++){
+		arcan_vobject* current = arcan_vint_vitem(ctx, i);
+		if (!FL_TEST(current, FL_INUSE))
 			continue;
 
-		arcan_vobject* current = &ctx->vitems_pool[i];
 		if (current->feed.state.tag ==
 			ARCAN_TAG_FRAMESERV && current->feed.state.ptr){
 			struct arcan_frameserver* fsrv = current->feed.state.ptr;
@@ -6171,6 +8520,7 @@ void arcan_video_shutdown(bool release_fsrv)
 
 	agp_shader_flush();
 	deallocate_gl_context(current_context, true, NULL);
+	arcan_workers_shutdown();
 	arcan_video_reset_fontcache();
 	TTF_Quit();
 	platform_video_shutdown();
@@ -6239,10 +8589,19 @@ arcan_vobj_id arcan_video_renderstring(arcan_vobj_id src,
 		current_context->attachment : &current_context->stdoutp;
 	arcan_renderfun_outputdensity(dst->hppcm, dst->vppcm);
 
+/* with the atlas, text that can be drawn as glyph quads skips rasterizing */
+	struct vobject_glyphs* glyphs = NULL;
+	if (arcan_video_display.text_atlas)
+		glyphs = arcan_renderfun_glyphs(data.multiple ? NULL : data.message,
+			data.multiple ? (const char**) data.array : NULL,
+			n_lines, lineheights, &maxw, &maxh);
+
 	if (src == ARCAN_EID){
 		vobj = arcan_video_newvobject(&rv);
-		if (!vobj)
+		if (!vobj){
+			arcan_mem_free(glyphs);
 			FAIL(ARCAN_ERRC_OUT_OF_SPACE);
+		}
 
 #define ARGLST src, false, n_lines, \
 lineheights, &w, &h, &dsz, &maxw, &maxh, false
@@ -6253,6 +8612,19 @@ lineheights, &w, &h, &dsz, &maxw, &maxh, false
 		vobj->feed.state.tag = ARCAN_TAG_TEXT;
 		vobj->blendmode = BLEND_FORCE;
 
+		if (glyphs){
+			ds->vinf.text.vppcm = dst->vppcm;
+			ds->vinf.text.hppcm = dst->hppcm;
+			ds->vinf.text.kind = STORAGE_TEXT;
+			ds->vinf.text.raw = NULL;
+			ds->vinf.text.s_raw = 0;
+			ds->w = maxw;
+			ds->h = maxh;
+			vobj->glyphs = glyphs;
+			arcan_vint_attachobject(rv);
+			goto done;
+		}
+
 		ds->vinf.text.raw = data.multiple ?
 			arcan_renderfun_renderfmtstr_extended((const char**)data.array, ARGLST) :
 			arcan_renderfun_renderfmtstr(data.message, ARGLST);
@@ -6282,8 +8654,17 @@ lineheights, &w, &h, &dsz, &maxw, &maxh, false
 			FAIL(ARCAN_ERRC_UNACCEPTED_STATE);
 
 		ds = vobj->vstore;
-
-		if (data.multiple)
+		arcan_mem_free(vobj->glyphs);
+		vobj->glyphs = glyphs;
+
+		if (glyphs){
+			arcan_mem_free(ds->vinf.text.raw);
+			ds->vinf.text.raw = NULL;
+			ds->vinf.text.s_raw = 0;
+			ds->w = maxw;
+			ds->h = maxh;
+		}
+		else if (data.multiple)
 			arcan_renderfun_renderfmtstr_extended((const char**)data.array, ARGLST);
 		else
 			arcan_renderfun_renderfmtstr(data.message, ARGLST);
@@ -6292,6 +8673,7 @@ lineheights, &w, &h, &dsz, &maxw, &maxh, false
 		arcan_video_objectscale(vobj->cellid, 1.0, 1.0, 1.0, 0);
 	}
 
+done:
 	vobj->origw = maxw;
 	vobj->origh = maxh;
 
@@ -318,6 +318,9 @@ arcan_errc arcan_video_maxorder(arcan_vobj_id rt, uint16_t* ov);
  *
  * 0 > newlim < VITEM_CONTEXT_LIMIT
  *
+ * The limit only caps the id range, storage is allocated in chunks of
+ * VITEM_CHUNK_SIZE as the range in use grows.
+ *
  * will fail if shrinking a context would undershoot the number
  * of persistent- flagged items.
  */
@@ -374,6 +377,41 @@ signed arcan_video_extpushcontext(arcan_vobj_id* dst);
  */
 unsigned arcan_video_contextusage(unsigned* used);
 
+/*
+ * Object counts and an estimate of the backing store memory in the current
+ * context, [store_gpu] from the store dimensions and [store_cpu] for the
+ * local copies that are kept around (raw, unpacked tpack).
+ */
+struct arcan_video_usage {
+	unsigned vobjects, vobject_limit;
+	unsigned rendertargets;
+	size_t store_gpu, store_cpu;
+
+/* the part of store_gpu that currently has GPU storage, and the part that
+ * was dropped to stay within the vstore budget and will be reloaded on use */
+	size_t store_resident, store_evicted;
+};
+void arcan_video_usage(struct arcan_video_usage* dst);
+
+/*
+ * Same as arcan_video_usage, but for the context [ofs] steps below the
+ * current one in the context stack (0 being the current). Returns false if
+ * there is no such context.
+ */
+bool arcan_video_contextusage_at(unsigned ofs, struct arcan_video_usage* dst);
+
+/*
+ * Set the number of bytes of resident stores the active context may use
+ * before image backed stores that haven't been drawn recently get their GPU
+ * copy dropped (least recently drawn first). They are reloaded from the
+ * local copy or from the source the next time they are drawn. 0 disables.
+ *
+ * Returns the previous budget, and the number of evictions and re-uploads
+ * performed so far in [evictions] and [restores] if provided.
+ */
+size_t arcan_video_vstore_budget(
+	ssize_t budget, size_t* evictions, size_t* restores);
+
 /*
  * Create a "visible" but initially non-drawable object with its initial
  * dimensions set to [origw] and [origh] ordered by [zv]. This should be
@@ -524,8 +562,8 @@ arcan_errc arcan_video_resizefeed(arcan_vobj_id id, size_t w, size_t h);
  * defined in the resource will be retained, otherwise the image will be
  * rescaled upon loading (unfiltered and rather slow).
  *
- * The asynchronous version will spawn a worker thread (up to a certain
- * number, compile-time limited with ASYNCH_CONCURRENT_THREADS).
+ * The asynchronous version queues the job for a shared pool of worker
+ * threads (grown on demand, ASYNCH_CONCURRENT_THREADS or video_image_workers).
  * Context operations will force a join on any outstanding asynchronous
  * loading jobs.
  *
@@ -568,6 +606,27 @@ arcan_errc arcan_video_resize_canvas(size_t neww, size_t newh);
 arcan_errc arcan_video_resampleobject(arcan_vobj_id id, arcan_vobj_id did,
 		size_t neww, size_t newh, agp_shader_id prg, bool nocopy);
 
+/*
+ * Resample a batch of sources into [w, h] each, using [prg] and a single
+ * rendertarget pass into a shared atlas (more passes only if the batch
+ * does not fit in RESAMPLE_ATLAS_SIZE). [out] is set to a new object per
+ * job. If [separate] is set, the atlas is read back once and split into
+ * individual stores, otherwise the new objects share the atlas store and
+ * reference their region through texture coordinates.
+ *
+ * The batch is either completed in full or not at all, and on success an
+ * EVENT_VIDEO_RESAMPLE_COMPLETE is enqueued with [tag] as data and the
+ * [out] of the first job as source.
+ */
+struct arcan_resample_job {
+	arcan_vobj_id src;
+	size_t w, h;
+	arcan_vobj_id out;
+};
+
+arcan_errc arcan_video_resamplebatch(struct arcan_resample_job* jobs,
+	size_t n, agp_shader_id prg, bool separate, intptr_t tag);
+
 /* Object hierarchy related functions */
 arcan_errc arcan_video_linkobjs(arcan_vobj_id src, arcan_vobj_id parent,
 	enum arcan_transform_mask mask, enum parent_anchor, enum parent_scale);
@@ -728,6 +787,15 @@ arcan_errc arcan_video_detachfromrendertarget(arcan_vobj_id did,
 arcan_errc arcan_video_alterreadback(arcan_vobj_id did, int readback);
 arcan_errc arcan_video_rendertarget_setnoclear(arcan_vobj_id did, bool value);
 
+/*
+ * Retrieve the most recently collected GPU time (nanoseconds) for a pass of
+ * the rendertarget backing of *did* (or WORLDID).
+ * Error codes:
+ *  ARCAN_ERRC_NO_SUCH_OBJECT
+ *  ARCAN_ERRC_UNACCEPTED_STATE (video_gpu_timers disabled or no result yet)
+ */
+arcan_errc arcan_video_rendertarget_gputime(arcan_vobj_id did, uint64_t* ns);
+
 /*
  * Define the range of valid, resolved, order values that will actually be
  * drawn for the rendertarget. A negative number or where max < min will
@@ -965,6 +1033,25 @@ arcan_errc arcan_video_objectrotate3d(
 arcan_errc arcan_video_objectopacity(
 	arcan_vobj_id id, float opa, unsigned int time);
 
+/*
+ * Append the same kind of transformation to [n] objects in one pass, with
+ * the object lookup and chain append done once per object. [vals] holds
+ * two (move: x, y / resize: w, h) or one (blend: opacity) value per object.
+ * Resize takes absolute dimensions that are translated to factors of the
+ * initial size (0 in one axis retains the aspect ratio). [interp] is set on
+ * the appended links if [time] > 0 and it is a valid arcan_vinterp. Invalid
+ * objects are skipped, returns the number of objects that were updated.
+ */
+enum arcan_batch_transform {
+	ARCAN_BATCH_MOVE = 0,
+	ARCAN_BATCH_RESIZE,
+	ARCAN_BATCH_BLEND
+};
+
+size_t arcan_video_transform_batch(enum arcan_batch_transform kind,
+	const arcan_vobj_id* ids, const float* vals, size_t n,
+	unsigned time, int interp);
+
 /*
  * Switch interpolation function of the last entry of the current blend
  * transformation chain
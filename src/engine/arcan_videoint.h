@@ -16,6 +16,22 @@
 #define RENDERTARGET_LIMIT 64
 #endif
 
+/*
+ * vobject storage in a context is split into chunks of this many slots,
+ * allocated on demand as the id range in use grows.
+ */
+#ifndef VITEM_CHUNK_SIZE
+#define VITEM_CHUNK_SIZE 256
+#endif
+
+/*
+ * number of GPU timer queries per rendertarget (video_gpu_timers), this
+ * bounds how many frames a result may lag behind before a pass goes untimed.
+ */
+#ifndef GPUTIME_RING
+#define GPUTIME_RING 4
+#endif
+
 /*
  *  Indicate that the video pipeline is in such a state that
  *  it should be redrawn. X should be NULL or a vobj reference
@@ -62,6 +78,10 @@ struct rendertarget {
 /* might be set by the platform layer, check when building projections */
 	bool inv_y;
 
+/* set by the platform layer for the coming refresh when the display(s) the
+ * rendertarget is mapped to are not due yet, see arcan_conductor_display_due */
+	bool deferred;
+
 /* identifier for matching against shader */
 	int id;
 
@@ -130,6 +150,68 @@ struct rendertarget {
  * we need to track the lower accepted bounds and the max accepted bounds.
  */
 	size_t min_order, max_order;
+
+/*
+ * Damage tracking (video_damage_regions), [id] is matched against the
+ * attachment records to detect which target the records belong to, [sig]
+ * covers target-wide state (projection, shader, ...) and [box] accumulates
+ * the area of elements that were detached since the last pass.
+ */
+	struct rendertarget_damage {
+		uint64_t id;
+		uint64_t sig;
+		struct agp_region box;
+	} damage;
+
+/*
+ * Optional (video_pick_index) uniform grid over world-space bounding boxes,
+ * refit each pass from the resolved properties and used by the pick functions
+ * to narrow down the candidates. Entries are in pipeline order, [seq] is
+ * bumped on attach/detach and the index is only used while it matches
+ * [built]. [moved] is the position in the moved-object log at build time.
+ */
+	struct rendertarget_pickidx {
+		struct rendertarget_pickent {
+			struct arcan_vobject* vobj;
+			float x1, y1, x2, y2;
+			bool drawn, stable;
+		}* entries;
+		size_t* dynamic;
+		size_t* scratch;
+		size_t* cells;
+		size_t* cell_ofs;
+		size_t count, limit, n_dynamic, cells_limit;
+		float x1, y1, cw, ch;
+		uint64_t seq, built, moved;
+		bool valid;
+	} pick;
+
+/*
+ * CPU- side preparation of the 2D pipeline (resolved properties, modelview
+ * and rotation state) in pipeline order. This is populated by a worker job
+ * ahead of drawing (see video_prepare_threads) and consumed by the serial
+ * submission in process_rendertarget. It is only valid for the pass where
+ * cookie matches the display cookie and first matches the current pipeline.
+ */
+	struct rendertarget_prep {
+		surface_properties* props;
+		float* world;
+		bool* rotate;
+		size_t count, limit;
+		uint64_t cookie;
+		struct arcan_vobject_litem* first;
+	} prep;
+
+/*
+ * Optional (video_gpu_timers) ring of GPU timer queries for the passes of
+ * this target, [count] are in flight ending before [head] and [last_ns] is
+ * the most recently collected result.
+ */
+	struct rendertarget_gputime {
+		unsigned queries[GPUTIME_RING];
+		size_t head, count;
+		uint64_t last_ns;
+	} gputime;
 };
 
 enum vobj_flags {
@@ -140,7 +222,13 @@ enum vobj_flags {
 	FL_ORDOFS = 16,
 	FL_PRSIST = 32,
 	FL_FULL3D = 64, /* switch to a quaternion- based orientation scheme */
-	FL_RTGT   = 128
+	FL_RTGT   = 128,
+/* set by the video platform when the object is scanned out on a display plane
+ * of its own, the world rendertarget then leaves it out of composition */
+	FL_SCANOUT = 256,
+/* the GPU copy of the store has been dropped to stay within the vstore budget
+ * (video_vstore_budget), it is re-uploaded before the object is drawn */
+	FL_EVICTED = 512
 };
 
 struct transf_move{
@@ -200,6 +288,19 @@ struct vobject_frameset {
 	enum arcan_framemode mode; /* how frameset should be applied */
 };
 
+/*
+ * Text drawn as quads referencing glyphs in the shared atlas store that
+ * arcan_renderfun maintains (video_text_atlas). Per glyph, verts are x1,y1,
+ * x2,y2 in the pixel space of the text (origw, origh) and txcos s1,t1,s2,t2
+ * in the atlas.
+ */
+struct vobject_glyphs {
+	struct agp_vstore* atlas;
+	size_t count;
+	float* verts;
+	float* txcos;
+};
+
 /*
  * Contents of this structure has grown from horrible to terrible over time.
  * It is due for a long overhaul as soon as regression and benchmark coverage
@@ -267,10 +368,19 @@ typedef struct arcan_vobject {
 	surface_properties prop_cache;
 	float _Alignas(16) prop_matr[16];
 
+/* entry in the pick index of the owner rendertarget (see video_pick_index) */
+	size_t pick_ind;
+
+/* set for text that is drawn from the glyph atlas instead of its vstore */
+	struct vobject_glyphs* glyphs;
+
 /* life-cycle tracking */
 	unsigned long last_updated;
 	long lifetime;
 
+/* residency frame (see arcan_vint_residency_touch) when last drawn */
+	uint64_t last_drawn;
+
 /* management mappings */
 	enum parent_anchor p_anchor;
 	enum parent_scale p_scale;
@@ -294,17 +404,92 @@ typedef struct arcan_vobject {
 	char* tracetag;
 } arcan_vobject;
 
+/*
+ * Packed (structure-of-arrays) cache of resolved transforms, indexed by vid.
+ * When enabled (video_soa_tfcache), each rendertarget pass first resolves
+ * the objects in its pipeline in one linear sweep, and the draw loop and
+ * parent-chain lookups then read from these contiguous arrays rather than
+ * walking the transform chain of each object again.
+ *
+ * A slot is only valid while gen[vid] matches the generation of the pass
+ * that is currently active, outside of a pass (active == 0) the cache is
+ * never consulted.
+ */
+struct vobject_tfcache {
+	size_t limit;
+	uint64_t active;
+	uint64_t counter;
+
+	uint64_t* gen;
+	point* position;
+	scalefactor* scale;
+	surface_orientation* rotation;
+	float* opacity;
+
+/* 16 floats per slot, the modelview matrix as built from the owner base */
+	float* world;
+};
+
 /* regular old- linked list, but also mapped to an array */
 struct arcan_vobject_litem {
 	arcan_vobject* elem;
 	struct arcan_vobject_litem* next;
 	struct arcan_vobject_litem* previous;
+
+/* what the element looked like and covered (framebuffer coordinates) the last
+ * time it was drawn, this is per attachment as the same vobj can be drawn in
+ * several rendertargets - see video_damage_regions */
+	struct {
+		bool valid;
+		uint64_t tgt;
+		uint64_t sig;
+		struct agp_region box;
+	} damage;
 };
 typedef struct arcan_vobject_litem arcan_vobject_litem;
 
 struct arcan_video_display {
 	bool suspended, fullscreen, conservative, in_video, no_stdout;
 
+/* resolve transforms into the packed cache before each rendertarget pass */
+	bool soa_tfcache;
+
+/* only redraw the parts of rendertargets that changed since the last pass */
+	bool damage_regions;
+
+/* maintain a spatial index per rendertarget for picking and culling */
+	bool pick_index;
+
+/* merge consecutive default-shaded quads sharing state into one draw */
+	bool batch_draws;
+
+/* draw text from a shared glyph atlas rather than rastering each label */
+	bool text_atlas;
+
+/* draw TPACK clients from a cell grid and a shared glyph atlas on the GPU */
+	bool tpack_gpu;
+
+/* hand recordtarget stores to willing clients as buffers instead of reading back */
+	bool export_readback;
+
+/* skip 3d models outside the camera frustum, optionally also those that were
+ * occluded the last time they were drawn */
+	bool cull_3d;
+	bool occlusion_3d;
+
+/* requested worker threads for rendertarget preparation, 0 = serial, the
+ * number actually running is arcan_workers_count() */
+	size_t prepare_threads;
+
+/* bytes of resident vstores the active context may hold before image backed
+ * stores that aren't drawn get evicted, 0 = no limit */
+	size_t vstore_budget;
+
+/* time rendertarget passes on the GPU, [gpu_frame_ns] accumulates collected
+ * results until the end of the refresh */
+	bool gpu_timers;
+	uint64_t gpu_frame_ns;
+
 /* Updated every time a new processing run is made, any object that might have
  * multiple references that should only be processed once per update cycle
  * should store and compare cookie before proceeding. The main use for this is
@@ -364,19 +549,29 @@ struct arcan_video_display {
  * object in the subset. if first and dest are null, stop processing the list
  * of rendertargets. */
 struct arcan_video_context {
-	unsigned vitem_ofs;
+/* vitem_top is one past the highest id that has been handed out, vitem_limit
+ * is the id cap for the context. The pool is a table of chunk pointers where
+ * the first vitem_nchunks entries are backed, and ids below vitem_top that are
+ * not in use are kept on the vitem_free ring, vitem_fhead is the oldest entry
+ * and vitem_nfree the number queued. */
+	unsigned vitem_top;
 	unsigned vitem_limit;
 	long int nalive;
 	arcan_tickv last_tickstamp;
 
 	arcan_vobject world;
-	arcan_vobject* vitems_pool;
+	arcan_vobject** vitems_pool;
+	size_t vitem_nchunks;
+	unsigned* vitem_free;
+	size_t vitem_nfree;
+	size_t vitem_fhead;
 
 	struct rendertarget rtargets[RENDERTARGET_LIMIT];
 	struct rendertarget* attachment;
 	ssize_t n_rtargets;
 
 	struct rendertarget stdoutp;
+	struct vobject_tfcache tfcache;
 };
 
 extern struct arcan_video_context vcontext_stack[];
@@ -436,6 +631,12 @@ void arcan_debug_tracetag_dump();
  * used primarily by the video-platform layer
  */
 struct agp_vstore* arcan_vint_world();
+
+/*
+ * mark [vobj] as drawn in the current frame, and if it has been evicted to
+ * stay within the vstore budget, re-upload the store before it is used
+ */
+void arcan_vint_residency_touch(arcan_vobject* vobj);
 struct agp_rendertarget* arcan_vint_worldrt();
 
 /*
@@ -465,6 +666,13 @@ void arcan_vint_reraster(arcan_vobject* img, struct rendertarget*);
  */
 arcan_vobj_id arcan_vint_nextfree();
 
+/*
+ * Resolve the storage slot for [id] in [ctx] regardless of its INUSE state,
+ * returns NULL if the id is outside of the backed range of the pool. Any id
+ * below ctx->vitem_top is guaranteed to be backed.
+ */
+arcan_vobject* arcan_vint_vitem(struct arcan_video_context* ctx, size_t id);
+
 /*
  * get the internal structure of the rendertarget that vobj has as
  * its primary attachment (for ordering etc.)
@@ -30,6 +30,7 @@
 #include "arcan_audio.h"
 #include "arcan_audioint.h"
 #include "arcan_3dbase.h"
+#include "arcan_conductor.h"
 
 #define FRAMESERVER_PRIVATE
 #include "arcan_frameserver.h"
@@ -52,6 +53,15 @@ struct limb_ent {
 	arcan_vobj_id map;
 	bool position, orientation;
 	uint_least32_t ts;
+
+/* last sample that validated, when it was taken and the angular velocity it
+ * is extrapolated with (reported by the bridge or taken from the difference
+ * to the sample before it), [pos_pending] until its position is applied */
+	union vr_data sample;
+	bool have_sample;
+	bool pos_pending;
+	uint64_t sample_us;
+	vector angvel;
 };
 
 struct arcan_vr_ctx {
@@ -59,8 +69,24 @@ struct arcan_vr_ctx {
 	arcan_frameserver* connection;
 	uint64_t map;
 	struct limb_ent limb_map[LIMB_LIM+1];
+
+/* how far ahead (us) orientations can be predicted, the scanout that the
+ * last latch was for and the neck orientation that was latched for it */
+	uint64_t predict_us;
+	uint64_t latch_us;
+	quat latched;
+	bool have_latch;
+
+/* next ticket to consume from the sample ring */
+	uint64_t ring_tail;
 };
 
+/* the context that was last latched, for the reprojection uniform */
+static struct {
+	struct arcan_vr_ctx* ctx;
+	bool identity;
+} reproj;
+
 struct arcan_vr_ctx* arcan_vr_setup(
 	const char* bridge_arg, struct arcan_evctx* evctx, uintptr_t tag)
 {
@@ -90,6 +116,13 @@ struct arcan_vr_ctx* arcan_vr_setup(
 	arr_argv.data[0] = strdup(kv);
 	arr_argv.count = 1;
 
+	uint64_t predict_us = 50000;
+	char* kvp = arcan_db_appl_val(dbh, appl, "ext_vr_predict");
+	if (kvp){
+		predict_us = strtoul(kvp, NULL, 10) * 1000;
+		free(kvp);
+	}
+
 	char* kvd = arcan_db_appl_val(dbh, appl, "ext_vr_debug");
 	if (kvd){
 		arcan_mem_growarr(&arr_env);
@@ -134,7 +167,8 @@ struct arcan_vr_ctx* arcan_vr_setup(
 	debug_print(1, "vrbridge launched (%s)", args.args.external.fname);
 	*vrctx = (struct arcan_vr_ctx){
 		.ctx = evctx,
-		.connection = mvctx
+		.connection = mvctx,
+		.predict_us = predict_us
 	};
 	mvctx->segid = SEGID_SENSOR;
 	arcan_video_alterfeed(mvctx->vid, FFUNC_VR,
@@ -153,14 +187,137 @@ struct arcan_vr_ctx* arcan_vr_setup(
 	return vrctx;
 }
 
+/*
+ * Take the sample as a rotation from the angular velocity over the time until
+ * [at_us] (capped to what the context allows), applied in the same order as
+ * the velocity is estimated in push_sample.
+ */
+static quat predict_orientation(
+	struct arcan_vr_ctx* ctx, struct limb_ent* lent, uint64_t at_us)
+{
+	quat q = lent->sample.orientation;
+	if (!ctx->predict_us || at_us <= lent->sample_us)
+		return q;
+
+	uint64_t dt_us = at_us - lent->sample_us;
+	if (dt_us > ctx->predict_us)
+		dt_us = ctx->predict_us;
+
+	vector w = lent->angvel;
+	float mag = sqrtf(w.x * w.x + w.y * w.y + w.z * w.z);
+	float ang = mag * ((float)dt_us / 1000000.0f);
+	if (ang < 1e-6f)
+		return q;
+
+	float s = sinf(0.5f * ang) / mag;
+	quat d = {.x = w.x * s, .y = w.y * s, .z = w.z * s, .w = cosf(0.5f * ang)};
+	return norm_quat(mul_quat(q, d));
+}
+
+/*
+ * The rate a bridge samples at can be far above the display rate, the
+ * velocity estimated between two samples is smoothed over about this long
+ */
+#define ANGVEL_TAU_US 10000.0f
+
+static void push_sample(
+	struct limb_ent* lent, const union vr_data* data, uint64_t sample_us)
+{
+	vector w = data->angular_velocity;
+
+/* without a reported velocity, the rotation from the previous sample */
+	if (w.x == 0.0f && w.y == 0.0f && w.z == 0.0f &&
+		lent->have_sample && sample_us > lent->sample_us){
+		w = lent->angvel;
+		quat d = mul_quat(inv_quat(lent->sample.orientation), data->orientation);
+		if (d.w < 0.0f)
+			d = mul_quatf(d, -1.0f);
+
+		float dt_us = sample_us - lent->sample_us;
+		float sh = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+		float f = sh > 1e-6f ? 2.0f * atan2f(sh, d.w) / (sh * dt_us / 1000000.0f) : 0.0f;
+		float a = dt_us / (dt_us + ANGVEL_TAU_US);
+		w.x += a * (d.x * f - w.x);
+		w.y += a * (d.y * f - w.y);
+		w.z += a * (d.z * f - w.z);
+	}
+
+	lent->sample = *data;
+	lent->sample_us = sample_us;
+	lent->angvel = w;
+	lent->have_sample = true;
+	lent->pos_pending = true;
+}
+
+/*
+ * Without a sample ring, copy and validate the current sample of a limb.
+ * Failing validation means that it is being updated, it is then left for the
+ * next poll or latch without marking it as seen.
+ */
+static void fetch_limb(
+	struct arcan_shmif_vr* vr, size_t i, struct limb_ent* lent)
+{
+	uint32_t ts = atomic_load(&vr->limbs[i].timestamp);
+	if (lent->have_sample && ts == lent->ts)
+		return;
+
+	struct vr_limb vl = vr->limbs[i];
+	if (vr_limb_checksum(&vl) != atomic_load(&vl.data.checksum)){
+		debug_print(1, "limb %zu failed to validate\n", i);
+		return;
+	}
+
+	debug_print(2, "limb %zu updated - %"PRIu32, i, ts);
+	lent->ts = atomic_load(&vl.timestamp);
+	push_sample(lent, &vl.data,
+		vl.data.sample_us ? vl.data.sample_us : arcan_timemicros());
+}
+
+/*
+ * Take in everything the bridge has produced since the last time, that is
+ * every sample in the ring or the last sample of each mapped limb.
+ */
+static void ingest_samples(struct arcan_vr_ctx* ctx, struct arcan_shmif_vr* vr)
+{
+	struct vr_sample_ring* ring = vr_sample_ring(vr);
+	if (!ring){
+		for (size_t i = 0; i < LIMB_LIM; i++)
+			if (ctx->limb_map[i].map)
+				fetch_limb(vr, i, &ctx->limb_map[i]);
+		return;
+	}
+
+	uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	if (head - ctx->ring_tail > VR_RING_SIZE){
+		debug_print(1, "sample ring overrun, %"PRIu64" lost",
+			head - ctx->ring_tail - VR_RING_SIZE);
+		ctx->ring_tail = head - VR_RING_SIZE;
+	}
+
+/* a slot that is still being written stops the drain until next time */
+	while (ctx->ring_tail < head){
+		struct vr_sample smp;
+		int rv = vr_ring_get(ring, ctx->ring_tail, &smp);
+		if (0 == rv)
+			break;
+
+		ctx->ring_tail++;
+		if (-1 == rv || smp.limb >= LIMB_LIM || !ctx->limb_map[smp.limb].map)
+			continue;
+
+		push_sample(&ctx->limb_map[smp.limb], &smp.data, smp.sample_us);
+	}
+}
+
 /*
  * there might be better ways of applying this to an object that
  * would match better in the resolve path, but it's far away on the
  * experiment table
  */
-static void apply_limb(struct vr_limb* limb, struct limb_ent* lent)
+static void apply_limb(union vr_data* limb,
+	struct limb_ent* lent, quat orientation, bool use_position)
 {
-	vector tb = angle_quat(limb->data.orientation);
+	vector tb = angle_quat(orientation);
 	arcan_vobject* vobj = arcan_video_getobject(lent->map);
 	assert(vobj);
 	FLAG_DIRTY(vobj);
@@ -169,21 +326,38 @@ static void apply_limb(struct vr_limb* limb, struct limb_ent* lent)
 		vobj->current.rotation.roll = tb.x;
 		vobj->current.rotation.pitch = tb.y;
 		vobj->current.rotation.yaw = tb.z;
-		vobj->current.rotation.quaternion = limb->data.orientation;
+		vobj->current.rotation.quaternion = orientation;
 	}
 /* since 3dbase disables resolving entirely if there's a limb-map,
  * when we have the opportunity to test tools, we likely need to
  * resolve and translate ourselves */
-	if (lent->position){
+	if (lent->position && use_position){
 		surface_properties dprop;
 		arcan_resolve_vidprop(vobj, 0.0, &dprop);
-		vobj->current.position = limb->data.position;
+		vobj->current.position = limb->position;
 		vobj->current.position.x += dprop.position.x;
 		vobj->current.position.y += dprop.position.y;
 		vobj->current.position.z += dprop.position.z;
 	}
 }
 
+/* predict the limb sample to [at_us] and apply to the mapped model, the neck
+ * sample also drives the extra (camera) mapping. Positions are relative to
+ * the resolved position so they are only applied once per sample. */
+static quat apply_sample(struct arcan_vr_ctx* ctx, size_t i, uint64_t at_us)
+{
+	struct limb_ent* lent = &ctx->limb_map[i];
+	quat q = predict_orientation(ctx, lent, at_us);
+	bool use_position = lent->pos_pending;
+
+	apply_limb(&lent->sample, lent, q, use_position);
+	if (i == NECK && ctx->limb_map[LIMB_LIM].map)
+		apply_limb(&lent->sample, &ctx->limb_map[LIMB_LIM], q, use_position);
+
+	lent->pos_pending = false;
+	return q;
+}
+
 /*
  * This ffunc is a simplified version of the arcan_frameserver_emptyframe
  * where we also check limb updates and synch position / head tracking
@@ -203,6 +377,11 @@ enum arcan_ffunc_rv arcan_vr_ffunc FFUNC_HEAD
 		arcan_frameserver_free(tgt);
 		ctx->connection = NULL;
 
+		if (reproj.ctx == ctx){
+			reproj.ctx = NULL;
+			reproj.identity = false;
+		}
+
 		for (size_t i = 0; i < LIMB_LIM+1; i++){
 			if (ctx->limb_map[i].map){
 				arcan_3d_bindvr(ctx->limb_map[i].map, NULL);
@@ -222,31 +401,12 @@ enum arcan_ffunc_rv arcan_vr_ffunc FFUNC_HEAD
 	}
 
 	if (cmd == FFUNC_POLL){
-		for (size_t i = 0; i < LIMB_LIM; i++){
-			if (!ctx->limb_map[i].map)
-				continue;
-
-/* see if there is a new sample */
-			uint32_t ts = atomic_load(&vr->limbs[i].timestamp);
-			if (ts == ctx->limb_map[i].ts)
-				continue;
-
-			debug_print(2, "limb %zu updated - %"PRIu32, i, ts);
-			struct vr_limb vl = vr->limbs[i];
-
-/* there is, and it verified (failure assumes it is being updated) so using the
- * values is a disservice - the best way is probably to add it to a processing
- * queue and try/flush that queue before leaving */
-			uint16_t cs = subp_checksum((uint8_t*)&vl, sizeof(struct vr_limb)-2);
-			if (cs != atomic_load(&vr->limbs[i].data.checksum)){
-				debug_print(1, "limb %zu failed to validate\n", i);
-				continue;
-			}
-			apply_limb(&vl, &ctx->limb_map[i]);
-			if (i == NECK && ctx->limb_map[LIMB_LIM].map){
-				apply_limb(&vl, &ctx->limb_map[LIMB_LIM]);
-			}
-		}
+		uint64_t at_us = arcan_conductor_scanout_estimate();
+		ingest_samples(ctx, vr);
+
+		for (size_t i = 0; i < LIMB_LIM; i++)
+			if (ctx->limb_map[i].map && ctx->limb_map[i].pos_pending)
+				apply_sample(ctx, i, at_us);
 	}
 	else if (cmd == FFUNC_TICK){
 /* check allocation masks */
@@ -302,6 +462,63 @@ enum arcan_ffunc_rv arcan_vr_ffunc FFUNC_HEAD
 	return FRV_NOFRAME;
 }
 
+arcan_errc arcan_vr_latch(struct arcan_vr_ctx* ctx)
+{
+	if (!ctx || !ctx->connection || !ctx->connection->desc.aext.vr)
+		return ARCAN_ERRC_UNACCEPTED_STATE;
+
+/* all the eyes of a frame should see the same pose */
+	uint64_t at_us = arcan_conductor_scanout_estimate();
+	if (ctx->have_latch && ctx->latch_us == at_us)
+		return ARCAN_OK;
+
+	struct arcan_shmif_vr* vr = ctx->connection->desc.aext.vr;
+	TRAMP_GUARD(ARCAN_ERRC_UNACCEPTED_STATE, ctx->connection);
+	ingest_samples(ctx, vr);
+
+	for (size_t i = 0; i < LIMB_LIM; i++){
+		if (!ctx->limb_map[i].map || !ctx->limb_map[i].have_sample)
+			continue;
+
+		quat q = apply_sample(ctx, i, at_us);
+		if (i == NECK){
+			ctx->latched = q;
+			ctx->have_latch = true;
+		}
+	}
+	platform_fsrv_leave();
+
+	ctx->latch_us = at_us;
+	reproj.ctx = ctx;
+	return ARCAN_OK;
+}
+
+bool arcan_vr_reprojection(float* dst)
+{
+	struct arcan_vr_ctx* ctx = reproj.ctx;
+	quat delta = {.w = 1.0};
+
+	if (ctx && ctx->have_latch && ctx->connection &&
+		ctx->connection->desc.aext.vr && ctx->limb_map[NECK].map){
+		struct arcan_shmif_vr* vr = ctx->connection->desc.aext.vr;
+
+		TRAMP_GUARD(false, ctx->connection);
+			ingest_samples(ctx, vr);
+		platform_fsrv_leave();
+
+		delta = mul_quat(inv_quat(ctx->latched),
+			predict_orientation(ctx, &ctx->limb_map[NECK], ctx->latch_us));
+		reproj.identity = false;
+	}
+	else if (reproj.identity)
+		return false;
+	else
+		reproj.identity = true;
+
+	matr_quatf(norm_quat(delta), dst);
+	return true;
+}
+
 arcan_errc arcan_vr_setref(struct arcan_vr_ctx* ctx)
 {
 	if (!ctx || !ctx->connection)
@@ -76,6 +76,23 @@ arcan_errc arcan_vr_maplimb(
 struct vr_meta;
 arcan_errc arcan_vr_displaydata(struct arcan_vr_ctx*, struct vr_meta* dst);
 
+/*
+ * Update the mapped limbs with their latest samples, predicted to the
+ * expected scanout of the frame being composed. Called right before a
+ * camera that is bound to the context is used for a 3D pass, repeated
+ * calls for the same scanout (one per eye) keep the latched pose.
+ */
+arcan_errc arcan_vr_latch(struct arcan_vr_ctx* ctx);
+
+/*
+ * Write the rotation (4x4) from the neck orientation that was latched for
+ * the current frame to the latest prediction for the same scanout into
+ * [dst], for correcting the rendered eyes in the final composition. The
+ * identity is set if there is no latched context. Returns false if [dst]
+ * was left untouched as nothing has changed since the last call.
+ */
+bool arcan_vr_reprojection(float* dst);
+
 /*
  * mark the current position / orientation as the reference frame
  */
@@ -0,0 +1,163 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "arcan_workers.h"
+
+#ifndef ARCAN_WORKERS_LIMIT
+#define ARCAN_WORKERS_LIMIT 16
+#endif
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+
+	pthread_t threads[ARCAN_WORKERS_LIMIT];
+	size_t n_threads;
+
+/* current batch, (batch) increments for every dispatch so that a worker can
+ * tell a new batch from a spurious wakeup. (active) tracks workers that have
+ * picked up the batch and not yet returned, a new batch can't be set up until
+ * that reaches zero or a straggler could run an old job on new indices */
+	arcan_worker_job job;
+	void* tag;
+	size_t n_jobs;
+	_Atomic size_t next;
+	size_t left;
+	size_t active;
+	uint64_t batch;
+	bool shutdown;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER
+};
+
+/* grab indices until the batch is exhausted, return the number processed */
+static size_t run_batch(arcan_worker_job job, void* tag, size_t n)
+{
+	size_t count = 0;
+
+	for(;;){
+		size_t i = atomic_fetch_add(&pool.next, 1);
+		if (i >= n)
+			break;
+		job(tag, i);
+		count++;
+	}
+
+	return count;
+}
+
+static void* worker(void* arg)
+{
+	uint64_t seen = 0;
+
+	pthread_mutex_lock(&pool.lock);
+	for(;;){
+		while (!pool.shutdown && pool.batch == seen)
+			pthread_cond_wait(&pool.wake, &pool.lock);
+
+		if (pool.shutdown)
+			break;
+
+		seen = pool.batch;
+		pool.active++;
+		arcan_worker_job job = pool.job;
+		void* tag = pool.tag;
+		size_t n = pool.n_jobs;
+		pthread_mutex_unlock(&pool.lock);
+
+		size_t count = run_batch(job, tag, n);
+
+		pthread_mutex_lock(&pool.lock);
+		pool.left -= count;
+		pool.active--;
+		if (!pool.left && !pool.active)
+			pthread_cond_broadcast(&pool.done);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return NULL;
+}
+
+size_t arcan_workers_init(size_t n)
+{
+	if (pool.n_threads || !n)
+		return pool.n_threads;
+
+	if (n > ARCAN_WORKERS_LIMIT)
+		n = ARCAN_WORKERS_LIMIT;
+
+	for (size_t i = 0; i < n; i++){
+		if (0 != pthread_create(&pool.threads[i], NULL, worker, NULL))
+			break;
+		pool.n_threads++;
+	}
+
+	return pool.n_threads;
+}
+
+size_t arcan_workers_count()
+{
+	return pool.n_threads;
+}
+
+void arcan_workers_dispatch(arcan_worker_job job, void* tag, size_t n)
+{
+	if (!n)
+		return;
+
+/* no point waking anyone up for a single job */
+	if (!pool.n_threads || n == 1){
+		for (size_t i = 0; i < n; i++)
+			job(tag, i);
+		return;
+	}
+
+	pthread_mutex_lock(&pool.lock);
+		while (pool.active)
+			pthread_cond_wait(&pool.done, &pool.lock);
+
+		pool.job = job;
+		pool.tag = tag;
+		pool.n_jobs = n;
+		pool.left = n;
+		atomic_store(&pool.next, 0);
+		pool.batch++;
+		pthread_cond_broadcast(&pool.wake);
+	pthread_mutex_unlock(&pool.lock);
+
+	size_t count = run_batch(job, tag, n);
+
+	pthread_mutex_lock(&pool.lock);
+	pool.left -= count;
+	while (pool.left || pool.active)
+		pthread_cond_wait(&pool.done, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+void arcan_workers_shutdown()
+{
+	if (!pool.n_threads)
+		return;
+
+	pthread_mutex_lock(&pool.lock);
+		pool.shutdown = true;
+		pthread_cond_broadcast(&pool.wake);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (size_t i = 0; i < pool.n_threads; i++)
+		pthread_join(pool.threads[i], NULL);
+
+	pool.n_threads = 0;
+	pool.shutdown = false;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Small fixed-size pool of worker threads for fork/join style
+ * batches of independent CPU jobs (e.g. rendertarget preparation). Jobs are
+ * not allowed to touch the scripting VM or the graphics layer.
+ */
+#ifndef HAVE_ARCAN_WORKERS
+#define HAVE_ARCAN_WORKERS
+
+typedef void (*arcan_worker_job)(void* tag, size_t index);
+
+/*
+ * Spawn [n] worker threads, calling this multiple times is permitted but
+ * only the first successful call has any effect. Returns the number of
+ * threads that are available for dispatch.
+ */
+size_t arcan_workers_init(size_t n);
+
+/*
+ * Number of workers currently running (0 if the pool is disabled)
+ */
+size_t arcan_workers_count();
+
+/*
+ * Run job(tag, i) for i in 0 .. n-1 and block until all of them have
+ * finished. The calling thread participates in processing, so this works
+ * (serially) even when the pool has not been initialized. The order in which
+ * indices are processed is undefined, each job should write to its own slot.
+ */
+void arcan_workers_dispatch(arcan_worker_job job, void* tag, size_t n);
+
+/*
+ * Join and release all workers.
+ */
+void arcan_workers_shutdown();
+
+#endif
@@ -63,6 +63,10 @@ int show_use(struct arcan_shmif_cont* cont, const char* msg)
 		" Acceped pdf arguments:\n"
 		"   key   \t   value   \t   description\n"
 		"---------\t-----------\t-----------------\n"
+		" file    \t path      \t one-shot open file >path< for input \n"
+		" workers \t n         \t number of render threads (default: cores, max 8)\n"
+		" cache   \t mb        \t memory for rendered pages (default: 256)\n"
+		"---------\t-----------\t-----------------\n"
 		"\n"
 #endif
 #ifdef HAVE_PROBE
@@ -71,6 +75,13 @@ int show_use(struct arcan_shmif_cont* cont, const char* msg)
 		"---------\t-----------\t-----------------\n"
 		" file    \t path      \t one-shot open file >path< for input \n"
 		" format  \t type      \t set output format (mime, long, >short<)\n"
+		" batch   \t           \t probe and thumbnail many files, results as messages\n"
+		"         \t           \t and an atlas of thumbnails in the segment\n"
+		" dir     \t path      \t (batch) all regular files in >path<, or a received\n"
+		"         \t           \t directory descriptor if neither dir nor list is set\n"
+		" list    \t path      \t (batch) newline separated list of files in >path<\n"
+		" workers \t n         \t (batch) number of probe threads (default: cores, max 16)\n"
+		" thumb   \t WxH       \t (batch) atlas cell size, 0 to disable (default: 128x128)\n"
 		"---------\t-----------\t-----------------\n"
 		"\n"
 #endif
@@ -78,6 +89,10 @@ int show_use(struct arcan_shmif_cont* cont, const char* msg)
 		"  key    \t   value   \t   description\n"
 		"---------\t-----------\t-----------------\n"
 		" file    \t path      \t one-shot open file >path< for input \n"
+#ifdef HAVE_IMG_STREAM
+		" stream  \t           \t always use the streaming jpeg/png decoder\n"
+		" maxmem  \t mb        \t stream sources larger than this (default: 128)\n"
+#endif
 		"---------\t-----------\t-----------------\n"
 		"\n"
 		" Accepted text arguments:\n"
@@ -85,6 +100,13 @@ int show_use(struct arcan_shmif_cont* cont, const char* msg)
 		"---------\t-----------\t-----------------\n"
 		" file    \t path      \t try to open file path for playback \n"
 		" view    \t viewmode  \t (ascii, >utf8<, hex) set default view\n"
+		" follow  \t           \t start at the end and track appended data\n"
+		"\n"
+		" Accepted 3d arguments:\n"
+		"   key   \t   value   \t   description\n"
+		"---------\t-----------\t-----------------\n"
+		" file    \t path      \t one-shot open file >path< (.obj) for input\n"
+		" lods    \t 1..8      \t levels of detail, including the full (default: 4)\n"
 		"\n"
 		"Accepted media arguments:\n"
 		"   key   \t   value   \t   description\n"
@@ -93,6 +115,7 @@ int show_use(struct arcan_shmif_cont* cont, const char* msg)
 		" fd      \t file-no   \t use inherited descriptor for playback source\n"
 		" pos     \t 0..1      \t set the relative starting position \n"
 		" noaudio \t           \t disable the audio output entirely \n"
+		" hwdec   \t [method]  \t hardware decode (any, vaapi, ...), output as dma-buf\n"
 		" stream  \t url       \t attempt to open URL for streaming input \n"
 		" capture \t           \t try to open a capture device\n"
 		" device  \t number    \t find capture device with specific index\n"
@@ -104,6 +127,11 @@ int show_use(struct arcan_shmif_cont* cont, const char* msg)
 		"---------\t-----------\t----------------\n");
 	uvc_append_help(stdout);
 	fprintf(stdout,
+#endif
+#ifdef HAVE_V4L2
+		"---------\t-----------\t----------------\n");
+	v4l2_append_help(stdout);
+	fprintf(stdout,
 #endif
 		"---------\t-----------\t----------------\n"
 	);
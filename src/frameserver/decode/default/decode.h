@@ -2,6 +2,7 @@
 int show_use(struct arcan_shmif_cont* cont, const char* msg);
 
 void uvc_append_help(FILE* out);
+void v4l2_append_help(FILE* out);
 
 /* request that the server-side prove a bchunk-transfer with a
  * file descriptor to use */
@@ -1,12 +1,660 @@
 #include <arcan_shmif.h>
 #include <arcan_shmif_sub.h>
+#include <math.h>
+#include <float.h>
+#include <inttypes.h>
 
 #include "decode.h"
 
 #define TINYOBJ_LOADER_C_IMPLEMENTATION
 #include "parsers/tinyobj_loader_c.h"
 
-static int process_obj(struct arcan_shmif_cont* C, char* buf, size_t buf_sz)
+/* levels of detail to generate by default, including the full one */
+#define DEFAULT_LODS 4
+
+/* a coarse level that doesn't remove at least this share of triangles from
+ * the full one is not worth sending */
+#define LOD_MIN_REDUCTION 0.75
+
+/* the coarsest level clusters vertices on a grid of this many cells along
+ * the longest side of the bounding box, each finer level doubles it */
+#define LOD_BASE_CELLS 8
+
+/* width of the video buffer the packed mesh is placed in, height follows */
+#define MESH_BUFFER_W 2048
+
+struct vertex {
+	float pos[3];
+	float nrm[3];
+	float uv[2];
+};
+
+struct level {
+	uint32_t* indices;
+	size_t n_indices;
+
+/* vertices used by this and all coarser levels, they are sorted first */
+	size_t n_vertices;
+	float error;
+
+	struct shmif_mesh_meshlet* meshlets;
+	size_t n_meshlets;
+};
+
+struct mesh {
+	struct vertex* verts;
+	size_t n_verts;
+
+	bool has_uv;
+	bool uv_unorm;
+	float bbmin[3];
+	float bbmax[3];
+
+	struct level levels[SHMIF_MESH_LODLIM];
+	size_t n_levels;
+
+	size_t stride;
+	uint8_t index_size;
+};
+
+static void free_mesh(struct mesh* M)
+{
+	for (size_t i = 0; i < M->n_levels; i++){
+		free(M->levels[i].indices);
+		free(M->levels[i].meshlets);
+	}
+
+	free(M->verts);
+	*M = (struct mesh){0};
+}
+
+static size_t table_size(size_t n)
+{
+	size_t sz = 1024;
+	while (sz < n * 2)
+		sz <<= 1;
+	return sz;
+}
+
+static uint64_t hash_key(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdull;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ull;
+	k ^= k >> 33;
+	return k;
+}
+
+static bool valid_index(int ind, unsigned lim)
+{
+	return ind >= 0 && (unsigned) ind < lim;
+}
+
+/* obj indexes position, normal and texture coordinate separately, every used
+ * combination becomes one vertex */
+static bool unify_vertices(
+	tinyobj_attrib_t* attrib, struct mesh* M, uint32_t** out, size_t* n_out)
+{
+	size_t n_fv = attrib->num_faces;
+	size_t tbl_sz = table_size(n_fv);
+	uint32_t* tbl = malloc(tbl_sz * sizeof(uint32_t));
+	int (*keys)[3] = malloc(n_fv * sizeof(int[3]));
+	uint32_t* indices = malloc(n_fv * sizeof(uint32_t));
+	M->verts = malloc(n_fv * sizeof(struct vertex));
+
+	if (!tbl || !keys || !indices || !M->verts){
+		free(tbl);
+		free(keys);
+		free(indices);
+		return false;
+	}
+
+	memset(tbl, 0xff, tbl_sz * sizeof(uint32_t));
+	bool has_nrm = false;
+	size_t n_ind = 0;
+	size_t ofs = 0;
+
+	for (size_t f = 0; f < attrib->num_face_num_verts && ofs < n_fv; f++){
+		size_t nv = attrib->face_num_verts[f];
+		if (nv != 3 || ofs + nv > n_fv){
+			ofs += nv;
+			continue;
+		}
+
+		for (size_t i = 0; i < 3; i++){
+			tinyobj_vertex_index_t vi = attrib->faces[ofs + i];
+			int key[3] = {
+				vi.v_idx,
+				valid_index(vi.vn_idx, attrib->num_normals) ? vi.vn_idx : -1,
+				valid_index(vi.vt_idx, attrib->num_texcoords) ? vi.vt_idx : -1
+			};
+
+			if (!valid_index(key[0], attrib->num_vertices)){
+				n_ind -= i;
+				break;
+			}
+
+			uint64_t h = hash_key(
+				(uint64_t) key[0] ^ ((uint64_t)(uint32_t) key[1] << 21) ^
+				((uint64_t)(uint32_t) key[2] << 42));
+			size_t slot = h & (tbl_sz - 1);
+
+			while (tbl[slot] != UINT32_MAX &&
+				memcmp(keys[tbl[slot]], key, sizeof(key)) != 0)
+				slot = (slot + 1) & (tbl_sz - 1);
+
+			if (tbl[slot] == UINT32_MAX){
+				uint32_t nvi = M->n_verts++;
+				struct vertex* v = &M->verts[nvi];
+				memcpy(keys[nvi], key, sizeof(key));
+				memcpy(v->pos, &attrib->vertices[key[0] * 3], sizeof(float) * 3);
+				memset(v->nrm, '\0', sizeof(v->nrm));
+				memset(v->uv, '\0', sizeof(v->uv));
+
+				if (key[1] != -1){
+					memcpy(v->nrm, &attrib->normals[key[1] * 3], sizeof(float) * 3);
+					has_nrm = true;
+				}
+
+				if (key[2] != -1){
+					memcpy(v->uv, &attrib->texcoords[key[2] * 2], sizeof(float) * 2);
+					M->has_uv = true;
+				}
+				tbl[slot] = nvi;
+			}
+
+			indices[n_ind++] = tbl[slot];
+		}
+
+		ofs += nv;
+	}
+
+	free(tbl);
+	free(keys);
+
+/* without normals, accumulate the face normals (weighted by area through the
+ * length of the cross product) for shared vertices */
+	if (!has_nrm){
+		for (size_t i = 0; i < n_ind; i += 3){
+			float* a = M->verts[indices[i+0]].pos;
+			float* b = M->verts[indices[i+1]].pos;
+			float* c = M->verts[indices[i+2]].pos;
+			float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+			float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+			float n[3] = {
+				e1[1] * e2[2] - e1[2] * e2[1],
+				e1[2] * e2[0] - e1[0] * e2[2],
+				e1[0] * e2[1] - e1[1] * e2[0]
+			};
+			for (size_t j = 0; j < 3; j++){
+				float* dst = M->verts[indices[i+j]].nrm;
+				dst[0] += n[0];
+				dst[1] += n[1];
+				dst[2] += n[2];
+			}
+		}
+	}
+
+	for (size_t i = 0; i < M->n_verts; i++){
+		float* n = M->verts[i].nrm;
+		float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (len > FLT_EPSILON){
+			n[0] /= len;
+			n[1] /= len;
+			n[2] /= len;
+		}
+	}
+
+	*out = indices;
+	*n_out = n_ind;
+	return n_ind > 0;
+}
+
+static void mesh_bounds(struct mesh* M)
+{
+	M->uv_unorm = true;
+	for (size_t i = 0; i < 3; i++){
+		M->bbmin[i] = FLT_MAX;
+		M->bbmax[i] = -FLT_MAX;
+	}
+
+	for (size_t i = 0; i < M->n_verts; i++){
+		struct vertex* v = &M->verts[i];
+		for (size_t j = 0; j < 3; j++){
+			M->bbmin[j] = v->pos[j] < M->bbmin[j] ? v->pos[j] : M->bbmin[j];
+			M->bbmax[j] = v->pos[j] > M->bbmax[j] ? v->pos[j] : M->bbmax[j];
+		}
+		if (v->uv[0] < 0.0 || v->uv[0] > 1.0 || v->uv[1] < 0.0 || v->uv[1] > 1.0)
+			M->uv_unorm = false;
+	}
+}
+
+/* merge all vertices that fall within the same grid cell into the first one
+ * of them and drop the triangles that collapse, [rep] is scratch */
+static bool cluster_level(struct mesh* M, const uint32_t* indices,
+	size_t n_ind, size_t cells, uint32_t* rep, struct level* L)
+{
+	float ext = 0;
+	for (size_t i = 0; i < 3; i++){
+		float d = M->bbmax[i] - M->bbmin[i];
+		ext = d > ext ? d : ext;
+	}
+
+	if (ext <= FLT_EPSILON)
+		return false;
+
+	size_t tbl_sz = table_size(M->n_verts);
+	uint64_t* keys = malloc(tbl_sz * sizeof(uint64_t));
+	uint32_t* vals = malloc(tbl_sz * sizeof(uint32_t));
+	L->indices = malloc(n_ind * sizeof(uint32_t));
+
+	if (!keys || !vals || !L->indices){
+		free(keys);
+		free(vals);
+		free(L->indices);
+		L->indices = NULL;
+		return false;
+	}
+
+	memset(vals, 0xff, tbl_sz * sizeof(uint32_t));
+	float scale = (float) cells / ext;
+
+	for (size_t i = 0; i < M->n_verts; i++){
+		uint64_t cell[3];
+		for (size_t j = 0; j < 3; j++){
+			float pos = (M->verts[i].pos[j] - M->bbmin[j]) * scale;
+			cell[j] = pos < 0 ? 0 : (pos > cells ? cells : (uint64_t) pos);
+		}
+
+		uint64_t key = cell[0] | (cell[1] << 21) | (cell[2] << 42);
+		size_t slot = hash_key(key) & (tbl_sz - 1);
+		while (vals[slot] != UINT32_MAX && keys[slot] != key)
+			slot = (slot + 1) & (tbl_sz - 1);
+
+		if (vals[slot] == UINT32_MAX){
+			keys[slot] = key;
+			vals[slot] = i;
+		}
+		rep[i] = vals[slot];
+	}
+
+	free(keys);
+	free(vals);
+
+	for (size_t i = 0; i < n_ind; i += 3){
+		uint32_t a = rep[indices[i]], b = rep[indices[i+1]], c = rep[indices[i+2]];
+		if (a == b || b == c || a == c)
+			continue;
+
+		L->indices[L->n_indices++] = a;
+		L->indices[L->n_indices++] = b;
+		L->indices[L->n_indices++] = c;
+	}
+
+	L->error = 1.0 / (float) cells;
+	return true;
+}
+
+/* sort the vertices by the coarsest level that uses them so that every level
+ * only needs a prefix of the vertex buffer, then renumber the indices */
+static bool order_vertices(struct mesh* M)
+{
+	uint8_t* rank = malloc(M->n_verts);
+	uint32_t* remap = malloc(M->n_verts * sizeof(uint32_t));
+	struct vertex* verts = malloc(M->n_verts * sizeof(struct vertex));
+
+	if (!rank || !remap || !verts){
+		free(rank);
+		free(remap);
+		free(verts);
+		return false;
+	}
+
+	memset(rank, M->n_levels - 1, M->n_verts);
+	for (size_t l = M->n_levels - 1; l > 0; l--){
+		struct level* L = &M->levels[l - 1];
+		for (size_t i = 0; i < L->n_indices; i++)
+			rank[L->indices[i]] = l - 1;
+	}
+
+	size_t pos = 0;
+	for (size_t l = 0; l < M->n_levels; l++){
+		for (size_t i = 0; i < M->n_verts; i++){
+			if (rank[i] == l){
+				remap[i] = pos;
+				verts[pos++] = M->verts[i];
+			}
+		}
+		M->levels[l].n_vertices = pos;
+
+		for (size_t i = 0; i < M->levels[l].n_indices; i++)
+			M->levels[l].indices[i] = remap[M->levels[l].indices[i]];
+	}
+
+	free(M->verts);
+	M->verts = verts;
+	free(rank);
+	free(remap);
+	return true;
+}
+
+static bool close_meshlet(struct level* L, struct mesh* M,
+	size_t* cap, uint32_t start, uint32_t end, uint32_t* mv, size_t nmv)
+{
+	if (L->n_meshlets == *cap){
+		size_t ncap = *cap ? *cap * 2 : 64;
+		void* tmp = realloc(L->meshlets, ncap * sizeof(struct shmif_mesh_meshlet));
+		if (!tmp)
+			return false;
+		L->meshlets = tmp;
+		*cap = ncap;
+	}
+
+	float mn[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+	float mx[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+	for (size_t i = 0; i < nmv; i++){
+		float* p = M->verts[mv[i]].pos;
+		for (size_t j = 0; j < 3; j++){
+			mn[j] = p[j] < mn[j] ? p[j] : mn[j];
+			mx[j] = p[j] > mx[j] ? p[j] : mx[j];
+		}
+	}
+
+	struct shmif_mesh_meshlet* out = &L->meshlets[L->n_meshlets++];
+	*out = (struct shmif_mesh_meshlet){
+		.index_ofs = start,
+		.n_indices = end - start,
+		.center = {(mn[0] + mx[0]) * 0.5, (mn[1] + mx[1]) * 0.5, (mn[2] + mx[2]) * 0.5}
+	};
+
+	float r2 = 0;
+	for (size_t i = 0; i < nmv; i++){
+		float* p = M->verts[mv[i]].pos;
+		float d[3] = {p[0] - out->center[0], p[1] - out->center[1], p[2] - out->center[2]};
+		float dd = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+		r2 = dd > r2 ? dd : r2;
+	}
+	out->radius = sqrtf(r2);
+
+	return true;
+}
+
+/* split the triangles of a level in order into runs that stay within the
+ * meshlet vertex / triangle limits, [base] is where the level starts in the
+ * shared index buffer and [stamp] is per-vertex scratch */
+static bool build_meshlets(
+	struct mesh* M, struct level* L, uint32_t base, uint32_t* stamp)
+{
+	uint32_t mv[SHMIF_MESH_MESHLET_VERTS];
+	size_t nmv = 0, ntri = 0, cap = 0;
+	uint32_t start = 0, id = 1;
+
+	memset(stamp, '\0', M->n_verts * sizeof(uint32_t));
+
+	for (size_t i = 0; i < L->n_indices; i += 3){
+		size_t fresh = 0;
+		for (size_t j = 0; j < 3; j++)
+			fresh += stamp[L->indices[i+j]] != id;
+
+		if (nmv + fresh > SHMIF_MESH_MESHLET_VERTS ||
+			ntri == SHMIF_MESH_MESHLET_TRIS){
+			if (!close_meshlet(L, M, &cap, base + start, base + i, mv, nmv))
+				return false;
+			start = i;
+			nmv = ntri = 0;
+			id++;
+		}
+
+		for (size_t j = 0; j < 3; j++){
+			uint32_t v = L->indices[i+j];
+			if (stamp[v] != id){
+				stamp[v] = id;
+				mv[nmv++] = v;
+			}
+		}
+		ntri++;
+	}
+
+	if (ntri)
+		return close_meshlet(L, M, &cap, base + start, base + L->n_indices, mv, nmv);
+
+	return true;
+}
+
+static bool build_mesh(tinyobj_attrib_t* attrib, struct mesh* M, size_t lods)
+{
+	uint32_t* full;
+	size_t n_full;
+	if (!unify_vertices(attrib, M, &full, &n_full))
+		return false;
+
+	mesh_bounds(M);
+	uint32_t* scratch = malloc(M->n_verts * sizeof(uint32_t));
+	if (!scratch){
+		free(full);
+		return false;
+	}
+
+/* coarse to fine, only keep levels that cut enough and add detail over the
+ * previous one */
+	size_t last = 0;
+	for (size_t i = 0; i + 1 < lods; i++){
+		struct level* L = &M->levels[M->n_levels];
+		if (!cluster_level(M, full, n_full, LOD_BASE_CELLS << i, scratch, L))
+			break;
+
+		if (!L->n_indices || L->n_indices <= last ||
+			L->n_indices >= n_full * LOD_MIN_REDUCTION){
+			free(L->indices);
+			*L = (struct level){0};
+			continue;
+		}
+
+		last = L->n_indices;
+		M->n_levels++;
+	}
+
+	M->levels[M->n_levels++] = (struct level){
+		.indices = full,
+		.n_indices = n_full
+	};
+
+	bool ok = order_vertices(M);
+	uint32_t base = 0;
+	for (size_t i = 0; i < M->n_levels && ok; i++){
+		ok = build_meshlets(M, &M->levels[i], base, scratch);
+		base += M->levels[i].n_indices;
+	}
+	free(scratch);
+
+/* normals as snorm8, texture coordinates as unorm16 when they are in 0..1 */
+	M->index_size = M->n_verts <= 65536 ? 2 : 4;
+	M->stride = sizeof(float) * 3 + 4;
+	if (M->has_uv)
+		M->stride += M->uv_unorm ? 4 : sizeof(float) * 2;
+
+	return ok;
+}
+
+static size_t align4(size_t v)
+{
+	return (v + 3) & ~(size_t)3;
+}
+
+/* pack the first [n] levels, returns the number of bytes written to [dst] or
+ * needed if [dst] is NULL */
+static size_t pack_mesh(struct mesh* M, size_t n, uint8_t* dst)
+{
+	size_t n_ind = 0, n_meshlets = 0;
+	for (size_t i = 0; i < n; i++){
+		n_ind += M->levels[i].n_indices;
+		n_meshlets += M->levels[i].n_meshlets;
+	}
+	size_t n_verts = M->levels[n - 1].n_vertices;
+
+	size_t ofs_lods = sizeof(struct shmif_mesh_header);
+	size_t ofs_meshlets = ofs_lods + n * sizeof(struct shmif_mesh_lod);
+	size_t ofs_indices = ofs_meshlets + n_meshlets * sizeof(struct shmif_mesh_meshlet);
+	size_t ofs_vertices = align4(ofs_indices + n_ind * M->index_size);
+	size_t total = ofs_vertices + n_verts * M->stride;
+
+	if (!dst)
+		return total;
+
+	struct shmif_mesh_header hdr = {
+		.magic = SHMIF_MESH_MAGIC,
+		.version = SHMIF_MESH_VERSION,
+		.index_size = M->index_size,
+		.n_lods = n,
+		.stride = M->stride,
+		.n_vertices = n_verts,
+		.n_indices = n_ind,
+		.n_meshlets = n_meshlets,
+		.ofs_lods = ofs_lods,
+		.ofs_meshlets = ofs_meshlets,
+		.ofs_indices = ofs_indices,
+		.ofs_vertices = ofs_vertices,
+		.data_sz = total,
+		.bbmin = {M->bbmin[0], M->bbmin[1], M->bbmin[2]},
+		.bbmax = {M->bbmax[0], M->bbmax[1], M->bbmax[2]},
+		.attr = {
+			[SHMIF_MESH_POSITION] = {
+				.fmt = SHMIF_MESH_F32, .components = 3, .offset = 0},
+			[SHMIF_MESH_NORMAL] = {
+				.fmt = SHMIF_MESH_S8N, .components = 4, .offset = 12}
+		}
+	};
+
+	if (M->has_uv){
+		hdr.attr[SHMIF_MESH_TXCOS] = (struct shmif_mesh_attrib){
+			.fmt = M->uv_unorm ? SHMIF_MESH_U16N : SHMIF_MESH_F32,
+			.components = 2,
+			.offset = 16
+		};
+	}
+	memcpy(dst, &hdr, sizeof(hdr));
+
+	size_t iofs = 0, mofs = 0;
+	struct shmif_mesh_lod* lods = (struct shmif_mesh_lod*)(dst + ofs_lods);
+	uint8_t* meshlets = dst + ofs_meshlets;
+	uint8_t* indices = dst + ofs_indices;
+
+	for (size_t i = 0; i < n; i++){
+		struct level* L = &M->levels[i];
+		lods[i] = (struct shmif_mesh_lod){
+			.index_ofs = iofs,
+			.n_indices = L->n_indices,
+			.n_vertices = L->n_vertices,
+			.meshlet_ofs = mofs,
+			.n_meshlets = L->n_meshlets,
+			.error = L->error
+		};
+
+		memcpy(meshlets, L->meshlets, L->n_meshlets * sizeof(struct shmif_mesh_meshlet));
+		meshlets += L->n_meshlets * sizeof(struct shmif_mesh_meshlet);
+		mofs += L->n_meshlets;
+
+		if (M->index_size == 2){
+			uint16_t* out = (uint16_t*) indices;
+			for (size_t j = 0; j < L->n_indices; j++)
+				out[j] = L->indices[j];
+		}
+		else
+			memcpy(indices, L->indices, L->n_indices * sizeof(uint32_t));
+
+		indices += L->n_indices * M->index_size;
+		iofs += L->n_indices;
+	}
+
+	uint8_t* vout = dst + ofs_vertices;
+	for (size_t i = 0; i < n_verts; i++, vout += M->stride){
+		struct vertex* v = &M->verts[i];
+		memcpy(vout, v->pos, sizeof(float) * 3);
+
+		int8_t* nrm = (int8_t*)(vout + 12);
+		for (size_t j = 0; j < 3; j++)
+			nrm[j] = (int8_t) lrintf(v->nrm[j] * 127.0);
+		nrm[3] = 0;
+
+		if (!M->has_uv)
+			continue;
+
+		if (M->uv_unorm){
+			uint16_t* uv = (uint16_t*)(vout + 16);
+			uv[0] = (uint16_t) lrintf(v->uv[0] * 65535.0);
+			uv[1] = (uint16_t) lrintf(v->uv[1] * 65535.0);
+		}
+		else
+			memcpy(vout + 16, v->uv, sizeof(float) * 2);
+	}
+
+	return total;
+}
+
+static bool write_mesh(struct mesh* M, int fd)
+{
+	size_t sz = pack_mesh(M, M->n_levels, NULL);
+	uint8_t* buf = malloc(sz);
+	if (!buf)
+		return false;
+
+	pack_mesh(M, M->n_levels, buf);
+
+	size_t ofs = 0;
+	while (ofs < sz){
+		ssize_t nw = write(fd, buf + ofs, sz - ofs);
+		if (nw == -1){
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			break;
+		}
+		ofs += nw;
+	}
+
+	free(buf);
+	return ofs == sz;
+}
+
+/* send the levels one at a time from coarse to fine, each as a complete
+ * container, so the consumer has something to show while the rest comes */
+static bool stream_mesh(struct arcan_shmif_cont* C, struct mesh* M, uint32_t id)
+{
+	size_t total = pack_mesh(M, M->n_levels, NULL);
+	size_t row = MESH_BUFFER_W * sizeof(shmif_pixel);
+	size_t h = (total + row - 1) / row;
+
+	if (h > PP_SHMPAGE_MAXH || total > PP_SHMPAGE_MAXSZ){
+		LOG("mesh too large (%zu b)\n", total);
+		return false;
+	}
+
+	if (!arcan_shmif_resize_ext(C, MESH_BUFFER_W, h,
+		(struct shmif_resize_ext){.meta = SHMIF_META_VOBJ})){
+		LOG("couldn't resize to fit mesh (%zu b)\n", total);
+		return false;
+	}
+
+	struct arcan_shmif_vector* vec = arcan_shmif_substruct(C, SHMIF_META_VOBJ).vector;
+	if (!vec){
+		LOG("vector transfer (TARGET_ALLOWVECTOR) not permitted\n");
+		return false;
+	}
+
+	for (size_t i = 1; i <= M->n_levels; i++){
+		vec->data_sz = pack_mesh(M, i, (uint8_t*) C->vidb);
+		vec->mesh_id = id;
+		arcan_shmif_signal(C, SHMIF_SIGVID);
+	}
+
+	LOG("status=mesh:id=%"PRIu32":lods=%zu:vertices=%zu:indices=%zu:size=%zu\n",
+		id, M->n_levels, M->n_verts, M->levels[M->n_levels - 1].n_indices, total);
+
+	return true;
+}
+
+static bool process_obj(struct arcan_shmif_cont* C,
+	struct mesh* M, size_t lods, uint32_t id, char* buf, size_t buf_sz)
 {
 	tinyobj_attrib_t attrib;
 	tinyobj_shape_t* shapes = NULL;
@@ -17,20 +665,42 @@ static int process_obj(struct arcan_shmif_cont* C, char* buf, size_t buf_sz)
 	int rv = tinyobj_parse_obj(&attrib, &shapes, &num_shapes,
 		&materials, &num_materials, buf, buf_sz, 1 /* triangulate */);
 
-/* obj is 'trivial' enough that it is better to unpack/load in the engine/lua
- * level, but have some obj support here in order for basic testing - the main
- * target here is still cgltf */
-
-/* tinyobj_parse_mtl_file */
-/* also don't have a way to communicate animations */
-
+/* tinyobj_parse_mtl_file, also don't have a way to communicate animations,
+ * the main target here is still cgltf */
 	free(buf);
 	if (rv != TINYOBJ_SUCCESS)
-		return EXIT_FAILURE;
+		return false;
+
+	free_mesh(M);
+	bool ok = build_mesh(&attrib, M, lods);
 
 	tinyobj_attrib_free(&attrib);
-/* tinyobj_materials_free */
-	return EXIT_SUCCESS;
+	tinyobj_shapes_free(shapes, num_shapes);
+	tinyobj_materials_free(materials, num_materials);
+
+	return ok && stream_mesh(C, M, id);
+}
+
+static char* read_file(FILE* fpek, size_t* out_sz)
+{
+	*out_sz = 0;
+	fseek(fpek, 0, SEEK_END);
+	long pos = ftell(fpek);
+	fseek(fpek, 0, SEEK_SET);
+	if (pos <= 0)
+		return NULL;
+
+	char* buf = malloc(pos);
+	if (!buf)
+		return NULL;
+
+	if (1 != fread(buf, pos, 1, fpek)){
+		free(buf);
+		return NULL;
+	}
+
+	*out_sz = pos;
+	return buf;
 }
 
 int decode_3d(struct arcan_shmif_cont* cont, struct arg_arr* args)
@@ -40,6 +710,13 @@ int decode_3d(struct arcan_shmif_cont* cont, struct arg_arr* args)
 	size_t inbuf_sz = 0;
 	char* inbuf = NULL;
 
+	size_t lods = DEFAULT_LODS;
+	const char* val;
+	if (arg_lookup(args, "lods", 0, &val) && val){
+		lods = strtoul(val, NULL, 10);
+		lods = lods < 1 ? 1 : (lods > SHMIF_MESH_LODLIM ? SHMIF_MESH_LODLIM : lods);
+	}
+
 /* two modes we want to support, 'single file' once mode and as a decoder
  * daemon that gets fed files repeatedly in order to save setup */
 	if (arg_lookup(args, "file", 0, &file)){
@@ -51,51 +728,67 @@ int decode_3d(struct arcan_shmif_cont* cont, struct arg_arr* args)
 		}
 	}
 	else {
-		int fd = wait_for_file(cont, "obj;gltf", NULL);
+		int fd = wait_for_file(cont, "obj", NULL);
 		if (-1 == fd){
 			return EXIT_FAILURE;
 		}
 		fpek = fdopen(fd, "r");
 	}
 
-	fseek(fpek, 0, SEEK_END);
-	long pos = ftell(fpek);
-	fseek(fpek, 0, SEEK_SET);
-	if (pos <= 0){
-		char buf[64];
-		snprintf(buf, sizeof(buf), "invalid length (%ld) in %s", pos, file);
-		fclose(fpek);
-		return show_use(cont, buf);
-	}
-
 /* read the whole thing in memory, the catch 22 is that we need to parse
  * to know the reasonable size so we can set the context to that, but we
  * want to drop privileges before then, so need to do it in stages */
-	inbuf = malloc(pos);
-	if (!inbuf){
-		fclose(fpek);
-		return show_use(cont, "out of memory");
-	}
-
-	if (1 != fread(inbuf, pos, 1, fpek)){
-		fclose(fpek);
-		free(inbuf);
-		return show_use(cont, "couldn't load");
-	}
-
-	inbuf_sz = pos;
+	inbuf = read_file(fpek, &inbuf_sz);
 	fclose(fpek);
 
-	if (!inbuf_sz)
-		return show_use(cont, "no data in file");
+	if (!inbuf)
+		return show_use(cont, "couldn't load");
 
 /* need fuller shmif permissions here as new subsegments are used for
  * each additional 'surface' */
 	arcan_shmif_privsep(cont, "shmif", NULL, 0);
 
 /* assume .obj for now */
-	return process_obj(cont, inbuf, inbuf_sz);
+	struct mesh mesh = {0};
+	uint32_t id = 1;
+	if (!process_obj(cont, &mesh, lods, id, inbuf, inbuf_sz)){
+		free_mesh(&mesh);
+		return show_use(cont, "couldn't build mesh");
+	}
+
+/* stay around to write the packed form out (.amsh, can be loaded directly
+ * by add_3dmesh) or to take the next model */
+	arcan_event ev;
+	while (arcan_shmif_wait(cont, &ev)){
+		if (ev.category != EVENT_TARGET)
+			continue;
+
+		if (ev.tgt.kind == TARGET_COMMAND_EXIT)
+			break;
+
+		if (ev.tgt.kind == TARGET_COMMAND_BCHUNK_OUT){
+			int fd = arcan_shmif_dupfd(ev.tgt.ioevs[0].iv, -1, true);
+			if (-1 != fd){
+				if (!mesh.n_levels || !write_mesh(&mesh, fd))
+					LOG("couldn't write packed mesh\n");
+				close(fd);
+			}
+		}
+		else if (ev.tgt.kind == TARGET_COMMAND_BCHUNK_IN){
+			int fd = arcan_shmif_dupfd(ev.tgt.ioevs[0].iv, -1, true);
+			if (-1 == fd || !(fpek = fdopen(fd, "r"))){
+				if (-1 != fd)
+					close(fd);
+				continue;
+			}
+
+			inbuf = read_file(fpek, &inbuf_sz);
+			fclose(fpek);
+			if (inbuf && !process_obj(cont, &mesh, lods, ++id, inbuf, inbuf_sz))
+				LOG("couldn't build mesh\n");
+		}
+	}
 
-/* now we know the real unpack size, so resize to that */
+	free_mesh(&mesh);
 	return EXIT_SUCCESS;
 }
@@ -12,13 +12,10 @@
  * where a full-spec player is not needed - it's a data source and not
  * a player in itself.
  *
- * There are a number of 'good todos' here, the biggest one being to
- * try and either squeeze GL textures out of VLC directly, or at least
- * use that as transfer mechanism if we start with access to the gpu
- * (extract from shmif_initial).
- *
- * This could probably be done by exposing ourselves as a plugin to
- * vlc and set ourselves as the video output method.
+ * With libvlc >= 4 and the 'hwdec' argument, vlc renders into a GL
+ * context of ours instead and the result is passed as a dma-buf. The
+ * remaining 'good todo' is getting the raw decoder surfaces (multi-plane
+ * YUV) out directly, which would need us exposed as a vlc output plugin.
  */
 #include <stdlib.h>
 #include <stdio.h>
@@ -37,15 +34,26 @@
 
 #include <pthread.h>
 #include <kiss_fftr.h>
+#ifdef HAVE_VLC_GPU
+#define WANT_ARCAN_SHMIF_HELPER
+#endif
 #include <arcan_shmif.h>
 #include <arcan_tuisym.h>
 #include "frameserver.h"
 #include "decode.h"
 
+#ifdef HAVE_V4L2
+#include "v4l2_support.h"
+#endif
+
 #ifdef HAVE_UVC
 #include "uvc_support.h"
 #endif
 
+#ifdef HAVE_VLC_GPU
+#define GL_RGBA_FMT 0x1908
+#endif
+
 static struct {
 	libvlc_instance_t* vlc;
 	libvlc_media_player_t* player;
@@ -57,6 +65,18 @@ static struct {
 
 	volatile bool finished;
 	bool loop, force_paused;
+
+/* native rate of the audio track, the server resamples if it differs from
+ * the one it mixes at so vlc doesn't have to */
+	unsigned samplerate;
+
+#ifdef HAVE_VLC_GPU
+	struct {
+		bool active;
+		uintptr_t display, surface, context;
+		unsigned (*make_current)(uintptr_t, uintptr_t, uintptr_t, uintptr_t);
+	} gpu;
+#endif
 } decctx;
 
 /*
@@ -98,7 +118,8 @@ static unsigned video_setup(void** ctx, char* chroma, unsigned* width,
 	arcan_shmif_lock(&decctx.shmcont);
 	if (!arcan_shmif_resize_ext(&decctx.shmcont,
 		*width, *height, (struct shmif_resize_ext){
-			.abuf_sz = 16384, .abuf_cnt = 12, .vbuf_cnt = 1})){
+			.abuf_sz = 16384, .abuf_cnt = 12, .vbuf_cnt = 1,
+			.samplerate = decctx.samplerate})){
 		LOG("(decode) shmpage setup failed, "
 			"requested: (%d x %d)\n", *width, *height);
 		rv = 0;
@@ -208,7 +229,7 @@ static void generate_frame()
 			decctx.shmcont.addr->vpts = vptsc;
 
 			vptsc += 1000.0f / (
-				(double)(ARCAN_SHMIF_SAMPLERATE) / (double)smpl_wndw);
+				(double)(decctx.shmcont.samplerate) / (double)smpl_wndw);
 		}
 	}
 
@@ -227,7 +248,8 @@ static void audio_play(void *data,
 		arcan_shmif_lock(&decctx.shmcont);
 		arcan_shmif_resize_ext(&decctx.shmcont, AUD_VIS_HRES, 2,
 			(struct shmif_resize_ext){
-				.abuf_sz = AUD_VIS_HRES*2, .abuf_cnt = 4, .vbuf_cnt = 1
+				.abuf_sz = AUD_VIS_HRES*2, .abuf_cnt = 4, .vbuf_cnt = 1,
+				.samplerate = decctx.samplerate
 			}
 		);
 
@@ -302,6 +324,41 @@ static void on_context_reset(int op, void* tag)
 	}
 }
 
+/*
+ * Keep the samples in the native rate of the track and negotiate that with
+ * the server instead of having vlc resample. Should the server not go along,
+ * vlc gets the rate it did get and converts as before.
+ */
+static int audio_setup(void** opaque, char* format, unsigned* rate, unsigned* channels)
+{
+	memcpy(format, "S16N", 4);
+	*channels = ARCAN_SHMIF_ACHANNELS;
+
+	if (*rate < 8000 || *rate > 192000)
+		*rate = ARCAN_SHMIF_SAMPLERATE;
+
+	arcan_shmif_lock(&decctx.shmcont);
+	decctx.samplerate = *rate;
+	struct shmif_resize_ext ext = {
+		.abuf_sz = 16384, .abuf_cnt = 12, .vbuf_cnt = 1,
+		.samplerate = decctx.samplerate
+	};
+	if (decctx.fft_audio){
+		ext.abuf_sz = AUD_VIS_HRES * 2;
+		ext.abuf_cnt = 4;
+	}
+
+	if (arcan_shmif_resize_ext(&decctx.shmcont,
+		decctx.shmcont.w, decctx.shmcont.h, ext) && decctx.shmcont.samplerate)
+		*rate = decctx.samplerate = decctx.shmcont.samplerate;
+	else
+		*rate = decctx.samplerate = ARCAN_SHMIF_SAMPLERATE;
+	arcan_shmif_unlock(&decctx.shmcont);
+
+	LOG("(decode) audio: %u Hz\n", *rate);
+	return 0;
+}
+
 static void audio_flush()
 {
 	arcan_shmif_lock(&decctx.shmcont);
@@ -336,6 +393,113 @@ static void video_display(void* ctx, void* picture)
 	arcan_shmif_signalV();
 }
 
+#ifdef HAVE_VLC_GPU
+/*
+ * Hardware decoding path: vlc keeps the decoded surfaces (vaapi, ...) on the
+ * GPU, imports them into the GL context we provide and performs the colour
+ * conversion while drawing into the shmifext builtin rendertarget. That one is
+ * forwarded as a dma-buf, so the frame never passes through the CPU unless the
+ * server pushes us to readback.
+ *
+ * The context is created on the main thread but used by the vlc output thread,
+ * so it is explicitly bound / released around each use.
+ */
+static bool gpu_current(void* opaque, bool enter)
+{
+	if (!enter)
+		return decctx.gpu.make_current(decctx.gpu.display, 0, 0, 0);
+
+	if (!decctx.gpu.make_current(decctx.gpu.display,
+		decctx.gpu.surface, decctx.gpu.surface, decctx.gpu.context))
+		return false;
+
+	arcan_shmifext_bind(&decctx.shmcont);
+	return true;
+}
+
+static bool gpu_setup(struct arcan_shmif_cont* cont)
+{
+	struct arcan_shmifext_setup setup = arcan_shmifext_defaults(cont);
+	setup.builtin_fbo = 1;
+
+	enum shmifext_setup_status status;
+	if ((status = arcan_shmifext_setup(cont, setup)) != SHMIFEXT_OK){
+		LOG("(decode) hwdec: couldn't setup GPU context (%d)\n", status);
+		return false;
+	}
+
+	decctx.gpu.make_current = arcan_shmifext_lookup(cont, "eglMakeCurrent");
+	if (!decctx.gpu.make_current || !arcan_shmifext_egl_meta(cont,
+		&decctx.gpu.display, &decctx.gpu.surface, &decctx.gpu.context)){
+		LOG("(decode) hwdec: couldn't retrieve EGL context\n");
+		arcan_shmifext_drop(cont);
+		return false;
+	}
+
+	decctx.gpu.active = true;
+	gpu_current(NULL, false);
+	LOG("(decode) hwdec: GPU output ready, transfer: %s\n",
+		arcan_shmifext_isext(cont) == 1 ? "dma-buf" : "readback");
+	return true;
+}
+
+static bool gpu_vout_setup(void** opaque,
+	const libvlc_video_setup_device_cfg_t* cfg,
+	libvlc_video_setup_device_info_t* out)
+{
+	return true;
+}
+
+static void gpu_vout_cleanup(void* opaque)
+{
+}
+
+/* called with the context current */
+static bool gpu_vout_resize(void* opaque,
+	const libvlc_video_render_cfg_t* cfg, libvlc_video_output_cfg_t* out)
+{
+	decctx.got_video = true;
+
+	arcan_shmif_lock(&decctx.shmcont);
+	decctx.shmcont.hints |= SHMIF_RHINT_ORIGO_LL;
+	bool ok = arcan_shmif_resize_ext(&decctx.shmcont,
+		cfg->width, cfg->height, (struct shmif_resize_ext){
+			.abuf_sz = 16384, .abuf_cnt = 12, .vbuf_cnt = 1,
+			.samplerate = decctx.samplerate});
+	arcan_shmif_unlock(&decctx.shmcont);
+
+	if (!ok){
+		LOG("(decode) hwdec: shmpage setup failed, "
+			"requested: (%u x %u)\n", cfg->width, cfg->height);
+		return false;
+	}
+
+	arcan_shmifext_bind(&decctx.shmcont);
+	LOG("(decode) hwdec: output @ %zu * %zu\n",
+		(size_t) decctx.shmcont.w, (size_t) decctx.shmcont.h);
+
+	out->opengl_format = GL_RGBA_FMT;
+	out->full_range = true;
+	out->colorspace = libvlc_video_colorspace_BT709;
+	out->primaries = libvlc_video_primaries_BT709;
+	out->transfer = libvlc_video_transfer_func_SRGB;
+	out->orientation = libvlc_video_orient_top_left;
+	return true;
+}
+
+/* the signal swaps the rendertarget, so rebind for vlc to draw into the next */
+static void gpu_vout_swap(void* opaque)
+{
+	arcan_shmifext_signal(&decctx.shmcont, 0, SHMIF_SIGVID, SHMIFEXT_BUILTIN);
+	arcan_shmifext_bind(&decctx.shmcont);
+}
+
+static void* gpu_vout_lookup(void* opaque, const char* sym)
+{
+	return arcan_shmifext_lookup(&decctx.shmcont, sym);
+}
+#endif
+
 static void push_streamstatus(struct arcan_shmif_cont* ctx)
 {
 	static int c;
@@ -552,9 +716,16 @@ int decode_av(struct arcan_shmif_cont* cont, struct arg_arr* args)
 	libvlc_media_t* media = NULL;
 	float position = 0.0;
 
-/* Default the 'capture-' to take UVC first and thereafter go with VLCs probing
- * method. Do this first so that we can enumerate devices even without a valid
- * shmif- context */
+/* Default the 'capture-' to take native V4L2 nodes first, then UVC and
+ * thereafter go with VLCs probing method. Do this first so that we can
+ * enumerate devices even without a valid shmif- context */
+#ifdef HAVE_V4L2
+	if (args && arg_lookup(args, "capture", 0, &val)){
+		if (v4l2_support_activate(cont, args))
+			return EXIT_SUCCESS;
+	}
+#endif
+
 #ifdef HAVE_UVC
 	if (args && arg_lookup(args, "capture", 0, &val)){
 		if (uvc_support_activate(cont, args))
@@ -598,8 +769,8 @@ int decode_av(struct arcan_shmif_cont* cont, struct arg_arr* args)
 		}
 	}
 
-/* decode external arguments, map the necessary ones to VLC */
-	int pad = 1;
+/* decode external arguments, map the necessary ones to VLC, the trailing
+ * NULLs are slots for optional ones */
 	char const* vargs[] = {
 		"--no-xlib",
 		"--verbose", "3",
@@ -607,21 +778,31 @@ int decode_av(struct arcan_shmif_cont* cont, struct arg_arr* args)
 		"--vout", "vmem,none",
 		"--intf", "dummy",
 		"--aout", "amem,none",
-		NULL
+		NULL, NULL, NULL, NULL
 	};
+	size_t vargs_used = COUNT_OF(vargs) - 4;
 
 	arcan_shmif_resetfunc(cont, on_context_reset, NULL);
 
 	if (arg_lookup(args, "noaudio", 0, &val)){
-		for (size_t i = 0; i < COUNT_OF(vargs); i++)
-			if (!vargs[i]){
-				pad--;
-				vargs[i] = "--no-audio";
-				break;
-			}
+		vargs[vargs_used++] = "--no-audio";
+	}
+
+/* the decoder is also allowed to use hardware surfaces in the vmem path, the
+ * frames are then copied back before being handed to us */
+	if (arg_lookup(args, "hwdec", 0, &val)){
+		vargs[vargs_used++] = "--avcodec-hw";
+		vargs[vargs_used++] = val && strlen(val) ? val : "any";
+
+#ifdef HAVE_VLC_GPU
+		if (!gpu_setup(&decctx.shmcont))
+			LOG("(decode) hwdec: falling back to shared memory output\n");
+#else
+		LOG("(decode) hwdec: built without GPU output, using shared memory\n");
+#endif
 	}
 
-	decctx.vlc = libvlc_new(COUNT_OF(vargs)-pad, vargs);
+	decctx.vlc = libvlc_new(vargs_used, vargs);
   if (decctx.vlc == NULL){
   	LOG("Couldn't initialize VLC session, giving up.\n");
     return EXIT_FAILURE;
@@ -709,12 +890,23 @@ int decode_av(struct arcan_shmif_cont* cont, struct arg_arr* args)
 	libvlc_event_attach(em, libvlc_MediaPlayerEndReached, player_event, NULL);
 	libvlc_event_attach(em, libvlc_MediaPlayerEncounteredError, player_event, NULL);
 
-	libvlc_video_set_format_callbacks(decctx.player, video_setup, video_cleanup);
-	libvlc_video_set_callbacks(decctx.player,
-		video_lock, NULL, video_display, NULL);
+#ifdef HAVE_VLC_GPU
+	if (decctx.gpu.active){
+		libvlc_video_set_output_callbacks(decctx.player,
+			arcan_shmifext_defaults(&decctx.shmcont).api == API_OPENGL ?
+				libvlc_video_engine_opengl : libvlc_video_engine_gles2,
+			gpu_vout_setup, gpu_vout_cleanup, NULL, gpu_vout_resize,
+			gpu_vout_swap, gpu_current, gpu_vout_lookup, NULL, NULL, NULL);
+	}
+	else
+#endif
+	{
+		libvlc_video_set_format_callbacks(decctx.player, video_setup, video_cleanup);
+		libvlc_video_set_callbacks(decctx.player,
+			video_lock, NULL, video_display, NULL);
+	}
 
-	libvlc_audio_set_format(decctx.player, "S16N",
-		ARCAN_SHMIF_SAMPLERATE, ARCAN_SHMIF_ACHANNELS);
+	libvlc_audio_set_format_callbacks(decctx.player, audio_setup, NULL);
 
 	libvlc_audio_set_callbacks(decctx.player,
 		audio_play, /*pause*/ NULL, /*resume*/ NULL, audio_flush, audio_drain,NULL);
@@ -769,6 +961,10 @@ int decode_av(struct arcan_shmif_cont* cont, struct arg_arr* args)
 /*	libvlc_media_player_stop(decctx.player); */
 	libvlc_media_player_release(decctx.player);
 	libvlc_release(decctx.vlc);
+#ifdef HAVE_VLC_GPU
+	if (decctx.gpu.active)
+		arcan_shmifext_drop(&decctx.shmcont);
+#endif
 	arcan_shmif_drop(&decctx.shmcont);
 	return EXIT_SUCCESS;
 }
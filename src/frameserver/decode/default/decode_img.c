@@ -30,6 +30,13 @@
 #include "platform_types.h"
 #include "os_platform.h"
 
+#ifdef HAVE_IMG_STREAM
+#include "img_stream.h"
+#endif
+
+/* sources that would decode to more than this go through the streaming path */
+#define IMG_MEMCAP_DEFAULT 128
+
 static struct {
 	data_source source;
 	map_region map;
@@ -44,8 +51,19 @@ static struct {
 	bool force_scale;
 	bool pending_raster;
 	bool in_svg;
+
+/* streaming / deep zoom state, the view is the normalized center of the
+ * shown region and zoom is relative to the whole source fitting the output */
+	bool in_stream;
+	bool force_stream;
+	size_t memcap;
+	size_t src_w, src_h;
+	float view[2];
+	float zoom;
 } current = {
-	.scale = 1.0
+	.scale = 1.0,
+	.zoom = 1.0,
+	.memcap = IMG_MEMCAP_DEFAULT * 1024 * 1024
 };
 
 static void release_current()
@@ -63,11 +81,77 @@ static void release_current()
 	}
 }
 
+static void find_safe_fit(struct arcan_shmif_cont* C, size_t dw, size_t dh);
+static bool do_stbi(struct arcan_shmif_cont* C);
+
+#ifdef HAVE_IMG_STREAM
+static void stream_rows(size_t y1, size_t y2, void* tag)
+{
+	struct arcan_shmif_cont* C = tag;
+	arcan_shmif_dirty(C, 0, y1, C->w, y2, 0);
+	arcan_shmif_signal(C, SHMIF_SIGVID);
+}
+
+/* the part of the source visible at the current zoom and position */
+static struct img_stream_region view_region()
+{
+	float rw = (float) current.src_w / current.zoom;
+	float rh = (float) current.src_h / current.zoom;
+	float x = current.view[0] * current.src_w - rw * 0.5;
+	float y = current.view[1] * current.src_h - rh * 0.5;
+
+	x = x < 0 ? 0 : (x + rw > current.src_w ? current.src_w - rw : x);
+	y = y < 0 ? 0 : (y + rh > current.src_h ? current.src_h - rh : y);
+
+	return (struct img_stream_region){
+		.x = x, .y = y,
+		.w = rw < 1 ? 1 : rw,
+		.h = rh < 1 ? 1 : rh
+	};
+}
+
+/*
+ * re-decode the visible region straight at the output resolution, first as
+ * a cheap reduced pass (where the format has one) and then the real one with
+ * the rows synched as they come in
+ */
+static void restream(struct arcan_shmif_cont* C)
+{
+	current.pending_raster = false;
+	struct img_stream_region reg = view_region();
+
+	if (img_stream_decode((uint8_t*) current.map.ptr, current.map.sz,
+		reg, C->vidp, C->w, C->h, C->pitch, true, NULL, NULL)){
+		arcan_shmif_dirty(C, 0, 0, C->w, C->h, 0);
+		arcan_shmif_signal(C, SHMIF_SIGVID);
+	}
+
+	if (img_stream_decode((uint8_t*) current.map.ptr, current.map.sz,
+		reg, C->vidp, C->w, C->h, C->pitch, false, stream_rows, C))
+		return;
+
+/* the format doesn't stream (e.g. interlaced png), decode it in full */
+	current.in_stream = false;
+	find_safe_fit(C, current.src_w, current.src_h);
+	do_stbi(C);
+}
+#endif
+
 static void reraster(struct arcan_shmif_cont* C)
 {
 	if (!current.pending_raster)
 		return;
 
+#ifdef HAVE_IMG_STREAM
+	if (current.in_stream)
+		return restream(C);
+#endif
+
+	if (!current.svg){
+		current.pending_raster = false;
+		return;
+	}
+
 	if (!current.rast)
 		current.rast = nsvgCreateRasterizer();
 
@@ -93,7 +177,7 @@ static void reraster(struct arcan_shmif_cont* C)
 
 static bool do_svg(struct arcan_shmif_cont* C)
 {
-	char* tmp = strdup(current.map.ptr);
+	char* tmp = strndup(current.map.ptr, current.map.sz);
 
 	if (current.svg){
 		nsvgDelete(current.svg);
@@ -159,6 +243,9 @@ static bool do_file(struct arcan_shmif_cont* C, int inf)
 		return false;
 	}
 
+/* the streaming path keeps decoding from the map on zoom / pan */
+	current.active = true;
+
 	if (current.map.sz < 5){
 		return false;
 	}
@@ -169,6 +256,28 @@ static bool do_file(struct arcan_shmif_cont* C, int inf)
 		return do_svg(C);
 	}
 
+#ifdef HAVE_IMG_STREAM
+	if (img_stream_probe(
+		(uint8_t*) current.map.ptr, current.map.sz, &current.src_w, &current.src_h) &&
+		(current.force_stream ||
+		current.src_w * current.src_h * sizeof(shmif_pixel) > current.memcap ||
+		current.src_w > PP_SHMPAGE_MAXW || current.src_h > PP_SHMPAGE_MAXH)){
+		current.in_svg = false;
+		current.in_stream = true;
+		current.zoom = 1.0;
+		current.view[0] = current.view[1] = 0.5;
+		find_safe_fit(C, current.src_w, current.src_h);
+		current.pending_raster = true;
+		return true;
+	}
+#endif
+
+	current.in_stream = false;
+	return do_stbi(C);
+}
+
+static bool do_stbi(struct arcan_shmif_cont* C)
+{
 /* other considerations here later is to enable HDR-aproto and if used on the
  * right source, deal with all that jaz - then we might also need/want to go
  * the handle-passing path immediately and try shmifext */
@@ -231,6 +340,32 @@ static bool process_event(struct arcan_shmif_cont* C, arcan_tgtevent* ev)
 		return true;
 	}
 
+#ifdef HAVE_IMG_STREAM
+/* deep zoom, offsets are in output pixels for relative and normalized for
+ * absolute, with zoom as the magnification of the whole source */
+	if (ev->kind == TARGET_COMMAND_SEEKCONTENT && current.in_stream){
+		if (ev->ioevs[0].iv == 1){
+			current.view[0] += (float) ev->ioevs[1].iv / (C->w * current.zoom);
+			current.view[1] += (float) ev->ioevs[2].iv / (C->h * current.zoom);
+			current.zoom += ev->ioevs[3].fv;
+		}
+		else if (ev->ioevs[0].iv == 0){
+			current.view[0] = ev->ioevs[1].fv;
+			current.view[1] = ev->ioevs[2].fv;
+			if (ev->ioevs[3].fv > 0)
+				current.zoom = ev->ioevs[3].fv;
+		}
+
+/* past 8x the source pixels there is nothing left to see */
+		float maxzoom = 8.0 * current.src_w / C->w;
+		current.zoom = current.zoom < 1.0 ? 1.0 :
+			(current.zoom > maxzoom ? (maxzoom < 1.0 ? 1.0 : maxzoom) : current.zoom);
+		current.view[0] = current.view[0] < 0 ? 0 : (current.view[0] > 1 ? 1 : current.view[0]);
+		current.view[1] = current.view[1] < 0 ? 0 : (current.view[1] > 1 ? 1 : current.view[1]);
+		current.pending_raster = true;
+	}
+#endif
+
 	if (ev->kind == TARGET_COMMAND_SEEKCONTENT && current.svg){
 		if (ev->ioevs[0].iv == 1){
 			current.pan_xy[0] += ev->ioevs[1].iv;
@@ -288,6 +423,16 @@ int decode_image(struct arcan_shmif_cont* C, struct arg_arr* args)
 
 	const char* val = NULL;
 	int fd = -1;
+
+	if (arg_lookup(args, "stream", 0, NULL))
+		current.force_stream = true;
+
+	if (arg_lookup(args, "maxmem", 0, &val) && val){
+		size_t mb = strtoul(val, NULL, 10);
+		if (mb)
+			current.memcap = mb * 1024 * 1024;
+	}
+
 	if (arg_lookup(args, "file", 0, &val)){
 		if (!val || strlen(val) == 0){
 			return show_use(C, "file=arg [arg] missing");
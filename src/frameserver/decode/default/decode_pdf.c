@@ -1,6 +1,11 @@
 #include <arcan_shmif.h>
 #include <arcan_tuisym.h>
 #include <math.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 #include "decode.h"
 #include "mupdf/fitz.h"
@@ -8,7 +13,68 @@
 
 #define MIN(a, b)	((a) < (b) ? (a) : (b))
 
-static void rebuild_pixmap();
+/* pages are rendered in full-width bands of this many rows on the worker pool
+ * and kept at the zoom level they were rendered at until evicted from cache */
+#define PDF_BAND_H 128
+#define PDF_PREVIEW_SCALE 0.25
+#define PDF_WORKER_LIMIT 8
+#define PDF_CACHE_DEFAULT 256
+#define PDF_PREVIEW_JOB SIZE_MAX
+
+enum band_state {
+	BAND_EMPTY = 0,
+	BAND_QUEUED,
+	BAND_READY
+};
+
+struct page_ent {
+	int page_no;
+	float fact;
+	fz_irect bbox;
+	fz_display_list* list;
+
+/* full resolution, written band by band, and the low-DPI stand-in */
+	fz_pixmap* pix;
+	fz_pixmap* preview;
+	enum band_state preview_state;
+	uint8_t* bands;
+	size_t n_bands;
+
+/* jobs in flight, the entry can't be evicted while this is set */
+	size_t pending;
+	uint64_t used;
+	struct page_ent* next;
+};
+
+struct job {
+	struct page_ent* ent;
+	size_t band;
+	fz_pixmap* preview;
+	bool failed;
+	struct job* next;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct job* hi;
+	struct job* lo;
+	struct job* done;
+	bool quit;
+	int wake[2];
+
+	pthread_t workers[PDF_WORKER_LIMIT];
+	fz_context* wctx[PDF_WORKER_LIMIT];
+	size_t n_workers;
+
+	pthread_mutex_t fzlocks[FZ_LOCK_MAX];
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.wake = {-1, -1}
+};
+
+static void resize_output();
 
 static struct {
 /* action schedule triggers */
@@ -20,11 +86,19 @@ static struct {
 /* context tracking */
 	fz_context* ctx;
 	fz_document* doc;
-	fz_pixmap* pmap;
-	fz_device *dev;
 	fz_page *page;
 	struct arcan_shmif_cont con;
 
+/* page cache, the view is the entry for the current page and zoom */
+	struct page_ent* cache;
+	struct page_ent* view;
+	size_t cache_sz, cache_limit;
+	uint64_t stamp;
+
+/* rows rendered since the last signal */
+	bool damage;
+	size_t dmg_y1, dmg_y2;
+
 /* input states */
 	int32_t modifiers;
 	uint8_t mstate[ASHMIF_MSTATE_SZ];
@@ -43,20 +117,15 @@ static struct {
 	.scale = 1.0,
 	.annotations = true,
 	.dirty = true,
+	.cache_limit = PDF_CACHE_DEFAULT * 1024 * 1024
 };
 
 static bool auto_size(void* tag);
 static void calculate_zoom_factor();
 
-static fz_matrix get_transform(bool translate)
+static float get_fact()
 {
-	fz_matrix ctm = fz_rotate(0);
-	float fact = apdf.scale + (apdf.dpy.density * 2.54 / 72.0);
-	if (translate)
-		ctm = fz_pre_translate(ctm, apdf.dx, apdf.dy);
-	ctm = fz_pre_scale(ctm, fact, fact);
-
-	return ctm;
+	return apdf.scale + (apdf.dpy.density * 2.54 / 72.0);
 }
 
 static void calculate_zoom_factor()
@@ -77,77 +146,534 @@ static void calculate_zoom_factor()
 	}
 }
 
-static void render()
+static void fz_lock_mutex(void* user, int lock)
 {
-	rebuild_pixmap();
+	pthread_mutex_lock(&pool.fzlocks[lock]);
+}
 
-	bool repack = true;
-	fz_matrix transform = get_transform(true);
+static void fz_unlock_mutex(void* user, int lock)
+{
+	pthread_mutex_unlock(&pool.fzlocks[lock]);
+}
 
-/* pad? */
-	fz_rect rect = fz_bound_page(apdf.ctx, apdf.page);
-	rect = fz_transform_rect(rect, transform);
+static fz_locks_context fz_locks = {
+	.lock = fz_lock_mutex,
+	.unlock = fz_unlock_mutex
+};
 
-	shmif_pixel bg_pixel = SHMIF_RGBA(0x40, 0x40, 0x40, 0xff);
+static fz_irect band_rect(struct page_ent* ent, size_t band)
+{
+	fz_irect res = ent->bbox;
+	res.y0 += band * PDF_BAND_H;
+	res.y1 = MIN(res.y0 + PDF_BAND_H, ent->bbox.y1);
+	return res;
+}
 
-/* clear to 'background' first */
-	if (rect.y0 > 0.0){
-		for (size_t y = 0; y < apdf.con.h && y < rect.y0; y++){
-			shmif_pixel* out = &apdf.con.vidp[y * apdf.con.pitch];
-			for (size_t x = 0; x < apdf.con.w; x++)
-				out[x] = bg_pixel;
+/*
+ * worker side, only touches the display list and the pixmaps of the entry,
+ * both stay alive as long as the entry has pending jobs
+ */
+static void run_job(fz_context* ctx, struct job* job)
+{
+	struct page_ent* ent = job->ent;
+	fz_pixmap* pix = NULL;
+	fz_device* dev = NULL;
+	fz_var(pix);
+	fz_var(dev);
+
+	fz_try(ctx){
+		fz_matrix ctm;
+		fz_irect area;
+
+		if (job->band == PDF_PREVIEW_JOB){
+			ctm = fz_scale(ent->fact * PDF_PREVIEW_SCALE, ent->fact * PDF_PREVIEW_SCALE);
+			area = fz_round_rect(
+				fz_transform_rect(fz_bound_display_list(ctx, ent->list), ctm));
+			pix = fz_new_pixmap_with_bbox(ctx, fz_device_bgr(ctx), area, NULL, 1);
 		}
+/* the band aliases its rows in the page pixmap */
+		else {
+			ctm = fz_scale(ent->fact, ent->fact);
+			area = band_rect(ent, job->band);
+			pix = fz_new_pixmap_with_bbox_and_data(ctx, fz_device_bgr(ctx), area,
+				NULL, 1, fz_pixmap_samples(ctx, ent->pix) +
+				(size_t)(area.y0 - ent->bbox.y0) * fz_pixmap_stride(ctx, ent->pix));
+		}
+
+		fz_clear_pixmap_with_value(ctx, pix, 0xff);
+		dev = fz_new_draw_device(ctx, fz_identity, pix);
+		fz_run_display_list(ctx, ent->list, dev, ctm, fz_rect_from_irect(area), NULL);
+		fz_close_device(ctx, dev);
+	}
+	fz_always(ctx){
+		fz_drop_device(ctx, dev);
+	}
+	fz_catch(ctx){
+		fprintf(stderr, "couldn't render page %d: %s\n",
+			ent->page_no, fz_caught_message(ctx));
+		job->failed = true;
 	}
 
-	if (rect.y1 < apdf.con.h){
-		for (size_t y = rect.y1 + 1; y < apdf.con.h; y++){
-			shmif_pixel* out = &apdf.con.vidp[y * apdf.con.pitch];
-			for (size_t x = 0; x < apdf.con.w; x++)
-				out[x] = bg_pixel;
+	if (job->band == PDF_PREVIEW_JOB && !job->failed)
+		job->preview = pix;
+	else
+		fz_drop_pixmap(ctx, pix);
+}
+
+static void* worker(void* tag)
+{
+	fz_context* ctx = tag;
+
+	pthread_mutex_lock(&pool.lock);
+	for(;;){
+		while (!pool.quit && !pool.hi && !pool.lo)
+			pthread_cond_wait(&pool.cond, &pool.lock);
+
+		if (pool.quit)
+			break;
+
+		struct job* job;
+		if (pool.hi){
+			job = pool.hi;
+			pool.hi = job->next;
+		}
+		else {
+			job = pool.lo;
+			pool.lo = job->next;
 		}
+		pthread_mutex_unlock(&pool.lock);
+
+		run_job(ctx, job);
+
+		pthread_mutex_lock(&pool.lock);
+		job->next = pool.done;
+		pool.done = job;
+		uint8_t ch = 0;
+		write(pool.wake[1], &ch, 1);
 	}
+	pthread_mutex_unlock(&pool.lock);
 
-	for (size_t y = 0; y < apdf.con.h; y++){
-		shmif_pixel* out = &apdf.con.vidp[y * apdf.con.pitch];
-		for (size_t x = 0; x < rect.x0 && x < apdf.con.w; x++)
-			out[x] = bg_pixel;
-		for (size_t x = rect.x1 < 0 ? 0 : rect.x1; x < apdf.con.w; x++)
-			out[x] = bg_pixel;
+	return NULL;
+}
+
+static bool pool_start(size_t n)
+{
+	if (-1 == pipe(pool.wake))
+		return false;
+
+	fcntl(pool.wake[0], F_SETFL, O_NONBLOCK);
+	fcntl(pool.wake[0], F_SETFD, FD_CLOEXEC);
+	fcntl(pool.wake[1], F_SETFD, FD_CLOEXEC);
+
+	for (size_t i = 0; i < n && i < PDF_WORKER_LIMIT; i++){
+		if (!(pool.wctx[i] = fz_clone_context(apdf.ctx)))
+			break;
+
+		if (0 != pthread_create(&pool.workers[i], NULL, worker, pool.wctx[i])){
+			fz_drop_context(pool.wctx[i]);
+			break;
+		}
+		pool.n_workers++;
 	}
 
-/* then draw in the paper */
-	shmif_pixel fg_pixel = SHMIF_RGBA(0xff, 0xff, 0xff, 0xff);
-	for (size_t y = rect.y0 > 0 ? rect.y0 : 0; y < apdf.con.h && y <= rect.y1; y++){
-		shmif_pixel* out = &apdf.con.vidp[y * apdf.con.pitch];
-		for (size_t x = rect.x0 > 0 ? rect.x0 : 0; x < apdf.con.w && x <= rect.x1; x++){
-			out[x] = fg_pixel;
+	return pool.n_workers > 0;
+}
+
+static void drop_entry(struct page_ent* ent)
+{
+	apdf.cache_sz -= (size_t) fz_pixmap_stride(apdf.ctx, ent->pix) *
+		fz_pixmap_height(apdf.ctx, ent->pix);
+
+	fz_drop_pixmap(apdf.ctx, ent->pix);
+	fz_drop_pixmap(apdf.ctx, ent->preview);
+	fz_drop_display_list(apdf.ctx, ent->list);
+	free(ent->bands);
+	free(ent);
+}
+
+static void drop_jobs(struct job* job)
+{
+	while (job){
+		struct job* next = job->next;
+		fz_drop_pixmap(apdf.ctx, job->preview);
+		free(job);
+		job = next;
+	}
+}
+
+static void pool_stop()
+{
+	pthread_mutex_lock(&pool.lock);
+	pool.quit = true;
+	pthread_cond_broadcast(&pool.cond);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (size_t i = 0; i < pool.n_workers; i++){
+		pthread_join(pool.workers[i], NULL);
+		fz_drop_context(pool.wctx[i]);
+	}
+	pool.n_workers = 0;
+
+	drop_jobs(pool.hi);
+	drop_jobs(pool.lo);
+	drop_jobs(pool.done);
+	pool.hi = pool.lo = pool.done = NULL;
+
+	while (apdf.cache){
+		struct page_ent* next = apdf.cache->next;
+		drop_entry(apdf.cache);
+		apdf.cache = next;
+	}
+	apdf.view = NULL;
+
+	close(pool.wake[0]);
+	close(pool.wake[1]);
+}
+
+/* evict least recently used entries without jobs in flight until [sz] fits */
+static bool cache_trim(size_t sz)
+{
+	while (apdf.cache_sz + sz > apdf.cache_limit){
+		struct page_ent** victim = NULL;
+
+		for (struct page_ent** cur = &apdf.cache; *cur; cur = &(*cur)->next){
+			if ((*cur)->pending || *cur == apdf.view)
+				continue;
+			if (!victim || (*cur)->used < (*victim)->used)
+				victim = cur;
 		}
+
+		if (!victim)
+			return false;
+
+		struct page_ent* ent = *victim;
+		*victim = ent->next;
+		drop_entry(ent);
 	}
 
-	fz_try(apdf.ctx)
-		fz_run_page_contents(apdf.ctx, apdf.page, apdf.dev, transform, NULL);
+	return true;
+}
+
+static struct page_ent* cache_get(int page_no, float fact)
+{
+	fz_display_list* list = NULL;
 
-/* option here: toggle annotations on / off - possibly also as an overlay
- * window so the WM gets to split out */
+	for (struct page_ent* cur = apdf.cache; cur; cur = cur->next){
+		if (cur->page_no != page_no)
+			continue;
 
+		if (cur->fact == fact){
+			cur->used = ++apdf.stamp;
+			return cur;
+		}
+
+/* the display list doesn't depend on zoom so it can be shared */
+		if (!list)
+			list = fz_keep_display_list(apdf.ctx, cur->list);
+	}
+
+	fz_page* page = NULL;
+	fz_var(page);
+	fz_var(list);
+
+	fz_try(apdf.ctx){
+		if (!list){
+			page = page_no == apdf.page_no && apdf.page ?
+				fz_keep_page(apdf.ctx, apdf.page) : fz_load_page(apdf.ctx, apdf.doc, page_no);
+
+			list = apdf.annotations ?
+				fz_new_display_list_from_page(apdf.ctx, page) :
+				fz_new_display_list_from_page_contents(apdf.ctx, page);
+		}
+	}
+	fz_always(apdf.ctx){
+		fz_drop_page(apdf.ctx, page);
+	}
 	fz_catch(apdf.ctx){
-		fprintf(stderr, "couldn't run page: %s\n", fz_caught_message(apdf.ctx));
-		repack = false;
+		fprintf(stderr, "couldn't load page %d: %s\n", page_no, fz_caught_message(apdf.ctx));
+		fz_drop_display_list(apdf.ctx, list);
+		return NULL;
 	}
 
-	if (!repack)
+	fz_irect bbox = fz_round_rect(fz_transform_rect(
+		fz_bound_display_list(apdf.ctx, list), fz_scale(fact, fact)));
+	size_t w = bbox.x1 - bbox.x0;
+	size_t h = bbox.y1 - bbox.y0;
+
+	struct page_ent* ent = malloc(sizeof(struct page_ent));
+	if (!w || !h || !ent || !cache_trim(w * h * 4)){
+		fz_drop_display_list(apdf.ctx, list);
+		free(ent);
+		return NULL;
+	}
+
+	*ent = (struct page_ent){
+		.page_no = page_no,
+		.fact = fact,
+		.bbox = bbox,
+		.list = list,
+		.n_bands = (h + PDF_BAND_H - 1) / PDF_BAND_H,
+		.used = ++apdf.stamp
+	};
+
+	ent->bands = calloc(ent->n_bands, sizeof(uint8_t));
+	fz_try(apdf.ctx){
+		ent->pix = fz_new_pixmap_with_bbox(apdf.ctx, fz_device_bgr(apdf.ctx), bbox, NULL, 1);
+	}
+	fz_catch(apdf.ctx){
+		fprintf(stderr, "pixmap creation failed: %s\n", fz_caught_message(apdf.ctx));
+	}
+
+	if (!ent->bands || !ent->pix){
+		fz_drop_display_list(apdf.ctx, list);
+		free(ent->bands);
+		free(ent);
+		return NULL;
+	}
+
+	apdf.cache_sz += (size_t) fz_pixmap_stride(apdf.ctx, ent->pix) * h;
+	ent->next = apdf.cache;
+	apdf.cache = ent;
+	return ent;
+}
+
+/* LOCKED */
+static void queue_job(struct job** dst, struct page_ent* ent, size_t band)
+{
+	struct job* job = malloc(sizeof(struct job));
+	if (!job)
+		return;
+
+	*job = (struct job){
+		.ent = ent,
+		.band = band
+	};
+
+	if (band == PDF_PREVIEW_JOB)
+		ent->preview_state = BAND_QUEUED;
+	else
+		ent->bands[band] = BAND_QUEUED;
+	ent->pending++;
+
+	while (*dst)
+		dst = &(*dst)->next;
+	*dst = job;
+}
+
+/* LOCKED, jobs not yet picked up by a worker go back to being empty */
+static void unqueue_jobs(struct job** src)
+{
+	while (*src){
+		struct job* job = *src;
+		*src = job->next;
+
+		if (job->band == PDF_PREVIEW_JOB)
+			job->ent->preview_state = BAND_EMPTY;
+		else
+			job->ent->bands[job->band] = BAND_EMPTY;
+
+		job->ent->pending--;
+		free(job);
+	}
+}
+
+static void queue_bands(struct job** dst, struct page_ent* ent, size_t first, size_t last)
+{
+	for (size_t i = first; i < last && i < ent->n_bands; i++)
+		if (ent->bands[i] == BAND_EMPTY)
+			queue_job(dst, ent, i);
+}
+
+/*
+ * re-prioritize when the page or zoom changes: the preview goes first, then
+ * the visible bands followed by the rest of the page, while the neighboring
+ * pages come last. Anything queued for the old view that hasn't started yet
+ * is dropped, what has been rendered so far stays cached.
+ */
+static void schedule()
+{
+	float fact = get_fact();
+	apdf.view = cache_get(apdf.page_no, fact);
+
+	pthread_mutex_lock(&pool.lock);
+	unqueue_jobs(&pool.hi);
+	unqueue_jobs(&pool.lo);
+
+	struct page_ent* view = apdf.view;
+	if (view){
+		size_t n_ready = 0;
+		for (size_t i = 0; i < view->n_bands; i++)
+			n_ready += view->bands[i] == BAND_READY;
+
+		if (n_ready < view->n_bands && view->preview_state == BAND_EMPTY)
+			queue_job(&pool.hi, view, PDF_PREVIEW_JOB);
+
+		ssize_t oy = view->bbox.y0 + apdf.dy;
+		ssize_t y1 = -oy > 0 ? -oy : 0;
+		ssize_t y2 = (ssize_t) apdf.con.h - oy;
+		size_t first = y1 / PDF_BAND_H;
+		size_t last = y2 > 0 ? (y2 + PDF_BAND_H - 1) / PDF_BAND_H : 0;
+
+		queue_bands(&pool.hi, view, first, last);
+		queue_bands(&pool.hi, view, 0, view->n_bands);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+/* cache_get can load pages so don't hold the lock, the new entries are only
+ * known to this thread until queued */
+	int np = fz_count_pages(apdf.ctx, apdf.doc);
+	int nb[] = {apdf.page_no + 1, apdf.page_no - 1};
+
+	for (size_t i = 0; i < sizeof(nb) / sizeof(nb[0]); i++){
+		if (nb[i] < 0 || nb[i] >= np)
+			continue;
+
+		struct page_ent* ent = cache_get(nb[i], fact);
+		if (!ent)
+			continue;
+
+		pthread_mutex_lock(&pool.lock);
+		queue_bands(&pool.lo, ent, 0, ent->n_bands);
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pthread_cond_broadcast(&pool.cond);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+static void add_damage(ssize_t y1, ssize_t y2)
+{
+	y1 = y1 < 0 ? 0 : y1;
+	y2 = y2 > (ssize_t) apdf.con.h ? (ssize_t) apdf.con.h : y2;
+	if (y2 <= y1)
+		return;
+
+	if (!apdf.damage){
+		apdf.dmg_y1 = y1;
+		apdf.dmg_y2 = y2;
+		apdf.damage = true;
 		return;
+	}
+
+	apdf.dmg_y1 = (size_t) y1 < apdf.dmg_y1 ? (size_t) y1 : apdf.dmg_y1;
+	apdf.dmg_y2 = (size_t) y2 > apdf.dmg_y2 ? (size_t) y2 : apdf.dmg_y2;
+}
+
+/* pick up finished jobs and mark what they cover in the view as damaged */
+static void collect()
+{
+	uint8_t buf[64];
+	while (read(pool.wake[0], buf, sizeof(buf)) > 0){}
+
+	pthread_mutex_lock(&pool.lock);
+	struct job* job = pool.done;
+	pool.done = NULL;
+	pthread_mutex_unlock(&pool.lock);
+
+	while (job){
+		struct job* next = job->next;
+		struct page_ent* ent = job->ent;
+		ssize_t oy = ent->bbox.y0 + apdf.dy;
+
+/* failed ones are marked ready anyway so they don't get queued forever */
+		if (job->band == PDF_PREVIEW_JOB){
+			ent->preview = job->preview;
+			ent->preview_state = BAND_READY;
+			if (ent == apdf.view)
+				add_damage(oy, oy + ent->bbox.y1 - ent->bbox.y0);
+		}
+		else {
+			ent->bands[job->band] = BAND_READY;
+			if (ent == apdf.view){
+				fz_irect band = band_rect(ent, job->band);
+				add_damage(oy + band.y0 - ent->bbox.y0, oy + band.y1 - ent->bbox.y0);
+			}
+		}
+
+		ent->pending--;
+		free(job);
+		job = next;
+	}
+}
+
+/*
+ * fill rows [y1, y2> of the output: rendered bands are copied, the rest comes
+ * from the scaled up preview or blank paper until their band arrives
+ */
+static void compose(size_t y1, size_t y2)
+{
+	shmif_pixel bg_pixel = SHMIF_RGBA(0x40, 0x40, 0x40, 0xff);
+	shmif_pixel fg_pixel = SHMIF_RGBA(0xff, 0xff, 0xff, 0xff);
+	struct page_ent* ent = apdf.view;
+
+	ssize_t pw = 0, ph = 0, ox = 0, oy = 0;
+	if (ent){
+		pw = ent->bbox.x1 - ent->bbox.x0;
+		ph = ent->bbox.y1 - ent->bbox.y0;
+		ox = ent->bbox.x0 + apdf.dx;
+		oy = ent->bbox.y0 + apdf.dy;
+	}
 
-	if (apdf.annotations){
-		fz_try(apdf.ctx)
-			fz_run_page_annots(apdf.ctx, apdf.page, apdf.dev, transform, NULL);
-		fz_catch(apdf.ctx){
-			fprintf(stderr, "couldn't run annotations: %s\n", fz_caught_message(apdf.ctx));
+	ssize_t w = apdf.con.w;
+	ssize_t x1 = ox < 0 ? 0 : (ox > w ? w : ox);
+	ssize_t x2 = ox + pw < 0 ? 0 : (ox + pw > w ? w : ox + pw);
+
+	for (size_t y = y1; y < y2 && y < apdf.con.h; y++){
+		shmif_pixel* out = &apdf.con.vidp[y * apdf.con.pitch];
+		ssize_t py = (ssize_t) y - oy;
+
+		if (!ent || py < 0 || py >= ph || x2 <= x1){
+			for (ssize_t x = 0; x < w; x++)
+				out[x] = bg_pixel;
+			continue;
+		}
+
+		for (ssize_t x = 0; x < x1; x++)
+			out[x] = bg_pixel;
+		for (ssize_t x = x2; x < w; x++)
+			out[x] = bg_pixel;
+
+		if (ent->bands[py / PDF_BAND_H] == BAND_READY){
+			shmif_pixel* src = (shmif_pixel*)(fz_pixmap_samples(apdf.ctx, ent->pix) +
+				(size_t) py * fz_pixmap_stride(apdf.ctx, ent->pix));
+			memcpy(&out[x1], &src[x1 - ox], (x2 - x1) * sizeof(shmif_pixel));
+		}
+		else if (ent->preview){
+			ssize_t pvw = fz_pixmap_width(apdf.ctx, ent->preview);
+			ssize_t pvh = fz_pixmap_height(apdf.ctx, ent->preview);
+			ssize_t sy = MIN(py * pvh / ph, pvh - 1);
+			shmif_pixel* src = (shmif_pixel*)(fz_pixmap_samples(apdf.ctx, ent->preview) +
+				(size_t) sy * fz_pixmap_stride(apdf.ctx, ent->preview));
+
+			for (ssize_t x = x1; x < x2; x++)
+				out[x] = src[MIN((x - ox) * pvw / pw, pvw - 1)];
+		}
+		else {
+			for (ssize_t x = x1; x < x2; x++)
+				out[x] = fg_pixel;
 		}
 	}
+}
 
+static void present(size_t y1, size_t y2)
+{
+	compose(y1, y2);
+	arcan_shmif_dirty(&apdf.con, 0, y1, apdf.con.w, y2, 0);
 	arcan_shmif_signal(&apdf.con, SHMIF_SIGVID | SHMIF_SIGBLK_NONE);
 	apdf.locked = true;
+	apdf.damage = false;
+}
+
+static void render()
+{
+	resize_output();
+
+	float fact = get_fact();
+	if (!apdf.view || apdf.view->page_no != apdf.page_no || apdf.view->fact != fact)
+		schedule();
+
+	present(0, apdf.con.h);
 }
 
 static void set_page(int no)
@@ -174,13 +700,8 @@ static void set_page(int no)
 	apdf.dirty = true;
 }
 
-static void rebuild_pixmap()
+static void resize_output()
 {
-	apdf.dirty = true;
-	if (apdf.pmap){
-		apdf.pmap = (fz_drop_pixmap(apdf.ctx, apdf.pmap), NULL);
-	}
-
 /* two different modes here, one is where we switch page size to fit when stepping
  * (assuming it has changed from last time) - or we pan. There is also:
  * fz_is_document_reflowable -> fz_layout_document(ctx, doc, w, h, em_font_sz) */
@@ -199,40 +720,18 @@ static void rebuild_pixmap()
 		apdf.rezoom = true;
 	}
 
-	arcan_shmif_resize_ext(&apdf.con, w, h, (struct shmif_resize_ext){.vbuf_cnt = 2});
+/* single buffered so that only the damaged rows need to be synched, the
+ * frame signal is only sent when the server has released the last one */
+	apdf.con.hints = SHMIF_RHINT_VSIGNAL_EV | SHMIF_RHINT_SUBREGION;
+	arcan_shmif_resize_ext(&apdf.con, w, h, (struct shmif_resize_ext){.vbuf_cnt = 1});
 	if (apdf.rezoom){
 		calculate_zoom_factor();
 		apdf.rezoom = false;
 	}
 
-/* Now we have the 'negotiated' size - that might not match the actual size of
- * the page though so we might want to pan / offset. Doing that requires we
- * offset the vidb accordingly (and reduce w / h). */
-
 /* For big-endian it might be better to probe shmif_pixel through the packing
- * macro and switch between bgr and rgb there, the [1] sets n=4 for alpha ch. */
-	fz_colorspace* cspace = fz_device_bgr(apdf.ctx);
-	fz_try(apdf.ctx)
-		apdf.pmap = fz_new_pixmap_with_data(apdf.ctx, cspace,
-			apdf.con.w, apdf.con.h, NULL, 1, apdf.con.stride, apdf.con.vidb);
-
-	fz_catch(apdf.ctx){
-		fprintf(stderr, "pixmap creation failed: %s\n", fz_caught_message(apdf.ctx));
-	}
-
-	apdf.pmap->flags &= ~1; /* stop it from free:ing our buffer */
-
-/* change the >density< of the pixmap from the assumed default 72, though
- * can't find a control for also setting the subchannel layout for hinting */
-	float dpi = apdf.dpy.density * 2.54;
-	fz_set_pixmap_resolution(apdf.ctx, apdf.pmap, dpi, dpi);
-
-	fz_try(apdf.ctx)
-		apdf.dev = fz_new_draw_device(apdf.ctx, fz_identity, apdf.pmap);
-
-	fz_catch(apdf.ctx){
-		fprintf(stderr, "device creation failed: %s\n", fz_caught_message(apdf.ctx));
-	}
+ * macro and switch between bgr and rgb there, the pixmaps are all device_bgr
+ * with alpha so the rows can be copied as-is. */
 
 /* another interesting bit here is that we could add our own font hooks and map
  * that to the fonthints that we receive over the connection */
@@ -606,12 +1105,32 @@ int decode_pdf(struct arcan_shmif_cont* C, struct arg_arr* args)
 		return show_use(C, "file=arg [arg] couldn't be opened");
 	}
 
-	apdf.ctx = fz_new_context(NULL, NULL, FZ_STORE_DEFAULT);
+	long workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (arg_lookup(args, "workers", 0, &val) && val)
+		workers = strtol(val, NULL, 10);
+	workers = workers < 1 ? 1 : (workers > PDF_WORKER_LIMIT ? PDF_WORKER_LIMIT : workers);
+
+	if (arg_lookup(args, "cache", 0, &val) && val){
+		size_t mb = strtoul(val, NULL, 10);
+		if (mb)
+			apdf.cache_limit = mb * 1024 * 1024;
+	}
+
+	for (size_t i = 0; i < FZ_LOCK_MAX; i++)
+		pthread_mutex_init(&pool.fzlocks[i], NULL);
+
+	apdf.ctx = fz_new_context(NULL, &fz_locks, FZ_STORE_DEFAULT);
 	fz_register_document_handlers(apdf.ctx);
 
 	if (!open_document(fpek, idstr))
 		return EXIT_FAILURE;
 
+	if (!pool_start(workers)){
+		fz_drop_document(apdf.ctx, apdf.doc);
+		fz_drop_context(apdf.ctx);
+		return show_use(C, "couldn't setup render workers");
+	}
+
 	apdf.con = *C;
 	labelhint_table(ihandlers);
 	labelhint_announce(&apdf.con);
@@ -630,18 +1149,42 @@ int decode_pdf(struct arcan_shmif_cont* C, struct arg_arr* args)
 
 	struct arcan_event ev;
 
-/* normal double-dispatch structure to deal with storms without unnecessary refreshes */
-	while (arcan_shmif_wait(&apdf.con, &ev)){
-		run_event(&ev);
-		while (arcan_shmif_poll(&apdf.con, &ev) > 0)
+/* normal double-dispatch structure to deal with storms without unnecessary
+ * refreshes, with finished bands from the workers as the other wakeup source */
+	bool running = true;
+	while (running){
+		struct pollfd pfd[] = {
+			{.fd = apdf.con.epipe, .events = POLLIN | POLLERR | POLLHUP | POLLNVAL},
+			{.fd = pool.wake[0], .events = POLLIN}
+		};
+
+		if (-1 == poll(pfd, 2, -1) && errno != EINTR && errno != EAGAIN)
+			break;
+
+		if (pfd[1].revents)
+			collect();
+
+		int rc;
+		while ((rc = arcan_shmif_poll(&apdf.con, &ev)) > 0){
+			if (ev.category == EVENT_TARGET && ev.tgt.kind == TARGET_COMMAND_EXIT)
+				running = false;
 			run_event(&ev);
+		}
+
+		if (rc < 0)
+			break;
 
 		if (apdf.dirty && !apdf.locked){
 			render();
 			apdf.dirty = false;
 		}
+		else if (apdf.damage && !apdf.locked)
+			present(apdf.dmg_y1, apdf.dmg_y2);
 	}
 
+	pool_stop();
+	if (apdf.page)
+		fz_drop_page(apdf.ctx, apdf.page);
 	fz_drop_document(apdf.ctx, apdf.doc);
 	fz_drop_context(apdf.ctx);
 	arcan_shmif_drop(&apdf.con);
@@ -2,6 +2,12 @@
 #include <arcan_shmif_sub.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 /* included statically here since
  *   a. the interface hasn't changed since 2003 or so
@@ -12,6 +18,46 @@
 #include "decode.h"
 #include "util/msgchunk.h"
 
+/* the implementations are built into decode_img */
+#include "stb_image.h"
+#include "stb_image_resize.h"
+
+#ifdef HAVE_IMG_STREAM
+#include "img_stream.h"
+#endif
+
+#define BATCH_WORKER_LIMIT 16
+#define BATCH_THUMB_DEFAULT 128
+#define BATCH_ATLAS_COLS 8
+
+/* sources that would decode to more than this are not thumbnailed unless the
+ * streaming decoder can handle them */
+#define BATCH_DECODE_CAP (64 * 1024 * 1024)
+
+struct batch_item {
+	size_t index;
+	const char* name;
+	char* descr;
+	shmif_pixel* thumb;
+	size_t tw, th;
+	struct batch_item* next;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	int dirfd;
+	char** names;
+	size_t n_names;
+	size_t next;
+	struct batch_item* done;
+	int wake[2];
+	size_t cw, ch;
+} batch = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.dirfd = AT_FDCWD,
+	.wake = {-1, -1}
+};
+
 static const char* run_magic(
 	struct arcan_shmif_cont* cont, magic_t magic, int fd)
 {
@@ -25,6 +71,453 @@ static const char* run_magic(
 	return NULL;
 }
 
+static void fit_cell(size_t sw, size_t sh, size_t* tw, size_t* th)
+{
+	if (sw * batch.ch > sh * batch.cw){
+		*tw = batch.cw;
+		*th = sh * batch.cw / sw;
+	}
+	else {
+		*th = batch.ch;
+		*tw = sw * batch.ch / sh;
+	}
+	*tw = *tw ? *tw : 1;
+	*th = *th ? *th : 1;
+}
+
+static void make_thumb(int fd, struct batch_item* it)
+{
+	struct stat st;
+	if (-1 == fstat(fd, &st) || !S_ISREG(st.st_mode) || !st.st_size)
+		return;
+
+	uint8_t* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return;
+
+	size_t sw = 0, sh = 0;
+	bool streamed = false;
+#ifdef HAVE_IMG_STREAM
+	streamed = img_stream_probe(map, st.st_size, &sw, &sh);
+#endif
+
+	int iw, ih, comp;
+	if (!streamed){
+		if (!stbi_info_from_memory(map, st.st_size, &iw, &ih, &comp) ||
+			iw <= 0 || ih <= 0 || (size_t)iw * ih * 4 > BATCH_DECODE_CAP)
+			goto out;
+		sw = iw;
+		sh = ih;
+	}
+
+	if (!sw || !sh)
+		goto out;
+
+	fit_cell(sw, sh, &it->tw, &it->th);
+	if (!(it->thumb = malloc(it->tw * it->th * sizeof(shmif_pixel))))
+		goto out;
+
+/* the streaming decoder resamples straight to the cell size, so this is the
+ * cheap path regardless of the source resolution */
+#ifdef HAVE_IMG_STREAM
+	if (streamed){
+		if (img_stream_decode(map, st.st_size,
+			(struct img_stream_region){.w = sw, .h = sh},
+			it->thumb, it->tw, it->th, it->tw, false, NULL, NULL))
+			goto out;
+
+		if ((size_t)sw * sh * 4 > BATCH_DECODE_CAP){
+			free(it->thumb);
+			it->thumb = NULL;
+			goto out;
+		}
+	}
+#endif
+
+	uint8_t* src = stbi_load_from_memory(map, st.st_size, &iw, &ih, &comp, 4);
+	uint8_t* dst = malloc(it->tw * it->th * 4);
+	if (!src || !dst ||
+		!stbir_resize_uint8(src, iw, ih, 0, dst, it->tw, it->th, 0, 4)){
+		free(it->thumb);
+		it->thumb = NULL;
+	}
+	else {
+		for (size_t i = 0; i < it->tw * it->th; i++){
+			uint8_t* px = &dst[i * 4];
+			it->thumb[i] = SHMIF_RGBA(px[0], px[1], px[2], px[3]);
+		}
+	}
+
+	stbi_image_free(src);
+	free(dst);
+
+out:
+	munmap(map, st.st_size);
+}
+
+static void* batch_worker(void* tag)
+{
+	magic_t magic = tag;
+
+	for(;;){
+		pthread_mutex_lock(&batch.lock);
+		if (batch.next == batch.n_names){
+			pthread_mutex_unlock(&batch.lock);
+			break;
+		}
+		size_t index = batch.next++;
+		pthread_mutex_unlock(&batch.lock);
+
+		struct batch_item* it = malloc(sizeof(struct batch_item));
+		if (!it)
+			continue;
+
+		*it = (struct batch_item){
+			.index = index,
+			.name = batch.names[index]
+		};
+
+		int fd = openat(batch.dirfd, it->name, O_RDONLY | O_CLOEXEC);
+		if (-1 == fd){
+			it->descr = strdup(strerror(errno));
+		}
+		else {
+			const char* descr = magic_descriptor(magic, fd);
+			if (!descr)
+				descr = magic_error(magic);
+			it->descr = strdup(descr ? descr : "unknown");
+
+			if (batch.cw && 0 == lseek(fd, 0, SEEK_SET))
+				make_thumb(fd, it);
+			close(fd);
+		}
+
+		pthread_mutex_lock(&batch.lock);
+		it->next = batch.done;
+		batch.done = it;
+		pthread_mutex_unlock(&batch.lock);
+
+		uint8_t ch = 0;
+		write(batch.wake[1], &ch, 1);
+	}
+
+	magic_close(magic);
+	return NULL;
+}
+
+static bool add_name(const char* name, size_t* cap)
+{
+	if (batch.n_names == *cap){
+		size_t ncap = *cap ? *cap * 2 : 64;
+		char** nn = realloc(batch.names, ncap * sizeof(char*));
+		if (!nn)
+			return false;
+		batch.names = nn;
+		*cap = ncap;
+	}
+
+	if (!(batch.names[batch.n_names] = strdup(name)))
+		return false;
+
+	batch.n_names++;
+	return true;
+}
+
+static bool scan_dir(DIR* dir)
+{
+	size_t cap = 0;
+	struct dirent* ent;
+
+	while ((ent = readdir(dir))){
+		if (ent->d_name[0] == '.')
+			continue;
+
+		struct stat st;
+		if (-1 == fstatat(dirfd(dir), ent->d_name, &st, 0) || !S_ISREG(st.st_mode))
+			continue;
+
+		if (!add_name(ent->d_name, &cap))
+			return false;
+	}
+
+	return true;
+}
+
+static bool scan_list(FILE* fpek)
+{
+	size_t cap = 0;
+	char* line = NULL;
+	size_t line_sz = 0;
+	ssize_t nr;
+
+	while ((nr = getline(&line, &line_sz, fpek)) != -1){
+		while (nr && (line[nr-1] == '\n' || line[nr-1] == '\r'))
+			line[--nr] = '\0';
+
+		if (nr && !add_name(line, &cap)){
+			free(line);
+			return false;
+		}
+	}
+
+	free(line);
+	return true;
+}
+
+static void batch_clear(struct arcan_shmif_cont* cont)
+{
+	for (size_t i = 0; i < cont->pitch * cont->h; i++)
+		cont->vidp[i] = SHMIF_RGBA(0, 0, 0, 0);
+	arcan_shmif_dirty(cont, 0, 0, cont->w, cont->h, 0);
+}
+
+static void batch_emit(struct arcan_shmif_cont* cont,
+	struct batch_item* it, size_t page, size_t cell, size_t cols)
+{
+	if (it->thumb){
+		size_t x = (cell % cols) * batch.cw + ((batch.cw - it->tw) >> 1);
+		size_t y = (cell / cols) * batch.ch + ((batch.ch - it->th) >> 1);
+
+		for (size_t row = 0; row < it->th; row++)
+			memcpy(&cont->vidp[(y + row) * cont->pitch + x],
+				&it->thumb[row * it->tw], it->tw * sizeof(shmif_pixel));
+
+		arcan_shmif_dirty(cont, x, y, x + it->tw, y + it->th, 0);
+	}
+
+/* descr goes last as it is the field most likely to contain separators */
+	const char* base = strrchr(it->name, '/');
+	base = base ? base + 1 : it->name;
+
+	static const char fmt[] =
+		"item=%zu\tpage=%zu\tcell=%zu\tthumb=%zux%zu\tname=%s\tdescr=%s";
+	size_t tw = it->thumb ? it->tw : 0, th = it->thumb ? it->th : 0;
+	const char* descr = it->descr ? it->descr : "";
+
+	int len = snprintf(NULL, 0, fmt, it->index, page, cell, tw, th, base, descr);
+	char* msg = len > 0 ? malloc(len + 1) : NULL;
+	if (msg)
+		snprintf(msg, len + 1, fmt, it->index, page, cell, tw, th, base, descr);
+
+	if (msg)
+		shmif_msgchunk(cont, msg, len);
+	free(msg);
+}
+
+/*
+ * Batch mode: probe and thumbnail every regular file in a directory (path or
+ * received descriptor) or in a list of paths, with one libmagic handle per
+ * worker. Thumbnails are packed into an atlas in the segment and every item
+ * gets a message naming its page and cell, a new page starts over from cell 0
+ * once the atlas is full.
+ */
+static int run_batch(struct arcan_shmif_cont* cont,
+	struct arg_arr* args, int flags)
+{
+	const char* val;
+	bool scan_ok = false;
+
+	if (arg_lookup(args, "dir", 0, &val) && val){
+		DIR* dir = opendir(val);
+		if (dir){
+			scan_ok = scan_dir(dir);
+			batch.dirfd = dup(dirfd(dir));
+			closedir(dir);
+		}
+	}
+	else if (arg_lookup(args, "list", 0, &val) && val){
+		FILE* fpek = fopen(val, "r");
+		if (fpek){
+			scan_ok = scan_list(fpek);
+			fclose(fpek);
+		}
+	}
+	else {
+		int fd = wait_for_file(cont, "*", NULL);
+		struct stat st;
+		if (fd > 0 && 0 == fstat(fd, &st) && S_ISDIR(st.st_mode)){
+			DIR* dir = fdopendir(dup(fd));
+			if (dir){
+				scan_ok = scan_dir(dir);
+				closedir(dir);
+			}
+			batch.dirfd = fd;
+		}
+		else if (fd > 0)
+			close(fd);
+	}
+
+	if (!scan_ok || -1 == batch.dirfd){
+		arcan_shmif_last_words(cont, "batch: couldn't read dir, list or descriptor");
+		return EXIT_FAILURE;
+	}
+
+	batch.cw = batch.ch = BATCH_THUMB_DEFAULT;
+	if (arg_lookup(args, "thumb", 0, &val) && val){
+		size_t w = 0, h = 0;
+		if (2 == sscanf(val, "%zux%zu", &w, &h) || 1 == sscanf(val, "%zu", &w)){
+			batch.cw = w;
+			batch.ch = h ? h : w;
+		}
+	}
+	if (!batch.cw || !batch.ch || batch.cw > PP_SHMPAGE_MAXW / BATCH_ATLAS_COLS)
+		batch.cw = batch.ch = 0;
+
+	long workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (arg_lookup(args, "workers", 0, &val) && val)
+		workers = strtol(val, NULL, 10);
+	workers = workers < 1 ? 1 : (workers > BATCH_WORKER_LIMIT ? BATCH_WORKER_LIMIT : workers);
+	if ((size_t)workers > batch.n_names)
+		workers = batch.n_names ? batch.n_names : 1;
+
+/* each worker gets its own database handle as magic_t is not thread-safe */
+	magic_t magics[BATCH_WORKER_LIMIT];
+	for (long i = 0; i < workers; i++){
+		magics[i] = magic_open(flags);
+		if (!magics[i] || 0 != magic_load(magics[i], NULL)){
+			arcan_shmif_last_words(cont, "couldn't load magic database");
+			return EXIT_FAILURE;
+		}
+	}
+
+	size_t cols = BATCH_ATLAS_COLS;
+	size_t rows = (batch.n_names + cols - 1) / cols;
+	rows = rows > BATCH_ATLAS_COLS ? BATCH_ATLAS_COLS : (rows ? rows : 1);
+	while (rows > 1 && rows * batch.ch > PP_SHMPAGE_MAXH)
+		rows--;
+	size_t cells = cols * rows;
+
+	if (batch.cw){
+		cont->hints = SHMIF_RHINT_SUBREGION;
+		if (!arcan_shmif_resize_ext(cont, cols * batch.cw, rows * batch.ch,
+			(struct shmif_resize_ext){.vbuf_cnt = 1})){
+			arcan_shmif_last_words(cont, "batch: couldn't size atlas");
+			return EXIT_FAILURE;
+		}
+		batch_clear(cont);
+	}
+
+	if (-1 == pipe(batch.wake)){
+		arcan_shmif_last_words(cont, "batch: couldn't create wakeup pipe");
+		return EXIT_FAILURE;
+	}
+	fcntl(batch.wake[0], F_SETFL, O_NONBLOCK);
+	fcntl(batch.wake[0], F_SETFD, FD_CLOEXEC);
+	fcntl(batch.wake[1], F_SETFD, FD_CLOEXEC);
+
+/* paths in a list can be anywhere so keep read access */
+	struct shmif_privsep_node* node[1] = {NULL};
+	arcan_shmif_privsep(cont, "stdio rpath", node, 0);
+
+	pthread_t threads[BATCH_WORKER_LIMIT];
+	size_t n_threads = 0;
+	for (long i = 0; i < workers; i++){
+		if (0 == pthread_create(&threads[n_threads], NULL, batch_worker, magics[i]))
+			n_threads++;
+		else
+			magic_close(magics[i]);
+	}
+
+	if (!n_threads){
+		arcan_shmif_last_words(cont, "batch: couldn't start workers");
+		return EXIT_FAILURE;
+	}
+
+	size_t n_done = 0;
+	bool running = true;
+
+	while (running){
+		struct pollfd pfd[2] = {
+			{.fd = cont->epipe, .events = POLLIN | POLLERR | POLLHUP | POLLNVAL},
+			{.fd = batch.wake[0], .events = POLLIN}
+		};
+
+		if (-1 == poll(pfd, 2, -1) && errno != EINTR && errno != EAGAIN)
+			break;
+
+		if (pfd[1].revents & POLLIN){
+			uint8_t buf[64];
+			while (read(batch.wake[0], buf, sizeof(buf)) > 0){}
+		}
+
+		pthread_mutex_lock(&batch.lock);
+		struct batch_item* list = batch.done;
+		batch.done = NULL;
+		pthread_mutex_unlock(&batch.lock);
+
+		bool dirty = false;
+		while (list){
+			struct batch_item* it = list;
+			list = it->next;
+
+/* the previous page has been signalled and released, start over */
+			size_t cell = n_done % cells;
+			if (batch.cw && !cell && n_done){
+				batch_clear(cont);
+				dirty = true;
+			}
+
+			if (batch.cw){
+				batch_emit(cont, it, n_done / cells, cell, cols);
+				dirty |= it->thumb != NULL;
+			}
+			else
+				batch_emit(cont, it, 0, 0, 1);
+
+			n_done++;
+			free(it->descr);
+			free(it->thumb);
+			free(it);
+
+			if (dirty && n_done % cells == 0){
+				arcan_shmif_signal(cont, SHMIF_SIGVID);
+				dirty = false;
+			}
+		}
+
+		if (dirty)
+			arcan_shmif_signal(cont, SHMIF_SIGVID);
+
+		if (n_done == batch.n_names){
+			char msg[64];
+			int len = snprintf(msg, sizeof(msg), "batch=done:items=%zu", n_done);
+			shmif_msgchunk(cont, msg, len);
+			n_done++;
+		}
+
+		struct arcan_event ev;
+		int rc;
+		while ((rc = arcan_shmif_poll(cont, &ev)) > 0){
+			if (ev.category == EVENT_TARGET && ev.tgt.kind == TARGET_COMMAND_EXIT)
+				running = false;
+		}
+		if (rc < 0)
+			running = false;
+	}
+
+/* stop handing out work, whatever is in flight finishes and gets dropped */
+	pthread_mutex_lock(&batch.lock);
+	batch.next = batch.n_names;
+	pthread_mutex_unlock(&batch.lock);
+
+	for (size_t i = 0; i < n_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	while (batch.done){
+		struct batch_item* it = batch.done;
+		batch.done = it->next;
+		free(it->descr);
+		free(it->thumb);
+		free(it);
+	}
+
+	for (size_t i = 0; i < batch.n_names; i++)
+		free(batch.names[i]);
+	free(batch.names);
+
+	return EXIT_SUCCESS;
+}
+
 int decode_probe(struct arcan_shmif_cont* cont, struct arg_arr* args)
 {
 	int flags = 0;
@@ -36,6 +529,9 @@ int decode_probe(struct arcan_shmif_cont* cont, struct arg_arr* args)
 		}
 	}
 
+	if (arg_lookup(args, "batch", 0, NULL))
+		return run_batch(cont, args, flags);
+
 	magic_t magic = magic_open(flags);
 	if (!magic){
 		arcan_shmif_last_words(cont, "couldn't open magic-value database");
@@ -5,16 +5,442 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <pthread.h>
+#include <inttypes.h>
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/mman.h>
 
 #include "decode.h"
 
 /* reset / retry on sigsegv/sigabort due to mmap */
 
+/* The file is mapped but never swept up front. A background thread indexes
+ * the linefeeds, though only every INDEX_STRIDE:th line start is kept and the
+ * ones in between are found again by sweeping from the closest mark - that
+ * way a multi-GB log costs a fraction of its line count in index memory. */
+#define INDEX_STRIDE 64
+#define INDEX_CHUNK (1024 * 1024)
+
+/* The bufferwnd only gets a slice of lines around the view, and it is moved
+ * when the view comes close to either edge. Very long lines are capped on a
+ * number of bytes instead. */
+#define SLICE_LINES 4096
+#define SLICE_MARGIN 1024
+#define SLICE_BYTES (8 * 1024 * 1024)
+
+/* in follow mode the mapping reserves room past the end so that appends can
+ * be picked up without remapping, reaching into the reserve beyond the actual
+ * file size would fault so everything is bound by the known size */
+#define FOLLOW_RESERVE (256 * 1024 * 1024)
+#define FOLLOW_POLL_MS 250
+#define INDEX_POLL_MS 500
+
+struct text_state {
+	struct tui_context* tui;
+	int fd;
+	uint8_t* map;
+	size_t map_sz;
+	size_t size;
+
+	size_t slice_start;
+	size_t slice_end;
+
+	bool follow;
+	size_t tail_top;
+	size_t last_top;
+	char ident[64];
+
+	pthread_t indexer;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+/* protected by lock, the indexer only touches the mapping while busy and
+ * the main thread only remaps while it is paused */
+	bool shutdown;
+	bool paused;
+	bool busy;
+	size_t* marks;
+	size_t n_marks;
+	size_t marks_cap;
+	size_t n_lines;
+	size_t indexed;
+	size_t target;
+};
+
+static void* index_thread(void* tag)
+{
+	struct text_state* S = tag;
+	size_t* local = malloc(sizeof(size_t) * (INDEX_CHUNK / INDEX_STRIDE + 1));
+	if (!local)
+		return NULL;
+
+	pthread_mutex_lock(&S->lock);
+	for(;;){
+		while (!S->shutdown && (S->paused || S->indexed >= S->target)){
+			S->busy = false;
+			pthread_cond_broadcast(&S->cond);
+			pthread_cond_wait(&S->cond, &S->lock);
+		}
+
+		if (S->shutdown)
+			break;
+
+		S->busy = true;
+		uint8_t* base = S->map;
+		size_t pos = S->indexed;
+		size_t end = S->target - pos > INDEX_CHUNK ? pos + INDEX_CHUNK : S->target;
+		size_t lines = S->n_lines;
+		pthread_mutex_unlock(&S->lock);
+
+		size_t n_local = 0;
+		while (pos < end){
+			uint8_t* lf = memchr(&base[pos], '\n', end - pos);
+			if (!lf)
+				break;
+
+			pos = lf - base + 1;
+			if (++lines % INDEX_STRIDE == 0)
+				local[n_local++] = pos;
+		}
+
+		pthread_mutex_lock(&S->lock);
+		if (S->n_marks + n_local > S->marks_cap){
+			size_t cap = S->marks_cap * 2;
+			while (cap < S->n_marks + n_local)
+				cap *= 2;
+
+			size_t* marks = realloc(S->marks, cap * sizeof(size_t));
+			if (!marks){
+				S->busy = false;
+				pthread_cond_broadcast(&S->cond);
+				break;
+			}
+			S->marks = marks;
+			S->marks_cap = cap;
+		}
+
+		memcpy(&S->marks[S->n_marks], local, n_local * sizeof(size_t));
+		S->n_marks += n_local;
+		S->n_lines = lines;
+		S->indexed = end;
+	}
+
+	pthread_mutex_unlock(&S->lock);
+	free(local);
+	return NULL;
+}
+
+/* block the indexer so that the mapping and index can be replaced */
+static void index_pause(struct text_state* S)
+{
+	pthread_mutex_lock(&S->lock);
+	S->paused = true;
+	while (S->busy)
+		pthread_cond_wait(&S->cond, &S->lock);
+}
+
+static void index_resume(struct text_state* S)
+{
+	S->paused = false;
+	pthread_cond_broadcast(&S->cond);
+	pthread_mutex_unlock(&S->lock);
+}
+
+/* these two need the lock held, both sweep at most INDEX_STRIDE lines */
+static size_t line_offset(struct text_state* S, size_t line)
+{
+	if (line > S->n_lines)
+		line = S->n_lines;
+
+	size_t pos = S->marks[line / INDEX_STRIDE];
+	for (size_t i = line - line % INDEX_STRIDE; i < line; i++){
+		uint8_t* lf = memchr(&S->map[pos], '\n', S->indexed - pos);
+		if (!lf)
+			break;
+		pos = lf - S->map + 1;
+	}
+
+	return pos;
+}
+
+static size_t offset_line(struct text_state* S, size_t ofs)
+{
+	if (ofs >= S->indexed)
+		return S->n_lines;
+
+	size_t lo = 0, hi = S->n_marks;
+	while (hi - lo > 1){
+		size_t mid = lo + (hi - lo) / 2;
+		if (S->marks[mid] <= ofs)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	size_t line = lo * INDEX_STRIDE;
+	size_t pos = S->marks[lo];
+	while (pos < ofs){
+		uint8_t* lf = memchr(&S->map[pos], '\n', ofs - pos);
+		if (!lf)
+			break;
+		pos = lf - S->map + 1;
+		line++;
+	}
+
+	return line;
+}
+
+/* step forward to the start of the next line, if there is one before [end] */
+static size_t snap_line(struct text_state* S, size_t pos, size_t end)
+{
+	if (!pos || S->map[pos - 1] == '\n')
+		return pos;
+
+	uint8_t* lf = memchr(&S->map[pos], '\n', end - pos);
+	return lf ? lf - S->map + 1 : pos;
+}
+
+/* materialize the lines around [top] and hand them to the bufferwnd, the
+ * view is put back at the line holding [top] */
+static void set_slice(struct text_state* S, size_t top)
+{
+	if (!S->size)
+		return;
+
+	if (top >= S->size)
+		top = S->size - 1;
+
+	size_t start, end;
+	pthread_mutex_lock(&S->lock);
+	if (top < S->indexed){
+		size_t line = offset_line(S, top);
+		size_t first = line > SLICE_LINES / 2 ? line - SLICE_LINES / 2 : 0;
+		start = line_offset(S, first);
+		end = first + SLICE_LINES < S->n_lines ?
+			line_offset(S, first + SLICE_LINES) : S->size;
+	}
+/* not indexed this far yet, settle for bytes */
+	else {
+		start = top > SLICE_BYTES / 2 ? top - SLICE_BYTES / 2 : 0;
+		start = snap_line(S, start, top);
+		end = S->size - top > SLICE_BYTES / 2 ? top + SLICE_BYTES / 2 : S->size;
+	}
+	pthread_mutex_unlock(&S->lock);
+
+	if (end - start > SLICE_BYTES){
+		if (top - start > SLICE_BYTES / 2)
+			start = snap_line(S, top - SLICE_BYTES / 2, top);
+		if (end - start > SLICE_BYTES)
+			end = start + SLICE_BYTES;
+	}
+
+	S->slice_start = start;
+	S->slice_end = end;
+	arcan_tui_bufferwnd_synch(S->tui, &S->map[start], end - start, start);
+	arcan_tui_bufferwnd_seek(S->tui, top - start);
+	arcan_tui_bufferwnd_view(S->tui, &top, NULL);
+	S->last_top = start + top;
+}
+
+/* offset of the line that fills the last page, found by sweeping back from
+ * the end rather than through the index as appends might not be indexed */
+static size_t tail_offset(struct text_state* S)
+{
+	size_t rows, cols;
+	arcan_tui_dimensions(S->tui, &rows, &cols);
+
+	size_t pos = S->size;
+	size_t bound = S->size > SLICE_BYTES / 2 ? S->size - SLICE_BYTES / 2 : 0;
+	if (pos && S->map[pos - 1] == '\n')
+		pos--;
+
+	while (pos > bound && rows){
+		if (S->map[pos - 1] == '\n' && --rows == 0)
+			break;
+		pos--;
+	}
+
+	return pos;
+}
+
+static void jump_tail(struct text_state* S)
+{
+	set_slice(S, tail_offset(S));
+	S->tail_top = S->last_top;
+}
+
+/* keep the slice centered around the view, the edges at the start and
+ * end of the file stay where they are */
+static void track_view(struct text_state* S)
+{
+	size_t top;
+	arcan_tui_bufferwnd_view(S->tui, &top, NULL);
+	top += S->slice_start;
+	if (top == S->last_top)
+		return;
+	S->last_top = top;
+
+	pthread_mutex_lock(&S->lock);
+	size_t line = offset_line(S, top);
+	bool near_start = S->slice_start > 0 &&
+		line - offset_line(S, S->slice_start) < SLICE_MARGIN &&
+		top - S->slice_start < SLICE_BYTES / 4;
+	bool near_end = S->slice_end < S->size &&
+		offset_line(S, S->slice_end) - line < SLICE_MARGIN &&
+		S->slice_end - top < SLICE_BYTES / 4;
+	pthread_mutex_unlock(&S->lock);
+
+	if (near_start || near_end)
+		set_slice(S, top);
+}
+
+static bool remap(struct text_state* S, size_t size)
+{
+	size_t map_sz = size + (S->follow ? FOLLOW_RESERVE : 0);
+	if (!map_sz)
+		return false;
+
+	void* buf = mmap(NULL, map_sz, PROT_READ, MAP_SHARED, S->fd, 0);
+	if (buf == MAP_FAILED)
+		return false;
+
+	if (S->map)
+		munmap(S->map, S->map_sz);
+
+	S->map = buf;
+	S->map_sz = map_sz;
+	return true;
+}
+
+/* pick up appended data, only the new range gets indexed - a file that
+ * shrunk has most likely been truncated or rotated and is indexed again */
+static void check_growth(struct text_state* S)
+{
+	struct stat fs;
+	if (-1 == fstat(S->fd, &fs) || (size_t) fs.st_size == S->size)
+		return;
+
+	size_t top;
+	arcan_tui_bufferwnd_view(S->tui, &top, NULL);
+	top += S->slice_start;
+	bool tail = top >= S->tail_top;
+	bool shrunk = (size_t) fs.st_size < S->size;
+
+	index_pause(S);
+	bool moved = (size_t) fs.st_size > S->map_sz;
+	if (moved && !remap(S, fs.st_size)){
+		index_resume(S);
+		return;
+	}
+
+	if (shrunk){
+		S->n_marks = 1;
+		S->n_lines = 0;
+		S->indexed = 0;
+		tail = true;
+	}
+
+	size_t old_sz = S->size;
+	S->size = fs.st_size;
+	S->target = S->size;
+	index_resume(S);
+
+/* the bufferwnd still points into the old mapping if it moved */
+	if (tail)
+		jump_tail(S);
+	else if (moved || S->slice_end == old_sz)
+		set_slice(S, top);
+}
+
+static void update_ident(struct text_state* S)
+{
+	char buf[64];
+	size_t top;
+	arcan_tui_bufferwnd_view(S->tui, &top, NULL);
+
+	pthread_mutex_lock(&S->lock);
+	size_t line = offset_line(S, S->slice_start + top);
+	size_t n_lines = S->n_lines;
+	bool done = S->indexed >= S->target;
+	pthread_mutex_unlock(&S->lock);
+
+	snprintf(buf, sizeof(buf), "%zu/%zu%s%s", line + 1, n_lines + 1,
+		done ? "" : "+", S->follow ? " (follow)" : "");
+
+	if (strcmp(buf, S->ident) != 0){
+		memcpy(S->ident, buf, sizeof(buf));
+		arcan_tui_ident(S->tui, buf);
+	}
+}
+
+static const struct tui_labelent labels[] = {
+	{
+		.label = "FIRST",
+		.descr = "Go to the first line",
+		.initial = TUIK_HOME
+	},
+	{
+		.label = "LAST",
+		.descr = "Go to the last line",
+		.initial = TUIK_END
+	},
+	{
+		.label = "FOLLOW",
+		.descr = "Toggle following appends to the file",
+		.initial = TUIK_F8
+	}
+};
+
+static bool on_label_query(struct tui_context* T,
+	size_t index, const char* country, const char* lang,
+	struct tui_labelent* dstlbl, void* t)
+{
+	if (index >= sizeof(labels) / sizeof(labels[0]))
+		return false;
+
+	*dstlbl = labels[index];
+	return true;
+}
+
+static bool on_label_input(
+	struct tui_context* T, const char* label, bool active, void* tag)
+{
+	struct text_state* S = tag;
+	if (!active)
+		return true;
+
+	if (strcmp(label, "FIRST") == 0){
+		set_slice(S, 0);
+		return true;
+	}
+
+	if (strcmp(label, "LAST") == 0){
+		jump_tail(S);
+		return true;
+	}
+
+/* the mapping has no reserve without follow, so grab one on the way */
+	if (strcmp(label, "FOLLOW") == 0){
+		S->follow = !S->follow;
+		if (S->follow){
+			index_pause(S);
+			if (S->map_sz == S->size)
+				remap(S, S->size);
+			index_resume(S);
+			set_slice(S, S->last_top);
+			check_growth(S);
+			jump_tail(S);
+		}
+		return true;
+	}
+
+	return false;
+}
+
 static bool run_file_mmap(
-	struct arcan_shmif_cont* cont, int fd, int view)
+	struct arcan_shmif_cont* cont, int fd, int view, bool follow)
 {
 	struct stat fs;
 	if (-1 == fstat(fd, &fs)){
@@ -22,13 +448,33 @@ static bool run_file_mmap(
 		return false;
 	}
 
+	struct text_state S = {
+		.fd = fd,
+		.follow = follow,
+		.size = fs.st_size,
+		.target = fs.st_size,
+		.n_marks = 1,
+		.marks_cap = 1024
+	};
+
 /* on failure here we should just switch to the streaming version */
-	void* buf = mmap(NULL, fs.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-	if (buf == MAP_FAILED){
+	if (!remap(&S, S.size)){
 		arcan_shmif_last_words(cont, "couldn't mmap source");
 		return false;
 	}
 
+	S.marks = malloc(S.marks_cap * sizeof(size_t));
+	if (!S.marks){
+		munmap(S.map, S.map_sz);
+		arcan_shmif_last_words(cont, "couldn't allocate line index");
+		return false;
+	}
+	S.marks[0] = 0;
+
+	pthread_mutex_init(&S.lock, NULL);
+	pthread_cond_init(&S.cond, NULL);
+	bool threaded = 0 == pthread_create(&S.indexer, NULL, index_thread, &S);
+
 	struct tui_bufferwnd_opts opts = {
 		.read_only = true,
 		.view_mode = view,
@@ -36,21 +482,54 @@ static bool run_file_mmap(
 		.allow_exit = false
 	};
 
-	struct tui_context* tui =
-		arcan_tui_setup(cont, NULL, &(struct tui_cbcfg){}, sizeof(struct tui_cbcfg));
-	arcan_tui_bufferwnd_setup(tui, buf,
-		fs.st_size, &opts, sizeof(struct tui_bufferwnd_opts));
+	struct tui_cbcfg cbcfg = {
+		.tag = &S,
+		.query_label = on_label_query,
+		.input_label = on_label_input
+	};
+
+	S.tui = arcan_tui_setup(cont, NULL, &cbcfg, sizeof(struct tui_cbcfg));
+	arcan_tui_bufferwnd_setup(S.tui, S.map,
+		S.size < SLICE_BYTES ? S.size : SLICE_BYTES,
+		&opts, sizeof(struct tui_bufferwnd_opts));
+
+	if (follow)
+		jump_tail(&S);
+	else
+		set_slice(&S, 0);
+
+	while(1 == arcan_tui_bufferwnd_status(S.tui)){
+		pthread_mutex_lock(&S.lock);
+		bool indexing = threaded && S.indexed < S.target;
+		pthread_mutex_unlock(&S.lock);
+
+		struct tui_process_res res = arcan_tui_process(&S.tui, 1, NULL, 0,
+			S.follow ? FOLLOW_POLL_MS : (indexing ? INDEX_POLL_MS : -1));
 
-	while(1 == arcan_tui_bufferwnd_status(tui)){
-		struct tui_process_res res = arcan_tui_process(&tui, 1, NULL, 0, -1);
 		if (res.errc == TUI_ERRC_OK){
-			if (-1 == arcan_tui_refresh(tui) && errno == EINVAL)
+			if (S.follow)
+				check_growth(&S);
+			track_view(&S);
+			update_ident(&S);
+
+			if (-1 == arcan_tui_refresh(S.tui) && errno == EINVAL)
 				break;
 		}
 	}
 
-	arcan_tui_destroy(tui, NULL);
-	munmap(buf, fs.st_size);
+	if (threaded){
+		pthread_mutex_lock(&S.lock);
+		S.shutdown = true;
+		pthread_cond_broadcast(&S.cond);
+		pthread_mutex_unlock(&S.lock);
+		pthread_join(S.indexer, NULL);
+	}
+
+	arcan_tui_destroy(S.tui, NULL);
+	pthread_cond_destroy(&S.cond);
+	pthread_mutex_destroy(&S.lock);
+	munmap(S.map, S.map_sz);
+	free(S.marks);
 	return true;
 }
 
@@ -78,7 +557,9 @@ int decode_text(struct arcan_shmif_cont* cont, struct arg_arr* args)
 			view = BUFFERWND_VIEW_ASCII;
 	}
 
-	if (!run_file_mmap(cont, fd, view)){
+	bool follow = arg_lookup(args, "follow", 0, NULL);
+
+	if (!run_file_mmap(cont, fd, view, follow)){
 /* fallback to streaming? */
 	}
 
@@ -0,0 +1,458 @@
+/*
+ * Streaming image decoding for decode_img, used when the source would be too
+ * large to decode in full before showing anything (gigapixel scans and such).
+ *
+ * Both decoders hand over one source row at a time to a box filter that
+ * accumulates into a single output row, so the only allocations are a row of
+ * the source and a row of sums. JPEG also uses the DCT scaling to get within
+ * a factor of two of the output before any pixels are produced at all, and
+ * libjpeg-turbo lets us crop / skip outside of the decoded region.
+ */
+#include <arcan_shmif.h>
+#include <setjmp.h>
+
+#ifdef HAVE_IMG_JPEG
+#include <jpeglib.h>
+#endif
+
+#ifdef HAVE_IMG_PNG
+#include <png.h>
+#endif
+
+#include "img_stream.h"
+
+/* report progress in steps of at least this many output rows */
+#define ROW_STEP 64
+
+struct resampler {
+	size_t sw, sh, channels;
+	shmif_pixel* dst;
+	size_t dw, dh, pitch;
+
+	uint64_t* acc;
+	uint32_t* ccnt;
+	size_t rcnt;
+	size_t sy, oy, reported;
+
+	img_stream_rows cb;
+	void* tag;
+};
+
+static bool resampler_begin(struct resampler* R, size_t sw, size_t sh, size_t n)
+{
+	if (!sw || !sh || !R->dw || !R->dh)
+		return false;
+
+	R->sw = sw;
+	R->sh = sh;
+	R->channels = n;
+	R->rcnt = R->sy = R->oy = R->reported = 0;
+
+	R->acc = calloc(R->dw * 4, sizeof(uint64_t));
+	R->ccnt = calloc(R->dw, sizeof(uint32_t));
+	if (!R->acc || !R->ccnt){
+		free(R->acc);
+		free(R->ccnt);
+		R->acc = NULL;
+		R->ccnt = NULL;
+		return false;
+	}
+
+/* number of source columns that land in each output one */
+	if (sw >= R->dw){
+		for (size_t x = 0; x < sw; x++)
+			R->ccnt[x * R->dw / sw]++;
+	}
+	else {
+		for (size_t x = 0; x < R->dw; x++)
+			R->ccnt[x] = 1;
+	}
+
+	return true;
+}
+
+static void report(struct resampler* R, bool force)
+{
+	if (R->cb && R->oy > R->reported &&
+		(force || R->oy - R->reported >= ROW_STEP)){
+		R->cb(R->reported, R->oy, R->tag);
+		R->reported = R->oy;
+	}
+}
+
+static void emit_rows(struct resampler* R, size_t end)
+{
+	if (!R->rcnt)
+		return;
+
+	shmif_pixel* out = &R->dst[R->oy * R->pitch];
+	for (size_t x = 0; x < R->dw; x++){
+		uint64_t* a = &R->acc[x * 4];
+		uint64_t d = (uint64_t) R->ccnt[x] * R->rcnt;
+		out[x] = SHMIF_RGBA(a[0] / d, a[1] / d, a[2] / d, a[3] / d);
+	}
+
+/* upscaling, one source row covers several output ones */
+	for (size_t y = R->oy + 1; y < end && y < R->dh; y++)
+		memcpy(&R->dst[y * R->pitch], out, R->dw * sizeof(shmif_pixel));
+
+	R->oy = end < R->dh ? end : R->dh;
+	R->rcnt = 0;
+	memset(R->acc, '\0', R->dw * 4 * sizeof(uint64_t));
+	report(R, false);
+}
+
+static void resample_row(struct resampler* R, const uint8_t* row)
+{
+	size_t n = R->channels;
+
+	if (R->sw >= R->dw){
+		for (size_t x = 0; x < R->sw; x++){
+			const uint8_t* px = &row[x * n];
+			uint64_t* a = &R->acc[(x * R->dw / R->sw) * 4];
+			a[0] += px[0];
+			a[1] += px[1];
+			a[2] += px[2];
+			a[3] += n == 4 ? px[3] : 0xff;
+		}
+	}
+	else {
+		for (size_t x = 0; x < R->dw; x++){
+			const uint8_t* px = &row[(x * R->sw / R->dw) * n];
+			uint64_t* a = &R->acc[x * 4];
+			a[0] += px[0];
+			a[1] += px[1];
+			a[2] += px[2];
+			a[3] += n == 4 ? px[3] : 0xff;
+		}
+	}
+
+	R->rcnt++;
+	R->sy++;
+
+/* the output row is complete when the next source row maps past it */
+	size_t end = R->sy * R->dh / R->sh;
+	if (end > R->oy)
+		emit_rows(R, end);
+}
+
+static void resampler_end(struct resampler* R)
+{
+	emit_rows(R, R->dh);
+
+/* rounding can leave the last row(s) without a source */
+	for (size_t y = R->oy; y > 0 && y < R->dh; y++)
+		memcpy(&R->dst[y * R->pitch],
+			&R->dst[(y - 1) * R->pitch], R->dw * sizeof(shmif_pixel));
+
+	R->oy = R->dh;
+	report(R, true);
+
+	free(R->acc);
+	free(R->ccnt);
+	R->acc = NULL;
+	R->ccnt = NULL;
+}
+
+/* map a region in source pixels to a decoded image reduced by [num / den] */
+static struct img_stream_region scale_region(
+	struct img_stream_region reg, size_t num, size_t den, size_t w, size_t h)
+{
+	struct img_stream_region res = {
+		.x = reg.x * num / den,
+		.y = reg.y * num / den,
+		.w = (reg.w * num + den - 1) / den,
+		.h = (reg.h * num + den - 1) / den
+	};
+
+	if (res.x >= w)
+		res.x = w - 1;
+	if (res.y >= h)
+		res.y = h - 1;
+	if (!res.w || res.x + res.w > w)
+		res.w = w - res.x;
+	if (!res.h || res.y + res.h > h)
+		res.h = h - res.y;
+
+	return res;
+}
+
+#ifdef HAVE_IMG_JPEG
+struct jpeg_bail {
+	struct jpeg_error_mgr mgr;
+	jmp_buf jmp;
+};
+
+static void jpeg_error(j_common_ptr cinfo)
+{
+	struct jpeg_bail* err = (struct jpeg_bail*) cinfo->err;
+	(*cinfo->err->output_message)(cinfo);
+	longjmp(err->jmp, 1);
+}
+
+static bool jpeg_magic(const uint8_t* buf, size_t sz)
+{
+	return sz > 3 && buf[0] == 0xff && buf[1] == 0xd8 && buf[2] == 0xff;
+}
+
+static bool jpeg_probe(const uint8_t* buf, size_t sz, size_t* w, size_t* h)
+{
+	struct jpeg_decompress_struct cinfo;
+	struct jpeg_bail err;
+
+	cinfo.err = jpeg_std_error(&err.mgr);
+	err.mgr.error_exit = jpeg_error;
+	if (setjmp(err.jmp)){
+		jpeg_destroy_decompress(&cinfo);
+		return false;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, (unsigned char*) buf, sz);
+	jpeg_read_header(&cinfo, TRUE);
+	*w = cinfo.image_width;
+	*h = cinfo.image_height;
+	jpeg_destroy_decompress(&cinfo);
+
+	return true;
+}
+
+static bool jpeg_stream(const uint8_t* buf, size_t sz,
+	struct img_stream_region reg, struct resampler* R, bool preview)
+{
+	struct jpeg_decompress_struct cinfo;
+	struct jpeg_bail err;
+	uint8_t* volatile row = NULL;
+
+	cinfo.err = jpeg_std_error(&err.mgr);
+	err.mgr.error_exit = jpeg_error;
+	if (setjmp(err.jmp)){
+		jpeg_destroy_decompress(&cinfo);
+		free(row);
+		free(R->acc);
+		free(R->ccnt);
+		R->acc = NULL;
+		R->ccnt = NULL;
+		return false;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, (unsigned char*) buf, sz);
+	jpeg_read_header(&cinfo, TRUE);
+	cinfo.out_color_space = JCS_RGB;
+
+/* the largest DCT reduction that still covers the output resolution */
+	unsigned den = 8;
+	while (!preview && den > 1 && (reg.w / den < R->dw || reg.h / den < R->dh))
+		den >>= 1;
+
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = den;
+	if (preview){
+		cinfo.dct_method = JDCT_IFAST;
+		cinfo.do_fancy_upsampling = FALSE;
+		cinfo.do_block_smoothing = FALSE;
+	}
+
+	jpeg_start_decompress(&cinfo);
+	struct img_stream_region sr = scale_region(reg,
+		cinfo.output_width, cinfo.image_width, cinfo.output_width, cinfo.output_height);
+
+/* crop + skip means the parts outside of the region are never dequantized */
+	JDIMENSION xofs = sr.x;
+#ifdef LIBJPEG_TURBO_VERSION
+	if (sr.x || sr.w < cinfo.output_width){
+		JDIMENSION cw = sr.w;
+		jpeg_crop_scanline(&cinfo, &xofs, &cw);
+	}
+	else
+		xofs = 0;
+
+	if (sr.y)
+		jpeg_skip_scanlines(&cinfo, sr.y);
+#else
+	xofs = 0;
+#endif
+
+	row = malloc(cinfo.output_width * cinfo.output_components);
+	if (!row || !resampler_begin(R, sr.w, sr.h, cinfo.output_components)){
+		jpeg_destroy_decompress(&cinfo);
+		free(row);
+		return false;
+	}
+
+	while (cinfo.output_scanline < sr.y + sr.h){
+		JSAMPROW rp = row;
+		size_t y = cinfo.output_scanline;
+		if (1 != jpeg_read_scanlines(&cinfo, &rp, 1))
+			break;
+
+		if (y >= sr.y)
+			resample_row(R, &row[(sr.x - xofs) * cinfo.output_components]);
+	}
+
+	resampler_end(R);
+	jpeg_abort_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	free(row);
+	return true;
+}
+#endif
+
+#ifdef HAVE_IMG_PNG
+struct png_src {
+	const uint8_t* buf;
+	size_t sz, ofs;
+};
+
+static void png_read_mem(png_structp png, png_bytep out, png_size_t n)
+{
+	struct png_src* src = png_get_io_ptr(png);
+	if (n > src->sz - src->ofs)
+		png_error(png, "truncated source");
+
+	memcpy(out, &src->buf[src->ofs], n);
+	src->ofs += n;
+}
+
+static bool png_magic(const uint8_t* buf, size_t sz)
+{
+	return sz > 24 && png_sig_cmp((png_const_bytep) buf, 0, 8) == 0;
+}
+
+static bool png_probe(const uint8_t* buf, size_t sz, size_t* w, size_t* h)
+{
+/* IHDR is always first, no need to setup the decoder */
+	*w = (size_t) buf[16] << 24 | buf[17] << 16 | buf[18] << 8 | buf[19];
+	*h = (size_t) buf[20] << 24 | buf[21] << 16 | buf[22] << 8 | buf[23];
+	return *w && *h;
+}
+
+static bool png_stream(const uint8_t* buf, size_t sz,
+	struct img_stream_region reg, struct resampler* R, bool preview)
+{
+	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	png_infop info = png ? png_create_info_struct(png) : NULL;
+	uint8_t* volatile row = NULL;
+
+	if (!info){
+		png_destroy_read_struct(&png, NULL, NULL);
+		return false;
+	}
+
+	if (setjmp(png_jmpbuf(png))){
+		png_destroy_read_struct(&png, &info, NULL);
+		free(row);
+		free(R->acc);
+		free(R->ccnt);
+		R->acc = NULL;
+		R->ccnt = NULL;
+		return false;
+	}
+
+	struct png_src src = {.buf = buf, .sz = sz};
+	png_set_read_fn(png, &src, png_read_mem);
+
+/* sources this large is the point, so lift the default dimension limits */
+	png_set_user_limits(png, 0x7fffffff, 0x7fffffff);
+	png_read_info(png, info);
+
+	bool interlaced = png_get_interlace_type(png, info) != PNG_INTERLACE_NONE;
+
+/* deinterlacing needs the full image, leave it to the non-streaming path,
+ * while the first pass on its own makes for a free 1/8 preview */
+	if (interlaced != preview){
+		png_destroy_read_struct(&png, &info, NULL);
+		return false;
+	}
+
+	png_set_expand(png);
+	png_set_strip_16(png);
+	png_set_gray_to_rgb(png);
+	png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
+	png_read_update_info(png, info);
+
+	size_t w = png_get_image_width(png, info);
+	size_t h = png_get_image_height(png, info);
+	size_t nrows = h;
+	struct img_stream_region sr = scale_region(reg, 1, 1, w, h);
+
+/* without interlace handling the passes come out as reduced images */
+	if (interlaced){
+		size_t pw = PNG_PASS_COLS(w, 0);
+		nrows = PNG_PASS_ROWS(h, 0);
+		sr = scale_region(reg, pw, w, pw, nrows);
+	}
+
+	row = malloc(png_get_rowbytes(png, info));
+	if (!row || !resampler_begin(R, sr.w, sr.h, 4)){
+		png_destroy_read_struct(&png, &info, NULL);
+		free(row);
+		return false;
+	}
+
+/* rows above the region still have to be inflated, but not kept */
+	for (size_t y = 0; y < nrows && y < sr.y + sr.h; y++){
+		png_read_row(png, row, NULL);
+		if (y >= sr.y)
+			resample_row(R, &row[sr.x * 4]);
+	}
+
+	resampler_end(R);
+	png_destroy_read_struct(&png, &info, NULL);
+	free(row);
+	return true;
+}
+#endif
+
+bool img_stream_probe(const uint8_t* buf, size_t sz, size_t* w, size_t* h)
+{
+#ifdef HAVE_IMG_JPEG
+	if (jpeg_magic(buf, sz))
+		return jpeg_probe(buf, sz, w, h);
+#endif
+
+#ifdef HAVE_IMG_PNG
+	if (png_magic(buf, sz))
+		return png_probe(buf, sz, w, h);
+#endif
+
+	return false;
+}
+
+bool img_stream_decode(const uint8_t* buf, size_t sz,
+	struct img_stream_region region, shmif_pixel* dst,
+	size_t dw, size_t dh, size_t pitch, bool preview,
+	img_stream_rows cb, void* tag)
+{
+	struct resampler R = {
+		.dst = dst,
+		.dw = dw,
+		.dh = dh,
+		.pitch = pitch,
+		.cb = cb,
+		.tag = tag
+	};
+
+	size_t sw, sh;
+	if (!img_stream_probe(buf, sz, &sw, &sh))
+		return false;
+
+	if (!region.w || !region.h)
+		region = (struct img_stream_region){.w = sw, .h = sh};
+
+	if (region.x >= sw || region.y >= sh)
+		return false;
+
+#ifdef HAVE_IMG_JPEG
+	if (jpeg_magic(buf, sz))
+		return jpeg_stream(buf, sz, region, &R, preview);
+#endif
+
+#ifdef HAVE_IMG_PNG
+	if (png_magic(buf, sz))
+		return png_stream(buf, sz, region, &R, preview);
+#endif
+
+	return false;
+}
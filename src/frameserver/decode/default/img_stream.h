@@ -0,0 +1,37 @@
+#ifndef HAVE_IMG_STREAM_SUPPORT
+#define HAVE_IMG_STREAM_SUPPORT
+
+/*
+ * Row-streaming decoders for large JPEG and PNG sources. Rows are decoded one
+ * at a time and resampled straight into the output buffer, so memory use
+ * follows the output resolution rather than that of the source.
+ */
+struct img_stream_region {
+	size_t x, y, w, h;
+};
+
+/*
+ * Check if [buf] is in a format that can be streamed and retrieve the source
+ * dimensions without decoding anything.
+ */
+bool img_stream_probe(const uint8_t* buf, size_t sz, size_t* w, size_t* h);
+
+/*
+ * Invoked with each range of output rows [y1, y2> that has been completed.
+ */
+typedef void (*img_stream_rows)(size_t y1, size_t y2, void* tag);
+
+/*
+ * Decode [region] of the source (in source pixels) and resample it into the
+ * [dw * dh] buffer at [dst] with [pitch] pixels between rows.
+ *
+ * With [preview] set, only a cheap reduced pass is decoded (1/8 DCT scaling
+ * for JPEG, the first Adam7 pass for interlaced PNG). Returns false if the
+ * format has no such pass, or on decode failure.
+ */
+bool img_stream_decode(const uint8_t* buf, size_t sz,
+	struct img_stream_region region, shmif_pixel* dst,
+	size_t dw, size_t dh, size_t pitch, bool preview,
+	img_stream_rows cb, void* tag);
+
+#endif
@@ -30,65 +30,225 @@
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <math.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#ifdef HAVE_IMG_JPEG
+#include <stdio.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+
+#if defined(__SSE2__) && !defined(UVC_NO_SIMD)
+#include <emmintrin.h>
+#define UVC_SIMD_SSE2
+#endif
+
+#define UVC_CAMERA_LIMIT 16
+#define UVC_WORKER_LIMIT 16
+
+#ifdef HAVE_IMG_JPEG
+struct jpeg_bail {
+	struct jpeg_error_mgr mgr;
+	jmp_buf jmp;
+};
+#endif
 
-static int video_buffer_count = 1;
-static bool h264_passthrough = false;
+/*
+ * One per opened device. The stream thread that libuvc runs per device only
+ * copies the frame into [pending], decoding and the segment itself belong to
+ * whichever pool worker currently holds the camera.
+ */
+struct uvc_cam {
+	struct arcan_shmif_cont* cont;
+	uvc_device_handle_t* devh;
+	uvc_stream_ctrl_t ctrl;
+	bool streaming;
+	bool h264_passthrough;
+	bool yuyv_nv12;
+	int vbufc;
+
+/* a frame that hasn't been picked up before the next one arrives is replaced */
+	pthread_mutex_t lock;
+	uvc_frame_t* pending;
+	uvc_frame_t* work;
+	bool has_pending;
+	size_t dropped;
+
+/* pool scheduling, protected by the pool lock */
+	bool queued, busy, dead;
+	struct uvc_cam* next;
+
+/* decoder state */
+	struct SwsContext* scaler;
+	const AVCodec* codec;
+	AVCodecContext* decode;
+	AVCodecParserContext* parser;
+	AVFrame* frame;
+	AVPacket* packet;
+#ifdef HAVE_IMG_JPEG
+	struct jpeg_decompress_struct jpeg;
+	struct jpeg_bail jerr;
+	bool jpeg_init;
+	uint8_t* jpeg_row;
+#endif
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct uvc_cam* head;
+	struct uvc_cam* tail;
+	bool shutdown;
+	int wake[2];
+	pthread_t workers[UVC_WORKER_LIMIT];
+	size_t n_workers;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.wake = {-1, -1}
+};
+
+static void cam_fail(struct uvc_cam* cam, const char* msg)
+{
+	arcan_shmif_last_words(cam->cont, msg);
+
+	pthread_mutex_lock(&pool.lock);
+	cam->dead = true;
+	pthread_mutex_unlock(&pool.lock);
+
+	uint8_t ch = 0;
+	write(pool.wake[1], &ch, 1);
+}
 
-/* should also have the option to convert to GPU texture here and pass
- * onwards rather than paying the conversion proce like this */
 static uint8_t clamp_u8(int v, int low, int high)
 {
 	return
 		v < low ? low : (v > high ? high : v);
 }
 
-static shmif_pixel ycbcr(int y, int cb, int cr)
+/*
+ * BT.601 limited range in 6-bit fixed point. The vector version works on
+ * 16-bit lanes with saturation, and every case that saturates clamps to the
+ * same value as here.
+ */
+#define YUV_CY 75
+#define YUV_CRV 102
+#define YUV_CGU 25
+#define YUV_CGV 52
+#define YUV_CBU 129
+
+static inline shmif_pixel yuv_px(int y, int u, int v)
 {
-	double r = y + (1.4065 * (cr - 128));
-	double g = y - (0.3455 * (cb - 128)) - (0.7169 * (cr - 128));
-	double b = y + (1.7790 * (cb - 128));
 	return
 		SHMIF_RGBA(
-			clamp_u8(r, 0, 255),
-			clamp_u8(g, 0, 255),
-			clamp_u8(b, 0, 255),
+			clamp_u8((y + YUV_CRV * v) >> 6, 0, 255),
+			clamp_u8((y - YUV_CGU * u - YUV_CGV * v) >> 6, 0, 255),
+			clamp_u8((y + YUV_CBU * u) >> 6, 0, 255),
 			0xff
 		);
 }
-static void frame_uyvy(uvc_frame_t* frame, struct arcan_shmif_cont* dst)
-{
-	uint8_t* buf = frame->data;
 
-	for (size_t y = 0; y < frame->height; y++){
-		shmif_pixel* vidp = &dst->vidp[y * dst->pitch];
-		for (size_t x = 0; x < frame->width; x+=2){
-			vidp[x+0] = ycbcr(buf[1], buf[0], buf[2]);
-			vidp[x+1] = ycbcr(buf[3], buf[0], buf[2]);
-			buf += 4;
-		}
+/* packed 4:2:2, YUYV = Y0 U Y1 V and UYVY = U Y0 V Y1 */
+static void yuv422_row(
+	const uint8_t* src, shmif_pixel* dst, size_t n, bool uyvy)
+{
+	int yo = uyvy ? 1 : 0;
+	int uo = uyvy ? 0 : 1;
+	int vo = uyvy ? 2 : 3;
+
+	size_t x = 0;
+	for (; x + 2 <= n; x += 2, src += 4){
+		int u = src[uo] - 128;
+		int v = src[vo] - 128;
+		dst[x+0] = yuv_px((src[yo + 0] - 16) * YUV_CY, u, v);
+		dst[x+1] = yuv_px((src[yo + 2] - 16) * YUV_CY, u, v);
 	}
 
-	arcan_shmif_signal(dst, SHMIF_SIGVID);
+	if (x < n)
+		dst[x] = yuv_px((src[yo] - 16) * YUV_CY, src[uo] - 128, src[vo] - 128);
 }
 
-static void run_swscale(
-	uvc_frame_t* frame, struct arcan_shmif_cont* dst, int planes, int fmt)
+#ifdef UVC_SIMD_SSE2
+static inline __m128i clamp_epi16(__m128i v)
 {
-	static struct SwsContext* scaler;
-	static int old_fmt = -1;
+	return _mm_min_epi16(
+		_mm_max_epi16(_mm_srai_epi16(v, 6), _mm_setzero_si128()), _mm_set1_epi16(255));
+}
 
-	if (fmt != old_fmt && scaler){
-		sws_freeContext(scaler);
-		scaler = NULL;
-	}
+static void yuv422_row_sse2(
+	const uint8_t* src, shmif_pixel* dst, size_t n, bool uyvy)
+{
+	const __m128i lo8 = _mm_set1_epi16(0xff);
+	const __m128i lo16 = _mm_set1_epi32(0xffff);
+	const __m128i alpha = _mm_set1_epi16(0xff00);
+	const bool rlow = SHMIF_RGBA(0xff, 0x00, 0x00, 0x00) == 0xff;
+	size_t x = 0;
+
+	for (; x + 8 <= n; x += 8){
+		__m128i v = _mm_loadu_si128((const __m128i*) &src[x * 2]);
+		__m128i y = uyvy ? _mm_srli_epi16(v, 8) : _mm_and_si128(v, lo8);
+		__m128i c = uyvy ? _mm_and_si128(v, lo8) : _mm_srli_epi16(v, 8);
+
+/* chroma comes as U, V pairs per 32-bit lane, spread each over both pixels */
+		__m128i cu = _mm_and_si128(c, lo16);
+		__m128i cv = _mm_srli_epi32(c, 16);
+		cu = _mm_sub_epi16(_mm_or_si128(cu, _mm_slli_epi32(cu, 16)), _mm_set1_epi16(128));
+		cv = _mm_sub_epi16(_mm_or_si128(cv, _mm_slli_epi32(cv, 16)), _mm_set1_epi16(128));
+		y = _mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), _mm_set1_epi16(YUV_CY));
+
+		__m128i r = _mm_adds_epi16(y, _mm_mullo_epi16(cv, _mm_set1_epi16(YUV_CRV)));
+		__m128i g = _mm_subs_epi16(
+			_mm_subs_epi16(y, _mm_mullo_epi16(cu, _mm_set1_epi16(YUV_CGU))),
+			_mm_mullo_epi16(cv, _mm_set1_epi16(YUV_CGV))
+		);
+		__m128i b = _mm_adds_epi16(y, _mm_mullo_epi16(cu, _mm_set1_epi16(YUV_CBU)));
 
-	if (!scaler){
-		scaler = sws_getContext(
-			frame->width, frame->height, fmt,
-			dst->w, dst->h, AV_PIX_FMT_BGRA, SWS_BILINEAR, NULL, NULL, NULL);
+		r = clamp_epi16(r);
+		g = _mm_slli_epi16(clamp_epi16(g), 8);
+		b = clamp_epi16(b);
+
+		__m128i lo = _mm_or_si128(rlow ? r : b, g);
+		__m128i hi = _mm_or_si128(rlow ? b : r, alpha);
+		_mm_storeu_si128((__m128i*) &dst[x], _mm_unpacklo_epi16(lo, hi));
+		_mm_storeu_si128((__m128i*) &dst[x + 4], _mm_unpackhi_epi16(lo, hi));
 	}
 
-	if (!scaler)
+	yuv422_row(&src[x * 2], &dst[x], n - x, uyvy);
+}
+#endif
+
+static void frame_yuv422(
+	uvc_frame_t* frame, struct arcan_shmif_cont* dst, bool uyvy)
+{
+	size_t step = frame->step ? frame->step : frame->width * 2;
+	if (step * frame->height > frame->data_bytes)
+		return;
+
+	for (size_t y = 0; y < frame->height; y++)
+#ifdef UVC_SIMD_SSE2
+		yuv422_row_sse2(
+#else
+		yuv422_row(
+#endif
+			&((uint8_t*)frame->data)[y * step],
+			&dst->vidp[y * dst->pitch], frame->width, uyvy
+		);
+
+	arcan_shmif_signal(dst, SHMIF_SIGVID);
+}
+
+static void run_swscale(struct uvc_cam* cam,
+	uvc_frame_t* frame, struct arcan_shmif_cont* dst, int planes, int fmt)
+{
+	cam->scaler = sws_getCachedContext(cam->scaler,
+		frame->width, frame->height, fmt,
+		dst->w, dst->h, AV_PIX_FMT_BGRA, SWS_BILINEAR, NULL, NULL, NULL);
+
+	if (!cam->scaler)
 		return;
 
 	int dst_stride[] = {dst->stride};
@@ -99,67 +259,133 @@ static void run_swscale(
 
 	if (planes > 1){
 		size_t hw = (frame->width + 1) >> 1;
-		size_t hh = (frame->height + 1) >> 1;
 
-		data[1] = frame->data + bsz;
+		data[1] = (uint8_t*) frame->data + bsz;
 		lines[1] = frame->width;
 
 		if (planes > 2){
 			lines[1] = hw;
-			data[2] = frame->data + bsz + hw;
+			data[2] = (uint8_t*) frame->data + bsz + hw;
 			lines[2] = hw;
 		}
 	}
 
-	sws_scale(scaler, data, lines, 0, frame->height, dst_buf, dst_stride);
+	sws_scale(cam->scaler, data, lines, 0, frame->height, dst_buf, dst_stride);
 	arcan_shmif_signal(dst, SHMIF_SIGVID);
 }
 
-static void frame_ffmpeg(
-	uvc_frame_t* uvc, struct arcan_shmif_cont* cont, int fmt, const char* fmtstr)
+#ifdef HAVE_IMG_JPEG
+static void jpeg_error(j_common_ptr cinfo)
 {
-	static const AVCodec* codec;
-	static AVCodecContext* decode;
-	static AVCodecParserContext* parser;
-	static AVFrame* frame;
-	static AVPacket* packet;
-
-/* use to free / reset parser context */
-	if (!uvc){
-		if (decode)
-			avcodec_free_context(&decode);
-		if (parser)
-			parser = (av_parser_close(parser), NULL);
-		if (packet)
-			av_packet_free(&packet);
-		if (frame)
-			av_frame_free(&frame);
-		return;
+	struct jpeg_bail* err = (struct jpeg_bail*) cinfo->err;
+	longjmp(err->jmp, 1);
+}
+
+/*
+ * MJPEG frames are decoded straight into the segment rows, with turbo the
+ * colour conversion lands in the shmif packing directly. Frames without
+ * huffman tables (common for UVC) are covered by the library defaults.
+ */
+static bool frame_jpeg(struct uvc_cam* cam,
+	uvc_frame_t* frame, struct arcan_shmif_cont* dst)
+{
+	struct jpeg_decompress_struct* J = &cam->jpeg;
+
+	if (!cam->jpeg_init){
+		J->err = jpeg_std_error(&cam->jerr.mgr);
+		cam->jerr.mgr.error_exit = jpeg_error;
+		jpeg_create_decompress(J);
+		cam->jpeg_init = true;
+	}
+
+	if (setjmp(cam->jerr.jmp)){
+		jpeg_abort_decompress(J);
+		return false;
+	}
+
+	jpeg_mem_src(J, frame->data, frame->data_bytes);
+	if (JPEG_HEADER_OK != jpeg_read_header(J, TRUE)){
+		jpeg_abort_decompress(J);
+		return false;
+	}
+
+#ifdef JCS_EXTENSIONS
+	J->out_color_space =
+		SHMIF_RGBA(0xff, 0x00, 0x00, 0x00) == 0xff ? JCS_EXT_RGBX : JCS_EXT_BGRX;
+#else
+	J->out_color_space = JCS_RGB;
+#endif
+	jpeg_start_decompress(J);
+
+	if (J->output_width > dst->w || J->output_height > dst->h){
+		jpeg_abort_decompress(J);
+		return false;
+	}
+
+#ifndef JCS_EXTENSIONS
+	if (!cam->jpeg_row)
+		cam->jpeg_row = malloc(PP_SHMPAGE_MAXW * 3);
+	if (!cam->jpeg_row){
+		jpeg_abort_decompress(J);
+		return false;
+	}
+#endif
+
+	while (J->output_scanline < J->output_height){
+		size_t y = J->output_scanline;
+#ifdef JCS_EXTENSIONS
+		JSAMPROW rows[8];
+		size_t n = 0;
+		for (; n < 8 && y + n < J->output_height; n++)
+			rows[n] = (JSAMPROW) &dst->vidp[(y + n) * dst->pitch];
+
+		if (!jpeg_read_scanlines(J, rows, n))
+			break;
+#else
+		JSAMPROW row = cam->jpeg_row;
+		if (!jpeg_read_scanlines(J, &row, 1))
+			break;
+
+		shmif_pixel* px = &dst->vidp[y * dst->pitch];
+		for (size_t x = 0; x < J->output_width; x++)
+			px[x] = SHMIF_RGBA(row[x*3+0], row[x*3+1], row[x*3+2], 0xff);
+#endif
 	}
 
+	jpeg_finish_decompress(J);
+	arcan_shmif_signal(dst, SHMIF_SIGVID);
+	return true;
+}
+#endif
+
+static bool frame_ffmpeg(struct uvc_cam* cam,
+	uvc_frame_t* uvc, struct arcan_shmif_cont* cont, int fmt, const char* fmtstr)
+{
 /* this is the same code used in a12/a12_decode.c */
-	if (!codec){
-		codec = avcodec_find_decoder(fmt);
-		if (!codec){
+	if (!cam->codec){
+		cam->codec = avcodec_find_decoder(fmt);
+		if (!cam->codec){
 			LOG("status=error:fatal:kind=missing:message=no %s support", fmtstr);
-			arcan_shmif_last_words(cont, "ffmpeg no matching codec");
-			arcan_shmif_drop(cont);
-			exit(EXIT_FAILURE);
+			cam_fail(cam, "ffmpeg no matching codec");
+			return false;
 		}
-		decode = avcodec_alloc_context3(codec);
-		parser = av_parser_init(codec->id);
-		frame = av_frame_alloc();
-		packet = av_packet_alloc();
-		if (avcodec_open2(decode, codec, NULL) < 0){
+		cam->decode = avcodec_alloc_context3(cam->codec);
+		cam->parser = av_parser_init(cam->codec->id);
+		cam->frame = av_frame_alloc();
+		cam->packet = av_packet_alloc();
+		if (avcodec_open2(cam->decode, cam->codec, NULL) < 0){
 			LOG("status=error:fatal:kind=codec_fail:message=codec failed open");
-			arcan_shmif_drop(cont);
-			exit(EXIT_FAILURE);
+			cam_fail(cam, "ffmpeg codec failed open");
+			return false;
 		}
 	}
 
+	AVPacket* packet = cam->packet;
+	AVFrame* frame = cam->frame;
+
 	int ofs = 0;
 	while (uvc->data_bytes - ofs > 0){
-		int ret = av_parser_parse2(parser, decode,
+		int ret = av_parser_parse2(cam->parser, cam->decode,
 			&packet->data, &packet->size,
 			&((uint8_t*)uvc->data)[ofs],
 			uvc->data_bytes - ofs,
@@ -168,48 +394,46 @@ static void frame_ffmpeg(
 
 		if (ret < 0){
 			LOG("status=error:fatal:kind=ebad:message=%s parser failed", fmtstr);
-			arcan_shmif_last_words(cont, "ffmpeg parser error");
-			arcan_shmif_drop(cont);
-			exit(EXIT_FAILURE);
+			cam_fail(cam, "ffmpeg parser error");
+			return false;
 		}
 		ofs += ret;
 
 		if (packet->data){
-			ret = avcodec_send_packet(decode, packet);
+			ret = avcodec_send_packet(cam->decode, packet);
 			if (ret < 0)
 				goto decode_fail;
 
 			while (ret >= 0){
-				ret = avcodec_receive_frame(decode, frame);
+				ret = avcodec_receive_frame(cam->decode, frame);
 				if (ret == AVERROR(EAGAIN) || ret == AVERROR(EOF)){
 					break;
 				}
 				else if (ret != 0)
 					goto decode_fail;
 
-				struct SwsContext* scaler =
-					sws_getContext(
-						frame->width, frame->height, AV_PIX_FMT_YUV420P,
-						cont->w, cont->h, AV_PIX_FMT_BGRA, SWS_BILINEAR, NULL, NULL, NULL);
+				cam->scaler = sws_getCachedContext(cam->scaler,
+					frame->width, frame->height, frame->format,
+					cont->w, cont->h, AV_PIX_FMT_BGRA, SWS_BILINEAR, NULL, NULL, NULL);
+				if (!cam->scaler)
+					continue;
 
 				uint8_t* const dst[] = {cont->vidb};
 				int dst_stride[] = {cont->stride};
-				sws_scale(scaler, (const uint8_t* const*) frame->data,
+				sws_scale(cam->scaler, (const uint8_t* const*) frame->data,
 						frame->linesize, 0, frame->height, dst, dst_stride);
 
-				sws_freeContext(scaler);
 				arcan_shmif_signal(cont, SHMIF_SIGVID);
 			}
 		}
 	}
 
-	return;
+	return true;
 
 decode_fail:
 	LOG("status=error:fatal:kind=ebad:message=%s decoder failed", fmtstr);
-	arcan_shmif_last_words(cont, "ffmpeg decoder error");
-	arcan_shmif_drop(cont);
-	exit(EXIT_FAILURE);
+	cam_fail(cam, "ffmpeg decoder error");
+	return false;
 }
 
 static void frame_rgb(uvc_frame_t* frame, struct arcan_shmif_cont* dst)
@@ -225,35 +449,37 @@ static void frame_rgb(uvc_frame_t* frame, struct arcan_shmif_cont* dst)
 	arcan_shmif_signal(dst, SHMIF_SIGVID);
 }
 
-static void callback(uvc_frame_t* frame, void* tag)
+static void process_frame(struct uvc_cam* cam, uvc_frame_t* frame)
 {
-	uvc_frame_t* bgr;
-	uvc_error_t ret;
-	struct arcan_shmif_cont* cont = tag;
+	struct arcan_shmif_cont* cont = cam->cont;
+
+/* the main thread polls events on the same segment */
+	arcan_shmif_lock(cont);
 
 /* guarantee dimensions */
 	if (cont->w != frame->width || cont->h != frame->height){
 		if (!arcan_shmif_resize_ext(cont, frame->width, frame->height,
 			(struct shmif_resize_ext){
-				.vbuf_cnt = video_buffer_count,
-				.meta = h264_passthrough ? SHMIF_META_VENC : 0
+				.vbuf_cnt = cam->vbufc,
+				.meta = cam->h264_passthrough ? SHMIF_META_VENC : 0
 			})){
+			arcan_shmif_unlock(cont);
 			return;
 		}
 	}
 
-	if (h264_passthrough && frame->frame_format == UVC_FRAME_FORMAT_H264){
+	if (cam->h264_passthrough && frame->frame_format == UVC_FRAME_FORMAT_H264){
 		struct arcan_shmif_venc* venc =
 			arcan_shmif_substruct(cont, SHMIF_META_VENC).venc;
 		if (!venc){
-			h264_passthrough = false;
+			cam->h264_passthrough = false;
 			LOG("status=feature:h264_passthrough=false");
 		}
 /* sanity-check fail, revert to normal */
 		else {
 			if (frame->data_bytes > cont->w * cont->h * sizeof(shmif_pixel)){
 				venc->fourcc[0] = 0;
-				h264_passthrough = false;
+				cam->h264_passthrough = false;
 			}
 			else {
 				venc->fourcc[0] = 'H';
@@ -265,6 +491,7 @@ static void callback(uvc_frame_t* frame, void* tag)
 				LOG("status=frame:h264_passthrough=true:size=%zu", (size_t) frame->data_bytes);
 				memcpy(cont->vidb, frame->data, venc->framesize);
 				arcan_shmif_signal(cont, SHMIF_SIGVID);
+				arcan_shmif_unlock(cont);
 				return;
 			}
 		}
@@ -272,31 +499,152 @@ static void callback(uvc_frame_t* frame, void* tag)
 
 /* conversion / repack */
 	switch(frame->frame_format){
-/* 'actually YUY2 is also called YUYV which is YUV420' (what a mess)
- * though at least the capture devices I have used this one had the
- * YUYV frame format have the same output as NV12 /facepalm */
+/* some capture devices label NV12 output as YUYV, yuyv_nv12 keeps treating
+ * them that way */
 	case UVC_FRAME_FORMAT_YUYV:
+		if (cam->yuyv_nv12)
+			run_swscale(cam, frame, cont, 2, AV_PIX_FMT_NV12);
+		else
+			frame_yuv422(frame, cont, false);
+	break;
 	case UVC_FRAME_FORMAT_NV12:
-		run_swscale(frame, cont, 2, AV_PIX_FMT_NV12);
+		run_swscale(cam, frame, cont, 2, AV_PIX_FMT_NV12);
 	break;
 	case UVC_FRAME_FORMAT_UYVY:
-		run_swscale(frame, cont, 3, AV_PIX_FMT_UYVY422);
-		frame_uyvy(frame, cont);
+		frame_yuv422(frame, cont, true);
 	break;
 	case UVC_FRAME_FORMAT_RGB:
 		frame_rgb(frame, cont);
 	break;
 	case UVC_FRAME_FORMAT_H264:
-		frame_ffmpeg(frame, cont, AV_CODEC_ID_H264, "h264");
+		frame_ffmpeg(cam, frame, cont, AV_CODEC_ID_H264, "h264");
 	break;
 	case UVC_FRAME_FORMAT_MJPEG:
-		frame_ffmpeg(frame, cont, AV_CODEC_ID_MJPEG, "mjpeg");
+#ifdef HAVE_IMG_JPEG
+		if (frame_jpeg(cam, frame, cont))
+			break;
+#endif
+		frame_ffmpeg(cam, frame, cont, AV_CODEC_ID_MJPEG, "mjpeg");
 	break;
-/* h264 and mjpeg should map into ffmpeg as well */
 	default:
 		LOG("unhandled frame format: %d\n", (int)frame->frame_format);
 	break;
 	}
+
+	arcan_shmif_unlock(cont);
+}
+
+static void pool_queue(struct uvc_cam* cam)
+{
+	cam->queued = true;
+	cam->next = NULL;
+	if (pool.tail)
+		pool.tail->next = cam;
+	else
+		pool.head = cam;
+	pool.tail = cam;
+	pthread_cond_signal(&pool.cond);
+}
+
+/* libuvc stream thread, keep this to a copy */
+static void callback(uvc_frame_t* frame, void* tag)
+{
+	struct uvc_cam* cam = tag;
+
+	pthread_mutex_lock(&cam->lock);
+	if (cam->has_pending)
+		cam->dropped++;
+	cam->has_pending = UVC_SUCCESS == uvc_duplicate_frame(frame, cam->pending);
+	bool has_pending = cam->has_pending;
+	pthread_mutex_unlock(&cam->lock);
+
+	if (!has_pending)
+		return;
+
+	pthread_mutex_lock(&pool.lock);
+	if (!cam->queued && !cam->busy && !cam->dead)
+		pool_queue(cam);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+static void* pool_worker(void* tag)
+{
+	for(;;){
+		pthread_mutex_lock(&pool.lock);
+		while (!pool.head && !pool.shutdown)
+			pthread_cond_wait(&pool.cond, &pool.lock);
+
+		if (pool.shutdown){
+			pthread_mutex_unlock(&pool.lock);
+			break;
+		}
+
+		struct uvc_cam* cam = pool.head;
+		pool.head = cam->next;
+		if (!pool.head)
+			pool.tail = NULL;
+		cam->queued = false;
+		cam->busy = true;
+		pthread_mutex_unlock(&pool.lock);
+
+		pthread_mutex_lock(&cam->lock);
+		uvc_frame_t* frame = cam->pending;
+		cam->pending = cam->work;
+		cam->work = frame;
+		bool has_frame = cam->has_pending;
+		cam->has_pending = false;
+		pthread_mutex_unlock(&cam->lock);
+
+		if (has_frame)
+			process_frame(cam, frame);
+
+/* a new frame might have arrived while this one was being decoded */
+		pthread_mutex_lock(&pool.lock);
+		cam->busy = false;
+		pthread_mutex_lock(&cam->lock);
+		bool again = cam->has_pending;
+		pthread_mutex_unlock(&cam->lock);
+		if (again && !cam->queued && !cam->dead)
+			pool_queue(cam);
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	return NULL;
+}
+
+static bool pool_start(size_t n)
+{
+	if (-1 == pipe(pool.wake))
+		return false;
+
+	fcntl(pool.wake[0], F_SETFL, O_NONBLOCK);
+	fcntl(pool.wake[0], F_SETFD, FD_CLOEXEC);
+	fcntl(pool.wake[1], F_SETFD, FD_CLOEXEC);
+
+	for (size_t i = 0; i < n; i++){
+		if (0 != pthread_create(&pool.workers[pool.n_workers], NULL, pool_worker, NULL))
+			break;
+		pool.n_workers++;
+	}
+
+	return pool.n_workers > 0;
+}
+
+static void pool_stop()
+{
+	pthread_mutex_lock(&pool.lock);
+	pool.shutdown = true;
+	pthread_cond_broadcast(&pool.cond);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (size_t i = 0; i < pool.n_workers; i++)
+		pthread_join(pool.workers[i], NULL);
+	pool.n_workers = 0;
+
+	if (-1 != pool.wake[0]){
+		close(pool.wake[0]);
+		close(pool.wake[1]);
+	}
 }
 
 static int fmt_score(const uint8_t fourcc[static 4], int* out)
@@ -425,6 +773,191 @@ static bool match_dev_pref_fmt(
 		return false;
 }
 
+static bool cam_open(struct uvc_cam* cam, uvc_device_t* dev,
+	size_t width, size_t height, int fps, struct arg_arr* args)
+{
+	if (uvc_open(dev, &cam->devh) < 0){
+		cam->devh = NULL;
+		return false;
+	}
+
+/* finding the right format is complicated -
+ *  the formats for a device is a linked list (->next) where there is a
+ *  frame_desc with the same restriction.
+ *
+ * scan for matching size (if defined) - otherwise pick based on format
+ * and format priority. This is what uvc_get_stream_ctrl_format_size does
+ * but it also requires explicit size description
+ */
+	int fmt = -1;
+
+	if (!match_dev_pref_fmt(cam->devh, &width, &height, &fmt)){
+		arcan_shmif_last_words(cam->cont, "no compatible frame-format for device");
+		return false;
+	}
+
+/* will be redirected to log */
+	uvc_print_diag(cam->devh, stderr);
+
+/* so there are more options to negotiate here, and we can't really grok
+ * what is the 'preferred' format, normal tactic is
+ *
+ * uvc_stream_ctrl_t ctrl;
+ * uvc_get_stream_ctrl_format_size(
+ * 	devh, &ctrl, UVC_FRAME_FORMAT_YUYV, w, h, fps)
+ *
+ * so maybe we need to try a few and then pick what best match some user pref.
+ */
+	if (uvc_get_stream_ctrl_format_size(
+		cam->devh, &cam->ctrl, fmt, width, height, fps) < 0){
+		fprintf(stderr, "kind=EINVAL:message="
+			"format request (%zu*%zu@%d fps)@%d failed\n", width, height, fps, fmt);
+
+		if (uvc_get_stream_ctrl_format_size(
+			cam->devh, &cam->ctrl, UVC_FRAME_FORMAT_ANY, width, height, fps) < 0){
+			fprintf(stderr, "kind=EINVAL:message="
+				"format request (%zu*%zu@%d fps)@ANY failed\n", width, height, fps);
+		}
+		return false;
+	}
+
+	if (fmt == UVC_FRAME_FORMAT_H264 && !arg_lookup(args, "no_pass", 0, NULL)){
+		cam->h264_passthrough = true;
+	}
+
+	cam->pending = uvc_allocate_frame(0);
+	cam->work = uvc_allocate_frame(0);
+	return cam->pending && cam->work;
+}
+
+static void cam_free(struct uvc_cam* cam)
+{
+	if (cam->streaming)
+		uvc_stop_streaming(cam->devh);
+
+	if (cam->devh)
+		uvc_close(cam->devh);
+
+	if (cam->pending)
+		uvc_free_frame(cam->pending);
+	if (cam->work)
+		uvc_free_frame(cam->work);
+
+	if (cam->scaler)
+		sws_freeContext(cam->scaler);
+	if (cam->decode)
+		avcodec_free_context(&cam->decode);
+	if (cam->parser)
+		av_parser_close(cam->parser);
+	if (cam->packet)
+		av_packet_free(&cam->packet);
+	if (cam->frame)
+		av_frame_free(&cam->frame);
+
+#ifdef HAVE_IMG_JPEG
+	if (cam->jpeg_init)
+		jpeg_destroy_decompress(&cam->jpeg);
+	free(cam->jpeg_row);
+#endif
+
+	pthread_mutex_destroy(&cam->lock);
+}
+
+static bool serial_match(struct arg_arr* args, const char* serial)
+{
+	const char* val;
+	if (!arg_lookup(args, "serial", 0, &val))
+		return true;
+
+	for (size_t i = 0; arg_lookup(args, "serial", i, &val); i++)
+		if (val && serial && strcmp(val, serial) == 0)
+			return true;
+
+	return false;
+}
+
+/* every device that passes the vid/pid and (any of the) serial filters */
+static size_t find_devices(uvc_context_t* uvctx, struct arg_arr* args,
+	int vendor_id, int product_id, uvc_device_t* out[static UVC_CAMERA_LIMIT])
+{
+	uvc_device_t** devices;
+	size_t count = 0;
+
+	if (uvc_get_device_list(uvctx, &devices) != UVC_SUCCESS)
+		return 0;
+
+	for (size_t i = 0; devices[i] && count < UVC_CAMERA_LIMIT; i++){
+		uvc_device_descriptor_t* ddesc;
+		if (uvc_get_device_descriptor(devices[i], &ddesc) != UVC_SUCCESS)
+			continue;
+
+		if ((!vendor_id || vendor_id == ddesc->idVendor) &&
+			(!product_id || product_id == ddesc->idProduct) &&
+			serial_match(args, ddesc->serialNumber)){
+			uvc_ref_device(devices[i]);
+			out[count++] = devices[i];
+		}
+
+		uvc_free_device_descriptor(ddesc);
+	}
+
+	uvc_free_device_list(devices, 1);
+	return count;
+}
+
+static struct arcan_shmif_cont* request_segment(
+	struct arcan_shmif_cont* cont, size_t index)
+{
+	arcan_shmif_enqueue(cont, &(struct arcan_event){
+		.ext.kind = ARCAN_EVENT(SEGREQ),
+		.ext.segreq.kind = SEGID_MEDIA,
+		.ext.segreq.id = 0xcafe + index
+	});
+
+	arcan_event acq_event;
+	struct arcan_event* evpool = NULL;
+	ssize_t evpool_sz;
+
+	if (!arcan_shmif_acquireloop(cont, &acq_event, &evpool, &evpool_sz)){
+		LOG("kind=error:message=server rejected camera segment %zu\n", index);
+		free(evpool);
+		return NULL;
+	}
+	free(evpool);
+
+	struct arcan_shmif_cont* res = malloc(sizeof(struct arcan_shmif_cont));
+	if (!res)
+		return NULL;
+
+	*res = arcan_shmif_acquire(cont, NULL, SEGID_MEDIA, 0);
+	if (!res->addr){
+		free(res);
+		return NULL;
+	}
+
+	return res;
+}
+
+static void announce(struct uvc_cam* cam, size_t index, uvc_device_t* dev)
+{
+	uvc_device_descriptor_t* ddesc;
+	if (uvc_get_device_descriptor(dev, &ddesc) != UVC_SUCCESS)
+		return;
+
+	struct arcan_event ev = {
+		.category = EVENT_EXTERNAL,
+		.ext.kind = ARCAN_EVENT(MESSAGE)
+	};
+
+	size_t nb = sizeof(ev.ext.message.data) / sizeof(ev.ext.message.data[0]);
+	snprintf((char*) ev.ext.message.data, nb, "camera=%zu:vid=%.4x:pid=%.4x:serial=%s",
+		index, ddesc->idVendor, ddesc->idProduct,
+		ddesc->serialNumber ? ddesc->serialNumber : "");
+
+	arcan_shmif_enqueue(cam->cont, &ev);
+	uvc_free_device_descriptor(ddesc);
+}
+
 #define DIE(C) do { arcan_shmif_drop(C); return true; } while(0)
 
 bool uvc_support_activate(
@@ -435,6 +968,7 @@ bool uvc_support_activate(
 	size_t width = 0;
 	size_t height = 0;
 	int fps = 0;
+	int vbufc = 1;
 
 /* we only return 'false' if uvc has explicitly been disabled, otherwise
  * VLC might try to capture */
@@ -444,10 +978,6 @@ bool uvc_support_activate(
 
 /* capture is already set, otherwise we wouldn't be here */
 	uvc_context_t* uvctx;
-	uvc_device_t* dev;
-	uvc_device_handle_t* devh;
-	uvc_stream_ctrl_t ctrl;
-	uvc_error_t res;
 
 	if (uvc_init(&uvctx, NULL) < 0){
 		arcan_shmif_last_words(cont, "couldn't initialize UVC");
@@ -502,94 +1032,181 @@ bool uvc_support_activate(
 	if (arg_lookup(args, "fps", 0, &val) && val)
 		fps = strtoul(val, NULL, 10);
 
+/* with several cameras sharing workers, a blocking signal on a single
+ * buffer would hold a worker until the frame has been consumed */
+	bool multi = arg_lookup(args, "multi", 0, NULL);
+	if (multi)
+		vbufc = 2;
+
 	if (arg_lookup(args, "vbufc", 0, &val)){
 		uint8_t bufc = strtoul(val, NULL, 10);
-		video_buffer_count = bufc > 0 && bufc <= 4 ? bufc : 1;
+		vbufc = bufc > 0 && bufc <= 4 ? bufc : 1;
 	}
 
-	arg_lookup(args, "serial", 0, &serial);
+	uvc_device_t* devs[UVC_CAMERA_LIMIT];
+	size_t n_devs = 0;
 
-	if (uvc_find_device(uvctx, &dev, vendor_id, product_id, serial) < 0){
-		arcan_shmif_last_words(cont, "no matching device");
-		DIE(cont);
+	if (multi){
+		n_devs = find_devices(uvctx, args, vendor_id, product_id, devs);
 	}
-
-	if (uvc_open(dev, &devh) < 0){
-		arcan_shmif_last_words(cont, "couldn't open device");
-		DIE(cont);
+	else {
+		arg_lookup(args, "serial", 0, &serial);
+		if (uvc_find_device(uvctx, &devs[0], vendor_id, product_id, serial) >= 0)
+			n_devs = 1;
 	}
 
-/* finding the right format is complicated -
- *  the formats for a device is a linked list (->next) where there is a
- *  frame_desc with the same restriction.
- *
- * scan for matching size (if defined) - otherwise pick based on format
- * and format priority. This is what uvc_get_stream_ctrl_format_size does
- * but it also requires explicit size description
- */
-	int fmt = -1;
-
-	if (!match_dev_pref_fmt(devh, &width, &height, &fmt)){
-		arcan_shmif_last_words(cont, "no compatible frame-format for device");
+	if (!n_devs){
+		arcan_shmif_last_words(cont, "no matching device");
 		DIE(cont);
 	}
 
-	enum uvc_frame_format frame_format;
-
-/* will be redirected to log */
-	uvc_print_diag(devh, stderr);
-
-/* so there are more options to negotiate here, and we can't really grok
- * what is the 'preferred' format, normal tactic is
- *
- * uvc_stream_ctrl_t ctrl;
- * uvc_get_stream_ctrl_format_size(
- * 	devh, &ctrl, UVC_FRAME_FORMAT_YUYV, w, h, fps)
- *
- * so maybe we need to try a few and then pick what best match some user pref.
- */
+/* the first camera takes the primary segment, the others get one each */
+	struct uvc_cam cams[UVC_CAMERA_LIMIT] = {0};
+	size_t n_cams = 0;
+
+	for (size_t i = 0; i < n_devs; i++){
+		struct uvc_cam* cam = &cams[n_cams];
+		*cam = (struct uvc_cam){0};
+		cam->cont = i == 0 ? cont : request_segment(cont, i);
+		cam->vbufc = vbufc;
+		cam->yuyv_nv12 = arg_lookup(args, "yuyv_nv12", 0, NULL);
+		pthread_mutex_init(&cam->lock, NULL);
+
+		if (!cam->cont){
+			pthread_mutex_destroy(&cam->lock);
+			uvc_unref_device(devs[i]);
+			continue;
+		}
 
-/* some other frame formats take even more special consideration, mainly
- * FRAME_FORMAT_H264 (decode through vlc or openh264) | (attempt-passthrough)
- * FRAME_FORMAT_MJPEG
- */
-	if (uvc_get_stream_ctrl_format_size(
-		devh, &ctrl, fmt, width, height, fps) < 0){
-		fprintf(stderr, "kind=EINVAL:message="
-			"format request (%zu*%zu@%d fps)@%d failed\n", width, height, fps, fmt);
+		if (!cam_open(cam, devs[i], width, height, fps, args)){
+			if (i == 0)
+				arcan_shmif_last_words(cont, "couldn't open device");
+			else {
+				arcan_shmif_drop(cam->cont);
+				free(cam->cont);
+			}
+			cam_free(cam);
+			uvc_unref_device(devs[i]);
 
-		if (uvc_get_stream_ctrl_format_size(
-			devh, &ctrl, UVC_FRAME_FORMAT_ANY, width, height, fps) < 0){
-			fprintf(stderr, "kind=EINVAL:message="
-				"format request (%zu*%zu@%d fps)@ANY failed\n", width, height, fps);
+			if (i == 0)
+				goto out;
+			continue;
 		}
-		goto out;
-	}
 
-	if (fmt == UVC_FRAME_FORMAT_H264 && !arg_lookup(args, "no_pass", 0, NULL)){
-		h264_passthrough = true;
+		if (multi)
+			announce(cam, i, devs[i]);
+		uvc_unref_device(devs[i]);
+		n_cams++;
 	}
 
-	int rv = uvc_start_streaming(devh, &ctrl, callback, cont, 0);
-	if (rv < 0){
-		arcan_shmif_last_words(cont, "uvc- error when streaming");
+	long workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (arg_lookup(args, "workers", 0, &val) && val)
+		workers = strtol(val, NULL, 10);
+	workers = workers < 1 ? 1 : (workers > UVC_WORKER_LIMIT ? UVC_WORKER_LIMIT : workers);
+	if ((size_t)workers > n_cams)
+		workers = n_cams;
+
+	if (!pool_start(workers)){
+		arcan_shmif_last_words(cont, "couldn't start decode workers");
 		goto out;
 	}
 
+	for (size_t i = 0; i < n_cams; i++){
+		if (uvc_start_streaming(cams[i].devh, &cams[i].ctrl, callback, &cams[i], 0) < 0){
+			arcan_shmif_last_words(cams[i].cont, "uvc- error when streaming");
+			cams[i].dead = true;
+		}
+		else
+			cams[i].streaming = true;
+	}
+
 /* this one is a bit special, optimally we'd want to check cont and see if we
  * have GPU access - if there is one, we should try and get the camera native
  * format, upload that to a texture and repack / convert there - for now just
  * set RGBX and hope that uvc can unpack without further conversion */
 	arcan_shmif_privsep(cont, "minimal", NULL, 0);
 
-	struct arcan_event ev;
-	while(arcan_shmif_wait(cont, &ev)){
-		if (ev.category != EVENT_TARGET)
-			continue;
+	bool running = true;
+	while (running){
+		struct pollfd pfd[UVC_CAMERA_LIMIT + 1];
+		size_t n_live = 0;
+
+		pthread_mutex_lock(&pool.lock);
+		for (size_t i = 0; i < n_cams; i++){
+			pfd[i] = (struct pollfd){
+				.fd = cams[i].dead ? -1 : cams[i].cont->epipe,
+				.events = POLLIN | POLLERR | POLLHUP | POLLNVAL
+			};
+			n_live += !cams[i].dead;
+		}
+		pthread_mutex_unlock(&pool.lock);
+
+		if (!n_live || cams[0].dead)
+			break;
+
+		pfd[n_cams] = (struct pollfd){.fd = pool.wake[0], .events = POLLIN};
+		if (-1 == poll(pfd, n_cams + 1, -1) && errno != EINTR && errno != EAGAIN)
+			break;
+
+		if (pfd[n_cams].revents & POLLIN){
+			uint8_t buf[64];
+			while (read(pool.wake[0], buf, sizeof(buf)) > 0){}
+		}
+
+		for (size_t i = 0; i < n_cams; i++){
+			if (!pfd[i].revents)
+				continue;
+
+			struct arcan_event ev;
+			int rv;
+			bool stop = false;
+
+			arcan_shmif_lock(cams[i].cont);
+			while ((rv = arcan_shmif_poll(cams[i].cont, &ev)) > 0){
+				if (ev.category == EVENT_TARGET && ev.tgt.kind == TARGET_COMMAND_EXIT)
+					stop = true;
+			}
+			arcan_shmif_unlock(cams[i].cont);
+
+/* only the stream stops here, the segment stays until shutdown */
+			if (stop || rv < 0){
+				if (i == 0)
+					running = false;
+
+				pthread_mutex_lock(&pool.lock);
+				cams[i].dead = true;
+				pthread_mutex_unlock(&pool.lock);
+
+				if (cams[i].streaming){
+					uvc_stop_streaming(cams[i].devh);
+					cams[i].streaming = false;
+				}
+			}
+		}
 	}
 
 out:
-	uvc_close(devh);
+	for (size_t i = 0; i < n_cams; i++){
+		if (cams[i].streaming){
+			uvc_stop_streaming(cams[i].devh);
+			cams[i].streaming = false;
+		}
+	}
+
+	pool_stop();
+
+	for (size_t i = 0; i < n_cams; i++){
+		if (cams[i].dropped)
+			LOG("camera=%zu:dropped=%zu\n", i, cams[i].dropped);
+
+		cam_free(&cams[i]);
+		if (cams[i].cont != cont){
+			arcan_shmif_drop(cams[i].cont);
+			free(cams[i].cont);
+		}
+	}
+
+	uvc_exit(uvctx);
 	arcan_shmif_drop(cont);
 	return true;
 }
@@ -608,6 +1225,10 @@ void uvc_append_help(FILE* out)
 	"width    \t px        \t preferred capture width (=0)\n"
 	"height   \t px        \t preferred capture height (=0)\n"
 	"fps      \t nframes   \t preferred capture framerate (=0)\n"
-	"vbufc    \t nbuf      \t preferred number of transfer buffers (=1)\n"
+	"vbufc    \t nbuf      \t preferred number of transfer buffers (=1, multi: 2)\n"
+	"multi    \t           \t serve all matching devices (serial can repeat),\n"
+	"         \t           \t the first on this segment, the rest as subsegments\n"
+	"workers  \t n         \t decode threads shared by all cameras (=cores)\n"
+	"yuyv_nv12\t           \t treat YUYV labelled frames as NV12\n"
 	);
 }
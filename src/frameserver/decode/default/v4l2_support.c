@@ -0,0 +1,851 @@
+/*
+ * Native V4L2 capture as part of the decode frameserver.
+ *
+ * This is for devices that the kernel already exposes as video nodes, HDMI
+ * capture cards in particular, where libvlc would copy and convert every
+ * frame and libuvc would need to detach the kernel driver. The capture
+ * buffers are exported as dma-buf (VIDIOC_EXPBUF) and handed to the server
+ * through the same BUFFERSTREAM planes that hardware decoding uses, so YUV
+ * formats stay YUV and the conversion happens when the frame is sampled.
+ *
+ * A buffer that has been passed is kept away from the driver for a few
+ * frames as the server may still be sampling from it. If the driver can't
+ * export or the server rejects the buffers (BUFFER_FAIL), the mmap:ed
+ * buffers are converted into the segment instead.
+ *
+ * Missing:
+ *  - controls (brightness, input select, ...) as labelhints
+ *  - DV timings / source change events for HDMI inputs switching resolution
+ *  - audio (separate ALSA device for most cards)
+ */
+#include <arcan_shmif.h>
+#include <linux/videodev2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "v4l2_support.h"
+
+#define V4L2_BUFFER_LIMIT 32
+#define V4L2_PLANE_LIMIT 3
+
+#define V4L2_DRM_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) |\
+	((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+enum conv_kind {
+	CONV_PACKED422,
+	CONV_SEMIPLANAR,
+	CONV_PLANAR,
+	CONV_BGRX,
+	CONV_BGR24,
+	CONV_RGB24
+};
+
+/*
+ * [planes] is the number of planes the server sees, [mem_planes] the number
+ * of separate buffers the driver uses for them (the M- formats). [swap] is
+ * UYVY over YUYV and V before U for the (semi-)planar ones. The scores order
+ * the preference when the format isn't forced, dma-buf first for what GPUs
+ * tend to sample natively, copy first for the cheapest conversion.
+ */
+static const struct fmt_map {
+	uint32_t v4l2;
+	uint32_t drm;
+	uint8_t planes;
+	uint8_t mem_planes;
+	uint8_t vsub;
+	enum conv_kind conv;
+	bool swap;
+	int score_dmabuf;
+	int score_copy;
+} formats[] = {
+	{V4L2_PIX_FMT_NV12, V4L2_DRM_FOURCC('N','V','1','2'), 2, 1, 2, CONV_SEMIPLANAR, false, 10, 6},
+	{V4L2_PIX_FMT_NV12M, V4L2_DRM_FOURCC('N','V','1','2'), 2, 2, 2, CONV_SEMIPLANAR, false, 10, 6},
+	{V4L2_PIX_FMT_YUYV, V4L2_DRM_FOURCC('Y','U','Y','V'), 1, 1, 1, CONV_PACKED422, false, 9, 8},
+	{V4L2_PIX_FMT_UYVY, V4L2_DRM_FOURCC('U','Y','V','Y'), 1, 1, 1, CONV_PACKED422, true, 8, 8},
+	{V4L2_PIX_FMT_NV16, V4L2_DRM_FOURCC('N','V','1','6'), 2, 1, 1, CONV_SEMIPLANAR, false, 8, 5},
+	{V4L2_PIX_FMT_NV21, V4L2_DRM_FOURCC('N','V','2','1'), 2, 1, 2, CONV_SEMIPLANAR, true, 7, 6},
+	{V4L2_PIX_FMT_NV21M, V4L2_DRM_FOURCC('N','V','2','1'), 2, 2, 2, CONV_SEMIPLANAR, true, 7, 6},
+	{V4L2_PIX_FMT_NV61, V4L2_DRM_FOURCC('N','V','6','1'), 2, 1, 1, CONV_SEMIPLANAR, true, 6, 5},
+	{V4L2_PIX_FMT_YUV420, V4L2_DRM_FOURCC('Y','U','1','2'), 3, 1, 2, CONV_PLANAR, false, 5, 4},
+	{V4L2_PIX_FMT_YVU420, V4L2_DRM_FOURCC('Y','V','1','2'), 3, 1, 2, CONV_PLANAR, true, 5, 4},
+	{V4L2_PIX_FMT_XBGR32, V4L2_DRM_FOURCC('X','R','2','4'), 1, 1, 1, CONV_BGRX, false, 4, 10},
+	{V4L2_PIX_FMT_ABGR32, V4L2_DRM_FOURCC('A','R','2','4'), 1, 1, 1, CONV_BGRX, false, 4, 10},
+	{V4L2_PIX_FMT_BGR24, V4L2_DRM_FOURCC('R','G','2','4'), 1, 1, 1, CONV_BGR24, false, 2, 7},
+	{V4L2_PIX_FMT_RGB24, V4L2_DRM_FOURCC('B','G','2','4'), 1, 1, 1, CONV_RGB24, false, 2, 7},
+};
+
+struct v4l2_buf {
+	uint8_t* map[V4L2_PLANE_LIMIT];
+	size_t map_sz[V4L2_PLANE_LIMIT];
+	int fd[V4L2_PLANE_LIMIT];
+};
+
+/* where a server- side plane lives within the driver buffers */
+struct plane_layout {
+	size_t mem;
+	size_t offset;
+	size_t stride;
+	size_t rows;
+};
+
+struct v4l2_cap {
+	struct arcan_shmif_cont* cont;
+	int dev;
+	enum v4l2_buf_type type;
+	bool mplane;
+
+	const struct fmt_map* fmt;
+	size_t w, h;
+	struct plane_layout layout[V4L2_PLANE_LIMIT];
+	uint8_t color_space;
+	uint8_t color_range;
+
+	struct v4l2_buf bufs[V4L2_BUFFER_LIMIT];
+	size_t n_bufs;
+
+/* passed to the server and not given back to the driver yet, oldest first */
+	size_t held[V4L2_BUFFER_LIMIT];
+	size_t n_held;
+	size_t hold;
+
+	bool dmabuf;
+	bool streaming;
+};
+
+static int xioctl(int fd, unsigned long req, void* arg)
+{
+	int rv;
+	while (-1 == (rv = ioctl(fd, req, arg)) && errno == EINTR){}
+	return rv;
+}
+
+static uint8_t clamp_u8(int v)
+{
+	return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/* BT.601 limited range in 6-bit fixed point, same as the uvc path */
+#define YUV_CY 75
+#define YUV_CRV 102
+#define YUV_CGU 25
+#define YUV_CGV 52
+#define YUV_CBU 129
+
+static inline shmif_pixel yuv_px(int y, int u, int v)
+{
+	y = (y - 16) * YUV_CY;
+	u -= 128;
+	v -= 128;
+
+	return
+		SHMIF_RGBA(
+			clamp_u8((y + YUV_CRV * v) >> 6),
+			clamp_u8((y - YUV_CGU * u - YUV_CGV * v) >> 6),
+			clamp_u8((y + YUV_CBU * u) >> 6),
+			0xff
+		);
+}
+
+static void convert_frame(
+	struct v4l2_cap* cap, uint8_t* src[V4L2_PLANE_LIMIT])
+{
+	struct arcan_shmif_cont* C = cap->cont;
+	const struct plane_layout* L = cap->layout;
+	bool swap = cap->fmt->swap;
+
+	for (size_t y = 0; y < cap->h; y++){
+		shmif_pixel* dst = &C->vidp[y * C->pitch];
+		const uint8_t* p0 = &src[0][y * L[0].stride];
+
+		switch (cap->fmt->conv){
+		case CONV_PACKED422:{
+			int yo = swap ? 1 : 0;
+			int uo = swap ? 0 : 1;
+			int vo = swap ? 2 : 3;
+			for (size_t x = 0; x + 1 < cap->w; x += 2, p0 += 4){
+				dst[x+0] = yuv_px(p0[yo+0], p0[uo], p0[vo]);
+				dst[x+1] = yuv_px(p0[yo+2], p0[uo], p0[vo]);
+			}
+		}
+		break;
+		case CONV_SEMIPLANAR:{
+			const uint8_t* uv = &src[1][(y / cap->fmt->vsub) * L[1].stride];
+			int uo = swap ? 1 : 0;
+			int vo = swap ? 0 : 1;
+			for (size_t x = 0; x < cap->w; x++)
+				dst[x] = yuv_px(p0[x], uv[(x & ~1) + uo], uv[(x & ~1) + vo]);
+		}
+		break;
+		case CONV_PLANAR:{
+			size_t cy = y / cap->fmt->vsub;
+			const uint8_t* u = &src[swap ? 2 : 1][cy * L[1].stride];
+			const uint8_t* v = &src[swap ? 1 : 2][cy * L[2].stride];
+			for (size_t x = 0; x < cap->w; x++)
+				dst[x] = yuv_px(p0[x], u[x >> 1], v[x >> 1]);
+		}
+		break;
+		case CONV_BGRX:
+			for (size_t x = 0; x < cap->w; x++, p0 += 4)
+				dst[x] = SHMIF_RGBA(p0[2], p0[1], p0[0], 0xff);
+		break;
+		case CONV_BGR24:
+			for (size_t x = 0; x < cap->w; x++, p0 += 3)
+				dst[x] = SHMIF_RGBA(p0[2], p0[1], p0[0], 0xff);
+		break;
+		case CONV_RGB24:
+			for (size_t x = 0; x < cap->w; x++, p0 += 3)
+				dst[x] = SHMIF_RGBA(p0[0], p0[1], p0[2], 0xff);
+		break;
+		}
+	}
+}
+
+static void requeue(struct v4l2_cap* cap, size_t ind)
+{
+	struct v4l2_plane planes[V4L2_PLANE_LIMIT] = {0};
+	struct v4l2_buffer buf = {
+		.type = cap->type,
+		.memory = V4L2_MEMORY_MMAP,
+		.index = ind
+	};
+
+	if (cap->mplane){
+		buf.m.planes = planes;
+		buf.length = cap->fmt->mem_planes;
+	}
+
+	if (-1 == xioctl(cap->dev, VIDIOC_QBUF, &buf))
+		LOG("kind=error:message=couldn't requeue buffer %zu\n", ind);
+}
+
+static void release_held(struct v4l2_cap* cap)
+{
+	for (size_t i = 0; i < cap->n_held; i++)
+		requeue(cap, cap->held[i]);
+	cap->n_held = 0;
+}
+
+static void hold_buffer(struct v4l2_cap* cap, size_t ind)
+{
+	if (cap->n_held && cap->n_held >= cap->hold){
+		requeue(cap, cap->held[0]);
+		memmove(cap->held, &cap->held[1], sizeof(size_t) * --cap->n_held);
+	}
+	cap->held[cap->n_held++] = ind;
+}
+
+/*
+ * Same event sequence as hardware decoding in a12, one descriptor and one
+ * BUFFERSTREAM per plane counting down [left], then a normal signal.
+ */
+static bool pass_planes(struct v4l2_cap* cap,
+	size_t ind, struct v4l2_plane* mplanes)
+{
+	struct arcan_shmif_cont* C = cap->cont;
+	struct arcan_event ev = {
+		.category = EVENT_EXTERNAL,
+		.ext.kind = ARCAN_EVENT(BUFFERSTREAM)
+	};
+
+	size_t n = cap->fmt->planes;
+	for (size_t i = 0; i < n; i++){
+		const struct plane_layout* L = &cap->layout[i];
+
+/* a failure past the first plane leaves the server with a partial set, it
+ * will reject that and the BUFFER_FAIL puts us on the copy path */
+		if (!arcan_pushhandle(cap->bufs[ind].fd[L->mem], C->epipe))
+			return i > 0;
+
+		ev.ext.bstream.stride = L->stride;
+		ev.ext.bstream.offset = L->offset +
+			(cap->mplane ? mplanes[L->mem].data_offset : 0);
+		ev.ext.bstream.format = cap->fmt->drm;
+		ev.ext.bstream.mod_hi = 0;
+		ev.ext.bstream.mod_lo = 0;
+		ev.ext.bstream.width = cap->w;
+		ev.ext.bstream.height = cap->h;
+		ev.ext.bstream.color_space = cap->color_space;
+		ev.ext.bstream.color_range = cap->color_range;
+		ev.ext.bstream.left = n - i - 1;
+		arcan_shmif_enqueue(C, &ev);
+	}
+
+	arcan_shmif_signal(C, SHMIF_SIGVID);
+	return true;
+}
+
+static bool process_frame(struct v4l2_cap* cap)
+{
+	struct v4l2_plane planes[V4L2_PLANE_LIMIT] = {0};
+	struct v4l2_buffer buf = {
+		.type = cap->type,
+		.memory = V4L2_MEMORY_MMAP
+	};
+
+	if (cap->mplane){
+		buf.m.planes = planes;
+		buf.length = cap->fmt->mem_planes;
+	}
+
+	if (-1 == xioctl(cap->dev, VIDIOC_DQBUF, &buf))
+		return errno == EAGAIN;
+
+	if (buf.index >= cap->n_bufs)
+		return true;
+
+	if (buf.flags & V4L2_BUF_FLAG_ERROR){
+		requeue(cap, buf.index);
+		return true;
+	}
+
+/* the server can refuse at any time, then anything we hold is useless and
+ * should go back to the driver */
+	if (cap->dmabuf && !arcan_shmif_handle_permitted(cap->cont)){
+		LOG("status=feature:dmabuf=false:message=server rejected buffers\n");
+		cap->dmabuf = false;
+		release_held(cap);
+	}
+
+	if (cap->dmabuf && pass_planes(cap, buf.index, planes)){
+		hold_buffer(cap, buf.index);
+		return true;
+	}
+
+	uint8_t* src[V4L2_PLANE_LIMIT];
+	for (size_t i = 0; i < cap->fmt->planes; i++){
+		const struct plane_layout* L = &cap->layout[i];
+		src[i] = cap->bufs[buf.index].map[L->mem] + L->offset +
+			(cap->mplane ? planes[L->mem].data_offset : 0);
+	}
+
+	convert_frame(cap, src);
+	arcan_shmif_signal(cap->cont, SHMIF_SIGVID);
+	requeue(cap, buf.index);
+	return true;
+}
+
+static const struct fmt_map* find_format(uint32_t fourcc, bool mplane)
+{
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+		if (formats[i].v4l2 == fourcc && (formats[i].mem_planes > 1) == mplane)
+			return &formats[i];
+	return NULL;
+}
+
+static uint32_t pick_format(struct v4l2_cap* cap, const char* force)
+{
+	uint32_t best = 0;
+	int best_score = 0;
+
+	for (uint32_t i = 0;; i++){
+		struct v4l2_fmtdesc desc = {
+			.index = i,
+			.type = cap->type
+		};
+		if (-1 == xioctl(cap->dev, VIDIOC_ENUM_FMT, &desc))
+			break;
+
+		const struct fmt_map* fmt = find_format(desc.pixelformat, cap->mplane);
+		if (!fmt)
+			continue;
+
+		if (force){
+			if (strlen(force) == 4 && V4L2_DRM_FOURCC(
+				force[0], force[1], force[2], force[3]) == desc.pixelformat)
+				return desc.pixelformat;
+			continue;
+		}
+
+		int score = cap->dmabuf ? fmt->score_dmabuf : fmt->score_copy;
+		if (score > best_score){
+			best = desc.pixelformat;
+			best_score = score;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * The plane offsets for formats that keep all planes in a single buffer
+ * follow the V4L2 definitions: chroma right after luma at the same stride
+ * for semi-planar and half stride for planar.
+ */
+static bool setup_layout(struct v4l2_cap* cap, struct v4l2_format* fmt)
+{
+	const struct fmt_map* F = cap->fmt;
+
+	if (cap->mplane){
+		if (fmt->fmt.pix_mp.num_planes != F->mem_planes)
+			return false;
+
+		for (size_t i = 0; i < F->planes; i++){
+			cap->layout[i] = (struct plane_layout){
+				.mem = i,
+				.stride = fmt->fmt.pix_mp.plane_fmt[i].bytesperline,
+				.rows = i ? cap->h / F->vsub : cap->h
+			};
+		}
+		return true;
+	}
+
+	size_t bpl = fmt->fmt.pix.bytesperline;
+	size_t ch = cap->h / F->vsub;
+
+	cap->layout[0] = (struct plane_layout){
+		.stride = bpl,
+		.rows = cap->h
+	};
+
+	if (F->planes == 2){
+		cap->layout[1] = (struct plane_layout){
+			.offset = bpl * cap->h,
+			.stride = bpl,
+			.rows = ch
+		};
+	}
+	else if (F->planes == 3){
+		cap->layout[1] = (struct plane_layout){
+			.offset = bpl * cap->h,
+			.stride = bpl / 2,
+			.rows = ch
+		};
+		cap->layout[2] = (struct plane_layout){
+			.offset = bpl * cap->h + (bpl / 2) * ch,
+			.stride = bpl / 2,
+			.rows = ch
+		};
+	}
+
+	return true;
+}
+
+static void set_color(struct v4l2_cap* cap, uint32_t cs, uint32_t quant)
+{
+	switch (cs){
+	case V4L2_COLORSPACE_SMPTE170M:
+	case V4L2_COLORSPACE_470_SYSTEM_BG:
+	case V4L2_COLORSPACE_JPEG:
+		cap->color_space = SHMIFEXT_CS_BT601;
+	break;
+	case V4L2_COLORSPACE_REC709:
+		cap->color_space = SHMIFEXT_CS_BT709;
+	break;
+	case V4L2_COLORSPACE_BT2020:
+		cap->color_space = SHMIFEXT_CS_BT2020;
+	break;
+	default:
+		cap->color_space = SHMIFEXT_CS_DEFAULT;
+	break;
+	}
+
+	if (quant == V4L2_QUANTIZATION_FULL_RANGE || cs == V4L2_COLORSPACE_JPEG)
+		cap->color_range = SHMIFEXT_RANGE_FULL;
+	else if (quant == V4L2_QUANTIZATION_LIM_RANGE)
+		cap->color_range = SHMIFEXT_RANGE_NARROW;
+	else
+		cap->color_range = SHMIFEXT_RANGE_DEFAULT;
+}
+
+static bool setup_buffers(struct v4l2_cap* cap, size_t count)
+{
+	struct v4l2_requestbuffers req = {
+		.count = count,
+		.type = cap->type,
+		.memory = V4L2_MEMORY_MMAP
+	};
+
+	if (-1 == xioctl(cap->dev, VIDIOC_REQBUFS, &req) || req.count < 2)
+		return false;
+
+	cap->n_bufs = req.count > V4L2_BUFFER_LIMIT ? V4L2_BUFFER_LIMIT : req.count;
+	size_t n_mem = cap->fmt->mem_planes;
+
+	for (size_t i = 0; i < cap->n_bufs; i++)
+		for (size_t j = 0; j < V4L2_PLANE_LIMIT; j++){
+			cap->bufs[i].fd[j] = -1;
+			cap->bufs[i].map[j] = MAP_FAILED;
+		}
+
+	for (size_t i = 0; i < cap->n_bufs; i++){
+		struct v4l2_buf* B = &cap->bufs[i];
+		struct v4l2_plane planes[V4L2_PLANE_LIMIT] = {0};
+		struct v4l2_buffer buf = {
+			.type = cap->type,
+			.memory = V4L2_MEMORY_MMAP,
+			.index = i
+		};
+
+		if (cap->mplane){
+			buf.m.planes = planes;
+			buf.length = n_mem;
+		}
+
+		if (-1 == xioctl(cap->dev, VIDIOC_QUERYBUF, &buf))
+			return false;
+
+		for (size_t j = 0; j < n_mem; j++){
+			size_t len = cap->mplane ? planes[j].length : buf.length;
+			off_t ofs = cap->mplane ? planes[j].m.mem_offset : buf.m.offset;
+
+			B->map_sz[j] = len;
+			B->map[j] = mmap(NULL, len, PROT_READ, MAP_SHARED, cap->dev, ofs);
+			if (MAP_FAILED == B->map[j])
+				return false;
+
+			if (!cap->dmabuf)
+				continue;
+
+			struct v4l2_exportbuffer exp = {
+				.type = cap->type,
+				.index = i,
+				.plane = j,
+				.flags = O_RDONLY | O_CLOEXEC
+			};
+
+			if (-1 == xioctl(cap->dev, VIDIOC_EXPBUF, &exp)){
+				LOG("status=feature:dmabuf=false:message=export failed (%s)\n",
+					strerror(errno));
+				cap->dmabuf = false;
+			}
+			else
+				B->fd[j] = exp.fd;
+		}
+	}
+
+/* the planes need to fit in the buffers for the copy path to be safe */
+	for (size_t i = 0; i < cap->fmt->planes; i++){
+		const struct plane_layout* L = &cap->layout[i];
+		size_t row = cap->fmt->conv == CONV_PACKED422 ? cap->w * 2 :
+			(cap->fmt->conv == CONV_BGRX ? cap->w * 4 :
+			(cap->fmt->conv == CONV_PLANAR || cap->fmt->conv == CONV_SEMIPLANAR ?
+			cap->w : cap->w * 3));
+		if (i)
+			row = cap->fmt->conv == CONV_PLANAR ? (cap->w + 1) / 2 : (cap->w + 1) & ~1;
+
+		if (L->stride < row || L->offset + L->stride * L->rows >
+			cap->bufs[0].map_sz[L->mem])
+			return false;
+	}
+
+	for (size_t i = 0; i < cap->n_bufs; i++)
+		requeue(cap, i);
+
+	return true;
+}
+
+static void cap_free(struct v4l2_cap* cap)
+{
+	if (cap->streaming)
+		xioctl(cap->dev, VIDIOC_STREAMOFF, &cap->type);
+
+	for (size_t i = 0; i < cap->n_bufs; i++){
+		for (size_t j = 0; j < V4L2_PLANE_LIMIT; j++){
+			if (-1 != cap->bufs[i].fd[j])
+				close(cap->bufs[i].fd[j]);
+			if (MAP_FAILED != cap->bufs[i].map[j])
+				munmap(cap->bufs[i].map[j], cap->bufs[i].map_sz[j]);
+		}
+	}
+
+	if (cap->n_bufs){
+		struct v4l2_requestbuffers req = {
+			.count = 0,
+			.type = cap->type,
+			.memory = V4L2_MEMORY_MMAP
+		};
+		xioctl(cap->dev, VIDIOC_REQBUFS, &req);
+	}
+
+	if (-1 != cap->dev)
+		close(cap->dev);
+}
+
+static int open_device(const char* path, bool* mplane)
+{
+	int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (-1 == fd)
+		return -1;
+
+	struct v4l2_capability caps = {0};
+	if (-1 == xioctl(fd, VIDIOC_QUERYCAP, &caps)){
+		close(fd);
+		return -1;
+	}
+
+	uint32_t dc = (caps.capabilities & V4L2_CAP_DEVICE_CAPS) ?
+		caps.device_caps : caps.capabilities;
+
+	if (!(dc & V4L2_CAP_STREAMING) ||
+		!(dc & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE))){
+		close(fd);
+		return -1;
+	}
+
+	*mplane = !(dc & V4L2_CAP_VIDEO_CAPTURE);
+	return fd;
+}
+
+static void list_devices(struct arcan_shmif_cont* cont)
+{
+	for (size_t i = 0; i < 64; i++){
+		char path[sizeof("/dev/videoNN")];
+		snprintf(path, sizeof(path), "/dev/video%zu", i);
+
+		bool mplane;
+		int fd = open_device(path, &mplane);
+		if (-1 == fd)
+			continue;
+
+		struct v4l2_capability caps = {0};
+		xioctl(fd, VIDIOC_QUERYCAP, &caps);
+		close(fd);
+
+		struct arcan_event ev = {
+			.category = EVENT_EXTERNAL,
+			.ext.kind = ARCAN_EVENT(MESSAGE)
+		};
+
+		size_t nb = sizeof(ev.ext.message.data) / sizeof(ev.ext.message.data[0]);
+		snprintf((char*) ev.ext.message.data, nb, "v4l2=%zu:card=%.32s\n",
+			i, (char*) caps.card);
+
+		fputs((char*)ev.ext.message.data, stdout);
+		if (cont)
+			arcan_shmif_enqueue(cont, &ev);
+	}
+}
+
+bool v4l2_support_activate(
+	struct arcan_shmif_cont* cont, struct arg_arr* args)
+{
+	const char* val;
+
+	if (arg_lookup(args, "no_v4l2", 0, NULL))
+		return false;
+
+/* uvc (if available) and vlc get to list their devices as well */
+	if (arg_lookup(args, "list", 0, NULL)){
+		list_devices(cont);
+		return false;
+	}
+
+	if (!cont)
+		return false;
+
+	char path[sizeof("/dev/videoNNN")];
+	const char* devpath = path;
+	unsigned devind = 0;
+
+	if (arg_lookup(args, "device", 0, &val) && val)
+		devind = strtoul(val, NULL, 10);
+	snprintf(path, sizeof(path), "/dev/video%u", devind % 1000);
+
+	if (arg_lookup(args, "v4l2_dev", 0, &val) && val)
+		devpath = val;
+
+	struct v4l2_cap cap = {
+		.cont = cont,
+		.dmabuf = !arg_lookup(args, "v4l2_copy", 0, NULL)
+	};
+
+/* not being able to open it is not an error as such, just not ours */
+	cap.dev = open_device(devpath, &cap.mplane);
+	if (-1 == cap.dev)
+		return false;
+
+	cap.type = cap.mplane ?
+		V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+	const char* force = NULL;
+	arg_lookup(args, "v4l2_fmt", 0, &force);
+
+	uint32_t fourcc = pick_format(&cap, force);
+	if (!fourcc){
+		LOG("kind=error:message=%s has no supported format\n", devpath);
+		cap_free(&cap);
+		return false;
+	}
+
+	struct v4l2_format fmt = {
+		.type = cap.type
+	};
+
+	if (-1 == xioctl(cap.dev, VIDIOC_G_FMT, &fmt)){
+		cap_free(&cap);
+		return false;
+	}
+
+	size_t width = 0, height = 0;
+	if (arg_lookup(args, "width", 0, &val) && val)
+		width = strtoul(val, NULL, 10);
+	if (arg_lookup(args, "height", 0, &val) && val)
+		height = strtoul(val, NULL, 10);
+
+	if (cap.mplane){
+		fmt.fmt.pix_mp.pixelformat = fourcc;
+		fmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+		if (width && height){
+			fmt.fmt.pix_mp.width = width;
+			fmt.fmt.pix_mp.height = height;
+		}
+	}
+	else {
+		fmt.fmt.pix.pixelformat = fourcc;
+		fmt.fmt.pix.field = V4L2_FIELD_NONE;
+		if (width && height){
+			fmt.fmt.pix.width = width;
+			fmt.fmt.pix.height = height;
+		}
+	}
+
+/* the driver is free to adjust, what we get back is what we use */
+	if (-1 == xioctl(cap.dev, VIDIOC_S_FMT, &fmt)){
+		arcan_shmif_last_words(cont, "v4l2 device rejected format");
+		cap_free(&cap);
+		arcan_shmif_drop(cont);
+		return true;
+	}
+
+	if (cap.mplane){
+		cap.w = fmt.fmt.pix_mp.width;
+		cap.h = fmt.fmt.pix_mp.height;
+		cap.fmt = find_format(fmt.fmt.pix_mp.pixelformat, true);
+		set_color(&cap, fmt.fmt.pix_mp.colorspace, fmt.fmt.pix_mp.quantization);
+	}
+	else {
+		cap.w = fmt.fmt.pix.width;
+		cap.h = fmt.fmt.pix.height;
+		cap.fmt = find_format(fmt.fmt.pix.pixelformat, false);
+		set_color(&cap, fmt.fmt.pix.colorspace, fmt.fmt.pix.quantization);
+	}
+
+	if (!cap.fmt || !cap.w || !cap.h || cap.w > ARCAN_SHMPAGE_MAXW ||
+		cap.h > ARCAN_SHMPAGE_MAXH || !setup_layout(&cap, &fmt)){
+		arcan_shmif_last_words(cont, "v4l2 device returned unusable format");
+		cap_free(&cap);
+		arcan_shmif_drop(cont);
+		return true;
+	}
+
+	if (arg_lookup(args, "fps", 0, &val) && val){
+		struct v4l2_streamparm parm = {
+			.type = cap.type
+		};
+		unsigned long fps = strtoul(val, NULL, 10);
+		if (fps && -1 != xioctl(cap.dev, VIDIOC_G_PARM, &parm) &&
+			(parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)){
+			parm.parm.capture.timeperframe.numerator = 1;
+			parm.parm.capture.timeperframe.denominator = fps;
+			xioctl(cap.dev, VIDIOC_S_PARM, &parm);
+		}
+	}
+
+/* more buffers absorb jitter in the consumer, fewer keep the latency down,
+ * with dma-buf half of them are held for the server */
+	size_t count = 4;
+	if (arg_lookup(args, "v4l2_buffers", 0, &val) && val){
+		count = strtoul(val, NULL, 10);
+		count = count < 2 ? 2 : (count > V4L2_BUFFER_LIMIT ? V4L2_BUFFER_LIMIT : count);
+	}
+
+	if (!setup_buffers(&cap, count)){
+		arcan_shmif_last_words(cont, "v4l2 buffer setup failed");
+		cap_free(&cap);
+		arcan_shmif_drop(cont);
+		return true;
+	}
+	cap.hold = cap.n_bufs / 2;
+
+	if (!arcan_shmif_resize(cont, cap.w, cap.h)){
+		arcan_shmif_last_words(cont, "couldn't resize segment to capture size");
+		cap_free(&cap);
+		arcan_shmif_drop(cont);
+		return true;
+	}
+
+	if (-1 == xioctl(cap.dev, VIDIOC_STREAMON, &cap.type)){
+		arcan_shmif_last_words(cont, "v4l2 stream start failed");
+		cap_free(&cap);
+		arcan_shmif_drop(cont);
+		return true;
+	}
+	cap.streaming = true;
+
+	LOG("status=streaming:device=%s:w=%zu:h=%zu:fourcc=%.4s:buffers=%zu:dmabuf=%s\n",
+		devpath, cap.w, cap.h, (char*) &cap.fmt->v4l2, cap.n_bufs,
+		cap.dmabuf ? "true" : "false");
+
+	arcan_shmif_privsep(cont, "minimal", NULL, 0);
+
+	bool running = true;
+	while (running){
+		struct pollfd pfd[2] = {
+			{
+				.fd = cap.dev,
+				.events = POLLIN | POLLERR | POLLHUP | POLLNVAL
+			},
+			{
+				.fd = cont->epipe,
+				.events = POLLIN | POLLERR | POLLHUP | POLLNVAL
+			}
+		};
+
+		if (-1 == poll(pfd, 2, -1)){
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			break;
+		}
+
+		if (pfd[1].revents){
+			struct arcan_event ev;
+			int rv;
+			while ((rv = arcan_shmif_poll(cont, &ev)) > 0){
+				if (ev.category == EVENT_TARGET && ev.tgt.kind == TARGET_COMMAND_EXIT)
+					running = false;
+			}
+			if (rv < 0)
+				running = false;
+		}
+
+		if (pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL)){
+			arcan_shmif_last_words(cont, "capture device lost");
+			break;
+		}
+
+		if ((pfd[0].revents & POLLIN) && !process_frame(&cap)){
+			arcan_shmif_last_words(cont, "capture dequeue failed");
+			break;
+		}
+	}
+
+	cap_free(&cap);
+	arcan_shmif_drop(cont);
+	return true;
+}
+
+void v4l2_append_help(FILE* out)
+{
+	fprintf(out, "\nV4L2 capture arguments:\n"
+	"   key      \t   value   \t  description\n"
+	"------------\t-----------\t----------------\n"
+	"no_v4l2     \t           \t skip v4l2 in capture device processing chain\n"
+	"device      \t number    \t use /dev/video[number] (=0)\n"
+	"v4l2_dev    \t path      \t use a specific video node\n"
+	"v4l2_fmt    \t fourcc    \t force a capture format (e.g. NV12, YUYV)\n"
+	"v4l2_buffers\t n         \t number of capture buffers, 2..32 (=4)\n"
+	"            \t           \t fewer lowers latency, more absorbs stalls\n"
+	"v4l2_copy   \t           \t convert into the segment, no dma-buf passing\n"
+	"width       \t px        \t preferred capture width\n"
+	"height      \t px        \t preferred capture height\n"
+	"fps         \t nframes   \t preferred capture framerate\n"
+	);
+}
@@ -0,0 +1,16 @@
+#ifndef HAVE_V4L2_SUPPORT
+#define HAVE_V4L2_SUPPORT
+
+/*
+ * Capture straight from a kernel video node (V4L2), before the libuvc and
+ * libvlc paths. Returns true if the control loop was taken over (and exited),
+ * false if there was no usable device so the next capture method can try.
+ */
+bool v4l2_support_activate(struct arcan_shmif_cont* cont, struct arg_arr* args);
+
+/*
+ * Just add text help output for the V4L2 specific arguments
+ */
+void v4l2_append_help(FILE*);
+
+#endif
@@ -8,6 +8,7 @@
 #include <arcan_shmif_server.h>
 
 #include "a12.h"
+#include "encode.h"
 
 #include <errno.h>
 #include <sys/types.h>
@@ -112,8 +113,13 @@ static void process_shmif(struct a12_state* S, struct dispatch_data* data)
  * that gets sent in advanced, and forwarded unless the main frame arrives
  * in time. Then the SNR can be adjusted to match the quality of the link
  * for the time being. */
+		case TARGET_COMMAND_BUFFERSTREAM:
+			if (!encode_buffer_event(data->C, &ev, NULL))
+				break;
+/* fallthrough */
 		case TARGET_COMMAND_STEPFRAME:{
 			flush_av(S, data);
+			encode_buffer_release(data->C);
 			arcan_shmif_signal(data->C, SHMIF_SIGVID | SHMIF_SIGAUD);
 		}
 		default:
@@ -317,6 +323,7 @@ void a12_serv_run(struct arg_arr* arg, struct arcan_shmif_cont cont)
 	if (!decode_args(arg, &data)){
 		return;
 	}
+	encode_buffer_enable(&cont);
 
 	data.net_cfg.opts->pk_lookup = key_auth_local;
 	data.net_cfg.keystore.type = A12HELPER_PROVIDER_BASEDIR;
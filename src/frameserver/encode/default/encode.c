@@ -17,6 +17,12 @@
 #include <sys/stat.h>
 #include <assert.h>
 
+#ifdef __LINUX
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/dma-buf.h>
+#endif
+
 #include <arcan_shmif.h>
 #include "frameserver.h"
 #include "encode.h"
@@ -35,7 +41,9 @@ static void dump_help()
 		"--------\t-----------\t-----------------\n"
 		" name   \t string    \t set exported 'desktopName'\n"
 		" pass   \t string    \t set server password (insecure)\n"
-		" port   \t number    \t set server listen port\n\n"
+		" port   \t number    \t set server listen port\n"
+		" compress\t 0..9     \t override client zlib/tight/zrle compression level\n"
+		" nocopyrect\t        \t disable scroll detection (copy-rect updates)\n\n"
 #endif
 #ifdef HAVE_V4L2
 		"protocol=cam\n"
@@ -44,13 +52,17 @@ static void dump_help()
 		" device \t  number   \t set videoN device to write into (/dev/videoN)\n"
 		" format \t  pxfmt    \t output pixel format (rgb, bgr)\n"
 		" fps    \t  fps      \t (=25), target framerate\n"
+		" buffers\t  n        \t (=2), mmap buffers, more smooths out uneven output\n"
 		" fdout  \t           \t slow write path instead of mmap\n\n"
 #endif
 #ifdef HAVE_OCR
 		"protocol=ocr\n"
 		"  key   \t   value   \t   description\n"
 		"--------\t-----------\t-----------------\n"
-		" lang   \t string    \t set OCR engine language (default: eng)\n\n"
+		" lang   \t string    \t set OCR engine language (default: eng)\n"
+		" workers\t number    \t recognizer threads (default: cores, max 4)\n"
+		" cache  \t number    \t remembered region results (default: 256, 0 disables)\n"
+		" full   \t           \t recognize the whole frame on change, not the changed regions\n\n"
 #endif
 		"protocol=a12\n"
 		" key    \t   value   \t   description\n"
@@ -76,7 +88,10 @@ static void dump_help()
 		"vptsofs   \t ms        \t delay video presentation\n"
 		"aptsofs   \t ms        \t delay audio presentation\n"
 		"presilence\t ms        \t buffer audio with silence\n"
-		"vcodec    \t format    \t try to specify video codec\n"
+		"profile   \t name      \t (throughput) or latency: no lookahead, CBR, intra refresh\n"
+		"vqueue    \t 1..16     \t (4, latency: 1) frames queued for the encoder\n"
+		"cthreads  \t num       \t colour conversion threads (default: cores)\n"
+		"vcodec    \t format    \t try to specify video codec, auto: fastest on host\n"
 		"acodec    \t format    \t try to specify audio codec\n"
 		"container \t format    \t try to specify container format\n"
 		"stream    \t           \t enable remote streaming\n"
@@ -84,6 +99,146 @@ static void dump_help()
 	);
 }
 
+/*
+ * Frames delivered as buffers rather than through the vbuffer, see
+ * TARGET_COMMAND_BUFFERSTREAM. Only single-plane linear layouts in a packing
+ * we can consume are mapped here, anything else clears the hint so that the
+ * server goes back to the vbuffer path.
+ */
+#define FOURCC(a, b, c, d) \
+	((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+static struct {
+	int fd;
+	void* map;
+	size_t map_sz;
+	bool skip_planes;
+
+/* the regular vbuffer fields, restored on release */
+	shmif_pixel* vidp;
+	size_t pitch, stride;
+} import = {
+	.fd = -1
+};
+
+void encode_buffer_enable(struct arcan_shmif_cont* C)
+{
+#ifdef __LINUX
+	atomic_fetch_or(&C->addr->hints, SHMIF_RHINT_IMPORT_BUFFER);
+#endif
+}
+
+static void import_reject(struct arcan_shmif_cont* C, const char* reason)
+{
+	LOG("(encode) buffer import rejected (%s), reverting to shm\n", reason);
+	atomic_fetch_and(&C->addr->hints, ~SHMIF_RHINT_IMPORT_BUFFER);
+	C->addr->vready = false;
+}
+
+bool encode_buffer_event(
+	struct arcan_shmif_cont* C, struct arcan_event* ev, bool* swap_rb)
+{
+#ifdef __LINUX
+	if (ev->tgt.ioevs[1].iv > 0){
+		if (!import.skip_planes)
+			import_reject(C, "multi-planar");
+		import.skip_planes = true;
+		return false;
+	}
+
+	if (import.skip_planes || import.map){
+		import.skip_planes = false;
+		return false;
+	}
+
+/* the memory order that matches shmif_pixel, or the one with r/b swapped */
+	bool bgra = SHMIF_RGBA(0, 0, 255, 0) == 0xff;
+	uint32_t fmt = ev->tgt.ioevs[4].uiv;
+	bool swap;
+	if (fmt == FOURCC('A','R','2','4') || fmt == FOURCC('X','R','2','4'))
+		swap = !bgra;
+	else if (fmt == FOURCC('A','B','2','4') || fmt == FOURCC('X','B','2','4'))
+		swap = bgra;
+	else {
+		import_reject(C, "format");
+		return false;
+	}
+
+	if (swap && !swap_rb){
+		import_reject(C, "channel order");
+		return false;
+	}
+
+/* tiled layouts would need a GPU side import, 0 is DRM_FORMAT_MOD_LINEAR */
+	if (ev->tgt.ioevs[5].uiv || ev->tgt.ioevs[6].uiv){
+		import_reject(C, "non-linear modifier");
+		return false;
+	}
+
+	size_t stride = ev->tgt.ioevs[2].uiv;
+	size_t offset = ev->tgt.ioevs[3].uiv;
+	if (stride < C->w * sizeof(shmif_pixel) || stride % sizeof(shmif_pixel)){
+		import_reject(C, "stride");
+		return false;
+	}
+
+/* the event descriptor is closed by shmif on the next event */
+	int fd = dup(ev->tgt.ioevs[0].iv);
+	if (-1 == fd){
+		import_reject(C, "dup");
+		return false;
+	}
+
+	size_t map_sz = offset + stride * C->h;
+	void* map = mmap(NULL, map_sz, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED){
+		close(fd);
+		import_reject(C, "mmap");
+		return false;
+	}
+
+/* waits for the rendering that was submitted towards the buffer */
+	struct dma_buf_sync sync = {.flags = DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ};
+	ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+
+	import.fd = fd;
+	import.map = map;
+	import.map_sz = map_sz;
+	import.vidp = C->vidp;
+	import.pitch = C->pitch;
+	import.stride = C->stride;
+
+	C->vidp = (shmif_pixel*)((uint8_t*) map + offset);
+	C->stride = stride;
+	C->pitch = stride / sizeof(shmif_pixel);
+
+	if (swap_rb)
+		*swap_rb = swap;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void encode_buffer_release(struct arcan_shmif_cont* C)
+{
+#ifdef __LINUX
+	if (!import.map)
+		return;
+
+	struct dma_buf_sync sync = {.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ};
+	ioctl(import.fd, DMA_BUF_IOCTL_SYNC, &sync);
+	munmap(import.map, import.map_sz);
+	close(import.fd);
+
+	import.map = NULL;
+	import.fd = -1;
+	C->vidp = import.vidp;
+	C->pitch = import.pitch;
+	C->stride = import.stride;
+#endif
+}
+
 int afsrv_encode(struct arcan_shmif_cont* cont, struct arg_arr* args)
 {
 	const char* argval;
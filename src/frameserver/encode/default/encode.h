@@ -1,4 +1,4 @@
-extern int a12_serv_run(struct arg_arr*, struct arcan_shmif_cont);
+extern void a12_serv_run(struct arg_arr*, struct arcan_shmif_cont);
 
 #ifdef HAVE_VNCSERVER
 extern void vnc_serv_run(struct arg_arr*, struct arcan_shmif_cont);
@@ -15,3 +15,15 @@ void ocr_serv_run(struct arg_arr* args, struct arcan_shmif_cont cont);
 #endif
 
 int ffmpeg_run(struct arg_arr* args, struct arcan_shmif_cont* C);
+
+/*
+ * Opt in to frames delivered as GPU buffers (TARGET_COMMAND_BUFFERSTREAM).
+ * Feed those events to _buffer_event, when it returns true the frame has been
+ * mapped into C->vidp (with stride/pitch updated) and should be treated as a
+ * STEPFRAME, followed by _buffer_release once done with the contents. If
+ * [swap_rb] is provided, r/b swapped layouts are accepted and flagged there.
+ */
+void encode_buffer_enable(struct arcan_shmif_cont* C);
+bool encode_buffer_event(
+	struct arcan_shmif_cont* C, struct arcan_event* ev, bool* swap_rb);
+void encode_buffer_release(struct arcan_shmif_cont* C);
@@ -9,14 +9,19 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <errno.h>
+#include <math.h>
 
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <assert.h>
 
 #include <arcan_shmif.h>
 #include "frameserver.h"
+#include "encode.h"
 
 #include <libavcodec/avcodec.h>
 #include <libavcodec/version.h>
@@ -42,9 +47,8 @@ static struct {
 	AVFormatContext* fcontext;
 
 /* VIDEO */
-/* color format conversion (ccontext) is also used for
- * just populating the image/ color planes properly */
-	struct SwsContext* ccontext;
+/* imported buffers may come with r/b swapped compared to shmif */
+	bool swap_rb;
 	AVCodecContext* vcontext;
 	AVStream* vstream;
 	const AVCodec* vcodec;
@@ -95,8 +99,77 @@ struct cl_track {
 	unsigned conn_id;
 };
 
+/*
+ * Video goes through a pipeline so that a slow encoder preset doesn't hold up
+ * the shmif side: the main thread converts the frame (in horizontal bands
+ * spread over the conv workers) into a free slot in the frame queue and can
+ * release the source buffer right away. The encoder thread drains the frame
+ * queue into packets for the muxer thread, which is also fed audio packets
+ * from the main thread and is the only one writing to the output.
+ *
+ * When the frame queue is full the frame is dropped and folded into the most
+ * recent queued slot as a repeat, so the output framerate holds.
+ */
+#define VQUEUE_DEFAULT 4
+#define VQUEUE_LIMIT 16
+#define MQUEUE_LIMIT 64
+#define CONV_LIMIT 8
+
+struct vslot {
+	AVFrame* frame;
+	int64_t pts;
+	int repeat;
+};
+
+struct mpacket {
+	AVPacket* pkt;
+	struct mpacket* next;
+};
+
+static struct {
+	bool running;
+	pthread_t encoder, muxer;
+	pthread_mutex_t lock;
+	pthread_cond_t vcond, mcond, mspace;
+
+/* ring of converted frames, [taken] is set while the encoder works on head */
+	struct vslot slots[VQUEUE_LIMIT];
+	size_t n_slots, head, count;
+	bool taken, vdone;
+
+	struct mpacket* mfirst, (* mlast);
+	size_t mcount;
+	bool mdone;
+
+/* set by either thread on encode/write errors, main thread exits on it */
+	_Atomic bool failed;
+
+/* reported as STREAMSTATUS */
+	unsigned long encoded, dropped, worst_depth;
+	long long last_status;
+} vpipe;
+
+struct conv_band {
+	struct SwsContext* ctx;
+	struct SwsContext* ctx_swap;
+	int y, h;
+};
+
+static struct {
+	size_t n;
+	pthread_t threads[CONV_LIMIT];
+	pthread_mutex_t lock;
+	pthread_cond_t wake, done;
+	unsigned gen;
+	size_t pending;
+	AVFrame* dst;
+	bool swap;
+	struct conv_band bands[CONV_LIMIT];
+} conv;
+
 static bool encode_audio(bool);
 static int encode_video(bool);
+static void vpipe_stop();
 
 static void stop_output()
 {
@@ -117,9 +190,7 @@ static void stop_output()
 		encode_audio(true);
 	}
 
-	if (recctx.vcontext)
-		encode_video(true);
-
+	vpipe_stop();
 	av_write_trailer(recctx.fcontext);
 
 	if (recctx.astream){
@@ -269,7 +340,36 @@ static uint8_t* s16swrconv(int* size, int* nsamp)
 	return resamp_outbuf[0];
 }
 
-static void write_frame(AVCodecContext* AV,
+/* hand a packet over to the muxer thread, [wait] applies backpressure to
+ * the video encoder while audio from the main thread never blocks */
+static void mux_packet(AVPacket* pkt, bool wait)
+{
+	struct mpacket* mp = malloc(sizeof(struct mpacket));
+	if (!mp || !(mp->pkt = av_packet_alloc())){
+		LOG("(encode) couldn't queue packet, out of memory\n");
+		free(mp);
+		vpipe.failed = true;
+		return;
+	}
+	av_packet_move_ref(mp->pkt, pkt);
+	mp->next = NULL;
+
+	pthread_mutex_lock(&vpipe.lock);
+	while (wait && vpipe.mcount >= MQUEUE_LIMIT && !vpipe.failed)
+		pthread_cond_wait(&vpipe.mspace, &vpipe.lock);
+
+	if (vpipe.mlast)
+		vpipe.mlast->next = mp;
+	else
+		vpipe.mfirst = mp;
+	vpipe.mlast = mp;
+	vpipe.mcount++;
+
+	pthread_cond_signal(&vpipe.mcond);
+	pthread_mutex_unlock(&vpipe.lock);
+}
+
+static bool write_frame(AVCodecContext* AV,
 	AVFrame* frame, AVPacket* pkt, AVStream* stream, bool flush)
 {
 	int rv = avcodec_send_frame(AV, frame);
@@ -280,18 +380,340 @@ static void write_frame(AVCodecContext* AV,
 			break;
 		else if (rv < 0){
 			LOG("(encode) : Frame error: %s\n", av_err2str(rv));
-			exit(EXIT_FAILURE);
+			return false;
 		}
 
 		av_packet_rescale_ts(pkt, AV->time_base, stream->time_base);
 		pkt->stream_index = stream->index;
 
-		rv = av_interleaved_write_frame(recctx.fcontext, pkt);
-		if (rv < 0 && !flush){
-			LOG("(encode) : Writing frame failed: %s\n", av_err2str(rv));
-			exit(EXIT_FAILURE);
+		mux_packet(pkt, AV == recctx.vcontext && !flush);
+	}
+
+	return true;
+}
+
+static void* muxer_thread(void* tag)
+{
+	pthread_mutex_lock(&vpipe.lock);
+	for(;;){
+		while (!vpipe.mfirst && !vpipe.mdone)
+			pthread_cond_wait(&vpipe.mcond, &vpipe.lock);
+
+		struct mpacket* mp = vpipe.mfirst;
+		if (!mp)
+			break;
+
+		if (!(vpipe.mfirst = mp->next))
+			vpipe.mlast = NULL;
+		bool flush = vpipe.mdone;
+		pthread_mutex_unlock(&vpipe.lock);
+
+/* after a failure the queue is still drained so that no producer blocks */
+		if (!vpipe.failed){
+			int rv = av_interleaved_write_frame(recctx.fcontext, mp->pkt);
+			if (rv < 0 && !flush){
+				LOG("(encode) : Writing frame failed: %s\n", av_err2str(rv));
+				vpipe.failed = true;
+			}
+		}
+		av_packet_free(&mp->pkt);
+		free(mp);
+
+		pthread_mutex_lock(&vpipe.lock);
+		vpipe.mcount--;
+		pthread_cond_signal(&vpipe.mspace);
+	}
+	pthread_mutex_unlock(&vpipe.lock);
+
+	return NULL;
+}
+
+static void* encoder_thread(void* tag)
+{
+	pthread_mutex_lock(&vpipe.lock);
+	for(;;){
+		while (!vpipe.count && !vpipe.vdone)
+			pthread_cond_wait(&vpipe.vcond, &vpipe.lock);
+
+		if (!vpipe.count)
+			break;
+
+		struct vslot* slot = &vpipe.slots[vpipe.head];
+		vpipe.taken = true;
+		int64_t pts = slot->pts;
+		int repeat = slot->repeat;
+		pthread_mutex_unlock(&vpipe.lock);
+
+		for (int i = 0; i < repeat && !vpipe.failed; i++){
+			slot->frame->pts = pts + i;
+			if (!write_frame(recctx.vcontext,
+				slot->frame, recctx.vpacket, recctx.vstream, false))
+				vpipe.failed = true;
+		}
+
+		pthread_mutex_lock(&vpipe.lock);
+		vpipe.encoded += repeat;
+		vpipe.taken = false;
+		vpipe.head = (vpipe.head + 1) % vpipe.n_slots;
+		vpipe.count--;
+	}
+	pthread_mutex_unlock(&vpipe.lock);
+
+	write_frame(recctx.vcontext, NULL, recctx.vpacket, recctx.vstream, true);
+	return NULL;
+}
+
+static void convert_band(struct conv_band* band, AVFrame* dst, bool swap)
+{
+	struct arcan_shmif_cont* C = &recctx.shmcont;
+
+	if (swap && !band->ctx_swap)
+		band->ctx_swap = sws_getContext(C->addr->w, band->h,
+			SHMIF_RGBA(0,0,255,0) == 0xff ? AV_PIX_FMT_RGBA : AV_PIX_FMT_BGRA,
+			C->addr->w, band->h, AV_PIX_FMT_YUV420P,
+			SWS_FAST_BILINEAR, NULL, NULL, NULL
+		);
+
+	const uint8_t* srcpl[4] = {(uint8_t*)C->vidp + band->y * C->stride};
+	int srcstr[4] = {C->stride};
+
+/* bands start on even rows so the chroma planes split cleanly */
+	uint8_t* dstpl[4] = {
+		dst->data[0] + band->y * dst->linesize[0],
+		dst->data[1] + (band->y >> 1) * dst->linesize[1],
+		dst->data[2] + (band->y >> 1) * dst->linesize[2]
+	};
+
+	sws_scale(swap ? band->ctx_swap : band->ctx,
+		srcpl, srcstr, 0, band->h, dstpl, dst->linesize);
+}
+
+static void* conv_thread(void* tag)
+{
+	struct conv_band* band = tag;
+	unsigned gen = 0;
+
+	pthread_mutex_lock(&conv.lock);
+	for(;;){
+		while (conv.gen == gen)
+			pthread_cond_wait(&conv.wake, &conv.lock);
+		gen = conv.gen;
+
+		if (!conv.dst)
+			break;
+
+		pthread_mutex_unlock(&conv.lock);
+		convert_band(band, conv.dst, conv.swap);
+		pthread_mutex_lock(&conv.lock);
+
+		if (!--conv.pending)
+			pthread_cond_signal(&conv.done);
+	}
+	pthread_mutex_unlock(&conv.lock);
+
+	return NULL;
+}
+
+static void convert_frame(AVFrame* dst, bool swap)
+{
+	if (conv.n > 1){
+		pthread_mutex_lock(&conv.lock);
+		conv.dst = dst;
+		conv.swap = swap;
+		conv.pending = conv.n - 1;
+		conv.gen++;
+		pthread_cond_broadcast(&conv.wake);
+		pthread_mutex_unlock(&conv.lock);
+	}
+
+	convert_band(&conv.bands[0], dst, swap);
+
+	if (conv.n > 1){
+		pthread_mutex_lock(&conv.lock);
+		while (conv.pending)
+			pthread_cond_wait(&conv.done, &conv.lock);
+		pthread_mutex_unlock(&conv.lock);
+	}
+}
+
+static void conv_stop()
+{
+	if (conv.n > 1){
+		pthread_mutex_lock(&conv.lock);
+		conv.dst = NULL;
+		conv.gen++;
+		pthread_cond_broadcast(&conv.wake);
+		pthread_mutex_unlock(&conv.lock);
+
+		for (size_t i = 1; i < conv.n; i++)
+			pthread_join(conv.threads[i], NULL);
+	}
+
+	for (size_t i = 0; i < conv.n; i++){
+		sws_freeContext(conv.bands[i].ctx);
+		sws_freeContext(conv.bands[i].ctx_swap);
+		conv.bands[i] = (struct conv_band){0};
+	}
+
+/* threads spawned after this start from generation 0 */
+	conv.n = 0;
+	conv.gen = 0;
+}
+
+static bool conv_setup(size_t n, int w, int h)
+{
+	if (n > CONV_LIMIT)
+		n = CONV_LIMIT;
+
+/* keep the bands reasonably tall and all but the last of the same height */
+	while (n > 1 && h / n < 16)
+		n--;
+
+	pthread_mutex_init(&conv.lock, NULL);
+	pthread_cond_init(&conv.wake, NULL);
+	pthread_cond_init(&conv.done, NULL);
+
+/* the band heights depend on the count, so if a thread can't be spawned,
+ * tear down and split the height again over the threads that could be */
+	while (n > 0){
+		int step = (h / n) & ~1;
+		size_t i;
+
+		for (i = 0; i < n; i++){
+			struct conv_band* band = &conv.bands[i];
+			band->y = i * step;
+			band->h = i == n - 1 ? h - band->y : step;
+			band->ctx = sws_getContext(w, band->h,
+				SHMIF_RGBA(0,0,255,0) == 0xff ? AV_PIX_FMT_BGRA : AV_PIX_FMT_RGBA,
+				w, band->h, AV_PIX_FMT_YUV420P,
+				SWS_FAST_BILINEAR, NULL, NULL, NULL
+			);
+
+			if (!band->ctx){
+				conv_stop();
+				return false;
+			}
+			conv.n = i + 1;
+
+			if (i && 0 != pthread_create(&conv.threads[i], NULL, conv_thread, band)){
+				sws_freeContext(band->ctx);
+				band->ctx = NULL;
+				conv.n = i;
+				break;
+			}
 		}
+
+		if (i == n)
+			break;
+
+		LOG("(encode) couldn't spawn conversion thread, using %zu\n", i);
+		conv_stop();
+		n = i;
+	}
+
+	LOG("(encode) colour conversion in %zu band(s)\n", conv.n);
+	return true;
+}
+
+/* the muxer thread runs for audio-only output as well */
+static bool vpipe_start(size_t depth)
+{
+	pthread_mutex_init(&vpipe.lock, NULL);
+	pthread_cond_init(&vpipe.vcond, NULL);
+	pthread_cond_init(&vpipe.mcond, NULL);
+	pthread_cond_init(&vpipe.mspace, NULL);
+
+	vpipe.n_slots = recctx.vcontext ? depth : 0;
+	for (size_t i = 0; i < vpipe.n_slots; i++){
+		AVFrame* frame = av_frame_alloc();
+		if (!frame)
+			return false;
+
+		frame->width = recctx.vcontext->width;
+		frame->height = recctx.vcontext->height;
+		frame->format = AV_PIX_FMT_YUV420P;
+		vpipe.slots[i].frame = frame;
+
+		if (av_frame_get_buffer(frame, 32) < 0)
+			return false;
+	}
+
+	if (0 != pthread_create(&vpipe.muxer, NULL, muxer_thread, NULL))
+		return false;
+
+	if (recctx.vcontext &&
+		0 != pthread_create(&vpipe.encoder, NULL, encoder_thread, NULL)){
+		pthread_mutex_lock(&vpipe.lock);
+		vpipe.mdone = true;
+		pthread_cond_signal(&vpipe.mcond);
+		pthread_mutex_unlock(&vpipe.lock);
+		pthread_join(vpipe.muxer, NULL);
+		return false;
 	}
+
+	vpipe.running = true;
+	LOG("(encode) output pipeline with %zu queued frames\n", vpipe.n_slots);
+	return true;
+}
+
+/* flush the encoder, then everything queued for the muxer */
+static void vpipe_stop()
+{
+	if (!vpipe.running)
+		return;
+
+	pthread_mutex_lock(&vpipe.lock);
+	vpipe.vdone = true;
+	pthread_cond_signal(&vpipe.vcond);
+	pthread_mutex_unlock(&vpipe.lock);
+	if (recctx.vcontext)
+		pthread_join(vpipe.encoder, NULL);
+
+	pthread_mutex_lock(&vpipe.lock);
+	vpipe.mdone = true;
+	pthread_cond_signal(&vpipe.mcond);
+	pthread_mutex_unlock(&vpipe.lock);
+	pthread_join(vpipe.muxer, NULL);
+
+	vpipe.running = false;
+	conv_stop();
+
+	for (size_t i = 0; i < vpipe.n_slots; i++)
+		av_frame_free(&vpipe.slots[i].frame);
+
+	LOG("(encode) video: %lu frames encoded, %lu dropped\n",
+		vpipe.encoded, vpipe.dropped);
+}
+
+/*
+ * frameno: frames encoded, completion: frame queue fill (worst since the last
+ * report), identifier: frames dropped due to a full queue, timestr: elapsed.
+ */
+static void vpipe_status()
+{
+	long long now = arcan_timemillis();
+	if (now - vpipe.last_status < 1000)
+		return;
+	vpipe.last_status = now;
+
+	pthread_mutex_lock(&vpipe.lock);
+	struct arcan_event status = {
+		.category = EVENT_EXTERNAL,
+		.ext.kind = ARCAN_EVENT(STREAMSTATUS),
+		.ext.streamstat.frameno = vpipe.encoded,
+		.ext.streamstat.identifier = vpipe.dropped,
+		.ext.streamstat.completion = (float)vpipe.worst_depth / (float)vpipe.n_slots,
+		.ext.streamstat.streaming = true
+	};
+	vpipe.worst_depth = vpipe.count;
+	pthread_mutex_unlock(&vpipe.lock);
+
+	long long elapsed = (now - recctx.starttime) / 1000;
+	snprintf((char*)status.ext.streamstat.timestr,
+		sizeof(status.ext.streamstat.timestr), "%02lld:%02lld:%02lld",
+		(elapsed / 3600) % 100, (elapsed % 3600) / 60, elapsed % 60);
+
+	arcan_shmif_enqueue(&recctx.shmcont, &status);
 }
 
 static bool encode_audio(bool flush)
@@ -333,7 +755,8 @@ static bool encode_audio(bool flush)
 	frame->pts = recctx.aframe_ptscnt;
 	recctx.aframe_ptscnt += frame->nb_samples;
 
-	write_frame(audio, frame, recctx.apacket, recctx.astream, flush);
+	if (!write_frame(audio, frame, recctx.apacket, recctx.astream, flush))
+		exit(EXIT_FAILURE);
 	av_freep(&frame);
 
 	return true;
@@ -341,9 +764,6 @@ static bool encode_audio(bool flush)
 
 static int encode_video(bool flush)
 {
-	uint8_t* srcpl[4] = {(uint8_t*)recctx.shmcont.vidp, NULL, NULL, NULL};
-	int srcstr[4] = {recctx.shmcont.addr->w * recctx.bpp};
-
 /* the main problem here is that the source material may encompass many
  * framerates, in fact, even be variable (!) the samplerate we're running
  * with that is of interest. Thus compare the current time against the next
@@ -359,30 +779,47 @@ static int encode_video(bool flush)
 	frametime -= next_frame;
 	int fc = frametime > 0 ? floor(frametime / mspf) : 0;
 
-	sws_scale(recctx.ccontext, (const uint8_t* const*) srcpl, srcstr, 0,
-		recctx.shmcont.addr->h, recctx.vframe->data, recctx.vframe->linesize);
+/* running behind repeats the frame rather than converting it again */
+	int repeat = 1 + fc;
+	int64_t pts = recctx.framecount;
+	recctx.framecount += repeat;
+
+	pthread_mutex_lock(&vpipe.lock);
+	if (vpipe.count == vpipe.n_slots){
+		size_t last = (vpipe.head + vpipe.count - 1) % vpipe.n_slots;
+		if (vpipe.count > vpipe.taken)
+			vpipe.slots[last].repeat += repeat;
+		vpipe.dropped += repeat;
+		pthread_mutex_unlock(&vpipe.lock);
+		return 0;
+	}
+	struct vslot* slot = &vpipe.slots[(vpipe.head + vpipe.count) % vpipe.n_slots];
+	pthread_mutex_unlock(&vpipe.lock);
 
-	AVCodecContext* ctx = recctx.vcontext;
-	AVPacket pkt = {0};
-	int got_outp = false;
+/* the encoder can still hold a reference to the previous contents */
+	if (av_frame_make_writable(slot->frame) < 0){
+		LOG("(encode) couldn't reuse video frame\n");
+		vpipe.failed = true;
+		return 0;
+	}
 
-	recctx.vframe->pts = recctx.framecount++;
+	convert_frame(slot->frame, recctx.swap_rb);
+	slot->pts = pts;
+	slot->repeat = repeat;
 
-	write_frame(
-		recctx.vcontext,
-		flush ? NULL : recctx.vframe,
-		recctx.vpacket,
-		recctx.vstream,
-		flush
-	);
+	pthread_mutex_lock(&vpipe.lock);
+	vpipe.count++;
+	if (vpipe.count > vpipe.worst_depth)
+		vpipe.worst_depth = vpipe.count;
+	pthread_cond_signal(&vpipe.vcond);
+	pthread_mutex_unlock(&vpipe.lock);
 
-	return fc;
+	return 0;
 }
 
 void arcan_frameserver_stepframe()
 {
 	static bool first_audio = false;
-	double apts, vpts;
 
 	flush_audbuf();
 
@@ -397,27 +834,19 @@ void arcan_frameserver_stepframe()
 		goto end;
 	}
 
-/* interleave audio / video */
-	if (recctx.astream && recctx.vstream){
-		while(1){
-			apts = av_stream_get_end_pts(recctx.astream);
-			vpts = av_stream_get_end_pts(recctx.vstream);
+/* the muxer interleaves, all that is left here is to keep both fed */
+	if (recctx.astream)
+		while (encode_audio(false));
 
-			if (apts < vpts){
-				if (!encode_audio(false))
-					break;
-			}
-			else {
-				if (encode_video(false) == 0)
-					break;
-			}
-		}
+	if (recctx.vstream){
+		encode_video(false);
+		vpipe_status();
+	}
+
+	if (vpipe.failed){
+		LOG("(encode) output pipeline failed, giving up.\n");
+		exit(EXIT_FAILURE);
 	}
-/* audio or video only */
-	else if (recctx.astream)
-		while (encode_audio(false));
-	else
-		while (encode_video(false) > 0);
 
 end:
 	recctx.shmcont.addr->vready = false;
@@ -436,9 +865,6 @@ static void log_callback(void* ptr, int level, const char* fmt, va_list vl)
 	vfprintf(stderr, fmt, vl);
 }
 
-/*
- * expects ccontext to be populated elsewhere
- */
 static bool setup_ffmpeg_encode(struct arg_arr* args, int desw, int desh)
 {
 	struct arcan_shmif_page* shared = recctx.shmcont.addr;
@@ -465,6 +891,9 @@ static bool setup_ffmpeg_encode(struct arg_arr* args, int desw, int desh)
 
 	bool noaudio = false, stream_outp = false;
 	float fps    = 25;
+	size_t vqueue = VQUEUE_DEFAULT;
+	long nconv = sysconf(_SC_NPROCESSORS_ONLN);
+	enum encode_profile profile = ENCODE_PROFILE_THROUGHPUT;
 
 	const char (* vck) = NULL, (* ack) = NULL, (* cont) = NULL,
 		(* streamdst) = NULL;
@@ -486,6 +915,19 @@ static bool setup_ffmpeg_encode(struct arg_arr* args, int desw, int desh)
 		recctx.vpts_ofs = ( strtoul(val, NULL, 10) );
 	if (arg_lookup(args, "aptsofs", 0, &val))
 		recctx.apts_ofs = ( strtoul(val, NULL, 10) );
+/* queueing frames only adds delay when latency matters, drop instead */
+	if (arg_lookup(args, "profile", 0, &val) && val){
+		if (strcmp(val, "latency") == 0){
+			profile = ENCODE_PROFILE_LATENCY;
+			vqueue = 1;
+		}
+		else if (strcmp(val, "throughput") != 0)
+			LOG("(encode:args) unknown profile (%s), using throughput\n", val);
+	}
+	if (arg_lookup(args, "vqueue", 0, &val)) vqueue =
+		( (vqueue = strtoul(val, NULL, 10)) > VQUEUE_LIMIT ? VQUEUE_LIMIT : vqueue);
+	if (arg_lookup(args, "cthreads", 0, &val))
+		nconv = strtol(val, NULL, 10);
 
 	arg_lookup(args, "vcodec", 0, &vck);
 	arg_lookup(args, "acodec", 0, &ack);
@@ -523,8 +965,17 @@ static bool setup_ffmpeg_encode(struct arg_arr* args, int desw, int desh)
 
 	struct codec_ent muxer =
 		encode_getcontainer( cont, recctx.last_fd, streamdst);
+/* latency without an explicit codec picks whatever is fastest here */
+	if ((vck && strcmp(vck, "auto") == 0) ||
+		(!vck && profile == ENCODE_PROFILE_LATENCY)){
+		vck = encode_benchvcodec(muxer.storage.container.format,
+			desw, desh, fps, vbr, profile);
+		LOG("(encode) benchmark picked: %s\n", vck ? vck : "none, using default");
+	}
+
 	struct codec_ent video = encode_getvcodec(
 		vck, muxer.storage.container.format->flags);
+	video.profile = profile;
 	struct codec_ent audio = encode_getacodec(
 		ack, muxer.storage.container.format->flags);
 
@@ -608,6 +1059,9 @@ static bool setup_ffmpeg_encode(struct arg_arr* args, int desw, int desh)
 /* lastly, now that all streams are added, write the header */
 	recctx.fcontext = muxer.storage.container.context;
 
+	if (profile == ENCODE_PROFILE_LATENCY)
+		recctx.fcontext->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+
 	if (!muxer.setup.muxer(&muxer)){
 		LOG("(encode) muxer setupa failed, giving up.\n");
 		return false;
@@ -621,12 +1075,16 @@ static bool setup_ffmpeg_encode(struct arg_arr* args, int desw, int desh)
 			recctx.silence_samples = presilence;
 	}
 
-	recctx.ccontext = sws_getContext(
-		recctx.shmcont.addr->w, recctx.shmcont.addr->h,
-		SHMIF_RGBA(0,0,255,0) == 0xff ? AV_PIX_FMT_BGRA : AV_PIX_FMT_RGBA,
-		recctx.shmcont.addr->w, recctx.shmcont.addr->h, AV_PIX_FMT_YUV420P,
-		SWS_FAST_BILINEAR, NULL, NULL, NULL
-	);
+	if (recctx.vcontext && !conv_setup(nconv > 0 ? nconv : 1,
+		recctx.shmcont.addr->w, recctx.shmcont.addr->h)){
+		LOG("(encode) couldn't setup colour conversion, giving up.\n");
+		return false;
+	}
+
+	if (!vpipe_start(vqueue ? vqueue : 1)){
+		LOG("(encode) couldn't setup output pipeline, giving up.\n");
+		return false;
+	}
 
 	return true;
 }
@@ -652,6 +1110,7 @@ int ffmpeg_run(struct arg_arr* args, struct arcan_shmif_cont* C)
 	}
 
 	arcan_event ev;
+	encode_buffer_enable(&recctx.shmcont);
 
 	while (arcan_shmif_wait(&recctx.shmcont, &ev)){
 		if (ev.category == EVENT_TARGET){
@@ -681,6 +1140,11 @@ int ffmpeg_run(struct arg_arr* args, struct arcan_shmif_cont* C)
 					(ARCAN_SHMIF_SAMPLERATE / 1000.0) * ev.tgt.ioevs[0].iv;
 			break;
 
+/* same as stepframe, only with the contents in a mapped buffer */
+			case TARGET_COMMAND_BUFFERSTREAM:
+				if (!encode_buffer_event(&recctx.shmcont, &ev, &recctx.swap_rb))
+					break;
+/* fallthrough */
 			case TARGET_COMMAND_STEPFRAME:
 				if (!firstframe){
 					firstframe = true;
@@ -692,6 +1156,8 @@ int ffmpeg_run(struct arg_arr* args, struct arcan_shmif_cont* C)
 				}
 
 				arcan_frameserver_stepframe();
+				encode_buffer_release(&recctx.shmcont);
+				recctx.swap_rb = false;
 			break;
 
 			default:
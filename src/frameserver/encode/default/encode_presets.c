@@ -41,6 +41,19 @@ static void vcodec_defaults(struct codec_ent* dst, unsigned width,
 	dst->storage.video.pframe = pframe;
 }
 
+/* shared by the latency profiles: constant rate with a VBV of about a frame so
+ * the decoder never has to buffer, no reordering and slice based threading */
+static void latency_defaults(AVCodecContext* ctx, unsigned vbr, float fps)
+{
+	ctx->bit_rate = vbr;
+	ctx->rc_min_rate = vbr;
+	ctx->rc_max_rate = vbr;
+	ctx->rc_buffer_size = vbr / fps;
+	ctx->max_b_frames = 0;
+	ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+	ctx->thread_type = FF_THREAD_SLICE;
+}
+
 static bool default_vcodec_setup(struct codec_ent* dst, unsigned width,
 	unsigned height, float fps, unsigned vbr, bool stream)
 {
@@ -58,6 +71,10 @@ static bool default_vcodec_setup(struct codec_ent* dst, unsigned width,
 	}
 
 	ctx->bit_rate = vbr;
+	if (dst->profile == ENCODE_PROFILE_LATENCY){
+		latency_defaults(ctx, vbr, fps);
+		ctx->gop_size = fps;
+	}
 
 	if (avcodec_open2(dst->storage.video.context,
 		dst->storage.video.codec, NULL) != 0){
@@ -114,6 +131,7 @@ static bool setup_cb_x264(struct codec_ent* dst, unsigned width,
 {
 	AVDictionary* opts = NULL;
 	float vbrf = 1000 * (height >= 720 ? 2.0 : 1.0);
+	unsigned quality = vbr;
 
 	vcodec_defaults(dst, width, height, fps, vbr);
 	if (vbr == 10){
@@ -170,6 +188,19 @@ static bool setup_cb_x264(struct codec_ent* dst, unsigned width,
 
 	dst->storage.video.context->bit_rate = vbr;
 
+/* zerolatency already means sliced threads, no lookahead and no b-frames,
+ * intra refresh spreads the keyframe cost over a second worth of frames */
+	if (dst->profile == ENCODE_PROFILE_LATENCY){
+		av_dict_set(&opts, "preset", quality > 10 || quality < 4 ?
+			"ultrafast" : (quality < 7 ? "superfast" : "veryfast"), 0);
+		av_dict_set(&opts, "tune", "zerolatency", 0);
+		av_dict_set(&opts, "crf", NULL, 0);
+		av_dict_set(&opts, "intra-refresh", "1", 0);
+		av_dict_set(&opts, "nal-hrd", "cbr", 0);
+		latency_defaults(dst->storage.video.context, vbr, fps);
+		dst->storage.video.context->gop_size = fps;
+	}
+
 	LOG("(encode) video setup @ %d * %d, %f fps, %d kbit / s.\n",
 		width, height, fps, vbr / 1000);
 
@@ -237,6 +268,15 @@ static bool setup_cb_vp8(struct codec_ent* dst, unsigned width,
 	av_dict_set(&opts, "quality", "realtime", 0);
 	dst->storage.video.context->bit_rate = vbr;
 
+	if (dst->profile == ENCODE_PROFILE_LATENCY){
+		av_dict_set(&opts, "lag-in-frames", "0", 0);
+		av_dict_set(&opts, "auto-alt-ref", "0", 0);
+		av_dict_set(&opts, "error-resilient", "1", 0);
+		av_dict_set(&opts, "cpu-used", "8", 0);
+		av_dict_set(&opts, "slices", "4", 0);
+		latency_defaults(dst->storage.video.context, vbr, fps);
+	}
+
 	LOG("(encode) video setup @ %d * %d, %f fps, %d kbit / s.\n",
 		width, height, fps, vbr / 1024);
 	if (avcodec_open2(dst->storage.video.context,
@@ -250,6 +290,61 @@ static bool setup_cb_vp8(struct codec_ent* dst, unsigned width,
 	return true;
 }
 
+/* the hardware h264 encoders that take system memory YUV420P frames, vaapi is
+ * missing as it needs frames uploaded to a hw_frames_ctx first */
+static bool setup_cb_hwh264(struct codec_ent* dst, unsigned width,
+	unsigned height, float fps, unsigned vbr, bool stream)
+{
+	AVDictionary* opts = NULL;
+	AVCodecContext* ctx = dst->storage.video.context;
+	const char* name = dst->storage.video.codec->name;
+	bool latency = dst->profile == ENCODE_PROFILE_LATENCY;
+
+	vcodec_defaults(dst, width, height, fps, vbr);
+
+/* same range as the x264 quality presets */
+	if (vbr <= 10)
+		vbr = 1000 * (height >= 720 ? 2.0 : 1.0) * (300 + 90 * vbr);
+
+	ctx->bit_rate = vbr;
+	ctx->gop_size = fps * 2;
+
+	if (strcmp(name, "h264_nvenc") == 0){
+		av_dict_set(&opts, "preset", latency ? "p1" : "p4", 0);
+		av_dict_set(&opts, "rc", latency ? "cbr" : "vbr", 0);
+		if (latency){
+			av_dict_set(&opts, "tune", "ull", 0);
+			av_dict_set(&opts, "zerolatency", "1", 0);
+			av_dict_set(&opts, "delay", "0", 0);
+		}
+	}
+	else if (strcmp(name, "h264_amf") == 0){
+		av_dict_set(&opts, "usage", latency ? "ultralowlatency" : "transcoding", 0);
+		av_dict_set(&opts, "rc", latency ? "cbr" : "vbr_peak", 0);
+	}
+	else if (strcmp(name, "h264_videotoolbox") == 0){
+		if (latency)
+			av_dict_set(&opts, "realtime", "1", 0);
+	}
+
+	if (latency)
+		latency_defaults(ctx, vbr, fps);
+
+	LOG("(encode) video setup (%s) @ %d * %d, %f fps, %d kbit / s.\n",
+		name, width, height, fps, vbr / 1000);
+
+	if (avcodec_open2(ctx, dst->storage.video.codec, &opts) != 0){
+		av_dict_free(&opts);
+		avcodec_close(ctx);
+		dst->storage.video.context = NULL;
+		dst->storage.video.codec   = NULL;
+		return false;
+	}
+
+	av_dict_free(&opts);
+	return true;
+}
+
 static struct codec_ent vcodec_tbl[] = {
 	{.kind = CODEC_VIDEO,
 					.name = "libvpx",
@@ -268,6 +363,32 @@ static struct codec_ent vcodec_tbl[] = {
 					.shortname = "FFV1",
 				 	.id = AV_CODEC_ID_FFV1,
 				 	.setup.video = default_vcodec_setup },
+
+	{.kind = CODEC_VIDEO,
+					.name = "h264_nvenc",
+					.shortname = "NVENC",
+					.setup.video = setup_cb_hwh264},
+
+	{.kind = CODEC_VIDEO,
+					.name = "h264_amf",
+					.shortname = "AMF",
+					.setup.video = setup_cb_hwh264},
+
+	{.kind = CODEC_VIDEO,
+					.name = "h264_videotoolbox",
+					.shortname = "VTB",
+					.setup.video = setup_cb_hwh264},
+
+	{.kind = CODEC_VIDEO,
+					.name = "h264_v4l2m2m",
+					.shortname = "V4L2M2M",
+					.setup.video = setup_cb_hwh264},
+};
+
+/* candidate order for the benchmark, ties go to the earlier entry */
+static const char* bench_order[] = {
+	"h264_nvenc", "h264_amf", "h264_videotoolbox", "h264_v4l2m2m",
+	"libx264", "libvpx"
 };
 
 static struct codec_ent acodec_tbl[] = {
@@ -449,3 +570,92 @@ struct codec_ent encode_getcontainer(
 
 	return res;
 }
+
+#define BENCH_FRAMES 10
+
+static void release_vcodec(struct codec_ent* ent)
+{
+	avcodec_free_context(&ent->storage.video.context);
+	if (ent->storage.video.pframe){
+		av_freep(&ent->storage.video.pframe->data[0]);
+		av_frame_free(&ent->storage.video.pframe);
+	}
+}
+
+/* the time to push BENCH_FRAMES through and drain them, -1 on failure */
+static long long bench_vcodec(const char* name, unsigned width,
+	unsigned height, float fps, unsigned vbr, enum encode_profile profile)
+{
+	struct codec_ent ent = encode_getvcodec(name, 0);
+	if (!ent.storage.video.codec || !ent.storage.video.context ||
+		strcmp(ent.storage.video.codec->name, name) != 0){
+		avcodec_free_context(&ent.storage.video.context);
+		return -1;
+	}
+
+	ent.profile = profile;
+	AVCodecContext* ctx = ent.storage.video.context;
+	if (!ent.setup.video(&ent, width, height, fps, vbr, false)){
+		ent.storage.video.context = ctx;
+		release_vcodec(&ent);
+		return -1;
+	}
+
+	AVFrame* frame = ent.storage.video.pframe;
+	AVPacket* pkt = av_packet_alloc();
+	long long start = arcan_timemillis();
+	bool ok = pkt != NULL;
+
+/* moving gradient so that there is something to predict from */
+	for (size_t i = 0; ok && i <= BENCH_FRAMES; i++){
+		if (i < BENCH_FRAMES){
+			for (size_t y = 0; y < height; y++)
+				for (size_t x = 0; x < width; x++)
+					frame->data[0][y * frame->linesize[0] + x] = (x + y + i * 4) & 0xff;
+			for (size_t y = 0; y < height >> 1; y++){
+				memset(&frame->data[1][y * frame->linesize[1]], 128 + i, width >> 1);
+				memset(&frame->data[2][y * frame->linesize[2]], 128 - i, width >> 1);
+			}
+			frame->pts = i;
+		}
+
+		int rv = avcodec_send_frame(ctx, i < BENCH_FRAMES ? frame : NULL);
+		while (rv >= 0){
+			rv = avcodec_receive_packet(ctx, pkt);
+			if (rv >= 0)
+				av_packet_unref(pkt);
+		}
+		ok = rv == AVERROR(EAGAIN) || rv == AVERROR_EOF;
+	}
+
+	long long elapsed = arcan_timemillis() - start;
+	av_packet_free(&pkt);
+	release_vcodec(&ent);
+
+	return ok ? elapsed : -1;
+}
+
+const char* encode_benchvcodec(const AVOutputFormat* fmt, unsigned width,
+	unsigned height, float fps, unsigned vbr, enum encode_profile profile)
+{
+	const char* best = NULL;
+	long long best_time = 0;
+
+	for (size_t i = 0; i < sizeof(bench_order) / sizeof(bench_order[0]); i++){
+		const AVCodec* codec = avcodec_find_encoder_by_name(bench_order[i]);
+		if (!codec ||
+			(fmt && avformat_query_codec(fmt, codec->id, FF_COMPLIANCE_NORMAL) == 0))
+			continue;
+
+		long long time = bench_vcodec(bench_order[i], width, height, fps, vbr, profile);
+		LOG("(encode) benchmark %s: %lld ms / %d frames\n",
+			bench_order[i], time, BENCH_FRAMES);
+
+		if (time >= 0 && (!best || time < best_time)){
+			best = bench_order[i];
+			best_time = time;
+		}
+	}
+
+	return best;
+}
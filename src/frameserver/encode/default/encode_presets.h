@@ -12,6 +12,13 @@ enum codec_kind {
 	CODEC_FORMAT
 };
 
+/* throughput is the quality/size tradeoff for recording, latency trades that
+ * for no lookahead or b-frames, intra refresh and a CBR/VBV of about a frame */
+enum encode_profile {
+	ENCODE_PROFILE_THROUGHPUT = 0,
+	ENCODE_PROFILE_LATENCY = 1
+};
+
 struct codec_ent
 {
 	enum codec_kind kind;
@@ -20,6 +27,9 @@ struct codec_ent
 	const char* const shortname;
 	int id;
 
+/* set before calling setup.video */
+	enum encode_profile profile;
+
 	union {
 		struct {
 		const AVCodec* codec;
@@ -54,4 +64,12 @@ struct codec_ent encode_getvcodec(const char* const requested, int flags);
 struct codec_ent encode_getacodec(const char* const requested, int flags);
 struct codec_ent encode_getcontainer(const char* const requested,
 	int fd, const char* remote);
+
+/*
+ * Open each video encoder that fits [fmt], hardware ones first, and time a
+ * few synthetic frames through it with the given settings. Returns the name
+ * of the fastest one that worked, or NULL if none did.
+ */
+const char* encode_benchvcodec(const AVOutputFormat* fmt, unsigned width,
+	unsigned height, float fps, unsigned vbr, enum encode_profile profile);
 #endif
@@ -1,8 +1,30 @@
 #include <tesseract/capi.h>
 #include <leptonica/allheaders.h>
 #include <arcan_shmif.h>
+#include <pthread.h>
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "util/utf8.c"
 
+/*
+ * Only the parts of a frame that changed since the last one are recognized.
+ * Changes are found at tile granularity, neighbouring tiles are grouped into
+ * regions and each region is handed to a pool of workers that keep their own
+ * tesseract instance between frames. Results are cached by the hash of the
+ * region contents, so text that scrolls or reappears isn't run again.
+ */
+#define OCR_TILE 32
+#define OCR_PAD 4
+#define OCR_REGION_LIMIT 32
+#define OCR_WORKER_LIMIT 8
+#define OCR_CACHE_DEFAULT 256
+
+/* frames that arrive with this many regions still in flight are skipped, and
+ * as the reference copy isn't updated their changes carry over to the next */
+#define OCR_BACKLOG 64
+
 /*
  * Same code as in select- in terminal. Ought to be moved to a shared
  * shmif-support lib that also covers 3D setup and handle extraction.
@@ -53,47 +75,489 @@ static void push_multipart(struct arcan_shmif_cont* out,
 	}
 }
 
-void ocr_serv_run(struct arg_arr* args, struct arcan_shmif_cont cont)
+struct ocr_job {
+	size_t x, y, w, h;
+	uint64_t hash;
+	uint8_t* buf;
+	char* text;
+	bool cached;
+	struct ocr_job* next;
+};
+
+struct ocr_cache_ent {
+	uint64_t hash;
+	uint64_t stamp;
+	char* text;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct ocr_job* queue;
+	struct ocr_job* done;
+	size_t in_flight;
+	bool shutdown;
+	int wake[2];
+
+	pthread_t workers[OCR_WORKER_LIMIT];
+	size_t n_workers;
+
+	struct ocr_cache_ent* cache;
+	size_t cache_sz;
+	uint64_t stamp;
+} ocr = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.wake = {-1, -1}
+};
+
+static uint64_t region_hash(const uint8_t* buf, size_t w, size_t h)
+{
+	uint64_t hv = 0xcbf29ce484222325ULL ^ ((uint64_t)w << 32 | h);
+	const shmif_pixel* px = (const shmif_pixel*) buf;
+	for (size_t i = 0; i < w * h; i++)
+		hv = (hv ^ px[i]) * 0x100000001b3ULL;
+	return hv;
+}
+
+static struct ocr_cache_ent* cache_find(uint64_t hash)
+{
+	for (size_t i = 0; i < ocr.cache_sz; i++)
+		if (ocr.cache[i].text && ocr.cache[i].hash == hash){
+			ocr.cache[i].stamp = ++ocr.stamp;
+			return &ocr.cache[i];
+		}
+	return NULL;
+}
+
+static void cache_add(uint64_t hash, const char* text)
+{
+	if (!ocr.cache_sz)
+		return;
+
+	struct ocr_cache_ent* ent = &ocr.cache[0];
+	for (size_t i = 0; i < ocr.cache_sz; i++){
+		if (!ocr.cache[i].text){
+			ent = &ocr.cache[i];
+			break;
+		}
+		if (ocr.cache[i].stamp < ent->stamp)
+			ent = &ocr.cache[i];
+	}
+
+	free(ent->text);
+	*ent = (struct ocr_cache_ent){
+		.hash = hash,
+		.stamp = ++ocr.stamp,
+		.text = strdup(text)
+	};
+}
+
+static void* ocr_worker(void* tag)
+{
+	TessBaseAPI* handle = tag;
+
+	for(;;){
+		pthread_mutex_lock(&ocr.lock);
+		while (!ocr.queue && !ocr.shutdown)
+			pthread_cond_wait(&ocr.cond, &ocr.lock);
+
+		if (ocr.shutdown){
+			pthread_mutex_unlock(&ocr.lock);
+			break;
+		}
+
+		struct ocr_job* job = ocr.queue;
+		ocr.queue = job->next;
+		pthread_mutex_unlock(&ocr.lock);
+
+		TessBaseAPISetImage(handle, job->buf,
+			job->w, job->h, sizeof(shmif_pixel), job->w * sizeof(shmif_pixel));
+		char* text = TessBaseAPIGetUTF8Text(handle);
+		job->text = strdup(text ? text : "");
+		if (text)
+			TessDeleteText(text);
+
+		pthread_mutex_lock(&ocr.lock);
+		job->next = ocr.done;
+		ocr.done = job;
+		pthread_mutex_unlock(&ocr.lock);
+
+		uint8_t ch = 0;
+		write(ocr.wake[1], &ch, 1);
+	}
+
+	TessBaseAPIEnd(handle);
+	TessBaseAPIDelete(handle);
+	return NULL;
+}
+
+static void free_job(struct ocr_job* job)
+{
+	free(job->buf);
+	free(job->text);
+	free(job);
+}
+
+static void emit_job(struct arcan_shmif_cont* C, struct ocr_job* job)
+{
+	size_t len = job->text ? strlen(job->text) : 0;
+	if (!len)
+		return;
+
+	char hdr[96];
+	int hl = snprintf(hdr, sizeof(hdr), "x=%zu:y=%zu:w=%zu:h=%zu:cached=%d\n",
+		job->x, job->y, job->w, job->h, job->cached ? 1 : 0);
+
+	char* msg = malloc(hl + len + 1);
+	if (!msg)
+		return;
+
+	memcpy(msg, hdr, hl);
+	memcpy(&msg[hl], job->text, len + 1);
+	push_multipart(C, msg, hl + len);
+	free(msg);
+}
+
+/*
+ * Compare the frame against the reference copy in tiles, update the copy and
+ * return the grid of changed tiles. Without a reference everything counts.
+ */
+static size_t diff_tiles(struct arcan_shmif_cont* C,
+	shmif_pixel* ref, bool have_ref, uint8_t* grid, size_t gw, size_t gh)
+{
+	size_t count = 0;
+
+	for (size_t ty = 0; ty < gh; ty++){
+		size_t y1 = ty * OCR_TILE;
+		size_t y2 = y1 + OCR_TILE > C->h ? C->h : y1 + OCR_TILE;
+
+		for (size_t tx = 0; tx < gw; tx++){
+			size_t x1 = tx * OCR_TILE;
+			size_t nb = ((x1 + OCR_TILE > C->w ? C->w : x1 + OCR_TILE) - x1) * sizeof(shmif_pixel);
+			bool changed = !have_ref;
+
+			for (size_t y = y1; y < y2 && !changed; y++)
+				changed = memcmp(&C->vidp[y * C->pitch + x1], &ref[y * C->w + x1], nb) != 0;
+
+			if (changed){
+				for (size_t y = y1; y < y2; y++)
+					memcpy(&ref[y * C->w + x1], &C->vidp[y * C->pitch + x1], nb);
+				count++;
+			}
+
+			grid[ty * gw + tx] = changed;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * Group changed tiles into regions, tiles on the same row one tile apart
+ * still join so that the words of a line stay together.
+ */
+static size_t group_tiles(uint8_t* grid, size_t gw, size_t gh,
+	struct arcan_shmif_region* out, size_t lim, size_t* stack)
+{
+	size_t n = 0;
+
+	for (size_t i = 0; i < gw * gh; i++){
+		if (grid[i] != 1)
+			continue;
+
+		size_t x1 = i % gw, x2 = x1, y1 = i / gw, y2 = y1;
+		size_t sp = 0;
+		stack[sp++] = i;
+		grid[i] = 2;
+
+		while (sp){
+			size_t cur = stack[--sp];
+			ssize_t cx = cur % gw, cy = cur / gw;
+			x1 = (size_t)cx < x1 ? (size_t)cx : x1;
+			x2 = (size_t)cx > x2 ? (size_t)cx : x2;
+			y1 = (size_t)cy < y1 ? (size_t)cy : y1;
+			y2 = (size_t)cy > y2 ? (size_t)cy : y2;
+
+			for (ssize_t dy = -1; dy <= 1; dy++)
+				for (ssize_t dx = -2; dx <= 2; dx++){
+					ssize_t nx = cx + dx, ny = cy + dy;
+					if ((dy && (dx < -1 || dx > 1)) ||
+						nx < 0 || ny < 0 || nx >= (ssize_t)gw || ny >= (ssize_t)gh)
+						continue;
+
+					size_t ni = ny * gw + nx;
+					if (grid[ni] == 1){
+						grid[ni] = 2;
+						stack[sp++] = ni;
+					}
+				}
+		}
+
+/* past the limit, fold everything else into the last region */
+		struct arcan_shmif_region r = {
+			.x1 = x1 * OCR_TILE, .y1 = y1 * OCR_TILE,
+			.x2 = (x2 + 1) * OCR_TILE, .y2 = (y2 + 1) * OCR_TILE
+		};
+
+		if (n == lim){
+			struct arcan_shmif_region* l = &out[n - 1];
+			l->x1 = r.x1 < l->x1 ? r.x1 : l->x1;
+			l->y1 = r.y1 < l->y1 ? r.y1 : l->y1;
+			l->x2 = r.x2 > l->x2 ? r.x2 : l->x2;
+			l->y2 = r.y2 > l->y2 ? r.y2 : l->y2;
+		}
+		else
+			out[n++] = r;
+	}
+
+	return n;
+}
+
+static void queue_region(struct arcan_shmif_cont* C,
+	const shmif_pixel* ref, struct arcan_shmif_region r)
 {
-	TessBaseAPI* handle = TessBaseAPICreate();
-	PIX* img;
+	size_t x1 = r.x1 > OCR_PAD ? r.x1 - OCR_PAD : 0;
+	size_t y1 = r.y1 > OCR_PAD ? r.y1 - OCR_PAD : 0;
+	size_t x2 = (size_t)r.x2 + OCR_PAD > C->w ? C->w : r.x2 + OCR_PAD;
+	size_t y2 = (size_t)r.y2 + OCR_PAD > C->h ? C->h : r.y2 + OCR_PAD;
+	if (x2 <= x1 || y2 <= y1)
+		return;
+
+	struct ocr_job* job = malloc(sizeof(struct ocr_job));
+	if (!job)
+		return;
+
+	*job = (struct ocr_job){
+		.x = x1, .y = y1, .w = x2 - x1, .h = y2 - y1
+	};
+
+	size_t nb = job->w * sizeof(shmif_pixel);
+	if (!(job->buf = malloc(nb * job->h))){
+		free(job);
+		return;
+	}
+
+	for (size_t y = 0; y < job->h; y++)
+		memcpy(&job->buf[y * nb], &ref[(y1 + y) * C->w + x1], nb);
+
+	job->hash = region_hash(job->buf, job->w, job->h);
+
+	struct ocr_cache_ent* ent = cache_find(job->hash);
+	if (ent){
+		job->text = strdup(ent->text);
+		job->cached = true;
+		emit_job(C, job);
+		free_job(job);
+		return;
+	}
 
+	pthread_mutex_lock(&ocr.lock);
+	job->next = ocr.queue;
+	ocr.queue = job;
+	ocr.in_flight++;
+	pthread_cond_signal(&ocr.cond);
+	pthread_mutex_unlock(&ocr.lock);
+}
+
+static void collect(struct arcan_shmif_cont* C)
+{
+	pthread_mutex_lock(&ocr.lock);
+	struct ocr_job* job = ocr.done;
+	ocr.done = NULL;
+	pthread_mutex_unlock(&ocr.lock);
+
+	while (job){
+		struct ocr_job* next = job->next;
+		cache_add(job->hash, job->text ? job->text : "");
+		emit_job(C, job);
+
+		pthread_mutex_lock(&ocr.lock);
+		ocr.in_flight--;
+		pthread_mutex_unlock(&ocr.lock);
+
+		free_job(job);
+		job = next;
+	}
+}
+
+void ocr_serv_run(struct arg_arr* args, struct arcan_shmif_cont cont)
+{
 	const char* lang = "eng";
+	const char* val;
 	arg_lookup(args, "lang", 0, &lang);
-	if (TessBaseAPIInit3(handle, NULL, lang)){
-		LOG("encode-ocr: Couldn't initialize tesseract with lang (%s)\n", lang);
+
+	long workers = sysconf(_SC_NPROCESSORS_ONLN);
+	workers = workers > 4 ? 4 : workers;
+	if (arg_lookup(args, "workers", 0, &val) && val)
+		workers = strtol(val, NULL, 10);
+	workers = workers < 1 ? 1 : (workers > OCR_WORKER_LIMIT ? OCR_WORKER_LIMIT : workers);
+
+	ocr.cache_sz = OCR_CACHE_DEFAULT;
+	if (arg_lookup(args, "cache", 0, &val) && val)
+		ocr.cache_sz = strtoul(val, NULL, 10);
+	if (ocr.cache_sz)
+		ocr.cache = calloc(ocr.cache_sz, sizeof(struct ocr_cache_ent));
+	if (!ocr.cache)
+		ocr.cache_sz = 0;
+
+	bool full = arg_lookup(args, "full", 0, NULL);
+
+	if (-1 == pipe(ocr.wake)){
+		LOG("encode-ocr: couldn't create wakeup pipe\n");
 		return;
 	}
+	fcntl(ocr.wake[0], F_SETFL, O_NONBLOCK);
+	fcntl(ocr.wake[0], F_SETFD, FD_CLOEXEC);
+	fcntl(ocr.wake[1], F_SETFD, FD_CLOEXEC);
+
+/* each worker keeps its recognizer for the lifetime of the session */
+	for (long i = 0; i < workers; i++){
+		TessBaseAPI* handle = TessBaseAPICreate();
+		if (!handle || TessBaseAPIInit3(handle, NULL, lang)){
+			LOG("encode-ocr: Couldn't initialize tesseract with lang (%s)\n", lang);
+			if (handle)
+				TessBaseAPIDelete(handle);
+			break;
+		}
+
+		if (0 != pthread_create(&ocr.workers[ocr.n_workers], NULL, ocr_worker, handle)){
+			TessBaseAPIEnd(handle);
+			TessBaseAPIDelete(handle);
+			break;
+		}
+		ocr.n_workers++;
+	}
+
+	if (!ocr.n_workers)
+		goto out;
+
+	shmif_pixel* ref = NULL;
+	uint8_t* grid = NULL;
+	size_t* stack = NULL;
+	size_t ref_w = 0, ref_h = 0;
+	bool have_ref = false;
 
 /*
  * There are many little details missing here, e.g.  control over segmentation
  * / grouping (receiving input) and somehow alerting when the OCR failed to
  * yield anything.
  */
-	arcan_event ev;
-	while(arcan_shmif_wait(&cont, &ev)){
-		if (ev.category == EVENT_TARGET){
-			switch (ev.tgt.kind){
-			case TARGET_COMMAND_STEPFRAME:{
-				TessBaseAPISetImage(handle, (const unsigned char*) cont.vidp,
-					cont.w, cont.h, sizeof(shmif_pixel), cont.stride);
-				char* text = TessBaseAPIGetUTF8Text(handle);
-				size_t len;
-				if (!text || (len = strlen(text)) == 0)
-					continue;
-
-				push_multipart(&cont, text, len);
-				TessDeleteText(text);
-			}
-			break;
-			case TARGET_COMMAND_EXIT:
-				goto out;
-			default:
+	for(;;){
+		struct pollfd pfd[2] = {
+			{.fd = cont.epipe, .events = POLLIN | POLLERR | POLLHUP | POLLNVAL},
+			{.fd = ocr.wake[0], .events = POLLIN}
+		};
+
+		if (-1 == poll(pfd, 2, -1) && errno != EINTR && errno != EAGAIN)
 			break;
+
+		if (pfd[1].revents & POLLIN){
+			uint8_t buf[64];
+			while (read(ocr.wake[0], buf, sizeof(buf)) > 0){}
+			collect(&cont);
+		}
+
+		arcan_event ev;
+		int rv;
+		while ((rv = arcan_shmif_poll(&cont, &ev)) > 0){
+			if (ev.category != EVENT_TARGET)
+				continue;
+
+			if (ev.tgt.kind == TARGET_COMMAND_EXIT)
+				goto quit;
+
+			if (ev.tgt.kind != TARGET_COMMAND_STEPFRAME)
+				continue;
+
+			while (!cont.addr->vready){}
+
+			pthread_mutex_lock(&ocr.lock);
+			size_t backlog = ocr.in_flight;
+			pthread_mutex_unlock(&ocr.lock);
+
+			if (backlog >= OCR_BACKLOG){
+				cont.addr->vready = false;
+				continue;
+			}
+
+			if (ref_w != cont.w || ref_h != cont.h){
+				free(ref);
+				free(grid);
+				free(stack);
+				ref_w = cont.w;
+				ref_h = cont.h;
+				size_t gw = (ref_w + OCR_TILE - 1) / OCR_TILE;
+				size_t gh = (ref_h + OCR_TILE - 1) / OCR_TILE;
+				ref = malloc(ref_w * ref_h * sizeof(shmif_pixel));
+				grid = malloc(gw * gh);
+				stack = malloc(gw * gh * sizeof(size_t));
+				have_ref = false;
+
+				if (!ref || !grid || !stack){
+					LOG("encode-ocr: couldn't allocate reference frame\n");
+					cont.addr->vready = false;
+					goto quit;
+				}
 			}
+
+			size_t gw = (ref_w + OCR_TILE - 1) / OCR_TILE;
+			size_t gh = (ref_h + OCR_TILE - 1) / OCR_TILE;
+			size_t changed = diff_tiles(&cont, ref, have_ref, grid, gw, gh);
+			have_ref = true;
+
+/* the reference copy has what we need, the frame can go back */
+			cont.addr->vready = false;
+
+			if (!changed)
+				continue;
+
+			if (full){
+				queue_region(&cont, ref, (struct arcan_shmif_region){
+					.x2 = ref_w, .y2 = ref_h});
+				continue;
+			}
+
+			struct arcan_shmif_region regions[OCR_REGION_LIMIT];
+			size_t n = group_tiles(grid, gw, gh, regions, OCR_REGION_LIMIT, stack);
+			for (size_t i = 0; i < n; i++)
+				queue_region(&cont, ref, regions[i]);
 		}
+
+		if (rv < 0)
+			break;
 	}
+
+quit:
+	free(ref);
+	free(grid);
+	free(stack);
+
 out:
-	TessBaseAPIEnd(handle);
-	TessBaseAPIDelete(handle);
+	pthread_mutex_lock(&ocr.lock);
+	ocr.shutdown = true;
+	pthread_cond_broadcast(&ocr.cond);
+	pthread_mutex_unlock(&ocr.lock);
+
+	for (size_t i = 0; i < ocr.n_workers; i++)
+		pthread_join(ocr.workers[i], NULL);
+
+	while (ocr.queue){
+		struct ocr_job* job = ocr.queue;
+		ocr.queue = job->next;
+		free_job(job);
+	}
+
+	while (ocr.done){
+		struct ocr_job* job = ocr.done;
+		ocr.done = job->next;
+		free_job(job);
+	}
+
+	for (size_t i = 0; i < ocr.cache_sz; i++)
+		free(ocr.cache[i].text);
+	free(ocr.cache);
+
+	close(ocr.wake[0]);
+	close(ocr.wake[1]);
 }
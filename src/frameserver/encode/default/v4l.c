@@ -183,7 +183,13 @@ int v4l2_run(struct arg_arr* args, struct arcan_shmif_cont cont)
 		return EXIT_FAILURE;
 	}
 
+/* more buffers trade latency for tolerance against an uneven producer */
 	size_t bufcount = 2;
+	if (arg_lookup(args, "buffers", 0, &kind) && kind){
+		bufcount = strtoul(kind, NULL, 10);
+		bufcount = bufcount < 2 ? 2 : (bufcount > 16 ? 16 : bufcount);
+	}
+
 	struct v4l2_requestbuffers breq = {
 		.count = bufcount,
 		.type = V4L2_BUF_TYPE_VIDEO_OUTPUT,
@@ -198,8 +204,8 @@ int v4l2_run(struct arg_arr* args, struct arcan_shmif_cont cont)
 			mmapped = false;
 		}
 		else {
-/* might be a way to squeeze in dmabuf here */
-			bufcount = breq.count;
+/* the driver may hand out more than asked for, only use what we have room for */
+			bufcount = breq.count < bufcount ? breq.count : bufcount;
 			for (size_t i = 0; i < bufcount; i++){
 				buffers[i].index = i;
 				buffers[i].type = breq.type;
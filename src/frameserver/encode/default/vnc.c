@@ -21,6 +21,17 @@
 #define DEFINE_XKB
 #include "xsymconv.h"
 
+/* changed areas are found by comparing tiles of this size against the copy
+ * that was last handed to libvncserver */
+#define VNC_TILE_W 64
+#define VNC_TILE_H 16
+
+/* largest vertical offset searched for when looking for scrolled content,
+ * and the fraction (1/n) of rows that need to match for it to be used */
+#define VNC_SCROLL_RANGE 256
+#define VNC_SCROLL_MATCH 2
+#define VNC_SCROLL_SAMPLES 8
+
 static struct {
 	const char* pass[2];
 	pthread_mutex_t outsync;
@@ -29,7 +40,18 @@ static struct {
 	int last_mask;
 	struct arcan_shmif_cont shmcont;
 	int client_counter;
-} vncctx = {0};
+
+/* libvncserver encodes from its own thread, so it gets a shadow copy rather
+ * than the shared buffer that the parent can overwrite at any time */
+	shmif_pixel* fb;
+	size_t fb_w, fb_h;
+	uint64_t* row_old;
+	uint64_t* row_new;
+	bool copyrect;
+	int compress;
+} vncctx = {
+	.compress = -1
+};
 
 struct cl_track {
 	unsigned conn_id;
@@ -281,21 +303,179 @@ static enum rfbNewClientAction server_newclient(rfbClientPtr cl)
 	return RFB_CLIENT_ACCEPT;
 }
 
+/*
+ * Run before each update is encoded for a client, after any levels the client
+ * asked for through its pseudo-encodings - so an explicit compress= argument
+ * wins. The encoding itself (tight, zrle, ...) is still picked from the list
+ * the client prefers.
+ */
+static void server_display(rfbClientPtr cl)
+{
+	if (vncctx.compress < 0)
+		return;
+
+#ifdef LIBVNCSERVER_HAVE_LIBZ
+	cl->zlibCompressLevel = vncctx.compress;
+	cl->tightCompressLevel = vncctx.compress;
+#endif
+}
+
+static uint64_t row_hash(const shmif_pixel* px, size_t n)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < n; i++)
+		h = (h ^ px[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+static size_t scroll_matches(size_t y1, size_t y2, int dy)
+{
+	size_t count = 0;
+	for (size_t y = y1; y < y2; y++){
+		ssize_t sy = (ssize_t)y - dy;
+		if (sy >= (ssize_t)y1 && sy < (ssize_t)y2 && vncctx.row_new[y] == vncctx.row_old[sy])
+			count++;
+	}
+	return count;
+}
+
+/*
+ * Look for a vertical offset that explains most of the changes in the
+ * [x1, x2> column span as the previous contents being moved. A handful of
+ * sample rows that aren't flat (same hash as their neighbour) nominate
+ * offsets, which are then scored against all rows.
+ */
+static int find_scroll(struct arcan_shmif_region r)
+{
+	struct arcan_shmif_cont* C = &vncctx.shmcont;
+	size_t h = r.y2 - r.y1;
+	if (h < 2 * VNC_TILE_H)
+		return 0;
+
+	for (size_t y = r.y1; y < r.y2; y++){
+		vncctx.row_old[y] = row_hash(&vncctx.fb[y * vncctx.fb_w + r.x1], r.x2 - r.x1);
+		vncctx.row_new[y] = row_hash(&C->vidp[y * C->pitch + r.x1], r.x2 - r.x1);
+	}
+
+	int cand[VNC_SCROLL_SAMPLES * 2];
+	size_t n_cand = 0;
+
+	for (size_t i = 0; i < VNC_SCROLL_SAMPLES && n_cand < sizeof(cand) / sizeof(cand[0]); i++){
+		size_t y = r.y1 + 1 + (h - 2) * i / VNC_SCROLL_SAMPLES;
+		if (vncctx.row_new[y] == vncctx.row_new[y - 1] ||
+			vncctx.row_new[y] == vncctx.row_old[y])
+			continue;
+
+		ssize_t lo = (ssize_t)y - VNC_SCROLL_RANGE;
+		ssize_t hi = (ssize_t)y + VNC_SCROLL_RANGE;
+		lo = lo < r.y1 ? r.y1 : lo;
+		hi = hi >= r.y2 ? r.y2 - 1 : hi;
+
+		for (ssize_t sy = lo; sy <= hi; sy++){
+			if (sy == (ssize_t)y || vncctx.row_old[sy] != vncctx.row_new[y])
+				continue;
+
+			int dy = (ssize_t)y - sy;
+			bool known = false;
+			for (size_t j = 0; j < n_cand && !known; j++)
+				known = cand[j] == dy;
+
+			if (!known && n_cand < sizeof(cand) / sizeof(cand[0]))
+				cand[n_cand++] = dy;
+			break;
+		}
+	}
+
+	int best = 0;
+	size_t best_n = scroll_matches(r.y1, r.y2, 0);
+
+	for (size_t i = 0; i < n_cand; i++){
+		size_t n = scroll_matches(r.y1, r.y2, cand[i]);
+		if (n > best_n){
+			best = cand[i];
+			best_n = n;
+		}
+	}
+
+	return best_n * VNC_SCROLL_MATCH >= h ? best : 0;
+}
+
+/*
+ * Compare [r] tile by tile against the shadow copy, bring the shadow up to
+ * date and mark only the tiles that differ.
+ */
+static void update_region(struct arcan_shmif_region r)
+{
+	struct arcan_shmif_cont* C = &vncctx.shmcont;
+
+	for (size_t ty = r.y1; ty < r.y2; ty += VNC_TILE_H){
+		size_t th = ty + VNC_TILE_H > r.y2 ? r.y2 - ty : VNC_TILE_H;
+
+		for (size_t tx = r.x1; tx < r.x2; tx += VNC_TILE_W){
+			size_t tw = tx + VNC_TILE_W > r.x2 ? r.x2 - tx : VNC_TILE_W;
+			size_t nb = tw * sizeof(shmif_pixel);
+			size_t y = 0;
+
+			for (; y < th; y++)
+				if (memcmp(&C->vidp[(ty + y) * C->pitch + tx],
+					&vncctx.fb[(ty + y) * vncctx.fb_w + tx], nb) != 0)
+					break;
+
+			if (y == th)
+				continue;
+
+			for (; y < th; y++)
+				memcpy(&vncctx.fb[(ty + y) * vncctx.fb_w + tx],
+					&C->vidp[(ty + y) * C->pitch + tx], nb);
+
+			rfbMarkRectAsModified(vncctx.server, tx, ty, tx + tw, ty + th);
+		}
+	}
+}
+
+static bool clamp_region(struct arcan_shmif_region* r)
+{
+	if (r->x2 > vncctx.fb_w)
+		r->x2 = vncctx.fb_w;
+	if (r->y2 > vncctx.fb_h)
+		r->y2 = vncctx.fb_h;
+	return r->x1 < r->x2 && r->y1 < r->y2;
+}
+
 static void vnc_serv_deltaupd()
 {
 /*
- * We're missing a delta- function here, the reason it isn't implemented
- * yet is that we want the feature to be part of the server- shmif side
- * as it can be made more efficiently there.
+ * The region (or chain of them) set on the page bounds the search, within
+ * that only tiles that actually differ from what the clients have are sent
+ * and moved content is sent as a copy-rect.
  */
-	struct arcan_shmif_region dirty;
-	dirty = atomic_load(&vncctx.shmcont.addr->dirty);
-	if (dirty.x2 < vncctx.shmcont.w)
-		dirty.x2++;
-	if (dirty.y2 < vncctx.shmcont.h)
-		dirty.y2++;
-
-	rfbMarkRectAsModified(vncctx.server, dirty.x1, dirty.y1, dirty.x2, dirty.y2);
+	struct arcan_shmif_page* page = vncctx.shmcont.addr;
+	struct arcan_shmif_region dirty = atomic_load(&page->dirty);
+
+	if (!clamp_region(&dirty))
+		dirty = (struct arcan_shmif_region){.x2 = vncctx.fb_w, .y2 = vncctx.fb_h};
+
+	if (vncctx.copyrect){
+		int dy = find_scroll(dirty);
+		if (dy > 0)
+			rfbDoCopyRect(vncctx.server,
+				dirty.x1, dirty.y1 + dy, dirty.x2, dirty.y2, 0, dy);
+		else if (dy < 0)
+			rfbDoCopyRect(vncctx.server,
+				dirty.x1, dirty.y1, dirty.x2, dirty.y2 + dy, 0, dy);
+	}
+
+	size_t n_chain = atomic_load(&page->dirty_chain_n);
+	if (n_chain > 1 && n_chain <= ARCAN_SHMIF_DIRTY_LIM){
+		for (size_t i = 0; i < n_chain; i++){
+			struct arcan_shmif_region r = page->dirty_chain[i];
+			if (clamp_region(&r))
+				update_region(r);
+		}
+	}
+	else
+		update_region(dirty);
+
 	vncctx.shmcont.addr->vready = false;
 }
 
@@ -318,6 +498,29 @@ void vnc_serv_run(struct arg_arr* args, struct arcan_shmif_cont cont)
 		port = strtoul(tmpstr, NULL, 10);
 	}
 
+	if (arg_lookup(args, "compress", 0, &tmpstr) && tmpstr){
+		vncctx.compress = strtol(tmpstr, NULL, 10);
+		vncctx.compress = vncctx.compress < 0 ? 0 :
+			(vncctx.compress > 9 ? 9 : vncctx.compress);
+	}
+
+	vncctx.copyrect = !arg_lookup(args, "nocopyrect", 0, NULL);
+
+	vncctx.fb_w = vncctx.shmcont.addr->w;
+	vncctx.fb_h = vncctx.shmcont.addr->h;
+	vncctx.fb = malloc(vncctx.fb_w * vncctx.fb_h * sizeof(shmif_pixel));
+	vncctx.row_old = malloc(vncctx.fb_h * sizeof(uint64_t));
+	vncctx.row_new = malloc(vncctx.fb_h * sizeof(uint64_t));
+	if (!vncctx.fb || !vncctx.row_old || !vncctx.row_new){
+		LOG("couldn't allocate framebuffer copy\n");
+		goto done;
+	}
+
+	for (size_t y = 0; y < vncctx.fb_h; y++)
+		memcpy(&vncctx.fb[y * vncctx.fb_w],
+			&vncctx.shmcont.vidp[y * vncctx.shmcont.pitch],
+			vncctx.fb_w * sizeof(shmif_pixel));
+
 	int argc = 0;
 	char* argv[] = {NULL};
 
@@ -336,12 +539,13 @@ void vnc_serv_run(struct arg_arr* args, struct arcan_shmif_cont cont)
 		vncctx.server->authPasswdData = (void*)vncctx.pass;
 	}
 
-	vncctx.server->frameBuffer = (char*) vncctx.shmcont.vidp;
+	vncctx.server->frameBuffer = (char*) vncctx.fb;
 	vncctx.server->desktopName = name;
 	vncctx.server->alwaysShared = TRUE;
 	vncctx.server->ptrAddEvent = server_pointer;
 	vncctx.server->newClientHook = server_newclient;
 	vncctx.server->kbdAddEvent = server_key;
+	vncctx.server->displayHook = server_display;
 	vncctx.server->port = port;
 	vncctx.server->serverFormat.redShift = SHMIF_RGBA_RSHIFT;
 	vncctx.server->serverFormat.greenShift = SHMIF_RGBA_GSHIFT;
@@ -379,6 +583,9 @@ void vnc_serv_run(struct arg_arr* args, struct arcan_shmif_cont cont)
 	}
 
 done:
+	free(vncctx.fb);
+	free(vncctx.row_old);
+	free(vncctx.row_new);
 	return;
 }
 
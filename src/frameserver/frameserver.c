@@ -218,8 +218,58 @@ int launch_mode(const char* modestr,
 	return fptr(con.addr ? &con : NULL, arg);
 }
 
+/*
+ * Pooled frameservers are started ahead of time with the connection and
+ * segment but without the argument. These block here until the parent sends
+ * the rest of the environment as a series of KEY=VALUE\0 ending with an
+ * empty one, then continue as a normal launch.
+ */
+static bool pool_handover()
+{
+	unsetenv("ARCAN_FRAMESERVER_POOL");
+	const char* fdstr = getenv("ARCAN_SOCKIN_FD");
+	if (!fdstr)
+		return false;
+
+	int fd = (int) strtol(fdstr, NULL, 10);
+	int flags = fcntl(fd, F_GETFL);
+	if (-1 != flags)
+		fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+
+	char buf[64 * 1024];
+	size_t ofs = 0;
+
+/* byte at a time, anything after the block belongs to shmif */
+	for (;;){
+		ssize_t nr = read(fd, &buf[ofs], 1);
+		if (nr == -1 && errno == EINTR)
+			continue;
+		if (nr != 1)
+			return false;
+
+		if (buf[ofs] != '\0'){
+			if (++ofs == sizeof(buf))
+				return false;
+			continue;
+		}
+
+		if (!ofs)
+			return true;
+
+		char* val = strchr(buf, '=');
+		if (val){
+			*val++ = '\0';
+			setenv(buf, val, 1);
+		}
+		ofs = 0;
+	}
+}
+
 int main(int argc, char** argv)
 {
+	if (getenv("ARCAN_FRAMESERVER_POOL") && !pool_handover())
+		return EXIT_FAILURE;
+
 #ifdef DEFAULT_FSRV_MODE
 	char* fsrvmode = DEFAULT_FSRV_MODE;
 	char* argstr = argc > 1 ? argv[1] : NULL; /* optional */
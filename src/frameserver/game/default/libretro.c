@@ -20,6 +20,7 @@
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <poll.h>
 
 #ifdef FRAMESERVER_LIBRETRO_3D
 #ifdef ENABLE_RETEXTURE
@@ -37,6 +38,7 @@
 #include "frameserver.h"
 #include "ntsc/snes_ntsc.h"
 #include "sync_plot.h"
+#include "ievsched.h"
 #include "libretro.h"
 
 #include "font_8x8.h"
@@ -53,6 +55,11 @@
 #define MAX_BUTTONS 16
 #endif
 
+/* upper bound on hidden frames per presented one with run-ahead */
+#ifndef RUNAHEAD_LIMIT
+#define RUNAHEAD_LIMIT 4
+#endif
+
 #undef BADID
 
 #define COUNT_OF(x) \
@@ -154,6 +161,18 @@ static struct {
 	unsigned rollback_front;
 	char* rollback_state;
 	size_t state_sz;
+
+/* run-ahead: after the real frame, run this many more with the same input
+ * and present the last one, then restore the real frame from the slot - the
+ * option is announced after the core variables, at [runahead_index] */
+	int runahead;
+	int runahead_index;
+	char* runahead_state;
+	size_t runahead_sz;
+
+/* input with a pts is held in ievsched and applied at that time on the
+ * scheduler clock (us), frames carry the same clock (ms) as vpts */
+	bool inputsched;
 	char* syspath;
 	bool res_empty;
 
@@ -186,6 +205,7 @@ static struct {
 	.vbuf_cnt = 3,
 	.prewake = 10,
 	.preaudiogen = 1,
+	.runahead_index = -1,
 	.skipmode = TARGET_SKIP_AUTO
 };
 
@@ -327,24 +347,6 @@ static void process_frames(int nframes, bool overrv, bool overra)
 #define RGB565(b, g, r) ((uint16_t)(((uint8_t)(r) >> 3) << 11) | \
 								(((uint8_t)(g) >> 2) << 5) | ((uint8_t)(b) >> 3))
 
-static void push_ntsc(unsigned width, unsigned height,
-	const uint16_t* ntsc_imb, shmif_pixel* outp)
-{
-	size_t linew = SNES_NTSC_OUT_WIDTH(width) * 4;
-
-/* only draw on every other line, so we can easily mix or
- * blend interleaved (or just duplicate) */
-	snes_ntsc_blit(retro.ntscctx, ntsc_imb, width, 0,
-		width, height, outp, linew * 2);
-
-/* this might be a possible test-case for running two shmif
- * connections and let the compositor do interlacing management */
-	assert(ARCAN_SHMPAGE_VCHANNELS == 4);
-	for (int row = 1; row < height * 2; row += 2)
-		memcpy(& ((char*) retro.shmcont.vidp)[row * linew],
-			&((char*) retro.shmcont.vidp)[(row-1) * linew], linew);
-}
-
 /* better distribution for conversion (white is white ..) */
 static const uint8_t rgb565_lut5[] = {
   0,   8,  16,  25,  33,  41,  49,  58,  66,   74,  82,  90,  99, 107, 115,123,
@@ -358,32 +360,654 @@ static const uint8_t rgb565_lut6[] = {
 194, 198, 202, 206, 210, 215, 219, 223, 227, 231, 235, 239, 243, 247, 251, 255
 };
 
+/* the vector paths below pack with red in either the low or the third byte
+ * depending on how RGBA is defined for the platform, this folds to a constant */
+#define PIXCONV_RLOW (RGBA(0xff, 0, 0, 0) == 0xff)
+
+static void rgb565_row(const uint16_t* data, shmif_pixel* outp, size_t n)
+{
+	for (size_t x = 0; x < n; x++){
+		uint16_t val = data[x];
+		outp[x] = RGBA(
+			rgb565_lut5[ (val & 0xf800) >> 11 ],
+			rgb565_lut6[ (val & 0x07e0) >> 5  ],
+			rgb565_lut5[ (val & 0x001f)       ], 0xff);
+	}
+}
+
+static void xrgb888_row(const uint32_t* data, shmif_pixel* outp, size_t n)
+{
+	for (size_t x = 0; x < n; x++){
+		uint8_t* quad = (uint8_t*) (data + x);
+		outp[x] = RGBA(quad[2], quad[1], quad[0], 0xff);
+	}
+}
+
+static void rgb1555_row(const uint16_t* data, shmif_pixel* outp, size_t n)
+{
+	for (size_t x = 0; x < n; x++){
+		uint16_t val = data[x];
+		outp[x] = RGBA(
+			((val & 0x7c00) >> 10) << 3,
+			((val & 0x03e0) >>  5) << 3,
+			( val & 0x001f) <<  3, 0xff);
+	}
+}
+
+/* packing into the 16-bit intermediate the ntsc filter reads, red and blue
+ * trade places here so that the filter output lands in the right channels */
+static void rgb565_ntsc_row(const uint16_t* data, uint16_t* outp, size_t n)
+{
+	for (size_t x = 0; x < n; x++){
+		uint16_t val = data[x];
+		uint8_t r = rgb565_lut5[ (val & 0xf800) >> 11 ];
+		uint8_t g = rgb565_lut6[ (val & 0x07e0) >> 5  ];
+		uint8_t b = rgb565_lut5[ (val & 0x001f)       ];
+		outp[x] = RGB565(r, g, b);
+	}
+}
+
+static void xrgb888_ntsc_row(const uint32_t* data, uint16_t* outp, size_t n)
+{
+	for (size_t x = 0; x < n; x++){
+		uint8_t* quad = (uint8_t*) (data + x);
+		outp[x] = RGB565(quad[2], quad[1], quad[0]);
+	}
+}
+
+static void rgb1555_ntsc_row(const uint16_t* data, uint16_t* outp, size_t n)
+{
+	for (size_t x = 0; x < n; x++){
+		uint16_t val = data[x];
+		uint8_t r = ((val & 0x7c00) >> 10) << 3;
+		uint8_t g = ((val & 0x03e0) >>  5) << 3;
+		uint8_t b = ( val & 0x001f) <<  3;
+		outp[x] = RGB565(r, g, b);
+	}
+}
+
+/* vector versions of the row converters, selected at runtime in pixconv_select.
+ * The 565 expansion uses (v * 527 + 23) >> 6 and (v * 259 + 33) >> 6 which
+ * give the same values as the lookup tables above. */
+#ifndef PIXCONV_NO_SIMD
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXCONV_SIMD_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PIXCONV_SIMD_NEON
+#if defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+#endif
+
+#ifdef PIXCONV_SIMD_X86
+#define SSE2_FN __attribute__((target("sse2")))
+#define AVX2_FN __attribute__((target("avx2")))
+
+/* r, g, b as 16-bit lanes of 0..255, interleaved into 32-bit pixels */
+static SSE2_FN void pack_sse2(
+	__m128i r, __m128i g, __m128i b, shmif_pixel* outp)
+{
+	const __m128i alpha = _mm_set1_epi16(0xff00);
+	__m128i lo = PIXCONV_RLOW ?
+		_mm_or_si128(r, _mm_slli_epi16(g, 8)) : _mm_or_si128(b, _mm_slli_epi16(g, 8));
+	__m128i hi = _mm_or_si128(PIXCONV_RLOW ? b : r, alpha);
+	_mm_storeu_si128((__m128i*) outp, _mm_unpacklo_epi16(lo, hi));
+	_mm_storeu_si128((__m128i*) &outp[4], _mm_unpackhi_epi16(lo, hi));
+}
+
+static SSE2_FN void rgb565_row_sse2(
+	const uint16_t* data, shmif_pixel* outp, size_t n)
+{
+	const __m128i m5 = _mm_set1_epi16(0x1f);
+	const __m128i m6 = _mm_set1_epi16(0x3f);
+	size_t x = 0;
+
+	for (; x + 8 <= n; x += 8){
+		__m128i v = _mm_loadu_si128((__m128i*) &data[x]);
+		__m128i r = _mm_srli_epi16(v, 11);
+		__m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), m6);
+		__m128i b = _mm_and_si128(v, m5);
+
+		r = _mm_srli_epi16(_mm_add_epi16(
+			_mm_mullo_epi16(r, _mm_set1_epi16(527)), _mm_set1_epi16(23)), 6);
+		g = _mm_srli_epi16(_mm_add_epi16(
+			_mm_mullo_epi16(g, _mm_set1_epi16(259)), _mm_set1_epi16(33)), 6);
+		b = _mm_srli_epi16(_mm_add_epi16(
+			_mm_mullo_epi16(b, _mm_set1_epi16(527)), _mm_set1_epi16(23)), 6);
+
+		pack_sse2(r, g, b, &outp[x]);
+	}
+
+	rgb565_row(&data[x], &outp[x], n - x);
+}
+
+static SSE2_FN void rgb1555_row_sse2(
+	const uint16_t* data, shmif_pixel* outp, size_t n)
+{
+	const __m128i m5 = _mm_set1_epi16(0xf8);
+	size_t x = 0;
+
+	for (; x + 8 <= n; x += 8){
+		__m128i v = _mm_loadu_si128((__m128i*) &data[x]);
+		pack_sse2(
+			_mm_and_si128(_mm_srli_epi16(v, 7), m5),
+			_mm_and_si128(_mm_srli_epi16(v, 2), m5),
+			_mm_and_si128(_mm_slli_epi16(v, 3), m5), &outp[x]);
+	}
+
+	rgb1555_row(&data[x], &outp[x], n - x);
+}
+
+/* the source is already in shmif order, other packings swap the r and b bytes */
+static SSE2_FN __m128i xrgb_sse2(__m128i v)
+{
+	const __m128i alpha = _mm_set1_epi32(0xff000000);
+	if (!PIXCONV_RLOW)
+		return _mm_or_si128(v, alpha);
+
+	const __m128i mb = _mm_set1_epi32(0xff);
+	return _mm_or_si128(
+		_mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(0xff00)), alpha),
+		_mm_or_si128(
+			_mm_and_si128(_mm_srli_epi32(v, 16), mb),
+			_mm_slli_epi32(_mm_and_si128(v, mb), 16)
+		)
+	);
+}
+
+static SSE2_FN void xrgb888_row_sse2(
+	const uint32_t* data, shmif_pixel* outp, size_t n)
+{
+	size_t x = 0;
+	for (; x + 4 <= n; x += 4){
+		__m128i v = _mm_loadu_si128((__m128i*) &data[x]);
+		_mm_storeu_si128((__m128i*) &outp[x], xrgb_sse2(v));
+	}
+
+	xrgb888_row(&data[x], &outp[x], n - x);
+}
+
+static SSE2_FN void rgb565_ntsc_row_sse2(
+	const uint16_t* data, uint16_t* outp, size_t n)
+{
+	const __m128i g = _mm_set1_epi16(0x07e0);
+	size_t x = 0;
+
+	for (; x + 8 <= n; x += 8){
+		__m128i v = _mm_loadu_si128((__m128i*) &data[x]);
+		v = _mm_or_si128(_mm_or_si128(
+			_mm_slli_epi16(v, 11), _mm_srli_epi16(v, 11)), _mm_and_si128(v, g));
+		_mm_storeu_si128((__m128i*) &outp[x], v);
+	}
+
+	rgb565_ntsc_row(&data[x], &outp[x], n - x);
+}
+
+static SSE2_FN void rgb1555_ntsc_row_sse2(
+	const uint16_t* data, uint16_t* outp, size_t n)
+{
+	const __m128i m5 = _mm_set1_epi16(0x1f);
+	const __m128i g = _mm_set1_epi16(0x07c0);
+	size_t x = 0;
+
+	for (; x + 8 <= n; x += 8){
+		__m128i v = _mm_loadu_si128((__m128i*) &data[x]);
+		v = _mm_or_si128(_mm_or_si128(
+			_mm_slli_epi16(v, 11), _mm_and_si128(_mm_srli_epi16(v, 10), m5)),
+			_mm_and_si128(_mm_slli_epi16(v, 1), g));
+		_mm_storeu_si128((__m128i*) &outp[x], v);
+	}
+
+	rgb1555_ntsc_row(&data[x], &outp[x], n - x);
+}
+
+/* blue to the top 5 bits, red to the low ones, then narrow with the values
+ * sign extended so the saturating pack leaves them alone */
+static SSE2_FN __m128i xrgb_ntsc_sse2(__m128i v)
+{
+	v = _mm_or_si128(_mm_or_si128(
+		_mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xf8)), 8),
+		_mm_and_si128(_mm_srli_epi32(v, 5), _mm_set1_epi32(0x07e0))),
+		_mm_and_si128(_mm_srli_epi32(v, 19), _mm_set1_epi32(0x1f)));
+	return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+static SSE2_FN void xrgb888_ntsc_row_sse2(
+	const uint32_t* data, uint16_t* outp, size_t n)
+{
+	size_t x = 0;
+	for (; x + 8 <= n; x += 8){
+		__m128i lo = xrgb_ntsc_sse2(_mm_loadu_si128((__m128i*) &data[x]));
+		__m128i hi = xrgb_ntsc_sse2(_mm_loadu_si128((__m128i*) &data[x+4]));
+		_mm_storeu_si128((__m128i*) &outp[x], _mm_packs_epi32(lo, hi));
+	}
+
+	xrgb888_ntsc_row(&data[x], &outp[x], n - x);
+}
+
+/* SNES_NTSC_CLAMP_ and SNES_NTSC_RGB_OUT_ at 32bpp for four outputs */
+static SSE2_FN __m128i ntsc_clamp_sse2(__m128i io)
+{
+	const __m128i mask = _mm_set1_epi32(snes_ntsc_clamp_mask);
+	__m128i sub = _mm_and_si128(_mm_srli_epi32(io, 8), mask);
+	__m128i clamp = _mm_sub_epi32(_mm_set1_epi32(snes_ntsc_clamp_add), sub);
+	io = _mm_or_si128(io, clamp);
+	clamp = _mm_sub_epi32(clamp, sub);
+	io = _mm_and_si128(io, clamp);
+
+	return _mm_or_si128(_mm_or_si128(
+		_mm_and_si128(_mm_srli_epi32(io, 4), _mm_set1_epi32(0xff0000)),
+		_mm_and_si128(_mm_srli_epi32(io, 2), _mm_set1_epi32(0xff00))),
+		_mm_or_si128(_mm_and_si128(io, _mm_set1_epi32(0xff)),
+		_mm_set1_epi32(0xff000000)));
+}
+
+#define NTSC_RAW(x) (kernel0[x] + kernel1[(x+12)%7+14] + kernel2[(x+10)%7+28] +\
+	kernelx0[(x+7)%14] + kernelx1[(x+5)%7+21] + kernelx2[(x+3)%7+35])
+
+/* same as snes_ntsc_blit, the kernel sums for a chunk of 7 outputs are
+ * gathered first and the clamp / pack is done on all of them at once. Only
+ * the low 32 bits of a sum can reach the packed pixel so they are truncated. */
+static SSE2_FN void ntsc_blit_sse2(snes_ntsc_t const* ntsc,
+	SNES_NTSC_IN_T const* input, long in_row_width, int burst_phase,
+	int in_width, int in_height, void* rgb_out, long out_pitch)
+{
+	int chunk_count = (in_width - 1) / snes_ntsc_in_chunk;
+
+	for (; in_height; --in_height){
+		SNES_NTSC_IN_T const* line_in = input;
+		SNES_NTSC_BEGIN_ROW(ntsc, burst_phase,
+			snes_ntsc_black, snes_ntsc_black, SNES_NTSC_ADJ_IN(*line_in));
+		uint32_t* restrict line_out = rgb_out;
+		_Alignas(16) uint32_t raw[8];
+		line_in++;
+
+/* the last round finishes the row with black */
+		for (int n = chunk_count + 1; n; --n){
+			bool last = n == 1;
+			SNES_NTSC_COLOR_IN(0, last ? snes_ntsc_black : SNES_NTSC_ADJ_IN(line_in[0]));
+			raw[0] = NTSC_RAW(0);
+			raw[1] = NTSC_RAW(1);
+			SNES_NTSC_COLOR_IN(1, last ? snes_ntsc_black : SNES_NTSC_ADJ_IN(line_in[1]));
+			raw[2] = NTSC_RAW(2);
+			raw[3] = NTSC_RAW(3);
+			SNES_NTSC_COLOR_IN(2, last ? snes_ntsc_black : SNES_NTSC_ADJ_IN(line_in[2]));
+			raw[4] = NTSC_RAW(4);
+			raw[5] = NTSC_RAW(5);
+			raw[6] = NTSC_RAW(6);
+
+			__m128i lo = ntsc_clamp_sse2(_mm_load_si128((__m128i*) raw));
+			__m128i hi = ntsc_clamp_sse2(_mm_load_si128((__m128i*) &raw[4]));
+			_mm_storeu_si128((__m128i*) line_out, lo);
+			_mm_storel_epi64((__m128i*) &line_out[4], hi);
+			line_out[6] = _mm_cvtsi128_si32(_mm_srli_si128(hi, 8));
+
+			line_in += 3;
+			line_out += 7;
+		}
+
+		burst_phase = (burst_phase + 1) % snes_ntsc_burst_count;
+		input += in_row_width;
+		rgb_out = (char*) rgb_out + out_pitch;
+	}
+}
+#undef NTSC_RAW
+
+/* unpack works per 128-bit lane, so put the halves back in order on store */
+static AVX2_FN void pack_avx2(
+	__m256i r, __m256i g, __m256i b, shmif_pixel* outp)
+{
+	const __m256i alpha = _mm256_set1_epi16(0xff00);
+	__m256i lo = PIXCONV_RLOW ?
+		_mm256_or_si256(r, _mm256_slli_epi16(g, 8)) :
+		_mm256_or_si256(b, _mm256_slli_epi16(g, 8));
+	__m256i hi = _mm256_or_si256(PIXCONV_RLOW ? b : r, alpha);
+	__m256i p0 = _mm256_unpacklo_epi16(lo, hi);
+	__m256i p1 = _mm256_unpackhi_epi16(lo, hi);
+	_mm256_storeu_si256((__m256i*) outp, _mm256_permute2x128_si256(p0, p1, 0x20));
+	_mm256_storeu_si256((__m256i*) &outp[8], _mm256_permute2x128_si256(p0, p1, 0x31));
+}
+
+static AVX2_FN void rgb565_row_avx2(
+	const uint16_t* data, shmif_pixel* outp, size_t n)
+{
+	const __m256i m5 = _mm256_set1_epi16(0x1f);
+	const __m256i m6 = _mm256_set1_epi16(0x3f);
+	size_t x = 0;
+
+	for (; x + 16 <= n; x += 16){
+		__m256i v = _mm256_loadu_si256((__m256i*) &data[x]);
+		__m256i r = _mm256_srli_epi16(v, 11);
+		__m256i g = _mm256_and_si256(_mm256_srli_epi16(v, 5), m6);
+		__m256i b = _mm256_and_si256(v, m5);
+
+		r = _mm256_srli_epi16(_mm256_add_epi16(
+			_mm256_mullo_epi16(r, _mm256_set1_epi16(527)), _mm256_set1_epi16(23)), 6);
+		g = _mm256_srli_epi16(_mm256_add_epi16(
+			_mm256_mullo_epi16(g, _mm256_set1_epi16(259)), _mm256_set1_epi16(33)), 6);
+		b = _mm256_srli_epi16(_mm256_add_epi16(
+			_mm256_mullo_epi16(b, _mm256_set1_epi16(527)), _mm256_set1_epi16(23)), 6);
+
+		pack_avx2(r, g, b, &outp[x]);
+	}
+
+	rgb565_row_sse2(&data[x], &outp[x], n - x);
+}
+
+static AVX2_FN void rgb1555_row_avx2(
+	const uint16_t* data, shmif_pixel* outp, size_t n)
+{
+	const __m256i m5 = _mm256_set1_epi16(0xf8);
+	size_t x = 0;
+
+	for (; x + 16 <= n; x += 16){
+		__m256i v = _mm256_loadu_si256((__m256i*) &data[x]);
+		pack_avx2(
+			_mm256_and_si256(_mm256_srli_epi16(v, 7), m5),
+			_mm256_and_si256(_mm256_srli_epi16(v, 2), m5),
+			_mm256_and_si256(_mm256_slli_epi16(v, 3), m5), &outp[x]);
+	}
+
+	rgb1555_row_sse2(&data[x], &outp[x], n - x);
+}
+
+static AVX2_FN void xrgb888_row_avx2(
+	const uint32_t* data, shmif_pixel* outp, size_t n)
+{
+	const __m256i alpha = _mm256_set1_epi32(0xff000000);
+	const __m256i mb = _mm256_set1_epi32(0xff);
+	size_t x = 0;
+
+	for (; x + 8 <= n; x += 8){
+		__m256i v = _mm256_loadu_si256((__m256i*) &data[x]);
+		if (PIXCONV_RLOW)
+			v = _mm256_or_si256(
+				_mm256_and_si256(v, _mm256_set1_epi32(0xff00)),
+				_mm256_or_si256(
+					_mm256_and_si256(_mm256_srli_epi32(v, 16), mb),
+					_mm256_slli_epi32(_mm256_and_si256(v, mb), 16)
+				)
+			);
+		_mm256_storeu_si256((__m256i*) &outp[x], _mm256_or_si256(v, alpha));
+	}
+
+	xrgb888_row_sse2(&data[x], &outp[x], n - x);
+}
+#endif
+
+#ifdef PIXCONV_SIMD_NEON
+static void pack_neon(
+	uint16x8_t r, uint16x8_t g, uint16x8_t b, shmif_pixel* outp)
+{
+	uint8x8x4_t px;
+	px.val[0] = vmovn_u16(PIXCONV_RLOW ? r : b);
+	px.val[1] = vmovn_u16(g);
+	px.val[2] = vmovn_u16(PIXCONV_RLOW ? b : r);
+	px.val[3] = vdup_n_u8(0xff);
+	vst4_u8((uint8_t*) outp, px);
+}
+
+static void rgb565_row_neon(const uint16_t* data, shmif_pixel* outp, size_t n)
+{
+	const uint16x8_t m5 = vdupq_n_u16(0x1f);
+	const uint16x8_t m6 = vdupq_n_u16(0x3f);
+	size_t x = 0;
+
+	for (; x + 8 <= n; x += 8){
+		uint16x8_t v = vld1q_u16(&data[x]);
+		uint16x8_t r = vshrq_n_u16(v, 11);
+		uint16x8_t g = vandq_u16(vshrq_n_u16(v, 5), m6);
+		uint16x8_t b = vandq_u16(v, m5);
+
+		r = vshrq_n_u16(vmlaq_n_u16(vdupq_n_u16(23), r, 527), 6);
+		g = vshrq_n_u16(vmlaq_n_u16(vdupq_n_u16(33), g, 259), 6);
+		b = vshrq_n_u16(vmlaq_n_u16(vdupq_n_u16(23), b, 527), 6);
+
+		pack_neon(r, g, b, &outp[x]);
+	}
+
+	rgb565_row(&data[x], &outp[x], n - x);
+}
+
+static void rgb1555_row_neon(const uint16_t* data, shmif_pixel* outp, size_t n)
+{
+	const uint16x8_t m5 = vdupq_n_u16(0xf8);
+	size_t x = 0;
+
+	for (; x + 8 <= n; x += 8){
+		uint16x8_t v = vld1q_u16(&data[x]);
+		pack_neon(
+			vandq_u16(vshrq_n_u16(v, 7), m5),
+			vandq_u16(vshrq_n_u16(v, 2), m5),
+			vandq_u16(vshlq_n_u16(v, 3), m5), &outp[x]);
+	}
+
+	rgb1555_row(&data[x], &outp[x], n - x);
+}
+
+static void xrgb888_row_neon(const uint32_t* data, shmif_pixel* outp, size_t n)
+{
+	size_t x = 0;
+
+	for (; x + 16 <= n; x += 16){
+		uint8x16x4_t px = vld4q_u8((const uint8_t*) &data[x]);
+		if (PIXCONV_RLOW){
+			uint8x16_t tmp = px.val[0];
+			px.val[0] = px.val[2];
+			px.val[2] = tmp;
+		}
+		px.val[3] = vdupq_n_u8(0xff);
+		vst4q_u8((uint8_t*) &outp[x], px);
+	}
+
+	xrgb888_row(&data[x], &outp[x], n - x);
+}
+#endif
+
+static struct {
+	bool init;
+	void (*rgb565)(const uint16_t*, shmif_pixel*, size_t);
+	void (*xrgb888)(const uint32_t*, shmif_pixel*, size_t);
+	void (*rgb1555)(const uint16_t*, shmif_pixel*, size_t);
+	void (*rgb565_ntsc)(const uint16_t*, uint16_t*, size_t);
+	void (*xrgb888_ntsc)(const uint32_t*, uint16_t*, size_t);
+	void (*rgb1555_ntsc)(const uint16_t*, uint16_t*, size_t);
+	void (*ntsc_blit)(snes_ntsc_t const*, SNES_NTSC_IN_T const*,
+		long, int, int, int, void*, long);
+} pixconv = {
+	.rgb565 = rgb565_row,
+	.xrgb888 = xrgb888_row,
+	.rgb1555 = rgb1555_row,
+	.rgb565_ntsc = rgb565_ntsc_row,
+	.xrgb888_ntsc = xrgb888_ntsc_row,
+	.rgb1555_ntsc = rgb1555_ntsc_row,
+	.ntsc_blit = snes_ntsc_blit
+};
+
+/* GAME_NOSIMD in the env keeps the scalar versions for comparison */
+static void pixconv_select()
+{
+	if (pixconv.init)
+		return;
+	pixconv.init = true;
+
+	if (getenv("GAME_NOSIMD"))
+		return;
+
+#ifdef PIXCONV_SIMD_X86
+	if (__builtin_cpu_supports("avx2")){
+		pixconv.rgb565 = rgb565_row_avx2;
+		pixconv.xrgb888 = xrgb888_row_avx2;
+		pixconv.rgb1555 = rgb1555_row_avx2;
+	}
+	else if (__builtin_cpu_supports("sse2")){
+		pixconv.rgb565 = rgb565_row_sse2;
+		pixconv.xrgb888 = xrgb888_row_sse2;
+		pixconv.rgb1555 = rgb1555_row_sse2;
+	}
+
+	if (__builtin_cpu_supports("sse2")){
+		pixconv.rgb565_ntsc = rgb565_ntsc_row_sse2;
+		pixconv.xrgb888_ntsc = xrgb888_ntsc_row_sse2;
+		pixconv.rgb1555_ntsc = rgb1555_ntsc_row_sse2;
+		pixconv.ntsc_blit = ntsc_blit_sse2;
+	}
+#endif
+
+#ifdef PIXCONV_SIMD_NEON
+#if defined(__arm__) && defined(__linux__)
+	if (!(getauxval(AT_HWCAP) & HWCAP_NEON))
+		return;
+#endif
+	pixconv.rgb565 = rgb565_row_neon;
+	pixconv.xrgb888 = xrgb888_row_neon;
+	pixconv.rgb1555 = rgb1555_row_neon;
+#endif
+}
+
+/* Rows in the ntsc filter only depend on their own input and the burst phase,
+ * which follows the row index, so the frame is cut into bands that are run in
+ * parallel. The calling thread takes the first band and waits for the rest.
+ * Workers are started on the first filtered frame and then kept around. */
+#define NTSC_MAX_THREADS 8
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+	size_t n_threads;
+	size_t n_started;
+	size_t pending;
+	unsigned gen;
+
+	const uint16_t* imb;
+	shmif_pixel* outp;
+	unsigned width, height;
+} ntscpool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+	.n_threads = 1
+};
+
+static void ntsc_band(size_t band, size_t n_bands)
+{
+	unsigned width = ntscpool.width;
+	unsigned y0 = ntscpool.height * band / n_bands;
+	unsigned y1 = ntscpool.height * (band + 1) / n_bands;
+	size_t linew = SNES_NTSC_OUT_WIDTH(width) * 4;
+	char* outp = (char*) ntscpool.outp + (size_t) y0 * 2 * linew;
+
+	if (y1 <= y0)
+		return;
+
+/* only draw on every other line, so we can easily mix or
+ * blend interleaved (or just duplicate) */
+	pixconv.ntsc_blit(retro.ntscctx, &ntscpool.imb[(size_t) y0 * width],
+		width, y0 % snes_ntsc_burst_count, width, y1 - y0, outp, linew * 2);
+
+/* this might be a possible test-case for running two shmif
+ * connections and let the compositor do interlacing management */
+	assert(ARCAN_SHMPAGE_VCHANNELS == 4);
+	for (size_t row = 0; row < y1 - y0; row++)
+		memcpy(&outp[(row * 2 + 1) * linew], &outp[row * 2 * linew], linew);
+}
+
+static void* ntsc_worker(void* tag)
+{
+	size_t band = (uintptr_t) tag;
+	unsigned gen = 0;
+
+	pthread_mutex_lock(&ntscpool.lock);
+	for(;;){
+		while (gen == ntscpool.gen)
+			pthread_cond_wait(&ntscpool.work, &ntscpool.lock);
+		gen = ntscpool.gen;
+		size_t n_bands = ntscpool.n_threads;
+		pthread_mutex_unlock(&ntscpool.lock);
+
+		ntsc_band(band, n_bands);
+
+		pthread_mutex_lock(&ntscpool.lock);
+		if (--ntscpool.pending == 0)
+			pthread_cond_signal(&ntscpool.done);
+	}
+
+	return NULL;
+}
+
+static void ntsc_workers()
+{
+	if (ntscpool.n_started)
+		return;
+	ntscpool.n_started = 1;
+
+	for (size_t i = 1; i < ntscpool.n_threads; i++){
+		pthread_t pth;
+		if (0 != pthread_create(&pth, NULL, ntsc_worker, (void*)(uintptr_t) i))
+			break;
+		pthread_detach(pth);
+		ntscpool.n_started++;
+	}
+
+/* fewer threads than asked for just means fewer bands */
+	ntscpool.n_threads = ntscpool.n_started;
+}
+
+static void push_ntsc(unsigned width, unsigned height,
+	const uint16_t* ntsc_imb, shmif_pixel* outp)
+{
+	ntsc_workers();
+	ntscpool.imb = ntsc_imb;
+	ntscpool.outp = outp;
+	ntscpool.width = width;
+	ntscpool.height = height;
+
+	if (ntscpool.n_threads <= 1){
+		ntsc_band(0, 1);
+		return;
+	}
+
+	pthread_mutex_lock(&ntscpool.lock);
+	ntscpool.pending = ntscpool.n_threads - 1;
+	ntscpool.gen++;
+	pthread_cond_broadcast(&ntscpool.work);
+	pthread_mutex_unlock(&ntscpool.lock);
+
+	ntsc_band(0, ntscpool.n_threads);
+
+	pthread_mutex_lock(&ntscpool.lock);
+	while (ntscpool.pending)
+		pthread_cond_wait(&ntscpool.done, &ntscpool.lock);
+	pthread_mutex_unlock(&ntscpool.lock);
+}
+
 static void libretro_rgb565_rgba(const uint16_t* data, shmif_pixel* outp,
 	unsigned width, unsigned height, size_t pitch)
 {
 	uint16_t* interm = retro.ntsc_imb;
 	retro.colorspace = "RGB565->RGBA";
 
-/* with NTSC on, the input format is already correct */
-	for (int y = 0; y < height; y++){
-		for (int x = 0; x < width; x++){
-			uint16_t val = data[x];
-			uint8_t r = rgb565_lut5[ (val & 0xf800) >> 11 ];
-			uint8_t g = rgb565_lut6[ (val & 0x07e0) >> 5  ];
-			uint8_t b = rgb565_lut5[ (val & 0x001f)       ];
-
-			if (retro.ntscconv)
-				*interm++ = RGB565(r, g, b);
-			else
-				*outp++ = RGBA(r, g, b, 0xff);
+	if (!retro.ntscconv){
+		for (int y = 0; y < height; y++){
+			pixconv.rgb565(data, outp, width);
+			outp += width;
+			data += pitch >> 1;
 		}
-		data += pitch >> 1;
+		return;
 	}
 
-	if (retro.ntscconv)
-		push_ntsc(width, height, retro.ntsc_imb, outp);
+	for (int y = 0; y < height; y++){
+		pixconv.rgb565_ntsc(data, interm, width);
+		interm += width;
+		data += pitch >> 1;
+	}
 
-	return;
+	push_ntsc(width, height, retro.ntsc_imb, outp);
 }
 
 static void libretro_xrgb888_rgba(const uint32_t* data, uint32_t* outp,
@@ -394,20 +1018,22 @@ static void libretro_xrgb888_rgba(const uint32_t* data, uint32_t* outp,
 
 	uint16_t* interm = retro.ntsc_imb;
 
-	for (int y = 0; y < height; y++){
-		for (int x = 0; x < width; x++){
-			uint8_t* quad = (uint8_t*) (data + x);
-			if (retro.ntscconv)
-				*interm++ = RGB565(quad[2], quad[1], quad[0]);
-			else
-				*outp++ = RGBA(quad[2], quad[1], quad[0], 0xff);
+	if (!retro.ntscconv){
+		for (int y = 0; y < height; y++){
+			pixconv.xrgb888(data, outp, width);
+			outp += width;
+			data += pitch >> 2;
 		}
+		return;
+	}
 
+	for (int y = 0; y < height; y++){
+		pixconv.xrgb888_ntsc(data, interm, width);
+		interm += width;
 		data += pitch >> 2;
 	}
 
-	if (retro.ntscconv)
-		push_ntsc(width, height, retro.ntsc_imb, outp);
+	push_ntsc(width, height, retro.ntsc_imb, outp);
 }
 
 static void libretro_rgb1555_rgba(const uint16_t* data, uint32_t* outp,
@@ -419,36 +1045,33 @@ static void libretro_rgb1555_rgba(const uint16_t* data, uint32_t* outp,
 	unsigned dh = height >= ARCAN_SHMPAGE_MAXH ? ARCAN_SHMPAGE_MAXH : height;
 	unsigned dw =  width >= ARCAN_SHMPAGE_MAXW ? ARCAN_SHMPAGE_MAXW : width;
 
-	for (int y = 0; y < dh; y++){
-		for (int x = 0; x < dw; x++){
-			uint16_t val = data[x];
-			uint8_t r = ((val & 0x7c00) >> 10) << 3;
-			uint8_t g = ((val & 0x03e0) >>  5) << 3;
-			uint8_t b = ( val & 0x001f) <<  3;
-
-			if (postfilter)
-				*interm++ = RGB565(r, g, b);
-			else
-				*outp++ = RGBA(r, g, b, 0xff);
+	if (!postfilter){
+		for (int y = 0; y < dh; y++){
+			pixconv.rgb1555(data, outp, dw);
+			outp += dw;
+			data += pitch >> 1;
 		}
+		return;
+	}
 
+	for (int y = 0; y < dh; y++){
+		pixconv.rgb1555_ntsc(data, interm, dw);
+		interm += dw;
 		data += pitch >> 1;
 	}
 
-	if (postfilter)
-		push_ntsc(width, height, retro.ntsc_imb, outp);
+	push_ntsc(width, height, retro.ntsc_imb, outp);
 }
 
-
 static int testcounter;
 static void libretro_vidcb(const void* data, unsigned width,
 	unsigned height, size_t pitch)
 {
 	testcounter++;
 
-	if (retro.in_3d && !data)
-		;
-	else if (!data || retro.skipframe_v){
+/* for hw-render cores NULL is also a dupe, the core didn't draw into the
+ * swapchain buffer so presenting it would show a stale frame */
+	if (!data || retro.skipframe_v){
 		retro.empty_v = true;
 		return;
 	}
@@ -487,8 +1110,9 @@ static void libretro_vidcb(const void* data, unsigned width,
 #ifdef FRAMESERVER_LIBRETRO_3D
 /* method one, just read color attachment */
 	if (retro.in_3d){
-/* it seems like tons of cores doesn't actually set this correctly */
-		retro.got_3dframe = 1 || data == RETRO_HW_FRAME_BUFFER_VALID;
+/* it seems like tons of cores doesn't actually set this correctly, so any
+ * non-NULL data counts as a rendered frame */
+		retro.got_3dframe = true;
 		return;
 	}
 	else
@@ -540,6 +1164,65 @@ static void libretro_skipnframes(unsigned count, bool fastfwd)
 	retro.skipframe_v = false;
 }
 
+static void set_runahead(int n)
+{
+	if (n < 0)
+		n = 0;
+	else if (n > RUNAHEAD_LIMIT)
+		n = RUNAHEAD_LIMIT;
+
+	if (n && !retro.state_sz){
+		LOG("run-ahead requires savestate support in the core\n");
+		n = 0;
+	}
+
+/* the slot is only ever grown, run-ahead itself doesn't allocate */
+	if (n && retro.runahead_sz < retro.state_sz){
+		free(retro.runahead_state);
+		retro.runahead_state = malloc(retro.state_sz);
+		retro.runahead_sz = retro.runahead_state ? retro.state_sz : 0;
+		if (!retro.runahead_state)
+			n = 0;
+	}
+
+	retro.runahead = n;
+	LOG("run-ahead set to (%d) frames\n", n);
+}
+
+/* the real frame only contributes audio, the presented one is the last of
+ * the hidden frames that run past it */
+static void runahead_frames()
+{
+	if (retro.skipframe_v){
+		process_frames(1, false, false);
+		return;
+	}
+
+	retro.skipframe_v = true;
+	retro.run();
+
+	if (!retro.serialize(retro.runahead_state, retro.state_sz)){
+		LOG("run-ahead couldn't serialize, disabling\n");
+		retro.runahead = 0;
+		retro.skipframe_v = false;
+		return;
+	}
+
+	bool ca = retro.skipframe_a;
+	retro.skipframe_a = true;
+	for (int i = 0; i < retro.runahead - 1; i++)
+		retro.run();
+
+	retro.skipframe_v = false;
+	retro.run();
+
+	retro.deserialize(retro.runahead_state, retro.state_sz);
+	retro.skipframe_a = ca;
+
+/* only the presented frame counts for the one video frame per run() check */
+	testcounter -= retro.runahead;
+}
+
 static void reset_timing(bool newstate)
 {
 	arcan_shmif_enqueue(&retro.shmcont, &(arcan_event){
@@ -667,6 +1350,11 @@ static const char* lookup_varset( const char* key )
  * so this is just a complement to launch arguments */
 static void update_corearg(int code, const char* value)
 {
+	if (retro.runahead_index >= 0 && code == retro.runahead_index){
+		set_runahead(strtol(value, NULL, 10));
+		return;
+	}
+
 	struct core_variable* var = retro.varset;
 	while (var && var->key && code--)
 		var++;
@@ -678,6 +1366,36 @@ static void update_corearg(int code, const char* value)
 	}
 }
 
+/* run-ahead is exposed as an option of its own so that the parent can keep
+ * it per core along with the others */
+static void announce_runahead(int index)
+{
+	arcan_event outev = {
+		.category = EVENT_EXTERNAL,
+		.ext.kind = ARCAN_EVENT(COREOPT),
+		.ext.coreopt.index = index
+	};
+	size_t msgsz = COUNT_OF(outev.ext.coreopt.data);
+	retro.runahead_index = index;
+
+	snprintf((char*)outev.ext.coreopt.data, msgsz, "arcan_runahead");
+	arcan_shmif_enqueue(&retro.shmcont, &outev);
+
+	outev.ext.coreopt.type = 1;
+	snprintf((char*)outev.ext.coreopt.data, msgsz, "Run-ahead frames");
+	arcan_shmif_enqueue(&retro.shmcont, &outev);
+
+	outev.ext.coreopt.type = 2;
+	for (int i = 0; i <= RUNAHEAD_LIMIT; i++){
+		snprintf((char*)outev.ext.coreopt.data, msgsz, "%d", i);
+		arcan_shmif_enqueue(&retro.shmcont, &outev);
+	}
+
+	outev.ext.coreopt.type = 3;
+	snprintf((char*)outev.ext.coreopt.data, msgsz, "%d", retro.runahead);
+	arcan_shmif_enqueue(&retro.shmcont, &outev);
+}
+
 static void update_varset( struct retro_variable* data )
 {
 	int count = 0;
@@ -705,8 +1423,10 @@ static void update_varset( struct retro_variable* data )
 	while ( data[count].key )
 		count++;
 
-	if (count == 0)
+	if (count == 0){
+		announce_runahead(0);
 		return;
+	}
 
 	count++;
 	retro.varset = malloc( sizeof(struct core_variable) * count);
@@ -786,6 +1506,8 @@ step:
 
 		count++;
 	}
+
+	announce_runahead(count);
 }
 
 static void libretro_log(enum retro_log_level level, const char* fmt, ...)
@@ -1403,6 +2125,56 @@ static inline void targetev(arcan_event* ev)
 	}
 }
 
+static void send_latency_report()
+{
+	char buf[256];
+	ievsched_report(buf, sizeof(buf), true);
+	LOG("%s\n", buf);
+
+	arcan_event ev = {
+		.category = EVENT_EXTERNAL,
+		.ext.kind = ARCAN_EVENT(MESSAGE)
+	};
+	arcan_shmif_pushutf8(&retro.shmcont, &ev, buf, strlen(buf));
+}
+
+/* LATENCY markers never come out of the scheduler, LATENCY_REPORT sends the
+ * samples collected so far as a message and starts over */
+static void dispatch_scheduled()
+{
+	arcan_ioevent* ev;
+	while (ievsched_poll(&ev)){
+		if (strcmp(ev->label, "LATENCY_REPORT") == 0)
+			send_latency_report();
+		else
+			ioev_ctxtbl(ev, ev->label);
+	}
+}
+
+/* sleep on the scheduler timer so held input is applied at its time rather
+ * than at the next frame boundary */
+static void sched_sleep(int ms)
+{
+	unsigned long until = ievsched_nextpts() + ms * 1000;
+
+	for(;;){
+		dispatch_scheduled();
+		if (ievsched_nextpts() >= until)
+			return;
+
+		int fd = ievsched_timerfd(until);
+		if (-1 == fd){
+			arcan_timesleep(ievsched_timeout(until));
+			continue;
+		}
+
+		struct pollfd pfd = {.fd = fd, .events = POLLIN};
+		uint64_t exp;
+		if (poll(&pfd, 1, -1) > 0)
+			read(fd, &exp, sizeof(exp));
+	}
+}
+
 /* use labels etc. for trying to populate the context table we also process
  * requests to save state, shutdown, reset, plug/unplug input, here */
 static inline int flush_eventq(){
@@ -1412,7 +2184,10 @@ static inline int flush_eventq(){
 	while ((ps = arcan_shmif_poll(&retro.shmcont, &ev)) > 0){
 		switch (ev.category){
 			case EVENT_IO:
-				ioev_ctxtbl(&(ev.io), ev.io.label);
+				if (retro.inputsched && ev.io.pts)
+					ievsched_enqueue(&ev.io);
+				else
+					ioev_ctxtbl(&(ev.io), ev.io.label);
 			break;
 
 			case EVENT_TARGET:
@@ -1493,7 +2268,10 @@ static inline bool retro_sync()
  * compensate lightly for scheduling jitter etc. */
 	if (left > retro.prewake){
 		LOG("sleep %d ms\n", left - retro.prewake);
-		arcan_timesleep( left - retro.prewake );
+		if (retro.inputsched)
+			sched_sleep( left - retro.prewake );
+		else
+			arcan_timesleep( left - retro.prewake );
 	}
 
 	return true;
@@ -1550,6 +2328,9 @@ static void setup_3dcore(struct retro_hw_render_callback* ctx)
 	}
 
 	retro.in_3d = true;
+	retro.colorspace = arcan_shmifext_isext(&retro.shmcont) == 1 ?
+		"HW (dma-buf)" : "HW (readback)";
+	LOG("3D context ready, transfer: %s\n", retro.colorspace);
 
 	ctx->get_current_framebuffer = get_framebuffer;
 	ctx->get_proc_address = (retro_hw_get_proc_address_t) platform_video_gfxsym;
@@ -1667,6 +2448,13 @@ static void setup_input()
 		.ext.kind = ARCAN_EVENT(STATESIZE),
 		.ext.stateinf.size = retro.state_sz
 	});
+
+/* cores without variables of their own still get the option */
+	if (retro.runahead_index == -1)
+		announce_runahead(0);
+
+	if (retro.runahead)
+		set_runahead(retro.runahead);
 }
 
 static void dump_help()
@@ -1682,6 +2470,10 @@ static void dump_help()
 		" vbufc   \t num       \t (1) 1..4 - number of video buffers\n"
 		" abufc   \t num       \t (8) 1..16 - number of audio buffers\n"
 		" abufsz  \t num       \t audio buffer size in bytes (default = probe)\n"
+		" runahead\t num       \t (0) 0..4 - hidden frames to run past input\n"
+		" inputsched\t         \t hold input with a pts (us, frame vpts clock) until due,\n"
+		"         \t           \t LATENCY/LATENCY_REPORT labels mark and report latency\n"
+		" ntsc_threads\t num     \t (cores, max 4) 1..8 - threads for the NTSC filter\n"
     " noreset \t           \t (3D) disable context reset calls\n"
     "---------\t-----------\t-----------------\n"
 	);
@@ -1697,6 +2489,7 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 		return EXIT_FAILURE;
 	}
 
+	pixconv_select();
 	retro.converter = (pixconv_fun) libretro_rgb1555_rgba;
 	retro.inargs = args;
 	retro.shmcont = *cont;
@@ -1725,6 +2518,23 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 		retro.def_abuf_sz = strtoul(val, NULL, 10);
 	}
 
+/* applied in setup_input when it is known if the core can serialize */
+	if (arg_lookup(args, "runahead", 0, &val)){
+		int n = strtol(val, NULL, 10);
+		retro.runahead = n < 0 ? 0 : (n > RUNAHEAD_LIMIT ? RUNAHEAD_LIMIT : n);
+	}
+
+	retro.inputsched = arg_lookup(args, "inputsched", 0, NULL);
+
+	if (arg_lookup(args, "ntsc_threads", 0, &val)){
+		long n = strtol(val, NULL, 10);
+		ntscpool.n_threads = n < 1 ? 1 : (n > NTSC_MAX_THREADS ? NTSC_MAX_THREADS : n);
+	}
+	else {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		ntscpool.n_threads = n < 1 ? 1 : (n > 4 ? 4 : n);
+	}
+
 /* system directory doesn't really match any of arcan namespaces,
  * provide some kind of global-  user overridable way */
 	const char* spath = getenv("ARCAN_LIBRETRO_SYSPATH");
@@ -1836,6 +2646,8 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 	retro.run();
 	retro.skipframe_v = retro.skipframe_a = false;
 	retro.basetime = arcan_timemillis();
+	if (retro.inputsched)
+		ievsched_clock(IEVSCHED_MONOTONIC, false);
 
 /* pre-audio is a last- resort to work around buffering size issues
  * in audio layers -- run one or more frames of emulation, ignoring
@@ -1873,11 +2685,18 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 
 		testcounter = 0;
 
+		if (retro.inputsched)
+			dispatch_scheduled();
+
 /* add jitter, jitterstep, framecost etc. are used for debugging /
- * testing by adding delays at various key synchronization points */
+ * testing by adding delays at various key synchronization points,
+ * rollback already covers what run-ahead would */
 		start = arcan_timemillis();
 			add_jitter(retro.jitterstep);
-			process_frames(1, false, false);
+			if (retro.runahead && retro.skipmode > TARGET_SKIP_ROLLBACK)
+				runahead_frames();
+			else
+				process_frames(1, false, false);
 		stop = arcan_timemillis();
 		retro.framecost = stop - start;
 		if (retro.sync_data){
@@ -1898,13 +2717,22 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
  * penalties and the cost for resampling can be enough if we are close */
 		if (!retro.empty_v){
 			long long elapsed = add_jitter(retro.jitterstep);
+			if (retro.inputsched)
+				retro.shmcont.addr->vpts = ievsched_nextpts() / 1000;
 #ifdef FRAMESERVER_LIBRETRO_3D
 			if (retro.got_3dframe){
+/* with handle passing the call returns without waiting for the ack, so the
+ * cost is measured here rather than taken from the return value */
+				long long hstart = arcan_timemillis();
 				int handlestatus = arcan_shmifext_signal(&retro.shmcont,
 					0, SHMIF_SIGVID, SHMIFEXT_BUILTIN);
 				if (handlestatus >= 0)
-					elapsed += handlestatus;
+					elapsed += arcan_timemillis() - hstart;
 				retro.got_3dframe = false;
+
+/* the server can reject the buffers at any time and push us to readback */
+				retro.colorspace = arcan_shmifext_isext(&retro.shmcont) == 1 ?
+					"HW (dma-buf)" : "HW (readback)";
 				LOG("3d-video transfer cost (%lld)\n", elapsed);
 			}
 /* note the dangling else */
@@ -1914,6 +2742,8 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 
 			retro.transfercost = elapsed;
 			LOG("video transfer cost (%lld)\n", elapsed);
+			if (retro.inputsched)
+				ievsched_frame(retro.shmcont.addr->vpts);
 			if (retro.sync_data)
 				retro.sync_data->mark_transfer(retro.sync_data,
 					stop, retro.transfercost);
@@ -1926,6 +2756,13 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 		if (retro.sync_data)
 				push_stats();
 	}
+
+	if (retro.inputsched){
+		char buf[256];
+		ievsched_report(buf, sizeof(buf), false);
+		LOG("%s\n", buf);
+	}
+
 	return EXIT_SUCCESS;
 }
 
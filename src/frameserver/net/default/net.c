@@ -44,7 +44,7 @@ static bool flush_shmif(struct arcan_shmif_cont* C)
 
 	while ((rv = arcan_shmif_poll(C, &ev)) > 0){
 		if (ev.category == EVENT_TARGET && ev.tgt.kind == TARGET_COMMAND_EXIT)
-			return EXIT_FAILURE;
+			return false;
 	}
 
 	return rv == 0;
@@ -202,58 +202,82 @@ static int discover_passive(
 	return EXIT_SUCCESS;
 }
 
-struct listent;
-struct listent {
+/*
+ * The sweep keeps one entry per known tag and runs everything from a single
+ * poll loop: reachability is checked with non-blocking connects to all hosts
+ * that are due at the same time, and only when a host turns up (or the role is
+ * due for a refresh) is the full authenticated probe run. Results are cached
+ * so that a stable network only costs a connect per host and sweep, and hosts
+ * that keep failing are backed off instead of being retried every sweep.
+ */
+#define SWEEP_CONNECT_TIMEOUT 3000
+#define SWEEP_PARALLEL 16
+#define SWEEP_BACKOFF_MAX 32
+#define SWEEP_REFRESH 6
+
+struct sweepent;
+struct sweepent {
 	char name[64];
-	bool seen;
-	struct listent* next;
+	bool listed;
+	bool known;
+	int type;
+	int fd;
+	size_t host_ind;
+	uint64_t deadline;
+	uint64_t next_probe;
+	unsigned fails;
+	unsigned since_deep;
+	struct sweepent* next;
 };
 
-struct tagopt {
+struct sweepopt {
 	struct arcan_shmif_cont* C;
-	int delay;
-	bool alive;
 	const char* key;
-	struct listent* first;
+	uint64_t pause;
+	struct sweepent* first;
 };
 
-static void reset_seen(struct listent* cur)
+static void sweep_netstate(
+	struct arcan_shmif_cont* C, struct sweepent* ent, bool found)
 {
-	while (cur){
-		cur->seen = false;
-		cur = cur->next;
-	}
+	arcan_event ev = {
+		.ext.kind = ARCAN_EVENT(NETSTATE),
+		.ext.netstate = {
+			.state = found,
+			.type = found ? ent->type : 0
+		}
+	};
+	snprintf(ev.ext.netstate.name,
+		COUNT_OF(ev.ext.netstate.name), "%s", ent->name);
+	arcan_shmif_enqueue(C, &ev);
 }
 
-static void mark_lost(struct arcan_shmif_cont* C, struct listent** first)
+static bool sweep_listtag(const char* name, void* tag)
 {
-	struct listent** last = first;
-	struct listent* cur = *first;
-
-/* sweep through all known nodes and if one wasn't visited this sweep,
- * send an event marking it as unknown and then unlink from the list */
-	while (cur){
-		if (!cur->seen){
-			LOG("lost-known: %s\n", cur->name);
-			arcan_event ev = {
-				.ext.kind = ARCAN_EVENT(NETSTATE),
-				.ext.netstate = {0}
-			};
-			snprintf(ev.ext.netstate.name,
-				COUNT_OF(ev.ext.netstate.name), "%s", cur->name);
-			arcan_shmif_enqueue(C, &ev);
+	struct sweepopt* opt = tag;
+	if (!name)
+		return true;
 
-			(*last) = cur->next;
-			free(cur);
-			cur = *last;
-		}
-		else{
-			last = &cur->next;
-			cur = cur->next;
+	struct sweepent** cur = &opt->first;
+	while (*cur){
+		if (strcmp((*cur)->name, name) == 0){
+			(*cur)->listed = true;
+			return true;
 		}
+		cur = &(*cur)->next;
 	}
-}
 
+	*cur = malloc(sizeof(struct sweepent));
+	if (!*cur)
+		return false;
+
+	**cur = (struct sweepent){
+		.listed = true,
+		.fd = -1
+	};
+	snprintf((*cur)->name, 64, "%s", name);
+	return true;
+}
 /* Singleton accessor workaround, the anet_helper_keystore API wasn't really
  * designed / built for this use - anet_cl_setup will swap active keystore
  * which releases current if the contents doesn't match. The tags_ callback is
@@ -283,9 +307,12 @@ static bool get_keystore(
 	return true;
 }
 
-static bool tagh(const char* name, void* tag)
+/*
+ * Authenticated probe for the role of the other end, returns -1 if the
+ * connection or the authentication didn't go through.
+ */
+static int sweep_deep(struct sweepopt* opt, const char* name)
 {
-	struct tagopt* opt = tag;
 	struct a12_context_options a12opts = {
 		.local_role = ROLE_PROBE,
 		.pk_lookup = key_auth_local
@@ -296,15 +323,11 @@ static bool tagh(const char* name, void* tag)
 		.opts = &a12opts
 	};
 
-/* don't need to do any allocation so early out the last entry */
-	if (!name)
-		return true;
-
 	LOG("sweep: petname %s\n", name);
 /* keystore gets released between each cl_setup call */
 	if (!get_keystore(opt->C, &opts.keystore)){
 		LOG("fail, couldn't access keystore\n");
-		return false;
+		return -1;
 	}
 
 /* some might want to provide another secret, this only matters for deep
@@ -314,69 +337,119 @@ static bool tagh(const char* name, void* tag)
 		LOG("setting custom secret (****)\n");
 	}
 
-/* this will depth- first the tag, and if a connection is there, the 'deep'
- * option will also attempt to authenticate before shutting down the socket */
 	struct anet_cl_connection con = anet_cl_setup(&opts);
+	free(con.errmsg);
 
-/* flush the shmif connection to determine if we should stop */
-	if (!flush_shmif(opt->C)){
-		opt->alive = false;
-		return false;
+	int type = -1;
+	if (-1 != con.fd){
+		type = a12_remote_mode(con.state);
+		shutdown(con.fd, SHUT_RDWR);
+		close(con.fd);
 	}
 
-	if (con.errmsg){
-		free(con.errmsg);
+	a12_free(con.state);
+	return type;
+}
+
+/*
+ * Start a non-blocking connect to the host at [ent->host_ind] for the tag,
+ * returns false when the tag has no more hosts to try.
+ */
+static bool sweep_connect(struct sweepopt* opt, struct sweepent* ent, uint64_t now)
+{
+	struct keystore_provider prov;
+	if (!get_keystore(opt->C, &prov) || !a12helper_keystore_open(&prov))
+		return false;
+
+	char* host;
+	uint16_t port;
+	uint8_t privk[32];
+
+	while (a12helper_keystore_hostkey(ent->name, ent->host_ind, privk, &host, &port)){
+		char portstr[sizeof("65536")];
+		snprintf(portstr, sizeof(portstr), "%"PRIu16, port);
+
+		struct addrinfo* addr = NULL;
+		struct addrinfo hints = {
+			.ai_family = AF_UNSPEC,
+			.ai_socktype = SOCK_STREAM,
+			.ai_flags = AI_NUMERICSERV
+		};
+		int ec = getaddrinfo(host, portstr, &hints, &addr);
+		free(host);
+
+		if (!ec){
+			int fd = socket(addr->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (-1 != fd &&
+				(0 == connect(fd, addr->ai_addr, addr->ai_addrlen) || errno == EINPROGRESS)){
+				freeaddrinfo(addr);
+				ent->fd = fd;
+				ent->deadline = now + SWEEP_CONNECT_TIMEOUT;
+				return true;
+			}
+
+			if (-1 != fd)
+				close(fd);
+			freeaddrinfo(addr);
+		}
+
+		ent->host_ind++;
 	}
 
-/* connection didn't go through, move on to the next tag */
-	if (-1 == con.fd){
-		goto out;
+	return false;
+}
+
+static void sweep_result(
+	struct sweepopt* opt, struct sweepent* ent, bool reachable, uint64_t now)
+{
+	if (-1 != ent->fd){
+		close(ent->fd);
+		ent->fd = -1;
 	}
 
-/* already known? then just re-mark as seen and move on */
-	struct listent** cur = &opt->first;
-	while (*cur){
-		if (strcmp((*cur)->name, name) == 0){
-			close(con.fd);
-			(*cur)->seen = true;
-			LOG("known-seen(%s)\n", name);
-			goto out;
-		}
-		cur = &((*cur)->next);
+/* the tag can have several hosts, try the next before giving up */
+	if (!reachable){
+		ent->host_ind++;
+		if (sweep_connect(opt, ent, now))
+			return;
 	}
 
-	*cur = malloc(sizeof(struct listent));
-	**cur = (struct listent){
-		.seen = true
-	};
-	snprintf((*cur)->name, 64, "%s", name);
-	LOG("discovered:%s\n", name);
+	ent->host_ind = 0;
 
-/* if deep is desired, perform authentication and set (type) to
- * 1: source, 2: sink or 4: directory. */
-	arcan_event ev = {
-		.ext.kind = ARCAN_EVENT(NETSTATE),
-		.ext.netstate = {
-			.state = 1,
-			.type  = a12_remote_mode(con.state)
+	if (reachable){
+		int type = ent->type;
+
+/* the connect alone can't say what is on the other end, that needs the full
+ * handshake - but only when it is new to us or the role is due for a check */
+		if (!ent->known || ++ent->since_deep >= SWEEP_REFRESH){
+			type = sweep_deep(opt, ent->name);
+			ent->since_deep = 0;
+			if (-1 == type)
+				reachable = false;
 		}
-	};
-	snprintf(ev.ext.netstate.name,
-		COUNT_OF(ev.ext.netstate.name), "%s",name);
-	arcan_shmif_enqueue(opt->C, &ev);
 
-out:
-	if (-1 != con.fd){
-		shutdown(con.fd, SHUT_RDWR);
-		close(con.fd);
+		if (reachable){
+			if (!ent->known || type != ent->type){
+				ent->type = type;
+				LOG("discovered:%s\n", ent->name);
+				sweep_netstate(opt->C, ent, true);
+			}
+			ent->known = true;
+			ent->fails = 0;
+			ent->next_probe = now + opt->pause;
+			return;
+		}
 	}
 
-	a12_free(con.state);
-
-	if (opt->delay)
-		sleep(opt->delay);
+	if (ent->known){
+		LOG("lost-known: %s\n", ent->name);
+		sweep_netstate(opt->C, ent, false);
+		ent->known = false;
+	}
 
-	return true;
+	if (ent->fails < SWEEP_BACKOFF_MAX)
+		ent->fails = ent->fails ? ent->fails * 2 : 1;
+	ent->next_probe = now + opt->pause * ent->fails;
 }
 
 static int discover_test(struct arcan_shmif_cont* C, int trust)
@@ -422,14 +495,17 @@ static int discover_test(struct arcan_shmif_cont* C, int trust)
 	return EXIT_SUCCESS;
 }
 
-static int discover_sweep(struct arcan_shmif_cont* C, int trust)
+static int discover_sweep(
+	struct arcan_shmif_cont* C, struct arg_arr* args, int trust)
 {
-	struct tagopt tag = {
+	struct sweepopt opt = {
 		.C = C,
-		.delay = 1,
-		.alive = true
+		.pause = 10000
 	};
-	int sweep_pause = 10;
+
+	const char* val;
+	if (arg_lookup(args, "sweep", 0, &val) && val && strtoul(val, NULL, 10))
+		opt.pause = strtoul(val, NULL, 10) * 1000;
 
 	struct keystore_provider prov;
 	if (!get_keystore(C, &prov))
@@ -441,11 +517,92 @@ static int discover_sweep(struct arcan_shmif_cont* C, int trust)
 		return EXIT_FAILURE;
 	}
 
+	uint64_t next_list = 0;
+	struct pollfd pfd[SWEEP_PARALLEL + 1];
+	struct sweepent* pending[SWEEP_PARALLEL];
+
 	while (flush_shmif(C)){
-		reset_seen(tag.first);
-		a12helper_keystore_tags(tagh, &tag);
-		mark_lost(C, &tag.first);
-		sleep(sweep_pause);
+		uint64_t now = arcan_timemillis();
+
+/* re-read the set of tags each sweep, entries that went away are dropped */
+		if (now >= next_list){
+			get_keystore(C, &prov);
+			a12helper_keystore_open(&prov);
+
+			for (struct sweepent* cur = opt.first; cur; cur = cur->next)
+				cur->listed = false;
+			a12helper_keystore_tags(sweep_listtag, &opt);
+
+			struct sweepent** cur = &opt.first;
+			while (*cur){
+				struct sweepent* ent = *cur;
+				if (ent->listed){
+					cur = &ent->next;
+					continue;
+				}
+				if (ent->known)
+					sweep_netstate(C, ent, false);
+				if (-1 != ent->fd)
+					close(ent->fd);
+				*cur = ent->next;
+				free(ent);
+			}
+
+			next_list = now + opt.pause;
+		}
+
+/* start probes that are due, bounded so a large keystore trickles out */
+		size_t n_pending = 0;
+		uint64_t wake = next_list;
+
+		for (struct sweepent* cur = opt.first; cur; cur = cur->next){
+			if (-1 == cur->fd && cur->next_probe <= now && n_pending < SWEEP_PARALLEL){
+				if (!sweep_connect(&opt, cur, now)){
+					sweep_result(&opt, cur, false, now);
+					continue;
+				}
+			}
+
+			if (-1 != cur->fd){
+				if (n_pending < SWEEP_PARALLEL){
+					pending[n_pending] = cur;
+					pfd[n_pending++] = (struct pollfd){.fd = cur->fd, .events = POLLOUT};
+				}
+				wake = cur->deadline < wake ? cur->deadline : wake;
+			}
+			else
+				wake = cur->next_probe < wake ? cur->next_probe : wake;
+		}
+
+		pfd[n_pending] = (struct pollfd){
+			.fd = C->epipe, .events = POLLIN | POLLERR | POLLHUP};
+
+		int timeout = wake > now ? wake - now : 0;
+		if (-1 == poll(pfd, n_pending + 1, timeout) && errno != EINTR && errno != EAGAIN)
+			break;
+
+		now = arcan_timemillis();
+		for (size_t i = 0; i < n_pending; i++){
+			struct sweepent* ent = pending[i];
+
+			if (pfd[i].revents){
+				int err = 0;
+				socklen_t len = sizeof(err);
+				if (-1 == getsockopt(ent->fd, SOL_SOCKET, SO_ERROR, &err, &len))
+					err = errno;
+				sweep_result(&opt, ent, err == 0 && !(pfd[i].revents & POLLNVAL), now);
+			}
+			else if (now >= ent->deadline)
+				sweep_result(&opt, ent, false, now);
+		}
+	}
+
+	while (opt.first){
+		struct sweepent* next = opt.first->next;
+		if (-1 != opt.first->fd)
+			close(opt.first->fd);
+		free(opt.first);
+		opt.first = next;
 	}
 
 	arcan_shmif_drop(C);
@@ -1081,6 +1238,7 @@ static int show_help()
 		"--------\t-----------\t-----------------\n"
 		" discover \t  method   \t Set discovery mode (method=sweep,test,passive,\n"
 		"          \t           \t                     broadcast or directory)\n"
+		" sweep    \t  seconds  \t (sweep) time between probes of a reachable host (=10)\n"
 	);
 
 	return EXIT_FAILURE;
@@ -1108,7 +1266,7 @@ int afsrv_netcl(struct arcan_shmif_cont* C, struct arg_arr* args)
 		int trustm = TRUST_KNOWN;
 
 		if (strcmp(dmethod, "sweep") == 0){
-			return discover_sweep(C, trustm);
+			return discover_sweep(C, args, trustm);
 		}
 		else if (strcmp(dmethod, "passive") == 0){
 			return discover_passive(C, args, trustm);
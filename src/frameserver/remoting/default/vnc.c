@@ -61,7 +61,11 @@ static rfbBool client_resize(struct _rfbClient* client)
 
 	vncctx.shmcont.hints = SHMIF_RHINT_SUBREGION | SHMIF_RHINT_IGNORE_ALPHA;
 
-	if (!arcan_shmif_resize(&vncctx.shmcont, neww, newh)){
+/* libvncclient decodes straight into the segment, so it has to stay single
+ * buffered for the alias to survive signalling and for the contents outside
+ * of the damaged regions to remain intact */
+	if (!arcan_shmif_resize_ext(&vncctx.shmcont, neww, newh,
+		(struct shmif_resize_ext){.vbuf_cnt = 1})){
 		LOG("client requested a resize outside "
 			"accepted dimensions (%d, %d)\n", neww, newh);
 		return false;
@@ -111,18 +115,9 @@ static rfbBool client_resize(struct _rfbClient* client)
 
 static void client_update(rfbClient* client, int x, int y, int w, int h)
 {
-	if (!vncctx.dirty || x < vncctx.shmcont.dirty.x1)
-		vncctx.shmcont.dirty.x1 = x;
-
-	if (!vncctx.dirty || y < vncctx.shmcont.dirty.y1)
-		vncctx.shmcont.dirty.y1 = y;
-
-	if (!vncctx.dirty || (x+w) > vncctx.shmcont.dirty.x2)
-		vncctx.shmcont.dirty.x2 = x + w;
-
-	if (!vncctx.dirty || (y+h) > vncctx.shmcont.dirty.y2)
-		vncctx.shmcont.dirty.y2 = y + h;
-
+/* each rectangle is kept as a separate region in the damage chain, the
+ * segment bounding box is only used if they exceed the chain */
+	arcan_shmif_dirty(&vncctx.shmcont, x, y, x + w, y + h, 0);
 	vncctx.dirty = true;
 }
 
@@ -277,9 +272,9 @@ bool process_shmif()
 	while (arcan_shmif_poll(&vncctx.shmcont, &inev) > 0){
 		if (inev.category == EVENT_TARGET)
 			switch(inev.tgt.kind){
+/* only ask for what changed, a full refresh is left for RESET */
 			case TARGET_COMMAND_STEPFRAME:
-				SendFramebufferUpdateRequest(vncctx.client, 0, 0,
-					vncctx.shmcont.addr->w, vncctx.shmcont.addr->h, FALSE);
+				SendIncrementalFramebufferUpdateRequest(vncctx.client);
 			break;
 
 			case TARGET_COMMAND_EXIT:
@@ -287,6 +282,8 @@ bool process_shmif()
 
 			case TARGET_COMMAND_RESET:
 				cl_unstick();
+				SendFramebufferUpdateRequest(vncctx.client, 0, 0,
+					vncctx.shmcont.w, vncctx.shmcont.h, FALSE);
 			break;
 
 			case TARGET_COMMAND_DISPLAYHINT:
@@ -345,21 +342,18 @@ int run_vnc(struct arcan_shmif_cont* con, struct arg_arr* args)
 		.ext.message = "(01) server connection broken"
 	};
 
-/* this is cheating a bit as we don't guarantee the color format used */
-	vncctx.client->frameBuffer = (uint8_t*) vncctx.shmcont.vidp;
+/* the framebuffer is already aliased to the segment by client_resize, the
+ * format is set to match the native shmif packing */
 	atexit( cleanup );
 
 	short poller = POLLHUP | POLLNVAL;
 	short pollev = POLLIN | poller;
 
 	while (true){
+/* signal resets the damage, the next update rectangles start over */
 		if (vncctx.dirty){
 			vncctx.dirty = false;
 			arcan_shmif_signal(&vncctx.shmcont, SHMIF_SIGVID);
-			vncctx.shmcont.dirty.x1 = 0;
-			vncctx.shmcont.dirty.y1 = 0;
-			vncctx.shmcont.dirty.x2 = vncctx.shmcont.w;
-			vncctx.shmcont.dirty.y2 = vncctx.shmcont.h;
 		}
 
 		struct pollfd fds[2] = {
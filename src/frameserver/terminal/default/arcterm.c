@@ -563,11 +563,14 @@ static void dump_help()
 		" keep_stderr \t           \t forward whatever [stderr] is into the child\n"
 		"             \t           \t and disable logging for afsrv_terminal\n"
 		" autofit     \t           \t (with exec, keep_alive) shrink window to fit\n"
+		" scrollback  \t lines     \t scrollback length (default: 1000)\n"
+		" scrollback_mb\t mb       \t scrollback memory cap (default: 64, 0 = off)\n"
 		" record      \t fname     \t record everything in main window in tpackani fmt\n"
 		" pipe        \t [mode]    \t map stdin-stdout (mode: raw, lf)\n"
 		" palette     \t name      \t use built-in palette (below)\n"
 		" cli         \t [lua]     \t switch to non-vt cli/builtin shell mode\n"
 		" cursor      \t [style]   \t set default cursor: block, bar, underline, hollow\n"
+		" fps         \t n         \t cap refresh rate (default: display rate, 0: off)\n"
 #ifdef SALLOW_ST
 		" interp      \t [tsm,st]  \t specify emulator state machine\n"
 #endif
@@ -578,7 +581,8 @@ static void dump_help()
 		"    key      \t   value   \t   description\n"
 		"-------------\t-----------\t-----------------\n"
 		" env         \t key=val   \t override default environment (repeatable)\n"
-		" mode        \t exec_mode \t arcan, wayland, x11, vt100 (default: vt100)\n"
+		" mode        \t exec_mode \t arcan, wayland, x11, vt100, job (default: vt100)\n"
+		" jobio       \t pty, pipe \t how job mode captures output (default: pty)\n"
 #ifndef FSRV_TERMINAL_NOEXEC
 		" oneshot     \t           \t use with exec, shut down after evaluating command\n"
 		"-------------\t-----------\t----------------\n"
@@ -1406,6 +1410,17 @@ int afsrv_terminal(struct arcan_shmif_cont* con, struct arg_arr* args)
 		term.fit_contents = true;
 	}
 
+/* scrollback lines are packed (and optionally compressed), so the length can
+ * be set generously and the memory cap decides what is actually kept */
+	size_t sb_mb = 64;
+	if (arg_lookup(args, "scrollback", 0, &val) && val){
+		tsm_screen_set_max_sb(term.screen->screen, strtoul(val, NULL, 10));
+	}
+	if (arg_lookup(args, "scrollback_mb", 0, &val) && val){
+		sb_mb = strtoul(val, NULL, 10);
+	}
+	tsm_screen_set_sb_budget(term.screen->screen, sb_mb * 1024 * 1024);
+
 /* if a command-line palette override is set, apply that - BUT if there was
  * custom color overrides defined during preroll (tui_setup) those take
  * precedence */
@@ -7,6 +7,7 @@
 #include <inttypes.h>
 #include "cli.h"
 #include "cli_builtin.h"
+#include "cli_job.h"
 
 static struct cli_state cli_state = {
 	.mode = LAUNCH_VT100,
@@ -173,6 +174,7 @@ static void setup_cmd_mode(
  * the argument that we just built */
 	switch (cmd->mode){
 	case LAUNCH_UNSET:
+	case LAUNCH_JOB:
 	break;
 	case LAUNCH_VT100:{
 		*bin = get_terminal_bin();
@@ -417,6 +419,9 @@ static void rebuild_prompt(struct tui_context* T, struct cli_state* S)
 	case LAUNCH_X11:
 		modestr = "(x11@) ";
 	break;
+	case LAUNCH_JOB:
+		modestr = "(job@) ";
+	break;
 	default:
 	break;
 	}
@@ -490,6 +495,15 @@ static void parse_eval(struct tui_context* T, char* out)
 	cmd->id = ++cli_state.id_counter;
 	cmd->wd = malloc(PATH_MAX);
 	getcwd(cmd->wd, PATH_MAX);
+
+/* inline jobs don't need a window, the output goes above the prompt */
+	if (cmd->mode == LAUNCH_JOB){
+		if (!cli_job_spawn(T, &cli_state, cmd->argv, cmd->env, cmd->wd))
+			arcan_tui_message(T, TUI_MESSAGE_FAILURE, "couldn't start job");
+		free_cmd(cmd);
+		return;
+	}
+
 	arcan_tui_request_subwnd(T, TUI_WND_HANDOVER, cmd->id);
 }
 
@@ -546,6 +560,16 @@ static struct labelent labels[] = {
 			.descr = "Switch launch mode to arcan",
 			.initial = TUIK_F4
 		}
+	},
+	{
+		.handler = label_modesw,
+		.idt = LAUNCH_JOB,
+		.ent =
+		{
+			.label = "MODE_JOB",
+			.descr = "Switch launch mode to inline jobs",
+			.initial = TUIK_F5
+		}
 	}
 };
 
@@ -575,6 +599,16 @@ static bool on_label_query(struct tui_context* T,
 	return false;
 }
 
+/* readline resets its region after this, so have the job area redrawn and
+ * the prompt moved back on the next pass */
+static void on_resized(struct tui_context* T,
+	size_t neww, size_t newh, size_t cols, size_t rows, void* tag)
+{
+	cli_state.jobs_dirty = true;
+	cli_state.jobs_drawn = 0;
+	cli_state.jobs_rows = 0;
+}
+
 int arcterm_cli_run(struct arcan_shmif_cont* c, struct arg_arr* args)
 {
 /* source arguments, prompt, ... from args or config file */
@@ -586,6 +620,7 @@ int arcterm_cli_run(struct arcan_shmif_cont* c, struct arg_arr* args)
 /* don't need much on top of the normal readline:
  * subwindow handler for dispatching new command basically */
 	struct tui_cbcfg cfg = {
+		.resized = on_resized,
 		.subwindow = on_subwindow,
 		.query_label = on_label_query,
 		.input_label = on_label_input,
@@ -607,8 +642,14 @@ int arcterm_cli_run(struct arcan_shmif_cont* c, struct arg_arr* args)
 		else if (strcmp(argt, "x11") == 0){
 			cli_state.mode = LAUNCH_X11;
 		}
+		else if (strcmp(argt, "job") == 0){
+			cli_state.mode = LAUNCH_JOB;
+		}
 	}
 
+	if (arg_lookup(args, "jobio", 0, &argt) && argt)
+		cli_state.job_pipe = strcmp(argt, "pipe") == 0;
+
 	if (arg_lookup(args, "bgalpha", 0, &argt) && argt)
 		cli_state.bgalpha = strtoul(argt, NULL, 10);
 
@@ -637,8 +678,16 @@ int arcterm_cli_run(struct arcan_shmif_cont* c, struct arg_arr* args)
 		int status;
 		rebuild_prompt(tui, &cli_state);
 		while (!(status = arcan_tui_readline_finished(tui, &out)) && cli_state.alive){
-			struct tui_process_res res = arcan_tui_process(&tui, 1, NULL, 0, -1);
-			if (res.errc == TUI_ERRC_OK){
+			int fds[CLI_JOB_LIMIT];
+			size_t n_fds = cli_job_fds(&cli_state, fds, CLI_JOB_LIMIT);
+
+/* job output only marks the area as dirty, drawing follows the refresh cap */
+			struct tui_process_res res = arcan_tui_process(
+				&tui, 1, fds, n_fds, cli_job_timeout(&cli_state));
+			cli_job_service(&cli_state);
+			cli_job_draw(tui, &cli_state, false);
+
+			if (res.errc == TUI_ERRC_OK || res.errc == TUI_ERRC_BAD_FD){
 				if (-1 == arcan_tui_refresh(tui) && errno == EINVAL)
 					cli_state.alive = false;
 			}
@@ -656,6 +705,7 @@ int arcterm_cli_run(struct arcan_shmif_cont* c, struct arg_arr* args)
 		}
 	}
 
+	cli_job_clear(&cli_state, true);
 	arcan_tui_destroy(tui, NULL);
 	return EXIT_SUCCESS;
 }
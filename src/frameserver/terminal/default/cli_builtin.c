@@ -4,6 +4,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include "cli_builtin.h"
+#include "cli_job.h"
 
 struct cmd_state {
 	char* cwd;
@@ -122,6 +123,9 @@ static struct ext_cmd* cmd_mode(
 	else if (strcmp(argv[1], "vt100") == 0){
 		state->mode = LAUNCH_VT100;
 	}
+	else if (strcmp(argv[1], "job") == 0){
+		state->mode = LAUNCH_JOB;
+	}
 
 	return NULL;
 }
@@ -193,6 +197,14 @@ static struct ext_cmd* cmd_open(
 	return res;
 }
 
+/* drop finished jobs, 'clear all' also hangs up on the running ones */
+static struct ext_cmd* cmd_clear(
+	struct cli_state* state, char** argv, ssize_t* ofs, char** err)
+{
+	cli_job_clear(state, argv[1] && strcmp(argv[1], "all") == 0);
+	return NULL;
+}
+
 static struct ext_cmd* cmd_exit(
 	struct cli_state* state, char** argv, ssize_t* ofs, char** err)
 {
@@ -229,6 +241,10 @@ struct cli_command commands[] = {
 		.name = "open",
 		.exec = cmd_open
 	},
+	{
+		.name = "clear",
+		.exec = cmd_clear
+	},
 	{
 		.name = "exit",
 		.exec = cmd_exit
@@ -7,7 +7,30 @@ enum launch_mode {
 	LAUNCH_TUI   = 2,
 	LAUNCH_WL    = 3,
 	LAUNCH_X11   = 4,
-	LAUNCH_SHMIF = 5
+	LAUNCH_SHMIF = 5,
+	LAUNCH_JOB   = 6
+};
+
+/* jobs run inline rather than through a handover, their output is kept in
+ * a bounded ring per job and drawn above the prompt */
+#define CLI_JOB_LIMIT 8
+#define CLI_JOB_RING (64 * 1024)
+
+struct cli_job {
+	uint32_t id;
+	pid_t pid;
+	int fd;
+	int status;
+	bool reaped;
+	char name[64];
+
+/* output with control sequences stripped, [esc] carries the filter state
+ * between reads */
+	uint8_t* ring;
+	size_t ring_pos;
+	size_t ring_used;
+	uint64_t total;
+	int esc;
 };
 
 struct ext_cmd {
@@ -38,6 +61,14 @@ struct cli_state {
 	char* in_debug;
 	struct tui_cell* prompt;
 	size_t prompt_sz;
+
+/* jobs use a pty unless job_pipe is set, drawing is limited to once every
+ * CLI_JOB_REFRESH ms no matter how much output arrives */
+	bool job_pipe;
+	struct cli_job jobs[CLI_JOB_LIMIT];
+	bool jobs_dirty;
+	long long jobs_drawn;
+	size_t jobs_rows;
 };
 
 struct cli_command {
@@ -0,0 +1,475 @@
+#include <arcan_shmif.h>
+#include <arcan_tui.h>
+#include <arcan_tui_readline.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include "cli_builtin.h"
+#include "cli_job.h"
+
+/* upper bound on bytes taken from one job per service pass, the rest stays in
+ * the descriptor until the next pass so that jobs progress side by side */
+#define JOB_READ_CHUNK 16384
+
+/* the descriptor can be gone before the child has exited */
+#define JOB_REAP_POLL 100
+
+enum esc_state {
+	ESC_NONE = 0,
+	ESC_START,
+	ESC_SKIP,
+	ESC_CSI,
+	ESC_OSC,
+	ESC_OSC_END
+};
+
+extern char** environ;
+
+static uint8_t ring_at(struct cli_job* J, size_t ofs)
+{
+	return J->ring[
+		(J->ring_pos + CLI_JOB_RING - J->ring_used + ofs) % CLI_JOB_RING];
+}
+
+/* there is no emulation here, so drop escape sequences and control characters
+ * on the way in, the oldest output is overwritten when the ring is full */
+static void ring_push(struct cli_job* J, const uint8_t* buf, size_t nb)
+{
+	for (size_t i = 0; i < nb; i++){
+		uint8_t ch = buf[i];
+
+		switch (J->esc){
+		case ESC_START:
+			if (ch == '[')
+				J->esc = ESC_CSI;
+			else if (ch == ']')
+				J->esc = ESC_OSC;
+			else if (ch == '(' || ch == ')' || ch == '#')
+				J->esc = ESC_SKIP;
+			else
+				J->esc = ESC_NONE;
+		continue;
+		case ESC_SKIP:
+			J->esc = ESC_NONE;
+		continue;
+		case ESC_CSI:
+			if (ch >= 0x40 && ch <= 0x7e)
+				J->esc = ESC_NONE;
+		continue;
+		case ESC_OSC:
+			if (ch == 0x07)
+				J->esc = ESC_NONE;
+			else if (ch == 0x1b)
+				J->esc = ESC_OSC_END;
+		continue;
+		case ESC_OSC_END:
+			J->esc = ESC_NONE;
+		continue;
+		default:
+		break;
+		}
+
+		if (ch == 0x1b){
+			J->esc = ESC_START;
+			continue;
+		}
+
+		if (ch == '\t')
+			ch = ' ';
+		else if (ch != '\n' && (ch < 0x20 || ch == 0x7f))
+			continue;
+
+		J->ring[J->ring_pos] = ch;
+		J->ring_pos = (J->ring_pos + 1) % CLI_JOB_RING;
+		if (J->ring_used < CLI_JOB_RING)
+			J->ring_used++;
+	}
+
+	J->total += nb;
+}
+
+static void job_release(struct cli_job* J)
+{
+	if (J->fd != -1)
+		close(J->fd);
+	free(J->ring);
+	*J = (struct cli_job){
+		.fd = -1
+	};
+}
+
+static void set_name(struct cli_job* J, char** argv)
+{
+	size_t ofs = 0;
+	J->name[0] = '\0';
+
+	for (size_t i = 0; argv[i] && ofs + 1 < sizeof(J->name); i++){
+		int nw = snprintf(&J->name[ofs],
+			sizeof(J->name) - ofs, "%s%s", i ? " " : "", argv[i]);
+		if (nw < 0)
+			break;
+		ofs += nw;
+	}
+}
+
+bool cli_job_spawn(struct tui_context* T,
+	struct cli_state* S, char** argv, char** env, const char* wd)
+{
+	if (!argv || !argv[0])
+		return false;
+
+/* prefer a free slot, otherwise recycle the oldest finished job */
+	struct cli_job* J = NULL;
+	for (size_t i = 0; i < CLI_JOB_LIMIT && !J; i++)
+		if (!S->jobs[i].id)
+			J = &S->jobs[i];
+
+	for (size_t i = 0; i < CLI_JOB_LIMIT && !J; i++)
+		if (S->jobs[i].reaped && (!J || S->jobs[i].id < J->id))
+			J = &S->jobs[i];
+
+	if (!J)
+		return false;
+
+	uint8_t* ring = malloc(CLI_JOB_RING);
+	if (!ring)
+		return false;
+
+	size_t rows, cols;
+	arcan_tui_dimensions(T, &rows, &cols);
+
+	int fd = -1, child = -1;
+	if (S->job_pipe){
+		int pair[2];
+		if (-1 == pipe(pair)){
+			free(ring);
+			return false;
+		}
+		fd = pair[0];
+		child = pair[1];
+	}
+	else {
+		fd = posix_openpt(O_RDWR | O_NOCTTY);
+		char* name;
+		if (-1 == fd || -1 == grantpt(fd) || -1 == unlockpt(fd) ||
+			!(name = ptsname(fd)) || -1 == (child = open(name, O_RDWR | O_NOCTTY))){
+			if (-1 != fd)
+				close(fd);
+			free(ring);
+			return false;
+		}
+
+		struct winsize ws = {
+			.ws_row = rows > 1 ? rows - 1 : 1,
+			.ws_col = cols
+		};
+		ioctl(child, TIOCSWINSZ, &ws);
+	}
+
+	pid_t pid = fork();
+	if (0 == pid){
+/* nothing is forwarded to the job, so it gets no input rather than blocking
+ * on a terminal that never answers */
+		setsid();
+		int null = open("/dev/null", O_RDONLY);
+		if (!S->job_pipe)
+			ioctl(child, TIOCSCTTY, 0);
+
+		dup2(null, STDIN_FILENO);
+		dup2(child, STDOUT_FILENO);
+		dup2(child, STDERR_FILENO);
+		close(fd);
+		if (child > STDERR_FILENO)
+			close(child);
+		if (null > STDERR_FILENO)
+			close(null);
+
+		for (size_t i = 1; i < NSIG; i++)
+			signal(i, SIG_DFL);
+
+		if (wd && -1 == chdir(wd))
+			_exit(EXIT_FAILURE);
+
+		if (env)
+			environ = env;
+
+		execvp(argv[0], argv);
+		_exit(EXIT_FAILURE);
+	}
+
+	close(child);
+	if (-1 == pid){
+		close(fd);
+		free(ring);
+		return false;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	job_release(J);
+	*J = (struct cli_job){
+		.id = ++S->id_counter,
+		.pid = pid,
+		.fd = fd,
+		.ring = ring
+	};
+	set_name(J, argv);
+
+	S->jobs_dirty = true;
+	return true;
+}
+
+size_t cli_job_fds(struct cli_state* S, int* fds, size_t lim)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < CLI_JOB_LIMIT && n < lim; i++)
+		if (S->jobs[i].id && S->jobs[i].fd != -1)
+			fds[n++] = S->jobs[i].fd;
+	return n;
+}
+
+void cli_job_service(struct cli_state* S)
+{
+	uint8_t buf[JOB_READ_CHUNK];
+
+	for (size_t i = 0; i < CLI_JOB_LIMIT; i++){
+		struct cli_job* J = &S->jobs[i];
+		if (!J->id)
+			continue;
+
+/* pty gives EIO rather than EOF when the other side is gone */
+		if (J->fd != -1){
+			ssize_t nr = read(J->fd, buf, sizeof(buf));
+			if (nr > 0){
+				ring_push(J, buf, nr);
+				S->jobs_dirty = true;
+			}
+			else if (nr == 0 || (errno != EAGAIN && errno != EINTR)){
+				close(J->fd);
+				J->fd = -1;
+				S->jobs_dirty = true;
+			}
+		}
+
+		if (J->fd == -1 && !J->reaped){
+			int st;
+			pid_t rv = waitpid(J->pid, &st, WNOHANG);
+			if (rv == J->pid){
+				J->status = WIFEXITED(st) ? WEXITSTATUS(st) : 128 + WTERMSIG(st);
+				J->reaped = true;
+				S->jobs_dirty = true;
+			}
+			else if (rv == -1 && errno != EINTR){
+				J->status = -1;
+				J->reaped = true;
+				S->jobs_dirty = true;
+			}
+		}
+	}
+}
+
+int cli_job_timeout(struct cli_state* S)
+{
+	int timeout = -1;
+	for (size_t i = 0; i < CLI_JOB_LIMIT; i++)
+		if (S->jobs[i].id && S->jobs[i].fd == -1 && !S->jobs[i].reaped)
+			timeout = JOB_REAP_POLL;
+
+	if (S->jobs_dirty){
+		long long left = CLI_JOB_REFRESH - (arcan_timemillis() - S->jobs_drawn);
+		if (left < 0)
+			left = 0;
+		if (timeout == -1 || left < timeout)
+			timeout = left;
+	}
+
+	return timeout;
+}
+
+static size_t glyph_count(struct cli_job* J, size_t start, size_t end)
+{
+	size_t n = 0;
+	for (size_t i = start; i < end; i++)
+		if ((ring_at(J, i) & 0xc0) != 0x80)
+			n++;
+	return n;
+}
+
+static void draw_job(struct tui_context* T,
+	struct cli_job* J, size_t y, size_t h, size_t cols, uint8_t* rowbuf)
+{
+	struct tui_screen_attr attr = arcan_tui_defattr(T, NULL);
+	struct tui_screen_attr hdr = {
+		.aflags = TUI_ATTR_COLOR_INDEXED | TUI_ATTR_INVERSE,
+		.fc[0] = TUI_COL_LABEL,
+		.bc[0] = TUI_COL_LABEL
+	};
+
+	char status[32];
+	if (J->reaped)
+		snprintf(status, sizeof(status), "exit %d", J->status);
+	else
+		snprintf(status, sizeof(status), "running");
+
+	char head[128];
+	int hlen = snprintf(head, sizeof(head),
+		"[%"PRIu32"] %s (%s, %"PRIu64" bytes)", J->id, J->name, status, J->total);
+	if (hlen < 0)
+		return;
+	if ((size_t) hlen >= sizeof(head))
+		hlen = sizeof(head) - 1;
+
+	arcan_tui_eraseattr_region(T, 0, y, cols - 1, y, false, hdr);
+	arcan_tui_move_to(T, 0, y);
+	arcan_tui_writeu8(T, (uint8_t*) head,
+		(size_t) hlen < cols ? (size_t) hlen : cols, &hdr);
+
+	size_t out = h - 1;
+	if (!out || !J->ring_used)
+		return;
+
+/* walk back from the end until there are enough rows, a linefeed at the
+ * very end closes the last line rather than starting an empty one */
+	size_t end = J->ring_used;
+	if (ring_at(J, end - 1) == '\n')
+		end--;
+
+	size_t start = end, skip = 0, need = out, pos = end;
+	for(;;){
+		size_t ls = pos;
+		while (ls > 0 && ring_at(J, ls - 1) != '\n')
+			ls--;
+
+		size_t w = glyph_count(J, ls, pos);
+		size_t vrows = w ? (w + cols - 1) / cols : 1;
+		start = ls;
+
+		if (vrows >= need){
+			skip = vrows - need;
+			break;
+		}
+
+		need -= vrows;
+		if (!ls)
+			break;
+		pos = ls - 1;
+	}
+
+/* rows only break on glyph starts so each row is whole UTF-8 */
+	size_t row = 0, col = 0, nb = 0;
+	for (size_t i = start; i <= end; i++){
+		uint8_t ch = i < end ? ring_at(J, i) : '\n';
+		bool glyph = (ch & 0xc0) != 0x80;
+
+		if (ch == '\n' || (glyph && col == cols)){
+			if (row >= skip && nb){
+				arcan_tui_move_to(T, 0, y + 1 + row - skip);
+				arcan_tui_writeu8(T, rowbuf, nb, &attr);
+			}
+			row++;
+			col = nb = 0;
+			if (row - skip >= out && row >= skip)
+				break;
+			if (ch == '\n')
+				continue;
+		}
+
+		if (glyph)
+			col++;
+		rowbuf[nb++] = ch;
+	}
+}
+
+bool cli_job_draw(struct tui_context* T, struct cli_state* S, bool force)
+{
+	if (!S->jobs_dirty)
+		return false;
+
+	long long now = arcan_timemillis();
+	if (!force && now - S->jobs_drawn < CLI_JOB_REFRESH)
+		return false;
+
+	S->jobs_dirty = false;
+	S->jobs_drawn = now;
+
+	size_t rows, cols;
+	arcan_tui_dimensions(T, &rows, &cols);
+	if (!cols)
+		return false;
+
+/* oldest first */
+	struct cli_job* vis[CLI_JOB_LIMIT];
+	size_t n = 0;
+	for (size_t i = 0; i < CLI_JOB_LIMIT; i++){
+		if (!S->jobs[i].id)
+			continue;
+
+		size_t j = n++;
+		for (; j > 0 && vis[j - 1]->id > S->jobs[i].id; j--)
+			vis[j] = vis[j - 1];
+		vis[j] = &S->jobs[i];
+	}
+
+/* the prompt goes to the last row as long as there are jobs to show */
+	size_t area = n && rows > 1 ? rows - 1 : 0;
+	if (area != S->jobs_rows){
+		arcan_tui_erase_screen(T, false);
+		if (area)
+			arcan_tui_readline_region(T, 0, rows - 1, cols - 1, rows - 1);
+		else
+			arcan_tui_readline_region(T, 0, 0, cols - 1, rows - 1);
+		S->jobs_rows = area;
+	}
+
+	if (area){
+		uint8_t* rowbuf = malloc(cols * 4 + 4);
+		if (!rowbuf)
+			return false;
+
+/* when the rows don't go around the newest jobs get them */
+		size_t first = 0;
+		while (n - first > 1 && area / (n - first) < 2)
+			first++;
+
+		size_t per = area / (n - first);
+		size_t y = 0;
+		arcan_tui_erase_region(T, 0, 0, cols - 1, area - 1, false);
+
+		for (size_t i = first; i < n; i++){
+			size_t h = i == n - 1 ? area - y : per;
+			draw_job(T, vis[i], y, h, cols, rowbuf);
+			y += h;
+		}
+		free(rowbuf);
+	}
+
+/* the prompt owns the cursor, setting it again redraws and puts it back */
+	if (S->prompt)
+		arcan_tui_readline_prompt(T, S->prompt);
+
+	return true;
+}
+
+void cli_job_clear(struct cli_state* S, bool all)
+{
+	for (size_t i = 0; i < CLI_JOB_LIMIT; i++){
+		struct cli_job* J = &S->jobs[i];
+		if (!J->id || (!J->reaped && !all))
+			continue;
+
+/* the job leads its own session, so take the whole group down */
+		if (!J->reaped){
+			kill(-J->pid, SIGHUP);
+			waitpid(J->pid, NULL, WNOHANG);
+		}
+
+		job_release(J);
+		S->jobs_dirty = true;
+	}
+}
@@ -0,0 +1,29 @@
+#ifndef HAVE_CLI_JOB
+#define HAVE_CLI_JOB
+
+#define CLI_JOB_REFRESH 40
+
+/* pick a free job slot and start argv in [wd] under a pty (or a pipe pair
+ * if state->job_pipe is set), the caller retains ownership of argv/env,
+ * returns false if all slots are taken by running jobs or the launch failed */
+bool cli_job_spawn(struct tui_context* T,
+	struct cli_state* state, char** argv, char** env, const char* wd);
+
+/* populate [fds] with the descriptors of running jobs, returns the count */
+size_t cli_job_fds(struct cli_state* state, int* fds, size_t lim);
+
+/* read whatever is available from every running job, bounded per job so one
+ * chatty job can't starve the others, and reap the ones that are done */
+void cli_job_service(struct cli_state* state);
+
+/* timeout to use for the next process call, -1 if nothing is pending */
+int cli_job_timeout(struct cli_state* state);
+
+/* draw the job area if the output changed and the refresh cap allows it,
+ * or immediately if [force] is set, returns true if anything was drawn */
+bool cli_job_draw(struct tui_context* T, struct cli_state* state, bool force);
+
+/* drop finished jobs, and with [all] also hang up on running ones */
+void cli_job_clear(struct cli_state* state, bool all);
+
+#endif
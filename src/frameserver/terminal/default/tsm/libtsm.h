@@ -267,6 +267,10 @@ int tsm_screen_resize(struct tsm_screen *con, unsigned int x,
 int tsm_screen_set_margins(struct tsm_screen *con,
 	  unsigned int top, unsigned int bottom);
 void tsm_screen_set_max_sb(struct tsm_screen *con, unsigned int max);
+
+/* cap the memory used by the scrollback, oldest lines are dropped to stay
+ * within [bytes] regardless of the max_sb line count, 0 disables the cap */
+void tsm_screen_set_sb_budget(struct tsm_screen *con, size_t bytes);
 void tsm_screen_clear_sb(struct tsm_screen *con);
 
 int tsm_screen_sb_up(struct tsm_screen *con, unsigned int num);
@@ -293,11 +297,21 @@ void tsm_screen_reset_all_tabstops(struct tsm_screen *con);
 
 void tsm_screen_write(struct tsm_screen *con, tsm_symbol_t ch,
 		const struct tui_screen_attr *attr);
+
+/* same as repeated tsm_screen_write with [n] printable ASCII characters,
+ * the parts that fit on the current line are written in one pass */
+void tsm_screen_write_ascii(struct tsm_screen *con, const char *u8, size_t n,
+		const struct tui_screen_attr *attr);
 void tsm_screen_setattr(struct tsm_screen *con,
 	const struct tui_screen_attr *attr, size_t x, size_t y);
 int tsm_screen_newline(struct tsm_screen *con);
 int tsm_screen_scroll_up(struct tsm_screen *con, unsigned int num);
 int tsm_screen_scroll_down(struct tsm_screen *con, unsigned int num);
+
+/* retrieve and reset the accumulated scroll of the visible rows ([step] > 0
+ * for up), false if there was none or it covered different margins */
+bool tsm_screen_scrolled(struct tsm_screen *con,
+	unsigned int *top, unsigned int *bottom, int *step);
 void tsm_screen_move_to(struct tsm_screen *con, unsigned int x,
 			unsigned int y);
 int tsm_screen_move_up(struct tsm_screen *con, unsigned int num,
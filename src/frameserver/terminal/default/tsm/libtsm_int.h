@@ -75,6 +75,9 @@ int tsm_utf8_mach_feed(struct tsm_utf8_mach *mach, char c);
 uint32_t tsm_utf8_mach_get(struct tsm_utf8_mach *mach);
 void tsm_utf8_mach_reset(struct tsm_utf8_mach *mach);
 
+/* true if the machine is in the middle of a multi-byte sequence */
+bool tsm_utf8_mach_pending(struct tsm_utf8_mach *mach);
+
 /* TSM screen
 
 void tsm_screen_set_opts(struct tsm_screen *scr, unsigned int opts);
@@ -178,6 +181,8 @@ struct cell {
 	tsm_age_t age;
 };
 
+struct sb_block;
+
 struct line {
 	struct line *next;
 	struct line *prev;
@@ -186,8 +191,15 @@ struct line {
 	struct cell *cells;
 	uint64_t sb_id;
 	tsm_age_t age;
+
+	/* scrollback lines are packed into a shared block, cells is NULL then */
+	struct sb_block *block;
+	size_t block_ofs;
 };
 
+/* recently unpacked compressed scrollback blocks */
+#define SB_HOT 4
+
 #define SELECTION_TOP -1
 struct selection_pos {
 	struct line *line;
@@ -219,6 +231,13 @@ struct tsm_screen {
 	tsm_age_t age;
 	int vanguard;
 
+	/* visible rows moved since the last tsm_screen_scrolled */
+	int scroll_step;
+	unsigned int scroll_top;
+	unsigned int scroll_bottom;
+	unsigned int scroll_set : 1;
+	unsigned int scroll_bad : 1;
+
 	/* scroll-back buffer */
 	unsigned int sb_count;		/* number of lines in sb */
 	struct line *sb_first;		/* first line; was moved first */
@@ -226,6 +245,14 @@ struct tsm_screen {
 	unsigned int sb_max;		/* max-limit of lines in sb */
 	struct line *sb_pos;		/* current position in sb or NULL */
 	uint64_t sb_last_id;		/* last id given to sb-line */
+	size_t sb_bytes;		/* memory held by sb lines and blocks */
+	size_t sb_budget;		/* cap on sb_bytes, 0 for none */
+	struct sb_block *sb_blocks;	/* oldest packed block */
+	struct sb_block *sb_tail;	/* block new lines are packed into */
+	struct sb_block *sb_hot[SB_HOT];
+	size_t sb_hot_pos;
+	struct line sb_view;		/* one sb line unpacked for draw/copy */
+	unsigned int sb_view_cap;
 
 	/* cursor */
 	unsigned int cursor_x;
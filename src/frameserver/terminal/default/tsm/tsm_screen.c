@@ -83,6 +83,11 @@
 typedef void* TTF_Font;
 #include "libtsm_int.h"
 
+#ifdef TSM_SB_ZSTD
+#include <zstd.h>
+#define SB_ZSTD_LEVEL 3
+#endif
+
 static void inc_age(struct tsm_screen *con)
 {
 	if (!++con->age_cnt) {
@@ -165,6 +170,8 @@ static int line_new(struct tsm_screen *con, struct line **out,
 	line->prev = NULL;
 	line->size = width;
 	line->age = con->age_cnt;
+	line->block = NULL;
+	line->block_ofs = 0;
 
 	line->cells = malloc(sizeof(struct cell) * width);
 	if (!line->cells) {
@@ -209,6 +216,386 @@ static int line_resize(struct tsm_screen *con, struct line *line,
 	return 0;
 }
 
+/*
+ * Scrollback lines are packed when linked in. The cells are run-length encoded
+ * on attribute into blocks shared by many lines and, with TSM_SB_ZSTD, a full
+ * block is compressed. Lines are unpacked into the single sb_view line when
+ * drawn or copied. Lines leave the scrollback from the top, so the oldest
+ * block is the one that gets emptied and freed.
+ *
+ * line: varint(size) run*
+ * run:  u8(kind) varint(count) attr(9) [count * varint]
+ *   SB_BLANK  - empty cells, no characters stored
+ *   SB_NARROW - ch, width 1
+ *   SB_CELLS  - ch << 2 | width, for wide characters and their padding
+ */
+#define SB_BLOCK_SIZE 65536
+
+enum sb_kind {
+	SB_BLANK = 0,
+	SB_NARROW = 1,
+	SB_CELLS = 2
+};
+
+struct sb_block {
+	struct sb_block *next;
+	uint8_t *raw;		/* packed lines, NULL while only compressed */
+	size_t used, cap;
+	uint8_t *z;		/* compressed copy of raw once sealed */
+	size_t z_sz;
+	size_t lines;		/* lines still packed into the block */
+	size_t bytes;		/* accounted in sb_bytes */
+};
+
+static struct line empty_line;
+
+static uint8_t *put_varint(uint8_t *dst, uint64_t v)
+{
+	do {
+		uint8_t b = v & 0x7f;
+		v >>= 7;
+		*dst++ = b | (v ? 0x80 : 0);
+	} while (v);
+	return dst;
+}
+
+static const uint8_t *get_varint(
+	const uint8_t *src, const uint8_t *end, uint64_t *v)
+{
+	*v = 0;
+	for (size_t shift = 0; src < end && shift < 64; shift += 7) {
+		uint8_t b = *src++;
+		*v |= (uint64_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return src;
+	}
+	return NULL;
+}
+
+static int cell_kind(const struct cell *c)
+{
+	if (c->width != 1)
+		return SB_CELLS;
+	return c->ch ? SB_NARROW : SB_BLANK;
+}
+
+/* worst case is a run per cell */
+static size_t sb_line_bound(const struct line *line)
+{
+	return 10 + (size_t) line->size * (1 + 10 + 9 + 10);
+}
+
+static size_t sb_line_bytes(const struct line *line)
+{
+	return sizeof(struct line) +
+		(line->cells ? line->size * sizeof(struct cell) : 0);
+}
+
+static void sb_account(struct tsm_screen *con, struct sb_block *blk, size_t bytes)
+{
+	con->sb_bytes = con->sb_bytes - blk->bytes + bytes;
+	blk->bytes = bytes;
+}
+
+static uint8_t *sb_encode(const struct line *line, uint8_t *dst)
+{
+	unsigned int i = 0;
+	dst = put_varint(dst, line->size);
+
+	while (i < line->size) {
+		const struct cell *first = &line->cells[i];
+		int kind = cell_kind(first);
+		unsigned int n = 1;
+
+		while (i + n < line->size &&
+			cell_kind(&line->cells[i + n]) == kind &&
+			tui_attr_equal(line->cells[i + n].attr, first->attr))
+			n++;
+
+		*dst++ = kind;
+		dst = put_varint(dst, n);
+		*dst++ = first->attr.fr;
+		*dst++ = first->attr.fg;
+		*dst++ = first->attr.fb;
+		*dst++ = first->attr.br;
+		*dst++ = first->attr.bg;
+		*dst++ = first->attr.bb;
+		*dst++ = first->attr.aflags & 0xff;
+		*dst++ = first->attr.aflags >> 8;
+		*dst++ = first->attr.custom_id;
+
+		for (unsigned int j = 0; j < n && kind != SB_BLANK; j++) {
+			const struct cell *c = &line->cells[i + j];
+			dst = put_varint(dst, kind == SB_NARROW ?
+				c->ch : ((uint64_t) c->ch << 2 | (c->width & 3)));
+		}
+
+		i += n;
+	}
+
+	return dst;
+}
+
+static bool sb_decode(const uint8_t *src, const uint8_t *end,
+	struct line *line, struct cell *out)
+{
+	uint64_t size, n, v;
+	if (!(src = get_varint(src, end, &size)) || size != line->size)
+		return false;
+
+	for (unsigned int i = 0; i < size; i += n) {
+		if (src >= end)
+			return false;
+
+		int kind = *src++;
+		if (!(src = get_varint(src, end, &n)) || n > size - i || end - src < 9)
+			return false;
+
+		struct tui_screen_attr attr = {
+			.fr = src[0], .fg = src[1], .fb = src[2],
+			.br = src[3], .bg = src[4], .bb = src[5],
+			.aflags = src[6] | (src[7] << 8),
+			.custom_id = src[8]
+		};
+		src += 9;
+
+		for (unsigned int j = 0; j < n; j++) {
+			struct cell *c = &out[i + j];
+			c->attr = attr;
+			c->age = line->age;
+			c->ch = 0;
+			c->width = 1;
+
+			if (kind == SB_BLANK)
+				continue;
+
+			if (!(src = get_varint(src, end, &v)))
+				return false;
+
+			if (kind == SB_NARROW)
+				c->ch = v;
+			else {
+				c->ch = v >> 2;
+				c->width = v & 3;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void sb_block_free(struct tsm_screen *con, struct sb_block *blk)
+{
+	struct sb_block **cur = &con->sb_blocks;
+	while (*cur && *cur != blk)
+		cur = &(*cur)->next;
+	if (*cur)
+		*cur = blk->next;
+
+	if (con->sb_tail == blk) {
+		con->sb_tail = NULL;
+		for (struct sb_block *it = con->sb_blocks; it; it = it->next)
+			con->sb_tail = it;
+	}
+
+	for (size_t i = 0; i < SB_HOT; i++)
+		if (con->sb_hot[i] == blk)
+			con->sb_hot[i] = NULL;
+
+	sb_account(con, blk, 0);
+	free(blk->raw);
+	free(blk->z);
+	free(blk);
+}
+
+/* the block is full, compress it or at least drop the slack */
+static void sb_seal(struct tsm_screen *con, struct sb_block *blk)
+{
+#ifdef TSM_SB_ZSTD
+	size_t bound = ZSTD_compressBound(blk->used);
+	uint8_t *z = malloc(bound);
+	if (z) {
+		size_t zs = ZSTD_compress(z, bound, blk->raw, blk->used, SB_ZSTD_LEVEL);
+		if (!ZSTD_isError(zs) && zs < blk->used) {
+			uint8_t *tmp = realloc(z, zs);
+			blk->z = tmp ? tmp : z;
+			blk->z_sz = zs;
+			free(blk->raw);
+			blk->raw = NULL;
+			sb_account(con, blk, sizeof(*blk) + zs);
+			return;
+		}
+		free(z);
+	}
+#endif
+
+	uint8_t *raw = realloc(blk->raw, blk->used ? blk->used : 1);
+	if (raw) {
+		blk->raw = raw;
+		blk->cap = blk->used;
+		sb_account(con, blk, sizeof(*blk) + blk->cap);
+	}
+}
+
+/* packed data of a block, unpacking a compressed one into the hot set */
+static const uint8_t *sb_block_data(struct tsm_screen *con, struct sb_block *blk)
+{
+	if (blk->raw)
+		return blk->raw;
+
+#ifdef TSM_SB_ZSTD
+	uint8_t *raw = malloc(blk->used);
+	if (!raw)
+		return NULL;
+
+	size_t rv = ZSTD_decompress(raw, blk->used, blk->z, blk->z_sz);
+	if (ZSTD_isError(rv) || rv != blk->used) {
+		free(raw);
+		return NULL;
+	}
+
+	struct sb_block *old = con->sb_hot[con->sb_hot_pos];
+	if (old && old->z && old->raw) {
+		free(old->raw);
+		old->raw = NULL;
+		sb_account(con, old, sizeof(*old) + old->z_sz);
+	}
+
+	con->sb_hot[con->sb_hot_pos] = blk;
+	con->sb_hot_pos = (con->sb_hot_pos + 1) % SB_HOT;
+
+	blk->raw = raw;
+	sb_account(con, blk, sizeof(*blk) + blk->z_sz + blk->used);
+	return raw;
+#else
+	return NULL;
+#endif
+}
+
+/* move the cells of a line going into the scrollback into the tail block,
+ * on allocation failure the line simply stays unpacked */
+static void sb_pack(struct tsm_screen *con, struct line *line)
+{
+	size_t bound = sb_line_bound(line);
+	struct sb_block *blk = con->sb_tail;
+
+	if (!blk || blk->cap - blk->used < bound) {
+		size_t cap = bound > SB_BLOCK_SIZE ? bound : SB_BLOCK_SIZE;
+		struct sb_block *nb = malloc(sizeof(*nb));
+		uint8_t *raw = malloc(cap);
+		if (!nb || !raw) {
+			free(nb);
+			free(raw);
+			return;
+		}
+		*nb = (struct sb_block){
+			.raw = raw,
+			.cap = cap
+		};
+		sb_account(con, nb, sizeof(*nb) + cap);
+
+		if (blk) {
+			sb_seal(con, blk);
+			blk->next = nb;
+		}
+		else
+			con->sb_blocks = nb;
+
+		con->sb_tail = blk = nb;
+	}
+
+	uint8_t *end = sb_encode(line, &blk->raw[blk->used]);
+	line->block = blk;
+	line->block_ofs = blk->used;
+	blk->used = end - blk->raw;
+	blk->lines++;
+
+	free(line->cells);
+	line->cells = NULL;
+}
+
+/* free a line that has been linked into the scrollback */
+static void sb_line_free(struct tsm_screen *con, struct line *line)
+{
+	struct sb_block *blk = line->block;
+
+	con->sb_bytes -= sb_line_bytes(line);
+	if (blk && !--blk->lines && blk != con->sb_tail)
+		sb_block_free(con, blk);
+
+	free(line->cells);
+	free(line);
+}
+
+/* get a line with cells, for packed scrollback lines this is only valid until
+ * the next call */
+static struct line *sb_line_view(struct tsm_screen *con, struct line *line)
+{
+	if (line->cells)
+		return line;
+
+	if (!line->block)
+		return &empty_line;
+
+	struct line *view = &con->sb_view;
+	if (con->sb_view_cap < line->size) {
+		struct cell *cells = realloc(view->cells, line->size * sizeof(struct cell));
+		if (!cells)
+			return &empty_line;
+		view->cells = cells;
+		con->sb_view_cap = line->size;
+	}
+
+	view->size = line->size;
+	view->age = line->age;
+	view->sb_id = line->sb_id;
+
+	struct sb_block *blk = line->block;
+	const uint8_t *data = sb_block_data(con, blk);
+	if (!data || !sb_decode(&data[line->block_ofs],
+		&data[blk->used], line, view->cells)) {
+		for (unsigned int i = 0; i < line->size; i++)
+			cell_init(con, &view->cells[i]);
+	}
+
+	return view;
+}
+
+/* drop the oldest scrollback line, a position on it moves to the next one */
+static void sb_pop_first(struct tsm_screen *con)
+{
+	struct line *line = con->sb_first;
+
+	con->sb_first = line->next;
+	if (line->next)
+		line->next->prev = NULL;
+	else
+		con->sb_last = NULL;
+	con->sb_count--;
+
+	if (con->sb_pos == line)
+		con->sb_pos = con->sb_first;
+
+	if (con->sel_active) {
+		if (con->sel_start.line == line) {
+			con->sel_start.line = NULL;
+			con->sel_start.y = SELECTION_TOP;
+		}
+		if (con->sel_end.line == line) {
+			con->sel_end.line = NULL;
+			con->sel_end.y = SELECTION_TOP;
+		}
+	}
+
+	sb_line_free(con, line);
+}
+
+static void sb_trim_budget(struct tsm_screen *con)
+{
+	while (con->sb_budget && con->sb_bytes > con->sb_budget && con->sb_count > 1)
+		sb_pop_first(con);
+}
+
 /* This links the given line into the scrollback-buffer */
 static void link_to_scrollback(struct tsm_screen *con, struct line *line)
 {
@@ -271,9 +658,12 @@ static void link_to_scrollback(struct tsm_screen *con, struct line *line)
 				con->sel_end.y = SELECTION_TOP;
 			}
 		}
-		line_free(tmp);
+		sb_line_free(con, tmp);
 	}
 
+	sb_pack(con, line);
+	con->sb_bytes += sb_line_bytes(line);
+
 	line->sb_id = ++con->sb_last_id;
 	line->next = NULL;
 	line->prev = con->sb_last;
@@ -283,6 +673,41 @@ static void link_to_scrollback(struct tsm_screen *con, struct line *line)
 		con->sb_first = line;
 	con->sb_last = line;
 	++con->sb_count;
+
+	sb_trim_budget(con);
+}
+
+/* only the visible rows matter, a scroll while the scrollback is shown does
+ * not move anything on screen */
+static void note_scroll(struct tsm_screen *con, int step)
+{
+	if (con->sb_pos || con->scroll_bad)
+		return;
+
+	if (!con->scroll_set) {
+		con->scroll_set = 1;
+		con->scroll_top = con->margin_top;
+		con->scroll_bottom = con->margin_bottom;
+		con->scroll_step = step;
+	} else if (con->scroll_top == con->margin_top &&
+		con->scroll_bottom == con->margin_bottom) {
+		con->scroll_step += step;
+	} else
+		con->scroll_bad = 1;
+}
+
+SHL_EXPORT
+bool tsm_screen_scrolled(struct tsm_screen *con,
+	unsigned int *top, unsigned int *bottom, int *step)
+{
+	bool res = con->scroll_set && !con->scroll_bad && con->scroll_step;
+	*top = con->scroll_top;
+	*bottom = con->scroll_bottom;
+	*step = con->scroll_step;
+
+	con->scroll_set = con->scroll_bad = 0;
+	con->scroll_step = 0;
+	return res;
 }
 
 static int screen_scroll_up(struct tsm_screen *con, unsigned int num)
@@ -338,6 +763,7 @@ static int screen_scroll_up(struct tsm_screen *con, unsigned int num)
 
 	memcpy(&con->lines[con->margin_top + (max - num)],
 	       cache, num * sizeof(struct line*));
+	note_scroll(con, num);
 
 	if (con->sel_active) {
 		if (!con->sel_start.line && con->sel_start.y >= 0) {
@@ -400,6 +826,7 @@ static int screen_scroll_down(struct tsm_screen *con, unsigned int num)
 
 	memcpy(&con->lines[con->margin_top],
 	       cache, num * sizeof(struct line*));
+	note_scroll(con, -(int) num);
 
 	if (con->sel_active) {
 		if (!con->sel_start.line && con->sel_start.y >= 0)
@@ -565,6 +992,7 @@ void tsm_screen_unref(struct tsm_screen *con)
 		return;
 
 	tsm_screen_clear_sb(con);
+	free(con->sb_view.cells);
 
 	for (i = 0; i < con->line_num; ++i) {
 		line_free(con->main_lines[i]);
@@ -870,42 +1298,31 @@ SHL_EXPORT
 void tsm_screen_set_max_sb(struct tsm_screen *con,
 			       unsigned int max)
 {
-	struct line *line;
-
 	if (!con)
 		return;
 
 	inc_age(con);
 	con->age = con->age_cnt;
 
-	while (con->sb_count > max) {
-		line = con->sb_first;
-		con->sb_first = line->next;
-		if (line->next)
-			line->next->prev = NULL;
-		else
-			con->sb_last = NULL;
-		con->sb_count--;
+	/* We treat fixed/unfixed position the same here because we
+	 * remove lines from the TOP of the scrollback buffer. */
+	while (con->sb_count > max)
+		sb_pop_first(con);
 
-		/* We treat fixed/unfixed position the same here because we
-		 * remove lines from the TOP of the scrollback buffer. */
-		if (con->sb_pos == line)
-			con->sb_pos = con->sb_first;
+	con->sb_max = max;
+}
 
-		if (con->sel_active) {
-			if (con->sel_start.line == line) {
-				con->sel_start.line = NULL;
-				con->sel_start.y = SELECTION_TOP;
-			}
-			if (con->sel_end.line == line) {
-				con->sel_end.line = NULL;
-				con->sel_end.y = SELECTION_TOP;
-			}
-		}
-		line_free(line);
-	}
+SHL_EXPORT
+void tsm_screen_set_sb_budget(struct tsm_screen *con, size_t bytes)
+{
+	if (!con)
+		return;
 
-	con->sb_max = max;
+	inc_age(con);
+	con->age = con->age_cnt;
+
+	con->sb_budget = bytes;
+	sb_trim_budget(con);
 }
 
 /* clear scrollback buffer */
@@ -923,9 +1340,12 @@ void tsm_screen_clear_sb(struct tsm_screen *con)
 	for (iter = con->sb_first; iter; ) {
 		tmp = iter;
 		iter = iter->next;
-		line_free(tmp);
+		sb_line_free(con, tmp);
 	}
 
+	while (con->sb_blocks)
+		sb_block_free(con, con->sb_blocks);
+
 	con->sb_first = NULL;
 	con->sb_last = NULL;
 	con->sb_count = 0;
@@ -1248,6 +1668,49 @@ void tsm_screen_write(struct tsm_screen *con, tsm_symbol_t ch,
 	return;
 }
 
+SHL_EXPORT
+void tsm_screen_write_ascii(struct tsm_screen *con, const char *u8, size_t n,
+			  const struct tui_screen_attr *attr)
+{
+	if (!con)
+		return;
+
+	if (!attr)
+		attr = &con->def_attr;
+
+	while (n) {
+/* wrapping, scrolling and insert mode take the normal path */
+		if (con->cursor_x >= con->size_x || con->cursor_y >= con->size_y ||
+			(con->flags & TSM_SCREEN_INSERT_MODE)) {
+			tsm_screen_write(con, (unsigned char) *u8, attr);
+			u8++;
+			n--;
+			continue;
+		}
+
+/* all of these have width 1, so the rest of the line can be filled as is */
+		size_t step = con->size_x - con->cursor_x;
+		if (step > n)
+			step = n;
+
+		inc_age(con);
+		struct cell *cells = &con->lines[con->cursor_y]->cells[con->cursor_x];
+		for (size_t i = 0; i < step; i++) {
+			cells[i].age = con->age_cnt;
+			cells[i].ch = (unsigned char) u8[i];
+			cells[i].width = 1;
+			memcpy(&cells[i].attr, attr, sizeof(*attr));
+		}
+
+		if (con->cursor_y > con->vanguard)
+			con->vanguard = con->cursor_y;
+
+		move_cursor(con, con->cursor_x + step, con->cursor_y);
+		u8 += step;
+		n -= step;
+	}
+}
+
 struct export_metadata {
 	uint8_t magic[4];
 	uint32_t sb_count;
@@ -1978,12 +2441,14 @@ void tsm_screen_selection_target(struct tsm_screen *con,
 	selection_set(con, &con->sel_end, posx, posy);
 }
 
-static unsigned int copy_line(struct line *line, char *buf,
-			      unsigned int start, unsigned int len, bool conv)
+static unsigned int copy_line(struct tsm_screen *con, struct line *line,
+			      char *buf, unsigned int start, unsigned int len, bool conv)
 {
 	unsigned int i, end;
 	char *pos = buf;
 
+	line = sb_line_view(con, line);
+
 	end = start + len;
 	for (i = start; i < line->size && i < end; ++i) {
 		if (i < line->size || !line->cells[i].ch){
@@ -2155,22 +2620,22 @@ int tsm_screen_selection_copy(struct tsm_screen *con, char **out, bool conv)
 					len = end->x - start->x + 1;
 				else
 					len = iter->size - start->x;
-				pos += copy_line(iter, pos, start->x, len, conv);
+				pos += copy_line(con, iter, pos, start->x, len, conv);
 			}
 			break;
 		} else if (iter == start->line) {
 			if (iter->size > start->x)
-				pos += copy_line(iter, pos, start->x,
+				pos += copy_line(con, iter, pos, start->x,
 						 iter->size - start->x, conv);
 		} else if (iter == end->line) {
 			if (iter->size > end->x)
 				len = end->x + 1;
 			else
 				len = iter->size;
-			pos += copy_line(iter, pos, 0, len, conv);
+			pos += copy_line(con, iter, pos, 0, len, conv);
 			break;
 		} else {
-			pos += copy_line(iter, pos, 0, iter->size, conv);
+			pos += copy_line(con, iter, pos, 0, iter->size, conv);
 		}
 
 		if (conv){
@@ -2197,22 +2662,22 @@ int tsm_screen_selection_copy(struct tsm_screen *con, char **out, bool conv)
 						len = end->x - start->x + 1;
 					else
 						len = con->size_x - start->x;
-					pos += copy_line(iter, pos, start->x, len, conv);
+					pos += copy_line(con, iter, pos, start->x, len, conv);
 				}
 				break;
 			} else if (!start->line && start->y == i) {
 				if (con->size_x > start->x)
-					pos += copy_line(iter, pos, start->x,
+					pos += copy_line(con, iter, pos, start->x,
 							 con->size_x - start->x, conv);
 			} else if (end->y == i) {
 				if (con->size_x > end->x)
 					len = end->x + 1;
 				else
 					len = con->size_x;
-				pos += copy_line(iter, pos, 0, len, conv);
+				pos += copy_line(con, iter, pos, 0, len, conv);
 				break;
 			} else {
-				pos += copy_line(iter, pos, 0, con->size_x, conv);
+				pos += copy_line(con, iter, pos, 0, con->size_x, conv);
 			}
 
 			if (conv){
@@ -2296,9 +2761,10 @@ tsm_age_t tsm_screen_draw(struct tsm_screen *con, tsm_screen_draw_cb draw_cb,
 			was_sel = false;
 		}
 
+		struct line *cl = sb_line_view(con, line);
 		for (j = 0; j < con->size_x; ++j) {
-			if (j < line->size)
-				cell = &line->cells[j];
+			if (j < cl->size)
+				cell = &cl->cells[j];
 			else
 				cell = &empty;
 			memcpy(&attr, &cell->attr, sizeof(attr));
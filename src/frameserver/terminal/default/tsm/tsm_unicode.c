@@ -584,3 +584,8 @@ void tsm_utf8_mach_reset(struct tsm_utf8_mach *mach)
 
 	mach->state = TSM_UTF8_START;
 }
+
+bool tsm_utf8_mach_pending(struct tsm_utf8_mach *mach)
+{
+	return mach && mach->state >= TSM_UTF8_EXPECT1;
+}
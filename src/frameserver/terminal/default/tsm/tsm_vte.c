@@ -56,6 +56,17 @@
 #include "libtsm.h"
 #include "libtsm_int.h"
 
+/* vector version of the printable run scan */
+#ifndef TSM_NO_SIMD
+#if defined(__x86_64__) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TSM_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TSM_SIMD_NEON
+#endif
+#endif
+
 /* Input parser states */
 enum parser_state {
 	STATE_NONE,		/* placeholder */
@@ -2105,6 +2116,64 @@ static uint32_t vte_map(struct tsm_vte *vte, uint32_t val)
 	return val;
 }
 
+/* number of leading bytes in the range 0x20 to 0x7e, anything else is a
+ * control, DEL or part of a multi-byte sequence */
+static size_t printable_run(const char *u8, size_t len)
+{
+	size_t i = 0;
+
+#if defined(TSM_SIMD_SSE2)
+/* signed compare, so bytes >= 0x80 fail the lower bound */
+	const __m128i lo = _mm_set1_epi8(0x1f);
+	const __m128i hi = _mm_set1_epi8(0x7f);
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) &u8[i]);
+		__m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+		unsigned mask = _mm_movemask_epi8(ok);
+		if (mask != 0xffff)
+			return i + __builtin_ctz(~mask);
+	}
+#elif defined(TSM_SIMD_NEON)
+/* no movemask, leave the position within the block to the scalar loop */
+	const uint8x16_t lo = vdupq_n_u8(0x1f);
+	const uint8x16_t hi = vdupq_n_u8(0x7f);
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8((const uint8_t *) &u8[i]);
+		uint64x2_t ok = vreinterpretq_u64_u8(
+			vandq_u8(vcgtq_u8(v, lo), vcltq_u8(v, hi)));
+		if ((vgetq_lane_u64(ok, 0) & vgetq_lane_u64(ok, 1)) != ~(uint64_t) 0)
+			break;
+	}
+#endif
+
+	while (i < len && (unsigned char) u8[i] > 0x1f && (unsigned char) u8[i] < 0x7f)
+		i++;
+
+	return i;
+}
+
+/*
+ * In the ground state with no charset mapping active, printable ASCII would
+ * go through ACTION_PRINT as itself, one screen write each. Find such a run
+ * and write it as a span instead. Returns the number of bytes consumed.
+ */
+static size_t print_run(struct tsm_vte *vte, const char *u8, size_t len)
+{
+	if (vte->state != STATE_GROUND || vte->glt ||
+		*vte->gl != &tsm_vte_unicode_lower)
+		return 0;
+
+	size_t n = printable_run(u8, len);
+	if (!n)
+		return 0;
+
+	vte->last_symbol = tsm_symbol_make((unsigned char) u8[n - 1]);
+	to_rgb(vte, false);
+	tsm_screen_write_ascii(vte->con->screen, u8, n, &vte->cattr);
+
+	return n;
+}
+
 /* perform parser action */
 static void do_action(struct tsm_vte *vte, uint32_t data, int action)
 {
@@ -2565,6 +2634,14 @@ void tsm_vte_input(struct tsm_vte *vte, const char *u8, size_t len)
 
 	++vte->parse_cnt;
 	for (i = 0; i < len; ++i) {
+		if (!tsm_utf8_mach_pending(vte->mach)) {
+			size_t n = print_run(vte, &u8[i], len - i);
+			if (n) {
+				i += n - 1;
+				continue;
+			}
+		}
+
 		if (vte->flags & FLAG_7BIT_MODE) {
 			if (u8[i] & 0x80)
 				DEBUG_LOG(vte, "receiving 8bit character U+%d from pty while in 7bit mode",
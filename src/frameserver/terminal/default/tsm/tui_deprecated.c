@@ -237,7 +237,9 @@ void arcan_tui_scroll_up(struct tui_context* c, size_t n)
 	if (!c || !c->screen || (tsm_screen_get_flags(c->screen) & TUI_ALTERNATE))
 		return;
 
-	c->sbofs -= tsm_screen_sb_up(c->screen, n);
+	int step = tsm_screen_sb_up(c->screen, n);
+	c->sbofs -= step;
+	tui_screen_scroll(c, 0, c->rows - 1, step);
 	arcan_tui_content_size(c,
 		c->screen->sb_count - c->sbofs, c->screen->sb_count + c->rows, 0, 0);
 
@@ -249,8 +251,10 @@ void arcan_tui_scroll_down(struct tui_context* c, size_t n)
 	if (!c || !c->screen || (tsm_screen_get_flags(c->screen) & TUI_ALTERNATE))
 		return;
 
-	c->sbofs -= tsm_screen_sb_down(c->screen, n);
+	int step = tsm_screen_sb_down(c->screen, n);
+	c->sbofs -= step;
 	c->sbofs = c->sbofs < 0 ? 0 : c->sbofs;
+	tui_screen_scroll(c, 0, c->rows - 1, step);
 
 	flag_cursor(c);
 }
@@ -913,7 +917,7 @@ static int tsm_draw_callback(struct tsm_screen* screen, uint32_t id,
 		tui->front[pos].draw_ch = tui->front[pos].ch = *ch;
 		tui->front[pos].attr = *attr;
 		tui->front[pos].fstamp = tui->fstamp;
-		tui->dirty |= DIRTY_PARTIAL;
+		tui_dirty_rows(tui, y, y);
 	}
 
 	return 0;
@@ -928,6 +932,12 @@ static void tsm_refresh_eh(struct tui_context* tui)
 /* this will repeatedly call tsm_draw_callback which, in turn, will update
  * the front buffer with new glyphs. */
 	tui->age = tsm_screen_draw(tui->screen, tsm_draw_callback, tui);
+
+/* let the tpack stage send the line moves as a scroll */
+	unsigned int top, bottom;
+	int step;
+	if (tsm_screen_scrolled(tui->screen, &top, &bottom, &step))
+		tui_screen_scroll(tui, top, bottom, step);
 }
 
 static void tsm_resize_eh(struct tui_context* tui)
@@ -9,6 +9,7 @@
 #include <sys/wait.h>
 #include <stdarg.h>
 #include <ctype.h>
+#include <time.h>
 
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -144,6 +145,11 @@ static struct anet_cl_connection connect_to(struct anet_options* arg)
 		return res;
 	}
 
+/* remember where we went in case the session needs to be resumed */
+	res.peer_len = sizeof(res.peer);
+	if (-1 == getpeername(res.fd, (struct sockaddr*) &res.peer, &res.peer_len))
+		res.peer_len = 0;
+
 /* at this stage we have a valid connection, time to build the state machine */
 	res.state = a12_client(arg->opts);
 	if (anet_authenticate(res.state, res.fd, res.fd, &res.errmsg))
@@ -161,6 +167,59 @@ static struct anet_cl_connection connect_to(struct anet_options* arg)
 	return res;
 }
 
+bool anet_cl_resume(struct anet_cl_connection* con,
+	struct a12_ticket* ticket, ssize_t retry_count, char** err)
+{
+	*err = NULL;
+	if (!con->state || !con->peer_len){
+		*err = strdup("no session to resume\n");
+		return false;
+	}
+
+/* same pattern as connect_to, just without the resolving */
+	int fd = -1;
+	for(;;){
+		fd = socket(con->peer.ss_family, SOCK_STREAM, 0);
+		if (-1 != fd){
+			if (-1 != connect(fd, (struct sockaddr*) &con->peer, con->peer_len))
+				break;
+			close(fd);
+			fd = -1;
+		}
+
+		if (retry_count == 0 || (uint64_t) time(NULL) >= ticket->expires)
+			break;
+		retry_count--;
+		sleep(1);
+	}
+
+	if (-1 == fd){
+		*err = strdup("couldn't reconnect\n");
+		return false;
+	}
+
+	int optval = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+
+	if (!a12_resume(con->state, ticket)){
+		*err = strdup("session ticket expired\n");
+		close(fd);
+		return false;
+	}
+
+	if (!anet_authenticate(con->state, fd, fd, err)){
+		shutdown(fd, SHUT_RDWR);
+		close(fd);
+		return false;
+	}
+
+	if (-1 != con->fd)
+		close(con->fd);
+	con->fd = fd;
+
+	return true;
+}
+
 struct anet_cl_connection anet_cl_setup(struct anet_options* arg)
 {
 	struct anet_cl_connection res = {
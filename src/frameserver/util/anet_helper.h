@@ -1,13 +1,19 @@
 #ifndef HAVE_ARCAN_NET_HELPER
 #define HAVE_ARCAN_NET_HELPER
 
+#include <sys/socket.h>
+
 /*
  * keystore provider types and constraints
  */
 enum a12helper_providers {
 /* naive single-file per key approach, does not handle concurrent write access
  * outside basic posix file locking semantics */
-	A12HELPER_PROVIDER_BASEDIR = 0
+	A12HELPER_PROVIDER_BASEDIR = 0,
+
+/* same basedir layout, but accepted keys are appended to a single log that is
+ * indexed in memory, for stores with many accepted keys */
+	A12HELPER_PROVIDER_INDEXED = 1
 };
 
 struct keystore_provider {
@@ -89,10 +95,26 @@ struct anet_cl_connection {
 	struct a12_state* state;
 	char* errmsg;
 	bool auth_failed;
+
+/* where [fd] went, for anet_cl_resume */
+	struct sockaddr_storage peer;
+	socklen_t peer_len;
 };
 
 struct anet_cl_connection anet_cl_setup(struct anet_options* opts);
 
+/*
+ * [blocking]
+ * reconnect to the same address as [con] after the connection was lost and
+ * resume the session with [ticket] (see a12_resume). Connecting is retried
+ * according to [retry_count] like with anet_options.
+ *
+ * On success the old descriptor is closed and replaced in [con]. On failure
+ * [con] is left as is, with any error message dynamically allocated in *err.
+ */
+bool anet_cl_resume(struct anet_cl_connection* con,
+	struct a12_ticket* ticket, ssize_t retry_count, char** err);
+
 /* setup the keystore using the specified provider,
  *
  * returns false if the provider is missing/broken or there already is a
@@ -3,6 +3,21 @@
  *  2. creating new key to private
  *  3. loading key from private
  *  4. accepting key into store
+ *
+ * accepted keys are kept in a list (for the beacon / challenge scan) and an
+ * index on the public key (for authentication). The basedir provider stores
+ * one file per key in accepted/, the indexed provider appends records to one
+ * accepted.log instead:
+ *
+ *   connp base64key statename<lf>
+ *
+ * where statename ties the key to its state/ directory like the filename does
+ * for the basedir provider. Records are appended under an flock and other
+ * processes pick them up the next time a lookup misses. The log is compacted
+ * on open if enough records are duplicated or broken. Files in accepted/ that
+ * are missing from the log are imported so that dropping in a key (or moving
+ * from basedir to indexed) keeps working. The basedir provider also reads the
+ * log if there is one, but never writes to it.
  */
 
 #include <arcan_shmif.h>
@@ -19,6 +34,7 @@
 
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <netdb.h>
 
 #include "a12.h"
@@ -42,23 +58,44 @@ struct key_ent {
 	uint8_t pub_chg[32];
 
 	struct key_ent* next;
+
+/* bucket chains in the key and state-name indices */
+	struct key_ent* next_key;
+	struct key_ent* next_fn;
 };
 
 static struct {
 	struct key_ent* hosts;
+	struct key_ent** hosts_tail;
+
+	struct key_ent** by_key;
+	struct key_ent** by_fn;
+	size_t n_buckets;
+	size_t n_keys;
 
 	int dirfd_private;
 	int dirfd_accepted;
 	int dirfd_state;
 
+/* accepted.log, parsed up to log_ofs */
+	int fd_log;
+	off_t log_ofs;
+	size_t log_live;
+	size_t log_dead;
+
 	bool open;
 	struct keystore_provider provider;
 } keystore = {
+	.hosts_tail = &keystore.hosts,
 	.dirfd_private = -1,
 	.dirfd_accepted = -1,
-	.dirfd_state = -1
+	.dirfd_state = -1,
+	.fd_log = -1
 };
 
+#define KEYSTORE_LOG "accepted.log"
+#define KEYSTORE_LOG_TMP "accepted.log.new"
+
 static uint8_t b64dec_lut[256] = {
 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 62, 0, 0, 0,
@@ -203,21 +240,363 @@ static bool decode_hostline(char* buf,
 	return a12helper_fromb64((uint8_t*) cur, 32, key);
 }
 
+static size_t key_bucket(const uint8_t key[static 32])
+{
+/* public keys are uniformly distributed so any 8 bytes is a fine hash */
+	uint64_t val;
+	memcpy(&val, key, sizeof(val));
+	return val & (keystore.n_buckets - 1);
+}
+
+static size_t fn_bucket(const char* fn)
+{
+	uint64_t h = 5381;
+	for (; *fn; fn++)
+		h = ((h << 5) + h) + (uint8_t) *fn;
+	return h & (keystore.n_buckets - 1);
+}
+
+static void index_insert(struct key_ent* ent)
+{
+	size_t ind = key_bucket(ent->key);
+	ent->next_key = keystore.by_key[ind];
+	keystore.by_key[ind] = ent;
+
+	if (ent->fn){
+		ind = fn_bucket(ent->fn);
+		ent->next_fn = keystore.by_fn[ind];
+		keystore.by_fn[ind] = ent;
+	}
+}
+
+static bool index_resize(size_t n_buckets)
+{
+	struct key_ent** by_key = calloc(n_buckets, sizeof(struct key_ent*));
+	struct key_ent** by_fn = calloc(n_buckets, sizeof(struct key_ent*));
+	if (!by_key || !by_fn){
+		free(by_key);
+		free(by_fn);
+		return false;
+	}
+
+	free(keystore.by_key);
+	free(keystore.by_fn);
+	keystore.by_key = by_key;
+	keystore.by_fn = by_fn;
+	keystore.n_buckets = n_buckets;
+
+	for (struct key_ent* cur = keystore.hosts; cur; cur = cur->next)
+		index_insert(cur);
+
+	return true;
+}
+
+static struct key_ent* find_fn(const char* fn)
+{
+	if (!keystore.n_buckets)
+		return NULL;
+
+	struct key_ent* cur = keystore.by_fn[fn_bucket(fn)];
+	while (cur && strcmp(cur->fn, fn) != 0)
+		cur = cur->next_fn;
+
+	return cur;
+}
+
+/* first entry for the key, continue along ->next_key for any others */
+static struct key_ent* find_key(const uint8_t key[static 32])
+{
+	if (!keystore.n_buckets)
+		return NULL;
+
+	struct key_ent* cur = keystore.by_key[key_bucket(key)];
+	while (cur && memcmp(cur->key, key, 32) != 0)
+		cur = cur->next_key;
+
+	return cur;
+}
+
+static struct key_ent* append_key(
+	const uint8_t key[static 32], const char* host, const char* fn)
+{
+	struct key_ent* ent = alloc_key_ent(key);
+	if (!ent)
+		return NULL;
+
+	ent->host = strdup(host);
+	ent->fn = fn ? strdup(fn) : NULL;
+	if (!ent->host || (fn && !ent->fn)){
+		free(ent->host);
+		free(ent->fn);
+		free(ent);
+		return NULL;
+	}
+
+	*keystore.hosts_tail = ent;
+	keystore.hosts_tail = &ent->next;
+	keystore.n_keys++;
+
+/* keep the load factor below 3/4, resizing re-inserts the new entry as well */
+	if (keystore.n_keys * 4 > keystore.n_buckets * 3){
+		if (index_resize(keystore.n_buckets ? keystore.n_buckets * 2 : 256))
+			return ent;
+
+		if (!keystore.n_buckets){
+			keystore.hosts_tail = &keystore.hosts;
+			keystore.hosts = NULL;
+			keystore.n_keys = 0;
+			free(ent->host);
+			free(ent->fn);
+			free(ent);
+			return NULL;
+		}
+	}
+
+	index_insert(ent);
+	return ent;
+}
+
 static void flush_accepted_keys()
 {
 	struct key_ent* cur = keystore.hosts;
 	while (cur){
 		struct key_ent* prev = cur;
 		cur = cur->next;
+		free(prev->host);
+		free(prev->fn);
 		memset(prev, '\0', sizeof(struct key_ent));
 		free(prev);
 	}
 	keystore.hosts = NULL;
+	keystore.hosts_tail = &keystore.hosts;
+
+	free(keystore.by_key);
+	free(keystore.by_fn);
+	keystore.by_key = NULL;
+	keystore.by_fn = NULL;
+	keystore.n_buckets = 0;
+	keystore.n_keys = 0;
+}
+
+static bool log_open()
+{
+	bool indexed = keystore.provider.type == A12HELPER_PROVIDER_INDEXED;
+
+	if (-1 != keystore.fd_log)
+		close(keystore.fd_log);
+
+	keystore.fd_log = openat(keystore.provider.directory.dirfd, KEYSTORE_LOG,
+		indexed ? O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC,
+		S_IRUSR | S_IWUSR);
+	keystore.log_ofs = 0;
+
+	return -1 != keystore.fd_log;
+}
+
+/* has the log been replaced (compacted) by someone else? */
+static bool log_stale()
+{
+	struct stat cur, path;
+	if (-1 == fstat(keystore.fd_log, &cur) ||
+		-1 == fstatat(keystore.provider.directory.dirfd, KEYSTORE_LOG, &path, 0))
+		return true;
+
+	return cur.st_ino != path.st_ino || cur.st_dev != path.st_dev;
+}
+
+static bool parse_logline(const char* line, size_t len)
+{
+	char buf[512];
+	if (!len || len >= sizeof(buf))
+		return false;
+
+	memcpy(buf, line, len);
+	buf[len] = '\0';
+
+	char* save;
+	char* connp = strtok_r(buf, " \t", &save);
+	char* b64 = strtok_r(NULL, " \t", &save);
+	char* fn = strtok_r(NULL, " \t\r", &save);
+
+	if (!connp || !b64 || !fn || strchr(fn, '/') || fn[0] == '.')
+		return false;
+
+	uint8_t key[32];
+	if (!a12helper_fromb64((uint8_t*) b64, 32, key))
+		return false;
+
+/* the same record appended twice, e.g. an import that raced */
+	if (find_fn(fn))
+		return false;
+
+	return append_key(key, connp, fn) != NULL;
+}
+
+/* parse whatever has been appended since last time, only complete lines */
+static bool log_parse_tail()
+{
+	struct stat st;
+	if (-1 == fstat(keystore.fd_log, &st) || st.st_size <= keystore.log_ofs)
+		return false;
+
+	off_t base = keystore.log_ofs & ~((off_t) sysconf(_SC_PAGESIZE) - 1);
+	size_t map_sz = st.st_size - base;
+	char* map = mmap(NULL, map_sz, PROT_READ, MAP_PRIVATE, keystore.fd_log, base);
+	if (MAP_FAILED == map)
+		return false;
+
+	const char* cur = &map[keystore.log_ofs - base];
+	const char* end = &map[map_sz];
+	size_t live = keystore.log_live;
+
+	while (cur < end){
+		const char* nl = memchr(cur, '\n', end - cur);
+		if (!nl)
+			break;
+
+		if (parse_logline(cur, nl - cur))
+			keystore.log_live++;
+		else
+			keystore.log_dead++;
+
+		cur = nl + 1;
+	}
+
+	keystore.log_ofs = base + (cur - map);
+	munmap(map, map_sz);
+	return keystore.log_live != live;
+}
+
+/* returns true if there were new records */
+static bool log_sync()
+{
+	if (-1 == keystore.fd_log || log_stale()){
+		if (!log_open())
+			return false;
+	}
+
+	return log_parse_tail();
+}
+
+static bool log_append(const uint8_t key[static 32], const char* connp, const char* fn)
+{
+	size_t outl;
+	uint8_t* b64 = a12helper_tob64(key, 32, &outl);
+	if (!b64)
+		return false;
+
+	char buf[512];
+	int len = snprintf(buf, sizeof(buf), "%s %s %s\n", connp, (char*) b64, fn);
+	free(b64);
+
+	if (len < 0 || len >= sizeof(buf))
+		return false;
+
+/* retry if the log got compacted between opening and getting the lock */
+	for (size_t i = 0; i < 4; i++){
+		if (-1 == keystore.fd_log && !log_open())
+			return false;
+
+		if (-1 == flock(keystore.fd_log, LOCK_EX))
+			return false;
+
+		if (log_stale()){
+			flock(keystore.fd_log, LOCK_UN);
+			if (!log_open())
+				return false;
+			continue;
+		}
+
+		off_t base_pos = lseek(keystore.fd_log, 0, SEEK_END);
+		ssize_t nw;
+		while ((nw = write(keystore.fd_log, buf, len)) == -1 &&
+			(errno == EINTR || errno == EAGAIN)){}
+
+/* don't leave a partial record for the next append to run into */
+		if (nw != len && -1 != base_pos)
+			ftruncate(keystore.fd_log, base_pos);
+
+		flock(keystore.fd_log, LOCK_UN);
+		return nw == len;
+	}
+
+	return false;
+}
+
+/*
+ * rewrite the log with only the live records, keys that were only kept in
+ * memory (log_append failed) are included as well
+ */
+static void log_compact()
+{
+	if (keystore.provider.type != A12HELPER_PROVIDER_INDEXED ||
+		-1 == keystore.fd_log || !keystore.log_dead ||
+		keystore.log_dead < keystore.log_live / 4 + 16)
+		return;
+
+	if (-1 == flock(keystore.fd_log, LOCK_EX))
+		return;
+
+/* someone else got here first */
+	if (log_stale()){
+		flock(keystore.fd_log, LOCK_UN);
+		return;
+	}
+
+/* and anything appended since we parsed would be lost otherwise */
+	log_parse_tail();
+
+	int dirfd = keystore.provider.directory.dirfd;
+	int fd = openat(dirfd, KEYSTORE_LOG_TMP,
+		O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	FILE* fout = -1 != fd ? fdopen(fd, "w") : NULL;
+	if (!fout){
+		if (-1 != fd)
+			close(fd);
+		flock(keystore.fd_log, LOCK_UN);
+		return;
+	}
+
+	bool ok = true;
+	size_t live = 0;
+	for (struct key_ent* cur = keystore.hosts; cur && ok; cur = cur->next){
+		if (!cur->fn)
+			continue;
+
+		size_t outl;
+		uint8_t* b64 = a12helper_tob64(cur->key, 32, &outl);
+		ok = b64 && fprintf(fout, "%s %s %s\n", cur->host, (char*) b64, cur->fn) > 0;
+		free(b64);
+		live++;
+	}
+
+	ok = ok && 0 == fflush(fout) && 0 == fsync(fd);
+	off_t ofs = ftello(fout);
+	fclose(fout);
+
+	if (!ok || -1 == renameat(dirfd, KEYSTORE_LOG_TMP, dirfd, KEYSTORE_LOG)){
+		fprintf(stderr, "keystore_naive(): couldn't compact %s\n", KEYSTORE_LOG);
+		unlinkat(dirfd, KEYSTORE_LOG_TMP, 0);
+		flock(keystore.fd_log, LOCK_UN);
+		return;
+	}
+
+/* closing the old log releases the lock */
+	if (log_open()){
+		keystore.log_ofs = ofs;
+		keystore.log_live = live;
+		keystore.log_dead = 0;
+	}
 }
 
 static void load_accepted_keys()
 {
+	bool indexed = keystore.provider.type == A12HELPER_PROVIDER_INDEXED;
+	bool appended = false;
+
 	flush_accepted_keys();
+	keystore.log_live = keystore.log_dead = 0;
+	log_sync();
 
 	int tmpdfd = dup(keystore.dirfd_accepted);
 	if (-1 == tmpdfd)
@@ -225,12 +604,15 @@ static void load_accepted_keys()
 
 	DIR* dir = fdopendir(tmpdfd);
 	struct dirent* ent;
-	struct key_ent** host = &keystore.hosts;
 
 /* all entries in directory is treated as possible keys, no single
  * authorized_keys, also means that we can have an inotify / watch on the
  * folder and immediately react on additions and revocations */
 	while ((ent = readdir(dir))){
+/* already known through the log */
+		if (find_fn(ent->d_name))
+			continue;
+
 		int fd = openat(keystore.dirfd_accepted, ent->d_name, O_RDONLY | O_CLOEXEC);
 		if (-1 == fd)
 			continue;
@@ -252,26 +634,29 @@ static void load_accepted_keys()
 
 			if (!decode_hostline(inbuf, len-1, &hoststr, key)){
 				fprintf(stderr, "keystore_naive(): failed to parse %s\n", ent->d_name);
-				free(inbuf);
 				continue;
 			}
 
-/* chain/attach as linked list, this will only contain the list of cps the key is valid for */
-			*host = alloc_key_ent(key);
-			if (*host){
-				(*host)->host = strdup(hoststr);
-				(*host)->fn = strdup(ent->d_name);
-				host = &(*host)->next;
-			}
+/* import into the log and pick it up when parsing, in-memory only as fallback */
+			if (indexed && log_append(key, hoststr, ent->d_name))
+				appended = true;
+			else
+				append_key(key, hoststr, ent->d_name);
 
 			break;
 		}
 
+		free(inbuf);
 		fclose(fpek);
 	}
 
 	rewinddir(dir);
 	closedir(dir);
+
+	if (appended)
+		log_sync();
+
+	log_compact();
 }
 
 bool a12helper_keystore_open(struct keystore_provider* p)
@@ -288,7 +673,8 @@ bool a12helper_keystore_open(struct keystore_provider* p)
 	}
 
 	keystore.provider = *p;
-	if (keystore.provider.type != A12HELPER_PROVIDER_BASEDIR)
+	if (keystore.provider.type != A12HELPER_PROVIDER_BASEDIR &&
+		keystore.provider.type != A12HELPER_PROVIDER_INDEXED)
 		return false;
 
 	if (keystore.provider.directory.dirfd < STDERR_FILENO)
@@ -345,6 +731,22 @@ bool a12helper_keystore_accept(const uint8_t pubk[static 32], const char* connp)
 	if (!keystore.open)
 		return false;
 
+	if (!connp)
+		connp = "outbound";
+
+/* the log record is the key, the name only needs to be unique for state/ */
+	if (keystore.provider.type == A12HELPER_PROVIDER_INDEXED){
+		do {
+			gen_fn(tmpfn, 8);
+		} while (find_fn(tmpfn));
+
+		if (!log_append(pubk, connp, tmpfn))
+			return false;
+
+		log_sync();
+		return find_fn(tmpfn) != NULL;
+	}
+
 	do {
 		gen_fn(tmpfn, 8);
 		fdout = openat(keystore.dirfd_accepted,
@@ -355,9 +757,6 @@ bool a12helper_keystore_accept(const uint8_t pubk[static 32], const char* connp)
 	if (!fpek)
 		return false;
 
-	if (!connp)
-		connp = "outbound";
-
 /* get base64 of pubk, just write that + space + connp <lf> */
 	size_t outl;
 	uint8_t* buf = a12helper_tob64(pubk, 32, &outl);
@@ -372,15 +771,7 @@ bool a12helper_keystore_accept(const uint8_t pubk[static 32], const char* connp)
 	free(buf);
 
 /* add to the existing keystore */
-	struct key_ent** host = &keystore.hosts;
-	while (*host){
-		host = &(*host)->next;
-	}
-
-	*host = alloc_key_ent(pubk);
-	if (*host){
-		(*host)->host = strdup(connp);
-	}
+	append_key(pubk, connp, tmpfn);
 	return true;
 }
 
@@ -393,7 +784,12 @@ bool a12helper_keystore_release()
 	close(keystore.dirfd_accepted);
 	close(keystore.dirfd_private);
 	close(keystore.dirfd_state);
+	if (-1 != keystore.fd_log)
+		close(keystore.fd_log);
+	flush_accepted_keys();
 
+	keystore.fd_log = -1;
+	keystore.log_ofs = 0;
 	keystore.provider.directory.dirfd = -1;
 	keystore.dirfd_accepted = -1;
 	keystore.dirfd_private = -1;
@@ -636,9 +1032,9 @@ int a12helper_keystore_statestore(
 	if (keystore.dirfd_state == -1)
 		return -1;
 
-	struct key_ent* ent = keystore.hosts;
-	while (ent && memcmp(pubk, ent->key, 32) != 0)
-		ent = ent->next;
+	struct key_ent* ent = find_key(pubk);
+	while (ent && !ent->fn)
+		ent = ent->next_key;
 
 	if (!ent)
 		return -1;
@@ -658,31 +1054,15 @@ int a12helper_keystore_statestore(
 		return openat(dir, name, O_RDONLY | O_CLOEXEC);
 }
 
-/*
- * this can be timed for a side-channel leak of:
- *
- *  - whether a key is known accepted or not
- *  - the number of accepted connection points for a key
- *  - the number of accepted keys
- *
- * mitigate by call first for '*' connp, then the specific one (if desired)
- * mitigate by also asking for a few random keys
- */
-const char*
-	a12helper_keystore_accepted(const uint8_t pubk[static 32], const char* connp)
+static const char* match_accepted(
+	const uint8_t pubk[static 32], const char* connp, size_t nlen)
 {
-	struct key_ent* ent = keystore.hosts;
-	if (!connp)
-		return NULL;
-
-	size_t nlen = strlen(connp);
-	if (!nlen)
-		return NULL;
+	struct key_ent* ent = find_key(pubk);
 
 	while (ent){
-/* not this key? */
+/* bucket neighbour rather than this key? */
 		if (memcmp(pubk, ent->key, 32) != 0){
-			ent = ent->next;
+			ent = ent->next_key;
 			continue;
 		}
 
@@ -694,7 +1074,7 @@ const char*
 /* then host- list is separated cp1,cp2,cp3,... so find needle in haystack */
 		const char* needle = strstr(ent->host, connp);
 		if (!needle){
-			ent = ent->next;
+			ent = ent->next_key;
 			continue;
 		}
 
@@ -709,12 +1089,40 @@ const char*
 		}
 
 /* continue as the pubk may exist multiple times */
-		ent = ent->next;
+		ent = ent->next_key;
 	}
 
 	return NULL;
 }
 
+/*
+ * this can be timed for a side-channel leak of:
+ *
+ *  - whether a key is known accepted or not
+ *  - the number of accepted connection points for a key
+ *
+ * mitigate by call first for '*' connp, then the specific one (if desired)
+ * mitigate by also asking for a few random keys
+ */
+const char*
+	a12helper_keystore_accepted(const uint8_t pubk[static 32], const char* connp)
+{
+	if (!connp)
+		return NULL;
+
+	size_t nlen = strlen(connp);
+	if (!nlen)
+		return NULL;
+
+	const char* res = match_accepted(pubk, connp, nlen);
+
+/* another process might have accepted the key since we last looked */
+	if (!res && keystore.open && log_sync())
+		res = match_accepted(pubk, connp, nlen);
+
+	return res;
+}
+
 int a12helper_keystore_dirfd(const char** err)
 {
 	char* basedir = getenv("ARCAN_STATEPATH");
@@ -1,29 +1,33 @@
 /*
- * Input-Event scheduler (stub still, nothing to see here)
+ * Input-Event scheduler
  * Copyright 2014-2016, Björn Ståhl
  * License: 3-Clause BSD, see COPYING file in arcan source repository.
  * Reference: http://arcan-fe.com
  */
 
-/*
- * Currently just a nonsense- stub, nothing real to see here yet.
- */
-
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
 
 #include <arcan_shmif.h>
-#include <arcan_math.h>
-#include <arcan_general.h>
-#include <arcan_event.h>
 
 #include "ievsched.h"
 
+/* latency samples that are started but not yet closed by a frame, and the
+ * upper bound on collected samples before a report has to reset them */
+#define MARK_LIMIT 256
+#define SAMPLE_LIMIT 65536
+
 struct ptsent {
 	arcan_ioevent data;
 	unsigned long pts;
@@ -32,20 +36,48 @@ struct ptsent {
 	struct ptsent* prev;
 };
 
+struct mark {
+	unsigned long sched;
+	unsigned long dispatch;
+};
+
 static struct {
-	bool initalized;
-	bool monotonic;
+	bool log;
+	enum ievsched_clock source;
 	unsigned long clock;
+	uint64_t epoch;
+	int timerfd;
 
-	struct ptsent* epoch;
+	struct ptsent* epoch_ent;
 	struct ptsent* current;
 	struct ptsent* end;
 
-} ievctx;
+/* poll hands out a reference, without logging the entry is already gone */
+	arcan_ioevent out;
+
+	struct mark marks[MARK_LIMIT];
+	size_t n_marks;
+
+	uint32_t* latency;
+	uint32_t* lag;
+	size_t n_samples;
+	size_t n_dropped;
+	size_t n_frames;
+	uint64_t last_vpts;
+} ievctx = {
+	.timerfd = -1
+};
+
+static uint64_t monotonic_us()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t)tp.tv_sec * 1000000 + tp.tv_nsec / 1000;
+}
 
 void ievsched_flush(bool log)
 {
-	struct ptsent* current = ievctx.epoch;
+	struct ptsent* current = ievctx.epoch_ent;
 
 	while (current){
 		struct ptsent* cur = current;
@@ -53,38 +85,260 @@ void ievsched_flush(bool log)
 		free(cur);
 	}
 
-	memset(&ievctx, '\0', sizeof(ievctx));
+/* the clock source, timer and collected samples survive the flush */
+	ievctx.epoch_ent = ievctx.current = ievctx.end = NULL;
+	ievctx.log = log;
+	ievctx.clock = 0;
+	ievctx.n_marks = 0;
+	ievctx.epoch = monotonic_us();
+}
+
+void ievsched_clock(enum ievsched_clock clock, bool log)
+{
+	ievctx.source = clock;
+	ievsched_flush(log);
 }
 
 void ievsched_step(int step)
 {
-	ievctx.clock = ievctx.clock + step;
+	if (ievctx.source != IEVSCHED_STEP)
+		return;
 
-	if (step < 0 && (-1 * step) > ievctx.clock)
+	if (step < 0 && (unsigned long)(-1 * step) > ievctx.clock)
 		ievctx.clock = 0;
 	else
 		ievctx.clock += step;
+}
+
+unsigned long ievsched_nextpts()
+{
+	if (ievctx.source == IEVSCHED_MONOTONIC)
+		return monotonic_us() - ievctx.epoch;
 
-/* slide current to point to the start of the current timestamp */
+	return ievctx.clock;
 }
 
 void ievsched_enqueue(arcan_ioevent* in)
 {
 	if (in->pts <= 0)
 		return;
+
+	struct ptsent* ent = malloc(sizeof(struct ptsent));
+	if (!ent)
+		return;
+
+	*ent = (struct ptsent){
+		.data = *in,
+		.pts = in->pts
+	};
+
+/* typically scheduled in order, so search from the back - with logging the
+ * entries before current are already consumed, anything scheduled in the past
+ * goes right before current so that it is up next */
+	struct ptsent* bound = ievctx.current ? ievctx.current->prev : ievctx.end;
+	struct ptsent* prev = ievctx.end;
+	while (prev && prev != bound && prev->pts > ent->pts)
+		prev = prev->prev;
+
+	ent->prev = prev;
+	ent->next = prev ? prev->next : ievctx.epoch_ent;
+
+	if (ent->next)
+		ent->next->prev = ent;
+	else
+		ievctx.end = ent;
+
+	if (prev)
+		prev->next = ent;
+	else
+		ievctx.epoch_ent = ent;
+
+	if (ent->next == ievctx.current)
+		ievctx.current = ent;
 }
 
-unsigned long ievsched_nextpts()
+static void start_mark(unsigned long sched, unsigned long now)
 {
-	return ievctx.clock;
+	if (ievctx.n_marks == MARK_LIMIT){
+		ievctx.n_dropped++;
+		return;
+	}
+
+	ievctx.marks[ievctx.n_marks++] = (struct mark){
+		.sched = sched,
+		.dispatch = now
+	};
 }
 
 bool ievsched_poll(arcan_ioevent** dst)
 {
 	*dst = NULL;
+	unsigned long now = ievsched_nextpts();
+
+/* if log, then step current in place and keep the entry for replay, else
+ * unlink and hand out a copy until current == NULL or event clock > now */
+	while (ievctx.current && ievctx.current->pts <= now){
+		struct ptsent* cur = ievctx.current;
+		ievctx.current = cur->next;
+		start_mark(cur->pts, now);
+
+		if (!ievctx.log){
+			ievctx.out = cur->data;
+			ievctx.epoch_ent = cur->next;
+			if (cur->next)
+				cur->next->prev = NULL;
+			else
+				ievctx.end = NULL;
+			free(cur);
+		}
+
+		arcan_ioevent* ev = ievctx.log ? &cur->data : &ievctx.out;
+		if (strncmp(ev->label, "LATENCY", 16) == 0)
+			continue;
+
+		*dst = ev;
+		return true;
+	}
+
 	return false;
+}
+
+/* next point in time worth waking up for, bounded by deadline */
+static unsigned long next_wake(unsigned long deadline)
+{
+	if (ievctx.current && ievctx.current->pts < deadline)
+		return ievctx.current->pts;
+	return deadline;
+}
+
+int ievsched_timerfd(unsigned long deadline)
+{
+#ifdef __linux__
+	if (ievctx.source != IEVSCHED_MONOTONIC)
+		return -1;
+
+	if (-1 == ievctx.timerfd){
+		ievctx.timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if (-1 == ievctx.timerfd)
+			return -1;
+	}
+
+/* absolute in the past fires immediately, but zero disarms */
+	uint64_t at = ievctx.epoch + next_wake(deadline);
+	struct itimerspec spec = {
+		.it_value = {
+			.tv_sec = at / 1000000,
+			.tv_nsec = (at % 1000000) * 1000 + 1
+		}
+	};
+
+	if (-1 == timerfd_settime(ievctx.timerfd, TFD_TIMER_ABSTIME, &spec, NULL))
+		return -1;
+
+	return ievctx.timerfd;
+#else
+	return -1;
+#endif
+}
+
+int ievsched_timeout(unsigned long deadline)
+{
+	unsigned long now = ievsched_nextpts();
+	unsigned long at = next_wake(deadline);
+
+	if (at <= now)
+		return 0;
+
+	if (ievctx.source == IEVSCHED_MONOTONIC)
+		return (at - now + 999) / 1000;
+
+	return at - now;
+}
+
+void ievsched_frame(uint64_t vpts)
+{
+	ievctx.last_vpts = vpts;
+	if (!ievctx.n_marks)
+		return;
+
+	if (!ievctx.latency){
+		ievctx.latency = malloc(SAMPLE_LIMIT * sizeof(uint32_t));
+		ievctx.lag = malloc(SAMPLE_LIMIT * sizeof(uint32_t));
+		if (!ievctx.latency || !ievctx.lag){
+			free(ievctx.latency);
+			free(ievctx.lag);
+			ievctx.latency = ievctx.lag = NULL;
+			ievctx.n_marks = 0;
+			return;
+		}
+	}
+
+	unsigned long now = ievsched_nextpts();
+	for (size_t i = 0; i < ievctx.n_marks; i++){
+		if (ievctx.n_samples == SAMPLE_LIMIT){
+			ievctx.n_dropped++;
+			continue;
+		}
+
+		ievctx.latency[ievctx.n_samples] = now - ievctx.marks[i].sched;
+		ievctx.lag[ievctx.n_samples] =
+			ievctx.marks[i].dispatch - ievctx.marks[i].sched;
+		ievctx.n_samples++;
+	}
 
-	/* if log, then find point and enqueue, else step current clock
-	 * until current == NULL or event clock != current time */
+	ievctx.n_marks = 0;
+	ievctx.n_frames++;
 }
 
+static int cmp_u32(const void* a, const void* b)
+{
+	uint32_t av = *(const uint32_t*) a;
+	uint32_t bv = *(const uint32_t*) b;
+	return av < bv ? -1 : (av > bv ? 1 : 0);
+}
+
+size_t ievsched_report(char* buf, size_t buf_sz, bool reset)
+{
+	size_t n = ievctx.n_samples;
+
+/* with the step clock the samples are in steps, not microseconds */
+	double scale = ievctx.source == IEVSCHED_MONOTONIC ? 0.001 : 1.0;
+
+	if (!n){
+		snprintf(buf, buf_sz, "latency:n=0:dropped=%zu", ievctx.n_dropped);
+		return 0;
+	}
+
+	qsort(ievctx.latency, n, sizeof(uint32_t), cmp_u32);
+
+	double sum = 0, lag_sum = 0;
+	uint32_t lag_max = 0;
+	for (size_t i = 0; i < n; i++){
+		sum += ievctx.latency[i];
+		lag_sum += ievctx.lag[i];
+		lag_max = ievctx.lag[i] > lag_max ? ievctx.lag[i] : lag_max;
+	}
+
+	snprintf(buf, buf_sz,
+		"latency:n=%zu:frames=%zu:dropped=%zu:vpts=%"PRIu64":"
+		"min=%.3f:avg=%.3f:p50=%.3f:p95=%.3f:p99=%.3f:max=%.3f:"
+		"lag_avg=%.3f:lag_max=%.3f",
+		n, ievctx.n_frames, ievctx.n_dropped, ievctx.last_vpts,
+		scale * ievctx.latency[0],
+		scale * sum / (double) n,
+		scale * ievctx.latency[n / 2],
+		scale * ievctx.latency[(n * 95) / 100],
+		scale * ievctx.latency[(n * 99) / 100],
+		scale * ievctx.latency[n - 1],
+		scale * lag_sum / (double) n,
+		scale * lag_max
+	);
+
+	if (reset){
+		ievctx.n_samples = 0;
+		ievctx.n_dropped = 0;
+		ievctx.n_frames = 0;
+	}
+
+	return n;
+}
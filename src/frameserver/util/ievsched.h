@@ -1,9 +1,12 @@
 /* Input Event scheduling,
  *
  * A simple growing buffer for arcan input events that
- * has a pts set to a local monotonic clock with epoc
- * relative to the first reset. These are typically
- * aligned to the number of retro_run() invocations
+ * has a pts set to a local clock with epoch relative to
+ * the first reset (flush). The clock is either a step
+ * counter, typically aligned to the number of retro_run()
+ * invocations, or the monotonic clock in microseconds for
+ * scheduling against wall time with sub-millisecond
+ * precision.
  *
  * These allow for collisions, meaning that multiple events
  * can be applied in the same logical pulse, even though
@@ -13,15 +16,30 @@
  * If this is setup with rewind / replay support,
  * these will accumulate until out of memory or until
  * explicitly flushed.
+ *
+ * Events with the label LATENCY are markers, they are not
+ * returned from poll but start a latency sample when their
+ * time comes, as does any other scheduled event. The samples
+ * are closed by the next call to ievsched_frame, giving the
+ * time from scheduled input to the frame that could show it.
  */
 
+enum ievsched_clock {
+	IEVSCHED_STEP = 0,
+	IEVSCHED_MONOTONIC = 1
+};
+
 /* drop all currently stored input events, resets the
  * internal pts counter. If log is set, new configuration
  * will either hold all new inputs or drop them as they're dequeued */
 void ievsched_flush(bool log);
 
+/* pick the clock source, this also flushes */
+void ievsched_clock(enum ievsched_clock clock, bool log);
+
 /* Increment or decrement the current stepcounter.
- * the end result will be clamped to 0 <= n < ULINT_MAX */
+ * the end result will be clamped to 0 <= n < ULINT_MAX,
+ * ignored with the monotonic clock */
 void ievsched_step(int step);
 
 /* add ioevent to ptsqueue */
@@ -36,3 +54,20 @@ bool ievsched_poll(arcan_ioevent** dst);
  * enqueue if it doesn't have a evslot set. */
 unsigned long ievsched_nextpts();
 
+/* monotonic clock only - get a (timerfd) descriptor that becomes readable
+ * when the next event is due or at [deadline], whichever comes first, the
+ * descriptor is owned by the scheduler and should be read() before reuse.
+ * returns -1 if there is no timerfd support, then use ievsched_timeout. */
+int ievsched_timerfd(unsigned long deadline);
+
+/* milliseconds (rounded up) until the next event or [deadline] */
+int ievsched_timeout(unsigned long deadline);
+
+/* a frame was submitted with the presentation timestamp [vpts], closes the
+ * latency samples that were started before it */
+void ievsched_frame(uint64_t vpts);
+
+/* format the collected latency samples (ms, microsecond precision) as a
+ * key=value:key=value report into [buf], returns the number of samples,
+ * if reset is set the samples are cleared afterwards */
+size_t ievsched_report(char* buf, size_t buf_sz, bool reset);
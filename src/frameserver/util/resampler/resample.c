@@ -96,6 +96,13 @@ static void speex_free (void *ptr) {free(ptr);}
 #define NULL 0
 #endif
 
+/* SSE is always there on x86-64, the float inner loops can use it unless
+ * ARCAN_RESAMPLE_NOSIMD is defined at build time */
+#if !defined(FIXED_POINT) && !defined(_USE_SSE) && \
+	!defined(ARCAN_RESAMPLE_NOSIMD) && (defined(__x86_64__) || defined(__SSE__))
+#define _USE_SSE
+#endif
+
 #ifdef _USE_SSE
 #include "resample_sse.h"
 #endif
@@ -338,7 +345,9 @@ static int resampler_basic_direct_single(SpeexResamplerState *st, spx_uint32_t c
    const int frac_advance = st->frac_advance;
    const spx_uint32_t den_rate = st->den_rate;
    spx_word32_t sum;
+#ifndef OVERRIDE_INNER_PRODUCT_SINGLE
    int j;
+#endif
 
    while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
    {
@@ -442,7 +451,9 @@ static int resampler_basic_interpolate_single(SpeexResamplerState *st, spx_uint3
    const int int_advance = st->int_advance;
    const int frac_advance = st->frac_advance;
    const spx_uint32_t den_rate = st->den_rate;
+#ifndef OVERRIDE_INTERPOLATE_PRODUCT_SINGLE
    int j;
+#endif
    spx_word32_t sum;
 
    while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
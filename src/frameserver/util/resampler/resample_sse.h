@@ -0,0 +1,50 @@
+/*
+ * SSE versions of the single precision inner loops in resample.c, included
+ * when _USE_SSE is set. The filter length is always a multiple of 4 (see
+ * update_filter) which the loops below rely on.
+ */
+#include <xmmintrin.h>
+
+static inline float hsum_ps(__m128 v)
+{
+	__m128 t = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	t = _mm_add_ss(t, _mm_shuffle_ps(t, t, 0x55));
+	return _mm_cvtss_f32(t);
+}
+
+#define OVERRIDE_INNER_PRODUCT_SINGLE
+static inline float inner_product_single(
+	const float* a, const float* b, unsigned int len)
+{
+	__m128 sum = _mm_setzero_ps();
+	unsigned int i = 0;
+
+	for (; i + 8 <= len; i += 8){
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		sum = _mm_add_ps(sum,
+			_mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+
+	for (; i < len; i += 4)
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+	return hsum_ps(sum);
+}
+
+/* four taps of the oversampled table per input sample, weighted by the cubic
+ * interpolation coefficients in [frac] */
+#define OVERRIDE_INTERPOLATE_PRODUCT_SINGLE
+static inline float interpolate_product_single(const float* a,
+	const float* b, unsigned int len, const spx_uint32_t oversample, float* frac)
+{
+	__m128 sum = _mm_setzero_ps();
+
+	for (unsigned int i = 0; i < len; i += 2){
+		sum = _mm_add_ps(sum,
+			_mm_mul_ps(_mm_load1_ps(a + i), _mm_loadu_ps(b + i * oversample)));
+		sum = _mm_add_ps(sum,
+			_mm_mul_ps(_mm_load1_ps(a + i + 1), _mm_loadu_ps(b + (i + 1) * oversample)));
+	}
+
+	return hsum_ps(_mm_mul_ps(_mm_loadu_ps(frac), sum));
+}
@@ -139,22 +139,6 @@ const char* agp_shader_language()
 	return "GLSL120";
 }
 
-static void pbo_alloc_read(struct agp_vstore* store)
-{
-	GLuint pboid;
-	struct agp_fenv* env = agp_env();
-	env->gen_buffers(1, &pboid);
-	store->vinf.text.rid = pboid;
-
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, pboid);
-	env->buffer_data(GL_PIXEL_PACK_BUFFER,
-		store->w * store->h * store->bpp, NULL, GL_STREAM_COPY);
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
-
-	verbose_print("allocated %zu*%zu read-pbo",
-		(size_t) store->w, (size_t) store->h);
-}
-
 static void pbo_alloc_write(struct agp_vstore* store)
 {
 	GLuint pboid;
@@ -178,11 +162,6 @@ static void rebuild_pbo(struct agp_vstore* s)
 		env->delete_buffers(1, &s->vinf.text.wid);
 		pbo_alloc_write(s);
 	}
-
-	if (s->vinf.text.rid){
-		env->delete_buffers(1, &s->vinf.text.rid);
-		pbo_alloc_read(s);
-	}
 }
 
 static void set_pixel_store(size_t w, struct stream_meta const meta)
@@ -217,17 +196,27 @@ void agp_readback_synchronous(struct agp_vstore* dst)
 	env->get_tex_image(GL_TEXTURE_2D, 0,
 		GL_PIXEL_FORMAT, GL_UNSIGNED_BYTE, dst->vinf.text.raw);
 	dst->update_ts = arcan_timemillis();
+	dst->update_seq++;
 	env->bind_texture(GL_TEXTURE_2D, 0);
 }
 
 static void pbo_stream(struct agp_vstore* s,
 	av_pixel* buf, struct stream_meta* meta, bool synch)
 {
-	agp_activate_vstore(s);
 	struct agp_fenv* env = agp_env();
+	size_t ntc = s->w * s->h;
 
+	if (agp_ulring_upload(s, buf, 0, 0, s->w, s->h)){
+		if (synch){
+			memcpy(s->vinf.text.raw, buf, ntc * sizeof(av_pixel));
+			s->update_ts = arcan_timemillis();
+			s->update_seq++;
+		}
+		return;
+	}
+
+	agp_activate_vstore(s);
 	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, s->vinf.text.wid);
-	size_t ntc = s->w * s->h;
 
 	av_pixel* ptr = env->map_buffer(GL_PIXEL_UNPACK_BUFFER,GL_WRITE_ONLY);
 
@@ -250,6 +239,7 @@ static void pbo_stream(struct agp_vstore* s,
 		buf = obuf;
 		ptr = s->vinf.text.raw;
 		s->update_ts = arcan_timemillis();
+		s->update_seq++;
 
 		if ( ((uintptr_t)ptr % 16) == 0 && ((uintptr_t)buf % 16) == 0	)
 			memcpy(ptr, buf, ntc * sizeof(av_pixel));
@@ -277,11 +267,17 @@ static void pbo_stream_sub(struct agp_vstore* s,
 	av_pixel* buf, struct stream_meta* meta, bool synch)
 {
 	struct agp_fenv* env = agp_env();
+	size_t row_sz = meta->w * sizeof(av_pixel);
+
+/* with the ring only the damaged rows are copied, so no need to check how
+ * much of the store that is actually covered */
+	if (agp_ulring_upload(s, buf, meta->x1, meta->y1, meta->w, meta->h))
+		goto synch;
+
 	if ( (float)(meta->w * meta->h) / (s->w * s->h) > 0.5)
 		return pbo_stream(s, buf, meta, synch);
 
 	agp_activate_vstore(s);
-	size_t row_sz = meta->w * sizeof(av_pixel);
 	set_pixel_store(s->w, *meta);
 
 	verbose_print(
@@ -296,15 +292,14 @@ static void pbo_stream_sub(struct agp_vstore* s,
 	reset_pixel_store();
 	agp_deactivate_vstore();
 
+synch:
 	if (synch){
-		size_t x2 = meta->x1 + meta->w;
-		size_t y2 = meta->y1 + meta->h;
-
 		av_pixel* cpy = s->vinf.text.raw;
 		for (size_t y = meta->y1; y < meta->y1 + meta->h; y++)
 			memcpy(&cpy[y * s->w + meta->x1], &buf[y * s->w + meta->x1], row_sz);
 
 		s->update_ts = arcan_timemillis();
+		s->update_seq++;
 	}
 
 /*
@@ -346,14 +341,15 @@ static inline void setup_unpack_pbo(struct agp_vstore* s, void* buf)
 
 static void alloc_buffer(struct agp_vstore* s)
 {
-	if (s->vinf.text.s_raw != s->w * s->h * sizeof(av_pixel)){
+	size_t bpp = s->bpp > sizeof(av_pixel) ? s->bpp : sizeof(av_pixel);
+	if (s->vinf.text.s_raw != s->w * s->h * bpp){
 		arcan_mem_free(s->vinf.text.raw);
 		s->vinf.text.raw = NULL;
 	}
 
 	if (!s->vinf.text.raw){
 		verbose_print("(%"PRIxPTR") alloc buffer", (uintptr_t) s);
-		s->vinf.text.s_raw = s->w * s->h * sizeof(av_pixel);
+		s->vinf.text.s_raw = s->w * s->h * bpp;
 		s->vinf.text.raw = arcan_alloc_mem(s->vinf.text.s_raw,
 			ARCAN_MEM_VBUFFER, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_PAGE);
 	}
@@ -406,10 +402,11 @@ struct stream_meta agp_stream_prepare(struct agp_vstore* s,
 		if (meta.dirty){
 			verbose_print("(%"PRIxPTR") raw synch sub (%zu+%zu*%zu+%zu)",
 				(uintptr_t) s, meta.x1, meta.w, meta.y1, meta.h);
-			set_pixel_store(s->w, meta);
+			set_pixel_store(meta.stride ? meta.stride : s->w, meta);
 			env->tex_subimage_2d(GL_TEXTURE_2D, 0, meta.x1, meta.y1, meta.w, meta.h,
 				s->vinf.text.s_fmt ? s->vinf.text.s_fmt : GL_PIXEL_FORMAT,
-				GL_UNSIGNED_BYTE, meta.buf
+				s->vinf.text.s_type ? s->vinf.text.s_type : GL_UNSIGNED_BYTE,
+				meta.buf
 			);
 
 			reset_pixel_store();
@@ -417,10 +414,17 @@ struct stream_meta agp_stream_prepare(struct agp_vstore* s,
 		else{
 			verbose_print(
 				"(%"PRIxPTR") raw synch (%zu*%zu)", (uintptr_t) s, meta.w, meta.h);
-				env->tex_subimage_2d(GL_TEXTURE_2D, 0, 0, 0, s->w, s->h,
+			if (meta.stride)
+				env->pixel_storei(GL_UNPACK_ROW_LENGTH, meta.stride);
+
+			env->tex_subimage_2d(GL_TEXTURE_2D, 0, 0, 0, s->w, s->h,
 				s->vinf.text.s_fmt ? s->vinf.text.s_fmt : GL_PIXEL_FORMAT,
-				GL_UNSIGNED_BYTE, meta.buf
+				s->vinf.text.s_type ? s->vinf.text.s_type : GL_UNSIGNED_BYTE,
+				meta.buf
 			);
+
+			if (meta.stride)
+				env->pixel_storei(GL_UNPACK_ROW_LENGTH, 0);
 		}
 		agp_deactivate_vstore();
 	break;
@@ -470,22 +474,18 @@ void agp_stream_commit(struct agp_vstore* s, struct stream_meta meta)
 {
 }
 
-static void default_release(void* tag)
-{
-	if (!tag)
-		return;
-	struct agp_fenv* env = agp_env();
-
-	env->unmap_buffer(GL_PIXEL_PACK_BUFFER);
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
-}
-
 void agp_resize_vstore(struct agp_vstore* s, size_t w, size_t h)
 {
 	struct agp_fenv* env = agp_env();
 	s->w = w;
 	s->h = h;
-	s->bpp = sizeof(av_pixel);
+/* deep formats keep their pixel size, the rest are treated as av_pixel */
+	if (s->hdr.depth < VSTORE_HINT_F16)
+		s->bpp = sizeof(av_pixel);
+
+/* whatever was compressed before will be replaced with a plain store */
+	s->vinf.text.compressed = 0;
+	s->vinf.text.mip_levels = 0;
 
 	verbose_print("(%"PRIxPTR") resize to %zu * %zu", (uintptr_t) s, w, h);
 	alloc_buffer(s);
@@ -494,42 +494,3 @@ void agp_resize_vstore(struct agp_vstore* s, size_t w, size_t h)
 	agp_update_vstore(s, true);
 }
 
-void agp_request_readback(struct agp_vstore* store)
-{
-	if (!store || store->txmapped != TXSTATE_TEX2D)
-		return;
-	struct agp_fenv* env = agp_env();
-
-	if (!store->vinf.text.rid)
-		pbo_alloc_read(store);
-
-	verbose_print("(%"PRIxPTR":glid %u) getTexImage2D => PBO",
-		(uintptr_t) store, (unsigned) store->vinf.text.glid);
-
-	env->bind_texture(GL_TEXTURE_2D, agp_resolve_texid(store));
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, store->vinf.text.rid);
-	env->get_tex_image(GL_TEXTURE_2D, 0, GL_PIXEL_FORMAT, GL_UNSIGNED_BYTE, NULL);
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
-	env->bind_texture(GL_TEXTURE_2D, 0);
-}
-
-struct asynch_readback_meta agp_poll_readback(struct agp_vstore* store)
-{
-	struct agp_fenv* env = agp_env();
-	struct asynch_readback_meta res = {
-	.release = default_release
-	};
-
-	if (!store || store->txmapped != TXSTATE_TEX2D ||
-		store->vinf.text.rid == GL_NONE)
-		return res;
-
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, store->vinf.text.rid);
-
-	res.w = store->w;
-	res.h = store->h;
-	res.tag = (void*) 0xdeadbeef;
-	res.ptr = (av_pixel*) env->map_buffer(GL_PIXEL_PACK_BUFFER, GL_READ_WRITE);
-
-	return res;
-}
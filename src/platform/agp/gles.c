@@ -3,8 +3,8 @@
  * License: 3-Clause BSD, see COPYING file in arcan source repository.
  * Reference: http://arcan-fe.com
  * Description: Simplified AGP platform for GLES 2/3. We need a slightly
- * different shader format and we lack some key features that kill this
- * platform rather badly (PBO uploads and asynch data fetch).
+ * different shader format and we lack some key features that hurt this
+ * platform rather badly (PBO uploads, and GLES2 has no asynch data fetch).
  */
 
 #include <stdlib.h>
@@ -175,72 +175,44 @@ void glDrawBuffer(GLint mode)
 }
 
 /*
- * NOTE: not yet implemented, there's few "clean" ways for
- * getting this behavior in GLES2,3 -- either look for an
- * extension that permits it or create an intermediate
- * rendertarget, blit to it, and then glReadPixels (seriously...)
- *
- * Possibly use a pool of a few stores at least as
- * the amount of readbacks should be rather limited
- * (we're talking recording, streaming or remoting)
- * something like:
- *
- *	glGenRenderbuffers(1, &readback.texid);
- *  glBindRenderbuffer(GL_RENDERBUFFER, readback.texid);
- *	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA, w, h);
- *
- *	glGenFramebuffers(1, &readback.fboid);
- *	glBindFramebuffer(GL_FRAMEBUFFER, readback.fboid);
- *	glFramebufferRenderbuffer(GL_FRAMEBUFFER,
- *		GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, readback.texid);
- *
- *	glViewport(0, 0, width, height);
- *	glReadPixels(0, 0, width, height, GL_RGBA, GL_RGBA, dstbuf);
+ * There is no glGetTexImage here, so the texture is attached to a scratch
+ * FBO and glReadPixels is used instead. The asynchronous version lives in
+ * glshared.c together with the PBO ring.
  */
-
 void agp_readback_synchronous(struct agp_vstore* dst)
 {
-	arcan_warning("agp(gles) - readbacks not supported\n");
-}
-
-void agp_request_readback(struct agp_vstore* store)
-{
-	arcan_warning("agp(gles) - readbacks not supported\n");
-}
-
-struct asynch_readback_meta argp_buffer_readback_asynchronous(
-	struct agp_vstore* dst, bool poll)
-{
-	struct asynch_readback_meta res = {0};
-	return res;
-}
-
-static void default_release(void* tag)
-{
-#ifdef GLES3
-	if (!tag)
+	if (!(dst->txmapped == TXSTATE_TEX2D) || !dst->vinf.text.raw)
 		return;
 	struct agp_fenv* env = agp_env();
 
-	env->unmap_buffer(GL_PIXEL_PACK_BUFFER);
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
-#endif
-}
-
-struct asynch_readback_meta agp_poll_readback(struct agp_vstore* store)
-{
-	struct asynch_readback_meta res = {
-	.release = default_release
-	};
-
-	return res;
+	GLint last;
+	GLuint fbo;
+	env->get_integer_v(GL_FRAMEBUFFER_BINDING, &last);
+	env->gen_framebuffers(1, &fbo);
+	env->bind_framebuffer(GL_FRAMEBUFFER, fbo);
+	env->framebuffer_texture_2d(GL_FRAMEBUFFER,
+		GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, agp_resolve_texid(dst), 0);
+
+	env->read_pixels(0, 0, dst->w, dst->h,
+		GL_PIXEL_FORMAT, GL_UNSIGNED_BYTE, dst->vinf.text.raw);
+	dst->update_ts = arcan_timemillis();
+	dst->update_seq++;
+
+	env->bind_framebuffer(GL_FRAMEBUFFER, last);
+	env->delete_framebuffers(1, &fbo);
 }
 
 void agp_resize_vstore(struct agp_vstore* s, size_t w, size_t h)
 {
 	s->w = w;
 	s->h = h;
-	s->bpp = sizeof(av_pixel);
+/* deep formats keep their pixel size, the rest are treated as av_pixel */
+	if (s->hdr.depth < VSTORE_HINT_F16)
+		s->bpp = sizeof(av_pixel);
+
+/* whatever was compressed before will be replaced with a plain store */
+	s->vinf.text.compressed = 0;
+	s->vinf.text.mip_levels = 0;
 	size_t new_sz = w * h * s->bpp;
 	struct agp_fenv* env = agp_env();
 
@@ -302,6 +274,7 @@ struct stream_meta agp_stream_prepare(struct agp_vstore* s,
 		size_t ntc = s->w * s->h;
 		av_pixel* ptr = s->vinf.text.raw, (* buf) = meta.buf;
 		s->update_ts = arcan_timemillis();
+		s->update_seq++;
 
 		if ( ((uintptr_t)ptr % 16) == 0 && ((uintptr_t)buf % 16) == 0	)
 			memcpy(ptr, buf, ntc * sizeof(av_pixel));
@@ -320,11 +293,22 @@ struct stream_meta agp_stream_prepare(struct agp_vstore* s,
 	case STREAM_RAW_DIRECT:
 	case STREAM_RAW_DIRECT_SYNCHRONOUS:
 	agp_activate_vstore(s);
+/* no UNPACK_ROW_LENGTH in GLES2, so a padded source goes row by row */
+	if (meta.stride && meta.stride != s->w){
+		for (size_t y = 0; y < s->h; y++)
+			env->tex_subimage_2d(GL_TEXTURE_2D, 0, 0, y, s->w, 1,
+				s->vinf.text.s_fmt ? s->vinf.text.s_fmt : GL_PIXEL_FORMAT,
+				s->vinf.text.s_type ? s->vinf.text.s_type : GL_UNSIGNED_BYTE,
+				&meta.buf[y * meta.stride]
+			);
+	}
+	else
 		env->tex_subimage_2d(GL_TEXTURE_2D, 0, 0, 0, s->w, s->h,
 			s->vinf.text.s_fmt ? s->vinf.text.s_fmt : GL_PIXEL_FORMAT,
-			GL_UNSIGNED_BYTE, meta.buf
+			s->vinf.text.s_type ? s->vinf.text.s_type : GL_UNSIGNED_BYTE,
+			meta.buf
 		);
-		agp_deactivate_vstore();
+	agp_deactivate_vstore();
 	break;
 
 /* see notes in gl21.c */
@@ -39,12 +39,100 @@
 #endif
 #endif
 
+/* sync objects and mapped ranges are optional (see agp_fenv), but the
+ * constants are needed regardless of what the headers provide */
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#endif
+
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+
+#ifndef GL_NUM_COMPRESSED_TEXTURE_FORMATS
+#define GL_NUM_COMPRESSED_TEXTURE_FORMATS 0x86A2
+#endif
+
+#ifndef GL_COMPRESSED_TEXTURE_FORMATS
+#define GL_COMPRESSED_TEXTURE_FORMATS 0x86A3
+#endif
+
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#endif
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+
+#ifndef GL_SAMPLES_PASSED
+#define GL_SAMPLES_PASSED 0x8914
+#endif
+
+#ifndef GL_ANY_SAMPLES_PASSED
+#define GL_ANY_SAMPLES_PASSED 0x8C2F
+#endif
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
 /*
  * To work with the extension wrangling problem and all the other headaches
  * with multiple GL libraries, switching GL library at runtime for
  * multiple-GPUs, we package all the functions we need in a struct that is
  * instanced per GPU/vendor.
  */
+#define AGP_STATE_UNITS 8
+
 struct agp_fenv {
 	int cookie;
 	int mode;
@@ -58,6 +146,28 @@ struct agp_fenv {
 	void (*buffer_data) (GLenum, GLsizeiptr, const GLvoid*, GLenum);
 	void (*bind_buffer) (GLenum, GLuint);
 	void* (*map_buffer) (GLenum, GLenum);
+	void* (*map_buffer_range) (GLenum, GLintptr, GLsizeiptr, GLbitfield);
+
+/* Immutable buffer storage, optional (GL4.4 / ARB_buffer_storage), used for
+ * the persistently mapped upload ring */
+	void (*buffer_storage) (GLenum, GLsizeiptr, const void*, GLbitfield);
+
+/* Synchronization, optional (GL3.2 / ARB_sync / GLES3), the sync objects
+ * are kept opaque so that we don't depend on the header providing GLsync */
+	void* (*fence_sync) (GLenum, GLbitfield);
+	GLenum (*client_wait_sync) (void*, GLbitfield, uint64_t);
+	void (*delete_sync) (void*);
+
+/* Occlusion queries, optional (GLES2 lacks them) */
+	void (*gen_queries) (GLsizei, GLuint*);
+	void (*delete_queries) (GLsizei, const GLuint*);
+	void (*begin_query) (GLenum, GLuint);
+	void (*end_query) (GLenum);
+	void (*get_query_objectuiv) (GLuint, GLenum, GLuint*);
+
+/* Timer queries, optional on top of the queries above (ARB/EXT_timer_query,
+ * EXT_disjoint_timer_query) */
+	void (*get_query_objectui64v) (GLuint, GLenum, uint64_t*);
 
 /* FBOs */
 	void (*gen_framebuffers) (GLsizei, GLuint*);
@@ -105,6 +215,12 @@ struct agp_fenv {
 	void (*link_program) (GLuint);
 	void (*get_program_iv) (GLuint, GLenum, GLint*);
 
+/* Program binaries, optional (GL4.1 / ARB_get_program_binary / GLES3 /
+ * OES_get_program_binary), parameter_i is only needed for the hint */
+	void (*get_program_binary) (GLuint, GLsizei, GLsizei*, GLenum*, void*);
+	void (*program_binary) (GLuint, GLenum, const void*, GLsizei);
+	void (*program_parameter_i) (GLuint, GLenum, GLint);
+
 /* Texturing */
 	void (*gen_textures) (GLsizei, GLuint*);
 	void (*active_texture) (GLenum);
@@ -114,6 +230,8 @@ struct agp_fenv {
 		GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const GLvoid*);
 	void (*tex_image_2d) (GLenum,
 		GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const GLvoid*);
+	void (*compressed_tex_image_2d) (GLenum,
+		GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei, const GLvoid*);
 	void (*tex_image_2d_multisample) (
 		GLenum, GLsizei, GLint, GLsizei, GLsizei, GLboolean);
 	void (*tex_image_3d)(
@@ -158,10 +276,42 @@ struct agp_fenv {
 	GLenum blend_src_alpha, blend_dst_alpha;
 	GLint last_store_mode;
 
+/* redundant state filtering: the texture entry points above are wrapped and
+ * the real ones kept here, blend_mode is maintained by agp_blendstate and is
+ * -1 whenever something else has touched the blend state */
+	struct {
+		void (*bind_texture) (GLenum, GLuint);
+		void (*active_texture) (GLenum);
+		void (*delete_textures) (GLsizei, const GLuint*);
+		size_t unit;
+		GLuint bound[AGP_STATE_UNITS];
+		int blend_mode;
+		GLenum blend_src_alpha, blend_dst_alpha;
+	} state;
+
+/* persistently mapped staging memory for texture uploads, see glshared.c */
+	struct agp_ulring* ulring;
+
 /* safety */
 	int (*reset_status) ();
 };
 
 void agp_glinit_fenv(struct agp_fenv* dst,
 	void*(*lookup)(void* tag, const char* sym, bool req), void* tag);
+
+/*
+ * forget all cached state (bound textures, blend mode) for [env], needed
+ * when something outside of agp may have modified the context
+ */
+void agp_glinit_state_reset(struct agp_fenv* env);
+
+/*
+ * Upload the [w*h] region at [x,y] of [buf] (with a row length of s->w) to
+ * the texture of [s] through the environment upload ring. Returns false if
+ * there is no ring or no free space without stalling, the caller is then
+ * expected to fall back to a regular upload.
+ */
+struct agp_vstore;
+bool agp_ulring_upload(struct agp_vstore* s,
+	const void* buf, size_t x, size_t y, size_t w, size_t h);
 #endif
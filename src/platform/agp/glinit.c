@@ -14,6 +14,61 @@
 
 static struct agp_fenv* cenv;
 
+/* the default environment can be initialised and used before it has been
+ * set as the current one, so the state wrappers fall back to the last one */
+static struct agp_fenv* initenv;
+
+static struct agp_fenv* state_env()
+{
+	return cenv ? cenv : initenv;
+}
+
+void agp_glinit_state_reset(struct agp_fenv* env)
+{
+	if (!env)
+		return;
+
+	env->state.unit = 0;
+	memset(env->state.bound, '\0', sizeof(env->state.bound));
+	env->state.blend_mode = -1;
+}
+
+/* only 2D bindings on the first units are tracked, anything else passes */
+static void state_bind_texture(GLenum target, GLuint id)
+{
+	struct agp_fenv* env = state_env();
+	if (target != GL_TEXTURE_2D || env->state.unit >= AGP_STATE_UNITS){
+		env->state.bind_texture(target, id);
+		return;
+	}
+
+	if (env->state.bound[env->state.unit] == id)
+		return;
+
+	env->state.bound[env->state.unit] = id;
+	env->state.bind_texture(target, id);
+}
+
+static void state_active_texture(GLenum unit)
+{
+	struct agp_fenv* env = state_env();
+	env->state.unit = unit - GL_TEXTURE0;
+	env->state.active_texture(unit);
+}
+
+/* deleting a bound texture reverts that binding to 0, and the name can be
+ * recycled by the next gen_textures so the cache has to follow */
+static void state_delete_textures(GLsizei n, const GLuint* ids)
+{
+	struct agp_fenv* env = state_env();
+	for (GLsizei i = 0; i < n; i++)
+		for (size_t j = 0; j < AGP_STATE_UNITS; j++)
+			if (env->state.bound[j] == ids[i])
+				env->state.bound[j] = 0;
+
+	env->state.delete_textures(n, ids);
+}
+
 struct agp_fenv* agp_env()
 {
 	return cenv;
@@ -22,6 +77,7 @@ struct agp_fenv* agp_env()
 void agp_setenv(struct agp_fenv* dst)
 {
 	cenv = dst;
+	agp_glinit_state_reset(dst);
 }
 
 /*
@@ -102,7 +158,71 @@ void agp_glinit_fenv(struct agp_fenv* dst,
 	dst->map_buffer =
 		(void*(*)(GLenum, GLenum))
 			lookup(tag, "glMapBuffer");
+	dst->map_buffer_range =
+		(void*(*)(GLenum, GLintptr, GLsizeiptr, GLbitfield))
+			lookup_opt(tag, "glMapBufferRange");
+	dst->buffer_storage =
+		(void(*)(GLenum, GLsizeiptr, const void*, GLbitfield))
+			lookup_opt(tag, "glBufferStorage");
+	if (!dst->buffer_storage)
+		dst->buffer_storage =
+			(void(*)(GLenum, GLsizeiptr, const void*, GLbitfield))
+				lookup_opt(tag, "glBufferStorageEXT");
 #endif
+	dst->fence_sync =
+		(void*(*)(GLenum, GLbitfield))
+			lookup_opt(tag, "glFenceSync");
+	dst->client_wait_sync =
+		(GLenum(*)(void*, GLbitfield, uint64_t))
+			lookup_opt(tag, "glClientWaitSync");
+	dst->delete_sync =
+		(void(*)(void*))
+			lookup_opt(tag, "glDeleteSync");
+
+/* treat partial sync support as none */
+	if (!dst->fence_sync || !dst->client_wait_sync || !dst->delete_sync){
+		dst->fence_sync = NULL;
+		dst->client_wait_sync = NULL;
+		dst->delete_sync = NULL;
+	}
+
+	dst->gen_queries =
+		(void(*)(GLsizei, GLuint*))
+			lookup_opt(tag, "glGenQueries");
+	dst->delete_queries =
+		(void(*)(GLsizei, const GLuint*))
+			lookup_opt(tag, "glDeleteQueries");
+	dst->begin_query =
+		(void(*)(GLenum, GLuint))
+			lookup_opt(tag, "glBeginQuery");
+	dst->end_query =
+		(void(*)(GLenum))
+			lookup_opt(tag, "glEndQuery");
+	dst->get_query_objectuiv =
+		(void(*)(GLuint, GLenum, GLuint*))
+			lookup_opt(tag, "glGetQueryObjectuiv");
+
+	if (!dst->gen_queries || !dst->delete_queries ||
+		!dst->begin_query || !dst->end_query || !dst->get_query_objectuiv){
+		dst->gen_queries = NULL;
+		dst->delete_queries = NULL;
+		dst->begin_query = NULL;
+		dst->end_query = NULL;
+		dst->get_query_objectuiv = NULL;
+	}
+
+	if (dst->gen_queries && (check_ext("GL_ARB_timer_query", ext) ||
+		check_ext("GL_EXT_timer_query", ext) ||
+		check_ext("GL_EXT_disjoint_timer_query", ext))){
+		dst->get_query_objectui64v =
+			(void(*)(GLuint, GLenum, uint64_t*))
+				lookup_opt(tag, "glGetQueryObjectui64v");
+		if (!dst->get_query_objectui64v)
+			dst->get_query_objectui64v =
+				(void(*)(GLuint, GLenum, uint64_t*))
+					lookup_opt(tag, "glGetQueryObjectui64vEXT");
+	}
+
 /* FBOs */
 	dst->gen_framebuffers =
 		(void (*)(GLsizei, GLuint*)) lookup(tag, "glGenFramebuffers");
@@ -217,6 +337,36 @@ void agp_glinit_fenv(struct agp_fenv* dst,
 		(void(*)(GLuint, GLenum, GLint*))
 			lookup(tag, "glGetProgramiv");
 
+	dst->get_program_binary =
+		(void(*)(GLuint, GLsizei, GLsizei*, GLenum*, void*))
+			lookup_opt(tag, "glGetProgramBinary");
+	if (!dst->get_program_binary)
+		dst->get_program_binary =
+			(void(*)(GLuint, GLsizei, GLsizei*, GLenum*, void*))
+				lookup_opt(tag, "glGetProgramBinaryOES");
+
+	dst->program_binary =
+		(void(*)(GLuint, GLenum, const void*, GLsizei))
+			lookup_opt(tag, "glProgramBinary");
+	if (!dst->program_binary)
+		dst->program_binary =
+			(void(*)(GLuint, GLenum, const void*, GLsizei))
+				lookup_opt(tag, "glProgramBinaryOES");
+
+	dst->program_parameter_i =
+		(void(*)(GLuint, GLenum, GLint))
+			lookup_opt(tag, "glProgramParameteri");
+
+/* a driver can expose the entry points yet support no binary formats */
+	GLint nfmt = 0;
+	if (dst->get_program_binary && dst->program_binary)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nfmt);
+
+	if (nfmt <= 0){
+		dst->get_program_binary = NULL;
+		dst->program_binary = NULL;
+	}
+
 /* Texturing */
 	dst->gen_textures =
 		(void(*)(GLsizei, GLuint*))
@@ -230,12 +380,24 @@ void agp_glinit_fenv(struct agp_fenv* dst,
 	dst->delete_textures =
 		(void (*)(GLsizei, const GLuint*))
 			lookup(tag, "glDeleteTextures");
+
+	dst->state.bind_texture = dst->bind_texture;
+	dst->state.active_texture = dst->active_texture;
+	dst->state.delete_textures = dst->delete_textures;
+	dst->bind_texture = state_bind_texture;
+	dst->active_texture = state_active_texture;
+	dst->delete_textures = state_delete_textures;
+	initenv = dst;
+	agp_glinit_state_reset(dst);
 	dst->tex_subimage_2d = (void (*)(GLenum,
 		GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const GLvoid*))
 			lookup(tag, "glTexSubImage2D");
 	dst->tex_image_2d =	(void (*)(GLenum,
 		GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const GLvoid*))
 			lookup(tag, "glTexImage2D");
+	dst->compressed_tex_image_2d = (void (*)(GLenum,
+		GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei, const GLvoid*))
+			lookup_opt(tag, "glCompressedTexImage2D");
 	dst->tex_image_3d = (void (*)(
 		GLenum, GLint, GLint, GLsizei, GLsizei, GLsizei, GLint, GLenum, GLenum, const void*))
 			lookup(tag, "glTexImage3D");
@@ -114,11 +114,23 @@ struct agp_rendertarget
 /* used for multi-buffering mode */
 	bool rz_ack;
 	size_t n_stores;
-	size_t dirty_flip, dirty_region, dirty_region_decay;
+	size_t dirty_flip;
 	size_t store_ind;
 	struct agp_vstore* stores[MAX_BUFFERS];
 	struct agp_vstore* shadow[MAX_BUFFERS];
 
+/* damage for the current [0] and the previous [1] frame in framebuffer
+ * coordinates, the previous set is kept to cover double buffered consumers */
+	struct agp_region damage[2][AGP_DAMAGE_LIMIT];
+	size_t n_damage[2];
+
+/* contents can't be trusted (new, resized, swapped) until a full clear */
+	bool damage_reset;
+
+/* set when drawing has been restricted to a subregion of the viewport */
+	bool scissor_set;
+	struct agp_region scissor;
+
 	bool (*alloc)(struct agp_rendertarget*, struct agp_vstore*, int, void*);
 	void* alloc_tag;
 };
@@ -165,7 +177,8 @@ static void setup_stores(struct agp_rendertarget* dst)
 /* need this tracking because there's no external memory management for _back */
 	dst->n_stores = MAX_BUFFERS;
 	dst->dirty_flip = MAX_BUFFERS;
-	dst->dirty_region_decay = dst->dirty_region = 0;
+	dst->n_damage[0] = dst->n_damage[1] = 0;
+	dst->damage_reset = true;
 
 	TRACE_MARK_ONESHOT("agp", "setup-rtgt-vstore-swap",
 		TRACE_SYS_DEFAULT, (uintptr_t) dst, MAX_BUFFERS, "");
@@ -279,22 +292,105 @@ void agp_rendertarget_dropswap(struct agp_rendertarget* tgt)
 
 /* mark that we need to treat as dirty regardless of contents */
 	tgt->dirty_flip++;
+	tgt->damage_reset = true;
+}
+
+static void damage_add(struct agp_rendertarget* dst, struct agp_region reg)
+{
+	size_t w = dst->store->w;
+	size_t h = dst->store->h;
+
+	if (reg.x2 > w)
+		reg.x2 = w;
+	if (reg.y2 > h)
+		reg.y2 = h;
+	if (reg.x1 >= reg.x2 || reg.y1 >= reg.y2)
+		return;
+
+	struct agp_region* cur = dst->damage[0];
+	size_t* n = &dst->n_damage[0];
+
+/* the common case is the same region being marked by every draw call */
+	for (size_t i = 0; i < *n; i++){
+		if (reg.x1 >= cur[i].x1 && reg.x2 <= cur[i].x2 &&
+			reg.y1 >= cur[i].y1 && reg.y2 <= cur[i].y2)
+			return;
+	}
+
+	if (*n < AGP_DAMAGE_LIMIT){
+		cur[(*n)++] = reg;
+		return;
+	}
+
+/* out of slots, collapse into the bounding region */
+	for (size_t i = 0; i < *n; i++){
+		reg.x1 = cur[i].x1 < reg.x1 ? cur[i].x1 : reg.x1;
+		reg.y1 = cur[i].y1 < reg.y1 ? cur[i].y1 : reg.y1;
+		reg.x2 = cur[i].x2 > reg.x2 ? cur[i].x2 : reg.x2;
+		reg.y2 = cur[i].y2 > reg.y2 ? cur[i].y2 : reg.y2;
+	}
+	cur[0] = reg;
+	*n = 1;
 }
 
 size_t agp_rendertarget_dirty(
 	struct agp_rendertarget* dst, struct agp_region* dirty)
 {
-	if (!dst)
+	if (!dst || !dst->store)
 		return 0;
 
-/* rather unsofisticated, we could/should have a n-buffered merge-region
- * instead of this inc/dec/decay nonsense - but all in due course */
+/* an empty region covers whatever the draw calls are currently limited to */
 	if (dirty){
-		dst->dirty_region++;
-		dst->dirty_region_decay++;
+		struct agp_region reg = *dirty;
+		if (reg.x1 >= reg.x2 || reg.y1 >= reg.y2){
+			reg = dst->scissor_set ? dst->scissor : (struct agp_region){
+				.x2 = dst->store->w, .y2 = dst->store->h
+			};
+		}
+		damage_add(dst, reg);
+	}
+
+	return dst->n_damage[0] + dst->n_damage[1];
+}
+
+bool agp_rendertarget_scissor(
+	struct agp_rendertarget* tgt, struct agp_region* region)
+{
+	if (!tgt || !tgt->store)
+		return false;
+
+	struct agp_fenv* env = agp_env();
+	ssize_t* vp = tgt->viewport;
+
+	if (!region){
+		tgt->scissor_set = false;
+		if (tgt == active_rendertarget)
+			env->scissor(vp[0], vp[1], vp[2], vp[3]);
+		return true;
 	}
 
-	return dst->dirty_region_decay;
+/* partial updates need the previous contents to still be there, which is not
+ * the case for swapchains, buffers that were just reset or proxied output */
+	if (tgt->n_stores || tgt->damage_reset || tgt->proxy_state ||
+		vp[0] != 0 || vp[1] != 0 ||
+		vp[2] != tgt->store->w || vp[3] != tgt->store->h)
+		return false;
+
+	struct agp_region reg = *region;
+	if (reg.x2 > tgt->store->w)
+		reg.x2 = tgt->store->w;
+	if (reg.y2 > tgt->store->h)
+		reg.y2 = tgt->store->h;
+	if (reg.x1 >= reg.x2 || reg.y1 >= reg.y2)
+		return false;
+
+	tgt->scissor = reg;
+	tgt->scissor_set = true;
+
+	if (tgt == active_rendertarget)
+		env->scissor(reg.x1, reg.y1, reg.x2 - reg.x1, reg.y2 - reg.y1);
+
+	return true;
 }
 
 struct agp_vstore*
@@ -694,6 +790,8 @@ static bool update_cube(
 	}
 
 	backing->update_ts = arcan_timemillis();
+	backing->update_seq++;
+
 	env->bind_texture(GL_TEXTURE_CUBE_MAP, 0);
 	return true;
 }
@@ -730,79 +828,94 @@ bool agp_slice_synch(
 #define GL_RGB32F 0x8815
 #endif
 
-void agp_empty_vstoreext(struct agp_vstore* vs,
-	size_t w, size_t h, enum vstore_hint hint)
+enum vstore_hint agp_vstore_setformat(
+	struct agp_vstore* vs, enum vstore_hint hint)
 {
 	size_t bpp = 4;
+	vs->vinf.text.s_fmt = 0;
+	vs->vinf.text.s_type = 0;
 
 	switch (hint){
 	case VSTORE_HINT_LODEF:
-		verbose_print("(%"PRIxPTR") empty fmt: lodef", (uintptr_t) vs);
+		verbose_print("(%"PRIxPTR") fmt: lodef", (uintptr_t) vs);
 		vs->vinf.text.d_fmt = GL_RGB5_A1;
 		vs->vinf.text.s_fmt = GL_RGB;
 		vs->vinf.text.s_type = GL_UNSIGNED_SHORT;
 		bpp = 2;
 	break;
 	case VSTORE_HINT_LODEF_NOALPHA:
-		verbose_print("(%"PRIxPTR") empty fmt: lodef-no-alpha", (uintptr_t) vs);
+		verbose_print("(%"PRIxPTR") fmt: lodef-no-alpha", (uintptr_t) vs);
 		vs->vinf.text.d_fmt = GL_RGB565;
 		vs->vinf.text.s_fmt = GL_RGB;
 		vs->vinf.text.s_type = GL_UNSIGNED_SHORT;
 		bpp = 2;
 	break;
-	case VSTORE_HINT_NORMAL:
-	case VSTORE_HINT_NORMAL_NOALPHA:
-		verbose_print("(%"PRIxPTR") empty fmt: normal", (uintptr_t) vs);
-		vs->vinf.text.d_fmt = GL_STORE_PIXEL_FORMAT;
-	break;
-#if !defined(GLES2) && !defined(GLES3)
+#if !defined(GLES2)
+/* the packing matches DRM_FORMAT_ABGR2101010 / SHMIF_VFMT_RGB10A2 */
 	case VSTORE_HINT_HIDEF:
 	case VSTORE_HINT_HIDEF_NOALPHA:
+		verbose_print("(%"PRIxPTR") fmt: 10-bit", (uintptr_t) vs);
 		vs->vinf.text.d_fmt = GL_RGB10_A2;
-		vs->vinf.text.s_type = GL_UNSIGNED_INT_10_10_10_2;
+		vs->vinf.text.s_type = GL_UNSIGNED_INT_2_10_10_10_REV;
 		vs->vinf.text.s_fmt = GL_RGBA;
 		bpp = 4;
 	break;
 	case VSTORE_HINT_F16:
-		verbose_print("(%"PRIxPTR") empty fmt: half-float", (uintptr_t) vs);
+		verbose_print("(%"PRIxPTR") fmt: half-float", (uintptr_t) vs);
 		vs->vinf.text.d_fmt = GL_RGBA16F;
 		vs->vinf.text.s_type = GL_HALF_FLOAT;
 		vs->vinf.text.s_fmt = GL_RGBA;
 		bpp = 8;
 	break;
 	case VSTORE_HINT_F16_NOALPHA:
-		verbose_print("(%"PRIxPTR") empty fmt: half-float-no-alpha", (uintptr_t) vs);
+		verbose_print("(%"PRIxPTR") fmt: half-float-no-alpha", (uintptr_t) vs);
 		vs->vinf.text.d_fmt = GL_RGB16F;
 		vs->vinf.text.s_type = GL_HALF_FLOAT;
 		vs->vinf.text.s_fmt = GL_RGB;
 		bpp = 8;
 	break;
+#endif
+#if !defined(GLES2) && !defined(GLES3)
 	case VSTORE_HINT_F32:
-		verbose_print("(%"PRIxPTR") empty fmt: float", (uintptr_t) vs);
+		verbose_print("(%"PRIxPTR") fmt: float", (uintptr_t) vs);
 		vs->vinf.text.d_fmt = GL_RGB32F;
 		vs->vinf.text.s_type = GL_FLOAT;
 		vs->vinf.text.s_fmt = GL_RGBA;
 		bpp = 16;
 	break;
 	case VSTORE_HINT_F32_NOALPHA:
-		verbose_print("(%"PRIxPTR") empty fmt: float-no-alpha", (uintptr_t) vs);
+		verbose_print("(%"PRIxPTR") fmt: float-no-alpha", (uintptr_t) vs);
 		vs->vinf.text.d_fmt = GL_RGBA32F;
 		vs->vinf.text.s_type = GL_FLOAT;
 		vs->vinf.text.s_fmt = GL_RGB;
 		bpp = 16;
 	break;
 #endif
+	case VSTORE_HINT_NORMAL_NOALPHA:
+		verbose_print("(%"PRIxPTR") fmt: normal", (uintptr_t) vs);
+		vs->vinf.text.d_fmt = GL_STORE_PIXEL_FORMAT;
+	break;
 	default:
+		verbose_print("(%"PRIxPTR") fmt: normal", (uintptr_t) vs);
+		vs->vinf.text.d_fmt = GL_STORE_PIXEL_FORMAT;
+		hint = VSTORE_HINT_NORMAL;
 	break;
 	}
 
+	vs->bpp = bpp;
+	vs->hdr.depth = hint;
+	return hint;
+}
+
+void agp_empty_vstoreext(struct agp_vstore* vs,
+	size_t w, size_t h, enum vstore_hint hint)
+{
+	agp_vstore_setformat(vs, hint);
+
 /* note, the local source format is always the native shmif_pixel so that we
  * don't break one of the many functions that was built on this assumption */
 	vs->w = w;
 	vs->h = h;
-	vs->vinf.text.s_raw = w * h * bpp;
-	vs->bpp = bpp;
-
 	vs->vinf.text.s_raw = vs->bpp * vs->w * vs->h;
 
 /* note that alloc_mem VBUFFER assumes RGBA so we'd need to initialize the
@@ -836,6 +949,7 @@ bool agp_rendertarget_swapstore(
 		return true;
 
 	tgt->store = vstore;
+	tgt->damage_reset = true;
 	BIND_FRAMEBUFFER(tgt->fbo);
 
 	env->framebuffer_texture_2d(GL_FRAMEBUFFER,
@@ -865,6 +979,7 @@ struct agp_rendertarget* agp_setup_rendertarget(
 	r->clearcol[1] = 0.05;
 	r->clearcol[2] = 0.05;
 	r->clearcol[3] = 1.0;
+	r->damage_reset = true;
 	verbose_print("vstore (%"PRIxPTR") bound to rendertarget "
 		"(%"PRIxPTR") in mode %d", (uintptr_t) vstore, (uintptr_t) r, (int) m);
 
@@ -908,6 +1023,10 @@ void agp_dropenv(struct agp_fenv* env)
 	}
 	env->cookie = 0xdeadbeef;
 
+/* the GL names go with the context, only the bookkeeping needs to go */
+	arcan_mem_free(env->ulring);
+	env->ulring = NULL;
+
 	if (env != &defenv)
 		arcan_mem_free(env);
 
@@ -915,6 +1034,77 @@ void agp_dropenv(struct agp_fenv* env)
 		agp_setenv(NULL);
 }
 
+/* bitmap of enum agp_compressed_format, 0 bit unused */
+static unsigned compressed_formats;
+
+static GLenum compressed_glfmt(enum agp_compressed_format fmt)
+{
+	switch (fmt){
+	case AGP_COMPRESSED_ETC1: return GL_ETC1_RGB8_OES;
+	case AGP_COMPRESSED_DXT1: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	case AGP_COMPRESSED_DXT3: return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+	case AGP_COMPRESSED_DXT5: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	default:
+		return GL_NONE;
+	}
+}
+
+static void probe_compressed(struct agp_fenv* env)
+{
+	unsigned mask = 0;
+	GLint count = 0;
+
+	if (env->compressed_tex_image_2d)
+		env->get_integer_v(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+
+	if (count > 0){
+		GLint* formats = arcan_alloc_mem(sizeof(GLint) * count,
+			ARCAN_MEM_BINDING, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		env->get_integer_v(GL_COMPRESSED_TEXTURE_FORMATS, formats);
+
+		for (size_t i = 0; i < count; i++)
+			for (size_t j = AGP_COMPRESSED_ETC1; j <= AGP_COMPRESSED_DXT5; j++)
+				if (formats[i] == compressed_glfmt(j))
+					mask |= 1 << j;
+
+		arcan_mem_free(formats);
+	}
+
+	verbose_print("compressed formats: %x", mask);
+	compressed_formats = mask;
+}
+
+bool agp_compressed_support(enum agp_compressed_format fmt)
+{
+	return fmt != AGP_COMPRESSED_NONE && (compressed_formats & (1 << fmt));
+}
+
+size_t agp_compressed_size(enum agp_compressed_format fmt, size_t w, size_t h)
+{
+	size_t block = fmt == AGP_COMPRESSED_DXT3 || fmt == AGP_COMPRESSED_DXT5 ? 16 : 8;
+	return ((w + 3) / 4) * ((h + 3) / 4) * block;
+}
+
+static void upload_compressed(struct agp_vstore* s)
+{
+	struct agp_fenv* env = agp_env();
+	GLenum fmt = compressed_glfmt(s->vinf.text.compressed);
+	size_t w = s->w, h = s->h, ofs = 0;
+	size_t levels = s->vinf.text.mip_levels ? s->vinf.text.mip_levels : 1;
+
+	for (size_t i = 0; i < levels; i++){
+		size_t sz = agp_compressed_size(s->vinf.text.compressed, w, h);
+		if (ofs + sz > s->vinf.text.s_raw)
+			break;
+
+		env->compressed_tex_image_2d(GL_TEXTURE_2D, i, fmt, w, h, 0, sz,
+			(uint8_t*) s->vinf.text.raw + ofs);
+		ofs += sz;
+		w = w > 1 ? w >> 1 : 1;
+		h = h > 1 ? h >> 1 : 1;
+	}
+}
+
 void agp_init()
 {
 	struct agp_fenv* env = agp_env();
@@ -942,6 +1132,9 @@ void agp_init()
 
 	env->enable(GL_BLEND);
 	env->clear_color(0.0, 0.0, 0.0, 1.0f);
+	agp_glinit_state_reset(env);
+
+	probe_compressed(env);
 
 /*
  * -- Removed as they were causing trouble with NVidia GPUs (white line outline
@@ -1106,6 +1299,7 @@ void agp_activate_rendertarget(struct agp_rendertarget* tgt)
 			tgt->clearcol[1], tgt->clearcol[2], tgt->clearcol[3]);
 
 		ssize_t* vp = tgt->viewport;
+		tgt->scissor_set = false;
 		env->scissor(vp[0], vp[1], vp[2], vp[3]);
 		env->viewport(vp[0], vp[1], vp[2], vp[3]);
 
@@ -1122,18 +1316,20 @@ void agp_activate_rendertarget(struct agp_rendertarget* tgt)
 void agp_rendertarget_dirty_reset(
 	struct agp_rendertarget* src, struct agp_region* dst)
 {
-	for (size_t i = 0; i < src->dirty_region_decay && dst; i++){
-		dst[i] = (struct agp_region){
-			.x1 = 0, .y1 = 0,
-			.x2 = src->store->w, .y2 = src->store->h
-		};
+	if (!src)
+		return;
+
+/* previous frame first, then the current one - this assumes that consumers
+ * are at most double buffered */
+	if (dst){
+		memcpy(dst, src->damage[1], sizeof(struct agp_region) * src->n_damage[1]);
+		memcpy(&dst[src->n_damage[1]],
+			src->damage[0], sizeof(struct agp_region) * src->n_damage[0]);
 	}
 
-/* this assumes that we are double- buffered though the reality might be
- * more or less than that - so quick workaround now and do it for real a
- * bit later */
-	src->dirty_region_decay = src->dirty_region;
-	src->dirty_region = 0;
+	memcpy(src->damage[1], src->damage[0], sizeof(src->damage[0]));
+	src->n_damage[1] = src->n_damage[0];
+	src->n_damage[0] = 0;
 }
 
 void agp_rendertarget_clear()
@@ -1142,6 +1338,41 @@ void agp_rendertarget_clear()
 
 	agp_env()->clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	agp_rendertarget_dirty(active_rendertarget, &(struct agp_region){});
+
+/* a clear over the entire surface re-establishes known contents */
+	if (active_rendertarget && !active_rendertarget->scissor_set)
+		active_rendertarget->damage_reset = false;
+}
+
+void agp_rendertarget_subview(size_t index, size_t count)
+{
+	struct agp_rendertarget* tgt = active_rendertarget;
+	if (!tgt)
+		return;
+
+	struct agp_fenv* env = agp_env();
+	ssize_t* vp = tgt->viewport;
+	ssize_t x1 = vp[0], y1 = vp[1], x2 = vp[0] + vp[2], y2 = vp[1] + vp[3];
+
+	if (count && index < count){
+		ssize_t w = vp[2] / (ssize_t) count;
+		x1 = vp[0] + w * (ssize_t) index;
+		x2 = x1 + w;
+	}
+
+	env->viewport(x1, y1, x2 - x1, y2 - y1);
+
+/* keep the view from bleeding into the neighbour, but retain damage limits */
+	if (tgt->scissor_set){
+		if (x1 < (ssize_t) tgt->scissor.x1) x1 = tgt->scissor.x1;
+		if (y1 < (ssize_t) tgt->scissor.y1) y1 = tgt->scissor.y1;
+		if (x2 > (ssize_t) tgt->scissor.x2) x2 = tgt->scissor.x2;
+		if (y2 > (ssize_t) tgt->scissor.y2) y2 = tgt->scissor.y2;
+		if (x2 < x1) x2 = x1;
+		if (y2 < y1) y2 = y1;
+	}
+
+	env->scissor(x1, y1, x2 - x1, y2 - y1);
 }
 
 void agp_pipeline_hint(enum pipeline_mode mode)
@@ -1175,6 +1406,429 @@ void agp_pipeline_hint(enum pipeline_mode mode)
 	}
 }
 
+/*
+ * Readbacks go through a small ring of pack buffers per store, so that a new
+ * transfer can be queued while earlier ones are still in flight - e.g. an
+ * encoder still chewing on the previous frame. Each slot gets a fence when
+ * the GL has sync objects and that is polled with a zero timeout, so the map
+ * itself shouldn't stall. Without fences the oldest slot is assumed to be
+ * done and the map may block, which is what the single-PBO version did.
+ *
+ * GLES2 lacks pack buffers, there the transfer is a synchronous glReadPixels
+ * into the slot memory and the ring only decouples it from the consumer.
+ */
+#define RBRING_LIMIT 8
+static size_t rbring_depth = 3;
+
+struct rbslot {
+	GLuint pbo;
+	void* fence;
+	av_pixel* buf;
+	size_t w, h;
+};
+
+struct agp_rbring {
+	struct rbslot slots[RBRING_LIMIT];
+	size_t depth;
+
+/* next slot to fill and the number of slots in flight, the oldest one is the
+ * only one that can be mapped */
+	size_t head, count;
+	bool mapped;
+
+/* GLES has no glGetTexImage, the source texture is attached here instead */
+	GLuint fbo;
+};
+
+void agp_readback_ring(size_t depth)
+{
+	if (!depth)
+		depth = 1;
+	rbring_depth = depth > RBRING_LIMIT ? RBRING_LIMIT : depth;
+}
+
+static struct rbslot* rbring_tail(struct agp_rbring* ring)
+{
+	return &ring->slots[(ring->head + ring->depth - ring->count) % ring->depth];
+}
+
+static void drop_rbring(struct agp_vstore* s)
+{
+	struct agp_rbring* ring = s->vinf.text.rbring;
+	if (!ring)
+		return;
+
+/* deleting a mapped buffer implicitly unmaps it */
+	struct agp_fenv* env = agp_env();
+	for (size_t i = 0; i < ring->depth; i++){
+		struct rbslot* slot = &ring->slots[i];
+		if (slot->fence)
+			env->delete_sync(slot->fence);
+		if (slot->pbo != GL_NONE)
+			env->delete_buffers(1, &slot->pbo);
+		if (slot->buf)
+			arcan_mem_free(slot->buf);
+	}
+
+	if (ring->fbo != GL_NONE)
+		env->delete_framebuffers(1, &ring->fbo);
+
+	verbose_print("(%"PRIxPTR") dropped readback ring", (uintptr_t) s);
+	arcan_mem_free(ring);
+	s->vinf.text.rbring = NULL;
+}
+
+static bool rbslot_size(struct rbslot* slot, size_t w, size_t h)
+{
+	if (slot->w == w && slot->h == h)
+		return true;
+
+	size_t sz = w * h * sizeof(av_pixel);
+#ifdef GLES2
+	if (slot->buf)
+		arcan_mem_free(slot->buf);
+	slot->buf = arcan_alloc_mem(sz,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	if (!slot->buf){
+		slot->w = slot->h = 0;
+		return false;
+	}
+#else
+	struct agp_fenv* env = agp_env();
+	if (slot->pbo == GL_NONE)
+		env->gen_buffers(1, &slot->pbo);
+
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+	env->buffer_data(GL_PIXEL_PACK_BUFFER, sz, NULL, GL_STREAM_READ);
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+#endif
+
+	verbose_print("allocated %zu*%zu read slot", w, h);
+	slot->w = w;
+	slot->h = h;
+	return true;
+}
+
+static void rbslot_transfer(
+	struct agp_rbring* ring, struct rbslot* slot, struct agp_vstore* s)
+{
+	struct agp_fenv* env = agp_env();
+
+#if defined(GLES2) || defined(GLES3)
+	GLuint last = st_last_fbo;
+	if (ring->fbo == GL_NONE)
+		env->gen_framebuffers(1, &ring->fbo);
+
+	BIND_FRAMEBUFFER(ring->fbo);
+	env->framebuffer_texture_2d(GL_FRAMEBUFFER,
+		GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, agp_resolve_texid(s), 0);
+
+#ifdef GLES3
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+	env->read_pixels(0, 0,
+		slot->w, slot->h, GL_PIXEL_FORMAT, GL_UNSIGNED_BYTE, NULL);
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+#else
+	env->read_pixels(0, 0,
+		slot->w, slot->h, GL_PIXEL_FORMAT, GL_UNSIGNED_BYTE, slot->buf);
+#endif
+	BIND_FRAMEBUFFER(last);
+
+#else
+	env->bind_texture(GL_TEXTURE_2D, agp_resolve_texid(s));
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+	env->get_tex_image(GL_TEXTURE_2D, 0, GL_PIXEL_FORMAT, GL_UNSIGNED_BYTE, NULL);
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	env->bind_texture(GL_TEXTURE_2D, 0);
+#endif
+
+#ifndef GLES2
+	if (env->fence_sync)
+		slot->fence = env->fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+}
+
+bool agp_request_readback(struct agp_vstore* s)
+{
+	if (!s || s->txmapped != TXSTATE_TEX2D)
+		return false;
+
+	struct agp_rbring* ring = s->vinf.text.rbring;
+	if (!ring){
+		ring = arcan_alloc_mem(sizeof(struct agp_rbring),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+			ARCAN_MEMALIGN_NATURAL
+		);
+		if (!ring)
+			return false;
+
+		ring->depth = rbring_depth;
+		s->vinf.text.rbring = ring;
+	}
+
+/* every slot in flight, drop the frame rather than wait */
+	if (ring->count == ring->depth){
+		verbose_print("(%"PRIxPTR") readback ring full", (uintptr_t) s);
+		return false;
+	}
+
+	struct rbslot* slot = &ring->slots[ring->head];
+	if (!rbslot_size(slot, s->w, s->h))
+		return false;
+
+	verbose_print("(%"PRIxPTR":glid %u) readback => slot %zu",
+		(uintptr_t) s, (unsigned) s->vinf.text.glid, ring->head);
+
+	rbslot_transfer(ring, slot, s);
+	ring->head = (ring->head + 1) % ring->depth;
+	ring->count++;
+
+	return true;
+}
+
+static void rbring_release(void* tag)
+{
+	struct agp_rbring* ring = tag;
+	if (!ring || !ring->mapped)
+		return;
+
+#ifndef GLES2
+	struct agp_fenv* env = agp_env();
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, rbring_tail(ring)->pbo);
+	env->unmap_buffer(GL_PIXEL_PACK_BUFFER);
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+#endif
+
+	ring->mapped = false;
+	ring->count--;
+}
+
+struct asynch_readback_meta agp_poll_readback(struct agp_vstore* s)
+{
+	struct asynch_readback_meta res = {
+		.release = rbring_release
+	};
+
+	if (!s || s->txmapped != TXSTATE_TEX2D || !s->vinf.text.rbring)
+		return res;
+
+	struct agp_rbring* ring = s->vinf.text.rbring;
+	res.pending = ring->count;
+	if (!ring->count || ring->mapped)
+		return res;
+
+	struct rbslot* slot = rbring_tail(ring);
+	size_t sz = slot->w * slot->h * sizeof(av_pixel);
+
+#ifdef GLES2
+	res.ptr = slot->buf;
+#else
+	struct agp_fenv* env = agp_env();
+	if (slot->fence){
+		GLenum rv = env->client_wait_sync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (rv != GL_ALREADY_SIGNALED && rv != GL_CONDITION_SATISFIED)
+			return res;
+
+		env->delete_sync(slot->fence);
+		slot->fence = NULL;
+	}
+
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+	if (env->map_buffer_range)
+		res.ptr = env->map_buffer_range(GL_PIXEL_PACK_BUFFER, 0, sz, GL_MAP_READ_BIT);
+#ifndef GLES3
+	else
+		res.ptr = env->map_buffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+#endif
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+/* a failed map would otherwise wedge the ring, treat it as a dropped frame */
+	if (!res.ptr){
+		verbose_print("(%"PRIxPTR") couldn't map read slot", (uintptr_t) s);
+		ring->count--;
+		res.pending = ring->count;
+		return res;
+	}
+#endif
+
+	ring->mapped = true;
+	res.tag = ring;
+	res.w = slot->w;
+	res.h = slot->h;
+	res.stride = slot->w * sizeof(av_pixel);
+	res.buf_sz = sz;
+	res.pending = ring->count - 1;
+
+	return res;
+}
+
+/*
+ * Uploads can go through one persistently mapped (ARB_buffer_storage) unpack
+ * buffer per environment that is used as a ring. Each transfer takes the
+ * next range, copies the (damaged) rows in tightly packed and queues the
+ * texture update from the buffer followed by a fence. Ranges are reclaimed
+ * in order once their fences have signalled, if there is not enough space
+ * without waiting the caller falls back to the normal upload path instead.
+ */
+#define ULRING_FENCES 32
+#define ULRING_ALIGN 256
+static size_t ulring_size = 32 * 1024 * 1024;
+
+struct agp_ulring {
+	GLuint pbo;
+	uint8_t* map;
+	size_t size;
+	size_t head;
+
+/* in-flight ranges, oldest at [first] */
+	struct {
+		void* fence;
+		size_t start;
+	} pending[ULRING_FENCES];
+	size_t first, count;
+	bool broken;
+};
+
+void agp_upload_ring(size_t mb)
+{
+	ulring_size = mb * 1024 * 1024;
+}
+
+#ifndef GLES2
+static struct agp_ulring* ulring_get(struct agp_fenv* env)
+{
+	if (env->ulring)
+		return env->ulring->broken ? NULL : env->ulring;
+
+	if (!ulring_size || !env->buffer_storage || !env->map_buffer_range ||
+		!env->fence_sync)
+		return NULL;
+
+	struct agp_ulring* ring = arcan_alloc_mem(sizeof(struct agp_ulring),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL);
+	if (!ring)
+		return NULL;
+
+	env->ulring = ring;
+	GLbitfield flags =
+		GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	env->gen_buffers(1, &ring->pbo);
+	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, ring->pbo);
+	env->buffer_storage(GL_PIXEL_UNPACK_BUFFER, ulring_size, NULL, flags);
+	ring->map = env->map_buffer_range(GL_PIXEL_UNPACK_BUFFER, 0, ulring_size, flags);
+	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+/* keep the ring around but marked so we don't retry every upload */
+	if (!ring->map){
+		verbose_print("couldn't map upload ring, disabled");
+		env->delete_buffers(1, &ring->pbo);
+		ring->pbo = GL_NONE;
+		ring->broken = true;
+		return NULL;
+	}
+
+	ring->size = ulring_size;
+	verbose_print("upload ring of %zu bytes mapped", ring->size);
+	return ring;
+}
+
+static void ulring_retire(struct agp_fenv* env, struct agp_ulring* ring)
+{
+	while (ring->count){
+		void* fence = ring->pending[ring->first].fence;
+		GLenum rv = env->client_wait_sync(fence, 0, 0);
+		if (rv != GL_ALREADY_SIGNALED && rv != GL_CONDITION_SATISFIED)
+			return;
+
+		env->delete_sync(fence);
+		ring->first = (ring->first + 1) % ULRING_FENCES;
+		ring->count--;
+	}
+}
+
+/* find [sz] contiguous bytes between head and the oldest in-flight range */
+static bool ulring_alloc(struct agp_ulring* ring, size_t sz, size_t* ofs)
+{
+	if (sz > ring->size || ring->count == ULRING_FENCES)
+		return false;
+
+	if (!ring->count){
+		ring->head = 0;
+		*ofs = 0;
+		return true;
+	}
+
+	size_t tail = ring->pending[ring->first].start;
+	if (ring->head >= tail){
+		if (ring->size - ring->head >= sz){
+			*ofs = ring->head;
+			return true;
+		}
+		if (tail >= sz){
+			*ofs = 0;
+			return true;
+		}
+		return false;
+	}
+
+	if (tail - ring->head >= sz){
+		*ofs = ring->head;
+		return true;
+	}
+
+	return false;
+}
+#endif
+
+bool agp_ulring_upload(struct agp_vstore* s,
+	const void* buf, size_t x, size_t y, size_t w, size_t h)
+{
+#ifdef GLES2
+	return false;
+#else
+	struct agp_fenv* env = agp_env();
+	struct agp_ulring* ring = ulring_get(env);
+	if (!ring || !w || !h)
+		return false;
+
+	ulring_retire(env, ring);
+
+	size_t row_sz = w * sizeof(av_pixel);
+	size_t sz = (row_sz * h + ULRING_ALIGN - 1) & ~(size_t)(ULRING_ALIGN - 1);
+	size_t ofs;
+	if (!ulring_alloc(ring, sz, &ofs)){
+		verbose_print("(%"PRIxPTR") upload ring full", (uintptr_t) s);
+		return false;
+	}
+
+	const av_pixel* src = buf;
+	uint8_t* dst = &ring->map[ofs];
+	for (size_t row = y; row < y + h; row++, dst += row_sz)
+		memcpy(dst, &src[row * s->w + x], row_sz);
+
+	agp_activate_vstore(s);
+	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, ring->pbo);
+	env->tex_subimage_2d(GL_TEXTURE_2D, 0, x, y, w, h,
+		s->vinf.text.s_fmt ? s->vinf.text.s_fmt : GL_PIXEL_FORMAT,
+		GL_UNSIGNED_BYTE, (void*)(uintptr_t) ofs
+	);
+	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	agp_deactivate_vstore();
+
+	size_t slot = (ring->first + ring->count) % ULRING_FENCES;
+	ring->pending[slot].fence = env->fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ring->pending[slot].start = ofs;
+	ring->count++;
+	ring->head = ofs + sz;
+
+	verbose_print("(%"PRIxPTR") ring upload %zu+%zu*%zu+%zu @ %zu",
+		(uintptr_t) s, x, w, y, h, ofs);
+	return true;
+#endif
+}
+
 void agp_null_vstore(struct agp_vstore* store)
 {
 /* the txmapped property here might be problematic when it comes to
@@ -1192,10 +1846,7 @@ void agp_null_vstore(struct agp_vstore* store)
 	store->vinf.text.glid_proxy = NULL;
 
 /* null out any pending PBOs as well, those get re-allocated on demand */
-	if (GL_NONE != store->vinf.text.rid){
-		env->delete_buffers(1, &store->vinf.text.rid);
-		store->vinf.text.rid = GL_NONE;
-	}
+	drop_rbring(store);
 
 #ifndef GLES2
 	if (GL_NONE != store->vinf.text.wid){
@@ -1217,6 +1868,7 @@ void agp_rendertarget_viewport(struct agp_rendertarget* tgt,
 	tgt->viewport[1] = y1;
 	tgt->viewport[2] = x2;
 	tgt->viewport[3] = y2;
+	tgt->damage_reset = true;
 }
 
 void agp_resize_rendertarget(
@@ -1252,6 +1904,8 @@ void agp_resize_rendertarget(
 	tgt->viewport[2] = neww;
 	tgt->viewport[3] = newh;
 	tgt->rz_ack = true;
+	tgt->damage_reset = true;
+	tgt->n_damage[0] = tgt->n_damage[1] = 0;
 
 	if (tgt->n_stores){
 		for (size_t i = 0; i < tgt->n_stores; i++){
@@ -1354,10 +2008,16 @@ void agp_update_vstore(struct agp_vstore* s, bool copy)
 	int filtermode = s->filtermode & (~ARCAN_VFILTER_MIPMAP);
 	bool mipmap = s->filtermode & ARCAN_VFILTER_MIPMAP;
 
+/* compressed stores can't have levels generated, only use what they carry */
+	bool compressed = s->vinf.text.compressed &&
+		agp_compressed_support(s->vinf.text.compressed);
+	if (compressed)
+		mipmap = mipmap && s->vinf.text.mip_levels > 1;
+
 /*
  * Mipmapping still misses the option to manually define mipmap levels
  */
-	if (copy){
+	if (copy && !compressed){
 #ifndef GL_GENERATE_MIPMAP
 		if (mipmap)
 			env->generate_mipmap(GL_TEXTURE_2D);
@@ -1404,9 +2064,13 @@ void agp_update_vstore(struct agp_vstore* s, bool copy)
 		env->pixel_storei(GL_UNPACK_ROW_LENGTH, 0);
 #endif
 		s->update_ts = arcan_timemillis();
+		s->update_seq++;
 		if (s->txmapped == TXSTATE_DEPTH)
 			env->tex_image_2d(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, s->w, s->h, 0,
 				GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0);
+		else if (compressed){
+			upload_compressed(s);
+		}
 		else
 			env->tex_image_2d(GL_TEXTURE_2D, 0,
 				s->vinf.text.d_fmt ? s->vinf.text.d_fmt : GL_STORE_PIXEL_FORMAT,
@@ -1437,6 +2101,7 @@ void agp_prepare_stencil()
 	struct agp_fenv* env = agp_env();
 	env->enable(GL_STENCIL_TEST);
 	env->disable(GL_BLEND);
+	env->state.blend_mode = -1;
 	env->clear_stencil(0);
 	env->clear(GL_STENCIL_BUFFER_BIT);
 	env->color_mask(0, 0, 0, 0);
@@ -1468,6 +2133,17 @@ void agp_blendstate(enum arcan_blendfunc mode)
 {
 	struct agp_fenv* env = agp_env();
 
+/* the alpha channel factors come from the rendertarget so they are part of
+ * the cached state as well */
+	if (env->state.blend_mode == mode &&
+		env->state.blend_src_alpha == env->blend_src_alpha &&
+		env->state.blend_dst_alpha == env->blend_dst_alpha)
+		return;
+
+	env->state.blend_mode = mode;
+	env->state.blend_src_alpha = env->blend_src_alpha;
+	env->state.blend_dst_alpha = env->blend_dst_alpha;
+
 	if (mode == BLEND_NONE){
 		env->disable(GL_BLEND);
 		return;
@@ -1569,6 +2245,39 @@ void agp_draw_vobj(
 	agp_rendertarget_dirty(active_rendertarget, &(struct agp_region){});
 }
 
+void agp_draw_quads(const float* verts, const float* txcos, size_t n)
+{
+	verbose_print("draw-quads(%zu)", n);
+	struct agp_fenv* env = agp_env();
+
+	if (!n)
+		return;
+
+	agp_shader_envv(MODELVIEW_MATR, ident, sizeof(float) * 16);
+
+	GLint attrindv = agp_shader_vattribute_loc(ATTRIBUTE_VERTEX);
+	GLint attrindt = agp_shader_vattribute_loc(ATTRIBUTE_TEXCORD0);
+
+	if (attrindv != -1){
+		env->enable_vertex_attrarray(attrindv);
+		env->vertex_attrpointer(attrindv, 4, GL_FLOAT, GL_FALSE, 0, verts);
+
+		if (attrindt != -1){
+			env->enable_vertex_attrarray(attrindt);
+			env->vertex_attrpointer(attrindt, 2, GL_FLOAT, GL_FALSE, 0, txcos);
+		}
+
+		env->draw_arrays(GL_TRIANGLES, 0, n * 6);
+
+		if (attrindt != -1)
+			env->disable_vertex_attrarray(attrindt);
+
+		env->disable_vertex_attrarray(attrindv);
+	}
+
+	agp_rendertarget_dirty(active_rendertarget, &(struct agp_region){});
+}
+
 static void toggle_debugstates(float* modelview)
 {
 	struct agp_fenv* env = agp_env();
@@ -1608,8 +2317,233 @@ void agp_render_options(struct agp_render_options opts)
 	env->line_width(opts.line_width);
 }
 
+static GLenum vertex_type(struct agp_mesh_store* base, uint8_t fmt, GLboolean* nrm)
+{
+	*nrm = GL_FALSE;
+	if (!base->stride)
+		return GL_FLOAT;
+
+	switch (fmt){
+	case AGP_VFMT_S16N: *nrm = GL_TRUE; return GL_SHORT;
+	case AGP_VFMT_U16N: *nrm = GL_TRUE; return GL_UNSIGNED_SHORT;
+	case AGP_VFMT_S8N: *nrm = GL_TRUE; return GL_BYTE;
+	case AGP_VFMT_U8N: *nrm = GL_TRUE; return GL_UNSIGNED_BYTE;
+	default:
+		return GL_FLOAT;
+	}
+}
+
+static unsigned mesh_index(struct agp_mesh_store* base, size_t i)
+{
+	if (base->index_size == 2)
+		return ((uint16_t*) base->indices)[i];
+	return base->indices[i];
+}
+
+/*
+ * Stream meshes keep their attributes in a vertex buffer. With buffer storage
+ * and sync support the buffer holds MESH_SLICES copies of the shared_buffer,
+ * persistently mapped, and each update goes into the next slice the GPU is
+ * done with, copying only what has changed since that slice was written.
+ * Otherwise the buffer is respecified (orphaned) with all of it on update.
+ */
+#define MESH_SLICES 3
+
+struct mesh_stream {
+	GLuint vbo;
+	uint8_t* map;
+	size_t size;
+	size_t cur;
+
+/* [lo, hi) of the shared_buffer that is newer than the copy in the slice */
+	struct {
+		void* fence;
+		size_t lo, hi;
+	} slice[MESH_SLICES];
+};
+
+static bool stream_inside(struct agp_mesh_store* base)
+{
+	uintptr_t lo = (uintptr_t) base->shared_buffer;
+	uintptr_t hi = lo + base->shared_buffer_sz;
+	uintptr_t attrs[] = {
+		(uintptr_t) base->verts, (uintptr_t) base->txcos,
+		(uintptr_t) base->txcos2, (uintptr_t) base->normals,
+		(uintptr_t) base->colors, (uintptr_t) base->tangents,
+		(uintptr_t) base->bitangents, (uintptr_t) base->weights,
+		(uintptr_t) base->joints
+	};
+
+	if (!lo || !base->shared_buffer_sz)
+		return false;
+
+	for (size_t i = 0; i < COUNT_OF(attrs); i++)
+		if (attrs[i] && (attrs[i] < lo || attrs[i] >= hi))
+			return false;
+
+	return true;
+}
+
+static struct mesh_stream* stream_get(
+	struct agp_fenv* env, struct agp_mesh_store* base)
+{
+	if (base->opaque)
+		return (struct mesh_stream*) base->opaque;
+
+/* not eligible, fall back to client side arrays for good */
+	if (!stream_inside(base) || !env->gen_buffers){
+		base->stream = false;
+		return NULL;
+	}
+
+	struct mesh_stream* ms = arcan_alloc_mem(sizeof(struct mesh_stream),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL);
+	if (!ms){
+		base->stream = false;
+		return NULL;
+	}
+
+	ms->size = base->shared_buffer_sz;
+	env->gen_buffers(1, &ms->vbo);
+	env->bind_buffer(GL_ARRAY_BUFFER, ms->vbo);
+
+#ifndef GLES2
+	if (env->buffer_storage && env->map_buffer_range && env->fence_sync){
+		GLbitfield flags =
+			GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		env->buffer_storage(GL_ARRAY_BUFFER, ms->size * MESH_SLICES, NULL, flags);
+		ms->map = env->map_buffer_range(
+			GL_ARRAY_BUFFER, 0, ms->size * MESH_SLICES, flags);
+
+/* the storage is immutable, so start over with a plain buffer */
+		if (!ms->map){
+			verbose_print("(%"PRIxPTR") couldn't map, orphaning", (uintptr_t) base);
+			env->bind_buffer(GL_ARRAY_BUFFER, 0);
+			env->delete_buffers(1, &ms->vbo);
+			env->gen_buffers(1, &ms->vbo);
+			env->bind_buffer(GL_ARRAY_BUFFER, ms->vbo);
+		}
+	}
+#endif
+
+	if (ms->map){
+		for (size_t i = 0; i < MESH_SLICES; i++){
+			ms->slice[i].lo = 0;
+			ms->slice[i].hi = ms->size;
+		}
+		ms->cur = MESH_SLICES - 1;
+		base->dirty = true;
+	}
+	else {
+		env->buffer_data(GL_ARRAY_BUFFER,
+			ms->size, base->shared_buffer, GL_STREAM_DRAW);
+		base->dirty = false;
+	}
+
+	env->bind_buffer(GL_ARRAY_BUFFER, 0);
+	base->opaque = (uintptr_t) ms;
+	verbose_print("(%"PRIxPTR") stream buffer of %zu bytes%s",
+		(uintptr_t) base, ms->size, ms->map ? ", mapped" : "");
+
+	return ms;
+}
+
+static void stream_update(struct agp_fenv* env,
+	struct agp_mesh_store* base, struct mesh_stream* ms)
+{
+	if (!base->dirty)
+		return;
+
+	if (!ms->map){
+		env->bind_buffer(GL_ARRAY_BUFFER, ms->vbo);
+		env->buffer_data(GL_ARRAY_BUFFER,
+			ms->size, base->shared_buffer, GL_STREAM_DRAW);
+		env->bind_buffer(GL_ARRAY_BUFFER, 0);
+		base->dirty = false;
+		return;
+	}
+
+#ifndef GLES2
+/* if the GPU is still reading the next slice, draw the current one again
+ * and retry on the next submission rather than stall */
+	size_t next = (ms->cur + 1) % MESH_SLICES;
+	if (ms->slice[next].fence){
+		GLenum rv = env->client_wait_sync(ms->slice[next].fence, 0, 0);
+		if (rv != GL_ALREADY_SIGNALED && rv != GL_CONDITION_SATISFIED){
+			verbose_print("(%"PRIxPTR") slice %zu busy", (uintptr_t) base, next);
+			return;
+		}
+		env->delete_sync(ms->slice[next].fence);
+		ms->slice[next].fence = NULL;
+	}
+
+	size_t lo = ms->slice[next].lo;
+	size_t hi = ms->slice[next].hi;
+	if (hi > lo)
+		memcpy(&ms->map[next * ms->size + lo], &base->shared_buffer[lo], hi - lo);
+
+	ms->slice[next].lo = ms->size;
+	ms->slice[next].hi = 0;
+	ms->cur = next;
+	base->dirty = false;
+#endif
+}
+
+/* bind the buffer of a stream mesh, returns what to add to the attribute
+ * pointers to make them offsets into the current slice */
+static intptr_t stream_bind(struct agp_fenv* env, struct agp_mesh_store* base)
+{
+	struct mesh_stream* ms = (struct mesh_stream*) base->opaque;
+	if (!base->stream || !ms)
+		return 0;
+
+	env->bind_buffer(GL_ARRAY_BUFFER, ms->vbo);
+	size_t ofs = ms->map ? ms->cur * ms->size : 0;
+	return (intptr_t) ofs - (intptr_t) base->shared_buffer;
+}
+
+/* mark when the GPU is done with the slice that was just drawn from */
+static void stream_fence(struct agp_fenv* env, struct agp_mesh_store* base)
+{
+#ifndef GLES2
+	struct mesh_stream* ms = (struct mesh_stream*) base->opaque;
+	if (!base->stream || !ms || !ms->map)
+		return;
+
+	if (ms->slice[ms->cur].fence)
+		env->delete_sync(ms->slice[ms->cur].fence);
+	ms->slice[ms->cur].fence = env->fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+}
+
+static void stream_drop(struct agp_fenv* env, struct agp_mesh_store* base)
+{
+	struct mesh_stream* ms = (struct mesh_stream*) base->opaque;
+	if (!ms)
+		return;
+
+#ifndef GLES2
+	for (size_t i = 0; i < MESH_SLICES; i++)
+		if (ms->slice[i].fence)
+			env->delete_sync(ms->slice[i].fence);
+
+	if (ms->map){
+		env->bind_buffer(GL_ARRAY_BUFFER, ms->vbo);
+		env->unmap_buffer(GL_ARRAY_BUFFER);
+		env->bind_buffer(GL_ARRAY_BUFFER, 0);
+	}
+#endif
+
+	env->delete_buffers(1, &ms->vbo);
+	arcan_mem_free(ms);
+	base->opaque = 0;
+}
+
 static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 {
+	GLboolean nrm;
+	GLenum type;
 	struct agp_fenv* env = agp_env();
 	int attribs[] = {
 		agp_shader_vattribute_loc(ATTRIBUTE_VERTEX),
@@ -1624,17 +2558,22 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 	};
 	if (attribs[0] == -1)
 		return;
-	else {
-		verbose_print("vertex");
-		env->enable_vertex_attrarray(attribs[0]);
-		env->vertex_attrpointer(attribs[0],
-			base->vertex_size, GL_FLOAT, GL_FALSE, 0, base->verts);
-	}
+
+	bool streamed = base->stream && base->opaque;
+	intptr_t delta = stream_bind(env, base);
+#define ATTR(X) ((void*)((uintptr_t)(X) + delta))
+
+	verbose_print("vertex");
+	env->enable_vertex_attrarray(attribs[0]);
+	env->vertex_attrpointer(attribs[0],
+		base->vertex_size, GL_FLOAT, GL_FALSE, base->stride, ATTR(base->verts));
 
 	if (attribs[1] != -1 && base->normals){
 		verbose_print("normals");
 		env->enable_vertex_attrarray(attribs[1]);
-		env->vertex_attrpointer(attribs[1], 3, GL_FLOAT, GL_FALSE,0, base->normals);
+		type = vertex_type(base, base->fmt.normals, &nrm);
+		env->vertex_attrpointer(attribs[1],
+			3, type, nrm, base->stride, ATTR(base->normals));
 	}
 	else
 		attribs[1] = -1;
@@ -1642,7 +2581,9 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 	if (attribs[2] != -1 && base->txcos){
 		verbose_print("texture-coordinates");
 		env->enable_vertex_attrarray(attribs[2]);
-		env->vertex_attrpointer(attribs[2], 2, GL_FLOAT, GL_FALSE, 0, base->txcos);
+		type = vertex_type(base, base->fmt.txcos, &nrm);
+		env->vertex_attrpointer(attribs[2],
+			2, type, nrm, base->stride, ATTR(base->txcos));
 	}
 	else
 		attribs[2] = -1;
@@ -1650,7 +2591,9 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 	if (attribs[3] != -1 && base->colors){
 		verbose_print("colors");
 		env->enable_vertex_attrarray(attribs[3]);
-		env->vertex_attrpointer(attribs[3], 3, GL_FLOAT, GL_FALSE, 0, base->colors);
+		type = vertex_type(base, base->fmt.colors, &nrm);
+		env->vertex_attrpointer(attribs[3], base->fmt.n_colors ? base->fmt.n_colors : 3,
+			type, nrm, base->stride, ATTR(base->colors));
 	}
 	else
 		attribs[3] = -1;
@@ -1658,7 +2601,7 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 	if (attribs[4] != -1 && base->txcos2){
 		verbose_print("texture-coordinates-alt");
 		env->enable_vertex_attrarray(attribs[4]);
-		env->vertex_attrpointer(attribs[4], 2, GL_FLOAT, GL_FALSE, 0, base->txcos2);
+		env->vertex_attrpointer(attribs[4], 2, GL_FLOAT, GL_FALSE, 0, ATTR(base->txcos2));
 	}
 	else
 		attribs[4] = -1;
@@ -1666,7 +2609,7 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 	if (attribs[5] != -1 && base->tangents){
 		verbose_print("tangents");
 		env->enable_vertex_attrarray(attribs[5]);
-		env->vertex_attrpointer(attribs[5],4,GL_FLOAT,GL_FALSE,0,base->tangents);
+		env->vertex_attrpointer(attribs[5],4,GL_FLOAT,GL_FALSE,0,ATTR(base->tangents));
 	}
 	else
 		attribs[5] = -1;
@@ -1674,7 +2617,7 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 	if (attribs[6] != -1 && base->bitangents){
 		verbose_print("bitangents");
 		env->enable_vertex_attrarray(attribs[6]);
-		env->vertex_attrpointer(attribs[6],4,GL_FLOAT,GL_FALSE,0,base->bitangents);
+		env->vertex_attrpointer(attribs[6],4,GL_FLOAT,GL_FALSE,0,ATTR(base->bitangents));
 	}
 	else
 		attribs[6] = -1;
@@ -1682,7 +2625,7 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 	if (attribs[7] != -1 && base->weights){
 		verbose_print("vertex-weights");
 		env->enable_vertex_attrarray(attribs[7]);
-		env->vertex_attrpointer(attribs[7], 4, GL_FLOAT, GL_FALSE, 0,base->weights);
+		env->vertex_attrpointer(attribs[7], 4, GL_FLOAT, GL_FALSE, 0,ATTR(base->weights));
 	}
 	else
 		attribs[7] = -1;
@@ -1690,7 +2633,7 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 	if (attribs[8] != -1 && base->joints){
 		verbose_print("vertex-joints");
 		env->enable_vertex_attrarray(attribs[8]);
-		env->vertex_iattrpointer(attribs[8], 4, GL_UNSIGNED_SHORT, 0, base->joints);
+		env->vertex_iattrpointer(attribs[8], 4, GL_UNSIGNED_SHORT, 0, ATTR(base->joints));
 	}
 	else
 		attribs[8] = -1;
@@ -1700,10 +2643,10 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 			if (!base->validated){
 				static bool warned;
 				for (size_t i = 0; i < base->n_indices; i++){
-					if (base->indices[i] > base->n_vertices){
+					if (mesh_index(base, i) > base->n_vertices){
 						if (!warned){
 							arcan_warning("agp_submit_mesh(), " "refusing mesh with OOB indices "
-								"(%zu=>%zu/%zu\n", i, base->indices[i], base->n_vertices);
+								"(%zu=>%u/%zu\n", i, mesh_index(base, i), base->n_vertices);
 							warned = true;
 						}
 						return;
@@ -1713,8 +2656,8 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 			}
 			verbose_print(
 				"triangle-soup(indexed, %u indices)", (unsigned)base->n_indices);
-			env->draw_elements(GL_TRIANGLES,
-				base->n_indices, GL_UNSIGNED_INT, base->indices);
+			env->draw_elements(GL_TRIANGLES, base->n_indices,
+				base->index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, base->indices);
 		}
 		else{
 			verbose_print(
@@ -1729,6 +2672,10 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 		env->disable(GL_VERTEX_PROGRAM_POINT_SIZE);
 	}
 
+	if (streamed)
+		env->bind_buffer(GL_ARRAY_BUFFER, 0);
+#undef ATTR
+
 	for (size_t i = 0; i < sizeof(attribs) / sizeof(attribs[0]); i++)
 		if (attribs[i] != -1)
 			env->disable_vertex_attrarray(attribs[i]);
@@ -1761,10 +2708,7 @@ void agp_drop_vstore(struct agp_vstore* s)
 	env->delete_textures(1, &s->vinf.text.glid);
 	s->vinf.text.glid = GL_NONE;
 
-	if (GL_NONE != s->vinf.text.rid){
-		env->delete_buffers(1, &s->vinf.text.rid);
-		s->vinf.text.rid = GL_NONE;
-	}
+	drop_rbring(s);
 
 #ifndef GLES2
 	if (GL_NONE != s->vinf.text.wid){
@@ -1822,8 +2766,10 @@ void agp_submit_mesh(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 /* make sure the current program actually uses the attributes from the mesh */
 	struct agp_fenv* env = agp_env();
 
-/* ignore for now */
-	if (base->dirty)
+	struct mesh_stream* ms = base->stream ? stream_get(env, base) : NULL;
+	if (ms)
+		stream_update(env, base, ms);
+	else
 		base->dirty = false;
 
 	if (fl != env->model_flags){
@@ -1846,6 +2792,7 @@ void agp_submit_mesh(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 				env->color_mask(true, true, true, true);
 				setup_transfer(base, fl);
 				env->polygon_mode(GL_FRONT_AND_BACK, GL_FILL);
+				stream_fence(env, base);
 #else
 /* no wireframe support for GLES */
 #endif
@@ -1863,6 +2810,7 @@ void agp_submit_mesh(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 	}
 
 	setup_transfer(base, fl);
+	stream_fence(env, base);
 	agp_rendertarget_dirty(active_rendertarget, &(struct agp_region){});
 }
 
@@ -1873,6 +2821,156 @@ void agp_submit_mesh(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 void agp_invalidate_mesh(struct agp_mesh_store* bs)
 {
 	verbose_print("(%"PRIxPTR")", (uintptr_t) bs);
+	agp_invalidate_mesh_range(bs, 0, bs->shared_buffer_sz);
+}
+
+void agp_invalidate_mesh_range(struct agp_mesh_store* bs, size_t ofs, size_t len)
+{
+	bs->dirty = true;
+
+/* the orphaning path always sends all of it */
+	struct mesh_stream* ms = (struct mesh_stream*) bs->opaque;
+	if (!ms || !ms->map)
+		return;
+
+	if (ofs > ms->size)
+		ofs = ms->size;
+	if (len > ms->size - ofs)
+		len = ms->size - ofs;
+
+	for (size_t i = 0; i < MESH_SLICES; i++){
+		if (ofs < ms->slice[i].lo)
+			ms->slice[i].lo = ofs;
+		if (ofs + len > ms->slice[i].hi)
+			ms->slice[i].hi = ofs + len;
+	}
+}
+
+/* GLES3 only has the boolean form, that's all we need anyhow */
+#if defined(GLES3)
+#define OCCLUSION_TARGET GL_ANY_SAMPLES_PASSED
+#else
+#define OCCLUSION_TARGET GL_SAMPLES_PASSED
+#endif
+
+static bool occlusion_proxy;
+
+unsigned agp_occlusion_alloc()
+{
+	struct agp_fenv* env = agp_env();
+	if (!env->gen_queries)
+		return 0;
+
+	GLuint id = 0;
+	env->gen_queries(1, &id);
+	verbose_print("query: %u", (unsigned) id);
+	return id;
+}
+
+void agp_occlusion_free(unsigned id)
+{
+	struct agp_fenv* env = agp_env();
+	if (!id || !env->delete_queries)
+		return;
+
+	GLuint qid = id;
+	env->delete_queries(1, &qid);
+}
+
+void agp_occlusion_begin(unsigned id, bool proxy)
+{
+	struct agp_fenv* env = agp_env();
+	if (!id || !env->begin_query)
+		return;
+
+	if (proxy){
+		env->color_mask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		env->depth_mask(GL_FALSE);
+		occlusion_proxy = true;
+	}
+
+	env->begin_query(OCCLUSION_TARGET, id);
+}
+
+void agp_occlusion_end()
+{
+	struct agp_fenv* env = agp_env();
+	if (!env->end_query)
+		return;
+
+	env->end_query(OCCLUSION_TARGET);
+
+	if (occlusion_proxy){
+		env->color_mask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		env->depth_mask(GL_TRUE);
+		occlusion_proxy = false;
+	}
+}
+
+int agp_occlusion_result(unsigned id)
+{
+	struct agp_fenv* env = agp_env();
+	if (!id || !env->get_query_objectuiv)
+		return 1;
+
+	GLuint avail = 0;
+	env->get_query_objectuiv(id, GL_QUERY_RESULT_AVAILABLE, &avail);
+	if (!avail)
+		return -1;
+
+	GLuint samples = 0;
+	env->get_query_objectuiv(id, GL_QUERY_RESULT, &samples);
+	return samples > 0;
+}
+
+unsigned agp_timer_alloc()
+{
+	struct agp_fenv* env = agp_env();
+	if (!env->get_query_objectui64v)
+		return 0;
+
+	GLuint id = 0;
+	env->gen_queries(1, &id);
+	return id;
+}
+
+void agp_timer_free(unsigned id)
+{
+	agp_occlusion_free(id);
+}
+
+void agp_timer_begin(unsigned id)
+{
+	struct agp_fenv* env = agp_env();
+	if (!id || !env->get_query_objectui64v)
+		return;
+
+	env->begin_query(GL_TIME_ELAPSED, id);
+}
+
+void agp_timer_end()
+{
+	struct agp_fenv* env = agp_env();
+	if (!env->get_query_objectui64v)
+		return;
+
+	env->end_query(GL_TIME_ELAPSED);
+}
+
+int64_t agp_timer_result(unsigned id)
+{
+	struct agp_fenv* env = agp_env();
+	if (!id || !env->get_query_objectui64v)
+		return -1;
+
+	GLuint avail = 0;
+	env->get_query_objectuiv(id, GL_QUERY_RESULT_AVAILABLE, &avail);
+	if (!avail)
+		return -1;
+
+	uint64_t ns = 0;
+	env->get_query_objectui64v(id, GL_QUERY_RESULT, &ns);
+	return ns > INT64_MAX ? INT64_MAX : (int64_t) ns;
 }
 
 void agp_activate_vstore(struct agp_vstore* s)
@@ -1917,6 +3015,7 @@ void agp_rendertarget_clearcolor(
 	tgt->clearcol[1] = g;
 	tgt->clearcol[2] = b;
 	tgt->clearcol[3] = a;
+	tgt->damage_reset = true;
 }
 
 void agp_drop_mesh(struct agp_mesh_store* s)
@@ -1924,6 +3023,9 @@ void agp_drop_mesh(struct agp_mesh_store* s)
 	if (!s)
 		return;
 
+	if (s->opaque)
+		stream_drop(agp_env(), s);
+
 	uintptr_t targets[] = {
 		(uintptr_t) s->verts, (uintptr_t) s->txcos,
 		(uintptr_t) s->txcos2, (uintptr_t) s->normals,
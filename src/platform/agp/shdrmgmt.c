@@ -13,6 +13,8 @@
 #include <string.h>
 #include <stddef.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
 
 #include "glfun.h"
 
@@ -28,7 +30,7 @@
 #define FLAG_DIRTY()
 #endif
 
-#define TBLSIZE (1 + TIMESTAMP_D - MODELVIEW_MATR)
+#define TBLSIZE (1 + VR_REPROJECT - MODELVIEW_MATR)
 
 /* all current global shader settings,
  * updated whenever a vobj/3dobj needs a different state
@@ -53,6 +55,8 @@ struct shader_envts {
 /* system values, don't change this order */
 	float fract_timestamp;
 	arcan_tickv timestamp;
+
+	float vr_reproject[16];
 };
 
 static int ofstbl[TBLSIZE] = {
@@ -75,7 +79,9 @@ static int ofstbl[TBLSIZE] = {
 
 /* system values, don't change this order */
 	offsetof(struct shader_envts, fract_timestamp),
-	offsetof(struct shader_envts, timestamp)
+	offsetof(struct shader_envts, timestamp),
+
+	offsetof(struct shader_envts, vr_reproject)
 };
 
 static enum shdrutype typetbl[TBLSIZE] = {
@@ -96,7 +102,9 @@ static enum shdrutype typetbl[TBLSIZE] = {
 	shdrint, /* rtgt_id */
 
 	shdrfloat, /* fract_timestamp */
-	shdrint /* timestamp */
+	shdrint, /* timestamp */
+
+	shdrmat4x4 /* vr_reproject */
 };
 
 static int counttbl[TBLSIZE] = {
@@ -117,7 +125,8 @@ static char* symtbl[TBLSIZE] = {
 	"obj_storage_sz",
 	"rtgt_id",
 	"fract_timestamp",
-	"timestamp"
+	"timestamp",
+	"vr_reproject"
 };
 
 static char* attrsymtbl[9] = {
@@ -159,6 +168,11 @@ struct shader_cont {
 	GLint attributes[9];
 
 	struct arcan_strarr ugroups;
+
+/* uniform values persist per program, so track what was last uploaded for
+ * each builtin and skip pushing values that did not change */
+	struct shader_envts shadow;
+	uint32_t shadow_valid;
 };
 
 static int sizetbl[7] = {
@@ -179,6 +193,27 @@ static struct {
 	char guard;
 } shdr_global = {.active_prg = BROKEN_SHADER, .guard = 64};
 
+/* linked program binaries persisted between runs, keyed on a hash of the
+ * sources and the vendor / renderer / version strings of the context */
+static struct {
+	char* dir;
+	uint64_t ident;
+} shdr_cache;
+
+#define SHDR_CACHE_MAGIC 0x32505341 /* ASP2 */
+
+/* the entry also carries the source lengths and a second, differently
+ * computed, hash of the sources so that a collision in the file name can't
+ * hand out the binary of another program */
+struct shdr_cache_hdr {
+	uint32_t magic;
+	uint32_t fmt;
+	uint32_t len;
+	uint32_t vlen;
+	uint32_t flen;
+	uint64_t src;
+};
+
 static bool build_shader(const char*, GLuint*, GLuint*, GLuint*,
 	const char*, const char*);
 static void kill_shader(GLuint* dprg, GLuint* vprg, GLuint* fprg);
@@ -223,6 +258,19 @@ static void setv(GLint loc, enum shdrutype kind, void* val,
 	}
 }
 
+static void push_global(struct shader_cont* cur, size_t i, const void* val)
+{
+	char* dst = (char*)(&cur->shadow) + ofstbl[i];
+	size_t sz = sizetbl[typetbl[i]];
+
+	if ((cur->shadow_valid & (1 << i)) && memcmp(dst, val, sz) == 0)
+		return;
+
+	memcpy(dst, val, sz);
+	cur->shadow_valid |= 1 << i;
+	setv(cur->locations[i], typetbl[i], (void*) val, symtbl[i], cur->label);
+}
+
 static void destroy_shader(struct shader_cont* cur)
 {
 	if (!cur->label)
@@ -312,16 +360,11 @@ int agp_shader_activate(agp_shader_id shid)
 			SHADER_INDEX(shid), cur->prg_container, cur->label);
 #endif
 
-/*
- * While we chould practically just update the uniforms that has actually
- * changed since the last push as we keep a cache, the incentive is rather
- * small (uniform- set on a bound shader is among the cheaper state changes
- * possible).
- */
+/* only the builtins that changed since this program was last active are
+ * pushed, in dense scenes most of them (projection, timestamp, ..) don't */
 		for (size_t i = 0; i < sizeof(ofstbl) / sizeof(ofstbl[0]); i++){
 			if (cur->locations[i] >= 0){
-				setv(cur->locations[i], typetbl[i], (char*)(&shdr_global.context)
-					+ ofstbl[i], symtbl[i], cur->label);
+				push_global(cur, i, (char*)(&shdr_global.context) + ofstbl[i]);
 				counttbl[i]++;
 			}
 		}
@@ -472,6 +515,7 @@ agp_shader_id agp_shader_build(const char* tag,
 		return ARCAN_EID;
 
 	cur->shmask = shmask;
+	cur->shadow_valid = 0;
 	cur->label = strdup(tag);
 	cur->vertex = strdup(vert);
 	cur->fragment = strdup(frag);
@@ -534,8 +578,8 @@ int agp_shader_envv(enum agp_shader_envts slot, void* value, size_t size)
  */
 	if (glloc != -1){
 		assert(size == sizetbl[ typetbl[slot] ]);
-		setv(glloc, typetbl[slot], value, symtbl[slot],
-			shdr_global.slots[SHADER_INDEX(shdr_global.active_prg)].label );
+		push_global(
+			&shdr_global.slots[SHADER_INDEX(shdr_global.active_prg)], slot, value);
 		counttbl[slot]++;
 
 		return rv;
@@ -638,8 +682,10 @@ void agp_shader_forceunif(const char* label, enum shdrutype type, void* value)
 	}
 	memcpy((*current)->data, value, sizetbl[type]);
 
+/* this can alias a builtin, so don't trust the shadow copy after */
 	if (loc >= 0){
 		setv(loc, type, value, label, slot->label);
+		slot->shadow_valid = 0;
 	}
 #ifdef DEBUG
 	else
@@ -714,11 +760,175 @@ static void dump_shaderlog(const char* label,
 	arcan_warning("%s shader failed on %s stage:\n", label, stage);
 }
 
+static uint64_t fnv1a(uint64_t h, const char* str)
+{
+	while (str && *str){
+		h ^= (uint8_t)*str++;
+		h *= 0x100000001b3ULL;
+	}
+	h ^= 0xff;
+	h *= 0x100000001b3ULL;
+	return h;
+}
+
+void agp_shader_cache(const char* dir)
+{
+	free(shdr_cache.dir);
+	shdr_cache.dir = NULL;
+	shdr_cache.ident = 0;
+
+	if (!dir)
+		return;
+
+	size_t len = strlen(dir) + sizeof("/shadercache");
+	if (!(shdr_cache.dir = malloc(len)))
+		return;
+
+	snprintf(shdr_cache.dir, len, "%s/shadercache", dir);
+	if (-1 == mkdir(shdr_cache.dir, S_IRWXU) && errno != EEXIST){
+		arcan_warning("agp_shader_cache(%s), couldn't create store\n", shdr_cache.dir);
+		free(shdr_cache.dir);
+		shdr_cache.dir = NULL;
+	}
+}
+
+/* resolved on first use as the strings need a current context, and the
+ * binaries are only valid for the exact driver that produced them */
+static uint64_t djb2(uint64_t h, const char* str)
+{
+	while (str && *str)
+		h = (h * 33) ^ (uint8_t)*str++;
+	return h * 33;
+}
+
+static bool cache_path(char* out, size_t out_sz,
+	const char* vprogram, const char* fprogram, struct shdr_cache_hdr* hdr)
+{
+	struct agp_fenv* env = agp_env();
+	if (!shdr_cache.dir || !env->program_binary || !env->get_program_binary)
+		return false;
+
+	if (!shdr_cache.ident){
+		uint64_t h = 0xcbf29ce484222325ULL;
+		h = fnv1a(h, (const char*) glGetString(GL_VENDOR));
+		h = fnv1a(h, (const char*) glGetString(GL_RENDERER));
+		h = fnv1a(h, (const char*) glGetString(GL_VERSION));
+		h = fnv1a(h, agp_ident());
+		shdr_cache.ident = h;
+	}
+
+	uint64_t h = fnv1a(fnv1a(shdr_cache.ident, vprogram), fprogram);
+	snprintf(out, out_sz, "%s/%016"PRIx64".bin", shdr_cache.dir, h);
+
+	*hdr = (struct shdr_cache_hdr){
+		.magic = SHDR_CACHE_MAGIC,
+		.vlen = vprogram ? strlen(vprogram) : 0,
+		.flen = fprogram ? strlen(fprogram) : 0,
+		.src = djb2(djb2(5381, vprogram), fprogram)
+	};
+	return true;
+}
+
+static bool cache_load(
+	const char* path, struct shdr_cache_hdr* key, GLuint* dprg)
+{
+	struct agp_fenv* env = agp_env();
+	FILE* fin = fopen(path, "r");
+	if (!fin)
+		return false;
+
+	struct shdr_cache_hdr hdr = {0};
+	void* buf = NULL;
+	bool ok = false;
+
+	if (1 != fread(&hdr, sizeof(hdr), 1, fin) ||
+		hdr.magic != SHDR_CACHE_MAGIC || !hdr.len || hdr.len > 16 * 1024 * 1024)
+		goto out;
+
+/* same name but not the same program, leave it to be replaced on store */
+	if (hdr.vlen != key->vlen || hdr.flen != key->flen || hdr.src != key->src)
+		goto out;
+
+	if (!(buf = malloc(hdr.len)) || 1 != fread(buf, hdr.len, 1, fin))
+		goto out;
+
+	TRACE_MARK_ENTER("agp", "shader-cache", TRACE_SYS_FAST, 0, hdr.len, path);
+		*dprg = env->create_program();
+		env->program_binary(*dprg, hdr.fmt, buf, hdr.len);
+		int lstat = 0;
+		env->get_program_iv(*dprg, GL_LINK_STATUS, &lstat);
+	TRACE_MARK_EXIT("agp", "shader-cache", TRACE_SYS_FAST, 0, hdr.len, path);
+
+/* driver updates with the same version string or a corrupt file, either
+ * way the entry is useless so drop it and let the caller rebuild */
+	if (GL_FALSE == lstat){
+		env->delete_program(*dprg);
+		*dprg = 0;
+		unlink(path);
+	}
+	else
+		ok = true;
+
+out:
+	free(buf);
+	fclose(fin);
+	return ok;
+}
+
+static void cache_store(
+	const char* path, struct shdr_cache_hdr* key, GLuint prg)
+{
+	struct agp_fenv* env = agp_env();
+	GLint len = 0;
+	env->get_program_iv(prg, GL_PROGRAM_BINARY_LENGTH, &len);
+	if (len <= 0)
+		return;
+
+	void* buf = malloc(len);
+	if (!buf)
+		return;
+
+	GLenum fmt = 0;
+	GLsizei outlen = 0;
+	env->get_program_binary(prg, len, &outlen, &fmt, buf);
+
+/* write to a temporary and rename so a concurrent or aborted run never
+ * sees a partial entry */
+	size_t tmp_sz = strlen(path) + sizeof(".tmp");
+	char tmp[tmp_sz];
+	snprintf(tmp, tmp_sz, "%s.tmp", path);
+
+	FILE* fout;
+	if (outlen > 0 && (fout = fopen(tmp, "w"))){
+		struct shdr_cache_hdr hdr = *key;
+		hdr.fmt = fmt;
+		hdr.len = outlen;
+		bool ok = 1 == fwrite(&hdr, sizeof(hdr), 1, fout) &&
+			1 == fwrite(buf, outlen, 1, fout);
+		ok = (0 == fclose(fout)) && ok;
+
+		if (!ok || 0 != rename(tmp, path))
+			unlink(tmp);
+	}
+
+	free(buf);
+}
+
 static bool build_shader(const char* label, GLuint* dprg,
 	GLuint* vprg, GLuint* fprg, const char* vprogram, const char* fprogram)
 {
 	struct agp_fenv* env = agp_env();
 	bool failed = false;
+	char cpath[4096];
+	struct shdr_cache_hdr ckey;
+	bool cached = cache_path(cpath, sizeof(cpath), vprogram, fprogram, &ckey);
+
+/* a hit skips both compilation and linking, the stage objects stay 0 which
+ * kill_shader already accepts */
+	if (cached && cache_load(cpath, &ckey, dprg)){
+		*vprg = *fprg = 0;
+		goto linked;
+	}
 
 #ifdef DEBUG
 	bool force = true;
@@ -741,6 +951,8 @@ static bool build_shader(const char* label, GLuint* dprg,
 	*dprg = env->create_program();
 	env->attach_shader(*dprg, *fprg);
 	env->attach_shader(*dprg, *vprg);
+	if (cached && env->program_parameter_i)
+		env->program_parameter_i(*dprg, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	env->link_program(*dprg);
 
 	int lstat = 0;
@@ -750,23 +962,28 @@ static bool build_shader(const char* label, GLuint* dprg,
 		failed = true;
 		dump_shaderlog(label, "link-vertex", vprogram, *dprg);
 		dump_shaderlog(label, "link-fragment", fprogram, *dprg);
+		return false;
 	}
-	else {
-		env->use_program(*dprg);
-		int loc = env->get_uniform_loc(*dprg, "map_tu0");
-		GLint val = 0;
 
-		if (loc >= 0)
-			env->unif_1i(loc, val);
+	if (cached && !failed)
+		cache_store(cpath, &ckey, *dprg);
 
-		loc = env->get_uniform_loc(*dprg, "map_diffuse");
-		if (loc >= 0)
-			env->unif_1i(loc, val);
-	}
+linked:
+	env->use_program(*dprg);
+	int loc = env->get_uniform_loc(*dprg, "map_tu0");
+	GLint val = 0;
+
+	if (loc >= 0)
+		env->unif_1i(loc, val);
+
+	loc = env->get_uniform_loc(*dprg, "map_diffuse");
+	if (loc >= 0)
+		env->unif_1i(loc, val);
 
 	return !failed;
 }
 
+
 const char* agp_shader_symtype(enum agp_shader_envts env)
 {
 	return symtbl[env];
@@ -785,12 +1002,15 @@ void agp_shader_flush()
 
 void agp_shader_rebuild_all()
 {
+	agp_glinit_state_reset(agp_env());
+
 	for (size_t i = 0; i < sizeof(shdr_global.slots) /
 			sizeof(shdr_global.slots[0]); i++){
 		struct shader_cont* cur = shdr_global.slots + i;
 		if (cur->label == NULL)
 			continue;
 
+		cur->shadow_valid = 0;
 		build_shader(cur->label,
 			&cur->prg_container,
 			&cur->obj_vertex,
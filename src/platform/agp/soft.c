@@ -0,0 +1,3075 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Software rasterizer AGP backend for headless and a12- serving
+ * setups where there is no GPU (or none worth waking up).
+ *
+ * Vstores are plain av_pixel buffers indexed by glid. Draw calls are not
+ * executed immediately, they are recorded against the current destination
+ * together with a snapshot of the state they need (blend, sampler, clip,
+ * opacity, ...). The recorded batch is flushed when something needs the
+ * results, e.g. another destination being activated, a readback, a swap or
+ * a store being modified. The flush splits the touched area of the
+ * destination into tiles that are rasterized in command order by a small
+ * pool of threads, so each tile sees the same ordering as the GL would.
+ *
+ * There is no shader language. Programs can still be built and activated so
+ * that appls work unmodified, but they are classified as either textured
+ * (DEFAULT) or color (DEFAULT_COLOR) based on their fragment source and then
+ * treated as such. Point clouds and line fill are not drawn.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../platform_types.h"
+#include "../video_platform.h"
+#include "../platform.h"
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_video.h"
+#include "arcan_videoint.h"
+
+#ifdef HEADLESS_NOARCAN
+#undef FLAG_DIRTY
+#define FLAG_DIRTY()
+#endif
+
+#ifndef MAX_BUFFERS
+#define MAX_BUFFERS 4
+#endif
+
+#define SOFT_TILE 64
+
+#ifndef SOFT_THREAD_LIMIT
+#define SOFT_THREAD_LIMIT 16
+#endif
+
+#define SOFT_SHADER_LIMIT 256
+#define RBRING_LIMIT 8
+
+/* subpixel precision for triangle setup, and the guard band in pixels */
+#define SOFT_SUBPX 16
+#define SOFT_GUARD 1048576.0f
+
+struct soft_tex {
+	av_pixel* buf;
+	size_t w, h;
+	bool live;
+};
+
+/* stencil and depth for a destination, only allocated when used */
+struct soft_aux {
+	uint8_t* stencil;
+	float* depth;
+	size_t w, h;
+};
+
+struct agp_rendertarget
+{
+	ssize_t viewport[4];
+	float clearcol[4];
+
+	enum rendertarget_mode mode;
+	struct agp_vstore* store;
+	struct soft_aux aux;
+
+	bool (*proxy_state)(struct agp_rendertarget* tgt, uintptr_t tag);
+	uintptr_t proxy_tag;
+
+/* used for multi-buffering mode */
+	bool rz_ack;
+	size_t n_stores;
+	size_t dirty_flip;
+	size_t store_ind;
+	struct agp_vstore* stores[MAX_BUFFERS];
+	struct agp_vstore* shadow[MAX_BUFFERS];
+
+/* damage for the current [0] and the previous [1] frame, same rules as in
+ * glshared.c */
+	struct agp_region damage[2][AGP_DAMAGE_LIMIT];
+	size_t n_damage[2];
+	bool damage_reset;
+
+	bool scissor_set;
+	struct agp_region scissor;
+
+	bool (*alloc)(struct agp_rendertarget*, struct agp_vstore*, int, void*);
+	void* alloc_tag;
+};
+
+struct rbslot {
+	av_pixel* buf;
+	size_t w, h;
+};
+
+struct agp_rbring {
+	struct rbslot slots[RBRING_LIMIT];
+	size_t depth;
+	size_t head, count;
+	bool mapped;
+};
+
+/* there is no context to set up, but the fenv calls need something to return */
+struct agp_fenv {
+	int mode;
+};
+
+enum soft_cmd_kind {
+	CMD_CLEAR = 0,
+	CMD_CLEAR_DEPTH,
+	CMD_CLEAR_STENCIL,
+	CMD_RECT,
+	CMD_TRIS
+};
+
+enum soft_stencil {
+	STENCIL_OFF = 0,
+	STENCIL_WRITE,
+	STENCIL_TEST
+};
+
+/* window coordinates, z in 0..1 and the perspective divided attributes */
+struct soft_vert {
+	float x, y, z;
+	float iw, u, v;
+};
+
+struct soft_tri {
+	struct soft_vert v[3];
+	int32_t fx[3], fy[3];
+	int64_t area;
+	bool tl[3];
+	int x1, y1, x2, y2;
+};
+
+struct soft_cmd {
+	enum soft_cmd_kind kind;
+
+/* pixel bounds, half-open, already limited to the clip region */
+	int x1, y1, x2, y2;
+
+	uint8_t blend;
+	uint8_t stencil;
+	uint8_t opacity;
+
+/* enum agp_depth_func + 1, 0 disables the test */
+	uint8_t depth;
+	bool retain_alpha;
+	bool bilinear;
+	bool repeat_s, repeat_t;
+	bool perspective;
+
+	av_pixel col;
+	const av_pixel* tex;
+	size_t tw, th;
+
+	union {
+/* texel coordinates in 16.16 at the center of pixel x1, y1 and the steps */
+		struct {
+			int64_t u, v, du, dv;
+		} rect;
+		struct {
+			size_t first, count;
+		} tris;
+	};
+};
+
+struct soft_dst {
+	av_pixel* buf;
+	size_t w, h;
+	struct soft_aux* aux;
+};
+
+struct soft_job {
+	struct soft_dst dst;
+	const struct soft_cmd* cmds;
+	size_t n_cmds;
+	const struct soft_tri* tris;
+	int x1, y1, x2, y2;
+	size_t tiles_x, tiles_y;
+};
+
+struct soft_shader {
+	char* label;
+	char* vertex;
+	char* fragment;
+	bool color;
+	uint16_t groups;
+	float col[3];
+};
+
+static struct {
+	struct soft_tex* slots;
+	size_t count;
+} tex_pool;
+
+static struct {
+	struct soft_cmd* cmds;
+	size_t n_cmds, cmd_limit;
+	struct soft_tri* tris;
+	size_t n_tris, tri_limit;
+	struct soft_dst dst;
+	int x1, y1, x2, y2;
+} queue;
+
+static struct {
+	float _Alignas(16) modelview[16];
+	float _Alignas(16) projection[16];
+	float opacity;
+	enum arcan_blendfunc blend;
+	bool retain_alpha;
+	enum pipeline_mode mode;
+	enum soft_stencil stencil;
+	struct agp_vstore* vstore;
+	agp_shader_id shader;
+
+/* active viewport and the clip region (scissor) in window coordinates */
+	ssize_t vp[4];
+	int clip[4];
+	bool proxied;
+} st = {
+	.opacity = 1.0,
+	.shader = BROKEN_SHADER
+};
+
+static struct {
+	struct soft_tex tex;
+	struct soft_aux aux;
+} fb0;
+
+static struct {
+	pthread_t threads[SOFT_THREAD_LIMIT];
+	size_t n_threads;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	uint64_t gen;
+	size_t active;
+	const struct soft_job* job;
+	atomic_size_t next_tile;
+	bool init;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER
+};
+
+static struct soft_shader shaders[SOFT_SHADER_LIMIT];
+static struct agp_fenv default_env;
+static struct agp_fenv* current_env = &default_env;
+static struct agp_rendertarget* active_rendertarget;
+static size_t rbring_depth = 3;
+
+static float ident[] = {
+	1.0, 0.0, 0.0, 0.0,
+	0.0, 1.0, 0.0, 0.0,
+	0.0, 0.0, 1.0, 0.0,
+	0.0, 0.0, 0.0, 1.0
+};
+
+static const char* defvprg = "soft:default";
+static const char* deffprg = "uniform sampler2D map_tu0;";
+static const char* defcvprg = "soft:default_color";
+static const char* defcfprg = "uniform vec3 obj_col;";
+
+static void soft_flush();
+
+static inline int clampi(int v, int lo, int hi)
+{
+	return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static inline unsigned div255(unsigned v)
+{
+	v += 128;
+	return (v + (v >> 8)) >> 8;
+}
+
+/*
+ * Textures
+ */
+static struct soft_tex* tex_get(unsigned id)
+{
+	if (!id || id > tex_pool.count || !tex_pool.slots[id-1].live)
+		return NULL;
+	return &tex_pool.slots[id-1];
+}
+
+static unsigned tex_alloc()
+{
+	for (size_t i = 0; i < tex_pool.count; i++)
+		if (!tex_pool.slots[i].live){
+			tex_pool.slots[i] = (struct soft_tex){.live = true};
+			return i + 1;
+		}
+
+/* recorded commands only keep the buffers, not the slots, so moving is fine */
+	size_t ncount = tex_pool.count ? tex_pool.count * 2 : 64;
+	struct soft_tex* slots = arcan_alloc_mem(sizeof(struct soft_tex) * ncount,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	if (tex_pool.slots)
+		memcpy(slots, tex_pool.slots, sizeof(struct soft_tex) * tex_pool.count);
+	arcan_mem_free(tex_pool.slots);
+
+	unsigned id = tex_pool.count + 1;
+	tex_pool.slots = slots;
+	tex_pool.count = ncount;
+	slots[id-1].live = true;
+	return id;
+}
+
+static bool tex_size(struct soft_tex* t, size_t w, size_t h)
+{
+	if (t->buf && t->w == w && t->h == h)
+		return true;
+
+	arcan_mem_free(t->buf);
+	t->buf = NULL;
+	t->w = t->h = 0;
+	if (!w || !h)
+		return false;
+
+	t->buf = arcan_alloc_mem(w * h * sizeof(av_pixel), ARCAN_MEM_VBUFFER,
+		ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_SIMD);
+	if (!t->buf)
+		return false;
+
+	t->w = w;
+	t->h = h;
+	return true;
+}
+
+static void tex_free(unsigned id)
+{
+	struct soft_tex* t = tex_get(id);
+	if (!t)
+		return;
+
+	arcan_mem_free(t->buf);
+	*t = (struct soft_tex){0};
+}
+
+static bool noalpha(struct agp_vstore* s)
+{
+	return s->hdr.depth == VSTORE_HINT_NORMAL_NOALPHA;
+}
+
+/* copy a region from [src] with [stride] pixels per row into texture */
+static void tex_copy(struct soft_tex* t, const av_pixel* src, size_t stride,
+	size_t x1, size_t y1, size_t w, size_t h, bool opaque)
+{
+	if (!t->buf || x1 >= t->w || y1 >= t->h)
+		return;
+
+	if (x1 + w > t->w)
+		w = t->w - x1;
+	if (y1 + h > t->h)
+		h = t->h - y1;
+
+	for (size_t y = y1; y < y1 + h; y++){
+		av_pixel* out = &t->buf[y * t->w + x1];
+		const av_pixel* in = &src[y * stride + x1];
+		if (!opaque){
+			memcpy(out, in, w * sizeof(av_pixel));
+			continue;
+		}
+		for (size_t x = 0; x < w; x++)
+			out[x] = in[x] | 0xff000000;
+	}
+}
+
+static struct soft_tex* vstore_tex(struct agp_vstore* s)
+{
+	if (!s->vinf.text.glid)
+		s->vinf.text.glid = tex_alloc();
+
+	struct soft_tex* t = tex_get(s->vinf.text.glid);
+	if (!tex_size(t, s->w, s->h))
+		return NULL;
+
+	return t;
+}
+
+/*
+ * Blending, the integer version of the same factors that glshared sets up
+ * with alpha going through the rendertarget (ONE, ONE or SRC_ALPHA,
+ * ONE_MINUS_SRC_ALPHA) factors. Both terms are scaled and rounded on their
+ * own and then added (or subtracted) with saturation. The SSE2 path has to
+ * produce identical results.
+ */
+static inline av_pixel blend_px(av_pixel d, av_pixel s, int mode, bool retain)
+{
+	unsigned sa = s >> 24;
+	av_pixel out = 0;
+
+	if (mode == BLEND_NORMAL){
+		if (sa == 255)
+			return s;
+		if (sa == 0)
+			return d;
+	}
+
+	for (int ch = 0; ch < 32; ch += 8){
+		unsigned sc = (s >> ch) & 0xff;
+		unsigned dc = (d >> ch) & 0xff;
+		unsigned sf, df;
+
+		if (ch == 24){
+			sf = retain ? sa : 255;
+			df = retain ? 255 - sa : 255;
+		}
+		else
+			switch (mode){
+			case BLEND_MULTIPLY: sf = dc; df = 255 - sa; break;
+			case BLEND_PREMUL:
+			case BLEND_SUB: sf = 255; df = 255 - sa; break;
+			case BLEND_ADD: sf = 255; df = 255; break;
+			default:
+				sf = sa; df = 255 - sa;
+			break;
+			}
+
+		unsigned a = div255(sc * sf);
+		unsigned b = div255(dc * df);
+		unsigned r;
+
+		if (mode == BLEND_SUB)
+			r = a > b ? a - b : 0;
+		else
+			r = a + b > 255 ? 255 : a + b;
+
+		out |= (av_pixel) r << ch;
+	}
+
+	return out;
+}
+
+#ifdef __SSE2__
+static inline __m128i div255_epu16(__m128i v)
+{
+	v = _mm_add_epi16(v, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+}
+
+/* two pixels unpacked to 16-bit lanes, alpha in lane 3 and 7 */
+static inline __m128i blend_half(__m128i s, __m128i d, int mode, bool retain)
+{
+	const __m128i full = _mm_set1_epi16(255);
+	const __m128i amask = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+
+	__m128i sa = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+	sa = _mm_shufflehi_epi16(sa, _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i inv = _mm_sub_epi16(full, sa);
+	__m128i sf, df;
+
+	switch (mode){
+	case BLEND_MULTIPLY: sf = d; df = inv; break;
+	case BLEND_PREMUL:
+	case BLEND_SUB: sf = full; df = inv; break;
+	case BLEND_ADD: sf = full; df = full; break;
+	default:
+		sf = sa; df = inv;
+	break;
+	}
+
+	__m128i asf = retain ? sa : full;
+	__m128i adf = retain ? inv : full;
+	sf = _mm_or_si128(_mm_andnot_si128(amask, sf), _mm_and_si128(amask, asf));
+	df = _mm_or_si128(_mm_andnot_si128(amask, df), _mm_and_si128(amask, adf));
+
+	__m128i a = div255_epu16(_mm_mullo_epi16(s, sf));
+	__m128i b = div255_epu16(_mm_mullo_epi16(d, df));
+
+	return mode == BLEND_SUB ? _mm_subs_epu16(a, b) : _mm_adds_epu16(a, b);
+}
+#endif
+
+static void blend_row(av_pixel* restrict d,
+	const av_pixel* restrict s, size_t n, int mode, bool retain)
+{
+	size_t i = 0;
+
+	if (mode == BLEND_NONE){
+		memcpy(d, s, n * sizeof(av_pixel));
+		return;
+	}
+
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i amask = _mm_set1_epi32(0xff000000);
+
+	for (; i + 4 <= n; i += 4){
+		__m128i sv = _mm_loadu_si128((const __m128i*) &s[i]);
+
+/* opaque and fully transparent runs are common enough with text and UI */
+		if (mode == BLEND_NORMAL){
+			__m128i av = _mm_and_si128(sv, amask);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(av, amask)) == 0xffff){
+				_mm_storeu_si128((__m128i*) &d[i], sv);
+				continue;
+			}
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(av, zero)) == 0xffff)
+				continue;
+		}
+
+		__m128i dv = _mm_loadu_si128((const __m128i*) &d[i]);
+		__m128i lo = blend_half(
+			_mm_unpacklo_epi8(sv, zero), _mm_unpacklo_epi8(dv, zero), mode, retain);
+		__m128i hi = blend_half(
+			_mm_unpackhi_epi8(sv, zero), _mm_unpackhi_epi8(dv, zero), mode, retain);
+		_mm_storeu_si128((__m128i*) &d[i], _mm_packus_epi16(lo, hi));
+	}
+#endif
+
+	for (; i < n; i++)
+		d[i] = blend_px(d[i], s[i], mode, retain);
+}
+
+static void opacity_row(av_pixel* buf, size_t n, unsigned opa)
+{
+	for (size_t i = 0; i < n; i++){
+		unsigned a = div255((buf[i] >> 24) * opa);
+		buf[i] = (buf[i] & 0x00ffffff) | ((av_pixel) a << 24);
+	}
+}
+
+/*
+ * Sampling, weights are in 1/256:th steps for both versions
+ */
+static inline av_pixel bilerp(av_pixel p00,
+	av_pixel p10, av_pixel p01, av_pixel p11, unsigned fx, unsigned fy)
+{
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	__m128i px = _mm_setr_epi32(p00, p10, p01, p11);
+	__m128i wx = _mm_setr_epi16(
+		256 - fx, 256 - fx, 256 - fx, 256 - fx, fx, fx, fx, fx);
+
+	__m128i top = _mm_mullo_epi16(_mm_unpacklo_epi8(px, zero), wx);
+	__m128i bot = _mm_mullo_epi16(_mm_unpackhi_epi8(px, zero), wx);
+	top = _mm_srli_epi16(_mm_add_epi16(top, _mm_srli_si128(top, 8)), 8);
+	bot = _mm_srli_epi16(_mm_add_epi16(bot, _mm_srli_si128(bot, 8)), 8);
+
+	__m128i r = _mm_add_epi16(
+		_mm_mullo_epi16(top, _mm_set1_epi16(256 - fy)),
+		_mm_mullo_epi16(bot, _mm_set1_epi16(fy))
+	);
+	r = _mm_srli_epi16(r, 8);
+	return _mm_cvtsi128_si32(_mm_packus_epi16(r, r));
+#else
+	av_pixel out = 0;
+	for (int ch = 0; ch < 32; ch += 8){
+		unsigned top = (((p00 >> ch) & 0xff) * (256 - fx) +
+			((p10 >> ch) & 0xff) * fx) >> 8;
+		unsigned bot = (((p01 >> ch) & 0xff) * (256 - fx) +
+			((p11 >> ch) & 0xff) * fx) >> 8;
+		out |= (av_pixel)((top * (256 - fy) + bot * fy) >> 8) << ch;
+	}
+	return out;
+#endif
+}
+
+static inline int64_t wrap(int64_t v, size_t n, bool repeat)
+{
+	if (repeat){
+		v %= (int64_t) n;
+		return v < 0 ? v + n : v;
+	}
+	return v < 0 ? 0 : (v >= (int64_t) n ? (int64_t) n - 1 : v);
+}
+
+/* [u, v] in 16.16 texel space */
+static inline av_pixel sample_fx(const struct soft_cmd* c, int64_t u, int64_t v)
+{
+	if (!c->bilinear){
+		int64_t x = wrap(u >> 16, c->tw, c->repeat_s);
+		int64_t y = wrap(v >> 16, c->th, c->repeat_t);
+		return c->tex[y * c->tw + x];
+	}
+
+	u -= 32768;
+	v -= 32768;
+	unsigned fx = (u >> 8) & 0xff;
+	unsigned fy = (v >> 8) & 0xff;
+	int64_t x0 = wrap(u >> 16, c->tw, c->repeat_s);
+	int64_t x1 = wrap((u >> 16) + 1, c->tw, c->repeat_s);
+	const av_pixel* r0 = &c->tex[wrap(v >> 16, c->th, c->repeat_t) * c->tw];
+	const av_pixel* r1 = &c->tex[wrap((v >> 16) + 1, c->th, c->repeat_t) * c->tw];
+
+	return bilerp(r0[x0], r0[x1], r1[x0], r1[x1], fx, fy);
+}
+
+static inline int64_t to_fx(float v, size_t dim)
+{
+	double r = (double) v * dim * 65536.0;
+	if (r > 4e15)
+		r = 4e15;
+	else if (r < -4e15)
+		r = -4e15;
+	return (int64_t) r;
+}
+
+/*
+ * Destination writes, [src] is the final color of [n] fragments starting at
+ * [x, y], [z] their depth if the command has depth testing.
+ */
+static inline bool depth_pass(int func, float z, float ref)
+{
+	switch (func){
+	case AGP_DEPTH_LESS: return z < ref;
+	case AGP_DEPTH_LESSEQUAL: return z <= ref;
+	case AGP_DEPTH_GREATER: return z > ref;
+	case AGP_DEPTH_GREATEREQUAL: return z >= ref;
+	case AGP_DEPTH_EQUAL: return z == ref;
+	case AGP_DEPTH_NOTEQUAL: return z != ref;
+	case AGP_DEPTH_ALWAYS: return true;
+	default:
+		return false;
+	}
+}
+
+static void put_span(const struct soft_dst* dst, const struct soft_cmd* c,
+	int x, int y, size_t n, const av_pixel* src, const float* z)
+{
+	size_t ofs = (size_t) y * dst->w + x;
+
+	if (c->stencil == STENCIL_WRITE){
+		memset(&dst->aux->stencil[ofs], 1, n);
+		return;
+	}
+
+	if (c->stencil != STENCIL_TEST && !c->depth){
+		blend_row(&dst->buf[ofs], src, n, c->blend, c->retain_alpha);
+		return;
+	}
+
+	const uint8_t* sb = c->stencil == STENCIL_TEST ? &dst->aux->stencil[ofs] : NULL;
+	float* zb = c->depth ? &dst->aux->depth[ofs] : NULL;
+
+/* blend the runs of fragments that survive the tests */
+	size_t i = 0;
+	while (i < n){
+		size_t start = i;
+		for (; i < n; i++){
+			if (sb && !sb[i])
+				break;
+			if (zb){
+				if (!depth_pass(c->depth - 1, z[i], zb[i]))
+					break;
+				zb[i] = z[i];
+			}
+		}
+
+		if (i > start)
+			blend_row(&dst->buf[ofs + start],
+				&src[start], i - start, c->blend, c->retain_alpha);
+		i++;
+	}
+}
+
+/*
+ * Command execution within the region [x1, y1, x2, y2] of one tile
+ */
+static void exec_fill(const struct soft_dst* dst,
+	const struct soft_cmd* c, int x1, int y1, int x2, int y2)
+{
+	for (int y = y1; y < y2; y++){
+		size_t ofs = (size_t) y * dst->w + x1;
+		size_t n = x2 - x1;
+
+		switch (c->kind){
+		case CMD_CLEAR:
+			for (size_t i = 0; i < n; i++)
+				dst->buf[ofs + i] = c->col;
+		break;
+		case CMD_CLEAR_DEPTH:
+			for (size_t i = 0; i < n; i++)
+				dst->aux->depth[ofs + i] = 1.0;
+		break;
+		case CMD_CLEAR_STENCIL:
+			memset(&dst->aux->stencil[ofs], 0, n);
+		break;
+		default:
+		break;
+		}
+	}
+}
+
+static void exec_rect(const struct soft_dst* dst,
+	const struct soft_cmd* c, int x1, int y1, int x2, int y2)
+{
+	av_pixel span[SOFT_TILE];
+	size_t n = x2 - x1;
+
+	if (!c->tex){
+		for (size_t i = 0; i < n; i++)
+			span[i] = c->col;
+		for (int y = y1; y < y2; y++)
+			put_span(dst, c, x1, y, n, span, NULL);
+		return;
+	}
+
+	int64_t u0 = c->rect.u + (x1 - c->x1) * c->rect.du;
+	int64_t u1 = u0 + (int64_t)(n - 1) * c->rect.du;
+
+/* 1:1 mapping that stays inside the texture can go straight from the rows */
+	bool direct = !c->bilinear && c->opacity == 255 &&
+		c->rect.du == 65536 && u0 >= 0 && (u1 >> 16) < (int64_t) c->tw;
+
+	for (int y = y1; y < y2; y++){
+		int64_t v = c->rect.v + (y - c->y1) * c->rect.dv;
+		const av_pixel* src = span;
+
+		if (direct){
+			int64_t ty = wrap(v >> 16, c->th, c->repeat_t);
+			src = &c->tex[ty * c->tw + (u0 >> 16)];
+		}
+		else {
+			int64_t u = u0;
+			for (size_t i = 0; i < n; i++, u += c->rect.du)
+				span[i] = sample_fx(c, u, v);
+			if (c->opacity != 255)
+				opacity_row(span, n, c->opacity);
+		}
+
+		put_span(dst, c, x1, y, n, src, NULL);
+	}
+}
+
+static inline int64_t edge_eval(const struct soft_tri* t, int e, int64_t px, int64_t py)
+{
+	int a = (e + 1) % 3, b = (e + 2) % 3;
+	return (int64_t)(t->fx[b] - t->fx[a]) * (py - t->fy[a]) -
+		(int64_t)(t->fy[b] - t->fy[a]) * (px - t->fx[a]);
+}
+
+static void exec_tri(const struct soft_dst* dst, const struct soft_cmd* c,
+	const struct soft_tri* t, int x1, int y1, int x2, int y2)
+{
+	av_pixel span[SOFT_TILE];
+	float zs[SOFT_TILE];
+
+	x1 = x1 > t->x1 ? x1 : t->x1;
+	y1 = y1 > t->y1 ? y1 : t->y1;
+	x2 = x2 < t->x2 ? x2 : t->x2;
+	y2 = y2 < t->y2 ? y2 : t->y2;
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	const struct soft_vert* v = t->v;
+	float ia = 1.0 / (float) t->area;
+	int64_t step[3];
+	for (int e = 0; e < 3; e++){
+		int a = (e + 1) % 3, b = (e + 2) % 3;
+		step[e] = -(int64_t)(t->fy[b] - t->fy[a]) * SOFT_SUBPX;
+	}
+
+	float dz[2] = {v[1].z - v[0].z, v[2].z - v[0].z};
+	float dw[2] = {v[1].iw - v[0].iw, v[2].iw - v[0].iw};
+	float du[2] = {v[1].u - v[0].u, v[2].u - v[0].u};
+	float dv[2] = {v[1].v - v[0].v, v[2].v - v[0].v};
+
+	for (int y = y1; y < y2; y++){
+		int64_t px = (int64_t) x1 * SOFT_SUBPX + SOFT_SUBPX / 2;
+		int64_t py = (int64_t) y * SOFT_SUBPX + SOFT_SUBPX / 2;
+		int64_t w[3];
+		for (int e = 0; e < 3; e++)
+			w[e] = edge_eval(t, e, px, py);
+
+		int start = -1;
+		size_t n = 0;
+
+		for (int x = x1; x < x2; x++){
+			bool in = true;
+			for (int e = 0; e < 3 && in; e++)
+				in = w[e] > 0 || (w[e] == 0 && t->tl[e]);
+
+			if (in){
+				if (start == -1)
+					start = x;
+
+				float b1 = (float) w[1] * ia;
+				float b2 = (float) w[2] * ia;
+
+				if (c->depth)
+					zs[n] = v[0].z + b1 * dz[0] + b2 * dz[1];
+
+				if (!c->tex)
+					span[n] = c->col;
+				else {
+					float tu = v[0].u + b1 * du[0] + b2 * du[1];
+					float tv = v[0].v + b1 * dv[0] + b2 * dv[1];
+					if (c->perspective){
+						float iw = 1.0 / (v[0].iw + b1 * dw[0] + b2 * dw[1]);
+						tu *= iw;
+						tv *= iw;
+					}
+					span[n] = sample_fx(c, to_fx(tu, c->tw), to_fx(tv, c->th));
+				}
+				n++;
+			}
+/* convex, there is only one run per row */
+			else if (start != -1)
+				break;
+
+			for (int e = 0; e < 3; e++)
+				w[e] += step[e];
+		}
+
+		if (!n)
+			continue;
+
+		if (c->tex && c->opacity != 255)
+			opacity_row(span, n, c->opacity);
+
+		put_span(dst, c, start, y, n, span, zs);
+	}
+}
+
+static void run_tile(const struct soft_job* job, size_t tx, size_t ty)
+{
+	int x1 = job->x1 + tx * SOFT_TILE;
+	int y1 = job->y1 + ty * SOFT_TILE;
+	int x2 = x1 + SOFT_TILE < job->x2 ? x1 + SOFT_TILE : job->x2;
+	int y2 = y1 + SOFT_TILE < job->y2 ? y1 + SOFT_TILE : job->y2;
+
+	for (size_t i = 0; i < job->n_cmds; i++){
+		const struct soft_cmd* c = &job->cmds[i];
+		int cx1 = c->x1 > x1 ? c->x1 : x1;
+		int cy1 = c->y1 > y1 ? c->y1 : y1;
+		int cx2 = c->x2 < x2 ? c->x2 : x2;
+		int cy2 = c->y2 < y2 ? c->y2 : y2;
+		if (cx1 >= cx2 || cy1 >= cy2)
+			continue;
+
+		switch (c->kind){
+		case CMD_RECT:
+			exec_rect(&job->dst, c, cx1, cy1, cx2, cy2);
+		break;
+		case CMD_TRIS:
+			for (size_t j = 0; j < c->tris.count; j++)
+				exec_tri(&job->dst, c,
+					&job->tris[c->tris.first + j], cx1, cy1, cx2, cy2);
+		break;
+		default:
+			exec_fill(&job->dst, c, cx1, cy1, cx2, cy2);
+		break;
+		}
+	}
+}
+
+/*
+ * Thread pool, workers and the caller pull tiles from a shared counter until
+ * the job is exhausted. The caller waits for all workers to check out before
+ * returning so the next job can't be missed.
+ */
+static void run_tiles(const struct soft_job* job)
+{
+	size_t n = job->tiles_x * job->tiles_y;
+	size_t i;
+
+	while ((i = atomic_fetch_add(&pool.next_tile, 1)) < n)
+		run_tile(job, i % job->tiles_x, i / job->tiles_x);
+}
+
+static void* worker(void* arg)
+{
+	uint64_t gen = 0;
+
+	pthread_mutex_lock(&pool.lock);
+	for(;;){
+		while (pool.gen == gen)
+			pthread_cond_wait(&pool.wake, &pool.lock);
+
+		gen = pool.gen;
+		const struct soft_job* job = pool.job;
+		pthread_mutex_unlock(&pool.lock);
+
+		run_tiles(job);
+
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.active == 0)
+			pthread_cond_signal(&pool.done);
+	}
+
+	return NULL;
+}
+
+static void pool_init()
+{
+	if (pool.init)
+		return;
+	pool.init = true;
+
+	uintptr_t tag;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+	char* val;
+	long n = 0;
+
+	if (get_config("agp_soft_threads", 0, &val, tag)){
+		n = strtol(val, NULL, 10);
+		free(val);
+	}
+
+	if (n <= 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (n > SOFT_THREAD_LIMIT)
+		n = SOFT_THREAD_LIMIT;
+
+/* the calling thread takes part so it counts as one */
+	for (long i = 1; i < n; i++){
+		if (0 != pthread_create(&pool.threads[pool.n_threads], NULL, worker, NULL))
+			break;
+		pool.n_threads++;
+	}
+}
+
+static void dispatch(const struct soft_job* job)
+{
+	atomic_store(&pool.next_tile, 0);
+
+	if (!pool.n_threads || job->tiles_x * job->tiles_y < 2){
+		run_tiles(job);
+		return;
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.job = job;
+	pool.active = pool.n_threads;
+	pool.gen++;
+	pthread_cond_broadcast(&pool.wake);
+	pthread_mutex_unlock(&pool.lock);
+
+	run_tiles(job);
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.active)
+		pthread_cond_wait(&pool.done, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+static void soft_flush()
+{
+	if (!queue.n_cmds)
+		return;
+
+	TRACE_MARK_ENTER("agp", "soft-flush", TRACE_SYS_DEFAULT, queue.n_cmds, 0, "");
+
+	struct soft_job job = {
+		.dst = queue.dst,
+		.cmds = queue.cmds,
+		.n_cmds = queue.n_cmds,
+		.tris = queue.tris,
+		.x1 = queue.x1,
+		.y1 = queue.y1,
+		.x2 = queue.x2,
+		.y2 = queue.y2,
+	};
+
+	job.tiles_x = (job.x2 - job.x1 + SOFT_TILE - 1) / SOFT_TILE;
+	job.tiles_y = (job.y2 - job.y1 + SOFT_TILE - 1) / SOFT_TILE;
+	dispatch(&job);
+
+	TRACE_MARK_EXIT("agp", "soft-flush", TRACE_SYS_DEFAULT, queue.n_cmds, 0, "");
+	queue.n_cmds = 0;
+	queue.n_tris = 0;
+}
+
+/*
+ * Recording
+ */
+static struct soft_aux* dst_aux()
+{
+	if (active_rendertarget && !st.proxied)
+		return &active_rendertarget->aux;
+	return &fb0.aux;
+}
+
+static struct soft_tex* dst_tex()
+{
+	if (active_rendertarget && !st.proxied)
+		return tex_get(agp_resolve_texid(active_rendertarget->store));
+	return &fb0.tex;
+}
+
+/* resolve the destination, it can have been swapped or resized since the
+ * rendertarget was activated */
+static bool dst_bind()
+{
+	struct soft_tex* t = dst_tex();
+	if (!t || !t->buf)
+		return false;
+
+	if (queue.dst.buf != t->buf || queue.dst.w != t->w || queue.dst.h != t->h){
+		soft_flush();
+		queue.dst = (struct soft_dst){
+			.buf = t->buf, .w = t->w, .h = t->h, .aux = dst_aux()
+		};
+	}
+
+	return true;
+}
+
+static void aux_free(struct soft_aux* aux)
+{
+	arcan_mem_free(aux->stencil);
+	arcan_mem_free(aux->depth);
+	*aux = (struct soft_aux){0};
+}
+
+static bool aux_ensure(bool depth, bool stencil)
+{
+	struct soft_aux* aux = queue.dst.aux;
+
+	if (aux->w != queue.dst.w || aux->h != queue.dst.h){
+		soft_flush();
+		aux_free(aux);
+		aux->w = queue.dst.w;
+		aux->h = queue.dst.h;
+	}
+
+	size_t np = aux->w * aux->h;
+
+	if (stencil && !aux->stencil){
+		aux->stencil = arcan_alloc_mem(np,
+			ARCAN_MEM_VBUFFER, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_SIMD);
+		if (!aux->stencil)
+			return false;
+	}
+
+	if (depth && !aux->depth){
+		aux->depth = arcan_alloc_mem(np * sizeof(float),
+			ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_SIMD);
+		if (!aux->depth)
+			return false;
+		for (size_t i = 0; i < np; i++)
+			aux->depth[i] = 1.0;
+	}
+
+	return true;
+}
+
+static struct soft_cmd* cmd_add(enum soft_cmd_kind kind, int x1, int y1, int x2, int y2)
+{
+	x1 = x1 > st.clip[0] ? x1 : st.clip[0];
+	y1 = y1 > st.clip[1] ? y1 : st.clip[1];
+	x2 = x2 < st.clip[2] ? x2 : st.clip[2];
+	y2 = y2 < st.clip[3] ? y2 : st.clip[3];
+	x1 = x1 > 0 ? x1 : 0;
+	y1 = y1 > 0 ? y1 : 0;
+	x2 = x2 < (int) queue.dst.w ? x2 : (int) queue.dst.w;
+	y2 = y2 < (int) queue.dst.h ? y2 : (int) queue.dst.h;
+
+	if (x1 >= x2 || y1 >= y2)
+		return NULL;
+
+	if (queue.n_cmds == queue.cmd_limit){
+		size_t nlim = queue.cmd_limit ? queue.cmd_limit * 2 : 256;
+		struct soft_cmd* ncmds = arcan_alloc_mem(sizeof(struct soft_cmd) * nlim,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+		if (!ncmds)
+			return NULL;
+		if (queue.cmds)
+			memcpy(ncmds, queue.cmds, sizeof(struct soft_cmd) * queue.n_cmds);
+		arcan_mem_free(queue.cmds);
+		queue.cmds = ncmds;
+		queue.cmd_limit = nlim;
+	}
+
+	if (!queue.n_cmds){
+		queue.x1 = x1; queue.y1 = y1;
+		queue.x2 = x2; queue.y2 = y2;
+	}
+	else {
+		queue.x1 = x1 < queue.x1 ? x1 : queue.x1;
+		queue.y1 = y1 < queue.y1 ? y1 : queue.y1;
+		queue.x2 = x2 > queue.x2 ? x2 : queue.x2;
+		queue.y2 = y2 > queue.y2 ? y2 : queue.y2;
+	}
+
+	struct soft_cmd* c = &queue.cmds[queue.n_cmds++];
+	*c = (struct soft_cmd){
+		.kind = kind,
+		.x1 = x1, .y1 = y1, .x2 = x2, .y2 = y2
+	};
+
+	return c;
+}
+
+static struct soft_tri* tri_add()
+{
+	if (queue.n_tris == queue.tri_limit){
+		size_t nlim = queue.tri_limit ? queue.tri_limit * 2 : 1024;
+		struct soft_tri* ntris = arcan_alloc_mem(sizeof(struct soft_tri) * nlim,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+		if (!ntris)
+			return NULL;
+		if (queue.tris)
+			memcpy(ntris, queue.tris, sizeof(struct soft_tri) * queue.n_tris);
+		arcan_mem_free(queue.tris);
+		queue.tris = ntris;
+		queue.tri_limit = nlim;
+	}
+
+	return &queue.tris[queue.n_tris++];
+}
+
+static bool shader_color()
+{
+	if (!agp_shader_valid(st.shader))
+		return st.vstore == NULL;
+	return shaders[SHADER_INDEX(st.shader)].color;
+}
+
+/* fill out color / sampler state for a draw, false if it would be a no-op */
+static bool cmd_state(struct soft_cmd* c, bool depth, int depth_func)
+{
+	float opa = st.opacity < 0.0 ? 0.0 : (st.opacity > 1.0 ? 1.0 : st.opacity);
+	c->opacity = opa * 255.0f + 0.5f;
+	c->blend = st.blend;
+	c->retain_alpha = st.retain_alpha;
+	c->stencil = st.stencil;
+	c->depth = depth ? depth_func + 1 : 0;
+
+	if (shader_color()){
+		float* col = agp_shader_valid(st.shader) ?
+			shaders[SHADER_INDEX(st.shader)].col : (float[]){1.0, 1.0, 1.0};
+		c->col = RGBA(
+			clampi(col[0] * 255.0f + 0.5f, 0, 255),
+			clampi(col[1] * 255.0f + 0.5f, 0, 255),
+			clampi(col[2] * 255.0f + 0.5f, 0, 255), c->opacity
+		);
+		return true;
+	}
+
+	struct soft_tex* t = NULL;
+	if (st.vstore && st.vstore->txmapped == TXSTATE_TEX2D)
+		t = tex_get(agp_resolve_texid(st.vstore));
+
+/* incomplete texture, that samples as opaque black */
+	if (!t || !t->buf){
+		c->col = RGBA(0, 0, 0, c->opacity);
+		return true;
+	}
+
+	c->tex = t->buf;
+	c->tw = t->w;
+	c->th = t->h;
+	c->bilinear = (st.vstore->filtermode & (~ARCAN_VFILTER_MIPMAP)) != ARCAN_VFILTER_NONE;
+	c->repeat_s = st.vstore->txu == ARCAN_VTEX_REPEAT;
+	c->repeat_t = st.vstore->txv == ARCAN_VTEX_REPEAT;
+	return true;
+}
+
+struct clipv {
+	float x, y, z, w, u, v;
+};
+
+static size_t clip_plane(struct clipv* in, size_t n, struct clipv* out, int plane)
+{
+	size_t no = 0;
+
+	for (size_t i = 0; i < n; i++){
+		struct clipv* a = &in[i];
+		struct clipv* b = &in[(i + 1) % n];
+		float da, db;
+
+		switch (plane){
+		case 0: da = a->z + a->w; db = b->z + b->w; break;
+		case 1: da = a->w - a->z; db = b->w - b->z; break;
+		default: da = a->w - 1e-5; db = b->w - 1e-5; break;
+		}
+
+		if (da >= 0)
+			out[no++] = *a;
+
+		if ((da >= 0) != (db >= 0)){
+			float t = da / (da - db);
+			out[no++] = (struct clipv){
+				.x = a->x + t * (b->x - a->x),
+				.y = a->y + t * (b->y - a->y),
+				.z = a->z + t * (b->z - a->z),
+				.w = a->w + t * (b->w - a->w),
+				.u = a->u + t * (b->u - a->u),
+				.v = a->v + t * (b->v - a->v)
+			};
+		}
+	}
+
+	return no;
+}
+
+static struct soft_vert to_window(struct clipv* cv)
+{
+	float iw = 1.0 / cv->w;
+	return (struct soft_vert){
+		.x = st.vp[0] + (cv->x * iw + 1.0) * 0.5 * st.vp[2],
+		.y = st.vp[1] + (cv->y * iw + 1.0) * 0.5 * st.vp[3],
+		.z = (cv->z * iw + 1.0) * 0.5,
+		.iw = iw,
+		.u = cv->u * iw,
+		.v = cv->v * iw
+	};
+}
+
+static inline int32_t to_subpx(float v)
+{
+	v = v < -SOFT_GUARD ? -SOFT_GUARD : (v > SOFT_GUARD ? SOFT_GUARD : v);
+	return lrintf(v * SOFT_SUBPX);
+}
+
+/* [cull] 0 none, 1 back, 2 front */
+static void emit_tri(struct soft_cmd* c,
+	struct soft_vert* a, struct soft_vert* b, struct soft_vert* d, int cull)
+{
+	struct soft_vert v[3] = {*a, *b, *d};
+	int32_t fx[3], fy[3];
+
+	for (size_t i = 0; i < 3; i++){
+		fx[i] = to_subpx(v[i].x);
+		fy[i] = to_subpx(v[i].y);
+	}
+
+	int64_t area = (int64_t)(fx[1] - fx[0]) * (fy[2] - fy[0]) -
+		(int64_t)(fy[1] - fy[0]) * (fx[2] - fx[0]);
+
+/* counter-clockwise in window coordinates is the front face */
+	if (!area || (cull == 1 && area < 0) || (cull == 2 && area > 0))
+		return;
+
+	if (area < 0){
+		struct soft_vert tv = v[1]; v[1] = v[2]; v[2] = tv;
+		int32_t tx = fx[1]; fx[1] = fx[2]; fx[2] = tx;
+		int32_t ty = fy[1]; fy[1] = fy[2]; fy[2] = ty;
+		area = -area;
+	}
+
+	int x1 = floorf((float) ((fx[0] < fx[1] ? (fx[0] < fx[2] ? fx[0] : fx[2]) :
+		(fx[1] < fx[2] ? fx[1] : fx[2]))) / SOFT_SUBPX);
+	int y1 = floorf((float) ((fy[0] < fy[1] ? (fy[0] < fy[2] ? fy[0] : fy[2]) :
+		(fy[1] < fy[2] ? fy[1] : fy[2]))) / SOFT_SUBPX);
+	int x2 = ceilf((float) ((fx[0] > fx[1] ? (fx[0] > fx[2] ? fx[0] : fx[2]) :
+		(fx[1] > fx[2] ? fx[1] : fx[2]))) / SOFT_SUBPX);
+	int y2 = ceilf((float) ((fy[0] > fy[1] ? (fy[0] > fy[2] ? fy[0] : fy[2]) :
+		(fy[1] > fy[2] ? fy[1] : fy[2]))) / SOFT_SUBPX);
+
+	x1 = x1 > c->x1 ? x1 : c->x1;
+	y1 = y1 > c->y1 ? y1 : c->y1;
+	x2 = x2 < c->x2 ? x2 : c->x2;
+	y2 = y2 < c->y2 ? y2 : c->y2;
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	struct soft_tri* t = tri_add();
+	if (!t)
+		return;
+
+	*t = (struct soft_tri){
+		.area = area,
+		.x1 = x1, .y1 = y1, .x2 = x2, .y2 = y2
+	};
+
+	for (size_t i = 0; i < 3; i++){
+		t->v[i] = v[i];
+		t->fx[i] = fx[i];
+		t->fy[i] = fy[i];
+
+/* top-left rule, shared edges are walked in opposite directions so exactly
+ * one of the two triangles gets the pixels right on the edge */
+		int32_t dx = fx[(i + 2) % 3] - fx[(i + 1) % 3];
+		int32_t dy = fy[(i + 2) % 3] - fy[(i + 1) % 3];
+		t->tl[i] = dy > 0 || (dy == 0 && dx < 0);
+	}
+
+	c->tris.count++;
+	if (v[0].iw != 1.0 || v[1].iw != 1.0 || v[2].iw != 1.0)
+		c->perspective = true;
+}
+
+/* [clip] is n vertices in clip space, [uv] 2 floats per vertex, [ind] (or
+ * sequential if NULL) n_ind indices forming triangles */
+static void record_tris(const float* clip, const float* uv, size_t n,
+	const unsigned* ind, size_t n_ind, bool depth, int depth_func, int cull)
+{
+	struct soft_cmd* c = cmd_add(CMD_TRIS, st.clip[0], st.clip[1], st.clip[2], st.clip[3]);
+	if (!c)
+		return;
+
+	if (!cmd_state(c, depth, depth_func)){
+		queue.n_cmds--;
+		return;
+	}
+
+	c->tris.first = queue.n_tris;
+
+	for (size_t i = 0; i + 2 < n_ind; i += 3){
+		struct clipv in[9], tmp[9];
+		size_t nv = 3;
+
+		for (size_t j = 0; j < 3; j++){
+			size_t vi = ind ? ind[i + j] : i + j;
+			const float* p = &clip[vi * 4];
+			in[j] = (struct clipv){
+				.x = p[0], .y = p[1], .z = p[2], .w = p[3],
+				.u = uv ? uv[vi * 2] : 0.0,
+				.v = uv ? uv[vi * 2 + 1] : 0.0
+			};
+		}
+
+/* only go through the clipper when something is outside near/far */
+		bool inside = true;
+		for (size_t j = 0; j < 3 && inside; j++)
+			inside = in[j].z + in[j].w >= 0 &&
+				in[j].w - in[j].z >= 0 && in[j].w > 1e-5;
+
+		if (!inside){
+			nv = clip_plane(in, nv, tmp, 0);
+			nv = clip_plane(tmp, nv, in, 1);
+			nv = clip_plane(in, nv, tmp, 2);
+			memcpy(in, tmp, sizeof(struct clipv) * nv);
+		}
+
+		if (nv < 3)
+			continue;
+
+		struct soft_vert wv[9];
+		for (size_t j = 0; j < nv; j++)
+			wv[j] = to_window(&in[j]);
+
+		for (size_t j = 1; j + 1 < nv; j++)
+			emit_tri(c, &wv[0], &wv[j], &wv[j + 1], cull);
+	}
+
+	if (!c->tris.count)
+		queue.n_cmds--;
+}
+
+/*
+ * Axis aligned quads with axis aligned texture coordinates, which is most of
+ * what a 2D pipeline draws, take the span path instead of two triangles.
+ * [clip] is n vertices in clip space, [uv] 2 floats per vertex.
+ */
+static bool record_rect(const float* clip, const float* uv, size_t n)
+{
+	float wx[n], wy[n];
+	const float eps = 1e-3;
+
+	for (size_t i = 0; i < n; i++){
+		const float* p = &clip[i * 4];
+		if (fabsf(p[3] - 1.0) > 1e-6 || p[2] < -1.0 || p[2] > 1.0)
+			return false;
+		wx[i] = st.vp[0] + (p[0] + 1.0) * 0.5 * st.vp[2];
+		wy[i] = st.vp[1] + (p[1] + 1.0) * 0.5 * st.vp[3];
+	}
+
+	float x1 = wx[0], x2 = wx[0], y1 = wy[0], y2 = wy[0];
+	for (size_t i = 1; i < n; i++){
+		x1 = wx[i] < x1 ? wx[i] : x1;
+		x2 = wx[i] > x2 ? wx[i] : x2;
+		y1 = wy[i] < y1 ? wy[i] : y1;
+		y2 = wy[i] > y2 ? wy[i] : y2;
+	}
+
+	if (x2 - x1 < eps || y2 - y1 < eps)
+		return false;
+
+/* every vertex has to be on a corner, with u following x and v following y */
+	float u[2], v[2];
+	bool hu[2] = {false, false}, hv[2] = {false, false};
+
+	for (size_t i = 0; i < n; i++){
+		int sx = fabsf(wx[i] - x1) < eps ? 0 : (fabsf(wx[i] - x2) < eps ? 1 : -1);
+		int sy = fabsf(wy[i] - y1) < eps ? 0 : (fabsf(wy[i] - y2) < eps ? 1 : -1);
+		if (sx == -1 || sy == -1)
+			return false;
+
+		float cu = uv ? uv[i * 2] : 0.0;
+		float cv = uv ? uv[i * 2 + 1] : 0.0;
+
+		if (!hu[sx]){
+			u[sx] = cu;
+			hu[sx] = true;
+		}
+		else if (fabsf(u[sx] - cu) > 1e-6)
+			return false;
+
+		if (!hv[sy]){
+			v[sy] = cv;
+			hv[sy] = true;
+		}
+		else if (fabsf(v[sy] - cv) > 1e-6)
+			return false;
+	}
+
+	if (!hu[0] || !hu[1] || !hv[0] || !hv[1])
+		return false;
+
+	float cx1 = ceilf(fmaxf(x1, -SOFT_GUARD) - 0.5);
+	float cy1 = ceilf(fmaxf(y1, -SOFT_GUARD) - 0.5);
+	float cx2 = ceilf(fminf(x2, SOFT_GUARD) - 0.5);
+	float cy2 = ceilf(fminf(y2, SOFT_GUARD) - 0.5);
+
+	struct soft_cmd* c = cmd_add(CMD_RECT, cx1, cy1, cx2, cy2);
+	if (!c)
+		return true;
+
+	if (!cmd_state(c, false, 0)){
+		queue.n_cmds--;
+		return true;
+	}
+
+	if (c->tex){
+		float du = (u[1] - u[0]) / (x2 - x1);
+		float dv = (v[1] - v[0]) / (y2 - y1);
+		c->rect.u = to_fx(u[0] + (c->x1 + 0.5 - x1) * du, c->tw);
+		c->rect.v = to_fx(v[0] + (c->y1 + 0.5 - y1) * dv, c->th);
+		c->rect.du = to_fx(du, c->tw);
+		c->rect.dv = to_fx(dv, c->th);
+
+/* snap near-exact 1:1 steps so that the row copy path gets used */
+		if (llabs(c->rect.du - 65536) < 2 && llabs(c->rect.dv) <= 65536 + 2){
+			c->rect.du = 65536;
+			c->rect.dv = c->rect.dv > 0 ? 65536 : -65536;
+		}
+
+/* bilinear sampling at texel centers is the same as nearest */
+		if (c->bilinear &&
+			labs(c->rect.du) == 65536 && labs(c->rect.dv) == 65536 &&
+			((c->rect.u + 32768) & 0xffff) < 256 &&
+			((c->rect.v + 32768) & 0xffff) < 256){
+			c->bilinear = false;
+		}
+	}
+
+	return true;
+}
+
+static void record_quads(const float* clip, const float* uv, size_t n_verts)
+{
+	if (!dst_bind())
+		return;
+
+	if (st.stencil != STENCIL_OFF && !aux_ensure(false, true))
+		return;
+
+	if (record_rect(clip, uv, n_verts))
+		return;
+
+	if (n_verts == 4){
+		unsigned fan[] = {0, 1, 2, 0, 2, 3};
+		record_tris(clip, uv, 4, fan, 6, false, 0, 0);
+	}
+	else
+		record_tris(clip, uv, n_verts, NULL, n_verts, false, 0, 0);
+}
+
+/*
+ * Environment
+ */
+struct agp_fenv* agp_alloc_fenv(
+	void*(lookup)(void* tag, const char* sym, bool req), void* tag)
+{
+	return arcan_alloc_mem(sizeof(struct agp_fenv),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+}
+
+void agp_glinit_fenv(struct agp_fenv* dst,
+	void*(*lookup)(void* tag, const char* sym, bool req), void* tag)
+{
+}
+
+struct agp_fenv* agp_env()
+{
+	return current_env;
+}
+
+void agp_setenv(struct agp_fenv* dst)
+{
+	current_env = dst ? dst : &default_env;
+}
+
+void agp_dropenv(struct agp_fenv* env)
+{
+	if (!env || env == &default_env)
+		return;
+
+	if (env == current_env)
+		current_env = &default_env;
+
+	arcan_mem_free(env);
+}
+
+void agp_init()
+{
+	pool_init();
+	identity_matrix(st.modelview);
+	identity_matrix(st.projection);
+	st.mode = PIPELINE_2D;
+	st.stencil = STENCIL_OFF;
+	agp_activate_rendertarget(NULL);
+}
+
+const char* agp_ident()
+{
+	return "SOFT";
+}
+
+const char* agp_backend_ident()
+{
+	return "SOFT";
+}
+
+/* shaders are not executed, but appls pick sources based on this so
+ * report the oldest version the GL backends accept */
+const char* agp_shader_language()
+{
+	return "GLSL120";
+}
+
+const char** agp_envopts()
+{
+	static const char* env[] = {
+		"ARCAN_AGP_SOFT_THREADS=n",
+		"Number of rasterizer threads (default: one per core, max 16)",
+		NULL
+	};
+	return env;
+}
+
+bool agp_status_ok(const char** msg)
+{
+	return true;
+}
+
+bool agp_accelerated()
+{
+	return false;
+}
+
+void agp_render_options(struct agp_render_options opts)
+{
+}
+
+/*
+ * Shaders
+ */
+agp_shader_id agp_default_shader(enum SHADER_TYPES type)
+{
+	static agp_shader_id shids[SHADER_TYPE_ENDM];
+	static bool defshdr_build;
+
+	if (type >= SHADER_TYPE_ENDM)
+		return BROKEN_SHADER;
+
+	if (!defshdr_build){
+		shids[BASIC_2D] = agp_shader_build("DEFAULT", NULL, defvprg, deffprg);
+		shids[COLOR_2D] = agp_shader_build(
+			"DEFAULT_COLOR", NULL, defcvprg, defcfprg);
+		shids[BASIC_3D] = shids[BASIC_2D];
+		defshdr_build = true;
+	}
+
+	return shids[type];
+}
+
+void agp_shader_source(enum SHADER_TYPES type,
+	const char** vert, const char** frag)
+{
+	switch (type){
+	case COLOR_2D:
+		*vert = defcvprg;
+		*frag = defcfprg;
+	break;
+	default:
+		*vert = defvprg;
+		*frag = deffprg;
+	break;
+	}
+}
+
+bool agp_shader_valid(agp_shader_id id)
+{
+	return id != BROKEN_SHADER &&
+		SHADER_INDEX(id) < SOFT_SHADER_LIMIT && shaders[SHADER_INDEX(id)].label;
+}
+
+static void shader_free(struct soft_shader* cur)
+{
+	free(cur->label);
+	free(cur->vertex);
+	free(cur->fragment);
+	*cur = (struct soft_shader){0};
+}
+
+agp_shader_id agp_shader_build(const char* tag,
+	const char* geom, const char* vert, const char* frag)
+{
+	if (!tag)
+		return BROKEN_SHADER;
+
+	if (!vert)
+		vert = defvprg;
+	if (!frag)
+		frag = deffprg;
+
+	ssize_t dst = -1;
+	for (size_t i = 0; i < SOFT_SHADER_LIMIT && dst == -1; i++)
+		if (shaders[i].label && strcmp(shaders[i].label, tag) == 0)
+			dst = i;
+
+	for (size_t i = 0; i < SOFT_SHADER_LIMIT && dst == -1; i++)
+		if (!shaders[i].label)
+			dst = i;
+
+	if (dst == -1)
+		return BROKEN_SHADER;
+
+	struct soft_shader* cur = &shaders[dst];
+	shader_free(cur);
+	cur->label = strdup(tag);
+	cur->vertex = strdup(vert);
+	cur->fragment = strdup(frag);
+	cur->col[0] = cur->col[1] = cur->col[2] = 1.0;
+
+/* anything that samples is treated as the default textured one */
+	cur->color = !strstr(frag, "sampler") && strstr(frag, "obj_col");
+
+	return SHADER_ID(dst, 0);
+}
+
+bool agp_shader_destroy(agp_shader_id shid)
+{
+	if (!agp_shader_valid(shid) ||
+		shid == agp_default_shader(BASIC_2D) ||
+		shid == agp_default_shader(COLOR_2D))
+		return false;
+
+	if (GROUP_INDEX(shid) == 0)
+		shader_free(&shaders[SHADER_INDEX(shid)]);
+
+	if (st.shader == shid)
+		st.shader = BROKEN_SHADER;
+
+	return true;
+}
+
+int agp_shader_activate(agp_shader_id shid)
+{
+	if (!agp_shader_valid(shid))
+		return ARCAN_ERRC_NO_SUCH_OBJECT;
+
+	st.shader = shid;
+	return ARCAN_OK;
+}
+
+agp_shader_id agp_shader_lookup(const char* tag)
+{
+	for (size_t i = 0; i < SOFT_SHADER_LIMIT; i++)
+		if (shaders[i].label && strcmp(tag, shaders[i].label) == 0)
+			return i;
+
+	return BROKEN_SHADER;
+}
+
+const char* agp_shader_lookuptag(agp_shader_id id)
+{
+	if (!agp_shader_valid(id))
+		return NULL;
+
+	return shaders[SHADER_INDEX(id)].label;
+}
+
+bool agp_shader_lookupprgs(agp_shader_id id,
+	const char** vert, const char** frag)
+{
+	if (!agp_shader_valid(id))
+		return false;
+
+	if (vert)
+		*vert = shaders[SHADER_INDEX(id)].vertex;
+	if (frag)
+		*frag = shaders[SHADER_INDEX(id)].fragment;
+
+	return true;
+}
+
+agp_shader_id agp_shader_addgroup(agp_shader_id shid)
+{
+	if (!agp_shader_valid(shid))
+		return BROKEN_SHADER;
+
+	struct soft_shader* cur = &shaders[SHADER_INDEX(shid)];
+	if (cur->groups == 65535)
+		return BROKEN_SHADER;
+
+	return SHADER_ID(SHADER_INDEX(shid), ++cur->groups);
+}
+
+int agp_shader_vattribute_loc(enum shader_vertex_attributes attr)
+{
+	return attr == ATTRIBUTE_VERTEX || attr == ATTRIBUTE_TEXCORD0 ? attr : -1;
+}
+
+int agp_shader_envv(enum agp_shader_envts slot, void* value, size_t size)
+{
+	switch (slot){
+	case MODELVIEW_MATR:
+		memcpy(st.modelview, value, sizeof(float) * 16);
+	break;
+	case PROJECTION_MATR:
+		memcpy(st.projection, value, sizeof(float) * 16);
+	break;
+	case OBJ_OPACITY:
+		memcpy(&st.opacity, value, sizeof(float));
+	break;
+	default:
+	break;
+	}
+	return 0;
+}
+
+#define TBLSIZE (1 + VR_REPROJECT - MODELVIEW_MATR)
+static char* symtbl[TBLSIZE] = {
+	"modelview",
+	"projection",
+	"texturem",
+	"obj_opacity",
+	"trans_blend",
+	"trans_move",
+	"trans_scale",
+	"trans_rotate",
+	"obj_input_sz",
+	"obj_output_sz",
+	"obj_storage_sz",
+	"rtgt_id",
+	"fract_timestamp",
+	"timestamp",
+	"vr_reproject"
+};
+
+const char* agp_shader_symtype(enum agp_shader_envts env)
+{
+	return symtbl[env];
+}
+
+void agp_shader_forceunif(const char* label, enum shdrutype type, void* value)
+{
+	if (!agp_shader_valid(st.shader))
+		return;
+
+	if (type == shdrvec3 && strcmp(label, "obj_col") == 0)
+		memcpy(shaders[SHADER_INDEX(st.shader)].col, value, sizeof(float) * 3);
+}
+
+void agp_shader_flush()
+{
+	for (size_t i = 0; i < SOFT_SHADER_LIMIT; i++)
+		shader_free(&shaders[i]);
+	st.shader = BROKEN_SHADER;
+}
+
+void agp_shader_cache(const char* dir)
+{
+}
+
+void agp_shader_unload_all()
+{
+}
+
+void agp_shader_rebuild_all()
+{
+}
+
+/*
+ * Vstores
+ */
+void agp_activate_vstore(struct agp_vstore* s)
+{
+	st.vstore = s;
+}
+
+void agp_deactivate_vstore()
+{
+	st.vstore = NULL;
+}
+
+void agp_activate_vstore_multi(struct agp_vstore** backing, size_t n)
+{
+	st.vstore = n ? backing[0] : NULL;
+}
+
+unsigned agp_resolve_texid(struct agp_vstore* vs)
+{
+	if (vs->vinf.text.glid_proxy)
+		return *vs->vinf.text.glid_proxy;
+	else
+		return vs->vinf.text.glid;
+}
+
+enum vstore_hint agp_vstore_setformat(
+	struct agp_vstore* vs, enum vstore_hint hint)
+{
+/* everything is stored as av_pixel, keep the alpha part of the hint */
+	switch (hint){
+	case VSTORE_HINT_NORMAL_NOALPHA:
+	case VSTORE_HINT_LODEF_NOALPHA:
+	case VSTORE_HINT_HIDEF_NOALPHA:
+	case VSTORE_HINT_F16_NOALPHA:
+	case VSTORE_HINT_F32_NOALPHA:
+		hint = VSTORE_HINT_NORMAL_NOALPHA;
+	break;
+	default:
+		hint = VSTORE_HINT_NORMAL;
+	break;
+	}
+
+	vs->hdr.depth = hint;
+	vs->bpp = sizeof(av_pixel);
+	return hint;
+}
+
+void agp_empty_vstoreext(struct agp_vstore* vs,
+	size_t w, size_t h, enum vstore_hint hint)
+{
+	agp_vstore_setformat(vs, hint);
+	vs->w = w;
+	vs->h = h;
+	vs->txmapped = TXSTATE_TEX2D;
+
+	soft_flush();
+	struct soft_tex* t = vstore_tex(vs);
+	if (t)
+		memset(t->buf, '\0', t->w * t->h * sizeof(av_pixel));
+
+	if (vs->refcount == 0)
+		vs->refcount = 1;
+	vs->vinf.text.glid_proxy = NULL;
+	vs->update_ts = arcan_timemillis();
+	vs->update_seq++;
+	FLAG_DIRTY();
+}
+
+void agp_empty_vstore(struct agp_vstore* vs, size_t w, size_t h)
+{
+	agp_empty_vstoreext(vs, w, h, VSTORE_HINT_NORMAL);
+}
+
+bool agp_slice_vstore(struct agp_vstore* backing,
+	size_t n_slices, size_t base, enum txstate txstate)
+{
+	return false;
+}
+
+bool agp_slice_synch(
+	struct agp_vstore* backing, size_t n_slices, struct agp_vstore** slices)
+{
+	return false;
+}
+
+static void drop_rbring(struct agp_vstore* s)
+{
+	struct agp_rbring* ring = s->vinf.text.rbring;
+	if (!ring)
+		return;
+
+	for (size_t i = 0; i < RBRING_LIMIT; i++)
+		arcan_mem_free(ring->slots[i].buf);
+
+	arcan_mem_free(ring);
+	s->vinf.text.rbring = NULL;
+}
+
+void agp_update_vstore(struct agp_vstore* s, bool copy)
+{
+	if (s->txmapped == TXSTATE_OFF)
+		return;
+
+	FLAG_DIRTY();
+
+	if (copy){
+		soft_flush();
+		if (s->refcount == 0)
+			s->refcount = 1;
+
+		struct soft_tex* t = vstore_tex(s);
+		if (t && s->txmapped == TXSTATE_TEX2D && s->vinf.text.raw &&
+			!s->vinf.text.compressed &&
+			s->vinf.text.s_raw >= s->w * s->h * sizeof(av_pixel)){
+			tex_copy(t, s->vinf.text.raw, s->w, 0, 0, s->w, s->h, noalpha(s));
+		}
+
+		s->update_ts = arcan_timemillis();
+		s->update_seq++;
+	}
+
+	s->vinf.text.glid_proxy = NULL;
+
+	if (arcan_video_display.conservative){
+		arcan_mem_free(s->vinf.text.raw);
+		s->vinf.text.raw = NULL;
+		s->vinf.text.s_raw = 0;
+	}
+}
+
+static void alloc_buffer(struct agp_vstore* s)
+{
+	if (s->vinf.text.s_raw != s->w * s->h * sizeof(av_pixel)){
+		arcan_mem_free(s->vinf.text.raw);
+		s->vinf.text.raw = NULL;
+	}
+
+	if (!s->vinf.text.raw){
+		s->vinf.text.s_raw = s->w * s->h * sizeof(av_pixel);
+		s->vinf.text.raw = arcan_alloc_mem(s->vinf.text.s_raw,
+			ARCAN_MEM_VBUFFER, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_PAGE);
+	}
+}
+
+void agp_resize_vstore(struct agp_vstore* s, size_t w, size_t h)
+{
+	s->w = w;
+	s->h = h;
+	s->bpp = sizeof(av_pixel);
+	s->vinf.text.compressed = 0;
+	s->vinf.text.mip_levels = 0;
+
+	alloc_buffer(s);
+	agp_update_vstore(s, true);
+}
+
+static void stream_copy(struct agp_vstore* s,
+	const av_pixel* buf, struct stream_meta* meta, size_t stride, bool synch)
+{
+	soft_flush();
+	struct soft_tex* t = vstore_tex(s);
+	if (!t || !buf)
+		return;
+
+	size_t x1 = 0, y1 = 0, w = s->w, h = s->h;
+	if (meta->dirty){
+		x1 = meta->x1;
+		y1 = meta->y1;
+		w = meta->w;
+		h = meta->h;
+	}
+
+	tex_copy(t, buf, stride, x1, y1, w, h, noalpha(s));
+
+	if (synch && s->vinf.text.raw && buf != s->vinf.text.raw){
+		for (size_t y = y1; y < y1 + h && y < s->h; y++)
+			memcpy(&s->vinf.text.raw[y * s->w + x1],
+				&buf[y * stride + x1], w * sizeof(av_pixel));
+		s->update_ts = arcan_timemillis();
+		s->update_seq++;
+	}
+}
+
+struct stream_meta agp_stream_prepare(struct agp_vstore* s,
+		struct stream_meta meta, enum stream_type type)
+{
+	struct stream_meta res = meta;
+	res.state = true;
+	res.type = type;
+
+	switch (type){
+	case STREAM_RAW:
+		alloc_buffer(s);
+		res.buf = s->vinf.text.raw;
+		res.state = res.buf != NULL;
+	break;
+
+	case STREAM_RAW_DIRECT_COPY:
+		alloc_buffer(s);
+	case STREAM_RAW_DIRECT:
+		stream_copy(s, meta.buf, &meta, s->w, type == STREAM_RAW_DIRECT_COPY);
+	break;
+
+	case STREAM_EXT_RESYNCH:
+		agp_null_vstore(s);
+		agp_update_vstore(s, true);
+	break;
+
+	case STREAM_RAW_DIRECT_SYNCHRONOUS:
+		stream_copy(s, meta.buf, &meta, meta.stride ? meta.stride : s->w, false);
+	break;
+
+	case STREAM_HANDLE:
+		if (!s->vinf.text.glid)
+			s->vinf.text.glid = tex_alloc();
+		res.state = platform_video_map_buffer(s, meta.planes, meta.used);
+	break;
+	}
+
+	return res;
+}
+
+void agp_stream_release(struct agp_vstore* s, struct stream_meta meta)
+{
+	stream_copy(s, s->vinf.text.raw, &meta, s->w, false);
+}
+
+void agp_stream_commit(struct agp_vstore* s, struct stream_meta meta)
+{
+}
+
+void agp_null_vstore(struct agp_vstore* store)
+{
+	if (!store ||
+		store->txmapped != TXSTATE_TEX2D || store->vinf.text.glid == 0)
+		return;
+
+	soft_flush();
+	tex_free(store->vinf.text.glid);
+	store->vinf.text.glid = 0;
+	store->vinf.text.glid_proxy = NULL;
+	drop_rbring(store);
+}
+
+void agp_drop_vstore(struct agp_vstore* s)
+{
+	if (!s || s->vinf.text.glid == 0)
+		return;
+
+	if (s->vinf.text.tag)
+		platform_video_map_handle(s, -1);
+
+	if (s->vinf.text.kind == STORAGE_TEXT){
+		arcan_mem_free(s->vinf.text.source);
+	}
+	else if (s->vinf.text.kind == STORAGE_TPACK){
+		arcan_mem_free(s->vinf.text.tpack.buf);
+	}
+	if (s->vinf.text.kind == STORAGE_TEXTARRAY){
+		char** work = s->vinf.text.source_arr;
+		while(*work){
+			arcan_mem_free(*work);
+			work++;
+		}
+		arcan_mem_free(s->vinf.text.source_arr);
+	}
+
+	soft_flush();
+	tex_free(s->vinf.text.glid);
+	drop_rbring(s);
+
+	if (st.vstore == s)
+		st.vstore = NULL;
+
+	memset(s, '\0', sizeof(struct agp_vstore));
+}
+
+void agp_vstore_copyreg(
+	struct agp_vstore* restrict src, struct agp_vstore* restrict dst,
+	size_t x1, size_t y1, size_t x2, size_t y2)
+{
+	if (!src || !dst || y1 > dst->h || y1 > src->h || x1 > dst->w || x1 > src->w)
+		return;
+
+	if (y2 > dst->h)
+		y2 = dst->h;
+	if (y2 > src->h)
+		y2 = src->h;
+	if (x2 > dst->w)
+		x2 = dst->w;
+	if (x2 > src->w)
+		x2 = src->w;
+
+	if (x2 <= x1 || y2 <= y1)
+		return;
+
+	size_t line_w = (x2 - x1) * sizeof(av_pixel);
+	size_t dst_pitch = dst->vinf.text.stride / sizeof(av_pixel);
+	size_t src_pitch = src->vinf.text.stride / sizeof(av_pixel);
+
+	if (!dst_pitch)
+		dst_pitch = dst->w;
+	if (!src_pitch)
+		src_pitch = src->w;
+
+	for (size_t y = y1; y < y2; y++){
+		memcpy(
+			&dst->vinf.text.raw[y * dst_pitch + x1],
+			&src->vinf.text.raw[y * src_pitch + x1], line_w
+		);
+	}
+}
+
+/*
+ * Readbacks, the copy is made when requested so the ring only decouples it
+ * from the consumer
+ */
+void agp_readback_synchronous(struct agp_vstore* dst)
+{
+	if (dst->txmapped != TXSTATE_TEX2D || !dst->vinf.text.raw)
+		return;
+
+	soft_flush();
+	struct soft_tex* t = tex_get(agp_resolve_texid(dst));
+	if (!t || !t->buf)
+		return;
+
+	size_t sz = t->w * t->h * sizeof(av_pixel);
+	memcpy(dst->vinf.text.raw, t->buf, sz < dst->vinf.text.s_raw ? sz : dst->vinf.text.s_raw);
+	dst->update_ts = arcan_timemillis();
+	dst->update_seq++;
+}
+
+void agp_readback_ring(size_t depth)
+{
+	if (!depth)
+		depth = 1;
+	rbring_depth = depth > RBRING_LIMIT ? RBRING_LIMIT : depth;
+}
+
+void agp_upload_ring(size_t mb)
+{
+}
+
+bool agp_request_readback(struct agp_vstore* s)
+{
+	if (!s || s->txmapped != TXSTATE_TEX2D || !s->vinf.text.glid)
+		return false;
+
+	struct agp_rbring* ring = s->vinf.text.rbring;
+	if (!ring){
+		ring = arcan_alloc_mem(sizeof(struct agp_rbring),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+		if (!ring)
+			return false;
+		ring->depth = rbring_depth;
+		s->vinf.text.rbring = ring;
+	}
+
+	if (ring->count == ring->depth)
+		return false;
+
+	soft_flush();
+	struct soft_tex* t = tex_get(agp_resolve_texid(s));
+	if (!t || !t->buf)
+		return false;
+
+	struct rbslot* slot = &ring->slots[ring->head];
+	if (slot->w != t->w || slot->h != t->h || !slot->buf){
+		arcan_mem_free(slot->buf);
+		slot->buf = arcan_alloc_mem(t->w * t->h * sizeof(av_pixel),
+			ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+		if (!slot->buf){
+			slot->w = slot->h = 0;
+			return false;
+		}
+		slot->w = t->w;
+		slot->h = t->h;
+	}
+
+	memcpy(slot->buf, t->buf, t->w * t->h * sizeof(av_pixel));
+	ring->head = (ring->head + 1) % ring->depth;
+	ring->count++;
+	return true;
+}
+
+static void rbring_release(void* tag)
+{
+	struct agp_rbring* ring = tag;
+	if (!ring->mapped)
+		return;
+
+	ring->mapped = false;
+	ring->count--;
+}
+
+struct asynch_readback_meta agp_poll_readback(struct agp_vstore* s)
+{
+	struct asynch_readback_meta res = {0};
+	struct agp_rbring* ring = s->vinf.text.rbring;
+
+	if (!ring || !ring->count || ring->mapped)
+		return res;
+
+	struct rbslot* slot =
+		&ring->slots[(ring->head + ring->depth - ring->count) % ring->depth];
+
+	ring->mapped = true;
+	res = (struct asynch_readback_meta){
+		.ptr = slot->buf,
+		.buf_sz = slot->w * slot->h * sizeof(av_pixel),
+		.w = slot->w,
+		.h = slot->h,
+		.stride = slot->w * sizeof(av_pixel),
+		.release = rbring_release,
+		.tag = ring,
+		.pending = ring->count - 1
+	};
+
+	return res;
+}
+
+void agp_save_output(size_t w, size_t h, av_pixel* dst, size_t dsz)
+{
+	soft_flush();
+	if (!fb0.tex.buf)
+		return;
+
+	size_t cw = w < fb0.tex.w ? w : fb0.tex.w;
+	size_t ch = h < fb0.tex.h ? h : fb0.tex.h;
+
+	for (size_t y = 0; y < ch && (y + 1) * w * sizeof(av_pixel) <= dsz; y++)
+		memcpy(&dst[y * w], &fb0.tex.buf[y * fb0.tex.w], cw * sizeof(av_pixel));
+}
+
+/*
+ * Rendertargets, the store and damage management follows glshared.c
+ */
+static void erase_store(struct agp_vstore* os)
+{
+	if (!os)
+		return;
+
+	agp_null_vstore(os);
+	arcan_mem_free(os->vinf.text.raw);
+	os->vinf.text.raw = NULL;
+	os->vinf.text.s_raw = 0;
+}
+
+static void setup_stores(struct agp_rendertarget* dst)
+{
+	dst->n_stores = MAX_BUFFERS;
+	dst->dirty_flip = MAX_BUFFERS;
+	dst->n_damage[0] = dst->n_damage[1] = 0;
+	dst->damage_reset = true;
+
+	for (size_t i = 0; i < MAX_BUFFERS; i++){
+		dst->stores[i] = arcan_alloc_mem(sizeof(struct agp_vstore),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		dst->stores[i]->vinf.text.s_fmt = dst->store->vinf.text.s_fmt;
+		dst->stores[i]->vinf.text.d_fmt = dst->store->vinf.text.d_fmt;
+
+		if (dst->alloc){
+			dst->stores[i]->w = dst->store->w;
+			dst->stores[i]->h = dst->store->h;
+			dst->alloc(dst, dst->stores[i], RTGT_ALLOC_SETUP, dst->alloc_tag);
+		}
+		else{
+			agp_empty_vstore(dst->stores[i], dst->store->w, dst->store->h);
+		}
+	}
+}
+
+struct agp_rendertarget* agp_setup_rendertarget(
+	struct agp_vstore* vstore, enum rendertarget_mode m)
+{
+	if (vstore->txmapped == TXSTATE_TEX3D)
+		return NULL;
+
+	struct agp_rendertarget* r = arcan_alloc_mem(sizeof(struct agp_rendertarget),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+
+	r->store = vstore;
+	r->mode = m;
+	r->viewport[0] = 0;
+	r->viewport[1] = 0;
+	r->viewport[2] = vstore->w;
+	r->viewport[3] = vstore->h;
+	r->clearcol[0] = 0.05;
+	r->clearcol[1] = 0.05;
+	r->clearcol[2] = 0.05;
+	r->clearcol[3] = 1.0;
+	r->damage_reset = true;
+
+	if (!agp_resolve_texid(vstore))
+		agp_update_vstore(vstore, true);
+
+	return r;
+}
+
+void agp_rendertarget_allocator(struct agp_rendertarget* tgt, bool (*handler)(
+	struct agp_rendertarget*, struct agp_vstore*, int action, void* tag), void* tag)
+{
+	if (!tgt)
+		return;
+
+	soft_flush();
+	if (tgt->alloc){
+		for (size_t i = 0; i < tgt->n_stores; i++){
+			tgt->alloc(tgt, tgt->stores[i], RTGT_ALLOC_FREE, tgt->alloc_tag);
+			if (tgt->shadow[i]){
+				tgt->alloc(tgt, tgt->shadow[i], RTGT_ALLOC_FREE, tgt->alloc_tag);
+				arcan_mem_free(tgt->shadow[i]);
+				tgt->shadow[i] = NULL;
+			}
+		}
+	}
+
+	tgt->alloc = handler;
+	tgt->alloc_tag = tag;
+
+	if (!tgt->n_stores)
+		return;
+
+	for (size_t i = 0; i < tgt->n_stores; i++){
+		tgt->alloc(tgt, tgt->stores[i], RTGT_ALLOC_SETUP, tgt->alloc_tag);
+	}
+}
+
+void agp_rendertarget_dropswap(struct agp_rendertarget* tgt)
+{
+	if (!tgt || !tgt->n_stores)
+		return;
+
+	soft_flush();
+	for (size_t i = 0; i < tgt->n_stores; i++){
+		if (tgt->alloc){
+			tgt->alloc(tgt, tgt->stores[i], RTGT_ALLOC_FREE, tgt->alloc_tag);
+		}
+		else
+			agp_drop_vstore(tgt->stores[i]);
+
+		if (tgt->shadow[i]){
+			if (tgt->alloc)
+				tgt->alloc(tgt, tgt->shadow[i], RTGT_ALLOC_FREE, tgt->alloc_tag);
+			else
+				agp_drop_vstore(tgt->shadow[i]);
+
+			arcan_mem_free(tgt->shadow[i]);
+			tgt->shadow[i] = NULL;
+		}
+	}
+
+	tgt->n_stores = 0;
+	tgt->store->vinf.text.glid_proxy = NULL;
+	tgt->alloc = NULL;
+	tgt->alloc_tag = NULL;
+	tgt->dirty_flip++;
+	tgt->damage_reset = true;
+}
+
+static void damage_add(struct agp_rendertarget* dst, struct agp_region reg)
+{
+	size_t w = dst->store->w;
+	size_t h = dst->store->h;
+
+	if (reg.x2 > w)
+		reg.x2 = w;
+	if (reg.y2 > h)
+		reg.y2 = h;
+	if (reg.x1 >= reg.x2 || reg.y1 >= reg.y2)
+		return;
+
+	struct agp_region* cur = dst->damage[0];
+	size_t* n = &dst->n_damage[0];
+
+	for (size_t i = 0; i < *n; i++){
+		if (reg.x1 >= cur[i].x1 && reg.x2 <= cur[i].x2 &&
+			reg.y1 >= cur[i].y1 && reg.y2 <= cur[i].y2)
+			return;
+	}
+
+	if (*n < AGP_DAMAGE_LIMIT){
+		cur[(*n)++] = reg;
+		return;
+	}
+
+	for (size_t i = 0; i < *n; i++){
+		reg.x1 = cur[i].x1 < reg.x1 ? cur[i].x1 : reg.x1;
+		reg.y1 = cur[i].y1 < reg.y1 ? cur[i].y1 : reg.y1;
+		reg.x2 = cur[i].x2 > reg.x2 ? cur[i].x2 : reg.x2;
+		reg.y2 = cur[i].y2 > reg.y2 ? cur[i].y2 : reg.y2;
+	}
+	cur[0] = reg;
+	*n = 1;
+}
+
+size_t agp_rendertarget_dirty(
+	struct agp_rendertarget* dst, struct agp_region* dirty)
+{
+	if (!dst || !dst->store)
+		return 0;
+
+	if (dirty){
+		struct agp_region reg = *dirty;
+		if (reg.x1 >= reg.x2 || reg.y1 >= reg.y2){
+			reg = dst->scissor_set ? dst->scissor : (struct agp_region){
+				.x2 = dst->store->w, .y2 = dst->store->h
+			};
+		}
+		damage_add(dst, reg);
+	}
+
+	return dst->n_damage[0] + dst->n_damage[1];
+}
+
+void agp_rendertarget_dirty_reset(
+	struct agp_rendertarget* src, struct agp_region* dst)
+{
+	if (!src)
+		return;
+
+	if (dst){
+		memcpy(dst, src->damage[1], sizeof(struct agp_region) * src->n_damage[1]);
+		memcpy(&dst[src->n_damage[1]],
+			src->damage[0], sizeof(struct agp_region) * src->n_damage[0]);
+	}
+
+	memcpy(src->damage[1], src->damage[0], sizeof(src->damage[0]));
+	src->n_damage[1] = src->n_damage[0];
+	src->n_damage[0] = 0;
+}
+
+static void set_clip(ssize_t x, ssize_t y, ssize_t w, ssize_t h)
+{
+	st.clip[0] = x;
+	st.clip[1] = y;
+	st.clip[2] = x + w;
+	st.clip[3] = y + h;
+}
+
+bool agp_rendertarget_scissor(
+	struct agp_rendertarget* tgt, struct agp_region* region)
+{
+	if (!tgt || !tgt->store)
+		return false;
+
+	ssize_t* vp = tgt->viewport;
+
+	if (!region){
+		tgt->scissor_set = false;
+		if (tgt == active_rendertarget)
+			set_clip(vp[0], vp[1], vp[2], vp[3]);
+		return true;
+	}
+
+	if (tgt->n_stores || tgt->damage_reset || tgt->proxy_state ||
+		vp[0] != 0 || vp[1] != 0 ||
+		vp[2] != tgt->store->w || vp[3] != tgt->store->h)
+		return false;
+
+	struct agp_region reg = *region;
+	if (reg.x2 > tgt->store->w)
+		reg.x2 = tgt->store->w;
+	if (reg.y2 > tgt->store->h)
+		reg.y2 = tgt->store->h;
+	if (reg.x1 >= reg.x2 || reg.y1 >= reg.y2)
+		return false;
+
+	tgt->scissor = reg;
+	tgt->scissor_set = true;
+
+	if (tgt == active_rendertarget)
+		set_clip(reg.x1, reg.y1, reg.x2 - reg.x1, reg.y2 - reg.y1);
+
+	return true;
+}
+
+struct agp_vstore*
+	agp_rendertarget_swap(struct agp_rendertarget* dst, bool* swap)
+{
+	if (!dst || !dst->store){
+		*swap = false;
+		return NULL;
+	}
+
+/* the frame has to be complete before anyone else gets to see the store */
+	soft_flush();
+
+	int old_front = dst->store_ind;
+	int front = dst->store_ind;
+
+	if (!dst->n_stores){
+		setup_stores(dst);
+		FLAG_DIRTY();
+		*swap = false;
+	}
+	else {
+		front = dst->store_ind = (dst->store_ind + 1) % MAX_BUFFERS;
+		*swap = true;
+	}
+
+	dst->store->vinf.text.glid_proxy = &dst->stores[front]->vinf.text.glid;
+
+	if (dst->dirty_flip > 0){
+		dst->dirty_flip--;
+		FLAG_DIRTY();
+
+		if (!dst->dirty_flip){
+			for (size_t i = 0; i < MAX_BUFFERS; i++){
+				if (!dst->shadow[i])
+					continue;
+
+				if (dst->alloc)
+					dst->alloc(dst, dst->shadow[i], RTGT_ALLOC_FREE, dst->alloc_tag);
+				else
+					erase_store(dst->shadow[i]);
+
+				arcan_mem_free(dst->shadow[i]);
+				dst->shadow[i] = NULL;
+			}
+		}
+
+		if (dst->rz_ack){
+			*swap = false;
+			dst->rz_ack = false;
+			return NULL;
+		}
+	}
+
+	return dst->stores[old_front];
+}
+
+bool agp_rendertarget_swapstore(
+	struct agp_rendertarget* tgt, struct agp_vstore* vstore)
+{
+	if (!tgt || !vstore ||
+		vstore->txmapped != TXSTATE_TEX2D || tgt->n_stores ||
+		tgt->store->w != vstore->w || tgt->store->h != vstore->h)
+		return false;
+
+	if (tgt->store == vstore)
+		return true;
+
+	soft_flush();
+	tgt->store = vstore;
+	tgt->damage_reset = true;
+
+	return true;
+}
+
+void agp_rendertarget_proxy(struct agp_rendertarget* tgt,
+	bool (*proxy_state)(struct agp_rendertarget*, uintptr_t tag), uintptr_t tag)
+{
+	tgt->proxy_state = proxy_state;
+	tgt->proxy_tag = tag;
+}
+
+void agp_rendertarget_ids(struct agp_rendertarget* rtgt, uintptr_t* tgt,
+	uintptr_t* col, uintptr_t* depth)
+{
+	if (tgt)
+		*tgt = (uintptr_t) rtgt;
+	if (col)
+		*col = agp_resolve_texid(rtgt->store);
+	if (depth)
+		*depth = 0;
+}
+
+void agp_rendertarget_clearcolor(
+	struct agp_rendertarget* tgt, float r, float g, float b, float a)
+{
+	if (!tgt)
+		return;
+
+	tgt->clearcol[0] = r;
+	tgt->clearcol[1] = g;
+	tgt->clearcol[2] = b;
+	tgt->clearcol[3] = a;
+}
+
+void agp_activate_rendertarget(struct agp_rendertarget* tgt)
+{
+	soft_flush();
+	st.proxied = false;
+
+	if (!tgt){
+		struct monitor_mode mode = platform_video_dimensions();
+		agp_blendstate(BLEND_NONE);
+		st.retain_alpha = false;
+		tex_size(&fb0.tex, mode.width, mode.height);
+		st.vp[0] = st.vp[1] = 0;
+		st.vp[2] = mode.width;
+		st.vp[3] = mode.height;
+		set_clip(0, 0, mode.width, mode.height);
+		active_rendertarget = NULL;
+		return;
+	}
+
+	agp_blendstate(BLEND_NORMAL);
+	st.retain_alpha = tgt->mode & RENDERTARGET_RETAIN_ALPHA;
+
+	if (tgt->store->refcount < 2 &&
+		tgt->proxy_state && tgt->proxy_state(tgt, tgt->proxy_tag)){
+		st.proxied = true;
+		tex_size(&fb0.tex, tgt->store->w, tgt->store->h);
+	}
+
+	ssize_t* vp = tgt->viewport;
+	tgt->scissor_set = false;
+	memcpy(st.vp, vp, sizeof(st.vp));
+	set_clip(vp[0], vp[1], vp[2], vp[3]);
+
+	active_rendertarget = tgt;
+}
+
+void agp_drop_rendertarget(struct agp_rendertarget* tgt)
+{
+	if (!tgt)
+		return;
+
+	if (tgt == active_rendertarget)
+		agp_activate_rendertarget(NULL);
+
+	soft_flush();
+	if (queue.dst.aux == &tgt->aux)
+		queue.dst = (struct soft_dst){0};
+
+	if (tgt->n_stores){
+		for (size_t i = 0; i < tgt->n_stores; i++){
+			agp_drop_vstore(tgt->stores[i]);
+			if (tgt->shadow[i]){
+				agp_drop_vstore(tgt->shadow[i]);
+				arcan_mem_free(tgt->shadow[i]);
+				tgt->shadow[i] = NULL;
+			}
+		}
+		tgt->n_stores = 0;
+		tgt->store->vinf.text.glid_proxy = NULL;
+	}
+
+	aux_free(&tgt->aux);
+	arcan_mem_free(tgt);
+}
+
+void agp_rendertarget_viewport(struct agp_rendertarget* tgt,
+	ssize_t x1, ssize_t y1, ssize_t x2, ssize_t y2)
+{
+	if (!tgt || !tgt->store){
+		arcan_warning("attempted resize on broken rendertarget\n");
+		return;
+	}
+
+	tgt->viewport[0] = x1;
+	tgt->viewport[1] = y1;
+	tgt->viewport[2] = x2;
+	tgt->viewport[3] = y2;
+	tgt->damage_reset = true;
+}
+
+void agp_resize_rendertarget(
+	struct agp_rendertarget* tgt, size_t neww, size_t newh)
+{
+	if (!tgt || !tgt->store){
+		arcan_warning("attempted resize on broken rendertarget\n");
+		return;
+	}
+
+	if (tgt->store->w == neww && tgt->store->h == newh)
+		return;
+
+	soft_flush();
+	tgt->store->w = neww;
+	tgt->store->h = newh;
+	tgt->viewport[0] = 0;
+	tgt->viewport[1] = 0;
+	tgt->viewport[2] = neww;
+	tgt->viewport[3] = newh;
+	tgt->rz_ack = true;
+	tgt->damage_reset = true;
+	tgt->n_damage[0] = tgt->n_damage[1] = 0;
+
+	if (tgt->n_stores){
+		for (size_t i = 0; i < tgt->n_stores; i++){
+			if (tgt->shadow[i]){
+				if (tgt->alloc){
+					tgt->alloc(tgt, tgt->shadow[i], RTGT_ALLOC_FREE, tgt->alloc_tag);
+				}
+				else
+					erase_store(tgt->shadow[i]);
+
+				arcan_mem_free(tgt->shadow[i]);
+				tgt->shadow[i] = NULL;
+			}
+
+			tgt->shadow[i] = tgt->stores[i];
+			tgt->stores[i] = NULL;
+		}
+
+		setup_stores(tgt);
+		tgt->store->vinf.text.glid_proxy = &tgt->stores[0]->vinf.text.glid;
+	}
+	else {
+		erase_store(tgt->store);
+		agp_empty_vstore(tgt->store, neww, newh);
+	}
+}
+
+void agp_rendertarget_clear()
+{
+	if (!dst_bind())
+		return;
+
+	float* cc = active_rendertarget && !st.proxied ?
+		active_rendertarget->clearcol : (float[]){0.05, 0.05, 0.05, 1.0};
+
+	if (active_rendertarget && st.proxied)
+		cc = active_rendertarget->clearcol;
+
+	struct soft_cmd* c = cmd_add(CMD_CLEAR, st.clip[0], st.clip[1], st.clip[2], st.clip[3]);
+	if (c)
+		c->col = RGBA(
+			clampi(cc[0] * 255.0f + 0.5f, 0, 255),
+			clampi(cc[1] * 255.0f + 0.5f, 0, 255),
+			clampi(cc[2] * 255.0f + 0.5f, 0, 255),
+			clampi(cc[3] * 255.0f + 0.5f, 0, 255)
+		);
+
+	if (queue.dst.aux->depth && aux_ensure(true, false))
+		cmd_add(CMD_CLEAR_DEPTH, st.clip[0], st.clip[1], st.clip[2], st.clip[3]);
+
+	agp_rendertarget_dirty(active_rendertarget, &(struct agp_region){});
+
+	if (active_rendertarget && !active_rendertarget->scissor_set)
+		active_rendertarget->damage_reset = false;
+}
+
+void agp_rendertarget_subview(size_t index, size_t count)
+{
+	struct agp_rendertarget* tgt = active_rendertarget;
+	if (!tgt)
+		return;
+
+	ssize_t* vp = tgt->viewport;
+	ssize_t x1 = vp[0], y1 = vp[1], x2 = vp[0] + vp[2], y2 = vp[1] + vp[3];
+
+	if (count && index < count){
+		ssize_t w = vp[2] / (ssize_t) count;
+		x1 = vp[0] + w * (ssize_t) index;
+		x2 = x1 + w;
+	}
+
+	st.vp[0] = x1;
+	st.vp[1] = y1;
+	st.vp[2] = x2 - x1;
+	st.vp[3] = y2 - y1;
+
+	if (tgt->scissor_set){
+		if (x1 < (ssize_t) tgt->scissor.x1) x1 = tgt->scissor.x1;
+		if (y1 < (ssize_t) tgt->scissor.y1) y1 = tgt->scissor.y1;
+		if (x2 > (ssize_t) tgt->scissor.x2) x2 = tgt->scissor.x2;
+		if (y2 > (ssize_t) tgt->scissor.y2) y2 = tgt->scissor.y2;
+		if (x2 < x1) x2 = x1;
+		if (y2 < y1) y2 = y1;
+	}
+
+	set_clip(x1, y1, x2 - x1, y2 - y1);
+}
+
+void agp_pipeline_hint(enum pipeline_mode mode)
+{
+	if (mode == st.mode)
+		return;
+
+	st.mode = mode;
+	if (mode == PIPELINE_3D && dst_bind() && aux_ensure(true, false))
+		cmd_add(CMD_CLEAR_DEPTH, 0, 0, queue.dst.w, queue.dst.h);
+}
+
+/*
+ * Drawing
+ */
+void agp_prepare_stencil()
+{
+	if (!dst_bind() || !aux_ensure(false, true))
+		return;
+
+	cmd_add(CMD_CLEAR_STENCIL, st.clip[0], st.clip[1], st.clip[2], st.clip[3]);
+	st.stencil = STENCIL_WRITE;
+}
+
+void agp_draw_stencil(float x1, float y1, float x2, float y2)
+{
+}
+
+void agp_activate_stencil()
+{
+	st.stencil = STENCIL_TEST;
+}
+
+void agp_disable_stencil()
+{
+	st.stencil = STENCIL_OFF;
+}
+
+void agp_blendstate(enum arcan_blendfunc mode)
+{
+	mode &= ~BLEND_FORCE;
+	st.blend = mode > BLEND_PREMUL ? BLEND_NORMAL : mode;
+}
+
+void agp_draw_vobj(
+	float x1, float y1, float x2, float y2,
+	const float* txcos, const float* model)
+{
+	static const float deftxcos[] = {0, 0, 1, 0, 1, 1, 0, 1};
+	float _Alignas(16) mvp[16];
+	float _Alignas(16) verts[16] = {
+		x1, y1, 0, 1,
+		x2, y1, 0, 1,
+		x2, y2, 0, 1,
+		x1, y2, 0, 1
+	};
+
+	agp_shader_envv(MODELVIEW_MATR,
+		model ? (void*) model : ident, sizeof(float) * 16);
+
+	multiply_matrix(mvp, st.projection, st.modelview);
+	mult_matrix_vecf_n(mvp, verts, verts, 4);
+	record_quads(verts, txcos ? txcos : deftxcos, 4);
+
+	agp_rendertarget_dirty(active_rendertarget, &(struct agp_region){});
+}
+
+void agp_draw_quads(const float* verts, const float* txcos, size_t n)
+{
+	if (!n)
+		return;
+
+	agp_shader_envv(MODELVIEW_MATR, ident, sizeof(float) * 16);
+
+	float* clip = arcan_alloc_mem(sizeof(float) * 4 * 6 * n,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_TEMPORARY | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_SIMD);
+	if (!clip)
+		return;
+
+	mult_matrix_vecf_n(st.projection, verts, clip, n * 6);
+
+	for (size_t i = 0; i < n; i++)
+		record_quads(&clip[i * 24], &txcos[i * 12], 6);
+
+	arcan_mem_free(clip);
+	agp_rendertarget_dirty(active_rendertarget, &(struct agp_region){});
+}
+
+static unsigned mesh_index(struct agp_mesh_store* base, size_t i)
+{
+	if (base->index_size == 2)
+		return ((uint16_t*) base->indices)[i];
+	return base->indices[i];
+}
+
+static float mesh_attr(struct agp_mesh_store* base, const uint8_t* p, uint8_t fmt)
+{
+	if (!base->stride)
+		fmt = AGP_VFMT_F32;
+
+	switch (fmt){
+	case AGP_VFMT_S16N:{
+		int16_t v; memcpy(&v, p, sizeof(v));
+		return v < -32767 ? -1.0 : v / 32767.0f;
+	}
+	case AGP_VFMT_U16N:{
+		uint16_t v; memcpy(&v, p, sizeof(v));
+		return v / 65535.0f;
+	}
+	case AGP_VFMT_S8N:{
+		int8_t v = *(int8_t*) p;
+		return v < -127 ? -1.0 : v / 127.0f;
+	}
+	case AGP_VFMT_U8N:
+		return *p / 255.0f;
+	default:{
+		float v; memcpy(&v, p, sizeof(v));
+		return v;
+	}
+	}
+}
+
+static size_t attr_size(struct agp_mesh_store* base, uint8_t fmt)
+{
+	if (!base->stride)
+		return sizeof(float);
+
+	switch (fmt){
+	case AGP_VFMT_S16N:
+	case AGP_VFMT_U16N: return 2;
+	case AGP_VFMT_S8N:
+	case AGP_VFMT_U8N: return 1;
+	default:
+		return sizeof(float);
+	}
+}
+
+void agp_submit_mesh(struct agp_mesh_store* base, enum agp_mesh_flags fl)
+{
+	if (base->dirty)
+		base->dirty = false;
+
+/* there are no line or point primitives in the rasterizer */
+	if (base->type != AGP_MESH_TRISOUP || (fl & MESH_FILL_LINE) ||
+		!base->verts || !base->n_vertices || !dst_bind())
+		return;
+
+	if (base->indices && !base->validated){
+		for (size_t i = 0; i < base->n_indices; i++){
+			if (mesh_index(base, i) >= base->n_vertices){
+				static bool warned;
+				if (!warned){
+					arcan_warning("agp_submit_mesh(), refusing mesh with OOB indices "
+						"(%zu=>%u/%zu\n", i, mesh_index(base, i), base->n_vertices);
+					warned = true;
+				}
+				return;
+			}
+		}
+		base->validated = true;
+	}
+
+	bool depth = st.mode == PIPELINE_3D && !(fl & MESH_FACING_NODEPTH) && !base->nodepth;
+	if ((depth || st.stencil != STENCIL_OFF) &&
+		!aux_ensure(depth, st.stencil != STENCIL_OFF))
+		return;
+
+	int cull = 0;
+	if ((fl & MESH_FACING_BOTH) == MESH_FACING_FRONT)
+		cull = 1;
+	else if ((fl & MESH_FACING_BOTH) == MESH_FACING_BACK)
+		cull = 2;
+
+	size_t nv = base->n_vertices;
+	float* clip = arcan_alloc_mem(sizeof(float) * 4 * nv, ARCAN_MEM_VBUFFER,
+		ARCAN_MEM_TEMPORARY | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_SIMD);
+	float* uv = base->txcos ? arcan_alloc_mem(sizeof(float) * 2 * nv,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_TEMPORARY | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL) : NULL;
+	unsigned* ind = base->indices ? arcan_alloc_mem(
+		sizeof(unsigned) * base->n_indices, ARCAN_MEM_VBUFFER,
+		ARCAN_MEM_TEMPORARY | ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL) : NULL;
+
+	if (!clip || (base->txcos && !uv) || (base->indices && !ind))
+		goto out;
+
+	size_t vstride = base->stride ? base->stride : base->vertex_size * sizeof(float);
+	size_t tstride = base->stride ? base->stride : 2 * sizeof(float);
+	size_t tsz = attr_size(base, base->fmt.txcos);
+
+	for (size_t i = 0; i < nv; i++){
+		const float* p = (const float*)((const uint8_t*) base->verts + i * vstride);
+		float* cv = &clip[i * 4];
+		cv[2] = 0.0;
+		cv[3] = 1.0;
+		memcpy(cv, p, sizeof(float) * (base->vertex_size > 4 ? 4 : base->vertex_size));
+
+		if (uv){
+			const uint8_t* tp = (const uint8_t*) base->txcos + i * tstride;
+			uv[i * 2 + 0] = mesh_attr(base, tp, base->fmt.txcos);
+			uv[i * 2 + 1] = mesh_attr(base, tp + tsz, base->fmt.txcos);
+		}
+	}
+
+	float _Alignas(16) mvp[16];
+	multiply_matrix(mvp, st.projection, st.modelview);
+	mult_matrix_vecf_n(mvp, clip, clip, nv);
+
+	if (ind)
+		for (size_t i = 0; i < base->n_indices; i++)
+			ind[i] = mesh_index(base, i);
+
+	record_tris(clip, uv, nv,
+		ind, ind ? base->n_indices : nv, depth, base->depth_func, cull);
+	agp_rendertarget_dirty(active_rendertarget, &(struct agp_region){});
+
+out:
+	arcan_mem_free(clip);
+	arcan_mem_free(uv);
+	arcan_mem_free(ind);
+}
+
+void agp_invalidate_mesh(struct agp_mesh_store* bs)
+{
+}
+
+void agp_invalidate_mesh_range(
+	struct agp_mesh_store* bs, size_t ofs, size_t len)
+{
+}
+
+void agp_drop_mesh(struct agp_mesh_store* s)
+{
+	if (!s)
+		return;
+
+	if (s->shared_buffer)
+		arcan_mem_free(s->shared_buffer);
+	else{
+		arcan_mem_free(s->verts);
+		arcan_mem_free(s->txcos);
+		arcan_mem_free(s->txcos2);
+		arcan_mem_free(s->normals);
+		arcan_mem_free(s->colors);
+		arcan_mem_free(s->tangents);
+		arcan_mem_free(s->bitangents);
+		arcan_mem_free(s->weights);
+		arcan_mem_free(s->joints);
+		arcan_mem_free(s->indices);
+	}
+
+	memset(s, '\0', sizeof(struct agp_mesh_store));
+}
+
+bool agp_compressed_support(enum agp_compressed_format fmt)
+{
+	return false;
+}
+
+size_t agp_compressed_size(enum agp_compressed_format fmt, size_t w, size_t h)
+{
+	return 0;
+}
+
+/*
+ * No queries, occlusion reports everything as visible like the stub does
+ */
+unsigned agp_occlusion_alloc()
+{
+	return 0;
+}
+
+void agp_occlusion_free(unsigned id)
+{
+}
+
+void agp_occlusion_begin(unsigned id, bool proxy)
+{
+}
+
+void agp_occlusion_end()
+{
+}
+
+int agp_occlusion_result(unsigned id)
+{
+	return 1;
+}
+
+unsigned agp_timer_alloc()
+{
+	return 0;
+}
+
+void agp_timer_free(unsigned id)
+{
+}
+
+void agp_timer_begin(unsigned id)
+{
+}
+
+void agp_timer_end()
+{
+}
+
+int64_t agp_timer_result(unsigned id)
+{
+	return -1;
+}
@@ -83,7 +83,16 @@ void agp_resize_vstore(struct agp_vstore* s, size_t w, size_t h)
 {
 }
 
-void agp_request_readback(struct agp_vstore* s)
+bool agp_request_readback(struct agp_vstore* s)
+{
+	return false;
+}
+
+void agp_upload_ring(size_t mb)
+{
+}
+
+void agp_readback_ring(size_t depth)
 {
 }
 
@@ -124,6 +133,16 @@ void agp_rendertarget_clear()
 {
 }
 
+void agp_rendertarget_subview(size_t index, size_t count)
+{
+}
+
+bool agp_rendertarget_scissor(
+	struct agp_rendertarget* tgt, struct agp_region* region)
+{
+	return false;
+}
+
 void agp_pipeline_hint(enum pipeline_mode mode)
 {
 }
@@ -167,14 +186,77 @@ void agp_draw_vobj(
 {
 }
 
+void agp_draw_quads(const float* verts, const float* txcos, size_t n)
+{
+}
+
 void agp_submit_mesh(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 {
 }
 
+bool agp_compressed_support(enum agp_compressed_format fmt)
+{
+	return false;
+}
+
+size_t agp_compressed_size(enum agp_compressed_format fmt, size_t w, size_t h)
+{
+	return 0;
+}
+
+unsigned agp_occlusion_alloc()
+{
+	return 0;
+}
+
+void agp_occlusion_free(unsigned id)
+{
+}
+
+void agp_occlusion_begin(unsigned id, bool proxy)
+{
+}
+
+void agp_occlusion_end()
+{
+}
+
+int agp_occlusion_result(unsigned id)
+{
+	return 1;
+}
+
+unsigned agp_timer_alloc()
+{
+	return 0;
+}
+
+void agp_timer_free(unsigned id)
+{
+}
+
+void agp_timer_begin(unsigned id)
+{
+}
+
+void agp_timer_end()
+{
+}
+
+int64_t agp_timer_result(unsigned id)
+{
+	return -1;
+}
+
 void agp_invalidate_mesh(struct agp_mesh_store* base)
 {
 }
 
+void agp_invalidate_mesh_range(
+	struct agp_mesh_store* base, size_t ofs, size_t len)
+{
+}
+
 void agp_activate_vstore(struct agp_vstore* s)
 {
 }
@@ -227,6 +309,10 @@ void agp_shader_forceunif(const char* label, enum shdrutype type, void* val)
 {
 }
 
+void agp_shader_cache(const char* dir)
+{
+}
+
 agp_shader_id agp_shader_lookup(const char* tag)
 {
 	return BROKEN_SHADER;
@@ -253,6 +339,12 @@ void agp_empty_vstoreext(struct agp_vstore* vs,
 {
 }
 
+enum vstore_hint agp_vstore_setformat(
+	struct agp_vstore* vs, enum vstore_hint hint)
+{
+	return VSTORE_HINT_NORMAL;
+}
+
 void agp_rendertarget_proxy(struct agp_rendertarget* tgt,
 	bool (*proxy_state)(struct agp_rendertarget*, uintptr_t tag), uintptr_t tag)
 {
@@ -284,7 +376,7 @@ void agp_setenv(struct agp_fenv* dst)
 {
 }
 
-#define TBLSIZE (1 + TIMESTAMP_D - MODELVIEW_MATR)
+#define TBLSIZE (1 + VR_REPROJECT - MODELVIEW_MATR)
 static char* symtbl[TBLSIZE] = {
 	"modelview",
 	"projection",
@@ -297,7 +389,8 @@ static char* symtbl[TBLSIZE] = {
 	"obj_output_sz",
 	"obj_storage_sz",
 	"fract_timestamp",
-	"timestamp"
+	"timestamp",
+	"vr_reproject"
 };
 
 const char* agp_shader_symtype(enum agp_shader_envts env)
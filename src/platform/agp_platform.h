@@ -1,6 +1,39 @@
 /*
  * The following functions abstract the graphics operations that arcan_video.c
  * relies on, implementations can be found in platform/agp_.
+ *
+ * Not everything here is API neutral yet, which is what blocks a non-GL
+ * (e.g. Vulkan) implementation:
+ *  - shaders are passed as GLSL source (agp_shader_language) and the builtin
+ *    uniforms are resolved by name, a backend would need SPIR-V translation
+ *    and a mapping of the builtins to push constants / a uniform block.
+ *  - agp_fenv is a GL function table that the video platforms (egl-dri in
+ *    particular) fill and switch per GPU, and they own context creation.
+ *  - vstores and rendertargets expose GL names (glid, fbo) that are read
+ *    directly by the video platforms and the frameserver import paths.
+ *  - drawing is immediate (agp_draw_vobj, agp_submit_mesh) and relies on
+ *    implicit synchronization, explicit command recording per rendertarget
+ *    would need the submission split from the calls below.
+ *
+ * The intended shape of a Vulkan backend (agp/vulkan.c, not in tree):
+ *  - pixel packing gets its own define next to OPENGL in platform_types.h
+ *    (B8G8R8A8 matches the OPENGL packing) instead of borrowing -DOPENGL,
+ *    which also turns on GL-only paths.
+ *  - the builtin shaders are GLSL compiled to SPIR-V with glslang at build
+ *    time, user programs go through the same compiler at agp_shader_build,
+ *    builtin uniforms become a push constant range. Pipelines per shader and
+ *    blend mode are kept in a VkPipelineCache stored next to the shader
+ *    cache (agp_shader_cache).
+ *  - every rendertarget records into its own secondary command buffer, so
+ *    the preparation pool (video_prepare_threads) can record them in
+ *    parallel, the primary only executes them in order and is submitted at
+ *    agp_activate_rendertarget(NULL).
+ *  - STREAM_HANDLE buffers are imported as dma-buf backed VkImages with a
+ *    timeline semaphore per frameserver, waited on at submit and signalled
+ *    on release, instead of implicit fencing.
+ *  - headless first, as there the backend owns the device and has no
+ *    scanout to negotiate. Landing requires a build against the SDK and a
+ *    clean run under the validation layers.
  */
 
 #ifndef HAVE_AGP_PLATFORM
@@ -146,6 +179,15 @@ enum vstore_hint
 void agp_empty_vstoreext(struct agp_vstore* backing,
 	size_t w, size_t h, enum vstore_hint);
 
+/*
+ * Set the source and storage formats of [backing] to match [hint] without
+ * allocating, used to upload client buffers that are already in that format.
+ * Formats the platform can't provide fall back to VSTORE_HINT_NORMAL, the
+ * format that was applied is returned and kept in backing->hdr.depth.
+ */
+enum vstore_hint agp_vstore_setformat(
+	struct agp_vstore* backing, enum vstore_hint);
+
 /*
  * Rebuild an existing vstore to handle a change in data source dimensions
  * without sharestorage- like operations breaking
@@ -195,6 +237,9 @@ struct agp_buffer_plane {
 			uint64_t offset;
 			uint32_t mod_hi;
 			uint32_t mod_lo;
+			uint8_t color_space;   /* enum shmifext_color_space */
+			uint8_t color_range;   /* enum shmifext_color_range */
+			uint8_t chroma_siting; /* SHMIFEXT_SITING_* bits */
 		} gbm;
 	};
 };
@@ -226,7 +271,8 @@ struct stream_meta {
  *  - RAW_DIRECT: prop: asynchronous copy of contents, fastest when handle
  *                is unavailable, con:
  *
- *  - RAW_DIRECT_SYNCHRONOUS: block and copy meta.buf.
+ *  - RAW_DIRECT_SYNCHRONOUS: block and copy meta.buf, meta.stride (in
+ *                pixels, 0 = store width) covers a padded source.
  *                pro: guarantee of content state, con: stalls pipeline
  *
  *  - EXT_RESYNCH: vstore- is externally managed in terms of buffers,
@@ -287,20 +333,39 @@ struct asynch_readback_meta {
 
 	void (*release)(void* tag);
 	void* tag;
+
+/* number of requests still in flight, not counting the one returned */
+	size_t pending;
 };
 
 /*
- * Check if a pending readback request has been completed.
+ * Check if the oldest pending readback request has been completed.
  * In that case, [meta.ptr] will be !NULL and the caller is expected to:
  * meta.release(meta.tag); when finished using the contents of [meta.ptr]
+ * This will not block waiting for the transfer to finish. Only one result
+ * may be held at a time, release before polling again.
  */
 struct asynch_readback_meta agp_poll_readback(struct agp_vstore*);
 
 /*
- * Initiate a new asynchronous readback.
- * if one is already pending, this is a no-operation.
+ * Initiate a new asynchronous readback. Requests are queued in a ring of
+ * transfer buffers per store, returns false if all of them are in flight
+ * (the request is then dropped) or readbacks are not supported.
+ */
+bool agp_request_readback(struct agp_vstore*);
+
+/*
+ * Set the number of in-flight readbacks permitted per store (default 3),
+ * applies to stores that have not yet performed a readback.
  */
-void agp_request_readback(struct agp_vstore*);
+void agp_readback_ring(size_t depth);
+
+/*
+ * Set the size (in MiB, 0 disables, default 32) of the persistently mapped
+ * staging ring that streaming uploads go through when the GL supports it.
+ * Applies to environments that have not yet performed a ring upload.
+ */
+void agp_upload_ring(size_t mb);
 
 /*
  * For clipping and similar operations where we want to
@@ -330,6 +395,14 @@ void agp_blendstate(enum arcan_blendfunc);
 void agp_draw_vobj(float x1, float y1, float x2, float y2,
 	const float* txcos, const float* modelview);
 
+/*
+ * Draw [n] quads with the currently active shader and vstore in one call,
+ * using an identity modelview. [verts] is 6 vertices (two triangles) of 4
+ * floats per quad, already transformed to world space, and [txcos] is the
+ * matching 6 pairs of texture coordinates per quad.
+ */
+void agp_draw_quads(const float* verts, const float* txcos, size_t n);
+
 /*
  * Destination format for rendertargets. Note that we do not currently suport
  * floating point targets and that for some platforms, COLOR_DEPTH will map to
@@ -446,26 +519,56 @@ void agp_rendertarget_dropswap(struct agp_rendertarget*);
 void agp_drop_rendertarget(struct agp_rendertarget*);
 
 /*
- * manually mark part of rendertarget as dirty, returns number of invalidations
- * so far. if [dirty] is set to NULL, no changes will be marked, but counter
- * will still be returned.
+ * upper bound of damage regions tracked per rendertarget and frame, when
+ * exceeded the regions are collapsed into their bounding region.
+ */
+#ifndef AGP_DAMAGE_LIMIT
+#define AGP_DAMAGE_LIMIT 8
+#endif
+
+/*
+ * manually mark part of rendertarget as dirty, returns number of damage
+ * regions so far (current and previous frame, at most 2*AGP_DAMAGE_LIMIT).
+ * An empty region marks whatever drawing is currently limited to (see
+ * agp_rendertarget_scissor). if [dirty] is set to NULL, no changes will be
+ * marked, but counter will still be returned.
  */
 size_t agp_rendertarget_dirty(
 	struct agp_rendertarget* dst, struct agp_region* dirty);
 
 /*
  * Flush the list of dirty regions, and store a copy inside [dst], if provided.
- * The [dst] size can be probed using agp_rendertarget_dirty(src, NULL).
- * This will also set the dirty- counter for the rendertarget to 0.
+ * The [dst] size can be probed using agp_rendertarget_dirty(src, NULL). The
+ * regions are in framebuffer coordinates (origin in the lower left corner).
+ * The regions from the flushed frame are retained and included in the next
+ * flush, as the consumer is assumed to be double buffered.
  */
 void agp_rendertarget_dirty_reset(
 	struct agp_rendertarget* src, struct agp_region* dst);
 
+/*
+ * Restrict clearing and drawing to [region] (framebuffer coordinates) until
+ * the rendertarget is activated again, or [region] is NULL. This fails (and
+ * leaves the scissor state untouched) for rendertargets where the previous
+ * contents can't be relied upon, e.g. multi-buffered, proxied, resized,
+ * custom viewport or not yet fully cleared since setup.
+ */
+bool agp_rendertarget_scissor(
+	struct agp_rendertarget* tgt, struct agp_region* region);
+
 /*
  * reset the currently bound rendertarget output buffer
  */
 void agp_rendertarget_clear();
 
+/*
+ * Restrict drawing to column [index] out of [count] equal splits of the
+ * viewport of the currently bound rendertarget, e.g. one per eye for side by
+ * side stereo. The stored viewport is left intact and [count] of 0 restores
+ * it. Any scissor region set still applies.
+ */
+void agp_rendertarget_subview(size_t index, size_t count);
+
 /*
  * change the clear color of the rendertarget from the default RGBA(0,0,0,1)
  */
@@ -477,6 +580,15 @@ enum agp_mesh_type {
 	AGP_MESH_POINTCLOUD
 };
 
+/* vertex attribute formats for packed meshes, the integer ones normalized */
+enum agp_vertex_fmt {
+	AGP_VFMT_F32 = 0,
+	AGP_VFMT_S16N = 1,
+	AGP_VFMT_U16N = 2,
+	AGP_VFMT_S8N = 3,
+	AGP_VFMT_U8N = 4
+};
+
 enum agp_depth_func {
 	AGP_DEPTH_LESS = 0,
 	AGP_DEPTH_LESSEQUAL = 1,
@@ -518,6 +630,21 @@ struct agp_mesh_store
 	size_t n_vertices;
 	size_t n_indices;
 
+/*
+ * [ PACKED ]
+ * with a non-zero stride the attributes are interleaved [stride] bytes apart
+ * and normals, txcos and colors are in the formats below rather than float,
+ * vertices are always float. The indices are uint16_t if index_size is 2.
+ */
+	size_t stride;
+	uint8_t index_size;
+	struct {
+		uint8_t normals;
+		uint8_t txcos;
+		uint8_t colors;
+		uint8_t n_colors;
+	} fmt;
+
 	enum agp_mesh_type type;
 	enum agp_depth_func depth_func;
 
@@ -528,6 +655,11 @@ struct agp_mesh_store
 /* set if the underlying buffers have changed and force a resynch (VBOs) */
 	bool dirty;
 
+/* keep the attributes in a GPU side buffer that is updated from
+ * shared_buffer through agp_invalidate_mesh(_range), rather than sending
+ * them with every draw. All attributes must be inside shared_buffer. */
+	bool stream;
+
 /* set if the mesh should be processed without a depth buffer active */
 	bool nodepth;
 
@@ -558,12 +690,71 @@ const char* agp_ident();
 
 void agp_submit_mesh(struct agp_mesh_store*, enum agp_mesh_flags);
 
+/*
+ * Block compressed texture formats that vstores can carry (see
+ * vinf.text.compressed) and that get uploaded without being expanded.
+ */
+enum agp_compressed_format {
+	AGP_COMPRESSED_NONE = 0,
+	AGP_COMPRESSED_ETC1 = 1,
+	AGP_COMPRESSED_DXT1 = 2,
+	AGP_COMPRESSED_DXT3 = 3,
+	AGP_COMPRESSED_DXT5 = 4
+};
+
+/*
+ * Check if the GPU accepts [fmt] for uploads. The set is probed in agp_init,
+ * so unlike most agp_ functions this is safe to call from other threads.
+ */
+bool agp_compressed_support(enum agp_compressed_format fmt);
+
+/*
+ * Size in bytes of one level of [fmt] at [w]*[h], 4x4 blocks rounded up.
+ */
+size_t agp_compressed_size(enum agp_compressed_format fmt, size_t w, size_t h);
+
+/*
+ * Occlusion queries, counting samples that pass the depth test for draws
+ * between _begin and _end. Allocation returns 0 if queries are not supported
+ * by the GL implementation. If [proxy] is set, color and depth writes are
+ * masked off until _end so that a stand-in (e.g. bounding box) can be tested
+ * without affecting the output.
+ *
+ * Results are collected without blocking: -1 while the query is still in
+ * flight, 0 if no samples passed and 1 otherwise.
+ */
+unsigned agp_occlusion_alloc();
+void agp_occlusion_free(unsigned);
+void agp_occlusion_begin(unsigned, bool proxy);
+void agp_occlusion_end();
+int agp_occlusion_result(unsigned);
+
+/*
+ * GPU timers measure the time the GPU spends on the work issued between
+ * begin and end. Only one timer can be active at a time and they can't be
+ * nested with each other. Alloc returns 0 if the GL lacks timer queries,
+ * the other calls then do nothing. Results are collected without blocking
+ * and are -1 while still in flight, otherwise the elapsed nanoseconds.
+ */
+unsigned agp_timer_alloc();
+void agp_timer_free(unsigned);
+void agp_timer_begin(unsigned);
+void agp_timer_end();
+int64_t agp_timer_result(unsigned);
+
 /*
  * Mark that the contents of the mesh has changed dynamically and that possible
  * GPU- side cache might need to be updated.
  */
 void agp_invalidate_mesh(struct agp_mesh_store*);
 
+/*
+ * Same as agp_invalidate_mesh, but only [len] bytes from [ofs] into the
+ * shared_buffer of a stream mesh have changed. Other meshes are treated as
+ * if all of the contents changed.
+ */
+void agp_invalidate_mesh_range(struct agp_mesh_store*, size_t ofs, size_t len);
+
 /*
  * Free the resources tied to a mesh (buffers + GPU handles)
  */
@@ -578,6 +769,13 @@ void agp_save_output(size_t w, size_t h, av_pixel* dst, size_t dsz);
 /* delete, forget and flush all allocated shaders */
 void agp_shader_flush();
 
+/*
+ * Persist linked programs in [dir] (if the driver can provide binaries) so
+ * that later builds of the same sources on the same GPU and driver skip
+ * compilation and linking. NULL disables the cache.
+ */
+void agp_shader_cache(const char* dir);
+
 /*
  * Drop possible underlying handles, a call chain of unload_all and rebuild_all
  * should yield no visible changes to the rest of the engine.
@@ -770,6 +770,23 @@ bool platform_video_map_buffer(
 	return false;
 }
 
+size_t platform_video_export_vstore(
+	struct agp_vstore* vs, struct agp_buffer_plane* planes, size_t n)
+{
+	return 0;
+}
+
+size_t platform_video_scanout_formats(
+	uint32_t* formats, uint64_t* modifiers, size_t n)
+{
+	return 0;
+}
+
+int platform_video_release_fence(struct agp_vstore* vs, size_t* held)
+{
+	return -1;
+}
+
 /*
  * Need to do this manually here so that when we run nested, we are still able
  * to import data from clients that give us buffers. When/ if we implement the
@@ -0,0 +1,1474 @@
+/*
+ * ALSA audio platform
+ *
+ * Instead of queueing buffers per source like the openAL platform does, one
+ * PCM is opened in mmap- mode and a mixer thread writes directly into the
+ * device ring one period at a time. This keeps the output latency at roughly
+ * periods * period frames, with a period that can be configured down to 128
+ * frames (audio_device_period, audio_device_periods, audio_device_node).
+ *
+ * The mixer thread also services the stream feeds itself at the start of
+ * each period, with the frameserver shm read lock held, so playback doesn't
+ * depend on how long the main thread takes for a frame. The buffers go into a
+ * lock-free ring per stream that is then drained with resampling to the
+ * device rate. Streams with a monitor hook attached (recording) and capture
+ * devices are fed from the main thread on refresh as the hooks reach into
+ * engine state, as is everything when there is no device.
+ *
+ * Gain and play/pause changes are sent to the mixer over a command queue.
+ * The lock only protects the object list and sample voices, which is held by
+ * the mixer for the duration of a period.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include <alsa/asoundlib.h>
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_shmif.h"
+#include "arcan_video.h"
+#include "arcan_audio.h"
+#include "arcan_audioint.h"
+#include "arcan_event.h"
+#include "platform_types.h"
+
+#ifndef CONST_MAX_ASAMPLESZ
+#define CONST_MAX_ASAMPLESZ 1048756
+#endif
+
+#ifndef ARCAN_AUDIO_SLIMIT
+#define ARCAN_AUDIO_SLIMIT 32
+#endif
+
+/* frames per stream ring, power of two. abufused is 16-bit so one shmif
+ * buffer is at most RESERVE frames and we only feed if one would fit */
+#ifndef ARCAN_ASTREAM_RING
+#define ARCAN_ASTREAM_RING 32768
+#endif
+#define ARCAN_ASTREAM_RESERVE (65536 / (sizeof(shmif_asample) * 2))
+
+#ifndef ARCAN_AUDIO_PERIOD
+#define ARCAN_AUDIO_PERIOD 256
+#endif
+
+/* power of two, the queue is applied at the start of every period */
+#ifndef ARCAN_AUDIO_CMDQ
+#define ARCAN_AUDIO_CMDQ 256
+#endif
+
+#ifndef ARCAN_AUDIO_PERIODS
+#define ARCAN_AUDIO_PERIODS 3
+#endif
+
+#define ARCAN_AUDIO_PERIOD_MIN 128
+#define ARCAN_AUDIO_PERIOD_MAX 8192
+
+struct stream_ring {
+	shmif_asample* buf;
+	_Atomic size_t head, tail;
+
+/* 16.16 fixed point source frames per device frame and the fraction of the
+ * current tail frame, only touched by the mixer */
+	_Atomic uint32_t step;
+	uint32_t frac;
+	unsigned rate;
+};
+
+typedef struct arcan_aobj {
+/* shared */
+	arcan_aobj_id id;
+	enum aobj_kind kind;
+	bool active;
+
+	float gain;
+
+/* mixer side copy of gain and active, only changed through the command
+ * queue, and set if the mixer failed to feed the stream */
+	float mix_gain;
+	bool mix_active;
+	_Atomic bool mix_failed;
+	bool fail_reported;
+
+	struct arcan_achain* transform;
+
+/* AOBJ proxy only */
+	arcan_again_cb gproxy;
+
+/* AOBJ_STREAM only */
+	bool streaming;
+	struct stream_ring ring;
+
+/* AOBJ sample only, always interleaved stereo */
+	shmif_asample* samplebuf;
+	size_t sample_frames;
+	unsigned samplerate;
+
+/* AOBJ_CAPTUREFEED only */
+	snd_pcm_t* capture;
+
+	arcan_tickv last_used;
+
+/* global hooks */
+	arcan_afunc_cb feed;
+	arcan_monafunc_cb monitor;
+	void* monitortag, (* tag);
+
+/* stored as linked list */
+	struct arcan_aobj* next;
+} arcan_aobj;
+
+enum mixer_cmd_kind {
+	MIXCMD_GAIN = 0,
+	MIXCMD_ACTIVE,
+	MIXCMD_FLUSH
+};
+
+struct mixer_cmd {
+	enum mixer_cmd_kind kind;
+	arcan_aobj_id id;
+	float gain;
+	bool active;
+};
+
+struct arcan_achain {
+	unsigned t_gain;
+	float d_gain;
+
+	struct arcan_achain* next;
+};
+
+/* one playback instance of an AOBJ_SAMPLE, [done] is set by the mixer and
+ * the slot is released on the next tick */
+struct sample_voice {
+	arcan_aobj* src;
+	uint64_t pos;
+	uint32_t step;
+	float gain;
+	intptr_t tag;
+	_Atomic bool done;
+};
+
+struct arcan_acontext {
+	arcan_aobj* first;
+	bool init, suspended;
+	bool nosound;
+
+	snd_pcm_t* pcm;
+	pthread_t mixer;
+	pthread_mutex_t lock;
+	_Atomic bool alive, running;
+
+	struct mixer_cmd cmdq[ARCAN_AUDIO_CMDQ];
+	_Atomic size_t cmdq_head, cmdq_tail;
+
+	unsigned rate;
+	snd_pcm_uframes_t period, buffer;
+	float* mixbuf;
+	_Atomic size_t xruns;
+
+	arcan_aobj_id lastid;
+	float def_gain;
+
+	struct sample_voice voices[ARCAN_AUDIO_SLIMIT];
+
+	arcan_tickv atick_counter;
+
+	arcan_monafunc_cb globalhook;
+	void* global_hooktag;
+};
+
+static struct arcan_acontext _current_acontext = {
+	.def_gain = 1.0,
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+static struct arcan_acontext* current_acontext = &_current_acontext;
+
+/* the mixer thread already holds the lock when it is the ring producer */
+static _Thread_local bool in_mixer;
+
+static arcan_aobj_id arcan_audio_alloc(arcan_aobj** dst)
+{
+	if (dst)
+		*dst = NULL;
+
+	arcan_aobj* newcell = arcan_alloc_mem(sizeof(arcan_aobj), ARCAN_MEM_ATAG,
+		ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	if (!newcell)
+		return ARCAN_EID;
+
+	newcell->gain = newcell->mix_gain = current_acontext->def_gain;
+
+/* unlikely event of wrap-around */
+	newcell->id = current_acontext->lastid++;
+	if (newcell->id == ARCAN_EID)
+		newcell->id = 1;
+
+	if (dst)
+		*dst = newcell;
+
+	return newcell->id;
+}
+
+/* after setting up, the mixer reads kind / feed / tag */
+static void link_obj(arcan_aobj* newcell)
+{
+	pthread_mutex_lock(&current_acontext->lock);
+	if (current_acontext->first){
+		arcan_aobj* current = current_acontext->first;
+		while(current && current->next)
+			current = current->next;
+
+		current->next = newcell;
+	}
+	else
+		current_acontext->first = newcell;
+	pthread_mutex_unlock(&current_acontext->lock);
+}
+
+/* must be delinked first, the mixer can't see it anymore */
+static void release_obj(arcan_aobj* obj)
+{
+	if (obj->capture){
+		snd_pcm_drop(obj->capture);
+		snd_pcm_close(obj->capture);
+	}
+
+	struct arcan_achain* current = obj->transform;
+	while (current){
+		struct arcan_achain* next = current->next;
+		arcan_mem_free(current);
+		current = next;
+	}
+
+	arcan_mem_free(obj->ring.buf);
+	arcan_mem_free(obj->samplebuf);
+	obj->next = (void*) 0xdeadbeef;
+	obj->tag = (void*) 0xdeadbeef;
+	obj->feed = NULL;
+	arcan_mem_free(obj);
+}
+
+/* with the lock held, voices referencing [obj] are dropped rather then
+ * finished as the object is gone by the time the event would arrive */
+static void delink_obj(arcan_aobj** owner, arcan_aobj* obj)
+{
+	*owner = obj->next;
+	for (size_t i = 0; i < ARCAN_AUDIO_SLIMIT; i++)
+		if (current_acontext->voices[i].src == obj)
+			current_acontext->voices[i] = (struct sample_voice){0};
+}
+
+static arcan_errc arcan_audio_free(arcan_aobj_id id)
+{
+	pthread_mutex_lock(&current_acontext->lock);
+	arcan_aobj* current = current_acontext->first;
+	arcan_aobj** owner = &(current_acontext->first);
+
+ /* find */
+	while(current && current->id != id){
+		owner = &(current->next);
+		current = current->next;
+	}
+
+	if (current)
+		delink_obj(owner, current);
+	pthread_mutex_unlock(&current_acontext->lock);
+
+	if (!current)
+		return ARCAN_ERRC_NO_SUCH_OBJECT;
+
+	release_obj(current);
+	return ARCAN_OK;
+}
+
+static arcan_aobj* arcan_audio_getobj(arcan_aobj_id id)
+{
+	arcan_aobj* current = current_acontext->first;
+
+	while (current){
+		if (current->id == id)
+			return current;
+
+		current = current->next;
+	}
+
+	return NULL;
+}
+
+static void apply_cmd(struct mixer_cmd* cmd)
+{
+	arcan_aobj* obj = arcan_audio_getobj(cmd->id);
+	if (!obj)
+		return;
+
+	switch (cmd->kind){
+	case MIXCMD_GAIN:
+		obj->mix_gain = cmd->gain;
+	break;
+	case MIXCMD_ACTIVE:
+		obj->mix_active = cmd->active;
+	break;
+	case MIXCMD_FLUSH:
+		atomic_store(&obj->ring.tail, atomic_load(&obj->ring.head));
+		obj->ring.frac = 0;
+	break;
+	}
+}
+
+/* with the lock held or no mixer running */
+static void drain_cmds()
+{
+	size_t tail = atomic_load_explicit(
+		&current_acontext->cmdq_tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(
+		&current_acontext->cmdq_head, memory_order_acquire);
+
+	for (; tail != head; tail++)
+		apply_cmd(&current_acontext->cmdq[tail & (ARCAN_AUDIO_CMDQ - 1)]);
+
+	atomic_store_explicit(
+		&current_acontext->cmdq_tail, tail, memory_order_release);
+}
+
+/* without a mixer, or with the queue full, the queue is flushed and the
+ * command applied right away so that the order is kept */
+static void send_cmd(struct mixer_cmd cmd)
+{
+	if (!atomic_load(&current_acontext->running)){
+		drain_cmds();
+		apply_cmd(&cmd);
+		return;
+	}
+
+	size_t head = atomic_load_explicit(
+		&current_acontext->cmdq_head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(
+		&current_acontext->cmdq_tail, memory_order_acquire);
+
+	if (head - tail >= ARCAN_AUDIO_CMDQ){
+		pthread_mutex_lock(&current_acontext->lock);
+		drain_cmds();
+		apply_cmd(&cmd);
+		pthread_mutex_unlock(&current_acontext->lock);
+		return;
+	}
+
+	current_acontext->cmdq[head & (ARCAN_AUDIO_CMDQ - 1)] = cmd;
+	atomic_store_explicit(
+		&current_acontext->cmdq_head, head + 1, memory_order_release);
+}
+
+/* streams that the mixer feeds itself, the monitor hooks need the main thread */
+static bool mixer_fed(arcan_aobj* obj)
+{
+	return obj->kind == AOBJ_STREAM && !obj->monitor &&
+		atomic_load(&current_acontext->running);
+}
+
+static uint32_t rate_step(unsigned rate)
+{
+	if (!rate)
+		rate = ARCAN_SHMIF_SAMPLERATE;
+
+	unsigned dst = current_acontext->rate ?
+		current_acontext->rate : ARCAN_SHMIF_SAMPLERATE;
+
+	return ((uint64_t) rate << 16) / dst;
+}
+
+/* convert [nch] channels of [bits] PCM to interleaved stereo shmif samples */
+static shmif_asample* wave_convert(
+	const uint8_t* src, size_t nb, int nch, int bits, size_t* frames)
+{
+	size_t nf = nb / (nch * (bits / 8));
+	shmif_asample* dst = arcan_alloc_mem(nf * 2 * sizeof(shmif_asample),
+		ARCAN_MEM_ABUFFER, 0, ARCAN_MEMALIGN_PAGE);
+	if (!dst)
+		return NULL;
+
+	for (size_t i = 0; i < nf; i++){
+		for (size_t c = 0; c < 2; c++){
+			size_t sc = c < nch ? c : 0;
+			if (bits == 8)
+				dst[i * 2 + c] = ((int) src[i * nch + sc] - 128) << 8;
+			else {
+				int16_t v;
+				memcpy(&v, &src[(i * nch + sc) * 2], 2);
+				dst[i * 2 + c] = v;
+			}
+		}
+	}
+
+	*frames = nf;
+	return dst;
+}
+
+static bool arcan_load_wave(const char* fname, arcan_aobj* dst)
+{
+	bool rv = false;
+
+	data_source inres = arcan_open_resource(fname);
+	if (inres.fd == BADFD)
+		return rv;
+
+	map_region inmem = arcan_map_resource(&inres, false);
+	if (inmem.ptr == NULL){
+		arcan_release_resource(&inres);
+		return rv;
+	}
+
+/* same restrictions as the openAL platform, see the layout notes there */
+	if (memcmp(inmem.ptr + 0, "RIFF", 4) != 0 &&
+		(arcan_warning("load_wave() -- missing RIFF header identifier\n"), true))
+		goto cleanup;
+
+	if (memcmp(inmem.ptr + 8, "WAVE", 4) != 0 &&
+		(arcan_warning("load_wave() -- missing WAVE format identifier\n"), true))
+		goto cleanup;
+
+	uint16_t kv = 0x1234;
+	bool le = (*(char*)&kv) == 0x34;
+	if (!le && (arcan_warning(
+		"load_wave(BE) -- big endian swap unimplemented\n"), true))
+	goto cleanup;
+
+	int16_t  fmt;
+	int16_t  nch;
+	uint16_t bits_ps;
+	uint16_t smplrte;
+	int32_t  nofs;
+
+	if (memcmp(inmem.ptr + 12, "fmt ", 4) != 0 &&
+		(arcan_warning("load_wave() -- missing format chuck ID\n"), true))
+		goto cleanup;
+
+	memcpy(&fmt,     inmem.ptr + 20, 2);
+	memcpy(&nch,     inmem.ptr + 22, 2);
+	memcpy(&smplrte, inmem.ptr + 24, 2);
+	memcpy(&bits_ps, inmem.ptr + 34, 2);
+	memcpy(&nofs,    inmem.ptr + 16, 4);
+	nofs += 20;
+
+	if (fmt != 0x001 && (arcan_warning(
+		"load_wave() -- unsupported encoding (%d),only PCM accepted.\n", fmt), true))
+		goto cleanup;
+
+	if (nch != 1 && nch != 2 && (arcan_warning(
+		"load_wave() -- unexpected number of channels (%d).\n", nch), true))
+		goto cleanup;
+
+	if (bits_ps != 8 && bits_ps != 16 && (arcan_warning(
+		"load_wave() -- unsupported bitdepth (%d)\n", bits_ps), true))
+		goto cleanup;
+
+	if (smplrte != 48000 && smplrte != 44100 && smplrte != 22050 && smplrte != 11025)
+		arcan_warning("load_wave() -- unconventional samplerate (%d).\n", smplrte);
+
+	if (memcmp(inmem.ptr + nofs, "data", 4) != 0 &&
+		(arcan_warning("load_wave() -- data chunk not found\n"), true))
+		goto cleanup;
+
+	int32_t nb;
+	memcpy(&nb, inmem.ptr + nofs + 4, 4);
+	if (nb > CONST_MAX_ASAMPLESZ){
+		arcan_warning("load_wave() -- sample exceeds compile time limit "
+			" (CONST_MAX_ASAMPLESZ %d), truncating.\n", CONST_MAX_ASAMPLESZ);
+		nb = CONST_MAX_ASAMPLESZ;
+	}
+
+	if (nb > (inmem.sz - nofs - 4) && (arcan_warning(
+	 "load wave() -- total sample size is larger than the mapped input.\n"), true))
+		goto cleanup;
+
+	dst->samplebuf = wave_convert((uint8_t*) inmem.ptr + nofs + 8,
+		nb, nch, bits_ps, &dst->sample_frames);
+	dst->samplerate = smplrte;
+	rv = dst->samplebuf != NULL;
+
+cleanup:
+	arcan_release_map(inmem);
+	arcan_release_resource(&inres);
+
+	return rv;
+}
+
+/* default feed function for capture devices, same as with openAL it is only
+ * forwarded to the monitors and not mixed into the output */
+static arcan_errc capturefeed(void* aobjopaq, arcan_aobj_id id,
+	ssize_t buffer, bool cont, void* tag)
+{
+	arcan_aobj* aobj = aobjopaq;
+
+	if (buffer < 0)
+		return ARCAN_ERRC_NOTREADY;
+
+	static int16_t* capturebuf;
+
+	if (!capturebuf)
+		capturebuf = arcan_alloc_mem(1024 * 4, ARCAN_MEM_ABUFFER,
+			ARCAN_MEM_SENSITIVE, ARCAN_MEMALIGN_PAGE);
+
+	snd_pcm_sframes_t sample = snd_pcm_readi(aobj->capture, capturebuf, 1024);
+	if (sample < 0){
+		if (sample != -EAGAIN)
+			snd_pcm_recover(aobj->capture, sample, 1);
+		return ARCAN_ERRC_NOTREADY;
+	}
+
+	if (sample == 0)
+		return ARCAN_ERRC_NOTREADY;
+
+	if (aobj->monitor)
+		aobj->monitor(aobj->id, (uint8_t*) capturebuf, sample << 2,
+			ARCAN_SHMIF_ACHANNELS, ARCAN_SHMIF_SAMPLERATE, aobj->monitortag);
+
+	if (current_acontext->globalhook)
+		current_acontext->globalhook(aobj->id, (uint8_t*) capturebuf,
+			sample << 2, ARCAN_SHMIF_ACHANNELS, ARCAN_SHMIF_SAMPLERATE,
+			current_acontext->global_hooktag
+		);
+
+	return ARCAN_OK;
+}
+
+static size_t ring_free(arcan_aobj* obj)
+{
+	return ARCAN_ASTREAM_RING - (
+		atomic_load_explicit(&obj->ring.head, memory_order_relaxed) -
+		atomic_load_explicit(&obj->ring.tail, memory_order_acquire));
+}
+
+/* [mixer] linear interpolation from the ring into [out], stops on underrun */
+static void mix_stream(arcan_aobj* obj, float* out, size_t frames)
+{
+	struct stream_ring* ring = &obj->ring;
+	if (!ring->buf || !obj->mix_active)
+		return;
+
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t avail = atomic_load_explicit(
+		&ring->head, memory_order_acquire) - tail;
+
+	uint32_t step = atomic_load_explicit(&ring->step, memory_order_relaxed);
+	float gain = obj->mix_gain / 32768.0;
+	uint64_t pos = ring->frac;
+	const size_t mask = ARCAN_ASTREAM_RING - 1;
+
+	for (size_t i = 0; i < frames; i++){
+		size_t ip = pos >> 16;
+		if (ip + 1 >= avail)
+			break;
+
+		float f = (float)(pos & 0xffff) / 65536.0;
+		shmif_asample* s0 = &ring->buf[((tail + ip) & mask) * 2];
+		shmif_asample* s1 = &ring->buf[((tail + ip + 1) & mask) * 2];
+		out[i * 2 + 0] += (s0[0] + (s1[0] - s0[0]) * f) * gain;
+		out[i * 2 + 1] += (s0[1] + (s1[1] - s0[1]) * f) * gain;
+		pos += step;
+	}
+
+	ring->frac = pos & 0xffff;
+	atomic_store_explicit(&ring->tail, tail + (pos >> 16), memory_order_release);
+}
+
+static void mix_voice(struct sample_voice* voice, float* out, size_t frames)
+{
+	arcan_aobj* src = voice->src;
+	float gain = voice->gain / 32768.0;
+	uint64_t pos = voice->pos;
+
+	for (size_t i = 0; i < frames; i++){
+		size_t ip = pos >> 16;
+		if (ip >= src->sample_frames){
+			atomic_store(&voice->done, true);
+			break;
+		}
+
+		float f = (float)(pos & 0xffff) / 65536.0;
+		shmif_asample* s0 = &src->samplebuf[ip * 2];
+		shmif_asample* s1 = ip + 1 < src->sample_frames ? s0 + 2 : s0;
+		out[i * 2 + 0] += (s0[0] + (s1[0] - s0[0]) * f) * gain;
+		out[i * 2 + 1] += (s0[1] + (s1[1] - s0[1]) * f) * gain;
+		pos += voice->step;
+	}
+
+	voice->pos = pos;
+}
+
+/* pull as long as another full shmif buffer would fit, past that the source
+ * is left waiting until the mixer catches up, false if the feed failed */
+static bool feed_ring(arcan_aobj* current)
+{
+	while (ring_free(current) >= ARCAN_ASTREAM_RESERVE){
+		bool cont = ring_free(current) >= 2 * ARCAN_ASTREAM_RESERVE;
+		arcan_errc rv = current->feed(current, current->id, 0, cont, current->tag);
+
+		if (rv == ARCAN_ERRC_NOTREADY)
+			break;
+
+		if (rv != ARCAN_OK)
+			return false;
+
+		if (!cont)
+			break;
+	}
+
+	return true;
+}
+
+static void mix_period(int16_t* dst, size_t frames)
+{
+	float* out = current_acontext->mixbuf;
+	memset(out, '\0', frames * 2 * sizeof(float));
+
+	pthread_mutex_lock(&current_acontext->lock);
+	drain_cmds();
+
+/* failures are reported from the main thread (tick), the event queue is
+ * not ours to touch */
+	arcan_aobj* current = current_acontext->first;
+	platform_fsrv_shmread(true);
+	while (current){
+		if (mixer_fed(current) && current->feed &&
+			!atomic_load(&current->mix_failed) && !feed_ring(current))
+			atomic_store(&current->mix_failed, true);
+		current = current->next;
+	}
+	platform_fsrv_shmread(false);
+
+	current = current_acontext->first;
+	while (current){
+		if (current->kind == AOBJ_STREAM || current->kind == AOBJ_FRAMESTREAM)
+			mix_stream(current, out, frames);
+		current = current->next;
+	}
+
+	for (size_t i = 0; i < ARCAN_AUDIO_SLIMIT; i++){
+		struct sample_voice* voice = &current_acontext->voices[i];
+		if (voice->src && !atomic_load(&voice->done))
+			mix_voice(voice, out, frames);
+	}
+	pthread_mutex_unlock(&current_acontext->lock);
+
+	for (size_t i = 0; i < frames * 2; i++){
+		float v = out[i] * 32767.0;
+		dst[i] = v > 32767.0 ? 32767 : (v < -32768.0 ? -32768 : v);
+	}
+}
+
+static bool pcm_recover(snd_pcm_t* pcm, int err)
+{
+	if (err == -EPIPE || err == -ESTRPIPE)
+		atomic_fetch_add(&current_acontext->xruns, 1);
+
+	return snd_pcm_recover(pcm, err, 1) >= 0;
+}
+
+static void* mixer_thread(void* tag)
+{
+	snd_pcm_t* pcm = current_acontext->pcm;
+	snd_pcm_uframes_t period = current_acontext->period;
+	in_mixer = true;
+
+/* best effort, without rtprio or CAP_SYS_NICE we stay at normal priority */
+	struct sched_param param = {
+		.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1
+	};
+	if (0 != pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+		arcan_warning("(audio) couldn't set realtime priority for mixer\n");
+
+	while (atomic_load(&current_acontext->alive)){
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+		if (avail < 0){
+			if (!pcm_recover(pcm, avail))
+				break;
+			continue;
+		}
+
+/* not started yet (initial fill or after recover) means there is no point
+ * in waiting, just keep filling until the start threshold kicks in */
+		if (avail < period){
+			if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED){
+				snd_pcm_start(pcm);
+				continue;
+			}
+			int rv = snd_pcm_wait(pcm, 100);
+			if (rv < 0 && !pcm_recover(pcm, rv))
+				break;
+			continue;
+		}
+
+		const snd_pcm_channel_area_t* areas;
+		snd_pcm_uframes_t ofs, frames = period;
+		int rv = snd_pcm_mmap_begin(pcm, &areas, &ofs, &frames);
+		if (rv < 0){
+			if (!pcm_recover(pcm, rv))
+				break;
+			continue;
+		}
+
+		int16_t* dst = (int16_t*)((uint8_t*) areas[0].addr +
+			(areas[0].first + ofs * areas[0].step) / 8);
+		mix_period(dst, frames);
+
+		snd_pcm_sframes_t nc = snd_pcm_mmap_commit(pcm, ofs, frames);
+		if (nc < 0 || nc != frames){
+			if (!pcm_recover(pcm, nc >= 0 ? -EPIPE : nc))
+				break;
+		}
+	}
+
+	if (atomic_load(&current_acontext->alive))
+		arcan_warning("(audio) unrecoverable device state, mixer stopped\n");
+
+/* feeds go back to the main thread, and are discarded there */
+	pthread_mutex_lock(&current_acontext->lock);
+	atomic_store(&current_acontext->running, false);
+	pthread_mutex_unlock(&current_acontext->lock);
+
+	return NULL;
+}
+
+static unsigned long cfg_num(cfg_lookup_fun get_config, uintptr_t tag,
+	const char* key, unsigned long def, unsigned long lo, unsigned long hi)
+{
+	char* val = NULL;
+	unsigned long rv = def;
+
+	if (get_config(key, 0, &val, tag) && val){
+		rv = strtoul(val, NULL, 10);
+		free(val);
+	}
+
+	return rv < lo ? lo : (rv > hi ? hi : rv);
+}
+
+static bool open_device()
+{
+	uintptr_t tag;
+	char* node = NULL;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+
+	get_config("audio_device_node", 0, &node, tag);
+	snd_pcm_uframes_t period = cfg_num(get_config, tag, "audio_device_period",
+		ARCAN_AUDIO_PERIOD, ARCAN_AUDIO_PERIOD_MIN, ARCAN_AUDIO_PERIOD_MAX);
+	unsigned periods = cfg_num(get_config, tag,
+		"audio_device_periods", ARCAN_AUDIO_PERIODS, 2, 16);
+
+	snd_pcm_t* pcm;
+	int rv = snd_pcm_open(&pcm, node ? node : "default", SND_PCM_STREAM_PLAYBACK, 0);
+	if (rv < 0){
+		arcan_warning("(audio) couldn't open %s: %s\n",
+			node ? node : "default", snd_strerror(rv));
+		free(node);
+		return false;
+	}
+
+	snd_pcm_hw_params_t* hw;
+	snd_pcm_hw_params_alloca(&hw);
+	unsigned rate = ARCAN_SHMIF_SAMPLERATE;
+	int dir = 0;
+
+	if ((rv = snd_pcm_hw_params_any(pcm, hw)) < 0 ||
+		(rv = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED)) < 0 ||
+		(rv = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16)) < 0 ||
+		(rv = snd_pcm_hw_params_set_channels(pcm, hw, 2)) < 0 ||
+		(rv = snd_pcm_hw_params_set_rate_near(pcm, hw, &rate, &dir)) < 0 ||
+		(rv = snd_pcm_hw_params_set_period_size_near(pcm, hw, &period, &dir)) < 0 ||
+		(rv = snd_pcm_hw_params_set_periods_near(pcm, hw, &periods, &dir)) < 0 ||
+		(rv = snd_pcm_hw_params(pcm, hw)) < 0){
+		arcan_warning("(audio) device %s rejected configuration: %s\n",
+			node ? node : "default", snd_strerror(rv));
+		free(node);
+		snd_pcm_close(pcm);
+		return false;
+	}
+
+	snd_pcm_uframes_t buffer;
+	snd_pcm_hw_params_get_period_size(hw, &period, &dir);
+	snd_pcm_hw_params_get_buffer_size(hw, &buffer);
+
+/* start when there is a full buffer, then wake up once per period */
+	snd_pcm_sw_params_t* sw;
+	snd_pcm_sw_params_alloca(&sw);
+	snd_pcm_sw_params_current(pcm, sw);
+	snd_pcm_sw_params_set_start_threshold(pcm, sw, buffer - buffer % period);
+	snd_pcm_sw_params_set_avail_min(pcm, sw, period);
+	snd_pcm_sw_params(pcm, sw);
+
+	float* mixbuf = arcan_alloc_mem(period * 2 * sizeof(float),
+		ARCAN_MEM_ABUFFER, 0, ARCAN_MEMALIGN_PAGE);
+
+	if (!mixbuf || snd_pcm_prepare(pcm) < 0){
+		arcan_mem_free(mixbuf);
+		free(node);
+		snd_pcm_close(pcm);
+		return false;
+	}
+
+	current_acontext->pcm = pcm;
+	current_acontext->rate = rate;
+	current_acontext->period = period;
+	current_acontext->buffer = buffer;
+	current_acontext->mixbuf = mixbuf;
+	atomic_store(&current_acontext->alive, true);
+	atomic_store(&current_acontext->running, true);
+
+	if (0 != pthread_create(&current_acontext->mixer, NULL, mixer_thread, NULL)){
+		atomic_store(&current_acontext->alive, false);
+		atomic_store(&current_acontext->running, false);
+		current_acontext->pcm = NULL;
+		current_acontext->mixbuf = NULL;
+		arcan_mem_free(mixbuf);
+		snd_pcm_close(pcm);
+		free(node);
+		return false;
+	}
+
+	arcan_warning("(audio) %s: %u Hz, period %lu, buffer %lu frames\n",
+		node ? node : "default", rate, (unsigned long) period, (unsigned long) buffer);
+	free(node);
+
+/* the device rate can change between suspend/resume */
+	pthread_mutex_lock(&current_acontext->lock);
+	for (arcan_aobj* cur = current_acontext->first; cur; cur = cur->next)
+		atomic_store(&cur->ring.step, rate_step(cur->ring.rate));
+	pthread_mutex_unlock(&current_acontext->lock);
+
+	return true;
+}
+
+static void close_device()
+{
+	if (!current_acontext->pcm)
+		return;
+
+	atomic_store(&current_acontext->alive, false);
+	pthread_join(current_acontext->mixer, NULL);
+
+	snd_pcm_drop(current_acontext->pcm);
+	snd_pcm_close(current_acontext->pcm);
+	current_acontext->pcm = NULL;
+
+	arcan_mem_free(current_acontext->mixbuf);
+	current_acontext->mixbuf = NULL;
+}
+
+static void astream_refill(arcan_aobj* current)
+{
+	arcan_event newevent = {
+		.category = EVENT_AUDIO,
+		.aud.kind = EVENT_AUDIO_PLAYBACK_FINISHED
+	};
+
+	if (!current->feed || mixer_fed(current))
+		return;
+
+	if (!feed_ring(current)){
+		newevent.aud.source = current->id;
+		arcan_event_denqueue(arcan_event_defaultctx(), &newevent);
+	}
+
+/* no device (nosound or failed open), consume so that sources don't stall */
+	if (!atomic_load(&current_acontext->running))
+		atomic_store(&current->ring.tail, atomic_load(&current->ring.head));
+}
+
+static inline bool step_transform(arcan_aobj* obj)
+{
+	if (obj->transform == NULL)
+		return false;
+
+	obj->gain += (obj->transform->d_gain - obj->gain) /
+		(float) obj->transform->t_gain;
+
+	obj->transform->t_gain--;
+	if (obj->transform->t_gain == 0){
+		obj->gain = obj->transform->d_gain;
+		struct arcan_achain* ct = obj->transform;
+		obj->transform = obj->transform->next;
+		arcan_mem_free(ct);
+	}
+
+	return true;
+}
+
+void platform_audio_preinit()
+{
+}
+
+bool platform_audio_init(bool noaudio)
+{
+/* don't supported repeated calls without shutting down in between */
+	if (current_acontext->init)
+		return false;
+
+	current_acontext->init = true;
+	current_acontext->suspended = false;
+	current_acontext->nosound = noaudio;
+	current_acontext->rate = ARCAN_SHMIF_SAMPLERATE;
+
+	/* just give a slightly "random" base so that
+	 user scripts don't get locked into hard-coded ids .. */
+	arcan_random((unsigned char*)&current_acontext->lastid, sizeof(arcan_aobj_id));
+
+/* without a device everything still works but output is discarded */
+	if (noaudio)
+		return true;
+
+	return open_device();
+}
+
+void platform_audio_suspend()
+{
+	if (!current_acontext->init || current_acontext->suspended)
+		return;
+
+/* release the device so that others can use it while we are suspended */
+	close_device();
+	current_acontext->suspended = true;
+}
+
+void platform_audio_resume()
+{
+	if (!current_acontext->init || !current_acontext->suspended)
+		return;
+
+	current_acontext->suspended = false;
+	if (!current_acontext->nosound)
+		open_device();
+}
+
+void platform_audio_tick(uint8_t ntt)
+{
+	if (!current_acontext->init || current_acontext->suspended)
+		return;
+
+	platform_audio_refresh();
+
+/* update time-dependent transformations */
+	while (ntt-- > 0) {
+		arcan_aobj* current = current_acontext->first;
+
+		while (current){
+			if (step_transform(current)){
+				if (current->gproxy)
+					current->gproxy(current->gain, current->tag);
+				else
+					send_cmd((struct mixer_cmd){
+						.kind = MIXCMD_GAIN, .id = current->id, .gain = current->gain});
+			}
+
+			current = current->next;
+		}
+
+		current_acontext->atick_counter++;
+	}
+
+/* streams the mixer couldn't feed, same event as a failed refill */
+	for (arcan_aobj* current = current_acontext->first; current;
+		current = current->next){
+		if (!atomic_load(&current->mix_failed) || current->fail_reported)
+			continue;
+
+		current->fail_reported = true;
+		arcan_event_enqueue(arcan_event_defaultctx(),
+		&(struct arcan_event){
+			.category = EVENT_AUDIO,
+			.aud.kind = EVENT_AUDIO_PLAYBACK_FINISHED,
+			.aud.source = current->id
+		});
+	}
+
+/* release voices the mixer is done with */
+	for (size_t i = 0; i < ARCAN_AUDIO_SLIMIT; i++){
+		struct sample_voice* voice = &current_acontext->voices[i];
+		if (!voice->src || !atomic_load(&voice->done))
+			continue;
+
+		intptr_t otag = voice->tag;
+		pthread_mutex_lock(&current_acontext->lock);
+		*voice = (struct sample_voice){0};
+		pthread_mutex_unlock(&current_acontext->lock);
+
+		if (otag != 0){
+			arcan_event_enqueue(arcan_event_defaultctx(),
+			&(struct arcan_event){
+				.category = EVENT_AUDIO,
+				.aud.kind = EVENT_AUDIO_PLAYBACK_FINISHED,
+				.aud.otag = otag
+			});
+		}
+	}
+}
+
+size_t platform_audio_refresh()
+{
+	if (!current_acontext->init || current_acontext->suspended)
+		return 0;
+
+	arcan_aobj* current = current_acontext->first;
+	size_t rv = 0;
+
+	while(current){
+		if (
+			current->kind == AOBJ_STREAM      ||
+			current->kind == AOBJ_FRAMESTREAM ||
+			current->kind == AOBJ_CAPTUREFEED
+		)
+			astream_refill(current);
+
+		if (ring_free(current) != ARCAN_ASTREAM_RING)
+			rv++;
+
+		current = current->next;
+	}
+
+	return rv;
+}
+
+void platform_audio_shutdown()
+{
+	if (!current_acontext->init)
+		return;
+
+	close_device();
+	memset(current_acontext->voices, '\0', sizeof(current_acontext->voices));
+	current_acontext->init = false;
+}
+
+bool platform_audio_rebuild(arcan_aobj_id id)
+{
+	arcan_aobj* aobj = arcan_audio_getobj(id);
+	if (!aobj || aobj->kind != AOBJ_STREAM)
+		return false;
+
+/* the source has been reset, drop whatever was left from before and give
+ * the mixer another go at feeding it */
+	send_cmd((struct mixer_cmd){.kind = MIXCMD_FLUSH, .id = id});
+	atomic_store(&aobj->mix_failed, false);
+	aobj->fail_reported = false;
+
+	return true;
+}
+
+bool platform_audio_hookfeed(arcan_aobj_id id, void* tag, arcan_monafunc_cb hookfun, void** oldtag)
+{
+	arcan_aobj* aobj = arcan_audio_getobj(id);
+	if (!aobj)
+		return false;
+
+	if (oldtag)
+		*oldtag = aobj->monitortag ? aobj->monitortag : NULL;
+
+/* this moves feeding between the mixer and the main thread */
+	pthread_mutex_lock(&current_acontext->lock);
+	aobj->monitor = hookfun;
+	aobj->monitortag = tag;
+	pthread_mutex_unlock(&current_acontext->lock);
+
+	return true;
+}
+
+arcan_aobj_id platform_audio_load_sample(
+	const char* fname, float gain, arcan_errc* err)
+{
+	arcan_aobj* aobj;
+	arcan_aobj_id rid = arcan_audio_alloc(&aobj);
+
+	if (rid == ARCAN_EID){
+		if (err) *err = ARCAN_ERRC_OUT_OF_SPACE;
+		return ARCAN_EID;
+	}
+
+	if (!arcan_load_wave(fname, aobj)){
+		if (err) *err = ARCAN_ERRC_BAD_RESOURCE;
+		release_obj(aobj);
+		return ARCAN_EID;
+	}
+
+	aobj->kind = AOBJ_SAMPLE;
+	aobj->gain = gain;
+	link_obj(aobj);
+
+	if (err) *err = ARCAN_OK;
+
+	return rid;
+}
+
+arcan_aobj_id platform_audio_sample_buffer(float* buffer, size_t elems, int channels, int samplerate, const char* fmt_specifier)
+{
+	if (channels != 1 && channels != 2)
+		return ARCAN_EID;
+
+	arcan_aobj* aobj;
+	arcan_aobj_id rid = arcan_audio_alloc(&aobj);
+
+	if (rid == ARCAN_EID)
+		return ARCAN_EID;
+
+	size_t nf = elems / channels;
+	aobj->samplebuf = arcan_alloc_mem(nf * 2 * sizeof(shmif_asample),
+		ARCAN_MEM_ABUFFER, 0, ARCAN_MEMALIGN_PAGE);
+
+	if (!aobj->samplebuf){
+		release_obj(aobj);
+		return ARCAN_EID;
+	}
+
+	for (size_t i = 0; i < nf; i++){
+		for (size_t c = 0; c < 2; c++){
+			float v = buffer[i * channels + (c < channels ? c : 0)];
+			v = v > 1.0 ? 1.0 : (v < -1.0 ? -1.0 : v);
+			aobj->samplebuf[i * 2 + c] = v < 0.0 ? v * 32768.0 : v * 32767.0;
+		}
+	}
+
+	aobj->sample_frames = nf;
+	aobj->samplerate = samplerate;
+	aobj->kind = AOBJ_SAMPLE;
+	aobj->gain = 1.0;
+	link_obj(aobj);
+
+	return rid;
+}
+
+bool platform_audio_alterfeed(arcan_aobj_id id, arcan_afunc_cb cb)
+{
+	arcan_aobj* obj = arcan_audio_getobj(id);
+
+	if (!obj || !cb)
+		return false;
+
+	obj->feed = cb;
+	return true;
+}
+
+arcan_aobj_id platform_audio_feed(arcan_afunc_cb feed, void* tag, arcan_errc* errc)
+{
+	arcan_aobj* aobj;
+	arcan_aobj_id rid = arcan_audio_alloc(&aobj);
+	if (!aobj){
+		if (errc) *errc = ARCAN_ERRC_OUT_OF_SPACE;
+		return ARCAN_EID;
+	}
+
+/* the ring is allocated when we first get data, plenty of frameservers
+ * never produce any audio */
+	aobj->streaming = true;
+	aobj->tag = tag;
+	aobj->feed = feed;
+	aobj->gain = aobj->mix_gain = 1.0;
+	aobj->active = aobj->mix_active = true;
+	aobj->kind = AOBJ_STREAM;
+	link_obj(aobj);
+
+	if (errc) *errc = ARCAN_OK;
+	return rid;
+}
+
+enum aobj_kind platform_audio_kind(arcan_aobj_id id)
+{
+	arcan_aobj* aobj = arcan_audio_getobj(id);
+	return aobj ? aobj->kind : AOBJ_INVALID;
+}
+
+bool platform_audio_stop(arcan_aobj_id id)
+{
+	arcan_aobj* dobj = arcan_audio_getobj(id);
+	if (!dobj)
+		return false;
+
+	dobj->kind = AOBJ_INVALID;
+	dobj->feed = NULL;
+
+	arcan_audio_free(id);
+
+	arcan_event newevent = {
+		.category = EVENT_AUDIO,
+		.aud.kind = EVENT_AUDIO_OBJECT_GONE,
+		.aud.source = id
+	};
+
+	arcan_event_enqueue(arcan_event_defaultctx(), &newevent);
+	return true;
+}
+
+bool platform_audio_play(
+	arcan_aobj_id id, bool gain_override, float gain, intptr_t tag)
+{
+	arcan_aobj* aobj = arcan_audio_getobj(id);
+
+	if (!aobj)
+		return false;
+
+	if (aobj->kind != AOBJ_SAMPLE){
+		aobj->active = true;
+		send_cmd((struct mixer_cmd){
+			.kind = MIXCMD_ACTIVE, .id = id, .active = true});
+		return true;
+	}
+
+/* find a free voice (if any), without a device it finishes right away */
+	pthread_mutex_lock(&current_acontext->lock);
+	for (size_t i = 0; i < ARCAN_AUDIO_SLIMIT; i++){
+		struct sample_voice* voice = &current_acontext->voices[i];
+		if (voice->src)
+			continue;
+
+		*voice = (struct sample_voice){
+			.src = aobj,
+			.step = rate_step(aobj->samplerate),
+			.gain = gain_override ? gain : aobj->gain,
+			.tag = tag,
+			.done = !atomic_load(&current_acontext->running)
+		};
+		break;
+	}
+	pthread_mutex_unlock(&current_acontext->lock);
+
+	return true;
+}
+
+bool platform_audio_pause(arcan_aobj_id id)
+{
+	arcan_aobj* dobj = arcan_audio_getobj(id);
+
+	if (!dobj || dobj->kind == AOBJ_SAMPLE)
+		return false;
+
+	dobj->active = false;
+	send_cmd((struct mixer_cmd){
+		.kind = MIXCMD_ACTIVE, .id = id, .active = false});
+	return true;
+}
+
+bool platform_audio_rewind(arcan_aobj_id id)
+{
+	arcan_aobj* aobj = arcan_audio_getobj(id);
+	return aobj && aobj->kind != AOBJ_SAMPLE;
+}
+
+void platform_audio_capturelist(char** capturelist)
+{
+/* arcan_audio_capturelist doesn't take the list back, nothing to fill */
+}
+
+arcan_aobj_id platform_audio_capturefeed(const char* identifier)
+{
+	snd_pcm_t* capture;
+	const char* node = identifier ? identifier : "default";
+
+	int rv = snd_pcm_open(&capture, node, SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK);
+	if (rv < 0){
+		arcan_warning("arcan_audio_capturefeed(%s) - %s\n", node, snd_strerror(rv));
+		return ARCAN_EID;
+	}
+
+	if ((rv = snd_pcm_set_params(capture, SND_PCM_FORMAT_S16,
+		SND_PCM_ACCESS_RW_INTERLEAVED, ARCAN_SHMIF_ACHANNELS,
+		ARCAN_SHMIF_SAMPLERATE, 1, 100000)) < 0){
+		arcan_warning("arcan_audio_capturefeed(%s) - %s\n", node, snd_strerror(rv));
+		snd_pcm_close(capture);
+		return ARCAN_EID;
+	}
+
+	arcan_aobj* dstobj;
+	if (ARCAN_EID == arcan_audio_alloc(&dstobj)){
+		snd_pcm_close(capture);
+		return ARCAN_EID;
+	}
+
+	dstobj->streaming = true;
+	dstobj->gain = 1.0;
+	dstobj->kind = AOBJ_CAPTUREFEED;
+	dstobj->feed = capturefeed;
+	dstobj->capture = capture;
+	dstobj->tag = capture;
+	link_obj(dstobj);
+
+	snd_pcm_start(capture);
+	return dstobj->id;
+}
+
+bool platform_audio_setgain(arcan_aobj_id id, float gain, uint16_t time)
+{
+	if (id == ARCAN_EID){
+		current_acontext->def_gain = gain;
+		return true;
+	}
+
+	arcan_aobj* dobj = arcan_audio_getobj(id);
+
+	if (!dobj)
+		return false;
+
+/* immediately */
+	if (time == 0){
+		struct arcan_achain* current = dobj->transform;
+		while (current){
+			struct arcan_achain* next = current->next;
+			arcan_mem_free(current);
+			current = next;
+		}
+		dobj->transform = NULL;
+		dobj->gain = gain;
+
+		if (dobj->gproxy)
+			dobj->gproxy(dobj->gain, dobj->tag);
+		else
+			send_cmd((struct mixer_cmd){
+				.kind = MIXCMD_GAIN, .id = id, .gain = gain});
+	}
+	else{
+		struct arcan_achain** dptr = &dobj->transform;
+
+		while(*dptr){
+			dptr = &(*dptr)->next;
+		}
+
+		*dptr = arcan_alloc_mem(sizeof(struct arcan_achain),
+			ARCAN_MEM_ATAG, 0, ARCAN_MEMALIGN_NATURAL);
+
+		(*dptr)->next = NULL;
+		(*dptr)->t_gain = time;
+		(*dptr)->d_gain = gain;
+	}
+
+	return true;
+}
+
+bool platform_audio_getgain(arcan_aobj_id id, float* gain)
+{
+	if (id == ARCAN_EID){
+		if (gain)
+			*gain = current_acontext->def_gain;
+		return true;
+	}
+
+	arcan_aobj* dobj = arcan_audio_getobj(id);
+
+	if (!dobj)
+		return false;
+
+	if (gain)
+		*gain = dobj->gain;
+
+	return true;
+}
+
+void platform_audio_buffer(void* aobjopaq, ssize_t buffer, void* audbuf,
+	size_t abufs, unsigned int channels, unsigned int samplerate, void* tag)
+{
+	arcan_aobj* aobj = aobjopaq;
+
+	if (aobj->monitor)
+		aobj->monitor(aobj->id, audbuf, abufs, channels,
+			samplerate, aobj->monitortag);
+
+	if (current_acontext->globalhook)
+		current_acontext->globalhook(aobj->id, audbuf, abufs, channels,
+			samplerate, current_acontext->global_hooktag);
+
+	if (aobj->gproxy || (channels != 1 && channels != 2))
+		return;
+
+	struct stream_ring* ring = &aobj->ring;
+	if (!ring->buf){
+		shmif_asample* buf = arcan_alloc_mem(
+			ARCAN_ASTREAM_RING * 2 * sizeof(shmif_asample),
+			ARCAN_MEM_ABUFFER, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_PAGE
+		);
+		if (!buf)
+			return;
+
+		if (!in_mixer)
+			pthread_mutex_lock(&current_acontext->lock);
+		ring->buf = buf;
+		if (!in_mixer)
+			pthread_mutex_unlock(&current_acontext->lock);
+	}
+
+	if (samplerate != ring->rate || !ring->step){
+		ring->rate = samplerate;
+		atomic_store(&ring->step, rate_step(samplerate));
+	}
+
+	aobj->last_used = current_acontext->atick_counter;
+
+/* refill makes sure there is room, this only triggers with a misbehaving
+ * feed and then the end of the buffer is dropped */
+	size_t nf = abufs / (sizeof(shmif_asample) * channels);
+	size_t space = ring_free(aobj);
+	if (nf > space)
+		nf = space;
+
+	const shmif_asample* src = audbuf;
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	const size_t mask = ARCAN_ASTREAM_RING - 1;
+
+	for (size_t i = 0; i < nf; i++){
+		shmif_asample* dst = &ring->buf[((head + i) & mask) * 2];
+		dst[0] = src[i * channels];
+		dst[1] = src[i * channels + (channels - 1)];
+	}
+
+	atomic_store_explicit(&ring->head, head + nf, memory_order_release);
+}
+
+void platform_audio_aid_refresh(arcan_aobj_id aid)
+{
+	struct arcan_aobj* obj = arcan_audio_getobj(aid);
+	if (obj && current_acontext->init && !current_acontext->suspended)
+		astream_refill(obj);
+}
+
+/*
+ * very inefficient, but the set of IDs to delete is reasonably small
+ */
+void platform_audio_purge(arcan_aobj_id* save, size_t save_count)
+{
+	arcan_aobj* current = _current_acontext.first;
+	arcan_aobj** previous = &_current_acontext.first;
+
+	while(current){
+		bool match = false;
+
+		for (size_t i = 0; i < save_count; i++){
+			if (save[i] == current->id){
+				match = true;
+				break;
+			}
+		}
+
+		arcan_aobj* next = current->next;
+		if (!match){
+			pthread_mutex_lock(&current_acontext->lock);
+			delink_obj(previous, current);
+			pthread_mutex_unlock(&current_acontext->lock);
+
+			if (current->feed)
+				current->feed(current, current->id, -1, false, current->tag);
+
+			release_obj(current);
+		}
+		else {
+			previous = &current->next;
+		}
+
+		current = next;
+	}
+}
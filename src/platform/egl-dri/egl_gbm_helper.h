@@ -84,6 +84,59 @@ static int dma_mod_constants[] = {
 	EGL_DMA_BUF_PLANE3_MODIFIER_LO_EXT,
 };
 
+static bool helper_fourcc_yuv(uint32_t fourcc)
+{
+	switch (fourcc){
+	case DRM_FORMAT_NV12:
+	case DRM_FORMAT_NV21:
+	case DRM_FORMAT_NV16:
+	case DRM_FORMAT_NV61:
+	case DRM_FORMAT_P010:
+	case DRM_FORMAT_YUV420:
+	case DRM_FORMAT_YVU420:
+	case DRM_FORMAT_YUV422:
+	case DRM_FORMAT_YUYV:
+	case DRM_FORMAT_UYVY:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Drivers that can only sample a format/modifier through samplerExternalOES
+ * (typical for YUV) report it as external_only, those images can't be bound
+ * to a regular GL_TEXTURE_2D. Without the modifiers query, assume that it
+ * can and let the import fail instead.
+ */
+static bool helper_dmabuf_external_only(
+	struct egl_env* egl, EGLDisplay dpy, uint32_t fourcc, uint64_t mod)
+{
+	EGLint n = 0;
+	if (!egl->query_dmabuf_modifiers ||
+		!egl->query_dmabuf_modifiers(dpy, fourcc, 0, NULL, NULL, &n) || n <= 0)
+		return false;
+
+	EGLuint64KHR mods[n];
+	EGLBoolean ext[n];
+	if (!egl->query_dmabuf_modifiers(dpy, fourcc, n, mods, ext, &n))
+		return false;
+
+	for (EGLint i = 0; i < n; i++)
+		if (mods[i] == mod)
+			return ext[i];
+
+/* implicit modifiers, only external if every explicit one is */
+	if (mod == DRM_FORMAT_MOD_INVALID){
+		for (EGLint i = 0; i < n; i++)
+			if (!ext[i])
+				return false;
+		return true;
+	}
+
+	return false;
+}
+
 static EGLImage helper_dmabuf_eglimage(
 	struct agp_fenv* agp, struct egl_env* egl,
 	EGLDisplay dpy,
@@ -97,6 +150,31 @@ static EGLImage helper_dmabuf_eglimage(
 	ADD_ATTR(EGL_HEIGHT, planes[0].h);
 	ADD_ATTR(EGL_LINUX_DRM_FOURCC_EXT, planes[0].gbm.format);
 
+/* conversion hints only apply to YUV and are otherwise an import error */
+	if (helper_fourcc_yuv(planes[0].gbm.format)){
+		static const EGLint cs[] = {
+			EGL_ITU_REC601_EXT, EGL_ITU_REC601_EXT,
+			EGL_ITU_REC709_EXT, EGL_ITU_REC2020_EXT
+		};
+		if (planes[0].gbm.color_space &&
+			planes[0].gbm.color_space < sizeof(cs) / sizeof(cs[0]))
+			ADD_ATTR(EGL_YUV_COLOR_SPACE_HINT_EXT, cs[planes[0].gbm.color_space]);
+
+		if (planes[0].gbm.color_range)
+			ADD_ATTR(EGL_SAMPLE_RANGE_HINT_EXT,
+				planes[0].gbm.color_range == SHMIFEXT_RANGE_FULL ?
+				EGL_YUV_FULL_RANGE_EXT : EGL_YUV_NARROW_RANGE_EXT);
+
+		if (planes[0].gbm.chroma_siting){
+			ADD_ATTR(EGL_YUV_CHROMA_HORIZONTAL_SITING_HINT_EXT,
+				(planes[0].gbm.chroma_siting & SHMIFEXT_SITING_H_HALF) ?
+				EGL_YUV_CHROMA_SITING_0_5_EXT : EGL_YUV_CHROMA_SITING_0_EXT);
+			ADD_ATTR(EGL_YUV_CHROMA_VERTICAL_SITING_HINT_EXT,
+				(planes[0].gbm.chroma_siting & SHMIFEXT_SITING_V_HALF) ?
+				EGL_YUV_CHROMA_SITING_0_5_EXT : EGL_YUV_CHROMA_SITING_0_EXT);
+		}
+	}
+
 	uint64_t mod =
 		((uint64_t)planes[0].gbm.mod_hi << (uint64_t)32) |
 		(uint64_t)(planes[0].gbm.mod_lo);
@@ -125,6 +203,60 @@ static EGLImage helper_dmabuf_eglimage(
 	return img;
 }
 
+/*
+ * Have the GPU (not the CPU) wait for the sync_file [fence] before executing
+ * further commands from the current context. The descriptor remains owned by
+ * the caller. Returns false if the fence could not be imported, in that case
+ * only implicit synchronization applies.
+ */
+static bool helper_fence_wait(struct egl_env* egl, EGLDisplay dpy, int fence)
+{
+	if (fence <= 0 ||
+		!egl->create_synch || !egl->wait_synch || !egl->destroy_synch)
+		return false;
+
+/* on success EGL takes ownership of the descriptor */
+	int fd = dup(fence);
+	if (-1 == fd)
+		return false;
+
+	EGLSyncKHR synch = egl->create_synch(dpy, EGL_SYNC_NATIVE_FENCE_ANDROID,
+		(EGLint[]){EGL_SYNC_NATIVE_FENCE_FD_ANDROID, fd, EGL_NONE});
+	if (synch == EGL_NO_SYNC_KHR){
+		close(fd);
+		return false;
+	}
+
+	egl->wait_synch(dpy, synch, 0);
+	egl->destroy_synch(dpy, synch);
+	return true;
+}
+
+/*
+ * Create a sync_file that signals when the commands submitted from the current
+ * context so far have completed. This flushes but does not wait, returns -1 if
+ * native fences are not supported.
+ */
+static int helper_fence_create(
+	struct agp_fenv* agp, struct egl_env* egl, EGLDisplay dpy)
+{
+	if (!egl->create_synch || !egl->dup_fence_fd || !egl->destroy_synch)
+		return -1;
+
+	EGLSyncKHR synch = egl->create_synch(dpy, EGL_SYNC_NATIVE_FENCE_ANDROID,
+		(EGLint[]){EGL_SYNC_NATIVE_FENCE_FD_ANDROID,
+			EGL_NO_NATIVE_FENCE_FD_ANDROID, EGL_NONE});
+	if (synch == EGL_NO_SYNC_KHR)
+		return -1;
+
+/* the fence descriptor only exists once the sync has been flushed */
+	agp->flush();
+	int fd = egl->dup_fence_fd(dpy, synch);
+	egl->destroy_synch(dpy, synch);
+
+	return fd == EGL_NO_NATIVE_FENCE_FD_ANDROID ? -1 : fd;
+}
+
 static void helper_eglimage_color(
 	struct agp_fenv* agp, struct egl_env* egl, EGLImage img, unsigned* id)
 {
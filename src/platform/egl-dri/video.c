@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <poll.h>
+#include <linux/sync_file.h>
 
 #include <fcntl.h>
 #include <assert.h>
@@ -62,6 +63,8 @@
  *    HDR_OUTPUT_METADATA + blob
  *
  * For VRR / Explicit Synch:
+ *  - vrr_capable (connector) and VRR_ENABLED (crtc) are exposed, but the
+ *    refresh range is not, so it is taken from the EDID range descriptor.
  *  - The interface is so-so when communicating special parameters like
  *    slew interval, see deadline_for_display.
  */
@@ -106,6 +109,9 @@ struct shmifext_color_buffer {
 static bool lookup_drm_propval(int fd,
 	uint32_t oid, uint32_t otype, const char* name, uint64_t* val, bool id);
 
+/* lower bound of the adaptive synch range when the EDID doesn't provide one */
+#define VRR_MIN_HZ 48
+
 static const char* egl_errstr();
 static void* lookup(void* tag, const char* sym, bool req)
 {
@@ -137,6 +143,10 @@ static char* egl_envopts[] = {
 	"device_nodpms", "set to disable power management controls",
 	"device_direct_scanout", "enable direct rendertarget scanout",
 	"display_context=1", "set outer shared headless context, per display contexts",
+	"display_clocks", "compose and scan out each display on its own refresh",
+	"device_planes", "scan out client buffers and the cursor on hardware planes",
+	"device_offload=direct|copy", "transfer for displays composed on the first card",
+	"display_depth", "switch to 10-bit / fp16 scanout for deep mapped sources",
 	NULL
 };
 
@@ -158,7 +168,9 @@ enum display_update_state {
 	UPDATE_FLIP, /* swap between front and back bo */
 	UPDATE_DIRECT,
 	UPDATE_FRONT,
-	UPDATE_SKIP
+	UPDATE_SKIP,
+	UPDATE_PLANES, /* only plane state changed, primary keeps its buffer */
+	UPDATE_OFFLOAD /* composed on the render node, scan out an offload buffer */
 };
 
 /*
@@ -193,6 +205,10 @@ struct dev_node {
 	bool fb2_modifiers;
 	bool ts_monotonic;
 
+/* DRM_MODE_PAGE_FLIP_ASYNC support for legacy flips and atomic commits */
+	bool async_flip;
+	bool atomic_async;
+
 /*
  * method is the key driver for most paths in here, see the M_ enum values
  * above to indicate which of the elements here that are valid.
@@ -252,6 +268,103 @@ enum output_format {
 	OUTPUT_HDR     = 3
 };
 
+/*
+ * Overlay and cursor planes per display (video_device_planes) and how many
+ * of the topmost objects in the world pipeline that are considered for them.
+ * After repeated failures on real commits, a display stops trying.
+ */
+#ifndef DISPLAY_PLANE_LIMIT
+#define DISPLAY_PLANE_LIMIT 4
+#endif
+
+#ifndef PLANE_SCAN_LIMIT
+#define PLANE_SCAN_LIMIT 64
+#endif
+
+#ifndef PLANE_FAIL_LIMIT
+#define PLANE_FAIL_LIMIT 4
+#endif
+
+/* asynchronous flips (HINT_TEARING, "tearing" synch or a client request) are
+ * dropped for a display when the driver keeps rejecting them */
+#ifndef ASYNC_FAIL_LIMIT
+#define ASYNC_FAIL_LIMIT 4
+#endif
+
+/*
+ * Displays on another card than the one that composes (the card with the agp
+ * context, nodes[0]) get a small swapchain of linear buffers allocated on the
+ * render node. The display card either imports them as framebuffers as is
+ * (direct) or blits them into its own scanout buffers (copy).
+ */
+#ifndef OFFLOAD_BUFFERS
+#define OFFLOAD_BUFFERS 3
+#endif
+
+enum offload_mode {
+	OFFLOAD_NONE = 0,
+	OFFLOAD_DIRECT = 1,
+	OFFLOAD_COPY = 2
+};
+
+struct offload_buf {
+/* render node side */
+	struct gbm_bo* bo;
+	EGLImage img;
+	unsigned tex;
+	struct agp_vstore store;
+	struct agp_rendertarget* rtgt;
+
+/* display node side, direct uses fb, copy samples through tex/fbo */
+	struct gbm_bo* remote_bo;
+	uint32_t fb;
+	EGLImage remote_img;
+	unsigned remote_tex, remote_fbo;
+};
+
+#ifndef GL_READ_FRAMEBUFFER
+#define GL_READ_FRAMEBUFFER 0x8CA8
+#define GL_DRAW_FRAMEBUFFER 0x8CA9
+#endif
+
+#ifndef DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP
+#define DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP 0x15
+#endif
+
+/*
+ * one hardware plane that the assignment pass may give an object of its own,
+ * [fb] is what the next (or pending) commit sets, [shown] is what the last
+ * completed commit latched, coordinates are in crtc space.
+ */
+struct disp_plane {
+	uint32_t id;
+	uint32_t fb, shown;
+	arcan_vobj_id vid;
+	int32_t x, y;
+	uint32_t w, h, src_w, src_h;
+};
+
+/*
+ * Client buffers (dma-buf) imported as KMS framebuffers so that they can go
+ * on a plane. Entries are created by the assignment pass for objects that
+ * are otherwise eligible and filled in on the next buffer from the client,
+ * [img] pairs the import with the EGLImage of the same submission.
+ */
+#ifndef SCANOUT_FB_LIMIT
+#define SCANOUT_FB_LIMIT 32
+#endif
+
+struct scanout_fb {
+	struct agp_vstore* vs;
+	uintptr_t img;
+	struct gbm_bo* bo;
+	uint32_t fb;
+	uint32_t format;
+
+/* acquire fence of the client buffer, IN_FENCE_FD on the plane it goes on */
+	int fence;
+};
+
 /*
  * aggregation struct that represent one triple of display, card, bindings
  */
@@ -260,8 +373,16 @@ struct dispout {
 	struct dev_node* device;
 	unsigned long long last_update;
 	int output_format;
+	bool depth_auto; /* output_format was picked from the mapped source */
 	uint64_t frame_cookie;
 
+/* damage (plane coordinates) for the next atomic commit, count == 0 means
+ * that the entire plane should be considered changed */
+	struct {
+		struct drm_mode_rect rects[2 * AGP_DAMAGE_LIMIT];
+		size_t count;
+	} damage;
+
 	struct monitor_mode* mode_cache;
 	size_t mode_cache_sz;
 
@@ -276,8 +397,14 @@ struct dispout {
 		int synch_fence;
 		uint64_t in_flip;
 
+/* OUT_FENCE_PTR of the last atomic commit, signals once it is on screen */
+		int32_t out_fence;
+
 		struct gbm_bo* cur_bo, (* next_bo);
 		uint32_t cur_fb;
+
+/* set when a commit only changed plane state and cur_bo stays on the crtc */
+		bool keep_bo;
 		int format;
 		struct gbm_surface* surface;
 
@@ -321,14 +448,65 @@ struct dispout {
 			struct drm_hdr_meta drm;
 		} hdr;
 
-/* should track a small amount of possible overlay planes (one or two) and
- * allow the platform_map call to set them and their offsets individually */
+/* adaptive synch, [capable] is connector vrr_capable with a VRR_ENABLED crtc,
+ * [target] the requested rate (<= 0 for the panel range) in [min, max] Hz */
+		struct {
+			bool capable, enabled;
+			float target;
+			float min_hz, max_hz;
+		} vrr;
+
+/* overlay and cursor planes are tracked in [planes] below */
 	} display;
 
+/* Planes other than the primary that can be used with the crtc, these are
+ * assigned each frame by assign_planes. [key] is the signature of the
+ * candidate set that last went through test-only commits, [accept] which
+ * of those candidates passed and [dirty] that the next commit changes the
+ * plane state even if the primary is unchanged. */
+	struct {
+		struct disp_plane overlay[DISPLAY_PLANE_LIMIT];
+		size_t n_overlay;
+		struct disp_plane cursor;
+
+		struct {
+			uint32_t handle, fb, pitch;
+			size_t w, h, sz;
+			uint8_t* map;
+			struct agp_vstore* src;
+			size_t src_seq, src_w, src_h;
+		} cursor_buf;
+
+		uint64_t key;
+		uint32_t accept;
+		bool cursor_ok;
+		bool dirty;
+		size_t fails;
+	} planes;
+
 /* internal v-store and system mappings, rules for drawing final output */
 	arcan_vobj_id vid;
 	bool force_compose;
 	bool skip_blit;
+
+/* mapped with HINT_TEARING, async_fails counts rejected asynchronous flips */
+	bool tearing;
+	size_t async_fails;
+
+/* composed on another card (render), see OFFLOAD_BUFFERS */
+	struct {
+		struct dev_node* render;
+		enum offload_mode mode;
+		bool failed;
+		size_t w, h;
+		struct offload_buf buf[OFFLOAD_BUFFERS];
+		size_t next, pending, front;
+		int fence;
+		uint64_t render_us, xfer_us, frames;
+	} offload;
+
+/* composition clock not up yet this synch (video_display_clocks) */
+	bool deferred;
 	size_t dispw, disph, dispx, dispy;
 
 	_Alignas(16) float projection[16];
@@ -359,6 +537,23 @@ static struct {
 
 	long long last_card_scan;
 	bool scan_pending;
+
+/* per-display composition clocks in the conductor */
+	bool display_clocks;
+
+/* overlay / cursor plane assignment (video_device_planes), framebuffers for
+ * client buffers and those replaced while they may still be scanned out */
+	bool planes;
+
+/* default output format follows the depth of the mapped source */
+	bool display_depth;
+
+	struct scanout_fb scanout[SCANOUT_FB_LIMIT];
+	struct {
+		uint32_t fb;
+		struct gbm_bo* bo;
+	} retired[SCANOUT_FB_LIMIT];
+	size_t n_retired;
 } egl_dri = {
 	.ledind = 255
 };
@@ -384,7 +579,9 @@ static struct dispout* allocate_display(struct dev_node* node)
 			displays[i].display.primary = false;
 			displays[i].id = i;
 			displays[i].buffer.synch_fence = -1;
+			displays[i].buffer.out_fence = -1;
 			displays[i].buffer.synch = EGL_NO_SYNC_KHR;
+			displays[i].offload.fence = -1;
 
 			node->refc++;
 			displays[i].state = DISP_KNOWN;
@@ -498,6 +695,17 @@ static void dpms_set(struct dispout* d, int level)
  * free, dealloc, possibly re-index displays
  */
 static void disable_display(struct dispout*, bool dealloc);
+static void offload_free(struct dispout* d);
+static bool display_offloaded(struct dispout* d);
+
+/*
+ * client buffers that may go on a plane (see assign_planes) are imported as
+ * framebuffers before the EGLImage import consumes the descriptors
+ */
+static void scanout_import(struct agp_vstore*, struct agp_buffer_plane*, size_t);
+static void scanout_bind(struct agp_vstore*, uintptr_t img);
+static void scanout_drop(struct agp_vstore*);
+static struct scanout_fb* scanout_find(struct agp_vstore*, bool alloc);
 
 /*
  * assumes that the video pipeline is in a state to safely
@@ -617,6 +825,21 @@ bool platform_video_map_buffer(
 	EGLDisplay dpy = device->display;
 	struct egl_env* egl = &device->eglenv;
 
+/* the vstore is sampled as a normal 2D texture, YUV that the driver can only
+ * sample as external is rejected so the client falls back to converting */
+	uint64_t mod =
+		((uint64_t)planes[0].gbm.mod_hi << 32) | (uint64_t)planes[0].gbm.mod_lo;
+	if (helper_fourcc_yuv(planes[0].gbm.format) &&
+		helper_dmabuf_external_only(egl, dpy, planes[0].gbm.format, mod)){
+		debug_print("buffer import rejected, external-only yuv format");
+		for (size_t i = 0; i < n_planes; i++)
+			close(planes[i].fd);
+		return false;
+	}
+
+	if (egl_dri.planes)
+		scanout_import(vs, planes, n_planes);
+
 	EGLImage img = helper_dmabuf_eglimage(agp_env(), egl, dpy, planes, n_planes);
 	if (!img){
 		debug_print("buffer import failed (%s)", egl_errstr());
@@ -637,11 +860,147 @@ bool platform_video_map_buffer(
 		egl->image_target_texture2D(GL_TEXTURE_2D, img);
 	agp_deactivate_vstore();
 
+/* composition that samples the buffer waits on the GPU for the client to
+ * finish, without a fence (or support for one) implicit synch applies */
+	for (size_t i = 0; i < n_planes; i++){
+		if (planes[i].fence <= 0)
+			continue;
+
+		if (!helper_fence_wait(egl, dpy, planes[i].fence))
+			debug_print("buffer fence import failed (%s)", egl_errstr());
+		break;
+	}
+
 	vs->vinf.text.tag = (uintptr_t) img;
+	if (egl_dri.planes)
+		scanout_bind(vs, vs->vinf.text.tag);
 
 	return true;
 }
 
+/* fold sync_file [b] into [a] (or a copy of [b] if there is no [a] yet) */
+static int fence_merge(int a, int b)
+{
+	if (-1 == a)
+		return arcan_shmif_dupfd(b, -1, false);
+
+	struct sync_merge_data merge = {
+		.name = "arcan-release",
+		.fd2 = b
+	};
+
+	int rv = ioctl(a, SYNC_IOC_MERGE, &merge);
+	close(a);
+
+	return -1 == rv ? -1 : merge.fence;
+}
+
+int platform_video_release_fence(struct agp_vstore* vs, size_t* held)
+{
+/* everything that sampled the older buffers has been submitted by now */
+	struct dev_node* device = &nodes[0];
+	int fence = helper_fence_create(agp_env(), &device->eglenv, device->display);
+	if (-1 == fence)
+		return -1;
+
+	*held = 1;
+
+/* a buffer on a plane stays on screen until the next commit, the out fence of
+ * the last commit covers the one before it */
+	struct scanout_fb* ent = egl_dri.planes ? scanout_find(vs, false) : NULL;
+	if (!ent || !ent->fb)
+		return fence;
+
+	*held = 2;
+	for (size_t i = 0; i < MAX_DISPLAYS && -1 != fence; i++){
+		struct dispout* d = &displays[i];
+		if (d->state != DISP_MAPPED || d->device != device)
+			continue;
+
+		if (d->buffer.out_fence <= 0){
+			close(fence);
+			return -1;
+		}
+
+		fence = fence_merge(fence, d->buffer.out_fence);
+	}
+
+	return fence;
+}
+
+size_t platform_video_export_vstore(
+	struct agp_vstore* vs, struct agp_buffer_plane* planes, size_t n)
+{
+	struct dev_node* device = &nodes[0];
+	struct egl_env* egl = &device->eglenv;
+
+	if (!egl->create_image || !egl->query_image_format || !egl->export_dmabuf ||
+		!n || vs->txmapped != TXSTATE_TEX2D)
+		return 0;
+
+/* the image only lives long enough to get the planes out, the dma-buf:s keep
+ * the underlying texture storage referenced */
+	EGLImage img = egl->create_image(device->display, device->context,
+		EGL_GL_TEXTURE_2D_KHR, (EGLClientBuffer)(uintptr_t) agp_resolve_texid(vs), NULL);
+	if (!img){
+		debug_print("export:create_image failed (%s)", egl_errstr());
+		return 0;
+	}
+
+	int fourcc, np;
+	EGLuint64KHR mod;
+	if (!egl->query_image_format(device->display, img, &fourcc, &np, &mod) ||
+		np <= 0 || np > n || np > DMABUF_PLANES_LIMIT){
+		debug_print("export:bad_query:planes=%d", np);
+		egl->destroy_image(device->display, img);
+		return 0;
+	}
+
+	int fds[DMABUF_PLANES_LIMIT] = {-1, -1, -1, -1};
+	EGLint strides[DMABUF_PLANES_LIMIT];
+	EGLint offsets[DMABUF_PLANES_LIMIT];
+	bool ok = egl->export_dmabuf(device->display, img, fds, strides, offsets);
+	egl->destroy_image(device->display, img);
+
+	if (!ok){
+		debug_print("export:failed (%s)", egl_errstr());
+		for (size_t i = 0; i < np; i++)
+			if (-1 != fds[i])
+				close(fds[i]);
+		return 0;
+	}
+
+/* consumers rely on implicit synchronization on the buffer, that only covers
+ * work that has actually been submitted so flush (but don't wait) */
+	struct agp_fenv* env = agp_env();
+	if (env->fence_sync){
+		void* fence = env->fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		env->client_wait_sync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		env->delete_sync(fence);
+	}
+	else
+		env->flush();
+
+	for (size_t i = 0; i < np; i++){
+		planes[i] = (struct agp_buffer_plane){
+			.fd = fds[i],
+			.fence = -1,
+			.w = vs->w,
+			.h = vs->h,
+			.gbm = {
+				.format = fourcc,
+				.stride = strides[i],
+				.offset = offsets[i],
+				.mod_hi = (uint64_t) mod >> 32,
+				.mod_lo = (uint64_t) mod & 0xffffffff
+			}
+		};
+	}
+
+	debug_print("export:ok:planes=%d:fourcc=%x:mod=%"PRIx64, np, fourcc, (uint64_t) mod);
+	return np;
+}
+
 void setup_backlight_ledmap()
 {
 	if (pipe(egl_dri.ledpair) == -1)
@@ -997,23 +1356,136 @@ static bool realloc_buffers(struct dispout* d)
 
 static float deadline_for_display(struct dispout* d)
 {
-/* [FIX-VRR: the actual target including 'slew' rate stepping should be
- *           presented / calculated here based on the last synch, the
- *           target and the stepping rate                              ] */
+/* with adaptive synch the conductor paces the display from frame delivery,
+ * this is the longest the panel can wait before it needs a new frame.
+ * [FIX-VRR: 'slew' rate stepping towards the target is not done ] */
+	if (d->display.vrr.enabled)
+		return 1000.0f / d->display.vrr.min_hz;
+
 	return 1000.0f / (float)
 		(d->display.mode.vrefresh ? d->display.mode.vrefresh : 60.0);
 }
 
+static void fetch_edid(struct dispout* d);
+
+/*
+ * KMS has no property for the refresh range of a VRR capable panel, the EDID
+ * display range limits descriptor (0xfd) carries it for DisplayPort Adaptive
+ * Sync and FreeSync displays. The upper bound is capped to the current mode.
+ */
+static void vrr_range(struct dispout* d)
+{
+	float max_hz = d->display.mode.vrefresh ? d->display.mode.vrefresh : 60.0;
+	float min_hz = VRR_MIN_HZ;
+
+	fetch_edid(d);
+	uint8_t* edid = (uint8_t*) d->display.edid_blob;
+
+	for (size_t i = 0; edid && d->display.blob_sz >= 128 && i < 4; i++){
+		uint8_t* desc = &edid[54 + i * 18];
+		if (desc[0] || desc[1] || desc[2] || desc[3] != 0xfd)
+			continue;
+
+/* EDID 1.4 rate offsets for > 255Hz */
+		float edid_min = desc[5] + (desc[4] & 1 ? 255 : 0);
+		float edid_max = desc[6] + (desc[4] & 2 ? 255 : 0);
+		if (edid_min > 0 && edid_min < edid_max){
+			min_hz = edid_min;
+			if (edid_max < max_hz)
+				max_hz = edid_max;
+		}
+		break;
+	}
+
+	if (min_hz >= max_hz)
+		min_hz = max_hz * 0.5;
+
+	d->display.vrr.min_hz = min_hz;
+	d->display.vrr.max_hz = max_hz;
+}
+
+static void vrr_probe(struct dispout* d)
+{
+	uint64_t val = 0, pid;
+	d->display.vrr.capable =
+		lookup_drm_propval(d->device->disp_fd, d->display.con->connector_id,
+			DRM_MODE_OBJECT_CONNECTOR, "vrr_capable", &val, false) && val &&
+		lookup_drm_propval(d->device->disp_fd,
+			d->display.crtc, DRM_MODE_OBJECT_CRTC, "VRR_ENABLED", &pid, true);
+
+	vrr_range(d);
+}
+
+/*
+ * Toggle VRR_ENABLED on the crtc and switch the conductor clock of the display
+ * between the fixed refresh and the adaptive range. The atomic modeset path
+ * carries the property along with later modesets.
+ */
+static void vrr_set(struct dispout* d, float target)
+{
+	vrr_probe(d);
+	bool enable = fabs(target) > EPSILON && d->display.vrr.capable;
+	d->display.vrr.target = target;
+
+	if (!d->display.vrr.capable){
+		if (fabs(target) > EPSILON)
+			debug_print("(%d) vrr_ignored:not_capable", (int) d->id);
+		d->display.vrr.enabled = false;
+		return;
+	}
+
+	if (enable != d->display.vrr.enabled){
+		uint64_t pid;
+		if (!lookup_drm_propval(d->device->disp_fd, d->display.crtc,
+			DRM_MODE_OBJECT_CRTC, "VRR_ENABLED", &pid, true) ||
+			0 != drmModeObjectSetProperty(d->device->disp_fd,
+			d->display.crtc, DRM_MODE_OBJECT_CRTC, pid, enable)){
+			debug_print("(%d) vrr_ignored:set_property_failed", (int) d->id);
+			return;
+		}
+		d->display.vrr.enabled = enable;
+	}
+
+	float max_hz = d->display.vrr.max_hz;
+	if (target > d->display.vrr.min_hz && target < max_hz)
+		max_hz = target;
+
+	debug_print("(%d) vrr:%s range %.1f..%.1f", (int) d->id,
+		enable ? "on" : "off", d->display.vrr.min_hz, max_hz);
+
+	if (enable){
+		arcan_conductor_register_display(
+			d->device->card_id, d->id, SYNCH_DYNAMIC, max_hz, d->vid);
+		arcan_conductor_display_range(
+			d->device->card_id, d->id, d->display.vrr.min_hz, max_hz);
+	}
+	else
+		arcan_conductor_register_display(d->device->card_id,
+			d->id, SYNCH_STATIC, d->display.mode.vrefresh, d->vid);
+}
+
+static bool vrr_displays()
+{
+	for (size_t i = 0; i < MAX_DISPLAYS; i++)
+		if (displays[i].state == DISP_MAPPED && displays[i].display.vrr.enabled)
+			return true;
+
+	return false;
+}
+
 bool platform_video_set_mode(platform_display_id disp,
 	platform_mode_id mode, struct platform_mode_opts opts)
 {
 	struct dispout* d = get_display(disp);
 
 	if (!d || d->state != DISP_MAPPED || mode >= d->display.con->count_modes)
+		return false;
 
 	if (memcmp(&d->display.mode,
-		&d->display.con->modes[mode], sizeof(drmModeModeInfo)) == 0)
+		&d->display.con->modes[mode], sizeof(drmModeModeInfo)) == 0){
+		vrr_set(d, opts.vrr);
 		return true;
+	}
 
 /* [FIX: ATOMIC: we can test the modeset in order to fail here if there
  * should be insuficcient bandwidth, use DRM_STATE_TEST_ONLY */
@@ -1024,6 +1496,7 @@ bool platform_video_set_mode(platform_display_id disp,
 /* changes to the output format are reflected first in rebuild_buffers, if that
  * fails (e.g. the buffers do not fit the qualities of the display) it reverts
  * back to whatever OUTPUT_DEFAULT is set to rather than failing */
+	d->depth_auto = false;
 	switch(opts.depth){
 	case VSTORE_HINT_LODEF:
 		d->output_format = OUTPUT_LOW;
@@ -1039,15 +1512,7 @@ bool platform_video_set_mode(platform_display_id disp,
 		d->output_format = OUTPUT_DEFAULT;
 	}
 
-	uint64_t pid;
-	if (lookup_drm_propval(d->device->disp_fd,
-		d->display.crtc, DRM_MODE_OBJECT_CRTC, "type", &pid, true)){
-		debug_print("setting_vrr: %f", opts.vrr);
-		drmModeObjectSetProperty(d->device->disp_fd,
-			d->display.crtc, DRM_MODE_OBJECT_CRTC, pid, fabs(opts.vrr) > EPSILON);
-	}
-	else
-		debug_print("vrr_ignored:missing_vrr_property");
+	vrr_set(d, opts.vrr);
 
 /* ATOMIC test goes here */
 	debug_print("(%d) schedule mode switch to %zu * %zu", (int) disp,
@@ -1758,6 +2223,10 @@ static int setup_node_gbm(int devind,
 		drmGetCap(node->disp_fd, DRM_CAP_TIMESTAMP_MONOTONIC, &cap);
 	node->fb2_modifiers =
 		drmGetCap(node->disp_fd, DRM_CAP_ADDFB2_MODIFIERS, &cap);
+	node->async_flip =
+		0 == drmGetCap(node->disp_fd, DRM_CAP_ASYNC_PAGE_FLIP, &cap) && cap;
+	node->atomic_async = node->atomic &&
+		0 == drmGetCap(node->disp_fd, DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP, &cap) && cap;
 
 	debug_print("gbm, node in atomic mode: %s", node->atomic ? "yes" : "no");
 
@@ -2123,7 +2592,7 @@ static void release_dumb_fb(struct dispout* d)
 }
 
 static bool resolve_add(int fd, drmModeAtomicReqPtr dst, uint32_t obj_id,
-	drmModeObjectPropertiesPtr pptr, const char* name, uint32_t val)
+	drmModeObjectPropertiesPtr pptr, const char* name, uint64_t val)
 {
 	for (size_t i = 0; i < pptr->count_props; i++){
 		drmModePropertyPtr prop = drmModeGetProperty(fd, pptr->props[i]);
@@ -2141,9 +2610,16 @@ static bool resolve_add(int fd, drmModeAtomicReqPtr dst, uint32_t obj_id,
 	return false;
 }
 
+static bool planes_add(int fd,
+	drmModeAtomicReqPtr aptr, struct dispout* d, struct disp_plane* ov,
+	struct disp_plane* cursor);
+static void planes_latched(struct dispout* d);
+static void planes_reset(struct dispout* d);
+
 static bool atomic_set_mode(struct dispout* d, int fl)
 {
 	uint32_t mode;
+	uint32_t damage_blob = 0;
 	bool rv = false;
 	int fd = d->device->disp_fd;
 
@@ -2168,6 +2644,14 @@ static bool atomic_set_mode(struct dispout* d, int fl)
 	}
 	AADD(d->display.crtc, "MODE_ID", mode);
 	AADD(d->display.crtc, "ACTIVE", 1);
+	if (d->display.vrr.capable)
+		AADD(d->display.crtc, "VRR_ENABLED", d->display.vrr.enabled);
+
+/* the out fence is what client buffer releases wait for, it is optional */
+	int32_t out_fence = -1;
+	if (!resolve_add(fd, aptr, d->display.crtc,
+		pptr, "OUT_FENCE_PTR", (uint64_t)(uintptr_t) &out_fence))
+		verbose_print("(%d) atomic-modeset, no out-fence support", (int)d->id);
 	drmModeFreeObjectProperties(pptr);
 
 	pptr = drmModeObjectGetProperties(fd,
@@ -2208,18 +2692,39 @@ static bool atomic_set_mode(struct dispout* d, int fl)
 	AADD(d->display.plane_id, "FB_ID", fbid);
 	AADD(d->display.plane_id, "CRTC_ID", d->display.crtc);
 
-/* CRTC_OUT_FENCE_PTR to add a commit-fence that will be signalled when the
- * commit completes, which is different from the page-flip event */
+/* damage clips are only a hint and the property may be missing entirely */
+	if (d->damage.count && 0 == drmModeCreatePropertyBlob(fd, d->damage.rects,
+		sizeof(struct drm_mode_rect) * d->damage.count, &damage_blob)){
+		if (!resolve_add(fd, aptr,
+			d->display.plane_id, pptr, "FB_DAMAGE_CLIPS", damage_blob))
+			verbose_print("(%d) atomic-modeset, no damage-clips support", (int)d->id);
+	}
+
 #undef AADD
 
-/* resolve sym:id for the properties on the objects we need:
- */
+/* overlay and cursor planes go into the same commit, the assignment was
+ * verified with test-only commits against the primary in assign_planes */
+	bool planes = planes_add(fd, aptr, d, d->planes.overlay, &d->planes.cursor);
 
 	if (0 != drmModeAtomicCommit(fd,aptr, fl, NULL)){
+		if (planes){
+			TRACE_MARK_ONESHOT("egl-dri", "planes-commit", TRACE_SYS_WARN, d->id, 0, "");
+			debug_print("(%d) commit with planes failed, reverting", (int)d->id);
+			d->planes.fails++;
+			planes_reset(d);
+		}
 		goto cleanup;
 	}
-	else
+	else {
 		rv = true;
+		d->planes.dirty = false;
+		if (!(fl & DRM_MODE_PAGE_FLIP_EVENT))
+			planes_latched(d);
+
+		if (d->buffer.out_fence > 0)
+			close(d->buffer.out_fence);
+		d->buffer.out_fence = out_fence;
+	}
 
 cleanup:
 	if (d->buffer.synch_fence > 0){
@@ -2228,108 +2733,970 @@ cleanup:
 	}
 	drmModeAtomicFree(aptr);
 	drmModeDestroyPropertyBlob(fd, mode);
+	if (damage_blob)
+		drmModeDestroyPropertyBlob(fd, damage_blob);
+	d->damage.count = 0;
 
 	return rv;
 }
 
 /*
- * foreach plane in plane-resources(dev):
- *  if plane.crtc == display.crtc:
- *   find type
- *   if type is primary, set and true
+ * Plane assignment (video_device_planes)
+ *
+ * Each frame, before the world rendertarget is composed, the topmost part of
+ * the world pipeline is checked for objects that can be scanned out on an
+ * overlay plane as is: backed by an imported client buffer, opaque, not
+ * rotated or clipped, with the default shader and texture mapping, inside of
+ * the crtc and not covered by anything drawn after them. The mouse cursor
+ * goes on the cursor plane through a dumb buffer when the store has a local
+ * copy. Candidates are added one at a time through test-only commits against
+ * the current primary buffer, those that pass are flagged (FL_SCANOUT) so
+ * that composition leaves them out. The test results are reused for as long
+ * as the candidates keep their geometry and buffer format.
+ *
+ * Only displays that are the sole mapping of WORLDID with a 1:1 mapping are
+ * considered, and overlays are assumed to stack above the primary.
  */
-static bool find_plane(struct dispout* d)
+static bool plane_referenced(uint32_t fb)
 {
-	drmModePlaneResPtr plane_res = drmModeGetPlaneResources(d->device->disp_fd);
-	d->display.plane_id = 0;
-	if (!plane_res){
-		debug_print("(%d) atomic-modeset, couldn't find plane on device",(int)d->id);
-		return false;
-	}
-	for (size_t i = 0; i < plane_res->count_planes; i++){
-		drmModePlanePtr plane =
-			drmModeGetPlane(d->device->disp_fd, plane_res->planes[i]);
-		if (!plane){
-			debug_print("(%d) atomic-modeset, couldn't get plane (%zu)",(int)d->id,i);
-			return false;
-		}
-		uint32_t crtcs = plane->possible_crtcs;
-		drmModeFreePlane(plane);
-		if (0 == (crtcs & (1 << d->display.crtc_index)))
-			continue;
-
-		uint64_t val;
-		if (!lookup_drm_propval(d->device->disp_fd,
-			plane_res->planes[i], DRM_MODE_OBJECT_PLANE, "type", &val, false))
+	for (size_t i = 0; fb && i < MAX_DISPLAYS; i++){
+		if (displays[i].state == DISP_UNUSED)
 			continue;
 
-/* NOTE: There are additional constraints for PRIMARY planes that don't
- * apply to OVERLAY planes - we can't do scaling, plane size must cover
- * all of CRTC etc. If we use this wrong, check dmesg for something like
- * 'DRM: plane must cover entire CRTC' */
-		if (val == DRM_PLANE_TYPE_PRIMARY){
-			d->display.plane_id = plane_res->planes[i];
-			break;
+		for (size_t j = 0; j < displays[i].planes.n_overlay; j++){
+			struct disp_plane* p = &displays[i].planes.overlay[j];
+			if (p->fb == fb || p->shown == fb)
+				return true;
 		}
 	}
-	drmModeFreePlaneResources(plane_res);
-	return d->display.plane_id != 0;
+
+	return false;
 }
 
-/*
- * sweep all displays, and see if the referenced CRTC id is in use.
- */
-static struct dispout* crtc_used(struct dev_node* dev, int crtc)
+static void scanout_release(uint32_t fb, struct gbm_bo* bo)
 {
-	for (size_t i = 0; i < MAX_DISPLAYS; i++){
-		if (displays[i].state == DISP_UNUSED)
-			continue;
+	if (fb)
+		drmModeRmFB(nodes[0].disp_fd, fb);
 
-		if (displays[i].device != dev)
-			continue;
+	if (bo)
+		gbm_bo_destroy(bo);
+}
 
-		if (displays[i].display.crtc == crtc)
-			return &displays[i];
+/* removing a framebuffer disables any plane it is on, so defer that until no
+ * display has it pending or latched */
+static void scanout_retire(uint32_t fb, struct gbm_bo* bo)
+{
+	if (plane_referenced(fb) && egl_dri.n_retired < SCANOUT_FB_LIMIT){
+		egl_dri.retired[egl_dri.n_retired].fb = fb;
+		egl_dri.retired[egl_dri.n_retired].bo = bo;
+		egl_dri.n_retired++;
+		return;
 	}
 
-	return NULL;
+	scanout_release(fb, bo);
 }
 
-static int setup_kms(struct dispout* d, int conn_id, size_t w, size_t h)
+static void scanout_gc()
 {
-	SET_SEGV_MSG("egl-dri(), enumerating connectors on device failed.\n");
-	drmModeRes* res;
+	for (size_t i = 0; i < egl_dri.n_retired;){
+		if (plane_referenced(egl_dri.retired[i].fb)){
+			i++;
+			continue;
+		}
 
-retry:
-	res = drmModeGetResources(d->device->disp_fd);
-	if (!res){
-		debug_print("(%d) setup_kms, couldn't get resources (fd:%d)",
-			(int)d->id, (int)d->device->disp_fd);
-		return -1;
+		scanout_release(egl_dri.retired[i].fb, egl_dri.retired[i].bo);
+		egl_dri.retired[i] = egl_dri.retired[--egl_dri.n_retired];
 	}
+}
 
-/* for the default case we don't have a connector, but for
- * newly detected displays we store / reserve */
-	if (!d->display.con)
-	for (int i = 0; i < res->count_connectors; i++){
-		d->display.con = drmModeGetConnector(d->device->disp_fd, res->connectors[i]);
+static struct scanout_fb* scanout_find(struct agp_vstore* vs, bool alloc)
+{
+	struct scanout_fb* slot = NULL;
 
-		if (d->display.con->connection == DRM_MODE_CONNECTED &&
-			(conn_id == -1 || conn_id == d->display.con->connector_id))
-			break;
+	for (size_t i = 0; i < SCANOUT_FB_LIMIT; i++){
+		if (egl_dri.scanout[i].vs == vs)
+			return &egl_dri.scanout[i];
 
-		drmModeFreeConnector(d->display.con);
-		d->display.con = NULL;
+		if (!slot && !egl_dri.scanout[i].vs)
+			slot = &egl_dri.scanout[i];
 	}
 
-/*
- * No connector in place, set a retry- timer or give up. The other
- * option would be to switch over to display/headless mode
- */
-	if (!d->display.con){
-		drmModeFreeResources(res);
+	if (!alloc || !slot)
+		return NULL;
 
-/* only wait for the first display */
+	*slot = (struct scanout_fb){
+		.vs = vs
+	};
+	return slot;
+}
+
+static void scanout_import(
+	struct agp_vstore* vs, struct agp_buffer_plane* planes, size_t n_planes)
+{
+	struct scanout_fb* ent = scanout_find(vs, false);
+	if (!ent || !n_planes || n_planes > 4 ||
+		!nodes[0].atomic || nodes[0].buftype != BUF_GBM)
+		return;
+
+	struct gbm_bo* bo = NULL;
+	uint32_t fb = 0;
+	uint64_t mod =
+		((uint64_t)planes[0].gbm.mod_hi << 32) | (uint64_t)planes[0].gbm.mod_lo;
+
+#ifdef GBM_BO_IMPORT_FD_MODIFIER
+	struct gbm_import_fd_modifier_data data = {
+		.width = planes[0].w,
+		.height = planes[0].h,
+		.format = planes[0].gbm.format,
+		.num_fds = n_planes,
+		.modifier = mod
+	};
+
+	for (size_t i = 0; i < n_planes; i++){
+		data.fds[i] = planes[i].fd;
+		data.strides[i] = planes[i].gbm.stride;
+		data.offsets[i] = planes[i].gbm.offset;
+	}
+
+	bo = gbm_bo_import(nodes[0].buffer.gbm,
+		GBM_BO_IMPORT_FD_MODIFIER, &data, GBM_BO_USE_SCANOUT);
+#endif
+
+	if (bo){
+		uint32_t handles[4] = {0}, strides[4] = {0}, offsets[4] = {0};
+		uint64_t mods[4] = {0};
+
+		for (size_t i = 0; i < n_planes; i++){
+			handles[i] = gbm_bo_get_handle_for_plane(bo, i).u32;
+			strides[i] = planes[i].gbm.stride;
+			offsets[i] = planes[i].gbm.offset;
+			mods[i] = mod;
+		}
+
+		int rv;
+		if (mod != DRM_FORMAT_MOD_INVALID && nodes[0].fb2_modifiers)
+			rv = drmModeAddFB2WithModifiers(nodes[0].disp_fd,
+				planes[0].w, planes[0].h, planes[0].gbm.format,
+				handles, strides, offsets, mods, &fb, DRM_MODE_FB_MODIFIERS);
+		else
+			rv = drmModeAddFB2(nodes[0].disp_fd, planes[0].w, planes[0].h,
+				planes[0].gbm.format, handles, strides, offsets, &fb, 0);
+
+		if (rv){
+			TRACE_MARK_ONESHOT("egl-dri", "scanout-addfb", TRACE_SYS_WARN, 0, 0, "");
+			gbm_bo_destroy(bo);
+			bo = NULL;
+			fb = 0;
+		}
+	}
+
+	scanout_retire(ent->fb, ent->bo);
+	ent->bo = bo;
+	ent->fb = fb;
+	ent->format = planes[0].gbm.format;
+	ent->img = 0;
+
+	if (ent->fence > 0)
+		close(ent->fence);
+	ent->fence = 0;
+	for (size_t i = 0; fb && i < n_planes && !ent->fence; i++)
+		if (planes[i].fence > 0)
+			ent->fence = arcan_shmif_dupfd(planes[i].fence, -1, false);
+}
+
+static int scanout_fence(uint32_t fb)
+{
+	for (size_t i = 0; fb && i < SCANOUT_FB_LIMIT; i++)
+		if (egl_dri.scanout[i].vs && egl_dri.scanout[i].fb == fb)
+			return egl_dri.scanout[i].fence;
+
+	return 0;
+}
+
+static void scanout_bind(struct agp_vstore* vs, uintptr_t img)
+{
+	struct scanout_fb* ent = scanout_find(vs, false);
+	if (ent)
+		ent->img = img;
+}
+
+static void scanout_drop(struct agp_vstore* vs)
+{
+	struct scanout_fb* ent = scanout_find(vs, false);
+	if (!ent)
+		return;
+
+	scanout_retire(ent->fb, ent->bo);
+	if (ent->fence > 0)
+		close(ent->fence);
+	*ent = (struct scanout_fb){};
+}
+
+static bool fourcc_opaque(uint32_t fourcc)
+{
+	switch (fourcc){
+	case DRM_FORMAT_XRGB8888:
+	case DRM_FORMAT_XBGR8888:
+	case DRM_FORMAT_RGBX8888:
+	case DRM_FORMAT_BGRX8888:
+	case DRM_FORMAT_XRGB2101010:
+	case DRM_FORMAT_XBGR2101010:
+	case DRM_FORMAT_RGB565:
+	case DRM_FORMAT_BGR565:
+	case DRM_FORMAT_NV12:
+	case DRM_FORMAT_NV21:
+	case DRM_FORMAT_YUV420:
+	case DRM_FORMAT_P010:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* a plane can only be used by one crtc at a time */
+static bool plane_claimed(uint32_t id)
+{
+	for (size_t i = 0; i < MAX_DISPLAYS; i++){
+		if (displays[i].state == DISP_UNUSED)
+			continue;
+
+		if (displays[i].display.plane_id == id ||
+			displays[i].planes.cursor.id == id)
+			return true;
+
+		for (size_t j = 0; j < displays[i].planes.n_overlay; j++)
+			if (displays[i].planes.overlay[j].id == id)
+				return true;
+	}
+
+	return false;
+}
+
+static void find_planes(struct dispout* d, drmModePlaneResPtr plane_res)
+{
+	if (d->planes.n_overlay || d->planes.cursor.id)
+		return;
+
+	for (size_t i = 0; i < plane_res->count_planes; i++){
+		uint32_t id = plane_res->planes[i];
+		drmModePlanePtr plane = drmModeGetPlane(d->device->disp_fd, id);
+		if (!plane)
+			continue;
+
+		uint32_t crtcs = plane->possible_crtcs;
+		drmModeFreePlane(plane);
+		if (0 == (crtcs & (1 << d->display.crtc_index)) || plane_claimed(id))
+			continue;
+
+		uint64_t val;
+		if (!lookup_drm_propval(d->device->disp_fd,
+			id, DRM_MODE_OBJECT_PLANE, "type", &val, false))
+			continue;
+
+		if (val == DRM_PLANE_TYPE_OVERLAY &&
+			d->planes.n_overlay < DISPLAY_PLANE_LIMIT){
+			d->planes.overlay[d->planes.n_overlay++] = (struct disp_plane){.id = id};
+		}
+		else if (val == DRM_PLANE_TYPE_CURSOR && !d->planes.cursor.id){
+			d->planes.cursor = (struct disp_plane){.id = id};
+		}
+	}
+
+	debug_print("(%d) %zu overlay planes, cursor plane: %d",
+		(int)d->id, d->planes.n_overlay, (int)(d->planes.cursor.id != 0));
+}
+
+static bool plane_props(int fd,
+	drmModeAtomicReqPtr aptr, struct dispout* d, struct disp_plane* p)
+{
+	drmModeObjectPropertiesPtr pptr =
+		drmModeObjectGetProperties(fd, p->id, DRM_MODE_OBJECT_PLANE);
+	if (!pptr)
+		return false;
+
+	bool ok;
+	if (p->fb){
+		ok =
+			resolve_add(fd, aptr, p->id, pptr, "FB_ID", p->fb) &&
+			resolve_add(fd, aptr, p->id, pptr, "CRTC_ID", d->display.crtc) &&
+			resolve_add(fd, aptr, p->id, pptr, "SRC_X", 0) &&
+			resolve_add(fd, aptr, p->id, pptr, "SRC_Y", 0) &&
+			resolve_add(fd, aptr, p->id, pptr, "SRC_W", (uint64_t)p->src_w << 16) &&
+			resolve_add(fd, aptr, p->id, pptr, "SRC_H", (uint64_t)p->src_h << 16) &&
+			resolve_add(fd, aptr, p->id, pptr, "CRTC_X", (uint64_t)(int64_t)p->x) &&
+			resolve_add(fd, aptr, p->id, pptr, "CRTC_Y", (uint64_t)(int64_t)p->y) &&
+			resolve_add(fd, aptr, p->id, pptr, "CRTC_W", p->w) &&
+			resolve_add(fd, aptr, p->id, pptr, "CRTC_H", p->h);
+
+/* the cursor is ours, client buffers carry their acquire fence */
+		int fence = scanout_fence(p->fb);
+		if (ok && fence > 0)
+			resolve_add(fd, aptr, p->id, pptr, "IN_FENCE_FD", fence);
+	}
+	else {
+		ok =
+			resolve_add(fd, aptr, p->id, pptr, "FB_ID", 0) &&
+			resolve_add(fd, aptr, p->id, pptr, "CRTC_ID", 0);
+	}
+
+	drmModeFreeObjectProperties(pptr);
+	return ok;
+}
+
+/* add the planes that are set or need to be turned off, true if any */
+static bool planes_add(int fd,
+	drmModeAtomicReqPtr aptr, struct dispout* d, struct disp_plane* ov,
+	struct disp_plane* cursor)
+{
+	bool any = false;
+
+	for (size_t i = 0; i < d->planes.n_overlay; i++){
+		if (ov[i].fb || ov[i].shown)
+			any |= plane_props(fd, aptr, d, &ov[i]);
+	}
+
+	if (cursor->id && (cursor->fb || cursor->shown))
+		any |= plane_props(fd, aptr, d, cursor);
+
+	return any;
+}
+
+static bool planes_test(
+	struct dispout* d, struct disp_plane* ov, struct disp_plane* cursor)
+{
+	int fd = d->device->disp_fd;
+	drmModeAtomicReqPtr aptr = drmModeAtomicAlloc();
+	if (!aptr)
+		return false;
+
+	struct disp_plane primary = {
+		.id = d->display.plane_id,
+		.fb = d->buffer.cur_fb,
+		.w = d->display.mode.hdisplay,
+		.h = d->display.mode.vdisplay,
+		.src_w = d->display.mode.hdisplay,
+		.src_h = d->display.mode.vdisplay
+	};
+
+	bool ok = plane_props(fd, aptr, d, &primary);
+	planes_add(fd, aptr, d, ov, cursor);
+
+	ok = ok && 0 == drmModeAtomicCommit(fd, aptr, DRM_MODE_ATOMIC_TEST_ONLY, NULL);
+	drmModeAtomicFree(aptr);
+	return ok;
+}
+
+static void cursor_free(struct dispout* d)
+{
+	int fd = d->device->disp_fd;
+
+	if (d->planes.cursor_buf.fb)
+		drmModeRmFB(fd, d->planes.cursor_buf.fb);
+
+	if (d->planes.cursor_buf.map)
+		munmap(d->planes.cursor_buf.map, d->planes.cursor_buf.sz);
+
+	if (d->planes.cursor_buf.handle){
+		struct drm_mode_destroy_dumb dreq = {
+			.handle = d->planes.cursor_buf.handle
+		};
+		drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+	}
+
+	d->planes.cursor_buf = (typeof(d->planes.cursor_buf)){};
+}
+
+static bool cursor_alloc(struct dispout* d)
+{
+	int fd = d->device->disp_fd;
+	uint64_t cw = 64, ch = 64;
+	drmGetCap(fd, DRM_CAP_CURSOR_WIDTH, &cw);
+	drmGetCap(fd, DRM_CAP_CURSOR_HEIGHT, &ch);
+
+	struct drm_mode_create_dumb create = {
+		.width = cw,
+		.height = ch,
+		.bpp = 32
+	};
+
+	if (drmIoctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, &create) < 0)
+		goto fail;
+
+	d->planes.cursor_buf.handle = create.handle;
+	d->planes.cursor_buf.pitch = create.pitch;
+	d->planes.cursor_buf.sz = create.size;
+	d->planes.cursor_buf.w = cw;
+	d->planes.cursor_buf.h = ch;
+
+	struct drm_mode_map_dumb mreq = {
+		.handle = create.handle
+	};
+	if (drmIoctl(fd, DRM_IOCTL_MODE_MAP_DUMB, &mreq) < 0)
+		goto fail;
+
+	uint8_t* map = mmap(0,
+		create.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, mreq.offset);
+	if (MAP_FAILED == map)
+		goto fail;
+	d->planes.cursor_buf.map = map;
+
+	uint32_t handles[4] = {create.handle};
+	uint32_t pitches[4] = {create.pitch};
+	uint32_t offsets[4] = {0};
+	if (drmModeAddFB2(fd, cw, ch, DRM_FORMAT_ARGB8888,
+		handles, pitches, offsets, &d->planes.cursor_buf.fb, 0))
+		goto fail;
+
+	return true;
+
+fail:
+	debug_print("(%d) couldn't setup cursor plane buffer", (int)d->id);
+	cursor_free(d);
+	d->planes.cursor.id = 0;
+	return false;
+}
+
+/* raster the cursor into the plane buffer whenever the source changes, the
+ * buffer is premultiplied ARGB8888 and the cursor is sampled to its size */
+static void cursor_prepare(struct dispout* d, struct disp_plane* out)
+{
+	struct agp_vstore* vs = arcan_video_display.cursor.vstore;
+	size_t cw = arcan_video_display.cursor.w;
+	size_t ch = arcan_video_display.cursor.h;
+
+	if (!out->id || !vs || !vs->vinf.text.raw || !vs->w || !vs->h || !cw || !ch)
+		return;
+
+	if (!d->planes.cursor_buf.fb && !cursor_alloc(d))
+		return;
+
+	if (cw > d->planes.cursor_buf.w || ch > d->planes.cursor_buf.h)
+		return;
+
+	if (d->planes.cursor_buf.src != vs ||
+		d->planes.cursor_buf.src_seq != vs->update_seq ||
+		d->planes.cursor_buf.src_w != cw || d->planes.cursor_buf.src_h != ch){
+		memset(d->planes.cursor_buf.map, '\0', d->planes.cursor_buf.sz);
+
+		for (size_t y = 0; y < ch; y++){
+			uint32_t* dst = (uint32_t*)
+				&d->planes.cursor_buf.map[y * d->planes.cursor_buf.pitch];
+			av_pixel* src = &vs->vinf.text.raw[(y * vs->h / ch) * vs->w];
+
+			for (size_t x = 0; x < cw; x++){
+				uint8_t r, g, b, a;
+				RGBA_DECOMP(src[x * vs->w / cw], &r, &g, &b, &a);
+				dst[x] =
+					((uint32_t)a << 24) |
+					((uint32_t)(r * a / 255) << 16) |
+					((uint32_t)(g * a / 255) << 8) |
+					((uint32_t)(b * a / 255));
+			}
+		}
+
+		d->planes.cursor_buf.src = vs;
+		d->planes.cursor_buf.src_seq = vs->update_seq;
+		d->planes.cursor_buf.src_w = cw;
+		d->planes.cursor_buf.src_h = ch;
+		d->planes.dirty = true;
+
+		drmModeClip clip = {
+			.x2 = d->planes.cursor_buf.w,
+			.y2 = d->planes.cursor_buf.h
+		};
+		drmModeDirtyFB(d->device->disp_fd, d->planes.cursor_buf.fb, &clip, 1);
+	}
+
+	out->fb = d->planes.cursor_buf.fb;
+	out->x = arcan_video_display.cursor.x;
+	out->y = arcan_video_display.cursor.y;
+	out->w = out->src_w = d->planes.cursor_buf.w;
+	out->h = out->src_h = d->planes.cursor_buf.h;
+}
+
+/* world maps 1:1 to the crtc and no other display shows it */
+static bool planes_eligible(struct dispout* d)
+{
+	struct agp_vstore* world = arcan_vint_world();
+
+	if (!d->device->atomic || d->vid != ARCAN_VIDEO_WORLDID ||
+		d->device != &nodes[0] ||
+		d->display.dpms != ADPMS_ON || d->buffer.dumb.enabled ||
+		!d->buffer.cur_fb || !d->display.plane_id || !world ||
+		d->planes.fails >= PLANE_FAIL_LIMIT ||
+		d->dispx || d->dispy ||
+		d->dispw != d->display.mode.hdisplay ||
+		d->disph != d->display.mode.vdisplay ||
+		world->w != d->dispw || world->h != d->disph ||
+		memcmp(d->txcos, arcan_video_display.mirror_txcos, sizeof(float) * 8))
+		return false;
+
+	for (size_t i = 0; i < MAX_DISPLAYS; i++){
+		if (&displays[i] != d &&
+			displays[i].state == DISP_MAPPED && displays[i].vid == ARCAN_VIDEO_WORLDID)
+			return false;
+	}
+
+	return true;
+}
+
+struct plane_cand {
+	arcan_vobject* vobj;
+	struct scanout_fb* sfb;
+	float box[4];
+	bool ok;
+};
+
+static bool plane_candidate(struct dispout* d,
+	arcan_vobject* elem, surface_properties* props, struct plane_cand* out)
+{
+	struct agp_vstore* vs = elem->vstore;
+
+	if (!vs || vs->txmapped != TXSTATE_TEX2D || !vs->vinf.text.tag ||
+		elem->frameset || elem->shape || elem->glyphs || elem->txcos ||
+		((elem->mask & MASK_MAPPING) && elem->parent && elem->parent->txcos) ||
+		elem->clip != ARCAN_CLIP_OFF ||
+		(elem->program && elem->program != agp_default_shader(BASIC_2D)) ||
+		fabsf(props->rotation.roll) > EPSILON || props->opa < 1.0 - EPSILON)
+		return false;
+
+/* whole pixels, inside of the crtc */
+	float* box = out->box;
+	if (box[0] < 0 || box[1] < 0 ||
+		box[2] > d->display.mode.hdisplay || box[3] > d->display.mode.vdisplay ||
+		box[2] - box[0] < 1.0 || box[3] - box[1] < 1.0 ||
+		fabsf(box[0] - roundf(box[0])) > EPSILON ||
+		fabsf(box[1] - roundf(box[1])) > EPSILON)
+		return false;
+
+/* otherwise a fit, mark the store so the next buffer from the client is
+ * also imported as a framebuffer */
+	struct scanout_fb* sfb = scanout_find(vs, true);
+	if (!sfb || !sfb->fb || sfb->img != vs->vinf.text.tag)
+		return false;
+
+	if (elem->blendmode != BLEND_NONE && !fourcc_opaque(sfb->format))
+		return false;
+
+	out->sfb = sfb;
+	return true;
+}
+
+static bool box_overlap(float* a, float* b)
+{
+	return !(a[2] <= b[0] || a[0] >= b[2] || a[3] <= b[1] || a[1] >= b[3]);
+}
+
+/* sweep the world pipeline, retain the topmost visible objects and return
+ * the ones that are on top of everything else they overlap, topmost first */
+static size_t plane_candidates(struct dispout* d,
+	struct rendertarget* tgt, float fract, bool cursor_plane,
+	struct plane_cand* out, size_t lim)
+{
+	static struct plane_cand top[PLANE_SCAN_LIMIT];
+	size_t head = 0, count = 0;
+
+	for (arcan_vobject_litem* cur = tgt->first; cur; cur = cur->next){
+		arcan_vobject* elem = cur->elem;
+		if (elem->order < 0 || elem->order < tgt->min_order || elem == tgt->color)
+			continue;
+
+		if (elem->order > tgt->max_order)
+			break;
+
+		surface_properties props;
+		arcan_resolve_vidprop(elem, fract, &props);
+		if (props.opa <= EPSILON)
+			continue;
+
+		struct plane_cand* slot = &top[head];
+		head = (head + 1) % PLANE_SCAN_LIMIT;
+		if (count < PLANE_SCAN_LIMIT)
+			count++;
+
+		*slot = (struct plane_cand){.vobj = elem};
+
+/* rotated objects are covered by the circumscribed box */
+		float w = fabsf((float)elem->origw * props.scale.x);
+		float h = fabsf((float)elem->origh * props.scale.y);
+		float pad = 0;
+		if (fabsf(props.rotation.roll) > EPSILON)
+			pad = 0.5 * (sqrtf(w * w + h * h) - fminf(w, h));
+
+		slot->box[0] = props.position.x - pad;
+		slot->box[1] = props.position.y - pad;
+		slot->box[2] = props.position.x + w + pad;
+		slot->box[3] = props.position.y + h + pad;
+		slot->ok = plane_candidate(d, elem, &props, slot);
+	}
+
+	float cbox[4] = {
+		arcan_video_display.cursor.x,
+		arcan_video_display.cursor.y,
+		arcan_video_display.cursor.x + arcan_video_display.cursor.w,
+		arcan_video_display.cursor.y + arcan_video_display.cursor.h
+	};
+	bool gl_cursor = arcan_video_display.cursor.vstore && !cursor_plane;
+
+	size_t n = 0;
+	for (size_t i = 0; i < count && n < lim; i++){
+		struct plane_cand* cand = &top[(head + PLANE_SCAN_LIMIT - 1 - i) % PLANE_SCAN_LIMIT];
+		if (!cand->ok || (gl_cursor && box_overlap(cand->box, cbox)))
+			continue;
+
+		bool covered = false;
+		for (size_t j = 0; j < i && !covered; j++){
+			struct plane_cand* above = &top[(head + PLANE_SCAN_LIMIT - 1 - j) % PLANE_SCAN_LIMIT];
+			covered = box_overlap(cand->box, above->box);
+		}
+
+		if (!covered)
+			out[n++] = *cand;
+	}
+
+	return n;
+}
+
+static uint64_t planes_key(struct plane_cand* cand, size_t n, struct disp_plane* cursor)
+{
+	uint64_t key = 0xcbf29ce484222325ULL;
+#define FNV(X) key = (key ^ (uint64_t)(X)) * 0x100000001b3ULL
+
+	for (size_t i = 0; i < n; i++){
+		FNV(cand[i].vobj->cellid);
+		FNV((int64_t) cand[i].box[0]);
+		FNV((int64_t) cand[i].box[1]);
+		FNV((int64_t) cand[i].box[2]);
+		FNV((int64_t) cand[i].box[3]);
+		FNV(cand[i].sfb->format);
+		FNV(cand[i].vobj->vstore->w);
+		FNV(cand[i].vobj->vstore->h);
+	}
+
+	FNV(cursor->fb);
+	FNV(cursor->w);
+	FNV(cursor->h);
+#undef FNV
+	return key;
+}
+
+static void plane_set(struct disp_plane* p, struct plane_cand* cand)
+{
+	p->fb = cand->sfb->fb;
+	p->vid = cand->vobj->cellid;
+	p->x = roundf(cand->box[0]);
+	p->y = roundf(cand->box[1]);
+	p->w = roundf(cand->box[2] - cand->box[0]);
+	p->h = roundf(cand->box[3] - cand->box[1]);
+	p->src_w = cand->vobj->vstore->w;
+	p->src_h = cand->vobj->vstore->h;
+}
+
+static void planes_apply(
+	struct dispout* d, struct disp_plane* ov, struct disp_plane* cursor)
+{
+	bool moved = false;
+
+	for (size_t i = 0; i < d->planes.n_overlay; i++){
+		struct disp_plane* cur = &d->planes.overlay[i];
+		if (cur->vid != ov[i].vid){
+			arcan_vobject* vobj = arcan_video_getobject(cur->vid);
+			if (cur->fb && vobj)
+				FL_CLEAR(vobj, FL_SCANOUT);
+			moved = true;
+		}
+
+		if (memcmp(cur, &ov[i], sizeof(struct disp_plane)) != 0)
+			d->planes.dirty = true;
+	}
+
+	for (size_t i = 0; i < d->planes.n_overlay; i++){
+		if (!ov[i].fb)
+			continue;
+
+		arcan_vobject* vobj = arcan_video_getobject(ov[i].vid);
+		if (vobj)
+			FL_SET(vobj, FL_SCANOUT);
+	}
+
+	if (memcmp(&d->planes.cursor, cursor, sizeof(struct disp_plane)) != 0)
+		d->planes.dirty = true;
+
+	memcpy(d->planes.overlay, ov, sizeof(struct disp_plane) * d->planes.n_overlay);
+	d->planes.cursor = *cursor;
+
+/* objects moving between planes and composition need the world redrawn */
+	if (moved)
+		FLAG_DIRTY(NULL);
+}
+
+static void assign_planes(struct dispout* d, float fract)
+{
+	if (!d->planes.n_overlay && !d->planes.cursor.id)
+		return;
+
+	struct disp_plane ov[DISPLAY_PLANE_LIMIT];
+	for (size_t i = 0; i < d->planes.n_overlay; i++)
+		ov[i] = (struct disp_plane){
+			.id = d->planes.overlay[i].id,
+			.shown = d->planes.overlay[i].shown
+		};
+
+	struct disp_plane cursor = {
+		.id = d->planes.cursor.id,
+		.shown = d->planes.cursor.shown
+	};
+
+	struct rendertarget* tgt =
+		arcan_vint_findrt(arcan_video_getobject(ARCAN_VIDEO_WORLDID));
+
+	if (!tgt || !planes_eligible(d)){
+		planes_apply(d, ov, &cursor);
+		d->planes.key = 0;
+		return;
+	}
+
+	cursor_prepare(d, &cursor);
+
+	struct plane_cand cand[DISPLAY_PLANE_LIMIT];
+	size_t n_cand = plane_candidates(d,
+		tgt, fract, cursor.fb != 0, cand, d->planes.n_overlay);
+
+/* same candidates as the last time, reuse what passed then */
+	uint64_t key = planes_key(cand, n_cand, &cursor);
+	if (key == d->planes.key){
+		if (!d->planes.cursor_ok)
+			cursor.fb = 0;
+
+		for (size_t i = 0, slot = 0; i < n_cand; i++)
+			if (d->planes.accept & (1 << i))
+				plane_set(&ov[slot++], &cand[i]);
+
+		planes_apply(d, ov, &cursor);
+		return;
+	}
+
+	TRACE_MARK_ONESHOT("egl-dri", "planes-test", TRACE_SYS_DEFAULT, d->id, n_cand, "");
+	d->planes.key = key;
+	d->planes.accept = 0;
+	d->planes.cursor_ok = true;
+
+	if (cursor.fb && !planes_test(d, ov, &cursor)){
+		cursor.fb = 0;
+		d->planes.cursor_ok = false;
+	}
+
+	for (size_t i = 0, slot = 0; i < n_cand; i++){
+		plane_set(&ov[slot], &cand[i]);
+
+		if (planes_test(d, ov, &cursor)){
+			d->planes.accept |= 1 << i;
+			slot++;
+		}
+		else {
+			ov[slot].fb = 0;
+			ov[slot].vid = 0;
+		}
+	}
+
+	planes_apply(d, ov, &cursor);
+}
+
+/* a commit has completed, its framebuffers are now the ones on screen */
+static void planes_latched(struct dispout* d)
+{
+	for (size_t i = 0; i < d->planes.n_overlay; i++)
+		d->planes.overlay[i].shown = d->planes.overlay[i].fb;
+	d->planes.cursor.shown = d->planes.cursor.fb;
+
+	scanout_gc();
+}
+
+/* drop all assignments, the next commit turns the planes off */
+static void planes_reset(struct dispout* d)
+{
+	struct disp_plane ov[DISPLAY_PLANE_LIMIT];
+	for (size_t i = 0; i < d->planes.n_overlay; i++)
+		ov[i] = (struct disp_plane){
+			.id = d->planes.overlay[i].id,
+			.shown = d->planes.overlay[i].shown
+		};
+
+	struct disp_plane cursor = {
+		.id = d->planes.cursor.id,
+		.shown = d->planes.cursor.shown
+	};
+
+	planes_apply(d, ov, &cursor);
+	d->planes.key = 0;
+}
+
+static void planes_free(struct dispout* d)
+{
+	planes_reset(d);
+	cursor_free(d);
+	d->planes = (typeof(d->planes)){};
+	scanout_gc();
+}
+
+/*
+ * foreach plane in plane-resources(dev):
+ *  if plane.crtc == display.crtc:
+ *   find type
+ *   if type is primary, set and true
+ */
+static bool find_plane(struct dispout* d)
+{
+	drmModePlaneResPtr plane_res = drmModeGetPlaneResources(d->device->disp_fd);
+	d->display.plane_id = 0;
+	if (!plane_res){
+		debug_print("(%d) atomic-modeset, couldn't find plane on device",(int)d->id);
+		return false;
+	}
+	for (size_t i = 0; i < plane_res->count_planes; i++){
+		drmModePlanePtr plane =
+			drmModeGetPlane(d->device->disp_fd, plane_res->planes[i]);
+		if (!plane){
+			debug_print("(%d) atomic-modeset, couldn't get plane (%zu)",(int)d->id,i);
+			return false;
+		}
+		uint32_t crtcs = plane->possible_crtcs;
+		drmModeFreePlane(plane);
+		if (0 == (crtcs & (1 << d->display.crtc_index)))
+			continue;
+
+		uint64_t val;
+		if (!lookup_drm_propval(d->device->disp_fd,
+			plane_res->planes[i], DRM_MODE_OBJECT_PLANE, "type", &val, false))
+			continue;
+
+/* NOTE: There are additional constraints for PRIMARY planes that don't
+ * apply to OVERLAY planes - we can't do scaling, plane size must cover
+ * all of CRTC etc. If we use this wrong, check dmesg for something like
+ * 'DRM: plane must cover entire CRTC' */
+		if (val == DRM_PLANE_TYPE_PRIMARY){
+			d->display.plane_id = plane_res->planes[i];
+			break;
+		}
+	}
+	if (d->display.plane_id && egl_dri.planes)
+		find_planes(d, plane_res);
+
+	drmModeFreePlaneResources(plane_res);
+	return d->display.plane_id != 0;
+}
+
+/*
+ * What the overlay planes of the displays that take part in plane assignment
+ * accept, from their IN_FORMATS blob. Planes without one only accept implicit
+ * modifiers and are left out as there is no layout to tell producers about.
+ */
+size_t platform_video_scanout_formats(
+	uint32_t* formats, uint64_t* modifiers, size_t n)
+{
+	size_t count = 0;
+	if (!egl_dri.planes)
+		return 0;
+
+	for (size_t i = 0; i < MAX_DISPLAYS && count < n; i++){
+		struct dispout* d = &displays[i];
+		if (d->state == DISP_UNUSED ||
+			d->device != &nodes[0] || !d->planes.n_overlay)
+			continue;
+
+		uint64_t blob_id;
+		int fd = d->device->disp_fd;
+		if (!lookup_drm_propval(fd, d->planes.overlay[0].id,
+			DRM_MODE_OBJECT_PLANE, "IN_FORMATS", &blob_id, false) || !blob_id)
+			continue;
+
+		drmModePropertyBlobPtr blob = drmModeGetPropertyBlob(fd, blob_id);
+		if (!blob)
+			continue;
+
+		struct drm_format_modifier_blob* hdr = blob->data;
+		uint32_t* fmts = (uint32_t*)((uint8_t*) blob->data + hdr->formats_offset);
+		struct drm_format_modifier* mods =
+			(struct drm_format_modifier*)((uint8_t*) blob->data + hdr->modifiers_offset);
+
+		for (size_t j = 0; j < hdr->count_modifiers && count < n; j++){
+			for (size_t k = 0; k < 64 && count < n; k++){
+				if (!(mods[j].formats & (1ull << k)) ||
+					mods[j].offset + k >= hdr->count_formats)
+					continue;
+
+				uint32_t fmt = fmts[mods[j].offset + k];
+				bool known = false;
+				for (size_t l = 0; l < count && !known; l++)
+					known = formats[l] == fmt && modifiers[l] == mods[j].modifier;
+
+				if (!known){
+					formats[count] = fmt;
+					modifiers[count++] = mods[j].modifier;
+				}
+			}
+		}
+
+		drmModeFreePropertyBlob(blob);
+	}
+
+	return count;
+}
+
+/*
+ * sweep all displays, and see if the referenced CRTC id is in use.
+ */
+static struct dispout* crtc_used(struct dev_node* dev, int crtc)
+{
+	for (size_t i = 0; i < MAX_DISPLAYS; i++){
+		if (displays[i].state == DISP_UNUSED)
+			continue;
+
+		if (displays[i].device != dev)
+			continue;
+
+		if (displays[i].display.crtc == crtc)
+			return &displays[i];
+	}
+
+	return NULL;
+}
+
+static int setup_kms(struct dispout* d, int conn_id, size_t w, size_t h)
+{
+	SET_SEGV_MSG("egl-dri(), enumerating connectors on device failed.\n");
+	drmModeRes* res;
+
+retry:
+	res = drmModeGetResources(d->device->disp_fd);
+	if (!res){
+		debug_print("(%d) setup_kms, couldn't get resources (fd:%d)",
+			(int)d->id, (int)d->device->disp_fd);
+		return -1;
+	}
+
+/* for the default case we don't have a connector, but for
+ * newly detected displays we store / reserve */
+	if (!d->display.con)
+	for (int i = 0; i < res->count_connectors; i++){
+		d->display.con = drmModeGetConnector(d->device->disp_fd, res->connectors[i]);
+
+		if (d->display.con->connection == DRM_MODE_CONNECTED &&
+			(conn_id == -1 || conn_id == d->display.con->connector_id))
+			break;
+
+		drmModeFreeConnector(d->display.con);
+		d->display.con = NULL;
+	}
+
+/*
+ * No connector in place, set a retry- timer or give up. The other
+ * option would be to switch over to display/headless mode
+ */
+	if (!d->display.con){
+		drmModeFreeResources(res);
+
+/* only wait for the first display */
 		if (d == &displays[0] && d->device->wait_connector){
 			debug_print("(%d) setup-kms, no display - retry in 5s", (int)d->id);
 			sleep(5);
@@ -2568,6 +3935,7 @@ static bool map_handle_gbm(struct agp_vstore* dst, int64_t handle)
 	uint32_t lo = invalid & 0xffffffff;
 
 	if (-1 == handle){
+		scanout_drop(dst);
 		struct dispout* d = &displays[0];
 		d->device->eglenv.destroy_image(
 			d->device->display, (EGLImage) dst->vinf.text.tag);
@@ -2727,7 +4095,7 @@ static void query_card(struct dev_node* node)
 /* allocate display and mark as known but not mapped, give up
  * if we're out of display slots */
 		debug_print("unknown display detected");
-		d = allocate_display(&nodes[0]);
+		d = allocate_display(node);
 		if (!d){
 			debug_print("failed  to allocate new display");
 			drmModeFreeConnector(con);
@@ -2810,6 +4178,20 @@ static void disable_display(struct dispout* d, bool dealloc)
 
 	d->state = DISP_CLEANUP;
 
+/* needs the display card context and surface to still be around */
+	offload_free(d);
+	d->offload.failed = false;
+
+/* don't leave adaptive synch on for whatever gets the crtc next */
+	if (d->display.vrr.enabled)
+		vrr_set(d, 0.0);
+	d->display.vrr.capable = false;
+
+	if (d->buffer.out_fence > 0){
+		close(d->buffer.out_fence);
+		d->buffer.out_fence = -1;
+	}
+
 	set_display_context(d);
 	debug_print("(%d) destroying EGL surface", (int)d->id);
 	d->device->eglenv.destroy_surface(d->device->display, d->buffer.esurf);
@@ -2872,6 +4254,7 @@ static void disable_display(struct dispout* d, bool dealloc)
 /* in extended suspend, we have no idea which displays we are returning to so
  * the only real option is to fully deallocate even in EXTSUSP */
 	debug_print("(%d) release crtc id (%d)", (int)d->id,(int)d->display.crtc);
+	planes_reset(d);
 	if (d->display.old_crtc){
 		debug_print("(%d) old mode found, trying to reset", (int)d->id);
 		if (d->device->atomic){
@@ -2893,6 +4276,7 @@ static void disable_display(struct dispout* d, bool dealloc)
 			debug_print("Error setting old CRTC on %d", d->display.con_id);
 		}
 	}
+	planes_free(d);
 
 /* in the no-dealloc state we still want to remember which CRTCs etc were
  * set as those might have been changed as part of a modeset request */
@@ -3229,6 +4613,12 @@ bool platform_video_init(uint16_t w, uint16_t h,
  */
 	sigaction(SIGSEGV, &err_sh, &old_sh);
 
+	uintptr_t tag;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+	egl_dri.display_clocks = get_config("video_display_clocks", 0, NULL, tag);
+	egl_dri.planes = get_config("video_device_planes", 0, NULL, tag);
+	egl_dri.display_depth = get_config("video_display_depth", 0, NULL, tag);
+
 	if (setup_cards_db(w, h) || setup_cards_basic(w, h)){
 		struct dispout* d = egl_dri.last_display;
 		set_display_context(d);
@@ -3352,9 +4742,21 @@ page_flip_handler(
 	d->buffer.in_flip = 0;
 	TRACE_MARK_ONESHOT("egl-dri", "flip-ack", TRACE_SYS_DEFAULT, d->id, frame, "flip");
 	verbose_print("(%d) flip(frame: %u, @ %u.%u)", (int) d->id, frame, sec, usec);
+	planes_latched(d);
+
+/* flip timestamps are CLOCK_MONOTONIC, same as arcan_timemicros */
+	arcan_bench_register_present((uint64_t) sec * 1000000 + usec);
+
+	if (d->offload.mode == OFFLOAD_DIRECT)
+		d->offload.front = d->offload.pending;
 
 	switch(d->device->buftype){
 	case BUF_GBM:{
+/* plane-only commit, the primary bo is still the one on screen */
+		if (d->buffer.keep_bo){
+			d->buffer.keep_bo = false;
+			break;
+		}
 
 /* won't happen first frame or to-from dumb transition */
 		if (d->buffer.cur_bo)
@@ -3398,7 +4800,42 @@ page_flip_handler(
 	break;
 	}
 
-	arcan_conductor_deadline(deadline_for_display(d));
+	if (egl_dri.display_clocks || d->display.vrr.enabled)
+		arcan_conductor_display_synch(
+			d->device->card_id, d->id, deadline_for_display(d));
+	else
+		arcan_conductor_deadline(deadline_for_display(d));
+}
+
+/*
+ * With per-display clocks, a rendertarget is only composed when at least one
+ * of the displays it is mapped to is due. Rendertargets that aren't mapped to
+ * a display are left alone.
+ */
+static void defer_displays()
+{
+	struct dispout* d;
+	int i = 0;
+
+	while ((d = get_display(i++))){
+		struct rendertarget* tgt =
+			arcan_vint_findrt(arcan_video_getobject(d->vid));
+
+		d->deferred = d->state == DISP_MAPPED &&
+			!arcan_conductor_display_due(d->device->card_id, d->id);
+
+		if (tgt && d->state == DISP_MAPPED)
+			tgt->deferred = true;
+	}
+
+	i = 0;
+	while ((d = get_display(i++))){
+		struct rendertarget* tgt =
+			arcan_vint_findrt(arcan_video_getobject(d->vid));
+
+		if (tgt && d->state == DISP_MAPPED && !d->deferred)
+			tgt->deferred = false;
+	}
 }
 
 static bool dirty_displays()
@@ -3407,6 +4844,9 @@ static bool dirty_displays()
 	int i = 0;
 
 	while((d = get_display(i++))){
+		if (d->planes.dirty)
+			return true;
+
 		arcan_vobject* vobj = arcan_video_getobject(d->vid);
 		if (!vobj)
 			continue;
@@ -3638,7 +5078,20 @@ void platform_video_synch(
  * rendertargets so that we can properly decide which ones to synch or not -
  * this is basically a left-over from old / naive design */
 	size_t nd;
+	if (egl_dri.display_clocks || vrr_displays())
+		defer_displays();
+
+/* plane assignment decides what the world composition can leave out */
+	if (egl_dri.planes){
+		for (size_t i = 0; i < MAX_DISPLAYS; i++){
+			struct dispout* d = &displays[i];
+			if (d->state == DISP_MAPPED && !d->buffer.in_flip && !d->deferred)
+				assign_planes(d, fract);
+		}
+	}
+
 	uint32_t cost_ms = arcan_vint_refresh(fract, &nd);
+	arcan_conductor_phase(CONDUCTOR_PHASE_SWAP);
 
 /*
  * At this stage, the contents of all RTs have been synched, with nd == 0,
@@ -3655,19 +5108,40 @@ void platform_video_synch(
  * on whatever display that was updated so we can go with that
  */
 	if (nd > 0 || dirty_displays()){
+		struct dispout* blitq[MAX_DISPLAYS];
+		size_t n_blitq = 0;
+
 		while ( (d = get_display(i++)) ){
-			if (d->state == DISP_MAPPED && d->buffer.in_flip == 0){
+			if (d->state == DISP_MAPPED && d->buffer.in_flip == 0 && !d->deferred){
+				if (display_offloaded(d)){
+					blitq[n_blitq++] = d;
+					continue;
+				}
 				updated |= update_display(d);
 				clocked |= d->device->vsynch_method == VSYNCH_CLOCK;
 			}
 		}
+
+/* displays composed for another card go after those scanned out from the
+ * render node so the transfers don't delay them */
+		for (size_t j = 0; j < n_blitq; j++){
+			updated |= update_display(blitq[j]);
+			clocked |= blitq[j]->device->vsynch_method == VSYNCH_CLOCK;
+		}
+
+		if (n_blitq){
+			set_device_context(&nodes[0]);
+			agp_setenv(agp_env());
+		}
 /*
  * Finally check for the callbacks, synchronize with the conductor and so on
  * the clocked is a failsafe for devices that don't support giving a vsynch
  * signal.
  */
-		if (get_pending(false) || updated)
+		if (get_pending(false) || updated){
+			arcan_conductor_phase(CONDUCTOR_PHASE_SCANOUT);
 			flush_display_events(clocked ? 16 : 0, true);
+		}
 	}
 
 /*
@@ -3967,6 +5441,36 @@ ssize_t platform_video_map_display_layer(arcan_vobj_id id,
 		return -1;
 	}
 
+/* a deep source on a display that hasn't had its depth set explicitly gets
+ * a matching scanout format, setup_buffers_gbm falls back to 8-bit if the
+ * driver doesn't have a config for it */
+	if (egl_dri.display_depth &&
+		d->device->buftype == BUF_GBM && d->state == DISP_MAPPED){
+		int fmt = OUTPUT_DEFAULT;
+		if (vobj->vstore->hdr.depth == VSTORE_HINT_HIDEF ||
+			vobj->vstore->hdr.depth == VSTORE_HINT_HIDEF_NOALPHA)
+			fmt = OUTPUT_DEEP;
+		else if (vobj->vstore->hdr.depth >= VSTORE_HINT_F16)
+			fmt = OUTPUT_HDR;
+
+		if (fmt != d->output_format && (d->depth_auto ||
+			d->output_format == OUTPUT_DEFAULT)){
+			debug_print("map_display(%d->%d) output format %d -> %d",
+				(int) id, (int) disp, d->output_format, fmt);
+			d->output_format = fmt;
+			d->depth_auto = fmt != OUTPUT_DEFAULT;
+			d->state = DISP_CLEANUP;
+			d->device->eglenv.destroy_surface(d->device->display, d->buffer.esurf);
+			d->buffer.esurf = EGL_NO_SURFACE;
+			if (!realloc_buffers(d)){
+				debug_print("map_display(%d->%d) couldn't rebuild buffers",
+					(int) id, (int) disp);
+				return -1;
+			}
+			d->state = DISP_MAPPED;
+		}
+	}
+
 /* normal object may have origo in UL, WORLDID FBO in LL */
 	float txcos[8];
 		memcpy(txcos, vobj->txcos ? vobj->txcos :
@@ -4005,7 +5509,9 @@ ssize_t platform_video_map_display_layer(arcan_vobj_id id,
 
 /* need to remove this from the mapping hint so that it doesn't
  * hit HINT_NONE tests */
-	d->hint = hint & ~(HINT_FL_PRIMARY | HINT_DIRECT);
+	d->tearing = hint & HINT_TEARING;
+	d->async_fails = 0;
+	d->hint = hint & ~(HINT_FL_PRIMARY | HINT_DIRECT | HINT_TEARING);
 	d->vid = id;
 	arcan_conductor_register_display(
 		d->device->card_id, d->id, SYNCH_STATIC, d->display.mode.vrefresh, d->vid);
@@ -4020,7 +5526,8 @@ ssize_t platform_video_map_display_layer(arcan_vobj_id id,
 		build_orthographic_matrix(
 			newtgt->projection, 0, vobj->origw, 0, vobj->origh, 0, 1);
 
-		if (!d->hint && !d->force_compose && sane_direct_vobj(vobj, "rtgt")){
+		if (!d->hint && !d->force_compose &&
+			!display_offloaded(d) && sane_direct_vobj(vobj, "rtgt")){
 /* before swapping, set an allocator for the rendertarget so that we can ensure
  * that we allocate from scanout capable memory - note that in that case the
  * contents is invalidated and a new render pass on the target is needed. This
@@ -4041,7 +5548,7 @@ ssize_t platform_video_map_display_layer(arcan_vobj_id id,
  *
  *  - tui based contents where we can raster into a dumb buffer
  */
-	else if (sane_direct_vobj(vobj, "simple_vid")){
+	else if (!display_offloaded(d) && sane_direct_vobj(vobj, "simple_vid")){
 		TRACE_MARK_ONESHOT("egl-dri", "dumb-bo", TRACE_SYS_DEFAULT, d->id, 0, "");
 		debug_print("(%d) switching to dumb mode", d->id);
 
@@ -4119,6 +5626,405 @@ static void ensure_in_fence(struct dispout* d)
  */
 }
 
+/*
+ * Translate rendertarget damage into plane coordinates for FB_DAMAGE_CLIPS,
+ * this is only done when the store maps 1:1 to the plane, otherwise the
+ * entire plane is left as damaged.
+ */
+static void set_damage_clips(struct dispout* d,
+	arcan_vobject* vobj, struct agp_region* regions, size_t n)
+{
+	d->damage.count = 0;
+	struct agp_vstore* vs =
+		d->vid == ARCAN_VIDEO_WORLDID ? arcan_vint_world() : vobj->vstore;
+
+	if (!n || n > COUNT_OF(d->damage.rects) || !vs ||
+		d->dispx || d->dispy || vs->w != d->dispw || vs->h != d->disph ||
+		d->dispw != d->display.mode.hdisplay ||
+		d->disph != d->display.mode.vdisplay)
+		return;
+
+/* framebuffer origin is lower left, mirrored mapping puts that at the bottom */
+	bool flip;
+	if (memcmp(d->txcos,
+		arcan_video_display.mirror_txcos, sizeof(float) * 8) == 0)
+		flip = true;
+	else if (memcmp(d->txcos,
+		arcan_video_display.default_txcos, sizeof(float) * 8) == 0)
+		flip = false;
+	else
+		return;
+
+	for (size_t i = 0; i < n; i++){
+		d->damage.rects[i] = (struct drm_mode_rect){
+			.x1 = regions[i].x1,
+			.x2 = regions[i].x2,
+			.y1 = flip ? vs->h - regions[i].y2 : regions[i].y1,
+			.y2 = flip ? vs->h - regions[i].y1 : regions[i].y2
+		};
+	}
+
+	d->damage.count = n;
+}
+
+/*
+ * Render offload: the scene graph lives in the agp context of the render node
+ * so displays on other cards are composed there into OFFLOAD_BUFFERS linear
+ * buffers that are then handed over as dma-bufs. With OFFLOAD_DIRECT the
+ * display card imports them as framebuffers and scans out from them as is,
+ * with OFFLOAD_COPY it imports them as textures and blits into its own gbm
+ * surface, which is then flipped through the normal path. The copies are
+ * queued until the displays on the render node have been updated, see
+ * platform_video_synch. Per-display costs are sampled into trace marks.
+ */
+static bool display_offloaded(struct dispout* d)
+{
+	return d->device != &nodes[0] &&
+		d->device->buftype == BUF_GBM && nodes[0].buftype == BUF_GBM &&
+		nodes[0].buffer.gbm && !d->offload.failed;
+}
+
+static void offload_free(struct dispout* d)
+{
+	if (!d->offload.mode)
+		return;
+
+	struct agp_fenv* env = agp_env();
+
+/* the display card side first, then the render node */
+	if (d->offload.mode == OFFLOAD_COPY)
+		set_display_context(d);
+
+	for (size_t i = 0; i < OFFLOAD_BUFFERS; i++){
+		struct offload_buf* buf = &d->offload.buf[i];
+
+		if (buf->fb)
+			drmModeRmFB(d->device->disp_fd, buf->fb);
+
+		if (buf->remote_bo)
+			gbm_bo_destroy(buf->remote_bo);
+
+		if (buf->remote_fbo)
+			env->delete_framebuffers(1, &buf->remote_fbo);
+
+		if (buf->remote_tex)
+			env->delete_textures(1, &buf->remote_tex);
+
+		if (buf->remote_img)
+			d->device->eglenv.destroy_image(d->device->display, buf->remote_img);
+	}
+
+	set_device_context(&nodes[0]);
+	agp_setenv(env);
+
+	for (size_t i = 0; i < OFFLOAD_BUFFERS; i++){
+		struct offload_buf* buf = &d->offload.buf[i];
+
+		if (buf->rtgt)
+			agp_drop_rendertarget(buf->rtgt);
+
+		if (buf->tex)
+			env->delete_textures(1, &buf->tex);
+
+		if (buf->img)
+			nodes[0].eglenv.destroy_image(nodes[0].display, buf->img);
+
+		if (buf->bo)
+			gbm_bo_destroy(buf->bo);
+	}
+
+	if (d->offload.fence > 0)
+		close(d->offload.fence);
+
+	debug_print("(%d) offload released after %"PRIu64" frames", (int)d->id,
+		d->offload.frames);
+
+	bool failed = d->offload.failed;
+	d->offload = (typeof(d->offload)){
+		.fence = -1,
+		.failed = failed
+	};
+}
+
+static bool offload_import_direct(struct dispout* d,
+	struct offload_buf* buf, struct shmifext_buffer_plane* planes, size_t n_planes)
+{
+	uint32_t handles[4] = {0}, strides[4] = {0}, offsets[4] = {0};
+	struct gbm_import_fd_data data = {
+		.fd = planes[0].fd,
+		.width = d->offload.w,
+		.height = d->offload.h,
+		.stride = planes[0].gbm.stride,
+		.format = planes[0].gbm.format
+	};
+
+	if (n_planes != 1)
+		return false;
+
+	buf->remote_bo = gbm_bo_import(
+		d->device->buffer.gbm, GBM_BO_IMPORT_FD, &data, GBM_BO_USE_SCANOUT);
+	if (!buf->remote_bo)
+		return false;
+
+	handles[0] = gbm_bo_get_handle(buf->remote_bo).u32;
+	strides[0] = planes[0].gbm.stride;
+	offsets[0] = planes[0].gbm.offset;
+
+	return 0 == drmModeAddFB2(d->device->disp_fd, d->offload.w, d->offload.h,
+		planes[0].gbm.format, handles, strides, offsets, &buf->fb, 0);
+}
+
+static bool offload_import_copy(struct dispout* d,
+	struct offload_buf* buf, struct shmifext_buffer_plane* planes, size_t n_planes)
+{
+	struct agp_fenv* env = agp_env();
+	if (!env->blit_framebuffer || !d->buffer.esurf)
+		return false;
+
+	buf->remote_img = helper_dmabuf_eglimage(
+		env, &d->device->eglenv, d->device->display, planes, n_planes);
+	if (!buf->remote_img)
+		return false;
+
+	helper_eglimage_color(env, &d->device->eglenv, buf->remote_img, &buf->remote_tex);
+	env->gen_framebuffers(1, &buf->remote_fbo);
+	env->bind_framebuffer(GL_FRAMEBUFFER, buf->remote_fbo);
+	env->framebuffer_texture_2d(GL_FRAMEBUFFER,
+		GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, buf->remote_tex, 0);
+	bool ok = env->check_framebuffer(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	env->bind_framebuffer(GL_FRAMEBUFFER, 0);
+
+	return ok;
+}
+
+static bool offload_setup_buf(
+	struct dispout* d, struct offload_buf* buf, enum offload_mode mode)
+{
+	struct agp_fenv* env = agp_env();
+	struct shmifext_buffer_plane planes[DMABUF_PLANES_LIMIT];
+	size_t n_planes = DMABUF_PLANES_LIMIT;
+
+/* linear as tiling layouts are rarely understood across vendors */
+	set_device_context(&nodes[0]);
+	buf->bo = gbm_bo_create(nodes[0].buffer.gbm, d->offload.w, d->offload.h,
+		d->buffer.format, GBM_BO_USE_RENDERING | GBM_BO_USE_LINEAR);
+
+	if (!buf->bo || !helper_bo_dmabuf(env, &nodes[0].eglenv, nodes[0].buffer.gbm,
+		nodes[0].display, d->offload.w, d->offload.h, d->buffer.format,
+		buf->bo, planes, &n_planes))
+		return false;
+
+	buf->img = helper_dmabuf_eglimage(
+		env, &nodes[0].eglenv, nodes[0].display, planes, n_planes);
+	if (!buf->img)
+		return false;
+
+	helper_eglimage_color(env, &nodes[0].eglenv, buf->img, &buf->tex);
+	buf->store = (struct agp_vstore){
+		.txmapped = TXSTATE_TEX2D,
+		.w = d->offload.w,
+		.h = d->offload.h,
+		.refcount = 1,
+		.vinf.text.glid = buf->tex
+	};
+	buf->rtgt = agp_setup_rendertarget(&buf->store, RENDERTARGET_COLOR);
+	agp_activate_rendertarget(NULL);
+
+/* second export for the display card, the first set was consumed by EGL */
+	n_planes = DMABUF_PLANES_LIMIT;
+	if (!buf->rtgt || !helper_bo_dmabuf(env, &nodes[0].eglenv, nodes[0].buffer.gbm,
+		nodes[0].display, d->offload.w, d->offload.h, d->buffer.format,
+		buf->bo, planes, &n_planes))
+		return false;
+
+	bool ok;
+	if (mode == OFFLOAD_DIRECT){
+		ok = offload_import_direct(d, buf, planes, n_planes);
+		for (size_t i = 0; i < n_planes; i++)
+			close(planes[i].fd);
+	}
+	else {
+		set_display_context(d);
+		ok = offload_import_copy(d, buf, planes, n_planes);
+		set_device_context(&nodes[0]);
+		agp_setenv(env);
+	}
+
+	return ok;
+}
+
+static bool offload_try(struct dispout* d, enum offload_mode mode)
+{
+	d->offload.mode = mode;
+	d->offload.render = &nodes[0];
+	d->offload.w = d->dispw;
+	d->offload.h = d->disph;
+
+	for (size_t i = 0; i < OFFLOAD_BUFFERS; i++){
+		if (!offload_setup_buf(d, &d->offload.buf[i], mode)){
+			debug_print("(%d) offload, %s setup failed on buffer %zu", (int)d->id,
+				mode == OFFLOAD_DIRECT ? "direct" : "copy", i);
+			offload_free(d);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* (re-)build the swapchain when the display is first drawn or changes size */
+static bool offload_setup(struct dispout* d)
+{
+	if (d->offload.mode && d->offload.w == d->dispw && d->offload.h == d->disph)
+		return true;
+
+	offload_free(d);
+
+	uintptr_t tag;
+	char* pref = NULL;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+	get_config("video_device_offload", d->device->card_id, &pref, tag);
+
+	bool direct = !pref || strcmp(pref, "copy") != 0;
+	bool copy = !pref || strcmp(pref, "direct") != 0;
+	free(pref);
+
+	if ((direct && offload_try(d, OFFLOAD_DIRECT)) ||
+		(copy && offload_try(d, OFFLOAD_COPY))){
+		TRACE_MARK_ONESHOT("egl-dri", "offload", TRACE_SYS_DEFAULT,
+			d->id, d->offload.mode, d->offload.mode == OFFLOAD_DIRECT ? "direct" : "copy");
+		return true;
+	}
+
+	TRACE_MARK_ONESHOT("egl-dri", "offload", TRACE_SYS_ERROR, d->id, 0, "failed");
+	d->offload.failed = true;
+	return false;
+}
+
+/* compose on the render node into the next free offload buffer */
+static bool offload_render(
+	struct dispout* d, arcan_vobject* vobj, agp_shader_id shid)
+{
+	if (!offload_setup(d))
+		return false;
+
+	uint64_t start = arcan_timemicros();
+	struct offload_buf* buf = &d->offload.buf[d->offload.next];
+
+	set_device_context(&nodes[0]);
+	agp_activate_rendertarget(buf->rtgt);
+
+/* the buffer is scanned out top-down, unlike the EGL surface */
+	float projection[16];
+	build_orthographic_matrix(projection, 0, d->dispw, 0, d->disph, 0, 1);
+
+	agp_activate_vstore(
+		d->vid == ARCAN_VIDEO_WORLDID ? arcan_vint_world() : vobj->vstore);
+	agp_shader_activate(shid);
+	agp_shader_envv(PROJECTION_MATR, projection, sizeof(float)*16);
+	agp_rendertarget_clear();
+	agp_blendstate(BLEND_NONE);
+	agp_draw_vobj(0, 0, d->dispw, d->disph, d->txcos, NULL);
+
+	if (vobj->vstore == arcan_vint_world())
+		arcan_vint_drawcursor(false);
+
+	agp_deactivate_vstore();
+	agp_activate_rendertarget(NULL);
+
+/* the display card waits for this rather than the cpu */
+	if (d->offload.fence > 0){
+		close(d->offload.fence);
+		d->offload.fence = -1;
+	}
+
+	if (nodes[0].eglenv.create_synch && nodes[0].eglenv.dup_fence_fd){
+		EGLSyncKHR synch = nodes[0].eglenv.create_synch(nodes[0].display,
+			EGL_SYNC_NATIVE_FENCE_ANDROID, (EGLint[]){
+				EGL_SYNC_NATIVE_FENCE_FD_ANDROID, EGL_NO_NATIVE_FENCE_FD_ANDROID, EGL_NONE}
+		);
+		agp_env()->flush();
+
+		if (synch != EGL_NO_SYNC_KHR){
+			d->offload.fence = nodes[0].eglenv.dup_fence_fd(nodes[0].display, synch);
+			nodes[0].eglenv.destroy_synch(nodes[0].display, synch);
+		}
+	}
+	else
+		agp_env()->flush();
+
+	d->offload.render_us = arcan_timemicros() - start;
+	return true;
+}
+
+/* hand the last rendered buffer to the display card */
+static enum display_update_state offload_transfer(struct dispout* d, uint32_t* fb)
+{
+	uint64_t start = arcan_timemicros();
+	struct offload_buf* buf = &d->offload.buf[d->offload.next];
+	enum display_update_state rv = UPDATE_OFFLOAD;
+
+	if (d->offload.mode == OFFLOAD_DIRECT){
+/* the atomic commit carries the fence, legacy flips wait for it here */
+		if (d->device->atomic && d->offload.fence > 0){
+			if (d->buffer.synch_fence > 0)
+				close(d->buffer.synch_fence);
+			d->buffer.synch_fence = d->offload.fence;
+			d->offload.fence = -1;
+		}
+		else if (d->offload.fence > 0){
+			struct pollfd pfd = {.fd = d->offload.fence, .events = POLLIN};
+			poll(&pfd, 1, 16);
+		}
+
+		*fb = buf->fb;
+		d->offload.pending = d->offload.next;
+	}
+	else {
+		struct agp_fenv* env = agp_env();
+		set_display_context(d);
+
+		if (d->offload.fence > 0 && d->device->eglenv.create_synch){
+			EGLSyncKHR synch = d->device->eglenv.create_synch(d->device->display,
+				EGL_SYNC_NATIVE_FENCE_ANDROID, (EGLint[]){
+					EGL_SYNC_NATIVE_FENCE_FD_ANDROID, d->offload.fence, EGL_NONE}
+			);
+
+/* on success the sync object owns the descriptor */
+			if (synch != EGL_NO_SYNC_KHR){
+				d->offload.fence = -1;
+				d->device->eglenv.wait_synch(d->device->display, synch, 0);
+				d->device->eglenv.destroy_synch(d->device->display, synch);
+			}
+		}
+
+		env->bind_framebuffer(GL_READ_FRAMEBUFFER, buf->remote_fbo);
+		env->bind_framebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		env->blit_framebuffer(0, 0, d->offload.w, d->offload.h,
+			0, d->offload.h, d->offload.w, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		env->bind_framebuffer(GL_FRAMEBUFFER, 0);
+
+		d->device->eglenv.swap_buffers(d->device->display, d->buffer.esurf);
+		rv = UPDATE_FLIP;
+	}
+
+	d->offload.next = (d->offload.next + 1) % OFFLOAD_BUFFERS;
+	if (d->offload.mode == OFFLOAD_DIRECT &&
+		(d->offload.next == d->offload.front || d->offload.next == d->offload.pending))
+		d->offload.next = (d->offload.next + 1) % OFFLOAD_BUFFERS;
+
+	d->offload.xfer_us = arcan_timemicros() - start;
+	d->offload.frames++;
+
+	TRACE_MARK_ONESHOT("egl-dri", "offload-render",
+		TRACE_SYS_DEFAULT, d->id, d->offload.render_us, "");
+	TRACE_MARK_ONESHOT("egl-dri", "offload-transfer",
+		TRACE_SYS_DEFAULT, d->id, d->offload.xfer_us,
+		d->offload.mode == OFFLOAD_DIRECT ? "direct" : "copy");
+
+	return rv;
+}
+
 static enum display_update_state draw_display(struct dispout* d)
 {
 	bool swap_display = true;
@@ -4139,7 +6045,13 @@ static enum display_update_state draw_display(struct dispout* d)
 			"(%d:%s) draw display, dirty regions: %zu",
 			(int) d->id, vobj->tracetag ? vobj->tracetag : "(untagged)", nd);
 		if (nd || newtgt->frame_cookie != d->frame_cookie){
-			agp_rendertarget_dirty_reset(newtgt->art, NULL);
+			struct agp_region regions[nd ? nd : 1];
+			agp_rendertarget_dirty_reset(newtgt->art, regions);
+			set_damage_clips(d, vobj, regions, nd);
+		}
+		else if (d->planes.dirty && d->buffer.cur_fb){
+			verbose_print("(%d) no dirty, planes changed", (int)d->id);
+			return UPDATE_PLANES;
 		}
 		else{
 			verbose_print("(%d) no dirty, skip");
@@ -4149,11 +6061,16 @@ static enum display_update_state draw_display(struct dispout* d)
 		newtgt->frame_cookie = d->frame_cookie;
 	}
 
+/* displays on another card are composed by the render node */
+	if (vobj && display_offloaded(d) &&
+		offload_render(d, vobj, vobj->program > 0 ? vobj->program : shid))
+		return UPDATE_OFFLOAD;
+
 /*
  * If the following conditions are valid, we can simply add the source vid
  * to the display directly, saving a full screen copy.
  */
-	if (d->hint == HINT_NONE &&
+	if (d->hint == HINT_NONE && !display_offloaded(d) &&
 		!d->force_compose && sane_direct_vobj(vobj, "rt_swap")){
 		swap_display = false;
 		goto out;
@@ -4199,8 +6116,12 @@ static enum display_update_state draw_display(struct dispout* d)
 	 * Seems more and more that accelerated cursors add to more state explosion
 	 * than they are worth ..
 	 */
-	if (vobj->vstore == arcan_vint_world()){
+	if (vobj->vstore == arcan_vint_world() && !d->planes.cursor.fb){
 		arcan_vint_drawcursor(false);
+
+/* the cursor is composed in here and not covered by the rendertarget damage */
+		if (arcan_video_display.cursor.vstore)
+			d->damage.count = 0;
 	}
 
 	agp_deactivate_vstore();
@@ -4218,6 +6139,86 @@ out:
 	return UPDATE_DIRECT;
 }
 
+/*
+ * Asynchronous flips are used when the display was mapped with HINT_TEARING,
+ * when the conductor strategy asks for it, or when a client that is mapped
+ * to the display as is has requested it (CLOCKREQ, dynamic = 3). Only the
+ * primary buffer can change in an asynchronous commit, so plane updates and
+ * modesets always go through the normal path.
+ */
+static bool want_tearing(struct dispout* d)
+{
+	if (d->async_fails >= ASYNC_FAIL_LIMIT ||
+		d->buffer.dumb.enabled || d->planes.dirty)
+		return false;
+
+	if (d->device->atomic ? !d->device->atomic_async : !d->device->async_flip)
+		return false;
+
+	if (d->tearing || arcan_conductor_tearing())
+		return true;
+
+	arcan_vobject* vobj = arcan_video_getobject(d->vid);
+	if (vobj && vobj->feed.state.tag == ARCAN_TAG_FRAMESERV){
+		struct arcan_frameserver* fsrv = vobj->feed.state.ptr;
+		return fsrv && fsrv->clock.tearing;
+	}
+
+	return false;
+}
+
+static bool atomic_async_flip(struct dispout* d, uint32_t fb)
+{
+	int fd = d->device->disp_fd;
+
+/* IN_FENCE_FD can't be set on an asynchronous commit, wait for it here */
+	if (d->buffer.synch_fence > 0){
+		struct pollfd pfd = {.fd = d->buffer.synch_fence, .events = POLLIN};
+		poll(&pfd, 1, 16);
+		close(d->buffer.synch_fence);
+		d->buffer.synch_fence = -1;
+	}
+
+	drmModeObjectPropertiesPtr pptr =
+		drmModeObjectGetProperties(fd, d->display.plane_id, DRM_MODE_OBJECT_PLANE);
+	if (!pptr)
+		return false;
+
+	drmModeAtomicReqPtr aptr = drmModeAtomicAlloc();
+	bool rv = resolve_add(fd, aptr, d->display.plane_id, pptr, "FB_ID", fb) &&
+		0 == drmModeAtomicCommit(fd, aptr, DRM_MODE_PAGE_FLIP_ASYNC |
+			DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT, NULL);
+
+	drmModeAtomicFree(aptr);
+	drmModeFreeObjectProperties(pptr);
+	d->damage.count = 0;
+
+	if (!rv){
+		d->async_fails++;
+		TRACE_MARK_ONESHOT("egl-dri", "async-flip",
+			TRACE_SYS_WARN, d->id, d->async_fails, "rejected");
+	}
+
+	return rv;
+}
+
+static bool legacy_flip(struct dispout* d, uint32_t fb)
+{
+	int fd = d->device->disp_fd;
+
+	if (want_tearing(d)){
+		if (0 == drmModePageFlip(fd, d->display.crtc,
+			fb, DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_PAGE_FLIP_ASYNC, d))
+			return true;
+
+		d->async_fails++;
+		TRACE_MARK_ONESHOT("egl-dri", "async-flip",
+			TRACE_SYS_WARN, d->id, d->async_fails, "rejected");
+	}
+
+	return 0 == drmModePageFlip(fd, d->display.crtc, fb, DRM_MODE_PAGE_FLIP_EVENT, d);
+}
+
 static bool update_display(struct dispout* d)
 {
 	if (d->display.dpms != ADPMS_ON)
@@ -4241,23 +6242,39 @@ static bool update_display(struct dispout* d)
 	agp_activate_rendertarget(NULL);
 
 /*
- * Currently we only do binary damage / update tracking in that there are EGL
- * versions for saying 'this region is damaged, update that' to cut down on
- * fillrate/bw. This should likely be added to the agp_ layer as a simple dirty
- * list that the draw_vobj calls append to. Some is prepared for (see
- * agp_rendertarget_dirty), but more is needed in the drawing logic itself.
- *
- * We can also sidestep the EGL bits entirely and simply go with
- * FB_DAMAGE_CLIPS where applicable.
+ * The agp_ layer tracks damage regions per rendertarget (see
+ * agp_rendertarget_dirty) and these are forwarded as FB_DAMAGE_CLIPS on the
+ * atomic commit where the mapping permits (see set_damage_clips). There are
+ * also EGL versions for saying 'this region is damaged' that could cut down
+ * on fillrate/bw for the composition pass itself.
  */
 	enum display_update_state dstate = draw_display(d);
 
+/* nothing to present, committing anyway would scan out an empty fb */
+	if (dstate == UPDATE_SKIP && !d->buffer.dumb.enabled)
+		goto out;
+
 	uint32_t next_fb = 0;
 	int rv = -1;
 /* We use rendertarget_swap for implementing front/back buffering in the
  * case of rendertarget scanout. */
 	switch (d->device->buftype){
 	case BUF_GBM:
+/* re-commit the primary as is, only the planes on top of it change */
+		if (dstate == UPDATE_PLANES){
+			next_fb = d->buffer.cur_fb;
+			d->buffer.keep_bo = true;
+		}
+
+/* direct offload scans out the render node buffer, copy flips as usual */
+		if (dstate == UPDATE_OFFLOAD){
+			dstate = offload_transfer(d, &next_fb);
+			if (dstate == UPDATE_OFFLOAD){
+				d->buffer.cur_fb = next_fb;
+				d->buffer.keep_bo = true;
+			}
+		}
+
 		if (dstate == UPDATE_DIRECT){
 			if ((rv = get_gbm_fb(d, dstate, NULL, &next_fb)) == -1){
 
@@ -4360,13 +6377,16 @@ static bool update_display(struct dispout* d)
 			if (!new_crtc){
 				uint32_t fl = DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT;
 				d->buffer.cur_fb = next_fb;
-				if (atomic_set_mode(d, fl))
+				if (want_tearing(d) && atomic_async_flip(d, next_fb))
 					d->buffer.in_flip = arcan_timemillis();
+				else if (atomic_set_mode(d, fl))
+					d->buffer.in_flip = arcan_timemillis();
+				else
+					d->buffer.keep_bo = false;
 			}
 		}
 /* LEGACY: */
-		else if (0 == drmModePageFlip(d->device->disp_fd,
-			d->display.crtc, next_fb, DRM_MODE_PAGE_FLIP_EVENT, d)){
+		else if (legacy_flip(d, next_fb)){
 			TRACE_MARK_ONESHOT("egl-dri", "vsynch-req", TRACE_SYS_DEFAULT, d->id, next_fb, "flip");
 			d->buffer.in_flip = arcan_timemillis();
 			d->buffer.cur_fb = next_fb;
@@ -16,6 +16,9 @@
 #include <errno.h>
 #include <poll.h>
 #include <glob.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 
 #include <sys/types.h>
 #include <sys/param.h>
@@ -31,6 +34,7 @@
 #include "arcan_led.h"
 #include "arcan_video.h"
 #include "arcan_videoint.h"
+#include "arcan_conductor.h"
 #include "keycode_xlate.h"
 
 #ifdef HAVE_XKBCOMMON
@@ -99,6 +103,7 @@ static const char* envopts[] = {
 	"evdev_keyboard=label", "Force device matching 'label' as a keyboard",
 	"evdev_game=label", "Force device matching 'label' as a game device",
 	"evdev_mouse=label", "Force device matching 'label' as a mouse",
+	"input_thread", "Read device nodes from a separate (real-time priority) thread",
 #ifdef HAVE_XKBCOMMON
 	"", "",
 	"[XKB db keys]", "(libkbcommon specific, no ARCAN_ env prefix)",
@@ -156,6 +161,10 @@ static struct {
 	struct devnode* nodes;
 
 	struct pollfd* pollset;
+
+/* time of the current read pass, stamped into input events (io.pts) so that
+ * input-to-present latency can be tracked */
+	uint64_t read_us;
 } iodev = {0};
 
 struct devnode {
@@ -526,24 +535,9 @@ void platform_event_analogfilter(int devid,
 	set_analogstate(axis,lower_bound, upper_bound, deadzone, buffer_sz, kind);
 }
 
-static bool discovered(struct arcan_evctx* ctx,
-	const char* name, size_t name_len, bool nopending)
+static bool opened(struct arcan_evctx* ctx,
+	const char* name, size_t name_len, int fd, bool nopending)
 {
-	char buffer[name_len+sizeof(notify_scan_dir)];
-	char outbuffer[MAXPATHLEN];
-
-/* need to resolve a symlink if there is one as the platform_device_open
- * has a whitelist that is rather picky about which devices it will open */
-	snprintf(buffer, sizeof(buffer), "%s/%.*s", notify_scan_dir, (int)name_len, name);
-
-	TRACE_MARK_ENTER("event", "open-device", TRACE_SYS_DEFAULT, 0, 0, name);
-
-	int fd = platform_device_open(
-		readlink(buffer, outbuffer, sizeof(outbuffer)) > 0 ?
-			outbuffer : buffer, O_NONBLOCK| O_RDWR);
-
-	TRACE_MARK_EXIT("event", "open-device", TRACE_SYS_DEFAULT, 0, fd, name);
-
 	verbose_print("input: trying to add %s/%.*s",
 		notify_scan_dir, (int)name_len, name);
 
@@ -590,6 +584,55 @@ static bool discovered(struct arcan_evctx* ctx,
 	return false;
 }
 
+static bool discovered(struct arcan_evctx* ctx,
+	const char* name, size_t name_len, bool nopending)
+{
+	char buffer[name_len + strlen(notify_scan_dir) + 2];
+	char outbuffer[MAXPATHLEN];
+
+/* need to resolve a symlink if there is one as the platform_device_open
+ * has a whitelist that is rather picky about which devices it will open */
+	snprintf(buffer, sizeof(buffer), "%s/%.*s", notify_scan_dir, (int)name_len, name);
+	ssize_t nl = readlink(buffer, outbuffer, sizeof(outbuffer) - 1);
+	if (nl > 0)
+		outbuffer[nl] = '\0';
+
+	TRACE_MARK_ENTER("event", "open-device", TRACE_SYS_DEFAULT, 0, 0, name);
+
+/* new devices tend to arrive in bursts (docking, hubs) so don't wait for the
+ * privileged side on each one, the outcome is picked up in process_opened */
+	int fd;
+	if (nopending)
+		fd = platform_device_open(nl > 0 ? outbuffer : buffer, O_NONBLOCK| O_RDWR);
+	else
+		fd = platform_device_open_async(nl > 0 ? outbuffer : buffer, O_NONBLOCK| O_RDWR);
+
+	TRACE_MARK_EXIT("event", "open-device", TRACE_SYS_DEFAULT, 0, fd, name);
+
+	if (-1 == fd && errno == EINPROGRESS)
+		return false;
+
+	return opened(ctx, name, name_len, fd, nopending);
+}
+
+static void process_opened(struct arcan_evctx* ctx)
+{
+	char* path;
+	int fd;
+	size_t dlen = strlen(notify_scan_dir);
+
+	while (platform_device_open_result(&path, &fd)){
+/* pending retries are keyed on the name inside of the scan directory, a
+ * resolved symlink elsewhere can't be retried that way */
+		const char* name = path;
+		if (strncmp(path, notify_scan_dir, dlen) == 0 && path[dlen] == '/')
+			name = &path[dlen + 1];
+
+		opened(ctx, name, strlen(name), fd, name == path);
+		free(path);
+	}
+}
+
 static void process_pending(struct arcan_evctx* ctx)
 {
 	for (size_t i = 0; i < COUNT_OF(pending); i++){
@@ -621,6 +664,374 @@ static void process_pending(struct arcan_evctx* ctx)
 	}
 }
 
+/*
+ * Optional reader thread (event_input_thread): the nodes are read as soon
+ * as they become readable and the raw input_events are stamped and kept in
+ * a per-node ring. The main thread is woken through the conductor wait set
+ * and the node handlers consume the rings in platform_event_process, so the
+ * translation stages (keymaps, filters, coalescing) stay single-threaded.
+ * The lock covers the rings and the node set, the thread holds it only for
+ * the non-blocking reads, and the thread only sees the descriptors through
+ * the rings. Any change to those bumps the generation, which makes the
+ * thread discard its poll set so it never touches a closed descriptor.
+ */
+#define INPUT_RING_SZ 256
+
+struct input_ring {
+	struct input_event buf[INPUT_RING_SZ];
+	size_t head, tail;
+	uint64_t stamp;
+	int fd;
+	bool failed;
+};
+
+static struct {
+	bool enabled, running;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	int wake[2];
+	int notify[2];
+	struct input_ring* rings;
+	size_t n_rings;
+	unsigned gen;
+	atomic_bool shutdown;
+} ithread = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = {-1, -1},
+	.notify = {-1, -1}
+};
+
+/* caller holds the lock */
+static void ithread_poke()
+{
+	ithread.gen++;
+	if (-1 != ithread.wake[1] &&
+		-1 == write(ithread.wake[1], "", 1) && errno != EAGAIN){
+		debug_print("couldn't wake input thread: %s", strerror(errno));
+	}
+}
+
+static void ithread_reset(size_t i, int fd)
+{
+	if (!ithread.running)
+		return;
+
+	pthread_mutex_lock(&ithread.lock);
+	if (i < ithread.n_rings){
+		ithread.rings[i].head = ithread.rings[i].tail = 0;
+		ithread.rings[i].failed = false;
+		ithread.rings[i].fd = fd;
+	}
+	ithread_poke();
+	pthread_mutex_unlock(&ithread.lock);
+}
+
+/* the ring set follows the node set, called after the node set grows */
+static bool ithread_resize()
+{
+	if (!ithread.running || ithread.n_rings >= iodev.sz_nodes)
+		return true;
+
+	pthread_mutex_lock(&ithread.lock);
+	struct input_ring* nr =
+		realloc(ithread.rings, sizeof(struct input_ring) * iodev.sz_nodes);
+	if (!nr){
+		pthread_mutex_unlock(&ithread.lock);
+		return false;
+	}
+
+	memset(&nr[ithread.n_rings], '\0',
+		sizeof(struct input_ring) * (iodev.sz_nodes - ithread.n_rings));
+	for (size_t i = ithread.n_rings; i < iodev.sz_nodes; i++)
+		nr[i].fd = -1;
+	ithread.rings = nr;
+	ithread.n_rings = iodev.sz_nodes;
+	ithread_poke();
+	pthread_mutex_unlock(&ithread.lock);
+	return true;
+}
+
+/* drain as much as fits from one node into its ring, false on failure */
+static bool ithread_fill(int fd, struct input_ring* ring, uint64_t now)
+{
+	if (ring->head == ring->tail)
+		ring->stamp = now;
+
+	while (ring->head - ring->tail < INPUT_RING_SZ){
+		size_t ofs = ring->head % INPUT_RING_SZ;
+		size_t cap = INPUT_RING_SZ - (ring->head - ring->tail);
+		if (cap > INPUT_RING_SZ - ofs)
+			cap = INPUT_RING_SZ - ofs;
+
+		ssize_t nr = read(fd, &ring->buf[ofs], cap * sizeof(struct input_event));
+		if (-1 == nr){
+			if (errno == EINTR)
+				continue;
+			return errno == EAGAIN;
+		}
+		if (0 == nr)
+			return false;
+
+		ring->head += nr / sizeof(struct input_event);
+		if (nr < cap * sizeof(struct input_event))
+			break;
+	}
+
+	return true;
+}
+
+static void* ithread_main(void* arg)
+{
+	struct pollfd* set = NULL;
+	size_t* map = NULL;
+	size_t set_sz = 0, set_used = 1;
+	unsigned gen = ithread.gen - 1;
+
+	while (!atomic_load(&ithread.shutdown)){
+		pthread_mutex_lock(&ithread.lock);
+		if (gen != ithread.gen){
+			gen = ithread.gen;
+			if (set_sz < ithread.n_rings + 1){
+				size_t new_sz = ithread.n_rings + 1;
+				struct pollfd* ns = realloc(set, sizeof(struct pollfd) * new_sz);
+				size_t* nm = realloc(map, sizeof(size_t) * new_sz);
+				if (ns)
+					set = ns;
+				if (nm)
+					map = nm;
+				if (ns && nm)
+					set_sz = new_sz;
+			}
+
+			set[0] = (struct pollfd){.fd = ithread.wake[0], .events = POLLIN};
+			set_used = 1;
+			for (size_t i = 0; i < ithread.n_rings && set_used < set_sz; i++){
+				struct input_ring* ring = &ithread.rings[i];
+				if (ring->fd <= 0 || ring->failed)
+					continue;
+
+/* a full ring is skipped until the main thread has consumed and poked */
+				set[set_used] = (struct pollfd){
+					.fd = ring->head - ring->tail < INPUT_RING_SZ ? ring->fd : -1,
+					.events = POLLIN
+				};
+				map[set_used++] = i;
+			}
+		}
+		pthread_mutex_unlock(&ithread.lock);
+
+		if (poll(set, set_used, -1) <= 0)
+			continue;
+
+		if (set[0].revents){
+			char buf[64];
+			while (read(ithread.wake[0], buf, sizeof(buf)) > 0){}
+		}
+
+		bool got = false;
+		uint64_t now = arcan_timemicros();
+
+		pthread_mutex_lock(&ithread.lock);
+		for (size_t i = 1; i < set_used && gen == ithread.gen; i++){
+			if (!set[i].revents)
+				continue;
+
+			struct input_ring* ring = &ithread.rings[map[i]];
+			if (!(set[i].revents & POLLIN) || !ithread_fill(ring->fd, ring, now))
+				ring->failed = true;
+
+			if (ring->failed || ring->head - ring->tail == INPUT_RING_SZ)
+				set[i].fd = -1;
+
+			got = true;
+		}
+		pthread_mutex_unlock(&ithread.lock);
+
+		if (got && -1 == write(ithread.notify[1], "", 1) && errno != EAGAIN){
+			debug_print("couldn't notify main thread: %s", strerror(errno));
+		}
+	}
+
+	free(set);
+	free(map);
+	return NULL;
+}
+
+static void ithread_notified(int fd, int revents, void* tag)
+{
+	char buf[64];
+	while (read(fd, buf, sizeof(buf)) > 0){}
+}
+
+static void ithread_stop()
+{
+	if (!ithread.running)
+		return;
+
+	atomic_store(&ithread.shutdown, true);
+	pthread_mutex_lock(&ithread.lock);
+	ithread_poke();
+	pthread_mutex_unlock(&ithread.lock);
+	pthread_join(ithread.thread, NULL);
+
+	arcan_conductor_unwatch_fd(ithread.notify[0], &ithread);
+	for (size_t i = 0; i < 2; i++){
+		close(ithread.wake[i]);
+		close(ithread.notify[i]);
+		ithread.wake[i] = ithread.notify[i] = -1;
+	}
+
+	free(ithread.rings);
+	ithread.rings = NULL;
+	ithread.n_rings = 0;
+	ithread.running = false;
+}
+
+static void ithread_start()
+{
+	if (!ithread.enabled || ithread.running)
+		return;
+
+	if (-1 == pipe2(ithread.wake, O_NONBLOCK | O_CLOEXEC))
+		goto fail;
+
+	if (-1 == pipe2(ithread.notify, O_NONBLOCK | O_CLOEXEC)){
+		close(ithread.wake[0]);
+		close(ithread.wake[1]);
+		ithread.wake[0] = ithread.wake[1] = -1;
+		goto fail;
+	}
+
+	atomic_store(&ithread.shutdown, false);
+	ithread.running = true;
+
+	if (!ithread_resize() || 0 != pthread_create(
+		&ithread.thread, NULL, ithread_main, NULL)){
+		ithread.running = false;
+		for (size_t i = 0; i < 2; i++){
+			close(ithread.wake[i]);
+			close(ithread.notify[i]);
+			ithread.wake[i] = ithread.notify[i] = -1;
+		}
+		free(ithread.rings);
+		ithread.rings = NULL;
+		ithread.n_rings = 0;
+		goto fail;
+	}
+
+/* priority is best effort, same rules as for the rest of the process */
+	struct sched_param sp = {.sched_priority = sched_get_priority_min(SCHED_FIFO)};
+	if (0 != pthread_setschedparam(ithread.thread, SCHED_FIFO, &sp)){
+		verbose_print("input: couldn't raise input thread priority");
+	}
+
+	arcan_conductor_watch_fd(ithread.notify[0], POLLIN, ithread_notified, &ithread);
+	return;
+
+fail:
+	arcan_warning("input: couldn't setup input thread (%s), "
+		"reading from main thread\n", strerror(errno));
+}
+
+/*
+ * Replaces read(node->handle) in the handlers, with the thread running this
+ * consumes from the ring and reports a failed node as a read error.
+ */
+static ssize_t node_read(struct devnode* node, void* buf, size_t sz)
+{
+	if (!ithread.running)
+		return read(node->handle, buf, sz);
+
+	size_t i = node - iodev.nodes;
+	ssize_t rv = -1;
+
+	pthread_mutex_lock(&ithread.lock);
+	if (i >= ithread.n_rings){
+		errno = EAGAIN;
+		goto out;
+	}
+
+	struct input_ring* ring = &ithread.rings[i];
+	size_t avail = ring->head - ring->tail;
+	size_t want = sz / sizeof(struct input_event);
+
+	if (!avail || !want){
+		errno = ring->failed && !avail ? EIO : EAGAIN;
+		goto out;
+	}
+
+	bool full = avail == INPUT_RING_SZ;
+	if (want > avail)
+		want = avail;
+
+	struct input_event* dst = buf;
+	for (size_t j = 0; j < want; j++)
+		dst[j] = ring->buf[(ring->tail + j) % INPUT_RING_SZ];
+
+	ring->tail += want;
+	rv = want * sizeof(struct input_event);
+
+	if (full)
+		ithread_poke();
+
+out:
+	pthread_mutex_unlock(&ithread.lock);
+	return rv;
+}
+
+static bool node_pending(size_t i, uint64_t* stamp)
+{
+	bool rv = false;
+	pthread_mutex_lock(&ithread.lock);
+	if (i < ithread.n_rings){
+		rv = ithread.rings[i].failed ||
+			ithread.rings[i].head != ithread.rings[i].tail;
+		*stamp = ithread.rings[i].stamp;
+	}
+	pthread_mutex_unlock(&ithread.lock);
+	return rv;
+}
+
+/*
+ * The node descriptors are part of the conductor wait set, readiness is
+ * latched into the pollset revents and consumed in platform_event_process.
+ * The tag is the node index, with the high bit set for the led mirror as
+ * the mirror offset changes when the set grows.
+ */
+#define LED_TAG ((uintptr_t)1 << (sizeof(uintptr_t) * 8 - 1))
+
+static void node_ready(int fd, int revents, void* tag)
+{
+	uintptr_t ind = (uintptr_t) tag;
+	if (ind & LED_TAG)
+		ind = (ind & ~LED_TAG) + iodev.sz_nodes;
+
+	if (ind < iodev.sz_nodes * 2 && iodev.pollset[ind].fd == fd)
+		iodev.pollset[ind].revents |= revents;
+}
+
+static void watch_node(size_t i, bool led)
+{
+	uintptr_t tag = led ? i | LED_TAG : i;
+	int fd = iodev.pollset[led ? i + iodev.sz_nodes : i].fd;
+	arcan_conductor_unwatch_fd(-1, (void*) tag);
+
+	if (!led && ithread.running){
+		ithread_reset(i, fd);
+		return;
+	}
+
+	if (fd > 0)
+		arcan_conductor_watch_fd(fd, POLLIN, node_ready, (void*) tag);
+}
+
+static void unwatch_node(size_t i)
+{
+	arcan_conductor_unwatch_fd(-1, (void*) i);
+	arcan_conductor_unwatch_fd(-1, (void*) (i | LED_TAG));
+	ithread_reset(i, -1);
+}
+
 static void disconnect(struct arcan_evctx* ctx, struct devnode* node)
 {
 	struct arcan_event addev = {
@@ -637,6 +1048,7 @@ static void disconnect(struct arcan_evctx* ctx, struct devnode* node)
 
 	for (size_t i = 0; i < iodev.sz_nodes; i++)
 		if (node->devnum == iodev.nodes[i].devnum){
+			unwatch_node(i);
 			close(node->handle);
 			free(node->path);
 			node->path = NULL;
@@ -727,34 +1139,49 @@ void platform_event_process(struct arcan_evctx* ctx)
 			}
 	}
 #endif
+	process_opened(ctx);
+
 	TRACE_MARK_ENTER("event", "flush-pending-in", TRACE_SYS_DEFAULT, 0, 0, "flush-in");
 
 	if (gstate.pending)
 		process_pending(ctx);
 
-	int nr = poll(iodev.pollset, iodev.sz_nodes * 2, 0);
-	if (nr <= 0){
-		TRACE_MARK_EXIT("event", "flush-pending-in", TRACE_SYS_FAST, 0, 0, "flush-in");
-		return;
-	}
-
+/* revents are latched by node_ready when the conductor waits */
 	for (size_t i = 0; i < iodev.sz_nodes; i++){
 /* recall, sz_nodes is half the count, i + sz_nodes = alt-dev index */
 		if (iodev.pollset[i+iodev.sz_nodes].revents & POLLIN){
+			iodev.pollset[i+iodev.sz_nodes].revents = 0;
 			do_led(&iodev.nodes[i]);
 		}
 
+		if (ithread.running){
+			uint64_t stamp;
+			if (iodev.pollset[i].fd <= 0 || !node_pending(i, &stamp))
+				continue;
+
+			iodev.read_us = stamp;
+			if (iodev.nodes[i].hnd.handler)
+				iodev.nodes[i].hnd.handler(ctx, &iodev.nodes[i]);
+			else
+				defhandler_null(ctx, &iodev.nodes[i]);
+			continue;
+		}
+
 		if (iodev.pollset[i].fd == -1 || 0 == iodev.pollset[i].revents)
 			continue;
 
+		int revents = iodev.pollset[i].revents;
+		iodev.pollset[i].revents = 0;
+
 /* !POLLIN, then something is wrong, remove the node */
-		if (0 == (iodev.pollset[i].revents & POLLIN)){
+		if (0 == (revents & POLLIN)){
 			disconnect(ctx, &iodev.nodes[i]);
 			continue;
 		}
 /* some nodes may get a null handler temporarily or permanently assiged,
  * drain those for evdev structures */
 		else {
+			iodev.read_us = arcan_timemicros();
 			if (iodev.nodes[i].hnd.handler)
 				iodev.nodes[i].hnd.handler(ctx, &iodev.nodes[i]);
 			else{
@@ -1050,6 +1477,7 @@ static int alloc_node_slot(const char* path)
  * stays the same and got_device will still register so don't have
  * to consider leak for ledset */
 		if (iodev.nodes[i].path && strcmp(iodev.nodes[i].path, path) == 0){
+			unwatch_node(i);
 			close(iodev.nodes[i].handle);
 			iodev.n_devs--;
 			return i;
@@ -1091,6 +1519,9 @@ static int alloc_node_slot(const char* path)
 		iodev.pollset = newset;
 		hole = iodev.sz_nodes;
 		iodev.sz_nodes = new_cnt;
+
+		if (!ithread_resize())
+			return -1;
 	}
 
 	return hole;
@@ -1381,6 +1812,8 @@ static void got_device(struct arcan_evctx* ctx, int fd, const char* path)
 	iodev.pollset[hole].fd = fd;
 	iodev.pollset[hole].events = POLLIN | POLLERR | POLLHUP;
 	iodev.pollset[hole + iodev.sz_nodes].fd = BADFD;
+	unwatch_node(hole);
+	watch_node(hole, false);
 	send_device_added(ctx, &node);
 
 /* had to defer led device creation until now because we didn't
@@ -1391,6 +1824,7 @@ static void got_device(struct arcan_evctx* ctx, int fd, const char* path)
 		setup_led(&node, add_led, fd);
 		if (node.led.gotled){
 			iodev.pollset[hole+iodev.sz_nodes].fd = node.led.fds[0];
+			watch_node(hole, true);
 		}
 	}
 	iodev.nodes[hole] = node;
@@ -1418,14 +1852,15 @@ void platform_event_rescan_idev(struct arcan_evctx* ctx)
 	snprintf(ibuf, sizeof(ibuf), "%s/*", notify_scan_dir);
 
 	if (glob(ibuf, 0, NULL, &res) == 0){
-		char** beg = res.gl_pathv;
+/* one request for the whole set, this is also the path that runs on every
+ * VT switch back so it matters that it doesn't scale with the device count */
+		int fds[res.gl_pathc];
+		platform_device_open_batch((const char* const*) res.gl_pathv,
+			fds, res.gl_pathc, O_NONBLOCK | O_RDWR);
 
-		while(*beg){
-			int fd = platform_device_open(*beg, O_NONBLOCK | O_RDWR);
-			if (-1 != fd)
-				got_device(ctx, fd, *beg);
-			beg++;
-		}
+		for (size_t i = 0; i < res.gl_pathc; i++)
+			if (-1 != fds[i])
+				got_device(ctx, fds[i], res.gl_pathv[i]);
 
 		globfree(&res);
 	}
@@ -1482,7 +1917,7 @@ static void defhandler_kbd(
 	struct arcan_evctx* out, struct devnode* node)
 {
 	struct input_event inev[64];
-	ssize_t evs = read(node->handle, &inev, sizeof(inev));
+	ssize_t evs = node_read(node, &inev, sizeof(inev));
 
 	if (-1 == evs){
 		if (errno != EINTR && errno != EAGAIN)
@@ -1495,6 +1930,7 @@ static void defhandler_kbd(
 	arcan_event newev = {
 		.category = EVENT_IO,
 		.io = {
+			.pts = iodev.read_us,
 			.kind = EVENT_IO_BUTTON,
 			.devid = node->devnum,
 			.datatype = EVENT_IDATATYPE_TRANSLATED,
@@ -1578,6 +2014,7 @@ static void flush_pending(
 	arcan_event newev = {
 		.category = EVENT_IO,
 		.io = {
+		.pts = iodev.read_us,
 		.label = "touch",
 		.devid = node->devnum,
 		.subid = node->touch.ind + 128,
@@ -1664,6 +2101,7 @@ static void decode_hat(struct arcan_evctx* ctx,
 	arcan_event newev = {
 		.category = EVENT_IO,
 		.io = {
+			.pts = iodev.read_us,
 			.label = "gamepad",
 			.kind = EVENT_IO_BUTTON,
 			.devkind = EVENT_IDEVKIND_GAMEDEV,
@@ -1712,7 +2150,7 @@ static void decode_hat(struct arcan_evctx* ctx,
 static void defhandler_game(struct arcan_evctx* ctx, struct devnode* node)
 {
 	struct input_event inev[64];
-	ssize_t evs = read(node->handle, &inev, sizeof(inev));
+	ssize_t evs = node_read(node, &inev, sizeof(inev));
 
 	if (-1 == evs){
 		if (errno != EINTR && errno != EAGAIN)
@@ -1725,6 +2163,7 @@ static void defhandler_game(struct arcan_evctx* ctx, struct devnode* node)
 	arcan_event newev = {
 		.category = EVENT_IO,
 		.io = {
+			.pts = iodev.read_us,
 			.label = "gamepad",
 			.devkind = EVENT_IDEVKIND_GAMEDEV
 		}
@@ -1840,7 +2279,7 @@ static void defhandler_mouse(struct arcan_evctx* ctx,
 {
 	struct input_event inev[64];
 
-	ssize_t evs = read(node->handle, &inev, sizeof(inev));
+	ssize_t evs = node_read(node, &inev, sizeof(inev));
 
 	if (-1 == evs){
 		if (errno != EINTR && errno != EAGAIN)
@@ -1853,6 +2292,7 @@ static void defhandler_mouse(struct arcan_evctx* ctx,
 	arcan_event newev = {
 		.category = EVENT_IO,
 		.io = {
+			.pts = iodev.read_us,
 			.label = "mouse",
 			.devkind = EVENT_IDEVKIND_MOUSE,
 		}
@@ -1939,7 +2379,7 @@ static void defhandler_null(struct arcan_evctx* out,
 	struct devnode* node)
 {
 	char nbuf[256];
-	ssize_t evs = read(node->handle, nbuf, sizeof(nbuf));
+	ssize_t evs = node_read(node, nbuf, sizeof(nbuf));
 	if (-1 == evs){
 		if (errno != EINTR && errno != EAGAIN)
 			disconnect(out, node);
@@ -1980,6 +2420,11 @@ void platform_event_deinit(struct arcan_evctx* ctx)
 /* note, for VT switching this means that the state of devices when it comes
  * to filtering etc. do not persist between external launches, should rework
  * this */
+	for (size_t i = 0; i < iodev.sz_nodes; i++)
+		unwatch_node(i);
+
+	ithread_stop();
+
 	for (size_t i = 0; i < iodev.n_devs; i++){
 		if (iodev.nodes[i].handle > 0){
 			verbose_print("closing %zu:%d", i, iodev.nodes[i].handle);
@@ -2120,6 +2565,9 @@ void platform_event_init(arcan_evctx* ctx)
 		notify_scan_dir = newsd;
 	}
 
+	ithread.enabled = get_config("event_input_thread", 0, NULL, tag);
+	ithread_start();
+
 /* chances are the CREATE events are actually racey, but with the
  * _device_open refactor this won't really matter as the suid part
  * allows us access anyway */
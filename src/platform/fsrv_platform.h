@@ -34,6 +34,19 @@ struct arcan_frameserver* platform_fsrv_listen_external(
 	const char* key, const char* auth,	int fd, mode_t mode,
 	size_t w, size_t h, uintptr_t tag);
 
+/*
+ * Split form of listen_external for keeping a segment ready ahead of time.
+ * _prepare allocates and maps the page without any connection point and
+ * _bind attaches it to the listening [key] / [fd], same arguments as in
+ * listen_external. On failure in _bind, [seg] is left unbound and can be
+ * destroyed or kept.
+ */
+struct arcan_frameserver* platform_fsrv_listen_prepare(
+	mode_t mode, size_t w, size_t h);
+
+bool platform_fsrv_listen_bind(struct arcan_frameserver* seg,
+	const char* key, const char* auth, int fd, uintptr_t tag);
+
 /*
  * Build a frameserver context that can be used either in-process or forwarded
  * to a new process. Note that this will only prepare the context and resources
@@ -124,6 +137,19 @@ void platform_fsrv_enter(struct arcan_frameserver*, jmp_buf ctx);
 void platform_fsrv_leave(void);
 size_t platform_fsrv_clock(void);
 
+/*
+ * Threads other than the main one that read from the shared memory of a
+ * frameserver (audio mixing) do so with the shm read lock held, and still
+ * within _enter/_leave. While held, the mapping won't be remapped or dropped.
+ * A bus error on such a thread unwinds but leaves dropping the segment to the
+ * main thread.
+ *
+ * _shmlock is the exclusive side, taken (recursively) by the frameserver
+ * platform around remapping and dropping the mapping.
+ */
+void platform_fsrv_shmread(bool lock);
+void platform_fsrv_shmlock(bool lock);
+
 /*
  * disconnect, clean up resources, free. The connection should be considered
  * alive (not just _alloc call) or it will return false. State of *src is
@@ -152,6 +178,26 @@ struct arcan_frameserver* platform_fsrv_alloc(void);
  */
 int platform_fsrv_pushevent(struct arcan_frameserver*, struct arcan_event*);
 
+/*
+ * copy up to [n] events to the outgoing queue of the frameserver with a
+ * single update of the queue index and a single wakeup. Returns the number
+ * of events consumed from [ev], including those that were dropped due to
+ * the device/data mask, stops short when the queue is full.
+ */
+size_t platform_fsrv_pushevents(
+	struct arcan_frameserver*, struct arcan_event* ev, size_t n);
+
+/*
+ * Explicit video slot management for the FIFO/MAILBOX/IMMEDIATE swapchain
+ * models (fsrv->vswap != 0). _pick returns the slot that should be presented
+ * at [now] (arcan_timemillis) or -1, _acquire also takes ownership of it and
+ * drops any frames it supersedes. _release returns the acquired slot to the
+ * client and updates vready, the caller is responsible for waking the client.
+ */
+int platform_fsrv_vslot_pick(struct arcan_frameserver*, uint64_t now);
+int platform_fsrv_vslot_acquire(struct arcan_frameserver*, uint64_t now);
+void platform_fsrv_vslot_release(struct arcan_frameserver*);
+
 /*
  * Determine if the connected end is still alive or not,
  * this is treated as a poll -> state transition
@@ -164,6 +210,25 @@ bool platform_fsrv_validchild(struct arcan_frameserver*);
  */
 int platform_fsrv_pushfd(struct arcan_frameserver*, struct arcan_event*, int);
 
+/*
+ * If the segment page is not reachable by its key (memfd), send the page
+ * descriptor over the connection socket. This is done automatically for
+ * subsegments and as part of socketauth, ones from spawn_server that skip
+ * the authentication leave it to the caller as the socket might be needed
+ * for other things first.
+ */
+bool platform_fsrv_pushshm(struct arcan_frameserver*);
+
+/*
+ * Map the shared memory descriptor in src->vstream.pool (read-only) and
+ * return the base, the mapped size is set in vstream.pool.map_sz. The mapping
+ * is kept and reused for as long as the descriptor refers to the same file of
+ * the same size. Descriptors that are not sealed against shrinking are
+ * rejected as a truncation would fault on reading. With [release] set, any
+ * cached mapping is dropped and NULL is returned.
+ */
+uint8_t* platform_fsrv_mappool(struct arcan_frameserver*, bool release);
+
 /*
  * Update the static / shared default audio buffer size that is provided if
  * the client doesn't request a specific one. Returns the previous value.
@@ -13,6 +13,7 @@
  * [ ] map_handle should be shared with egl-dri
  * [ ] let DPMS state and map_handle(BADID) reflect in encode-output
  * [ ] "resolution" switch reflect in encode output
+ * [ ] pass exported buffers to the sinks instead of readback
  */
 
 #include <stdlib.h>
@@ -50,10 +51,21 @@
 #include <xf86drm.h>
 #include <gbm.h>
 
-static struct {
+#ifndef HEADLESS_DISPLAYS
+#define HEADLESS_DISPLAYS 8
+#endif
+
+/*
+ * Each virtual display has its own mapping and optional encode sink, display
+ * 0 is the default output and always mapped to the world unless told
+ * otherwise. The others stay unmapped until map_video_display.
+ */
+struct headless_display {
 	size_t width;
 	size_t height;
-	int deadline;
+	bool mapped;
+	bool announced;
+	struct agp_vstore* vstore;
 
 	struct {
 		struct arcan_frameserver* outctx;
@@ -62,6 +74,21 @@ static struct {
 		bool block;
 	} encode;
 
+/* frames handed to the sink, frames dropped as the sink was busy and the
+ * moving average for readback and copy */
+	struct {
+		size_t frames;
+		size_t dropped;
+		double cost_us;
+	} stats;
+};
+
+static struct {
+	int deadline;
+	bool uncapped;
+	size_t n_displays;
+	struct headless_display displays[HEADLESS_DISPLAYS];
+
 	struct {
 		EGLDisplay disp;
 		EGLContext ctx;
@@ -70,12 +97,14 @@ static struct {
 		EGLNativeWindowType wnd;
 		struct gbm_device* gbmdev;
 	} egl;
-
-	struct agp_vstore* vstore;
 } global = {
 	.deadline = 13,
-	.encode = {
-		.flip_y = true
+	.n_displays = 1,
+	.displays[0] = {
+		.mapped = true,
+		.encode = {
+			.flip_y = true
+		}
 	}
 };
 
@@ -98,30 +127,48 @@ static char* envopts[] = {
 	"Use encode frameserver as virtual output, see afsrv_encode for format",
 	"ARCAN_VIDEO_DISABLE_PLATFORM=1",
 	"Use the EGL default for the GL display rather than go through gbm/mesa",
+	"ARCAN_VIDEO_ENCODE_n=encode_args",
+	"Encode frameserver as sink for virtual display n (1..)",
+	"ARCAN_VIDEO_DISPLAYS=n",
+	"Number of virtual displays (default 1, max 8)",
 	"ARCAN_VIDEO_REFRESH=n",
-	"Set the simulated vsynch to n Hz",
+	"Set the simulated vsynch to n Hz, 0 renders uncapped",
 	"ARCAN_VIDEO_DEVICE=/dev/dri/renderD128",
 	"Set the render node to an explicit path",
 	NULL
 };
 
-static void spawn_encode_output()
+static struct headless_display* get_display(platform_display_id id)
+{
+	if (id < 0 || id >= global.n_displays)
+		return NULL;
+
+	return &global.displays[id];
+}
+
+static void spawn_encode_output(struct headless_display* d)
 {
 /*
  * Terminate a current / pending connection if one can be found
  */
-	if (global.encode.outctx){
-		arcan_frameserver_free(global.encode.outctx);
-		global.encode.outctx = NULL;
+	if (d->encode.outctx){
+		arcan_frameserver_free(d->encode.outctx);
+		d->encode.outctx = NULL;
 	}
 
 /*
- * Get the parameters / options from the config- layer
+ * Get the parameters / options from the config- layer, the default display
+ * uses the plain key and the others are suffixed with the display index
  */
 	uintptr_t tag;
 	char* enc_arg;
+	char key[32] = "video_encode";
+	size_t ind = d - global.displays;
+	if (ind)
+		snprintf(key, sizeof(key), "video_encode_%zu", ind);
+
 	cfg_lookup_fun get_config = platform_config_lookup(&tag);
-	if (!get_config("video_encode", 0, &enc_arg, tag))
+	if (!get_config(key, 0, &enc_arg, tag))
 		return;
 
 /*
@@ -132,24 +179,26 @@ static void spawn_encode_output()
 		.custom_feed = 0xfeedface,
 		.args.builtin.mode = "encode",
 		.args.builtin.resource = enc_arg,
-		.init_w = global.width,
-		.init_h = global.height
+		.init_w = d->width,
+		.init_h = d->height
 	};
 	struct arcan_frameserver* fsrv = platform_launch_fork(&args, 0);
 	if (!fsrv){
-		arcan_warning("(headless) couldn't spawn afsrv_encode\n");
+		arcan_warning("(headless) couldn't spawn afsrv_encode for %zu\n", ind);
 		return;
 	}
-	debug_print("encode display output enabled");
-	global.encode.outctx = fsrv;
+	debug_print("encode display output enabled on %zu", ind);
+	d->encode.outctx = fsrv;
 }
 
 void platform_video_shutdown()
 {
 	debug_print("shutting down");
-	if (global.encode.outctx){
-		arcan_frameserver_free(global.encode.outctx);
-	}
+	for (size_t i = 0; i < global.n_displays; i++)
+		if (global.displays[i].encode.outctx){
+			arcan_frameserver_free(global.displays[i].encode.outctx);
+			global.displays[i].encode.outctx = NULL;
+		}
 }
 
 void platform_video_prepare_external()
@@ -202,27 +251,52 @@ void platform_video_reset(int id, int swap)
 {
 }
 
+/*
+ * The default display follows the canvas, the others can be resized freely
+ * which also respawns their sink to match
+ */
 bool platform_video_specify_mode(platform_display_id disp, struct monitor_mode mode)
 {
-	return false;
+	struct headless_display* d = get_display(disp);
+	if (!d || !disp || !mode.width || !mode.height)
+		return false;
+
+	if (d->width == mode.width && d->height == mode.height)
+		return true;
+
+	d->width = mode.width;
+	d->height = mode.height;
+
+	if (d->encode.outctx){
+		arcan_frameserver_free(d->encode.outctx);
+		d->encode.outctx = NULL;
+	}
+	d->encode.check_output = false;
+
+	return true;
 }
 
 /*
  * called as external from the headless input platform
  */
-int headless_flush_encode_events()
+static int flush_encode_events(struct headless_display* d)
 {
-	if (!global.encode.outctx)
+	if (!d->encode.outctx)
 		return FRV_NOFRAME;
 
 /* Prevent control_chld from emitting events about the state of the frameserver
  * (it doesn't exist in the lua space) and instead substitute it with the exit
- * request. Ideally we should probably just switch into a wait-relaunch pattern */
+ * request. Ideally we should probably just switch into a wait-relaunch pattern.
+ * Only the default display is tied to the lifecycle, other sinks just go. */
 	arcan_event_maskall(arcan_event_defaultctx());
-	if (!arcan_frameserver_control_chld(global.encode.outctx)){
-		arcan_warning("(headless) output encoder died\n");
-		global.encode.outctx = NULL;
+	if (!arcan_frameserver_control_chld(d->encode.outctx)){
+		arcan_warning("(headless) output encoder for %zu died\n",
+			(size_t)(d - global.displays));
+		d->encode.outctx = NULL;
 		arcan_event_clearmask(arcan_event_defaultctx());
+		if (d != global.displays)
+			return FRV_NOFRAME;
+
 		arcan_event ev = {
 			.category = EVENT_SYSTEM,
 			.sys.kind = EVENT_SYSTEM_EXIT,
@@ -233,12 +307,12 @@ int headless_flush_encode_events()
 	}
 	arcan_event_clearmask(arcan_event_defaultctx());
 
-	TRAMP_GUARD(FRV_NOFRAME, global.encode.outctx);
+	TRAMP_GUARD(FRV_NOFRAME, d->encode.outctx);
 	arcan_event inev;
 
 /* !arcan_frameserver_control_chld -> _free() -> TERMINATED event */
 
-	while (arcan_event_poll(&global.encode.outctx->inqueue, &inev) > 0){
+	while (arcan_event_poll(&d->encode.outctx->inqueue, &inev) > 0){
 /* allow IO events to be forwarded as if the encode frameserver was actually
  * an input device (which in the remoting stage it is) */
 		if (inev.category == EVENT_IO){
@@ -260,14 +334,29 @@ int headless_flush_encode_events()
 	return FRV_NOFRAME;
 }
 
-static int readback_encode()
+int headless_flush_encode_events()
+{
+	for (size_t i = 0; i < global.n_displays; i++)
+		flush_encode_events(&global.displays[i]);
+
+	return FRV_NOFRAME;
+}
+
+/*
+ * returns -1 if there is nothing to present, 0 if the sink is still busy
+ * with the last frame and 1 if the frame was handed over (or unchanged)
+ */
+static int readback_encode(struct headless_display* d)
 {
+	if (!d->mapped || d->encode.block)
+		return -1;
+
 /* other side is still encoding / synching so don't overwrite the buffer */
-	struct arcan_frameserver* out = global.encode.outctx;
-	TRAMP_GUARD(0, out);
+	struct arcan_frameserver* out = d->encode.outctx;
+	TRAMP_GUARD(-1, out);
 
 /* not finished, fake it until we finish */
-	if (out->shm.ptr->vready || global.encode.block){
+	if (out->shm.ptr->vready){
 		platform_fsrv_leave();
 		return 0;
 	}
@@ -275,7 +364,7 @@ static int readback_encode()
 /* even if the store sizes have changed for some reason, we crop to the smallest */
 	agp_activate_rendertarget(NULL);
 
-	struct agp_vstore* vs = global.vstore ? global.vstore : arcan_vint_world();
+	struct agp_vstore* vs = d->vstore ? d->vstore : arcan_vint_world();
 	size_t row_len = vs->w > out->desc.width ? out->desc.width : vs->w;
 	size_t row_sz = row_len * sizeof(av_pixel);
 	size_t n_rows = vs->h > out->desc.height ? out->desc.height : vs->h;
@@ -305,7 +394,7 @@ static int readback_encode()
 	size_t dst_row = n_rows - 1;
 	int dst_step = -1;
 
-	if (!global.encode.flip_y){
+	if (!d->encode.flip_y){
 		dst_row = 0;
 		dst_step = 1;
 	}
@@ -358,28 +447,58 @@ static int readback_encode()
 	}
 
 /* flag ok and commit dirty region */
-	global.encode.outctx->shm.ptr->hints |= SHMIF_RHINT_SUBREGION;
+	out->shm.ptr->hints |= SHMIF_RHINT_SUBREGION;
 
 	struct arcan_shmif_region dirty = {
 		.x1 = x1, .y1 = y1,
 		.x2 = x2, .y2 = y2
 	};
 
-	atomic_store(&global.encode.outctx->shm.ptr->dirty, dirty);
-	atomic_store_explicit(
-		&global.encode.outctx->shm.ptr->vready, true, memory_order_seq_cst);
+	atomic_store(&out->shm.ptr->dirty, dirty);
+	atomic_store_explicit(&out->shm.ptr->vready, true, memory_order_seq_cst);
 
 /* encode has more explicit frame signalling until we have futexes */
-	platform_fsrv_pushevent(global.encode.outctx, &(struct arcan_event){
+	platform_fsrv_pushevent(out, &(struct arcan_event){
 		.tgt.kind = TARGET_COMMAND_STEPFRAME,
 		.category = EVENT_TARGET,
-		.tgt.ioevs[0] = global.encode.outctx->vfcount++
+		.tgt.ioevs[0] = out->vfcount++
 	});
 
 	platform_fsrv_leave();
 	return 1;
 }
 
+/*
+ * Hand the frame to the sink of a display. With a refresh set, try to synch
+ * it or 'fake-+yield' until synch succeeded. Uncapped, a busy sink means the
+ * frame is dropped for that display rather than stalling the others.
+ */
+static void present_display(struct headless_display* d, unsigned long deadline)
+{
+	uint64_t start = arcan_timemicros();
+	int rv;
+
+	while (0 == (rv = readback_encode(d)) && !global.uncapped){
+		arcan_conductor_phase(CONDUCTOR_PHASE_SCANOUT);
+		unsigned step = arcan_conductor_yield(NULL, 0);
+		if (arcan_timemillis() + step < deadline)
+			arcan_timesleep(step);
+		start = arcan_timemicros();
+	}
+	arcan_conductor_phase(CONDUCTOR_PHASE_SWAP);
+
+	if (0 == rv){
+		d->stats.dropped++;
+		return;
+	}
+
+	if (1 == rv){
+		d->stats.frames++;
+		d->stats.cost_us = 0.8 * d->stats.cost_us +
+			0.2 * (double)(arcan_timemicros() - start);
+	}
+}
+
 void platform_video_synch(uint64_t tick_count, float fract,
 	video_synchevent pre, video_synchevent post)
 {
@@ -390,9 +509,12 @@ void platform_video_synch(uint64_t tick_count, float fract,
  * we can't spawn this in platform init as the agp_ and video stack context
  * isn't available at that stage so it needs to be deferred here
  */
-	if (!global.encode.check_output && !global.encode.outctx){
-		global.encode.check_output = true;
-		spawn_encode_output();
+	for (size_t i = 0; i < global.n_displays; i++){
+		struct headless_display* d = &global.displays[i];
+		if (!d->encode.check_output && !d->encode.outctx){
+			d->encode.check_output = true;
+			spawn_encode_output(d);
+		}
 	}
 
 /*
@@ -400,26 +522,29 @@ void platform_video_synch(uint64_t tick_count, float fract,
  */
 	size_t nd;
 	arcan_bench_register_cost( arcan_vint_refresh(fract, &nd) );
+	arcan_conductor_phase(CONDUCTOR_PHASE_SWAP);
 
-/*
- * if there is no encoder listening run with the estimated fake synch
- */
-	if (!nd || !global.encode.outctx){
-		arcan_conductor_fakesynch(global.deadline);
+	bool sinks = false;
+	unsigned long deadline = arcan_timemillis() + global.deadline;
+
+	for (size_t i = 0; nd && i < global.n_displays; i++){
+		struct headless_display* d = &global.displays[i];
+		if (d->encode.outctx){
+			sinks = true;
+			present_display(d, deadline);
+		}
 	}
 
 /*
- * if there is an encoder set, try to synch it or 'fake-+yield' until
- * the deadline has elapsed or synch succeeded
+ * if there is no encoder listening run with the estimated fake synch, when
+ * uncapped only yield if there was nothing to draw so that the clients can
+ * wake us up again
  */
-	else{
-		unsigned long deadline = arcan_timemillis() + global.deadline;
-
-		while (!readback_encode()){
-			unsigned step = arcan_conductor_yield(NULL, 0);
-			if (arcan_timemillis() + step < deadline)
-				arcan_timesleep(step);
-		}
+	if (!sinks){
+		if (!global.uncapped)
+			arcan_conductor_fakesynch(global.deadline);
+		else if (!nd)
+			arcan_conductor_fakesynch(1);
 	}
 
 	if (post)
@@ -442,20 +567,37 @@ const char** platform_video_envopts()
 	return (const char**) envopts;
 }
 
+/*
+ * the default display is implied, the others are announced once so that the
+ * scripts can find and map them
+ */
 void platform_video_query_displays()
 {
+	for (size_t i = 1; i < global.n_displays; i++){
+		if (global.displays[i].announced)
+			continue;
+
+		global.displays[i].announced = true;
+		arcan_event_enqueue(arcan_event_defaultctx(), &(struct arcan_event){
+			.category = EVENT_VIDEO,
+			.vid.kind = EVENT_VIDEO_DISPLAY_ADDED,
+			.vid.displayid = i
+		});
+	}
 }
 
 size_t platform_video_displays(platform_display_id* dids, size_t* lim)
 {
-	if (dids && lim && *lim > 0){
-		dids[0] = 0;
+	size_t count = 0;
+	if (dids && lim){
+		for (; count < *lim && count < global.n_displays; count++)
+			dids[count] = count;
 	}
 
 	if (lim)
-		*lim = 1;
+		*lim = count;
 
-	return 1;
+	return global.n_displays;
 }
 
 bool platform_video_map_handle(struct agp_vstore* dst, int64_t handle)
@@ -472,8 +614,8 @@ bool platform_video_set_mode(platform_display_id disp,
 struct monitor_mode platform_video_dimensions()
 {
 	return (struct monitor_mode){
-		.width = global.width,
-		.height = global.height
+		.width = global.displays[0].width,
+		.height = global.displays[0].height
 	};
 }
 
@@ -481,10 +623,17 @@ struct monitor_mode* platform_video_query_modes(
 	platform_display_id id, size_t* count)
 {
 	static struct monitor_mode mode = {};
-	mode.width  = global.width;
-	mode.height = global.height;
+	struct headless_display* d = get_display(id);
+	if (!d){
+		*count = 0;
+		return NULL;
+	}
+
+	mode.width  = d->width;
+	mode.height = d->height;
 	mode.depth  = sizeof(av_pixel) * 8;
-	mode.refresh = 60; /* should be queried */
+	mode.refresh = global.uncapped || !global.deadline ?
+		0 : 1000 / global.deadline;
 
 	*count = 1;
 	return &mode;
@@ -510,7 +659,8 @@ bool platform_video_map_display(
 ssize_t platform_video_map_display_layer(arcan_vobj_id id,
 	platform_display_id disp, size_t layer_index, struct display_layer_cfg cfg)
 {
-	if (disp != 0 || layer_index > 0)
+	struct headless_display* d = get_display(disp);
+	if (!d || layer_index > 0)
 		return -1;
 
 	arcan_vobject* vobj = arcan_video_getobject(id);
@@ -518,27 +668,28 @@ ssize_t platform_video_map_display_layer(arcan_vobj_id id,
 /*
  * unmap any existing one
  */
-	if (global.vstore && global.vstore != arcan_vint_world()){
-		arcan_vint_drop_vstore(global.vstore);
-		global.vstore = NULL;
+	if (d->vstore && d->vstore != arcan_vint_world()){
+		arcan_vint_drop_vstore(d->vstore);
+		d->vstore = NULL;
 	}
 
 /*
  * disable output temporarily if it's there
  */
 	if (id == ARCAN_EID){
-		global.encode.block = true;
+		d->encode.block = true;
 		return 0;
 	}
 
-	global.encode.block = false;
+	d->encode.block = false;
+	d->mapped = true;
 
 /*
  * switch to the global output
  */
 	if (id == ARCAN_VIDEO_WORLDID || !vobj){
 		arcan_warning("(headless) map display, worldid or no object, invert-y\n");
-		global.encode.flip_y = true;
+		d->encode.flip_y = true;
 		return 0;
 	}
 
@@ -555,9 +706,9 @@ ssize_t platform_video_map_display_layer(arcan_vobj_id id,
  */
 	vobj->vstore->refcount++;
 	bool isrt = arcan_vint_findrt(vobj) != NULL;
-	global.encode.flip_y = !isrt;
-	global.vstore = vobj->vstore;
-	arcan_warning("(headless) mapped source, invert-y: %d\n", global.encode.flip_y);
+	d->encode.flip_y = !isrt;
+	d->vstore = vobj->vstore;
+	arcan_warning("(headless) mapped source, invert-y: %d\n", d->encode.flip_y);
 
 	return 0;
 }
@@ -576,15 +727,100 @@ bool platform_video_map_buffer(
 	return false;
 }
 
+size_t platform_video_export_vstore(
+	struct agp_vstore* vs, struct agp_buffer_plane* planes, size_t n)
+{
+	return 0;
+}
+
+size_t platform_video_scanout_formats(
+	uint32_t* formats, uint64_t* modifiers, size_t n)
+{
+	return 0;
+}
+
+int platform_video_release_fence(struct agp_vstore* vs, size_t* held)
+{
+	return -1;
+}
+
+/*
+ * the per display sink statistics are appended so that the cost of a session
+ * can be measured from the scripts (system_identstr) when packing several
+ */
 const char* platform_video_capstr()
 {
-	return "Video Platform (HEADLESS)";
+	static char* buf;
+	static size_t buf_sz;
+
+	if (buf){
+		free(buf);
+		buf = NULL;
+	}
+
+	FILE* stream = open_memstream(&buf, &buf_sz);
+	if (!stream)
+		return "Video Platform (HEADLESS)";
+
+	fprintf(stream, "Video Platform (HEADLESS)\n");
+	if (global.uncapped)
+		fprintf(stream, "Refresh: uncapped\n");
+	else
+		fprintf(stream, "Refresh: %d ms\n", global.deadline);
+
+	for (size_t i = 0; i < global.n_displays; i++){
+		struct headless_display* d = &global.displays[i];
+		fprintf(stream, "Display %zu: %zux%zu sink=%s"
+			" frames=%zu dropped=%zu cost_us=%.0f\n",
+			i, d->width, d->height, d->encode.outctx ? "encode" : "none",
+			d->stats.frames, d->stats.dropped, d->stats.cost_us);
+	}
+
+	fclose(stream);
+	return buf;
 }
 
 void platform_video_preinit()
 {
 }
 
+static void load_config()
+{
+	uintptr_t tag;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+	char* node;
+
+/*
+ * Default is ~75Hz (no real need to be very precise, but % logic clock) Then
+ * let user override. This will only be effective if we don't tie the output to
+ * the encode/remoting stage.
+ */
+	if (get_config("video_refresh", 0, &node, tag)){
+		float hz = strtof(node, NULL);
+		if (hz > 0.0)
+			global.deadline = 1000.0 / hz;
+		else
+			global.uncapped = true;
+		free(node);
+		debug_print("deadline changed to %d", global.deadline);
+	}
+
+/* the extra displays start unmapped with the same dimensions as the first */
+	if (get_config("video_displays", 0, &node, tag)){
+		unsigned long n = strtoul(node, NULL, 10);
+		free(node);
+		global.n_displays = n < 1 ? 1 : (n > HEADLESS_DISPLAYS ? HEADLESS_DISPLAYS : n);
+
+		for (size_t i = 1; i < global.n_displays; i++){
+			global.displays[i] = (struct headless_display){
+				.width = global.displays[0].width,
+				.height = global.displays[0].height,
+				.encode.flip_y = true
+			};
+		}
+	}
+}
+
 static void* lookup_fenv(void* tag, const char* sym, bool req)
 {
 	return eglGetProcAddress(sym);
@@ -593,14 +829,20 @@ static void* lookup_fenv(void* tag, const char* sym, bool req)
 bool platform_video_init(uint16_t width,
 	uint16_t height, uint8_t bpp, bool fs, bool frames, const char* capt)
 {
-	global.width = width;
-	global.height = height;
+	global.displays[0].width = width;
+	global.displays[0].height = height;
 
 /* some trival default as default is -w 0 -h 0 */
-	if (!global.width)
-		global.width = 640;
-	if (!global.height)
-		global.height = 480;
+	if (!global.displays[0].width)
+		global.displays[0].width = 640;
+	if (!global.displays[0].height)
+		global.displays[0].height = 480;
+
+	load_config();
+
+/* the software rasterizer has no context or display to set up */
+	if (strcmp(agp_ident(), "SOFT") == 0)
+		return true;
 
 	const EGLint attribs[] = {
 		EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
@@ -719,20 +961,6 @@ bool platform_video_init(uint16_t width,
 		return false;
 	}
 
-/*
- * Default is ~75Hz (no real need to be very precise, but % logic clock) Then
- * let user override. This will only be effective if we don't tie the output to
- * the encode/remoting stage.
- */
-	char* node;
-	if (get_config("video_refresh", 0, &node, tag)){
-		float hz = strtoul("node", NULL, 10);
-		if (hz)
-			global.deadline = 1.0 / hz;
-		free(node);
-		debug_print("deadline changed to %d", global.deadline);
-	}
-
 	EGLint cas[] = {
 		EGL_CONTEXT_CLIENT_VERSION, 2,
 		EGL_NONE, EGL_NONE,
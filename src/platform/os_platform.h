@@ -30,6 +30,16 @@ int arcan_sem_trywait(sem_handle sem);
 int arcan_sem_init(sem_handle*, unsigned value);
 int arcan_sem_destroy(sem_handle);
 
+/*
+ * Release a handle retrieved through the shared namespace (sem_close for the
+ * named semaphores). For ARCAN_SHMIF_FUTEX builds, the synchronization words
+ * live in the shared page instead, and _bind (re-)attaches a handle to such a
+ * word pair (allocating if [sem] is NULL). Without futex support, _bind is a
+ * no-op that returns [sem].
+ */
+int arcan_sem_close(sem_handle);
+sem_handle arcan_sem_bind(sem_handle sem, _Atomic uint32_t* words);
+
 /*
  * Launch the specified program and bind its resources and control to the
  * returned frameserver instance (NULL if spawn was not possible for some
@@ -232,6 +242,29 @@ unsigned arcan_glob(char* basename,
 unsigned arcan_glob_userns(char* basename,
 	const char* userns, void (*cb)(char*, void*), void* tag);
 
+/*
+ * implemented in <platform>/resindex.c
+ * Cache the directory structure below <root> (typically the appl path) and
+ * keep it current, and hint the appl scripts into the page cache. Calling it
+ * again replaces the previous root, NULL disables the index.
+ */
+void arcan_resindex_build(const char* root);
+
+/*
+ * Check an absolute <path> against the index, returns 1 for a file, 2 for a
+ * directory, 0 if it does not exist and -1 if the index can't tell (outside
+ * of the root, symlinks, index disabled).
+ */
+int arcan_resindex_lookup(const char* path);
+
+/*
+ * Match the last path component of the absolute <pattern> against the index
+ * and invoke <cb(basename, tag)> for each entry in sorted order. Returns the
+ * number of matches or -1 if the pattern should go through glob() instead.
+ */
+ssize_t arcan_resindex_glob(
+	const char* pattern, void (*cb)(char*, void*), void* tag);
+
 /* replace the thread_local logging output destination with outf.
  * This can be null (and by default is null) in order to disable log output */
 void arcan_log_destination(FILE* outf, int minlevel);
@@ -182,6 +182,30 @@ char* platform_dbstore_path();
  */
 int platform_device_open(const char* identifier, int flags);
 
+/*
+ * open [n] devices in one go, [fds] gets the handle (or -1) for each entry in
+ * [identifiers]. Where there is an intermediate process this costs a single
+ * round-trip rather than one per device. Returns the number of devices that
+ * could be opened.
+ */
+size_t platform_device_open_batch(
+	const char* const* identifiers, int* fds, size_t n, int flags);
+
+/*
+ * request a device to be opened without waiting for the result. If it can
+ * be satisfied immediately, the handle is returned as with _open, otherwise
+ * -1 is returned and errno is set to EINPROGRESS. The outcome is retrieved
+ * through _open_result.
+ */
+int platform_device_open_async(const char* identifier, int flags);
+
+/*
+ * collect the outcome of a previous _open_async request, returns 1 and stores
+ * a copy of the identifier (caller assumes ownership) and the handle (or -1
+ * with errno set) into [fd], 0 if there is nothing pending.
+ */
+int platform_device_open_result(char** identifier, int* fd);
+
 /*
  * special devices, typically gpu nodes and ttys, need and explicit privilege
  * side release- action as well. The idhint is special for TTY-swap
@@ -207,6 +207,9 @@ enum agp_shader_envts{
 
 	FRACT_TIMESTAMP_F = 12,
 	TIMESTAMP_D       = 13,
+
+/* late-latch correction for VR eye composition, see arcan_vr_reprojection */
+	VR_REPROJECT      = 14
 };
 
 /*
@@ -246,6 +249,10 @@ struct agp_vstore {
 	size_t refcount;
 	uint32_t update_ts;
 
+/* incremented on each change to the contents, unlike update_ts this can be
+ * used to detect changes between two frames drawn within the same tick */
+	size_t update_seq;
+
 	union {
 		struct {
 /* ID number connecting to AGP, this MAY be bound diretly to the glid
@@ -253,8 +260,9 @@ struct agp_vstore {
 			unsigned glid;
 			unsigned* glid_proxy;
 
-/* used for PBO transfers */
-			unsigned rid, wid;
+/* used for PBO transfers, readbacks go through a ring (see glshared.c) */
+			unsigned wid;
+			struct agp_rbring* rbring;
 
 /* intermediate storage for reconstructing lost context */
 			uint32_t s_raw;
@@ -288,6 +296,11 @@ struct agp_vstore {
 			size_t stride;
 			int64_t handle;
 			uintptr_t tag;
+
+/* raw holds blocks in this format (enum agp_compressed_format), s_raw bytes
+ * covering [mip_levels] levels that follow each other, largest first */
+			uint8_t compressed;
+			uint8_t mip_levels;
 		} text;
 
 		struct {
@@ -307,6 +320,7 @@ struct agp_vstore {
 	struct {
 		int model;
 		struct drm_hdr_meta drm;
+		int depth; /* enum vstore_hint of the storage format */
 	} hdr;
 };
 
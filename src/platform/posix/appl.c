@@ -133,6 +133,9 @@ bool arcan_verifyload_appl(const char* appl_id, const char** errc)
 		return false;
 	}
 
+/* appl resources are looked up (and globbed) repeatedly, cache the tree */
+	arcan_resindex_build(arcan_fetch_namespace(RESOURCE_APPL));
+
 /*
  * Switch to appl- suppled fonts if a folder exists to avoid relying on res
  * namespace pollution. Specific settings can still pin the namespace to
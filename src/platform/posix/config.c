@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <strings.h>
 #include <ctype.h>
+#include <pthread.h>
 #include "../platform.h"
 #include "../../engine/arcan_math.h"
 #include "../../engine/arcan_general.h"
@@ -14,6 +15,10 @@
 
 static uintptr_t token = 0xdeadbabe;
 
+/* the database handle is not safe to share, this keeps lookups from helper
+ * threads during startup (audio) apart from those on the main thread */
+static pthread_mutex_t db_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static bool lookup(const char* const key,
 	unsigned short ind, char** val, uintptr_t tag)
 {
@@ -43,12 +48,15 @@ static bool lookup(const char* const key,
 /* fallback to database- config in arcan appl- space */
 	if (!test){
 		const char* appl;
-		struct arcan_dbh* dbh = arcan_db_get_shared(&appl);
 		if (ind > 0)
 			snprintf(tmpbuf, sizeof(tmpbuf), "%s_%"PRIu16, key, ind);
 		else
 			snprintf(tmpbuf, sizeof(tmpbuf), "%s", key);
+
+		pthread_mutex_lock(&db_lock);
+		struct arcan_dbh* dbh = arcan_db_get_shared(&appl);
 		test = arcan_db_appl_val(dbh, appl, tmpbuf);
+		pthread_mutex_unlock(&db_lock);
 		if (test && val){
 			*val = test;
 		}
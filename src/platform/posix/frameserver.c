@@ -101,7 +101,7 @@ static void* nanny_thread(void* arg)
 	return NULL;
 }
 
-static size_t shmpage_size(size_t w, size_t h,
+static size_t shmpage_size(size_t w, size_t h, int meta,
 	size_t vbufc, size_t abufc, int abufsz, size_t apad)
 {
 #ifdef ARCAN_SHMIF_OVERCOMMIT
@@ -109,7 +109,7 @@ static size_t shmpage_size(size_t w, size_t h,
 #else
 	return sizeof(struct arcan_shmif_page) + apad + 64 +
 		abufc * abufsz + (abufc * 64) +
-		vbufc * w * h * sizeof(shmif_pixel) + (vbufc * 64);
+		vbufc * w * h * arcan_shmif_vbpp(meta) + (vbufc * 64);
 #endif
 }
 
@@ -119,6 +119,62 @@ struct arcan_frameserver* platform_fsrv_wrapcl(struct arcan_shmif_cont* in)
 	return NULL;
 }
 
+/*
+ * The page is an anonymous memory file where the OS provides one, it reaches
+ * the client over the socket (platform_fsrv_pushshm) rather than through the
+ * shm namespace. The key is still generated as it names the semaphores for
+ * non-futex builds, but its last character tells the client where to look:
+ *
+ *  'm' - shm_open(key)
+ *  'f' - the descriptor follows on the socket
+ *  'h' - as 'f', and the mapping should be advised for hugepages
+ *
+ * This file is also built into the shmif-server library, so the options are
+ * taken from the environment rather than the config lookup:
+ *
+ *  ARCAN_SHM_NAMED     - always go through the shm namespace
+ *  ARCAN_SHM_HUGEPAGES - back the page with transparent hugepages
+ *  ARCAN_SHM_PREFAULT  - populate the page when it is created or grown
+ */
+static struct {
+	bool init;
+	bool named;
+	bool huge;
+	bool prefault;
+} shmopt;
+
+static void shmopt_init()
+{
+	if (shmopt.init)
+		return;
+
+	shmopt.init = true;
+	shmopt.named = getenv("ARCAN_SHM_NAMED") != NULL;
+	shmopt.huge = getenv("ARCAN_SHM_HUGEPAGES") != NULL;
+	shmopt.prefault = getenv("ARCAN_SHM_PREFAULT") != NULL;
+}
+
+static char shm_kind(const char* key)
+{
+	size_t len = key ? strlen(key) : 0;
+	return len ? key[len - 1] : 'm';
+}
+
+/* the advice is per mapping, so this is repeated on every (re-)map */
+static void shm_advise(char kind, void* addr, size_t ofs, size_t sz)
+{
+#ifdef MADV_HUGEPAGE
+	if (kind == 'h')
+		madvise(addr, sz, MADV_HUGEPAGE);
+#endif
+
+/* only the grown range, the rest is already resident */
+#ifdef MADV_POPULATE_WRITE
+	if (shmopt.prefault && sz > ofs)
+		madvise((uint8_t*) addr + ofs, sz - ofs, MADV_POPULATE_WRITE);
+#endif
+}
+
 static void dropshared_keyed(char** key)
 {
 	if (!key || !(*key))
@@ -126,7 +182,8 @@ static void dropshared_keyed(char** key)
 
 	char* work = *key;
 
-	shm_unlink(work);
+	if (shm_kind(work) == 'm')
+		shm_unlink(work);
 	size_t chpos = strlen(work) - 1;
 	work[chpos] = 'a';
 	arcan_sem_unlink(NULL, work);
@@ -215,9 +272,11 @@ bool platform_fsrv_destroy_local(arcan_frameserver* src)
 		src->dpipe = BADFD;
 	}
 
-	sem_close(src->async);
-	sem_close(src->vsync);
-	sem_close(src->esync);
+	platform_fsrv_shmlock(true);
+	arcan_sem_close(src->async);
+	arcan_sem_close(src->vsync);
+	arcan_sem_close(src->esync);
+	src->async = src->vsync = src->esync = NULL;
 
 	struct arcan_shmif_page* shmpage = src->shm.ptr;
 
@@ -229,6 +288,7 @@ bool platform_fsrv_destroy_local(arcan_frameserver* src)
 		close(src->shm.handle);
 
 	src->shm.ptr = NULL;
+	platform_fsrv_shmlock(false);
 	return true;
 }
 
@@ -311,6 +371,9 @@ void platform_fsrv_dropshared(arcan_frameserver* src)
 	if (!src)
 		return;
 
+/* the semaphores and the mapping are used by shared readers */
+	platform_fsrv_shmlock(true);
+
 	if (src->dpipe != BADFD){
 		shutdown(src->dpipe, SHUT_RDWR);
 		close(src->dpipe);
@@ -328,9 +391,10 @@ void platform_fsrv_dropshared(arcan_frameserver* src)
 		src->sockkey = NULL;
 	}
 
-	sem_close(src->async);
-	sem_close(src->vsync);
-	sem_close(src->esync);
+	arcan_sem_close(src->async);
+	arcan_sem_close(src->vsync);
+	arcan_sem_close(src->esync);
+	src->async = src->vsync = src->esync = NULL;
 
 	struct arcan_shmif_page* shmpage = src->shm.ptr;
 
@@ -344,6 +408,7 @@ void platform_fsrv_dropshared(arcan_frameserver* src)
 		close(src->shm.handle);
 
 	src->shm.ptr = NULL;
+	platform_fsrv_shmlock(false);
 }
 
 static void fsrv_killchild(arcan_frameserver* src)
@@ -410,6 +475,10 @@ bool platform_fsrv_validchild(arcan_frameserver* src){
  * descriptor.
  */
 	if (src->child == BROKEN_PROCESS_HANDLE){
+/* the conductor wait set latches hangup for registered frameservers */
+		if (src->flags.sock_watch)
+			return !src->flags.sock_hup;
+
 		if (src->dpipe > 0){
 			int mask = POLLERR | POLLHUP | POLLNVAL;
 
@@ -460,10 +529,76 @@ int platform_fsrv_pushfd(
 	return ARCAN_ERRC_BAD_ARGUMENT;
 }
 
+static int memfd_page(const char* name)
+{
+#ifdef MFD_CLOEXEC
+	if (!shmopt.named)
+		return memfd_create(name, MFD_CLOEXEC);
+#endif
+	return -1;
+}
+
+bool platform_fsrv_pushshm(arcan_frameserver* ctx)
+{
+	if (!ctx)
+		return false;
+
+	char kind = shm_kind(ctx->shm.key);
+	if (kind != 'f' && kind != 'h')
+		return true;
+
+	return arcan_pushhandle(ctx->shm.handle, ctx->dpipe);
+}
+
+uint8_t* platform_fsrv_mappool(arcan_frameserver* ctx, bool release)
+{
+	if (!ctx)
+		return NULL;
+
+	struct stat fs;
+	int fd = ctx->vstream.pool.fd;
+	bool drop = release || fd <= 0 || -1 == fstat(fd, &fs) || fs.st_size <= 0;
+
+	if (!drop && ctx->vstream.pool.map &&
+		ctx->vstream.pool.dev == (uint64_t) fs.st_dev &&
+		ctx->vstream.pool.ino == (uint64_t) fs.st_ino &&
+		ctx->vstream.pool.map_sz == (size_t) fs.st_size)
+		return ctx->vstream.pool.map;
+
+	if (ctx->vstream.pool.map){
+		munmap(ctx->vstream.pool.map, ctx->vstream.pool.map_sz);
+		ctx->vstream.pool.map = NULL;
+		ctx->vstream.pool.map_sz = 0;
+	}
+
+	if (drop)
+		return NULL;
+
+/* the client could otherwise truncate the file and have us SIGBUS */
+#ifdef F_GET_SEALS
+	int seals = fcntl(fd, F_GET_SEALS);
+	if (-1 == seals || !(seals & F_SEAL_SHRINK))
+		return NULL;
+#else
+	return NULL;
+#endif
+
+	void* map = mmap(NULL, fs.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == map)
+		return NULL;
+
+	ctx->vstream.pool.map = map;
+	ctx->vstream.pool.map_sz = fs.st_size;
+	ctx->vstream.pool.dev = fs.st_dev;
+	ctx->vstream.pool.ino = fs.st_ino;
+	return map;
+}
+
 static bool findshmkey(arcan_frameserver* ctx, int* dfd, mode_t mode){
 	pid_t selfpid = getpid();
 	int retrycount = 10;
 	size_t pb_ofs = 0;
+	char kind = 'm';
 
 	const char pattern[] = "/arcan_%i_%im";
 	const char* errmsg = NULL;
@@ -475,7 +610,15 @@ static bool findshmkey(arcan_frameserver* ctx, int* dfd, mode_t mode){
 		snprintf(playbuf, sizeof(playbuf), pattern, selfpid % 1000, rand() % 100000);
 
 		pb_ofs = strlen(playbuf) - 1;
-		*dfd = shm_open(playbuf, O_CREAT | O_RDWR | O_EXCL, mode);
+
+/* without a name there is nothing to collide with, only the semaphores */
+		*dfd = memfd_page(&playbuf[1]);
+		if (-1 != *dfd)
+			kind = shmopt.huge ? 'h' : 'f';
+		else {
+			kind = 'm';
+			*dfd = shm_open(playbuf, O_CREAT | O_RDWR | O_EXCL, mode);
+		}
 
 /*
  * with EEXIST, we happened to have a name collision, it is unlikely, but may
@@ -494,6 +637,11 @@ static bool findshmkey(arcan_frameserver* ctx, int* dfd, mode_t mode){
 			continue;
 		}
 
+/* the synchronization words are bound to the page after mapping instead */
+#ifdef ARCAN_SHMIF_FUTEX
+		break;
+#endif
+
 		playbuf[pb_ofs] = 'v';
 		ctx->vsync = sem_open(playbuf, O_CREAT | O_EXCL, mode, 0);
 
@@ -532,7 +680,7 @@ static bool findshmkey(arcan_frameserver* ctx, int* dfd, mode_t mode){
 		break;
 	}
 
-	playbuf[pb_ofs] = 'm';
+	playbuf[pb_ofs] = kind;
 	ctx->shm.key = strdup(playbuf);
 
 	if (retrycount)
@@ -680,6 +828,7 @@ static bool shmalloc(arcan_frameserver* ctx,
 	struct arcan_shmif_page* shmpage;
 	int shmfd = 0;
 
+	shmopt_init();
 	if (!findshmkey(ctx, &shmfd, ctx->sockmode))
 		return false;
 
@@ -697,8 +846,18 @@ static bool shmalloc(arcan_frameserver* ctx,
 	}
 
 	ctx->shm.handle = shmfd;
+
+/* populating before the hugepage advice would get the small pages, then the
+ * touch below does the faulting */
+	char kind = shm_kind(ctx->shm.key);
+	int mflags = MAP_SHARED;
+#ifdef MAP_POPULATE
+	if (shmopt.prefault && kind != 'h')
+		mflags |= MAP_POPULATE;
+#endif
+
 	shmpage = (void*) mmap(
-		NULL, ctx->shm.shmsize, PROT_READ | PROT_WRITE, MAP_SHARED, shmfd, 0);
+		NULL, ctx->shm.shmsize, PROT_READ | PROT_WRITE, mflags, shmfd, 0);
 
 	if (MAP_FAILED == shmpage){
 		arcan_warning("platform_fsrv_spawn_server(unix) -- couldn't "
@@ -709,14 +868,17 @@ fail:
  * leak even if we unlink */
 		if (shmfd != -1){
 			close(shmfd);
-			sem_close(ctx->vsync);
-			sem_close(ctx->async);
-			sem_close(ctx->esync);
+			arcan_sem_close(ctx->vsync);
+			arcan_sem_close(ctx->async);
+			arcan_sem_close(ctx->esync);
 		}
 		dropshared_keyed(&ctx->shm.key);
 		return false;
 	}
 
+/* MAP_POPULATE or the touch covers the faulting here */
+	shm_advise(kind, shmpage, ctx->shm.shmsize, ctx->shm.shmsize);
+
 /* separate failure code here as the memory is still mapped */
 	jmp_buf out;
 	if (0 != setjmp(out)){
@@ -726,9 +888,13 @@ fail:
 		return false;
 	}
 
-/* tiny race condition SIGBUS window here */
+/* The key is always new (O_EXCL or memfd) so the contents are already zero.
+ * Only the header and queue indices get written, the rest (the unused part of
+ * the queues and the buffers) is committed when the client starts drawing,
+ * which keeps the mostly idle popups, cursors, titlebars and so on cheap. */
 	platform_fsrv_enter(ctx, out);
-		memset(shmpage, '\0', ctx->shm.shmsize);
+		if (shmopt.prefault && kind == 'h')
+			memset(shmpage, '\0', ctx->shm.shmsize);
 		shmpage->dms = true;
 		shmpage->parent = getpid();
 		shmpage->major = ASHMIF_VERSION_MAJOR;
@@ -738,6 +904,13 @@ fail:
 		shmpage->cookie = arcan_shmif_cookie();
 		shmpage->vpending = 1;
 		shmpage->apending = 1;
+#ifdef ARCAN_SHMIF_FUTEX
+		shmpage->futex = 1;
+		atomic_store(&shmpage->doorbell[2][0], 1);
+#endif
+		ctx->vsync = arcan_sem_bind(ctx->vsync, shmpage->doorbell[0]);
+		ctx->async = arcan_sem_bind(ctx->async, shmpage->doorbell[1]);
+		ctx->esync = arcan_sem_bind(ctx->esync, shmpage->doorbell[2]);
 		ctx->shm.ptr = shmpage;
 	platform_fsrv_leave();
 
@@ -829,15 +1002,24 @@ static size_t fsrv_protosize(arcan_frameserver* ctx,
 		tot += tot - (tot % sizeof(max_align_t));
 
 	if (proto & SHMIF_META_HDR){
-/* nothing now, possibly reserved for tone-mapping */
+		dofs->ofs_hdr = dofs->sz_hdr = tot;
+		tot += sizeof(struct arcan_shmif_hdr);
+		dofs->sz_hdr = tot - dofs->sz_hdr;
 	}
-	dofs->ofs_hdr = dofs->sz_hdr = 0;
+	else
+		dofs->ofs_hdr = dofs->sz_hdr = 0;
 
+	if (tot % sizeof(max_align_t) != 0)
+		tot += tot - (tot % sizeof(max_align_t));
+
+/* the mesh itself goes in the video buffer, this only describes its size */
 	if (proto & SHMIF_META_VOBJ){
-/* nothing now, somewhat pesky in that we need a limit on ops and an
- * ops specifier as part of the request (?) */
+		dofs->ofs_vector = dofs->sz_vector = tot;
+		tot += sizeof(struct arcan_shmif_vector);
+		dofs->sz_vector = tot - dofs->sz_vector;
 	}
-	dofs->ofs_vector = dofs->sz_vector = 0;
+	else
+		dofs->ofs_vector = dofs->sz_vector = 0;
 
 	if (proto & SHMIF_META_VENC){
 		dofs->ofs_venc = dofs->sz_venc = tot;
@@ -852,6 +1034,7 @@ static size_t fsrv_protosize(arcan_frameserver* ctx,
 		dofs->ofs_vr = dofs->sz_vr = tot;
 		tot += sizeof(struct arcan_shmif_vr);
 		tot += sizeof(struct vr_limb) * LIMB_LIM;
+		tot += sizeof(struct vr_sample_ring);
 		dofs->sz_vr = tot - dofs->sz_vr;
 	}
 	else
@@ -884,7 +1067,7 @@ static bool prepare_segment(struct arcan_frameserver* ctx,
 		abufsz = 65535;
 	}
 
-	ctx->shm.shmsize = shmpage_size(hintw, hinth, 1, abufc, abufsz, 0);
+	ctx->shm.shmsize = shmpage_size(hintw, hinth, 0, 1, abufc, abufsz, 0);
 
 	if (!shmalloc(ctx, named, optkey, optdesc))
 		return NULL;
@@ -905,6 +1088,8 @@ static bool prepare_segment(struct arcan_frameserver* ctx,
 		shmpage->vpending = 1;
 		shmpage->abufsize = abufsz;
 		shmpage->apending = abufc;
+		shmpage->childevq.size = PP_QUEUE_SZ;
+		shmpage->parentevq.size = PP_QUEUE_SZ;
 		shmpage->segment_size = arcan_shmif_mapav(shmpage,
 			ctx->vbufs, 1, hintw * hinth * sizeof(shmif_pixel),
 			ctx->abufs, abufc, abufsz
@@ -1007,6 +1192,7 @@ struct arcan_frameserver* platform_fsrv_spawn_subsegment(
  * sending on additional descriptor in advance.
  */
 	newseg->dpipe = sockp[0];
+	platform_fsrv_pushshm(newseg);
 	arcan_pushhandle(sockp[1], ctx->dpipe);
 	close(sockp[1]);
 
@@ -1094,6 +1280,147 @@ int platform_fsrv_pushevent(arcan_frameserver* dst, arcan_event* ev)
 	return ARCAN_OK;
 }
 
+/* frames timed further ahead than this are treated as due, so a client with
+ * a broken clock can't stall its own presentation indefinitely */
+#ifndef FSRV_VSLOT_HORIZON
+#define FSRV_VSLOT_HORIZON 10000
+#endif
+
+static bool vslot_due(uint64_t pts, uint64_t now)
+{
+	return !pts || pts <= now || pts > now + FSRV_VSLOT_HORIZON;
+}
+
+int platform_fsrv_vslot_pick(struct arcan_frameserver* s, uint64_t now)
+{
+	struct arcan_shmif_page* page = s->shm.ptr;
+	if (!s->vswap || !page)
+		return -1;
+
+	if (s->vslot_held)
+		return s->vslot_held - 1;
+
+	bool fifo = s->vswap == SHMIF_SWAP_FIFO;
+	bool timed = s->vswap != SHMIF_SWAP_IMMEDIATE;
+	int best = -1;
+	uint32_t best_seq = 0;
+
+/* fifo takes the oldest and waits for it to become due, the others take the
+ * newest of the due ones */
+	for (size_t i = 0; i < s->vbuf_cnt; i++){
+		if (atomic_load_explicit(&page->vslot[i],
+			memory_order_acquire) != SHMIF_VSLOT_QUEUED)
+			continue;
+
+		uint32_t seq = atomic_load(&page->vslot_seq[i]);
+		if (!fifo && timed && !vslot_due(atomic_load(&page->vslot_pts[i]), now))
+			continue;
+
+		if (best == -1 ||
+			(fifo ? (int32_t)(seq - best_seq) < 0 : (int32_t)(seq - best_seq) > 0)){
+			best = i;
+			best_seq = seq;
+		}
+	}
+
+	if (best != -1 && fifo && !vslot_due(atomic_load(&page->vslot_pts[best]), now))
+		return -1;
+
+	return best;
+}
+
+int platform_fsrv_vslot_acquire(struct arcan_frameserver* s, uint64_t now)
+{
+/* a previous attempt got deferred after taking the slot, keep using that */
+	if (s->vslot_held)
+		return s->vslot_held - 1;
+
+	int slot = platform_fsrv_vslot_pick(s, now);
+	if (slot < 0)
+		return -1;
+
+/* the client may have reclaimed the slot (mailbox) since it was picked */
+	struct arcan_shmif_page* page = s->shm.ptr;
+	uint8_t expect = SHMIF_VSLOT_QUEUED;
+	if (!atomic_compare_exchange_strong(
+		&page->vslot[slot], &expect, SHMIF_VSLOT_ACQUIRED))
+		return -1;
+
+/* anything queued before the picked slot will never be presented */
+	if (s->vswap != SHMIF_SWAP_FIFO){
+		uint32_t seq = atomic_load(&page->vslot_seq[slot]);
+		for (size_t i = 0; i < s->vbuf_cnt; i++){
+			expect = SHMIF_VSLOT_QUEUED;
+			if (i != slot &&
+				(int32_t)(atomic_load(&page->vslot_seq[i]) - seq) < 0)
+				atomic_compare_exchange_strong(
+					&page->vslot[i], &expect, SHMIF_VSLOT_FREE);
+		}
+	}
+
+	s->vslot_held = slot + 1;
+	return slot;
+}
+
+void platform_fsrv_vslot_release(struct arcan_frameserver* s)
+{
+	struct arcan_shmif_page* page = s->shm.ptr;
+	if (s->vslot_held){
+		atomic_store_explicit(&page->vslot[s->vslot_held - 1],
+			SHMIF_VSLOT_FREE, memory_order_release);
+		s->vslot_held = 0;
+	}
+
+/* clear first and then rescan so a slot queued in between isn't missed */
+	atomic_store_explicit(&page->vready, 0, memory_order_release);
+	for (size_t i = 0; i < s->vbuf_cnt; i++){
+		if (atomic_load(&page->vslot[i]) == SHMIF_VSLOT_QUEUED){
+			atomic_store_explicit(&page->vready, i + 1, memory_order_release);
+			break;
+		}
+	}
+}
+
+size_t platform_fsrv_pushevents(
+	arcan_frameserver* dst, arcan_event* ev, size_t n)
+{
+	if (!dst || !ev || !n || !dst->outqueue.back)
+		return 0;
+
+	TRAMP_GUARD(0, dst);
+
+	if (!dst->flags.alive || !dst->shm.ptr || !dst->shm.ptr->dms){
+		platform_fsrv_leave();
+		return 0;
+	}
+
+	struct arcan_evctx* ctx = &dst->outqueue;
+	unsigned back = *ctx->back;
+	size_t count = 0;
+
+	for (; count < n; count++){
+		if (ev[count].category == EVENT_IO && (
+			(dst->devicemask & ev[count].io.devkind) ||
+			(dst->datamask & ev[count].io.datatype)))
+			continue;
+
+		if ((back + 1) % ctx->eventbuf_sz == *ctx->front)
+			break;
+
+		ctx->eventbuf[back] = ev[count];
+		back = (back + 1) % ctx->eventbuf_sz;
+	}
+
+	if (back != *ctx->back){
+		FORCE_SYNCH();
+		*ctx->back = back;
+		arcan_pushhandle(-1, dst->dpipe);
+	}
+
+	platform_fsrv_leave();
+	return count;
+}
+
 int platform_fsrv_socketauth(struct arcan_frameserver* tgt)
 {
 	char ch;
@@ -1118,7 +1445,9 @@ reread:
  * that strcmp will effectively not become an oracle as we'll align to vsync
  * and jitter from tons of activity - but the scripts can also take different
  * action */
-	if ('\0' == ch){
+/* arcan_shmif_connect terminates the key with a linefeed */
+	if ('\0' == ch || '\n' == ch){
+		tgt->sockinbuf[tgt->sockrofs] = '\0';
 		if (strncmp(tgt->clientkey, tgt->sockinbuf, PP_SHMPAGE_SHMKEYLIM) != 0){
 			errno = EBADF;
 			return -1;
@@ -1159,7 +1488,8 @@ send_key:
 		}
 	}
 
-	if (rtc <= 0){
+/* the page descriptor follows the key line, see findshmkey */
+	if (rtc <= 0 || !platform_fsrv_pushshm(tgt)){
 		errno = EBADF;
 		return -1;
 	}
@@ -1169,8 +1499,16 @@ send_key:
 int platform_fsrv_socketpoll(struct arcan_frameserver* tgt)
 {
 /* if we're not in a pending state, just return normal. */
-	bool term;
-	if (!fd_avail(tgt->dpipe, &term)){
+	bool term, avail;
+	if (tgt->flags.sock_watch){
+		term = tgt->flags.sock_hup;
+		avail = !term && tgt->flags.sock_ready;
+		tgt->flags.sock_ready = false;
+	}
+	else
+		avail = fd_avail(tgt->dpipe, &term);
+
+	if (!avail){
 		if (term){
 			errno = EBADF;
 			return -1;
@@ -1291,10 +1629,46 @@ size_t platform_fsrv_display_limit(size_t new_sz)
 	return res;
 }
 
+/*
+ * Move the pending events in [ctx] to the start of the ring so that they
+ * survive the modulo changing, anything that no longer fits is dropped from
+ * the back. Only safe while the client is blocked in resize negotiation.
+ */
+static void resize_evq(struct arcan_evctx* ctx, uint16_t* size, size_t new_sz)
+{
+	if (new_sz == ctx->eventbuf_sz)
+		return;
+
+	struct arcan_event* tmp = malloc(new_sz * sizeof(struct arcan_event));
+	if (!tmp)
+		return;
+
+	size_t count = 0;
+	unsigned front = *ctx->front;
+	unsigned back = *ctx->back;
+
+	if (front < ctx->eventbuf_sz && back < ctx->eventbuf_sz){
+		while (front != back && count < new_sz - 1){
+			tmp[count++] = ctx->eventbuf[front];
+			front = (front + 1) % ctx->eventbuf_sz;
+		}
+	}
+
+	memcpy(ctx->eventbuf, tmp, count * sizeof(struct arcan_event));
+	free(tmp);
+	*ctx->front = 0;
+	*ctx->back = count;
+	*size = new_sz;
+	ctx->eventbuf_sz = new_sz;
+}
+
 int platform_fsrv_resynch(struct arcan_frameserver* s)
 {
 	int state = 0;
 	struct shm_handle* src = &s->shm;
+
+/* buffers and the mapping itself can change, exclude shared readers */
+	platform_fsrv_shmlock(true);
 	struct arcan_shmif_page* shmpage = s->shm.ptr;
 
 /* local copy so we don't fall victim for TOCTU */
@@ -1306,11 +1680,23 @@ int platform_fsrv_resynch(struct arcan_frameserver* s)
 	size_t samplerate = atomic_load(&shmpage->audiorate);
 	size_t rows = atomic_load(&shmpage->rows);
 	size_t cols = atomic_load(&shmpage->cols);
-	unsigned aproto = atomic_load(&shmpage->apad_type) & s->metamask;
+	size_t evqsz = shmpage->evqueue_req;
+	size_t rsv_w = atomic_load(&shmpage->reserve_w);
+	size_t rsv_h = atomic_load(&shmpage->reserve_h);
+	unsigned aproto = atomic_load(&shmpage->apad_type);
+
+/* the buffer format only applies with HDR, and only formats we can size */
+	if ((aproto & s->metamask & SHMIF_META_HDR) &&
+		SHMIF_META_VFMT(aproto) <= SHMIF_VFMT_RGBA16F)
+		aproto &= s->metamask | SHMIF_META_VFMT_MASK;
+	else
+		aproto &= s->metamask & ~SHMIF_META_VFMT_MASK;
 
 	vbufc = vbufc > FSRV_MAX_VBUFC ? FSRV_MAX_VBUFC : vbufc;
 	abufc = abufc > FSRV_MAX_ABUFC ? FSRV_MAX_ABUFC : abufc;
 	vbufc = vbufc == 0 ? 1 : vbufc;
+	evqsz = evqsz > PP_QUEUE_MAX ? PP_QUEUE_MAX : evqsz;
+	evqsz = evqsz && evqsz < PP_QUEUE_SZ ? PP_QUEUE_SZ : evqsz;
 
 /*
  * Determine if we should switch/ enable privileged subprotocols.
@@ -1341,7 +1727,7 @@ int platform_fsrv_resynch(struct arcan_frameserver* s)
 /* shrink number of video buffers if we don't fit */
 	size_t shmsz;
 	do{
-		shmsz = shmpage_size(w, h, vbufc, abufc, abufsz, apad_sz);
+		shmsz = shmpage_size(w, h, aproto, vbufc, abufc, abufsz, apad_sz);
 	} while (shmsz > ARCAN_SHMPAGE_MAX_SZ && vbufc-- > 1);
 
 /* initial sanity check */
@@ -1349,6 +1735,26 @@ int platform_fsrv_resynch(struct arcan_frameserver* s)
 		(s->max_h && h > s->max_h))
 		goto fail;
 
+/* with a reservation the segment is sized for the larger of the current and
+ * the reserved dimensions, resizes that stay within it won't remap */
+	bool reserved = false;
+	if (rsv_w && rsv_h){
+		rsv_w = rsv_w < w ? w : rsv_w;
+		rsv_h = rsv_h < h ? h : rsv_h;
+		if (s->max_w && rsv_w > s->max_w)
+			rsv_w = s->max_w;
+		if (s->max_h && rsv_h > s->max_h)
+			rsv_h = s->max_h;
+
+		size_t rsvsz = shmpage_size(rsv_w, rsv_h, aproto,
+			vbufc, abufc, abufsz, apad_sz);
+		if (rsvsz > ARCAN_SHMPAGE_MAX_SZ)
+			rsvsz = ARCAN_SHMPAGE_MAX_SZ;
+
+		shmsz = rsvsz > shmsz ? rsvsz : shmsz;
+		reserved = true;
+	}
+
 /* no remapping required, resize effect is insignificant or impossible */
 	bool rmap = (shmsz > src->shmsize || shmsz < (float) src->shmsize * 0.8);
 
@@ -1376,6 +1782,7 @@ int platform_fsrv_resynch(struct arcan_frameserver* s)
 		goto fail;
 	}
 	src->ptr = newp;
+	shm_advise(shm_kind(src->key), newp, src->shmsize, shmsz);
 /*
  * doesn't seem to exist on FBSD10 etc.?
 	struct arcan_shmif_page* newp = mremap(src->ptr, src->shmsize, shmsz, NULL);
@@ -1393,11 +1800,15 @@ int platform_fsrv_resynch(struct arcan_frameserver* s)
 		arcan_warning("frameserver_resize() failed, reason: %s\n", strerror(errno));
 		goto fail;
 	}
+	shm_advise(shm_kind(src->key), src->ptr, src->shmsize, shmsz);
 #endif
 	}
 
 	shmpage = src->ptr;
 	src->shmsize = shmsz;
+	s->vsync = arcan_sem_bind(s->vsync, shmpage->doorbell[0]);
+	s->async = arcan_sem_bind(s->async, shmpage->doorbell[1]);
+	s->esync = arcan_sem_bind(s->esync, shmpage->doorbell[2]);
 
 /* commit to local tracking */
 	atomic_store(&shmpage->w, w);
@@ -1435,29 +1846,58 @@ int platform_fsrv_resynch(struct arcan_frameserver* s)
 	shmpage->segment_size = arcan_shmif_mapav(shmpage,
 		s->vbufs, s->vbuf_cnt, vbufsz, s->abufs, s->abuf_cnt, abufsz);
 	s->abuf_sz = abufsz;
+
+/* let the client map the entire reservation so it doesn't remap either */
+	if (reserved)
+		shmpage->segment_size = src->shmsize;
+
 	arcan_shmif_setevqs(shmpage, s->esync, &(s->inqueue), &(s->outqueue), 1);
 
+	if (evqsz){
+		resize_evq(&s->inqueue, &shmpage->parentevq.size, evqsz);
+		resize_evq(&s->outqueue, &shmpage->childevq.size, evqsz);
+	}
+	shmpage->evqueue_req = 0;
+
+/* buffers have been remapped so slot ownership starts over */
+	int swap = atomic_load(&shmpage->swap_mode);
+	s->vswap = swap > SHMIF_SWAP_DEFAULT && swap <= SHMIF_SWAP_IMMEDIATE ? swap : 0;
+	s->vslot_held = 0;
+	for (size_t i = 0; i < ARCAN_SHMIF_VBUFC_LIM; i++){
+		atomic_store(&shmpage->vslot[i], SHMIF_VSLOT_FREE);
+		atomic_store(&shmpage->vslot_seq[i], 0);
+		atomic_store(&shmpage->vslot_pts[i], 0);
+	}
+	atomic_store(&shmpage->swap_mode, s->vswap ? s->vswap : SHMIF_SWAP_DEFAULT);
+
 /* commit to shared page */
 	shmpage->resized = 0;
 	shmpage->abufsize = abufsz;
 	shmpage->apending = s->abuf_cnt;
 	shmpage->vpending = s->vbuf_cnt;
 
+/* a new buffer format needs the store reformatted even at the same size */
+	if (SHMIF_META_VFMT(s->desc.aproto) != SHMIF_META_VFMT(aproto))
+		s->desc.rz_flag = true;
+
 /* realize the sub-protocol */
 	if (reset_proto){
 		fsrv_setproto(s, aproto, &apend);
-		atomic_store(&shmpage->apad_type, aproto);
 		state = 2;
 	}
 	else
 		state = 1;
 
+/* always reflect the acknowledged mask, the client sizes its buffers from it */
+	atomic_store(&shmpage->apad_type, aproto);
+
 	goto done;
 
 /* couldn't resize, restore contents. this shouldn't be "needed" but is a
  * protection for clients that erroneously use .addr->** rather than the
  * context-local copy */
 fail:
+	atomic_store(&shmpage->swap_mode, s->vswap ? s->vswap : SHMIF_SWAP_DEFAULT);
 	atomic_store(&shmpage->abufsize, abufsz);
 	atomic_store(&shmpage->apending, s->abuf_cnt);
 	atomic_store(&shmpage->vpending, s->vbuf_cnt);
@@ -1469,6 +1909,8 @@ fail:
 	state = -1;
 
 done:
+	platform_fsrv_shmlock(false);
+
 /* barrier + signal */
 	FORCE_SYNCH();
 	arcan_sem_post(s->vsync);
@@ -1490,6 +1932,35 @@ struct arcan_frameserver* platform_fsrv_listen_external(const char* key,
 	return newseg;
 }
 
+struct arcan_frameserver* platform_fsrv_listen_prepare(
+	mode_t mode, size_t w, size_t h)
+{
+	arcan_frameserver* newseg = platform_fsrv_alloc();
+	if (!newseg)
+		return NULL;
+
+	newseg->sockmode = mode;
+	if (!prepare_segment(newseg, SEGID_UNKNOWN, 0, w, h, false, NULL, -1, 0)){
+		arcan_mem_free(newseg);
+		return NULL;
+	}
+
+	return newseg;
+}
+
+bool platform_fsrv_listen_bind(struct arcan_frameserver* seg,
+	const char* key, const char* auth, int fd, uintptr_t tag)
+{
+	if (!setup_socket(seg, seg->shm.handle, key, fd))
+		return false;
+
+	seg->tag = tag;
+	seg->launchedtime = arcan_timemillis();
+	if (auth)
+		strncpy(seg->clientkey, auth, PP_SHMPAGE_SHMKEYLIM-1);
+	return true;
+}
+
 struct arcan_frameserver* platform_fsrv_preset_server(
 	int sockin, int segid, size_t w, size_t h, uintptr_t tag)
 {
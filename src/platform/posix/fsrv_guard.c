@@ -28,6 +28,7 @@
 #include <signal.h>
 #include <errno.h>
 #include <setjmp.h>
+#include <stdatomic.h>
 
 #include <arcan_math.h>
 #include <arcan_general.h>
@@ -37,9 +38,18 @@
 #include <arcan_audio.h>
 #include <arcan_frameserver.h>
 
-static struct arcan_frameserver* tag;
-static sigjmp_buf recover;
-static size_t counter;
+/*
+ * The guard is per thread as SIGBUS is delivered to the thread that faulted.
+ * Other threads than the main one (audio mixing) only read through the shm
+ * lock, see platform_fsrv_shmread, and won't drop the segment on a fault as
+ * that would pull it from under the main thread.
+ */
+static _Thread_local struct arcan_frameserver* tag;
+static _Thread_local sigjmp_buf recover;
+static _Thread_local bool reader;
+static _Thread_local size_t lock_depth;
+static _Atomic size_t counter;
+static pthread_mutex_t shm_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void bus_handler(int signo)
 {
@@ -51,25 +61,56 @@ static void bus_handler(int signo)
 
 void platform_fsrv_enter(struct arcan_frameserver* m, jmp_buf out)
 {
-	static bool initialized;
+	static _Atomic bool initialized;
 	counter++;
 
-	if (!initialized){
-		initialized = true;
+	if (!atomic_exchange(&initialized, true)){
 		if (signal(SIGBUS, bus_handler) == SIG_ERR)
 			arcan_warning("(posix/fsrv_guard) can't install sigbus handler.\n");
 		}
 
 	if (sigsetjmp(recover, 0)){
+		if (reader){
+			arcan_warning("(posix/fsrv_guard) bus error on shared read.\n");
+			tag = NULL;
+			longjmp(out, -1);
+		}
+
 		arcan_warning("(posix/fsrv_guard) DoS attempt from client.\n");
 		platform_fsrv_dropshared(tag);
 		tag = NULL;
+
+/* an interrupted exclusive section won't get to release the lock */
+		if (lock_depth){
+			lock_depth = 0;
+			pthread_mutex_unlock(&shm_lock);
+		}
 		longjmp(out, -1);
 	}
 
 	tag = m;
 }
 
+void platform_fsrv_shmlock(bool lock)
+{
+	if (lock){
+		if (lock_depth++ == 0)
+			pthread_mutex_lock(&shm_lock);
+	}
+	else if (lock_depth && --lock_depth == 0)
+		pthread_mutex_unlock(&shm_lock);
+}
+
+void platform_fsrv_shmread(bool lock)
+{
+	if (lock)
+		pthread_mutex_lock(&shm_lock);
+	else
+		pthread_mutex_unlock(&shm_lock);
+
+	reader = lock;
+}
+
 size_t platform_fsrv_clock()
 {
 	return counter;
@@ -88,6 +88,13 @@ unsigned arcan_glob(
 
 		globslots[ofs++] = path;
 
+/* the appl namespace is usually indexed, then no readdir is needed */
+		ssize_t nindex = arcan_resindex_glob(path, cb, tag);
+		if (nindex >= 0){
+			count += nindex;
+			continue;
+		}
+
 		if ( glob(path, 0, NULL, &res) == 0 ){
 			char** beg = res.gl_pathv;
 
@@ -20,9 +20,14 @@
 #include <sys/mman.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <pthread.h>
 
+#ifdef __LINUX
+#include <sched.h>
+#endif
+
 #include <errno.h>
 
 #include <assert.h>
@@ -230,11 +235,15 @@ static void append_env(
 	darr->data[step] = NULL;
 }
 
+static struct arcan_frameserver* connpoint_take(const char* key,
+	const char* pw, int fd, mode_t mode, size_t w, size_t h, uintptr_t tag);
+
 arcan_frameserver* platform_launch_listen_external(const char* key,
 	const char* pw, int fd, mode_t mode, size_t w, size_t h, uintptr_t tag)
 {
-	arcan_frameserver* res =
-		platform_fsrv_listen_external(key, pw, fd, mode, w, h, tag);
+	arcan_frameserver* res = connpoint_take(key, pw, fd, mode, w, h, tag);
+	if (!res)
+		res = platform_fsrv_listen_external(key, pw, fd, mode, w, h, tag);
 
 	if (!res)
 		return NULL;
@@ -263,6 +272,766 @@ arcan_frameserver* platform_launch_listen_external(const char* key,
 	return res;
 }
 
+/* drop our nice level to normal user, have that configurable so that some
+ * setups may allow trusted launch-path children to have higher priority,
+ * nice itself will clamp */
+static int child_priority()
+{
+	uintptr_t cfg;
+	cfg_lookup_fun get_config = platform_config_lookup(&cfg);
+	int level = 0;
+	char* priostr;
+
+	if (get_config("child_priority", 0, &priostr, cfg)){
+		level = (int) strtol(priostr, NULL, 10) % INT_MAX;
+		free(priostr);
+	}
+
+	return level;
+}
+
+/*
+ * Resource classes (placement) for launched frameservers. Each launch maps to
+ * a class, either the one set through platform_launch_class or the default
+ * for its archetype, and the class decides scheduling policy, nice level,
+ * cpu affinity and (with a delegated cgroup v2 directory) cpu.weight,
+ * cpuset.cpus and memory.high.
+ *
+ * Configuration (get_config):
+ *  frameserver_cgroup=path    - delegated cgroup v2 directory, one child
+ *                               group per class is created there
+ *  frameserver_reserve=list   - cpus kept for the engine itself (0,2-3),
+ *                               defaults to 0 with four or more cpus online
+ *  frameserver_class_<name>=  - override class fields, '-' in <name> as '_':
+ *   weight=n:cpus=list:mem=size:sched=other|batch|idle|fifo|rr:prio=n:nice=n
+ *
+ * The scheduling parts are resolved in the parent so that the child side only
+ * needs a few syscalls between fork and exec.
+ */
+struct launch_class {
+	const char* name;
+	int sched;
+	int prio;
+	int nice;
+	int weight;
+	bool spare;
+	char* cpus;
+	char* mem;
+	int procs;
+	bool init;
+};
+
+static struct {
+	bool init;
+	char* current;
+	char* cgroup;
+#ifdef __LINUX
+	bool reserved;
+	cpu_set_t free;
+#endif
+	struct launch_class classes[4];
+} fsrv_place = {
+	.classes = {
+		{
+			.name = "interactive",
+			.sched = 0, .weight = 100, .procs = -1
+		},
+		{
+			.name = "realtime-audio",
+			.sched = 3, .prio = 10, .weight = 400, .procs = -1
+		},
+		{
+			.name = "batch-decode",
+			.sched = 1, .nice = 5, .weight = 25, .spare = true, .procs = -1
+		},
+		{
+			.name = "background",
+			.sched = 2, .nice = 19, .weight = 1, .spare = true, .procs = -1
+		}
+	}
+};
+
+/* the resolved form handed to the child, no allocations after fork */
+struct launch_place {
+	int procs;
+	int nice;
+#ifdef __LINUX
+	int policy;
+	struct sched_param param;
+	bool affinity;
+	cpu_set_t cpus;
+#endif
+};
+
+static const char* sched_names[] = {"other", "batch", "idle", "fifo", "rr"};
+
+#ifdef __LINUX
+static const int sched_policies[] = {
+	SCHED_OTHER, SCHED_BATCH, SCHED_IDLE, SCHED_FIFO, SCHED_RR
+};
+
+/* "0,2-3" -> set, returns false on malformed or empty lists */
+static bool parse_cpulist(const char* list, cpu_set_t* out)
+{
+	CPU_ZERO(out);
+	while (list && *list){
+		char* end;
+		unsigned long first = strtoul(list, &end, 10);
+		if (end == list)
+			return false;
+
+		unsigned long last = first;
+		if (*end == '-')
+			last = strtoul(end + 1, &end, 10);
+
+		for (unsigned long i = first; i <= last && i < CPU_SETSIZE; i++)
+			CPU_SET(i, out);
+
+		if (*end != ',')
+			break;
+		list = end + 1;
+	}
+
+	return CPU_COUNT(out) > 0;
+}
+
+static void cpulist_str(cpu_set_t* set, char* buf, size_t buf_sz)
+{
+	size_t ofs = 0;
+	buf[0] = '\0';
+	for (size_t i = 0; i < CPU_SETSIZE && ofs < buf_sz; i++)
+		if (CPU_ISSET(i, set))
+			ofs += snprintf(&buf[ofs], buf_sz - ofs, "%s%zu", ofs ? "," : "", i);
+}
+#endif
+
+static bool cgroup_write(const char* dir, const char* key, const char* val)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", dir, key);
+	int fd = open(path, O_WRONLY | O_CLOEXEC);
+	if (-1 == fd)
+		return false;
+
+	bool ok = write(fd, val, strlen(val)) == (ssize_t) strlen(val);
+	close(fd);
+	return ok;
+}
+
+static void class_override(struct launch_class* cl, char* val)
+{
+	char* tmp;
+	for (char* tok = strtok_r(val, ":", &tmp); tok;
+		tok = strtok_r(NULL, ":", &tmp)){
+		char* arg = strchr(tok, '=');
+		if (!arg)
+			goto bad;
+		*arg++ = '\0';
+
+		if (strcmp(tok, "weight") == 0)
+			cl->weight = strtoul(arg, NULL, 10);
+		else if (strcmp(tok, "nice") == 0)
+			cl->nice = strtol(arg, NULL, 10);
+		else if (strcmp(tok, "prio") == 0)
+			cl->prio = strtol(arg, NULL, 10);
+		else if (strcmp(tok, "cpus") == 0){
+			free(cl->cpus);
+			cl->cpus = strdup(arg);
+		}
+		else if (strcmp(tok, "mem") == 0){
+			free(cl->mem);
+			cl->mem = strdup(arg);
+		}
+		else if (strcmp(tok, "sched") == 0){
+			size_t i = 0;
+			for (; i < COUNT_OF(sched_names); i++)
+				if (strcmp(sched_names[i], arg) == 0)
+					break;
+			if (i == COUNT_OF(sched_names))
+				goto bad;
+			cl->sched = i;
+		}
+		else
+			goto bad;
+		continue;
+bad:
+		arcan_warning("frameserver_class_%s: ignoring (%s)\n", cl->name, tok);
+	}
+}
+
+static void place_init()
+{
+	fsrv_place.init = true;
+
+	uintptr_t tag;
+	char* val;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+
+	for (size_t i = 0; i < COUNT_OF(fsrv_place.classes); i++){
+		char key[64];
+		snprintf(key, sizeof(key),
+			"frameserver_class_%s", fsrv_place.classes[i].name);
+		for (char* ch = key; *ch; ch++)
+			if (*ch == '-')
+				*ch = '_';
+
+		if (get_config(key, 0, &val, tag) && val){
+			class_override(&fsrv_place.classes[i], val);
+			free(val);
+		}
+	}
+
+#ifdef __LINUX
+/* keep the batch classes away from the cores the engine should own, only
+ * worth it when there are enough of them to spare one */
+	cpu_set_t resv;
+	CPU_ZERO(&resv);
+	if (get_config("frameserver_reserve", 0, &val, tag)){
+		if (val && val[0] && !parse_cpulist(val, &resv))
+			arcan_warning("frameserver_reserve: couldn't parse (%s)\n", val);
+		free(val);
+	}
+	else if (sysconf(_SC_NPROCESSORS_ONLN) >= 4)
+		CPU_SET(0, &resv);
+
+	cpu_set_t all;
+	if (CPU_COUNT(&resv) && 0 == sched_getaffinity(0, sizeof(cpu_set_t), &all)){
+		CPU_XOR(&fsrv_place.free, &all, &resv);
+		CPU_AND(&fsrv_place.free, &fsrv_place.free, &all);
+		fsrv_place.reserved = CPU_COUNT(&fsrv_place.free) > 0;
+	}
+#endif
+
+	if (get_config("frameserver_cgroup", 0, &val, tag) && val){
+/* each controller separately so a missing one doesn't take the others */
+		cgroup_write(val, "cgroup.subtree_control", "+cpu");
+		cgroup_write(val, "cgroup.subtree_control", "+cpuset");
+		cgroup_write(val, "cgroup.subtree_control", "+memory");
+		fsrv_place.cgroup = val;
+	}
+}
+
+/* create the group on first use, returns the cgroup.procs descriptor */
+static int class_cgroup(struct launch_class* cl)
+{
+	if (cl->init || !fsrv_place.cgroup)
+		return cl->procs;
+	cl->init = true;
+
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", fsrv_place.cgroup, cl->name);
+	if (-1 == mkdir(path, 0755) && errno != EEXIST){
+		arcan_warning("frameserver_cgroup: couldn't create (%s): %s\n",
+			path, strerror(errno));
+		return -1;
+	}
+
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%d", cl->weight);
+	cgroup_write(path, "cpu.weight", buf);
+
+	if (cl->cpus)
+		cgroup_write(path, "cpuset.cpus", cl->cpus);
+#ifdef __LINUX
+	else if (cl->spare && fsrv_place.reserved){
+		cpulist_str(&fsrv_place.free, buf, sizeof(buf));
+		cgroup_write(path, "cpuset.cpus", buf);
+	}
+#endif
+
+	if (cl->mem)
+		cgroup_write(path, "memory.high", cl->mem);
+
+	snprintf(path, sizeof(path), "%s/%s/cgroup.procs", fsrv_place.cgroup, cl->name);
+	cl->procs = open(path, O_WRONLY | O_CLOEXEC);
+	if (-1 == cl->procs)
+		arcan_warning("frameserver_cgroup: couldn't open (%s): %s\n",
+			path, strerror(errno));
+
+	return cl->procs;
+}
+
+static struct launch_class* find_class(const char* name)
+{
+	for (size_t i = 0; i < COUNT_OF(fsrv_place.classes); i++)
+		if (strcmp(fsrv_place.classes[i].name, name) == 0)
+			return &fsrv_place.classes[i];
+	return NULL;
+}
+
+bool platform_launch_class(const char* name)
+{
+	if (name && name[0] && !find_class(name))
+		return false;
+
+	free(fsrv_place.current);
+	fsrv_place.current = name && name[0] ? strdup(name) : NULL;
+	return true;
+}
+
+/* encoders and decoders are throughput bound and buffered, the rest sit in
+ * someones input-to-photon path */
+static const char* archetype_class(struct frameserver_envp* setup)
+{
+	if (setup->use_builtin && (
+		strcmp(setup->args.builtin.mode, "encode") == 0 ||
+		strcmp(setup->args.builtin.mode, "decode") == 0))
+		return "batch-decode";
+
+	return "interactive";
+}
+
+static const char* launch_class(struct frameserver_envp* setup)
+{
+	return fsrv_place.current ? fsrv_place.current : archetype_class(setup);
+}
+
+static void place_resolve(const char* name, struct launch_place* out)
+{
+	if (!fsrv_place.init)
+		place_init();
+
+	struct launch_class* cl = find_class(name);
+	*out = (struct launch_place){.procs = -1, .nice = child_priority()};
+	if (!cl)
+		return;
+
+	out->procs = class_cgroup(cl);
+	out->nice += cl->nice;
+
+#ifdef __LINUX
+	out->policy = sched_policies[cl->sched];
+	if (out->policy == SCHED_FIFO || out->policy == SCHED_RR){
+		int pmin = sched_get_priority_min(out->policy);
+		int pmax = sched_get_priority_max(out->policy);
+		out->param.sched_priority =
+			cl->prio < pmin ? pmin : (cl->prio > pmax ? pmax : cl->prio);
+		out->policy |= SCHED_RESET_ON_FORK;
+	}
+
+	if (cl->cpus)
+		out->affinity = parse_cpulist(cl->cpus, &out->cpus);
+	else if (cl->spare && fsrv_place.reserved){
+		out->cpus = fsrv_place.free;
+		out->affinity = true;
+	}
+#endif
+}
+
+/* pid 0 is the child side of fork, otherwise an already running (pooled) one */
+static void place_apply(struct launch_place* pl, pid_t pid)
+{
+	if (-1 != pl->procs){
+		char buf[24];
+		snprintf(buf, sizeof(buf), "%d", (int) pid);
+		write(pl->procs, buf, strlen(buf));
+	}
+
+#ifdef __LINUX
+	if (pl->affinity)
+		sched_setaffinity(pid, sizeof(cpu_set_t), &pl->cpus);
+
+/* realtime needs RLIMIT_RTPRIO or CAP_SYS_NICE, fall back to just nice */
+	bool rt = false;
+	if (pl->policy != SCHED_OTHER)
+		rt = 0 == sched_setscheduler(pid, pl->policy, &pl->param) &&
+			pl->param.sched_priority > 0;
+	else if (pid)
+		sched_setscheduler(pid, SCHED_OTHER, &pl->param);
+
+	if (rt)
+		return;
+#endif
+
+	setpriority(PRIO_PROCESS, pid, pl->nice);
+}
+
+/*
+ * child side of the fork, [clsock] is the connection socket that ends up as
+ * descriptor 3, never returns
+ */
+static void exec_child(struct frameserver_envp* setup,
+	struct arcan_strarr* arr, int clsock, struct launch_place* pl)
+{
+/* the cgroup.procs descriptor goes with closefrom so place first */
+	place_apply(pl, 0);
+
+	close(STDERR_FILENO+1);
+/* will also strip CLOEXEC */
+	dup2(clsock, STDERR_FILENO+1);
+	arcan_closefrom(STDERR_FILENO+2);
+
+/* split out into a new session */
+	if (setsid() == -1)
+		_exit(EXIT_FAILURE);
+
+/* do this twice so that they have the correct mode and the 'right' ops fail */
+	int nfd = open("/dev/null", O_RDONLY);
+	if (-1 != nfd){
+		dup2(nfd, STDIN_FILENO);
+		close(nfd);
+	}
+
+	nfd = open("/dev/null", O_WRONLY);
+	if (-1 != nfd){
+		dup2(nfd, STDOUT_FILENO);
+		dup2(nfd, STDERR_FILENO);
+		close(nfd);
+	}
+
+/*
+ * we need to mask this signal as when debugging parent process, GDB pushes
+ * SIGINT to children, killing them and changing the behavior in the core
+ * process
+ */
+	sigaction(SIGPIPE, &(struct sigaction){
+		.sa_handler = SIG_IGN}, NULL);
+
+	if (setup->use_builtin){
+		char* argv[] = {
+			arcan_fetch_namespace(RESOURCE_SYS_BINS),
+			(char*) setup->args.builtin.mode,
+			NULL
+		};
+
+/* OVERRIDE/INHERIT rather than REPLACE environment (terminal, ...) */
+		if (setup->preserve_env){
+			for (size_t i = 0; i < arr->count;	i++){
+				if (!(arr->data[i] || arr->data[i][0]))
+					continue;
+
+				char* val = strchr(arr->data[i], '=');
+				*val++ = '\0';
+				setenv(arr->data[i], val, 1);
+			}
+			execv(argv[0], argv);
+		}
+		else
+			execve(argv[0], argv, arr->data);
+
+		arcan_warning("platform_fsrv_spawn_server() failed: %s, %s\n",
+			strerror(errno), argv[0]);
+			;
+		_exit(EXIT_FAILURE);
+	}
+/* non-frameserver executions (hijack libs, ...) */
+	else {
+		execve(setup->args.external.fname,
+			setup->args.external.argv->data, setup->args.external.envv->data);
+		_exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Prewarmed frameservers (frameserver_pool=mode=n,mode=n), the process is
+ * forked, executed and given its connection and segment ahead of time and
+ * then blocks on the socket until launch_fork sends the launch arguments.
+ * This leaves the exec, dynamic linking and segment allocation outside of
+ * the launch itself. Only archetypes that map 1:1 to a mode and don't need
+ * a custom feed are eligible.
+ */
+#ifndef FSRV_POOL_LIMIT
+#define FSRV_POOL_LIMIT 16
+#endif
+
+#ifndef FSRV_POOL_MODES
+#define FSRV_POOL_MODES 8
+#endif
+
+/* a pool that keeps getting dead children is disabled rather than refilled */
+#define FSRV_POOL_FAILLIM 3
+
+static struct {
+	bool init;
+	size_t n_pools;
+	struct {
+		char* mode;
+		bool preserve_env;
+		size_t limit;
+		size_t count;
+		size_t fails;
+		struct arcan_frameserver* ents[FSRV_POOL_LIMIT];
+	} pools[FSRV_POOL_MODES];
+
+/* connpoint=n, spare segments for connection points that get re-armed */
+	size_t n_connpoints;
+	size_t connpoint_limit;
+	struct {
+		char* key;
+		mode_t mode;
+		size_t w, h;
+		struct arcan_frameserver* spare;
+	} connpoints[FSRV_POOL_LIMIT];
+} fsrv_pool;
+
+static const char* pool_modes[] = {
+	"decode", "avfeed", "terminal", "game", "remoting"
+};
+
+static void pool_init()
+{
+	fsrv_pool.init = true;
+
+	uintptr_t tag;
+	char* val;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+	if (!get_config("frameserver_pool", 0, &val, tag) || !val)
+		return;
+
+	char* tmp;
+	for (char* tok = strtok_r(val, ",", &tmp); tok &&
+		fsrv_pool.n_pools < FSRV_POOL_MODES; tok = strtok_r(NULL, ",", &tmp)){
+		char* cnt = strchr(tok, '=');
+		size_t limit = 1;
+		if (cnt){
+			*cnt++ = '\0';
+			limit = strtoul(cnt, NULL, 10);
+		}
+		limit = limit > FSRV_POOL_LIMIT ? FSRV_POOL_LIMIT : limit;
+
+		if (strcmp(tok, "connpoint") == 0){
+			fsrv_pool.connpoint_limit = limit;
+			continue;
+		}
+
+		bool known = false;
+		for (size_t i = 0; i < COUNT_OF(pool_modes) && !known; i++)
+			known = strcmp(pool_modes[i], tok) == 0;
+
+		if (!known || !limit){
+			arcan_warning("frameserver_pool: ignoring (%s)\n", tok);
+			continue;
+		}
+
+		size_t i = fsrv_pool.n_pools++;
+		fsrv_pool.pools[i].mode = strdup(tok);
+		fsrv_pool.pools[i].preserve_env = strcmp(tok, "terminal") == 0;
+		fsrv_pool.pools[i].limit = limit;
+	}
+
+	free(val);
+}
+
+static bool pool_spawn(size_t ind)
+{
+	int clsock;
+	struct arcan_frameserver* ctx =
+		platform_fsrv_spawn_server(SEGID_UNKNOWN, 0, 0, 0, &clsock);
+	if (!ctx)
+		return false;
+
+/* same environment as a normal launch, minus the argument */
+	struct arcan_strarr arr = {0};
+	append_env(&arr, NULL, "3", ctx->shm.key);
+	if (arr.limit - arr.count < 2)
+		arcan_mem_growarr(&arr);
+	arr.data[arr.count++] = strdup("ARCAN_FRAMESERVER_POOL=1");
+	arr.data[arr.count] = NULL;
+
+	struct frameserver_envp setup = {
+		.use_builtin = true,
+		.preserve_env = fsrv_pool.pools[ind].preserve_env,
+		.args.builtin.mode = fsrv_pool.pools[ind].mode
+	};
+
+/* launch_fork re-places it if the launch asks for another class */
+	struct launch_place pl;
+	place_resolve(archetype_class(&setup), &pl);
+
+	pid_t child = fork();
+	if (child == 0)
+		exec_child(&setup, &arr, clsock, &pl);
+
+	close(clsock);
+	arcan_mem_freearr(&arr);
+
+	if (-1 == child){
+		platform_fsrv_destroy(ctx);
+		return false;
+	}
+
+	ctx->child = child;
+	fsrv_pool.pools[ind].ents[fsrv_pool.pools[ind].count++] = ctx;
+	return true;
+}
+
+/* the child might have died while waiting (killed, missing binary, ...) */
+static bool pool_alive(struct arcan_frameserver* ctx)
+{
+	int status;
+	if (waitpid(ctx->child, &status, WNOHANG) == 0)
+		return true;
+
+/* already reaped, don't let destroy signal a pid that might be reused */
+	ctx->child = BROKEN_PROCESS_HANDLE;
+	return false;
+}
+
+/* [ARCAN_ARG=arg\0]\0 over the connection socket, see frameserver.c */
+static bool pool_handover(struct arcan_frameserver* ctx, const char* arg)
+{
+	size_t len = arg && arg[0] ? strlen(arg) + sizeof("ARCAN_ARG=") : 0;
+	char buf[len + 1];
+	if (len)
+		snprintf(buf, len, "ARCAN_ARG=%s", arg);
+	buf[len] = '\0';
+
+	size_t ofs = 0;
+	while (ofs < len + 1){
+		ssize_t nw = write(ctx->dpipe, &buf[ofs], len + 1 - ofs);
+		if (nw > 0){
+			ofs += nw;
+			continue;
+		}
+		if (-1 == nw && (errno == EAGAIN || errno == EINTR) &&
+			poll(&(struct pollfd){.fd = ctx->dpipe, .events = POLLOUT}, 1, 10) > 0)
+			continue;
+		return false;
+	}
+
+	return true;
+}
+
+static struct arcan_frameserver* pool_take(struct frameserver_envp* setup)
+{
+	if (!fsrv_pool.init)
+		pool_init();
+
+	if (!setup->use_builtin || setup->custom_feed ||
+		setup->init_w || setup->init_h)
+		return NULL;
+
+	for (size_t i = 0; i < fsrv_pool.n_pools; i++){
+		if (strcmp(fsrv_pool.pools[i].mode, setup->args.builtin.mode) != 0 ||
+			fsrv_pool.pools[i].preserve_env != setup->preserve_env)
+			continue;
+
+		while (fsrv_pool.pools[i].count){
+			struct arcan_frameserver* ctx =
+				fsrv_pool.pools[i].ents[--fsrv_pool.pools[i].count];
+
+			if (pool_alive(ctx) &&
+				pool_handover(ctx, setup->args.builtin.resource)){
+				fsrv_pool.pools[i].fails = 0;
+				return ctx;
+			}
+
+			fsrv_pool.pools[i].fails++;
+			platform_fsrv_destroy(ctx);
+		}
+		break;
+	}
+
+	return NULL;
+}
+
+void platform_launch_pool_step()
+{
+	if (!fsrv_pool.init)
+		pool_init();
+
+/* refill at most one per pool and call so a burst of launches doesn't
+ * turn into a burst of forks on the next tick */
+	for (size_t i = 0; i < fsrv_pool.n_pools; i++){
+		if (fsrv_pool.pools[i].fails >= FSRV_POOL_FAILLIM)
+			continue;
+
+		for (size_t j = 0; j < fsrv_pool.pools[i].count; j++){
+			if (pool_alive(fsrv_pool.pools[i].ents[j]))
+				continue;
+
+			platform_fsrv_destroy(fsrv_pool.pools[i].ents[j]);
+			fsrv_pool.pools[i].ents[j] =
+				fsrv_pool.pools[i].ents[--fsrv_pool.pools[i].count];
+			if (++fsrv_pool.pools[i].fails == FSRV_POOL_FAILLIM){
+				arcan_warning("frameserver_pool: (%s) children keep dying, "
+					"pool disabled\n", fsrv_pool.pools[i].mode);
+			}
+			break;
+		}
+
+		if (fsrv_pool.pools[i].count < fsrv_pool.pools[i].limit)
+			pool_spawn(i);
+	}
+
+/* same pacing for connection points, one spare page per call */
+	for (size_t i = 0; i < fsrv_pool.n_connpoints; i++){
+		if (fsrv_pool.connpoints[i].spare)
+			continue;
+
+		fsrv_pool.connpoints[i].spare = platform_fsrv_listen_prepare(
+			fsrv_pool.connpoints[i].mode,
+			fsrv_pool.connpoints[i].w, fsrv_pool.connpoints[i].h
+		);
+		break;
+	}
+}
+
+/*
+ * A connection point is re-armed from the script by calling target_alloc on
+ * the same key from within the 'connected' handler, and the next client can't
+ * be answered until that has happened. With connpoint=n in frameserver_pool,
+ * the n most recent keys keep a spare segment mapped (refilled from pool_step)
+ * so the re-arm only has to bind the inherited socket and the client gets the
+ * key and page in the same poll as the accept.
+ */
+static struct arcan_frameserver* connpoint_take(const char* key,
+	const char* pw, int fd, mode_t mode, size_t w, size_t h, uintptr_t tag)
+{
+	if (!fsrv_pool.init)
+		pool_init();
+
+	if (!fsrv_pool.connpoint_limit || !key)
+		return NULL;
+
+	size_t i = 0;
+	for (; i < fsrv_pool.n_connpoints; i++)
+		if (strcmp(fsrv_pool.connpoints[i].key, key) == 0)
+			break;
+
+/* new key, evict the oldest if needed and let pool_step prepare it */
+	if (i == fsrv_pool.n_connpoints){
+		if (fsrv_pool.n_connpoints == fsrv_pool.connpoint_limit){
+			free(fsrv_pool.connpoints[0].key);
+			if (fsrv_pool.connpoints[0].spare)
+				platform_fsrv_destroy(fsrv_pool.connpoints[0].spare);
+			memmove(&fsrv_pool.connpoints[0], &fsrv_pool.connpoints[1],
+				sizeof(fsrv_pool.connpoints[0]) * --fsrv_pool.n_connpoints);
+			i--;
+		}
+
+		fsrv_pool.connpoints[i].key = strdup(key);
+		fsrv_pool.connpoints[i].mode = mode;
+		fsrv_pool.connpoints[i].w = w;
+		fsrv_pool.connpoints[i].h = h;
+		fsrv_pool.connpoints[i].spare = NULL;
+		fsrv_pool.n_connpoints++;
+		return NULL;
+	}
+
+/* the page has to match, the socket is either the inherited one or new */
+	struct arcan_frameserver* res = fsrv_pool.connpoints[i].spare;
+	if (!res ||
+		fsrv_pool.connpoints[i].mode != mode ||
+		fsrv_pool.connpoints[i].w != w || fsrv_pool.connpoints[i].h != h){
+		if (res)
+			platform_fsrv_destroy(res);
+		fsrv_pool.connpoints[i].spare = NULL;
+		fsrv_pool.connpoints[i].mode = mode;
+		fsrv_pool.connpoints[i].w = w;
+		fsrv_pool.connpoints[i].h = h;
+		return NULL;
+	}
+
+	fsrv_pool.connpoints[i].spare = NULL;
+	if (!platform_fsrv_listen_bind(res, key, pw, fd, tag)){
+		platform_fsrv_destroy(res);
+		return NULL;
+	}
+
+	return res;
+}
+
 /*
  * this warrants explaining - to avoid dynamic allocations in the asynch unsafe
  * context of fork, we prepare the str_arr in *setup along with all envs needed
@@ -279,15 +1048,30 @@ struct arcan_frameserver* platform_launch_fork(
 	const char* source;
 	int modem = 0;
 	bool add_audio = true;
-	int clsock;
+	int clsock = -1;
 
-	struct arcan_frameserver* ctx =
-		platform_fsrv_spawn_server(
+/* a prewarmed one already has its process and segment */
+	struct launch_place pl;
+	const char* class = launch_class(setup);
+	place_resolve(class, &pl);
+
+	struct arcan_frameserver* ctx = pool_take(setup);
+	bool pooled = ctx != NULL;
+
+	if (pooled){
+		ctx->tag = tag;
+		if (strcmp(class, archetype_class(setup)) != 0)
+			place_apply(&pl, ctx->child);
+	}
+	else
+		ctx = platform_fsrv_spawn_server(
 			SEGID_UNKNOWN, setup->init_w, setup->init_h, tag, &clsock);
 
 	if (!ctx)
 		return NULL;
 
+/* after the handover block for pooled ones, see pool_handover */
+	platform_fsrv_pushshm(ctx);
 	ctx->launchedtime = arcan_frametime();
 	ctx->source = NULL;
 
@@ -320,8 +1104,9 @@ struct arcan_frameserver* platform_launch_fork(
 			setup->args.builtin.resource ?
 			setup->args.builtin.resource : setup->args.builtin.mode);
 
-		append_env(&arr,
-			(char*) setup->args.builtin.resource, "3", ctx->shm.key);
+		if (!pooled)
+			append_env(&arr,
+				(char*) setup->args.builtin.resource, "3", ctx->shm.key);
 	}
 	else{
 		ctx->source = strdup(
@@ -358,96 +1143,21 @@ struct arcan_frameserver* platform_launch_fork(
 	}
 
 /* spawn the process */
-	pid_t child = fork();
-	if (child){
-		ctx->child = child;
-	}
-	else if (child == 0){
-		close(STDERR_FILENO+1);
-/* will also strip CLOEXEC */
-		dup2(clsock, STDERR_FILENO+1);
-		arcan_closefrom(STDERR_FILENO+2);
-
-/* split out into a new session */
-		if (setsid() == -1)
-			_exit(EXIT_FAILURE);
-
-/* drop our nice level to normal user, have that configurable so that some
- * setups may allow trusted launch-path children to have higher priority */
-		uintptr_t cfg;
-		cfg_lookup_fun get_config = platform_config_lookup(&cfg);
-		int level = 0;
-		char* priostr;
-
-/* nice itself will clamp */
-		if (get_config("child_priority", 0, &priostr, cfg)){
-			level = (int) strtol(priostr, NULL, 10) % INT_MAX;
-		}
-		setpriority(PRIO_PROCESS, 0, level);
-
-/* do this twice so that they have the correct mode and the 'right' ops fail */
-		int nfd = open("/dev/null", O_RDONLY);
-		if (-1 != nfd){
-			dup2(nfd, STDIN_FILENO);
-			close(nfd);
-		}
-
-		nfd = open("/dev/null", O_WRONLY);
-		if (-1 != nfd){
-			dup2(nfd, STDOUT_FILENO);
-			dup2(nfd, STDERR_FILENO);
-			close(nfd);
+	if (!pooled){
+		pid_t child = fork();
+		if (child > 0){
+			ctx->child = child;
 		}
-
-/*
- * we need to mask this signal as when debugging parent process, GDB pushes
- * SIGINT to children, killing them and changing the behavior in the core
- * process
- */
-		sigaction(SIGPIPE, &(struct sigaction){
-			.sa_handler = SIG_IGN}, NULL);
-
-		if (setup->use_builtin){
-			char* argv[] = {
-				arcan_fetch_namespace(RESOURCE_SYS_BINS),
-				(char*) setup->args.builtin.mode,
-				NULL
-			};
-
-/* OVERRIDE/INHERIT rather than REPLACE environment (terminal, ...) */
-			if (setup->preserve_env){
-				for (size_t i = 0; i < arr.count;	i++){
-					if (!(arr.data[i] || arr.data[i][0]))
-						continue;
-
-					char* val = strchr(arr.data[i], '=');
-					*val++ = '\0';
-					setenv(arr.data[i], val, 1);
-				}
-				execv(argv[0], argv);
-			}
-			else
-				execve(argv[0], argv, arr.data);
-
-			arcan_warning("platform_fsrv_spawn_server() failed: %s, %s\n",
-				strerror(errno), argv[0]);
-				;
-			_exit(EXIT_FAILURE);
-		}
-/* non-frameserver executions (hijack libs, ...) */
+		else if (child == 0)
+			exec_child(setup, &arr, clsock, &pl);
+/* out of alloted limit of subprocesses */
 		else {
-			execve(setup->args.external.fname,
-				setup->args.external.argv->data, setup->args.external.envv->data);
-			_exit(EXIT_FAILURE);
+			arcan_video_deleteobject(ctx->vid);
+			platform_fsrv_destroy(ctx);
+			return NULL;
 		}
+		close(clsock);
 	}
-/* out of alloted limit of subprocesses */
-	else {
-		arcan_video_deleteobject(ctx->vid);
-		platform_fsrv_destroy(ctx);
-		return NULL;
-	}
-	close(clsock);
 
 /* most kinds will need this, not the encode though */
 	arcan_errc errc;
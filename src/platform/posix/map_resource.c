@@ -25,22 +25,59 @@
 #define MAX_RESMAP_SIZE (1024 * 1024 * 40)
 #endif
 
+/* prefault mappings up to this size, larger ones just get the readahead hint */
+#ifndef RESMAP_POPULATE_SIZE
+#define RESMAP_POPULATE_SIZE (1024 * 1024 * 4)
+#endif
+
+#ifdef MAP_POPULATE
+#define MAP_POPULATE_FLAG MAP_POPULATE
+#else
+#define MAP_POPULATE_FLAG 0
+#endif
+
+/* [dofs] set to NULL means skip [ntr] bytes */
 static inline bool read_safe(int fd, size_t ntr, int bs, char* dofs)
 {
+	char skip[bs];
 	char* dbuf = dofs;
 
 	while (ntr > 0){
-		int nr = read(fd, dbuf, bs > ntr ? ntr : bs);
+		ssize_t nr = read(fd, dofs ? dbuf : skip, (size_t) bs > ntr ? ntr : (size_t) bs);
 
-		if (nr > 0)
+		if (nr > 0){
 			ntr -= nr;
-		else
-			if (errno == EINTR);
+			if (dofs)
+				dbuf += nr;
+		}
+		else if (-1 == nr && errno == EINTR)
+			;
 		else
 			break;
+	}
+
+	return ntr == 0;
+}
 
-		if (dofs)
-			dbuf += nr;
+/* pread leaves the descriptor position alone, for the pipe/socket cases fall
+ * back to skipping and reading, see flow cases */
+static inline bool pread_safe(int fd, size_t ntr, off_t ofs, char* dofs)
+{
+	while (ntr > 0){
+		ssize_t nr = pread(fd, dofs, ntr, ofs);
+		if (nr > 0){
+			ntr -= nr;
+			dofs += nr;
+			ofs += nr;
+		}
+		else if (-1 == nr && errno == EINTR)
+			;
+		else if (-1 == nr && errno == ESPIPE)
+			return
+				(ofs == 0 || read_safe(fd, ofs, 8192, NULL)) &&
+				read_safe(fd, ntr, 8192, dofs);
+		else
+			break;
 	}
 
 	return ntr == 0;
@@ -71,22 +108,43 @@ map_region arcan_map_resource(data_source* source, bool allowwrite)
 		return rv;
 
 /*
- * for unaligned reads (or in-place modifiable memory)
- * we manually read the file into a buffer
+ * for unaligned reads we manually read the file into a buffer
  */
-	if (source->start % sysconf(_SC_PAGE_SIZE) != 0 || allowwrite){
+	if (source->start % sysconf(_SC_PAGE_SIZE) != 0){
+		goto memread;
+	}
+
+/*
+ * In-place modifiable memory is a private (copy on write) mapping, only the
+ * pages that actually get modified are copied. This fails on pipes and the
+ * likes, then go with the buffer.
+ */
+	if (allowwrite){
+		if (MAX_RESMAP_SIZE > source->len){
+			rv.ptr = mmap(NULL, source->len, PROT_READ | PROT_WRITE,
+				MAP_FILE | MAP_PRIVATE, source->fd, source->start);
+			if (rv.ptr != MAP_FAILED){
+				rv.sz = source->len;
+				rv.mmap = true;
+				return rv;
+			}
+			rv.ptr = NULL;
+		}
 		goto memread;
 	}
 
 /*
  * The use-cases for most resources mapped in this manner relies on
  * mapping reasonably small buffer lengths for decoding. Reasonably
- * is here defined by MAX_RESMAP_SIZE
+ * is here defined by MAX_RESMAP_SIZE. The contents are decoded right
+ * away so fault in small ones now rather than one page at a time.
  */
 	if (0 < source->len && MAX_RESMAP_SIZE > source->len){
+		int flags = MAP_FILE | MAP_PRIVATE;
+		if (source->len <= RESMAP_POPULATE_SIZE)
+			flags |= MAP_POPULATE_FLAG;
 		rv.sz  = source->len;
-		rv.ptr = mmap(NULL, rv.sz, PROT_READ,
-			MAP_FILE | MAP_PRIVATE, source->fd, source->start);
+		rv.ptr = mmap(NULL, rv.sz, PROT_READ, flags, source->fd, source->start);
 
 		if (rv.ptr == MAP_FAILED){
 			char errbuf[64];
@@ -102,6 +160,10 @@ map_region arcan_map_resource(data_source* source, bool allowwrite)
 		}
 		else{
 			rv.mmap = true;
+#ifdef MADV_WILLNEED
+			if (!(flags & MAP_POPULATE_FLAG) || !MAP_POPULATE_FLAG)
+				madvise(rv.ptr, rv.sz, MADV_WILLNEED);
+#endif
 		}
 	}
 	return rv;
@@ -110,24 +172,20 @@ memread:
 	rv.ptr  = malloc(source->len);
 	rv.sz   = source->len;
 	rv.mmap = false;
+	if (!rv.ptr){
+		rv.sz = 0;
+		return rv;
+	}
+
 /*
  * there are several devices where we can assume that seeking is not possible,
  * then we automatically convert seeking to "skipping"
  */
-		bool rstatus = true;
-		if (source->start > 0 && -1 == lseek(source->fd, SEEK_SET, source->start)){
-			rstatus = read_safe(source->fd, source->start, 8192, NULL);
-		}
-
-		if (rstatus){
-			rstatus = read_safe(source->fd, source->len, 8192, rv.ptr);
-		}
-
-		if (!rstatus){
-			free(rv.ptr);
-			rv.ptr = NULL;
-			rv.sz  = 0;
-		}
+	if (!pread_safe(source->fd, source->len, source->start, rv.ptr)){
+		free(rv.ptr);
+		rv.ptr = NULL;
+		rv.sz  = 0;
+	}
 
 	return rv;
 }
@@ -17,6 +17,7 @@
 #include <stdbool.h>
 #include <signal.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <sys/mman.h>
 
@@ -47,8 +48,248 @@ struct mempool_meta {
 	size_t in_use;
 	size_t monitor_sz;
 	size_t n_pages;
+
+/* ARCAN_MEM_SLAB pools, [monitor_sz] is the object size and [n_pages] the
+ * number of slabs assigned, the tick_ values are latched in arcan_mem_tick */
+	struct slab_obj* free;
+	size_t sys_alloc;
+	size_t tick_alloc, tick_sys_alloc;
+	size_t mark_alloc, mark_sys_alloc;
+	pthread_mutex_t lock;
+};
+
+/*
+ * The slab pools share one reserved (lazily committed) range that is carved
+ * into SLAB_SIZE slabs as size classes run out of free objects. Slabs are not
+ * returned, the pools are sized by the peak use. Keeping them in one range
+ * means arcan_mem_free can tell a pool object from a system allocation with a
+ * range check, and the slab index gives the size class.
+ *
+ * ARCAN_MEM_NOSLAB (env) turns it off, as does building with ASan so that
+ * use-after-free of pool objects is still caught.
+ */
+#ifndef SLAB_ARENA_SIZE
+#define SLAB_ARENA_SIZE (128 * 1024 * 1024)
+#endif
+
+#define SLAB_SIZE (64 * 1024)
+
+struct slab_obj {
+	struct slab_obj* next;
 };
 
+static const size_t slab_classes[] = {32, 64, 128, 256, 512};
+#define SLAB_CLASSES (sizeof(slab_classes) / sizeof(slab_classes[0]))
+
+static struct {
+	pthread_once_t once;
+	bool disabled;
+	uint8_t* base;
+	size_t used;
+	pthread_mutex_t lock;
+	uint8_t cls[SLAB_ARENA_SIZE / SLAB_SIZE];
+	struct mempool_meta pools[SLAB_CLASSES];
+} slab = {
+	.once = PTHREAD_ONCE_INIT,
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static void slab_init()
+{
+#if defined(__SANITIZE_ADDRESS__)
+	slab.disabled = true;
+#endif
+	if (getenv("ARCAN_MEM_NOSLAB"))
+		slab.disabled = true;
+
+	for (size_t i = 0; i < SLAB_CLASSES; i++){
+		slab.pools[i].monitor_sz = slab_classes[i];
+		pthread_mutex_init(&slab.pools[i].lock, NULL);
+	}
+
+	if (slab.disabled)
+		return;
+
+	void* base = mmap(NULL, SLAB_ARENA_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (base == MAP_FAILED)
+		slab.disabled = true;
+	else
+		slab.base = base;
+}
+
+/* pool lock held, assign a new slab to the pool and split it into objects */
+static bool slab_grow(struct mempool_meta* pool, uint8_t cls)
+{
+	pthread_mutex_lock(&slab.lock);
+	size_t ind = slab.used;
+	bool ok = ind < SLAB_ARENA_SIZE / SLAB_SIZE;
+	if (ok){
+		slab.cls[ind] = cls;
+		slab.used++;
+	}
+	pthread_mutex_unlock(&slab.lock);
+
+	if (!ok)
+		return false;
+
+	uint8_t* mem = slab.base + ind * SLAB_SIZE;
+	for (size_t ofs = 0; ofs + pool->monitor_sz <= SLAB_SIZE; ofs += pool->monitor_sz){
+		struct slab_obj* obj = (struct slab_obj*) &mem[ofs];
+		obj->next = pool->free;
+		pool->free = obj;
+	}
+
+	pool->n_pages++;
+	return true;
+}
+
+/* NULL means that the caller should use the system allocator */
+static void* slab_alloc(size_t nb)
+{
+	pthread_once(&slab.once, slab_init);
+
+	size_t cls = 0;
+	while (cls < SLAB_CLASSES && slab_classes[cls] < nb)
+		cls++;
+
+/* too large, accounted for in the largest class */
+	struct mempool_meta* pool = &slab.pools[cls < SLAB_CLASSES ? cls : SLAB_CLASSES - 1];
+	pthread_mutex_lock(&pool->lock);
+
+	if (slab.disabled || cls == SLAB_CLASSES || (!pool->free && !slab_grow(pool, cls))){
+		pool->sys_alloc++;
+		pthread_mutex_unlock(&pool->lock);
+		return NULL;
+	}
+
+	struct slab_obj* obj = pool->free;
+	pool->free = obj->next;
+	pool->in_use++;
+	pool->alloc_cnt++;
+	pthread_mutex_unlock(&pool->lock);
+
+	return obj;
+}
+
+static bool slab_free(void* ptr)
+{
+	uint8_t* mem = ptr;
+	if (!slab.base || mem < slab.base || mem >= slab.base + SLAB_ARENA_SIZE)
+		return false;
+
+	struct mempool_meta* pool = &slab.pools[slab.cls[(mem - slab.base) / SLAB_SIZE]];
+	struct slab_obj* obj = ptr;
+
+	pthread_mutex_lock(&pool->lock);
+	obj->next = pool->free;
+	pool->free = obj;
+	pool->in_use--;
+	pool->dealloc_cnt++;
+	pthread_mutex_unlock(&pool->lock);
+
+	return true;
+}
+
+/*
+ * The frame arena is one reserved range split in three regions, [0] for
+ * ARCAN_MEM_FRAME blocks and the other two alternating as the current carry
+ * region for ARCAN_MEM_FRAMECARRY so that those live through one more reset.
+ * Blocks are bump allocated and a reset just rewinds the region. With ASan
+ * the released part is poisoned (and blocks get a poisoned gap in between),
+ * debug builds fill it with a pattern instead so stale pointers show up.
+ */
+#ifndef FRAME_ARENA_SIZE
+#define FRAME_ARENA_SIZE (16 * 1024 * 1024)
+#endif
+
+#define FRAME_ALIGN 16
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+#define FRAME_REDZONE 16
+#define FRAME_POISON(A, B) ASAN_POISON_MEMORY_REGION(A, B)
+#define FRAME_UNPOISON(A, B) ASAN_UNPOISON_MEMORY_REGION(A, B)
+#else
+#define FRAME_REDZONE 0
+#define FRAME_POISON(A, B)
+#define FRAME_UNPOISON(A, B)
+#endif
+
+static struct {
+	uint8_t* base;
+	pthread_t owner;
+	size_t ofs[3];
+	size_t carry;
+} frame = {
+	.carry = 1
+};
+
+static uint8_t* frame_region(size_t ind)
+{
+	return frame.base + ind * FRAME_ARENA_SIZE;
+}
+
+/* NULL means that the caller should use the normal path */
+static void* frame_alloc(size_t nb, bool carry)
+{
+	if (!frame.base || !pthread_equal(frame.owner, pthread_self()))
+		return NULL;
+
+	size_t ind = carry ? frame.carry : 0;
+	size_t step = (nb + FRAME_REDZONE + FRAME_ALIGN - 1) & ~(FRAME_ALIGN - 1);
+	if (step > FRAME_ARENA_SIZE - frame.ofs[ind])
+		return NULL;
+
+	uint8_t* mem = frame_region(ind) + frame.ofs[ind];
+	frame.ofs[ind] += step;
+	FRAME_UNPOISON(mem, nb);
+
+	return mem;
+}
+
+static bool frame_owns(void* ptr)
+{
+	uint8_t* mem = ptr;
+	return frame.base && mem >= frame.base && mem < frame.base + 3 * FRAME_ARENA_SIZE;
+}
+
+static void frame_release(size_t ind)
+{
+	if (!frame.ofs[ind])
+		return;
+
+#ifdef _DEBUG
+	memset(frame_region(ind), 0xdd, frame.ofs[ind]);
+#endif
+	FRAME_POISON(frame_region(ind), frame.ofs[ind]);
+	frame.ofs[ind] = 0;
+}
+
+void arcan_mem_frame_reset()
+{
+	if (!frame.base){
+		if (getenv("ARCAN_MEM_NOFRAME"))
+			return;
+
+		void* base = mmap(NULL, 3 * FRAME_ARENA_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (base == MAP_FAILED)
+			return;
+
+		FRAME_POISON(base, 3 * FRAME_ARENA_SIZE);
+		frame.owner = pthread_self();
+		frame.base = base;
+		return;
+	}
+
+/* the carry region that was filled before the last reset is the one to go */
+	frame_release(0);
+	frame.carry = frame.carry == 1 ? 2 : 1;
+	frame_release(frame.carry);
+}
+
 /* pool behaviors:
  * [ SENSITIVE is always a special case ]
  *   |-> pages will remain mapped in dumps, but data will be
@@ -124,6 +365,40 @@ void arcan_mem_init()
  */
 void arcan_mem_tick()
 {
+	pthread_once(&slab.once, slab_init);
+
+	for (size_t i = 0; i < SLAB_CLASSES; i++){
+		struct mempool_meta* pool = &slab.pools[i];
+		pthread_mutex_lock(&pool->lock);
+		pool->tick_alloc = pool->alloc_cnt - pool->mark_alloc;
+		pool->tick_sys_alloc = pool->sys_alloc - pool->mark_sys_alloc;
+		pool->mark_alloc = pool->alloc_cnt;
+		pool->mark_sys_alloc = pool->sys_alloc;
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+size_t arcan_mem_poolstats(struct arcan_mem_poolstat* dst, size_t lim)
+{
+	pthread_once(&slab.once, slab_init);
+
+	for (size_t i = 0; i < SLAB_CLASSES && i < lim; i++){
+		struct mempool_meta* pool = &slab.pools[i];
+		pthread_mutex_lock(&pool->lock);
+		dst[i] = (struct arcan_mem_poolstat){
+			.obj_sz = pool->monitor_sz,
+			.in_use = pool->in_use,
+			.capacity = pool->n_pages * (SLAB_SIZE / pool->monitor_sz),
+			.alloc_cnt = pool->alloc_cnt,
+			.dealloc_cnt = pool->dealloc_cnt,
+			.sys_alloc = pool->sys_alloc,
+			.tick_alloc = pool->tick_alloc,
+			.tick_sys_alloc = pool->tick_sys_alloc
+		};
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	return SLAB_CLASSES;
 }
 
 /*static void sigsegv_hand(int sig, siginfo_t* si, void* unused)
@@ -155,6 +430,22 @@ void* arcan_alloc_mem(size_t nb,
 	size_t padding_sz = 0;
 	size_t total;
 
+/* the frame arena first, SLAB is the fallback off the main thread */
+	if ((hint & ARCAN_MEM_FRAME) && align != ARCAN_MEMALIGN_PAGE &&
+		(hint & ARCAN_MEM_SENSITIVE) == 0 &&
+		(rptr = frame_alloc(nb, (hint & ARCAN_MEM_FRAMECARRY) == ARCAN_MEM_FRAMECARRY))){
+		if (hint & ARCAN_MEM_BZERO)
+			memset(rptr, '\0', nb);
+		return rptr;
+	}
+
+	if ((hint & ARCAN_MEM_SLAB) && align == ARCAN_MEMALIGN_NATURAL &&
+		(hint & ARCAN_MEM_SENSITIVE) == 0 && (rptr = slab_alloc(nb))){
+		if (hint & ARCAN_MEM_BZERO)
+			memset(rptr, '\0', nb);
+		return rptr;
+	}
+
 	switch (type){
 /* this is not safe to _free at the moment since we don't track metadata yet,
  * the refactor adding obsd/musl-new heap allocator should take this into account */
@@ -264,9 +555,10 @@ void arcan_mem_freearr(struct arcan_strarr* res)
 		return;
 
 	char** cptr = res->data;
-	while (cptr && *cptr)
+	while (!res->pack && cptr && *cptr)
 		arcan_mem_free(*cptr++);
 
+	arcan_mem_free(res->pack);
 	arcan_mem_free(res->data);
 
 	memset(res, '\0', sizeof(struct arcan_strarr));
@@ -293,6 +585,9 @@ void* arcan_alloc_fillmem(const void* data,
 
 void arcan_mem_free(void* inptr)
 {
+	if (slab_free(inptr) || frame_owns(inptr))
+		return;
+
 /* lock then free */
 /* depending on type and flag, verify integrity,
  * then cleanup. VBUFFER for instance doesn't
@@ -129,6 +129,20 @@ static char* handle_dynfile(char* base, enum resource_type ares, int* dfd)
 	return base;
 }
 
+/* the index answers without a stat() for most of the appl namespace, and a
+ * miss there is final for the appl, see resindex.c */
+static bool resource_isfile(const char* path)
+{
+	int rv = arcan_resindex_lookup(path);
+	return rv == -1 ? arcan_isfile(path) : rv == 1;
+}
+
+static bool resource_isdir(const char* path)
+{
+	int rv = arcan_resindex_lookup(path);
+	return rv == -1 ? arcan_isdir(path) : rv == 2;
+}
+
 char* arcan_find_resource(const char* label,
 	enum arcan_namespaces space, enum resource_type ares, int* dfd)
 {
@@ -176,8 +190,8 @@ char* arcan_find_resource(const char* label,
 		);
 
 		if (
-			((ares & ARES_FILE) && arcan_isfile(scratch)) ||
-			((ares & ARES_FOLDER) && arcan_isdir(scratch))
+			((ares & ARES_FILE) && resource_isfile(scratch)) ||
+			((ares & ARES_FOLDER) && resource_isdir(scratch))
 		){
 			return handle_dynfile(strdup(scratch), ares, dfd);
 		}
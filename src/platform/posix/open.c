@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stddef.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -28,3 +29,25 @@ int platform_device_open(const char* const identifier, int flags, mode_t mode)
 {
 	return open(identifier, flags, mode);
 }
+
+size_t platform_device_open_batch(
+	const char* const* identifiers, int* fds, size_t n, int flags)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < n; i++){
+		fds[i] = open(identifiers[i], flags);
+		if (-1 != fds[i])
+			count++;
+	}
+	return count;
+}
+
+int platform_device_open_async(const char* const identifier, int flags)
+{
+	return open(identifier, flags);
+}
+
+int platform_device_open_result(char** identifier, int* fd)
+{
+	return 0;
+}
@@ -497,13 +497,17 @@ static int data_in(pid_t child)
 	bool keep;
 	bool release = cmd.cmd_ch == RELEASE_DEVICE;
 
+	errno = 0;
 	int fd = access_device(cmd.path, cmd.arg, release, &keep);
 
 /* release device won't return a valid file descriptor, otherwise
  * it is an error code that should be forwarded */
 
+/* forward the reason so that the client can tell a not-yet-accessible node
+ * (EACCES while udev is still setting permissions) from a rejected one */
 	if (!release && -1 == fd){
 		cmd.cmd_ch = OPEN_FAILED;
+		cmd.arg = errno ? errno : EPERM;
 		write(child_conn, &cmd, sizeof(cmd));
 	}
 	else if (!release){
@@ -720,8 +724,13 @@ static void parent_loop(pid_t child, int netlink)
 	if (pfd[0].revents & ~POLLIN)
 		check_child(child, true);
 
-	if (pfd[0].revents & POLLIN)
-		data_in(child);
+/* a batched open from the client arrives as a run of requests, take all of
+ * them before going back to sleep */
+	if (pfd[0].revents & POLLIN){
+		do {
+			data_in(child);
+		} while (poll(pfd, 1, 0) > 0 && pfd[0].revents == POLLIN);
+	}
 
 /* could add other commands here as well, but what we concern ourselves with
  * at the moment is only GPU changed events, these match the pattern:
@@ -913,7 +922,264 @@ void platform_device_init()
 /*
  * CLIENT SIDE FUNCTIONS
  */
-struct packet pkg_queue[1];
+
+/*
+ * Parent events (display hotplug, VT switch) that arrived while we were
+ * waiting for an open reply, returned by the next platform_device_poll in
+ * the order they came.
+ */
+static struct {
+	enum command cmd[8];
+	size_t count;
+} pkg_queue;
+
+/*
+ * Requests from platform_device_open_async, the reply can be picked up by any
+ * of the functions below that read from the parent, it gets marked as done
+ * and is handed out through platform_device_open_result.
+ */
+#define ASYNC_LIMIT 32
+struct async_req {
+	char* path;
+	int flags;
+	int fd;
+	int err;
+	bool done;
+};
+static struct async_req async_req[ASYNC_LIMIT];
+static size_t async_count;
+
+/*
+ * Already authorized input devices. When the event layer closes and rescans
+ * (VT switching, external launch) the same set of devices gets requested
+ * again, so we keep a copy of the descriptor and hand out a duplicate as
+ * long as the node on the filesystem is still the one we opened. DRM and TTY
+ * devices are left out as the parent needs to see every open of those to
+ * manage master / VT state, as are sysfs paths (shared file offset).
+ */
+#define CACHE_LIMIT 32
+struct cache_ent {
+	char* path;
+	int fd;
+	dev_t dev;
+	ino_t ino;
+	uint64_t used;
+};
+static struct cache_ent fd_cache[CACHE_LIMIT];
+static uint64_t cache_clock;
+
+/* upper bound on requests in flight per batch so that neither side can
+ * block on a full socket buffer while the other is still writing */
+#define BATCH_CHUNK 16
+
+static bool cacheable(const char* path)
+{
+	if (strncmp(path, "/sys", 4) == 0 || strncmp(path, "/dev/dri", 8) == 0)
+		return false;
+
+	for (size_t ind = 0; ind < COUNT_OF(whitelist); ind++){
+		if (whitelist[ind].mode & MODE_PREFIX){
+			if (0 != strncmp(
+				whitelist[ind].name, path, strlen(whitelist[ind].name)))
+				continue;
+		}
+		else if (strcmp(whitelist[ind].name, path) != 0)
+			continue;
+
+		return !(whitelist[ind].mode & (MODE_DRM | MODE_TTY));
+	}
+
+	return false;
+}
+
+static void cache_drop(size_t i)
+{
+	close(fd_cache[i].fd);
+	free(fd_cache[i].path);
+	fd_cache[i] = (struct cache_ent){.fd = -1};
+}
+
+static bool cache_valid(size_t i)
+{
+	struct stat fst, pst;
+	if (-1 == fstat(fd_cache[i].fd, &fst) || -1 == stat(fd_cache[i].path, &pst))
+		return false;
+
+/* the node can have been removed and another device got the same name */
+	if (fst.st_rdev != pst.st_rdev || fst.st_ino != pst.st_ino)
+		return false;
+
+/* removed devices (evdev at least) signal error / hangup */
+	struct pollfd pfd = {.fd = fd_cache[i].fd};
+	if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+		return false;
+
+	return true;
+}
+
+static void cache_insert(const char* path, int fd)
+{
+	if (!cacheable(path))
+		return;
+
+	struct stat fst;
+	if (-1 == fstat(fd, &fst) || !S_ISCHR(fst.st_mode))
+		return;
+
+/* replace the entry for the same path, or a free slot, or the oldest one */
+	size_t ind = CACHE_LIMIT;
+	for (size_t i = 0; i < CACHE_LIMIT && ind == CACHE_LIMIT; i++)
+		if (fd_cache[i].path && strcmp(fd_cache[i].path, path) == 0)
+			ind = i;
+
+	for (size_t i = 0; i < CACHE_LIMIT && ind == CACHE_LIMIT; i++)
+		if (!fd_cache[i].path)
+			ind = i;
+
+	if (ind == CACHE_LIMIT){
+		ind = 0;
+		for (size_t i = 1; i < CACHE_LIMIT; i++)
+			if (fd_cache[i].used < fd_cache[ind].used)
+				ind = i;
+	}
+
+	int cfd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (-1 == cfd)
+		return;
+
+	char* copy = strdup(path);
+	if (!copy){
+		close(cfd);
+		return;
+	}
+
+	if (fd_cache[ind].path)
+		cache_drop(ind);
+
+	fd_cache[ind] = (struct cache_ent){
+		.path = copy,
+		.fd = cfd,
+		.dev = fst.st_rdev,
+		.ino = fst.st_ino,
+		.used = ++cache_clock
+	};
+}
+
+static int cache_lookup(const char* path, int flags)
+{
+	for (size_t i = 0; i < CACHE_LIMIT; i++){
+		if (!fd_cache[i].path || strcmp(fd_cache[i].path, path) != 0)
+			continue;
+
+		if (!cache_valid(i)){
+			cache_drop(i);
+			return -1;
+		}
+
+		int fd = fcntl(fd_cache[i].fd, F_DUPFD_CLOEXEC, 0);
+		if (-1 == fd)
+			return -1;
+
+/* the descriptor has been collecting input while no-one was listening,
+ * flush that out so the caller doesn't get stale (other VT) events, the
+ * evdev client buffer is bounded so this is only a few reads */
+		char buf[1024];
+		fcntl(fd, F_SETFL, O_NONBLOCK);
+		for (size_t i = 0; i < 64 && read(fd, buf, sizeof(buf)) > 0; i++){}
+
+		fcntl(fd, F_SETFL, flags);
+		fd_cache[i].used = ++cache_clock;
+		return fd;
+	}
+
+	return -1;
+}
+
+static bool read_packet(struct packet* pkg)
+{
+	size_t ofs = 0;
+	while (ofs < sizeof(struct packet)){
+		ssize_t nr = read(psock, &((char*)pkg)[ofs], sizeof(struct packet) - ofs);
+		if (nr > 0)
+			ofs += nr;
+		else if (nr == 0 || (errno != EINTR && errno != EAGAIN))
+			return false;
+	}
+	return true;
+}
+
+static bool write_packets(struct packet* pkg, size_t n)
+{
+	size_t ofs = 0;
+	size_t len = n * sizeof(struct packet);
+	while (ofs < len){
+		ssize_t nw = write(psock, &((char*)pkg)[ofs], len - ofs);
+		if (nw > 0)
+			ofs += nw;
+		else if (nw == 0 || (errno != EINTR && errno != EAGAIN))
+			return false;
+	}
+	return true;
+}
+
+static bool psock_ready()
+{
+	struct pollfd pfd = {.fd = psock, .events = POLLIN};
+	return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
+/*
+ * Sort a packet from the parent: events go to the queue, open replies for
+ * async requests are completed in place. Returns true if this was an open
+ * reply that nobody is waiting for, [fd] (or -1 and [err]) is then left for
+ * the caller to match to its own request.
+ */
+static bool route_packet(struct packet* pkg, int* fd, int* err)
+{
+	if (pkg->cmd_ch == OPEN_DEVICE || pkg->cmd_ch == OPEN_FAILED){
+		*fd = -1;
+		*err = pkg->arg;
+
+		if (pkg->cmd_ch == OPEN_DEVICE){
+			*fd = arcan_fetchhandle(psock, true);
+			*err = -1 == *fd ? EBADF : 0;
+		}
+
+/* async requests were all sent before any blocking request that is currently
+ * waiting, and the parent replies in order, so they get first pick */
+		for (size_t i = 0; i < ASYNC_LIMIT; i++){
+			if (!async_req[i].path || async_req[i].done ||
+				strncmp(async_req[i].path, pkg->path, sizeof(pkg->path)) != 0)
+				continue;
+
+			if (-1 != *fd){
+				fcntl(*fd, F_SETFD, FD_CLOEXEC);
+				fcntl(*fd, F_SETFL, async_req[i].flags);
+				cache_insert(async_req[i].path, *fd);
+			}
+			async_req[i].fd = *fd;
+			async_req[i].err = *err;
+			async_req[i].done = true;
+			return false;
+		}
+
+		return true;
+	}
+
+/* NEW_INPUT_DEVICE: not properly handled right now as we have other hotplug
+ * mechanisms in place via inotify in the evdev layer */
+	if (pkg->cmd_ch == NEW_INPUT_DEVICE || pkg->cmd_ch == NO_OP)
+		return false;
+
+	for (size_t i = 0; i < pkg_queue.count; i++)
+		if (pkg_queue.cmd[i] == pkg->cmd_ch)
+			return false;
+
+	if (pkg_queue.count < COUNT_OF(pkg_queue.cmd))
+		pkg_queue.cmd[pkg_queue.count++] = pkg->cmd_ch;
+
+	return false;
+}
 
 void platform_device_release(const char* const name, int ind)
 {
@@ -922,51 +1188,180 @@ void platform_device_release(const char* const name, int ind)
 		.arg = ind
 	};
 
+/* the cached copies would otherwise keep any grab alive while the other VT
+ * tries to use the devices */
+#ifdef __LINUX
+	if (strcmp(name, "TTY") == 0){
+		for (size_t i = 0; i < CACHE_LIMIT; i++)
+			if (fd_cache[i].path)
+				ioctl(fd_cache[i].fd, EVIOCGRAB, 0);
+	}
+#endif
+
+	for (size_t i = 0; i < CACHE_LIMIT; i++)
+		if (fd_cache[i].path && strcmp(fd_cache[i].path, name) == 0)
+			cache_drop(i);
+
 	snprintf(pkg.path, sizeof(pkg.path), "%s", name);
-	write(psock, &pkg, sizeof(pkg));
+	write_packets(&pkg, 1);
+}
+
+size_t platform_device_open_batch(
+	const char* const* names, int* fds, size_t n, int flags)
+{
+	size_t count = 0;
+	struct packet req[BATCH_CHUNK];
+	size_t map[BATCH_CHUNK];
+
+	for (size_t i = 0; i < n;){
+		size_t nreq = 0;
+
+/* satisfy what we can from the cache, the rest goes out in one write */
+		for (; i < n && nreq < BATCH_CHUNK; i++){
+			fds[i] = cache_lookup(names[i], flags);
+			if (-1 != fds[i]){
+				count++;
+				continue;
+			}
+
+			req[nreq] = (struct packet){
+				.cmd_ch = OPEN_DEVICE,
+				.arg = -1
+			};
+			snprintf(req[nreq].path, sizeof(req[nreq].path), "%s", names[i]);
+			map[nreq++] = i;
+		}
+
+		if (!nreq)
+			continue;
+
+		if (!write_packets(req, nreq)){
+			for (size_t j = i; j < n; j++)
+				fds[j] = -1;
+			return count;
+		}
+
+		size_t left = nreq;
+		while (left){
+			struct packet pkg;
+			int fd, err;
+
+			if (!read_packet(&pkg)){
+				for (size_t j = i; j < n; j++)
+					fds[j] = -1;
+				return count;
+			}
+
+			if (!route_packet(&pkg, &fd, &err))
+				continue;
+
+			size_t j = 0;
+			for (; j < nreq; j++)
+				if (map[j] != SIZE_MAX &&
+					strncmp(req[j].path, pkg.path, sizeof(pkg.path)) == 0)
+					break;
+
+/* a reply to a request that has since been given up on */
+			if (j == nreq){
+				if (-1 != fd)
+					close(fd);
+				continue;
+			}
+
+			size_t dst = map[j];
+			fds[dst] = fd;
+			map[j] = SIZE_MAX;
+			left--;
+
+			if (-1 == fd){
+				errno = err;
+				continue;
+			}
+
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+			fcntl(fd, F_SETFL, flags);
+			cache_insert(names[dst], fd);
+			count++;
+		}
+	}
+
+	return count;
 }
 
 int platform_device_open(const char* const name, int flags)
 {
+	int fd;
+	const char* const names[] = {name};
+	platform_device_open_batch(names, &fd, 1, flags);
+	return fd;
+}
+
+int platform_device_open_async(const char* const name, int flags)
+{
+	int fd = cache_lookup(name, flags);
+	if (-1 != fd)
+		return fd;
+
+/* too many in flight, degrade to a normal open rather than fail */
+	if (async_count >= ASYNC_LIMIT)
+		return platform_device_open(name, flags);
+
 	struct packet pkg = {
 		.cmd_ch = OPEN_DEVICE,
 		.arg = -1
 	};
-
 	snprintf(pkg.path, sizeof(pkg.path), "%s", name);
-	if (-1 == write(psock, &pkg, sizeof(pkg)))
+
+	size_t i = 0;
+	for (; i < ASYNC_LIMIT && async_req[i].path; i++){}
+
+	async_req[i] = (struct async_req){
+		.path = strdup(pkg.path),
+		.flags = flags,
+		.fd = -1
+	};
+	if (!async_req[i].path)
+		return platform_device_open(name, flags);
+
+	if (!write_packets(&pkg, 1)){
+		free(async_req[i].path);
+		async_req[i].path = NULL;
 		return -1;
+	}
 
-	while (sizeof(struct packet) == read(psock, &pkg, sizeof(struct packet))){
-/* there might be other command events that we need to respect as there can be
- * both explicit open requests and implicit open requests depending on what
- * kind of device manager that is running on the other side, so we need to
- * queue here */
-		if (pkg.cmd_ch == OPEN_FAILED)
-			return -1;
+	async_count++;
+	errno = EINPROGRESS;
+	return -1;
+}
 
-		else if (pkg.cmd_ch == OPEN_DEVICE){
-			int fd = arcan_fetchhandle(psock, true);
-			if (-1 == fd)
-				return -1;
-			fcntl(fd, F_SETFD, FD_CLOEXEC);
-			fcntl(fd, F_SETFL, flags);
-			return fd;
-		}
+int platform_device_open_result(char** identifier, int* fd)
+{
+	if (!async_count)
+		return 0;
+
+	while (psock_ready()){
+		struct packet pkg;
+		int rfd, err;
 
-		else if (pkg.cmd_ch == DISPLAY_CONNECTOR_STATE)
-			pkg_queue[0] = pkg;
+		if (!read_packet(&pkg))
+			break;
 
-		assert(pkg.cmd_ch != NEW_INPUT_DEVICE);
+		if (route_packet(&pkg, &rfd, &err) && -1 != rfd)
+			close(rfd);
+	}
+
+	for (size_t i = 0; i < ASYNC_LIMIT; i++){
+		if (!async_req[i].path || !async_req[i].done)
+			continue;
+
+		*identifier = async_req[i].path;
+		*fd = async_req[i].fd;
+		async_req[i].path = NULL;
+		async_count--;
+		errno = async_req[i].err;
+		return 1;
 	}
 
-/*
- * When we move the inotify- behavior from evdev additional care needs to
- * be taken here to handle the input device discovery part as the devices
- * received needs to be queued until the engine is in a state to handle them.
- * Then we can simply look at the NETLINK socket for the inputn entries
- * appearing (or use the inotify + folder approach, compile-time option).
- */
 	return 0;
 }
 
@@ -975,11 +1370,29 @@ int platform_device_pollfd()
 	return psock;
 }
 
-int platform_device_poll(char** identifier)
+static int event_code(enum command cmd)
 {
-	if (pkg_queue[0].cmd_ch == DISPLAY_CONNECTOR_STATE){
-		pkg_queue[0] = (struct packet){};
+	switch(cmd){
+	case DISPLAY_CONNECTOR_STATE:
 		return 2;
+	case SYSTEM_STATE_RELEASE:
+		return 3;
+	case SYSTEM_STATE_ACQUIRE:
+		return 4;
+	case SYSTEM_STATE_TERMINATE:
+		return 5;
+	default:
+		return 0;
+	}
+}
+
+int platform_device_poll(char** identifier)
+{
+	if (pkg_queue.count){
+		int rv = event_code(pkg_queue.cmd[0]);
+		memmove(pkg_queue.cmd, &pkg_queue.cmd[1],
+			sizeof(enum command) * --pkg_queue.count);
+		return rv;
 	}
 
 	struct pollfd pfd = {.fd = psock,
@@ -992,32 +1405,22 @@ int platform_device_poll(char** identifier)
 		return -1;
 	}
 
-/* translate from the visible command format to the internal one */
-	struct packet pkg;
-	while (sizeof(struct packet) == read(psock, &pkg, sizeof(struct packet))){
-		switch(pkg.cmd_ch){
-		case NEW_INPUT_DEVICE:
-/* not properly handled right now as we have other hotplug mechanisms in place
- * via inotify in the evdev layer, the problem is that we need to cache new
- * input names until we get a call where there's an identifier provided */
-		break;
-		case DISPLAY_CONNECTOR_STATE:
-			return 2;
-		break;
-		case SYSTEM_STATE_RELEASE:
-			return 3;
-		break;
-		case SYSTEM_STATE_ACQUIRE:
-			return 4;
-		break;
-		case SYSTEM_STATE_TERMINATE:
-			return 5;
-		break;
-		default:
-			return 0;
-		break;
-		}
-	}
+/* translate from the visible command format to the internal one, open
+ * replies for async requests are sorted out along the way */
+	do {
+		struct packet pkg;
+		int fd, err;
+
+		if (!read_packet(&pkg))
+			return -1;
+
+		if (route_packet(&pkg, &fd, &err) && -1 != fd)
+			close(fd);
+
+		if (pkg_queue.count)
+			return platform_device_poll(identifier);
+
+	} while (psock_ready());
 
 	return 0;
 }
@@ -0,0 +1,491 @@
+/*
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Directory contents cache for resource lookups.
+ *
+ * Every find_resource is a stat() per namespace in the search mask and every
+ * glob a readdir() of the target directory, which adds up for appls with a
+ * large number of assets. Here, directories below a root (the appl namespace)
+ * are listed once, sorted and kept current through inotify. Lookups drain the
+ * notification queue first so that changes made by arcan itself (or a
+ * frameserver) are visible to the next lookup. Without inotify, or outside of
+ * the root, the index always answers 'unknown' and callers use the normal
+ * path.
+ *
+ * Symlinks are left out as the target can change without the directory being
+ * touched.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+#ifdef __linux
+#include <sys/inotify.h>
+#endif
+
+#include <arcan_math.h>
+#include <arcan_general.h>
+
+/* upper bounds for the number of watched directories, kept well below the
+ * default max_user_watches, and for the eager walk at appl load */
+#ifndef RESINDEX_DIR_LIMIT
+#define RESINDEX_DIR_LIMIT 1024
+#endif
+
+#ifndef RESINDEX_PRELOAD_DIRS
+#define RESINDEX_PRELOAD_DIRS 128
+#endif
+
+/* number of appl scripts to hint into the page cache at appl load */
+#ifndef RESINDEX_PREFETCH_LIMIT
+#define RESINDEX_PREFETCH_LIMIT 128
+#endif
+
+enum {
+	ENT_OTHER = 0,
+	ENT_FILE = 1,
+	ENT_DIR = 2,
+	ENT_LINK = 3
+};
+
+struct entry {
+	char* name;
+	uint8_t type;
+};
+
+struct dir {
+	char* path;
+	uint64_t hash;
+	int wd;
+	struct entry* ents;
+	size_t n_ents;
+	struct dir* next;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	bool disabled;
+	int notify;
+
+	char* root;
+	size_t root_len;
+
+	struct dir* buckets[256];
+	size_t n_dirs;
+} rindex_state = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.notify = -1
+};
+
+static uint64_t hash_path(const char* path, size_t len)
+{
+	uint64_t hash = 5381;
+	for (size_t i = 0; i < len; i++)
+		hash = ((hash << 5) + hash) + (uint8_t) path[i];
+	return hash;
+}
+
+static int cmp_entry(const void* a, const void* b)
+{
+	return strcmp(((struct entry*)a)->name, ((struct entry*)b)->name);
+}
+
+static void free_dir(struct dir* dir)
+{
+	for (size_t i = 0; i < dir->n_ents; i++)
+		free(dir->ents[i].name);
+	free(dir->ents);
+	free(dir->path);
+	free(dir);
+}
+
+static void drop_dir(struct dir* dir, bool watch)
+{
+	struct dir** cur = &rindex_state.buckets[dir->hash % 256];
+	while (*cur && *cur != dir)
+		cur = &(*cur)->next;
+	if (*cur)
+		*cur = dir->next;
+
+#ifdef __linux
+	if (watch && -1 != dir->wd)
+		inotify_rm_watch(rindex_state.notify, dir->wd);
+#endif
+
+	rindex_state.n_dirs--;
+	free_dir(dir);
+}
+
+static void drop_all()
+{
+	for (size_t i = 0; i < 256; i++)
+		while (rindex_state.buckets[i])
+			drop_dir(rindex_state.buckets[i], true);
+}
+
+static void drop_wd(int wd, bool watch)
+{
+	for (size_t i = 0; i < 256; i++)
+		for (struct dir* dir = rindex_state.buckets[i]; dir; dir = dir->next)
+			if (dir->wd == wd){
+				drop_dir(dir, watch);
+				return;
+			}
+}
+
+/* anything that happened to a watched directory invalidates its listing, it
+ * is rebuilt on the next lookup */
+static void drain_notify()
+{
+#ifdef __linux
+	if (-1 == rindex_state.notify)
+		return;
+
+	char buf[4096]
+		__attribute__ ((aligned(__alignof__(struct inotify_event))));
+	ssize_t nr;
+
+	while ((nr = read(rindex_state.notify, buf, sizeof(buf))) > 0){
+		for (char* cur = buf; cur < buf + nr;){
+			struct inotify_event* ev = (struct inotify_event*) cur;
+			cur += sizeof(struct inotify_event) + ev->len;
+
+			if (ev->mask & IN_Q_OVERFLOW){
+				drop_all();
+				continue;
+			}
+
+/* the watch is already gone on IGNORED (deleted, unmounted) */
+			drop_wd(ev->wd, !(ev->mask & IN_IGNORED));
+		}
+	}
+#endif
+}
+
+static struct dir* find_dir(const char* path, size_t len, uint64_t hash)
+{
+	for (struct dir* dir = rindex_state.buckets[hash % 256]; dir; dir = dir->next)
+		if (dir->hash == hash &&
+			strncmp(dir->path, path, len) == 0 && dir->path[len] == '\0')
+			return dir;
+	return NULL;
+}
+
+static bool in_root(const char* path, size_t len)
+{
+	return rindex_state.root && len >= rindex_state.root_len &&
+		strncmp(path, rindex_state.root, rindex_state.root_len) == 0 &&
+		(len == rindex_state.root_len || path[rindex_state.root_len] == '/');
+}
+
+static struct dir* list_dir(const char* path, size_t len)
+{
+#ifdef __linux
+	if (rindex_state.n_dirs >= RESINDEX_DIR_LIMIT)
+		return NULL;
+
+	struct dir* dir = malloc(sizeof(struct dir));
+	if (!dir)
+		return NULL;
+
+	*dir = (struct dir){
+		.path = strndup(path, len),
+		.hash = hash_path(path, len),
+		.wd = -1
+	};
+
+/* watch before listing so that nothing can slip in between */
+	if (!dir->path || -1 == (dir->wd = inotify_add_watch(rindex_state.notify, dir->path,
+		IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+		IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR))){
+		free_dir(dir);
+		return NULL;
+	}
+
+	DIR* dh = opendir(dir->path);
+	if (!dh){
+		inotify_rm_watch(rindex_state.notify, dir->wd);
+		free_dir(dir);
+		return NULL;
+	}
+
+	size_t cap = 0;
+	struct dirent* ent;
+	bool ok = true;
+
+	while (ok && (ent = readdir(dh))){
+		if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+			continue;
+
+		uint8_t type = ENT_OTHER;
+		unsigned char d_type = ent->d_type;
+		if (d_type == DT_UNKNOWN){
+			struct stat st;
+			if (0 == fstatat(dirfd(dh), ent->d_name, &st, AT_SYMLINK_NOFOLLOW))
+				d_type = IFTODT(st.st_mode);
+		}
+
+		switch (d_type){
+		case DT_REG: case DT_FIFO: case DT_SOCK: type = ENT_FILE; break;
+		case DT_DIR: type = ENT_DIR; break;
+		case DT_LNK: type = ENT_LINK; break;
+		default: break;
+		}
+
+		if (dir->n_ents == cap){
+			size_t ncap = cap ? cap * 2 : 32;
+			struct entry* ents = realloc(dir->ents, ncap * sizeof(struct entry));
+			if (!ents){
+				ok = false;
+				break;
+			}
+			dir->ents = ents;
+			cap = ncap;
+		}
+
+		if (!(dir->ents[dir->n_ents].name = strdup(ent->d_name))){
+			ok = false;
+			break;
+		}
+		dir->ents[dir->n_ents++].type = type;
+	}
+	closedir(dh);
+
+	if (!ok){
+		inotify_rm_watch(rindex_state.notify, dir->wd);
+		free_dir(dir);
+		return NULL;
+	}
+
+	if (dir->n_ents)
+		qsort(dir->ents, dir->n_ents, sizeof(struct entry), cmp_entry);
+
+	dir->next = rindex_state.buckets[dir->hash % 256];
+	rindex_state.buckets[dir->hash % 256] = dir;
+	rindex_state.n_dirs++;
+
+	return dir;
+#else
+	return NULL;
+#endif
+}
+
+/* resolve the directory part of [path] (up to [len]) to a listing */
+static struct dir* get_dir(const char* path, size_t len)
+{
+	if (rindex_state.disabled || !in_root(path, len))
+		return NULL;
+
+	uint64_t hash = hash_path(path, len);
+	struct dir* dir = find_dir(path, len, hash);
+	return dir ? dir : list_dir(path, len);
+}
+
+/* the index works on plain paths, anything that would need normalisation
+ * goes the slow way */
+static bool split_path(const char* path, size_t* dlen, const char** base)
+{
+	if (!path || path[0] != '/' ||
+		strstr(path, "//") || strstr(path, "/./") || strstr(path, "/../"))
+		return false;
+
+	const char* slash = strrchr(path, '/');
+	if (!slash[1] || slash == path)
+		return false;
+
+	*dlen = slash - path;
+	*base = slash + 1;
+	return true;
+}
+
+int arcan_resindex_lookup(const char* path)
+{
+	size_t dlen;
+	const char* base;
+
+	if (!split_path(path, &dlen, &base))
+		return -1;
+
+	pthread_mutex_lock(&rindex_state.lock);
+	drain_notify();
+
+	int rv = -1;
+	struct dir* dir = get_dir(path, dlen);
+	if (dir){
+		struct entry key = {.name = (char*) base};
+		struct entry* ent = dir->n_ents ? bsearch(&key,
+			dir->ents, dir->n_ents, sizeof(struct entry), cmp_entry) : NULL;
+
+/* devices and the likes are neither file nor directory to find_resource */
+		if (!ent || ent->type == ENT_OTHER)
+			rv = 0;
+		else if (ent->type == ENT_FILE)
+			rv = 1;
+		else if (ent->type == ENT_DIR)
+			rv = 2;
+	}
+
+	pthread_mutex_unlock(&rindex_state.lock);
+	return rv;
+}
+
+ssize_t arcan_resindex_glob(
+	const char* pattern, void (*cb)(char*, void*), void* tag)
+{
+	size_t dlen;
+	const char* base;
+
+/* only wildcards in the last component, the rest has to be a plain path */
+	if (!split_path(pattern, &dlen, &base))
+		return -1;
+
+	const char* wc = strpbrk(pattern, "*?[\\");
+	if (wc && wc < base)
+		return -1;
+
+	pthread_mutex_lock(&rindex_state.lock);
+	drain_notify();
+
+	struct dir* dir = get_dir(pattern, dlen);
+	if (!dir){
+		pthread_mutex_unlock(&rindex_state.lock);
+		return -1;
+	}
+
+/* the callback may well come back into resource lookups, so collect the
+ * matches and release the index first */
+	char** matches = NULL;
+	size_t n = 0;
+
+	for (size_t i = 0; i < dir->n_ents; i++){
+		if (0 != fnmatch(base, dir->ents[i].name, FNM_PERIOD))
+			continue;
+
+		if (!(n % 32)){
+			char** nm = realloc(matches, (n + 32) * sizeof(char*));
+			if (!nm)
+				break;
+			matches = nm;
+		}
+
+		if (!(matches[n] = strdup(dir->ents[i].name)))
+			break;
+		n++;
+	}
+	pthread_mutex_unlock(&rindex_state.lock);
+
+	for (size_t i = 0; i < n; i++){
+		cb(matches[i], tag);
+		free(matches[i]);
+	}
+	free(matches);
+
+	return n;
+}
+
+/* walk breadth first from the root so the directories closest to it get the
+ * watches if the tree is larger than the limits */
+static size_t preload(const char* root)
+{
+	char** queue = malloc(sizeof(char*) * RESINDEX_PRELOAD_DIRS);
+	if (!queue)
+		return 0;
+
+	size_t head = 0, tail = 0, prefetch = 0;
+	queue[tail++] = strdup(root);
+
+	while (head < tail){
+		char* path = queue[head++];
+		if (!path)
+			continue;
+
+		struct dir* dir = get_dir(path, strlen(path));
+		for (size_t i = 0; dir && i < dir->n_ents; i++){
+			struct entry* ent = &dir->ents[i];
+			size_t sz = strlen(path) + strlen(ent->name) + 2;
+
+			if (ent->type == ENT_DIR && tail < RESINDEX_PRELOAD_DIRS){
+				char* sub = malloc(sz);
+				if (sub)
+					snprintf(sub, sz, "%s/%s", path, ent->name);
+				queue[tail++] = sub;
+				continue;
+			}
+
+/* the appl scripts are what the appl will chain-load first, have those in
+ * the page cache by the time system_load asks for them */
+			size_t nlen = strlen(ent->name);
+			if (ent->type != ENT_FILE || prefetch >= RESINDEX_PREFETCH_LIMIT ||
+				nlen < 5 || strcmp(&ent->name[nlen - 4], ".lua") != 0)
+				continue;
+
+			char fpath[sz];
+			snprintf(fpath, sz, "%s/%s", path, ent->name);
+			int fd = open(fpath, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+			if (-1 != fd){
+#ifdef POSIX_FADV_WILLNEED
+				posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+				close(fd);
+				prefetch++;
+			}
+		}
+		free(path);
+	}
+
+	free(queue);
+	return prefetch;
+}
+
+void arcan_resindex_build(const char* root)
+{
+	pthread_mutex_lock(&rindex_state.lock);
+
+#ifdef __linux
+	if (-1 == rindex_state.notify && !rindex_state.disabled){
+		rindex_state.disabled = getenv("ARCAN_RESOURCE_NOINDEX") != NULL;
+		if (!rindex_state.disabled &&
+			-1 == (rindex_state.notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC))){
+			arcan_warning("resource index disabled, inotify: %s\n", strerror(errno));
+			rindex_state.disabled = true;
+		}
+	}
+#else
+	rindex_state.disabled = true;
+#endif
+
+	drain_notify();
+	drop_all();
+	free(rindex_state.root);
+	rindex_state.root = NULL;
+	rindex_state.root_len = 0;
+
+	if (rindex_state.disabled || !root || root[0] != '/'){
+		pthread_mutex_unlock(&rindex_state.lock);
+		return;
+	}
+
+/* the namespace path may come with a trailing separator */
+	rindex_state.root = strdup(root);
+	if (rindex_state.root){
+		rindex_state.root_len = strlen(rindex_state.root);
+		while (rindex_state.root_len > 1 && rindex_state.root[rindex_state.root_len - 1] == '/')
+			rindex_state.root[--rindex_state.root_len] = '\0';
+
+		size_t prefetch = preload(rindex_state.root);
+		arcan_warning("resource index: %zu directories, %zu scripts prefetched\n",
+			rindex_state.n_dirs, prefetch);
+	}
+
+	pthread_mutex_unlock(&rindex_state.lock);
+}
@@ -15,6 +15,128 @@
 #include PLATFORM_HEADER
 #endif
 
+#ifdef ARCAN_SHMIF_FUTEX
+#include <stdatomic.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+/*
+ * Futex- backed replacement for the named semaphores. The handle is still
+ * typed as sem_t* to keep the interop header stable, but really points to
+ * one of these. The words themselves live in the shared page (see doorbell
+ * in arcan_shmif_control.h) and are bound after mapping with arcan_sem_bind,
+ * or in the local 'own' storage for the process- private ones from _init.
+ *
+ * The waiters counter lets post skip the syscall entirely in the common case
+ * where nobody is blocked, which is the main point of the exercise. The wake
+ * is not PRIVATE as the words are shared between processes.
+ */
+struct arcan_sem {
+	_Atomic uint32_t* count;
+	_Atomic uint32_t* waiters;
+	_Atomic uint32_t own[2];
+};
+
+static long futex_op(_Atomic uint32_t* addr, int op, uint32_t val)
+{
+	return syscall(SYS_futex, (uint32_t*) addr, op, val, NULL, NULL, 0);
+}
+
+int arcan_sem_post(sem_handle sem)
+{
+	struct arcan_sem* s = (struct arcan_sem*) sem;
+	if (!s)
+		return -1;
+
+	atomic_fetch_add(s->count, 1);
+	if (atomic_load(s->waiters))
+		futex_op(s->count, FUTEX_WAKE, 1);
+
+	return 0;
+}
+
+int arcan_sem_unlink(sem_handle sem, char* key)
+{
+	return 0;
+}
+
+int arcan_sem_trywait(sem_handle sem)
+{
+	struct arcan_sem* s = (struct arcan_sem*) sem;
+	uint32_t cur = atomic_load(s->count);
+
+	while (cur > 0){
+		if (atomic_compare_exchange_weak(s->count, &cur, cur - 1))
+			return 0;
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
+
+int arcan_sem_wait(sem_handle sem)
+{
+	struct arcan_sem* s = (struct arcan_sem*) sem;
+
+	for(;;){
+		if (0 == arcan_sem_trywait(sem))
+			return 0;
+
+/* the kernel re-checks count == 0 atomically so a post racing between the
+ * trywait and the wait will just make the wait return immediately */
+		atomic_fetch_add(s->waiters, 1);
+		long rv = futex_op(s->count, FUTEX_WAIT, 0);
+		atomic_fetch_sub(s->waiters, 1);
+
+		if (-1 == rv && errno != EAGAIN && errno != EINTR)
+			return -1;
+	}
+}
+
+sem_handle arcan_sem_bind(sem_handle sem, _Atomic uint32_t* words)
+{
+	struct arcan_sem* s = (struct arcan_sem*) sem;
+	if (!s){
+		s = malloc(sizeof(struct arcan_sem));
+		if (!s)
+			return NULL;
+	}
+
+	s->count = &words[0];
+	s->waiters = &words[1];
+	return (sem_handle) s;
+}
+
+int arcan_sem_init(sem_handle* sem, unsigned val)
+{
+	struct arcan_sem* s = (struct arcan_sem*) *sem;
+	if (!s){
+		s = malloc(sizeof(struct arcan_sem));
+		if (!s)
+			return -1;
+		*sem = (sem_handle) s;
+	}
+
+	atomic_store(&s->own[0], val);
+	atomic_store(&s->own[1], 0);
+	arcan_sem_bind(*sem, s->own);
+	return 0;
+}
+
+int arcan_sem_destroy(sem_handle sem)
+{
+	return 0;
+}
+
+int arcan_sem_close(sem_handle sem)
+{
+	free(sem);
+	return 0;
+}
+
+#else
+
 int arcan_sem_post(sem_handle sem)
 {
 	return sem_post(sem);
@@ -47,3 +169,16 @@ int arcan_sem_destroy(sem_handle sem)
 {
 	return sem_destroy(sem);
 }
+
+sem_handle arcan_sem_bind(sem_handle sem, _Atomic uint32_t* words)
+{
+	return sem;
+}
+
+int arcan_sem_close(sem_handle sem)
+{
+	if (!sem)
+		return 0;
+	return sem_close(sem);
+}
+#endif
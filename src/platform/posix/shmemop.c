@@ -18,7 +18,23 @@ size_t arcan_shmif_vbufsz(
 		(rows + 2) * raster_line_sz + raster_hdr_pad;
 	}
 	else
-		return w * h * sizeof(shmif_pixel);
+		return w * h * arcan_shmif_vbpp(meta);
+}
+
+size_t arcan_shmif_vbpp(int meta)
+{
+	if (!(meta & SHMIF_META_HDR))
+		return sizeof(shmif_pixel);
+
+	switch (SHMIF_META_VFMT(meta)){
+	case SHMIF_VFMT_RGBA8:
+	case SHMIF_VFMT_RGB10A2:
+		return sizeof(shmif_pixel);
+	case SHMIF_VFMT_RGBA16F:
+		return 4 * sizeof(uint16_t);
+	default:
+		return 0;
+	}
 }
 
 uintptr_t arcan_shmif_mapav(
@@ -34,6 +34,15 @@ void arcan_mem_tick()
 {
 }
 
+void arcan_mem_frame_reset()
+{
+}
+
+size_t arcan_mem_poolstats(struct arcan_mem_poolstat* dst, size_t lim)
+{
+	return 0;
+}
+
 void arcan_mem_growarr(struct arcan_strarr* res)
 {
 /* _alloc functions lacks a grow at the moment,
@@ -55,9 +64,10 @@ void arcan_mem_freearr(struct arcan_strarr* res)
 		return;
 
 	char** cptr = res->data;
-	while (cptr && *cptr)
+	while (!res->pack && cptr && *cptr)
 		arcan_mem_free(*cptr++);
 
+	arcan_mem_free(res->pack);
 	arcan_mem_free(res->data);
 
 	memset(res, '\0', sizeof(struct arcan_strarr));
@@ -84,11 +84,40 @@ void* platform_video_gfxsym(const char* sym);
 bool platform_video_map_handle(struct agp_vstore*, int64_t inh);
 
 /*
- * take a set of agp_buffer_planes and bind to the specified vstore.
+ * take a set of agp_buffer_planes and bind to the specified vstore. Plane
+ * fences (acquire) remain owned by the caller, the platform should have the
+ * GPU wait for them rather than block.
  */
 bool platform_video_map_buffer(
 	struct agp_vstore*, struct agp_buffer_plane* planes, size_t n);
 
+/*
+ * get a sync_file that signals when the platform no longer reads from the
+ * buffers previously mapped to [vs] through platform_video_map_buffer, except
+ * for the [held] most recent ones (a buffer still scanned out on a plane is
+ * released by the commit after it). Returns -1 if that can't be expressed,
+ * and the consumer has to rely on implicit synchronization.
+ */
+int platform_video_release_fence(struct agp_vstore* vs, size_t* held);
+
+/*
+ * the inverse of map_buffer, describe the contents of the specified vstore as
+ * up to [n] agp_buffer_planes that can be passed to another process. Returns
+ * the number of planes populated, 0 if the store (or platform) can't export.
+ * The caller takes ownership of the plane descriptors.
+ */
+size_t platform_video_export_vstore(
+	struct agp_vstore*, struct agp_buffer_plane* planes, size_t n);
+
+/*
+ * The buffer layouts (format, modifier pairs) that can be put on an overlay
+ * plane as is, for producers that want to allocate buffers that remain
+ * eligible for plane assignment rather than being composed. Populates up to
+ * [n] pairs and returns the number of pairs, 0 if the platform can't tell.
+ */
+size_t platform_video_scanout_formats(
+	uint32_t* formats, uint64_t* modifiers, size_t n);
+
 /*
  * Reset and rebuild the graphics context(s) associated with a specific card
  * (or -1, default for all). If multiple cards are assigned to one cardid, the
@@ -281,6 +310,7 @@ enum blitting_hint {
 	HINT_ROTATE_180 = 64,
 	HINT_CURSOR = 128, /* not permitted for layer == 0 */
 	HINT_DIRECT = 256, /* attempt direct scanout (ignore force_compose setting) */
+	HINT_TEARING = 512, /* present without waiting for vblank, if supported */
 	HINT_ENDM = 156
 };
 
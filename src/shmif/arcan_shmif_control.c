@@ -39,6 +39,7 @@
 
 #ifdef __LINUX
 #include <sys/inotify.h>
+#include <sys/sendfile.h>
 #endif
 
 #ifndef COUNT_OF
@@ -167,11 +168,27 @@ struct shmif_hidden {
 	uint64_t vframe_id;
 	shmif_pixel* vbuf[ARCAN_SHMIF_VBUFC_LIM];
 
+/* acknowledged swapchain model, submission counter and the target time for
+ * the next signal (arcan_shmif_present_at) */
+	uint8_t swap_mode;
+	uint32_t vslot_seq;
+	uint64_t next_pts;
+
+/* individual arcan_shmif_dirty calls for the current frame, disjoint */
+	struct arcan_shmif_region dirty_chain[ARCAN_SHMIF_DIRTY_LIM];
+	size_t dirty_chain_n;
+
 	shmif_trigger_hook audio_hook;
 	void* audio_hook_data;
 	uint8_t abuf_ind, abuf_cnt;
 	shmif_asample* abuf[ARCAN_SHMIF_ABUFC_LIM];
 
+/* when the last signal returned, for the render time in the perf block */
+	uint64_t perf_last;
+
+/* worker for arcan_shmif_signal_async, created on first use */
+	struct shmif_async* async;
+
 	shmif_reset_hook reset_hook;
 	void* reset_hook_tag;
 
@@ -220,12 +237,14 @@ struct shmif_hidden {
  * be unliked on use. For special cases (SHMIF_DONT_UNLINK) this can be deferred
  * and be left to the user. In these scenarios we need to keep the key around. */
 	char* shm_key;
+	bool hugepage;
 
 /* User- provided setup flags and segment types are kept / tracked in order
  * to re-issue events on a hard reset or migration */
 	enum ARCAN_FLAGS flags;
 	int type;
 	enum shmif_ext_meta atype;
+	int atype_req; /* last requested meta, atype is what was acknowledged */
 	uint64_t guid[2];
 
 /* The ingoing and outgoing event queues */
@@ -330,6 +349,35 @@ static bool check_dms(struct arcan_shmif_cont* c)
 	return true;
 }
 
+/* held while the page of a context is unmapped or replaced, so that
+ * arcan_shmif_perf_sample from another thread never reads a stale mapping */
+static pthread_mutex_t page_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t perf_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* counters in the perf block only ever have us as the writer, so relaxed
+ * read-modify-write is enough */
+static void perf_add32(_Atomic uint32_t* dst, uint32_t v)
+{
+	atomic_fetch_add_explicit(dst, v, memory_order_relaxed);
+}
+
+static void perf_hwm(_Atomic uint16_t* dst, size_t used)
+{
+	if (used > atomic_load_explicit(dst, memory_order_relaxed))
+		atomic_store_explicit(dst, used, memory_order_relaxed);
+}
+
+static size_t queue_used(struct arcan_evctx* ctx)
+{
+	return (*ctx->back + ctx->eventbuf_sz - *ctx->front) % ctx->eventbuf_sz;
+}
+
 static void spawn_guardthread(struct arcan_shmif_cont* d)
 {
 	struct shmif_hidden* hgs = d->priv;
@@ -398,6 +446,22 @@ static bool fd_event(struct arcan_shmif_cont* c, struct arcan_event* dst)
 		c->priv->pev.fd = BADFD;
 		return true;
 	}
+/*
+ * release fences are only interesting to the buffer passing in shmifext, keep
+ * the latest one (later ones cover earlier ones) and don't forward
+ */
+	else if (dst->category == EVENT_TARGET && c->privext &&
+		dst->tgt.kind == TARGET_COMMAND_BUFFER_RELEASE){
+		if (c->privext->release_fence != -1)
+			close(c->privext->release_fence);
+
+		c->privext->release_fence = c->priv->pev.fd;
+		c->privext->release_held =
+			dst->tgt.ioevs[1].iv > 0 ? dst->tgt.ioevs[1].iv : 0;
+		c->priv->autoclean = true;
+		c->priv->pev.fd = BADFD;
+		return true;
+	}
 /*
  * otherwise we have a normal pending slot with a descriptor that
  * is inserted into the event, then set as consumed (so next call,
@@ -532,6 +596,90 @@ static inline bool merge_dh(arcan_event* new, arcan_event* old)
 	return true;
 }
 
+static size_t region_area(struct arcan_shmif_region r)
+{
+	return (size_t)(r.x2 - r.x1) * (size_t)(r.y2 - r.y1);
+}
+
+static struct arcan_shmif_region region_union(
+	struct arcan_shmif_region a, struct arcan_shmif_region b)
+{
+	return (struct arcan_shmif_region){
+		.x1 = a.x1 < b.x1 ? a.x1 : b.x1,
+		.y1 = a.y1 < b.y1 ? a.y1 : b.y1,
+		.x2 = a.x2 > b.x2 ? a.x2 : b.x2,
+		.y2 = a.y2 > b.y2 ? a.y2 : b.y2
+	};
+}
+
+/*
+ * Add [r] to the damage chain while keeping the set disjoint: anything that
+ * overlaps (or can be joined without covering more pixels) is absorbed, and
+ * when the chain is full the region that grows the least is merged instead.
+ * The grown region may then overlap others, hence the repeat.
+ */
+static void dirty_chain_add(struct shmif_hidden* P, struct arcan_shmif_region r)
+{
+	for(;;){
+		size_t best = P->dirty_chain_n;
+		size_t best_cost = SIZE_MAX;
+
+		for (size_t i = 0; i < P->dirty_chain_n; i++){
+			struct arcan_shmif_region c = P->dirty_chain[i];
+			struct arcan_shmif_region u = region_union(c, r);
+			size_t cost = region_area(u) - region_area(c) - region_area(r);
+
+			bool overlap = c.x1 < r.x2 && r.x1 < c.x2 && c.y1 < r.y2 && r.y1 < c.y2;
+			if (overlap || region_area(u) <= region_area(c) + region_area(r)){
+				best = i;
+				break;
+			}
+
+			if (P->dirty_chain_n == ARCAN_SHMIF_DIRTY_LIM && cost < best_cost){
+				best = i;
+				best_cost = cost;
+			}
+		}
+
+		if (best == P->dirty_chain_n)
+			break;
+
+		r = region_union(P->dirty_chain[best], r);
+		P->dirty_chain[best] = P->dirty_chain[--P->dirty_chain_n];
+	}
+
+	P->dirty_chain[P->dirty_chain_n++] = r;
+}
+
+/*
+ * Forward the chain to the page if it still describes the dirty region, the
+ * caller might have modified ctx->dirty directly (or auto-dirty replaced it)
+ * and then only the bounding box is valid.
+ */
+static void dirty_chain_commit(struct arcan_shmif_cont* ctx)
+{
+	struct shmif_hidden* P = ctx->priv;
+	size_t n = P->dirty_chain_n;
+	P->dirty_chain_n = 0;
+
+	if (n > 1){
+		struct arcan_shmif_region bb = P->dirty_chain[0];
+		for (size_t i = 1; i < n; i++)
+			bb = region_union(bb, P->dirty_chain[i]);
+
+		if (bb.x1 != ctx->dirty.x1 || bb.x2 != ctx->dirty.x2 ||
+			bb.y1 != ctx->dirty.y1 || bb.y2 != ctx->dirty.y2)
+			n = 0;
+	}
+	else
+		n = 0;
+
+	if (n)
+		memcpy(ctx->addr->dirty_chain,
+			P->dirty_chain, sizeof(struct arcan_shmif_region) * n);
+	atomic_store(&ctx->addr->dirty_chain_n, n);
+}
+
 static bool calc_dirty(
 	struct arcan_shmif_cont* ctx, shmif_pixel* old, shmif_pixel* new)
 {
@@ -588,7 +736,7 @@ static bool scan_stepframe_event(
 {
 	if (old->tgt.ioevs[1].iv != id)
 		return false;
-	uint8_t cur = *c->front;
+	uint16_t cur = *c->front;
 
 /* conservative merge on STEPFRAME so far is results from VBLANK polling only */
 	while (cur != *c->back){
@@ -604,7 +752,7 @@ static bool scan_stepframe_event(
 
 static bool scan_disp_event(struct arcan_evctx* c, struct arcan_event* old)
 {
-	uint8_t cur = *c->front;
+	uint16_t cur = *c->front;
 
 	while (cur != *c->back){
 		struct arcan_event* ev = &c->eventbuf[cur];
@@ -877,6 +1025,7 @@ checkfd:
 /* atomic increment of front -> event enqueued, other option in this sense
  * would be to have a poll that provides the pointer, and a step that unlocks */
 	if (*ctx->front != *ctx->back){
+		perf_hwm(&c->addr->perf.inq_hwm, queue_used(ctx));
 		*dst = ctx->eventbuf[ *ctx->front ];
 
 /*
@@ -1046,6 +1195,17 @@ checkfd:
 			case TARGET_COMMAND_RESTORE:
 			case TARGET_COMMAND_BCHUNK_IN:
 			case TARGET_COMMAND_BCHUNK_OUT:
+			case TARGET_COMMAND_BUFFERSTREAM:
+				debug_print(DETAILED, c,
+					"got descriptor event (%s)", arcan_shmif_eventstr(dst, NULL, 0));
+				priv->pev.gotev = true;
+				priv->pev.ev = *dst;
+				goto checkfd;
+
+/* without a handle it covers memory passed through signal_shm, forward as is */
+			case TARGET_COMMAND_BUFFER_RELEASE:
+				if (dst->tgt.ioevs[0].iv == BADFD)
+					break;
 				debug_print(DETAILED, c,
 					"got descriptor event (%s)", arcan_shmif_eventstr(dst, NULL, 0));
 				priv->pev.gotev = true;
@@ -1077,6 +1237,19 @@ bool arcan_shmif_handle_permitted(struct arcan_shmif_cont* ctx)
 	return (ctx && ctx->privext && ctx->privext->state_fl != STATE_NOACCEL);
 }
 
+int arcan_shmif_release_fence(struct arcan_shmif_cont* ctx, size_t* held)
+{
+	if (!ctx || !ctx->privext || ctx->privext->release_fence == -1)
+		return -1;
+
+	int fd = ctx->privext->release_fence;
+	ctx->privext->release_fence = -1;
+	if (held)
+		*held = ctx->privext->release_held;
+
+	return fd;
+}
+
 static bool is_output_segment(enum ARCAN_SEGID segid)
 {
 	return (segid == SEGID_ENCODER || segid == SEGID_CLIPBOARD_PASTE);
@@ -1142,10 +1315,18 @@ int arcan_shmif_wait_timed(
 		.events = POLLIN | POLLERR | POLLHUP | POLLNVAL
 	};
 
+	uint64_t perf_start = perf_us();
 	int rv = poll(&pfd, 1, timeout);
 	int elapsed = arcan_timemillis() - beg;
 	*time_ms = (elapsed < 0 || elapsed > timeout) ? 0 : timeout - elapsed;
 
+	if (c->addr){
+		atomic_fetch_add_explicit(&c->addr->perf.evwait_us,
+			perf_us() - perf_start, memory_order_relaxed);
+		if (1 != rv)
+			perf_add32(&c->addr->perf.evwaits, 1);
+	}
+
 	if (1 == rv){
 		return arcan_shmif_wait(c, dst);
 	}
@@ -1161,7 +1342,14 @@ int arcan_shmif_wait(struct arcan_shmif_cont* c, struct arcan_event* dst)
 	if (c->priv->valid_initial)
 		drop_initial(c);
 
+	uint64_t perf_start = perf_us();
 	int rv = process_events(c, dst, true, false);
+	if (c->addr){
+		perf_add32(&c->addr->perf.evwaits, 1);
+		atomic_fetch_add_explicit(&c->addr->perf.evwait_us,
+			perf_us() - perf_start, memory_order_relaxed);
+	}
+
 	if (rv > 0 && c->priv->log_event){
 		if (dst->category == EVENT_TARGET &&
 			dst->tgt.kind == TARGET_COMMAND_STEPFRAME && c->priv->log_event < 2)
@@ -1173,25 +1361,14 @@ int arcan_shmif_wait(struct arcan_shmif_cont* c, struct arcan_event* dst)
 	return rv > 0;
 }
 
-static int enqueue_internal(
-	struct arcan_shmif_cont* c, const struct arcan_event* const src, bool try)
+/*
+ * Fill in [pos] of the outgoing queue with [src] and synch any internal state
+ * tracking that the event affects, the caller is responsible for publishing
+ * the new back index.
+ */
+static void enqueue_slot(struct arcan_shmif_cont* c,
+	struct arcan_evctx* ctx, unsigned pos, const struct arcan_event* const src)
 {
-	assert(c);
-	if (!c || !c->addr || !c->priv)
-		return -1;
-
-/* this is dangerous territory: many _enqueue calls are done without checking
- * the return value, so chances are that some event will be dropped. In the
- * crash- recovery case this means that if the migration goes through, we have
- * either an event that might not fit in the current context, or an event that
- * gets lost. Neither is good. The counterargument is that crash recovery is a
- * 'best effort basis' - we're still dealing with an actual crash. */
-	if (!check_dms(c) && !try){
-		fallback_migrate(c, c->priv->alt_conn, true);
-		return 0;
-	}
-
-/* need some extra patching up for log-event to contain the proper values */
 	if (c->priv->log_event){
 		struct arcan_event outev = *src;
 		if (!outev.category){
@@ -1204,34 +1381,17 @@ static int enqueue_internal(
 			(uintptr_t) c, arcan_shmif_eventstr(&outev, NULL, 0));
 	}
 
-	struct arcan_evctx* ctx = &c->priv->outev;
-
-/* paused only set if segment is configured to handle it,
- * and process_events on blocking will block until unpaused */
-	if (c->priv->paused){
-		struct arcan_event ev;
-		process_events(c, &ev, true, true);
-	}
-
-	while ( check_dms(c) &&
-			((*ctx->back + 1) % ctx->eventbuf_sz) == *ctx->front){
-		struct arcan_event outev = *src;
-		debug_print(STATUS, c,
-			"=> %s: outqueue is full, waiting", arcan_shmif_eventstr(&outev, NULL, 0));
-		arcan_sem_wait(ctx->synch.handle);
-	}
-
 	int category = src->category;
-	ctx->eventbuf[*ctx->back] = *src;
+	ctx->eventbuf[pos] = *src;
 	if (!category)
-		ctx->eventbuf[*ctx->back].category = category = EVENT_EXTERNAL;
+		ctx->eventbuf[pos].category = category = EVENT_EXTERNAL;
 
 /* Some events affect internal state tracking, synch those here - not
  * particularly expensive as the frequency and max-rate of events
  * client->server is really low. Tag the event with the last signalled frame
  * for it to act as a clock. */
 	if (category == EVENT_EXTERNAL){
-		ctx->eventbuf[*ctx->back].ext.frame_id = c->priv->vframe_id;
+		ctx->eventbuf[pos].ext.frame_id = c->priv->vframe_id;
 
 		if (src->ext.kind == ARCAN_EVENT(REGISTER)){
 
@@ -1253,28 +1413,164 @@ static int enqueue_internal(
 				c->priv->type = src->ext.registr.kind;
 		}
 	}
+}
 
-	FORCE_SYNCH();
-	*ctx->back = (*ctx->back + 1) % ctx->eventbuf_sz;
+ssize_t arcan_shmif_poll_batch(
+	struct arcan_shmif_cont* c, struct arcan_event* dst, size_t lim)
+{
+	if (!dst)
+		return -1;
+
+	size_t count = 0;
+	while (count < lim){
+		int rv = arcan_shmif_poll(c, &dst[count]);
+		if (rv < 0)
+			return count ? (ssize_t) count : -1;
+		else if (rv == 0)
+			break;
 
-	return 1;
+/* descriptors are only valid until the next poll so stop here */
+		if (arcan_shmif_descrevent(&dst[count++]))
+			break;
+	}
+
+	return count;
+}
+
+/*
+ * [whole] reserves space for all of [n] (or as much as the queue can ever
+ * hold) before copying so that the batch is published in one go rather than
+ * trickled out as the parent drains the queue.
+ */
+static ssize_t enqueue_internal(struct arcan_shmif_cont* c,
+	const struct arcan_event* const src, size_t n, bool try, bool whole)
+{
+	assert(c);
+	if (!c || !c->addr || !c->priv)
+		return -1;
+
+/* this is dangerous territory: many _enqueue calls are done without checking
+ * the return value, so chances are that some event will be dropped. In the
+ * crash- recovery case this means that if the migration goes through, we have
+ * either an event that might not fit in the current context, or an event that
+ * gets lost. Neither is good. The counterargument is that crash recovery is a
+ * 'best effort basis' - we're still dealing with an actual crash. */
+	if (!check_dms(c) && !try){
+		fallback_migrate(c, c->priv->alt_conn, true);
+		return 0;
+	}
+
+	struct arcan_evctx* ctx = &c->priv->outev;
+
+/* paused only set if segment is configured to handle it,
+ * and process_events on blocking will block until unpaused */
+	if (c->priv->paused){
+		struct arcan_event ev;
+		process_events(c, &ev, true, true);
+	}
+
+	size_t count = 0;
+	while (count < n){
+		unsigned back = *ctx->back;
+		size_t used = (back + ctx->eventbuf_sz - *ctx->front) % ctx->eventbuf_sz;
+		size_t need = n - count;
+		need = need > ctx->eventbuf_sz - 1u ? ctx->eventbuf_sz - 1u : need;
+		bool fits = !whole || ctx->eventbuf_sz - 1u - used >= need;
+
+/* fill as much as fits and publish it with a single index update */
+		size_t step = 0;
+		while (fits &&
+			count + step < n && (back + 1) % ctx->eventbuf_sz != *ctx->front){
+			enqueue_slot(c, ctx, back, &src[count + step]);
+			back = (back + 1) % ctx->eventbuf_sz;
+			step++;
+		}
+
+		if (step){
+			FORCE_SYNCH();
+			*ctx->back = back;
+			count += step;
+			perf_hwm(&c->addr->perf.outq_hwm, queue_used(ctx));
+			continue;
+		}
+
+		if (try || !check_dms(c))
+			break;
+
+		perf_add32(&c->addr->perf.outq_full, 1);
+
+		struct arcan_event outev = src[count];
+		debug_print(STATUS, c,
+			"=> %s: outqueue is full, waiting", arcan_shmif_eventstr(&outev, NULL, 0));
+		arcan_sem_wait(ctx->synch.handle);
+	}
+
+	return count;
 }
 
 int arcan_shmif_enqueue(
 	struct arcan_shmif_cont* c, const struct arcan_event* const src)
 {
-	return enqueue_internal(c, src, false);
+	return (int) enqueue_internal(c, src, 1, false, false);
 }
 
 int arcan_shmif_tryenqueue(
 	struct arcan_shmif_cont* c, const arcan_event* const src)
 {
-	return enqueue_internal(c, src, true);
+	return (int) enqueue_internal(c, src, 1, true, false);
+}
+
+ssize_t arcan_shmif_enqueue_batch(struct arcan_shmif_cont* c,
+	const struct arcan_event* const src, size_t n, bool try)
+{
+	if (!src)
+		return -1;
+
+	return enqueue_internal(c, src, n, try, false);
+}
+
+int arcan_shmif_enqueue_v(struct arcan_shmif_cont* c,
+	const struct arcan_event* const src, size_t n)
+{
+	if (!src)
+		return -1;
+
+	return (int) enqueue_internal(c, src, n, false, true);
+}
+
+/*
+ * The last character of the key tells where the page is, 'm' for the shm
+ * namespace or 'f' / 'h' for a memfd that is sent over the socket, with 'h'
+ * asking for the mapping to be advised for hugepages. See findshmkey in
+ * platform/posix/frameserver.c.
+ */
+static char key_kind(const char* key)
+{
+	size_t len = key ? strlen(key) : 0;
+	return len ? key[len - 1] : 'm';
+}
+
+static bool key_memfd(const char* key)
+{
+	char kind = key_kind(key);
+	return kind == 'f' || kind == 'h';
+}
+
+static void advise_page(bool huge, void* addr, size_t sz)
+{
+#ifdef MADV_HUGEPAGE
+	if (huge && addr && MAP_FAILED != addr)
+		madvise(addr, sz, MADV_HUGEPAGE);
+#endif
 }
 
 static void unlink_keyed(const char* key)
 {
-	shm_unlink(key);
+	if (!key_memfd(key))
+		shm_unlink(key);
+#ifdef ARCAN_SHMIF_FUTEX
+	return;
+#endif
 	size_t slen = strlen(key) + 1;
 	char work[slen];
 	snprintf(work, slen, "%s", key);
@@ -1324,13 +1620,49 @@ static bool ensure_stdio()
 	return true;
 }
 
-static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
+/*
+ * With futex synchronization the semaphore words are part of the page, so
+ * this needs to be repeated whenever the page gets (re-)mapped. The handles
+ * themselves stay the same so the guard thread copies remain valid.
+ */
+static void bind_doorbells(struct arcan_shmif_cont* dst)
+{
+	dst->vsem = arcan_sem_bind(dst->vsem, dst->addr->doorbell[0]);
+	dst->asem = arcan_sem_bind(dst->asem, dst->addr->doorbell[1]);
+	dst->esem = arcan_sem_bind(dst->esem, dst->addr->doorbell[2]);
+}
+
+/* event pings (and the key line for spawned clients) can be queued ahead of
+ * it, those are safe to drop here. Blocks like the key read in _connect. */
+static int fetch_page(int sockfd)
+{
+	while (-1 != sockfd){
+		struct pollfd pfd = {.fd = sockfd, .events = POLLIN};
+		int rv = poll(&pfd, 1, -1);
+		if (-1 == rv && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (rv <= 0 || !(pfd.revents & POLLIN))
+			break;
+
+		int fd = arcan_fetchhandle(sockfd, true);
+		if (-1 != fd)
+			return fd;
+
+		if (pfd.revents & (POLLHUP | POLLERR))
+			break;
+	}
+
+	return -1;
+}
+
+static void map_shared(
+	const char* shmkey, int sockfd, struct arcan_shmif_cont* dst)
 {
 	assert(shmkey);
 	assert(strlen(shmkey) > 0);
 
-	int fd = -1;
-	fd = shm_open(shmkey, O_RDWR, 0700);
+	bool memfd = key_memfd(shmkey);
+	int fd = memfd ? fetch_page(sockfd) : shm_open(shmkey, O_RDWR, 0700);
 
 /* This has happened, and while 'technically' legal - it can (and will in most
  * cases) lead to nasty bugs. Since we need to keep the descriptor around in
@@ -1338,7 +1670,12 @@ static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
  * printf to stdout, stderr - potentially causing a write into the shared
  * memory page. The server side will likely detect this due to the validation
  * cookie failing, causing it to terminate the connection. */
-	if (fd <= STDERR_FILENO){
+	if (fd <= STDERR_FILENO && memfd && -1 != fd){
+		int nfd = fcntl(fd, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+		close(fd);
+		fd = nfd;
+	}
+	else if (fd <= STDERR_FILENO){
 		close(fd);
 		if (!ensure_stdio())
 			return;
@@ -1354,8 +1691,13 @@ static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
 	dst->addr = mmap(NULL, ARCAN_SHMPAGE_START_SZ,
 		PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 	dst->shmh = fd;
+	advise_page(key_kind(shmkey) == 'h', dst->addr, ARCAN_SHMPAGE_START_SZ);
 
 /* step 2, semaphore handles */
+#ifdef ARCAN_SHMIF_FUTEX
+	if (MAP_FAILED != dst->addr)
+		bind_doorbells(dst);
+#else
 	size_t slen = strlen(shmkey) + 1;
 	if (slen > 1){
 		char work[slen];
@@ -1368,10 +1710,11 @@ static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
 		work[slen] = 'e';
 		dst->esem = sem_open(work, 0);
 	}
+#endif
 
 	if (dst->asem == 0x0 || dst->esem == 0x0 || dst->vsem == 0x0){
 		debug_print(FATAL, dst, "couldn't map semaphores: %s", shmkey);
-		free(dst->addr);
+		munmap(dst->addr, ARCAN_SHMPAGE_START_SZ);
 		close(fd);
 		dst->addr = NULL;
 		return;
@@ -1385,6 +1728,7 @@ static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
 		dst->addr = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 		if (MAP_FAILED == dst->addr)
 			goto map_fail;
+		advise_page(key_kind(shmkey) == 'h', dst->addr, sz);
 	}
 
 	debug_print(STATUS, dst, "segment mapped to %" PRIxPTR, (uintptr_t) dst->addr);
@@ -1396,6 +1740,23 @@ map_fail:
 		dst->addr = NULL;
 		return;
 	}
+
+/* both ends need to agree on the synchronization primitive, the version
+ * check comes later but would fail on something more confusing */
+#ifdef ARCAN_SHMIF_FUTEX
+	bool futex = true;
+#else
+	bool futex = false;
+#endif
+	if (!!dst->addr->futex != futex){
+		debug_print(FATAL, dst, "synchronization mismatch (futex:%d, server:%d)",
+			(int) futex, (int) dst->addr->futex);
+		munmap(dst->addr, dst->addr->segment_size);
+		close(fd);
+		dst->addr = NULL;
+		return;
+	}
+	bind_doorbells(dst);
 }
 
 static int try_connpath(const char* key, char* dbuf, size_t dbuf_sz, int attempt)
@@ -1503,16 +1864,32 @@ retry:
 		}
 	}
 
-/* 3. wait for key response (or broken socket) */
+/* 3. wait for key response (or broken socket), peek so that it can be taken
+ * in one read without reaching into the page descriptor that follows */
 	size_t ofs = 0;
-	do {
-		if (-1 == read(sock, wbuf + ofs, 1)){
+	while (ofs < PP_SHMPAGE_SHMKEYLIM){
+		ssize_t nr = recv(sock, wbuf + ofs, PP_SHMPAGE_SHMKEYLIM - ofs, MSG_PEEK);
+		if (-1 == nr && errno == EINTR)
+			continue;
+
+		if (nr <= 0){
+			debug_print(FATAL, NULL, "invalid response on negotiation: %s",
+				nr == 0 ? "closed" : strerror(errno));
+			close(sock);
+			goto end;
+		}
+
+		char* lf = memchr(wbuf + ofs, '\n', nr);
+		size_t step = lf ? (size_t)(lf - (wbuf + ofs)) + 1 : (size_t) nr;
+		if (-1 == read(sock, wbuf + ofs, step)){
 			debug_print(FATAL, NULL, "invalid response on negotiation: %s", strerror(errno));
 			close(sock);
 			goto end;
 		}
+		ofs += step;
+		if (lf)
+			break;
 	}
-	while(wbuf[ofs++] != '\n' && ofs < PP_SHMPAGE_SHMKEYLIM);
 	wbuf[ofs-1] = '\0';
 
 /* 4. omitted, just return a copy of the key and let someone else perform the
@@ -1533,9 +1910,9 @@ static void setup_avbuf(struct arcan_shmif_cont* res)
 
 	res->w = atomic_load(&res->addr->w);
 	res->h = atomic_load(&res->addr->h);
-	res->stride = res->w * ARCAN_SHMPAGE_VCHANNELS;
-	res->pitch = res->w;
 	res->priv->atype = atomic_load(&res->addr->apad_type);
+	res->stride = res->w * arcan_shmif_vbpp(res->priv->atype);
+	res->pitch = res->stride / sizeof(shmif_pixel);
 
 	res->priv->vbuf_cnt = atomic_load(&res->addr->vpending);
 	res->priv->abuf_cnt = atomic_load(&res->addr->apending);
@@ -1544,6 +1921,9 @@ static void setup_avbuf(struct arcan_shmif_cont* res)
 	res->priv->abuf_ind = 0;
 	res->priv->vbuf_ind = 0;
 	res->priv->vbuf_nbuf_active = false;
+	res->priv->swap_mode = atomic_load(&res->addr->swap_mode);
+	if (res->priv->swap_mode > SHMIF_SWAP_IMMEDIATE)
+		res->priv->swap_mode = SHMIF_SWAP_DEFAULT;
 	atomic_store(&res->addr->vpending, 0);
 	atomic_store(&res->addr->apending, 0);
 	res->abufused = res->abufpos = 0;
@@ -1585,6 +1965,7 @@ static void setup_avbuf(struct arcan_shmif_cont* res)
  * and return the total size */
 static struct arcan_shmif_cont shmif_acquire_int(
 	struct arcan_shmif_cont* parent,
+	int sockfd,
 	const char* shmkey,
 	int type,
 	int flags, va_list vargs)
@@ -1604,7 +1985,7 @@ static struct arcan_shmif_cont shmif_acquire_int(
 
 	if (!shmkey){
 		struct shmif_hidden* gs = parent->priv;
-		map_shared(gs->pseg.key, &res);
+		map_shared(gs->pseg.key, gs->pseg.epipe, &res);
 		key_used = gs->pseg.key;
 		debug_print(STATUS, parent, "newsegment_shm_key:%s", key_used);
 
@@ -1620,7 +2001,7 @@ static struct arcan_shmif_cont shmif_acquire_int(
 	else{
 		debug_print(STATUS, parent, "acquire_shm_key:%s", shmkey);
 		key_used = shmkey;
-		map_shared(shmkey, &res);
+		map_shared(shmkey, sockfd, &res);
 		if (!(flags & SHMIF_DONT_UNLINK))
 			unlink_keyed(shmkey);
 	}
@@ -1663,10 +2044,12 @@ static struct arcan_shmif_cont shmif_acquire_int(
 		.cleanup = NULL,
 		.active_fd = -1,
 		.pending_fd = -1,
+		.release_fence = -1,
 	};
 
 	*res.priv = gs;
 	res.priv->alive = true;
+	res.priv->hugepage = key_kind(key_used) == 'h';
 	char* dbgenv = getenv("ARCAN_SHMIF_DEBUG");
 	if (dbgenv)
 		res.priv->log_event = strtoul(dbgenv, NULL, 10);
@@ -1729,7 +2112,19 @@ struct arcan_shmif_cont arcan_shmif_acquire(struct arcan_shmif_cont* parent,
 	va_list argp;
 	va_start(argp, flags);
 	struct arcan_shmif_cont res =
-		shmif_acquire_int(parent, shmkey, type, flags, argp);
+		shmif_acquire_int(parent, -1, shmkey, type, flags, argp);
+	va_end(argp);
+	return res;
+}
+
+/* for the connection paths where the page might follow on [sockfd] */
+static struct arcan_shmif_cont acquire_sock(
+	int sockfd, const char* shmkey, int type, int flags, ...)
+{
+	va_list argp;
+	va_start(argp, flags);
+	struct arcan_shmif_cont res =
+		shmif_acquire_int(NULL, sockfd, shmkey, type, flags, argp);
 	va_end(argp);
 	return res;
 }
@@ -1807,6 +2202,16 @@ bool arcan_shmif_integrity_check(struct arcan_shmif_cont* cont)
 	return true;
 }
 
+/* the size is read from the shared page so clamp to what is reserved there,
+ * both sides then only ever work with their local copy */
+static uint16_t queue_size(uint16_t size)
+{
+	if (!size)
+		return PP_QUEUE_SZ;
+
+	return size > PP_QUEUE_MAX ? PP_QUEUE_MAX : size;
+}
+
 void arcan_shmif_setevqs(struct arcan_shmif_page* dst,
 	sem_handle esem, arcan_evctx* inq, arcan_evctx* outq, bool parent)
 {
@@ -1843,13 +2248,13 @@ void arcan_shmif_setevqs(struct arcan_shmif_page* dst,
 	inq->eventbuf = dst->childevq.evqueue;
 	inq->front = &dst->childevq.front;
 	inq->back  = &dst->childevq.back;
-	inq->eventbuf_sz = PP_QUEUE_SZ;
+	inq->eventbuf_sz = queue_size(dst->childevq.size);
 
 	outq->local =false;
 	outq->eventbuf = dst->parentevq.evqueue;
 	outq->front = &dst->parentevq.front;
 	outq->back  = &dst->parentevq.back;
-	outq->eventbuf_sz = PP_QUEUE_SZ;
+	outq->eventbuf_sz = queue_size(dst->parentevq.size);
 }
 
 unsigned arcan_shmif_signalhandle(struct arcan_shmif_cont* ctx,
@@ -1870,6 +2275,111 @@ unsigned arcan_shmif_signalhandle(struct arcan_shmif_cont* ctx,
 	return arcan_shmif_signal(ctx, mask);
 }
 
+bool arcan_shmif_signal_shm(struct arcan_shmif_cont* ctx, int mask,
+	int handle, size_t offset, size_t stride, uint32_t format)
+{
+	if (!ctx || !ctx->addr || !arcan_shmif_handle_permitted(ctx) ||
+		offset > UINT32_MAX || stride > UINT32_MAX || stride < ctx->w * 4)
+		return false;
+
+	if (!arcan_pushhandle(handle, ctx->epipe))
+		return false;
+
+	struct arcan_event ev = {
+		.category = EVENT_EXTERNAL,
+		.ext.kind = EVENT_EXTERNAL_BUFFERSTREAM,
+		.ext.bstream.width = ctx->w,
+		.ext.bstream.height = ctx->h,
+		.ext.bstream.stride = stride,
+		.ext.bstream.offset = offset,
+		.ext.bstream.format = format,
+		.ext.bstream.shm = 1
+	};
+	arcan_shmif_enqueue(ctx, &ev);
+	arcan_shmif_signal(ctx, mask);
+	return true;
+}
+
+static bool swap_slots(struct shmif_hidden* priv)
+{
+	return priv->swap_mode > SHMIF_SWAP_DEFAULT;
+}
+
+/*
+ * Find a slot other than the current that the client can render into. FREE
+ * slots are ours already, in MAILBOX/IMMEDIATE the oldest QUEUED one can be
+ * taken back as long as the parent hasn't acquired it first.
+ */
+static bool swap_acquire(struct arcan_shmif_cont* ctx)
+{
+	struct shmif_hidden* priv = ctx->priv;
+	int oldest = -1;
+	uint32_t oldest_seq = 0;
+
+	for (size_t i = 0; i < priv->vbuf_cnt; i++){
+		if (i == priv->vbuf_ind && priv->vbuf_cnt > 1)
+			continue;
+
+		uint8_t state = atomic_load_explicit(
+			&ctx->addr->vslot[i], memory_order_acquire);
+
+		if (state == SHMIF_VSLOT_FREE){
+			priv->vbuf_ind = i;
+			ctx->vidp = priv->vbuf[i];
+			return true;
+		}
+
+		uint32_t seq = atomic_load(&ctx->addr->vslot_seq[i]);
+		if (state == SHMIF_VSLOT_QUEUED &&
+			(oldest == -1 || (int32_t)(seq - oldest_seq) < 0)){
+			oldest = i;
+			oldest_seq = seq;
+		}
+	}
+
+	if (priv->swap_mode == SHMIF_SWAP_FIFO ||
+		oldest == -1 || oldest == priv->vbuf_ind)
+		return false;
+
+	uint8_t expect = SHMIF_VSLOT_QUEUED;
+	if (!atomic_compare_exchange_strong(
+		&ctx->addr->vslot[oldest], &expect, SHMIF_VSLOT_FREE))
+		return false;
+
+	priv->vbuf_ind = oldest;
+	ctx->vidp = priv->vbuf[oldest];
+	return true;
+}
+
+void arcan_shmif_present_at(struct arcan_shmif_cont* ctx, uint64_t pts)
+{
+	if (!ctx || !ctx->priv)
+		return;
+
+	ctx->priv->next_pts = pts;
+}
+
+size_t arcan_shmif_vslots_free(struct arcan_shmif_cont* ctx)
+{
+	if (!ctx || !ctx->addr || !ctx->priv || !swap_slots(ctx->priv))
+		return 0;
+
+	struct shmif_hidden* priv = ctx->priv;
+	size_t count = 0;
+
+	for (size_t i = 0; i < priv->vbuf_cnt; i++){
+		if (i == priv->vbuf_ind)
+			continue;
+
+		uint8_t state = atomic_load(&ctx->addr->vslot[i]);
+		if (state == SHMIF_VSLOT_FREE ||
+			(state == SHMIF_VSLOT_QUEUED && priv->swap_mode != SHMIF_SWAP_FIFO))
+			count++;
+	}
+
+	return count;
+}
+
 static bool step_v(struct arcan_shmif_cont* ctx, int sigv)
 {
 	struct shmif_hidden* priv = ctx->priv;
@@ -1887,7 +2397,7 @@ static bool step_v(struct arcan_shmif_cont* ctx, int sigv)
 
 /* set if we should trim the dirty region based on current ^ last buffer,
  * but it only works if we are >= double buffered and buffers are populated */
-		if ((sigv & SHMIF_SIGVID_AUTO_DIRTY) &&
+		if ((sigv & SHMIF_SIGVID_AUTO_DIRTY) && !swap_slots(priv) &&
 			priv->vbuf_nbuf_active && priv->vbuf_cnt > 1){
 			shmif_pixel* old;
 			if (priv->vbuf_ind == 0)
@@ -1923,6 +2433,7 @@ static bool step_v(struct arcan_shmif_cont* ctx, int sigv)
 		}
 
 		atomic_store(&ctx->addr->dirty, ctx->dirty);
+		dirty_chain_commit(ctx);
 
 /* set an invalid dirty region so any subsequent signals would be ignored until
  * they are updated (i.e. something has changed) */
@@ -1940,6 +2451,20 @@ static bool step_v(struct arcan_shmif_cont* ctx, int sigv)
 		}
 	}
 
+/* with explicit slots, queue the current one and then try to find the next,
+ * vready is set after the slot state so the parent always sees the slot */
+	if (swap_slots(priv)){
+		unsigned ind = priv->vbuf_ind;
+		atomic_store(&ctx->addr->vslot_pts[ind], priv->next_pts);
+		atomic_store(&ctx->addr->vslot_seq[ind], ++priv->vslot_seq);
+		atomic_store_explicit(&ctx->addr->vslot[ind],
+			SHMIF_VSLOT_QUEUED, memory_order_release);
+		atomic_store_explicit(&ctx->addr->vready, ind+1, memory_order_release);
+		priv->next_pts = 0;
+		priv->vbuf_nbuf_active = true;
+		return !swap_acquire(ctx);
+	}
+
 /* mark the current buffer as pending, this is used when we have
  * non-subregion + (double, triple, quadruple buffer) rendering */
 	int pending = atomic_fetch_or_explicit(
@@ -2036,6 +2561,7 @@ unsigned arcan_shmif_signal(
 	}
 
 	unsigned startt = arcan_timemillis();
+	uint64_t perf_start = perf_us();
 	if ( (mask & SHMIF_SIGVID) && priv->video_hook)
 		mask = priv->video_hook(ctx);
 
@@ -2044,6 +2570,7 @@ unsigned arcan_shmif_signal(
 
 	if ( mask & SHMIF_SIGAUD ){
 		bool lock = step_a(ctx);
+		perf_add32(&ctx->addr->perf.audio, 1);
 
 /* guard-thread will pull the sems for us on dms */
 		if (lock && !(mask & SHMIF_SIGBLK_NONE))
@@ -2058,9 +2585,23 @@ unsigned arcan_shmif_signal(
 			&& ctx->addr->vready && check_dms(ctx))
 			arcan_sem_wait(ctx->vsem);
 
+/* the server hasn't picked up the last frame and this one will replace it */
+		if (!swap_slots(priv) && atomic_load(&ctx->addr->vready))
+			perf_add32(&ctx->addr->perf.dropped, 1);
+
+		perf_add32(&ctx->addr->perf.frames, 1);
 		bool lock = step_v(ctx, mask);
 
-		if (lock && !(mask & SHMIF_SIGBLK_NONE)){
+/* without a slot to move to there is nothing to draw into, so this has to
+ * block even with SIGBLK_NONE, the parent posts whenever it frees one */
+		if (swap_slots(priv)){
+			while (lock && check_dms(ctx)){
+				arcan_sem_wait(ctx->vsem);
+				lock = !swap_acquire(ctx);
+			}
+			arcan_sem_trywait(ctx->vsem);
+		}
+		else if (lock && !(mask & SHMIF_SIGBLK_NONE)){
 			while (ctx->addr->vready && check_dms(ctx))
 				arcan_sem_wait(ctx->vsem);
 		}
@@ -2068,10 +2609,211 @@ unsigned arcan_shmif_signal(
 			arcan_sem_trywait(ctx->vsem);
 	}
 
+	uint64_t perf_end = perf_us();
+	struct arcan_shmif_perf* perf = &ctx->addr->perf;
+	if (priv->perf_last && perf_start > priv->perf_last){
+		uint64_t render = perf_start - priv->perf_last;
+		atomic_fetch_add_explicit(&perf->render_us, render, memory_order_relaxed);
+		atomic_store_explicit(&perf->last_render_us, render, memory_order_relaxed);
+	}
+	atomic_fetch_add_explicit(&perf->wait_us,
+		perf_end - perf_start, memory_order_relaxed);
+	atomic_store_explicit(&perf->last_wait_us,
+		perf_end - perf_start, memory_order_relaxed);
+	priv->perf_last = perf_end;
+
 	priv->in_signal = false;
 	return arcan_timemillis() - startt;
 }
 
+/*
+ * Worker for arcan_shmif_signal_async, one per segment and created on first
+ * use. The completion is reported through the callback and by making the
+ * read end of [pipe] readable until collected in _async_wait.
+ */
+struct shmif_async {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int pipe[2];
+
+	bool quit, pending, collect;
+	int mask;
+	unsigned last;
+
+	void (*done)(struct arcan_shmif_cont*, unsigned ms, void* tag);
+	void* tag;
+};
+
+static void* async_worker(void* arg)
+{
+	struct arcan_shmif_cont* C = arg;
+	struct shmif_async* A = C->priv->async;
+
+	pthread_mutex_lock(&A->lock);
+	while (!A->quit){
+		if (!A->pending){
+			pthread_cond_wait(&A->cond, &A->lock);
+			continue;
+		}
+
+		int mask = A->mask;
+		pthread_mutex_unlock(&A->lock);
+			unsigned ms = arcan_shmif_signal(C, mask);
+		pthread_mutex_lock(&A->lock);
+
+		void (*done)(struct arcan_shmif_cont*, unsigned, void*) = A->done;
+		void* tag = A->tag;
+
+		A->last = ms;
+		A->pending = false;
+		if (!A->collect){
+			A->collect = true;
+			while (-1 == write(A->pipe[1], "", 1) && errno == EINTR){}
+		}
+		pthread_cond_broadcast(&A->cond);
+
+		if (done){
+			pthread_mutex_unlock(&A->lock);
+				done(C, ms, tag);
+			pthread_mutex_lock(&A->lock);
+		}
+	}
+	pthread_mutex_unlock(&A->lock);
+
+	return NULL;
+}
+
+static struct shmif_async* async_setup(struct arcan_shmif_cont* C)
+{
+	struct shmif_async* A = malloc(sizeof(struct shmif_async));
+	if (!A)
+		return NULL;
+
+	*A = (struct shmif_async){.pipe = {-1, -1}};
+	if (-1 == pipe(A->pipe)){
+		free(A);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < 2; i++){
+		fcntl(A->pipe[i], F_SETFD, FD_CLOEXEC);
+		fcntl(A->pipe[i], F_SETFL, O_NONBLOCK);
+	}
+
+	pthread_mutex_init(&A->lock, NULL);
+	pthread_cond_init(&A->cond, NULL);
+	C->priv->async = A;
+
+	if (0 != pthread_create(&A->thread, NULL, async_worker, C)){
+		C->priv->async = NULL;
+		close(A->pipe[0]);
+		close(A->pipe[1]);
+		pthread_mutex_destroy(&A->lock);
+		pthread_cond_destroy(&A->cond);
+		free(A);
+		return NULL;
+	}
+
+	return A;
+}
+
+/* wait for an in-flight signal without collecting the completion */
+static void async_sync(struct arcan_shmif_cont* C)
+{
+	struct shmif_async* A = C->priv->async;
+	if (!A || pthread_equal(pthread_self(), A->thread))
+		return;
+
+	pthread_mutex_lock(&A->lock);
+	while (A->pending)
+		pthread_cond_wait(&A->cond, &A->lock);
+	pthread_mutex_unlock(&A->lock);
+}
+
+/* let an in-flight signal finish and stop the worker */
+static void async_drop(struct arcan_shmif_cont* C)
+{
+	struct shmif_async* A = C->priv->async;
+	if (!A)
+		return;
+
+	async_sync(C);
+	pthread_mutex_lock(&A->lock);
+	A->quit = true;
+	pthread_cond_broadcast(&A->cond);
+	pthread_mutex_unlock(&A->lock);
+
+	pthread_join(A->thread, NULL);
+	close(A->pipe[0]);
+	close(A->pipe[1]);
+	pthread_mutex_destroy(&A->lock);
+	pthread_cond_destroy(&A->cond);
+	free(A);
+	C->priv->async = NULL;
+}
+
+bool arcan_shmif_signal_async(
+	struct arcan_shmif_cont* C, enum arcan_shmif_sigmask mask,
+	void (*done)(struct arcan_shmif_cont*, unsigned ms, void* tag), void* tag)
+{
+	if (!C || !C->addr || !C->priv || !check_dms(C))
+		return false;
+
+	struct shmif_async* A = C->priv->async;
+	if (!A && !(A = async_setup(C)))
+		return false;
+
+	pthread_mutex_lock(&A->lock);
+	if (A->pending){
+		pthread_mutex_unlock(&A->lock);
+		return false;
+	}
+
+	A->mask = mask;
+	A->done = done;
+	A->tag = tag;
+	A->pending = true;
+	pthread_cond_broadcast(&A->cond);
+	pthread_mutex_unlock(&A->lock);
+
+	return true;
+}
+
+int arcan_shmif_signal_async_handle(struct arcan_shmif_cont* C)
+{
+	if (!C || !C->priv || !C->priv->async)
+		return -1;
+
+	return C->priv->async->pipe[0];
+}
+
+int arcan_shmif_signal_async_wait(struct arcan_shmif_cont* C, bool block)
+{
+	if (!C || !C->priv || !C->priv->async)
+		return 0;
+
+	struct shmif_async* A = C->priv->async;
+	pthread_mutex_lock(&A->lock);
+	while (block && A->pending)
+		pthread_cond_wait(&A->cond, &A->lock);
+
+	if (A->pending){
+		pthread_mutex_unlock(&A->lock);
+		return -1;
+	}
+
+	if (A->collect){
+		char buf;
+		while (-1 == read(A->pipe[0], &buf, 1) && errno == EINTR){}
+		A->collect = false;
+	}
+
+	int rv = A->last;
+	pthread_mutex_unlock(&A->lock);
+	return rv;
+}
+
 struct arg_arr* arcan_shmif_args( struct arcan_shmif_cont* inctx)
 {
 	if (!inctx || !inctx->priv)
@@ -2084,6 +2826,9 @@ void arcan_shmif_drop(struct arcan_shmif_cont* inctx)
 	if (!inctx || !inctx->priv)
 		return;
 
+/* the worker runs signal on the context, it has to be out of there first */
+	async_drop(inctx);
+
 	pthread_mutex_lock(&inctx->priv->lock);
 
 	if (inctx->priv->valid_initial)
@@ -2110,9 +2855,9 @@ void arcan_shmif_drop(struct arcan_shmif_cont* inctx)
 	close(inctx->epipe);
 	close(inctx->shmh);
 
-	sem_close(inctx->asem);
-	sem_close(inctx->esem);
-	sem_close(inctx->vsem);
+	arcan_sem_close(inctx->asem);
+	arcan_sem_close(inctx->esem);
+	arcan_sem_close(inctx->vsem);
 
 	if (gstr->args){
 		arg_cleanup(gstr->args);
@@ -2127,6 +2872,8 @@ void arcan_shmif_drop(struct arcan_shmif_cont* inctx)
 		close(inctx->privext->active_fd);
 	if (inctx->privext->pending_fd != -1)
 		close(inctx->privext->pending_fd);
+	if (inctx->privext->release_fence != -1)
+		close(inctx->privext->release_fence);
 
 	pthread_mutex_unlock(&inctx->priv->lock);
 	pthread_mutex_destroy(&inctx->priv->lock);
@@ -2139,8 +2886,10 @@ void arcan_shmif_drop(struct arcan_shmif_cont* inctx)
 	else
 		free(inctx->priv);
 	free(inctx->privext);
+	pthread_mutex_lock(&page_lock);
 	munmap(inctx->addr, inctx->shmsize);
 	memset(inctx, '\0', sizeof(struct arcan_shmif_cont));
+	pthread_mutex_unlock(&page_lock);
 }
 
 static bool shmif_resize(struct arcan_shmif_cont* arg,
@@ -2152,6 +2901,9 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 
 	struct shmif_hidden* priv = arg->priv;
 
+/* an async signal still in flight owns the buffers */
+	async_sync(arg);
+
 /* quick rename / unpack as old prototype of this didn't carry ext struct */
 	size_t abufsz = ext.abuf_sz;
 	int vidc = ext.vbuf_cnt;
@@ -2202,13 +2954,37 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 	bool bufcnt_changed = vidc != priv->vbuf_cnt || audc != priv->abuf_cnt;
 	bool hints_changed = arg->addr->hints != arg->hints;
 	bool bufsz_changed = abufsz && arg->addr->abufsize != abufsz;
+	size_t evqsz = ext.evqueue_sz > PP_QUEUE_MAX ? PP_QUEUE_MAX : ext.evqueue_sz;
+	evqsz = evqsz && evqsz < PP_QUEUE_SZ ? PP_QUEUE_SZ : evqsz;
+	bool evqsz_changed = evqsz && (
+		evqsz != priv->inev.eventbuf_sz || evqsz != priv->outev.eventbuf_sz);
+
+/* the reservation sticks around on the page until explicitly changed */
+	size_t rsv_w = atomic_load(&arg->addr->reserve_w);
+	size_t rsv_h = atomic_load(&arg->addr->reserve_h);
+	if (ext.reserve_w < 0 || ext.reserve_h < 0)
+		rsv_w = rsv_h = 0;
+	else if (ext.reserve_w > 0 && ext.reserve_h > 0){
+		rsv_w = ext.reserve_w > PP_SHMPAGE_MAXW ? PP_SHMPAGE_MAXW : ext.reserve_w;
+		rsv_h = ext.reserve_h > PP_SHMPAGE_MAXH ? PP_SHMPAGE_MAXH : ext.reserve_h;
+	}
+	bool reserve_changed = rsv_w != atomic_load(&arg->addr->reserve_w) ||
+		rsv_h != atomic_load(&arg->addr->reserve_h);
+	int swap_mode = ext.swap_mode > 0 &&
+		ext.swap_mode <= SHMIF_SWAP_IMMEDIATE ? ext.swap_mode : priv->swap_mode;
+	bool swap_changed = swap_mode != priv->swap_mode;
+	bool meta_changed = adata != priv->atype_req;
 
 /* don't negotiate unless the goals have changed */
 	if (arg->vidp &&
 		!dimensions_changed &&
 		!bufcnt_changed &&
 		!hints_changed &&
-		!bufsz_changed){
+		!bufsz_changed &&
+		!evqsz_changed &&
+		!reserve_changed &&
+		!swap_changed &&
+		!meta_changed){
 		if (priv->reset_hook)
 			priv->reset_hook(SHMIF_RESET_NOCHG, priv->reset_hook_tag);
 
@@ -2218,6 +2994,7 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 /* synchronize hints as _ORIGO_LL and similar changes only synch on resize */
 	atomic_store(&arg->addr->hints, arg->hints);
 	atomic_store(&arg->addr->apad_type, adata);
+	priv->atype_req = adata;
 
 	if (samplerate < 0)
 		atomic_store(&arg->addr->audiorate, arg->samplerate);
@@ -2233,6 +3010,10 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 	atomic_store(&arg->addr->rows, ext.rows);
 	atomic_store(&arg->addr->cols, ext.cols);
 	atomic_store(&arg->addr->abufsize, abufsz);
+	arg->addr->evqueue_req = evqsz;
+	atomic_store(&arg->addr->reserve_w, rsv_w);
+	atomic_store(&arg->addr->reserve_h, rsv_h);
+	atomic_store(&arg->addr->swap_mode, swap_mode);
 	atomic_store_explicit(&arg->addr->apending, audc, memory_order_release);
 	atomic_store_explicit(&arg->addr->vpending, vidc, memory_order_release);
 	if (priv->log_event){
@@ -2246,12 +3027,14 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 /* all force synch- calls should be removed when atomicity and reordering
  * behavior have been verified properly */
 	FORCE_SYNCH();
+	uint64_t perf_start = perf_us();
 	arg->addr->resized = 1;
 	do{
 		if (0 == arcan_sem_trywait(arg->vsem))
 			arcan_timesleep(16);
 	}
 	while (arg->addr->resized > 0 && check_dms(arg));
+	uint64_t perf_wait = perf_us() - perf_start;
 
 /* post-size data commit is the last fragile moment server-side */
 	if (!check_dms(arg)){
@@ -2286,16 +3069,20 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 		if (gs->guard.active)
 			pthread_mutex_lock(&gs->guard.synch);
 
+		pthread_mutex_lock(&page_lock);
 		munmap(arg->addr, arg->shmsize);
 		arg->shmsize = new_sz;
 		arg->addr = mmap(NULL, arg->shmsize,
 			PROT_READ | PROT_WRITE, MAP_SHARED, arg->shmh, 0);
+		advise_page(priv->hugepage, arg->addr, arg->shmsize);
+		pthread_mutex_unlock(&page_lock);
 		if (!arg->addr){
 			debug_print(FATAL, arg, "segment couldn't be remapped");
 			return false;
 		}
 
 		atomic_store(&gs->guard.dms, (uint8_t*) &arg->addr->dms);
+		bind_doorbells(arg);
 		if (gs->guard.active)
 			pthread_mutex_unlock(&gs->guard.synch);
 	}
@@ -2307,6 +3094,10 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 		arg->esem, &priv->inev, &priv->outev, false);
 	setup_avbuf(arg);
 
+	perf_add32(&arg->addr->perf.resizes, 1);
+	atomic_fetch_add_explicit(
+		&arg->addr->perf.resize_us, perf_wait, memory_order_relaxed);
+
 	if (priv->reset_hook){
 			priv->reset_hook(old_addr != (uintptr_t)arg->addr ?
 				SHMIF_RESET_REMAP : SHMIF_RESET_NOCHG, priv->reset_hook_tag);
@@ -2606,6 +3397,56 @@ bool arcan_shmif_unlock(struct arcan_shmif_cont* C)
 	return true;
 }
 
+bool arcan_shmif_perf_sample(struct arcan_shmif_cont* C,
+	struct arcan_shmif_perf* out, size_t* inq, size_t* outq)
+{
+	if (!C || !out)
+		return false;
+
+	pthread_mutex_lock(&page_lock);
+	struct arcan_shmif_page* page = C->addr;
+	if (!page || !page->dms){
+		pthread_mutex_unlock(&page_lock);
+		return false;
+	}
+
+	struct arcan_shmif_perf* perf = &page->perf;
+	*out = (struct arcan_shmif_perf){};
+#define PERF(X) atomic_store_explicit(&out->X, \
+	atomic_load_explicit(&perf->X, memory_order_relaxed), memory_order_relaxed)
+	PERF(frames);
+	PERF(dropped);
+	PERF(audio);
+	PERF(render_us);
+	PERF(wait_us);
+	PERF(last_render_us);
+	PERF(last_wait_us);
+	PERF(outq_hwm);
+	PERF(inq_hwm);
+	PERF(outq_full);
+	PERF(resizes);
+	PERF(resize_us);
+	PERF(evwaits);
+	PERF(evwait_us);
+#undef PERF
+
+/* the queue indices are written by both sides, so only trust them if they
+ * are in range for the current size */
+	size_t sz = page->childevq.size;
+	size_t front = page->childevq.front, back = page->childevq.back;
+	if (inq)
+		*inq = sz && front < sz && back < sz ? (back + sz - front) % sz : 0;
+
+	sz = page->parentevq.size;
+	front = page->parentevq.front;
+	back = page->parentevq.back;
+	if (outq)
+		*outq = sz && front < sz && back < sz ? (back + sz - front) % sz : 0;
+
+	pthread_mutex_unlock(&page_lock);
+	return true;
+}
+
 bool arcan_shmif_descrevent(struct arcan_event* ev)
 {
 	if (!ev)
@@ -2621,7 +3462,9 @@ bool arcan_shmif_descrevent(struct arcan_event* ev)
 		TARGET_COMMAND_FONTHINT,
 		TARGET_COMMAND_BCHUNK_IN,
 		TARGET_COMMAND_BCHUNK_OUT,
-		TARGET_COMMAND_NEWSEGMENT
+		TARGET_COMMAND_NEWSEGMENT,
+		TARGET_COMMAND_BUFFERSTREAM,
+		TARGET_COMMAND_BUFFER_RELEASE
 	};
 
 	for (size_t i = 0; i < COUNT_OF(list); i++){
@@ -2728,7 +3571,7 @@ enum shmif_migrate_status arcan_shmif_migrate(
 /* re-use tracked "old" credentials" */
 	fcntl(dpipe, F_SETFD, FD_CLOEXEC);
 	struct arcan_shmif_cont ret =
-		arcan_shmif_acquire(NULL, keyfile, P->type, P->flags);
+		acquire_sock(dpipe, keyfile, P->type, P->flags);
 	ret.epipe = dpipe;
 
 	if (!ret.addr){
@@ -2769,7 +3612,11 @@ enum shmif_migrate_status arcan_shmif_migrate(
 		.samplerate = cont->samplerate,
 		.meta = P->atype,
 		.rows = atomic_load(&cont->addr->rows),
-		.cols = atomic_load(&cont->addr->cols)
+		.cols = atomic_load(&cont->addr->cols),
+		.evqueue_sz = P->outev.eventbuf_sz,
+		.reserve_w = atomic_load(&cont->addr->reserve_w),
+		.reserve_h = atomic_load(&cont->addr->reserve_h),
+		.swap_mode = P->swap_mode
 	};
 
 /* Copy the drawing/formatting hints, this is particularly important in case of
@@ -2847,6 +3694,7 @@ enum shmif_migrate_status arcan_shmif_migrate(
 		.cleanup = NULL,
 		.active_fd = -1,
 		.pending_fd = -1,
+		.release_fence = -1,
 	};
 
 	arcan_shmif_drop(cont);
@@ -2856,6 +3704,7 @@ enum shmif_migrate_status arcan_shmif_migrate(
  * caller can be masked */
 	void* alias = mmap(contaddr, ret.shmsize,
 		PROT_READ | PROT_WRITE, MAP_SHARED, ret.shmh, 0);
+	advise_page(ret.priv->hugepage, alias, ret.shmsize);
 
 /* prepare the guard-thread in the returned context to have its dms swapped */
 	pthread_mutex_lock(&ret.priv->guard.synch);
@@ -2869,6 +3718,7 @@ enum shmif_migrate_status arcan_shmif_migrate(
 		munmap(ret.addr, ret.shmsize);
 		ret.addr = alias;
 		ret.priv->guard.dms = &ret.addr->dms;
+		bind_doorbells(&ret);
 
 /* need to recalculate the buffer pointers */
 		arcan_shmif_mapav(ret.addr, ret.priv->vbuf, ret.priv->vbuf_cnt,
@@ -2881,7 +3731,9 @@ enum shmif_migrate_status arcan_shmif_migrate(
 		ret.vidp = ret.priv->vbuf[0];
 		ret.audp = ret.priv->abuf[0];
 	}
+	pthread_mutex_lock(&page_lock);
 	memcpy(cont, &ret, sizeof(struct arcan_shmif_cont));
+	pthread_mutex_unlock(&page_lock);
 	pthread_mutex_unlock(&ret.priv->guard.synch);
 
 	cont->hints = oldhints;
@@ -3274,7 +4126,7 @@ struct arcan_shmif_cont arcan_shmif_open_ext(enum ARCAN_FLAGS flags,
  * the newer extended version, we add the little quirk that ext_sz is 0 */
 	if (ext_sz > 0){
 /* we want manual control over the REGISTER message */
-		ret = arcan_shmif_acquire(NULL, keyfile, ext.type, flags | SHMIF_NOREGISTER);
+		ret = acquire_sock(dpipe, keyfile, ext.type, flags | SHMIF_NOREGISTER);
 		if (!ret.priv){
 			close(dpipe);
 			return ret;
@@ -3316,7 +4168,7 @@ struct arcan_shmif_cont arcan_shmif_open_ext(enum ARCAN_FLAGS flags,
 		}
 	}
 	else{
-		ret = arcan_shmif_acquire(NULL, keyfile, ext.type, flags);
+		ret = acquire_sock(dpipe, keyfile, ext.type, flags);
 		if (!ret.priv){
 			close(dpipe);
 			return ret;
@@ -3701,6 +4553,17 @@ int arcan_shmif_dirty(struct arcan_shmif_cont* cont,
 		cont->dirty.x2 = cont->w;
 	}
 
+/* and track the individual region, clamped the same way */
+	if (x2 > cont->w)
+		x2 = cont->w;
+	if (y2 > cont->h)
+		y2 = cont->h;
+
+	if (x2 > x1 && y2 > y1)
+		dirty_chain_add(cont->priv, (struct arcan_shmif_region){
+			.x1 = x1, .y1 = y1, .x2 = x2, .y2 = y2
+		});
+
 #ifdef _DEBUG
 	if (getenv("ARCAN_SHMIF_DEBUG_NODIRTY")){
 		cont->dirty.x1 = 0;
@@ -3744,7 +4607,11 @@ static bool write_buffer(int fd, char* inbuf, size_t inbuf_sz)
 	while(inbuf_sz){
 		ssize_t nr = write(fd, inbuf, inbuf_sz);
 		if (-1 == nr){
-			if (errno == EAGAIN || errno == EINTR)
+			if (errno == EAGAIN){
+				poll(&(struct pollfd){.fd = fd, .events = POLLOUT}, 1, 100);
+				continue;
+			}
+			if (errno == EINTR)
 				continue;
 			return false;
 		}
@@ -3754,10 +4621,106 @@ static bool write_buffer(int fd, char* inbuf, size_t inbuf_sz)
 	return true;
 }
 
+/*
+ * Ways of moving data in copy_thread, picked from the descriptor types and
+ * stepped down to plain read/write if the kernel refuses (cross-device,
+ * unsupported file system, ...). None of them need explicit offsets as they
+ * all advance the file position, so switching mid-stream is safe.
+ */
+enum copy_mode {
+	COPY_RW = 0,
+#ifdef __LINUX
+	COPY_SPLICE,
+	COPY_SENDFILE,
+	COPY_RANGE
+#endif
+};
+
+/* chunk per zero-copy call, small enough to keep progress reporting going,
+ * and the bounce buffer for read/write */
+#define COPY_CHUNK (4 * 1024 * 1024)
+#define COPY_BUFSZ (64 * 1024)
+
+static enum copy_mode copy_mode(int in, int out)
+{
+#ifdef __LINUX
+	struct stat fsin, fsout;
+	if (-1 == fstat(in, &fsin) || -1 == fstat(out, &fsout))
+		return COPY_RW;
+
+	if (S_ISREG(fsin.st_mode) && S_ISREG(fsout.st_mode))
+		return COPY_RANGE;
+
+	if (S_ISFIFO(fsin.st_mode) || S_ISFIFO(fsout.st_mode))
+		return COPY_SPLICE;
+
+	if (S_ISREG(fsin.st_mode))
+		return COPY_SENDFILE;
+#endif
+
+	return COPY_RW;
+}
+
+/*
+ * Move one chunk, returns the number of bytes moved, 0 on EOF, -1 on read
+ * and -2 on write errors. EAGAIN / EINTR are retried here.
+ */
+static ssize_t copy_step(
+	int in, int out, enum copy_mode* mode, char* buf, size_t buf_sz)
+{
+	for(;;){
+		ssize_t nr;
+		switch (*mode){
+#ifdef __LINUX
+		case COPY_RANGE:
+			nr = copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0);
+		break;
+		case COPY_SENDFILE:
+			nr = sendfile(out, in, NULL, COPY_CHUNK);
+		break;
+		case COPY_SPLICE:
+			nr = splice(in, NULL, out, NULL, COPY_CHUNK, SPLICE_F_MOVE);
+		break;
+#endif
+		default:
+			nr = read(in, buf, buf_sz);
+			if (nr > 0 && !write_buffer(out, buf, nr))
+				return -2;
+		break;
+		}
+
+		if (nr >= 0)
+			return nr;
+
+		if (errno == EINTR)
+			continue;
+
+/* the zero-copy calls don't tell which end would block, so wait for both */
+		if (errno == EAGAIN){
+			struct pollfd pfd[2] = {
+				{.fd = in, .events = POLLIN},
+				{.fd = out, .events = *mode == COPY_RW ? 0 : POLLOUT}
+			};
+			poll(pfd, 2, 100);
+			continue;
+		}
+
+		if (*mode != COPY_RW &&
+			(errno == EINVAL || errno == ENOSYS || errno == EXDEV ||
+			errno == EOPNOTSUPP || errno == EBADF)){
+			*mode = COPY_RW;
+			continue;
+		}
+
+/* a failing zero-copy step can't say which end broke */
+		return *mode == COPY_RW ? -1 : -2;
+	}
+}
+
 static void* copy_thread(void* inarg)
 {
 	int* fds = inarg;
-	char inbuf[4096];
+	char msg[64];
 	int8_t sc = 0;
 
 	size_t tot = 0;
@@ -3774,40 +4737,41 @@ static void* copy_thread(void* inarg)
 		tot = fs.st_size;
 	}
 
-/* depending on type and OS, there are a number of options e.g. sendfile,
- * splice, sosplice, ... right now just use a slow/safe */
+	enum copy_mode mode = copy_mode(fds[0], fds[1]);
+	char* buf = mode == COPY_RW ? malloc(COPY_BUFSZ) : NULL;
+
 	for(;;){
-		ssize_t nr = read(fds[0], inbuf, sizeof(inbuf));
-		if (-1 == nr){
-			if (errno == EAGAIN || errno == EINTR)
-				continue;
-			sc = -1;
+		if (mode == COPY_RW && !buf && !(buf = malloc(COPY_BUFSZ))){
+			sc = -3;
 			break;
 		}
-		if (0 == nr){
+
+		ssize_t nr = copy_step(fds[0], fds[1], &mode, buf, COPY_BUFSZ);
+		if (nr < 0){
+			sc = nr;
 			break;
 		}
-		else if (!write_buffer(fds[1], inbuf, nr)){
-			sc = -2;
+		if (0 == nr){
 			break;
 		}
 
 /* PIPE_BUF is required to be >= 512 on POSIX, only update every n megabytes or
  * every second or so as to not block unnecessarily on reporting while still
  * being responsive. */
+		acc += nr;
 		if (fds[3] & SHMIF_BGCOPY_PROGRESS){
-			acc += nr;
-
 			if (acc - last_acc > report_mb * 1024 * 1024 ||
 				arcan_timemillis() - time_last > 1000){
 
 				time_last = arcan_timemillis();
-				int n = snprintf(inbuf,
-					sizeof(inbuf), "%zu:%zu:%zu\n", (size_t) nr, acc, tot);
-				write(fds[2], inbuf, n);
+				last_acc = acc;
+				int n = snprintf(msg,
+					sizeof(msg), "%zu:%zu:%zu\n", (size_t) nr, acc, tot);
+				write(fds[2], msg, n);
 			}
 		}
 	}
+	free(buf);
 
 	if (!(fds[3] & SHMIF_BGCOPY_KEEPIN))
 		close(fds[0]);
@@ -3816,8 +4780,8 @@ static void* copy_thread(void* inarg)
 
 	if (-1 != fds[2]){
 		if (fds[3] & SHMIF_BGCOPY_PROGRESS){
-			int n = snprintf(inbuf, sizeof(inbuf), "%d:%zu:%zu\n", sc, acc, tot);
-			while (-1 == write(fds[2], inbuf, n) &&
+			int n = snprintf(msg, sizeof(msg), "%d:%zu:%zu\n", sc, acc, tot);
+			while (-1 == write(fds[2], msg, n) &&
 				(errno == EAGAIN || errno == EINTR)){}
 		}
 		else
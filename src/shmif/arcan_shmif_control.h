@@ -69,14 +69,21 @@
  */
 
 /*
- * Define the reserved ring-buffer space used for input and output events
- * must be 0 < PP_QUEUE_SZ < 256
+ * Define the reserved ring-buffer space used for input and output events.
+ * PP_QUEUE_SZ is the active size a segment starts out with, PP_QUEUE_MAX the
+ * reserved storage that a segment can negotiate up to through the evqueue_sz
+ * field of shmif_resize_ext. Must be 0 < PP_QUEUE_SZ <= PP_QUEUE_MAX < 65536
  */
 #ifndef PP_QUEUE_SZ
 #define PP_QUEUE_SZ 127
 #endif
 static const int ARCAN_SHMIF_QUEUE_SZ = PP_QUEUE_SZ;
 
+#ifndef PP_QUEUE_MAX
+#define PP_QUEUE_MAX 1024
+#endif
+static const int ARCAN_SHMIF_QUEUE_MAX = PP_QUEUE_MAX;
+
 /*
  * Audio format and basic parameters, this is kept primitive on purpose.
  * This will be revised shortly, but modifying still breaks ABI and may
@@ -109,7 +116,13 @@ static const int ARCAN_SHMIF_ACHANNELS = 2;
  * audiobuffer slot
  */
 #define ARCAN_SHMIF_ABUFC_LIM 12
-#define ARCAN_SHMIF_VBUFC_LIM 3
+#define ARCAN_SHMIF_VBUFC_LIM 4
+
+/*
+ * Upper bound on the number of separate damage rectangles tracked per video
+ * frame, see dirty_chain in the shmpage. Beyond this regions get merged.
+ */
+#define ARCAN_SHMIF_DIRTY_LIM 8
 /*
  * These are technically limited by the combination of graphics and video
  * platforms. Since the buffers are placed at the end of the struct, they
@@ -232,6 +245,40 @@ enum arcan_shmif_sigmask {
 	SHMIF_SIGVID_AUTO_DIRTY = 8,
 };
 
+/*
+ * Swapchain model for video buffers, requested through shmif_resize_ext and
+ * acknowledged in the page. In the default model the parent picks the most
+ * recently signalled buffer and releases all of them at once. The others
+ * track explicit ownership for each of the vbuf_cnt slots (see vslot in the
+ * page) and honor target presentation times set with arcan_shmif_present_at:
+ *
+ * FIFO      - queued frames are presented in order, one per parent frame,
+ *             signal blocks when there is no free slot (regardless of
+ *             SIGBLK_NONE, use arcan_shmif_vslots_free to pace).
+ * MAILBOX   - the newest due frame is presented and older queued frames are
+ *             dropped, when there is no free slot signal reclaims the oldest
+ *             queued one rather than blocking.
+ * IMMEDIATE - as MAILBOX but presentation times are ignored.
+ */
+enum shmif_swap_mode {
+	SHMIF_SWAP_RETAIN = 0,
+	SHMIF_SWAP_DEFAULT = 1,
+	SHMIF_SWAP_FIFO = 2,
+	SHMIF_SWAP_MAILBOX = 3,
+	SHMIF_SWAP_IMMEDIATE = 4
+};
+
+/*
+ * Slot states, a FREE slot belongs to the client, QUEUED have been signalled
+ * and can be reclaimed by the client in MAILBOX mode (compare-exchange) and
+ * ACQUIRED are being read by the parent.
+ */
+enum shmif_vslot_state {
+	SHMIF_VSLOT_FREE = 0,
+	SHMIF_VSLOT_QUEUED = 1,
+	SHMIF_VSLOT_ACQUIRED = 2
+};
+
 struct arcan_shmif_cont;
 struct shmif_ext_hidden;
 struct arcan_shmif_page;
@@ -445,6 +492,12 @@ uintptr_t arcan_shmif_mapav(
 size_t arcan_shmif_vbufsz(
 	int meta, uint8_t hints, size_t w, size_t h, size_t rows, size_t cols);
 
+/*
+ * Bytes per pixel of the video buffer format selected by [meta], see
+ * enum shmif_vbuf_format. Unknown formats return 0.
+ */
+size_t arcan_shmif_vbpp(int meta);
+
 /*
  * There can be one "post-flag, pre-semaphore" hook that will occur
  * before triggering a sigmask and can be used to synch audio to video
@@ -544,6 +597,33 @@ enum shmif_ext_meta {
 	SHMIF_META_VENC = 32
 };
 
+/*
+ * With SHMIF_META_HDR, the format of the video buffers is selected through
+ * the SHMIF_META_VFMT bits of [meta]. They are ignored without SHMIF_META_HDR
+ * and the acknowledged format is reflected back like the rest of the mask.
+ * All formats are in host byte order:
+ *
+ * RGBA8   - shmif_pixel, default.
+ * RGB10A2 - uint32, R in bits 0-9, G 10-19, B 20-29, A 30-31
+ *           (DRM_FORMAT_ABGR2101010, GL_UNSIGNED_INT_2_10_10_10_REV)
+ * RGBA16F - 4 * IEEE-754 binary16 in R, G, B, A order
+ *           (DRM_FORMAT_ABGR16161616F)
+ *
+ * The context stride is updated to reflect the pixel size, pitch is still
+ * counted in shmif_pixel units so a row of RGBA16F has a pitch of 2 * w.
+ */
+enum shmif_vbuf_format {
+	SHMIF_VFMT_RGBA8 = 0,
+	SHMIF_VFMT_RGB10A2 = 1,
+	SHMIF_VFMT_RGBA16F = 2
+};
+
+#define SHMIF_META_VFMT_SHIFT 8
+#define SHMIF_META_VFMT_MASK (0x0f << SHMIF_META_VFMT_SHIFT)
+#define SHMIF_META_VFMT(X) ((int)(((X) & SHMIF_META_VFMT_MASK)\
+	>> SHMIF_META_VFMT_SHIFT))
+#define SHMIF_META_FMT(X) (((X) << SHMIF_META_VFMT_SHIFT) & SHMIF_META_VFMT_MASK)
+
 /*
  * The acknowledged mask is reflected in cont->adata, and may subsequently
  * affect apad and apad_type in the addr-> substructure as well.
@@ -569,6 +649,19 @@ struct shmif_resize_ext {
  * is used for calculating the size of the apad region reserved for vobj */
 	size_t nops;
 	size_t op_fm;
+
+/* number of event queue slots to request in each direction, clamped to
+ * PP_QUEUE_SZ..PP_QUEUE_MAX, 0 retains the current queue size */
+	size_t evqueue_sz;
+
+/* video dimensions to reserve segment space for so that resizes within them
+ * do not remap (interactive resizing), 0 retains the current reservation and
+ * -1 releases it */
+	ssize_t reserve_w;
+	ssize_t reserve_h;
+
+/* enum shmif_swap_mode, 0 retains the current model */
+	int swap_mode;
 };
 
 /* extended resize that allows better buffering and format controls,
@@ -593,6 +686,54 @@ void arcan_shmif_drop(struct arcan_shmif_cont*);
  */
 unsigned arcan_shmif_signal(struct arcan_shmif_cont*, enum arcan_shmif_sigmask);
 
+/*
+ * Set the target presentation time (arcan_timemillis() clock) for the next
+ * video signal. Only used with the FIFO and MAILBOX swapchain models, the
+ * parent will not consume the frame before then. Resets after each signal.
+ */
+void arcan_shmif_present_at(struct arcan_shmif_cont*, uint64_t pts);
+
+/*
+ * Number of video buffer slots (excluding the current vidp) that the client
+ * could move to without blocking. With the DEFAULT model this is always 0.
+ */
+size_t arcan_shmif_vslots_free(struct arcan_shmif_cont*);
+
+/*
+ * Pipelined variant of arcan_shmif_signal. The signal, and any wait for the
+ * server that it would block on, runs on a worker thread for the segment
+ * (created on first use) so that the caller can do other work like input,
+ * simulation or preparing the next frame in a buffer of its own while the
+ * server composes.
+ *
+ * Returns false if the previous async signal is still in flight or the
+ * context is dead. Until it completes, vidp, audp and the buffer related
+ * fields of the context belong to the worker. Events can still be polled and
+ * enqueued. Resize waits for the in-flight signal, and so does drop, which
+ * also stops the worker and must not be called from [done].
+ *
+ * On completion [done] (if set) runs on the worker thread with the return
+ * value of arcan_shmif_signal, and the descriptor from _signal_async_handle
+ * becomes readable until the completion is collected with _signal_async_wait.
+ * The context must stay at the same address while the worker exists.
+ */
+bool arcan_shmif_signal_async(struct arcan_shmif_cont*,
+	enum arcan_shmif_sigmask,
+	void (*done)(struct arcan_shmif_cont*, unsigned ms, void* tag), void* tag);
+
+/*
+ * Pollable descriptor for async signal completion, -1 before the first
+ * arcan_shmif_signal_async.
+ */
+int arcan_shmif_signal_async_handle(struct arcan_shmif_cont*);
+
+/*
+ * Collect the completion of the last async signal, waiting for it if [block]
+ * is set. Returns -1 if it is still in flight, otherwise what the signal
+ * returned (0 if nothing was ever submitted).
+ */
+int arcan_shmif_signal_async_wait(struct arcan_shmif_cont*, bool block);
+
 /*
  * Signal a video transfer that is based on buffer sharing rather than on data
  * in the shmpage. Otherwise it behaves like [arcan_shmif_signal] but with a
@@ -615,6 +756,29 @@ unsigned arcan_shmif_signal(struct arcan_shmif_cont*, enum arcan_shmif_sigmask);
 unsigned arcan_shmif_signalhandle(struct arcan_shmif_cont* ctx,
 	int mask, int handle, size_t stride, int format, ...);
 
+/*
+ * Signal a video transfer from shared memory owned by the caller rather than
+ * from vidp, e.g. a pool from a wayland client to avoid copying it into the
+ * segment. [handle] is not consumed, the server maps it read- only and takes
+ * the w*h pixels at [offset] with [stride] bytes per row. The size is that of
+ * the segment, [format] is a DRM fourcc of a packed 32-bit layout matching
+ * shmif_pixel (XRGB8888 or ARGB8888).
+ *
+ * The server only accepts descriptors sealed against shrinking (F_SEAL_SHRINK)
+ * as it would fault on reading a truncated one. The dirty region applies as
+ * with a normal signal.
+ *
+ * The memory must be left untouched until TARGET_COMMAND_BUFFER_RELEASE with
+ * a BADFD handle arrives. If the server rejects the transfer it responds with
+ * BUFFER_FAIL followed by the release and arcan_shmif_handle_permitted will
+ * return false from then on.
+ *
+ * Returns false (and sends nothing) if handle passing is not permitted or the
+ * descriptor couldn't be sent, otherwise the frame is signalled with [mask].
+ */
+bool arcan_shmif_signal_shm(struct arcan_shmif_cont* ctx, int mask,
+	int handle, size_t offset, size_t stride, uint32_t format);
+
 /*
  * Returns true of handle based buffer passing is permitted or not, if not
  * a software based approach is required. The extended graphics mode of shmif
@@ -625,6 +789,17 @@ unsigned arcan_shmif_signalhandle(struct arcan_shmif_cont* ctx,
  */
 bool arcan_shmif_handle_permitted(struct arcan_shmif_cont* ctx);
 
+/*
+ * Take ownership of the latest release fence (TARGET_COMMAND_BUFFER_RELEASE)
+ * for buffers signalled with acquire fences, for proxies that forward it to
+ * their own clients (e.g. waybridge with linux-drm-syncobj) rather than wait
+ * on it. Returns -1 if none has arrived since the last call, otherwise a
+ * sync_file that signals when the server no longer reads from the buffers
+ * submitted before the [*held] most recent ones. Later fences cover earlier
+ * ones so only the latest is kept.
+ */
+int arcan_shmif_release_fence(struct arcan_shmif_cont* ctx, size_t* held);
+
 /*
  * Support function to set/unset the primary access segment (one slot for
  * input. one slot for output), manually managed. This is just a static member
@@ -641,6 +816,18 @@ void arcan_shmif_setprimary( enum arcan_shmif_type, struct arcan_shmif_cont*);
 bool arcan_shmif_lock(struct arcan_shmif_cont*);
 bool arcan_shmif_unlock(struct arcan_shmif_cont*);
 
+/*
+ * Copy the performance counters (struct arcan_shmif_perf) of [cont] into
+ * [out] and the number of pending events in the inbound and outbound queues
+ * into [inq] and [outq] (either can be NULL). This may be called from another
+ * thread than the one driving the context, e.g. the debug interface, and is
+ * safe against the page being remapped by a concurrent resize or migration.
+ * Returns false if the context has no live page.
+ */
+struct arcan_shmif_perf;
+bool arcan_shmif_perf_sample(struct arcan_shmif_cont* cont,
+	struct arcan_shmif_perf* out, size_t* inq, size_t* outq);
+
 /*
  * Update the failure callback associated with a context- remapping due to
  * a connection failure. Although ->vidp and ->audp may be correct, there are
@@ -788,7 +975,7 @@ struct arcan_shmif_cont {
  * SHMIF_RHINT_ORIGO_UL (or LL),
  * SHMIF_RHINT_IGNORE_ALPHA
  * SHMIF_RHINT_SUBREGION (only synch dirty region below)
- * SHMIF_RHINT_SUBREGION_CHAIN (reserved, not in use)
+ * SHMIF_RHINT_SUBREGION_CHAIN (reserved, see dirty_chain in page for damage)
  * SHMIF_RHINT_CSPACE_SRGB (non-linear color space)
  * SHMIF_RHINT_AUTH_TOK
  * SHMIF_RHINT_VSIGNAL_EV (get frame- delivery notification via STEPFRAME)
@@ -810,6 +997,11 @@ struct arcan_shmif_cont {
  *
  * The dirty region is reset on either calls to arcan_shmif_signal (video)
  * or on shmif_resize calls that impose a size change.
+ *
+ * When the region is built through arcan_shmif_dirty, the separate calls are
+ * also tracked (up to ARCAN_SHMIF_DIRTY_LIM) and forwarded as a chain so that
+ * disjoint updates do not need to synch the entire bounding box. Modifying
+ * this field directly drops the chain for the frame.
  */
   struct arcan_shmif_region dirty;
 
@@ -953,6 +1145,13 @@ enum rhint_mask {
  */
 	SHMIF_RHINT_VSIGNAL_EV = 32,
 
+/*
+ * Set on the page (not through _resize) by output segments that can map GPU
+ * buffer handles. The server may then deliver frames as BUFFERSTREAM events
+ * instead of copying into the vbuffer, see TARGET_COMMAND_BUFFERSTREAM.
+ */
+	SHMIF_RHINT_IMPORT_BUFFER = 64,
+
 /*
  * Changes the buffer contents to be packed in the TPACK format (see
  * tui/raster). This means that the server side will ignore the normal size
@@ -966,6 +1165,43 @@ enum rhint_mask {
 
 struct arcan_shmif_page;
 
+/*
+ * Client side performance counters, kept in the page and maintained by
+ * arcan_shmif_signal and the event queue functions so that the server or a
+ * monitor (tools/shmmon) can sample them without the client being involved.
+ * These are statistics only, written with relaxed ordering, and wrap around.
+ */
+struct arcan_shmif_perf {
+/* video frames and audio buffers signalled, dropped are video frames that
+ * were replaced by a newer signal before the server picked them up */
+	_Atomic uint32_t frames;
+	_Atomic uint32_t dropped;
+	_Atomic uint32_t audio;
+
+/* microseconds spent outside of signal (rendering) and blocked inside of it
+ * (waiting on the server), accumulated and for the last signal */
+	_Atomic uint64_t render_us;
+	_Atomic uint64_t wait_us;
+	_Atomic uint32_t last_render_us;
+	_Atomic uint32_t last_wait_us;
+
+/* highest number of pending events seen in the outbound queue on enqueue and
+ * in the inbound queue on poll / wait, and times enqueue had to block */
+	_Atomic uint16_t outq_hwm;
+	_Atomic uint16_t inq_hwm;
+	_Atomic uint32_t outq_full;
+
+/* completed resize requests and microseconds spent waiting for the server
+ * to acknowledge them */
+	_Atomic uint32_t resizes;
+	_Atomic uint64_t resize_us;
+
+/* calls to arcan_shmif_wait / _wait_timed and microseconds spent blocked in
+ * them waiting for an event */
+	_Atomic uint32_t evwaits;
+	_Atomic uint64_t evwait_us;
+};
+
 #ifndef ARCAN_SHMIF_HIDEPAGE
 struct arcan_shmif_page {
 /*
@@ -1019,6 +1255,27 @@ struct arcan_shmif_page {
 	volatile _Atomic int16_t scroll_dx;
 	volatile _Atomic int16_t scroll_dy;
 
+/*
+ * [FSRV-SET, SYNCH ON VREADY]
+ * If dirty_chain_n > 1, the dirty region above is the bounding box of the
+ * dirty_chain_n regions here and the server MAY synch just those. The regions
+ * are disjoint, clamped to the segment and written before vready is set.
+ */
+	volatile _Atomic uint8_t dirty_chain_n;
+	struct arcan_shmif_region dirty_chain[ARCAN_SHMIF_DIRTY_LIM];
+
+/*
+ * [FSRV-SET (resize), ARCAN-ACK]
+ * Active swapchain model (enum shmif_swap_mode), 0 is treated as DEFAULT.
+ * For anything else, the slot state, submission order and target time
+ * (CLOCK_MONOTONIC ms as per arcan_timemillis, 0 = as soon as possible) of
+ * each video buffer is tracked here rather than through vpending.
+ */
+	volatile _Atomic uint8_t swap_mode;
+	volatile _Atomic uint8_t vslot[ARCAN_SHMIF_VBUFC_LIM];
+	volatile _Atomic uint32_t vslot_seq[ARCAN_SHMIF_VBUFC_LIM];
+	volatile _Atomic uint64_t vslot_pts[ARCAN_SHMIF_VBUFC_LIM];
+
 /* [FSRV-SET]
  * Unique (or 0) segment identifier. Prvodes a local namespace for specifying
  * relative properties (e.g. VIEWPORT command from popups) between subsegments,
@@ -1039,10 +1296,20 @@ struct arcan_shmif_page {
  * constraints, making this interface a poor choice for a protocol.
  */
 	struct {
-		struct arcan_event evqueue[ PP_QUEUE_SZ ];
-		uint8_t front, back;
+		struct arcan_event evqueue[ PP_QUEUE_MAX ];
+		uint16_t front, back;
+
+/* [ARCAN-SET] active number of slots, 0 < size <= PP_QUEUE_MAX */
+		uint16_t size;
 	} childevq, parentevq;
 
+/* [FSRV-SET, ARCAN-CHECK]
+ * Requested number of slots for both queues, read by the parent on resize
+ * negotiation and clamped to PP_QUEUE_SZ..PP_QUEUE_MAX. Pending events are retained when
+ * the rings change size. 0 retains the current size.
+ */
+	uint16_t evqueue_req;
+
 /* [ARCAN-SET (parent), FSRV-CHECK]
  * Arcan mandates segment size, will only change during resize negotiation.
  * If this differs from the previous known size (tracked inside shmif_cont),
@@ -1070,6 +1337,17 @@ struct arcan_shmif_page {
  */
 	volatile _Atomic uint_least16_t rows, cols;
 
+/*
+ * [FSRV-SET (resize), ARCAN-CHECK]
+ * Dimensions that the video buffers should be able to grow to without the
+ * segment being remapped. When set, ARCAN sizes the segment for these (or the
+ * current w, h if larger) and sets segment_size to the full reservation, so
+ * resizes that stay inside of it only move buffer offsets. Pages beyond what
+ * is in use are never touched so the reservation costs address space only.
+ * 0 disables the reservation.
+ */
+	volatile _Atomic uint_least16_t reserve_w, reserve_h;
+
 /*
  * [FSRV-SET (aready signal), ARCAN-ACK]
  * Video buffers are planar transfers of a pre-determined size. Audio,
@@ -1111,6 +1389,20 @@ struct arcan_shmif_page {
  */
 	volatile _Atomic uint32_t apad, apad_type;
 
+/*
+ * [ARCAN-SET]
+ * Set to non-zero when the segment was created by a server built with
+ * ARCAN_SHMIF_FUTEX. The doorbell words then replace the named v/a/e
+ * semaphores as (count, waiters) pairs and both ends need to agree.
+ */
+	uint32_t futex;
+	_Atomic uint32_t doorbell[3][2];
+
+/* [FSRV-SET, ARCAN-READ]
+ * See struct arcan_shmif_perf above.
+ */
+	struct arcan_shmif_perf perf;
+
 /*
  * [FSRV-SET-ON-DMS/EXIT]
  * Short user-readable utf8- message to indicate a possible reason for a
@@ -15,7 +15,6 @@
  *  - interesting / unexplored venues:
  *    - seccomp- renderer
  *    - sanitizer
- *    - statistic profiler
  *    - detach intercept / redirect window
  *    - dynamic descriptor list refresh
  *    - runtime symbol hijack
@@ -57,6 +56,8 @@
 #include "arcan_shmif_debugif.h"
 #include <pthread.h>
 #include <dlfcn.h>
+#include <inttypes.h>
+#include <stddef.h>
 #include <errno.h>
 #include <ctype.h>
 #include <unistd.h>
@@ -74,6 +75,10 @@
 
 #ifdef __LINUX
 #include <sys/prctl.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <dirent.h>
 #endif
 
 /*
@@ -98,7 +103,8 @@ enum debug_cmd_id {
 	TAG_CMD_ENVIRONMENT = 1,
 	TAG_CMD_DESCRIPTOR = 2,
 	TAG_CMD_PROCESS = 3,
-	TAG_CMD_EXTERNAL = 4
+	TAG_CMD_EXTERNAL = 4,
+	TAG_CMD_PROFILE = 5
 };
 
 static volatile _Atomic int beancounter;
@@ -1441,6 +1447,519 @@ static void set_process_window(struct debug_ctx* dctx)
 	free(buf);
 }
 
+/*
+ * Profile view: counters from the perf block of the primary segment sampled
+ * once per interval into a short history, and (linux, if perf_event_paranoid
+ * permits) a statistical profile of the other threads in the process as a
+ * text call tree. Callchains come from the kernel frame-pointer unwinder, so
+ * code built without frame pointers will show up as shallow stacks.
+ */
+#define PROF_INTERVAL_MS 1000
+#define PROF_HISTORY 48
+#define PROF_FREQ 99
+#define PROF_MAX_THREADS 16
+#define PROF_RING_PAGES 16
+#define PROF_MAX_NODES 4096
+#define PROF_MAX_DEPTH 48
+#define PROF_SYMCACHE 4096
+#define PROF_MIN_PERMILLE 5
+
+struct prof_sample {
+	float fps;
+	float render_ms;
+	float signal_pct;
+	float evwait_pct;
+	float resizes;
+	size_t inq, outq;
+};
+
+struct prof_node {
+	uintptr_t sym;
+	uint32_t count;
+	uint32_t self;
+	uint32_t child;
+	uint32_t next;
+};
+
+struct prof_ctx {
+	struct arcan_shmif_cont* src;
+
+	uint64_t last_ts;
+	struct arcan_shmif_perf last;
+	bool have_last;
+
+	struct prof_sample hist[PROF_HISTORY];
+	size_t hist_pos, hist_count;
+	size_t inq_hwm, outq_hwm;
+	uint32_t outq_full;
+
+	const char* sampler;
+	int sampler_errno;
+	size_t n_threads;
+	int fds[PROF_MAX_THREADS];
+	uint8_t* maps[PROF_MAX_THREADS];
+	size_t map_sz;
+	uint64_t samples, lost, truncated;
+
+	struct {
+		uintptr_t ip, sym;
+	} symcache[PROF_SYMCACHE];
+
+	size_t n_nodes;
+	struct prof_node nodes[PROF_MAX_NODES];
+	uint8_t scratch[8192];
+};
+
+static uintptr_t prof_symbol(struct prof_ctx* P, uintptr_t ip)
+{
+	size_t slot = (ip * 2654435761u) % PROF_SYMCACHE;
+	if (P->symcache[slot].ip == ip)
+		return P->symcache[slot].sym;
+
+/* without a symbol (static functions, stripped) the address itself is the
+ * key, so distinct sites in such a function won't merge */
+	Dl_info info;
+	uintptr_t sym = ip;
+	if (dladdr((void*) ip, &info) && info.dli_saddr)
+		sym = (uintptr_t) info.dli_saddr;
+
+	P->symcache[slot].ip = ip;
+	P->symcache[slot].sym = sym;
+	return sym;
+}
+
+static void prof_symbol_str(uintptr_t sym, char* buf, size_t buf_sz)
+{
+	Dl_info info;
+	if (!dladdr((void*) sym, &info)){
+		snprintf(buf, buf_sz, "0x%"PRIxPTR, sym);
+		return;
+	}
+
+	if (info.dli_sname && (uintptr_t) info.dli_saddr == sym){
+		snprintf(buf, buf_sz, "%s", info.dli_sname);
+		return;
+	}
+
+	const char* mod = info.dli_fname ? strrchr(info.dli_fname, '/') : NULL;
+	mod = mod ? mod + 1 : (info.dli_fname ? info.dli_fname : "?");
+	snprintf(buf, buf_sz, "%s+0x%"PRIxPTR, mod, sym - (uintptr_t) info.dli_fbase);
+}
+
+/* chain is outermost frame first, node 0 is the root for all threads */
+static void prof_insert(struct prof_ctx* P, uintptr_t* chain, size_t n)
+{
+	uint32_t cur = 0;
+	P->nodes[0].count++;
+
+	for (size_t i = 0; i < n && i < PROF_MAX_DEPTH; i++){
+		uint32_t c = P->nodes[cur].child;
+		while (c && P->nodes[c].sym != chain[i])
+			c = P->nodes[c].next;
+
+		if (!c){
+			if (P->n_nodes == PROF_MAX_NODES){
+				P->truncated++;
+				break;
+			}
+			c = P->n_nodes++;
+			P->nodes[c] = (struct prof_node){
+				.sym = chain[i],
+				.next = P->nodes[cur].child
+			};
+			P->nodes[cur].child = c;
+		}
+
+		P->nodes[c].count++;
+		cur = c;
+	}
+
+	P->nodes[cur].self++;
+}
+
+#ifdef __LINUX
+static void prof_start(struct prof_ctx* P)
+{
+	P->n_nodes = 1;
+	P->sampler = "sampling: only available on linux";
+
+	DIR* dir = opendir("/proc/self/task");
+	if (!dir){
+		P->sampler_errno = errno;
+		return;
+	}
+
+	long page_sz = sysconf(_SC_PAGESIZE);
+	P->map_sz = (1 + PROF_RING_PAGES) * page_sz;
+
+	pid_t self = syscall(SYS_gettid);
+	struct dirent* ent;
+
+	while ((ent = readdir(dir)) && P->n_threads < PROF_MAX_THREADS){
+		pid_t tid = strtoul(ent->d_name, NULL, 10);
+		if (tid <= 0 || tid == self)
+			continue;
+
+		struct perf_event_attr attr = {
+			.type = PERF_TYPE_SOFTWARE,
+			.size = sizeof(struct perf_event_attr),
+			.config = PERF_COUNT_SW_TASK_CLOCK,
+			.sample_freq = PROF_FREQ,
+			.freq = 1,
+			.sample_type = PERF_SAMPLE_CALLCHAIN,
+			.disabled = 1,
+			.exclude_kernel = 1,
+			.exclude_hv = 1,
+			.exclude_callchain_kernel = 1
+		};
+
+		int fd = syscall(SYS_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+		if (-1 == fd){
+			P->sampler_errno = errno;
+			continue;
+		}
+
+		uint8_t* map = mmap(NULL, P->map_sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (map == MAP_FAILED){
+			P->sampler_errno = errno;
+			close(fd);
+			continue;
+		}
+
+		P->fds[P->n_threads] = fd;
+		P->maps[P->n_threads] = map;
+		P->n_threads++;
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	closedir(dir);
+	P->sampler = P->n_threads ? NULL :
+		"sampling: perf_event_open failed (see kernel.perf_event_paranoid)";
+}
+
+static void prof_stop(struct prof_ctx* P)
+{
+	for (size_t i = 0; i < P->n_threads; i++){
+		ioctl(P->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+		munmap(P->maps[i], P->map_sz);
+		close(P->fds[i]);
+	}
+	P->n_threads = 0;
+}
+
+static void ring_copy(uint8_t* data, size_t data_sz,
+	uint64_t ofs, uint8_t* dst, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = data[(ofs + i) % data_sz];
+}
+
+static void prof_drain(struct prof_ctx* P)
+{
+	long page_sz = sysconf(_SC_PAGESIZE);
+
+	for (size_t t = 0; t < P->n_threads; t++){
+		struct perf_event_mmap_page* mp = (struct perf_event_mmap_page*) P->maps[t];
+		uint8_t* data = P->maps[t] + page_sz;
+		size_t data_sz = P->map_sz - page_sz;
+
+		uint64_t head = __atomic_load_n(&mp->data_head, __ATOMIC_ACQUIRE);
+		uint64_t tail = mp->data_tail;
+
+		while (tail + sizeof(struct perf_event_header) <= head){
+			struct perf_event_header hdr;
+			ring_copy(data, data_sz, tail, (uint8_t*) &hdr, sizeof(hdr));
+			if (hdr.size < sizeof(hdr) || tail + hdr.size > head)
+				break;
+
+			if (hdr.size <= sizeof(P->scratch)){
+				ring_copy(data, data_sz, tail, P->scratch, hdr.size);
+				uint64_t* body = (uint64_t*) &P->scratch[sizeof(hdr)];
+
+/* sample is { u64 nr, u64 ips[nr] }, lost is { u64 id, u64 lost } */
+				if (hdr.type == PERF_RECORD_SAMPLE){
+					uint64_t nr = body[0];
+					if ((nr + 1) * sizeof(uint64_t) + sizeof(hdr) <= hdr.size){
+						uintptr_t chain[PROF_MAX_DEPTH];
+						size_t n = 0;
+						size_t leaf = 1;
+						while (leaf < nr && body[leaf] >= (uint64_t) PERF_CONTEXT_MAX)
+							leaf++;
+
+/* walk from the outermost frame, skip the context markers and step return
+ * addresses back into the call so they resolve to the caller */
+						for (size_t i = nr; i >= leaf && n < PROF_MAX_DEPTH; i--){
+							uint64_t ip = body[i];
+							if (ip >= (uint64_t) PERF_CONTEXT_MAX)
+								continue;
+							chain[n++] = prof_symbol(P, i > leaf ? ip - 1 : ip);
+						}
+
+						prof_insert(P, chain, n);
+						P->samples++;
+					}
+				}
+				else if (hdr.type == PERF_RECORD_LOST)
+					P->lost += body[1];
+			}
+
+			tail += hdr.size;
+		}
+
+		__atomic_store_n(&mp->data_tail, tail, __ATOMIC_RELEASE);
+	}
+}
+#else
+static void prof_start(struct prof_ctx* P)
+{
+	P->n_nodes = 1;
+	P->sampler = "sampling: only available on linux";
+}
+
+static void prof_stop(struct prof_ctx* P)
+{
+}
+
+static void prof_drain(struct prof_ctx* P)
+{
+}
+#endif
+
+static void prof_sample(struct prof_ctx* P)
+{
+	struct arcan_shmif_perf cur;
+	size_t inq, outq;
+	if (!arcan_shmif_perf_sample(P->src, &cur, &inq, &outq))
+		return;
+
+	uint64_t now = arcan_timemillis();
+	struct prof_sample s = {
+		.inq = inq,
+		.outq = outq
+	};
+
+	if (P->have_last && now > P->last_ts){
+		float dt = (float)(now - P->last_ts) / 1000.0;
+#define DELTA(X) ((float)(cur.X - P->last.X))
+		float frames = DELTA(frames);
+		s.fps = frames / dt;
+		s.render_ms = frames > 0 ? DELTA(render_us) / (1000.0 * frames) : 0;
+		s.signal_pct = DELTA(wait_us) / (dt * 10000.0);
+		s.evwait_pct = DELTA(evwait_us) / (dt * 10000.0);
+		s.resizes = DELTA(resizes) / dt;
+#undef DELTA
+
+		P->hist[P->hist_pos] = s;
+		P->hist_pos = (P->hist_pos + 1) % PROF_HISTORY;
+		if (P->hist_count < PROF_HISTORY)
+			P->hist_count++;
+	}
+
+	P->inq_hwm = cur.inq_hwm;
+	P->outq_hwm = cur.outq_hwm;
+	P->outq_full = cur.outq_full;
+	P->last = cur;
+	P->last_ts = now;
+	P->have_last = true;
+}
+
+/* one glyph per history entry, oldest first, scaled against [max] */
+static void prof_spark(FILE* out, struct prof_ctx* P, size_t ofs, float max)
+{
+	static const char* const bars[] = {
+		" ", "▁", "▂", "▃", "▄",
+		"▅", "▆", "▇", "█"
+	};
+
+	for (size_t i = 0; i < P->hist_count; i++){
+		size_t pos = (P->hist_pos + PROF_HISTORY - P->hist_count + i) % PROF_HISTORY;
+		float v;
+		if (ofs == offsetof(struct prof_sample, inq))
+			v = P->hist[pos].inq;
+		else if (ofs == offsetof(struct prof_sample, outq))
+			v = P->hist[pos].outq;
+		else
+			v = *(float*)((uint8_t*) &P->hist[pos] + ofs);
+
+		int step = max > 0 ? (int)(v / max * 8.0 + 0.5) : 0;
+		fputs(bars[step < 0 ? 0 : (step > 8 ? 8 : step)], out);
+	}
+}
+
+static float prof_max(struct prof_ctx* P, size_t ofs, float floor)
+{
+	float max = floor;
+	for (size_t i = 0; i < P->hist_count; i++){
+		float v = *(float*)((uint8_t*) &P->hist[i] + ofs);
+		if (v > max)
+			max = v;
+	}
+	return max;
+}
+
+static void prof_tree(FILE* out, struct prof_ctx* P, uint32_t node, size_t depth)
+{
+	uint32_t kids[64];
+	size_t nk = 0;
+	uint64_t total = P->nodes[0].count;
+
+	for (uint32_t c = P->nodes[node].child; c && nk < COUNT_OF(kids); c = P->nodes[c].next)
+		kids[nk++] = c;
+
+	for (size_t i = 1; i < nk; i++){
+		uint32_t k = kids[i];
+		size_t j = i;
+		for (; j > 0 && P->nodes[kids[j-1]].count < P->nodes[k].count; j--)
+			kids[j] = kids[j-1];
+		kids[j] = k;
+	}
+
+	for (size_t i = 0; i < nk; i++){
+		struct prof_node* n = &P->nodes[kids[i]];
+		if ((uint64_t) n->count * 1000 < total * PROF_MIN_PERMILLE)
+			break;
+
+		char sym[128];
+		prof_symbol_str(n->sym, sym, sizeof(sym));
+		fprintf(out, "%5.1f%% %5.1f%% %*s%s\n",
+			100.0 * (float) n->count / (float) total,
+			100.0 * (float) n->self / (float) total, (int)(depth * 2), "", sym);
+
+		if (depth < PROF_MAX_DEPTH)
+			prof_tree(out, P, kids[i], depth + 1);
+	}
+}
+
+static char* prof_render(struct prof_ctx* P, size_t* out_sz)
+{
+	char* buf = NULL;
+	FILE* out = open_memstream(&buf, out_sz);
+	if (!out)
+		return NULL;
+
+	struct prof_sample* s = P->hist_count ?
+		&P->hist[(P->hist_pos + PROF_HISTORY - 1) % PROF_HISTORY] : &(struct prof_sample){};
+	size_t qsz = P->src->addr ? P->src->addr->childevq.size : PP_QUEUE_SZ;
+
+	fprintf(out, "segment %zu x %zu, %d s history\n\n",
+		(size_t) P->src->w, (size_t) P->src->h, (int)(P->hist_count * PROF_INTERVAL_MS / 1000));
+
+	fprintf(out, "frames  %6.1f/s    ", s->fps);
+	prof_spark(out, P, offsetof(struct prof_sample, fps), prof_max(P, offsetof(struct prof_sample, fps), 1));
+	fprintf(out, "\nrender  %6.2f ms   ", s->render_ms);
+	prof_spark(out, P, offsetof(struct prof_sample, render_ms), prof_max(P, offsetof(struct prof_sample, render_ms), 1));
+	fprintf(out, "\nsignal  %6.1f %%    ", s->signal_pct);
+	prof_spark(out, P, offsetof(struct prof_sample, signal_pct), 100);
+	fprintf(out, "\nwait    %6.1f %%    ", s->evwait_pct);
+	prof_spark(out, P, offsetof(struct prof_sample, evwait_pct), 100);
+	fprintf(out, "\nresize  %6.2f/s    ", s->resizes);
+	prof_spark(out, P, offsetof(struct prof_sample, resizes), prof_max(P, offsetof(struct prof_sample, resizes), 1));
+	fprintf(out, "\nin-q    %3zu / %3zu  ", s->inq, qsz);
+	prof_spark(out, P, offsetof(struct prof_sample, inq), qsz);
+	fprintf(out, "\nout-q   %3zu / %3zu  ", s->outq, qsz);
+	prof_spark(out, P, offsetof(struct prof_sample, outq), qsz);
+	fprintf(out, "\n\nqueue high-water in: %zu out: %zu, blocked enqueue: %"PRIu32"\n\n",
+		P->inq_hwm, P->outq_hwm, P->outq_full);
+
+	if (P->sampler){
+		fprintf(out, "%s", P->sampler);
+		if (P->sampler_errno)
+			fprintf(out, ": %s", strerror(P->sampler_errno));
+		fprintf(out, "\n");
+	}
+	else {
+		fprintf(out, "%"PRIu64" samples at %d Hz over %zu threads, lost: %"PRIu64"%s\n",
+			P->samples, PROF_FREQ, P->n_threads, P->lost,
+			P->truncated ? ", tree full" : "");
+		fprintf(out, " total   self\n");
+		if (P->nodes[0].count)
+			prof_tree(out, P, 0, 0);
+	}
+
+	fclose(out);
+	return buf;
+}
+
+static void set_profile_window(struct debug_ctx* dctx)
+{
+	struct arcan_shmif_cont* src = arcan_shmif_primary(SHMIF_INPUT);
+	if (!src || !src->addr){
+		show_error_message(dctx->tui, "No primary segment to profile");
+		return;
+	}
+
+	struct prof_ctx* P = malloc(sizeof(struct prof_ctx));
+	if (!P)
+		return;
+
+	*P = (struct prof_ctx){
+		.src = src
+	};
+
+	prof_start(P);
+	prof_sample(P);
+
+	size_t buf_sz;
+	char* buf = prof_render(P, &buf_sz);
+	if (!buf){
+		prof_stop(P);
+		free(P);
+		return;
+	}
+
+	struct tui_bufferwnd_opts opts = {
+		.read_only = true,
+		.view_mode = BUFFERWND_VIEW_UTF8,
+		.wrap_mode = BUFFERWND_WRAP_ACCEPT_LF,
+		.allow_exit = true
+	};
+
+	arcan_tui_ident(dctx->tui, "profile");
+	arcan_tui_bufferwnd_setup(dctx->tui, (uint8_t*) buf, buf_sz, &opts, sizeof(opts));
+	uint64_t next = arcan_timemillis() + PROF_INTERVAL_MS;
+
+/* same loop as run_buffer, but wake up to drain the sample rings and to
+ * replace the contents on every interval */
+	while (1 == arcan_tui_bufferwnd_status(dctx->tui)){
+		uint64_t now = arcan_timemillis();
+		int timeout = next > now ? next - now : 0;
+		timeout = timeout > 100 ? 100 : timeout;
+
+		struct tui_process_res res = arcan_tui_process(&dctx->tui, 1, NULL, 0, timeout);
+		if (res.errc == TUI_ERRC_OK){
+			if (-1 == arcan_tui_refresh(dctx->tui) && errno == EINVAL)
+				break;
+		}
+
+		prof_drain(P);
+		if (arcan_timemillis() < next)
+			continue;
+
+		next += PROF_INTERVAL_MS;
+		prof_sample(P);
+
+		size_t new_sz;
+		char* new_buf = prof_render(P, &new_sz);
+		if (!new_buf)
+			continue;
+
+		size_t pos = arcan_tui_bufferwnd_tell(dctx->tui, NULL);
+		arcan_tui_bufferwnd_synch(dctx->tui, (uint8_t*) new_buf, new_sz, 0);
+		arcan_tui_bufferwnd_seek(dctx->tui, pos < new_sz ? pos : 0);
+		free(buf);
+		buf = new_buf;
+		buf_sz = new_sz;
+	}
+
+	arcan_tui_bufferwnd_release(dctx->tui);
+	arcan_tui_update_handlers(dctx->tui,
+		&(struct tui_cbcfg){}, NULL, sizeof(struct tui_cbcfg));
+
+	prof_stop(P);
+	free(P);
+	free(buf);
+}
+
 static void root_menu(struct debug_ctx* dctx)
 {
 	struct tui_list_entry menu_root[] = {
@@ -1472,6 +1991,11 @@ static void root_menu(struct debug_ctx* dctx)
 			.attributes = LIST_HAS_SUB,
 			.tag = TAG_CMD_PROCESS
 		},
+		{
+			.label = "Profile",
+			.attributes = LIST_HAS_SUB,
+			.tag = TAG_CMD_PROFILE
+		},
 /*
  * this little thing is to allow other tools to attach more entries
  * here, see, for instance, src/tools/adbginject.so that keeps the
@@ -1483,7 +2007,7 @@ static void root_menu(struct debug_ctx* dctx)
 		}
 	};
 
-	size_t nent = 4;
+	size_t nent = 5;
 	struct tui_list_entry* cent = &menu_root[COUNT_OF(menu_root)-1];
 	if (dctx->resolver.label){
 		cent->label = dctx->resolver.label;
@@ -1533,6 +2057,9 @@ static void root_menu(struct debug_ctx* dctx)
 						case TAG_CMD_PROCESS :
 							set_process_window(dctx);
 						break;
+						case TAG_CMD_PROFILE :
+							set_profile_window(dctx);
+						break;
 						case TAG_CMD_EXTERNAL :
 							dctx->resolver.handler(dctx->tui, dctx->resolver.tag);
 						break;
@@ -324,7 +324,10 @@ enum ARCAN_TARGET_COMMAND {
  * ioevs[1].iv may contain a user ID or a reserved one (see CLOCKREQ).
  * ioevs[2].uiv may contain the current attachment MSC (if avaiable)
  *
- * For present-feed
+ * For rhint_vsignal and vblank-feedback:
+ * ioevs[3].uiv, ioevs[4].uiv is the lower, upper 32 bits of the time of the
+ * latest scanout (microseconds, CLOCK_MONOTONIC) or 0 if unknown.
+ * ioevs[5].uiv is the estimated refresh period in microseconds or 0.
  */
 	TARGET_COMMAND_STEPFRAME,
 
@@ -683,6 +686,10 @@ enum ARCAN_TARGET_COMMAND {
  * [1].iv    modifier_hi
  * [2].iv    modifier_lo
  * [3].iv    modifier_hint (1 : preferred)
+ * [4].uiv   format (fourcc), 0 if the modifier applies to any format
+ *
+ * When sent after a DEVICE_NODE for a card the metadata are the format and
+ * modifier pairs that the display planes can scan out directly.
  */
 	TARGET_COMMAND_DEVICESTATE,
 
@@ -719,6 +726,43 @@ enum ARCAN_TARGET_COMMAND {
  */
 	TARGET_COMMAND_ANCHORHINT,
 
+/*
+ * [DESCRIPTOR_PASSING]
+ * Output segments that have set SHMIF_RHINT_IMPORT_BUFFER in their page hints
+ * may get a frame delivered as a set of GPU buffer handles rather than through
+ * the vbuffer. This replaces the STEPFRAME for that frame, one event is sent
+ * per plane and the frame is complete when [1] reaches 0. The dimensions are
+ * those of the segment and the frame is released by clearing vready, same as
+ * for a vbuffer frame. Clear the hint to return to vbuffer delivery.
+ * ioev[0].iv = handle
+ * ioev[1].iv = planes left after this one
+ * ioev[2].uiv = stride (bytes)
+ * ioev[3].uiv = offset (bytes)
+ * ioev[4].uiv = format (fourcc)
+ * ioev[5].uiv = modifier (high 32 bits)
+ * ioev[6].uiv = modifier (low 32 bits)
+ * ioev[7].uiv = frame number, matches the STEPFRAME counter
+ */
+	TARGET_COMMAND_BUFFERSTREAM,
+
+/*
+ * [DESCRIPTOR_PASSING]
+ * Sent after a frame delivered through EXTERNAL_BUFFERSTREAM has been
+ * replaced, to clients that attach acquire fences to their buffers. The
+ * handle is a sync_file that signals when the server no longer reads from the
+ * buffers submitted before the most recent ones. Writing into such a buffer
+ * should wait for it. Without this event, implicit synchronization applies.
+ * This is managed by arcan_shmif_control and arcan_shmifext.
+ * ioev[0].iv = handle
+ * ioev[1].iv = number of most recent buffers that are not covered, a buffer
+ *              that is scanned out directly is only released one frame later
+ *
+ * Without a handle (ioev[0].iv is BADFD) it is the server being done reading
+ * from the memory passed with arcan_shmif_signal_shm, it is then delivered
+ * as a normal event.
+ */
+	TARGET_COMMAND_BUFFER_RELEASE,
+
 	TARGET_COMMAND_LIMIT = INT_MAX
 };
 
@@ -1014,7 +1058,8 @@ enum ARCAN_TARGET_SKIPMODE {
 		EVENT_VIDEO_DISPLAY_REMOVED,
 		EVENT_VIDEO_DISPLAY_CHANGED,
 		EVENT_VIDEO_ASYNCHIMAGE_LOADED,
-		EVENT_VIDEO_ASYNCHIMAGE_FAILED
+		EVENT_VIDEO_ASYNCHIMAGE_FAILED,
+		EVENT_VIDEO_RESAMPLE_COMPLETE
 	};
 
 	enum ARCAN_EVENT_SYSTEM {
@@ -1067,7 +1112,10 @@ enum ARCAN_TARGET_SKIPMODE {
 		EVENT_FSRV_LOSTVRLIMB,
 
 /* Nested, contains an arcan_ioevent from an external source */
-		EVENT_FSRV_IONESTED
+		EVENT_FSRV_IONESTED,
+
+/* Packed mesh (VOBJ) received and validated, ready for add_3dmesh */
+		EVENT_FSRV_MESH
 	};
 	/* -- end internal -- */
 
@@ -1390,8 +1438,13 @@ enum ARCAN_TARGET_SKIPMODE {
  *              sink the segment is primarily mapped to. This does not have to
  *              match any previous received OUTPUTHINT.
  *
- * The vblank dynamic clock act as a toggle, repeating the same CLOCKREQ would
- * disable the previous.
+ * If (dynamic) is set to 3, the segment asks for its frames to be presented
+ *              as soon as they are ready rather than on vblank, accepting
+ *              tearing. This only applies when the segment is mapped directly
+ *              to a sink that supports it and no STEPFRAMEs are emitted.
+ *
+ * The vblank and tearing dynamic clocks act as toggles, repeating the same
+ * CLOCKREQ would disable the previous.
  *
  * Being subscribed to a dynamic clock should be handled with care as it is
  * very easy to drag behing in your processing loop and saturate the inbound
@@ -1533,6 +1586,13 @@ enum ARCAN_TARGET_SKIPMODE {
  * (gpuid) - source GPU as provided by a previous devicehint
  * (width/height) - width/height of the buffer
  * (left) - if there are multiple planes to the same transfer
+ * (fence) - a sync_file follows the plane descriptor, signalled when the
+ *           buffer contents are complete (acquire fence)
+ * (color_space, color_range, chroma_siting) - YUV conversion metadata, see
+ *           shmifext_buffer_plane, only the first plane is considered
+ * (shm) - the descriptor is shared memory rather than a GPU buffer, the
+ *         pixels are at (offset) with (stride) bytes per row, format is the
+ *         DRM fourcc, see arcan_shmif_signal_shm
  */
 		struct {
 			uint32_t stride;
@@ -1544,6 +1604,11 @@ enum ARCAN_TARGET_SKIPMODE {
 			uint32_t width;
 			uint32_t height;
 			uint8_t left;
+			uint8_t fence;
+			uint8_t color_space;
+			uint8_t color_range;
+			uint8_t chroma_siting;
+			uint8_t shm;
 		} bstream;
 
 /*
@@ -1796,16 +1861,16 @@ struct arcan_evctx {
 	uint32_t state_fl;
 	int exit_code;
 	bool (*drain)(arcan_event*, int);
-	uint8_t eventbuf_sz;
+	uint16_t eventbuf_sz;
 
 	arcan_event* eventbuf;
 
-/* offsets into the eventbuf queue, parent will always % ARCAN_SHMPAGE_QUEUE_SZ
+/* offsets into the eventbuf queue, parent will always % eventbuf_sz
  * to prevent nasty surprises. these were set before we had access to _Atomic
  * in the standard fashion, and the codebase should be refactored to take that
  * into account */
-	volatile uint8_t* volatile front;
-	volatile uint8_t* volatile back;
+	volatile uint16_t* volatile front;
+	volatile uint16_t* volatile back;
 
 	int8_t local;
 
@@ -8,6 +8,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
 #include <inttypes.h>
 
 #include "arcan_shmif.h"
@@ -68,6 +71,349 @@ ssize_t arcan_shmif_eventunpack(
 	return sizeof(struct arcan_event) + 2;
 }
 
+/*
+ * Compact format, first byte is a format marker that doubles as version,
+ * second the event category, followed by a category specific body where
+ * integers are LEB128 varints (zigzag for signed), floats are 4b LE and
+ * fixed size strings / buffers are length-prefixed with the trailing zeros
+ * trimmed. Fields that are not used by the kind/datatype are not sent and
+ * come back zeroed on unpack. There is no checksum, transports using this
+ * (a12) already authenticate each packet.
+ */
+#define EVPACK_COMPACT_V1 0xa1
+
+struct evpk {
+	uint8_t* buf;
+	size_t sz;
+	size_t pos;
+	bool fail;
+};
+
+struct evupk {
+	const uint8_t* buf;
+	size_t sz;
+	size_t pos;
+	bool fail;
+};
+
+static void pk_u8(struct evpk* P, uint8_t v)
+{
+	if (P->pos >= P->sz){
+		P->fail = true;
+		return;
+	}
+	P->buf[P->pos++] = v;
+}
+
+static void pk_varint(struct evpk* P, uint64_t v)
+{
+	do {
+		uint8_t b = v & 0x7f;
+		v >>= 7;
+		pk_u8(P, b | (v ? 0x80 : 0));
+	} while (v);
+}
+
+static void pk_zigzag(struct evpk* P, int64_t v)
+{
+	pk_varint(P, ((uint64_t) v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static void pk_f32(struct evpk* P, float f)
+{
+	uint32_t v;
+	memcpy(&v, &f, sizeof(uint32_t));
+	for (size_t i = 0; i < 4; i++)
+		pk_u8(P, (v >> (i * 8)) & 0xff);
+}
+
+static void pk_trim(struct evpk* P, const void* src, size_t n)
+{
+	const uint8_t* in = src;
+	while (n && !in[n-1])
+		n--;
+
+	pk_varint(P, n);
+	if (P->fail || P->sz - P->pos < n){
+		P->fail = true;
+		return;
+	}
+
+	memcpy(&P->buf[P->pos], in, n);
+	P->pos += n;
+}
+
+static uint8_t upk_u8(struct evupk* U)
+{
+	if (U->pos >= U->sz){
+		U->fail = true;
+		return 0;
+	}
+	return U->buf[U->pos++];
+}
+
+static uint64_t upk_varint(struct evupk* U)
+{
+	uint64_t res = 0;
+	for (size_t shift = 0; shift < 64; shift += 7){
+		uint8_t b = upk_u8(U);
+		res |= (uint64_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return res;
+	}
+	U->fail = true;
+	return 0;
+}
+
+static int64_t upk_zigzag(struct evupk* U)
+{
+	uint64_t v = upk_varint(U);
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static float upk_f32(struct evupk* U)
+{
+	uint32_t v = 0;
+	for (size_t i = 0; i < 4; i++)
+		v |= (uint32_t) upk_u8(U) << (i * 8);
+
+	float f;
+	memcpy(&f, &v, sizeof(float));
+	return f;
+}
+
+static void upk_trim(struct evupk* U, void* dst, size_t n)
+{
+	uint64_t len = upk_varint(U);
+	if (U->fail || len > n || U->sz - U->pos < len){
+		U->fail = true;
+		return;
+	}
+
+	memcpy(dst, &U->buf[U->pos], len);
+	U->pos += len;
+}
+
+static void pack_io(struct evpk* P, const arcan_ioevent* io)
+{
+	pk_varint(P, io->kind);
+	pk_varint(P, io->devkind);
+	pk_varint(P, io->datatype);
+	pk_u8(P, io->flags);
+	pk_varint(P, io->devid);
+	pk_varint(P, io->subid);
+	pk_varint(P, io->dst);
+	pk_varint(P, io->pts);
+	pk_trim(P, io->label, sizeof(io->label));
+
+	switch (io->datatype){
+	case EVENT_IDATATYPE_DIGITAL:
+		pk_u8(P, io->input.digital.active);
+	break;
+	case EVENT_IDATATYPE_TRANSLATED:
+		pk_trim(P, io->input.translated.utf8, sizeof(io->input.translated.utf8));
+		pk_u8(P, io->input.translated.active);
+		pk_u8(P, io->input.translated.scancode);
+		pk_varint(P, io->input.translated.keysym);
+		pk_varint(P, io->input.translated.modifiers);
+	break;
+	case EVENT_IDATATYPE_ANALOG:{
+/* nvalues is advisory for some producers, so send up to the last set sample */
+		size_t n = 4;
+		while (n && !io->input.analog.axisval[n-1])
+			n--;
+		pk_zigzag(P, io->input.analog.gotrel);
+		pk_u8(P, io->input.analog.nvalues);
+		pk_u8(P, n);
+		for (size_t i = 0; i < n; i++)
+			pk_zigzag(P, io->input.analog.axisval[i]);
+	}
+	break;
+	case EVENT_IDATATYPE_TOUCH:
+		pk_u8(P, io->input.touch.active);
+		pk_zigzag(P, io->input.touch.x);
+		pk_zigzag(P, io->input.touch.y);
+		pk_f32(P, io->input.touch.pressure);
+		pk_f32(P, io->input.touch.size);
+		pk_varint(P, io->input.touch.tilt_x);
+		pk_varint(P, io->input.touch.tilt_y);
+		pk_u8(P, io->input.touch.tool);
+	break;
+	default:
+		pk_trim(P, &io->input, sizeof(io->input));
+	break;
+	}
+}
+
+static void unpack_io(struct evupk* U, arcan_ioevent* io)
+{
+	io->kind = upk_varint(U);
+	io->devkind = upk_varint(U);
+	io->datatype = upk_varint(U);
+	io->flags = upk_u8(U);
+	io->devid = upk_varint(U);
+	io->subid = upk_varint(U);
+	io->dst = upk_varint(U);
+	io->pts = upk_varint(U);
+	upk_trim(U, io->label, sizeof(io->label));
+
+	switch (io->datatype){
+	case EVENT_IDATATYPE_DIGITAL:
+		io->input.digital.active = upk_u8(U);
+	break;
+	case EVENT_IDATATYPE_TRANSLATED:
+		upk_trim(U, io->input.translated.utf8, sizeof(io->input.translated.utf8));
+		io->input.translated.active = upk_u8(U);
+		io->input.translated.scancode = upk_u8(U);
+		io->input.translated.keysym = upk_varint(U);
+		io->input.translated.modifiers = upk_varint(U);
+	break;
+	case EVENT_IDATATYPE_ANALOG:{
+		io->input.analog.gotrel = upk_zigzag(U);
+		io->input.analog.nvalues = upk_u8(U);
+		size_t n = upk_u8(U);
+		if (n > 4){
+			U->fail = true;
+			return;
+		}
+		for (size_t i = 0; i < n; i++)
+			io->input.analog.axisval[i] = upk_zigzag(U);
+	}
+	break;
+	case EVENT_IDATATYPE_TOUCH:
+		io->input.touch.active = upk_u8(U);
+		io->input.touch.x = upk_zigzag(U);
+		io->input.touch.y = upk_zigzag(U);
+		io->input.touch.pressure = upk_f32(U);
+		io->input.touch.size = upk_f32(U);
+		io->input.touch.tilt_x = upk_varint(U);
+		io->input.touch.tilt_y = upk_varint(U);
+		io->input.touch.tool = upk_u8(U);
+	break;
+	default:
+		upk_trim(U, &io->input, sizeof(io->input));
+	break;
+	}
+}
+
+static void pack_tgt(struct evpk* P, const arcan_tgtevent* tgt)
+{
+	size_t n = sizeof(tgt->ioevs) / sizeof(tgt->ioevs[0]);
+	while (n && !tgt->ioevs[n-1].uiv)
+		n--;
+
+	pk_varint(P, tgt->kind);
+	pk_u8(P, n);
+	for (size_t i = 0; i < n; i++)
+		pk_varint(P, tgt->ioevs[i].uiv);
+	pk_zigzag(P, tgt->code);
+
+/* covers both message and timestamp */
+	pk_trim(P, tgt->bmessage, sizeof(tgt->bmessage));
+}
+
+static void unpack_tgt(struct evupk* U, arcan_tgtevent* tgt)
+{
+	tgt->kind = upk_varint(U);
+	size_t n = upk_u8(U);
+	if (n > sizeof(tgt->ioevs) / sizeof(tgt->ioevs[0])){
+		U->fail = true;
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++)
+		tgt->ioevs[i].uiv = upk_varint(U);
+	tgt->code = upk_zigzag(U);
+	upk_trim(U, tgt->bmessage, sizeof(tgt->bmessage));
+}
+
+static const size_t ext_body_ofs = offsetof(arcan_extevent, message);
+static const size_t ext_body_sz =
+	offsetof(arcan_extevent, frame_id) - offsetof(arcan_extevent, message);
+
+static void pack_ext(struct evpk* P, const arcan_extevent* ext)
+{
+	pk_varint(P, ext->kind);
+	pk_zigzag(P, ext->source);
+	pk_varint(P, ext->frame_id);
+
+/* the multipart flag sits after the string so it would defeat trimming */
+	if (ext->kind == EVENT_EXTERNAL_MESSAGE || ext->kind == EVENT_EXTERNAL_IDENT){
+		pk_trim(P, ext->message.data, sizeof(ext->message.data));
+		pk_u8(P, ext->message.multipart);
+	}
+	else
+		pk_trim(P, (const uint8_t*) ext + ext_body_ofs, ext_body_sz);
+}
+
+static void unpack_ext(struct evupk* U, arcan_extevent* ext)
+{
+	ext->kind = upk_varint(U);
+	ext->source = upk_zigzag(U);
+	ext->frame_id = upk_varint(U);
+
+	if (ext->kind == EVENT_EXTERNAL_MESSAGE || ext->kind == EVENT_EXTERNAL_IDENT){
+		upk_trim(U, ext->message.data, sizeof(ext->message.data));
+		ext->message.multipart = upk_u8(U);
+	}
+	else
+		upk_trim(U, (uint8_t*) ext + ext_body_ofs, ext_body_sz);
+}
+
+ssize_t arcan_shmif_eventpack_compact(
+	const struct arcan_event* const aev, uint8_t* dbuf, size_t dbuf_sz)
+{
+	struct evpk P = {.buf = dbuf, .sz = dbuf_sz};
+	pk_u8(&P, EVPACK_COMPACT_V1);
+	pk_u8(&P, aev->category);
+
+	switch (aev->category){
+	case EVENT_IO:
+		pack_io(&P, &aev->io);
+	break;
+	case EVENT_TARGET:
+		pack_tgt(&P, &aev->tgt);
+	break;
+	case EVENT_EXTERNAL:
+		pack_ext(&P, &aev->ext);
+	break;
+
+/* rare over the wire, just send the used part of the union */
+	default:
+		pk_trim(&P, aev, offsetof(struct arcan_event, category));
+	break;
+	}
+
+	return P.fail ? -1 : (ssize_t) P.pos;
+}
+
+ssize_t arcan_shmif_eventunpack_compact(
+	const uint8_t* const buf, size_t buf_sz, struct arcan_event* out)
+{
+	struct evupk U = {.buf = buf, .sz = buf_sz};
+	if (upk_u8(&U) != EVPACK_COMPACT_V1)
+		return -1;
+
+	*out = (struct arcan_event){.category = upk_u8(&U)};
+
+	switch (out->category){
+	case EVENT_IO:
+		unpack_io(&U, &out->io);
+	break;
+	case EVENT_TARGET:
+		unpack_tgt(&U, &out->tgt);
+	break;
+	case EVENT_EXTERNAL:
+		unpack_ext(&U, &out->ext);
+	break;
+	default:
+		upk_trim(&U, out, offsetof(struct arcan_event, category));
+	break;
+	}
+
+	return U.fail ? -1 : (ssize_t) U.pos;
+}
+
 const char* arcan_shmif_eventstr(arcan_event* aev, char* dbuf, size_t dsz)
 {
 	static char evbuf[256];
@@ -102,14 +448,15 @@ const char* arcan_shmif_eventstr(arcan_event* aev, char* dbuf, size_t dsz)
 		break;
 		case EVENT_EXTERNAL_BUFFERSTREAM:
 			snprintf(work, dsz,"EXT:BUFFERSTREAM(%zu, w*h: %zu*%zu, fmt: %d, "
-				"stride: %zu, offset: %zu, mod(lo,hi): %"PRIu32",%"PRIu32")",
+				"stride: %zu, offset: %zu, mod(lo,hi): %"PRIu32",%"PRIu32", fence: %d)",
 				(size_t)ev.ext.bstream.left,
 				(size_t)ev.ext.bstream.width, (size_t)ev.ext.bstream.height,
 				(int)ev.ext.bstream.format,
 				(size_t)ev.ext.bstream.stride,
 				(size_t)ev.ext.bstream.offset,
 				(uint32_t)ev.ext.bstream.mod_lo,
-				(uint32_t)ev.ext.bstream.mod_hi
+				(uint32_t)ev.ext.bstream.mod_hi,
+				(int)ev.ext.bstream.fence
 			);
 		break;
 		case EVENT_EXTERNAL_FRAMESTATUS:
@@ -368,6 +715,16 @@ const char* arcan_shmif_eventstr(arcan_event* aev, char* dbuf, size_t dsz)
 		case TARGET_COMMAND_ACTIVATE:
 			snprintf(work, dsz,"TGT:ACTIVATE()");
 		break;
+		case TARGET_COMMAND_BUFFERSTREAM:
+			snprintf(work, dsz,"TGT:BUFFERSTREAM("
+				"fd: %d, left: %d, stride: %u, offset: %u, fmt: %u, frame: %u)",
+				ev.tgt.ioevs[0].iv, ev.tgt.ioevs[1].iv, ev.tgt.ioevs[2].uiv,
+				ev.tgt.ioevs[3].uiv, ev.tgt.ioevs[4].uiv, ev.tgt.ioevs[7].uiv
+			);
+		break;
+		case TARGET_COMMAND_BUFFER_RELEASE:
+			snprintf(work, dsz,"TGT:BUFFER_RELEASE(fd: %d)", ev.tgt.ioevs[0].iv);
+		break;
 		default:
 			snprintf(work, dsz,"TGT:UNKNOWN(!)");
 		break;
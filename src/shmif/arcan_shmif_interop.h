@@ -41,7 +41,7 @@
  * during _integrity_check
  */
 #define ASHMIF_VERSION_MAJOR 0
-#define ASHMIF_VERSION_MINOR 16
+#define ASHMIF_VERSION_MINOR 27
 
 #ifndef LOG
 #define LOG(X, ...) (fprintf(stderr, "[%lld]" X, arcan_timemillis(), ## __VA_ARGS__))
@@ -69,6 +69,8 @@ file_handle arcan_fetchhandle(int insock, bool block);
 bool arcan_pushhandle(int fd, int channel);
 int arcan_sem_wait(sem_handle sem);
 int arcan_sem_trywait(sem_handle sem);
+int arcan_sem_close(sem_handle sem);
+sem_handle arcan_sem_bind(sem_handle sem, _Atomic uint32_t* words);
 int arcan_fdscan(int** listout);
 #endif
 
@@ -95,6 +97,17 @@ int arcan_shmif_poll(struct arcan_shmif_cont*, struct arcan_event* dst);
  */
 int arcan_shmif_wait(struct arcan_shmif_cont*, struct arcan_event* dst);
 
+/*
+ * _poll_batch repeats _poll until [lim] events have been stored in [dst],
+ * the queue is empty or an event carrying a descriptor has been returned
+ * (as the descriptor is only valid until the next _poll/_wait call).
+ *
+ * returns the number of events stored in [dst], or a negative value when
+ * the shmif_cont is unable to process events and nothing was stored.
+ */
+ssize_t arcan_shmif_poll_batch(
+	struct arcan_shmif_cont*, struct arcan_event* dst, size_t lim);
+
 /*
  * Wait for an incoming event for a maximum of ~time_ms, and update it with
  * the amount of milliseconds left (if any) on the timer.
@@ -200,6 +213,28 @@ int arcan_shmif_enqueue(
 int arcan_shmif_tryenqueue(
 	struct arcan_shmif_cont*, const struct arcan_event* const);
 
+/*
+ * Enqueue [n] events with a single update of the queue index for as many as
+ * currently fit. With [try] set, return as soon as the queue is full, otherwise
+ * block until all events have been enqueued or the context dies.
+ *
+ * returns the number of events enqueued, or a negative value on failure.
+ * Same threading constraints as arcan_shmif_enqueue.
+ */
+ssize_t arcan_shmif_enqueue_batch(struct arcan_shmif_cont*,
+	const struct arcan_event* const, size_t n, bool try);
+
+/*
+ * Vectored enqueue, waits until there is room for all [n] events (or the
+ * entire queue if [n] is larger than that), copies them and publishes the
+ * new queue index once, so the parent sees the set as a whole.
+ *
+ * returns the number of events enqueued, or a negative value on failure.
+ * Same threading constraints as arcan_shmif_enqueue.
+ */
+int arcan_shmif_enqueue_v(struct arcan_shmif_cont*,
+	const struct arcan_event* const, size_t n);
+
 /*
  * Provide a text representation useful for logging, tracing and debugging
  * purposes. If dbuf is NULL, a static buffer will be used (so for
@@ -223,6 +258,20 @@ ssize_t arcan_shmif_eventpack(
 ssize_t arcan_shmif_eventunpack(
 	const uint8_t* const buf, size_t buf_sz, struct arcan_event* out);
 
+/*
+ * Variable length version of eventpack / eventunpack. Fields are encoded per
+ * category (varints, trimmed strings) with explicit byte order, so the output
+ * is independent of struct layout and typically a fraction of the fixed size
+ * format. Fields outside of what the kind/datatype uses are not preserved.
+ * The two formats are not interchangeable, the compact one is identified by
+ * its first byte and unpack returns -1 on anything it does not recognise.
+ */
+ssize_t arcan_shmif_eventpack_compact(
+	const struct arcan_event* const aev, uint8_t* dbuf, size_t dbuf_sz);
+
+ssize_t arcan_shmif_eventunpack_compact(
+	const uint8_t* const buf, size_t buf_sz, struct arcan_event* out);
+
 /*
  * Resolve implementation- defined connection connection path based on a
  * suggested key. Returns -num if the resolved path couldn't fit in dsz (with
@@ -394,6 +443,9 @@ pid_t arcan_shmif_handover_exec_pipe(
  * context is dead / broken. You are still required to use shmif_signal calls
  * to synchronize the contents. Only the set of damaged regions will grow.
  *
+ * Each call is also recorded as a separate region (see dirty in _cont) so that
+ * disjoint updates within one frame can be synched without their bounding box.
+ *
  * [ Not yet implemented ]
  * This interface combines a number of latency and performance sensitive
  * usecases, with the ideal should re-add the possibility of run-ahead or
@@ -463,7 +515,9 @@ int arcan_shmif_deadline(
  * Asynchronously transfer the contents of [fdin] to [fdout]. This is
  * mainly to encourage non-blocking implementation of the bchunk handler.
  * The descriptors will be closed when the transfer is completed or if
- * it fails.
+ * it fails. Where supported, file to file transfers use copy_file_range,
+ * anything with a pipe on either end splice and other files sendfile, so
+ * the data doesn't pass through userspace.
  *
  * If [sigfd] is provided (> 0),
  * the result of the operation will be written on finish as:
@@ -476,7 +530,8 @@ int arcan_shmif_deadline(
  *
  * SHMIF_BGCOPY_KEEPIN,   (won't close fdin on completion)
  * SHMIF_BGCOPY_KEEPOUT,  (won't close fdout on completion)
- * SHMIF_BGCOPY_PROGRESS, (ascii: status:current:total\n into sigfd)
+ * SHMIF_BGCOPY_PROGRESS, (ascii: status:current:total\n into sigfd, at
+ *                         most every 10MB or once a second)
  *
  * If progress is set and [sigfd] is set, write-fails on buffer overflow
  * will spin for the completion byte.
@@ -539,6 +594,28 @@ bool arcan_shmif_pushutf8(
 	struct arcan_shmif_cont*, struct arcan_event* baseev,
 	const char* msg, size_t msg_sz);
 
+/*
+ * YUV conversion metadata for accelerated buffers (shmifext_buffer_plane and
+ * the bstream event), outside of the helper block as the server side needs
+ * them too.
+ */
+enum shmifext_color_space {
+	SHMIFEXT_CS_DEFAULT = 0,
+	SHMIFEXT_CS_BT601   = 1,
+	SHMIFEXT_CS_BT709   = 2,
+	SHMIFEXT_CS_BT2020  = 3
+};
+
+enum shmifext_color_range {
+	SHMIFEXT_RANGE_DEFAULT = 0,
+	SHMIFEXT_RANGE_FULL    = 1,
+	SHMIFEXT_RANGE_NARROW  = 2
+};
+
+/* chroma_siting bits, unset means co-sited with the first luma sample */
+#define SHMIFEXT_SITING_H_HALF 1
+#define SHMIFEXT_SITING_V_HALF 2
+
 /*
  * Part of auxiliary library, pulls in more dependencies and boiler-plate
  * for setting up accelerated graphics
@@ -773,6 +850,12 @@ struct agp_fenv* arcan_shmifext_getfenv(struct arcan_shmif_cont*);
  * If [dst_store] is set, the default buffer of the context will not be used
  * as the target store. Instead, [dst_store] will be updated to contain the
  * imported buffer.
+ *
+ * Multi-planar formats (NV12, P010, YUV420, ...) use one plane entry per
+ * plane, all sharing the same format and w/h of the full image, with the
+ * modifier for each plane set explicitly. For YUV formats the color_space,
+ * color_range and chroma_siting fields of the first plane describe how the
+ * sampler should convert, 0 leaves it to the driver default.
  */
 struct shmifext_buffer_plane {
 	int fd;
@@ -787,6 +870,9 @@ struct shmifext_buffer_plane {
 			uint64_t offset;
 			uint32_t mod_hi;
 			uint32_t mod_lo;
+			uint8_t color_space;
+			uint8_t color_range;
+			uint8_t chroma_siting;
 		} gbm;
 	};
 };
@@ -6,6 +6,10 @@
 #include <sys/wait.h>
 #include <pthread.h>
 #include <signal.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 /*
  * This is needed in order to re-use some of the platform layer functions that
@@ -50,6 +54,16 @@ struct shmifsrv_client {
 	pid_t pid;
 	size_t errors;
 	uint64_t cookie;
+
+/* only used while the client is tracked by a reactor */
+	struct {
+		struct shmifsrv_reactor* owner;
+		size_t ind;
+		void* tag;
+		int fd;
+		bool input;
+		bool io, hup, notified;
+	} rc;
 };
 
 static struct shmifsrv_client* alloc_client()
@@ -240,9 +254,10 @@ size_t shmifsrv_dequeue_events(
 
 	if (shmifsrv_enter(cl)){
 		size_t count = 0;
-		uint8_t front = cl->con->shm.ptr->parentevq.front;
-		uint8_t back = cl->con->shm.ptr->parentevq.back;
-		if (front > PP_QUEUE_SZ || back > PP_QUEUE_SZ){
+		size_t qsz = cl->con->inqueue.eventbuf_sz;
+		uint16_t front = cl->con->shm.ptr->parentevq.front;
+		uint16_t back = cl->con->shm.ptr->parentevq.back;
+		if (front >= qsz || back >= qsz){
 			cl->errors++;
 			shmifsrv_leave();
 			return 0;
@@ -250,7 +265,7 @@ size_t shmifsrv_dequeue_events(
 
 		while (count < limit && front != back){
 			newev[count++] = cl->con->shm.ptr->parentevq.evqueue[front];
-			front = (front + 1) % PP_QUEUE_SZ;
+			front = (front + 1) % qsz;
 		}
 		asm volatile("": : :"memory");
 		__sync_synchronize();
@@ -309,6 +324,15 @@ bool shmifsrv_enqueue_event(
 		return platform_fsrv_pushevent(cl->con, ev) == ARCAN_OK;
 }
 
+size_t shmifsrv_enqueue_events(
+	struct shmifsrv_client* cl, struct arcan_event* ev, size_t n)
+{
+	if (!cl || cl->status < READY || !ev)
+		return 0;
+
+	return platform_fsrv_pushevents(cl->con, ev, n);
+}
+
 int shmifsrv_poll(struct shmifsrv_client* cl)
 {
 	if (!cl || cl->status <= BROKEN){
@@ -353,7 +377,9 @@ int shmifsrv_poll(struct shmifsrv_client* cl)
 				return CLIENT_NOT_READY;
 			}
 			int a = !!(atomic_load(&cl->con->shm.ptr->aready));
-			int v = !!(atomic_load(&cl->con->shm.ptr->vready));
+			int v = cl->con->vswap ?
+				platform_fsrv_vslot_pick(cl->con, arcan_timemillis()) != -1 :
+				!!(atomic_load(&cl->con->shm.ptr->vready));
 			shmifsrv_leave();
 			if (a || v)
 				return
@@ -389,6 +415,28 @@ static void* nanny_thread(void* arg)
 	return NULL;
 }
 
+/* the same nanny-kill thread approach as used in platform-posix-frameserver */
+static void spawn_nanny(pid_t pid)
+{
+	pid_t* pidptr = malloc(sizeof(pid_t));
+	if (!pidptr){
+		kill(pid, SIGKILL);
+		return;
+	}
+
+	pthread_attr_t nanny_attr;
+	pthread_attr_init(&nanny_attr);
+	pthread_attr_setdetachstate(&nanny_attr, PTHREAD_CREATE_DETACHED);
+	*pidptr = pid;
+
+	pthread_t nanny;
+	if (0 != pthread_create(&nanny, &nanny_attr, nanny_thread, (void*) pidptr)){
+		kill(pid, SIGKILL);
+		free(pidptr);
+	}
+	pthread_attr_destroy(&nanny_attr);
+}
+
 void shmifsrv_free(struct shmifsrv_client* cl, int mode)
 {
 	if (!cl)
@@ -408,19 +456,8 @@ void shmifsrv_free(struct shmifsrv_client* cl, int mode)
 	break;
 	}
 
-/* the same nanny-kill thread approach as used in platform-posix-frameserver */
-	if (cl->pid){
-		pid_t* pidptr = malloc(sizeof(pid_t));
-		pthread_attr_t nanny_attr;
-		pthread_attr_init(&nanny_attr);
-		pthread_attr_setdetachstate(&nanny_attr, PTHREAD_CREATE_DETACHED);
-		*pidptr = cl->pid;
-
-		pthread_t nanny;
-		if (0 != pthread_create(&nanny, &nanny_attr, nanny_thread, (void*) pidptr))
-			kill(cl->pid, SIGKILL);
-		pthread_attr_destroy(&nanny_attr);
-	}
+	if (cl->pid)
+		spawn_nanny(cl->pid);
 
 	cl->status = DEAD;
 	free(cl);
@@ -452,7 +489,10 @@ void shmifsrv_client_protomask(struct shmifsrv_client* cl, unsigned mask)
 void shmifsrv_video_step(struct shmifsrv_client* cl)
 {
 /* signal that we're done with the buffer */
-	atomic_store_explicit(&cl->con->shm.ptr->vready, 0, memory_order_release);
+	if (cl->con->vswap)
+		platform_fsrv_vslot_release(cl->con);
+	else
+		atomic_store_explicit(&cl->con->shm.ptr->vready, 0, memory_order_release);
 	arcan_sem_post(cl->con->vsync);
 
 /* If the frameserver has indicated that it wants a frame callback every time
@@ -502,12 +542,38 @@ struct shmifsrv_vbuffer shmifsrv_video(struct shmifsrv_client* cl)
 		&cl->con->shm.ptr->vready, memory_order_consume);
 	vready = (vready <= 0 || vready > cl->con->vbuf_cnt) ? 0 : vready - 1;
 
+/* with explicit slots, take ownership of the one to present - if the client
+ * reclaimed it in the meanwhile, fall back to the last signalled one */
+	if (cl->con->vswap){
+		int slot = platform_fsrv_vslot_acquire(cl->con, arcan_timemillis());
+		if (slot != -1){
+			vready = slot;
+			res.vpts = atomic_load(&cl->con->shm.ptr->vslot_pts[slot]);
+		}
+	}
+
 	int vmask = ~atomic_load_explicit(
 		&cl->con->shm.ptr->vpending, memory_order_consume);
 
 	res.buffer = cl->con->vbufs[vready];
 	res.region = atomic_load(&cl->con->shm.ptr->dirty);
 
+/* the damage chain is only trusted if it fits within the bounding region */
+	size_t n_regions = atomic_load(&cl->con->shm.ptr->dirty_chain_n);
+	if (res.flags.subregion && n_regions > 1 && n_regions <= ARCAN_SHMIF_DIRTY_LIM){
+		res.n_regions = n_regions;
+		for (size_t i = 0; i < n_regions; i++){
+			struct arcan_shmif_region r = cl->con->shm.ptr->dirty_chain[i];
+			if (r.x2 <= r.x1 || r.y2 <= r.y1 ||
+				r.x1 < res.region.x1 || r.x2 > res.region.x2 ||
+				r.y1 < res.region.y1 || r.y2 > res.region.y2){
+				res.n_regions = 0;
+				break;
+			}
+			res.regions[i] = r;
+		}
+	}
+
 /* if we have negotiated compressed passthrough, set res.flags, copy /verify
  * framesize - if that fails, we need to propagate the bufferfail so the client
  * produces a new uncompressed one */
@@ -539,9 +605,13 @@ bool shmifsrv_process_event(struct shmifsrv_client* cl, struct arcan_event* ev)
 				.tgt.kind = TARGET_COMMAND_BUFFER_FAIL
 			}, -1);
 
-	/* just fetch and wipe */
+	/* just fetch and wipe, the acquire fence (if any) follows the plane */
 			int handle = arcan_fetchhandle(cl->con->dpipe, false);
 			close(handle);
+			if (ev->ext.bstream.fence){
+				handle = arcan_fetchhandle(cl->con->dpipe, false);
+				close(handle);
+			}
 
 			return true;
 		break;
@@ -650,7 +720,7 @@ int shmifsrv_monotonic_tick(int* left)
 	int64_t base = c_ticks * ARCAN_TIMER_TICK;
 	int64_t delta = frametime - base;
 
-	if (delta > ARCAN_TIMER_TICK){
+	if (delta >= ARCAN_TIMER_TICK){
 		n_ticks = delta / ARCAN_TIMER_TICK;
 
 /* safeguard against stalls or clock issues */
@@ -660,6 +730,7 @@ int shmifsrv_monotonic_tick(int* left)
 		}
 
 		c_ticks += n_ticks;
+		delta -= n_ticks * ARCAN_TIMER_TICK;
 	}
 
 	if (left)
@@ -674,6 +745,410 @@ void shmifsrv_monotonic_rebase()
 	c_ticks = 0;
 }
 
+/*
+ * Reactor for serving many clients from one thread. The sockets go into one
+ * epoll set (poll where that is missing) which covers accept, authentication
+ * and hangup. The futex / semaphore doorbells of the shared page can't be
+ * multiplexed that way, so the page state of every ready client is swept once
+ * per run instead, which is a handful of atomic loads per client.
+ */
+#define REACTOR_BATCH 64
+#define REACTOR_REAP_MS 10000
+
+struct reactor_reap {
+	pid_t pid;
+	int64_t deadline;
+};
+
+struct shmifsrv_reactor {
+	struct shmifsrv_reactor_cb cb;
+	int epfd;
+
+	struct shmifsrv_client** clients;
+	size_t n_clients, sz_clients;
+
+/* client currently in a callback, cleared if the callback frees it */
+	struct shmifsrv_client* current;
+
+	struct reactor_reap* reap;
+	size_t n_reap, sz_reap;
+
+	struct pollfd* pset;
+	size_t sz_pset;
+};
+
+struct shmifsrv_reactor* shmifsrv_reactor_create(struct shmifsrv_reactor_cb cb)
+{
+	struct shmifsrv_reactor* res = malloc(sizeof(struct shmifsrv_reactor));
+	if (!res)
+		return NULL;
+
+	*res = (struct shmifsrv_reactor){.cb = cb, .epfd = -1};
+
+#ifdef __linux__
+	res->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (-1 == res->epfd){
+		free(res);
+		return NULL;
+	}
+#endif
+
+	return res;
+}
+
+/* listening and authenticating sockets need input, ready ones are only
+ * watched for hangup as the event queue lives in the shared page */
+static void reactor_watch(struct shmifsrv_reactor* r, struct shmifsrv_client* cl)
+{
+	int fd = shmifsrv_client_handle(cl);
+	bool input = cl->status > BROKEN && cl->status < READY;
+
+	if (fd == cl->rc.fd && input == cl->rc.input)
+		return;
+
+#ifdef __linux__
+	if (-1 != cl->rc.fd)
+		epoll_ctl(r->epfd, EPOLL_CTL_DEL, cl->rc.fd, NULL);
+
+	if (-1 != fd){
+		struct epoll_event ev = {
+			.events = input ? EPOLLIN : 0,
+			.data.ptr = cl
+		};
+		if (-1 == epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev))
+			fd = -1;
+	}
+#endif
+
+	cl->rc.fd = fd;
+	cl->rc.input = input;
+}
+
+bool shmifsrv_reactor_add(
+	struct shmifsrv_reactor* r, struct shmifsrv_client* cl, void* tag)
+{
+	if (!r || !cl || cl->rc.owner)
+		return false;
+
+	if (r->n_clients == r->sz_clients){
+		size_t nsz = r->sz_clients ? r->sz_clients * 2 : 16;
+		struct shmifsrv_client** nc =
+			realloc(r->clients, nsz * sizeof(struct shmifsrv_client*));
+		if (!nc)
+			return false;
+		r->clients = nc;
+		r->sz_clients = nsz;
+	}
+
+	cl->rc.owner = r;
+	cl->rc.tag = tag;
+	cl->rc.ind = r->n_clients;
+	cl->rc.fd = -1;
+	cl->rc.input = false;
+	cl->rc.io = cl->rc.hup = cl->rc.notified = false;
+	r->clients[r->n_clients++] = cl;
+
+/* treat as readable on the first run so an already pending connection or
+ * authentication step isn't lost waiting for an edge */
+	cl->rc.io = true;
+	reactor_watch(r, cl);
+
+	return true;
+}
+
+void shmifsrv_reactor_remove(struct shmifsrv_reactor* r, struct shmifsrv_client* cl)
+{
+	if (!r || !cl || cl->rc.owner != r)
+		return;
+
+#ifdef __linux__
+	if (-1 != cl->rc.fd)
+		epoll_ctl(r->epfd, EPOLL_CTL_DEL, cl->rc.fd, NULL);
+#endif
+	cl->rc.fd = -1;
+
+/* swap with the last, the sweep in _run accounts for this */
+	size_t ind = cl->rc.ind;
+	r->clients[ind] = r->clients[--r->n_clients];
+	r->clients[ind]->rc.ind = ind;
+	cl->rc.owner = NULL;
+
+	if (r->current == cl)
+		r->current = NULL;
+}
+
+void shmifsrv_reactor_free(
+	struct shmifsrv_reactor* r, struct shmifsrv_client* cl, int mode)
+{
+	if (!cl)
+		return;
+
+	shmifsrv_reactor_remove(r, cl);
+
+/* take over reaping so there is no nanny thread per client */
+	if (r && cl->pid){
+		if (r->n_reap == r->sz_reap){
+			size_t nsz = r->sz_reap ? r->sz_reap * 2 : 16;
+			struct reactor_reap* nr = realloc(r->reap, nsz * sizeof(struct reactor_reap));
+			if (nr){
+				r->reap = nr;
+				r->sz_reap = nsz;
+			}
+		}
+
+		if (r->n_reap < r->sz_reap){
+			r->reap[r->n_reap++] = (struct reactor_reap){
+				.pid = cl->pid,
+				.deadline = arcan_timemillis() + REACTOR_REAP_MS
+			};
+			cl->pid = 0;
+		}
+	}
+
+	shmifsrv_free(cl, mode);
+}
+
+static void reactor_reap(struct shmifsrv_reactor* r)
+{
+	int64_t now = r->n_reap ? arcan_timemillis() : 0;
+
+	for (size_t i = 0; i < r->n_reap;){
+		int statusfl;
+		if (waitpid(r->reap[i].pid, &statusfl, WNOHANG) != 0){
+			r->reap[i] = r->reap[--r->n_reap];
+			continue;
+		}
+
+/* keep it in the set and collect on the next run */
+		if (now > r->reap[i].deadline){
+			kill(r->reap[i].pid, SIGKILL);
+			r->reap[i].deadline = INT64_MAX;
+		}
+		i++;
+	}
+}
+
+static void reactor_wait(struct shmifsrv_reactor* r, int timeout)
+{
+#ifdef __linux__
+	struct epoll_event evs[REACTOR_BATCH];
+	int nev = epoll_wait(r->epfd, evs, REACTOR_BATCH, timeout);
+
+	for (int i = 0; i < nev; i++){
+		struct shmifsrv_client* cl = evs[i].data.ptr;
+		if (evs[i].events & EPOLLIN)
+			cl->rc.io = true;
+		if (evs[i].events & (EPOLLHUP | EPOLLERR))
+			cl->rc.hup = true;
+	}
+
+#else
+	if (r->sz_pset < r->n_clients){
+		struct pollfd* np = realloc(r->pset, r->n_clients * sizeof(struct pollfd));
+		if (!np)
+			return;
+		r->pset = np;
+		r->sz_pset = r->n_clients;
+	}
+
+	for (size_t i = 0; i < r->n_clients; i++){
+		struct shmifsrv_client* cl = r->clients[i];
+		r->pset[i] = (struct pollfd){
+			.fd = cl->rc.fd,
+			.events = cl->rc.input ? POLLIN : 0
+		};
+	}
+
+	if (poll(r->pset, r->n_clients, timeout) <= 0)
+		return;
+
+	for (size_t i = 0; i < r->n_clients; i++){
+		if (r->pset[i].revents & POLLIN)
+			r->clients[i]->rc.io = true;
+		if (r->pset[i].revents & (POLLHUP | POLLERR | POLLNVAL))
+			r->clients[i]->rc.hup = true;
+	}
+#endif
+}
+
+static bool reactor_dead(struct shmifsrv_reactor* r, struct shmifsrv_client* cl)
+{
+	cl->rc.notified = true;
+
+/* hangup is level triggered, don't keep waking up until the client is freed */
+#ifdef __linux__
+	if (-1 != cl->rc.fd)
+		epoll_ctl(r->epfd, EPOLL_CTL_DEL, cl->rc.fd, NULL);
+#endif
+	cl->rc.fd = -1;
+
+	if (r->cb.dead)
+		r->cb.dead(cl, cl->rc.tag);
+	else
+		shmifsrv_reactor_free(r, cl, SHMIFSRV_FREE_FULL);
+
+	return true;
+}
+
+/* drain a signalled buffer nobody asked for so the client isn't left waiting */
+static void reactor_drop_video(struct shmifsrv_client* cl)
+{
+	if (shmifsrv_enter(cl)){
+		shmifsrv_video_step(cl);
+		shmifsrv_leave();
+	}
+}
+
+static void reactor_drop_audio(struct shmifsrv_client* cl)
+{
+	if (shmifsrv_enter(cl)){
+		shmifsrv_audio(cl, NULL, NULL);
+		shmifsrv_leave();
+	}
+}
+
+static bool reactor_step(
+	struct shmifsrv_reactor* r, struct shmifsrv_client* cl, int ticks)
+{
+	if (cl->rc.notified)
+		return false;
+
+	if (cl->rc.hup)
+		cl->status = BROKEN;
+
+/* accept and authentication both go through _poll, only when the socket
+ * says there is something to do */
+	if (cl->status > BROKEN && cl->status < READY){
+		if (!cl->rc.io)
+			return false;
+
+		cl->rc.io = false;
+		if (CLIENT_DEAD == shmifsrv_poll(cl))
+			return reactor_dead(r, cl);
+
+		reactor_watch(r, cl);
+		if (cl->status != READY)
+			return false;
+
+		if (r->cb.ready){
+			r->current = cl;
+			r->cb.ready(cl, cl->rc.tag);
+			if (r->current != cl)
+				return true;
+		}
+	}
+
+	if (cl->status <= BROKEN)
+		return reactor_dead(r, cl);
+
+	bool work = false;
+	while (ticks-- > 0)
+		shmifsrv_tick(cl);
+
+/* the internal events are handled here, the rest forwarded as one batch */
+	struct arcan_event evs[REACTOR_BATCH];
+	size_t nev = shmifsrv_dequeue_events(cl, evs, REACTOR_BATCH);
+	size_t nfwd = 0;
+
+	for (size_t i = 0; i < nev; i++)
+		if (!shmifsrv_process_event(cl, &evs[i]))
+			evs[nfwd++] = evs[i];
+
+	r->current = cl;
+	if (nfwd && r->cb.event){
+		work = true;
+		r->cb.event(cl, evs, nfwd, cl->rc.tag);
+		if (r->current != cl)
+			return true;
+	}
+
+	int pv = shmifsrv_poll(cl);
+	if (CLIENT_DEAD == pv || cl->status <= BROKEN)
+		return reactor_dead(r, cl);
+
+	if (pv & CLIENT_VBUFFER_READY){
+		work = true;
+		if (r->cb.video){
+			r->cb.video(cl, cl->rc.tag);
+			if (r->current != cl)
+				return true;
+		}
+		else
+			reactor_drop_video(cl);
+	}
+
+	if (pv & CLIENT_ABUFFER_READY){
+		work = true;
+		if (r->cb.audio){
+			r->cb.audio(cl, cl->rc.tag);
+			if (r->current != cl)
+				return true;
+		}
+		else
+			reactor_drop_audio(cl);
+	}
+
+	r->current = NULL;
+	return work;
+}
+
+size_t shmifsrv_reactor_run(struct shmifsrv_reactor* r, int timeout)
+{
+	if (!r)
+		return 0;
+
+/* wake up for the next tick even if no socket does anything */
+	int left;
+	int ticks = shmifsrv_monotonic_tick(&left);
+	if (left < 0)
+		left = 0;
+	if (timeout < 0 || timeout > left)
+		timeout = left;
+
+	reactor_wait(r, timeout);
+
+	size_t count = 0;
+	for (size_t i = 0; i < r->n_clients;){
+		struct shmifsrv_client* cl = r->clients[i];
+		if (reactor_step(r, cl, ticks))
+			count++;
+
+/* the callback may have removed this or another client, the ones swapped
+ * into already visited slots are picked up on the next run */
+		if (i < r->n_clients && r->clients[i] == cl)
+			i++;
+	}
+
+	reactor_reap(r);
+	return count;
+}
+
+size_t shmifsrv_reactor_clients(struct shmifsrv_reactor* r)
+{
+	return r ? r->n_clients : 0;
+}
+
+void shmifsrv_reactor_destroy(struct shmifsrv_reactor* r)
+{
+	if (!r)
+		return;
+
+	while (r->n_clients)
+		shmifsrv_reactor_remove(r, r->clients[0]);
+
+/* whatever is left to reap goes back to the per-pid nanny */
+	for (size_t i = 0; i < r->n_reap; i++)
+		spawn_nanny(r->reap[i].pid);
+
+	if (-1 != r->epfd)
+		close(r->epfd);
+
+	free(r->clients);
+	free(r->reap);
+	free(r->pset);
+	free(r);
+}
+
 #include "../frameserver/util/utf8.c"
 bool shmifsrv_enqueue_multipart_message(struct shmifsrv_client* acon,
 	struct arcan_event* base, const char* msg, size_t len)
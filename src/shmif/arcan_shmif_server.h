@@ -218,6 +218,14 @@ void shmifsrv_free(struct shmifsrv_client*, int mode);
 bool shmifsrv_enqueue_event(
 	struct shmifsrv_client*, struct arcan_event*, int fd);
 
+/*
+ * Enqueue up to [n] events (without descriptors) with a single queue index
+ * update and wakeup. Returns the number of events consumed, which is less
+ * than [n] if the outgoing queue filled up.
+ */
+size_t shmifsrv_enqueue_events(
+	struct shmifsrv_client*, struct arcan_event*, size_t n);
+
 /*
  * Split up a longer message into a multipart set of message events
  */
@@ -291,6 +299,11 @@ struct shmifsrv_vbuffer {
 /* only usedated with subregion : true */
 	struct arcan_shmif_region region;
 
+/* with subregion : true and n_regions > 1, region is the bounding box of the
+ * disjoint regions here and only those need to be synched */
+	size_t n_regions;
+	struct arcan_shmif_region regions[ARCAN_SHMIF_DIRTY_LIM];
+
 /* only used with hwhandles : true */
 	size_t formats[4];
 	int planes[4];
@@ -354,3 +367,73 @@ int shmifsrv_monotonic_tick(int* left);
  * pause, global suspend action and so on.
  */
 void shmifsrv_monotonic_rebase();
+
+/*
+ * Reactor for driving many clients from a single thread without one poll
+ * loop (or thread) per client. The client sockets share one epoll set (poll
+ * on platforms without it) that covers accept, authentication and hangup,
+ * while the shared page state of every ready client is swept once per run.
+ *
+ * The callbacks are invoked from within shmifsrv_reactor_run:
+ *  ready - client has connected and authenticated
+ *  event - a batch of [n] events that were not consumed by process_event
+ *  video - a video buffer is ready, do the [CRITICAL] enter / video /
+ *          video_step / leave dance in the callback
+ *  audio - an audio buffer is ready, forward from the callback with
+ *          shmifsrv_audio (inside enter / leave)
+ *  dead  - the client is gone, reported once, free with _reactor_free
+ *
+ * Missing video and audio handlers have the buffers released, a missing dead
+ * handler frees the client with SHMIFSRV_FREE_FULL. A callback may free or
+ * remove any client, including the one it was invoked for.
+ */
+struct shmifsrv_reactor;
+
+struct shmifsrv_reactor_cb {
+	void (*ready)(struct shmifsrv_client*, void* tag);
+	void (*event)(struct shmifsrv_client*,
+		struct arcan_event* ev, size_t n, void* tag);
+	void (*video)(struct shmifsrv_client*, void* tag);
+	void (*audio)(struct shmifsrv_client*, void* tag);
+	void (*dead)(struct shmifsrv_client*, void* tag);
+};
+
+struct shmifsrv_reactor* shmifsrv_reactor_create(struct shmifsrv_reactor_cb);
+
+/*
+ * Start tracking a client (any state, including a pending connection point)
+ * with [tag] forwarded to the callbacks. A client can only belong to one
+ * reactor at a time.
+ */
+bool shmifsrv_reactor_add(
+	struct shmifsrv_reactor*, struct shmifsrv_client*, void* tag);
+
+/*
+ * Stop tracking a client without freeing it, the caller takes over polling.
+ */
+void shmifsrv_reactor_remove(struct shmifsrv_reactor*, struct shmifsrv_client*);
+
+/*
+ * Remove and shmifsrv_free the client. Waiting for (and eventually killing)
+ * a spawned child is taken over by the reactor rather than a nanny thread.
+ */
+void shmifsrv_reactor_free(
+	struct shmifsrv_reactor*, struct shmifsrv_client*, int mode);
+
+/*
+ * [THREAD:USES_TLS]
+ * Wait up to [timeout] milliseconds (-1, until something happens or the next
+ * monotonic tick) and dispatch. The monotonic clock is shared with
+ * shmifsrv_monotonic_tick, and ready clients are ticked accordingly.
+ *
+ * Returns the number of clients that had any work done.
+ */
+size_t shmifsrv_reactor_run(struct shmifsrv_reactor*, int timeout);
+
+size_t shmifsrv_reactor_clients(struct shmifsrv_reactor*);
+
+/*
+ * Release the reactor. Clients still tracked are left as they are and need
+ * to be freed by the caller.
+ */
+void shmifsrv_reactor_destroy(struct shmifsrv_reactor*);
@@ -137,38 +137,185 @@ struct arcan_shmif_venc {
 };
 
 /*
- * similar to how agp_mesh_store accepts data, the reordering would
- * happen in the copy+validation stage. negative offset fields mean
- * the data isn't present.
+ * With SHMIF_META_VOBJ the video buffer carries a packed mesh rather than
+ * pixels, in the same way that VENC carries a compressed frame. The layout is
+ * what the consumer draws from, so it can be copied out and used without any
+ * repacking: one interleaved vertex buffer with quantized (normalized integer)
+ * attributes, 16 or 32-bit indices, meshlets (runs of at most
+ * SHMIF_MESH_MESHLET_VERTS vertices / SHMIF_MESH_MESHLET_TRIS triangles with a
+ * bounding sphere) and levels of detail from coarse to fine. The same
+ * container is used for files (.amsh).
+ *
+ * [header][lods][meshlets][indices][vertices]
+ *
+ * All offsets are in bytes from the start of the header and 4b aligned. The
+ * levels of detail are progressive: lod[i] draws [n_indices] from [index_ofs]
+ * and only references the first [n_vertices] vertices, with the vertices of
+ * coarser levels sorted first. This lets a producer stream refinements by
+ * sending the container again with more levels (and more of the vertices and
+ * indices), a consumer simply picks the finest level it has.
  */
-struct shmif_vector_mesh {
-	int32_t ofs_verts; /* float */
-	int32_t ofs_txcos; /* float */
-	int32_t ofs_txcos2; /* float */
-	int32_t ofs_normals; /* float */
-	int32_t ofs_colors; /* float */
-	int32_t ofs_tangents; /* float */
-	int32_t ofs_bitangents; /* float */
-	int32_t ofs_weights; /* float */
-	int32_t ofs_joints; /* uint16 */
-	int32_t ofs_indices; /* uint32 */
-
-	size_t vertex_size;
-	size_t n_vertices;
-	size_t n_indices;
-	int primitive;
-
-	size_t buffer_sz;
-	uint8_t* buffer;
+#define SHMIF_MESH_MAGIC 0x48534d41
+#define SHMIF_MESH_VERSION 1
+#define SHMIF_MESH_LODLIM 8
+#define SHMIF_MESH_MESHLET_VERTS 64
+#define SHMIF_MESH_MESHLET_TRIS 124
+
+enum shmif_mesh_attr {
+	SHMIF_MESH_POSITION = 0,
+	SHMIF_MESH_NORMAL = 1,
+	SHMIF_MESH_TXCOS = 2,
+	SHMIF_MESH_COLOR = 3,
+	SHMIF_MESH_ATTRLIM = 4
 };
 
+/* the N(ormalized) formats are fetched as [-1..1] signed, [0..1] unsigned */
+enum shmif_mesh_fmt {
+	SHMIF_MESH_NONE = 0,
+	SHMIF_MESH_F32 = 1,
+	SHMIF_MESH_S16N = 2,
+	SHMIF_MESH_U16N = 3,
+	SHMIF_MESH_S8N = 4,
+	SHMIF_MESH_U8N = 5
+};
+
+struct shmif_mesh_attrib {
+	uint8_t fmt;
+	uint8_t components;
+	uint16_t offset;
+};
+
+struct shmif_mesh_meshlet {
+	uint32_t index_ofs;
+	uint32_t n_indices;
+	float center[3];
+	float radius;
+};
+
+struct shmif_mesh_lod {
+	uint32_t index_ofs;
+	uint32_t n_indices;
+	uint32_t n_vertices;
+	uint32_t meshlet_ofs;
+	uint32_t n_meshlets;
+/* size of the cell vertices were merged in relative the bounding box, 0 is
+ * the full resolution mesh */
+	float error;
+};
+
+struct shmif_mesh_header {
+	uint32_t magic;
+	uint16_t version;
+	uint8_t index_size;
+	uint8_t n_lods;
+	uint32_t stride;
+	uint32_t n_vertices;
+	uint32_t n_indices;
+	uint32_t n_meshlets;
+	uint32_t ofs_lods;
+	uint32_t ofs_meshlets;
+	uint32_t ofs_indices;
+	uint32_t ofs_vertices;
+	uint32_t data_sz;
+	float bbmin[3];
+	float bbmax[3];
+	struct shmif_mesh_attrib attr[SHMIF_MESH_ATTRLIM];
+};
+
+/* PRODUCER set, bytes of the video buffer that are used by the mesh and an
+ * identifier that changes with a new mesh but not with refinements of it */
 struct arcan_shmif_vector {
-/* PRODUCER set */
-	size_t data_sz;
-	uint8_t mesh_groups;
-	struct shmif_vector_mesh meshes[];
+	uint32_t data_sz;
+	uint32_t mesh_id;
 };
 
+static inline size_t shmif_mesh_fmtsz(uint8_t fmt)
+{
+	switch (fmt){
+	case SHMIF_MESH_F32: return 4;
+	case SHMIF_MESH_S16N: case SHMIF_MESH_U16N: return 2;
+	case SHMIF_MESH_S8N: case SHMIF_MESH_U8N: return 1;
+	default:
+		return 0;
+	}
+}
+
+static inline bool shmif_mesh_range(
+	const struct shmif_mesh_header* hdr, uint32_t ofs, uint64_t n, size_t sz)
+{
+	return ofs >= sizeof(struct shmif_mesh_header) &&
+		ofs % 4 == 0 && ofs <= hdr->data_sz && n * sz <= hdr->data_sz - ofs;
+}
+
+/*
+ * Verify that every section, attribute and index of a packed mesh is within
+ * bounds. The data can't be trusted, so only use this on a private copy and
+ * not on the shared buffer. Returns the header or NULL if anything is off.
+ */
+static inline const struct shmif_mesh_header* shmif_mesh_validate(
+	const uint8_t* buf, size_t buf_sz)
+{
+	const struct shmif_mesh_header* hdr = (const struct shmif_mesh_header*) buf;
+	if (buf_sz < sizeof(struct shmif_mesh_header) || (uintptr_t) buf % 4 ||
+		hdr->magic != SHMIF_MESH_MAGIC || hdr->version != SHMIF_MESH_VERSION ||
+		hdr->data_sz > buf_sz || (hdr->index_size != 2 && hdr->index_size != 4) ||
+		!hdr->n_lods || hdr->n_lods > SHMIF_MESH_LODLIM ||
+		!hdr->stride || hdr->stride % 4 || hdr->stride > 256)
+		return NULL;
+
+	if (!shmif_mesh_range(hdr, hdr->ofs_lods,
+			hdr->n_lods, sizeof(struct shmif_mesh_lod)) ||
+		!shmif_mesh_range(hdr, hdr->ofs_meshlets,
+			hdr->n_meshlets, sizeof(struct shmif_mesh_meshlet)) ||
+		!shmif_mesh_range(hdr, hdr->ofs_indices, hdr->n_indices, hdr->index_size) ||
+		!shmif_mesh_range(hdr, hdr->ofs_vertices, hdr->n_vertices, hdr->stride))
+		return NULL;
+
+/* positions are required, and each attribute is aligned to its format */
+	for (size_t i = 0; i < SHMIF_MESH_ATTRLIM; i++){
+		const struct shmif_mesh_attrib* attr = &hdr->attr[i];
+		if (attr->fmt == SHMIF_MESH_NONE){
+			if (i == SHMIF_MESH_POSITION)
+				return NULL;
+			continue;
+		}
+
+		size_t fsz = shmif_mesh_fmtsz(attr->fmt);
+		if (!fsz || !attr->components || attr->components > 4 ||
+			attr->offset % fsz || attr->offset + fsz * attr->components > hdr->stride)
+			return NULL;
+	}
+
+	const struct shmif_mesh_lod* lods =
+		(const struct shmif_mesh_lod*)(buf + hdr->ofs_lods);
+	const struct shmif_mesh_meshlet* meshlets =
+		(const struct shmif_mesh_meshlet*)(buf + hdr->ofs_meshlets);
+
+	for (size_t i = 0; i < hdr->n_meshlets; i++){
+		if ((uint64_t) meshlets[i].index_ofs + meshlets[i].n_indices > hdr->n_indices)
+			return NULL;
+	}
+
+/* each level only gets to reference the vertices that it has */
+	for (size_t i = 0; i < hdr->n_lods; i++){
+		const struct shmif_mesh_lod* lod = &lods[i];
+		if ((uint64_t) lod->index_ofs + lod->n_indices > hdr->n_indices ||
+			lod->n_indices % 3 || lod->n_vertices > hdr->n_vertices ||
+			(uint64_t) lod->meshlet_ofs + lod->n_meshlets > hdr->n_meshlets)
+			return NULL;
+
+		const uint8_t* ind = buf + hdr->ofs_indices + lod->index_ofs * hdr->index_size;
+		for (size_t j = 0; j < lod->n_indices; j++){
+			uint32_t iv = hdr->index_size == 2 ?
+				((const uint16_t*) ind)[j] : ((const uint32_t*) ind)[j];
+			if (iv >= lod->n_vertices)
+				return NULL;
+		}
+	}
+
+	return hdr;
+}
+
 /*
  * Though it might seem that this information gets lost on a resize request,
  * that is only true if the substructure set changes. Otherwise it's part of
@@ -244,7 +391,7 @@ bool arcan_shmifsub_setramp(
  * engine code.
  */
 #ifdef HAVE_ARCAN_MATH
-#define VR_VERSION 0x1
+#define VR_VERSION 0x2
 
 /*
  * This structure is mapped into the adata area. It can be verified
@@ -342,6 +489,12 @@ union vr_data {
 		vector forward;
 		quat orientation;
 		_Atomic uint16_t checksum;
+
+/* optional, angular velocity (rad/s, applied as orientation * delta) and
+ * when the sample was taken (CLOCK_MONOTONIC, microseconds), the consumer
+ * uses these to predict the orientation at scanout. 0 if not provided. */
+		vector angular_velocity;
+		uint64_t sample_us;
 	};
 };
 
@@ -363,6 +516,39 @@ struct vr_limb {
 	union vr_data data;
 };
 
+/*
+ * The producer sets the timestamp and the rest of the limb first, the
+ * checksum is then calculated over all of it with the checksum as 0.
+ */
+static inline uint16_t vr_limb_checksum(const struct vr_limb* limb)
+{
+	struct vr_limb tmp = *limb;
+	atomic_store(&tmp.data.checksum, 0);
+	return subp_checksum((uint8_t*)&tmp, sizeof(struct vr_limb));
+}
+
+/*
+ * Every limb sample also goes into a ring that follows the limbs[limb_lim]
+ * array (VR_VERSION >= 2), so that the consumer sees all of them and not just
+ * the last one. Producers (one thread per limb) claim a ticket from [head]
+ * and never wait on the consumer, which tracks its own tail and falls behind
+ * by at most VR_RING_SIZE samples before the oldest are lost. [seq] is odd
+ * while the slot is being written and 2*(ticket+1) when it is complete.
+ */
+#define VR_RING_SIZE 256
+
+struct vr_sample {
+	_Atomic uint_least64_t seq;
+	uint8_t limb;
+	uint64_t sample_us;
+	union vr_data data;
+};
+
+struct vr_sample_ring {
+	_Atomic uint_least64_t head;
+	struct vr_sample samples[VR_RING_SIZE];
+};
+
 /*
  * 0 <= (page_sz) - offset_of(limb) - limb_lim*sizeof(struct) limb
  */
@@ -383,5 +569,49 @@ struct arcan_shmif_vr {
 /* PRODUCER UPDATE (see struct definition) */
 	struct vr_limb limbs[];
 };
+
+static inline struct vr_sample_ring* vr_sample_ring(struct arcan_shmif_vr* vr)
+{
+	if (!vr || vr->version < 2)
+		return NULL;
+
+	return (struct vr_sample_ring*)((uint8_t*)vr +
+		sizeof(struct arcan_shmif_vr) + sizeof(struct vr_limb) * vr->limb_lim);
+}
+
+static inline void vr_ring_push(struct vr_sample_ring* ring,
+	uint8_t limb, const union vr_data* data, uint64_t sample_us)
+{
+	uint64_t ticket = atomic_fetch_add_explicit(&ring->head, 1, memory_order_relaxed);
+	struct vr_sample* dst = &ring->samples[ticket % VR_RING_SIZE];
+
+	atomic_store_explicit(&dst->seq, 2 * ticket + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+		dst->limb = limb;
+		dst->sample_us = sample_us;
+		dst->data = *data;
+	atomic_store_explicit(&dst->seq, 2 * ticket + 2, memory_order_release);
+}
+
+/*
+ * Copy the sample for [ticket] into [dst], returns 1 on success, 0 if it has
+ * not been completed yet and -1 if it was lost (overwritten while reading).
+ */
+static inline int vr_ring_get(
+	struct vr_sample_ring* ring, uint64_t ticket, struct vr_sample* dst)
+{
+	struct vr_sample* src = &ring->samples[ticket % VR_RING_SIZE];
+	uint64_t want = 2 * ticket + 2;
+
+	uint64_t seq = atomic_load_explicit(&src->seq, memory_order_acquire);
+	if (seq < want)
+		return 0;
+	if (seq > want)
+		return -1;
+
+	*dst = *src;
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(&src->seq, memory_order_relaxed) == want ? 1 : -1;
+}
 #endif
 #endif
@@ -558,6 +558,13 @@ struct tui_region {
 	size_t w, h;
 };
 
+/* [len] bytes of UTF-8 sharing one attribute, see arcan_tui_writeu8_runs.
+ * [attr] set to NULL uses the current default attribute. */
+struct tui_attr_run {
+	size_t len;
+	const struct tui_screen_attr* attr;
+};
+
 struct tui_process_res {
 	uint32_t ok;
 	uint32_t bad;
@@ -912,6 +919,20 @@ bool arcan_tui_writeu8(struct tui_context*,
 bool arcan_tui_writestr(
 	struct tui_context*, const char* str, struct tui_screen_attr*);
 
+/*
+ * Write [n] bytes from [u8] as UTF-8 at the current cursor position, with
+ * the attributes given as consecutive runs of bytes in [runs]. Bytes past the
+ * last run use the default attribute. The cursor advances and wraps as with
+ * repeated arcan_tui_write calls, but the cells are written directly and the
+ * dirty state is updated once for the entire span. This is the cheaper way of
+ * drawing highlighted text where the attribute changes every few characters.
+ *
+ * Returns false if the UTF-8 failed to validate completely, the invalid bytes
+ * are written as empty cells and the rest of the span is still written.
+ */
+bool arcan_tui_writeu8_runs(struct tui_context*, const uint8_t* u8, size_t n,
+	const struct tui_attr_run* runs, size_t n_runs);
+
 /*
  * This behaves similar to the normal printf class functions, except that
  * it takes an optional [attr] and returns the number of characters written.
@@ -1305,6 +1326,7 @@ typedef uint32_t (* PTUISCREENS)(struct tui_context*);
 typedef void (* PTUIWRITE)(struct tui_context*, uint32_t, struct tui_screen_attr*);
 typedef bool (* PTUIWRITEU8)(struct tui_context*, const uint8_t*, size_t, struct tui_screen_attr*);
 typedef bool (* PTUIWRITESTR)(struct tui_context*, const char*, struct tui_screen_attr*);
+typedef bool (* PTUIWRITEU8RUNS)(struct tui_context*, const uint8_t*, size_t, const struct tui_attr_run*, size_t);
 typedef void (* PTUIWRITEATTR)(struct tui_context*, struct tui_screen_attr*, size_t x, size_t y);
 typedef void (* PTUICURSORPOS)(struct tui_context*, size_t*, size_t*);
 typedef struct tui_screen_attr (* PTUIDEFCATTR)(struct tui_context*, int);
@@ -1400,6 +1422,7 @@ static PTUISTATESZ arcan_tui_statesize;
 static PTUIWRITE arcan_tui_write;
 static PTUIWRITEU8 arcan_tui_writeu8;
 static PTUIWRITESTR arcan_tui_writestr;
+static PTUIWRITEU8RUNS arcan_tui_writeu8_runs;
 static PTUIWRITEATTR arcan_tui_writeattr_at;
 static PTUICURSORPOS arcan_tui_cursorpos;
 static PTUIDEFCATTR arcan_tui_defcattr;
@@ -1460,6 +1483,7 @@ M(PTUISTATESZ,arcan_tui_statesize);
 M(PTUIWRITE,arcan_tui_write);
 M(PTUIWRITEU8,arcan_tui_writeu8);
 M(PTUIWRITESTR,arcan_tui_writestr);
+M(PTUIWRITEU8RUNS,arcan_tui_writeu8_runs);
 M(PTUIWRITEATTR,arcan_tui_writeattr_at);
 M(PTUICURSORPOS,arcan_tui_cursorpos);
 M(PTUIDEFCATTR,arcan_tui_defcattr);
@@ -134,6 +134,15 @@ void arcan_tui_bufferwnd_seek(struct tui_context* T, size_t buf_ofs);
 size_t arcan_tui_bufferwnd_tell(
 	struct tui_context* T, struct tui_bufferwnd_opts*);
 
+/*
+ * Retrieve the buffer offset of the first visible cell [top] and of the
+ * cursor [cursor], either can be NULL. Together with _seek and _synch this
+ * lets the caller provide a slice of a larger source and move it along with
+ * the view.
+ */
+void arcan_tui_bufferwnd_view(
+	struct tui_context* T, size_t* top, size_t* cursor);
+
 void arcan_tui_bufferwnd_release(struct tui_context* T);
 
 /*
@@ -152,6 +161,7 @@ typedef void(* PTUIBUFFERWND_SYNCH)(
 typedef void(* PTUIBUFFERWND_SEEK)(struct tui_context*, size_t);
 typedef int(* PTUIBUFFERWND_STATUS)(struct tui_context*);
 typedef size_t(* PTUIBUFFERWND_TELL)(struct tui_context*, struct tui_bufferwnd_opts*);
+typedef void(* PTUIBUFFERWND_VIEW)(struct tui_context*, size_t*, size_t*);
 
 static PTUIBUFFERWND_SETUP arcan_tui_bufferwnd_setup;
 static PTUIBUFFERWND_RELEASE arcan_tui_bufferwnd_release;
@@ -159,6 +169,7 @@ static PTUIBUFFERWND_SYNCH arcan_tui_bufferwnd_synch;
 static PTUIBUFFERWND_SEEK arcan_tui_bufferwnd_seek;
 static PTUIBUFFERWND_STATUS arcan_tui_bufferwnd_status;
 static PTUIBUFFERWND_TELL arcan_tui_bufferwnd_tell;
+static PTUIBUFFERWND_VIEW arcan_tui_bufferwnd_view;
 
 static bool arcan_tui_bufferwnd_dynload(
 	void*(*lookup)(void*, const char*), void* tag)
@@ -170,6 +181,7 @@ M(PTUIBUFFERWND_SYNCH, arcan_tui_bufferwnd_synch);
 M(PTUIBUFFERWND_SEEK, arcan_tui_bufferwnd_seek);
 M(PTUIBUFFERWND_STATUS, arcan_tui_bufferwnd_status);
 M(PTUIBUFFERWND_TELL, arcan_tui_bufferwnd_tell);
+M(PTUIBUFFERWND_VIEW, arcan_tui_bufferwnd_view);
 return true;
 }
 #endif
@@ -29,6 +29,20 @@ struct tui_list_entry {
 	uintptr_t tag;        /* index or other reference to pair trigger */
 };
 
+/*
+ * Entry source for virtual lists, see arcan_tui_listwnd_setup_virtual.
+ * [count] returns the current number of entries.
+ * [fetch] fills in [dst] for 0 <= index < count and returns false if the
+ * entry can't be provided. The strings only need to be valid for the duration
+ * of the call, they are copied if kept.
+ */
+struct tui_list_source {
+	size_t (*count)(struct tui_context*, void* tag);
+	bool (*fetch)(struct tui_context*,
+		size_t index, struct tui_list_entry* dst, void* tag);
+	void* tag;
+};
+
 /*
  * Description:
  * This function partially assumes control over a provided window and uses
@@ -73,6 +87,27 @@ struct tui_list_entry {
 bool arcan_tui_listwnd_setup(
 	struct tui_context*, struct tui_list_entry*, size_t n_entries);
 
+/*
+ * Virtual version of _setup for lists that are too large to provide as an
+ * array, e.g. directories with millions of entries. Only the entries for the
+ * visible rows (and some overscan) are fetched and kept.
+ *
+ * Typed text filters the list (case insensitive substring on label) rather
+ * than matching shortcuts. The filter pass is incremental: it runs a bounded
+ * step per tick, narrows the previous results when the filter is extended and
+ * is cancelled and restarted when the filter changes. Backspace and cancel
+ * edit or clear the filter.
+ *
+ * Call arcan_tui_listwnd_dirty when the entries or their count changes, this
+ * drops the fetched entries and restarts an active filter.
+ *
+ * Positions in _setpos/_tell and the entry returned by _status refer to the
+ * source index regardless of filtering. The _status entry is valid until the
+ * next listwnd call.
+ */
+bool arcan_tui_listwnd_setup_virtual(
+	struct tui_context*, struct tui_list_source*);
+
 /*
  * Query and flush the active window selection status, returns true if
  * somthing has been activated, and sets a pointer to the item [or NULL
@@ -120,6 +155,8 @@ typedef void(* PTUILISTWND_DIRTY)(struct tui_context*);
 typedef void(* PTUILISTWND_RELEASE)(struct tui_context*);
 typedef void(* PTUILISTWND_SETPOS)(struct tui_context*, size_t);
 typedef ssize_t(* PTUILISTWND_TELL)(struct tui_context*);
+typedef bool(* PTUILISTWND_SETUP_VIRTUAL)(
+	struct tui_context*, struct tui_list_source*);
 
 static PTUILISTWND_SETUP arcan_tui_listwnd_setup;
 static PTUILISTWND_STATUS arcan_tui_listwnd_status;
@@ -127,6 +164,7 @@ static PTUILISTWND_DIRTY arcan_tui_listwnd_dirty;
 static PTUILISTWND_RELEASE arcan_tui_listwnd_release;
 static PTUILISTWND_SETPOS arcan_tui_listwnd_setpos;
 static PTUILISTWND_TELL arcan_tui_listwnd_tell;
+static PTUILISTWND_SETUP_VIRTUAL arcan_tui_listwnd_setup_virtual;
 
 static bool arcan_tui_listwnd_dynload(
 	void*(*lookup)(void*, const char*), void* tag)
@@ -138,6 +176,7 @@ M(PTUILISTWND_DIRTY, arcan_tui_listwnd_dirty);
 M(PTUILISTWND_RELEASE, arcan_tui_listwnd_release);
 M(PTUILISTWND_SETPOS, arcan_tui_listwnd_setpos);
 M(PTUILISTWND_TELL, arcan_tui_listwnd_tell);
+M(PTUILISTWND_SETUP_VIRTUAL, arcan_tui_listwnd_setup_virtual);
 return true;
 }
 #endif
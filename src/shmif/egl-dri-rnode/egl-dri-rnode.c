@@ -973,6 +973,14 @@ size_t arcan_shmifext_signal_planes(
 			return i;
 		close(planes[i].fd);
 
+/* the acquire fence goes right after the plane it is attached to */
+		ev.ext.bstream.fence = 0;
+		if (planes[i].fence > 0){
+			ev.ext.bstream.fence = arcan_pushhandle(planes[i].fence, c->epipe);
+			close(planes[i].fence);
+			planes[i].fence = -1;
+		}
+
 /* missing - the gpuid should be set based on what gpu the context is assigned
  * to based on initial/device-hint - this is to make sure that we don't commit
  * buffers to something that was not intended (particularly during hand-over)
@@ -984,6 +992,9 @@ size_t arcan_shmifext_signal_planes(
 		ev.ext.bstream.offset = planes[i].gbm.offset;
 		ev.ext.bstream.width  = planes[i].w;
 		ev.ext.bstream.height = planes[i].h;
+		ev.ext.bstream.color_space = planes[i].gbm.color_space;
+		ev.ext.bstream.color_range = planes[i].gbm.color_range;
+		ev.ext.bstream.chroma_siting = planes[i].gbm.chroma_siting;
 		ev.ext.bstream.left = n_planes - i - 1;
 
 		arcan_shmif_enqueue(c, &ev);
@@ -1014,6 +1025,8 @@ int arcan_shmifext_signal(struct arcan_shmif_cont* con,
 	if (!dpy)
 		return -1;
 
+	int fence = -1;
+
 /* swap and forward the state of the builtin- rendertarget or the latest
  * imported buffer depending on how the context was configured */
 	if (tex_id == SHMIFEXT_BUILTIN){
@@ -1021,24 +1034,43 @@ int arcan_shmifext_signal(struct arcan_shmif_cont* con,
 			return -1;
 
 		agp_activate_rendertarget(NULL);
-		glFinish();
+		fence = helper_fence_create(&agp_fenv, &agp_eglenv, dpy);
+		if (-1 == fence)
+			glFinish();
 
 		bool swap;
 		struct agp_vstore* vs = agp_rendertarget_swap(ctx->rtgt, &swap);
-		if (!swap)
+		if (!swap){
+			if (-1 != fence)
+				close(fence);
 			return INT_MAX;
+		}
+
+/* rendering into the buffer swapped in needs to wait for the server */
+		if (con->privext->release_fence != -1){
+			helper_fence_wait(&agp_eglenv, dpy, con->privext->release_fence);
+			close(con->privext->release_fence);
+			con->privext->release_fence = -1;
+		}
 
 		tex_id = vs->vinf.text.glid;
 	}
+	else
+		fence = helper_fence_create(&agp_fenv, &agp_eglenv, dpy);
 
 /* begin extraction of the currently rendered-to buffer */
 	size_t nplanes;
 	struct shmifext_buffer_plane planes[4];
 
 	if (con->privext->state_fl & STATE_NOACCEL ||
-			!(nplanes=arcan_shmifext_export_image(con, display, tex_id, 4, planes)))
+			!(nplanes=arcan_shmifext_export_image(con, display, tex_id, 4, planes))){
+		if (-1 != fence)
+			close(fence);
 		goto fallback;
+	}
 
+/* the server waits for the fence on the GPU instead of us blocking here */
+	planes[0].fence = fence;
 	arcan_shmifext_signal_planes(con, mask, nplanes, planes);
 	return INT_MAX;
 
@@ -27,6 +27,11 @@ struct shmif_ext_hidden {
 /* tracking information for active use */
 	int state_fl;
 
+/* latest sync_file from TARGET_COMMAND_BUFFER_RELEASE or -1, owned here,
+ * and the number of most recent buffers it doesn't cover */
+	int release_fence;
+	size_t release_held;
+
 /* metadata for allocation help */
 	size_t n_modifiers;
 	uint64_t modifiers[64];
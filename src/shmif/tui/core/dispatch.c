@@ -397,6 +397,12 @@ static void target_event(struct tui_context* tui, struct arcan_event* aev)
 		display_hint(tui, ev);
 	break;
 
+/* no point in synching faster than the output we are shown on can update */
+	case TARGET_COMMAND_OUTPUTHINT:
+		if (!tui->refresh_fixed && ev->ioevs[2].iv > 0)
+			tui->refresh_ms = 1000 / ev->ioevs[2].iv;
+	break;
+
 /* if the highest bit is set in the request, it's an external request
  * and it should be forwarded to the event handler */
 	case TARGET_COMMAND_REQFAIL:
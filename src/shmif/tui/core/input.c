@@ -26,8 +26,11 @@ void tui_expose_labels(struct tui_context* tui)
 		.ext.labelhint.idatatype = EVENT_IDATATYPE_DIGITAL
 	};
 
-/* send an empty label first as a reset */
-	arcan_shmif_enqueue(&tui->acon, &ev);
+/* send an empty label first as a reset, the labels are batched so the
+ * parent gets to see the whole set at once */
+	struct arcan_event batch[32];
+	size_t count = 0;
+	batch[count++] = ev;
 
 /* then forward to a possible callback handler */
 	size_t ind = 0;
@@ -48,9 +51,17 @@ void tui_expose_labels(struct tui_context* tui)
 			ev.ext.labelhint.initial = dstlbl.initial;
 			snprintf((char*)ev.ext.labelhint.vsym,
 				COUNT_OF(ev.ext.labelhint.vsym), "%s", dstlbl.vsym);
-			arcan_shmif_enqueue(&tui->acon, &ev);
+
+			batch[count++] = ev;
+			if (count == COUNT_OF(batch)){
+				arcan_shmif_enqueue_v(&tui->acon, batch, count);
+				count = 0;
+			}
 		}
 	}
+
+	if (count)
+		arcan_shmif_enqueue_v(&tui->acon, batch, count);
 }
 
 static int update_mods(int mods, int sym, bool pressed)
@@ -4,6 +4,7 @@
 #include <pthread.h>
 #include <errno.h>
 #include <assert.h>
+#include <stddef.h>
 
 typedef void* TTF_Font;
 #include "../raster/raster.h"
@@ -16,6 +17,8 @@ static void resize_cellbuffer(struct tui_context* tui)
 	}
 
 	tui->base = NULL;
+	free(tui->dirty_rows);
+	tui->dirty_rows = NULL;
 
 	size_t buffer_sz = 2 * tui->rows * tui->cols * sizeof(struct tui_cell);
 	size_t rbuf_sz = tui_screen_tpack_sz(tui);
@@ -34,8 +37,24 @@ static void resize_cellbuffer(struct tui_context* tui)
 	tui->front = tui->base;
 	tui->back = &tui->base[tui->rows * tui->cols];
 	tui->dirty |= DIRTY_FULL;
+
+/* without the bitmap every row is treated as dirty */
+	tui->dirty_rows = calloc((tui->rows + 63) / 64, sizeof(uint64_t));
 }
 
+/* the colors and flags are the first 8 bytes of the attribute, compare those
+ * as one word rather than field by field (tui_attr_equal) */
+static inline bool cell_equal(struct tui_cell* a, struct tui_cell* b)
+{
+	uint64_t wa, wb;
+	memcpy(&wa, &a->attr, sizeof(wa));
+	memcpy(&wb, &b->attr, sizeof(wb));
+	return wa == wb && a->ch == b->ch && a->attr.custom_id == b->attr.custom_id;
+}
+
+_Static_assert(offsetof(struct tui_screen_attr, custom_id) == sizeof(uint64_t),
+	"cell_equal expects colors and aflags in the first word");
+
 /* sweep a row from a start offset until the first deviation
  * between front and back offset */
 static ssize_t find_row_ofs(
@@ -45,15 +64,123 @@ static ssize_t find_row_ofs(
 	struct tui_cell* front = &tui->front[pos];
 	struct tui_cell* back = &tui->back[pos];
 
+/* rows that were rewritten with the same contents are common when scrolling,
+ * an identical row (fstamp included) can be ruled out in one go */
+	if (0 == ofs &&
+		0 == memcmp(front, back, sizeof(struct tui_cell) * tui->cols))
+		return -1;
+
 	for (pos = ofs; pos < tui->cols; pos++){
-		if (!tui_attr_equal(front[pos].attr,
-			back[pos].attr) || front[pos].ch != back[pos].ch){
+		if (!cell_equal(&front[pos], &back[pos]))
 			return pos;
-		}
 	}
 	return -1;
 }
 
+static void clear_dirty_rows(struct tui_context* tui)
+{
+	if (tui->dirty_rows)
+		memset(tui->dirty_rows, '\0', (tui->rows + 63) / 64 * sizeof(uint64_t));
+}
+
+static bool row_dirty(struct tui_context* tui, size_t row)
+{
+	return !tui->dirty_rows ||
+		(tui->dirty_rows[row >> 6] & ((uint64_t) 1 << (row & 63)));
+}
+
+static bool row_equal(struct tui_cell* a, struct tui_cell* b, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		if (!cell_equal(&a[i], &b[i]))
+			return false;
+	return true;
+}
+
+void tui_screen_scroll(
+	struct tui_context* tui, size_t top, size_t bottom, int step)
+{
+	if (!step || tui->scroll_hint.bad)
+		return;
+
+	if (!tui->scroll_hint.set){
+		tui->scroll_hint.set = true;
+		tui->scroll_hint.top = top;
+		tui->scroll_hint.bottom = bottom;
+		tui->scroll_hint.step = step;
+	}
+	else if (tui->scroll_hint.top == top && tui->scroll_hint.bottom == bottom)
+		tui->scroll_hint.step += step;
+	else
+		tui->scroll_hint.bad = true;
+}
+
+/*
+ * Apply a pending scroll hint to the back buffer and emit the matching scroll
+ * line so the receiver does the same to what it has drawn. The regular delta
+ * pass after this only has to cover what didn't just move.
+ */
+static size_t emit_scroll(struct tui_context* tui, uint8_t* out)
+{
+	int step = tui->scroll_hint.step;
+	size_t top = tui->scroll_hint.top;
+	size_t bottom = tui->scroll_hint.bottom;
+	size_t cols = tui->cols;
+
+	if (bottom >= tui->rows)
+		bottom = tui->rows - 1;
+
+	size_t mag = step < 0 ? -step : step;
+	if (!tui->scroll_hint.set || tui->scroll_hint.bad ||
+		top > bottom || !mag || mag > 255 || mag > bottom - top)
+		return 0;
+
+/* only worth it if the move explains more rows than are already in place */
+	size_t hit = 0, stay = 0;
+	for (size_t y = top; y + mag <= bottom; y++){
+		size_t dst = step > 0 ? y : y + mag;
+		size_t src = step > 0 ? y + mag : y;
+		hit += row_equal(&tui->front[dst * cols], &tui->back[src * cols], cols);
+		stay += row_equal(&tui->front[dst * cols], &tui->back[dst * cols], cols);
+	}
+
+	if (hit <= stay)
+		return 0;
+
+/* the rows that come into view are background on the receiver, poison them
+ * in back so they always mismatch */
+	size_t keep = bottom - top + 1 - mag;
+	struct tui_cell* base = &tui->back[top * cols];
+	if (step > 0){
+		memmove(base, &base[mag * cols], keep * cols * sizeof(struct tui_cell));
+		memset(&base[keep * cols], 0xff, mag * cols * sizeof(struct tui_cell));
+	}
+	else {
+		memmove(&base[mag * cols], base, keep * cols * sizeof(struct tui_cell));
+		memset(base, 0xff, mag * cols * sizeof(struct tui_cell));
+	}
+
+/* the drawn cursor moves with the pixels, make sure the cell gets redrawn */
+	if (tui->last_cursor.active &&
+		tui->last_cursor.row >= top && tui->last_cursor.row <= bottom){
+		ssize_t row = (ssize_t) tui->last_cursor.row - step;
+		if (row >= (ssize_t) top && row <= (ssize_t) bottom && tui->last_cursor.col < cols)
+			memset(&tui->back[row * cols + tui->last_cursor.col],
+				0xff, sizeof(struct tui_cell));
+	}
+
+	tui_dirty_rows(tui, top, bottom);
+
+	struct tui_raster_line line = {
+		.start_line = top,
+		.offset = bottom,
+		.scroll_dir = step > 0 ? RSCROLL_UP : RSCROLL_DOWN,
+		.line_state = mag
+	};
+	memcpy(out, &line, sizeof(line));
+	return sizeof(line);
+}
+
 static void pack_u32(uint32_t src, uint8_t* outb)
 {
 	outb[0] = (uint8_t)(src >> 0);
@@ -159,7 +286,7 @@ size_t tui_screen_tpack_sz(struct tui_context* tui)
 	return
 		sizeof(struct tui_raster_header) + /* always there */
 		((tui->rows * tui->cols + 2) * raster_cell_sz) + /* worst case, includes cursor */
-		((tui->rows+2) * sizeof(struct tui_raster_line))
+		((tui->rows+3) * sizeof(struct tui_raster_line)) /* cursor and scroll */
 	;
 }
 
@@ -218,11 +345,34 @@ size_t tui_screen_tpack(struct tui_context* tui,
 				front++;
 			}
 		}
+
+		if (opts.synch){
+			clear_dirty_rows(tui);
+			tui->scroll_hint.set = tui->scroll_hint.bad = false;
+		}
 	}
 
-/* delta update, find_row_ofs gives the next mismatch on the row */
+/* delta update, only rows marked by the drawing calls can differ and
+ * find_row_ofs gives the next mismatch on the row */
 	else if (tui->dirty & DIRTY_PARTIAL){
+		if (opts.synch){
+			size_t nb = emit_scroll(tui, &out[outsz]);
+			if (nb){
+				outsz += nb;
+				hdr.lines++;
+			}
+			tui->scroll_hint.set = tui->scroll_hint.bad = false;
+		}
+
 		for (size_t row = 0; row < tui->rows; row++){
+			if (tui->dirty_rows && !tui->dirty_rows[row >> 6]){
+				row |= 63;
+				continue;
+			}
+
+			if (!row_dirty(tui, row))
+				continue;
+
 			ssize_t ofs = find_row_ofs(tui, row, 0);
 			if (-1 == ofs)
 				continue;
@@ -277,6 +427,8 @@ size_t tui_screen_tpack(struct tui_context* tui,
 			hdr.lines++;
 		}
 
+		if (opts.synch)
+			clear_dirty_rows(tui);
 		hdr.flags |= RPACK_DFRAME;
 	}
 
@@ -410,6 +562,37 @@ void tui_screen_resized(struct tui_context* tui)
 	tui->dirty |= DIRTY_FULL;
 }
 
+/* same as scroll_px in raster.c, but on the cells of the front buffer */
+static void unpack_scroll(
+	struct tui_context* C, struct tui_raster_line* line, size_t y2)
+{
+	size_t top = line->start_line;
+	size_t bottom = (size_t) line->offset + 1 > y2 ? y2 : (size_t) line->offset + 1;
+	size_t mag = line->line_state;
+	if (top >= bottom ||
+		(line->scroll_dir != RSCROLL_UP && line->scroll_dir != RSCROLL_DOWN))
+		return;
+
+	struct tui_screen_attr empty = arcan_tui_defcattr(C, TUI_COL_BG);
+	if (mag >= bottom - top){
+		arcan_tui_eraseattr_region(C, 0, top, C->cols - 1, bottom - 1, false, empty);
+		return;
+	}
+
+	size_t keep = (bottom - top - mag) * C->cols * sizeof(struct tui_cell);
+	struct tui_cell* base = &C->front[top * C->cols];
+	tui_dirty_rows(C, top, bottom - 1);
+	if (line->scroll_dir == RSCROLL_UP){
+		memmove(base, &base[mag * C->cols], keep);
+		arcan_tui_eraseattr_region(C,
+			0, bottom - mag, C->cols - 1, bottom - 1, false, empty);
+	}
+	else {
+		memmove(&base[mag * C->cols], base, keep);
+		arcan_tui_eraseattr_region(C, 0, top, C->cols - 1, top + mag - 1, false, empty);
+	}
+}
+
 int tui_tpack_unpack(struct tui_context* C,
 	uint8_t* buf, size_t buf_sz, size_t x, size_t y, size_t x2, size_t y2)
 {
@@ -434,6 +617,12 @@ int tui_tpack_unpack(struct tui_context* C,
 	buf_sz -= sizeof(struct tui_raster_header);
 	buf += sizeof(struct tui_raster_header);
 
+/* the cursor color is only of interest to the raster */
+	if (hdr.cursor_state & CURSOR_EXTHDRv1){
+		buf_sz -= 3;
+		buf += 3;
+	}
+
 /* if it is not a delta frame, just clear region to bgcolor first and
  * make sure the window size match (unless w, h are set) */
 	if (!(hdr.flags & RPACK_DFRAME)){
@@ -485,31 +674,56 @@ int tui_tpack_unpack(struct tui_context* C,
 		memcpy(&line, buf, sizeof(struct tui_raster_line));
 		buf += sizeof(line);
 
+		if (line.scroll_dir && !line.ncells){
+			unpack_scroll(C, &line, y2);
+			continue;
+		}
+
+		bool touched = false;
 		for (size_t i = line.offset; line.ncells && buf_sz >= raster_cell_sz; i++){
 			line.ncells--;
 
 /* extract each cell */
 			struct tui_cell cell = rcell_to_cell(buf);
+			bool skip = buf[6] & CATTR_SKIP;
 			buf += raster_cell_sz;
 			buf_sz -= raster_cell_sz;
 
 /* just write cell into C if it is within the clipping region */
-			if (line.start_line < y2 && i < x2)
+			if (!skip && line.start_line < y2 && i < x2){
 				C->front[line.start_line * C->cols + i] = cell;
+				touched = true;
+			}
 		}
+
+/* only the rows the blob covers need to be diffed on the next refresh */
+		if (touched)
+			tui_dirty_rows(C, line.start_line, line.start_line);
 	}
 
-	C->dirty = DIRTY_FULL;
 	return 1;
 }
 
+int tui_screen_refresh_wait(struct tui_context* tui)
+{
+	if (!tui->refresh_ms)
+		return 0;
+
+	long long elapsed = arcan_timemillis() - tui->last_synch;
+	if (elapsed < 0 || elapsed >= tui->refresh_ms)
+		return 0;
+
+	return tui->refresh_ms - elapsed;
+}
+
 int tui_screen_refresh(struct tui_context* tui)
 {
 	if (tui->hooks.refresh){
 		tui->hooks.refresh(tui);
 	}
 
-	if (arcan_shmif_signalstatus(&tui->acon) != 0){
+	if (arcan_shmif_signalstatus(&tui->acon) != 0 ||
+		tui_screen_refresh_wait(tui) > 0){
 		errno = EAGAIN;
 		return -1;
 	}
@@ -517,6 +731,7 @@ int tui_screen_refresh(struct tui_context* tui)
 	size_t rv = tui_screen_tpack(tui,
 		(struct tpack_gen_opts){.synch = true}, tui->acon.vidb, tui->acon.vbufsize);
 	tui->dirty = DIRTY_NONE;
+	tui->last_synch = arcan_timemillis();
 
 	if (!rv)
 		return 0;
@@ -10,35 +10,39 @@
 
 void tui_queue_requests(struct tui_context* tui, bool clipboard, bool ident)
 {
+	struct arcan_event batch[4];
+	size_t count = 0;
+
 /* immediately request a clipboard for cut operations (none received ==
  * running appl doesn't care about cut'n'paste/drag'n'drop support). */
 /* and send a timer that will be used for cursor blinking when active */
 	if (clipboard)
-	arcan_shmif_enqueue(&tui->acon, &(struct arcan_event){
+	batch[count++] = (struct arcan_event){
 		.category = EVENT_EXTERNAL,
 		.ext.kind = ARCAN_EVENT(SEGREQ),
 		.ext.segreq.width = 1,
 		.ext.segreq.height = 1,
 		.ext.segreq.kind = SEGID_CLIPBOARD,
 		.ext.segreq.id = 0xfeedface
-	});
+	};
 
 /* always request a timer as the _tick callback may need it */
-	arcan_shmif_enqueue(&tui->acon, &(struct arcan_event){
+	batch[count++] = (struct arcan_event){
 		.category = EVENT_EXTERNAL,
 		.ext.kind = ARCAN_EVENT(CLOCKREQ),
 		.ext.clock.rate = 1,
 		.ext.clock.id = 0xabcdef00,
-	});
+	};
 
 /* ident is only set on crash recovery */
 	if (ident){
 		if (tui->last_ident.ext.kind != 0)
-			arcan_shmif_enqueue(&tui->acon, &tui->last_ident);
+			batch[count++] = tui->last_ident;
 
-		arcan_shmif_enqueue(&tui->acon, &tui->last_state_sz);
+		batch[count++] = tui->last_state_sz;
 	}
 
+	arcan_shmif_enqueue_v(&tui->acon, batch, count);
 	tui_expose_labels(tui);
 }
 
@@ -57,6 +61,15 @@ static void apply_arg(struct tui_context* src, struct arg_arr* args)
 	const char* val = NULL;
 	if (arg_lookup(args, "bgalpha", 0, &val) && val)
 		src->alpha = strtoul(val, NULL, 10);
+
+	if (arg_lookup(args, "raster_threads", 0, &val) && val)
+		src->raster_threads = strtoul(val, NULL, 10);
+
+	if (arg_lookup(args, "fps", 0, &val) && val){
+		unsigned long fps = strtoul(val, NULL, 10);
+		src->refresh_ms = fps ? 1000 / fps : 0;
+		src->refresh_fixed = true;
+	}
 }
 
 arcan_tui_conn* arcan_tui_open_display(const char* title, const char* ident)
@@ -115,7 +128,9 @@ void arcan_tui_destroy(struct tui_context* tui, const char* message)
 		arcan_shmif_drop(&tui->acon);
 	}
 
+	tui_fontmgmt_release(tui);
 	free(tui->base);
+	free(tui->dirty_rows);
 
 	memset(tui, '\0', sizeof(struct tui_context));
 	free(tui);
@@ -242,7 +257,9 @@ static bool late_bind(
 	if (!res->cell_h)
 		res->cell_h = 8;
 
-	tui_fontmgmt_setup(res, init);
+/* a sub-window already shares the fonts of its parent */
+	if (!res->font[0])
+		tui_fontmgmt_setup(res, init);
 
 	arcan_shmif_mousestate_setup(&res->acon, false, res->mouse_state);
 	res->acon.hints = SHMIF_RHINT_TPACK | SHMIF_RHINT_VSIGNAL_EV;
@@ -351,18 +368,9 @@ struct tui_context* arcan_tui_setup(
 		res->alpha = parent->alpha;
 		res->cursor = parent->cursor;
 		res->ppcm = parent->ppcm;
+		res->raster_threads = parent->raster_threads;
 
-		tui_fontmgmt_setup(res, &(struct arcan_shmif_initial){
-			.fonts = {
-				{
-					.size_mm = parent->font_sz,
-					.fd = arcan_shmif_dupfd(parent->font[0]->fd, -1, true)
-				},
-				{
-					.size_mm = parent->font_sz,
-					.fd = arcan_shmif_dupfd(parent->font[1]->fd, -1, true)
-				}
-		}});
+		tui_fontmgmt_inherit(res, parent);
 
 		if (parent->pending_handover){
 			res->viewport_proxy = parent->pending_handover;
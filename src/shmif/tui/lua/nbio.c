@@ -25,6 +25,7 @@
 #include <sys/wait.h>
 #include <sys/un.h>
 #include <sys/poll.h>
+#include <sys/uio.h>
 
 #include <lua.h>
 #include <lualib.h>
@@ -35,8 +36,25 @@
 
 #if LUA_VERSION_NUM == 501
 	#define lua_rawlen(x, y) lua_objlen(x, y)
+	#define nbio_resume(co, from, n) lua_resume(co, n)
+#elif LUA_VERSION_NUM < 504
+	#define nbio_resume(co, from, n) lua_resume(co, from, n)
+#else
+static int nbio_resume(lua_State* co, lua_State* from, int n)
+{
+	int nres;
+	return lua_resume(co, from, n, &nres);
+}
 #endif
 
+/* queued jobs gathered into one writev */
+#define NBIO_IOV 16
+
+/* :await buffer, initial size for delimiter mode and the upper bound after
+ * which the data is forwarded without the delimiter */
+#define NBIO_AWAIT_BASE 16384
+#define NBIO_AWAIT_CAP (16 * 1024 * 1024)
+
 static void check_canary(struct nonblock_io* ib)
 {
 	if (ib->canary_pre != 0xfeedface || ib->canary_post != 0xfacefeed)
@@ -239,28 +257,42 @@ int alt_nbio_process_write(lua_State* L, struct nonblock_io* ib)
 	check_canary(ib);
 
 	while (job){
-		ssize_t nw = write(ib->fd, &job->buf[job->ofs], job->sz - job->ofs);
+		struct iovec iov[NBIO_IOV];
+		int n = 0;
+
+/* many small writes (e.g. table form of :write) go out in one call */
+		for (struct io_job* cur = job; cur && n < NBIO_IOV; cur = cur->next){
+			iov[n++] = (struct iovec){
+				.iov_base = &cur->buf[cur->ofs],
+				.iov_len = cur->sz - cur->ofs
+			};
+		}
+
+		ssize_t nw = writev(ib->fd, iov, n);
 		if (-1 == nw){
 			if (errno == EINTR || errno == EAGAIN)
 				return 0;
 			return -1;
 		}
 
-		job->ofs += nw;
 		ib->out_count += nw;
 
-/* slide on completion */
-		if (job->ofs == job->sz){
+/* slide on completion, a short write leaves the job it stopped in */
+		while (job && (size_t) nw >= job->sz - job->ofs){
+			nw -= job->sz - job->ofs;
 			ib->out_queued -= job->sz;
 			ib->out_queue = job->next;
 			arcan_mem_free(job->buf);
 			arcan_mem_free(job);
 			job = ib->out_queue;
+		}
+
+		if (job)
+			job->ofs += nw;
 
 /* edge case, all jobs have been finished and the tail is dropped */
-			if (!job)
-				ib->out_queue_tail = &ib->out_queue;
-		}
+		else
+			ib->out_queue_tail = &ib->out_queue;
 	}
 
 /* when no more jobs, return true -> trigger callback */
@@ -329,8 +361,15 @@ int alt_nbio_close(lua_State* L, struct nonblock_io** ibb)
 	}
 
 	free(ib->pending);
+	free(ib->abuf);
 	drop_all_jobs(ib);
 
+/* a coroutine suspended in :await will simply never be resumed */
+	if (ib->awaiting){
+		luaL_unref(L, LUA_REGISTRYINDEX, ib->await_thread);
+		ib->awaiting = false;
+	}
+
 	if (ib->data_handler != LUA_NOREF){
 		unref_registry(L, ib->data_handler, LUA_TFUNCTION, "nbio_close_dh");
 		ib->data_handler = LUA_NOREF;
@@ -394,6 +433,10 @@ static int nbio_datahandler(lua_State* L)
 	if (!(*ib))
 		LUA_ETRACE("open_nonblock:data_handler", "already closed", 0);
 
+/* both use the read job slot */
+	if ((*ib)->awaiting)
+		arcan_fatal("open_nonblock:data_handler, :await is pending");
+
 /* always remove the last known handler refs */
 	if ((*ib)->data_handler != LUA_NOREF){
 		unref_registry(L, (*ib)->data_handler, LUA_TFUNCTION, "nbio-dh-reset");
@@ -847,6 +890,260 @@ int alt_nbio_process_read(
 	}
 }
 
+static bool await_grow(struct nonblock_io* ib, size_t sz)
+{
+	if (ib->abuf_sz >= sz)
+		return true;
+
+	char* buf = realloc(ib->abuf, sz);
+	if (!buf)
+		return false;
+
+	ib->abuf = buf;
+	ib->abuf_sz = sz;
+	return true;
+}
+
+/* check if the await condition holds, [nb] is the number of bytes to return
+ * and [step] the number of bytes to consume */
+static bool await_ready(struct nonblock_io* ib, size_t* nb, size_t* step)
+{
+	if (ib->await_n){
+		if (ib->abuf_used < ib->await_n)
+			return false;
+		*nb = *step = ib->await_n;
+		return true;
+	}
+
+/* continue scanning where the last pass stopped */
+	size_t dl = ib->await_dlen;
+	size_t i = ib->await_scan;
+
+	while (i + dl <= ib->abuf_used){
+		char* pos = memchr(&ib->abuf[i], ib->await_delim[0], ib->abuf_used - dl + 1 - i);
+		if (!pos)
+			break;
+
+		i = pos - ib->abuf;
+		if (memcmp(pos, ib->await_delim, dl) == 0){
+			*step = i + dl;
+			*nb = ib->lfstrip ? i : i + dl;
+			ib->await_scan = 0;
+			return true;
+		}
+		i++;
+	}
+	ib->await_scan = ib->abuf_used >= dl ? ib->abuf_used - dl + 1 : 0;
+
+/* hit the buffering limit, forward without waiting for the delimiter */
+	if (ib->abuf_used >= NBIO_AWAIT_CAP){
+		*nb = *step = ib->abuf_used;
+		ib->await_scan = 0;
+		return true;
+	}
+
+	return false;
+}
+
+/* move whatever can be read into the await buffer, returns false on eof */
+static bool await_fill(struct nonblock_io* ib)
+{
+/* anything left in the line buffer from :read comes first */
+	if (ib->ofs){
+		if (!await_grow(ib, ib->abuf_used + ib->ofs))
+			return true;
+		memcpy(&ib->abuf[ib->abuf_used], ib->buf, ib->ofs);
+		ib->abuf_used += ib->ofs;
+		ib->ofs = 0;
+	}
+
+	for(;;){
+		size_t want;
+
+/* fixed size reads go straight into the preallocated buffer and never read
+ * past what was asked for */
+		if (ib->await_n){
+			if (ib->abuf_used >= ib->await_n)
+				return true;
+			want = ib->await_n - ib->abuf_used;
+		}
+		else {
+			if (ib->abuf_used == ib->abuf_sz){
+				size_t sz = ib->abuf_sz ? ib->abuf_sz * 2 : NBIO_AWAIT_BASE;
+				if (sz > NBIO_AWAIT_CAP)
+					sz = NBIO_AWAIT_CAP;
+				if (ib->abuf_used >= sz || !await_grow(ib, sz))
+					return true;
+			}
+			want = ib->abuf_sz - ib->abuf_used;
+		}
+
+		ssize_t nr = read(ib->fd, &ib->abuf[ib->abuf_used], want);
+		if (0 == nr)
+			return false;
+
+		if (-1 == nr){
+			if (errno == EINTR)
+				continue;
+			return errno == EAGAIN;
+		}
+
+		ib->abuf_used += nr;
+
+/* one read per pass so the delimiter gets checked */
+		if (!ib->await_n)
+			return true;
+	}
+}
+
+/* try to complete the await, pushing data, alive to [L] if it did */
+static bool await_step(lua_State* L, struct nonblock_io* ib)
+{
+	size_t nb = 0, step = 0;
+	bool alive = true;
+
+	for(;;){
+		if (await_ready(ib, &nb, &step))
+			break;
+
+		size_t used = ib->abuf_used;
+		if (!(alive = await_fill(ib))){
+			nb = step = ib->abuf_used;
+			break;
+		}
+
+		if (ib->abuf_used == used)
+			return false;
+	}
+	check_canary(ib);
+
+	if (nb)
+		lua_pushlstring(L, ib->abuf, nb);
+	else
+		lua_pushnil(L);
+	lua_pushboolean(L, alive);
+
+	memmove(ib->abuf, &ib->abuf[step], ib->abuf_used - step);
+	ib->abuf_used -= step;
+	return true;
+}
+
+static int nbio_await(lua_State* L)
+{
+	LUA_TRACE("open_nonblock:await");
+	struct nonblock_io** ib = luaL_checkudata(L, 1, "nonblockIO");
+	struct nonblock_io* ir = *ib;
+
+	if (!ir)
+		LUA_ETRACE("open_nonblock:await", "already closed", 0);
+
+	if (ir->mode == O_WRONLY)
+		LUA_ETRACE("open_nonblock:await", "invalid mode (w) for read", 0);
+
+	if (ir->awaiting)
+		arcan_fatal("open_nonblock:await, already awaiting");
+
+	if (ir->data_handler != LUA_NOREF)
+		arcan_fatal("open_nonblock:await, can't be combined with a data_handler");
+
+	if (lua_type(L, 2) == LUA_TNUMBER){
+		lua_Number n = lua_tonumber(L, 2);
+		if (n < 1 || n > NBIO_AWAIT_CAP)
+			arcan_fatal("open_nonblock:await(n), n out of range (1..%d)", NBIO_AWAIT_CAP);
+
+		ir->await_n = n;
+		ir->await_dlen = 0;
+		if (!await_grow(ir, ir->await_n)){
+			lua_pushnil(L);
+			lua_pushboolean(L, true);
+			LUA_ETRACE("open_nonblock:await", "out of memory", 2);
+		}
+	}
+	else {
+		size_t len;
+		const char* delim = luaL_optlstring(L, 2, "\n", &len);
+		if (!len || len > COUNT_OF(ir->await_delim))
+			arcan_fatal("open_nonblock:await(delim), delimiter length out of range "
+				"(1..%zu)", COUNT_OF(ir->await_delim));
+
+		memcpy(ir->await_delim, delim, len);
+		ir->await_dlen = len;
+		ir->await_scan = 0;
+		ir->await_n = 0;
+	}
+
+	if (await_step(L, ir))
+		LUA_ETRACE("open_nonblock:await", NULL, 2);
+
+/* nothing yet, suspend the calling coroutine until alt_nbio_data_in can
+ * complete the await */
+	if (lua_pushthread(L)){
+		lua_pop(L, 1);
+		arcan_fatal("open_nonblock:await, called outside of a coroutine");
+	}
+	intptr_t thread = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	intptr_t ref;
+	if (remove_job(ir->fd, O_RDONLY, &ref)){
+		unref_registry(L, ref, LUA_TUSERDATA, "nbio-await-reset");
+	}
+
+	lua_pushvalue(L, 1);
+	ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	if (!add_job(ir->fd, O_RDONLY, ref)){
+		unref_registry(L, ref, LUA_TUSERDATA, "nbio-await-fail");
+		luaL_unref(L, LUA_REGISTRYINDEX, thread);
+		lua_pushnil(L);
+		lua_pushboolean(L, false);
+		LUA_ETRACE("open_nonblock:await", "couldn't queue job", 2);
+	}
+
+	ir->await_thread = thread;
+	ir->awaiting = true;
+	return lua_yield(L, 0);
+}
+
+/* run through alt_call so errors in the coroutine are handled the same way as
+ * those in any other callback */
+static int await_trampoline(lua_State* L)
+{
+	lua_State* co = lua_tothread(L, 1);
+	int rv = nbio_resume(co, L, 2);
+
+	if (rv != 0 && rv != LUA_YIELD){
+		lua_xmove(co, L, 1);
+		return lua_error(L);
+	}
+
+	return 0;
+}
+
+/* the descriptor of a pending await is readable, resume if it completes */
+static void await_resume(lua_State* L, struct nonblock_io* ib)
+{
+	lua_rawgeti(L, LUA_REGISTRYINDEX, ib->await_thread);
+	lua_State* co = lua_tothread(L, -1);
+
+	if (!co || !await_step(co, ib)){
+		lua_pop(L, 1);
+		return;
+	}
+
+/* the coroutine is free to await again, so reset before resuming - the copy
+ * on the stack keeps it alive until the call */
+	ib->awaiting = false;
+	luaL_unref(L, LUA_REGISTRYINDEX, ib->await_thread);
+
+	intptr_t tag;
+	if (remove_job(ib->fd, O_RDONLY, &tag)){
+		unref_registry(L, tag, LUA_TUSERDATA, "nbio-await-done");
+	}
+
+	lua_pushcfunction(L, await_trampoline);
+	lua_insert(L, -2);
+	alt_call(L, CB_SOURCE_NONE, 0, 1, 0, LINE_TAG":await_resume");
+}
+
 static int nbio_lf(lua_State* L)
 {
 	LUA_TRACE("open_nonblock:lf_strip")
@@ -1202,6 +1499,11 @@ void alt_nbio_data_in(lua_State* L, intptr_t tag)
 		return;
 
 	lua_pop(L, 1);
+	if (ib->awaiting){
+		await_resume(L, ib);
+		return;
+	}
+
 	if (!lookup_registry(L, ib->data_handler, LUA_TFUNCTION, "data-in-dh"))
 		return;
 
@@ -1370,6 +1672,8 @@ void alt_nbio_register(lua_State* L,
 	lua_setfield(L, -2, "flush");
 	lua_pushcfunction(L, nbio_lf);
 	lua_setfield(L, -2, "lf_strip");
+	lua_pushcfunction(L, nbio_await);
+	lua_setfield(L, -2, "await");
 	lua_pop(L, 1);
 
 	luaL_newmetatable(L, "nonblockIOs");
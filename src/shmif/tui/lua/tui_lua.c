@@ -2039,6 +2039,203 @@ out:
 	return 3;
 }
 
+/*
+ * write_rows(x, y, str, [fmt]) or write_rows(x, y, {row, row, ...})
+ *
+ * Bulk form of write_to for drawing whole regions in one call. In the string
+ * form rows are separated by \n and [fmt] is {ofs, attr, ofs, attr, ...} with
+ * byte offsets (0 based) into [str] where [attr] takes effect, a non-table
+ * attr reverts to the default. In the table form each row is a string or
+ * {str, ofs, attr, ...} with offsets relative to the row. Rows are clipped to
+ * the screen and written as attribute runs, see arcan_tui_writeu8_runs.
+ */
+#define ROWS_RUNS 64
+#define ROWS_ATTR_CACHE 32
+
+struct rows_state {
+	struct tui_context* tui;
+	bool ok;
+
+/* current position in the fmt table and the attribute in effect */
+	int fmt;
+	size_t fmt_i;
+	size_t next_ofs;
+	bool def;
+	struct tui_screen_attr cur;
+
+/* the same attribute tables tend to be reused across runs and rows */
+	const void* keys[ROWS_ATTR_CACHE];
+	struct tui_screen_attr cache[ROWS_ATTR_CACHE];
+	size_t cache_pos;
+
+	size_t n_runs;
+	struct tui_attr_run runs[ROWS_RUNS];
+	struct tui_screen_attr attrs[ROWS_RUNS];
+};
+
+static void rows_fetch_ofs(lua_State* L, struct rows_state* s)
+{
+	s->next_ofs = SIZE_MAX;
+	if (!s->fmt)
+		return;
+
+	lua_rawgeti(L, s->fmt, s->fmt_i);
+	int type = lua_type(L, -1);
+	if (type == LUA_TNUMBER){
+		lua_Number ofs = lua_tonumber(L, -1);
+		s->next_ofs = ofs < 0 ? 0 : ofs;
+	}
+	else if (type != LUA_TNIL)
+		luaL_error(L, "write_rows(), fmt should be {ofs, attr, ofs2, attr2, ...}");
+	lua_pop(L, 1);
+}
+
+static void rows_apply(lua_State* L, struct rows_state* s)
+{
+	lua_rawgeti(L, s->fmt, s->fmt_i + 1);
+
+	if (lua_type(L, -1) == LUA_TTABLE){
+		const void* key = lua_topointer(L, -1);
+		size_t i = 0;
+		for (; i < ROWS_ATTR_CACHE && s->keys[i] != key; i++){}
+
+		if (i == ROWS_ATTR_CACHE){
+			i = s->cache_pos;
+			s->cache_pos = (s->cache_pos + 1) % ROWS_ATTR_CACHE;
+			s->keys[i] = key;
+			apply_table(L, lua_gettop(L), &s->cache[i]);
+		}
+
+		s->cur = s->cache[i];
+		s->def = false;
+	}
+	else
+		s->def = true;
+
+	lua_pop(L, 1);
+	s->fmt_i += 2;
+	rows_fetch_ofs(L, s);
+}
+
+static void rows_flush(struct rows_state* s, const char* str, size_t len)
+{
+	if (s->n_runs && len)
+		s->ok &= arcan_tui_writeu8_runs(s->tui, (const uint8_t*) str, len, s->runs, s->n_runs);
+	s->n_runs = 0;
+}
+
+/* write bytes [b0, b1) of [str] at the cursor as at most [lim] cells */
+static void rows_span(lua_State* L,
+	struct rows_state* s, const char* str, size_t b0, size_t b1, size_t lim)
+{
+	size_t end = b0, cells = 0;
+	for (; end < b1; end++){
+		if (((uint8_t) str[end] & 0xc0) != 0x80){
+			if (cells == lim)
+				break;
+			cells++;
+		}
+	}
+
+	size_t pos = b0, start = b0;
+	while (pos < end){
+		while (s->next_ofs <= pos)
+			rows_apply(L, s);
+
+		size_t stop = s->next_ofs < end ? s->next_ofs : end;
+		s->attrs[s->n_runs] = s->cur;
+		s->runs[s->n_runs] = (struct tui_attr_run){
+			.len = stop - pos,
+			.attr = s->def ? NULL : &s->attrs[s->n_runs]
+		};
+		s->n_runs++;
+		pos = stop;
+
+/* the cursor advances with the write so a long row can go out in parts */
+		if (s->n_runs == ROWS_RUNS){
+			rows_flush(s, &str[start], pos - start);
+			start = pos;
+		}
+	}
+
+	rows_flush(s, &str[start], pos - start);
+}
+
+static int write_rows(lua_State* L)
+{
+	TUI_UDATA;
+	size_t x = luaL_checkinteger(L, 2);
+	size_t y = luaL_checkinteger(L, 3);
+	size_t rows, cols;
+	arcan_tui_dimensions(ib->tui, &rows, &cols);
+
+	struct rows_state s = {
+		.tui = ib->tui,
+		.ok = true,
+		.def = true
+	};
+
+	if (x >= cols){
+		lua_pushboolean(L, true);
+		return 1;
+	}
+	size_t lim = cols - x;
+
+	if (lua_type(L, 4) == LUA_TSTRING){
+		size_t len;
+		const char* str = lua_tolstring(L, 4, &len);
+		if (lua_type(L, 5) == LUA_TTABLE){
+			s.fmt = 5;
+			s.fmt_i = 1;
+		}
+		rows_fetch_ofs(L, &s);
+
+		size_t pos = 0;
+		for (size_t row = y; row < rows; row++){
+			const char* nl = memchr(&str[pos], '\n', len - pos);
+			size_t end = nl ? (size_t)(nl - str) : len;
+
+			arcan_tui_move_to(ib->tui, x, row);
+			rows_span(L, &s, str, pos, end, lim);
+
+			if (!nl)
+				break;
+			pos = end + 1;
+		}
+	}
+	else {
+		luaL_checktype(L, 4, LUA_TTABLE);
+		size_t n = lua_rawlen(L, 4);
+		int top = lua_gettop(L);
+
+		for (size_t i = 0; i < n && y + i < rows; i++){
+			lua_rawgeti(L, 4, i + 1);
+			s.def = true;
+			s.fmt = 0;
+
+			if (lua_type(L, -1) == LUA_TTABLE){
+				s.fmt = lua_gettop(L);
+				s.fmt_i = 2;
+				lua_rawgeti(L, s.fmt, 1);
+			}
+
+			if (lua_type(L, -1) != LUA_TSTRING)
+				luaL_error(L, "write_rows(), row should be str or {str, ofs, attr, ...}");
+
+			size_t len;
+			const char* str = lua_tolstring(L, -1, &len);
+			rows_fetch_ofs(L, &s);
+
+			arcan_tui_move_to(ib->tui, x, y + i);
+			rows_span(L, &s, str, 0, len, lim);
+			lua_settop(L, top);
+		}
+	}
+
+	lua_pushboolean(L, s.ok);
+	return 1;
+}
+
 static int writeu8(lua_State* L)
 {
 	TUI_UDATA;
@@ -2865,14 +3062,14 @@ static int readline_set(lua_State* L)
 		struct tui_screen_attr* attr = malloc(count * sizeof(struct tui_screen_attr));
 
 		for (size_t i = 0; i < count; i++){
-			lua_rawgeti(L, ind, i * 2);
+			lua_rawgeti(L, ind, i * 2 + 1);
 			if (lua_type(L, -1) != LUA_TNUMBER){
 				luaL_error(L, "readline:set(>table<) expected ch offset number");
 			}
 			ofs[i] = lua_tonumber(L, -1);
 			lua_pop(L, 1);
 
-			lua_rawgeti(L, ind, i * 2 + 1);
+			lua_rawgeti(L, ind, i * 2 + 2);
 			if (lua_type(L, -1) != LUA_TTABLE){
 				luaL_error(L, "readline:set(>table<) expected attribute table");
 			}
@@ -3497,6 +3694,7 @@ static void register_tuimeta(lua_State* L)
 		{"refresh", refresh},
 		{"write", writeu8},
 		{"write_to", write_tou8},
+		{"write_rows", write_rows},
 		{"write_border", write_border},
 		{"get", getxy},
 		{"set_handlers", settbl},
@@ -29,7 +29,7 @@ static bool tryload_truetype(struct tui_context* tui,
 
 	LOG("open_font(%zu pt, %f dpi)\n", pt_size, dpi);
 
-/* free pre-existing font / cache */
+/* free pre-existing font / cache, re-opening for a new size keeps the fd */
 	if (tui->font[slot]->vector){
 		TTF_CloseFont(tui->font[slot]->truetype);
 	}
@@ -37,6 +37,9 @@ static bool tryload_truetype(struct tui_context* tui,
 		tui_pixelfont_close(tui->font[slot]->bitmap);
 	}
 
+	if (tui->font[slot]->fd != -1 && tui->font[slot]->fd != fd)
+		close(tui->font[slot]->fd);
+
 	tui->font[slot]->truetype = font;
 	tui->font[slot]->fd = fd;
 	tui->font[slot]->vector = true;
@@ -97,7 +100,14 @@ static bool tryload_bitmap(struct tui_context* tui, int fd, int mode, size_t px_
 	if (tui->font[0]->vector){
 		if (tui->font[0]->truetype)
 			TTF_CloseFont(tui->font[0]->truetype);
+		if (tui->font[0]->fd != -1)
+			close(tui->font[0]->fd);
+		tui->font[0]->fd = -1;
 		tui->font[0]->vector = false;
+		tui->font[0]->bitmap = NULL;
+	}
+
+	if (!tui->font[0]->bitmap){
 		tui->font[0]->bitmap = tui_pixelfont_open(64);
 		if (!tui->font[0]->bitmap)
 			goto out;
@@ -148,6 +158,7 @@ static bool setup_font(
 	if (fd != BADFD){
 		if (tryload_bitmap(tui, fd, modeind, px_sz)){
 			size_t w, h;
+			close(fd);
 			tui_pixelfont_setsz(tui->font[0]->bitmap, px_sz, &w, &h);
 			tui->cell_w = w;
 			tui->cell_h = h;
@@ -167,7 +178,10 @@ static bool setup_font(
 		}
 		else {
 			size_t w = 0, h = 0;
-			tui->font[0]->bitmap = tui_pixelfont_open(64);
+			if (!tui->font[0]->bitmap)
+				tui->font[0]->bitmap = tui_pixelfont_open(64);
+			if (!tui->font[0]->bitmap)
+				return false;
 			tui_pixelfont_setsz(tui->font[0]->bitmap, px_sz, &w, &h);
 			tui->cell_w = w;
 			tui->cell_h = h;
@@ -232,26 +246,98 @@ void tui_fontmgmt_invalidate(struct tui_context* tui)
 	tui->dirty = DIRTY_FULL;
 }
 
-void tui_fontmgmt_inherit(struct tui_context* tui, struct tui_context* parent)
-{
-}
-
-void tui_fontmgmt_setup(
-	struct tui_context* tui, struct arcan_shmif_initial* init)
-{
 /* we track the allocation here in order to not have to pull in TTF_Font, ...
  * in all of the translation units, keeping tui_font opaque in tui_init, it's
  * part of the refactoring bits in that fontmgmt itself can be removed when
  * server-side */
+static bool alloc_fonts(struct tui_context* tui)
+{
 	size_t font_sz = sizeof(struct tui_font) * 2;
 	struct tui_font* fonts = malloc(font_sz);
 	if (!fonts)
-		return;
+		return false;
 
 	memset(fonts, '\0', font_sz);
+	fonts[0].fd = fonts[1].fd = -1;
 	tui->font[0] = &fonts[0];
 	tui->font[1] = &fonts[1];
 	tui->hint = TTF_HINTING_NORMAL;
+	return true;
+}
+
+/*
+ * Both font kinds are shared process-wide: truetype through the font cache in
+ * arcan_ttf (file identity, size, density, forked on style and hinting) and
+ * bitmap through the decoded font cache in pixelfont, so a sub-window costs
+ * references rather than another set of glyphs.
+ */
+void tui_fontmgmt_inherit(struct tui_context* tui, struct tui_context* parent)
+{
+	if (!parent->font[0] || !alloc_fonts(tui))
+		return;
+
+	tui->hint = parent->hint;
+	tui->font_sz = parent->font_sz;
+	tui->cell_w = parent->cell_w;
+	tui->cell_h = parent->cell_h;
+
+	if (parent->font[0]->vector){
+		size_t pt_size = roundf((float)tui->font_sz * 2.8346456693f);
+		if (pt_size < 4)
+			pt_size = 4;
+
+		for (size_t i = 0; i < 2; i++){
+			if (!parent->font[i]->vector || !parent->font[i]->truetype)
+				continue;
+
+			int fd = arcan_shmif_dupfd(parent->font[i]->fd, -1, true);
+			if (-1 == fd)
+				continue;
+
+			if (!tryload_truetype(tui, fd, i, pt_size, tui->ppcm * 2.54f))
+				close(fd);
+		}
+	}
+	else if (parent->font[0]->bitmap)
+		tui->font[0]->bitmap = tui_pixelfont_clone(parent->font[0]->bitmap);
+
+/* nothing could be shared, fall back to the builtin */
+	if (!tui->font[0]->truetype)
+		setup_font(tui, BADFD, tui->font_sz, 0);
+
+	tui->raster = tui_raster_setup(tui->cell_w, tui->cell_h);
+	tui_raster_setfont(tui->raster, tui->font, 2);
+	tui_raster_threads(tui->raster, tui->raster_threads);
+}
+
+void tui_fontmgmt_release(struct tui_context* tui)
+{
+	if (!tui->font[0])
+		return;
+
+	for (size_t i = 0; i < 2; i++){
+		if (tui->font[i]->vector && tui->font[i]->truetype)
+			TTF_CloseFont(tui->font[i]->truetype);
+		else if (!tui->font[i]->vector && tui->font[i]->bitmap)
+			tui_pixelfont_close(tui->font[i]->bitmap);
+
+		if (tui->font[i]->fd != -1)
+			close(tui->font[i]->fd);
+	}
+
+	tui_raster_free(tui->raster);
+	tui->raster = NULL;
+
+/* both slots come from the same allocation */
+	free(tui->font[0]);
+	tui->font[0] = tui->font[1] = NULL;
+}
+
+void tui_fontmgmt_setup(
+	struct tui_context* tui, struct arcan_shmif_initial* init)
+{
+	if (!alloc_fonts(tui))
+		return;
 
 	if (init){
 		setup_font(tui, init->fonts[0].fd, init->fonts[0].size_mm, 0);
@@ -268,4 +354,5 @@ void tui_fontmgmt_setup(
 
 	tui->raster = tui_raster_setup(tui->cell_w, tui->cell_h);
 	tui_raster_setfont(tui->raster, tui->font, 2);
+	tui_raster_threads(tui->raster, tui->raster_threads);
 }
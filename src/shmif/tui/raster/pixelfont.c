@@ -6,6 +6,7 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
 
 /*
  * builtin- fonts to load on init, see tui_draw_init()
@@ -57,13 +58,28 @@ struct glyph_ent {
 	UT_hash_handle hh;
 };
 
+/*
+ * A decoded font is immutable and kept in a process-wide cache keyed on the
+ * contents it was decoded from, so every container (one per tui context and
+ * more on the engine side) that loads the same font shares glyphs and lookup.
+ */
 struct bitmap_font {
 	uint8_t* fontdata;
 	size_t chsz, w, h;
 	size_t n_glyphs;
+
+	uint64_t key;
+	size_t key_sz;
+	size_t refs;
+	struct bitmap_font* next;
+
+	struct glyph_ent* ht;
 	struct glyph_ent glyphs[0];
 };
 
+static struct bitmap_font* font_cache;
+static pthread_mutex_t font_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static bool psf2_decode_header(
 	const uint8_t* const buf, size_t buf_sz,
 	size_t* glyph_count, size_t* glyph_bytes, size_t* w, size_t* h, size_t* ofs)
@@ -98,8 +114,7 @@ static bool psf2_decode_header(
 /*
  * support a subset of PSF(v2), no ranges in the unicode- table
  */
-static struct bitmap_font* open_psf2(
-	const uint8_t* const buf, size_t buf_sz, struct glyph_ent** ht)
+static struct bitmap_font* open_psf2(const uint8_t* const buf, size_t buf_sz)
 {
 	size_t glyph_count, glyph_bytes, w, h, ofs;
 
@@ -116,8 +131,11 @@ static struct bitmap_font* open_psf2(
 		sizeof(struct glyph_ent) * unicodecount +
 		glyphbuf_sz
 	);
+	if (!res)
+		return NULL;
 
 /* read in the raw font-data */
+	res->ht = NULL;
 	res->chsz = glyph_bytes;
 	res->w = w;
 	res->h = h;
@@ -153,7 +171,7 @@ static struct bitmap_font* open_psf2(
 			res->glyphs[res->n_glyphs].data = &res->fontdata[glyph_bytes*ind];
 
 			struct glyph_ent* repl;
-			HASH_REPLACE_INT(*ht, codepoint, &res->glyphs[res->n_glyphs], repl);
+			HASH_REPLACE_INT(res->ht, codepoint, &res->glyphs[res->n_glyphs], repl);
 			res->n_glyphs++;
 			state = 0;
 			codepoint = 0;
@@ -164,15 +182,71 @@ static struct bitmap_font* open_psf2(
 	return res;
 }
 
+static uint64_t font_key(const uint8_t* const buf, size_t buf_sz)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < buf_sz; i++){
+		hash ^= buf[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static struct bitmap_font* font_acquire(const uint8_t* const buf, size_t buf_sz)
+{
+	uint64_t key = font_key(buf, buf_sz);
+	pthread_mutex_lock(&font_cache_lock);
+
+	struct bitmap_font* res = font_cache;
+	for (; res; res = res->next){
+		if (res->key == key && res->key_sz == buf_sz){
+			res->refs++;
+			goto out;
+		}
+	}
+
+	res = open_psf2(buf, buf_sz);
+	if (res){
+		res->key = key;
+		res->key_sz = buf_sz;
+		res->refs = 1;
+		res->next = font_cache;
+		font_cache = res;
+	}
+
+out:
+	pthread_mutex_unlock(&font_cache_lock);
+	return res;
+}
+
+static void font_release(struct bitmap_font* font)
+{
+	pthread_mutex_lock(&font_cache_lock);
+	if (--font->refs){
+		pthread_mutex_unlock(&font_cache_lock);
+		return;
+	}
+
+	struct bitmap_font** cur = &font_cache;
+	while (*cur != font)
+		cur = &(*cur)->next;
+	*cur = font->next;
+	pthread_mutex_unlock(&font_cache_lock);
+
+	HASH_CLEAR(hh, font->ht);
+	free(font);
+}
+
 /*
- * Fixed size font/glyph container
+ * Fixed size font/glyph container, fonts merged into a size slot are chained
+ * newest first after the one that defines the slot so that they can override
+ * glyphs without modifying the shared lookup of the first.
  */
 #define MAX_BITMAP_FONTS 64
 struct font_entry {
 	size_t sz;
 	struct bitmap_font* font;
-	bool shared_ht;
-	struct glyph_ent* ht;
+	struct font_entry* merged;
 };
 
 struct tui_pixelfont {
@@ -187,16 +261,39 @@ bool tui_pixelfont_valid(uint8_t* buf, size_t buf_sz)
 	return psf2_decode_header(buf, buf_sz, NULL, NULL, NULL, NULL, NULL);
 }
 
+static void release_entry(struct font_entry* ent)
+{
+	struct font_entry* cur = ent->merged;
+	while (cur){
+		struct font_entry* next = cur->merged;
+		font_release(cur->font);
+		free(cur);
+		cur = next;
+	}
+
+	font_release(ent->font);
+	*ent = (struct font_entry){0};
+}
+
+static struct glyph_ent* find_glyph(struct font_entry* ent, uint32_t cp)
+{
+	struct glyph_ent* gent = NULL;
+	for (struct font_entry* cur = ent->merged; cur && !gent; cur = cur->merged)
+		HASH_FIND_INT(cur->font->ht, &cp, gent);
+
+	if (!gent)
+		HASH_FIND_INT(ent->font->ht, &cp, gent);
+
+	return gent;
+}
+
 /*
- * if there's a match for this size slot, then we share the hash lookup and the
- * new font act as an override for missing glyphs. This means that it is not
- * safe to just free a font (not that we do that anyhow).
+ * if there's a match for this size slot, the new font is chained to it and
+ * acts as an override for existing glyphs.
  */
 bool tui_pixelfont_load(struct tui_pixelfont* ctx,
 	uint8_t* buf, size_t buf_sz, size_t px_sz, bool merge)
 {
-	struct glyph_ent** ht = NULL;
-
 /* don't waste time with a font we can't decode */
 	if (!psf2_decode_header(buf, buf_sz, NULL, NULL, NULL, NULL, NULL))
 		return false;
@@ -204,14 +301,31 @@ bool tui_pixelfont_load(struct tui_pixelfont* ctx,
 /* if not merge, delete all for this size slot */
 	if (!merge){
 		for (size_t i = 0; i < ctx->n_fonts; i++){
-			if (ctx->fonts[i].font && ctx->fonts[i].sz == px_sz){
-				if (!ctx->fonts[i].shared_ht)
-					HASH_CLEAR(hh, ctx->fonts[i].ht);
-				free(ctx->fonts[i].font);
-				ctx->fonts[i].font = NULL;
-				ctx->fonts[i].sz = 0;
-				ctx->fonts[i].shared_ht = false;
+			if (ctx->fonts[i].font && ctx->fonts[i].sz == px_sz)
+				release_entry(&ctx->fonts[i]);
+		}
+	}
+
+/* find out if there's a slot to extend */
+	else {
+		for (size_t i = 0; i < ctx->n_fonts; i++){
+			if (!ctx->fonts[i].font || ctx->fonts[i].sz != px_sz)
+				continue;
+
+			struct font_entry* ent = malloc(sizeof(struct font_entry));
+			if (!ent)
+				return false;
+
+			ent->font = font_acquire(buf, buf_sz);
+			if (!ent->font){
+				free(ent);
+				return false;
 			}
+
+			ent->sz = px_sz;
+			ent->merged = ctx->fonts[i].merged;
+			ctx->fonts[i].merged = ent;
+			return true;
 		}
 	}
 
@@ -226,25 +340,12 @@ bool tui_pixelfont_load(struct tui_pixelfont* ctx,
 	if (!dst)
 		return false;
 
-/* find out if there's a hash-table to re-use */
-	if (merge){
-		for (size_t i = 0; i < ctx->n_fonts; i++){
-			if (ctx->fonts[i].font && ctx->fonts[i].sz == px_sz){
-				dst->shared_ht = true;
-				dst->ht = ctx->fonts[i].ht;
-				break;
-			}
-		}
-	}
-
 /* load it */
-	dst->font = open_psf2(buf, buf_sz, &dst->ht);
-	if (!dst->font){
-		dst->shared_ht = false;
-		dst->ht = NULL;
+	dst->font = font_acquire(buf, buf_sz);
+	if (!dst->font)
 		return false;
-	}
 	dst->sz = px_sz;
+	dst->merged = NULL;
 
 	return true;
 }
@@ -275,19 +376,50 @@ void tui_pixelfont_setsz(struct tui_pixelfont* ctx, size_t px, size_t* w, size_t
 
 void tui_pixelfont_close(struct tui_pixelfont* ctx)
 {
+	for (size_t i = 0; i < ctx->n_fonts; i++){
+		if (ctx->fonts[i].font)
+			release_entry(&ctx->fonts[i]);
+	}
+	free(ctx);
+}
+
+struct tui_pixelfont* tui_pixelfont_clone(struct tui_pixelfont* ctx)
+{
+	size_t ctx_sz =
+		sizeof(struct font_entry) * ctx->n_fonts + sizeof(struct tui_pixelfont);
+	struct tui_pixelfont* res = malloc(ctx_sz);
+	if (!res)
+		return NULL;
+	memset(res, '\0', ctx_sz);
+	res->n_fonts = ctx->n_fonts;
+	res->active_font_px = ctx->active_font_px;
+	res->active_font = &res->fonts[ctx->active_font - ctx->fonts];
+
+/* the references are only ever taken or dropped with the lock held, so it
+ * is enough to bump them here */
+	pthread_mutex_lock(&font_cache_lock);
 	for (size_t i = 0; i < ctx->n_fonts; i++){
 		if (!ctx->fonts[i].font)
 			continue;
 
-		if (!ctx->fonts[i].shared_ht)
-			HASH_CLEAR(hh, ctx->fonts[i].ht);
+		res->fonts[i].sz = ctx->fonts[i].sz;
+		res->fonts[i].font = ctx->fonts[i].font;
+		res->fonts[i].font->refs++;
 
-		free(ctx->fonts[i].font);
-		ctx->fonts[i].font = NULL;
-		ctx->fonts[i].sz = 0;
-		ctx->fonts[i].shared_ht = false;
+		struct font_entry** dst = &res->fonts[i].merged;
+		for (struct font_entry* cur = ctx->fonts[i].merged; cur; cur = cur->merged){
+			struct font_entry* ent = malloc(sizeof(struct font_entry));
+			if (!ent)
+				break;
+			*ent = (struct font_entry){.sz = cur->sz, .font = cur->font};
+			ent->font->refs++;
+			*dst = ent;
+			dst = &ent->merged;
+		}
 	}
-	free(ctx);
+	pthread_mutex_unlock(&font_cache_lock);
+
+	return res;
 }
 
 struct tui_pixelfont* tui_pixelfont_open(size_t lim)
@@ -329,9 +461,7 @@ bool tui_pixelfont_hascp(struct tui_pixelfont* ctx, uint32_t cp)
 	if (!ctx->active_font)
 		return false;
 
-	struct glyph_ent* gent;
-	HASH_FIND_INT(ctx->active_font->ht, &cp, gent);
-	return gent != NULL;
+	return find_glyph(ctx->active_font, cp) != NULL;
 }
 
 void tui_pixelfont_draw(
@@ -340,9 +470,9 @@ void tui_pixelfont_draw(
 	int maxx, int maxy, bool bgign)
 {
 	struct font_entry* font = ctx->active_font;
-	struct glyph_ent* gent;
+	struct glyph_ent* gent = NULL;
 	if (font)
-		HASH_FIND_INT(font->ht, &cp, gent);
+		gent = find_glyph(font, cp);
 
 	if (x >= maxx || y >= maxy)
 		return;
@@ -11,6 +11,12 @@ struct tui_pixelfont* tui_pixelfont_open(size_t limit);
  */
 void tui_pixelfont_close(struct tui_pixelfont* ctx);
 
+/*
+ * Create a new container that references the same loaded fonts as [ctx],
+ * the decoded glyphs are shared and only released with the last container.
+ */
+struct tui_pixelfont* tui_pixelfont_clone(struct tui_pixelfont* ctx);
+
 /*
  * Query if there is a matching symbol for the specified code-point
  * or not in the currently used font-set/font-context
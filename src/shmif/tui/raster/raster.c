@@ -1,4 +1,5 @@
 #include <inttypes.h>
+#include <pthread.h>
 #include "../../arcan_shmif.h"
 #include "../../arcan_tui.h"
 
@@ -15,19 +16,23 @@ struct agp_vstore;
 #include "raster.h"
 #include "pixelfont.h"
 
-struct cell {
-	shmif_pixel fc;
-	shmif_pixel bc;
-	uint32_t ucs4;
-	uint8_t attr;
-	uint8_t attr_ext;
-};
+/* upper bound for tui_raster_threads, and batches with fewer cells than this
+ * are not worth handing over to other threads */
+#define RASTER_MAX_THREADS 16
+#define RASTER_PARALLEL_CELLS 2048
+
+struct raster_pool;
 
 struct tui_raster_context {
 	struct tui_font* fonts[4];
 	int last_style;
 	int cursor_state;
 
+/* set for the contexts used by the threads of a pool, the vector fonts are
+ * forked per style so drawing never has to change the style of a font */
+	struct tui_font* styled[4][2];
+	struct raster_pool* pool;
+
 	shmif_pixel cc;
 
 /* custom hook, when set the cursor won't actually be drawn but instead
@@ -49,12 +54,73 @@ struct tui_raster_context {
 	size_t max_x, max_y;
 };
 
+/* a line of cells from the packed buffer, drawn as part of a batch */
+struct raster_job {
+	size_t row;
+	size_t offset;
+	size_t ncells;
+	uint8_t* cells;
+
+/* right edge of what was drawn, 0 if nothing */
+	size_t x2;
+};
+
+struct raster_batch {
+	struct raster_job* jobs;
+	size_t n_jobs;
+	size_t cap;
+	size_t n_cells;
+
+	shmif_pixel* vidp;
+	size_t pitch;
+	size_t max_w;
+	size_t max_h;
+	uint8_t alpha;
+};
+
+struct raster_worker {
+	struct raster_pool* pool;
+	size_t index;
+	pthread_t thread;
+
+	struct tui_raster_context ctx;
+	struct tui_font styled[4][2];
+};
+
+/*
+ * The calling thread acts as worker 0 and draws with its own context, the
+ * batch is split on rows so that the lines which touch the same row always
+ * end up in the same band and keep their order.
+ */
+struct raster_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+	unsigned gen;
+	size_t pending;
+	bool shutdown;
+
+/* fonts or cell size changed, the worker contexts need to be rebuilt */
+	bool stale;
+	bool usable;
+	TTF_Font* forked[2];
+
+	struct raster_batch* batch;
+	struct raster_job* jobs;
+	size_t jobs_cap;
+
+	size_t n_workers;
+	struct raster_worker* workers;
+};
+
 void tui_raster_setfont(
 	struct tui_raster_context* ctx, struct tui_font** src, size_t n_fonts)
 {
 	for (size_t i = 0; i < 4; i++)
 		ctx->fonts[i] = i < n_fonts ? src[i] : NULL;
 	ctx->last_style = -1;
+	if (ctx->pool)
+		ctx->pool->stale = true;
 }
 
 struct tui_raster_context* tui_raster_setup(size_t cell_w, size_t cell_h)
@@ -84,6 +150,10 @@ void tui_raster_cell_size(struct tui_raster_context* ctx, size_t w, size_t h)
 {
 	ctx->cell_w = w;
 	ctx->cell_h = h;
+
+/* the font has usually been replaced when this happens */
+	if (ctx->pool)
+		ctx->pool->stale = true;
 }
 
 void tui_raster_cursor_color(struct tui_raster_context* ctx, uint8_t col[static 3])
@@ -109,7 +179,8 @@ static void unpack_u32(uint32_t* dst, uint8_t* inbuf)
 		((uint64_t)inbuf[3] << 24);
 }
 
-static void unpack_cell(uint8_t unpack[static 12], struct cell* dst, uint8_t alpha)
+static void unpack_cell(
+	uint8_t unpack[static 12], struct tui_raster_cell* dst, uint8_t alpha)
 {
 	dst->fc = SHMIF_RGBA(unpack[0], unpack[1], unpack[2], 0xff);
 	dst->bc = SHMIF_RGBA(unpack[3], unpack[4], unpack[5], alpha);
@@ -120,7 +191,7 @@ static void unpack_cell(uint8_t unpack[static 12], struct cell* dst, uint8_t alp
 }
 
 static void drawborder_edge(
-	struct tui_raster_context* ctx, struct cell* cell, shmif_pixel* vidp,
+	struct tui_raster_context* ctx, struct tui_raster_cell* cell, shmif_pixel* vidp,
 	size_t pitch, int x, int y, size_t maxx, size_t maxy, int bv)
 {
 /* Missing:
@@ -156,7 +227,8 @@ static void drawborder_edge(
 	}
 }
 
-static void linehint(struct tui_raster_context* ctx, struct cell* cell,
+static void linehint(
+	struct tui_raster_context* ctx, struct tui_raster_cell* cell,
 	shmif_pixel* vidp, size_t pitch, int x, int y, size_t maxx, size_t maxy,
 	bool strikethrough, bool underline)
 {
@@ -186,7 +258,7 @@ static void drawcursor_px(
 	struct tui_raster_context* ctx, shmif_pixel* vidp,
 	size_t pitch, int x, int y, size_t maxx, size_t maxy, shmif_pixel cc)
 {
-	struct cell cell = {
+	struct tui_raster_cell cell = {
 		.fc = cc
 	};
 
@@ -203,7 +275,8 @@ static void drawcursor_px(
 	}
 }
 
-static size_t drawglyph(struct tui_raster_context* ctx, struct cell* cell,
+static size_t drawglyph(
+	struct tui_raster_context* ctx, struct tui_raster_cell* cell,
 	shmif_pixel* vidp, size_t pitch, int x, int y, size_t maxx, size_t maxy)
 {
 /* draw glyph based on font state */
@@ -240,14 +313,6 @@ static size_t drawglyph(struct tui_raster_context* ctx, struct cell* cell,
 		return ctx->cell_w;
 	}
 
-/* vector font drawing */
-	size_t nfonts = 1;
-	TTF_Font* fonts[2] = {ctx->fonts[0]->truetype, NULL};
-	if (ctx->fonts[1]->vector && ctx->fonts[1]->truetype){
-		nfonts = 2;
-		fonts[1] = ctx->fonts[1]->truetype;
-	}
-
 /* Clear to bg-color as the glyph drawing with background won't pad, except if
  * it is the cursor color, then use that. We can't do the fg/bg swap as even in
  * unshaped the glyph might be conditionally smaller than the cell size */
@@ -277,10 +342,21 @@ static size_t drawglyph(struct tui_raster_context* ctx, struct cell* cell,
 	prem    |= TTF_STYLE_ITALIC * !!(cell->attr & CATTR_ITALIC);
 	prem    |= TTF_STYLE_BOLD   * !!(cell->attr & CATTR_BOLD);
 
+/* vector font drawing */
+	struct tui_font** src = ctx->styled[prem][0] ? ctx->styled[prem] : ctx->fonts;
+	size_t nfonts = 1;
+	TTF_Font* fonts[2] = {src[0]->truetype, NULL};
+	if (src[1] && src[1]->vector && src[1]->truetype){
+		nfonts = 2;
+		fonts[1] = src[1]->truetype;
+	}
+
 /* seriously expensive so only perform if we actually need to as it can cause a
  * glyph cache flush (bold / italic / ...), other option would be to run
  * separate glyph caches on the different style options.. */
-	if (prem != ctx->last_style){
+	if (src != ctx->fonts)
+		ctx->last_style = prem;
+	else if (prem != ctx->last_style){
 		ctx->last_style = prem;
 		TTF_SetFontStyle(fonts[0], prem);
 		if (fonts[1])
@@ -324,11 +400,280 @@ static size_t drawglyph(struct tui_raster_context* ctx, struct cell* cell,
 	return ctx->cell_w;
 }
 
+/* move the pixel rows covered by a scroll line, returns the affected rows */
+static bool scroll_px(struct tui_raster_context* ctx,
+	shmif_pixel* vidp, size_t pitch, size_t max_w, size_t max_h,
+	shmif_pixel bgc, struct tui_raster_line* line, size_t* y0, size_t* yn)
+{
+	if (line->scroll_dir != RSCROLL_UP && line->scroll_dir != RSCROLL_DOWN)
+		return false;
+
+	*y0 = line->start_line * ctx->cell_h;
+	*yn = ((size_t) line->offset + 1) * ctx->cell_h;
+	if (*yn > max_h)
+		*yn = max_h;
+
+	if (*y0 >= *yn)
+		return false;
+
+	size_t h = *yn - *y0;
+	size_t d = line->line_state * ctx->cell_h;
+	if (d >= h){
+		draw_box_px(vidp, pitch, max_w, max_h, 0, *y0, max_w, h, bgc);
+		return true;
+	}
+
+	size_t keep = (h - d) * pitch * sizeof(shmif_pixel);
+	if (line->scroll_dir == RSCROLL_UP){
+		memmove(&vidp[*y0 * pitch], &vidp[(*y0 + d) * pitch], keep);
+		draw_box_px(vidp, pitch, max_w, max_h, 0, *yn - d, max_w, d, bgc);
+	}
+	else {
+		memmove(&vidp[(*y0 + d) * pitch], &vidp[*y0 * pitch], keep);
+		draw_box_px(vidp, pitch, max_w, max_h, 0, *y0, max_w, d, bgc);
+	}
+
+	return true;
+}
+
+static void draw_job(struct tui_raster_context* ctx,
+	struct raster_batch* b, struct raster_job* job)
+{
+	size_t draw_x = job->offset * ctx->cell_w;
+	size_t draw_y = job->row * ctx->cell_h;
+	uint8_t* buf = job->cells;
+	job->x2 = 0;
+
+	for (size_t i = job->offset; i < job->offset + job->ncells; i++){
+/* extract each cell */
+		struct tui_raster_cell cell;
+		unpack_cell(buf, &cell, b->alpha);
+		buf += raster_cell_sz;
+
+/* outsource cursor? then invoke external - for more custom cursors that cover
+ * a larger area or multiple cursors on the same buffer, these need to be
+ * queued separately and drawn in another pass - though that queueing can be
+ * handled in the ext_cursor handler */
+		if ((cell.attr & CATTR_CURSOR) && ctx->ext_cursor){
+			uint8_t rgba[4];
+			SHMIF_RGBA_DECOMP(ctx->cc, &rgba[0], &rgba[1], &rgba[2], &rgba[3]);
+			ctx->ext_cursor(ctx,
+				i, job->row, draw_x, draw_y, ctx->cell_w, ctx->cell_h,
+				ctx->cursor_state, rgba, NULL
+			);
+
+			cell.attr &= ~CATTR_CURSOR;
+		}
+
+/* skip bit is set, note that for a shaped line, this means that
+ * we need to have an offset- map to advance correctly */
+		if (cell.attr & CATTR_SKIP){
+			draw_x += ctx->cell_w;
+			continue;
+		}
+
+/* blit or discard if OOB */
+		if (draw_x + ctx->cell_w <= b->max_w && draw_y + ctx->cell_h <= b->max_h){
+			draw_x += drawglyph(ctx,
+				&cell, b->vidp, b->pitch, draw_x, draw_y, b->max_w, b->max_h);
+		}
+		else
+			continue;
+
+		uint16_t next_x = draw_x + ctx->cell_w;
+		if (job->x2 < next_x && next_x <= b->max_w)
+			job->x2 = next_x;
+	}
+}
+
+static void draw_band(struct tui_raster_context* ctx,
+	struct raster_batch* b, size_t band, size_t n_bands)
+{
+	size_t n_rows = (b->max_h + ctx->cell_h - 1) / ctx->cell_h;
+	if (!n_rows)
+		n_rows = 1;
+
+	for (size_t i = 0; i < b->n_jobs; i++){
+		size_t row_band = b->jobs[i].row * n_bands / n_rows;
+		if (row_band >= n_bands)
+			row_band = n_bands - 1;
+
+		if (row_band == band)
+			draw_job(ctx, b, &b->jobs[i]);
+	}
+}
+
+static void* raster_worker(void* tag)
+{
+	struct raster_worker* w = tag;
+	struct raster_pool* pool = w->pool;
+	unsigned gen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;){
+		while (!pool->shutdown && pool->gen == gen)
+			pthread_cond_wait(&pool->work, &pool->lock);
+
+		if (pool->shutdown)
+			break;
+
+		gen = pool->gen;
+		pthread_mutex_unlock(&pool->lock);
+
+		draw_band(&w->ctx, pool->batch, w->index, pool->n_workers);
+
+		pthread_mutex_lock(&pool->lock);
+		if (0 == --pool->pending)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+static void drop_forks(struct raster_worker* w)
+{
+	for (size_t s = 0; s < 4; s++)
+		for (size_t i = 0; i < 2; i++){
+			if (w->styled[s][i].truetype)
+				TTF_CloseFont(w->styled[s][i].truetype);
+			w->styled[s][i].truetype = NULL;
+			w->ctx.styled[s][i] = NULL;
+		}
+}
+
+/* only called with the workers idle, forks are opened and closed from the
+ * thread that owns the fonts they are forked from */
+static void refresh_workers(struct tui_raster_context* ctx)
+{
+	struct raster_pool* pool = ctx->pool;
+	pool->stale = false;
+	pool->usable = true;
+
+	for (size_t i = 0; i < 2; i++)
+		pool->forked[i] = ctx->fonts[i] && ctx->fonts[i]->vector ?
+			ctx->fonts[i]->truetype : NULL;
+
+	for (size_t i = 1; i < pool->n_workers; i++){
+		struct raster_worker* w = &pool->workers[i];
+		drop_forks(w);
+
+		w->ctx = (struct tui_raster_context){
+			.last_style = -1
+		};
+		memcpy(w->ctx.fonts, ctx->fonts, sizeof(ctx->fonts));
+
+/* bitmap fonts are only read from when drawing so they can be aliased */
+		if (!ctx->fonts[0]->vector)
+			continue;
+
+		for (size_t s = 0; s < 4 && pool->usable; s++)
+			for (size_t j = 0; j < 2; j++){
+				if (!pool->forked[j])
+					continue;
+
+				w->styled[s][j] = *ctx->fonts[j];
+				w->styled[s][j].truetype = TTF_ForkFont(pool->forked[j], s);
+				if (!w->styled[s][j].truetype){
+					pool->usable = false;
+					break;
+				}
+				w->ctx.styled[s][j] = &w->styled[s][j];
+			}
+	}
+}
+
+static bool draw_parallel(struct tui_raster_context* ctx, struct raster_batch* b)
+{
+	struct raster_pool* pool = ctx->pool;
+	if (!pool || ctx->ext_cursor || b->n_cells < RASTER_PARALLEL_CELLS)
+		return false;
+
+/* the font slots can be swapped without going through setfont */
+	for (size_t i = 0; i < 2 && !pool->stale; i++){
+		TTF_Font* cur = ctx->fonts[i] && ctx->fonts[i]->vector ?
+			ctx->fonts[i]->truetype : NULL;
+		if (cur != pool->forked[i])
+			pool->stale = true;
+	}
+
+	if (pool->stale)
+		refresh_workers(ctx);
+
+	if (!pool->usable)
+		return false;
+
+	for (size_t i = 1; i < pool->n_workers; i++){
+		struct tui_raster_context* wctx = &pool->workers[i].ctx;
+		wctx->cursor_state = ctx->cursor_state;
+		wctx->cc = ctx->cc;
+		wctx->cell_w = ctx->cell_w;
+		wctx->cell_h = ctx->cell_h;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->batch = b;
+	pool->pending = pool->n_workers - 1;
+	pool->gen++;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	draw_band(ctx, b, 0, pool->n_workers);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->pending)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+
+	return true;
+}
+
+/* draw the queued lines and merge their extents, in queue order */
+static void flush_batch(struct tui_raster_context* ctx,
+	struct raster_batch* b, bool update, struct arcan_shmif_cont* dmg,
+	uint16_t* x1, uint16_t* y1, uint16_t* x2)
+{
+	if (!b->n_jobs)
+		return;
+
+	if (!draw_parallel(ctx, b)){
+		for (size_t i = 0; i < b->n_jobs; i++)
+			draw_job(ctx, b, &b->jobs[i]);
+	}
+
+	for (size_t i = 0; i < b->n_jobs; i++){
+		struct raster_job* job = &b->jobs[i];
+		size_t draw_x = job->offset * ctx->cell_w;
+		size_t draw_y = job->row * ctx->cell_h;
+
+		if (draw_y < *y1)
+			*y1 = draw_y;
+
+		if (draw_x < *x1)
+			*x1 = draw_x;
+
+		if (*x2 < job->x2)
+			*x2 = job->x2;
+
+		if (update && dmg && job->x2 > draw_x)
+			arcan_shmif_dirty(dmg,
+				draw_x, draw_y, job->x2, draw_y + ctx->cell_h, 0);
+	}
+
+	b->n_jobs = 0;
+	b->n_cells = 0;
+}
+
+/*
+ * [dmg] is optional, when provided on a delta frame each drawn line is marked
+ * as its own dirty region (and the return value is 2) rather than just
+ * reporting the bounding box in x1,y1-x2,y2.
+ */
 static int raster_tobuf(
 	struct tui_raster_context* ctx, shmif_pixel* vidp, size_t pitch,
 	size_t max_w, size_t max_h,
 	uint16_t* x1, uint16_t* y1, uint16_t* x2, uint16_t* y2,
-	uint8_t* buf, size_t buf_sz)
+	uint8_t* buf, size_t buf_sz, struct arcan_shmif_cont* dmg)
 {
 	struct tui_raster_header hdr;
 	if (!buf_sz || buf_sz < sizeof(struct tui_raster_header))
@@ -390,103 +735,105 @@ static int raster_tobuf(
 
 	ctx->cursor_state = hdr.cursor_state & (~CURSOR_EXTHDRv1);
 
-	ssize_t cur_y = -1;
+/* lines are queued and drawn in batches between scrolls, with a pool the
+ * queue covers the whole frame, otherwise each line is drawn directly */
+	struct raster_job single;
+	struct raster_batch batch = {
+		.jobs = &single,
+		.cap = 1,
+		.vidp = vidp,
+		.pitch = pitch,
+		.max_w = max_w,
+		.max_h = max_h,
+		.alpha = hdr.bgc[3]
+	};
+
+	if (ctx->pool){
+		struct raster_pool* pool = ctx->pool;
+		if (pool->jobs_cap < hdr.lines){
+			struct raster_job* jobs =
+				realloc(pool->jobs, sizeof(struct raster_job) * hdr.lines);
+			if (jobs){
+				pool->jobs = jobs;
+				pool->jobs_cap = hdr.lines;
+			}
+		}
+		if (pool->jobs_cap){
+			batch.jobs = pool->jobs;
+			batch.cap = pool->jobs_cap;
+		}
+	}
+
 	size_t last_line = 0;
-	size_t draw_y = 0;
 
 	for (size_t i = 0; i < hdr.lines && buf_sz; i++){
-		if (buf_sz < sizeof(struct tui_raster_line))
+		if (buf_sz < sizeof(struct tui_raster_line)){
+			flush_batch(ctx, &batch, update, dmg, x1, y1, x2);
 			return -1;
+		}
 
 /* read / unpack line metadata */
 		struct tui_raster_line line;
 
 		memcpy(&line, buf, sizeof(struct tui_raster_line));
 		buf += sizeof(line);
+		buf_sz -= sizeof(line);
 
 /* remember the lower line we were at, these are not always ordered */
 		if (line.start_line > last_line)
 			last_line = line.start_line;
 
-/* respecting scrolling will need another drawing routine, as we need clipping
- * etc. and multiple lines can be scrolled, and that's better fixed when we
- * have an atlas to work from */
-		if (update && cur_y == -1){
-			*y1 = line.start_line * ctx->cell_h;
-		}
-
-/* skip omitted lines */
-		if (cur_y != line.start_line){
-/* for full draw we fill in the skipped space with the background color */
-			cur_y = line.start_line;
-		}
-		draw_y = cur_y * ctx->cell_h;
+/* a scroll moves what has already been drawn, the lines that follow fill
+ * in the rows that came into view */
+		if (line.scroll_dir && !line.ncells){
+			flush_batch(ctx, &batch, update, dmg, x1, y1, x2);
 
-/* the line- raster routine isn't right, we actually need to unpack each line
- * into a local buffer, make note of actual offsets and width, and then two-pass
- * with bg first and then blend the glyphs on top of that - otherwise kerning,
- * shapes etc. looks bad. */
-		if (draw_y < *y1){
-			*y1 = draw_y;
-		}
-
-/* Shaping, BiDi, ... missing here now while we get the rest in place */
-		size_t draw_x = line.offset * ctx->cell_w;
-
-		if (draw_x < *x1){
-			*x1 = draw_x;
-		}
-
-		for (size_t i = line.offset; line.ncells && buf_sz >= raster_cell_sz; i++){
-			line.ncells--;
-
-/* extract each cell */
-			struct cell cell;
-			unpack_cell(buf, &cell, hdr.bgc[3]);
-			buf += raster_cell_sz;
-			buf_sz -= raster_cell_sz;
-
-/* outsource cursor? then invoke external - for more custom cursors that cover
- * a larger area or multiple cursors on the same buffer, these need to be
- * queued separately and drawn in another pass - though that queueing can be
- * handled in the ext_cursor handler */
-			if ((cell.attr & CATTR_CURSOR) && ctx->ext_cursor){
-				uint8_t rgba[4];
-				SHMIF_RGBA_DECOMP(ctx->cc, &rgba[0], &rgba[1], &rgba[2], &rgba[3]);
-				ctx->ext_cursor(ctx,
-					i, cur_y, draw_x, draw_y, ctx->cell_w, ctx->cell_h,
-					ctx->cursor_state, rgba, NULL
-				);
-
-				cell.attr &= ~CATTR_CURSOR;
-			}
-
-/* skip bit is set, note that for a shaped line, this means that
- * we need to have an offset- map to advance correctly */
-			if (cell.attr & CATTR_SKIP){
-				draw_x += ctx->cell_w;
+			size_t y0, yn;
+			if (!scroll_px(ctx, vidp, pitch, max_w, max_h, bgc, &line, &y0, &yn))
 				continue;
-			}
 
-/* blit or discard if OOB */
-			if (draw_x + ctx->cell_w <= max_w && draw_y + ctx->cell_h <= max_h){
-				draw_x += drawglyph(ctx, &cell, vidp, pitch, draw_x, draw_y, max_w, max_h);
-			}
-			else
-				continue;
+			if (line.offset > last_line)
+				last_line = line.offset;
 
-			uint16_t next_x = draw_x + ctx->cell_w;
-			if (*x2 < next_x && next_x <= max_w){
-				*x2 = next_x;
+			if (update){
+				*x1 = 0;
+				*x2 = max_w;
+				if (y0 < *y1)
+					*y1 = y0;
+				if (dmg)
+					arcan_shmif_dirty(dmg, 0, y0, max_w, yn, 0);
 			}
+			continue;
 		}
 
-		cur_y++;
+/* the line- raster routine isn't right, we actually need to unpack each line
+ * into a local buffer, make note of actual offsets and width, and then two-pass
+ * with bg first and then blend the glyphs on top of that - otherwise kerning,
+ * shapes etc. looks bad. Shaping, BiDi, ... missing here now while we get the
+ * rest in place */
+		size_t ncells = line.ncells;
+		if (ncells > buf_sz / raster_cell_sz)
+			ncells = buf_sz / raster_cell_sz;
+
+		if (batch.n_jobs == batch.cap)
+			flush_batch(ctx, &batch, update, dmg, x1, y1, x2);
+
+		batch.jobs[batch.n_jobs++] = (struct raster_job){
+			.row = line.start_line,
+			.offset = line.offset,
+			.ncells = ncells,
+			.cells = buf
+		};
+		batch.n_cells += ncells;
+
+		buf += ncells * raster_cell_sz;
+		buf_sz -= ncells * raster_cell_sz;
 	}
 
+	flush_batch(ctx, &batch, update, dmg, x1, y1, x2);
 	*y2 = (last_line + 1) * ctx->cell_h;
 
-	return 1;
+	return update && dmg ? 2 : 1;
 }
 
 int tui_raster_render(struct tui_raster_context* ctx,
@@ -495,18 +842,21 @@ int tui_raster_render(struct tui_raster_context* ctx,
 	if (!ctx || !dst || !ctx->fonts[0] || buf_sz < sizeof(struct tui_raster_header))
 		return -1;
 
-/* pixel- rasterization over shmif should work with one big BB until we have
- * chain-mode. server-side, the vertex buffer slicing will just stream so not
- * much to care about there */
+/* pixel- rasterization over shmif marks each updated line so that the damage
+ * chain can keep disjoint lines apart. server-side, the vertex buffer slicing
+ * will just stream so not much to care about there */
 	uint16_t x1, y1, x2, y2;
-	if (-1 == raster_tobuf(ctx, dst->vidp, dst->pitch,
-		dst->w, dst->h, &x1, &y1, &x2, &y2, buf, buf_sz))
-	return -1;
+	int rv = raster_tobuf(ctx, dst->vidp, dst->pitch,
+		dst->w, dst->h, &x1, &y1, &x2, &y2, buf, buf_sz, dst);
+
+	if (-1 == rv)
+		return -1;
 
 	if (x2 > dst->w)
 		x2 = dst->w;
 
-	arcan_shmif_dirty(dst, x1, y1, x2, y2, 0);
+	if (rv != 2)
+		arcan_shmif_dirty(dst, x1, y1, x2, y2, 0);
 	return 1;
 }
 
@@ -541,7 +891,7 @@ void tui_raster_renderagp(struct tui_raster_context* ctx,
 	uint16_t x1, y1, x2, y2;
 
 	if (-1 == raster_tobuf(ctx, dst->vinf.text.raw, dst->w,
-		dst->w, dst->h, &x1, &y1, &x2, &y2, buf, buf_sz)){
+		dst->w, dst->h, &x1, &y1, &x2, &y2, buf, buf_sz, NULL)){
 		*out = (struct stream_meta){0};
 	}
 	else {
@@ -554,6 +904,233 @@ void tui_raster_renderagp(struct tui_raster_context* ctx,
 }
 #endif
 
+/* cell version of scroll_px, returns the affected rows */
+static bool scroll_cells(struct tui_raster_cell* grid, size_t cols, size_t rows,
+	struct tui_raster_cell* blank, struct tui_raster_line* line,
+	size_t* r0, size_t* rn)
+{
+	if (line->scroll_dir != RSCROLL_UP && line->scroll_dir != RSCROLL_DOWN)
+		return false;
+
+	*r0 = line->start_line;
+	*rn = (size_t) line->offset + 1;
+	if (*rn > rows)
+		*rn = rows;
+
+	if (*r0 >= *rn)
+		return false;
+
+	size_t h = *rn - *r0;
+	size_t d = line->line_state;
+	size_t fill = *r0;
+
+	if (d >= h)
+		d = h;
+	else if (line->scroll_dir == RSCROLL_UP){
+		memmove(&grid[*r0 * cols], &grid[(*r0 + d) * cols],
+			(h - d) * cols * sizeof(struct tui_raster_cell));
+		fill = *rn - d;
+	}
+	else {
+		memmove(&grid[(*r0 + d) * cols], &grid[*r0 * cols],
+			(h - d) * cols * sizeof(struct tui_raster_cell));
+	}
+
+	for (size_t i = fill * cols; i < (fill + d) * cols; i++)
+		grid[i] = *blank;
+
+	return true;
+}
+
+/*
+ * Unpack into a grid of cells instead of rastering. The grid retains state
+ * between calls the same way the pixel buffer does for the other paths, so
+ * a delta frame only overwrites the cells that it carries.
+ */
+int tui_raster_cells(struct tui_raster_context* ctx,
+	uint8_t* buf, size_t buf_sz,
+	struct tui_raster_cell* grid, size_t cols, size_t rows,
+	size_t* y1, size_t* y2, shmif_pixel* bgc)
+{
+	struct tui_raster_header hdr;
+	if (!ctx || !grid || buf_sz < sizeof(struct tui_raster_header))
+		return -1;
+
+	memcpy(&hdr, buf, sizeof(struct tui_raster_header));
+	bool extcursor = !!(hdr.cursor_state & CURSOR_EXTHDRv1);
+
+	size_t hdr_ver_sz = hdr.lines * raster_line_sz +
+		hdr.cells * raster_cell_sz + raster_hdr_sz +
+		extcursor * 3;
+
+	if (hdr.data_sz > buf_sz || hdr.data_sz != hdr_ver_sz)
+		return -1;
+
+	buf_sz -= sizeof(struct tui_raster_header);
+	buf += sizeof(struct tui_raster_header);
+
+	if (extcursor){
+		tui_raster_cursor_color(ctx, buf);
+		buf_sz -= 3;
+		buf += 3;
+	}
+
+	*bgc = SHMIF_RGBA(hdr.bgc[0], hdr.bgc[1], hdr.bgc[2], hdr.bgc[3]);
+	struct tui_raster_cell blank = {.bc = *bgc};
+	ctx->cursor_state = hdr.cursor_state & (~CURSOR_EXTHDRv1);
+
+	bool full = !(hdr.flags & RPACK_DFRAME);
+	if (full){
+		for (size_t i = 0; i < cols * rows; i++)
+			grid[i] = blank;
+		*y1 = 0;
+		*y2 = rows;
+	}
+	else {
+		*y1 = rows;
+		*y2 = 0;
+	}
+
+	for (size_t i = 0; i < hdr.lines && buf_sz; i++){
+		if (buf_sz < sizeof(struct tui_raster_line))
+			return -1;
+
+		struct tui_raster_line line;
+		memcpy(&line, buf, sizeof(struct tui_raster_line));
+		buf += sizeof(line);
+		buf_sz -= sizeof(line);
+
+		size_t r0 = line.start_line, rn = r0 + 1;
+		if (line.scroll_dir && !line.ncells){
+			if (!scroll_cells(grid, cols, rows, &blank, &line, &r0, &rn))
+				continue;
+		}
+		else {
+			for (size_t x = line.offset; line.ncells && buf_sz >= raster_cell_sz; x++){
+				line.ncells--;
+
+				struct tui_raster_cell cell;
+				unpack_cell(buf, &cell, hdr.bgc[3]);
+				buf += raster_cell_sz;
+				buf_sz -= raster_cell_sz;
+
+/* same as with the pixel buffer, a skipped cell keeps what it had */
+				if ((cell.attr & CATTR_SKIP) || r0 >= rows || x >= cols)
+					continue;
+
+				grid[r0 * cols + x] = cell;
+			}
+
+			if (r0 >= rows)
+				continue;
+		}
+
+		if (r0 < *y1)
+			*y1 = r0;
+		if (rn > *y2)
+			*y2 = rn;
+	}
+
+	return full ? 1 : 0;
+}
+
+void tui_raster_drawcell(struct tui_raster_context* ctx,
+	struct tui_raster_cell* cell, shmif_pixel* vidp, size_t pitch)
+{
+	if (!ctx || !ctx->fonts[0])
+		return;
+
+/* drawglyph patches the cell for the cursor, don't leak that to the caller */
+	struct tui_raster_cell tmp = *cell;
+	drawglyph(ctx, &tmp, vidp, pitch, 0, 0, ctx->cell_w, ctx->cell_h);
+}
+
+int tui_raster_cursor_state(struct tui_raster_context* ctx, shmif_pixel* cc)
+{
+	if (cc)
+		*cc = ctx->cc;
+	return ctx->cursor_state;
+}
+
+static void free_pool(struct raster_pool* pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = true;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (size_t i = 1; i < pool->n_workers; i++){
+		pthread_join(pool->workers[i].thread, NULL);
+		drop_forks(&pool->workers[i]);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->work);
+	pthread_cond_destroy(&pool->done);
+	free(pool->workers);
+	free(pool->jobs);
+	free(pool);
+}
+
+void tui_raster_threads(struct tui_raster_context* ctx, size_t n)
+{
+	if (!ctx)
+		return;
+
+	if (n > RASTER_MAX_THREADS)
+		n = RASTER_MAX_THREADS;
+
+	if (ctx->pool){
+		if (ctx->pool->n_workers == n)
+			return;
+		free_pool(ctx->pool);
+		ctx->pool = NULL;
+	}
+
+	if (n < 2)
+		return;
+
+	struct raster_pool* pool = malloc(sizeof(struct raster_pool));
+	if (!pool)
+		return;
+
+	*pool = (struct raster_pool){
+		.stale = true
+	};
+
+	pool->workers = malloc(sizeof(struct raster_worker) * n);
+	if (!pool->workers){
+		free(pool);
+		return;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+/* the workers don't look at n_workers until there is a batch, so whatever
+ * could be spawned is what will be used */
+	pool->n_workers = 1;
+	for (size_t i = 1; i < n; i++){
+		struct raster_worker* w = &pool->workers[i];
+		*w = (struct raster_worker){
+			.pool = pool,
+			.index = i
+		};
+
+		if (0 != pthread_create(&w->thread, NULL, raster_worker, w))
+			break;
+		pool->n_workers++;
+	}
+
+	if (pool->n_workers < 2){
+		free_pool(pool);
+		return;
+	}
+
+	ctx->pool = pool;
+}
+
 /*
  * Free any buffers and resources bound to the raster
  */
@@ -562,5 +1139,6 @@ void tui_raster_free(struct tui_raster_context* ctx)
 	if (!ctx)
 		return;
 
+	tui_raster_threads(ctx, 0);
 	free(ctx);
 }
@@ -25,9 +25,12 @@
  * verified against the fonts so that the codepoints exist, otherwise swapped
  * for a valid replacement.
  *
- * 5. Scrolling need to update all relevant lines in the region to scroll,
- *    only the step and direction of the first scroll- marked line will be
- *    respected (and applies to all subseqent scroll- tagged lines).
+ * 5. Scrolling is a line without cells that has scroll_dir set, it moves
+ *    the rows [start_line, offset] by line_state rows in that direction
+ *    and fills the vacated rows with the background color. It applies to
+ *    what has been drawn so far, so it is sent ahead of the line updates,
+ *    and those still need to cover every cell that isn't the result of just
+ *    moving the old contents.
  */
 
 /* the raster cell is 12 byte:
@@ -81,6 +84,15 @@ enum cell_extr_attr {
 	CEATTR_BORDER_ALL   = 60
 };
 
+/* unpacked form of the 12 byte cell, see tui_raster_cells */
+struct tui_raster_cell {
+	shmif_pixel fc;
+	shmif_pixel bc;
+	uint32_t ucs4;
+	uint8_t attr;
+	uint8_t attr_ext;
+};
+
 enum raster_content {
 /* monospaces, left to right, 1 data cell to 1 visible cell on a virtual grid */
 	LINE_NORMAL = 0,
@@ -100,6 +112,12 @@ enum raster_content {
 	LINE_NOBREAK = 4,
 };
 
+enum raster_scroll {
+	RSCROLL_NONE = 0,
+	RSCROLL_UP = 1,
+	RSCROLL_DOWN = 3
+};
+
 struct __attribute__((packed)) tui_raster_line {
 	uint16_t start_line;
 	uint16_t ncells;
@@ -192,6 +210,13 @@ int tui_raster_render(struct tui_raster_context* ctx,
 /* Called when the cell size has unexpectedly changed */
 void tui_raster_cell_size(struct tui_raster_context* ctx, size_t w, size_t h);
 
+/*
+ * Split rasterization of larger updates into bands of rows, drawn by [n]
+ * threads including the caller. Vector fonts get private copies per thread
+ * as the glyph caches can't be shared. [n] <= 1 returns to drawing serially.
+ */
+void tui_raster_threads(struct tui_raster_context* ctx, size_t n);
+
 void tui_raster_get_cell_size(
 	struct tui_raster_context* ctx, size_t* w, size_t* h);
 
@@ -205,6 +230,30 @@ void tui_raster_renderagp(struct tui_raster_context* ctx,
 	struct stream_meta* out);
 #endif
 
+/*
+ * Unpack [buf] into a [cols * rows] grid of cells rather than rastering, for
+ * renderers that resolve glyphs on their own (e.g. against an atlas). The
+ * rows [y1, y2) were changed (scrolled or written), [bgc] is set to the
+ * frame background color. Returns -1 on a malformed buffer, 1 on a full
+ * frame (the grid is cleared to [bgc] first) and 0 on a delta.
+ */
+int tui_raster_cells(struct tui_raster_context* ctx,
+	uint8_t* buf, size_t buf_sz,
+	struct tui_raster_cell* grid, size_t cols, size_t rows,
+	size_t* y1, size_t* y2, shmif_pixel* bgc);
+
+/*
+ * Draw a single cell at the top-left of [vidp], clipped to the cell size.
+ */
+void tui_raster_drawcell(struct tui_raster_context* ctx,
+	struct tui_raster_cell* cell, shmif_pixel* vidp, size_t pitch);
+
+/*
+ * Return the cursor state from the last unpacked frame, [cc] (optional)
+ * gets the cursor color.
+ */
+int tui_raster_cursor_state(struct tui_raster_context* ctx, shmif_pixel* cc);
+
 /*
  * Free any buffers and resources bound to the raster.
  */
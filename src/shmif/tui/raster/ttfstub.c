@@ -53,3 +53,8 @@ void TTF_SetFontStyle(TTF_Font *font, int style)
 void TTF_FontStyle(TTF_Font* font, int style)
 {
 }
+
+TTF_Font* TTF_ForkFont(TTF_Font* font, int style)
+{
+	return NULL;
+}
@@ -154,7 +154,7 @@ static void write_front_checked(struct tui_context* c,
 	data->draw_ch = data->ch = uc;
 	if (attr)
 		data->attr = *attr;
-	c->dirty |= DIRTY_PARTIAL;
+	tui_dirty_rows(c, c->cy, c->cy);
 }
 
 size_t arcan_tui_ucs4utf8(uint32_t cp, char dst[static 4])
@@ -269,6 +269,23 @@ ssize_t arcan_tui_utf8ucs4(const char src[static 4], uint32_t* dst)
 	return used;
 }
 
+/* when a dirty context can't synch right away there is no point in spinning,
+ * the server sends a STEPFRAME when the previous frame is consumed (VSIGNAL_EV)
+ * and the refresh cap tells how long until the next one is allowed */
+#define SYNCH_WAIT_MS 16
+
+static int tui_process_timeout(struct tui_context* tui, int timeout)
+{
+	int wait = tui_screen_refresh_wait(tui);
+	if (!wait && arcan_shmif_signalstatus(&tui->acon) != 0)
+		wait = SYNCH_WAIT_MS;
+
+	if (timeout < 0 || wait < timeout)
+		return wait;
+
+	return timeout;
+}
+
 struct tui_process_res arcan_tui_process(
 	struct tui_context** contexts, size_t n_contexts,
 	int* fdset, size_t fdset_sz, int timeout)
@@ -296,8 +313,9 @@ struct tui_process_res arcan_tui_process(
 		if (!contexts[i]->acon.addr){
 			res.bad |= 1 << i;
 		}
-		else if (contexts[i]->dirty)
-			timeout = 0;
+		else if (contexts[i]->dirty){
+			timeout = tui_process_timeout(contexts[i], timeout);
+		}
 	}
 
 	if (res.bad){
@@ -784,6 +802,8 @@ void arcan_tui_eraseattr_region(struct tui_context* c,
 				data->fstamp = c->fstamp;
 			}
 		}
+
+	tui_dirty_rows(c, y1, y2);
 }
 
 void arcan_tui_erase_region(struct tui_context* c,
@@ -866,6 +886,7 @@ void arcan_tui_writeattr_at(struct tui_context* c,
 	assert(c->screen == NULL);
 	if (x < c->cols && y < c->rows){
 		c->front[y * c->cols + x].attr = *attr;
+		tui_dirty_rows(c, y, y);
 	}
 
 	flag_cursor(c);
@@ -906,6 +927,74 @@ bool arcan_tui_writeu8(struct tui_context* c,
 	return true;
 }
 
+bool arcan_tui_writeu8_runs(struct tui_context* c, const uint8_t* u8,
+	size_t len, const struct tui_attr_run* runs, size_t n_runs)
+{
+	if (!(c && u8 && len > 0))
+		return false;
+
+	assert(c->screen == NULL);
+
+	size_t run = 0;
+	size_t run_end = n_runs ? runs[0].len : len;
+	const struct tui_screen_attr* attr =
+		n_runs && runs[0].attr ? runs[0].attr : &c->defattr;
+
+	size_t y1 = c->cy;
+	bool ok = true;
+	size_t pos = 0;
+
+	while (pos < len){
+/* find the run covering the first byte of the next codepoint */
+		while (pos >= run_end){
+			const struct tui_screen_attr* next = NULL;
+			if (++run < n_runs){
+				run_end += runs[run].len;
+				next = runs[run].attr;
+			}
+			else
+				run_end = len;
+			attr = next ? next : &c->defattr;
+		}
+
+		uint32_t ucs4 = u8[pos];
+		if (ucs4 < 0x80)
+			pos++;
+		else {
+			ssize_t step = arcan_tui_utf8ucs4((char*) &u8[pos], &ucs4);
+			if (step <= 0 || pos + step > len){
+				ucs4 = 0;
+				ok = false;
+				pos++;
+			}
+			else
+				pos += step;
+		}
+
+		struct tui_cell* data = &c->front[c->cy * c->cols + c->cx];
+		data->fstamp = c->fstamp;
+		data->draw_ch = data->ch = ucs4;
+		data->attr = *attr;
+
+/* same advance and wrap or clamp as _write */
+		c->cx = c->cx + 1;
+		if (c->cx > c->cols-1){
+			if (c->flags & TUI_AUTO_WRAP){
+				c->cx = 0;
+				if (c->cy < c->rows-1)
+					c->cy++;
+			}
+			else
+				c->cx = c->cols-1;
+		}
+	}
+
+	tui_dirty_rows(c, y1, c->cy);
+	flag_cursor(c);
+
+	return ok;
+}
+
 bool arcan_tui_hasglyph(struct tui_context* c, uint32_t cp)
 {
 	return tui_fontmgmt_hasglyph(c, cp);
@@ -1209,7 +1298,7 @@ void arcan_tui_screencopy(
 		}
 	}
 
-	dst->dirty = true;
+	tui_dirty_rows(dst, d_y1, d_y2);
 }
 
 void arcan_tui_write_border(
@@ -42,6 +42,17 @@ struct tui_context {
 	struct tui_cell* base;
 	struct tui_cell* front;
 	struct tui_cell* back;
+
+/* one bit per row that may differ between front and back, set by anything
+ * that writes into front (tui_dirty_rows) and cleared when tpack synchs */
+	uint64_t* dirty_rows;
+
+/* rows moved since the last refresh, see tui_screen_scroll */
+	struct {
+		bool set, bad;
+		int step;
+		size_t top, bottom;
+	} scroll_hint;
 	struct tui_screen_attr defattr;
 	uint8_t fstamp;
 
@@ -122,6 +133,15 @@ struct tui_context {
 
 	uint8_t alpha;
 
+/* threads for the raster to split larger updates over, 0/1 is serial */
+	size_t raster_threads;
+
+/* minimum ms between two synchs, 0 is uncapped, follows the rate from
+ * OUTPUTHINT unless refresh_fixed (set from the fps argument) */
+	unsigned refresh_ms;
+	bool refresh_fixed;
+	long long last_synch;
+
 /* track last time counter we did update on to avoid overdraw */
 	uint_fast32_t age;
 
@@ -167,6 +187,17 @@ struct tui_context {
 	struct tui_cbcfg handlers;
 };
 
+/* mark rows [y1, y2] as changed in the front buffer */
+static inline void tui_dirty_rows(struct tui_context* c, size_t y1, size_t y2)
+{
+	c->dirty |= DIRTY_PARTIAL;
+	if (!c->dirty_rows)
+		return;
+
+	for (size_t y = y1; y <= y2 && y < (size_t) c->rows; y++)
+		c->dirty_rows[y >> 6] |= (uint64_t) 1 << (y & 63);
+}
+
 /* ========================================================================== */
 /*                       SCREEN (tui_screen.c) related code                   */
 /* ========================================================================== */
@@ -176,6 +207,21 @@ struct tui_context {
  */
 int tui_screen_refresh(struct tui_context* tui);
 
+/*
+ * ms left until the refresh cap allows the next synch, 0 if it is allowed now
+ */
+int tui_screen_refresh_wait(struct tui_context* tui);
+
+/*
+ * Note that the contents of rows [top, bottom] have moved [step] rows up
+ * (positive) or down (negative) since the last refresh. The next delta
+ * tpack verifies this against the front buffer and, if it holds, sends a
+ * scroll rather than every line that shifted. Moves on different regions
+ * within the same refresh cancel the hint.
+ */
+void tui_screen_scroll(
+	struct tui_context* tui, size_t top, size_t bottom, int step);
+
 /*
  * cell dimensions or cell quantities has changed, rebuild the display
  */
@@ -279,6 +325,11 @@ void tui_fontmgmt_fonthint(struct tui_context* tui, struct arcan_tgtevent* ev);
  */
 void tui_fontmgmt_inherit(struct tui_context* tui, struct tui_context* parent);
 
+/*
+ * drop the font references and raster held by the context
+ */
+void tui_fontmgmt_release(struct tui_context* tui);
+
 /*
  * setup the font stat from the 'start' state provided from the connection
  */
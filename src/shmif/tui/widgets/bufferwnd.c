@@ -141,6 +141,19 @@ size_t arcan_tui_bufferwnd_tell(struct tui_context* T, struct tui_bufferwnd_opts
 	return M->buffer_ofs;
 }
 
+void arcan_tui_bufferwnd_view(struct tui_context* T, size_t* top, size_t* cursor)
+{
+	struct bufferwnd_meta* M;
+	if (!validate_context(T, &M))
+		return;
+
+	if (top)
+		*top = M->buffer_pos;
+
+	if (cursor)
+		*cursor = M->buffer_pos + M->buffer_ofs;
+}
+
 static void step_cursor_e(struct tui_context* T, struct bufferwnd_meta* M);
 
 static bool has_cursor(struct bufferwnd_meta* M)
@@ -943,7 +956,7 @@ static bool on_label_query(struct tui_context* T,
 	if (COUNT_OF(labels) < index + 1){
 		if (M->old_handlers.query_label)
 			return M->old_handlers.query_label(T,
-				index - COUNT_OF(labels) - 1, country, lang, dstlbl, M->old_handlers.tag);
+				index - COUNT_OF(labels), country, lang, dstlbl, M->old_handlers.tag);
 		return false;
 	}
 
@@ -1035,13 +1048,25 @@ static bool on_u8(struct tui_context* T, const char* u8, size_t len, void* tag)
 	return false;
 }
 
+static size_t text_row_back(
+	struct tui_context* T, struct bufferwnd_meta* M, size_t pos);
+
 static void scroll_page_down(struct tui_context* T, struct bufferwnd_meta* M)
 {
 	switch (M->opts.view_mode){
 	case BUFFERWND_VIEW_UTF8:
 	case BUFFERWND_VIEW_ASCII:{
-/* need to sweep the buffer in order to figure out where the 'page' starts
- * based on wrapping mode */
+/* the last visible row becomes the first, the sweep is the same as for the
+ * mouse picking so wrapping mode is respected */
+		M->cursor_x = 0;
+		M->cursor_y = M->cursor_ofs_row_end;
+		resolve_temp.ofs = 0;
+		size_t pos = screen_to_pos(T, M);
+		if (pos && M->buffer_pos + pos < M->buffer_sz){
+			M->buffer_pos += pos;
+			M->buffer_ofs = 0;
+		}
+		M->cursor_y = 0;
 	}
 	break;
 	case BUFFERWND_VIEW_HEX:
@@ -1062,8 +1087,12 @@ static void scroll_page_up(struct tui_context* T, struct bufferwnd_meta* M)
 	switch (M->opts.view_mode){
 	case BUFFERWND_VIEW_UTF8:
 	case BUFFERWND_VIEW_ASCII:{
-/* need to sweep the buffer in order to figure out where the 'page' starts
- * based on wrapping mode */
+/* no way of knowing where the rows before start without sweeping backwards
+ * one row at a time, each step is bounded by the row length */
+		for (size_t i = M->cursor_ofs_row; i < M->cursor_ofs_row_end && M->buffer_pos; i++)
+			M->buffer_pos = text_row_back(T, M, M->buffer_pos);
+		M->buffer_ofs = 0;
+		M->cursor_x = M->cursor_y = 0;
 	}
 	break;
 	case BUFFERWND_VIEW_HEX:
@@ -1106,45 +1135,53 @@ static void scroll_row_down(struct tui_context* T, struct bufferwnd_meta* M)
 	redraw_bufferwnd(T, M);
 }
 
-static void scroll_row_up(struct tui_context* T, struct bufferwnd_meta* M)
+/* find where the row before the one starting at [pos] begins in the text
+ * modes, this is bounded by the number of columns so it stays cheap */
+static size_t text_row_back(
+	struct tui_context* T, struct bufferwnd_meta* M, size_t pos)
 {
-/* this one is easy for hex still, but for ASCII and UTF8 it is the worst
- * case as we need to take both linefeed mode into account and (UTF8) deal
- * with variability in glyph visible length */
-	switch (M->opts.view_mode){
-
-/* not correct for UTF8, but treat them similarly for now */
-	case BUFFERWND_VIEW_UTF8:
-	case BUFFERWND_VIEW_ASCII:{
-		size_t cofs = 1;
-		size_t rows, cols;
-		bool in_linefeed = false;
-		arcan_tui_dimensions(T, &rows, &cols);
+	size_t cofs = 1;
+	size_t rows, cols;
+	bool in_linefeed = false;
+	arcan_tui_dimensions(T, &rows, &cols);
 
-		while (cofs < M->buffer_pos && cols){
+	while (cofs < pos && cols){
 /* we are already at a renderable / split point, so increment first */
-			uint8_t ch = M->buffer[M->buffer_pos - cofs];
+		uint8_t ch = M->buffer[pos - cofs];
 
 /* line-breaks, for UTF we'd need to also consider, at least, non-advancing
  * whitespace and all that kind of jazz */
-			if (ch == '\n' || ch == '\r'){
-				if (M->opts.wrap_mode != BUFFERWND_WRAP_ALL){
-					if (in_linefeed){
-						cofs--;
-						break;
-					}
-					in_linefeed = true;
+		if (ch == '\n' || ch == '\r'){
+			if (M->opts.wrap_mode != BUFFERWND_WRAP_ALL){
+				if (in_linefeed){
+					cofs--;
+					break;
 				}
+				in_linefeed = true;
 			}
+		}
 /* valid printable character (will need a utf-8 seekback etc. step here
  * as well, then the hairy problem of what to do with substitution table
  * or shaping functions */
-			cols--;
-			if (cols)
-				cofs++;
-		}
-		M->buffer_pos -= M->buffer_pos > cofs ? cofs : M->buffer_pos;
+		cols--;
+		if (cols)
+			cofs++;
 	}
+
+	return pos - (pos > cofs ? cofs : pos);
+}
+
+static void scroll_row_up(struct tui_context* T, struct bufferwnd_meta* M)
+{
+/* this one is easy for hex still, but for ASCII and UTF8 it is the worst
+ * case as we need to take both linefeed mode into account and (UTF8) deal
+ * with variability in glyph visible length */
+	switch (M->opts.view_mode){
+
+/* not correct for UTF8, but treat them similarly for now */
+	case BUFFERWND_VIEW_UTF8:
+	case BUFFERWND_VIEW_ASCII:
+		M->buffer_pos = text_row_back(T, M, M->buffer_pos);
 	break;
 	case BUFFERWND_VIEW_HEX:
 	case BUFFERWND_VIEW_HEX_DETAIL:
@@ -1397,6 +1434,27 @@ void arcan_tui_bufferwnd_seek(struct tui_context* T, size_t buf_pos)
 	if (buf_pos >= M->buffer_sz)
 		buf_pos = M->buffer_sz - 1;
 
+/* the text modes have no fixed number of bytes per page, put the row holding
+ * the offset first instead, the sweep back to the linefeed is bounded so that
+ * a single long line still keeps the cursor in view */
+	if (M->opts.view_mode == BUFFERWND_VIEW_UTF8 ||
+		M->opts.view_mode == BUFFERWND_VIEW_ASCII){
+		size_t rows, cols;
+		arcan_tui_dimensions(T, &rows, &cols);
+		size_t line = buf_pos;
+		size_t bound = buf_pos > (rows * cols) / 2 ? buf_pos - (rows * cols) / 2 : 0;
+
+		if (M->opts.wrap_mode != BUFFERWND_WRAP_ALL){
+			while (line > bound && M->buffer[line - 1] != '\n')
+				line--;
+		}
+
+		M->buffer_pos = line;
+		M->buffer_ofs = buf_pos - line;
+		redraw_bufferwnd(T, M);
+		return;
+	}
+
 /* cursor_ofs_row gives us starting row,
  * row_bytelen gives us the number of bytes per row
  * cursor_ofs_row_end gives us the last row line
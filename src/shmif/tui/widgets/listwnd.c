@@ -6,6 +6,7 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <string.h>
+#include <stdlib.h>
 #include <assert.h>
 
 /*
@@ -22,7 +23,7 @@
  *    more difficult is adding an expand-collapse so selection would expand
  *  - handle accessibility subwindow (provide only selected item for t2s)
  *  - allow multiple weighted column formats for wider windows
- *  - prefix typing for searching
+ *  - prefix typing for searching (static lists, virtual ones filter)
  */
 
 #ifndef COUNT_OF
@@ -33,15 +34,47 @@
 #define INACTIVE_ITEM (LIST_SEPARATOR | LIST_LABEL | LIST_PASSIVE | LIST_HIDE)
 #define HIDDEN_ITEM (LIST_HIDE)
 
+/* virtual lists: number of fetched entries kept around, direct mapped on the
+ * source index so it covers the visible rows and some overscan when stepping */
+#define LISTWND_CACHE 256
+
+/* virtual lists: source entries tested per tick in a filter pass */
+#define LISTWND_FILTER_STEP 16384
+#define LISTWND_FILTER_LIM 64
+
+struct listwnd_slot {
+	bool used;
+	size_t index;
+	struct tui_list_entry ent;
+};
+
 #define LISTWND_MAGIC 0xfadef00e
 struct listwnd_meta {
 /* debug-help, check against LISTWND_MAGIC */
 	uint32_t magic;
 
-/* actual entries, flags can mutate, size cannot */
+/* actual entries, flags can mutate, size cannot - list_sz is the number of
+ * presentable entries, which for a filtered virtual list is match_sz */
 	struct tui_list_entry* list;
 	size_t list_sz;
 
+/* virtual lists have no [list], entries are pulled through [src] and copied
+ * into [cache], the caller only needs to keep them valid during fetch */
+	struct tui_context* tui;
+	struct tui_list_source src;
+	size_t n_entries;
+	struct listwnd_slot* cache;
+
+/* incremental filter on virtual lists, [match] are source indices in ascending
+ * order. A pass tests [scan_set] (or the whole source when NULL) from scan_pos
+ * to scan_end a step at a time on tick, scan_end is cleared when done */
+	char filter[LISTWND_FILTER_LIM];
+	size_t filter_len;
+	size_t* match;
+	size_t match_sz, match_cap;
+	size_t* scan_set;
+	size_t scan_pos, scan_end;
+
 /* current logical cursor position and resolved screen position */
 	size_t list_pos;
 	size_t list_row;
@@ -49,7 +82,7 @@ struct listwnd_meta {
 /* first row start */
 	size_t list_ofs;
 
-/* set when user has made a selection, and the selected item */
+/* set when user has made a selection, and the selected (source) item */
 	int entry_state;
 	size_t entry_pos;
 
@@ -82,24 +115,106 @@ static bool validate(struct tui_context* T, struct listwnd_meta** M)
 	return true;
 }
 
-static size_t get_visible_offset(struct listwnd_meta* M)
+static struct tui_list_entry missing_entry = {
+	.label = "",
+	.attributes = LIST_PASSIVE
+};
+
+static void drop_slot(struct listwnd_slot* slot)
+{
+	if (!slot->used)
+		return;
+
+	free(slot->ent.label);
+	free(slot->ent.shortcut);
+	*slot = (struct listwnd_slot){0};
+}
+
+static void drop_cache(struct listwnd_meta* M)
+{
+	if (!M->cache)
+		return;
+
+	for (size_t i = 0; i < LISTWND_CACHE; i++)
+		drop_slot(&M->cache[i]);
+}
+
+/* resolve a source index, for virtual lists this is the only place fetch is
+ * called outside of filtering and the result lives until the slot is reused */
+static struct tui_list_entry* source_entry(struct listwnd_meta* M, size_t ind)
+{
+	if (M->list)
+		return &M->list[ind];
+
+	struct listwnd_slot* slot = &M->cache[ind % LISTWND_CACHE];
+	if (slot->used && slot->index == ind)
+		return &slot->ent;
+
+	drop_slot(slot);
+	struct tui_list_entry ent = {0};
+	if (ind >= M->n_entries || !M->src.fetch(M->tui, ind, &ent, M->src.tag))
+		return &missing_entry;
+
+	ent.label = strdup(ent.label ? ent.label : "");
+	if (!ent.label)
+		return &missing_entry;
+
+	if (ent.shortcut)
+		ent.shortcut = strdup(ent.shortcut);
+
+	*slot = (struct listwnd_slot){
+		.used = true,
+		.index = ind,
+		.ent = ent
+	};
+
+	return &slot->ent;
+}
+
+static size_t source_index(struct listwnd_meta* M, size_t i)
 {
+	return M->filter_len ? M->match[i] : i;
+}
+
+static struct tui_list_entry* get_entry(struct listwnd_meta* M, size_t i)
+{
+	return source_entry(M, source_index(M, i));
+}
+
+/* rows available for entries, the last one shows an active filter */
+static size_t list_rows(struct tui_context* T, struct listwnd_meta* M)
+{
+	size_t rows, cols;
+	arcan_tui_dimensions(T, &rows, &cols);
+	if (M->filter_len && rows > 1)
+		rows--;
+	return rows;
+}
+
+/* check if the cursor fits in [rows] from list_ofs without walking further
+ * than that, the list can be long enough that a full sweep is not an option */
+static bool cursor_on_page(struct listwnd_meta* M, size_t rows)
+{
+	if (M->list_pos < M->list_ofs)
+		return false;
+
 	size_t ofs = 0;
 	for (size_t i = M->list_ofs; i < M->list_pos; i++){
-		if (M->list[i].attributes & HIDDEN_ITEM)
+		if (get_entry(M, i)->attributes & HIDDEN_ITEM)
 			continue;
-		ofs++;
+		if (++ofs >= rows)
+			return false;
 	}
-	return ofs;
+	return true;
 }
 
 ssize_t arcan_tui_listwnd_tell(struct tui_context* T)
 {
 	struct listwnd_meta* M;
-	if (!validate(T, &M))
+	if (!validate(T, &M) || !M->list_sz)
 		return -1;
 
-	return M->list_pos;
+	return source_index(M, M->list_pos);
 }
 
 static void redraw(struct tui_context* T, struct listwnd_meta* M)
@@ -111,9 +226,22 @@ static void redraw(struct tui_context* T, struct listwnd_meta* M)
 	if (!rows)
 		return;
 
-/* safeguard that we fit in the current screen, else we search */
-	for (size_t ofs = get_visible_offset(M); ofs > rows; M->list_ofs++){
-		ofs = get_visible_offset(M);
+	size_t page = list_rows(T, M);
+	bool status_row = page < rows;
+	rows = page;
+
+/* safeguard that we fit in the current screen, else scroll so that the cursor
+ * ends up on the first row (moved above) or the last row (moved below) */
+	if (M->list_pos < M->list_ofs)
+		M->list_ofs = M->list_pos;
+
+	else if (!cursor_on_page(M, page)){
+		M->list_ofs = M->list_pos;
+		for (size_t vis = 1; M->list_ofs > 0 && vis < page;){
+			M->list_ofs--;
+			if (!(get_entry(M, M->list_ofs)->attributes & HIDDEN_ITEM))
+				vis++;
+		}
 	}
 
 #define GET_COL_INDEX(X) {.aflags = TUI_ATTR_COLOR_INDEXED, .fc[0] = X, .bc[0] = X};
@@ -132,8 +260,9 @@ static void redraw(struct tui_context* T, struct listwnd_meta* M)
 /* now we can just clear / draw the items on the page */
 	c_row = 0;
 	for (size_t i = M->list_ofs; rows && i < M->list_sz; i++){
-		int lattr = M->list[i].attributes;
-		const char* label = M->list[i].label;
+		struct tui_list_entry* ent = get_entry(M, i);
+		int lattr = ent->attributes;
+		const char* label = ent->label;
 
 		if (lattr & HIDDEN_ITEM)
 			continue;
@@ -171,7 +300,7 @@ static void redraw(struct tui_context* T, struct listwnd_meta* M)
 
 /* tactic: draw as much as possible from starting label offset,
  * recall (& 0xc0) != 0x80 for utf8- start */
-		arcan_tui_move_to(T, 1+M->list[i].indent, c_row);
+		arcan_tui_move_to(T, 1+ent->indent, c_row);
 		for (size_t vofs = 0; vofs < cols - 2 && label[ofs]; vofs++){
 			size_t end = ofs + 1;
 			while (label[end] && (label[end] & 0xc0) == 0x80) end++;
@@ -192,6 +321,15 @@ static void redraw(struct tui_context* T, struct listwnd_meta* M)
 		c_row++;
 	}
 
+/* show the filter and if the pass is still running */
+	if (M->filter_len && status_row){
+		arcan_tui_move_to(T, 0, page);
+		arcan_tui_defattr(T, &inact);
+		arcan_tui_erase_region(T, 0, page, cols, page, false);
+		arcan_tui_printf(T, &inact, "/%.*s%s",
+			(int) M->filter_len, M->filter, M->scan_end ? " ..." : "");
+	}
+
 	arcan_tui_defattr(T, &reset_def);
 }
 
@@ -201,7 +339,20 @@ void arcan_tui_listwnd_setpos(struct tui_context* T, size_t n)
 	if (!validate(T, &M))
 		return;
 
-	if (n < M->list_sz)
+/* matches are sorted, so a filtered list can be searched */
+	if (M->filter_len){
+		size_t lo = 0, hi = M->match_sz;
+		while (lo < hi){
+			size_t mid = lo + ((hi - lo) >> 1);
+			if (M->match[mid] < n)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo < M->match_sz && M->match[lo] == n)
+			M->list_pos = lo;
+	}
+	else if (n < M->list_sz)
 		M->list_pos = n;
 
 	redraw(T, M);
@@ -209,28 +360,138 @@ void arcan_tui_listwnd_setpos(struct tui_context* T, size_t n)
 
 static void select_current(struct tui_context* T, struct listwnd_meta* M)
 {
-	int flags = M->list[M->list_pos].attributes;
+	if (!M->list_sz)
+		return;
+
+	int flags = get_entry(M, M->list_pos)->attributes;
 	if (flags & INACTIVE_ITEM)
 		return;
 	M->entry_state = 1;
-	M->entry_pos = M->list_pos;
+	M->entry_pos = source_index(M, M->list_pos);
+}
+
+static bool filter_match(const char* pattern, size_t len, const char* label)
+{
+	if (!label)
+		return false;
+
+	for (; *label; label++){
+		size_t i = 0;
+		while (i < len && label[i] &&
+			tolower((unsigned char) label[i]) == tolower((unsigned char) pattern[i]))
+			i++;
+		if (i == len)
+			return true;
+	}
+
+	return false;
+}
+
+/* test up to [budget] source entries against the filter, returns true if the
+ * set of matches changed */
+static bool filter_step(struct listwnd_meta* M, size_t budget)
+{
+	size_t start = M->match_sz;
+
+	while (M->scan_pos < M->scan_end && budget--){
+		size_t ind = M->scan_set ? M->scan_set[M->scan_pos] : M->scan_pos;
+		M->scan_pos++;
+
+/* fetch straight into a local so the visible entries stay cached */
+		struct tui_list_entry ent = {0};
+		if (ind >= M->n_entries || !M->src.fetch(M->tui, ind, &ent, M->src.tag))
+			continue;
+
+		if ((ent.attributes & (HIDDEN_ITEM | LIST_SEPARATOR)) ||
+			!filter_match(M->filter, M->filter_len, ent.label))
+			continue;
+
+		if (M->match_sz == M->match_cap){
+			size_t cap = M->match_cap ? M->match_cap * 2 : 256;
+			size_t* match = realloc(M->match, cap * sizeof(size_t));
+			if (!match){
+				M->scan_pos = M->scan_end;
+				break;
+			}
+			M->match = match;
+			M->match_cap = cap;
+		}
+
+		M->match[M->match_sz++] = ind;
+	}
+
+	if (M->scan_pos >= M->scan_end){
+		free(M->scan_set);
+		M->scan_set = NULL;
+		M->scan_pos = M->scan_end = 0;
+	}
+
+	M->list_sz = M->match_sz;
+	return M->match_sz != start;
+}
+
+/* the filter has changed, cancel any pass in flight and start a new one. When
+ * the pattern only grew and the previous pass completed, the new matches are a
+ * subset of the old so only those need to be tested again */
+static void filter_update(struct tui_context* T, struct listwnd_meta* M, bool narrow)
+{
+	bool subset = narrow && !M->scan_end;
+	size_t* prev = M->match;
+	size_t prev_sz = M->match_sz;
+
+	free(M->scan_set);
+	M->scan_set = NULL;
+	M->match = NULL;
+	M->match_sz = M->match_cap = 0;
+	M->scan_pos = 0;
+	M->list_pos = M->list_ofs = 0;
+
+	if (!M->filter_len){
+		free(prev);
+		M->scan_end = 0;
+		M->list_sz = M->n_entries;
+		redraw(T, M);
+		return;
+	}
+
+	if (subset){
+		M->scan_set = prev;
+		M->scan_end = prev_sz;
+	}
+	else {
+		free(prev);
+		M->scan_end = M->n_entries;
+	}
+
+/* first step right away so the common case doesn't wait for the tick */
+	filter_step(M, LISTWND_FILTER_STEP);
+	redraw(T, M);
 }
 
 static void cancel(struct tui_context* T, struct listwnd_meta* M)
 {
+/* first cancel clears an active filter */
+	if (M->filter_len){
+		M->filter_len = 0;
+		filter_update(T, M, false);
+		return;
+	}
+
 	M->entry_state = -1;
 }
 
 static void step_page_s(struct tui_context* T, struct listwnd_meta* M)
 {
-	size_t rows, cols;
-	arcan_tui_dimensions(T, &rows, &cols);
+	if (!M->list_sz)
+		return;
+
+	size_t rows = list_rows(T, M);
 
 /* increment offset half- a page */
 	rows = (rows >> 1) + 1;
 	size_t c_row;
 	for (c_row = M->list_ofs; c_row < M->list_sz && rows; c_row++){
-		if (M->list[c_row].attributes & INACTIVE_ITEM)
+		if (get_entry(M, c_row)->attributes & INACTIVE_ITEM)
 			continue;
 
 		rows--;
@@ -248,7 +509,7 @@ static void step_page_s(struct tui_context* T, struct listwnd_meta* M)
 
 /* step cursor to next sane */
 	for (c_row = M->list_pos; c_row < M->list_sz; c_row++){
-		if (!(M->list[c_row].attributes & INACTIVE_ITEM)){
+		if (!(get_entry(M, c_row)->attributes & INACTIVE_ITEM)){
 			M->list_pos = c_row;
 			break;
 		}
@@ -263,22 +524,18 @@ static void step_page_n(struct tui_context* T, struct listwnd_meta* M)
 
 static void step_cursor_n(struct tui_context* T, struct listwnd_meta* M)
 {
+	if (!M->list_sz)
+		return;
+
 	size_t current = M->list_pos;
-	size_t vis_step = 0;
 	do {
 		current = current > 0 ? current - 1 : M->list_sz - 1;
-		if (!(M->list[current].attributes & HIDDEN_ITEM))
-			vis_step++;
-
-		if (!(M->list[current].attributes & INACTIVE_ITEM))
+		if (!(get_entry(M, current)->attributes & INACTIVE_ITEM))
 			break;
 
 	} while (current != M->list_pos);
 
-	if (M->list_row < vis_step){
-		step_page_n(T, M);
-		return;
-	}
+/* redraw scrolls the page if the new cursor is above it */
 
 	M->list_pos = current;
 	redraw(T, M);
@@ -286,8 +543,10 @@ static void step_cursor_n(struct tui_context* T, struct listwnd_meta* M)
 
 static void step_cursor_s(struct tui_context* T, struct listwnd_meta* M)
 {
-	size_t rows, cols;
-	arcan_tui_dimensions(T, &rows, &cols);
+	if (!M->list_sz)
+		return;
+
+	size_t rows = list_rows(T, M);
 
 /* find the next selectable item, and detect if it is on this page or not */
 	size_t current = M->list_pos;
@@ -296,7 +555,8 @@ static void step_cursor_s(struct tui_context* T, struct listwnd_meta* M)
 
 	do {
 		current = (current + 1) % M->list_sz;
-		if (!(M->list[current].attributes & HIDDEN_ITEM)){
+		struct tui_list_entry* ent = get_entry(M, current);
+		if (!(ent->attributes & HIDDEN_ITEM)){
 			vis_step++;
 
 /* track the first visible on the next page */
@@ -306,7 +566,7 @@ static void step_cursor_s(struct tui_context* T, struct listwnd_meta* M)
 			}
 		}
 
-		if (!(M->list[current].attributes & INACTIVE_ITEM))
+		if (!(ent->attributes & INACTIVE_ITEM))
 			break;
 
 /* end condition is wrap */
@@ -334,6 +594,19 @@ void arcan_tui_listwnd_dirty(struct tui_context* T)
 	if (!validate(T, &M))
 		return;
 
+/* entries may have changed as well as their number, restart any filter */
+	if (!M->list){
+		drop_cache(M);
+		M->n_entries = M->src.count(T, M->src.tag);
+		if (M->filter_len){
+			filter_update(T, M, false);
+			return;
+		}
+		M->list_sz = M->n_entries;
+		if (M->list_pos >= M->list_sz)
+			M->list_pos = M->list_ofs = 0;
+	}
+
 	redraw(T, M);
 }
 
@@ -345,6 +618,20 @@ static bool u8(struct tui_context* T, const char* u8, size_t len, void* tag)
 	cp[len] = '\0';
 
 	struct listwnd_meta* M = tag;
+
+/* virtual lists are too large to sweep for shortcuts, filter instead */
+	if (!M->list){
+		if ((unsigned char) cp[0] < 0x20 ||
+			M->filter_len + len >= LISTWND_FILTER_LIM)
+			return true;
+
+		bool narrow = M->filter_len > 0;
+		memcpy(&M->filter[M->filter_len], cp, len);
+		M->filter_len += len;
+		filter_update(T, M, narrow);
+		return true;
+	}
+
 	for (size_t i = 0; i < M->list_sz; i++){
 		if (M->list[i].shortcut && strcmp(M->list[i].shortcut, cp) == 0){
 			if (M->list[i].attributes & ~(INACTIVE_ITEM)){
@@ -372,7 +659,7 @@ bool arcan_tui_listwnd_status(struct tui_context* T, struct tui_list_entry** out
 		*out = NULL;
 /* or selected a real item */
 	else if (M->entry_state == 1 && out)
-		*out = &M->list[M->entry_pos];
+		*out = source_entry(M, M->entry_pos);
 
 	M->entry_state = 0;
 	return true;
@@ -461,6 +748,16 @@ static void key_input(struct tui_context* T, uint32_t keysym,
 	uint8_t scancode, uint16_t mods, uint16_t subid, void* tag)
 {
 	struct listwnd_meta* M = tag;
+
+/* drop the last codepoint from the filter */
+	if (keysym == TUIK_BACKSPACE && M->filter_len){
+		do {
+			M->filter_len--;
+		} while (M->filter_len && (M->filter[M->filter_len] & 0xc0) == 0x80);
+		filter_update(T, M, false);
+		return;
+	}
+
 	for (size_t i = 0; i < COUNT_OF(labels); i++){
 		if ((keysym && keysym == labels[i].alt) ||
 			keysym == labels[i].ent.initial)
@@ -483,6 +780,11 @@ void arcan_tui_listwnd_release(struct tui_context* T)
 
 	arcan_tui_reset_labels(T);
 
+	drop_cache(M);
+	free(M->cache);
+	free(M->match);
+	free(M->scan_set);
+
 /* it would make sense to 'fake' a resize here as well, but from some design
  * oversights with the event, that requires tracking or exposing shmif_ context
  * contents, or breaking ABI - so assume the caller actually has the sense to
@@ -541,6 +843,13 @@ static void tick(struct tui_context* T, void* t)
 	if (M->old_handlers.tick){
 		M->old_handlers.tick(T, M->old_handlers.tag);
 	}
+
+/* continue a filter pass in flight, only the visible rows need redrawing */
+	if (M->scan_end){
+		if (filter_step(M, LISTWND_FILTER_STEP) || !M->scan_end)
+			redraw(T, M);
+	}
+
 /* if current item is cropped, scroll it */
 }
 
@@ -582,8 +891,11 @@ static void mouse_motion(struct tui_context* T,
 		return;
 	}
 
-	for (size_t i = M->list_ofs, yp = 0; i < M->list_sz; i++){
-		if (M->list[i].attributes & HIDDEN_ITEM)
+	if (mouse_y < 0)
+		return;
+
+	for (size_t i = M->list_ofs, yp = 0; i < M->list_sz && yp <= mouse_y; i++){
+		if (get_entry(M, i)->attributes & HIDDEN_ITEM)
 			continue;
 
 /* find matching position */
@@ -644,12 +956,9 @@ static bool on_label_query(struct tui_context* T,
 	return true;
 }
 
-bool arcan_tui_listwnd_setup(
-	struct tui_context* T, struct tui_list_entry* L, size_t n_entries)
+static bool setup(struct tui_context* T,
+	struct tui_list_entry* L, size_t n_entries, struct tui_list_source* src)
 {
-	if (!T || !L || n_entries == 0)
-		return false;
-
 	struct listwnd_meta* meta = malloc(sizeof(struct listwnd_meta));
 	if (!meta)
 		return false;
@@ -657,9 +966,21 @@ bool arcan_tui_listwnd_setup(
 	*meta = (struct listwnd_meta){
 		.magic = LISTWND_MAGIC,
 		.list_sz = n_entries,
+		.n_entries = n_entries,
 		.list = L,
+		.tui = T
 	};
 
+	if (src){
+		meta->src = *src;
+		meta->cache = malloc(sizeof(struct listwnd_slot) * LISTWND_CACHE);
+		if (!meta->cache){
+			free(meta);
+			return false;
+		}
+		memset(meta->cache, '\0', sizeof(struct listwnd_slot) * LISTWND_CACHE);
+	}
+
 /* save old flags and just set clean + ALTERNATE */
 	meta->old_flags =
 		arcan_tui_set_flags(T, TUI_ALTERNATE | TUI_HIDE_CURSOR | TUI_MOUSE);
@@ -691,22 +1012,30 @@ bool arcan_tui_listwnd_setup(
 /* and check for misuse */
 	assert(meta->old_handlers.resize != resize);
 
-/* rough utf8-len based on labels alone */
-	size_t max_w = 0;
-	for (size_t i = 0; i < n_entries; i++){
-		size_t j = 0, w = 0;
-		while (L[i].label[j]){
-			w += (L[i].label[j++] & 0xc0) != 0x80;
+	arcan_tui_dimensions(T, &meta->orig_h, &meta->orig_w);
+
+/* rough utf8-len based on labels alone, virtual lists keep the current size
+ * as measuring would mean fetching every entry */
+	size_t max_w = meta->orig_w > 4 ? meta->orig_w - 4 : 0;
+	size_t max_h = meta->orig_h > 1 ? meta->orig_h - 1 : 0;
+
+	if (L){
+		max_w = 0;
+		max_h = n_entries;
+		for (size_t i = 0; i < n_entries; i++){
+			size_t j = 0, w = 0;
+			while (L[i].label[j]){
+				w += (L[i].label[j++] & 0xc0) != 0x80;
+			}
+			if (w > max_w)
+				max_w = w;
 		}
-		if (w > max_w)
-			max_w = w;
 	}
 
-	arcan_tui_dimensions(T, &meta->orig_h, &meta->orig_w);
 	arcan_tui_wndhint(T, NULL,
 		(struct tui_constraints){
 			.min_cols = -1, .min_rows = -1,
-			.max_cols = max_w + 4, .max_rows = n_entries + 1,
+			.max_cols = max_w + 4, .max_rows = max_h + 1,
 			.anch_row = -1, .anch_col = -1
 		}
 	);
@@ -718,6 +1047,24 @@ bool arcan_tui_listwnd_setup(
 	return true;
 }
 
+bool arcan_tui_listwnd_setup(
+	struct tui_context* T, struct tui_list_entry* L, size_t n_entries)
+{
+	if (!T || !L || n_entries == 0)
+		return false;
+
+	return setup(T, L, n_entries, NULL);
+}
+
+bool arcan_tui_listwnd_setup_virtual(
+	struct tui_context* T, struct tui_list_source* src)
+{
+	if (!T || !src || !src->count || !src->fetch)
+		return false;
+
+	return setup(T, NULL, src->count(T, src->tag), src);
+}
+
 #ifdef EXAMPLE
 
 static struct tui_list_entry test_easy[] = {
@@ -54,9 +54,9 @@ struct readline_meta {
 	char* suggest_suffix;
 	size_t suggest_suffix_sz;
 	size_t completion_sz;
-	size_t completion_width;
 	size_t completion_mode;
 	size_t completion_pos;
+	size_t completion_top;
 	int completion_hint;
 
 /* used to colorize the data part when drawing, offsets are in codepoints */
@@ -219,40 +219,6 @@ static void drop_completion(
 		add_input(T, M, M->suggest_suffix, M->suggest_suffix_sz, true);
 }
 
-/* find the codepoint that is within the next format offset (if any) ofs is in
- * bytes so linear search (not cheap but small n and only circumstantial use,
- * simple optimization would otherwise be to assume ofs will grow and cache
- * ch+fmt_i between calls */
-static struct tui_screen_attr* get_attr_for_ofs(struct readline_meta* M, size_t ofs)
-{
-	size_t ch = 0;
-	size_t fmt_i = 0;
-
-	if (!M->line_format)
-		return NULL;
-
-/* invariant: attr applies from 0, ofs to get attr from is also at 0 */
-	struct tui_screen_attr* fmt = NULL;
-	if (!M->line_format_ofs[0])
-		fmt = &M->line_format[0];
-
-	for (size_t i = 0; i < M->work_sz &&
-			i <= ofs; i = utf8fwd(i, M->work, M->work_sz)){
-
-		while (M->line_format_ofs[fmt_i] <= ch){
-			fmt_i++;
-			if (fmt_i >= M->line_format_sz)
-				break;
-
-			fmt = &M->line_format[fmt_i];
-		}
-
-		ch = ch + 1;
-	}
-
-	return fmt;
-}
-
 static size_t u8len(const char* buf)
 {
 	size_t len = 0;
@@ -297,10 +263,18 @@ static void draw_completion(
 	if (rows - cy < (rows >> 1))
 		step = -1;
 
+/* the set can be much larger than what fits, only the window of entries
+ * around the selected one gets measured and drawn */
+	size_t visible = step > 0 ? rows - cy - 1 : cy;
+	if (M->completion_pos < M->completion_top)
+		M->completion_top = M->completion_pos;
+	else if (visible && M->completion_pos >= M->completion_top + visible)
+		M->completion_top = M->completion_pos - visible + 1;
+
 	struct tui_screen_attr attr = arcan_tui_defcattr(T, TUI_COL_UI);
 
 	size_t maxw = 0;
-	for (size_t i = 0, j = cy + step;
+	for (size_t i = M->completion_top, j = cy + step;
 		!M->opts.completion_compact &&
 		i < M->completion_sz && j >= 0 && j < rows; i++, j += step){
 		size_t len = 0;
@@ -323,7 +297,7 @@ static void draw_completion(
 	size_t lasty = 0;
 	maxw += cx;
 
-	for (ssize_t i = 0, j = cy + step;
+	for (ssize_t i = M->completion_top, j = cy + step;
 		i < M->completion_sz && j >= 0 && j < rows; i++, j += step){
 		arcan_tui_move_to(T, cx, j);
 		lasty = j;
@@ -468,25 +442,60 @@ static void refresh(struct tui_context* T, struct readline_meta* M)
 		}
 	}
 
-	for (size_t i = 0; i < M->work_len && i < limit; i++){
-		uint32_t ch;
+/* line_format applies from codepoint offsets, so walk it alongside the drawn
+ * codepoints and collect runs with the same attribute into one span write */
+	size_t cp = 0;
+	for (size_t i = 0; i < pos; i++)
+		cp += (M->work[i] & 0xc0) != 0x80;
+
+	size_t fmt_i = 0;
+	const struct tui_screen_attr* fmt = NULL;
+
+	struct tui_attr_run runs[32];
+	size_t n_runs = 0;
+	size_t span = pos;
+
+	size_t x0, y0;
+	arcan_tui_cursorpos(T, &x0, &y0);
+
+	for (size_t i = 0; i < M->work_len && i < limit && pos < M->work_ofs; i++, cp++){
 		if (pos == M->cursor){
-			arcan_tui_cursorpos(T, &cx, &cy);
+			cx = x0 + i;
+			cy = y0;
 		}
-		ssize_t step = arcan_tui_utf8ucs4((char*) &M->work[pos], &ch);
-		if (M->opts.mask_character)
-			ch = M->opts.mask_character;
 
-		if (step > 0)
-			pos += step;
+		while (fmt_i < M->line_format_sz && M->line_format_ofs[fmt_i] <= cp)
+			fmt = &M->line_format[fmt_i++];
 
-		struct tui_screen_attr* attr = get_attr_for_ofs(M, pos);
+		const struct tui_screen_attr* attr = fmt;
 		if (M->broken_offset != -1 && pos >= M->broken_offset)
-			arcan_tui_write(T, ch, &alert);
-		else
-			arcan_tui_write(T, ch, attr);
+			attr = &alert;
+
+		size_t next = utf8fwd(pos, M->work, M->work_ofs);
+		if (M->opts.mask_character){
+			arcan_tui_write(T, M->opts.mask_character, attr);
+			pos = next;
+			continue;
+		}
+
+		if (!n_runs || runs[n_runs-1].attr != attr){
+			if (n_runs == sizeof(runs) / sizeof(runs[0])){
+				arcan_tui_writeu8_runs(T,
+					(const uint8_t*) &M->work[span], pos - span, runs, n_runs);
+				span = pos;
+				n_runs = 0;
+			}
+			runs[n_runs++] = (struct tui_attr_run){.attr = attr};
+		}
+
+		runs[n_runs-1].len += next - pos;
+		pos = next;
 	}
 
+	if (n_runs)
+		arcan_tui_writeu8_runs(T,
+			(const uint8_t*) &M->work[span], pos - span, runs, n_runs);
+
 	if (M->show_completion && M->completion && M->completion_sz){
 		draw_completion(T, M, M->opts.popup);
 	}
@@ -605,9 +614,9 @@ static bool delete_at_cursor(struct tui_context* T, struct readline_meta* M)
 
 	size_t c_cursor = utf8fwd(M->cursor, M->work, M->work_ofs);
 	memmove(&M->work[M->cursor], &M->work[c_cursor], M->work_ofs - c_cursor);
+	M->work_ofs -= c_cursor - M->cursor;
 	M->work[M->work_ofs] = '\0';
-	M->work_ofs--;
-	M->work_len = utf8len(M->work_ofs, M->work);
+	M->work_len--;
 
 	refresh(T, M);
 
@@ -633,6 +642,7 @@ static bool erase_at_cursor(struct tui_context* T, struct readline_meta* M)
 	M->cursor = c_cursor;
 	M->work_len--;
 	M->work_ofs -= len;
+	M->work[M->work_ofs] = '\0';
 
 /* check if we are broken at some offset */
 	verify(T, M);
@@ -689,10 +699,10 @@ static void delete_last_word(struct tui_context* T, struct readline_meta* M)
 		end = M->work_ofs;
 
 	M->cursor = beg;
-	size_t ntr = end - beg;
-	M->work_ofs -= ntr;
-	memmove(&M->work[beg], &M->work[end], M->work_ofs);
-	M->work_len = utf8len(M->work_ofs, M->work);
+	M->work_len -= utf8len(end - beg, &M->work[beg]);
+	memmove(&M->work[beg], &M->work[end], M->work_ofs - end);
+	M->work_ofs -= end - beg;
+	M->work[M->work_ofs] = '\0';
 
 	refresh(T, M);
 }
@@ -1013,20 +1023,19 @@ static bool ensure_size(
 	if (sz <= M->work_sz)
 		return true;
 
-/* pick a larger step size just to cut down on the number of allocations in
- * the common "type/paste" scenario */
-	sz += 1024;
-	size_t cols;
-	arcan_tui_dimensions(T, NULL, &cols);
-	char* new_buf = malloc(sz);
+/* grow geometrically so that typing / pasting into a long line doesn't copy
+ * the whole buffer every few keystrokes */
+	size_t new_sz = M->work_sz ? M->work_sz : 1024;
+	while (new_sz < sz)
+		new_sz *= 2;
+
+	char* new_buf = realloc(M->work, new_sz);
 	if (!new_buf)
 		return false;
 
-	memset(new_buf, '\0', sz);
-	memcpy(new_buf, M->work, M->work_ofs);
-	free(M->work);
+	memset(&new_buf[M->work_ofs], '\0', new_sz - M->work_ofs);
 	M->work = new_buf;
-	M->work_sz = sz;
+	M->work_sz = new_sz;
 
 	return true;
 }
@@ -1069,6 +1078,7 @@ static void add_input(struct tui_context* T,
 
 		memcpy(&M->work[M->cursor], u8, len);
 		M->cursor += len;
+		M->work[M->work_ofs + len] = '\0';
 	}
 
 	if (!noverify)
@@ -1234,14 +1244,7 @@ void arcan_tui_readline_suggest(
 	M->completion_mode = mode & ~(mask);
 	M->completion_hint = mode & mask;
 	M->completion_pos = 0;
-
-/* pre-calculate the completion set width so refresh can reposition as needed */
-	M->completion_width = 0;
-	for (size_t i = 0; i < M->completion_sz; i++){
-		size_t len = strlen(M->completion[i]);
-		if (len > M->completion_width)
-			M->completion_width = len;
-	}
+	M->completion_top = 0;
 
 	if (M->show_completion){
 		refresh(T, M);
@@ -1494,7 +1497,7 @@ void arcan_tui_readline_format(
 	release_line_format(M);
 	M->line_format = attr;
 	M->line_format_ofs = ofs;
-	M->line_format_sz = 0;
+	M->line_format_sz = attr && ofs ? n : 0;
 	refresh(T, M);
 }
 
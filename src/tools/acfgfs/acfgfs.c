@@ -12,6 +12,14 @@
  * eval /path=value : simulate path and see if the value would be accepted or not
  *
  * these are all mapped via wait_for_command and exposed as either directories or FIFOs.
+ *
+ * The appl can also push a line at any time (inside a command reply or not):
+ *
+ * invalidate /path : results cached for path and everything below it are stale
+ *
+ * Attributes, contents and listings are cached for --ttl seconds (and the same
+ * timeout is handed to the kernel), so a tree walk costs one ls per directory
+ * rather than one read per getattr/open.
  */
 
 #define FUSE_USE_VERSION 31
@@ -32,6 +40,8 @@
 #include <stdarg.h>
 #include <sys/socket.h>
 #include <pthread.h>
+#include <poll.h>
+#include <time.h>
 
 _Static_assert(sizeof(uint64_t) >= sizeof(uintptr_t), "filehandle can't hold pointer");
 
@@ -77,21 +87,498 @@ static struct options {
 	const char* control;
 	int con;
 	int show_help;
+	double ttl;
 } options = {
 	.control = NULL,
-	.con = -1
+	.con = -1,
+	.ttl = 2.0
+};
+
+/*
+ * Lookup cache, one entry per path split into the three kinds of answers as
+ * they are fetched at different times: attributes (read, or primed from the
+ * ls of the parent), contents (read) and listings (ls). Each part ages out on
+ * its own, and invalidations from the appl drop the whole subtree.
+ *
+ * Lock order is in_command -> cache.lock, never the other way around.
+ */
+#define CACHE_BUCKETS 256
+#define CACHE_LIMIT 4096
+#define INVAL_QUEUE 32
+
+struct cache_ent {
+	char* path;
+
+	uint64_t attr_expire;
+	int attr_status;
+	struct stat attr;
+
+	uint64_t data_expire;
+	char* data;
+	size_t data_sz;
+	bool value;
+	bool kernel_seen;
+
+	uint64_t list_expire;
+	char* list;
+	size_t list_sz;
+
+	struct cache_ent* next;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t notify;
+	struct cache_ent* buckets[CACHE_BUCKETS];
+	size_t count;
+
+/* paths the kernel should drop, flushed from the notify thread as the
+ * notification itself can't be sent from within a filesystem operation */
+	char* inval[INVAL_QUEUE];
+	size_t n_inval;
+	bool inval_all;
+} cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.notify = PTHREAD_COND_INITIALIZER
 };
 
+struct file_ent_info {
+	uint32_t cookie;
+	char buffer[4096];
+	size_t used;
+	bool value;
+};
+
+struct list_buf {
+	char* buf;
+	size_t used;
+	size_t cap;
+};
+
+static bool caching()
+{
+	return options.ttl > 0.0;
+}
+
+static uint64_t now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t expire_at()
+{
+	return now_ms() + (uint64_t)(options.ttl * 1000.0);
+}
+
+static size_t path_hash(const char* path)
+{
+	uint32_t h = 5381;
+	for (; *path; path++)
+		h = ((h << 5) + h) + (uint8_t) *path;
+	return h % CACHE_BUCKETS;
+}
+
+static bool in_subtree(const char* path, const char* root, size_t len)
+{
+	if (len == 1 && root[0] == '/')
+		return true;
+	return strncmp(path, root, len) == 0 && (path[len] == '\0' || path[len] == '/');
+}
+
+static void free_ent(struct cache_ent* ent)
+{
+	free(ent->path);
+	free(ent->data);
+	free(ent->list);
+	free(ent);
+}
+
+/* cache.lock held, drop everything in [root] or everything aged out */
+static void cache_drop(const char* root, uint64_t now)
+{
+	size_t len = root ? strlen(root) : 0;
+
+	for (size_t i = 0; i < CACHE_BUCKETS; i++){
+		struct cache_ent** cur = &cache.buckets[i];
+		while (*cur){
+			struct cache_ent* ent = *cur;
+			bool drop = root ? in_subtree(ent->path, root, len) :
+				(ent->attr_expire <= now && ent->data_expire <= now &&
+				ent->list_expire <= now);
+
+			if (drop){
+				*cur = ent->next;
+				free_ent(ent);
+				cache.count--;
+			}
+			else
+				cur = &ent->next;
+		}
+	}
+}
+
+/* cache.lock held */
+static struct cache_ent* find_ent(const char* path, bool create)
+{
+	size_t ind = path_hash(path);
+	for (struct cache_ent* cur = cache.buckets[ind]; cur; cur = cur->next)
+		if (strcmp(cur->path, path) == 0)
+			return cur;
+
+	if (!create)
+		return NULL;
+
+/* first try to get rid of what has aged out, then just start over */
+	if (cache.count >= CACHE_LIMIT){
+		cache_drop(NULL, now_ms());
+		if (cache.count >= CACHE_LIMIT)
+			cache_drop("/", 0);
+	}
+
+	struct cache_ent* ent = malloc(sizeof(struct cache_ent));
+	if (!ent)
+		return NULL;
+
+	*ent = (struct cache_ent){.path = strdup(path)};
+	if (!ent->path){
+		free(ent);
+		return NULL;
+	}
+
+	ent->next = cache.buckets[ind];
+	cache.buckets[ind] = ent;
+	cache.count++;
+	return ent;
+}
+
+static void cache_invalidate(const char* path, bool kernel)
+{
+	pthread_mutex_lock(&cache.lock);
+	cache_drop(path, 0);
+
+/* the parent listing changes if the node was added or removed */
+	const char* split = strrchr(path, '/');
+	if (split && split[1]){
+		size_t len = split == path ? 1 : split - path;
+		char parent[len + 1];
+		memcpy(parent, path, len);
+		parent[len] = '\0';
+		struct cache_ent* ent = find_ent(parent, false);
+		if (ent){
+			free(ent->list);
+			ent->list = NULL;
+			ent->list_expire = 0;
+		}
+	}
+
+	if (kernel){
+		char* copy;
+		if (cache.n_inval < INVAL_QUEUE && (copy = strdup(path)))
+			cache.inval[cache.n_inval++] = copy;
+		else
+			cache.inval_all = true;
+		pthread_cond_signal(&cache.notify);
+	}
+
+	pthread_mutex_unlock(&cache.lock);
+}
+
+/* returns 1 on miss, otherwise the cached status of the read */
+static int cache_get_attr(const char* path, struct stat* stbuf)
+{
+	if (!caching())
+		return 1;
+
+	int rv = 1;
+	pthread_mutex_lock(&cache.lock);
+	struct cache_ent* ent = find_ent(path, false);
+	if (ent && ent->attr_expire > now_ms()){
+		rv = ent->attr_status;
+		*stbuf = ent->attr;
+	}
+	pthread_mutex_unlock(&cache.lock);
+	return rv;
+}
+
+static void cache_set_attr(const char* path, int status, struct stat* stbuf)
+{
+	if (!caching())
+		return;
+
+	pthread_mutex_lock(&cache.lock);
+	struct cache_ent* ent = find_ent(path, true);
+	if (ent){
+		ent->attr_status = status;
+		ent->attr = *stbuf;
+		ent->attr_expire = expire_at();
+	}
+	pthread_mutex_unlock(&cache.lock);
+}
+
+/*
+ * [keep] is set if these are the contents the kernel got the last time the
+ * path was opened, i.e. its page cache can be kept
+ */
+static bool cache_get_data(
+	const char* path, struct file_ent_info* fent, bool* keep)
+{
+	if (!caching())
+		return false;
+
+	bool rv = false;
+	pthread_mutex_lock(&cache.lock);
+	struct cache_ent* ent = find_ent(path, false);
+	if (ent && ent->data && ent->data_expire > now_ms()){
+		memcpy(fent->buffer, ent->data, ent->data_sz);
+		fent->used = ent->data_sz;
+		fent->value = ent->value;
+		*keep = ent->kernel_seen;
+		ent->kernel_seen = true;
+		rv = true;
+	}
+	pthread_mutex_unlock(&cache.lock);
+	return rv;
+}
+
+static void cache_set_data(
+	const char* path, struct file_ent_info* fent, bool seen)
+{
+	if (!caching())
+		return;
+
+	pthread_mutex_lock(&cache.lock);
+	struct cache_ent* ent = find_ent(path, true);
+	char* data = ent ? malloc(fent->used + 1) : NULL;
+	if (data){
+		memcpy(data, fent->buffer, fent->used);
+		free(ent->data);
+		ent->data = data;
+		ent->data_sz = fent->used;
+		ent->value = fent->value;
+		ent->kernel_seen = seen;
+		ent->data_expire = expire_at();
+	}
+	pthread_mutex_unlock(&cache.lock);
+}
+
+static bool cache_get_list(const char* path, struct list_buf* dst)
+{
+	if (!caching())
+		return false;
+
+	bool rv = false;
+	pthread_mutex_lock(&cache.lock);
+	struct cache_ent* ent = find_ent(path, false);
+	if (ent && ent->list && ent->list_expire > now_ms() &&
+		(dst->buf = malloc(ent->list_sz + 1))){
+		memcpy(dst->buf, ent->list, ent->list_sz);
+		dst->used = dst->cap = ent->list_sz;
+		rv = true;
+	}
+	pthread_mutex_unlock(&cache.lock);
+	return rv;
+}
+
+/*
+ * Turn one line of ls output into name + attributes, trailing / means
+ * directory and everything else is a value or an action, both of which
+ * get the same attributes as the read path would give them.
+ */
+static bool dirent_stat(const char* line, size_t len,
+	char* name, size_t name_sz, struct stat* fs)
+{
+	if (len && line[len-1] == '\n')
+		len--;
+
+	if (!len || len >= name_sz)
+		return false;
+
+	*fs = (struct stat){};
+	if (line[len-1] == '/'){
+		fs->st_mode = S_IFDIR | 0700;
+		fs->st_nlink = 3;
+		fs->st_size = 4096;
+		if (!--len)
+			return false;
+	}
+	else {
+		fs->st_mode = S_IFREG | 0600;
+		fs->st_nlink = 1;
+		fs->st_size = 512;
+	}
+
+	memcpy(name, line, len);
+	name[len] = '\0';
+	return true;
+}
+
+/* store the listing and prime the attributes of every child with it */
+static void cache_set_list(const char* path, struct list_buf* src)
+{
+	if (!caching())
+		return;
+
+	pthread_mutex_lock(&cache.lock);
+	uint64_t expire = expire_at();
+	size_t path_len = strlen(path);
+	if (path_len == 1)
+		path_len = 0;
+
+	const char* cur = src->buf;
+	const char* end = src->buf + src->used;
+	while (cur && cur < end){
+		const char* nl = memchr(cur, '\n', end - cur);
+		size_t len = nl ? nl - cur : end - cur;
+		char child[PATH_MAX];
+		struct stat fs;
+
+		if (path_len + 1 < sizeof(child) && dirent_stat(cur, len,
+			&child[path_len + 1], sizeof(child) - path_len - 1, &fs)){
+			memcpy(child, path, path_len);
+			child[path_len] = '/';
+			struct cache_ent* ent = find_ent(child, true);
+			if (ent){
+				ent->attr_status = 0;
+				ent->attr = fs;
+				ent->attr_expire = expire;
+			}
+		}
+		cur = cur + len + 1;
+	}
+
+	struct cache_ent* ent = find_ent(path, true);
+	char* list = ent ? malloc(src->used + 1) : NULL;
+	if (list){
+		memcpy(list, src->buf, src->used);
+		free(ent->list);
+		ent->list = list;
+		ent->list_sz = src->used;
+		ent->list_expire = expire;
+	}
+	pthread_mutex_unlock(&cache.lock);
+}
+
+/*
+ * 'invalidate' or 'invalidate /some/path', return true if it was consumed
+ */
+static bool check_invalidate(const char* line)
+{
+	if (strncmp(line, "invalidate", 10) != 0 ||
+		(line[10] != '\0' && line[10] != ' '))
+		return false;
+
+	char path[PATH_MAX] = "/";
+	if (line[10] == ' ' && line[11] == '/'){
+		snprintf(path, sizeof(path), "%s", &line[11]);
+		size_t len = strlen(path);
+		while (len > 1 && path[len-1] == '/')
+			path[--len] = '\0';
+	}
+
+	cache_invalidate(path, true);
+	return true;
+}
+
+/* close the connection, anything cached came from the appl on the other end */
+static void drop_connection()
+{
+	close(options.con);
+	options.con = -1;
+	cache_invalidate("/", true);
+}
+
+/*
+ * [n] is so low that doing real buffering etc. isn't really meaningful,
+ * in_command is held
+ */
+static int read_line(char* buf, size_t buf_sz)
+{
+	size_t ofs = 0;
+	for(;;){
+		ssize_t nr = read(options.con, &buf[ofs], 1);
+		if (-1 == nr){
+			if (errno != EAGAIN && errno != EINTR){
+				int rv = -errno;
+				drop_connection();
+				return rv;
+			}
+			continue;
+		}
+		else if (0 == nr){
+			debug_print("control connection closed");
+			drop_connection();
+			return -EPIPE;
+		}
+
+		if (buf[ofs] == '\n'){
+			buf[ofs] = '\0';
+			return 0;
+		}
+
+		ofs++;
+		if (ofs == buf_sz)
+			return -EINVAL;
+	}
+}
+
+/*
+ * consume lines that have been pushed outside of a command, in_command held
+ */
+static void drain_pending()
+{
+	char buf[4096];
+
+	while (-1 != options.con){
+		struct pollfd pfd = {.fd = options.con, .events = POLLIN};
+		if (poll(&pfd, 1, 0) <= 0)
+			return;
+
+		if (!(pfd.revents & POLLIN)){
+			drop_connection();
+			return;
+		}
+
+		if (0 != read_line(buf, sizeof(buf)))
+			return;
+
+		if (!check_invalidate(buf))
+			debug_print("unexpected line outside of command: %s", buf);
+	}
+}
+
+static void sync_invalidations()
+{
+	if (!caching() || 0 != pthread_mutex_trylock(&in_command))
+		return;
+
+	drain_pending();
+	pthread_mutex_unlock(&in_command);
+}
+
 /*
  * This is quite slow as it has to align to the synch periods of the displays
- * in order for the menu to give accurate results about the various states,so
- * some kind of caching mechanism similar to what would be performed for high
- * latency filesystems (ftp, ...) should be used here as well.
+ * in order for the menu to give accurate results about the various states,
+ * so callers go through the cache first and only end up here on a miss.
  */
 static int wait_for_command(const char* cmd,
 	const char* path, const char* arg, void(*linecb)(char*, void*), void* tag)
 {
 	char buf[4096];
+	size_t ntw =
+		snprintf(buf, sizeof(buf), "%s %s%s%s\n",
+			cmd, path ? path : "",
+			arg ? "=" : "",
+			arg ? arg : ""
+		);
+	if (ntw > sizeof(buf)){
+		debug_print("command %s:%s overflow protection",
+			path ? path : "(nopath)", arg ? arg : "(noarg)");
+		return -EINVAL;
+	}
+
+	pthread_mutex_lock(&in_command);
 	if (-1 == options.con){
 		struct sockaddr_un addr = {
 			.sun_family = AF_UNIX
@@ -103,34 +590,22 @@ static int wait_for_command(const char* cmd,
 			debug_print("can't connect to socket (%s)", options.control);
 			close(options.con);
 			options.con = -1;
+			pthread_mutex_unlock(&in_command);
 			return -EEXIST;
 		}
 	}
 
-	size_t ntw =
-		snprintf(buf, sizeof(buf), "%s %s%s%s\n",
-			cmd, path ? path : "",
-			arg ? "=" : "",
-			arg ? arg : ""
-		);
-	if (ntw > sizeof(buf)){
-		debug_print("command %s:%s overflow protection",
-			path ? path : "(nopath)", arg ? arg : "(noarg)");
-		return -EINVAL;
-	}
-
 /* buffered write */
 	size_t ofs = 0;
-	pthread_mutex_lock(&in_command);
 	while(ntw){
 		ssize_t nw = write(options.con, &buf[ofs], ntw);
 		if (-1 == nw){
 			if (errno != EAGAIN && errno != EINTR){
+				int rv = -errno;
 				debug_print("write to parent failed, connection broken");
-				close(options.con);
-				options.con = -1;
+				drop_connection();
 				pthread_mutex_unlock(&in_command);
-				return -errno;
+				return rv;
 			}
 			continue;
 		}
@@ -138,50 +613,108 @@ static int wait_for_command(const char* cmd,
 		ntw -= nw;
 	}
 
-/* [n] is so low that doing real buffering etc. isn't really meaningful */
-	ofs = 0;
+	int rv;
 	for(;;){
-		if (-1 == read(options.con, &buf[ofs], 1)){
-			if (errno != EAGAIN && errno != EINTR){
-				close(options.con);
-				options.con = -1;
-				pthread_mutex_unlock(&in_command);
-				return -errno;
-			}
-			continue;
+		if (0 != (rv = read_line(buf, sizeof(buf))))
+			break;
+
+		if (strcmp(buf, "OK") == 0){
+			rv = 0;
+			break;
+		}
+		else if (strncmp(buf, "EINVAL", 6) == 0){
+			rv = -ENOENT;
+			break;
 		}
 
-		if (buf[ofs] == '\n'){
-			buf[ofs] = '\0';
-			ofs = 0;
-			if (strcmp(buf, "OK") == 0){
-				pthread_mutex_unlock(&in_command);
-				return 0;
-			}
-			else if (strncmp(buf, "EINVAL", 6) == 0){
-				pthread_mutex_unlock(&in_command);
-				return -ENOENT;
-			}
-			linecb(buf, tag);
+/* pushed invalidations can be interleaved with the reply */
+		if (check_invalidate(buf))
 			continue;
+
+		if (linecb)
+			linecb(buf, tag);
+	}
+
+	pthread_mutex_unlock(&in_command);
+	return rv;
+}
+
+/*
+ * Forward invalidations to the kernel side (entry/attr caches), and pick up
+ * whatever the appl has pushed while there has been no command activity.
+ */
+static void* notify_thread(void* tag)
+{
+	struct fuse* fuse = tag;
+	(void) fuse;
+
+	pthread_mutex_lock(&cache.lock);
+	for(;;){
+		if (!cache.n_inval && !cache.inval_all){
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += 250 * 1000000;
+			if (ts.tv_nsec >= 1000000000){
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&cache.notify, &cache.lock, &ts);
 		}
 
-		ofs++;
-		if (ofs == sizeof(buf)){
-			pthread_mutex_unlock(&in_command);
-			return -EINVAL;
+		char* paths[INVAL_QUEUE];
+		size_t n_paths = cache.n_inval;
+		bool all = cache.inval_all;
+		memcpy(paths, cache.inval, sizeof(char*) * n_paths);
+		cache.n_inval = 0;
+		cache.inval_all = false;
+		pthread_mutex_unlock(&cache.lock);
+		(void) all;
+
+/* the kernel has no 'drop everything', the root and the queued paths is the
+ * best that can be done, the rest ages out with the entry timeout */
+#if FUSE_VERSION >= FUSE_MAKE_VERSION(3, 2)
+		if (all)
+			fuse_invalidate_path(fuse, "/");
+#endif
+		for (size_t i = 0; i < n_paths; i++){
+#if FUSE_VERSION >= FUSE_MAKE_VERSION(3, 2)
+			if (!all)
+				fuse_invalidate_path(fuse, paths[i]);
+#endif
+			free(paths[i]);
 		}
+
+		sync_invalidations();
+		pthread_mutex_lock(&cache.lock);
 	}
 
-	pthread_mutex_unlock(&in_command);
-	return 0;
+	return NULL;
 }
 
 static void *acfgfs_init(
 	struct fuse_conn_info *conn, struct fuse_config *cfg)
 {
-	(void) conn;
-	cfg->kernel_cache = 1;
+/* the page cache is kept per open (see acfgfs_open) rather than always */
+	cfg->kernel_cache = 0;
+	cfg->entry_timeout = options.ttl;
+	cfg->attr_timeout = options.ttl;
+	cfg->negative_timeout = options.ttl;
+
+/* readdir then hands out the attributes along with the names and saves the
+ * lookup roundtrip for each entry */
+	if (conn->capable & FUSE_CAP_READDIRPLUS)
+		conn->want |= FUSE_CAP_READDIRPLUS;
+
+	if (caching()){
+		pthread_t pth;
+		pthread_attr_t pthattr;
+		pthread_attr_init(&pthattr);
+		pthread_attr_setdetachstate(&pthattr, PTHREAD_CREATE_DETACHED);
+		if (0 != pthread_create(&pth, &pthattr, notify_thread, fuse_get_context()->fuse))
+			debug_print("couldn't spawn notification thread, only ttl will apply");
+		pthread_attr_destroy(&pthattr);
+	}
+
 	return NULL;
 }
 
@@ -205,89 +738,134 @@ static void sdircb(char* str, void* tag)
 	}
 }
 
+static void rent(char* str, void* tag)
+{
+	struct file_ent_info* dst = tag;
+	size_t ntw = strlen(str);
+	if (dst->used + 2 >= sizeof(dst->buffer))
+		return;
+
+	size_t left = sizeof(dst->buffer) - dst->used - 2;
+	ntw = ntw < left ? ntw : left;
+	if (!ntw)
+		return;
+
+/* nulled at init */
+	memcpy(&dst->buffer[dst->used], str, ntw);
+	dst->used += ntw;
+	dst->buffer[dst->used++] = '\n';
+
+	if (strcmp(str, "kind: value") == 0)
+		dst->value = true;
+}
+
+struct readcb_t {
+	struct stat* stbuf;
+	struct file_ent_info* fent;
+};
+
+/* the reply to read gives both the attributes and the contents */
+static void readcb(char* str, void* tag)
+{
+	struct readcb_t* cbt = tag;
+	sdircb(str, cbt->stbuf);
+	rent(str, cbt->fent);
+}
+
 static int acfgfs_getattr(const char *path, struct stat *stbuf,
 			 struct fuse_file_info *fi)
 {
 	(void) fi;
+	sync_invalidations();
+	int rv = cache_get_attr(path, stbuf);
+	if (rv <= 0)
+		return rv;
+
 	*stbuf = (struct stat){};
-	return wait_for_command("read", path, NULL, sdircb, stbuf);
-}
+	struct file_ent_info fent = {.cookie = 0xfeedface};
+	struct readcb_t cbt = {
+		.stbuf = stbuf,
+		.fent = &fent
+	};
 
-struct rdircb_t {
-	void* buf;
-	fuse_fill_dir_t filler;
-};
+	rv = wait_for_command("read", path, NULL, readcb, &cbt);
+	if (0 == rv){
+		cache_set_attr(path, rv, stbuf);
+		cache_set_data(path, &fent, false);
+	}
+	else if (-ENOENT == rv)
+		cache_set_attr(path, rv, stbuf);
+
+	return rv;
+}
 
 static void rdircb(char* str, void* tag)
 {
-	struct rdircb_t* cbt = tag;
+	struct list_buf* dst = tag;
 	size_t len = strlen(str);
-	struct stat fs = {
-	};
-
-	if (len <= 1)
+	if (!len)
 		return;
 
-/* strip away trailing newline */
-	if (str[len-1] == '\n'){
-		str[len-1] = '\0';
-		len--;
-	}
+	if (dst->used + len + 1 > dst->cap){
+		size_t cap = dst->cap ? dst->cap * 2 : 4096;
+		while (cap < dst->used + len + 1)
+			cap *= 2;
 
-/* classify value, directory or action */
-	if (str[len-1] == '/'){
-		fs.st_mode = S_IFDIR | 0700;
-		fs.st_nlink = 3;
-		fs.st_size = 4096;
-		str[len-1] = '\0';
-	}
-	else {
-		fs.st_mode = S_IFREG | 0600;
-		fs.st_nlink = 1;
+		char* buf = realloc(dst->buf, cap);
+		if (!buf){
+			debug_print("out of memory on directory listing");
+			return;
+		}
+		dst->buf = buf;
+		dst->cap = cap;
 	}
 
-/* and forward */
-	cbt->filler(cbt->buf, str, &fs, 0, 0);
+	memcpy(&dst->buf[dst->used], str, len);
+	dst->used += len;
+	dst->buf[dst->used++] = '\n';
 }
 
 static int acfgfs_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
 			 off_t offset, struct fuse_file_info *fi,
 			 enum fuse_readdir_flags flags)
 {
-	struct rdircb_t cbt = {
-		.buf = buf,
-		.filler = filler,
-	};
+	struct list_buf list = {0};
+
+/* all of the listing is collected before filling, with readdirplus the filler
+ * will getattr each entry, and that should come from the primed cache rather
+ * than a command nested inside of the ls reply */
+	sync_invalidations();
+	if (!cache_get_list(path, &list)){
+		int rv = wait_for_command("ls", path, NULL, rdircb, &list);
+		if (0 != rv){
+			free(list.buf);
+			return rv;
+		}
+		cache_set_list(path, &list);
+	}
+
+	enum fuse_fill_dir_flags fill =
+		caching() && (flags & FUSE_READDIR_PLUS) ? FUSE_FILL_DIR_PLUS : 0;
 
 	filler(buf, ".", NULL, 0, 0);
 	filler(buf, "..", NULL, 0, 0);
 
-	return wait_for_command("ls", path, NULL, rdircb, &cbt);
-}
-
-struct file_ent_info {
-	uint32_t cookie;
-	char buffer[4096];
-	size_t used;
-	bool value;
-};
+	const char* cur = list.buf;
+	const char* end = list.buf + list.used;
+	while (cur && cur < end){
+		const char* nl = memchr(cur, '\n', end - cur);
+		size_t len = nl ? nl - cur : end - cur;
+		char name[4096];
+		struct stat fs;
 
-static void rent(char* str, void* tag)
-{
-	struct file_ent_info* dst = tag;
-	size_t ntw = strlen(str);
-	size_t left = sizeof(dst->buffer) - dst->used - 2;
-	ntw = ntw < left ? ntw : left;
-	if (!ntw)
-		return;
+		if (dirent_stat(cur, len, name, sizeof(name), &fs))
+			filler(buf, name, &fs, 0, fill);
 
-/* nulled at init */
-	memcpy(&dst->buffer[dst->used], str, ntw);
-	dst->used += ntw;
-	dst->buffer[dst->used++] = '\n';
+		cur = cur + len + 1;
+	}
 
-	if (strcmp(str, "kind: value") == 0)
-		dst->value = true;
+	free(list.buf);
+	return 0;
 }
 
 static int acfgfs_open(const char* path, struct fuse_file_info* fi)
@@ -299,11 +877,18 @@ static int acfgfs_open(const char* path, struct fuse_file_info* fi)
 	}
 	*fent = (struct file_ent_info){.cookie = 0xfeedface};
 
-	if (0 != wait_for_command("read", path, NULL, rent, fent)){
-		free(fent);
-		return -ENOENT;
+/* only keep the page cache if the contents are the same as last time */
+	sync_invalidations();
+	bool keep = false;
+	if (!cache_get_data(path, fent, &keep)){
+		if (0 != wait_for_command("read", path, NULL, rent, fent)){
+			free(fent);
+			return -ENOENT;
+		}
+		cache_set_data(path, fent, true);
 	}
 
+	fi->keep_cache = keep;
 	fi->nonseekable = true;
 	fi->fh = (uintptr_t) fent;
 /* do want polling for some special 'wm- management protocol',
@@ -381,6 +966,7 @@ static int acfgfs_write(const char* path,
 			debug_print("value commit failed: %s", argbuf);
 			return -EINVAL;
 		}
+		cache_invalidate(path, false);
 		return size;
 	}
 
@@ -391,6 +977,7 @@ static int acfgfs_write(const char* path,
 		debug_print("exec activation of %s failed", path);
 		return -EINVAL;
 	}
+	cache_invalidate(path, false);
 
 	return 0;
 }
@@ -409,7 +996,8 @@ static void show_help(const char* progname)
 {
 	printf("usage: %s [options] <mountpoint>\n\n", progname);
 	printf("File-system specific options:\n"
-		"\t--control=<s>\t control socket path (required)");
+		"\t--control=<s>\t control socket path (required)\n"
+		"\t--ttl=<n>\t seconds to cache lookups (default 2, 0 disables)\n");
 }
 
 #define OPTION(t, p)\
@@ -417,6 +1005,7 @@ static void show_help(const char* progname)
 
 static const struct fuse_opt option_spec[] = {
 	OPTION("--control=%s", control),
+	OPTION("--ttl=%lf", ttl),
 	OPTION("-h", show_help),
 	OPTION("--help", show_help),
 	FUSE_OPT_END
@@ -434,6 +1023,9 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if (options.ttl < 0.0)
+		options.ttl = 0.0;
+
 	if (options.show_help) {
 		show_help(argv[0]);
 		assert(fuse_opt_add_arg(&args, "--help") == 0);
@@ -52,6 +52,7 @@ struct draw_state {
 /* loading/ resource management state */
 	int wnd_lim, wnd_fwd, wnd_pending, wnd_act;
 	int wnd_prev, wnd_next;
+	int workers;
 	int timeout;
 	bool stdin_pending, loaded, animated, vector;
 
@@ -72,6 +73,7 @@ struct draw_state {
 
 static struct draw_state* last_ds;
 static bool set_playlist_pos(struct draw_state* ds, int new_i);
+static void fill_window(struct draw_state* ds);
 
 void debug_message(const char* msg, ...)
 {
@@ -143,8 +145,8 @@ static void blit(struct arcan_shmif_cont* dst,
 	if (state->aspect_ratio && fabs(new_ar - ar) > AR_EPSILON){
 /* bias against the dominant axis */
 		debug_message("blit[adjust %f] %d*%d -> ", ar, dw, dh);
-		float wr = src->w / dst->w;
-		float hr = src->h / dst->h;
+		float wr = (float)src->w / (float)dst->w;
+		float hr = (float)src->h / (float)dst->h;
 		dw = hr > wr ? dst->h * ar : dst->w;
 		dh = hr < wr ? dst->w / ar : dst->h;
 		debug_message("%d*%d\n", dw, dh);
@@ -154,6 +156,13 @@ static void blit(struct arcan_shmif_cont* dst,
 	if (src->buf_sz != src->w * src->h * 4)
 		return;
 
+/* the decoder has already scaled (see set_fit), only rounding differs */
+	if (abs(dw - src->w) <= 1 && abs(dh - src->h) <= 1 &&
+		src->w <= dst->w && src->h <= dst->h){
+		dw = src->w;
+		dh = src->h;
+	}
+
 	int pad_w = dst->w - dw;
 	int pad_h = dst->h - dh;
 	int src_stride = src->w * 4;
@@ -171,6 +180,13 @@ static void blit(struct arcan_shmif_cont* dst,
 	int pad_pre_x = pad_w >> 1;
 	int pad_pre_y = pad_h >> 1;
 
+	if (dw == src->w && dh == src->h){
+		debug_message("padded-blit[%d*%d]\n", dw, dh);
+		for (int row = 0; row < dh; row++)
+			memcpy(&dst->vidp[(pad_pre_y + row) * dst->pitch + pad_pre_x],
+				&src->buf[row * src_stride], src_stride);
+	}
+	else {
 /* FIXME: stretch-blit/transform for zoom in/out or pan */
 	debug_message("blit[%d+%d*%d+%d] -> [%d,%d]:pad(%d,%d)\n",
 		(int)src->w, (int)src->x, (int)src->h, (int)src->y,
@@ -182,6 +198,7 @@ static void blit(struct arcan_shmif_cont* dst,
 		(uint8_t*) &dst->vidp[pad_pre_y * dst->pitch + pad_pre_x],
 		dw, dh, dst->stride, sizeof(shmif_pixel)
 	);
+	}
 
 /* pad beginning / end rows */
 	for (int y = 0; y < pad_pre_y; y++){
@@ -288,12 +305,17 @@ static bool update_item(struct draw_state* ds, struct img_state* i, int step)
 static bool poll_pl(struct draw_state* ds, int step)
 {
 	bool update = false;
+	int pending = ds->wnd_pending;
 	for (size_t i = 0; i < ds->pl_size && ds->wnd_pending; i++){
 		struct img_state* is = &ds->playlist[i];
 		if (is->proc)
 			update |= update_item(ds, is, step);
 	}
 
+/* decoders freed up, keep the readahead going */
+	if (ds->wnd_pending < pending)
+		fill_window(ds);
+
 /* special treatment for the currently selected index, have a retry timer
  * on failure, update ident with current load status */
 	struct img_state* cur = &ds->playlist[ds->pl_ind];
@@ -310,6 +332,23 @@ static bool poll_pl(struct draw_state* ds, int step)
 	return update;
 }
 
+/* the size the decoders should deliver in, so that blit is only a copy */
+static void set_fit(struct draw_state* ds, struct img_state* is)
+{
+	if (ds->source_size){
+		is->fit_w = PP_SHMPAGE_MAXW;
+		is->fit_h = PP_SHMPAGE_MAXH;
+		is->fit_aspect = true;
+		is->fit_shrink = true;
+	}
+	else {
+		is->fit_w = ds->con->w;
+		is->fit_h = ds->con->h;
+		is->fit_aspect = ds->aspect_ratio;
+		is->fit_shrink = false;
+	}
+}
+
 /* used to spawn a new worker process */
 static bool try_dispatch(struct draw_state* ds, int ind, int prio_d)
 {
@@ -324,7 +363,13 @@ static bool try_dispatch(struct draw_state* ds, int ind, int prio_d)
 /* NOTE: we don't care if the entry has previously been marked as broken,
  * the specified input may have appeared or permissions might have changed */
 
+/* readahead is limited to one decoder per core, the current item (prio 0)
+ * always gets one */
+	if (prio_d && ds->workers && ds->wnd_pending >= ds->workers)
+		return false;
+
 /* all done, spawn */
+	set_fit(ds, &ds->playlist[ind]);
 	if (imgload_spawn(ds->con, &ds->playlist[ind], prio_d)){
 		if (ds->playlist[ind].is_stdin)
 			ds->stdin_pending = true;
@@ -352,6 +397,46 @@ static void reset_slot(struct draw_state* ds, int ind)
 	}
 }
 
+/* fill up the readahead window with lesser priority, note that there is a
+ * slight degrade if we step from the currently loaded into one that is
+ * pending as the priority for that one, though the effect should be minimal
+ * enough to not bothering with renicing. Broken items are only retried when
+ * they are stepped to. */
+static void fill_window(struct draw_state* ds)
+{
+	int pos = (ds->pl_ind + 1) % ds->pl_size;
+
+	while (pos != ds->pl_ind &&
+		(ds->wnd_act + ds->wnd_pending < ds->wnd_lim || !ds->wnd_lim) &&
+		(ds->wnd_pending < ds->workers || !ds->workers)){
+		if (!ds->playlist[pos].broken){
+			debug_message("attempt to queue (%s)\n", ds->playlist[pos].fname);
+			try_dispatch(ds, pos, 1);
+		}
+		pos = (pos + 1) % ds->pl_size;
+	}
+}
+
+/* the window size or scaling mode changed, the items that were decoded
+ * (or are decoding) for the previous size need to be redone */
+static void refit_playlist(struct draw_state* ds)
+{
+	for (size_t i = 0; i < ds->pl_size; i++){
+		struct img_state* is = &ds->playlist[i];
+		if (!is->out || is->is_stdin || -1 != is->fd)
+			continue;
+
+		struct img_state cmp = *is;
+		set_fit(ds, &cmp);
+		if (cmp.fit_w != is->fit_w || cmp.fit_h != is->fit_h ||
+			cmp.fit_aspect != is->fit_aspect || cmp.fit_shrink != is->fit_shrink)
+			reset_slot(ds, i);
+	}
+
+	ds->blit_ind = -1;
+	set_playlist_pos(ds, ds->pl_ind);
+}
+
 static void clean_queue(struct draw_state* ds)
 {
 /* scan horizon to determine the number of entries to drop, assumptions from
@@ -402,8 +487,6 @@ static void clean_queue(struct draw_state* ds)
 
 static bool set_playlist_pos(struct draw_state* ds, int new_i)
 {
-	size_t pos;
-
 /* range-check, if we don't loop, return to start */
 	if (new_i < 0)
 		new_i = ds->pl_size-1;
@@ -442,18 +525,8 @@ static bool set_playlist_pos(struct draw_state* ds, int new_i)
 		clean_queue(ds);
 	}
 
-/* and then fill up with lesser priority, note that there is a slight degrade
- * if we step from the currently loaded into one that is pending as the
- * priority for that one, though the effect should be minimal enough to not
- * bothering with renicing */
-	pos = (new_i + 1) % ds->pl_size;
-
-	while (pos != new_i &&
-		(ds->wnd_act + ds->wnd_pending < ds->wnd_lim || !ds->wnd_lim)){
-		debug_message("attempt to queue (%s)\n", ds->playlist[pos].fname);
-		try_dispatch(ds, pos, 1);
-		pos = (pos + 1) % ds->pl_size;
-	}
+/* and then fill up with lesser priority */
+	fill_window(ds);
 
 	debug_message("position set to (%d, act: %d/%d, pending: %d)\n",
 		ds->pl_ind, ds->wnd_act, ds->wnd_lim, ds->wnd_pending);
@@ -496,7 +569,7 @@ static bool source_size(struct draw_state* state)
 {
 	if (!state->source_size){
 		state->source_size = true;
-		state->blit_ind = -1;
+		refit_playlist(state);
 	}
 	return false;
 }
@@ -505,8 +578,9 @@ static bool server_size(struct draw_state* state)
 {
 	if (state->source_size){
 		state->source_size = false;
-		state->blit_ind = -1;
-		return arcan_shmif_resize(state->con, state->out_w, state->out_h);
+		bool rv = arcan_shmif_resize(state->con, state->out_w, state->out_h);
+		refit_playlist(state);
+		return rv;
 	}
 	else
 		return false;
@@ -521,6 +595,7 @@ static bool pl_toggle(struct draw_state* state)
 static bool aspect_ratio(struct draw_state* state)
 {
 	state->aspect_ratio = !state->aspect_ratio;
+	refit_playlist(state);
 	return true;
 }
 
@@ -607,6 +682,7 @@ static bool dispatch_event(
 					con, ev->tgt.ioevs[0].iv, ev->tgt.ioevs[1].iv)){
 						debug_message("server requested [%d*%d] vs. current [%d*%d]\n",
 							ev->tgt.ioevs[0].iv, ev->tgt.ioevs[1].iv, con->w, con->h);
+						refit_playlist(ds);
 						return true;
 				}
 			}
@@ -649,6 +725,7 @@ static int show_use(const char* msg)
 "Tuning:\n"
 "-m num \t--limit-mem   \tSet loader process memory limit to [num] MB\n"
 "-r num \t--readahead   \tSet the playlist window queue size\n"
+"-j num \t--decoders    \tSet the number of parallel decoders (0: no limit)\n"
 "-T sec \t--timeout     \tSet unresponsive worker kill- timeout\n"
 "-H     \t--vr          \tSet stereoscopic mode, prefix files with l: or r:\n"
 #ifdef ENABLE_SECCOMP
@@ -685,6 +762,7 @@ static const struct option longopts[] = {
 	{"timeout", required_argument, NULL, 'T'},
 	{"limit-mem", required_argument, NULL, 'm'},
 	{"readahead", required_argument, NULL, 'r'},
+	{"decoders", required_argument, NULL, 'j'},
 	{"padcol", required_argument, NULL, 'p'},
 	{"no-sysflt", no_argument, NULL, 'X'},
 	{"server-size", no_argument, NULL, 'S'},
@@ -731,7 +809,8 @@ int main(int argc, char** argv)
 		.init_timer = 0,
 		.pad_col = SHMIF_RGBA(32, 32, 32, 255),
 		.playlist = playlist,
-		.blit_ind = -1
+		.blit_ind = -1,
+		.workers = sysconf(_SC_NPROCESSORS_ONLN)
 	};
 	last_ds = &ds;
 
@@ -739,7 +818,7 @@ int main(int argc, char** argv)
 	int segid = SEGID_MEDIA;
 
 	while((ch = getopt_long(argc, argv,
-		"p:ihlt:bd:T:m:r:XSHd:a", longopts, NULL)) >= 0)
+		"p:ihlt:bd:T:m:r:j:XSHd:a", longopts, NULL)) >= 0)
 		switch(ch){
 		case 'h' : return show_use(""); break;
 		case 't' : ds.init_timer = strtoul(optarg, NULL, 10) * 5; break;
@@ -758,6 +837,7 @@ int main(int argc, char** argv)
 		case 'a' : ds.aspect_ratio = true; break;
 		case 'm' : image_size_limit_mb = strtoul(optarg, NULL, 10); break;
 		case 'r' : ds.wnd_lim = strtoul(optarg, NULL, 10); break;
+		case 'j' : ds.workers = strtoul(optarg, NULL, 10); break;
 		case 'X' : disable_syscall_flt = true; break;
 		case 'N' : ds.handover_exec = true; break;
 		case 'H' :
@@ -773,6 +853,8 @@ int main(int argc, char** argv)
 		break;
 		}
 	ds.step_timer = ds.init_timer;
+	if (ds.workers < 0)
+		ds.workers = 0;
 
 /* there are more considerations here -
  *
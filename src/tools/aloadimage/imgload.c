@@ -37,8 +37,38 @@
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "stb_image_resize.h"
 #include "imgload.h"
 
+/* resolve the output dimensions for a [w * h] source given the fit- box
+ * in [tgt], false if the source should be used as is */
+static bool fit_size(struct img_state* tgt, size_t w, size_t h, size_t* ow, size_t* oh)
+{
+	*ow = w;
+	*oh = h;
+	if (tgt->fit_w <= 0 || tgt->fit_h <= 0 || !w || !h)
+		return false;
+
+	if (tgt->fit_shrink && w <= tgt->fit_w && h <= tgt->fit_h)
+		return false;
+
+	if (tgt->fit_aspect){
+		float sx = (float) tgt->fit_w / (float) w;
+		float sy = (float) tgt->fit_h / (float) h;
+		float sf = sx < sy ? sx : sy;
+		*ow = w * sf;
+		*oh = h * sf;
+		*ow = *ow ? *ow : 1;
+		*oh = *oh ? *oh : 1;
+	}
+	else {
+		*ow = tgt->fit_w;
+		*oh = tgt->fit_h;
+	}
+
+	return *ow != w || *oh != h;
+}
+
 bool imgload_spawn(struct arcan_shmif_cont* con, struct img_state* tgt, int p)
 {
 /* pre-alloc the upper limit for the return- image, we'll munmap when
@@ -196,11 +226,26 @@ bool imgload_spawn(struct arcan_shmif_cont* con, struct img_state* tgt, int p)
 		fseek(inf, 0, SEEK_SET);
 		NSVGimage* image = nsvgParseFromFile(inf, "px", tgt->density);
 		if (image){
-			size_t w = image->width;
-			size_t h = image->height;
+/* rasterize at the size it will be presented at rather than scaling the
+ * rasterized source, nanosvg only takes a uniform scale factor */
+			size_t w, h;
+			float sf = 1.0;
+			if (fit_size(tgt, image->width, image->height, &w, &h)){
+				float sx = (float) w / image->width;
+				float sy = (float) h / image->height;
+				sf = sx < sy ? sx : sy;
+				w = image->width * sf;
+				h = image->height * sf;
+			}
+
+			if (w * h * sizeof(shmif_pixel) > tgt->buf_lim - sizeof(struct img_data)){
+				snprintf((char*)tgt->out->msg, sizeof(tgt->out->msg), "svg too large");
+				exit(EXIT_FAILURE);
+			}
+
 			struct NSVGrasterizer* rast = nsvgCreateRasterizer();
 			nsvgRasterize(rast, image,
-				0, 0, 1, (unsigned char*)tgt->out->buf, w, h, w * sizeof(shmif_pixel));
+				0, 0, sf, (unsigned char*)tgt->out->buf, w, h, w * sizeof(shmif_pixel));
 			tgt->out->w = w;
 			tgt->out->h = h;
 			tgt->out->buf_sz = w * h * 4;
@@ -214,14 +259,31 @@ bool imgload_spawn(struct arcan_shmif_cont* con, struct img_state* tgt, int p)
 /* else just assume stbi- can handle it */
 	fseek(inf, 0, SEEK_SET);
 
-	int dw, dh;
+	int sw = 0, sh = 0;
 	shmif_pixel* buf = (shmif_pixel*)
-		stbi_load_from_file(inf, &dw, &dh, NULL, sizeof(shmif_pixel));
+		stbi_load_from_file(inf, &sw, &sh, NULL, sizeof(shmif_pixel));
 	shmif_pixel* out = (shmif_pixel*) tgt->out->buf;
+	tgt->out->msg[0] = '\0';
+
+/* scale to the presentation size here rather than in the blit so that
+ * a large source costs the sandbox and not the UI, and so that the output
+ * buffer only needs to be large enough for what will be shown */
+	size_t dw = 0, dh = 0;
+	bool scale = buf ? fit_size(tgt, sw, sh, &dw, &dh) : false;
 	tgt->out->w = dw;
 	tgt->out->h = dh;
 	tgt->out->buf_sz = dw * dh * 4;
-	tgt->out->msg[0] = '\0';
+
+	if (buf && tgt->out->buf_sz > tgt->buf_lim - sizeof(struct img_data)){
+		snprintf((char*)tgt->out->msg, sizeof(tgt->out->msg), "image too large");
+		exit(EXIT_FAILURE);
+	}
+
+	if (buf && scale){
+		stbir_resize_uint8((uint8_t*) buf, sw, sh, sw * 4,
+			(uint8_t*) out, dw, dh, dw * 4, sizeof(shmif_pixel));
+		buf = out;
+	}
 
 	if (buf){
 		for (size_t i = dw * dh; i > 0; i--){
@@ -30,6 +30,12 @@ struct img_state {
 	float density;
 	bool stereo_right;
 
+/* if set, the decoder scales to fit [fit_w * fit_h] so that the result
+ * can be blit as is. [fit_aspect] preserves the aspect ratio, [fit_shrink]
+ * only ever scales down. Vector sources are rasterized at that size */
+	int fit_w, fit_h;
+	bool fit_aspect, fit_shrink;
+
 /* SETUP_GET */
 	bool broken;
 	size_t buf_lim;
@@ -9,8 +9,13 @@
 #include <unistd.h>
 #include <setjmp.h>
 #include <signal.h>
+#include <dirent.h>
+#include <time.h>
 
 static const struct option longopts[] = {
+	{"top", no_argument, NULL, 't'},
+	{"interval", required_argument, NULL, 'i'},
+	{"count", required_argument, NULL, 'n'},
 	{NULL, no_argument, NULL, '\0'}
 };
 
@@ -140,7 +145,12 @@ static void dump_snapshot(struct arcan_shmif_page* page, int qlim)
 		printf("auth-token ");
 
 	printf("\nqueue(in):\n");
-	uint8_t cur = page->childevq.front;
+	uint16_t cur = page->childevq.front;
+	uint16_t insz = page->childevq.size ? page->childevq.size : PP_QUEUE_SZ;
+	uint16_t outsz = page->parentevq.size ? page->parentevq.size : PP_QUEUE_SZ;
+	insz = insz > PP_QUEUE_MAX ? PP_QUEUE_MAX : insz;
+	outsz = outsz > PP_QUEUE_MAX ? PP_QUEUE_MAX : outsz;
+	cur = cur >= insz ? 0 : cur;
 	for (size_t i = 0; i < qlim; i++){
 		char* state = " ";
 		if (cur == page->childevq.front && cur == page->childevq.back)
@@ -156,12 +166,12 @@ static void dump_snapshot(struct arcan_shmif_page* page, int qlim)
 		printf("%s\t[%d] ", state, (int) cur);
 		dump_event(page->childevq.evqueue[cur]);
 		if (cur == 0)
-			cur = PP_QUEUE_SZ - 1;
+			cur = insz - 1;
 		else
 			cur--;
 	}
 
-	cur = page->parentevq.front;
+	cur = page->parentevq.front >= outsz ? 0 : page->parentevq.front;
 	printf("queue(out):\n");
 	for (size_t i = 0; i < qlim; i++){
 		char* state = " ";
@@ -178,29 +188,50 @@ static void dump_snapshot(struct arcan_shmif_page* page, int qlim)
 		printf("%s\t[%d] ", state, (int) cur);
 		dump_event(page->parentevq.evqueue[cur]);
 		if (cur == 0)
-			cur = PP_QUEUE_SZ - 1;
+			cur = outsz - 1;
 		else
 			cur--;
 	}
 
+	printf("\nperformance:\n"
+		"\tframes: %"PRIu32", dropped: %"PRIu32", audio: %"PRIu32"\n"
+		"\trender: %"PRIu64"us (last: %"PRIu32"us)\n"
+		"\twait: %"PRIu64"us (last: %"PRIu32"us)\n"
+		"\tqueue high-water (in, out): %"PRIu16", %"PRIu16" full: %"PRIu32"\n"
+		"\tresizes: %"PRIu32", waiting: %"PRIu64"us\n"
+		"\tevent waits: %"PRIu32", blocked: %"PRIu64"us\n",
+		(uint32_t) page->perf.frames, (uint32_t) page->perf.dropped,
+		(uint32_t) page->perf.audio,
+		(uint64_t) page->perf.render_us, (uint32_t) page->perf.last_render_us,
+		(uint64_t) page->perf.wait_us, (uint32_t) page->perf.last_wait_us,
+		(uint16_t) page->perf.inq_hwm, (uint16_t) page->perf.outq_hwm,
+		(uint32_t) page->perf.outq_full,
+		(uint32_t) page->perf.resizes, (uint64_t) page->perf.resize_us,
+		(uint32_t) page->perf.evwaits, (uint64_t) page->perf.evwait_us
+	);
+
 	printf("\nlast words: %s\n", page->last_words);
 	printf("aux- protocols (size: %zu):\n\t", (size_t) page->apad);
 	if (page->apad_type & SHMIF_META_CM)
 		printf("color-mgmt ");
-	if (page->apad_type & SHMIF_META_HDRF16)
-		printf("hdr16 ");
+	if (page->apad_type & SHMIF_META_HDR)
+		printf("hdr ");
 	if (page->apad_type & SHMIF_META_VOBJ)
 		printf("vobj ");
 	if (page->apad_type & SHMIF_META_VR)
 		printf("vr ");
-	if (page->apad_type & SHMIF_META_LDEF)
-		printf("ldef ");
+	if (page->apad_type & SHMIF_META_VENC)
+		printf("venc ");
 	printf("\n");
 }
 
 static void show_use()
 {
-	printf("Usage: shmmon /dev/shm/arcan_XXX_XXXm or /proc/pid/fds/XX\n");
+	printf("Usage: shmmon /dev/shm/arcan_XXX_XXXm or /proc/pid/fds/XX\n"
+		"       shmmon -t [-i ms] [-n count] [path1 .. pathn]\n\n"
+		"-t\t--top     \tlive view of the segments at path or all that can be found\n"
+		"-i ms\t--interval\tsample interval in top mode (default: 1000)\n"
+		"-n num\t--count   \tstop after num samples in top mode\n");
 }
 
 static sigjmp_buf recover;
@@ -209,14 +240,349 @@ static void bus_handler(int signo)
 	siglongjmp(recover, 1);
 }
 
+/*
+ * Top mode: map the header of every page read-only and derive rates from
+ * the perf block between samples. Pages come either from the command-line
+ * or from scanning /proc/pid/fd for descriptors that look like arcan pages
+ * (memfd or named shm), the same page is held by both the server and the
+ * client so they are deduplicated by inode.
+ */
+struct segment {
+	dev_t dev;
+	ino_t ino;
+	int fd;
+	struct arcan_shmif_page* page;
+	pid_t pid;
+	char name[20];
+	bool seen, dead;
+
+	struct {
+		uint64_t ts;
+		uint32_t frames, dropped, resizes;
+		uint64_t render_us, wait_us, resize_us;
+	} last;
+
+	float fps, drops, resize_rate, wait_pct, render_ms, dirty_pct;
+	size_t inq, outq;
+};
+
+static struct {
+	struct segment* segs;
+	size_t n, cap;
+} top;
+
+static uint64_t time_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void segment_name(struct segment* seg)
+{
+	char path[32];
+	snprintf(path, sizeof(path), "/proc/%d/comm", (int) seg->pid);
+	snprintf(seg->name, sizeof(seg->name), "%d", (int) seg->pid);
+
+	FILE* fpek = fopen(path, "r");
+	if (!fpek)
+		return;
+
+	if (fgets(seg->name, sizeof(seg->name), fpek))
+		seg->name[strcspn(seg->name, "\n")] = '\0';
+	fclose(fpek);
+}
+
+static void drop_segment(struct segment* seg)
+{
+	if (seg->page)
+		munmap(seg->page, sizeof(struct arcan_shmif_page));
+	if (-1 != seg->fd)
+		close(seg->fd);
+	seg->page = NULL;
+	seg->fd = -1;
+	seg->dead = true;
+}
+
+static void track_segment(const char* path, pid_t pid)
+{
+	struct stat st;
+	if (-1 == stat(path, &st))
+		return;
+
+/* known page, the owner is the one that isn't the server */
+	for (size_t i = 0; i < top.n; i++){
+		struct segment* seg = &top.segs[i];
+		if (seg->dead || seg->dev != st.st_dev || seg->ino != st.st_ino)
+			continue;
+
+		seg->seen = true;
+		if (seg->pid == seg->page->parent && pid != seg->page->parent){
+			seg->pid = pid;
+			segment_name(seg);
+		}
+		return;
+	}
+
+	if (st.st_size < sizeof(struct arcan_shmif_page))
+		return;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (-1 == fd)
+		return;
+
+	struct arcan_shmif_page* page = mmap(NULL,
+		sizeof(struct arcan_shmif_page), PROT_READ, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == page){
+		close(fd);
+		return;
+	}
+
+/* anything else that happens to use the same naming scheme */
+	if (page->cookie != arcan_shmif_cookie() || page->major != ASHMIF_VERSION_MAJOR){
+		munmap(page, sizeof(struct arcan_shmif_page));
+		close(fd);
+		return;
+	}
+
+	if (top.n == top.cap){
+		size_t ncap = top.cap ? top.cap * 2 : 16;
+		struct segment* segs = realloc(top.segs, ncap * sizeof(struct segment));
+		if (!segs){
+			munmap(page, sizeof(struct arcan_shmif_page));
+			close(fd);
+			return;
+		}
+		top.segs = segs;
+		top.cap = ncap;
+	}
+
+	struct segment* seg = &top.segs[top.n++];
+	*seg = (struct segment){
+		.dev = st.st_dev,
+		.ino = st.st_ino,
+		.fd = fd,
+		.page = page,
+		.pid = pid,
+		.seen = true
+	};
+	segment_name(seg);
+}
+
+static void scan_proc()
+{
+	DIR* proc = opendir("/proc");
+	if (!proc)
+		return;
+
+	struct dirent* ent;
+	while ((ent = readdir(proc))){
+		char* end;
+		long pid = strtol(ent->d_name, &end, 10);
+		if (*end || pid <= 0)
+			continue;
+
+		char path[64];
+		snprintf(path, sizeof(path), "/proc/%ld/fd", pid);
+		DIR* fds = opendir(path);
+		if (!fds)
+			continue;
+
+		struct dirent* fent;
+		while ((fent = readdir(fds))){
+			char fdpath[320], link[256];
+			if (fent->d_name[0] == '.')
+				continue;
+
+			snprintf(fdpath, sizeof(fdpath), "/proc/%ld/fd/%s", pid, fent->d_name);
+			ssize_t nr = readlink(fdpath, link, sizeof(link) - 1);
+			if (nr <= 0)
+				continue;
+			link[nr] = '\0';
+
+			if (strncmp(link, "/memfd:arcan_", 13) == 0 ||
+				strncmp(link, "/dev/shm/arcan_", 15) == 0)
+				track_segment(fdpath, (pid_t) pid);
+		}
+		closedir(fds);
+	}
+	closedir(proc);
+}
+
+static size_t queue_depth(size_t front, size_t back, size_t sz)
+{
+	sz = sz ? sz : PP_QUEUE_SZ;
+	sz = sz > PP_QUEUE_MAX ? PP_QUEUE_MAX : sz;
+	if (front >= sz || back >= sz)
+		return 0;
+	return (back + sz - front) % sz;
+}
+
+static void sample_segment(struct segment* seg, uint64_t now)
+{
+	struct arcan_shmif_page* page = seg->page;
+	struct arcan_shmif_perf* perf = &page->perf;
+
+	if (!page->dms){
+		drop_segment(seg);
+		return;
+	}
+
+#define LOAD(X) atomic_load_explicit(&perf->X, memory_order_relaxed)
+	uint32_t frames = LOAD(frames);
+	uint32_t dropped = LOAD(dropped);
+	uint32_t resizes = LOAD(resizes);
+	uint64_t render_us = LOAD(render_us);
+	uint64_t wait_us = LOAD(wait_us);
+#undef LOAD
+
+	if (seg->last.ts && now > seg->last.ts){
+		float dt = (float)(now - seg->last.ts) / 1000000.0;
+		uint32_t dframes = frames - seg->last.frames;
+		seg->fps = (float) dframes / dt;
+		seg->drops = (float)(dropped - seg->last.dropped) / dt;
+		seg->resize_rate = (float)(resizes - seg->last.resizes) / dt;
+		seg->wait_pct = 100.0 * (float)(wait_us - seg->last.wait_us) / (dt * 1000000.0);
+		seg->render_ms = dframes ?
+			(float)(render_us - seg->last.render_us) / (1000.0 * dframes) : 0;
+	}
+
+	seg->last.ts = now;
+	seg->last.frames = frames;
+	seg->last.dropped = dropped;
+	seg->last.resizes = resizes;
+	seg->last.render_us = render_us;
+	seg->last.wait_us = wait_us;
+
+/* the dirty region is for the last frame only, not accumulated */
+	struct arcan_shmif_region dirty = atomic_load(&page->dirty);
+	size_t area = (size_t) page->w * page->h;
+	seg->dirty_pct = 0;
+	if (area && dirty.x2 > dirty.x1 && dirty.y2 > dirty.y1){
+		size_t dw = dirty.x2 - dirty.x1, dh = dirty.y2 - dirty.y1;
+		seg->dirty_pct = 100.0 * (float)(dw * dh) / (float) area;
+		seg->dirty_pct = seg->dirty_pct > 100.0 ? 100.0 : seg->dirty_pct;
+	}
+
+	seg->inq = queue_depth(
+		page->childevq.front, page->childevq.back, page->childevq.size);
+	seg->outq = queue_depth(
+		page->parentevq.front, page->parentevq.back, page->parentevq.size);
+}
+
+static int sort_segment(const void* a, const void* b)
+{
+	const struct segment* sa = a;
+	const struct segment* sb = b;
+	if (sa->dead != sb->dead)
+		return sa->dead ? 1 : -1;
+	if (sa->wait_pct != sb->wait_pct)
+		return sa->wait_pct < sb->wait_pct ? 1 : -1;
+	return sa->fps < sb->fps ? 1 : (sa->fps > sb->fps ? -1 : 0);
+}
+
+static void draw_top(bool tty, size_t sample)
+{
+	if (tty)
+		printf("\033[H\033[2J");
+
+	printf("shmmon - segments: %zu, sample: %zu\n\n", top.n, sample);
+	printf("%7s %-16s %11s %6s %6s %6s %6s %6s %8s %5s %5s %4s/%-4s\n",
+		"PID", "COMMAND", "SIZE", "FPS", "DROP/s", "DIRTY%", "RSZ/s",
+		"WAIT%", "RENDERms", "INQ", "OUTQ", "IHWM", "OHWM");
+
+	for (size_t i = 0; i < top.n; i++){
+		struct segment* seg = &top.segs[i];
+		char size[16];
+		snprintf(size, sizeof(size), "%zux%zu",
+			(size_t) seg->page->w, (size_t) seg->page->h);
+
+		printf("%7d %-16s %11s %6.1f %6.1f %6.1f %6.1f %6.1f %8.2f %5zu %5zu %4u/%-4u\n",
+			(int) seg->pid, seg->name, size, seg->fps, seg->drops, seg->dirty_pct,
+			seg->resize_rate, seg->wait_pct, seg->render_ms, seg->inq, seg->outq,
+			(unsigned) atomic_load_explicit(&seg->page->perf.inq_hwm, memory_order_relaxed),
+			(unsigned) atomic_load_explicit(&seg->page->perf.outq_hwm, memory_order_relaxed)
+		);
+	}
+	fflush(stdout);
+}
+
+static int run_top(char** paths, size_t n_paths, int interval, size_t count)
+{
+	bool tty = isatty(STDOUT_FILENO);
+
+	for (size_t sample = 1; !count || sample <= count; sample++){
+		for (size_t i = 0; i < top.n; i++)
+			top.segs[i].seen = false;
+
+		if (n_paths){
+			for (size_t i = 0; i < n_paths; i++)
+				track_segment(paths[i], 0);
+		}
+		else
+			scan_proc();
+
+/* a client that shrinks the page under us will SIGBUS the read */
+		uint64_t now = time_us();
+		for (volatile size_t i = 0; i < top.n; i++){
+			struct segment* seg = &top.segs[i];
+			if (seg->dead)
+				continue;
+
+			if (!seg->seen || sigsetjmp(recover, 1)){
+				drop_segment(seg);
+				continue;
+			}
+			sample_segment(seg, now);
+		}
+
+/* compact, the mappings move with the entries */
+		size_t j = 0;
+		for (size_t i = 0; i < top.n; i++)
+			if (!top.segs[i].dead)
+				top.segs[j++] = top.segs[i];
+		top.n = j;
+
+		qsort(top.segs, top.n, sizeof(struct segment), sort_segment);
+		draw_top(tty, sample);
+
+		if (!count || sample < count)
+			nanosleep(&(struct timespec){
+				.tv_sec = interval / 1000,
+				.tv_nsec = (interval % 1000) * 1000000
+			}, NULL);
+	}
+
+	for (size_t i = 0; i < top.n; i++)
+		drop_segment(&top.segs[i]);
+	free(top.segs);
+	return EXIT_SUCCESS;
+}
+
 int main(int argc, char** argv)
 {
 	int ch;
-	while((ch = getopt_long(argc, argv, "", longopts, NULL)) >= 0)
+	bool top_mode = false;
+	int interval = 1000;
+	size_t count = 0;
+
+	while((ch = getopt_long(argc, argv, "ti:n:", longopts, NULL)) >= 0)
 	switch(ch){
+	case 't': top_mode = true; break;
+	case 'i': interval = strtoul(optarg, NULL, 10); break;
+	case 'n': count = strtoul(optarg, NULL, 10); break;
+	default:
+		show_use();
+		return EXIT_FAILURE;
+	}
+
+	if (top_mode){
+		if (signal(SIGBUS, bus_handler) == SIG_ERR)
+			fprintf(stderr, "Couldn't install SIGBUS handler.\n");
+		return run_top(&argv[optind], argc - optind, interval > 0 ? interval : 1000, count);
 	}
 
-	if (argc <= 1){
+	if (optind >= argc){
 		show_use();
 		return EXIT_FAILURE;
 	}
@@ -225,9 +591,9 @@ int main(int argc, char** argv)
 	void* addr = NULL;
 	size_t addr_sz;
 
-	int fd = open(argv[1], O_RDONLY);
+	int fd = open(argv[optind], O_RDONLY);
 	if (-1 == fd){
-		fprintf(stderr, "couldn't open %s\n", argv[1]);
+		fprintf(stderr, "couldn't open %s\n", argv[optind]);
 		return EXIT_FAILURE;
 	}
 
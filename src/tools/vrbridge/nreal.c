@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <math.h>
 #include <stdbool.h>
 #include <limits.h>
 #include "arcan_math.h"
@@ -100,6 +101,14 @@ static void motion_sample(
 			.w = C->fusion.q3
 		};
 		L->data.orientation = q;
+
+/* the gyro is the angular velocity in the device frame, in degrees */
+		L->data.angular_velocity = (vector){
+			.x = DEG2RAD(gyro[0]),
+			.y = DEG2RAD(gyro[1]),
+			.z = DEG2RAD(gyro[2])
+		};
+		L->data.sample_us = arcan_timemicros();
 	}
 	C->last_ts = ts;
 }
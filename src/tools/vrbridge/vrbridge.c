@@ -57,6 +57,7 @@ static void* limb_runner(void* arg)
 	struct limb_runner* meta = arg;
 
 	while (in_init){}
+	struct vr_sample_ring* ring = vr_sample_ring(meta->vr);
 
 	if (debug_offline){
 		while (meta->dev->alive){
@@ -69,10 +70,15 @@ static void* limb_runner(void* arg)
  * sampling was requested, not when the sample was retrieved */
 		unsigned long long timestamp = arcan_timemillis() - epoch;
 		meta->dev->sample(meta->dev, meta->limb, meta->limb_id);
-		uint16_t checksum = subp_checksum(
-			(uint8_t*)meta->limb, sizeof(struct vr_limb)-sizeof(uint16_t));
 		atomic_store(&meta->limb->timestamp, timestamp);
-		atomic_store(&meta->limb->data.checksum, checksum);
+		atomic_store(&meta->limb->data.checksum, vr_limb_checksum(meta->limb));
+
+/* the ring gets every sample, the limb itself only keeps the last one */
+		if (ring){
+			uint64_t sample_us = meta->limb->data.sample_us ?
+				meta->limb->data.sample_us : (uint64_t) arcan_timemicros();
+			vr_ring_push(ring, meta->limb_ind, &meta->limb->data, sample_us);
+		}
 		atomic_fetch_or(&meta->vr->ready, 1 << meta->limb_ind);
 	}
 
@@ -30,6 +30,7 @@ struct vr_limb* vrbridge_alloc_limb(
  * import/pluck from the platform- source tree
  */
 long long int arcan_timemillis();
+long long int arcan_timemicros();
 void arcan_timesleep(unsigned long);
 
 /*
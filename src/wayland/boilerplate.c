@@ -19,12 +19,37 @@ static struct zwp_linux_buffer_params_v1_interface zdmabuf_params_if = {
 };
 
 #include "wlimpl/dma_buf.c"
+#include "wlimpl/dmabuf_feedback.c"
 static struct zwp_linux_dmabuf_v1_interface zdmabuf_if = {
 	.destroy = zdmabuf_destroy,
 	.create_params = zdmabuf_params,
+	.get_default_feedback = zdmabuf_default_feedback,
+	.get_surface_feedback = zdmabuf_surface_feedback
 };
 
 
+#include "wlimpl/shm.c"
+
+#include "wayland-presentation-time-server-protocol.h"
+#include "wlimpl/presentation.c"
+static const struct wp_presentation_interface presentation_if = {
+	.destroy = presentation_destroy,
+	.feedback = presentation_feedback
+};
+
+#ifdef HAVE_SYNCOBJ
+#include "wayland-linux-drm-syncobj-v1-server-protocol.h"
+#include "wlimpl/syncobj.c"
+#endif
+
+#include "wayland-viewporter-server-protocol.h"
+#include "wlimpl/viewporter.c"
+
+#ifdef HAVE_FRACTIONAL_SCALE
+#include "wayland-fractional-scale-v1-server-protocol.h"
+#include "wlimpl/fractional_scale.c"
+#endif
+
 #include "wlimpl/surf.c"
 static struct wl_surface_interface surf_if = {
 	.destroy = surf_destroy,
@@ -36,7 +61,7 @@ static struct wl_surface_interface surf_if = {
 	.commit = surf_commit,
 	.set_buffer_transform = surf_transform,
 	.set_buffer_scale = surf_scale,
-	.damage_buffer = surf_damage
+	.damage_buffer = surf_damage_buffer
 };
 
 #include "wlimpl/region.c"
@@ -1,15 +1,21 @@
 /*
- * we used to do this, now the helper in -server will suffice
+ * normally the helper in -server will suffice, with -shm-pass we need the
+ * pool descriptors and use our own (wlimpl/shm.c)
+ */
 static void bind_shm(struct wl_client* client,
 	void* data, uint32_t version, uint32_t id)
 {
+	trace(TRACE_ALLOC, "wl_bind(shm %d:%d)", version, id);
 	struct wl_resource* res = wl_resource_create(client,
 		&wl_shm_interface, version, id);
+	if (!res){
+		wl_client_post_no_memory(client);
+		return;
+	}
 	wl_resource_set_implementation(res, &shm_if, NULL, NULL);
 	wl_shm_send_format(res, WL_SHM_FORMAT_XRGB8888);
 	wl_shm_send_format(res, WL_SHM_FORMAT_ARGB8888);
 }
- */
 
 static void bind_comp(struct wl_client *client,
 	void *data, uint32_t version, uint32_t id)
@@ -155,6 +161,10 @@ static void bind_zwp_dma_buf(struct wl_client* client,
 	}
 	wl_resource_set_implementation(res, &zdmabuf_if, NULL, NULL);
 
+/* from v4 the formats are only provided through feedback objects */
+	if (version >= ZWP_LINUX_DMABUF_V1_GET_DEFAULT_FEEDBACK_SINCE_VERSION)
+		return;
+
 /* the proper route for this is to use an egl display derived from a
  * DEVICE_NODE event, then first query the formats, then for each format, query
  * modifiers and send format+modifier pairs */
@@ -213,6 +223,65 @@ static void bind_zwp_dma_buf(struct wl_client* client,
 	free(formats);
 }
 
+static void bind_presentation(struct wl_client* client,
+	void *data, uint32_t version, uint32_t id)
+{
+	trace(TRACE_ALLOC, "wl_bind(presentation %d:%d)", version, id);
+	struct wl_resource* res = wl_resource_create(
+		client, &wp_presentation_interface, version, id);
+	if (!res){
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(res, &presentation_if, NULL, NULL);
+
+/* the scanout timestamps from arcan are on CLOCK_MONOTONIC */
+	wp_presentation_send_clock_id(res, CLOCK_MONOTONIC);
+}
+
+static void bind_viewporter(struct wl_client* client,
+	void *data, uint32_t version, uint32_t id)
+{
+	trace(TRACE_ALLOC, "wl_bind(viewporter %d:%d)", version, id);
+	struct wl_resource* res = wl_resource_create(
+		client, &wp_viewporter_interface, version, id);
+	if (!res){
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(res, &viewporter_if, NULL, NULL);
+}
+
+#ifdef HAVE_FRACTIONAL_SCALE
+static void bind_fractional_scale(struct wl_client* client,
+	void *data, uint32_t version, uint32_t id)
+{
+	trace(TRACE_ALLOC, "wl_bind(fractional_scale %d:%d)", version, id);
+	struct wl_resource* res = wl_resource_create(
+		client, &wp_fractional_scale_manager_v1_interface, version, id);
+	if (!res){
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(res, &fractional_mgr_if, NULL, NULL);
+}
+#endif
+
+#ifdef HAVE_SYNCOBJ
+static void bind_syncobj(struct wl_client* client,
+	void *data, uint32_t version, uint32_t id)
+{
+	trace(TRACE_ALLOC, "wl_bind(syncobj %d:%d)", version, id);
+	struct wl_resource* res = wl_resource_create(
+		client, &wp_linux_drm_syncobj_manager_v1_interface, version, id);
+	if (!res){
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(res, &syncobj_mgr_if, NULL, NULL);
+}
+#endif
+
 static void bind_subcomp(struct wl_client* client,
 	void* data, uint32_t version, uint32_t id)
 {
@@ -330,7 +330,7 @@ static void translate_input(
 		;
 }
 
-static void run_callback(struct comp_surf* surf)
+static void run_callback(struct comp_surf* surf, uint32_t ts)
 {
 	if (!surf->acon.addr)
 		return;
@@ -338,7 +338,7 @@ static void run_callback(struct comp_surf* surf)
 	for (size_t i = 0; i < COUNT_OF(surf->scratch) && surf->frames_pending; i++){
 		if (surf->scratch[i].type == 1){
 			surf->scratch[i].type = 0;
-			wl_callback_send_done(surf->scratch[i].res, arcan_timemillis());
+			wl_callback_send_done(surf->scratch[i].res, ts);
 			wl_resource_destroy(surf->scratch[i].res);
 			surf->frames_pending--;
 			trace(TRACE_SURF, "reply callback: %"PRIu32, surf->scratch[i].id);
@@ -355,6 +355,12 @@ static void try_frame_callback(struct comp_surf* surf)
 		return;
 	}
 
+/* occluded surfaces are left to the throttle in process_group */
+	if (surf->states.hidden){
+		trace(TRACE_SURF, "%s hidden, defer callback", surf->tracetag);
+		return;
+	}
+
 /* if this is a surface and there are subsurfaces in play that parent
 	size_t i = 0;
 	struct comp_surf* subsurf = find_surface_group(0, 's', &i);
@@ -362,14 +368,16 @@ static void try_frame_callback(struct comp_surf* surf)
 		struct comp_surf* psurf = wl_resource_get_user_data(subsurf->sub_parent_res);
 		if (psurf == surf){
 			printf("subsurface with parent, run callback\n");
-			run_callback(subsurf);
+			run_callback(subsurf, arcan_timemillis());
 		}
 		i++;
 		subsurf = find_surface_group(0, 's', &i);
 	}
  */
 
-	run_callback(surf);
+/* stamp with the scanout the frame was paced against, not our own clock */
+	run_callback(surf, surf->scanout_us ?
+		surf->scanout_us / 1000 : arcan_timemillis());
 }
 
 /*
@@ -386,6 +394,10 @@ static bool displayhint_handler(struct comp_surf* surf, struct arcan_tgtevent* e
 		.fullscreen = !!(ev->ioevs[2].iv &  16)
 	};
 
+#ifdef HAVE_FRACTIONAL_SCALE
+	fractional_update(surf, ev->ioevs[4].fv);
+#endif
+
 	bool change = memcmp(&surf->states, &states, sizeof(struct surf_state)) != 0;
 	if (change){
 		surf->last_state = surf->states;
@@ -415,6 +427,21 @@ static void flush_surface_events(struct comp_surf* surf)
 		else if (ev.category != EVENT_TARGET)
 			continue;
 
+/* vsignal (frame consumed) and vblank (scanout) both carry the last scanout
+ * time, only the former drives frame callbacks */
+		if (ev.tgt.kind == TARGET_COMMAND_STEPFRAME){
+			uint64_t ts = (uint64_t) ev.tgt.ioevs[3].uiv |
+				((uint64_t) ev.tgt.ioevs[4].uiv << 32);
+			if (ts)
+				surf->scanout_us = ts;
+
+			if (ev.tgt.ioevs[1].iv == 2){
+				presentation_scanout(surf, acon, &ev.tgt);
+				continue;
+			}
+			presentation_consumed(surf, acon, &ev.tgt);
+		}
+
 		switch(ev.tgt.kind){
 		case TARGET_COMMAND_OUTPUTHINT:{
 			update_client_output(surf->client,
@@ -435,6 +462,19 @@ static void flush_surface_events(struct comp_surf* surf)
 			got_frame_cb = true;
 		break;
 
+/* a buffer passed with -shm-pass has been consumed by the server */
+		case TARGET_COMMAND_BUFFER_RELEASE:
+			if (ev.tgt.ioevs[0].iv == BADFD && surf->shm_pending){
+				if (--surf->shm_pending == 0)
+					shm_release_held(surf);
+			}
+		break;
+
+/* the layouts the display planes take, comes with the device node */
+		case TARGET_COMMAND_DEVICESTATE:
+			dmabuf_feedback_devstate(&ev.tgt);
+		break;
+
 /* in the 'generic' case, there's litle we can do that match
  * 'EXIT' behavior. It's up to the shell-subprotocols to swallow
  * the event and map to the correct surface teardown. */
@@ -450,6 +490,25 @@ static void flush_surface_events(struct comp_surf* surf)
 		flush_mouse(surf, &mbuf);
 	}
 
+/* fullscreen state or the scanout layouts might have changed */
+	dmabuf_feedback_update(surf);
+
+#ifdef HAVE_SYNCOBJ
+/* release fences are collected by shmif, a server that doesn't provide them
+ * is done with a buffer once the next one has been presented */
+	if (surf->sync_release_n){
+		size_t held;
+		int fence = arcan_shmif_release_fence(acon, &held);
+		if (-1 != fence){
+			syncobj_release(surf, fence, held);
+			close(fence);
+			surf->sync_fenced = true;
+		}
+		else if (got_frame_cb && !surf->sync_fenced)
+			syncobj_release(surf, -1, 1);
+	}
+#endif
+
 	if (got_frame_cb){
 		try_frame_callback(surf);
 	}
@@ -496,8 +555,20 @@ static int flush_client_events(
 		break;
 		case TARGET_COMMAND_NEWSEGMENT:
 		break;
-		case TARGET_COMMAND_BCHUNK_IN:
+		case TARGET_COMMAND_DEVICESTATE:
+			dmabuf_feedback_devstate(&ev.tgt);
+		break;
 /* new paste operation, send that as a data offer to the client in question */
+		case TARGET_COMMAND_BCHUNK_IN:{
+			if (!cl->ddev)
+				continue;
+
+			int fd = arcan_shmif_dupfd(ev.tgt.ioevs[0].iv, -1, true);
+			if (-1 == fd)
+				continue;
+
+			ddev_paste_offer(cl, fd, ev.tgt.message);
+		}
 		break;
 /* new copy operation, send things there */
 		case TARGET_COMMAND_BCHUNK_OUT:{
@@ -543,6 +614,9 @@ static bool flush_bridge_events(struct arcan_shmif_cont* con)
 		switch (ev.tgt.kind){
 		case TARGET_COMMAND_EXIT:
 			return false;
+		case TARGET_COMMAND_DEVICESTATE:
+			dmabuf_feedback_devstate(&ev.tgt);
+		break;
 		default:
 		break;
 		}
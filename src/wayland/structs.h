@@ -1,6 +1,6 @@
 #ifndef HAVE_STRUCTS
 
-#define STEP_SERIAL() ( wl_display_next_serial(wl.disp) )
+#define STEP_SERIAL() ( wl_display_next_serial(tg->disp) )
 #define MAX_SEATS 8
 
 enum internal_command {
@@ -32,6 +32,9 @@ struct data_offer {
 	struct wl_resource* device;
 	struct wl_resource* offer;
 	struct wl_client* client;
+
+/* for offers made to the client, the bchunk descriptor with the contents */
+	int fd;
 };
 
 struct region {
@@ -92,7 +95,8 @@ struct bridge_client {
 	struct wl_resource* confined;
 	struct arcan_event confine_event;
 
-/* see ddev */
+/* see ddev, [ddev] is the last data device the client asked for */
+	struct wl_resource* ddev;
 	struct data_offer* doffer_copy;
 	struct data_offer* doffer_drag;
 	struct data_offer* doffer_paste;
@@ -182,6 +186,40 @@ struct scratch_req {
 	uint32_t id;
 };
 
+struct syncobj_surface;
+struct syncobj_timeline;
+struct syncobj_point {
+	struct syncobj_timeline* tl;
+	uint64_t pt;
+};
+
+/* wp_presentation feedback for the next commit (PENDING), the committed
+ * buffer (COMMITTED), and once arcan has consumed it (CONSUMED) the next
+ * scanout that follows decides if it was presented */
+enum {
+	PRESENT_FREE = 0,
+	PRESENT_PENDING,
+	PRESENT_COMMITTED,
+	PRESENT_CONSUMED
+};
+
+struct present_fb {
+	struct wl_resource* res;
+	int state;
+	uint64_t consumed_us;
+};
+
+/* wp_viewport, [src] in surface units (24.8 fixed) and [dst] with -1 as
+ * unset, the pending_ ones are applied on commit. [crop] is the part of the
+ * buffer (px) that was sent with the last shm commit */
+struct surf_viewport {
+	struct wl_resource* res;
+	wl_fixed_t src[4], pending_src[4];
+	int32_t dst[2], pending_dst[2];
+	bool dirty;
+	struct arcan_shmif_region crop;
+};
+
 #define SURF_TAGLEN 16
 #define SURF_RELEASE_WND 4
 struct comp_surf {
@@ -221,6 +259,58 @@ struct comp_surf {
  */
 	bool shm_gl_fail;
 
+/*
+ * Damage is double-buffered surface state, collected in buffer coordinates
+ * from damage/damage_buffer and consumed on commit. The shm path only copies
+ * the damaged regions into vidp as long as it still holds the previous
+ * contents, which is tracked through the last two buffers written to - for a
+ * double-buffered segment the older one also needs the previous damage.
+ */
+	struct arcan_shmif_region damage[ARCAN_SHMIF_DIRTY_LIM];
+	size_t damage_n;
+
+	shmif_pixel* shm_vidp[2];
+	struct arcan_shmif_region shm_prev[ARCAN_SHMIF_DIRTY_LIM];
+	size_t shm_prev_n;
+
+/* with -shm-pass the buffer is read by the server directly and can't be
+ * released back to the client until it tells us it is done with it */
+	struct wl_resource* shm_held;
+	struct wl_listener l_shmrel;
+	bool l_shmrel_a;
+	size_t shm_pending;
+
+/* linux-drm-syncobj, the acquire fence (if any) of the current commit goes
+ * with the next push_dma, the release points wait for the server release
+ * fence in submission order */
+	struct syncobj_surface* syncobj;
+	int sync_acquire;
+	struct syncobj_point sync_release[8];
+	size_t sync_release_n;
+	bool sync_fenced;
+
+/* see present_fb, [present_clock] tracks the vblank CLOCKREQ toggle and
+ * [scanout_us] the last scanout that arcan has told us about */
+	struct present_fb present[16];
+	bool present_clock;
+	uint64_t scanout_us;
+
+/* [scale] below is derived from these, see viewport_update_scale */
+	struct surf_viewport vport;
+	int32_t buffer_scale;
+
+/* wp_fractional_scale_v1, [fractional_pref] is the last preferred scale
+ * sent, in 120ths, and [density] the last hinted one (ppcm) */
+	struct wl_resource* fractional;
+	uint32_t fractional_pref;
+	float density;
+
+/* zwp_linux_dmabuf_feedback_v1 for the surface, [dmabuf_scanout] if the
+ * last feedback sent had a scanout tranche and for which scanout set */
+	struct wl_resource* dmabuf_fb[4];
+	bool dmabuf_scanout;
+	unsigned dmabuf_scanout_gen;
+
 /*
  * Just keep this fugly thing here as it is on par with wl_list masturbation,
  * the protocol is just riddled with unbounded allocations because all the bad
@@ -257,7 +347,8 @@ struct comp_surf {
 
 /* clients doesn't "scale" in shmif, you either draw it at the hinted
  * dimensions at the proper density or the server side will do 'something',
- * for wl we need to apply a transform hint */
+ * for wl we need to apply a transform hint. This is buffer pixels per
+ * surface unit, from the buffer scale or the viewport destination */
 	float scale;
 
 /* need to track these so that we can subtract from displayhints..*/
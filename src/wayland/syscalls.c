@@ -43,3 +43,5 @@ seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(sendmsg), 0);
 seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(mremap), 0);
 seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(clone), 0);
 seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(write), 0);
+seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(madvise), 0);
+seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(exit), 0);
@@ -17,12 +17,14 @@
 #include <EGL/eglext.h>
 #include <GL/gl.h>
 #include <sys/mman.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <errno.h>
 #include <poll.h>
 #include <assert.h>
 #include <stdatomic.h>
+#include <pthread.h>
 #include "../engine/arcan_mem.h"
 
 #include <xkbcommon/xkbcommon.h>
@@ -97,13 +99,13 @@ static void destroy_comp_surf(struct comp_surf* surf, bool clean);
 /*
  * For tracking allocations in arcan, split into bitmapped groups allocated/set
  * on startup. Allocation policy is first free slot, though no compaction
- * between groups. Doing it this way makes thread-group assignments etc.
- * easier if that ever becomes a need.
+ * between groups. Each thread group (see below) has groups of its own.
  *
  * Each group [64 bitmap] has a number of slots, and corresponding
  * poll struct entries.
  */
 static const size_t N_GROUP_SLOTS = 64;
+static const size_t N_GROUP_FIXED = 4;
 struct conn_group {
 	unsigned long long alloc;
 
@@ -113,6 +115,7 @@ struct conn_group {
 	struct pollfd* wayland;
 	struct pollfd* arcan;
 	struct pollfd* xwm;
+	struct pollfd* handoff;
 
 /* split bridge_slot and pollfd just to be able to have them on the same
  * indice, but be able to throw everyhthing at poll */
@@ -120,22 +123,59 @@ struct conn_group {
 	struct bridge_slot* slots;
 };
 
-static struct {
+/*
+ * A thread group is one wl_display with its own event loop and the poll /
+ * allocation groups for the clients and surfaces that live on it. By default
+ * there is only the main one. With -threads, the main display just accepts
+ * new clients and hands them over to the worker with the fewest clients, so
+ * that a client stalling on connect, resize or segment requests only blocks
+ * the others in its group.
+ *
+ * libwayland-server is not thread-safe, but separate displays are, so all
+ * resources of a client are only ever touched from the thread of its group.
+ * What is shared between groups (the control connection) is accessed under
+ * wl.core_lock.
+ */
+struct thread_group {
+	struct wl_display* disp;
+
+/* metadata on accelerated graphics (legacy) */
+	struct wl_drm* drm;
+
 /* allocation bitmaps to partition into poll and alloc- groups */
 	size_t n_groups;
 	struct conn_group* groups;
 
+/* new client descriptors are written here by the main thread */
+	int handoff[2];
+	_Atomic size_t clients;
+	pthread_t thread;
+
+/* last time frame callbacks were released for occluded surfaces */
+	long long throttle_ms;
+};
+
+static _Thread_local struct thread_group* tg;
+
+static struct {
+	struct thread_group main_group;
+	struct thread_group* workers;
+	size_t n_workers, n_running;
+
+/* clients accepted on the main display, destroyed there after handoff */
+	struct wl_client* handoff_pending[32];
+	size_t n_handoff_pending;
+
+/* serializes access to the control connection between thread groups */
+	pthread_mutex_t core_lock;
+
 	EGLDisplay display;
 	EGLBoolean (*query_formats)(EGLDisplay, EGLint, EGLint*, EGLint*);
 	EGLBoolean (*query_modifiers)(EGLDisplay,
 		EGLint, EGLint, EGLuint64KHR* mods, EGLBoolean* ext_only, EGLint* n_mods);
 
-	struct wl_display* disp;
 /* set to false after initialization to terminate */
-	bool alive;
-
-/* metadata on accelerated graphics (legacy) */
-	struct wl_drm* drm;
+	volatile bool alive;
 
 /* initial display parameters retrieved from the control connection */
 	struct arcan_shmif_initial init;
@@ -158,6 +198,25 @@ static struct {
  */
 	int default_accel_surface;
 
+/*
+ * use our own wl_shm and hand sealed pools over to the server rather
+ * than copying the buffer contents into the segment, see wlimpl/shm.c
+ */
+	bool shm_pass;
+
+/*
+ * render node used for the linux-drm-syncobj timelines, -1 if the node
+ * lacks timeline support or the protocol is disabled, see wlimpl/syncobj.c
+ */
+	int syncobj_fd;
+
+/*
+ * the compiled keymap is the same for every keyboard, it is written to a
+ * sealed memfd once and that descriptor is sent to all of them (core_lock)
+ */
+	int keymap_fd;
+	size_t keymap_sz;
+
 /*
  * needed to communicate window management events in the xwayland space, to
  * pair compositor surfaces with xwayland- originating ones and so on. On-
@@ -178,6 +237,9 @@ static struct {
 	bool exec_mode;
 } wl = {
 	.default_accel_surface = -1,
+	.syncobj_fd = -1,
+	.keymap_fd = -1,
+	.core_lock = PTHREAD_MUTEX_INITIALIZER
 };
 
 enum trace_levels {
@@ -213,12 +275,15 @@ static inline void trace(int level, const char* msg, ...)
 	if (!wl.trace_log || !(level & wl.trace_log) || !wl.trace_dst)
 		return;
 
+/* lock so lines from different thread groups don't interleave */
 	va_list args;
+	flockfile(wl.trace_dst);
 	va_start(args, msg);
 		vfprintf(wl.trace_dst,  msg, args);
 		fprintf(wl.trace_dst, "\n");
 	va_end(args);
 	fflush(wl.trace_dst);
+	funlockfile(wl.trace_dst);
 }
 
 #define __FILENAME__ (strrchr(__FILE__, '/')?strrchr(__FILE__, '/') + 1 : __FILE__)
@@ -260,11 +325,11 @@ static void dump_alloc(int i, char* domain, bool wmode)
 {
 /* debug output to see slot and source */
 	if (wmode || (wl.trace_log & TRACE_ALLOC)){
-		char alloc_buf[sizeof(wl.groups[i].alloc) * 8 + 1] = {0};
-		for (size_t j = 0; j < sizeof(wl.groups[i].alloc)*8;j++){
+		char alloc_buf[sizeof(tg->groups[i].alloc) * 8 + 1] = {0};
+		for (size_t j = 0; j < sizeof(tg->groups[i].alloc)*8;j++){
 			alloc_buf[j] =
-				(1 << j) & wl.groups[i].alloc ?
-				wl.groups[i].slots[j].idch : '_';
+				(1 << j) & tg->groups[i].alloc ?
+				tg->groups[i].slots[j].idch : '_';
 		}
 		if (wmode){
 			write(STDERR_FILENO, alloc_buf, sizeof(alloc_buf));
@@ -326,42 +391,41 @@ static bool waybridge_instance_keymap(
 	if (!load_keymap(&cl->kbd_state))
 		return false;
 
-	trace(TRACE_ALLOC, "creating temporary keymap copy");
-
-	char* chfn = NULL;
-	if (-1 == asprintf(&chfn, "%s/wlbridge-kmap-XXXXXX",
-		getenv("XDG_RUNTIME_DIR") ? getenv("XDG_RUNTIME_DIR") : "."))
-			chfn = NULL;
+	pthread_mutex_lock(&wl.core_lock);
+	if (-1 == wl.keymap_fd){
+		trace(TRACE_ALLOC, "creating shared keymap");
+		size_t sz = strlen(cl->kbd_state.map_str) + 1;
+
+/* clients from v7 map it private, older ones shared but read-only, either
+ * way the seals keep it from being changed under the others */
+		int fd = memfd_create("wlbridge-kmap", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+		if (-1 == fd || sz != write(fd, cl->kbd_state.map_str, sz)){
+			trace(TRACE_ALLOC, "write keymap failed");
+			if (-1 != fd)
+				close(fd);
+			pthread_mutex_unlock(&wl.core_lock);
+			free_kbd_state(&cl->kbd_state);
+			return false;
+		}
 
-	int fd;
-	if (!chfn || (fd = mkstemp(chfn)) == -1){
-		trace(TRACE_ALLOC, "make tempmap failed");
-		free(chfn);
-		free_kbd_state(&cl->kbd_state);
-		return false;
+		fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+		wl.keymap_fd = fd;
+		wl.keymap_sz = sz;
 	}
-	unlink(chfn);
 
-	*out_sz = strlen(cl->kbd_state.map_str) + 1;
-	if (*out_sz != write(fd, cl->kbd_state.map_str, *out_sz)){
-		trace(TRACE_ALLOC, "write keymap failed");
-		close(fd);
-		free(chfn);
-		free_kbd_state(&cl->kbd_state);
-		return false;
-	}
+/* libwayland duplicates the descriptor when the event is marshalled */
+	*out_fd = wl.keymap_fd;
+	*out_sz = wl.keymap_sz;
+	pthread_mutex_unlock(&wl.core_lock);
 
-	free(chfn);
-	*out_fd = fd;
 	*out_fmt = WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1;
-
 	return true;
 }
 
 static bool alloc_group_id(int type, int* groupid, int* slot, int fd, char d)
 {
-	for (size_t i = 0; i < wl.n_groups; i++){
-	uint64_t ind = find_set64(~wl.groups[i].alloc);
+	for (size_t i = 0; i < tg->n_groups; i++){
+	uint64_t ind = find_set64(~tg->groups[i].alloc);
 		if (0 == ind)
 			continue;
 
@@ -370,10 +434,10 @@ static bool alloc_group_id(int type, int* groupid, int* slot, int fd, char d)
 
 /* mark as allocated and store */
 		trace(TRACE_ALLOC, "alloc_to(%d : %d)", i, ind);
-		wl.groups[i].alloc |= 1 << ind;
-		wl.groups[i].pg[ind].fd = fd;
-		wl.groups[i].slots[ind].type = type;
-		wl.groups[i].slots[ind].idch = d;
+		tg->groups[i].alloc |= 1 << ind;
+		tg->groups[i].pg[ind].fd = fd;
+		tg->groups[i].slots[ind].type = type;
+		tg->groups[i].slots[ind].idch = d;
 		*groupid = i;
 		*slot = ind;
 
@@ -386,10 +450,10 @@ static bool alloc_group_id(int type, int* groupid, int* slot, int fd, char d)
 
 static void reset_group_slot(int group, int slot)
 {
-	wl.groups[group].alloc &= ~(1 << slot);
-	wl.groups[group].pg[slot].fd = -1;
-	wl.groups[group].pg[slot].revents = 0;
-	wl.groups[group].slots[slot] = (struct bridge_slot){};
+	tg->groups[group].alloc &= ~(1 << slot);
+	tg->groups[group].pg[slot].fd = -1;
+	tg->groups[group].pg[slot].revents = 0;
+	tg->groups[group].slots[slot] = (struct bridge_slot){};
 
 	dump_alloc(group, "reset", false);
 }
@@ -421,7 +485,7 @@ static bool request_surface(
  * IF the primary connection is unused, we can simply return that UNLESS
  * the request type is a CURSOR or a POPUP (both are possible in XDG).
  */
-	static uint32_t alloc_id = 0xbabe;
+	static _Atomic uint32_t alloc_id = 0xbabe;
 	trace(TRACE_ALLOC, "segment-req source(%s) -> %d", req->trace, alloc_id);
 	arcan_shmif_enqueue(&cl->acon, &(struct arcan_event){
 		.ext.kind = ARCAN_EVENT(SEGREQ),
@@ -482,7 +546,7 @@ static bool request_surface(
  * [if SURFACE]:comp_surf(dispatch) */
 				else{
 					cl->refc++;
-					wl.groups[group].slots[ind].surface = req->source;
+					tg->groups[group].slots[ind].surface = req->source;
 				}
 			}
 		}
@@ -514,6 +578,21 @@ static void destroy_comp_surf(struct comp_surf* surf, bool clean)
 		wl_list_remove(&surf->l_bufrem.link);
 	}
 
+	if (surf->l_shmrel_a){
+		surf->l_shmrel_a = false;
+		wl_list_remove(&surf->l_shmrel.link);
+	}
+
+#ifdef HAVE_SYNCOBJ
+	syncobj_surface_drop(surf);
+#endif
+	presentation_drop(surf);
+	viewport_drop(surf);
+	dmabuf_feedback_drop(surf);
+#ifdef HAVE_FRACTIONAL_SCALE
+	fractional_drop(surf);
+#endif
+
 /* destroy any dangling listeners */
 	for (size_t i = 0; i < COUNT_OF(surf->scratch) && surf->frames_pending; i++){
 		if (surf->scratch[i].type == 1){
@@ -557,18 +636,18 @@ static void destroy_comp_surf(struct comp_surf* surf, bool clean)
 
 static struct comp_surf* find_surface_group(int group, char type, size_t* pos)
 {
-	if (group < 0 || group < wl.n_groups)
+	if (group < 0 || group < tg->n_groups)
 		return NULL;
 
-	for (size_t i = (*pos); i < sizeof(wl.groups[i].alloc)*8; i++){
-		if (!((1 << i) & wl.groups[group].alloc) ||
-			wl.groups[group].slots[i].type != SLOT_TYPE_SURFACE ||
-			!wl.groups[group].slots[i].surface)
+	for (size_t i = (*pos); i < sizeof(tg->groups[i].alloc)*8; i++){
+		if (!((1 << i) & tg->groups[group].alloc) ||
+			tg->groups[group].slots[i].type != SLOT_TYPE_SURFACE ||
+			!tg->groups[group].slots[i].surface)
 			continue;
 
-		if (type == 0 || wl.groups[group].slots[i].idch == type){
+		if (type == 0 || tg->groups[group].slots[i].idch == type){
 			*pos = i;
-			return wl.groups[group].slots[i].surface;
+			return tg->groups[group].slots[i].surface;
 		}
 	}
 
@@ -583,7 +662,7 @@ static void destroy_client(struct wl_listener* l, void* data)
 {
 	struct bridge_client* cl = wl_container_of(l, cl, l_destr);
 
-	if (!cl || !(wl.groups[cl->group].alloc & (1 << cl->slot))){
+	if (!cl || !(tg->groups[cl->group].alloc & (1 << cl->slot))){
 		trace(TRACE_ALLOC, "destroy_client(), struct doesn't match bitmap");
 		return;
 	}
@@ -595,22 +674,22 @@ static void destroy_client(struct wl_listener* l, void* data)
  */
 
 /* each 'group', skip those with no alloc- bits */
-	for (size_t i = 0; i < wl.n_groups; i++){
-		if (0 == find_set64(~wl.groups[i].alloc))
+	for (size_t i = 0; i < tg->n_groups; i++){
+		if (0 == find_set64(~tg->groups[i].alloc))
 			continue;
 
 /* each surface in group */
-		for (size_t j = 0; j < sizeof(wl.groups[i].alloc)*8; j++){
-			if ( !((1 << j) & wl.groups[i].alloc) )
+		for (size_t j = 0; j < sizeof(tg->groups[i].alloc)*8; j++){
+			if ( !((1 << j) & tg->groups[i].alloc) )
 				continue;
 
 /* check if it belongs to the client we want to destroy */
-			if (wl.groups[i].slots[j].type == SLOT_TYPE_SURFACE &&
-				wl.groups[i].slots[j].surface &&
-				(wl.groups[i].slots[j].surface->client == cl)){
+			if (tg->groups[i].slots[j].type == SLOT_TYPE_SURFACE &&
+				tg->groups[i].slots[j].surface &&
+				(tg->groups[i].slots[j].surface->client == cl)){
 				trace(TRACE_ALLOC,"destroy_client->dangling surface(%zu:%zu:%c)",
-					i, j, wl.groups[i].slots[j].idch);
-				destroy_comp_surf(wl.groups[i].slots[j].surface, true);
+					i, j, tg->groups[i].slots[j].idch);
+				destroy_comp_surf(tg->groups[i].slots[j].surface, true);
 			}
 		}
 	}
@@ -660,8 +739,8 @@ static struct bridge_client* find_client(struct wl_client* cl)
 	struct bridge_client* res = NULL;
 
 /* traverse each group, check the fields for the set bits for match */
-	for (size_t i = 0; i < wl.n_groups; i++){
-		uint64_t mask = wl.groups[i].alloc;
+	for (size_t i = 0; i < tg->n_groups; i++){
+		uint64_t mask = tg->groups[i].alloc;
 		while (mask){
 			uint64_t ind = find_set64(mask);
 			if (!ind)
@@ -669,9 +748,9 @@ static struct bridge_client* find_client(struct wl_client* cl)
 
 			ind--;
 
-			if (wl.groups[i].slots[ind].type == SLOT_TYPE_CLIENT){
-				if (wl.groups[i].slots[ind].client.client == cl)
-					return &wl.groups[i].slots[ind].client;
+			if (tg->groups[i].slots[ind].type == SLOT_TYPE_CLIENT){
+				if (tg->groups[i].slots[ind].client.client == cl)
+					return &tg->groups[i].slots[ind].client;
 			}
 
 			mask &= ~(1 << ind);
@@ -692,6 +771,8 @@ static struct bridge_client* find_client(struct wl_client* cl)
  */
 	struct arcan_shmif_cont con = {0};
 
+/* the control connection is shared between thread groups */
+	pthread_mutex_lock(&wl.core_lock);
 	if (!con.addr){
 		arcan_shmif_enqueue(&wl.control,
 		&(struct arcan_event){
@@ -708,6 +789,7 @@ static struct bridge_client* find_client(struct wl_client* cl)
 	 * would just fail next iteration */
 		if (arcan_shmif_acquireloop(&wl.control, &acqev, &pqueue, &pqueue_sz)){
 			if (acqev.tgt.kind != TARGET_COMMAND_NEWSEGMENT){
+				pthread_mutex_unlock(&wl.core_lock);
 				trace(TRACE_ALLOC, "couldn't allocate client over control connection");
 				wl_client_post_no_memory(cl);
 				return NULL;
@@ -719,6 +801,7 @@ static struct bridge_client* find_client(struct wl_client* cl)
 			free(pqueue);
 		}
 	}
+	pthread_mutex_unlock(&wl.core_lock);
 
 	if (!con.addr){
 		trace(TRACE_ALLOC,
@@ -748,7 +831,7 @@ static struct bridge_client* find_client(struct wl_client* cl)
  * connection, we can't simply ignore connecting at this stage.
  */
 	trace(TRACE_ALLOC, "new client assigned to (%d:%d)", group, ind);
-	res = &wl.groups[group].slots[ind].client;
+	res = &tg->groups[group].slots[ind].client;
 	*res = (struct bridge_client){
 		.scale = 1
 	};
@@ -785,20 +868,20 @@ static void rebuild_client(struct bridge_client* bcl)
 		struct arcan_shmif_cont new;
 		int ind;
 		int group;
-	} surfaces[wl.n_groups * 64];
+	} surfaces[tg->n_groups * 64];
 	size_t surf_count = 0;
-	memset(surfaces, '\0', sizeof(surfaces[0]) * wl.n_groups * 64);
+	memset(surfaces, '\0', sizeof(surfaces[0]) * tg->n_groups * 64);
 
 	trace(TRACE_ALERT, "rebuild_client");
 
 /* update the pollset with the new descriptor */
-	wl.groups[bcl->group].pg[bcl->slot].fd = bcl->acon.epipe;
+	tg->groups[bcl->group].pg[bcl->slot].fd = bcl->acon.epipe;
 	struct comp_surf* cursor_surface = NULL;
 	size_t cs_group = 0;
 	size_t cs_ind = 0;
 
-	for (size_t i = 0; i < wl.n_groups; i++){
-		uint64_t mask = wl.groups[i].alloc;
+	for (size_t i = 0; i < tg->n_groups; i++){
+		uint64_t mask = tg->groups[i].alloc;
 		while (mask){
 			uint64_t ind = find_set64(mask);
 			if (!ind)
@@ -807,19 +890,19 @@ static void rebuild_client(struct bridge_client* bcl)
 			mask &= ~(1 << ind);
 
 /* if it is not marked as a normal surface, or not actually in-use, skip */
-			if (wl.groups[i].slots[ind].type != SLOT_TYPE_SURFACE ||
-				!wl.groups[i].slots[ind].surface)
+			if (tg->groups[i].slots[ind].type != SLOT_TYPE_SURFACE ||
+				!tg->groups[i].slots[ind].surface)
 				continue;
 
 /* if it is not tied to the requested client, ignore */
-			if (wl.groups[i].slots[ind].surface->client != bcl)
+			if (tg->groups[i].slots[ind].surface->client != bcl)
 				continue;
 
 /* rcons (mouse cursor), just disassociate, the next time the cursor
  * is set, we'll reassociate */
-			if (wl.groups[i].slots[ind].surface->rcon){
-				wl.groups[i].slots[ind].surface->rcon = NULL;
-				cursor_surface = wl.groups[i].slots[ind].surface;
+			if (tg->groups[i].slots[ind].surface->rcon){
+				tg->groups[i].slots[ind].surface->rcon = NULL;
+				cursor_surface = tg->groups[i].slots[ind].surface;
 				cs_group = i;
 				cs_ind = ind;
 				continue;
@@ -827,9 +910,9 @@ static void rebuild_client(struct bridge_client* bcl)
 
 			surfaces[surf_count].group = i;
 			surfaces[surf_count].ind = ind;
-			surfaces[surf_count].surf = wl.groups[i].slots[ind].surface;
+			surfaces[surf_count].surf = tg->groups[i].slots[ind].surface;
 			trace(TRACE_ALERT, "queue surface for rebuild: %c",
-				wl.groups[i].slots[ind].idch);
+				tg->groups[i].slots[ind].idch);
 			surf_count++;
 		}
 	}
@@ -839,7 +922,7 @@ static void rebuild_client(struct bridge_client* bcl)
  * though - we're SOL, might need a panic- hook in the comp_surf in order to
  * forward deletion to the client so it knows that some surface died, though
  * this will likely just make the thing crash. */
-	static uint32_t ralloc_id = 0xbeba;
+	static _Atomic uint32_t ralloc_id = 0xbeba;
 	for (size_t i = 0; i < surf_count; i++){
 		struct comp_surf* surf = surfaces[i].surf;
 		trace(TRACE_ALERT, "(%zu/%zu) rebuild, request %s => %d (%"PRIxPTR",%"PRIxPTR")",
@@ -935,7 +1018,7 @@ static void rebuild_client(struct bridge_client* bcl)
 		arcan_shmif_drop(&surf->acon);
 		surf->acon = surfaces[i].new;
 		arcan_shmif_signal(&surf->acon, SHMIF_SIGVID | SHMIF_SIGBLK_NONE);
-		wl.groups[surfaces[i].group].pg[surfaces[i].ind].fd = surf->acon.epipe;
+		tg->groups[surfaces[i].group].pg[surfaces[i].ind].fd = surf->acon.epipe;
 		trace(TRACE_ALERT, "rebuild %zu:%s - fd set to %d",
 			i, surf->tracetag, surf->acon.epipe);
 	}
@@ -986,7 +1069,7 @@ static void rebuild_client(struct bridge_client* bcl)
 		if (cursor_surface){
 			trace(TRACE_ALERT, "reassigned cursor subsegment");
 			cursor_surface->rcon = &bcl->acursor;
-			wl.groups[cs_group].pg[cs_ind].fd = bcl->acursor.epipe;
+			tg->groups[cs_group].pg[cs_ind].fd = bcl->acursor.epipe;
 			dump_alloc(cs_group, "rebuild_client", false);
 		}
 	}
@@ -1054,18 +1137,19 @@ static struct conn_group* prepare_groups(size_t count)
 
 	memset(groups, '\0', sizeof(struct conn_group) * count);
 	for (size_t i = 0; i < count; i++){
-		groups[i].pgroup = malloc(sizeof(struct pollfd) * (N_GROUP_SLOTS+3));
+		groups[i].pgroup = malloc(sizeof(struct pollfd) * (N_GROUP_SLOTS+N_GROUP_FIXED));
 		groups[i].slots = malloc(sizeof(struct bridge_slot) * N_GROUP_SLOTS);
 
 		if (!groups[i].pgroup || !groups[i].slots)
 			OUT_OF_MEMORY("group/slot alloc");
 
-		groups[i].pg = &groups[i].pgroup[3];
+		groups[i].pg = &groups[i].pgroup[N_GROUP_FIXED];
 		groups[i].wayland = &groups[i].pgroup[0];
 		groups[i].arcan = &groups[i].pgroup[1];
 		groups[i].xwm = &groups[i].pgroup[2];
+		groups[i].handoff = &groups[i].pgroup[3];
 
-		for (size_t j = 0; j < N_GROUP_SLOTS+3; j++){
+		for (size_t j = 0; j < N_GROUP_SLOTS+N_GROUP_FIXED; j++){
 			groups[i].pgroup[j] = (struct pollfd){
 				.events = POLLIN | POLLERR | POLLHUP,
 				.fd = -1
@@ -1108,6 +1192,8 @@ static int show_use(const char* msg, const char* arg)
 "\t-exec bin arg1 .. end of arg parsing, single-client mode (recommended)\n"
 "\t-exec-x11 bin arg same as -xwl -exec bin arg1 .. form\n"
 "\t-shm-egl          pass shm- buffers as gl textures\n"
+"\t-shm-pass         pass sealed shm- pools to arcan instead of copying\n"
+"\t-threads n        dispatch clients on n threads (not with -xwl, -shm-egl)\n"
 #ifdef ENABLE_SECCOMP
 "\t-sandbox          filter syscalls, ...\n"
 #endif
@@ -1122,6 +1208,7 @@ static int show_use(const char* msg, const char* arg)
 "\t-no-egl           disable the wayland-egl extensions\n"
 "\t       -no-drm    disable the drm subprotocol\n"
 "\t       -no-dma    disable the dma-buf subprotocol\n"
+"\t    -no-syncobj   disable the linux-drm-syncobj subprotocol\n"
 "\t-no-compositor    disable the compositor protocol\n"
 "\t-no-subcompositor disable the sub-compositor/surface protocol\n"
 "\t-no-shell         disable the shell protocol\n"
@@ -1134,6 +1221,9 @@ static int show_use(const char* msg, const char* arg)
 "\t-no-constraints   disable the pointer constraints protocol\n"
 "\t-no-xdg-decor     disable the xdg-decor protocol\n"
 "\t-no-kwin-decor    disable the kwin-ssd-manager protocol\n"
+"\t-no-presentation  disable the presentation-time protocol\n"
+"\t-no-viewporter    disable the viewporter protocol\n"
+"\t-no-fractional    disable the fractional-scale protocol\n"
 "\nDebugging Tools:\n"
 "\t-trace level      set trace output to (bitmask or key1,key2,...):\n"
 "\t\t1   - alloc         2 - digital          4 - analog\n"
@@ -1143,14 +1233,128 @@ static int show_use(const char* msg, const char* arg)
 	return EXIT_FAILURE;
 }
 
+/*
+ * [main thread, -threads]
+ * Accepted clients are moved to the worker with the fewest clients by
+ * duplicating the socket and creating a new client on the worker display from
+ * it. Nothing has been read or written on it yet so the client can't tell.
+ * The original can't be destroyed from within the create signal, that is
+ * deferred until the dispatch has finished.
+ */
+static void handoff_client(struct wl_listener* l, void* data)
+{
+	struct wl_client* cl = data;
+	if (!wl.n_workers || tg != &wl.main_group ||
+		wl.n_handoff_pending == COUNT_OF(wl.handoff_pending))
+		return;
+
+	struct thread_group* dst = &wl.workers[0];
+	for (size_t i = 1; i < wl.n_workers; i++)
+		if (wl.workers[i].clients < dst->clients)
+			dst = &wl.workers[i];
+
+	int fd = fcntl(wl_client_get_fd(cl), F_DUPFD_CLOEXEC, 0);
+	if (-1 == fd){
+		trace(TRACE_ALLOC, "handoff: couldn't duplicate client socket");
+		return;
+	}
+
+	if (sizeof(int) != write(dst->handoff[1], &fd, sizeof(int))){
+		trace(TRACE_ALLOC, "handoff: couldn't queue client");
+		close(fd);
+		return;
+	}
+
+	dst->clients++;
+	wl.handoff_pending[wl.n_handoff_pending++] = cl;
+	trace(TRACE_ALLOC, "handoff client to group %zu", (size_t)(dst - wl.workers));
+}
+
+static void handoff_flush()
+{
+	for (size_t i = 0; i < wl.n_handoff_pending; i++)
+		wl_client_destroy(wl.handoff_pending[i]);
+	wl.n_handoff_pending = 0;
+}
+
+struct handoff_tag {
+	struct wl_listener l_destr;
+	struct thread_group* group;
+};
+
+static void handoff_destroy(struct wl_listener* l, void* data)
+{
+	struct handoff_tag* tag = wl_container_of(l, tag, l_destr);
+	tag->group->clients--;
+	wl_list_remove(&tag->l_destr.link);
+	free(tag);
+}
+
+/*
+ * [worker thread]
+ * take over a client from the main thread, a descriptor of -1 is just used
+ * to wake us up on shutdown
+ */
+static void handoff_receive(struct thread_group* group)
+{
+	int fd;
+	if (sizeof(int) != read(group->handoff[0], &fd, sizeof(int)) || -1 == fd)
+		return;
+
+	struct handoff_tag* tag = malloc(sizeof(struct handoff_tag));
+	struct wl_client* cl = tag ? wl_client_create(group->disp, fd) : NULL;
+	if (!cl){
+		trace(TRACE_ALLOC, "handoff: couldn't create client");
+		group->clients--;
+		free(tag);
+		close(fd);
+		return;
+	}
+
+	trace(TRACE_ALLOC, "handoff: client received");
+	tag->group = group;
+	tag->l_destr.notify = handoff_destroy;
+	wl_client_add_destroy_listener(cl, &tag->l_destr);
+}
+
+/*
+ * Occluded surfaces don't get their frame callbacks from vsignal, but clients
+ * that block waiting on them would stall completely, so release them at a
+ * slow rate instead.
+ */
+#define HIDDEN_FRAME_MS 1000
+static void throttle_hidden()
+{
+	long long now = arcan_timemillis();
+	if (now - tg->throttle_ms < HIDDEN_FRAME_MS)
+		return;
+
+	tg->throttle_ms = now;
+	for (size_t i = 0; i < tg->n_groups; i++){
+		for (size_t j = 0; j < N_GROUP_SLOTS; j++){
+			struct bridge_slot* slot = &tg->groups[i].slots[j];
+			if (slot->type == SLOT_TYPE_SURFACE && slot->surface &&
+				slot->surface->states.hidden && slot->surface->frames_pending)
+				run_callback(slot->surface, now);
+		}
+	}
+}
+
 static bool process_group(struct conn_group* group)
 {
-	int sv = poll(group->pgroup, N_GROUP_SLOTS+3, 1000);
+	int sv = poll(group->pgroup, N_GROUP_SLOTS+N_GROUP_FIXED, 1000);
 
 	if (group->wayland && group->wayland->revents){
 		trace(TRACE_ALERT, "process wayland");
 		wl_event_loop_dispatch(
-			wl_display_get_event_loop(wl.disp), 0);
+			wl_display_get_event_loop(tg->disp), 0);
+		if (wl.n_handoff_pending)
+			handoff_flush();
+		sv--;
+	}
+
+	if (group->handoff && group->handoff->revents){
+		handoff_receive(tg);
 		sv--;
 	}
 
@@ -1162,9 +1366,11 @@ static bool process_group(struct conn_group* group)
 
 	if (group->arcan && group->arcan->revents){
 		trace(TRACE_ALERT, "process bridge");
+		pthread_mutex_lock(&wl.core_lock);
 		if (!flush_bridge_events(&wl.control)){
 			wl.alive = false;
 		}
+		pthread_mutex_unlock(&wl.core_lock);
 		sv--;
 	}
 
@@ -1207,10 +1413,21 @@ static bool process_group(struct conn_group* group)
 		}
 	}
 
-	wl_display_flush_clients(wl.disp);
+	throttle_hidden();
+	wl_display_flush_clients(tg->disp);
 	return true;
 }
 
+/*
+ * [-threads] each worker runs its own thread group until shutdown
+ */
+static void* worker_thread(void* arg)
+{
+	tg = arg;
+	while (wl.alive && process_group(&tg->groups[0])){}
+	return NULL;
+}
+
 /*
  * only happens in exec_mode
  */
@@ -1251,6 +1468,7 @@ int main(int argc, char* argv[])
 	struct {
 		int compositor, shell, shm, seat, output, ddev;
 		int egl, xdg, subcomp, drm, relp, dma, cons, xdg_output, xdg_decor, kwin_decor;
+		int syncobj, presentation, viewporter, fractional;
 	} protocols = {
 		.compositor = 4,
 		.shell = 1,
@@ -1260,14 +1478,18 @@ int main(int argc, char* argv[])
 		.egl = 1,
 		.xdg = 1,
 		.drm = 1,
-		.dma = 2,
+		.dma = 4,
 		.subcomp = 1,
 		.ddev = 3,
 		.relp = 1,
 		.cons = 1,
 		.xdg_output = 2,
 		.xdg_decor = 1,
-		.kwin_decor = 1
+		.kwin_decor = 1,
+		.syncobj = 1,
+		.presentation = 1,
+		.viewporter = 1,
+		.fractional = 1
 	};
 #ifdef ENABLE_SECCOMP
 	bool sandbox = false;
@@ -1290,6 +1512,17 @@ int main(int argc, char* argv[])
 		else if (strcmp(argv[arg_i], "-shm-egl") == 0){
 			wl.default_accel_surface = 0;
 		}
+		else if (strcmp(argv[arg_i], "-shm-pass") == 0){
+			wl.shm_pass = true;
+		}
+		else if (strcmp(argv[arg_i], "-threads") == 0){
+			if (arg_i == argc-1)
+				return show_use("missing thread count", "");
+			arg_i++;
+			wl.n_workers = strtoul(argv[arg_i], NULL, 10);
+			if (wl.n_workers > 64)
+				wl.n_workers = 64;
+		}
 #ifdef ENABLE_SECCOMP
 		else if (strcmp(argv[arg_i], "-sandbox") == 0){
 			sandbox = true;
@@ -1384,6 +1617,14 @@ int main(int argc, char* argv[])
 			protocols.xdg_output = 0;
 		else if (strcmp(argv[arg_i], "-no-dma") == 0)
 			protocols.dma = 0;
+		else if (strcmp(argv[arg_i], "-no-syncobj") == 0)
+			protocols.syncobj = 0;
+		else if (strcmp(argv[arg_i], "-no-presentation") == 0)
+			protocols.presentation = 0;
+		else if (strcmp(argv[arg_i], "-no-viewporter") == 0)
+			protocols.viewporter = 0;
+		else if (strcmp(argv[arg_i], "-no-fractional") == 0)
+			protocols.fractional = 0;
 		else if (strcmp(argv[arg_i], "-no-xdg") == 0)
 			protocols.xdg = 0;
 		else if (strcmp(argv[arg_i], "-no-subcompositor") == 0)
@@ -1417,6 +1658,17 @@ int main(int argc, char* argv[])
 			return show_use("unknown argument: ", argv[arg_i]);
 	}
 
+/* Xwayland pairing and GL uploads are tied to the main thread */
+	if (wl.n_workers && wl.use_xwayland){
+		fprintf(stderr, "-threads can't be combined with -xwl, ignored\n");
+		wl.n_workers = 0;
+	}
+
+	if (wl.n_workers && wl.default_accel_surface == 0){
+		fprintf(stderr, "-shm-egl can't be combined with -threads, ignored\n");
+		wl.default_accel_surface = -1;
+	}
+
 	if (!got_xdg_runtime && !wl.exec_mode){
 		fprintf(stderr,
 			"XDG_RUNTIME_DIR not set and -exec/-exec-x11 not used.\n"
@@ -1468,13 +1720,41 @@ int main(int argc, char* argv[])
 		}
 	}
 
-	wl.disp = wl_display_create();
-	if (!wl.disp){
+	tg = &wl.main_group;
+	tg->handoff[0] = tg->handoff[1] = -1;
+	tg->disp = wl_display_create();
+	if (!tg->disp){
 		fprintf(stderr,
 			"Couldn't create wayland display in (%s)\n", getenv("XDG_RUNTIME_DIR"));
 		return EXIT_FAILURE;
 	}
 
+/* the worker displays have no socket of their own, clients are created on
+ * them from what the main one accepts (handoff_client) */
+	if (wl.n_workers){
+		wl.workers = malloc(sizeof(struct thread_group) * wl.n_workers);
+		if (!wl.workers)
+			OUT_OF_MEMORY("thread groups");
+
+		for (size_t i = 0; i < wl.n_workers; i++){
+			struct thread_group* grp = &wl.workers[i];
+			*grp = (struct thread_group){};
+			grp->disp = wl_display_create();
+			if (!grp->disp || -1 == pipe2(grp->handoff, O_CLOEXEC)){
+				fprintf(stderr, "Couldn't create thread group display\n");
+				return EXIT_FAILURE;
+			}
+			grp->groups = prepare_groups(1);
+			grp->n_groups = 1;
+			grp->groups[0].wayland->fd =
+				wl_event_loop_get_fd(wl_display_get_event_loop(grp->disp));
+			grp->groups[0].handoff->fd = grp->handoff[0];
+		}
+
+		static struct wl_listener l_handoff = {.notify = handoff_client};
+		wl_display_add_client_created_listener(tg->disp, &l_handoff);
+	}
+
 /*
  * The purpose of having a 'control' bridge connection on which we never set
  * clients is to have a window where we can monitor the state of the server and
@@ -1578,8 +1858,25 @@ int main(int argc, char* argv[])
 		}
 
 		if (protocols.drm){
-			wl.drm = wayland_drm_init(wl.disp, getenv("ARCAN_RENDER_NODE"), NULL, 0);
+			tg->drm = wayland_drm_init(tg->disp, getenv("ARCAN_RENDER_NODE"), NULL, 0);
 		}
+
+#ifdef HAVE_SYNCOBJ
+		if (protocols.dma && protocols.syncobj){
+			wl.syncobj_fd = syncobj_open_device(getenv("ARCAN_RENDER_NODE"));
+			if (-1 == wl.syncobj_fd){
+				trace(TRACE_ALERT, "render node lacks timeline syncobj, explicit sync off");
+			}
+		}
+#endif
+	}
+
+/* feedback (v4) needs the render node and the EGL format queries, else stay
+ * with the older version that sends the formats on bind */
+	if (protocols.dma > 2 &&
+		(!protocols.egl || !dmabuf_feedback_init(getenv("ARCAN_RENDER_NODE")))){
+		trace(TRACE_ALERT, "no dma-buf format table, feedback disabled");
+		protocols.dma = 2;
 	}
 
 /*
@@ -1588,7 +1885,7 @@ int main(int argc, char* argv[])
  * it can spawn new primary connections as well as needing to crash-recover
  */
 	SET_WAYLAND_RUNTIME();
-		wl_display_add_socket_auto(wl.disp);
+		wl_display_add_socket_auto(tg->disp);
 	SET_ARCAN_RUNTIME();
 
 /*
@@ -1596,48 +1893,76 @@ int main(int argc, char* argv[])
  * testing / breaking clients as it's easy to run into 'woops we only tested
  * against weston/mutter exposed sets'.
  */
-	if (protocols.compositor)
-		wl_global_create(wl.disp, &wl_compositor_interface,
-			protocols.compositor, NULL, &bind_comp);
-	if (protocols.shell)
-		wl_global_create(wl.disp, &wl_shell_interface,
-			protocols.shell, NULL, &bind_shell);
-	if (protocols.shm)
-		wl_display_init_shm(wl.disp);
-	if (protocols.seat)
-		wl_global_create(wl.disp, &wl_seat_interface,
-			MIN(protocols.seat, wl_seat_interface.version), NULL, &bind_seat);
-	if (protocols.output)
-		wl_global_create(wl.disp, &wl_output_interface,
-			protocols.output, NULL, &bind_output);
-	if (protocols.xdg)
-		wl_global_create(wl.disp, &xdg_wm_base_interface,
-			protocols.xdg, NULL, &bind_xdg);
-	if (protocols.dma){
-		wl_global_create(wl.disp, &zwp_linux_dmabuf_v1_interface,
-			protocols.dma, NULL, &bind_zwp_dma_buf);
-	}
-	if (protocols.subcomp)
-		wl_global_create(wl.disp, &wl_subcompositor_interface,
-			protocols.subcomp, NULL, &bind_subcomp);
-	if (protocols.ddev)
-		wl_global_create(wl.disp, &wl_data_device_manager_interface,
-			protocols.ddev, NULL, &bind_ddev);
-	if (protocols.relp)
-		wl_global_create(wl.disp, &zwp_relative_pointer_manager_v1_interface,
-			protocols.relp, NULL, &bind_relp);
-	if (protocols.cons)
-		wl_global_create(wl.disp, &zwp_pointer_constraints_v1_interface,
-			protocols.cons, NULL, &bind_cons);
-	if (protocols.xdg_output)
-		wl_global_create(wl.disp, &zxdg_output_manager_v1_interface,
-			protocols.xdg_output, NULL, &bind_xdgoutput);
-	if (protocols.xdg_decor)
-		wl_global_create(wl.disp, &zxdg_decoration_manager_v1_interface,
-			protocols.xdg_decor, NULL, &bind_xdgdecor);
-	if (protocols.kwin_decor)
-		wl_global_create(wl.disp, &org_kde_kwin_server_decoration_manager_interface,
-			protocols.kwin_decor, NULL, &bind_kwindecor);
+/* each thread group has a display of its own that needs the same set */
+	for (size_t i = 0; i <= wl.n_workers; i++){
+		struct wl_display* disp = i ? wl.workers[i-1].disp : tg->disp;
+		if (i && protocols.egl && protocols.drm)
+			wl.workers[i-1].drm =
+				wayland_drm_init(disp, getenv("ARCAN_RENDER_NODE"), NULL, 0);
+
+		if (protocols.compositor)
+			wl_global_create(disp, &wl_compositor_interface,
+				protocols.compositor, NULL, &bind_comp);
+		if (protocols.shell)
+			wl_global_create(disp, &wl_shell_interface,
+				protocols.shell, NULL, &bind_shell);
+		if (protocols.shm){
+			if (wl.shm_pass)
+				wl_global_create(disp, &wl_shm_interface, 1, NULL, &bind_shm);
+			else
+				wl_display_init_shm(disp);
+		}
+		if (protocols.seat)
+			wl_global_create(disp, &wl_seat_interface,
+				MIN(protocols.seat, wl_seat_interface.version), NULL, &bind_seat);
+		if (protocols.output)
+			wl_global_create(disp, &wl_output_interface,
+				protocols.output, NULL, &bind_output);
+		if (protocols.xdg)
+			wl_global_create(disp, &xdg_wm_base_interface,
+				protocols.xdg, NULL, &bind_xdg);
+		if (protocols.dma){
+			wl_global_create(disp, &zwp_linux_dmabuf_v1_interface,
+				protocols.dma, NULL, &bind_zwp_dma_buf);
+		}
+#ifdef HAVE_SYNCOBJ
+		if (-1 != wl.syncobj_fd)
+			wl_global_create(disp, &wp_linux_drm_syncobj_manager_v1_interface,
+				1, NULL, &bind_syncobj);
+#endif
+		if (protocols.subcomp)
+			wl_global_create(disp, &wl_subcompositor_interface,
+				protocols.subcomp, NULL, &bind_subcomp);
+		if (protocols.ddev)
+			wl_global_create(disp, &wl_data_device_manager_interface,
+				protocols.ddev, NULL, &bind_ddev);
+		if (protocols.relp)
+			wl_global_create(disp, &zwp_relative_pointer_manager_v1_interface,
+				protocols.relp, NULL, &bind_relp);
+		if (protocols.cons)
+			wl_global_create(disp, &zwp_pointer_constraints_v1_interface,
+				protocols.cons, NULL, &bind_cons);
+		if (protocols.xdg_output)
+			wl_global_create(disp, &zxdg_output_manager_v1_interface,
+				protocols.xdg_output, NULL, &bind_xdgoutput);
+		if (protocols.xdg_decor)
+			wl_global_create(disp, &zxdg_decoration_manager_v1_interface,
+				protocols.xdg_decor, NULL, &bind_xdgdecor);
+		if (protocols.kwin_decor)
+			wl_global_create(disp, &org_kde_kwin_server_decoration_manager_interface,
+				protocols.kwin_decor, NULL, &bind_kwindecor);
+		if (protocols.presentation)
+			wl_global_create(disp, &wp_presentation_interface,
+				protocols.presentation, NULL, &bind_presentation);
+		if (protocols.viewporter)
+			wl_global_create(disp, &wp_viewporter_interface,
+				protocols.viewporter, NULL, &bind_viewporter);
+#ifdef HAVE_FRACTIONAL_SCALE
+		if (protocols.fractional)
+			wl_global_create(disp, &wp_fractional_scale_manager_v1_interface,
+				protocols.fractional, NULL, &bind_fractional_scale);
+#endif
+	}
 
 	trace(TRACE_ALLOC, "wl_display() finished");
 
@@ -1649,11 +1974,11 @@ int main(int argc, char* argv[])
  * time to slice of a new thread/process and continue there - but that's
  * something to worry about when we have all the features in place.
  */
-	wl.groups = prepare_groups(1);
-	wl.n_groups = 1;
-	wl.groups[0].wayland->fd =
-		wl_event_loop_get_fd(wl_display_get_event_loop(wl.disp));
-	wl.groups[0].arcan->fd = wl.control.epipe;
+	tg->groups = prepare_groups(1);
+	tg->n_groups = 1;
+	tg->groups[0].wayland->fd =
+		wl_event_loop_get_fd(wl_display_get_event_loop(tg->disp));
+	tg->groups[0].arcan->fd = wl.control.epipe;
 
 /* pipes from xwm etc, don't want that to kill us */
 	sigaction(SIGPIPE, &(struct sigaction){
@@ -1703,6 +2028,17 @@ int main(int argc, char* argv[])
 		SET_ARCAN_RUNTIME();
 	}
 
+/* started before the sandbox as thread creation isn't in the filter */
+	for (size_t i = 0; i < wl.n_workers && wl.alive; i++){
+		if (0 != pthread_create(
+			&wl.workers[i].thread, NULL, worker_thread, &wl.workers[i])){
+			fprintf(stderr, "Couldn't spawn thread group %zu\n", i);
+			wl.alive = false;
+			break;
+		}
+		wl.n_running++;
+	}
+
 #ifdef ENABLE_SECCOMP
 /* Unfortunately a rather obese list, part of it is our lack of control
  * over the whole FFI nonsense and the keylayout creation/transfer. You
@@ -1717,7 +2053,7 @@ int main(int argc, char* argv[])
 	}
 #endif
 
-	while(wl.alive && process_group(&wl.groups[0])){
+	while(wl.alive && process_group(&tg->groups[0])){
 
 /* Xwayland or the window manager might have died, restart in those cases */
 		if (wl.use_xwayland){
@@ -1732,15 +2068,40 @@ int main(int argc, char* argv[])
 	}
 
 cleanup:
-	if (wl.disp){
+	wl.alive = false;
+	for (size_t i = 0; i < wl.n_running; i++){
+		int fd = -1;
+		write(wl.workers[i].handoff[1], &fd, sizeof(int));
+		pthread_join(wl.workers[i].thread, NULL);
+	}
+
+/* destroying a display tears down its clients, which expects the group */
+	for (size_t i = 0; wl.workers && i < wl.n_workers; i++){
+		if (wl.workers[i].disp){
+			tg = &wl.workers[i];
+			wl_display_destroy(tg->disp);
+		}
+	}
+	tg = &wl.main_group;
+
+	if (tg->disp){
 		SET_WAYLAND_RUNTIME();
-			wl_display_destroy(wl.disp);
+			wl_display_destroy(tg->disp);
 		SET_ARCAN_RUNTIME();
 	}
 
 	arcan_shmif_drop(&wl.control);
 	free(arcan_runtime_dir);
 
+	if (-1 != wl.syncobj_fd)
+		close(wl.syncobj_fd);
+
+	if (-1 != dmabuf_table.fd)
+		close(dmabuf_table.fd);
+
+	if (-1 != wl.keymap_fd)
+		close(wl.keymap_fd);
+
 /* We have created a folder with temporary files and links, this comes with
  * the -xwl and -exec modes and we treat this as authoritative. This should
  * be shallow (only nodes by us or possibly symlinks so don't recurse */
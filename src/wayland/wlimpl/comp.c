@@ -40,7 +40,14 @@ static void comp_surf_create(struct wl_client *client,
 		.client = cl,
 		.tracetag = "compositor",
 		.shm_gl_fail = wl.default_accel_surface,
-		.scale = cl->scale
+		.scale = cl->scale,
+		.buffer_scale = cl->scale,
+		.vport = {
+			.src = {-1, -1, -1, -1},
+			.pending_src = {-1, -1, -1, -1},
+			.dst = {-1, -1},
+			.pending_dst = {-1, -1}
+		}
 	};
 	new_surf->viewport = (struct arcan_event){
 		.category = EVENT_EXTERNAL,
@@ -36,3 +36,76 @@ static void ddev_release(
 	trace(TRACE_DDEV, "%"PRIxPTR, (uintptr_t) res);
 	wl_resource_destroy(res);
 }
+
+static void ddev_free(struct wl_resource* res)
+{
+	struct bridge_client* cl = find_client(wl_resource_get_client(res));
+	if (cl && cl->ddev == res)
+		cl->ddev = NULL;
+}
+
+/* the bchunk extension is all we know about the contents */
+static const char* paste_mime(const char* ext)
+{
+	static const struct {
+		const char* ext, (* mime);
+	} map[] = {
+		{"png", "image/png"},
+		{"jpg", "image/jpeg"},
+		{"jpeg", "image/jpeg"},
+		{"bmp", "image/bmp"},
+		{"uri", "text/uri-list"},
+		{"html", "text/html"}
+	};
+
+	for (size_t i = 0; ext && i < COUNT_OF(map); i++)
+		if (strcasecmp(ext, map[i].ext) == 0)
+			return map[i].mime;
+
+	return NULL;
+}
+
+/* [flush_client_events] BCHUNK_IN, the new selection is offered to the data
+ * device of the client, takes ownership of [fd] */
+static void ddev_paste_offer(struct bridge_client* cl, int fd, const char* ext)
+{
+	struct data_offer* offer;
+	struct wl_resource* res;
+
+	if (!cl->ddev || !(offer = malloc(sizeof(struct data_offer)))){
+		close(fd);
+		return;
+	}
+
+	res = wl_resource_create(cl->client,
+		&wl_data_offer_interface, wl_resource_get_version(cl->ddev), 0);
+	if (!res){
+		free(offer);
+		close(fd);
+		return;
+	}
+
+	*offer = (struct data_offer){
+		.device = cl->ddev,
+		.offer = res,
+		.client = cl->client,
+		.fd = fd
+	};
+	wl_resource_set_implementation(res, &doffer_if, offer, doffer_free);
+
+/* the previous one is destroyed by the client when it sees the new one */
+	cl->doffer_paste = offer;
+	wl_data_device_send_data_offer(cl->ddev, res);
+
+	const char* mime = paste_mime(ext);
+	trace(TRACE_DDEV, "paste(%s)", mime ? mime : "text");
+	if (mime)
+		wl_data_offer_send_offer(res, mime);
+	else {
+		wl_data_offer_send_offer(res, "text/plain;charset=utf-8");
+		wl_data_offer_send_offer(res, "text/plain");
+		wl_data_offer_send_offer(res, "UTF8_STRING");
+	}
+
+	wl_data_device_send_selection(cl->ddev, res);
+}
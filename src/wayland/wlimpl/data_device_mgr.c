@@ -22,15 +22,16 @@ static void ddevmgr_create_data_source(
 	}
 
 	struct data_offer* data = malloc(sizeof(struct data_offer));
-	memset(data, '\0', sizeof(struct data_offer));
-
 	if (!data){
 		wl_resource_post_no_memory(res);
 		wl_resource_destroy(src);
 		return;
 	}
 
-	data->offer = res;
+	*data = (struct data_offer){
+		.offer = res,
+		.fd = -1
+	};
 	wl_resource_set_implementation(src, &dsrc_if, data, drop_source);
 }
 
@@ -48,5 +49,9 @@ static void ddevmgr_get_data_device(
 		return;
 	}
 
-	wl_resource_set_implementation(src, &ddev_if, NULL, NULL);
+	wl_resource_set_implementation(src, &ddev_if, NULL, ddev_free);
+
+	struct bridge_client* bcl = find_client(cl);
+	if (bcl)
+		bcl->ddev = src;
 }
@@ -2,7 +2,52 @@
  * wl_data_offer_send_offer
  * wl_data_offer_send_source_actions
  * wl_data_offer_send_action
+ *
+ * Offers are made for pastes from arcan (BCHUNK_IN on the client connection)
+ * and [fd] is the descriptor with the contents. It is moved to the client in
+ * one go on receive rather than read in here, so the size of the paste does
+ * not matter to the bridge.
  */
+#include <fcntl.h>
+
+struct paste_job {
+	int in, out;
+};
+
+/* splice needs a pipe on one side, the bchunk descriptor can be a file and
+ * the receiving end something else than a pipe, then fall back to copying */
+static void* paste_thread(void* arg)
+{
+	struct paste_job* job = arg;
+	size_t total = 0;
+	ssize_t nr;
+
+	while ((nr = splice(job->in, NULL, job->out, NULL, 1 << 20, SPLICE_F_MOVE)) > 0)
+		total += nr;
+
+	if (-1 == nr && (errno == EINVAL || errno == ENOSYS) && !total){
+		char buf[65536];
+		bool ok = true;
+		while (ok &&
+			((nr = read(job->in, buf, sizeof(buf))) > 0 || (-1 == nr && errno == EINTR))){
+			for (ssize_t ofs = 0; ok && ofs < nr;){
+				ssize_t nw = write(job->out, &buf[ofs], nr - ofs);
+				if (nw > 0){
+					ofs += nw;
+					total += nw;
+				}
+				else
+					ok = nw == -1 && errno == EINTR;
+			}
+		}
+	}
+
+	trace(TRACE_DDEV, "paste done(%zu bytes)", total);
+	close(job->in);
+	close(job->out);
+	free(job);
+	return NULL;
+}
 
 static void doffer_accept(struct wl_client* cl,
 	struct wl_resource* res, uint32_t serial, const char* mime)
@@ -14,6 +59,30 @@ static void doffer_receive(struct wl_client* cl,
 	struct wl_resource* res, const char* mime, int32_t fd)
 {
 	trace(TRACE_DDEV, "%s", mime ? mime : "");
+	struct data_offer* offer = wl_resource_get_user_data(res);
+
+/* the contents can only be read once, later receives get an empty pipe */
+	struct paste_job* job;
+	if (!offer || -1 == offer->fd || !(job = malloc(sizeof(struct paste_job)))){
+		close(fd);
+		return;
+	}
+
+/* the client might have left the write end non-blocking, the job blocks */
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+	*job = (struct paste_job){.in = offer->fd, .out = fd};
+	offer->fd = -1;
+
+	pthread_t pthr;
+	pthread_attr_t pattr;
+	pthread_attr_init(&pattr);
+	pthread_attr_setdetachstate(&pattr, PTHREAD_CREATE_DETACHED);
+	if (0 != pthread_create(&pthr, &pattr, paste_thread, job)){
+		close(job->in);
+		close(job->out);
+		free(job);
+	}
+	pthread_attr_destroy(&pattr);
 }
 
 static void doffer_actions(struct wl_client* cl,
@@ -30,4 +99,22 @@ static void doffer_finish(struct wl_client* cl, struct wl_resource* res)
 static void doffer_destroy(struct wl_client* cl, struct wl_resource* res)
 {
 	trace(TRACE_DDEV, "");
+	wl_resource_destroy(res);
+}
+
+static void doffer_free(struct wl_resource* res)
+{
+	struct data_offer* offer = wl_resource_get_user_data(res);
+	if (!offer)
+		return;
+
+	struct bridge_client* cl = find_client(offer->client);
+	if (cl && cl->doffer_paste == offer)
+		cl->doffer_paste = NULL;
+
+	if (-1 != offer->fd)
+		close(offer->fd);
+
+	wl_resource_set_user_data(res, NULL);
+	free(offer);
 }
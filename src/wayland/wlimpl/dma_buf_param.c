@@ -81,6 +81,13 @@ static void zdmattr_buffer_finish(struct wl_client* cl, struct wl_resource* res,
 	buffer->w = w;
 	buffer->h = h;
 
+/* planes can be added before the dimensions and format are known */
+	for (size_t i = 0; i < COUNT_OF(buffer->planes); i++){
+		buffer->planes[i].w = w;
+		buffer->planes[i].h = h;
+		buffer->planes[i].gbm.format = fmt;
+	}
+
 	wl_resource_set_implementation(
 		buffer->res, &buffer_impl, buffer, dmabuf_destroy_user);
 
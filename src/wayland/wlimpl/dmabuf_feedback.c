@@ -0,0 +1,328 @@
+/*
+ * zwp_linux_dmabuf_feedback_v1 (linux-dmabuf v4). The format table is what
+ * EGL can import on the render node and is built once. Fullscreen surfaces
+ * get a scanout tranche ahead of it with the layouts arcan has said its
+ * overlay planes take (DEVICESTATE metadata that comes with the device node)
+ * so that a client can allocate buffers that the plane assignment can put on
+ * a plane as is rather than having them composed.
+ */
+#include <sys/stat.h>
+
+#ifndef SCANOUT_FORMAT_LIMIT
+#define SCANOUT_FORMAT_LIMIT 32
+#endif
+
+struct dmabuf_table_ent {
+	uint32_t format;
+	uint32_t pad;
+	uint64_t modifier;
+};
+
+static struct {
+	int fd;
+	size_t n;
+	struct dmabuf_table_ent* ent;
+	dev_t dev;
+
+/* from DEVICESTATE, written under wl.core_lock */
+	uint32_t scanout_fmt[SCANOUT_FORMAT_LIMIT];
+	uint64_t scanout_mod[SCANOUT_FORMAT_LIMIT];
+	size_t scanout_n;
+	unsigned scanout_gen;
+} dmabuf_table = {
+	.fd = -1
+};
+
+static bool dmabuf_table_add(uint32_t format, uint64_t modifier)
+{
+	if (dmabuf_table.n >= UINT16_MAX)
+		return false;
+
+	struct dmabuf_table_ent* ent = realloc(dmabuf_table.ent,
+		sizeof(struct dmabuf_table_ent) * (dmabuf_table.n + 1));
+	if (!ent)
+		return false;
+
+	dmabuf_table.ent = ent;
+	ent[dmabuf_table.n++] = (struct dmabuf_table_ent){
+		.format = format,
+		.modifier = modifier
+	};
+	return true;
+}
+
+/* [main] after EGL setup, false if there is nothing to give feedback on */
+static bool dmabuf_feedback_init(const char* node)
+{
+	struct stat nodest;
+	EGLint num;
+
+	if (!node || -1 == stat(node, &nodest) ||
+		!wl.query_formats || !wl.query_formats(wl.display, 0, NULL, &num) || !num)
+		return false;
+
+	dmabuf_table.dev = nodest.st_rdev;
+
+	EGLint* formats = malloc(sizeof(EGLint) * num);
+	if (!formats)
+		return false;
+
+	if (!wl.query_formats(wl.display, num, formats, &num))
+		num = 0;
+
+	for (size_t i = 0; i < num; i++){
+		EGLint n_mods = 0;
+		if (!wl.query_modifiers ||
+			!wl.query_modifiers(wl.display, formats[i], 0, NULL, NULL, &n_mods) ||
+			!n_mods){
+			dmabuf_table_add(formats[i], DRM_FORMAT_MOD_INVALID);
+			continue;
+		}
+
+		EGLuint64KHR* mods = malloc(n_mods * sizeof(EGLuint64KHR));
+		if (mods &&
+			wl.query_modifiers(wl.display, formats[i], n_mods, mods, NULL, &n_mods)){
+			for (size_t j = 0; j < n_mods; j++)
+				dmabuf_table_add(formats[i], mods[j]);
+		}
+		free(mods);
+	}
+	free(formats);
+
+	size_t sz = dmabuf_table.n * sizeof(struct dmabuf_table_ent);
+	if (!sz)
+		return false;
+
+/* clients map it read-only, seal it so that holds */
+	int fd = memfd_create("arcan-wayland-dmabuf", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (-1 == fd)
+		return false;
+
+	if (sz != write(fd, dmabuf_table.ent, sz)){
+		close(fd);
+		return false;
+	}
+
+	fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+	dmabuf_table.fd = fd;
+
+	trace(TRACE_ALLOC, "dmabuf-feedback:table(%zu pairs)", dmabuf_table.n);
+	return true;
+}
+
+/* [flush_*_events] TARGET_COMMAND_DEVICESTATE, the surfaces pick up the
+ * change through [scanout_gen] on their next event flush */
+static void dmabuf_feedback_devstate(struct arcan_tgtevent* ev)
+{
+	bool changed = false;
+	pthread_mutex_lock(&wl.core_lock);
+
+	if (ev->ioevs[0].iv == 2){
+		changed = dmabuf_table.scanout_n != 0;
+		dmabuf_table.scanout_n = 0;
+	}
+	else if (ev->ioevs[0].iv == 3 && dmabuf_table.scanout_n < SCANOUT_FORMAT_LIMIT){
+		size_t i = dmabuf_table.scanout_n++;
+		dmabuf_table.scanout_fmt[i] = ev->ioevs[4].uiv;
+		dmabuf_table.scanout_mod[i] =
+			((uint64_t) ev->ioevs[1].uiv << 32) | ev->ioevs[2].uiv;
+		changed = true;
+	}
+
+	if (changed)
+		dmabuf_table.scanout_gen++;
+
+	pthread_mutex_unlock(&wl.core_lock);
+}
+
+/* the table entries that can go on a plane, as tranche_formats indices */
+static size_t dmabuf_scanout_indices(struct wl_array* dst)
+{
+	size_t count = 0;
+	pthread_mutex_lock(&wl.core_lock);
+
+	for (size_t i = 0; i < dmabuf_table.n; i++){
+		for (size_t j = 0; j < dmabuf_table.scanout_n; j++){
+			if (dmabuf_table.ent[i].format != dmabuf_table.scanout_fmt[j] ||
+				dmabuf_table.ent[i].modifier != dmabuf_table.scanout_mod[j])
+				continue;
+
+			uint16_t* ind = wl_array_add(dst, sizeof(uint16_t));
+			if (ind){
+				*ind = i;
+				count++;
+			}
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&wl.core_lock);
+	return count;
+}
+
+static void dmabuf_feedback_send(struct wl_resource* res, bool scanout)
+{
+	struct wl_array dev;
+	wl_array_init(&dev);
+	dev_t* devp = wl_array_add(&dev, sizeof(dev_t));
+	if (!devp){
+		wl_resource_post_no_memory(res);
+		return;
+	}
+	*devp = dmabuf_table.dev;
+
+	zwp_linux_dmabuf_feedback_v1_send_format_table(res,
+		dmabuf_table.fd, dmabuf_table.n * sizeof(struct dmabuf_table_ent));
+	zwp_linux_dmabuf_feedback_v1_send_main_device(res, &dev);
+
+/* display and render node are assumed to be the same device */
+	if (scanout){
+		struct wl_array ind;
+		wl_array_init(&ind);
+		if (dmabuf_scanout_indices(&ind)){
+			zwp_linux_dmabuf_feedback_v1_send_tranche_target_device(res, &dev);
+			zwp_linux_dmabuf_feedback_v1_send_tranche_flags(res,
+				ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_FLAGS_SCANOUT);
+			zwp_linux_dmabuf_feedback_v1_send_tranche_formats(res, &ind);
+			zwp_linux_dmabuf_feedback_v1_send_tranche_done(res);
+		}
+		wl_array_release(&ind);
+	}
+
+	struct wl_array all;
+	wl_array_init(&all);
+	uint16_t* ind = wl_array_add(&all, sizeof(uint16_t) * dmabuf_table.n);
+	if (ind){
+		for (size_t i = 0; i < dmabuf_table.n; i++)
+			ind[i] = i;
+	}
+
+	zwp_linux_dmabuf_feedback_v1_send_tranche_target_device(res, &dev);
+	zwp_linux_dmabuf_feedback_v1_send_tranche_flags(res, 0);
+	zwp_linux_dmabuf_feedback_v1_send_tranche_formats(res, &all);
+	zwp_linux_dmabuf_feedback_v1_send_tranche_done(res);
+	zwp_linux_dmabuf_feedback_v1_send_done(res);
+
+	wl_array_release(&all);
+	wl_array_release(&dev);
+}
+
+static bool dmabuf_scanout_candidate(struct comp_surf* surf, unsigned* gen)
+{
+	pthread_mutex_lock(&wl.core_lock);
+	size_t n = dmabuf_table.scanout_n;
+	*gen = dmabuf_table.scanout_gen;
+	pthread_mutex_unlock(&wl.core_lock);
+
+	return surf->states.fullscreen && !surf->states.hidden && n > 0;
+}
+
+/* [flush_surface_events] re-send surface feedback when the surface goes in
+ * or out of being a scanout candidate, or the scanout set changed under it */
+static void dmabuf_feedback_update(struct comp_surf* surf)
+{
+	bool any = false;
+	for (size_t i = 0; i < COUNT_OF(surf->dmabuf_fb) && !any; i++)
+		any = surf->dmabuf_fb[i] != NULL;
+	if (!any)
+		return;
+
+	unsigned gen;
+	bool scanout = dmabuf_scanout_candidate(surf, &gen);
+	if (scanout == surf->dmabuf_scanout &&
+		(!scanout || gen == surf->dmabuf_scanout_gen))
+		return;
+
+	surf->dmabuf_scanout = scanout;
+	surf->dmabuf_scanout_gen = gen;
+	for (size_t i = 0; i < COUNT_OF(surf->dmabuf_fb); i++){
+		if (surf->dmabuf_fb[i]){
+			trace(TRACE_SURF, "%s dmabuf-feedback(scanout: %d)", surf->tracetag, scanout);
+			dmabuf_feedback_send(surf->dmabuf_fb[i], scanout);
+		}
+	}
+}
+
+static void dmabuf_feedback_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static void dmabuf_feedback_free(struct wl_resource* res)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(res);
+	if (!surf)
+		return;
+
+	for (size_t i = 0; i < COUNT_OF(surf->dmabuf_fb); i++){
+		if (surf->dmabuf_fb[i] == res){
+			surf->dmabuf_fb[i] = NULL;
+			break;
+		}
+	}
+}
+
+static const struct zwp_linux_dmabuf_feedback_v1_interface dmabuf_feedback_if = {
+	.destroy = dmabuf_feedback_destroy
+};
+
+static struct wl_resource* dmabuf_feedback_create(
+	struct wl_client* cl, struct wl_resource* res, uint32_t id)
+{
+	struct wl_resource* fres = wl_resource_create(cl,
+		&zwp_linux_dmabuf_feedback_v1_interface, wl_resource_get_version(res), id);
+	if (!fres)
+		wl_resource_post_no_memory(res);
+	return fres;
+}
+
+static void zdmabuf_default_feedback(
+	struct wl_client* cl, struct wl_resource* res, uint32_t id)
+{
+	trace(TRACE_ALLOC, "dmabuf-feedback:default(%"PRIu32")", id);
+	struct wl_resource* fres = dmabuf_feedback_create(cl, res, id);
+	if (!fres)
+		return;
+
+	wl_resource_set_implementation(fres, &dmabuf_feedback_if, NULL, NULL);
+	dmabuf_feedback_send(fres, false);
+}
+
+static void zdmabuf_surface_feedback(struct wl_client* cl,
+	struct wl_resource* res, uint32_t id, struct wl_resource* surface)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(surface);
+	trace(TRACE_ALLOC, "dmabuf-feedback:surface(%"PRIu32")", id);
+
+	struct wl_resource* fres = dmabuf_feedback_create(cl, res, id);
+	if (!fres)
+		return;
+
+/* more feedback objects than any sane client would ask for, those get the
+ * default feedback and are then left alone */
+	for (size_t i = 0; i < COUNT_OF(surf->dmabuf_fb); i++){
+		if (!surf->dmabuf_fb[i]){
+			surf->dmabuf_fb[i] = fres;
+			surf->dmabuf_scanout =
+				dmabuf_scanout_candidate(surf, &surf->dmabuf_scanout_gen);
+			wl_resource_set_implementation(
+				fres, &dmabuf_feedback_if, surf, dmabuf_feedback_free);
+			dmabuf_feedback_send(fres, surf->dmabuf_scanout);
+			return;
+		}
+	}
+
+	wl_resource_set_implementation(fres, &dmabuf_feedback_if, NULL, NULL);
+	dmabuf_feedback_send(fres, false);
+}
+
+/* [destroy_comp_surf] the feedback objects become inert */
+static void dmabuf_feedback_drop(struct comp_surf* surf)
+{
+	for (size_t i = 0; i < COUNT_OF(surf->dmabuf_fb); i++){
+		if (surf->dmabuf_fb[i]){
+			wl_resource_set_user_data(surf->dmabuf_fb[i], NULL);
+			surf->dmabuf_fb[i] = NULL;
+		}
+	}
+}
@@ -335,7 +335,8 @@ bind_drm(struct wl_client *client, void *data, uint32_t version, uint32_t id)
 		wl_resource_post_event(resource, WL_DRM_CAPABILITIES, capabilities);
 }
 
-static struct shmifext_buffer_plane buffer_to_plane(struct wl_drm_buffer* buf)
+static struct shmifext_buffer_plane buffer_to_plane(
+	struct wl_drm_buffer* buf, size_t i)
 {
 	return (struct shmifext_buffer_plane){
 		.fd = arcan_shmif_dupfd(buf->fd, -1, false),
@@ -344,12 +345,31 @@ static struct shmifext_buffer_plane buffer_to_plane(struct wl_drm_buffer* buf)
 		.h = buf->height,
 		.gbm = {
 			.format = buf->format,
-			.stride = buf->stride[0],
-			.offset = buf->offset[0]
+			.stride = buf->stride[i],
+			.offset = buf->offset[i]
 		}
 	};
 }
 
+/* planar buffers share the one descriptor with per-plane offset/stride */
+static size_t buffer_planes(struct wl_drm_buffer* buf)
+{
+	switch (buf->format){
+	case WL_DRM_FORMAT_NV12:
+	case WL_DRM_FORMAT_NV21:
+	case WL_DRM_FORMAT_NV16:
+	case WL_DRM_FORMAT_NV61:
+		return 2;
+	case WL_DRM_FORMAT_YUV420:
+	case WL_DRM_FORMAT_YVU420:
+	case WL_DRM_FORMAT_YUV422:
+	case WL_DRM_FORMAT_YUV444:
+		return 3;
+	default:
+		return 1;
+	}
+}
+
 static void wayland_drm_commit(struct comp_surf* surf,
 	struct wl_drm_buffer* buf, struct arcan_shmif_cont* con)
 {
@@ -375,7 +395,7 @@ static void wayland_drm_commit(struct comp_surf* surf,
 /* the interface can deal with multiple planes to a buffer, though the current
  * implementation restricts us to 1, so assume that for now - we need to dup
  * the handle since the import procedure closes the handle */
-		struct shmifext_buffer_plane plane = buffer_to_plane(buf);
+		struct shmifext_buffer_plane plane = buffer_to_plane(buf, 0);
 
 /* now we can readback into the store (possible asynch through a PBO if we have
  * multiple clients and don't want to stall, or as a separate thread that
@@ -391,14 +411,14 @@ static void wayland_drm_commit(struct comp_surf* surf,
 		return;
 	}
 
-/*
- * The patches for the multi- buffer formats are coming in, but are not yet
- * here - basically in this layer it should only be setting a flag on the
- * SHMIF_SIGNAL to indicate a continuation, and repeat for all buffers
- */
-	struct shmifext_buffer_plane planes[4] = {buffer_to_plane(buf)};
+/* each plane gets its own descriptor (dup of the same one) as the receiving
+ * end imports them independently */
+	size_t n_planes = buffer_planes(buf);
+	struct shmifext_buffer_plane planes[3];
+	for (size_t i = 0; i < n_planes; i++)
+		planes[i] = buffer_to_plane(buf, i);
 
-	arcan_shmifext_signal_planes(con, SHMIF_SIGVID, 1, planes);
+	arcan_shmifext_signal_planes(con, SHMIF_SIGVID, n_planes, planes);
 }
 
 static struct wl_drm_buffer *
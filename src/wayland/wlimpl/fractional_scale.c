@@ -0,0 +1,104 @@
+/*
+ * wp_fractional_scale_v1, the preferred scale is the density of the display
+ * the surface is shown on (DISPLAYHINT) relative to the shmif default, in
+ * 120ths. With a wp_viewport destination the client can then render at the
+ * size arcan presents the surface at, rather than at the next integer scale
+ * and have it scaled down on composition.
+ */
+
+static uint32_t fractional_pref(float ppcm)
+{
+	if (wl.scale)
+		return wl.scale * 120;
+
+	if (ppcm <= 0.0)
+		ppcm = wl.init.density;
+
+	uint32_t pref = roundf(ppcm / ARCAN_SHMPAGE_DEFAULT_PPCM * 120.0);
+	return pref ? pref : 120;
+}
+
+/* [displayhint_handler] and on creation */
+static void fractional_update(struct comp_surf* surf, float ppcm)
+{
+	if (ppcm > 0.0)
+		surf->density = ppcm;
+
+	uint32_t pref = fractional_pref(surf->density);
+	if (!surf->fractional || pref == surf->fractional_pref)
+		return;
+
+	trace(TRACE_SURF, "%s preferred_scale(%"PRIu32" -> %"PRIu32")",
+		surf->tracetag, surf->fractional_pref, pref);
+
+	surf->fractional_pref = pref;
+	wp_fractional_scale_v1_send_preferred_scale(surf->fractional, pref);
+
+/* configures until the client has committed to a destination */
+	if (surf->vport.dst[0] <= 0 && surf->vport.res)
+		surf->scale = pref / 120.0;
+}
+
+static void fractional_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static void fractional_free(struct wl_resource* res)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(res);
+	if (!surf)
+		return;
+
+	surf->fractional = NULL;
+	surf->fractional_pref = 0;
+}
+
+static const struct wp_fractional_scale_v1_interface fractional_if = {
+	.destroy = fractional_destroy
+};
+
+static void fractional_mgr_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static void fractional_mgr_get(struct wl_client* cl,
+	struct wl_resource* res, uint32_t id, struct wl_resource* surface)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(surface);
+	trace(TRACE_ALLOC, "fractional_scale:get(%"PRIu32")", id);
+
+	if (surf->fractional){
+		wl_resource_post_error(res,
+			WP_FRACTIONAL_SCALE_MANAGER_V1_ERROR_FRACTIONAL_SCALE_EXISTS,
+			"surface already has a fractional scale");
+		return;
+	}
+
+	struct wl_resource* fres = wl_resource_create(cl,
+		&wp_fractional_scale_v1_interface, wl_resource_get_version(res), id);
+	if (!fres){
+		wl_resource_post_no_memory(res);
+		return;
+	}
+
+	surf->fractional = fres;
+	wl_resource_set_implementation(fres, &fractional_if, surf, fractional_free);
+
+	fractional_update(surf, 0.0);
+}
+
+static const struct wp_fractional_scale_manager_v1_interface fractional_mgr_if = {
+	.destroy = fractional_mgr_destroy,
+	.get_fractional_scale = fractional_mgr_get
+};
+
+/* [destroy_comp_surf] */
+static void fractional_drop(struct comp_surf* surf)
+{
+	if (surf->fractional){
+		wl_resource_set_user_data(surf->fractional, NULL);
+		surf->fractional = NULL;
+	}
+}
@@ -0,0 +1,180 @@
+/*
+ * wp_presentation, driven by the scanout timestamps arcan attaches to the
+ * frame feedback (STEPFRAME). The vsignal STEPFRAME tells us a frame has been
+ * consumed, the vblank one (CLOCKREQ, only enabled while there is feedback
+ * waiting on it) that the display has scanned out, and the first scanout
+ * after consumption is when the frame was presented.
+ */
+#include <time.h>
+
+static void present_fb_free(struct wl_resource* res)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(res);
+	if (!surf)
+		return;
+
+	for (size_t i = 0; i < COUNT_OF(surf->present); i++){
+		if (surf->present[i].res == res){
+			surf->present[i] = (struct present_fb){};
+			break;
+		}
+	}
+}
+
+static void present_discard(struct present_fb* fb)
+{
+	struct wl_resource* res = fb->res;
+	*fb = (struct present_fb){};
+	wp_presentation_feedback_send_discarded(res);
+	wl_resource_destroy(res);
+}
+
+static void present_clock(struct comp_surf* surf,
+	struct arcan_shmif_cont* acon, bool state)
+{
+	if (surf->present_clock == state || !acon->addr)
+		return;
+
+/* dynamic = 2 toggles vblank feedback on the segment */
+	surf->present_clock = state;
+	arcan_shmif_enqueue(acon, &(struct arcan_event){
+		.ext.kind = ARCAN_EVENT(CLOCKREQ),
+		.ext.clock.dynamic = 2
+	});
+}
+
+/* [surf_commit] feedback requested before the commit now refers to it, the
+ * ones without content to present are discarded */
+static void presentation_commit(struct comp_surf* surf, bool has_buffer)
+{
+	for (size_t i = 0; i < COUNT_OF(surf->present); i++){
+		if (surf->present[i].state != PRESENT_PENDING)
+			continue;
+
+		if (has_buffer)
+			surf->present[i].state = PRESENT_COMMITTED;
+		else
+			present_discard(&surf->present[i]);
+	}
+}
+
+/* [flush_surface_events] vsignal, the committed frames are now with arcan
+ * and will be presented with the first scanout after the one it carries */
+static void presentation_consumed(struct comp_surf* surf,
+	struct arcan_shmif_cont* acon, struct arcan_tgtevent* ev)
+{
+	uint64_t last = (uint64_t) ev->ioevs[3].uiv | ((uint64_t) ev->ioevs[4].uiv << 32);
+	bool waiting = false;
+
+	for (size_t i = 0; i < COUNT_OF(surf->present); i++){
+		if (surf->present[i].state == PRESENT_COMMITTED){
+			surf->present[i].state = PRESENT_CONSUMED;
+			surf->present[i].consumed_us = last;
+		}
+		waiting |= surf->present[i].state == PRESENT_CONSUMED;
+	}
+
+	if (waiting)
+		present_clock(surf, acon, true);
+}
+
+/* [flush_surface_events] vblank, present what was consumed before it */
+static void presentation_scanout(struct comp_surf* surf,
+	struct arcan_shmif_cont* acon, struct arcan_tgtevent* ev)
+{
+	uint64_t ts = (uint64_t) ev->ioevs[3].uiv | ((uint64_t) ev->ioevs[4].uiv << 32);
+	uint64_t refresh_ns = (uint64_t) ev->ioevs[5].uiv * 1000;
+	uint32_t flags = WP_PRESENTATION_FEEDBACK_KIND_VSYNC |
+		WP_PRESENTATION_FEEDBACK_KIND_HW_CLOCK |
+		WP_PRESENTATION_FEEDBACK_KIND_HW_COMPLETION;
+
+/* platform without flip timestamps, this is as close as we get */
+	if (!ts){
+		ts = arcan_timemicros();
+		flags = 0;
+	}
+
+	if (!refresh_ns && surf->client->output_state.rate > 0)
+		refresh_ns = 1000000000.0 / surf->client->output_state.rate;
+
+	uint64_t seq = ev->ioevs[2].uiv;
+	bool waiting = false;
+
+	for (size_t i = 0; i < COUNT_OF(surf->present); i++){
+		struct present_fb* fb = &surf->present[i];
+		if (fb->state != PRESENT_CONSUMED)
+			continue;
+
+		if (flags && fb->consumed_us >= ts){
+			waiting = true;
+			continue;
+		}
+
+		if (surf->states.hidden){
+			present_discard(fb);
+			continue;
+		}
+
+		if (surf->client->output)
+			wp_presentation_feedback_send_sync_output(fb->res, surf->client->output);
+
+		uint64_t sec = ts / 1000000;
+		wp_presentation_feedback_send_presented(fb->res,
+			sec >> 32, sec & 0xffffffff, (ts % 1000000) * 1000,
+			refresh_ns, seq >> 32, seq & 0xffffffff, flags);
+
+		struct wl_resource* res = fb->res;
+		*fb = (struct present_fb){};
+		wl_resource_destroy(res);
+	}
+
+	trace(TRACE_SURF, "%s scanout(%"PRIu64", waiting: %d)", surf->tracetag, ts, waiting);
+	if (!waiting)
+		present_clock(surf, acon, false);
+}
+
+/* [destroy_comp_surf] nothing more will be presented */
+static void presentation_drop(struct comp_surf* surf)
+{
+	for (size_t i = 0; i < COUNT_OF(surf->present); i++){
+		if (surf->present[i].state != PRESENT_FREE)
+			present_discard(&surf->present[i]);
+	}
+	surf->present_clock = false;
+}
+
+static void presentation_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static void presentation_feedback(struct wl_client* cl,
+	struct wl_resource* res, struct wl_resource* surface, uint32_t id)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(surface);
+	trace(TRACE_SURF, "%s feedback(%"PRIu32")", surf->tracetag, id);
+
+	struct wl_resource* fbres =
+		wl_resource_create(cl, &wp_presentation_feedback_interface, 1, id);
+	if (!fbres){
+		wl_resource_post_no_memory(res);
+		return;
+	}
+
+	for (size_t i = 0; i < COUNT_OF(surf->present); i++){
+		if (surf->present[i].state == PRESENT_FREE){
+			surf->present[i] = (struct present_fb){
+				.res = fbres,
+				.state = PRESENT_PENDING
+			};
+			wl_resource_set_implementation(fbres, NULL, surf, present_fb_free);
+			return;
+		}
+	}
+
+/* more outstanding feedback than frames in flight, nothing to track it with */
+	trace(TRACE_ALERT, "%s feedback overflow", surf->tracetag);
+	wl_resource_set_implementation(fbres, NULL, NULL, NULL);
+	wp_presentation_feedback_send_discarded(fbres);
+	wl_resource_destroy(fbres);
+}
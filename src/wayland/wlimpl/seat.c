@@ -28,11 +28,11 @@ static void pointer_set(struct wl_client* cl, struct wl_resource* res,
 		struct comp_surf* csurf = wl_resource_get_user_data(surf_res);
 		snprintf(csurf->tracetag, SURF_TAGLEN, "cursor");
 		csurf->rcon = &bcl->acursor;
-		wl.groups[tag->group].slots[tag->slot].surface = csurf;
+		tg->groups[tag->group].slots[tag->slot].surface = csurf;
 	}
 /* set a 0-alpha buffer? */
 	else {
-		wl.groups[tag->group].slots[tag->slot].surface = NULL;
+		tg->groups[tag->group].slots[tag->slot].surface = NULL;
 	}
 }
 
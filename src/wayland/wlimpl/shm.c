@@ -0,0 +1,289 @@
+/*
+ * Our own wl_shm, only used with -shm-pass. The implementation in
+ * libwayland-server hides the pool descriptor and that is what we want to
+ * hand over so that arcan can upload straight from the client buffer rather
+ * than us repacking it into the segment first.
+ *
+ * The interface tables are kept here rather than in boilerplate.c as pool
+ * and buffer creation refer to each other.
+ */
+#include <fcntl.h>
+#include <signal.h>
+
+#if defined(__linux__) && !defined(F_GET_SEALS)
+#define F_GET_SEALS 1034
+#define F_SEAL_SHRINK 0x0002
+#endif
+
+struct shm_pool {
+	struct wl_resource* res;
+	int fd;
+	uint8_t* map;
+	size_t sz;
+	size_t refs;
+
+/* only sealed pools are passed on, the others could be truncated under the
+ * reader which would fault in the server */
+	bool sealed;
+};
+
+struct shm_buffer {
+	struct wl_resource* res;
+	struct shm_pool* pool;
+	int32_t offset, width, height, stride;
+	uint32_t format;
+};
+
+/*
+ * Same approach as libwayland for unsealed pools: a client can truncate the
+ * file, and reading from it then raises SIGBUS. While we access a pool, a
+ * fault within it is patched over with anonymous memory and the client gets
+ * an error once we are done. The fault is delivered to the thread that made
+ * the access, so the state is per thread group.
+ */
+static _Thread_local struct {
+	uint8_t* base;
+	size_t sz;
+	bool fault;
+	bool installed;
+} shm_access;
+
+static void shm_sigbus(int sig, siginfo_t* info, void* tag)
+{
+	uint8_t* addr = info->si_addr;
+	if (!shm_access.base ||
+		addr < shm_access.base || addr >= shm_access.base + shm_access.sz){
+		signal(SIGBUS, SIG_DFL);
+		raise(SIGBUS);
+		return;
+	}
+
+	shm_access.fault = true;
+	if (MAP_FAILED == mmap(shm_access.base, shm_access.sz, PROT_READ,
+		MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0)){
+		signal(SIGBUS, SIG_DFL);
+		raise(SIGBUS);
+	}
+}
+
+static void shm_begin_access(struct shm_buffer* buf)
+{
+	if (buf->pool->sealed)
+		return;
+
+	if (!shm_access.installed){
+		struct sigaction sa = {
+			.sa_sigaction = shm_sigbus,
+			.sa_flags = SA_SIGINFO | SA_NODEFER
+		};
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGBUS, &sa, NULL);
+		shm_access.installed = true;
+	}
+
+	shm_access.base = buf->pool->map;
+	shm_access.sz = buf->pool->sz;
+	shm_access.fault = false;
+}
+
+static void shm_end_access(struct shm_buffer* buf)
+{
+	if (buf->pool->sealed)
+		return;
+
+	shm_access.base = NULL;
+	shm_access.sz = 0;
+
+	if (shm_access.fault){
+		trace(TRACE_SURF, "shm:fault on pool access");
+		wl_resource_post_error(buf->res,
+			WL_SHM_ERROR_INVALID_FD, "error accessing SHM buffer");
+		shm_access.fault = false;
+	}
+}
+
+static void shm_pool_unref(struct shm_pool* pool)
+{
+	if (--pool->refs)
+		return;
+
+	trace(TRACE_ALLOC, "shm:destroy pool(%zu b)", pool->sz);
+	munmap(pool->map, pool->sz);
+	close(pool->fd);
+	free(pool);
+}
+
+static void shm_buffer_free(struct wl_resource* res)
+{
+	struct shm_buffer* buf = wl_resource_get_user_data(res);
+	if (!buf)
+		return;
+
+	shm_pool_unref(buf->pool);
+	free(buf);
+}
+
+static void shm_buffer_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static const struct wl_buffer_interface shm_buffer_if = {
+	.destroy = shm_buffer_destroy
+};
+
+static struct shm_buffer* shm_buffer_get(struct wl_resource* res)
+{
+	if (!res ||
+		!wl_resource_instance_of(res, &wl_buffer_interface, &shm_buffer_if))
+		return NULL;
+
+	return wl_resource_get_user_data(res);
+}
+
+static void shm_pool_create_buffer(struct wl_client* cl,
+	struct wl_resource* res, uint32_t id, int32_t offset,
+	int32_t width, int32_t height, int32_t stride, uint32_t format)
+{
+	struct shm_pool* pool = wl_resource_get_user_data(res);
+	trace(TRACE_ALLOC, "shm:create buffer(%"PRId32"+%"PRId32"*%"PRId32
+		", stride: %"PRId32", fmt: %"PRIu32")", offset, width, height, stride, format);
+
+	if (format != WL_SHM_FORMAT_ARGB8888 && format != WL_SHM_FORMAT_XRGB8888){
+		wl_resource_post_error(res,
+			WL_SHM_ERROR_INVALID_FORMAT, "invalid format 0x%"PRIx32, format);
+		return;
+	}
+
+	if (offset < 0 || width <= 0 || height <= 0 ||
+		stride / 4 < width ||
+		(int64_t) offset + (int64_t) stride * height > (int64_t) pool->sz){
+		wl_resource_post_error(res,
+			WL_SHM_ERROR_INVALID_STRIDE, "invalid width, height or stride");
+		return;
+	}
+
+	struct shm_buffer* buf = malloc(sizeof(struct shm_buffer));
+	if (!buf){
+		wl_resource_post_no_memory(res);
+		return;
+	}
+
+	*buf = (struct shm_buffer){
+		.pool = pool,
+		.offset = offset,
+		.width = width,
+		.height = height,
+		.stride = stride,
+		.format = format
+	};
+
+	buf->res = wl_resource_create(cl, &wl_buffer_interface, 1, id);
+	if (!buf->res){
+		free(buf);
+		wl_resource_post_no_memory(res);
+		return;
+	}
+
+	pool->refs++;
+	wl_resource_set_implementation(buf->res, &shm_buffer_if, buf, shm_buffer_free);
+}
+
+static void shm_pool_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static void shm_pool_free(struct wl_resource* res)
+{
+	struct shm_pool* pool = wl_resource_get_user_data(res);
+	if (pool)
+		shm_pool_unref(pool);
+}
+
+static void shm_pool_resize(
+	struct wl_client* cl, struct wl_resource* res, int32_t size)
+{
+	struct shm_pool* pool = wl_resource_get_user_data(res);
+	trace(TRACE_ALLOC, "shm:resize pool(%zu -> %"PRId32")", pool->sz, size);
+
+	if (size < (int64_t) pool->sz){
+		wl_resource_post_error(res,
+			WL_SHM_ERROR_INVALID_FD, "shrinking pool invalid");
+		return;
+	}
+
+/* buffers reference the pool by offset so the mapping is free to move */
+	void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, pool->fd, 0);
+	if (MAP_FAILED == map){
+		wl_resource_post_error(res,
+			WL_SHM_ERROR_INVALID_FD, "failed mmap");
+		return;
+	}
+
+	munmap(pool->map, pool->sz);
+	pool->map = map;
+	pool->sz = size;
+}
+
+static const struct wl_shm_pool_interface shm_pool_if = {
+	.create_buffer = shm_pool_create_buffer,
+	.destroy = shm_pool_destroy,
+	.resize = shm_pool_resize
+};
+
+static void shm_create_pool(struct wl_client* cl,
+	struct wl_resource* res, uint32_t id, int32_t fd, int32_t size)
+{
+	trace(TRACE_ALLOC, "shm:create pool(%"PRId32" b)", size);
+
+	if (size <= 0){
+		wl_resource_post_error(res,
+			WL_SHM_ERROR_INVALID_STRIDE, "invalid size (%"PRId32")", size);
+		close(fd);
+		return;
+	}
+
+	struct shm_pool* pool = malloc(sizeof(struct shm_pool));
+	if (!pool){
+		wl_resource_post_no_memory(res);
+		close(fd);
+		return;
+	}
+
+	*pool = (struct shm_pool){
+		.fd = fd,
+		.sz = size,
+		.refs = 1
+	};
+
+	pool->map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == pool->map){
+		wl_resource_post_error(res,
+			WL_SHM_ERROR_INVALID_FD, "failed mmap fd %"PRId32, fd);
+		close(fd);
+		free(pool);
+		return;
+	}
+
+#ifdef F_GET_SEALS
+	int seals = fcntl(fd, F_GET_SEALS);
+	pool->sealed = seals != -1 && (seals & F_SEAL_SHRINK);
+#endif
+
+	pool->res = wl_resource_create(cl,
+		&wl_shm_pool_interface, wl_resource_get_version(res), id);
+	if (!pool->res){
+		munmap(pool->map, pool->sz);
+		close(fd);
+		free(pool);
+		wl_resource_post_no_memory(res);
+		return;
+	}
+
+	wl_resource_set_implementation(pool->res, &shm_pool_if, pool, shm_pool_free);
+}
+
+static const struct wl_shm_interface shm_if = {
+	.create_pool = shm_create_pool
+};
@@ -33,6 +33,55 @@ static void buffer_destroy(struct wl_listener* list, void* data)
 	}
 }
 
+static void shm_held_destroy(struct wl_listener* list, void* data)
+{
+	struct comp_surf* surf = NULL;
+	surf = wl_container_of(list, surf, l_shmrel);
+	if (!surf)
+		return;
+
+	trace(TRACE_SURF, "(event) destroy:held-buffer(%"PRIxPTR")", (uintptr_t) data);
+	surf->shm_held = NULL;
+
+	if (surf->l_shmrel_a){
+		surf->l_shmrel_a = false;
+		wl_list_remove(&surf->l_shmrel.link);
+	}
+}
+
+/*
+ * With -shm-pass the server reads from the client buffer, release is
+ * deferred until it says it is done (BUFFER_RELEASE in shmifevmap.c), or
+ * when the next buffer gets passed as the previous frame has been consumed
+ * by then.
+ */
+static void shm_release_held(struct comp_surf* surf)
+{
+	if (!surf->shm_held)
+		return;
+
+	if (surf->l_shmrel_a){
+		surf->l_shmrel_a = false;
+		wl_list_remove(&surf->l_shmrel.link);
+	}
+
+	wl_buffer_send_release(surf->shm_held);
+	surf->shm_held = NULL;
+}
+
+static void shm_hold(struct comp_surf* surf, struct wl_resource* buf)
+{
+	surf->shm_pending++;
+	if (surf->shm_held == buf)
+		return;
+
+	shm_release_held(surf);
+	surf->shm_held = buf;
+	surf->l_shmrel_a = true;
+	surf->l_shmrel.notify = shm_held_destroy;
+	wl_resource_add_destroy_listener(buf, &surf->l_shmrel);
+}
+
 /*
  * Buffer now belongs to surface, but it is useless until there's a commit
  */
@@ -96,6 +145,7 @@ static void surf_attach(struct wl_client* cl,
 			memset(&surf->acon.vidb[y * surf->acon.stride], '\0', surf->acon.stride);
 		arcan_shmif_dirty(&surf->acon, 0, 0, surf->acon.w, surf->acon.h, 0);
 		arcan_shmif_signal(&surf->acon, SHMIF_SIGVID | SHMIF_SIGBLK_NONE);
+		surf->shm_vidp[0] = surf->shm_vidp[1] = NULL;
 	}
 
 /* buf XOR cookie == cbuf in commit */
@@ -103,37 +153,116 @@ static void surf_attach(struct wl_client* cl,
 	surf->buf = (void*) ((uintptr_t) buf ^ ((uintptr_t) 0xfeedface));
 }
 
+static struct arcan_shmif_region damage_union(
+	struct arcan_shmif_region a, struct arcan_shmif_region b)
+{
+	return (struct arcan_shmif_region){
+		.x1 = a.x1 < b.x1 ? a.x1 : b.x1,
+		.y1 = a.y1 < b.y1 ? a.y1 : b.y1,
+		.x2 = a.x2 > b.x2 ? a.x2 : b.x2,
+		.y2 = a.y2 > b.y2 ? a.y2 : b.y2
+	};
+}
+
+/*
+ * Add to a set of regions, anything that overlaps or touches is merged so
+ * that the same pixels aren't copied twice, when out of slots the last one
+ * absorbs the rest.
+ */
+static void damage_region_add(struct arcan_shmif_region* set,
+	size_t* n, struct arcan_shmif_region r)
+{
+	for (size_t i = 0; i < *n;){
+		struct arcan_shmif_region c = set[i];
+		if (r.x1 <= c.x2 && r.x2 >= c.x1 && r.y1 <= c.y2 && r.y2 >= c.y1){
+			r = damage_union(r, c);
+			set[i] = set[--(*n)];
+			i = 0;
+			continue;
+		}
+		i++;
+	}
+
+	if (*n == ARCAN_SHMIF_DIRTY_LIM)
+		r = damage_union(r, set[--(*n)]);
+
+	set[(*n)++] = r;
+}
+
+static void damage_add(struct comp_surf* surf,
+	int64_t x1, int64_t y1, int64_t x2, int64_t y2)
+{
+	x1 = x1 < 0 ? 0 : (x1 > UINT16_MAX ? UINT16_MAX : x1);
+	y1 = y1 < 0 ? 0 : (y1 > UINT16_MAX ? UINT16_MAX : y1);
+	x2 = x2 < 0 ? 0 : (x2 > UINT16_MAX ? UINT16_MAX : x2);
+	y2 = y2 < 0 ? 0 : (y2 > UINT16_MAX ? UINT16_MAX : y2);
+
+	if (x2 <= x1 || y2 <= y1)
+		return;
+
+	damage_region_add(surf->damage, &surf->damage_n, (struct arcan_shmif_region){
+		.x1 = x1, .y1 = y1, .x2 = x2, .y2 = y2
+	});
+}
+
 /*
  * Similar to the X damage stuff, just grow the synch region for shm repacking
  * but there's more to this (of course there is) as there's the whole buffer
- * isn't necessarily 1:1 of surface.
+ * isn't necessarily 1:1 of surface. Clients also like to send INT32_MAX
+ * (e.g. 'everything') so do the math wide and clamp.
  */
 static void surf_damage(struct wl_client* cl,
 	struct wl_resource* res, int32_t x, int32_t y, int32_t w, int32_t h)
 {
 	struct comp_surf* surf = wl_resource_get_user_data(res);
 
-	x *= surf->scale;
-	y *= surf->scale;
-	w *= surf->scale;
-	h *= surf->scale;
-
-	if (x < 0)
-		x = 0;
+	trace(TRACE_SURF,"%s:(%"PRIxPTR") @x,y+w,h(%d+%d, %d+%d)",
+		surf->tracetag, (uintptr_t)res, (int)x, (int)w, (int)y, (int)h);
 
-	if (y < 0)
-		y = 0;
+	if (w < 0 || h < 0){
+		damage_add(surf, 0, 0, UINT16_MAX, UINT16_MAX);
+		return;
+	}
 
-	if (w < 0)
-		w = surf->acon.w;
+/* scaled outwards, negative coordinates get clamped so truncation works,
+ * with a viewport source the buffer coordinates start at the crop */
+	double ox = surf->vport.crop.x1, oy = surf->vport.crop.y1;
+	double x2 = ((double) x + w) * surf->scale + ox;
+	double y2 = ((double) y + h) * surf->scale + oy;
+	damage_add(surf,
+		(int64_t)((double) x * surf->scale + ox),
+		(int64_t)((double) y * surf->scale + oy),
+		(int64_t) x2 + ((double)(int64_t) x2 < x2),
+		(int64_t) y2 + ((double)(int64_t) y2 < y2)
+	);
+}
 
-	if (h < 0)
-		h = surf->acon.h;
+static void surf_damage_buffer(struct wl_client* cl,
+	struct wl_resource* res, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(res);
 
-	trace(TRACE_SURF,"%s:(%"PRIxPTR") @x,y+w,h(%d+%d, %d+%d)",
+	trace(TRACE_SURF,"%s:(%"PRIxPTR") buffer @x,y+w,h(%d+%d, %d+%d)",
 		surf->tracetag, (uintptr_t)res, (int)x, (int)w, (int)y, (int)h);
 
-	arcan_shmif_dirty(&surf->acon, x, y, x+w, y+h, 0);
+	if (w < 0 || h < 0){
+		damage_add(surf, 0, 0, UINT16_MAX, UINT16_MAX);
+		return;
+	}
+
+	damage_add(surf, x, y, (int64_t) x + w, (int64_t) y + h);
+}
+
+/*
+ * For the buffer types where we don't copy, just forward the damage as is so
+ * that the server may still limit what it synchs.
+ */
+static void damage_forward(struct arcan_shmif_cont* acon, struct comp_surf* surf)
+{
+	for (size_t i = 0; i < surf->damage_n; i++){
+		struct arcan_shmif_region r = surf->damage[i];
+		arcan_shmif_dirty(acon, r.x1, r.y1, r.x2, r.y2, 0);
+	}
 }
 
 /*
@@ -355,7 +484,7 @@ static void synch_acon_alpha(struct arcan_shmif_cont* acon, bool has_alpha)
 static bool push_drm(struct wl_client* cl,
 	struct arcan_shmif_cont* acon, struct wl_resource* buf, struct comp_surf* surf)
 {
-	struct wl_drm_buffer* drm_buf = wayland_drm_buffer_get(wl.drm, buf);
+	struct wl_drm_buffer* drm_buf = wayland_drm_buffer_get(tg->drm, buf);
 	if (!drm_buf)
 		return false;
 
@@ -389,6 +518,17 @@ static bool push_dma(struct wl_client* cl,
 			arcan_shmifext_setup(acon, defs);
 		}
 
+#ifdef HAVE_SYNCOBJ
+/* the readback is synchronous, so wait for the client here and the buffer is
+ * free to reuse once it returns */
+		if (surf->sync_acquire > 0){
+			struct pollfd pfd = {.fd = surf->sync_acquire, .events = POLLIN};
+			poll(&pfd, 1, 1000);
+			close(surf->sync_acquire);
+			surf->sync_acquire = 0;
+		}
+#endif
+
 		int n_planes = 0;
 		struct shmifext_buffer_plane planes[4];
 		for (size_t i = 0; i < 4; i++){
@@ -409,19 +549,34 @@ static bool push_dma(struct wl_client* cl,
 					close(planes[i].fd);
 		}
 
+#ifdef HAVE_SYNCOBJ
+		syncobj_release(surf, -1, 0);
+#endif
 	return true;
 	}
 
-/* right now this only supports a single transfered buffer, the real support
- * is close by in another branch, but for the sake of bringup just block those
- * now */
+/* forward all planes as-is so multi-planar YUV (video decoders) stays in its
+ * native format, signal_planes takes ownership of the descriptors so dup */
+	size_t n_planes = 0;
+	struct shmifext_buffer_plane planes[COUNT_OF(dmabuf->planes)];
 	for (size_t i = 0; i < COUNT_OF(dmabuf->planes); i++){
-		if (i == 0){
-			arcan_shmif_signalhandle(acon, SHMIF_SIGVID | SHMIF_SIGBLK_NONE,
-				dmabuf->planes[i].fd, dmabuf->planes[i].gbm.stride, dmabuf->fmt);
-		}
+		if (dmabuf->planes[i].fd <= 0)
+			break;
+		planes[i] = dmabuf->planes[i];
+		planes[i].fd = arcan_shmif_dupfd(planes[i].fd, -1, false);
+		planes[i].fence = -1;
+		n_planes++;
 	}
 
+/* the server waits for the acquire fence on the GPU, it covers all planes */
+	if (n_planes && surf->sync_acquire > 0){
+		planes[0].fence = surf->sync_acquire;
+		surf->sync_acquire = 0;
+	}
+
+	if (n_planes)
+		arcan_shmifext_signal_planes(acon, SHMIF_SIGVID | SHMIF_SIGBLK_NONE, n_planes, planes);
+
 	synch_acon_alpha(acon, fmt_has_alpha(dmabuf->fmt, surf));
 
 	trace(TRACE_SURF, "surf_commit(dmabuf:%s)", surf->tracetag);
@@ -436,22 +591,52 @@ static bool push_dma(struct wl_client* cl,
 static bool push_shm(struct wl_client* cl,
 	struct arcan_shmif_cont* acon, struct wl_resource* buf, struct comp_surf* surf)
 {
+/* with -shm-pass the buffers come from wlimpl/shm.c instead */
 	struct wl_shm_buffer* shm_buf = wl_shm_buffer_get(buf);
-	if (!shm_buf)
+	struct shm_buffer* pass_buf = shm_buf ? NULL : shm_buffer_get(buf);
+	if (!shm_buf && !pass_buf)
 		return false;
 
 	trace(TRACE_SURF, "surf_commit(shm:%s)", surf->tracetag);
 
-	uint32_t w = wl_shm_buffer_get_width(shm_buf);
-	uint32_t h = wl_shm_buffer_get_height(shm_buf);
-	int fmt = wl_shm_buffer_get_format(shm_buf);
-	void* data = wl_shm_buffer_get_data(shm_buf);
-	int stride = wl_shm_buffer_get_stride(shm_buf);
+	uint32_t w, h;
+	int fmt, stride;
+	void* data;
+
+	if (shm_buf){
+		w = wl_shm_buffer_get_width(shm_buf);
+		h = wl_shm_buffer_get_height(shm_buf);
+		fmt = wl_shm_buffer_get_format(shm_buf);
+		data = wl_shm_buffer_get_data(shm_buf);
+		stride = wl_shm_buffer_get_stride(shm_buf);
+	}
+	else {
+		w = pass_buf->width;
+		h = pass_buf->height;
+		fmt = pass_buf->format;
+		data = &pass_buf->pool->map[pass_buf->offset];
+		stride = pass_buf->stride;
+	}
+
+/* with a viewport source only the crop is sent, a different crop means that
+ * what the segment buffers hold can't be reused for a partial copy */
+	struct arcan_shmif_region crop;
+	if (!viewport_crop(surf, w, h, &crop))
+		return true;
+
+	if (memcmp(&crop, &surf->vport.crop, sizeof(crop)) != 0){
+		surf->vport.crop = crop;
+		surf->shm_vidp[0] = surf->shm_vidp[1] = NULL;
+	}
+	data = &((uint8_t*) data)[crop.y1 * stride + crop.x1 * sizeof(shmif_pixel)];
+	w = crop.x2 - crop.x1;
+	h = crop.y2 - crop.y1;
 
 	if (acon->w != w || acon->h != h){
 		trace(TRACE_SURF,
 			"surf_commit(shm, resize to: %zu, %zu)", (size_t)w, (size_t)h);
 		arcan_shmif_resize(acon, w, h);
+		surf->shm_vidp[0] = surf->shm_vidp[1] = NULL;
 	}
 
 /* resize failed, this will only happen when growing, thus we can crop */
@@ -463,9 +648,47 @@ static bool push_shm(struct wl_client* cl,
 /* alpha state changed? only changing this flag does not require a resynch
  * as the hint is checked on each frame */
 	synch_acon_alpha(acon, fmt_has_alpha(fmt, surf));
-	wl_shm_buffer_begin_access(shm_buf);
-	if (shm_to_gl(acon, surf, w, h, fmt, data, stride))
+
+/* sealed pools can be handed over as is, the server maps the descriptor and
+ * uploads from it, which saves the repack below. The buffer is held until the
+ * server releases it. Unsealed pools or a server that refuses handles (after
+ * BUFFER_FAIL) takes the copy path. */
+	if (pass_buf && pass_buf->pool->sealed && acon == &surf->acon &&
+		w == pass_buf->width && h == pass_buf->height &&
+		arcan_shmif_handle_permitted(acon)){
+		size_t n_dirty = 0;
+		for (size_t i = 0; i < surf->damage_n; i++){
+			struct arcan_shmif_region r = surf->damage[i];
+			r.x2 = r.x2 > w ? w : r.x2;
+			r.y2 = r.y2 > h ? h : r.y2;
+			if (r.x2 <= r.x1 || r.y2 <= r.y1)
+				continue;
+			arcan_shmif_dirty(acon, r.x1, r.y1, r.x2, r.y2, 0);
+			n_dirty++;
+		}
+		if (!n_dirty)
+			arcan_shmif_dirty(acon, 0, 0, w, h, 0);
+
+		uint32_t fourcc = fmt == WL_SHM_FORMAT_ARGB8888 ? 0x34325241 : 0x34325258;
+		if (arcan_shmif_signal_shm(acon, SHMIF_SIGVID | SHMIF_SIGBLK_NONE,
+			pass_buf->pool->fd, pass_buf->offset, stride, fourcc)){
+			trace(TRACE_SURF, "surf_commit(shm, pass)");
+			surf->shm_vidp[0] = surf->shm_vidp[1] = NULL;
+			shm_hold(surf, buf);
+			return true;
+		}
+		trace(TRACE_SURF, "surf_commit(shm, pass failed)");
+	}
+
+	if (shm_buf)
+		wl_shm_buffer_begin_access(shm_buf);
+	else
+		shm_begin_access(pass_buf);
+
+	if (shm_to_gl(acon, surf, w, h, fmt, data, stride)){
+		surf->shm_vidp[0] = surf->shm_vidp[1] = NULL;
 		goto out;
+	}
 
 /* two other options to avoid repacking, one is to actually use this signal-
  * handle facility to send a descriptor, and mark the type as the WL shared
@@ -476,23 +699,85 @@ static bool push_shm(struct wl_client* cl,
  * The other is to actually allow the shmif server to ptrace into us (wut)
  * and use a rare linuxism known as process_vm_writev and process_vm_readv
  * and send the pointers that way. One might call that one exotic.
+ *
+ * What we can do is to only repack what the client said has changed. If vidp
+ * is the buffer we wrote last time it still has the previous frame, if it is
+ * the one before that (double buffered) it also lacks the previous damage,
+ * anything else (new mapping, gl path in between) needs the full copy.
  */
-	if (stride != acon->stride){
-		trace(TRACE_SURF,"surf_commit(stride-mismatch)");
-		for (size_t row = 0; row < h; row++){
-			memcpy(&acon->vidp[row * acon->pitch],
-				&((uint8_t*)data)[row * stride],
-				w * sizeof(shmif_pixel)
-			);
+	struct arcan_shmif_region copy[ARCAN_SHMIF_DIRTY_LIM];
+	size_t n_copy = 0;
+	bool full = true;
+
+	if (acon->vidp && (
+		acon->vidp == surf->shm_vidp[0] || acon->vidp == surf->shm_vidp[1])){
+		full = false;
+		for (size_t i = 0; i < surf->damage_n; i++)
+			damage_region_add(copy, &n_copy, surf->damage[i]);
+
+		if (acon->vidp != surf->shm_vidp[0])
+			for (size_t i = 0; i < surf->shm_prev_n; i++)
+				damage_region_add(copy, &n_copy, surf->shm_prev[i]);
+	}
+
+	if (full){
+		trace(TRACE_SURF, "surf_commit(shm, full)");
+		if (stride != acon->stride){
+			trace(TRACE_SURF,"surf_commit(stride-mismatch)");
+			for (size_t row = 0; row < h; row++){
+				memcpy(&acon->vidp[row * acon->pitch],
+					&((uint8_t*)data)[row * stride],
+					w * sizeof(shmif_pixel)
+				);
+			}
 		}
+		else
+			memcpy(acon->vidp, data, w * h * sizeof(shmif_pixel));
+
+		arcan_shmif_dirty(acon, 0, 0, w, h, 0);
+		surf->shm_prev[0] = (struct arcan_shmif_region){.x2 = w, .y2 = h};
+		surf->shm_prev_n = 1;
 	}
-	else
-		memcpy(acon->vidp, data, w * h * sizeof(shmif_pixel));
+	else {
+		for (size_t i = 0; i < n_copy; i++){
+			size_t x1 = copy[i].x1, y1 = copy[i].y1;
+			size_t x2 = copy[i].x2 > w ? w : copy[i].x2;
+			size_t y2 = copy[i].y2 > h ? h : copy[i].y2;
+			if (x2 <= x1 || y2 <= y1)
+				continue;
+
+			for (size_t row = y1; row < y2; row++){
+				memcpy(&acon->vidp[row * acon->pitch + x1],
+					&((uint8_t*)data)[row * stride + x1 * sizeof(shmif_pixel)],
+					(x2 - x1) * sizeof(shmif_pixel)
+				);
+			}
+		}
 
+/* only the new damage differs from what the server has */
+		surf->shm_prev_n = 0;
+		for (size_t i = 0; i < surf->damage_n; i++){
+			struct arcan_shmif_region r = surf->damage[i];
+			r.x2 = r.x2 > w ? w : r.x2;
+			r.y2 = r.y2 > h ? h : r.y2;
+			if (r.x2 <= r.x1 || r.y2 <= r.y1)
+				continue;
+
+			arcan_shmif_dirty(acon, r.x1, r.y1, r.x2, r.y2, 0);
+			surf->shm_prev[surf->shm_prev_n++] = r;
+		}
+		trace(TRACE_SURF, "surf_commit(shm, %zu regions)", surf->shm_prev_n);
+	}
+
+	surf->shm_vidp[1] = surf->shm_vidp[0];
+	surf->shm_vidp[0] = acon->vidp;
 	arcan_shmif_signal(acon, SHMIF_SIGVID | SHMIF_SIGBLK_NONE);
 
 out:
-	wl_shm_buffer_end_access(shm_buf);
+	if (shm_buf)
+		wl_shm_buffer_end_access(shm_buf);
+	else
+		shm_end_access(pass_buf);
 	return true;
 }
 
@@ -523,8 +808,12 @@ static void surf_commit(struct wl_client* cl, struct wl_resource* res)
 		}
 	}
 
+	if (!viewport_commit(surf))
+		return;
+
 	if (!surf->cbuf){
 		trace(TRACE_SURF, "no buffer");
+		presentation_commit(surf, false);
 		if (surf->internal){
 			surf->internal(surf, CMD_RECONFIGURE);
 			surf->internal(surf, CMD_FLUSH_CALLBACKS);
@@ -546,6 +835,11 @@ static void surf_commit(struct wl_client* cl, struct wl_resource* res)
 		return;
 	}
 
+#ifdef HAVE_SYNCOBJ
+	if (!syncobj_commit(surf, buf))
+		return;
+#endif
+
 /*
  * special case, if the surface we should synch is the currently set
  * pointer resource, then draw that to the special segment.
@@ -591,17 +885,26 @@ static void surf_commit(struct wl_client* cl, struct wl_resource* res)
  * order shm -> drm -> dma-buf.
  */
 
-	if (
-		!push_shm(cl, acon, buf, surf) &&
-		!push_drm(cl, acon, buf, surf) &&
-		!push_dma(cl, acon, buf, surf)){
-		trace(TRACE_SURF, "surf_commit(unknown:%s)", surf->tracetag);
+	if (!push_shm(cl, acon, buf, surf)){
+		surf->shm_vidp[0] = surf->shm_vidp[1] = NULL;
+		surf->vport.crop = (struct arcan_shmif_region){};
+		damage_forward(acon, surf);
+
+		if (
+			!push_drm(cl, acon, buf, surf) &&
+			!push_dma(cl, acon, buf, surf)){
+			trace(TRACE_SURF, "surf_commit(unknown:%s)", surf->tracetag);
+		}
 	}
+	surf->damage_n = 0;
+	viewport_update_scale(surf, acon->w);
+	presentation_commit(surf, true);
 
 /* might be that this should be moved to the buffer types as well,
  * since we might need double-triple buffering, uncertain how mesa
  * actually handles this */
-	wl_buffer_send_release(buf);
+	if (buf != surf->shm_held)
+		wl_buffer_send_release(buf);
 
 	trace(TRACE_SURF,
 		"surf_commit(%zu,%zu-%zu,%zu)accel_fail=%d",
@@ -641,7 +944,10 @@ static void surf_scale(struct wl_client* cl,
 	if (!surf || !surf->acon.addr)
 		return;
 
-	surf->scale = scale > 0 ? scale : 1;
+	surf->buffer_scale = scale > 0 ? scale : 1;
+	if (surf->vport.dst[0] <= 0 && surf->vport.src[2] <= 0)
+		surf->scale = surf->buffer_scale;
+
 	struct arcan_event ev = {
 		.ext.kind = ARCAN_EVENT(MESSAGE)
 	};
@@ -0,0 +1,385 @@
+/*
+ * linux-drm-syncobj-v1, explicit synchronization for dma-buf clients.
+ *
+ * The acquire point of a commit is exported as a sync_file and attached to
+ * the planes (bstream.fence) so that arcan waits for the client rendering on
+ * the GPU rather than stalling on implicit fencing. The release points are
+ * kept per surface in submission order and signalled from the release fences
+ * that arcan sends back (TARGET_COMMAND_BUFFER_RELEASE).
+ *
+ * Timelines are refcounted as a pending point can outlive the client object.
+ * The device is the render node the bridge was told to use, the ioctls are
+ * safe to use from any thread group.
+ */
+#include <xf86drm.h>
+#include <time.h>
+
+struct syncobj_timeline {
+	struct wl_resource* res;
+	uint32_t handle;
+	size_t refs;
+};
+
+struct syncobj_surface {
+	struct wl_resource* res;
+	struct comp_surf* surf;
+	struct syncobj_point acquire, release;
+};
+
+static void syncobj_timeline_unref(struct syncobj_timeline* tl)
+{
+	if (!tl || --tl->refs)
+		return;
+
+	drmSyncobjDestroy(wl.syncobj_fd, tl->handle);
+	free(tl);
+}
+
+static void syncobj_point_set(
+	struct syncobj_point* dst, struct syncobj_timeline* tl, uint64_t pt)
+{
+	if (tl)
+		tl->refs++;
+	syncobj_timeline_unref(dst->tl);
+	dst->tl = tl;
+	dst->pt = pt;
+}
+
+/*
+ * signal [pt] when [fence] does, or right away if there is no fence (or it
+ * couldn't be imported) - better with a glitch than a client stuck forever
+ */
+static void syncobj_signal(struct syncobj_point* pt, int fence)
+{
+	if (!pt->tl)
+		return;
+
+	int fd = wl.syncobj_fd;
+	uint32_t tmp;
+	bool done = false;
+
+	if (-1 != fence && 0 == drmSyncobjCreate(fd, 0, &tmp)){
+		done =
+			0 == drmSyncobjImportSyncFile(fd, tmp, fence) &&
+			0 == drmSyncobjTransfer(fd, pt->tl->handle, pt->pt, tmp, 0, 0);
+		drmSyncobjDestroy(fd, tmp);
+	}
+
+	if (!done)
+		drmSyncobjTimelineSignal(fd, &pt->tl->handle, &pt->pt, 1);
+
+	syncobj_point_set(pt, NULL, 0);
+}
+
+/*
+ * A point only has a fence once the client has submitted the work, normally
+ * done before the commit. Wait (bounded) for the submission, never for the
+ * completion - that is left to arcan. If it still isn't there, fall back to
+ * waiting on the CPU so the buffer is at least complete.
+ */
+static int syncobj_acquire_fence(struct syncobj_point* pt)
+{
+	int fd = wl.syncobj_fd;
+	uint32_t handle = pt->tl->handle;
+	uint64_t point = pt->pt;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t deadline = (int64_t) now.tv_sec * 1000000000ll + now.tv_nsec;
+
+	if (0 != drmSyncobjTimelineWait(fd, &handle, &point, 1,
+		deadline + 100000000ll, DRM_SYNCOBJ_WAIT_FLAGS_WAIT_AVAILABLE, NULL)){
+		trace(TRACE_DRM, "syncobj:acquire point not submitted, cpu wait");
+		drmSyncobjTimelineWait(fd, &handle, &point, 1,
+			deadline + 1000000000ll, DRM_SYNCOBJ_WAIT_FLAGS_WAIT_FOR_SUBMIT, NULL);
+		return -1;
+	}
+
+	uint32_t tmp;
+	int sync_fd = -1;
+	if (0 != drmSyncobjCreate(fd, 0, &tmp))
+		return -1;
+
+	if (0 == drmSyncobjTransfer(fd, tmp, 0, handle, point, 0))
+		drmSyncobjExportSyncFile(fd, tmp, &sync_fd);
+
+	drmSyncobjDestroy(fd, tmp);
+	return sync_fd;
+}
+
+/*
+ * [flush_surface_events] a release fence covers everything submitted before
+ * the [held] most recent buffers, without handle passing the buffer has been
+ * consumed once it has been replaced.
+ */
+static void syncobj_release(struct comp_surf* surf, int fence, size_t held)
+{
+	if (surf->sync_release_n <= held)
+		return;
+
+	size_t n = surf->sync_release_n - held;
+	for (size_t i = 0; i < n; i++)
+		syncobj_signal(&surf->sync_release[i], fence);
+
+	memmove(surf->sync_release, &surf->sync_release[n],
+		held * sizeof(struct syncobj_point));
+	for (size_t i = held; i < surf->sync_release_n; i++)
+		surf->sync_release[i] = (struct syncobj_point){};
+	surf->sync_release_n = held;
+}
+
+/*
+ * [surf_commit] apply the pending points, the acquire fence is stored in
+ * sync_acquire for push_dma and the release point queued for the server.
+ * Returns false if the commit is in violation of the protocol.
+ */
+static bool syncobj_commit(struct comp_surf* surf, struct wl_resource* buf)
+{
+	struct syncobj_surface* ss = surf->syncobj;
+	if (!ss || (!ss->acquire.tl && !ss->release.tl))
+		return true;
+
+	if (!buf){
+		wl_resource_post_error(ss->res,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_NO_BUFFER, "points without buffer");
+		return false;
+	}
+
+	if (!ss->acquire.tl){
+		wl_resource_post_error(ss->res,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_NO_ACQUIRE_POINT, "missing acquire");
+		return false;
+	}
+
+	if (!ss->release.tl){
+		wl_resource_post_error(ss->res,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_NO_RELEASE_POINT, "missing release");
+		return false;
+	}
+
+	if (ss->acquire.tl == ss->release.tl && ss->acquire.pt >= ss->release.pt){
+		wl_resource_post_error(ss->res,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_CONFLICTING_POINTS,
+			"release point must be after acquire point");
+		return false;
+	}
+
+	if (!dmabuf_buffer_get(buf)){
+		wl_resource_post_error(ss->res,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_UNSUPPORTED_BUFFER,
+			"only dma-buf buffers are supported");
+		return false;
+	}
+
+	if (surf->sync_acquire > 0)
+		close(surf->sync_acquire);
+	int fence = syncobj_acquire_fence(&ss->acquire);
+	surf->sync_acquire = fence > 0 ? fence : 0;
+	syncobj_point_set(&ss->acquire, NULL, 0);
+
+/* out of room, release the oldest early rather than block */
+	if (surf->sync_release_n == COUNT_OF(surf->sync_release))
+		syncobj_release(surf, -1, surf->sync_release_n - 1);
+
+	struct syncobj_point* dst = &surf->sync_release[surf->sync_release_n++];
+	*dst = ss->release;
+	ss->release = (struct syncobj_point){};
+
+	trace(TRACE_DRM, "syncobj:commit(acquire: %d, pending: %zu)",
+		surf->sync_acquire, surf->sync_release_n);
+	return true;
+}
+
+/* [destroy_comp_surf] nothing more will be read from these buffers */
+static void syncobj_surface_drop(struct comp_surf* surf)
+{
+	syncobj_release(surf, -1, 0);
+	if (surf->sync_acquire > 0){
+		close(surf->sync_acquire);
+		surf->sync_acquire = 0;
+	}
+
+	if (surf->syncobj){
+		surf->syncobj->surf = NULL;
+		surf->syncobj = NULL;
+	}
+}
+
+static void syncobj_timeline_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static void syncobj_timeline_free(struct wl_resource* res)
+{
+	struct syncobj_timeline* tl = wl_resource_get_user_data(res);
+	if (!tl)
+		return;
+
+	tl->res = NULL;
+	syncobj_timeline_unref(tl);
+}
+
+static const struct wp_linux_drm_syncobj_timeline_v1_interface syncobj_timeline_if = {
+	.destroy = syncobj_timeline_destroy
+};
+
+static void syncobj_surface_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static void syncobj_surface_free(struct wl_resource* res)
+{
+	struct syncobj_surface* ss = wl_resource_get_user_data(res);
+	if (!ss)
+		return;
+
+	if (ss->surf)
+		ss->surf->syncobj = NULL;
+
+	syncobj_point_set(&ss->acquire, NULL, 0);
+	syncobj_point_set(&ss->release, NULL, 0);
+	free(ss);
+}
+
+static bool syncobj_point_arg(struct wl_resource* res,
+	struct wl_resource* timeline, uint32_t hi, uint32_t lo,
+	struct syncobj_point* dst)
+{
+	struct syncobj_surface* ss = wl_resource_get_user_data(res);
+	if (!ss->surf){
+		wl_resource_post_error(res,
+			WP_LINUX_DRM_SYNCOBJ_SURFACE_V1_ERROR_NO_SURFACE, "surface destroyed");
+		return false;
+	}
+
+	syncobj_point_set(dst,
+		wl_resource_get_user_data(timeline), ((uint64_t) hi << 32) | lo);
+	return true;
+}
+
+static void syncobj_surface_acquire(struct wl_client* cl,
+	struct wl_resource* res, struct wl_resource* timeline, uint32_t hi, uint32_t lo)
+{
+	struct syncobj_surface* ss = wl_resource_get_user_data(res);
+	syncobj_point_arg(res, timeline, hi, lo, &ss->acquire);
+}
+
+static void syncobj_surface_release(struct wl_client* cl,
+	struct wl_resource* res, struct wl_resource* timeline, uint32_t hi, uint32_t lo)
+{
+	struct syncobj_surface* ss = wl_resource_get_user_data(res);
+	syncobj_point_arg(res, timeline, hi, lo, &ss->release);
+}
+
+static const struct wp_linux_drm_syncobj_surface_v1_interface syncobj_surface_if = {
+	.destroy = syncobj_surface_destroy,
+	.set_acquire_point = syncobj_surface_acquire,
+	.set_release_point = syncobj_surface_release
+};
+
+static void syncobj_mgr_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static void syncobj_mgr_surface(struct wl_client* cl,
+	struct wl_resource* res, uint32_t id, struct wl_resource* surface)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(surface);
+	trace(TRACE_ALLOC, "syncobj:get_surface(%"PRIu32")", id);
+
+	if (surf->syncobj){
+		wl_resource_post_error(res,
+			WP_LINUX_DRM_SYNCOBJ_MANAGER_V1_ERROR_SURFACE_EXISTS, "surface exists");
+		return;
+	}
+
+	struct syncobj_surface* ss = malloc(sizeof(struct syncobj_surface));
+	if (!ss){
+		wl_resource_post_no_memory(res);
+		return;
+	}
+
+	*ss = (struct syncobj_surface){
+		.surf = surf
+	};
+
+	ss->res = wl_resource_create(cl,
+		&wp_linux_drm_syncobj_surface_v1_interface, wl_resource_get_version(res), id);
+	if (!ss->res){
+		free(ss);
+		wl_resource_post_no_memory(res);
+		return;
+	}
+
+	surf->syncobj = ss;
+	wl_resource_set_implementation(ss->res,
+		&syncobj_surface_if, ss, syncobj_surface_free);
+}
+
+static void syncobj_mgr_timeline(struct wl_client* cl,
+	struct wl_resource* res, uint32_t id, int32_t fd)
+{
+	trace(TRACE_ALLOC, "syncobj:import_timeline(%"PRIu32")", id);
+	struct syncobj_timeline* tl = malloc(sizeof(struct syncobj_timeline));
+	if (!tl){
+		close(fd);
+		wl_resource_post_no_memory(res);
+		return;
+	}
+
+	*tl = (struct syncobj_timeline){
+		.refs = 1
+	};
+
+	int rv = drmSyncobjFDToHandle(wl.syncobj_fd, fd, &tl->handle);
+	close(fd);
+
+	if (0 != rv){
+		free(tl);
+		wl_resource_post_error(res,
+			WP_LINUX_DRM_SYNCOBJ_MANAGER_V1_ERROR_INVALID_TIMELINE, "bad timeline");
+		return;
+	}
+
+	tl->res = wl_resource_create(cl,
+		&wp_linux_drm_syncobj_timeline_v1_interface, wl_resource_get_version(res), id);
+	if (!tl->res){
+		syncobj_timeline_unref(tl);
+		wl_resource_post_no_memory(res);
+		return;
+	}
+
+	wl_resource_set_implementation(tl->res,
+		&syncobj_timeline_if, tl, syncobj_timeline_free);
+}
+
+static const struct wp_linux_drm_syncobj_manager_v1_interface syncobj_mgr_if = {
+	.destroy = syncobj_mgr_destroy,
+	.get_surface = syncobj_mgr_surface,
+	.import_timeline = syncobj_mgr_timeline
+};
+
+/*
+ * the device needs timeline syncobjs, otherwise the global is not exposed
+ * and clients stay with implicit sync
+ */
+static int syncobj_open_device(const char* path)
+{
+	if (!path)
+		return -1;
+
+	int fd = open(path, O_RDWR | O_CLOEXEC);
+	if (-1 == fd)
+		return -1;
+
+	uint64_t cap = 0;
+	if (0 != drmGetCap(fd, DRM_CAP_SYNCOBJ_TIMELINE, &cap) || !cap){
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
@@ -0,0 +1,223 @@
+/*
+ * wp_viewporter, crop and scale of the surface contents. The destination
+ * decides the surface size in place of buffer size / buffer scale, which is
+ * how fractional scale clients present a buffer rendered at the size arcan
+ * will show it at. The source crop is applied when repacking shm buffers so
+ * only the visible part is copied to the segment, other buffer types are
+ * forwarded whole as there is no way to describe a crop of them in shmif.
+ *
+ * The interface tables are kept here as the manager and the viewport refer
+ * to each other.
+ */
+#include <math.h>
+
+static void viewport_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+/* the state is removed with the next commit, same as unsetting it */
+static void viewport_free(struct wl_resource* res)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(res);
+	if (!surf)
+		return;
+
+	for (size_t i = 0; i < 4; i++)
+		surf->vport.pending_src[i] = -1;
+	surf->vport.pending_dst[0] = surf->vport.pending_dst[1] = -1;
+	surf->vport.dirty = true;
+	surf->vport.res = NULL;
+}
+
+static void viewport_set_source(struct wl_client* cl, struct wl_resource* res,
+	wl_fixed_t x, wl_fixed_t y, wl_fixed_t w, wl_fixed_t h)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(res);
+	trace(TRACE_SURF, "viewport:source(%f, %f, %f, %f)",
+		wl_fixed_to_double(x), wl_fixed_to_double(y),
+		wl_fixed_to_double(w), wl_fixed_to_double(h));
+
+	if (!surf){
+		wl_resource_post_error(res,
+			WP_VIEWPORT_ERROR_NO_SURFACE, "surface destroyed");
+		return;
+	}
+
+	wl_fixed_t unset = wl_fixed_from_int(-1);
+	bool is_unset = x == unset && y == unset && w == unset && h == unset;
+
+	if (!is_unset && (x < 0 || y < 0 || w <= 0 || h <= 0)){
+		wl_resource_post_error(res,
+			WP_VIEWPORT_ERROR_BAD_VALUE, "invalid source rectangle");
+		return;
+	}
+
+	surf->vport.pending_src[0] = x;
+	surf->vport.pending_src[1] = y;
+	surf->vport.pending_src[2] = w;
+	surf->vport.pending_src[3] = h;
+	surf->vport.dirty = true;
+}
+
+static void viewport_set_destination(struct wl_client* cl,
+	struct wl_resource* res, int32_t w, int32_t h)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(res);
+	trace(TRACE_SURF, "viewport:destination(%"PRId32", %"PRId32")", w, h);
+
+	if (!surf){
+		wl_resource_post_error(res,
+			WP_VIEWPORT_ERROR_NO_SURFACE, "surface destroyed");
+		return;
+	}
+
+	if (!(w == -1 && h == -1) && (w <= 0 || h <= 0)){
+		wl_resource_post_error(res,
+			WP_VIEWPORT_ERROR_BAD_VALUE, "invalid destination size");
+		return;
+	}
+
+	surf->vport.pending_dst[0] = w;
+	surf->vport.pending_dst[1] = h;
+	surf->vport.dirty = true;
+}
+
+static const struct wp_viewport_interface viewport_if = {
+	.destroy = viewport_destroy,
+	.set_source = viewport_set_source,
+	.set_destination = viewport_set_destination
+};
+
+static void viewporter_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static void viewporter_get_viewport(struct wl_client* cl,
+	struct wl_resource* res, uint32_t id, struct wl_resource* surface)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(surface);
+	trace(TRACE_ALLOC, "viewporter:get_viewport(%"PRIu32")", id);
+
+	if (surf->vport.res){
+		wl_resource_post_error(res,
+			WP_VIEWPORTER_ERROR_VIEWPORT_EXISTS, "surface already has a viewport");
+		return;
+	}
+
+	struct wl_resource* vres = wl_resource_create(cl,
+		&wp_viewport_interface, wl_resource_get_version(res), id);
+	if (!vres){
+		wl_resource_post_no_memory(res);
+		return;
+	}
+
+	surf->vport.res = vres;
+	wl_resource_set_implementation(vres, &viewport_if, surf, viewport_free);
+}
+
+static const struct wp_viewporter_interface viewporter_if = {
+	.destroy = viewporter_destroy,
+	.get_viewport = viewporter_get_viewport
+};
+
+/* [surf_commit] latch the pending state, false if it was invalid and the
+ * client has been sent an error */
+static bool viewport_commit(struct comp_surf* surf)
+{
+	if (!surf->vport.dirty)
+		return true;
+
+	surf->vport.dirty = false;
+	memcpy(surf->vport.src, surf->vport.pending_src, sizeof(surf->vport.src));
+	memcpy(surf->vport.dst, surf->vport.pending_dst, sizeof(surf->vport.dst));
+
+/* without a destination the source size becomes the surface size */
+	if (surf->vport.res && surf->vport.dst[0] <= 0 && surf->vport.src[2] > 0 &&
+		(wl_fixed_to_int(surf->vport.src[2]) * 256 != surf->vport.src[2] ||
+		 wl_fixed_to_int(surf->vport.src[3]) * 256 != surf->vport.src[3])){
+		wl_resource_post_error(surf->vport.res,
+			WP_VIEWPORT_ERROR_BAD_SIZE, "source size is not integer");
+		return false;
+	}
+
+	return true;
+}
+
+/* [push_shm] the part of a w*h buffer to copy, false if the source extends
+ * outside of it and the client has been sent an error */
+static bool viewport_crop(struct comp_surf* surf,
+	size_t w, size_t h, struct arcan_shmif_region* out)
+{
+	*out = (struct arcan_shmif_region){.x2 = w, .y2 = h};
+	if (surf->vport.src[2] <= 0)
+		return true;
+
+	int32_t bs = surf->buffer_scale > 0 ? surf->buffer_scale : 1;
+	double x1 = wl_fixed_to_double(surf->vport.src[0]) * bs;
+	double y1 = wl_fixed_to_double(surf->vport.src[1]) * bs;
+	double x2 = x1 + wl_fixed_to_double(surf->vport.src[2]) * bs;
+	double y2 = y1 + wl_fixed_to_double(surf->vport.src[3]) * bs;
+
+	if (x2 > w || y2 > h){
+		if (surf->vport.res)
+			wl_resource_post_error(surf->vport.res,
+				WP_VIEWPORT_ERROR_OUT_OF_BUFFER, "source outside of buffer");
+		return false;
+	}
+
+/* sub-pixel sources are rounded outwards, the server scales anyhow */
+	*out = (struct arcan_shmif_region){
+		.x1 = x1, .y1 = y1,
+		.x2 = ceil(x2) > w ? w : ceil(x2),
+		.y2 = ceil(y2) > h ? h : ceil(y2)
+	};
+
+/* the damage is in buffer coordinates, move it to the crop */
+	size_t n = 0;
+	for (size_t i = 0; i < surf->damage_n; i++){
+		struct arcan_shmif_region r = surf->damage[i];
+		if (r.x2 <= out->x1 || r.y2 <= out->y1 || r.x1 >= out->x2 || r.y1 >= out->y2)
+			continue;
+
+		r.x1 = r.x1 > out->x1 ? r.x1 - out->x1 : 0;
+		r.y1 = r.y1 > out->y1 ? r.y1 - out->y1 : 0;
+		r.x2 = (r.x2 < out->x2 ? r.x2 : out->x2) - out->x1;
+		r.y2 = (r.y2 < out->y2 ? r.y2 : out->y2) - out->y1;
+		surf->damage[n++] = r;
+	}
+	surf->damage_n = n;
+
+	return true;
+}
+
+/* [surf_commit] with the [w] wide contents in place, work out how many
+ * buffer pixels there are to a surface unit for input and configure */
+static void viewport_update_scale(struct comp_surf* surf, size_t w)
+{
+	float scale = surf->buffer_scale > 0 ? surf->buffer_scale : 1;
+
+	if (surf->vport.dst[0] > 0 && w)
+		scale = (float) w / surf->vport.dst[0];
+
+	else if (surf->vport.src[2] > 0 && w)
+		scale = (float) w / wl_fixed_to_double(surf->vport.src[2]);
+
+/* a fractional scale client that hasn't set a destination yet */
+	else if (surf->vport.res && surf->fractional && surf->fractional_pref)
+		scale = surf->fractional_pref / 120.0;
+
+	if (scale != surf->scale)
+		trace(TRACE_SURF, "%s scale(%f -> %f)", surf->tracetag, surf->scale, scale);
+	surf->scale = scale;
+}
+
+/* [destroy_comp_surf] */
+static void viewport_drop(struct comp_surf* surf)
+{
+	if (surf->vport.res){
+		wl_resource_set_user_data(surf->vport.res, NULL);
+		surf->vport.res = NULL;
+	}
+}
@@ -50,6 +50,10 @@ struct xwl_window {
  * populated when there is still no surf to pair it to */
 	struct arcan_event viewport;
 
+/* configure changes are collected and sent with the frame they belong to,
+ * see wnd_viewport_flush */
+	bool viewport_dirty;
+
 /* a window mapping that is PAIRED means that we know both the local
  * compositor surface and the wmed X surface */
 	bool paired;
@@ -468,8 +472,8 @@ static int process_input(const char* msg)
 			trace(TRACE_XWL, "y reconfigured %d", wnd->viewport.ext.viewport.y);
 		}
 
-/* and either reflect now or later */
-		wnd_viewport(wnd);
+/* and either reflect with the next frame or at the end of the batch */
+		wnd->viewport_dirty = true;
 	}
 	else if (strcmp(arg, "destroy") == 0){
 		if (!arg_lookup(cmd, "id", 0, &arg)){
@@ -645,7 +649,7 @@ static int xwl_spawn_wm(bool block, char** argv)
 		return 0;
 
 	trace(TRACE_XWL, "spawning 'arcan-xwayland-wm'");
-	wl.groups[0].xwm->fd = -1;
+	tg->groups[0].xwm->fd = -1;
 	int p2c_pipe[2];
 	int c2p_pipe[2];
 	if (-1 == pipe(p2c_pipe))
@@ -660,7 +664,7 @@ static int xwl_spawn_wm(bool block, char** argv)
 	wmfd_input = c2p_pipe[0];
 	wmfd_output = fdopen(p2c_pipe[1], "w");
 	setlinebuf(wmfd_output);
-	wl.groups[0].xwm->fd = wmfd_input;
+	tg->groups[0].xwm->fd = wmfd_input;
 
 	xwl_wm_pid = fork();
 
@@ -724,9 +728,31 @@ static int xwl_spawn_wm(bool block, char** argv)
 	return 0;
 }
 
+/*
+ * Forward configures that accumulated during a wm batch. A window that has a
+ * frame in flight gets it with the vsignal for that frame instead (see
+ * xwlsurf_shmifev_handler) so that position and contents change together.
+ */
+static void wnd_viewport_flush()
+{
+	for (size_t i = 0; i < COUNT_OF(xwl_windows); i++){
+		struct xwl_window* wnd = &xwl_windows[i];
+		if (!wnd->viewport_dirty)
+			continue;
+
+		if (wnd->surf &&
+			wnd->surf->acon.addr && wnd->surf->acon.addr->vready)
+			continue;
+
+		wnd->viewport_dirty = false;
+		wnd_viewport(wnd);
+	}
+}
+
 static void xwl_check_wm()
 {
 	xwl_read_wm(process_input);
+	wnd_viewport_flush();
 }
 
 static bool xwlsurf_shmifev_handler(
@@ -798,6 +824,14 @@ static bool xwlsurf_shmifev_handler(
 		fprintf(wmfd_output, "kind=destroy:id=%"PRIu32"\n", wnd->id);
 		*wnd = (struct xwl_window){};
 		return true;
+/* the frame has been consumed, anything held back for it goes now and the
+ * event continues to the normal frame callback handling */
+	case TARGET_COMMAND_STEPFRAME:
+		if (wnd->viewport_dirty && ev->tgt.ioevs[1].iv == 0){
+			wnd->viewport_dirty = false;
+			wnd_viewport(wnd);
+		}
+	break;
 	default:
 	break;
 	}
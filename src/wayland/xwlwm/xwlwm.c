@@ -55,6 +55,13 @@ struct xwnd_state {
 
 	bool paired;
 	bool configured;
+
+/* configure notifies / requests since the last batch was flushed, only the
+ * last one of each is forwarded (see flush_batch) */
+	bool dirty_notify;
+	bool dirty_request;
+	struct timed_request cl_forward;
+
 	bool override_redirect;
 	bool fullscreen;
 	int x, y;
@@ -757,11 +764,8 @@ static void xcb_configure_notify(xcb_configure_notify_event_t* ev)
 
 /* override redirect? use width / height */
 
-	if (state->mapped && state->paired){
-		wm_command(WM_FLUSH,
-		"kind=configure:id=%"PRIu32":x=%d:y=%d:w=%d:h=%d",
-		ev->window, ev->x, ev->y, ev->width, ev->height);
-	}
+	if (state->mapped && state->paired)
+		state->dirty_notify = true;
 }
 
 /*
@@ -780,11 +784,15 @@ static void xcb_configure_request(xcb_configure_request_event_t* ev)
 		return;
 	}
 
-/* this needs to translate to _resize calls and to VIEWPORT hint events */
-	wm_command(WM_FLUSH,
-		"kind=configure:id=%"PRIu32":x=%d:y=%d:w=%d:h=%d",
-		ev->window, ev->x, ev->y, ev->width, ev->height
-	);
+/* this needs to translate to _resize calls and to VIEWPORT hint events,
+ * clients that animate their own geometry send these in bursts */
+	state->dirty_request = true;
+	state->cl_forward = (struct timed_request){
+		.x = ev->x,
+		.y = ev->y,
+		.w = ev->width,
+		.h = ev->height
+	};
 
 	struct timed_request req =
 		(struct timed_request){
@@ -1030,6 +1038,34 @@ static void spawn_debug()
 	}
 }
 
+/*
+ * Forward the last configure of each window that changed during the batch,
+ * a request has precedence as the notify that follows it will repeat it
+ */
+static void flush_batch()
+{
+	struct xwnd_state* state, (* tmp);
+	HASH_ITER(hh, windows, state, tmp){
+		if (state->dirty_request){
+			wm_command(WM_FLUSH,
+				"kind=configure:id=%"PRIu32":x=%d:y=%d:w=%d:h=%d",
+				(uint32_t) state->id, state->cl_forward.x, state->cl_forward.y,
+				state->cl_forward.w, state->cl_forward.h
+			);
+		}
+		else if (state->dirty_notify){
+			wm_command(WM_FLUSH,
+				"kind=configure:id=%"PRIu32":x=%d:y=%d:w=%d:h=%d",
+				(uint32_t) state->id, state->x, state->y, state->w, state->h
+			);
+		}
+		state->dirty_request = state->dirty_notify = false;
+	}
+
+	xcb_flush(dpy);
+	fflush(stdout);
+}
+
 static void* process_thread(void* arg)
 {
 	while (!ferror(stdin) && !feof(stdin)){
@@ -1043,25 +1079,20 @@ static void* process_thread(void* arg)
 /* shouldn't be needed but doesn't trust xcb */
 			pthread_mutex_lock(&wm_synch);
 			process_wm_command(inbuf);
-			xcb_flush(dpy);
+			flush_batch();
 			pthread_mutex_unlock(&wm_synch);
 		}
 	}
 	wm_command(WM_FLUSH, "kind=terminated");
+	fflush(stdout);
 	uint8_t ch = 'x';
 	trace("shutdown:source=process_thread");
 	write(signal_fd, &ch, 1);
 	return NULL;
 }
 
-static void run_event()
+static void dispatch_event(xcb_generic_event_t* ev)
 {
-	xcb_generic_event_t* ev = xcb_wait_for_event(dpy);
-	if (ev->response_type == 0){
-		return;
-	}
-
-	pthread_mutex_lock(&wm_synch);
 	switch (ev->response_type & ~0x80) {
 /* the following are mostly relevant for "UI" events if the decorations are
 * implemented in the context of X rather than at a higher level. Since this
@@ -1132,8 +1163,29 @@ static void run_event()
 		trace("xcb-unhandled:type=%"PRIu8, ev->response_type);
 	break;
 	}
-	xcb_flush(dpy);
+}
+
+/*
+ * Block for one event, then take everything libxcb has already read so that
+ * a flood (games, video) results in one batch of configures and one flush
+ * rather than one per event.
+ */
+static bool run_event()
+{
+	xcb_generic_event_t* ev = xcb_wait_for_event(dpy);
+	if (!ev)
+		return false;
+
+	pthread_mutex_lock(&wm_synch);
+	do {
+		if (ev->response_type != 0)
+			dispatch_event(ev);
+		free(ev);
+	} while ((ev = xcb_poll_for_queued_event(dpy)));
+
+	flush_batch();
 	pthread_mutex_unlock(&wm_synch);
+	return true;
 }
 
 /*
@@ -1172,8 +1224,11 @@ static void setup_init_state(bool standalone)
 
 static void* xcb_msg_thread(void* arg)
 {
-	for (;;)
-		run_event();
+	while (run_event()){}
+
+	uint8_t ch = 'x';
+	trace("shutdown:source=xcb_msg_thread");
+	write(signal_fd, &ch, 1);
 	return NULL;
 }
 
@@ -1383,14 +1438,13 @@ int main (int argc, char **argv)
 	if (xwm_standalone){
 		if (single_exec)
 			launch_child(false, &argv[exec_ind]);
-		for (;;){
-			run_event();
-		}
+		while (run_event()){}
 		return EXIT_SUCCESS;
 	}
 
+/* output is flushed per batch of events (flush_batch), not per line */
 	setlinebuf(stdin);
-	setlinebuf(stdout);
+	setvbuf(stdout, NULL, _IOFBF, 8192);
 
 /* one thread for the WM, one thread for the arcan-wayland connection */
 	pthread_t pth;
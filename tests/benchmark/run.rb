@@ -0,0 +1,156 @@
+#!/usr/bin/ruby
+#
+# Non-interactive benchmark runner, see README in this folder.
+#
+# Runs each benchmark appl through the headless platform in the fixed mode
+# of scripts/benchmark.lua, collects the 'benchmark:json' reports into one
+# JSON document and compares the summaries against a baseline file. Exits
+# with 1 if any scenario failed to produce a report or regressed past the
+# tolerance, so it can be used as a build step.
+#
+require 'json'
+require 'optparse'
+require 'tmpdir'
+require 'timeout'
+
+$testdir = File.expand_path(File.join(File.dirname(__FILE__), ".."))
+$benchdir = File.join($testdir, "benchmark")
+
+opts = {
+	:arcan => ENV["ARCAN_BIN"] ? ENV["ARCAN_BIN"] : "arcan_headless",
+	:baseline => nil,
+	:output => nil,
+	:update => false,
+	:tolerance => 0.15,
+	:width => 640,
+	:height => 480,
+	:refresh => 60,
+	:args => "steps=5:frames=60:warmup=20",
+	:timeout => 300
+}
+
+OptionParser.new{|o|
+	o.banner = "Usage: run.rb [options] [scenario ...]"
+	o.on("--arcan BIN", "engine binary (arcan_headless)"){|v| opts[:arcan] = v }
+	o.on("--baseline FILE", "compare against FILE"){|v| opts[:baseline] = v }
+	o.on("--output FILE", "write results to FILE (stdout)"){|v| opts[:output] = v }
+	o.on("--update", "write the results as the new baseline"){ opts[:update] = true }
+	o.on("--tolerance F", Float, "allowed slowdown (0.15)"){|v| opts[:tolerance] = v }
+	o.on("--size WxH", "canvas dimensions (640x480)"){|v|
+		opts[:width], opts[:height] = v.split("x").map{|n| n.to_i }
+	}
+	o.on("--refresh HZ", Integer, "frame pacing (60)"){|v| opts[:refresh] = v }
+	o.on("--args STR", "arguments to the fixed mode"){|v| opts[:args] = v }
+	o.on("--timeout S", Integer, "per scenario timeout (300)"){|v| opts[:timeout] = v }
+}.parse!
+
+scenarios = ARGV.empty? ? Dir.entries($benchdir).sort.select{|d|
+	File.exist?(File.join($benchdir, d, "#{d}.lua"))
+} : ARGV
+
+def run_scenario(name, opts, dbdir)
+	env = {
+		"ARCAN_VIDEO_REFRESH" => opts[:refresh].to_s,
+		"ARCAN_VIDEO_GPU_TIMERS" => "1"
+	}
+
+	cmd = [opts[:arcan],
+		"-d", File.join(dbdir, "#{name}.sqlite"),
+		"-w", opts[:width].to_s, "-h", opts[:height].to_s,
+		"-p", $testdir, File.join($benchdir, name),
+		"fixed=1:#{opts[:args]}"
+	]
+
+	report = nil
+	begin
+		IO.popen(env, cmd, :err => File::NULL){|io|
+			begin
+				Timeout.timeout(opts[:timeout]){
+					io.each_line{|line|
+						if line.start_with?("benchmark:json ")
+							report = JSON.parse(line.sub("benchmark:json ", ""))
+						end
+					}
+				}
+			rescue Timeout::Error
+				Process.kill("KILL", io.pid)
+				STDERR.print("#{name}: timed out\n")
+			end
+		}
+	rescue SystemCallError => e
+		STDERR.print("#{name}: couldn't run #{opts[:arcan]} (#{e})\n")
+	end
+
+	report
+end
+
+# returns a list of messages for each summary value that got worse
+def compare(name, cur, base, tolerance)
+	res = []
+	["cost_ms", "frame_ms", "gpu_us"].each{|key|
+		b = base["summary"][key]
+		c = cur["summary"][key]
+		next if b.nil? || c.nil? || b <= 0
+
+		delta = (c.to_f - b) / b
+		if delta > tolerance
+			res << format("%s: %s %.3f -> %.3f (+%.1f%%)", name, key, b, c, delta * 100.0)
+		end
+	}
+	res
+end
+
+baseline = {}
+if opts[:baseline] && File.exist?(opts[:baseline]) && !opts[:update]
+	baseline = JSON.parse(File.read(opts[:baseline]))["scenarios"] || {}
+end
+
+results = {}
+failed = []
+regressed = []
+
+Dir.mktmpdir("arcan_bench"){|dbdir|
+	scenarios.each{|name|
+		STDERR.print("benchmark, run #{name}\n")
+		report = run_scenario(name, opts, dbdir)
+		if report.nil?
+			failed << name
+			next
+		end
+
+		results[name] = report
+		if baseline[name]
+			regressed += compare(name, report, baseline[name], opts[:tolerance])
+		end
+	}
+}
+
+doc = {
+	"config" => {
+		"arcan" => opts[:arcan],
+		"width" => opts[:width],
+		"height" => opts[:height],
+		"refresh" => opts[:refresh],
+		"args" => opts[:args]
+	},
+	"scenarios" => results,
+	"failed" => failed,
+	"regressions" => regressed
+}
+
+out = JSON.pretty_generate(doc)
+if opts[:output]
+	File.write(opts[:output], out + "\n")
+else
+	STDOUT.print(out + "\n")
+end
+
+if opts[:update] && opts[:baseline]
+	File.write(opts[:baseline], out + "\n")
+	STDERR.print("baseline written to #{opts[:baseline]}\n")
+end
+
+regressed.each{|msg| STDERR.print("regression, #{msg}\n") }
+failed.each{|name| STDERR.print("failed, #{name}\n") }
+
+exit((failed.empty? && regressed.empty?) ? 0 : 1)
@@ -0,0 +1,786 @@
+/*
+ * Throughput and latency benchmark for the A12 video path. A source and a
+ * sink state are paired, either pumped in memory on one thread or with the
+ * sink on its own thread at the other end of a localhost TCP connection, and
+ * a sequence of frames is sent through each of the chosen vframe methods.
+ *
+ * The sequences are synthesized (desktop, terminal, video) or replayed from a
+ * recording (see -f, -o and the README for the format). Damage is the bounding
+ * box of what changed since the previous frame, as it would be from a client
+ * that marks its regions.
+ *
+ * Output is one CSV row per transport / sequence / method run on stdout with
+ * a header first, progress and errors go to stderr.
+ */
+#include <arcan_shmif.h>
+#include <arcan_shmif_server.h>
+#include <arcan/a12.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <getopt.h>
+#include <time.h>
+
+/* if a frame hasn't arrived by then, the method is considered broken */
+#define FRAME_TIMEOUT_US 5000000
+
+static const uint8_t rec_magic[4] = {'A', '1', '2', 'B'};
+
+struct frame_stat {
+	uint64_t submit;
+	uint64_t enc_us;
+	_Atomic uint64_t dec_us;
+	uint64_t lat_us;
+};
+
+struct bench {
+	struct a12_state* cl;
+	struct a12_state* srv;
+	int fd_cl, fd_srv;
+
+	size_t w, h;
+	shmif_pixel* dst;
+
+	struct frame_stat* stats;
+	size_t n_frames;
+	_Atomic size_t signalled;
+	_Atomic bool done;
+	size_t wire;
+};
+
+struct sequence {
+	const char* name;
+	void (*render)(struct sequence*, shmif_pixel*, size_t w, size_t h, size_t f);
+	FILE* fin;
+	size_t n_frames;
+};
+
+static const struct {
+	const char* name;
+	int method;
+} methods[] = {
+	{"raw", VFRAME_METHOD_RAW_NOALPHA},
+	{"rgb565", VFRAME_METHOD_RAW_RGB565},
+	{"h264", VFRAME_METHOD_H264},
+	{"zstd", VFRAME_METHOD_ZSTD},
+	{"dzstd", VFRAME_METHOD_DZSTD},
+	{"tiles", VFRAME_METHOD_TILES},
+	{"adaptive", VFRAME_METHOD_ADAPTIVE}
+};
+
+#define COUNT_OF(X) (sizeof(X) / sizeof(X[0]))
+
+static uint64_t now_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t cpu_us()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return
+		(uint64_t) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+		ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+/* stateless so that every method sees the same frame [f] */
+static uint32_t hash(uint32_t a, uint32_t b, uint32_t c)
+{
+	uint32_t h = a * 0x9e3779b1 ^ b * 0x85ebca77 ^ c * 0xc2b2ae3d;
+	h ^= h >> 15;
+	h *= 0x2c1b3c6d;
+	h ^= h >> 12;
+	return h;
+}
+
+static void fill_rect(shmif_pixel* buf, size_t w, size_t h,
+	ssize_t x, ssize_t y, size_t rw, size_t rh, shmif_pixel px)
+{
+	for (ssize_t cy = y; cy < y + (ssize_t) rh; cy++){
+		if (cy < 0 || cy >= (ssize_t) h)
+			continue;
+		for (ssize_t cx = x; cx < x + (ssize_t) rw; cx++)
+			if (cx >= 0 && cx < (ssize_t) w)
+				buf[cy * w + cx] = px;
+	}
+}
+
+/* a static wallpaper and panels, one window being dragged around, a clock
+ * ticking and a list that changes every 10 frames */
+static void render_desktop(
+	struct sequence* seq, shmif_pixel* buf, size_t w, size_t h, size_t f)
+{
+	for (size_t y = 0; y < h; y++)
+		for (size_t x = 0; x < w; x++)
+			buf[y * w + x] = SHMIF_RGBA(0x20 + y * 0x40 / h, 0x30, 0x50 + x * 0x40 / w, 0xff);
+
+	fill_rect(buf, w, h, 0, 0, w, 24, SHMIF_RGBA(0x30, 0x30, 0x30, 0xff));
+	fill_rect(buf, w, h, w - 80, 4, 72, 16,
+		SHMIF_RGBA(0x10 * (f % 16), 0xc0, 0xc0, 0xff));
+
+	size_t list = f / 10;
+	fill_rect(buf, w, h, 40, 60, w / 3, h / 2, SHMIF_RGBA(0xe0, 0xe0, 0xe0, 0xff));
+	for (size_t i = 0; i < h / 2 / 20; i++)
+		fill_rect(buf, w, h, 48, 66 + i * 20, 40 + hash(list, i, 0) % (w / 3 - 60), 12,
+			SHMIF_RGBA(0x40, 0x40, hash(list, i, 1) & 0xff, 0xff));
+
+	ssize_t wx = w / 2 + (ssize_t)((f * 4) % (w / 3)) - (ssize_t) w / 6;
+	ssize_t wy = h / 4 + (ssize_t)((f * 2) % (h / 3));
+	fill_rect(buf, w, h, wx, wy, w / 4, h / 3, SHMIF_RGBA(0xf0, 0xf0, 0xd0, 0xff));
+	fill_rect(buf, w, h, wx, wy, w / 4, 20, SHMIF_RGBA(0x30, 0x60, 0xa0, 0xff));
+}
+
+/* 8x16 cells of pseudo-glyphs, a line is written every frame and the view
+ * scrolls once the screen is full */
+static void render_terminal(
+	struct sequence* seq, shmif_pixel* buf, size_t w, size_t h, size_t f)
+{
+	size_t cols = w / 8, rows = h / 16;
+	size_t first = f >= rows ? f - rows + 1 : 0;
+	shmif_pixel bg = SHMIF_RGBA(0x10, 0x10, 0x10, 0xff);
+	shmif_pixel fg = SHMIF_RGBA(0xc0, 0xc0, 0xc0, 0xff);
+
+	for (size_t i = 0; i < w * h; i++)
+		buf[i] = bg;
+
+	for (size_t row = 0; row < rows && first + row <= f; row++){
+		size_t line = first + row;
+		size_t len = hash(line, 0, 0) % cols;
+		for (size_t col = 0; col < len; col++){
+			uint32_t ch = hash(line, col, 1) % 95;
+			if (ch == 0)
+				continue;
+			for (size_t gy = 0; gy < 16; gy++){
+				uint32_t bits = hash(ch, gy, 2);
+				for (size_t gx = 0; gx < 8; gx++)
+					if (gy > 2 && gy < 14 && (bits >> gx) & 1)
+						buf[(row * 16 + gy) * w + col * 8 + gx] = fg;
+			}
+		}
+	}
+}
+
+/* full-frame motion with a bit of grain */
+static void render_video(
+	struct sequence* seq, shmif_pixel* buf, size_t w, size_t h, size_t f)
+{
+	for (size_t y = 0; y < h; y++)
+		for (size_t x = 0; x < w; x++){
+			uint32_t n = hash(x, y, f) & 0x0f;
+			buf[y * w + x] = SHMIF_RGBA(
+				((x + f * 3) & 0xff) ^ n, ((y + f * 2) & 0xff) ^ n, ((x + y) / 4 + f) & 0xff, 0xff);
+		}
+}
+
+static void render_file(
+	struct sequence* seq, shmif_pixel* buf, size_t w, size_t h, size_t f)
+{
+	if (f == 0)
+		fseek(seq->fin, 12, SEEK_SET);
+
+	if (1 != fread(buf, w * h * sizeof(shmif_pixel), 1, seq->fin))
+		memset(buf, '\0', w * h * sizeof(shmif_pixel));
+}
+
+static bool open_recording(struct sequence* seq, const char* path, size_t* w, size_t* h)
+{
+	FILE* fin = fopen(path, "r");
+	if (!fin){
+		fprintf(stderr, "couldn't open recording (%s): %s\n", path, strerror(errno));
+		return false;
+	}
+
+	uint8_t hdr[12];
+	if (1 != fread(hdr, 12, 1, fin) || memcmp(hdr, rec_magic, 4) != 0){
+		fprintf(stderr, "%s: not a recording\n", path);
+		fclose(fin);
+		return false;
+	}
+
+	uint32_t rw, rh;
+	memcpy(&rw, &hdr[4], 4);
+	memcpy(&rh, &hdr[8], 4);
+
+	fseek(fin, 0, SEEK_END);
+	size_t sz = ftell(fin) - 12;
+	size_t frame_sz = (size_t) rw * rh * sizeof(shmif_pixel);
+
+	if (!rw || !rh || rw > 8192 || rh > 8192 || sz < frame_sz){
+		fprintf(stderr, "%s: bad dimensions or no frames\n", path);
+		fclose(fin);
+		return false;
+	}
+
+	*w = rw;
+	*h = rh;
+	*seq = (struct sequence){
+		.name = path,
+		.render = render_file,
+		.fin = fin,
+		.n_frames = sz / frame_sz
+	};
+	return true;
+}
+
+static bool write_recording(struct sequence* seq,
+	const char* path, size_t w, size_t h, size_t n)
+{
+	FILE* fout = fopen(path, "w");
+	if (!fout){
+		fprintf(stderr, "couldn't create (%s): %s\n", path, strerror(errno));
+		return false;
+	}
+
+	uint32_t dim[2] = {w, h};
+	fwrite(rec_magic, 4, 1, fout);
+	fwrite(dim, sizeof(dim), 1, fout);
+
+	shmif_pixel* buf = malloc(w * h * sizeof(shmif_pixel));
+	for (size_t f = 0; f < n; f++){
+		seq->render(seq, buf, w, h, f);
+		fwrite(buf, w * h * sizeof(shmif_pixel), 1, fout);
+	}
+
+	free(buf);
+	return fclose(fout) == 0;
+}
+
+/* bounding box of what differs to [prev], false if nothing does */
+static bool damage(shmif_pixel* cur,
+	shmif_pixel* prev, size_t w, size_t h, struct arcan_shmif_region* R)
+{
+	size_t x1 = w, y1 = h, x2 = 0, y2 = 0;
+	for (size_t y = 0; y < h; y++){
+		shmif_pixel* a = &cur[y * w];
+		shmif_pixel* b = &prev[y * w];
+		if (memcmp(a, b, w * sizeof(shmif_pixel)) == 0)
+			continue;
+
+		if (y < y1)
+			y1 = y;
+		y2 = y;
+		for (size_t x = 0; x < w; x++)
+			if (a[x] != b[x]){
+				if (x < x1)
+					x1 = x;
+				if (x > x2)
+					x2 = x;
+			}
+	}
+
+	if (y1 == h)
+		return false;
+
+	*R = (struct arcan_shmif_region){
+		.x1 = x1, .y1 = y1, .x2 = x2 + 1, .y2 = y2 + 1
+	};
+	return true;
+}
+
+static shmif_pixel* on_raw_buffer(
+	size_t w, size_t h, size_t* stride, int flags, void* tag)
+{
+	struct bench* B = tag;
+	free(B->dst);
+	B->dst = malloc(w * h * sizeof(shmif_pixel));
+	*stride = w * sizeof(shmif_pixel);
+	return B->dst;
+}
+
+/* called on the thread that services the sink, the frame that completes is
+ * always the oldest one in flight */
+static void on_video(size_t x1, size_t y1, size_t x2, size_t y2, void* tag)
+{
+	struct bench* B = tag;
+	size_t i = atomic_load(&B->signalled);
+	if (i < B->n_frames)
+		B->stats[i].lat_us = now_us() - B->stats[i].submit;
+	atomic_fetch_add(&B->signalled, 1);
+}
+
+static struct pk_response key_lookup(uint8_t pub[static 32], void* tag)
+{
+	return (struct pk_response){.authentic = true};
+}
+
+static bool write_all(int fd, uint8_t* buf, size_t n)
+{
+	while (n){
+		ssize_t nw = write(fd, buf, n);
+		if (-1 == nw){
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return false;
+		}
+		buf += nw;
+		n -= nw;
+	}
+	return true;
+}
+
+static void unpack_timed(struct bench* B, uint8_t* buf, size_t n)
+{
+	uint64_t t0 = now_us();
+	a12_unpack(B->srv, buf, n, NULL, NULL);
+	size_t i = atomic_load(&B->signalled);
+	if (i >= B->n_frames)
+		i = B->n_frames - 1;
+	atomic_fetch_add(&B->stats[i].dec_us, now_us() - t0);
+}
+
+/* move everything the source has to the sink and the replies back */
+static void pump_mem(struct bench* B, struct frame_stat* fs)
+{
+	uint8_t* buf;
+	size_t n;
+
+	for(;;){
+		uint64_t t0 = now_us();
+		n = a12_flush(B->cl, &buf, A12_FLUSH_ALL);
+		fs->enc_us += now_us() - t0;
+		if (!n)
+			break;
+		B->wire += n;
+		unpack_timed(B, buf, n);
+	}
+
+	while ((n = a12_flush(B->srv, &buf, A12_FLUSH_ALL)))
+		a12_unpack(B->cl, buf, n, NULL, NULL);
+}
+
+static void pump_tcp(struct bench* B, struct frame_stat* fs)
+{
+	uint8_t* buf;
+	size_t n;
+
+	for(;;){
+		uint64_t t0 = now_us();
+		n = a12_flush(B->cl, &buf, A12_FLUSH_ALL);
+		fs->enc_us += now_us() - t0;
+		if (!n)
+			break;
+		B->wire += n;
+		if (!write_all(B->fd_cl, buf, n)){
+			fprintf(stderr, "source write failed: %s\n", strerror(errno));
+			atomic_store(&B->done, true);
+			return;
+		}
+	}
+
+	struct pollfd pfd = {.fd = B->fd_cl, .events = POLLIN};
+	uint8_t inbuf[65536];
+	if (poll(&pfd, 1, 1) == 1){
+		ssize_t nr = read(B->fd_cl, inbuf, sizeof(inbuf));
+		if (nr > 0)
+			a12_unpack(B->cl, inbuf, nr, NULL, NULL);
+	}
+}
+
+static void* sink_thread(void* tag)
+{
+	struct bench* B = tag;
+	uint8_t inbuf[65536];
+	struct pollfd pfd = {.fd = B->fd_srv, .events = POLLIN};
+
+	while (!atomic_load(&B->done)){
+		if (poll(&pfd, 1, 10) == 1){
+			ssize_t nr = read(B->fd_srv, inbuf, sizeof(inbuf));
+			if (nr <= 0)
+				break;
+			unpack_timed(B, inbuf, nr);
+		}
+		else
+			a12_poll(B->srv);
+
+		uint8_t* buf;
+		size_t n;
+		while ((n = a12_flush(B->srv, &buf, A12_FLUSH_ALL)))
+			if (!write_all(B->fd_srv, buf, n))
+				return NULL;
+	}
+
+	return NULL;
+}
+
+static bool tcp_pair(int* a, int* b)
+{
+	int lfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+	};
+	socklen_t len = sizeof(addr);
+
+	if (-1 == lfd ||
+		-1 == bind(lfd, (struct sockaddr*) &addr, len) ||
+		-1 == listen(lfd, 1) ||
+		-1 == getsockname(lfd, (struct sockaddr*) &addr, &len)){
+		fprintf(stderr, "couldn't listen on localhost: %s\n", strerror(errno));
+		if (-1 != lfd)
+			close(lfd);
+		return false;
+	}
+
+	*a = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (-1 == *a || -1 == connect(*a, (struct sockaddr*) &addr, len)){
+		fprintf(stderr, "couldn't connect to localhost: %s\n", strerror(errno));
+		close(lfd);
+		return false;
+	}
+
+	*b = accept(lfd, NULL, NULL);
+	close(lfd);
+	if (-1 == *b)
+		return false;
+
+	int flag = 1;
+	setsockopt(*a, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+	setsockopt(*b, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+	return true;
+}
+
+/* the handshake is not part of the measurement so it always runs in memory */
+static bool setup_pair(struct bench* B, size_t venc, size_t vdec)
+{
+	struct a12_context_options cl_opts = {
+		.local_role = ROLE_SOURCE,
+		.pk_lookup = key_lookup
+	};
+	struct a12_context_options srv_opts = {
+		.local_role = ROLE_SINK,
+		.pk_lookup = key_lookup,
+		.allow_symmetric_auth = true
+	};
+	snprintf(cl_opts.secret, sizeof(cl_opts.secret), "a12bench");
+	snprintf(srv_opts.secret, sizeof(srv_opts.secret), "a12bench");
+
+	B->srv = a12_server(&srv_opts);
+	B->cl = a12_client(&cl_opts);
+	if (!B->srv || !B->cl)
+		return false;
+
+	uint8_t* buf;
+	size_t n;
+	for (size_t i = 0; i < 16 && !(a12_auth_state(B->cl) == AUTH_FULL_PK &&
+		a12_auth_state(B->srv) == AUTH_FULL_PK); i++){
+		while ((n = a12_flush(B->cl, &buf, A12_FLUSH_ALL)))
+			a12_unpack(B->srv, buf, n, NULL, NULL);
+		while ((n = a12_flush(B->srv, &buf, A12_FLUSH_ALL)))
+			a12_unpack(B->cl, buf, n, NULL, NULL);
+	}
+
+	if (a12_auth_state(B->cl) != AUTH_FULL_PK || a12_auth_state(B->srv) != AUTH_FULL_PK){
+		fprintf(stderr, "authentication failed (%d, %d)\n",
+			a12_auth_state(B->cl), a12_auth_state(B->srv));
+		return false;
+	}
+
+	a12_set_destination_raw(B->srv, 0,
+		(struct a12_unpack_cfg){
+			.tag = B,
+			.request_raw_buffer = on_raw_buffer,
+			.signal_video = on_video
+		}, sizeof(struct a12_unpack_cfg)
+	);
+
+	if (venc)
+		a12_set_venc_worker(B->cl, venc, NULL, NULL);
+	if (vdec)
+		a12_set_vdec_worker(B->srv, vdec, NULL, NULL);
+
+	return true;
+}
+
+static void teardown_pair(struct bench* B)
+{
+	a12_set_vdec_worker(B->srv, 0, NULL, NULL);
+	a12_set_venc_worker(B->cl, 0, NULL, NULL);
+	a12_channel_close(B->cl);
+	a12_channel_close(B->srv);
+	a12_free(B->cl);
+	a12_free(B->srv);
+	free(B->dst);
+	B->dst = NULL;
+}
+
+static int cmp_u64(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+	return x < y ? -1 : x > y;
+}
+
+static void report(struct bench* B, const char* transport,
+	const char* seq, const char* method, size_t frames, uint64_t wall, uint64_t cpu)
+{
+	uint64_t enc = 0, enc_max = 0, dec = 0, dec_max = 0, lat = 0;
+	uint64_t* lats = malloc(sizeof(uint64_t) * (frames ? frames : 1));
+
+	for (size_t i = 0; i < frames; i++){
+		struct frame_stat* fs = &B->stats[i];
+		uint64_t d = atomic_load(&fs->dec_us);
+		enc += fs->enc_us;
+		dec += d;
+		lat += fs->lat_us;
+		enc_max = fs->enc_us > enc_max ? fs->enc_us : enc_max;
+		dec_max = d > dec_max ? d : dec_max;
+		lats[i] = fs->lat_us;
+	}
+
+	qsort(lats, frames, sizeof(uint64_t), cmp_u64);
+	size_t n = frames ? frames : 1;
+	size_t raw = B->w * B->h * sizeof(shmif_pixel) * frames;
+
+	printf("%s,%s,%s,%zu,%zu,%zu,%zu,%zu,%.3f,"
+		"%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%.1f\n",
+		transport, seq, method, frames, B->w, B->h, raw, B->wire,
+		B->wire ? (double) raw / (double) B->wire : 0.0,
+		enc / n, enc_max, dec / n, dec_max,
+		lat / n, frames ? lats[frames * 95 / 100] : 0, frames ? lats[frames - 1] : 0,
+		wall ? (double) cpu * 100.0 / (double) wall : 0.0
+	);
+	fflush(stdout);
+	free(lats);
+}
+
+static bool run(struct sequence* seq, int method, const char* method_name,
+	bool tcp, size_t w, size_t h, size_t n_frames, size_t venc, size_t vdec)
+{
+	struct bench B = {
+		.w = w,
+		.h = h,
+		.n_frames = n_frames,
+		.fd_cl = -1,
+		.fd_srv = -1
+	};
+
+	B.stats = calloc(n_frames, sizeof(struct frame_stat));
+	shmif_pixel* cur = malloc(w * h * sizeof(shmif_pixel));
+	shmif_pixel* prev = malloc(w * h * sizeof(shmif_pixel));
+	if (!B.stats || !cur || !prev || !setup_pair(&B, venc, vdec)){
+		free(B.stats);
+		free(cur);
+		free(prev);
+		return false;
+	}
+
+	pthread_t sink;
+	if (tcp){
+		if (!tcp_pair(&B.fd_cl, &B.fd_srv) ||
+			0 != pthread_create(&sink, NULL, sink_thread, &B)){
+			teardown_pair(&B);
+			free(B.stats);
+			free(cur);
+			free(prev);
+			return false;
+		}
+	}
+
+	uint64_t wall = now_us();
+	uint64_t cpu = cpu_us();
+	size_t f = 0;
+
+	for (; f < n_frames; f++){
+		struct frame_stat* fs = &B.stats[f];
+		struct shmifsrv_vbuffer vb = {
+			.buffer = cur,
+			.w = w,
+			.h = h,
+			.pitch = w,
+			.stride = w * sizeof(shmif_pixel)
+		};
+
+/* the render is not part of the measurement, the damage tracking is as that
+ * is work the client would do */
+		uint64_t paused = now_us();
+		uint64_t paused_cpu = cpu_us();
+		seq->render(seq, cur, w, h, f);
+		wall += now_us() - paused;
+		cpu += cpu_us() - paused_cpu;
+
+		if (f && damage(cur, prev, w, h, &vb.region))
+			vb.flags.subregion = true;
+
+		fs->submit = now_us();
+		a12_channel_vframe(B.cl, &vb, (struct a12_vframe_opts){.method = method});
+		fs->enc_us = now_us() - fs->submit;
+
+		while (atomic_load(&B.signalled) <= f){
+			if (now_us() - fs->submit > FRAME_TIMEOUT_US || !a12_ok(B.cl)){
+				fprintf(stderr, "%s:%s: frame %zu timed out\n", seq->name, method_name, f);
+				goto out;
+			}
+
+			if (tcp)
+				pump_tcp(&B, fs);
+			else{
+				pump_mem(&B, fs);
+				a12_poll(B.srv);
+			}
+			a12_poll(B.cl);
+		}
+
+		shmif_pixel* tmp = prev;
+		prev = cur;
+		cur = tmp;
+	}
+
+out:
+	wall = now_us() - wall;
+	cpu = cpu_us() - cpu;
+
+	atomic_store(&B.done, true);
+	if (tcp){
+		shutdown(B.fd_cl, SHUT_RDWR);
+		pthread_join(sink, NULL);
+		close(B.fd_cl);
+		close(B.fd_srv);
+	}
+
+	report(&B, tcp ? "tcp" : "mem", seq->name, method_name, f, wall, cpu);
+	teardown_pair(&B);
+	free(B.stats);
+	free(cur);
+	free(prev);
+	return f == n_frames;
+}
+
+static void usage()
+{
+	fprintf(stderr, "Usage: a12bench [options]\n"
+	"-s, --sequence name  desktop, terminal, video or all (default)\n"
+	"-f, --file path      replay a recording instead of the synthetic sequences\n"
+	"-o, --output path    write the (first) chosen sequence as a recording and exit\n"
+	"-m, --method name    raw, rgb565, h264, zstd, dzstd, tiles, adaptive or all (default)\n"
+	"-t, --transport name mem, tcp or all (default)\n"
+	"-n, --frames n       number of frames per run (default 120)\n"
+	"-W, --width n        synthetic frame width (default 1280)\n"
+	"-H, --height n       synthetic frame height (default 720)\n"
+	"-e, --venc n         use the encode worker with n band threads\n"
+	"-d, --vdec n         use the decode worker with n threads\n"
+	"\n"
+	"Output columns:\n"
+	" transport,sequence,method,frames,width,height,raw_bytes,wire_bytes,ratio,\n"
+	" enc_us_avg,enc_us_max,dec_us_avg,dec_us_max,lat_us_avg,lat_us_p95,lat_us_max,cpu_pct\n"
+	);
+}
+
+static const struct option longopts[] = {
+	{"sequence", required_argument, NULL, 's'},
+	{"file", required_argument, NULL, 'f'},
+	{"output", required_argument, NULL, 'o'},
+	{"method", required_argument, NULL, 'm'},
+	{"transport", required_argument, NULL, 't'},
+	{"frames", required_argument, NULL, 'n'},
+	{"width", required_argument, NULL, 'W'},
+	{"height", required_argument, NULL, 'H'},
+	{"venc", required_argument, NULL, 'e'},
+	{"vdec", required_argument, NULL, 'd'},
+	{"help", no_argument, NULL, 'h'},
+	{NULL, 0, NULL, 0}
+};
+
+int main(int argc, char** argv)
+{
+	struct sequence synth[] = {
+		{.name = "desktop", .render = render_desktop},
+		{.name = "terminal", .render = render_terminal},
+		{.name = "video", .render = render_video}
+	};
+	struct sequence file;
+
+	const char* seq_sel = "all";
+	const char* method_sel = "all";
+	const char* transport_sel = "all";
+	const char* rec_in = NULL;
+	const char* rec_out = NULL;
+	size_t n_frames = 120, w = 1280, h = 720, venc = 0, vdec = 0;
+
+	int ch;
+	while ((ch = getopt_long(argc, argv, "s:f:o:m:t:n:W:H:e:d:h", longopts, NULL)) >= 0){
+		switch (ch){
+		case 's': seq_sel = optarg; break;
+		case 'f': rec_in = optarg; break;
+		case 'o': rec_out = optarg; break;
+		case 'm': method_sel = optarg; break;
+		case 't': transport_sel = optarg; break;
+		case 'n': n_frames = strtoul(optarg, NULL, 10); break;
+		case 'W': w = strtoul(optarg, NULL, 10); break;
+		case 'H': h = strtoul(optarg, NULL, 10); break;
+		case 'e': venc = strtoul(optarg, NULL, 10); break;
+		case 'd': vdec = strtoul(optarg, NULL, 10); break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!n_frames || w < 64 || h < 64 || w > 8192 || h > 8192){
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	struct sequence* seqs = synth;
+	size_t n_seqs = COUNT_OF(synth);
+
+	if (rec_in){
+		if (!open_recording(&file, rec_in, &w, &h))
+			return EXIT_FAILURE;
+		seqs = &file;
+		n_seqs = 1;
+		if (file.n_frames < n_frames)
+			n_frames = file.n_frames;
+	}
+
+	if (rec_out){
+		for (size_t i = 0; i < n_seqs; i++)
+			if (strcmp(seq_sel, "all") == 0 || strcmp(seq_sel, seqs[i].name) == 0)
+				return write_recording(&seqs[i], rec_out, w, h, n_frames) ?
+					EXIT_SUCCESS : EXIT_FAILURE;
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	printf("transport,sequence,method,frames,width,height,raw_bytes,wire_bytes,ratio,"
+		"enc_us_avg,enc_us_max,dec_us_avg,dec_us_max,lat_us_avg,lat_us_p95,lat_us_max,cpu_pct\n");
+
+	bool ok = true;
+	for (size_t t = 0; t < 2; t++){
+		const char* transport = t ? "tcp" : "mem";
+		if (strcmp(transport_sel, "all") != 0 && strcmp(transport_sel, transport) != 0)
+			continue;
+
+		for (size_t s = 0; s < n_seqs; s++){
+			if (!rec_in &&
+				strcmp(seq_sel, "all") != 0 && strcmp(seq_sel, seqs[s].name) != 0)
+				continue;
+
+			for (size_t m = 0; m < COUNT_OF(methods); m++){
+				if (strcmp(method_sel, "all") != 0 && strcmp(method_sel, methods[m].name) != 0)
+					continue;
+
+				fprintf(stderr, "%s:%s:%s\n", transport, seqs[s].name, methods[m].name);
+				ok &= run(&seqs[s], methods[m].method,
+					methods[m].name, t == 1, w, h, n_frames, venc, vdec);
+			}
+		}
+	}
+
+	if (rec_in)
+		fclose(file.fin);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
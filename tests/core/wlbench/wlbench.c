@@ -0,0 +1,815 @@
+/*
+ * Throughput and latency benchmark for arcan-wayland. A plain wayland client
+ * that maps an xdg toplevel per run and commits a sequence of frames through
+ * either wl_shm or linux-dmabuf buffers at a set size and damage pattern,
+ * pacing on frame callbacks the way a well behaved client would.
+ *
+ * Each commit carries wp_presentation feedback, commit-to-scanout latency is
+ * from the commit until the presented timestamp (on the clock the bridge says
+ * it uses). The CPU time of the bridge comes from the scheduler statistics of
+ * all its threads, the bridge is found as the peer of the display socket or
+ * given with -p.
+ *
+ * Output is one CSV row per mode / size / damage run on stdout with a header
+ * first, progress and errors go to stderr.
+ */
+#include <wayland-client.h>
+#include "wayland-xdg-shell-client-protocol.h"
+#include "wayland-presentation-time-client-protocol.h"
+#include "wayland-dmabuf-client-protocol.h"
+
+#ifdef HAVE_GBM
+#include <gbm.h>
+#include <fcntl.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <poll.h>
+#include <math.h>
+#include <getopt.h>
+#include <time.h>
+
+/* if a frame hasn't been called back by then, the run is considered broken */
+#define FRAME_TIMEOUT_MS 5000
+
+/* outstanding presentation feedback is waited for this long after a run */
+#define DRAIN_TIMEOUT_MS 1000
+
+#define N_BUFFERS 3
+
+#define COUNT_OF(X) (sizeof(X) / sizeof(X[0]))
+
+#ifndef DRM_FORMAT_XRGB8888
+#define DRM_FORMAT_XRGB8888 0x34325258
+#endif
+
+struct region {
+	size_t x, y, w, h;
+};
+
+struct buffer {
+	struct wl_buffer* buf;
+	uint32_t* px;
+	size_t stride;
+	bool busy;
+	struct region last;
+#ifdef HAVE_GBM
+	struct gbm_bo* bo;
+	void* map_data;
+#endif
+};
+
+struct frame_stat {
+	uint64_t commit_ns;
+	uint64_t present_ns;
+	bool presented, discarded;
+	struct wp_presentation_feedback* fb;
+};
+
+struct bench {
+	struct wl_display* dpy;
+	struct wl_registry* reg;
+	struct wl_compositor* comp;
+	struct wl_shm* shm;
+	struct xdg_wm_base* wm;
+	struct wp_presentation* pres;
+	struct zwp_linux_dmabuf_v1* dmabuf;
+	clockid_t clock;
+	pid_t bridge;
+
+#ifdef HAVE_GBM
+	struct gbm_device* gbm;
+#endif
+
+/* per run */
+	struct wl_surface* surf;
+	struct xdg_surface* xsurf;
+	struct xdg_toplevel* top;
+	bool configured;
+	bool frame_done;
+	uint64_t frame_ns;
+
+	struct buffer buffers[N_BUFFERS];
+	struct frame_stat* stats;
+	size_t outstanding;
+};
+
+enum damage_pattern {
+	DAMAGE_FULL = 0,
+	DAMAGE_BOX,
+	DAMAGE_LINE
+};
+
+static const char* damage_names[] = {"full", "box", "line"};
+
+static uint64_t now_ns(clockid_t clk)
+{
+	struct timespec ts;
+	clock_gettime(clk, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* sum of the on-cpu time of every thread in the bridge process */
+static uint64_t bridge_ns(pid_t pid)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/task", (int) pid);
+	DIR* dir = opendir(path);
+	if (!dir)
+		return 0;
+
+	uint64_t sum = 0;
+	struct dirent* ent;
+	while ((ent = readdir(dir))){
+		if (ent->d_name[0] == '.')
+			continue;
+
+		char fn[128];
+		snprintf(fn, sizeof(fn), "/proc/%d/task/%s/schedstat", (int) pid, ent->d_name);
+		FILE* fin = fopen(fn, "r");
+		if (!fin)
+			continue;
+
+		unsigned long long ns;
+		if (1 == fscanf(fin, "%llu", &ns))
+			sum += ns;
+		fclose(fin);
+	}
+
+	closedir(dir);
+	return sum;
+}
+
+static pid_t socket_peer(struct wl_display* dpy)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	if (-1 == getsockopt(
+		wl_display_get_fd(dpy), SOL_SOCKET, SO_PEERCRED, &cred, &len))
+		return 0;
+	return cred.pid;
+}
+
+/* dispatch whatever arrives within [ms], false on timeout or error */
+static bool pump(struct bench* B, int ms)
+{
+	while (wl_display_prepare_read(B->dpy) != 0)
+		wl_display_dispatch_pending(B->dpy);
+
+	wl_display_flush(B->dpy);
+
+	struct pollfd pfd = {.fd = wl_display_get_fd(B->dpy), .events = POLLIN};
+	if (poll(&pfd, 1, ms) <= 0){
+		wl_display_cancel_read(B->dpy);
+		return false;
+	}
+
+	if (-1 == wl_display_read_events(B->dpy))
+		return false;
+
+	return wl_display_dispatch_pending(B->dpy) != -1;
+}
+
+static void wm_ping(void* data, struct xdg_wm_base* wm, uint32_t serial)
+{
+	xdg_wm_base_pong(wm, serial);
+}
+
+static const struct xdg_wm_base_listener wm_listener = {
+	.ping = wm_ping
+};
+
+static void pres_clock(void* data, struct wp_presentation* pres, uint32_t clk)
+{
+	struct bench* B = data;
+	B->clock = clk;
+}
+
+static const struct wp_presentation_listener pres_listener = {
+	.clock_id = pres_clock
+};
+
+static void dmabuf_format(void* data,
+	struct zwp_linux_dmabuf_v1* dmabuf, uint32_t format)
+{
+}
+
+static void dmabuf_modifier(void* data, struct zwp_linux_dmabuf_v1* dmabuf,
+	uint32_t format, uint32_t mod_hi, uint32_t mod_lo)
+{
+}
+
+static const struct zwp_linux_dmabuf_v1_listener dmabuf_listener = {
+	.format = dmabuf_format,
+	.modifier = dmabuf_modifier
+};
+
+static void reg_global(void* data, struct wl_registry* reg,
+	uint32_t name, const char* iface, uint32_t version)
+{
+	struct bench* B = data;
+
+	if (strcmp(iface, wl_compositor_interface.name) == 0 && version >= 4)
+		B->comp = wl_registry_bind(reg, name, &wl_compositor_interface, 4);
+
+	else if (strcmp(iface, wl_shm_interface.name) == 0)
+		B->shm = wl_registry_bind(reg, name, &wl_shm_interface, 1);
+
+	else if (strcmp(iface, xdg_wm_base_interface.name) == 0){
+		B->wm = wl_registry_bind(reg, name, &xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(B->wm, &wm_listener, B);
+	}
+	else if (strcmp(iface, wp_presentation_interface.name) == 0){
+		B->pres = wl_registry_bind(reg, name, &wp_presentation_interface, 1);
+		wp_presentation_add_listener(B->pres, &pres_listener, B);
+	}
+	else if (strcmp(iface, zwp_linux_dmabuf_v1_interface.name) == 0 && version >= 2){
+		B->dmabuf = wl_registry_bind(reg,
+			name, &zwp_linux_dmabuf_v1_interface, version < 3 ? version : 3);
+		zwp_linux_dmabuf_v1_add_listener(B->dmabuf, &dmabuf_listener, B);
+	}
+}
+
+static void reg_remove(void* data, struct wl_registry* reg, uint32_t name)
+{
+}
+
+static const struct wl_registry_listener reg_listener = {
+	.global = reg_global,
+	.global_remove = reg_remove
+};
+
+static void xsurf_configure(void* data, struct xdg_surface* xsurf, uint32_t serial)
+{
+	struct bench* B = data;
+	xdg_surface_ack_configure(xsurf, serial);
+	B->configured = true;
+}
+
+static const struct xdg_surface_listener xsurf_listener = {
+	.configure = xsurf_configure
+};
+
+/* the size is ours to pick, the point is to measure it */
+static void top_configure(void* data,
+	struct xdg_toplevel* top, int32_t w, int32_t h, struct wl_array* states)
+{
+}
+
+static void top_close(void* data, struct xdg_toplevel* top)
+{
+}
+
+static const struct xdg_toplevel_listener top_listener = {
+	.configure = top_configure,
+	.close = top_close
+};
+
+static void buffer_release(void* data, struct wl_buffer* buf)
+{
+	struct buffer* b = data;
+	b->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	.release = buffer_release
+};
+
+static void frame_done(void* data, struct wl_callback* cb, uint32_t ms)
+{
+	struct bench* B = data;
+	B->frame_done = true;
+	B->frame_ns = now_ns(B->clock);
+	wl_callback_destroy(cb);
+}
+
+static const struct wl_callback_listener frame_listener = {
+	.done = frame_done
+};
+
+static struct bench* fb_bench;
+
+static void fb_sync_output(void* data,
+	struct wp_presentation_feedback* fb, struct wl_output* out)
+{
+}
+
+static void fb_presented(void* data, struct wp_presentation_feedback* fb,
+	uint32_t sec_hi, uint32_t sec_lo, uint32_t nsec, uint32_t refresh,
+	uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+{
+	struct frame_stat* fs = data;
+	fs->presented = true;
+	fs->present_ns =
+		(((uint64_t) sec_hi << 32) | sec_lo) * 1000000000 + nsec;
+	fs->fb = NULL;
+	fb_bench->outstanding--;
+	wp_presentation_feedback_destroy(fb);
+}
+
+static void fb_discarded(void* data, struct wp_presentation_feedback* fb)
+{
+	struct frame_stat* fs = data;
+	fs->discarded = true;
+	fs->fb = NULL;
+	fb_bench->outstanding--;
+	wp_presentation_feedback_destroy(fb);
+}
+
+static const struct wp_presentation_feedback_listener fb_listener = {
+	.sync_output = fb_sync_output,
+	.presented = fb_presented,
+	.discarded = fb_discarded
+};
+
+static bool alloc_shm(struct bench* B, size_t w, size_t h)
+{
+	size_t stride = w * 4;
+	size_t sz = stride * h;
+
+	int fd = memfd_create("wlbench", MFD_CLOEXEC);
+	if (-1 == fd || -1 == ftruncate(fd, sz * N_BUFFERS)){
+		if (-1 != fd)
+			close(fd);
+		return false;
+	}
+
+	uint8_t* map = mmap(NULL, sz * N_BUFFERS, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED){
+		close(fd);
+		return false;
+	}
+
+	struct wl_shm_pool* pool = wl_shm_create_pool(B->shm, fd, sz * N_BUFFERS);
+	for (size_t i = 0; i < N_BUFFERS; i++){
+		B->buffers[i] = (struct buffer){
+			.buf = wl_shm_pool_create_buffer(pool,
+				i * sz, w, h, stride, WL_SHM_FORMAT_XRGB8888),
+			.px = (uint32_t*)(map + i * sz),
+			.stride = w
+		};
+		wl_buffer_add_listener(B->buffers[i].buf, &buffer_listener, &B->buffers[i]);
+	}
+
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	return true;
+}
+
+#ifdef HAVE_GBM
+/* linear and kept mapped so that the same patterns can be drawn on the CPU,
+ * the bridge forwards the buffer as is */
+static bool alloc_dma(struct bench* B, size_t w, size_t h)
+{
+	for (size_t i = 0; i < N_BUFFERS; i++){
+		struct gbm_bo* bo = gbm_bo_create(B->gbm,
+			w, h, GBM_FORMAT_XRGB8888, GBM_BO_USE_LINEAR | GBM_BO_USE_RENDERING);
+		if (!bo)
+			return false;
+
+		uint32_t stride;
+		void* map_data = NULL;
+		void* map = gbm_bo_map(bo, 0, 0, w, h, GBM_BO_TRANSFER_WRITE, &stride, &map_data);
+		int fd = gbm_bo_get_fd(bo);
+		if (!map || -1 == fd){
+			if (-1 != fd)
+				close(fd);
+			gbm_bo_destroy(bo);
+			return false;
+		}
+
+		uint64_t mod = gbm_bo_get_modifier(bo);
+		struct zwp_linux_buffer_params_v1* params =
+			zwp_linux_dmabuf_v1_create_params(B->dmabuf);
+		zwp_linux_buffer_params_v1_add(params, fd, 0,
+			gbm_bo_get_offset(bo, 0), gbm_bo_get_stride(bo), mod >> 32, mod & 0xffffffff);
+
+		B->buffers[i] = (struct buffer){
+			.buf = zwp_linux_buffer_params_v1_create_immed(
+				params, w, h, DRM_FORMAT_XRGB8888, 0),
+			.px = map,
+			.stride = stride / 4,
+			.bo = bo,
+			.map_data = map_data
+		};
+		zwp_linux_buffer_params_v1_destroy(params);
+		close(fd);
+
+		wl_buffer_add_listener(B->buffers[i].buf, &buffer_listener, &B->buffers[i]);
+	}
+
+	return true;
+}
+#endif
+
+static void free_buffers(struct bench* B, size_t w, size_t h)
+{
+	for (size_t i = 0; i < N_BUFFERS; i++){
+		struct buffer* b = &B->buffers[i];
+		if (b->buf)
+			wl_buffer_destroy(b->buf);
+#ifdef HAVE_GBM
+		if (b->bo){
+			gbm_bo_unmap(b->bo, b->map_data);
+			gbm_bo_destroy(b->bo);
+			b->px = NULL;
+		}
+#endif
+	}
+
+/* the shm buffers share one mapping */
+	if (B->buffers[0].px)
+		munmap(B->buffers[0].px, w * h * 4 * N_BUFFERS);
+
+	memset(B->buffers, '\0', sizeof(B->buffers));
+}
+
+static void fill(struct buffer* b, struct region r, uint32_t px)
+{
+	for (size_t y = r.y; y < r.y + r.h; y++)
+		for (size_t x = r.x; x < r.x + r.w; x++)
+			b->px[y * b->stride + x] = px;
+}
+
+static struct region merge(struct region a, struct region b)
+{
+	if (!a.w || !a.h)
+		return b;
+
+	size_t x2 = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+	size_t y2 = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+	a.x = a.x < b.x ? a.x : b.x;
+	a.y = a.y < b.y ? a.y : b.y;
+	a.w = x2 - a.x;
+	a.h = y2 - a.y;
+	return a;
+}
+
+/*
+ * Draw frame [f] into [b] and return the damage. The untouched parts of a
+ * buffer are whatever it held before, which doesn't matter here as only the
+ * damaged region is what the bridge is asked to pick up.
+ *
+ *  full - every pixel changes
+ *  box  - a 64x64 box moves across a static background, the old and the new
+ *         position is damaged
+ *  line - one 16px band of text-like content per frame, top to bottom
+ */
+static struct region render(struct buffer* b,
+	enum damage_pattern pattern, size_t w, size_t h, size_t f)
+{
+	uint32_t px = 0xff000000 | ((f * 0x3b) & 0xff) << 16 | ((f * 0x17) & 0xff) << 8;
+	struct region r = {0, 0, w, h};
+
+	switch (pattern){
+	case DAMAGE_FULL:
+		fill(b, r, px);
+	break;
+	case DAMAGE_BOX:{
+		size_t bs = 64;
+		size_t span_x = w - bs, span_y = h - bs;
+		struct region box = {
+			.x = (f * 7) % (span_x ? span_x : 1),
+			.y = (f * 3) % (span_y ? span_y : 1),
+			.w = bs, .h = bs
+		};
+		if (f == 0)
+			fill(b, r, 0xff202020);
+		else{
+			fill(b, b->last, 0xff202020);
+			r = merge(b->last, box);
+		}
+		fill(b, box, 0xffe0e0e0);
+		b->last = box;
+	}
+	break;
+	case DAMAGE_LINE:{
+		size_t lh = 16;
+		r = (struct region){.y = (f * lh) % (h - h % lh), .w = w, .h = lh};
+		fill(b, r, 0xff000000);
+		for (size_t x = 0; x + 8 < w; x += 10)
+			fill(b, (struct region){x, r.y + 3, 8, 10}, (x / 10 + f) % 3 ? px : 0xff000000);
+	}
+	break;
+	}
+
+	return r;
+}
+
+static int cmp_u64(const void* a, const void* b)
+{
+	uint64_t va = *(uint64_t*) a, vb = *(uint64_t*) b;
+	return va < vb ? -1 : va > vb;
+}
+
+static void report(struct bench* B, const char* mode, size_t w, size_t h,
+	enum damage_pattern pattern, size_t frames, uint64_t copied,
+	uint64_t bridge, uint64_t* intervals, size_t n_intervals)
+{
+	size_t presented = 0, discarded = 0;
+	uint64_t* lat = malloc(sizeof(uint64_t) * (frames + 1));
+	uint64_t lat_sum = 0;
+
+	for (size_t i = 0; i < frames; i++){
+		struct frame_stat* fs = &B->stats[i];
+		discarded += fs->discarded;
+		if (!fs->presented)
+			continue;
+
+		uint64_t l = fs->present_ns > fs->commit_ns ?
+			(fs->present_ns - fs->commit_ns) / 1000 : 0;
+		lat[presented++] = l;
+		lat_sum += l;
+	}
+
+	qsort(lat, presented, sizeof(uint64_t), cmp_u64);
+
+	double cb_avg = 0, cb_dev = 0;
+	for (size_t i = 0; i < n_intervals; i++)
+		cb_avg += intervals[i];
+	if (n_intervals)
+		cb_avg /= n_intervals;
+	for (size_t i = 0; i < n_intervals; i++)
+		cb_dev += (intervals[i] - cb_avg) * (intervals[i] - cb_avg);
+	if (n_intervals)
+		cb_dev = sqrt(cb_dev / n_intervals);
+
+	printf("%s,%zu,%zu,%s,%zu,%zu,%zu,%"PRIu64",%"PRIu64",%"PRIu64
+		",%"PRIu64",%"PRIu64",%.0f,%.0f\n",
+		mode, w, h, damage_names[pattern], frames, presented, discarded,
+		presented ? lat_sum / presented : 0,
+		presented ? lat[presented * 95 / 100] : 0,
+		presented ? lat[presented - 1] : 0,
+		frames ? copied / frames : 0,
+		frames ? bridge / frames : 0,
+		cb_avg, cb_dev
+	);
+
+	free(lat);
+}
+
+static bool run(struct bench* B,
+	bool dma, size_t w, size_t h, enum damage_pattern pattern, size_t n_frames)
+{
+	const char* mode = dma ? "dma" : "shm";
+	bool ok = false;
+
+#ifdef HAVE_GBM
+	if (dma && !alloc_dma(B, w, h)){
+		fprintf(stderr, "%s:%zux%zu: couldn't allocate dma-buf buffers\n", mode, w, h);
+		free_buffers(B, w, h);
+		return false;
+	}
+#endif
+	if (!dma && !alloc_shm(B, w, h)){
+		fprintf(stderr, "%s:%zux%zu: couldn't allocate shm buffers\n", mode, w, h);
+		return false;
+	}
+
+	B->stats = calloc(n_frames, sizeof(struct frame_stat));
+	uint64_t* intervals = calloc(n_frames, sizeof(uint64_t));
+	size_t n_intervals = 0;
+
+	B->surf = wl_compositor_create_surface(B->comp);
+	B->xsurf = xdg_wm_base_get_xdg_surface(B->wm, B->surf);
+	xdg_surface_add_listener(B->xsurf, &xsurf_listener, B);
+	B->top = xdg_surface_get_toplevel(B->xsurf);
+	xdg_toplevel_add_listener(B->top, &top_listener, B);
+	xdg_toplevel_set_title(B->top, "wlbench");
+	B->configured = false;
+	wl_surface_commit(B->surf);
+
+	while (!B->configured)
+		if (!pump(B, FRAME_TIMEOUT_MS)){
+			fprintf(stderr, "%s:%zux%zu: no configure\n", mode, w, h);
+			goto out;
+		}
+
+	uint64_t copied = 0;
+	uint64_t last_cb = 0;
+	uint64_t bridge = bridge_ns(B->bridge);
+	size_t f = 0;
+
+	for (; f < n_frames; f++){
+		struct buffer* buf = NULL;
+		while (!buf){
+			for (size_t i = 0; i < N_BUFFERS && !buf; i++)
+				if (!B->buffers[i].busy)
+					buf = &B->buffers[i];
+
+			if (!buf && !pump(B, FRAME_TIMEOUT_MS)){
+				fprintf(stderr, "%s:%zux%zu:%s: no buffer released by frame %zu\n",
+					mode, w, h, damage_names[pattern], f);
+				goto done;
+			}
+		}
+
+		struct region r = render(buf, pattern, w, h, f);
+
+/* only the shm path copies, the first commit is the whole buffer */
+		if (!dma)
+			copied += f ? r.w * r.h * 4 : w * h * 4;
+
+		struct frame_stat* fs = &B->stats[f];
+		fs->fb = wp_presentation_feedback(B->pres, B->surf);
+		wp_presentation_feedback_add_listener(fs->fb, &fb_listener, fs);
+		B->outstanding++;
+
+		struct wl_callback* cb = wl_surface_frame(B->surf);
+		wl_callback_add_listener(cb, &frame_listener, B);
+		B->frame_done = false;
+
+		wl_surface_attach(B->surf, buf->buf, 0, 0);
+		if (f)
+			wl_surface_damage_buffer(B->surf, r.x, r.y, r.w, r.h);
+		else
+			wl_surface_damage_buffer(B->surf, 0, 0, w, h);
+
+		buf->busy = true;
+		fs->commit_ns = now_ns(B->clock);
+		wl_surface_commit(B->surf);
+
+		while (!B->frame_done)
+			if (!pump(B, FRAME_TIMEOUT_MS)){
+				fprintf(stderr, "%s:%zux%zu:%s: frame %zu timed out\n",
+					mode, w, h, damage_names[pattern], f);
+				goto done;
+			}
+
+		if (last_cb)
+			intervals[n_intervals++] = (B->frame_ns - last_cb) / 1000;
+		last_cb = B->frame_ns;
+	}
+	ok = true;
+
+done:
+	bridge = (bridge_ns(B->bridge) - bridge) / 1000;
+
+	uint64_t drain = now_ns(CLOCK_MONOTONIC);
+	while (B->outstanding &&
+		now_ns(CLOCK_MONOTONIC) - drain < DRAIN_TIMEOUT_MS * 1000000ull)
+		pump(B, DRAIN_TIMEOUT_MS);
+
+	report(B, mode, w, h, pattern, f, copied, bridge, intervals, n_intervals);
+
+out:
+	for (size_t i = 0; i < n_frames; i++)
+		if (B->stats[i].fb)
+			wp_presentation_feedback_destroy(B->stats[i].fb);
+	B->outstanding = 0;
+
+	xdg_toplevel_destroy(B->top);
+	xdg_surface_destroy(B->xsurf);
+	wl_surface_destroy(B->surf);
+	wl_display_roundtrip(B->dpy);
+
+	free_buffers(B, w, h);
+	free(B->stats);
+	free(intervals);
+	return ok;
+}
+
+static void usage()
+{
+	fprintf(stderr, "Usage: wlbench [options]\n"
+	"-m, --mode name      shm, dma or all (default)\n"
+	"-s, --size WxH,..    buffer sizes (default 640x480,1920x1080,3840x2160)\n"
+	"-d, --damage name    full, box, line or all (default)\n"
+	"-n, --frames n       number of frames per run (default 300)\n"
+	"-p, --pid n          bridge process (default: display socket peer)\n"
+	"-r, --render path    render node for dma-buf allocation (default /dev/dri/renderD128)\n"
+	"\n"
+	"Output columns:\n"
+	" mode,width,height,damage,frames,presented,discarded,lat_us_avg,lat_us_p95,\n"
+	" lat_us_max,copy_bytes,bridge_us,cb_us_avg,cb_jitter_us\n"
+	);
+}
+
+static const struct option longopts[] = {
+	{"mode", required_argument, NULL, 'm'},
+	{"size", required_argument, NULL, 's'},
+	{"damage", required_argument, NULL, 'd'},
+	{"frames", required_argument, NULL, 'n'},
+	{"pid", required_argument, NULL, 'p'},
+	{"render", required_argument, NULL, 'r'},
+	{"help", no_argument, NULL, 'h'},
+	{NULL, 0, NULL, 0}
+};
+
+int main(int argc, char** argv)
+{
+	const char* mode_sel = "all";
+	const char* damage_sel = "all";
+	const char* sizes = "640x480,1920x1080,3840x2160";
+	const char* render_node = "/dev/dri/renderD128";
+	size_t n_frames = 300;
+	pid_t pid = 0;
+
+	int ch;
+	while ((ch = getopt_long(argc, argv, "m:s:d:n:p:r:h", longopts, NULL)) >= 0){
+		switch (ch){
+		case 'm': mode_sel = optarg; break;
+		case 's': sizes = optarg; break;
+		case 'd': damage_sel = optarg; break;
+		case 'n': n_frames = strtoul(optarg, NULL, 10); break;
+		case 'p': pid = strtoul(optarg, NULL, 10); break;
+		case 'r': render_node = optarg; break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!n_frames){
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	struct bench B = {.clock = CLOCK_MONOTONIC};
+	fb_bench = &B;
+
+	B.dpy = wl_display_connect(NULL);
+	if (!B.dpy){
+		fprintf(stderr, "couldn't connect to the wayland display\n");
+		return EXIT_FAILURE;
+	}
+
+	B.reg = wl_display_get_registry(B.dpy);
+	wl_registry_add_listener(B.reg, &reg_listener, &B);
+	wl_display_roundtrip(B.dpy);
+	wl_display_roundtrip(B.dpy);
+
+	if (!B.comp || !B.shm || !B.wm || !B.pres){
+		fprintf(stderr, "missing wl_compositor v4, wl_shm, xdg_wm_base or wp_presentation\n");
+		return EXIT_FAILURE;
+	}
+
+	B.bridge = pid ? pid : socket_peer(B.dpy);
+	if (!B.bridge)
+		fprintf(stderr, "no bridge process, bridge_us will be 0\n");
+
+	bool want_dma = strcmp(mode_sel, "all") == 0 || strcmp(mode_sel, "dma") == 0;
+	bool want_shm = strcmp(mode_sel, "all") == 0 || strcmp(mode_sel, "shm") == 0;
+
+#ifdef HAVE_GBM
+	if (want_dma && B.dmabuf){
+		int fd = open(render_node, O_RDWR | O_CLOEXEC);
+		if (-1 != fd)
+			B.gbm = gbm_create_device(fd);
+	}
+	if (want_dma && !B.gbm){
+		fprintf(stderr, "no dma-buf support (%s), skipping dma\n", render_node);
+		want_dma = false;
+	}
+#else
+	(void) render_node;
+	if (want_dma && strcmp(mode_sel, "dma") == 0)
+		fprintf(stderr, "built without gbm, skipping dma\n");
+	want_dma = false;
+#endif
+
+	printf("mode,width,height,damage,frames,presented,discarded,lat_us_avg,lat_us_p95,"
+		"lat_us_max,copy_bytes,bridge_us,cb_us_avg,cb_jitter_us\n");
+
+	bool ok = true;
+	for (size_t m = 0; m < 2; m++){
+		bool dma = m == 1;
+		if ((dma && !want_dma) || (!dma && !want_shm))
+			continue;
+
+		for (const char* sz = sizes; sz && *sz;){
+			size_t w, h;
+			if (2 != sscanf(sz, "%zux%zu", &w, &h) || w < 64 || h < 64 || w > 8192 || h > 8192){
+				fprintf(stderr, "invalid size: %s\n", sz);
+				return EXIT_FAILURE;
+			}
+
+			for (size_t d = 0; d < COUNT_OF(damage_names); d++){
+				if (strcmp(damage_sel, "all") != 0 && strcmp(damage_sel, damage_names[d]) != 0)
+					continue;
+
+				fprintf(stderr, "%s:%zux%zu:%s\n", dma ? "dma" : "shm", w, h, damage_names[d]);
+				ok &= run(&B, dma, w, h, d, n_frames);
+			}
+
+			sz = strchr(sz, ',');
+			if (sz)
+				sz++;
+		}
+	}
+
+	wl_display_disconnect(B.dpy);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -26,7 +26,25 @@ local function encode_string(val)
 end
 
 
+-- profiler samples carry the folded stack (outermost;...;innermost) as message
+-- and the sampling interval as quantity, unfold into nested complete events on
+-- a separate track so they line up with the engine marks
+local function profile_lines(val, suffix)
+	local res = {}
+	for frame in string.gmatch(val.message, "[^;]+") do
+		table.insert(res, string.format(
+			[[{"name":%s, "cat":"lua,sample", "ph":"X","pid":0,"tid":1,"ts":%s,"dur":%s}]],
+			encode_string(frame), tostring(val.timestamp), tostring(val.quantity)
+		))
+	end
+	return table.concat(res, ",\n") .. suffix
+end
+
 local function sample_line(val, suffix)
+	if val.system == "lua" and val.subsystem == "sample" and #val.message > 0 then
+		return profile_lines(val, suffix)
+	end
+
 	local ph = "I"
 	if val.trigger == 1 then
 		ph = "B"
@@ -67,6 +85,7 @@ function tracetest(argv)
 	move_image(img, 100, 100, 100)
 	move_image(img, 0, 0, 100)
 	image_transform_cycle(img, true)
+	benchmark_profile(1000)
 
 	benchmark_enable(10,
 	function(set)
@@ -44,6 +44,19 @@
 -- Table Properties:
 --   rebench (default, false) -- reset internal benchmarking values
 --                               between runs.
+--
+-- Fixed mode:
+-- If the first appl argument to the benchmark sets fixed=1, e.g.
+--
+--   arcan -p tests tests/benchmark/fillrate fixed=1:steps=4:frames=60
+--
+-- the load is not ramped until the framerate drops. Instead the increment
+-- function is called @rampup (or step=n) times per step, and for each of @steps steps
+-- the frame cost (ms), frame interval (ms) and GPU (us, needs
+-- video_gpu_timers) of @frames frames are collected after @warmup frames.
+-- The result is printed as a single 'benchmark:json {...}' line on stdout
+-- and tick() fails when done. The random seed is fixed (seed=n) so runs
+-- produce the same scene. This is what tests/benchmark/run.rb drives.
 local function calc_avg(frames)
 	local val = 0;
 	local min = frames[1];
@@ -122,19 +135,205 @@ local function bench_destr(tbl)
 	benchmark_enable(false);
 end
 
+local fixed_opts = nil;
+
+-- key=val:key=val argument string to table
+local function parse_args(str)
+	local res = {};
+	for ent in string.gmatch(str, "[^:]+") do
+		local key, val = string.match(ent, "^([^=]+)=?(.*)$");
+		if (key) then
+			res[key] = tonumber(val) and tonumber(val) or val;
+		end
+	end
+	return res;
+end
+
 function benchmark_setup( arguments )
 	system_context_size(65535);
 	pop_video_context();
 	if (arguments == nil) then
 		return;
 	end
+
+	local args = parse_args(arguments);
+	if (args.fixed and args.fixed ~= 0) then
+		fixed_opts = {
+			steps = args.steps and args.steps or 5,
+-- benchmark_data keeps the last 63 samples
+			frames = args.frames and math.min(args.frames, 63) or 60,
+			warmup = args.warmup and args.warmup or 20,
+			step = args.step,
+			seed = args.seed and args.seed or 1
+		};
+		math.randomseed(fixed_opts.seed);
+	end
 end
 
 local function empty_warn(tbl)
 	warning("limit reached during testing, values inconclusive.\n");
 end
 
+-- the last [n] values of a ring table from benchmark_data, these are
+-- indexed from 0 with the most recent value last
+local function ring_tail(tbl, count)
+	local res = {};
+	local size = 0;
+	for k, v in pairs(tbl) do
+		size = k + 1 > size and k + 1 or size;
+	end
+
+	local n = count < size and count or size;
+	for i = size - n, size - 1 do
+		table.insert(res, tbl[i]);
+	end
+	return res;
+end
+
+local function summary(vals)
+	if (#vals == 0) then
+		return nil;
+	end
+
+	local sorted = {};
+	for i=1,#vals do
+		sorted[i] = vals[i];
+	end
+	table.sort(sorted);
+
+	local avg, min, max, stddev = calc_avg(vals);
+	return {
+		avg = avg,
+		min = min,
+		max = max,
+		stddev = stddev,
+		p95 = sorted[math.ceil(#sorted * 0.95)]
+	};
+end
+
+local function to_json(val)
+	local vt = type(val);
+	if (vt == "nil") then
+		return "null";
+	elseif (vt == "number") then
+		if (val ~= val or val == math.huge or val == -math.huge) then
+			return "null";
+		end
+		if (val == math.floor(val)) then
+			return string.format("%d", val);
+		end
+		return string.format("%.3f", val);
+	elseif (vt == "boolean") then
+		return tostring(val);
+	elseif (vt == "string") then
+		return string.format("%q", val);
+	end
+
+	local res = {};
+	if (#val > 0) then
+		for i=1,#val do
+			table.insert(res, to_json(val[i]));
+		end
+		return "[" .. table.concat(res, ",") .. "]";
+	end
+
+	local keys = {};
+	for k,_ in pairs(val) do
+		table.insert(keys, k);
+	end
+	table.sort(keys);
+	for _,k in ipairs(keys) do
+		table.insert(res, string.format("%q:%s", k, to_json(val[k])));
+	end
+	return "{" .. table.concat(res, ",") .. "}";
+end
+
+local function fixed_step(tbl)
+	for i=1,tbl.ramp do
+		local img = tbl.incr();
+		if (valid_vid(img)) then
+			table.insert(tbl.list, img);
+		end
+		tbl.count = tbl.count + 1;
+	end
+	tbl.warm = true;
+	benchmark_enable(true);
+end
+
+local function fixed_tick(tbl)
+	local _, _, framecnt, frames, costcnt, cost,
+		_, _, gpucnt, gpu = benchmark_data();
+
+	if (tbl.warm) then
+		if (framecnt < tbl.opts.warmup) then
+			return true;
+		end
+		tbl.warm = false;
+		benchmark_enable(true);
+		return true;
+	end
+
+	if (costcnt < tbl.opts.frames) then
+		return true;
+	end
+
+	local gpuvals = ring_tail(gpu, gpucnt);
+	table.insert(tbl.steps, {
+		load = tbl.count,
+		cost_ms = summary(ring_tail(cost, costcnt)),
+		frame_ms = summary(ring_tail(frames, framecnt)),
+		gpu_us = summary(gpuvals)
+	});
+
+	if (#tbl.steps < tbl.opts.steps) then
+		fixed_step(tbl);
+		return true;
+	end
+
+-- the summary is the mean of the per step averages
+	local res = {cost_ms = 0, frame_ms = 0};
+	local gpu_sum, gpu_n = 0, 0;
+	for _,v in ipairs(tbl.steps) do
+		res.cost_ms = res.cost_ms + v.cost_ms.avg / #tbl.steps;
+		res.frame_ms = res.frame_ms + v.frame_ms.avg / #tbl.steps;
+		if (v.gpu_us) then
+			gpu_sum = gpu_sum + v.gpu_us.avg;
+			gpu_n = gpu_n + 1;
+		end
+	end
+	res.gpu_us = gpu_n > 0 and gpu_sum / gpu_n or nil;
+
+	print("benchmark:json " .. to_json({
+		name = APPLID,
+		width = VRESW,
+		height = VRESH,
+		seed = tbl.opts.seed,
+		frames = tbl.opts.frames,
+		summary = res,
+		steps = tbl.steps
+	}));
+
+	benchmark_enable(false);
+	tbl.tick = function() return false; end
+	return false;
+end
+
 function benchmark_create(min_samples, threshold, ramp, increment_function)
+	if (fixed_opts) then
+		local res = {
+			tick = fixed_tick,
+			destroy = bench_destr,
+			incr = increment_function,
+			ramp = fixed_opts.step and fixed_opts.step or (ramp > 0 and ramp or 1),
+			opts = fixed_opts,
+			count = 0,
+			steps = {},
+			list = {}
+		};
+		fixed_step(res);
+		return res;
+	end
+
 	local res = {
 		tick = bench_tick,
 		rep = default_rep,